@@ -0,0 +1,57 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_BENCH_COMMON_H
+#define FAIR_MQ_BENCH_COMMON_H
+
+#include <fairmq/Channel.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <memory>
+#include <string>
+
+namespace fair::mq::bench
+{
+
+/// Transport factory of its own session, created outside of the measured loops
+struct TransportSetup
+{
+    explicit TransportSetup(const std::string& name)
+    {
+        fConfig.SetProperty<std::string>("session", tools::Uuid());
+        fConfig.SetProperty<bool>("shm-monitor", false);
+        fConfig.SetProperty<size_t>("shm-segment-size", 256 << 20);
+        fFactory = TransportFactory::CreateTransportFactory(name, tools::Uuid(), &fConfig);
+    }
+
+    ProgOptions fConfig;
+    std::shared_ptr<TransportFactory> fFactory;
+};
+
+/// Two connected pair channels, so that a single thread can do round trips
+struct ChannelPair
+{
+    explicit ChannelPair(TransportSetup& transport)
+        : fBind("bind", "pair", transport.fFactory)
+        , fConnect("connect", "pair", transport.fFactory)
+    {
+        std::string address(tools::ToString("ipc://@fairmq-microbench-", tools::Uuid()));
+        fBind.Bind(address);
+        fConnect.Connect(address);
+    }
+
+    Channel fBind;
+    Channel fConnect;
+};
+
+} // namespace fair::mq::bench
+
+#endif /* FAIR_MQ_BENCH_COMMON_H */
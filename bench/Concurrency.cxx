@@ -0,0 +1,167 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/tools/Futex.h>
+#include <fairmq/tools/PerThreadCounter.h>
+#include <fairmq/tools/Queues.h>
+#include <fairmq/tools/Semaphore.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace
+{
+
+using namespace fair::mq::tools;
+
+// items/s from a producer thread to the measuring (consumer) thread, move-only items like MessagePtr
+template<typename Queue>
+void QueueTransfer(benchmark::State& state)
+{
+    Queue queue(1024);
+    std::atomic<bool> stop(false);
+    std::thread producer([&]() {
+        auto item = std::make_unique<int>(1);
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (!queue.TryPush(std::move(item))) {
+                CpuRelax();
+            } else {
+                item = std::make_unique<int>(1);
+            }
+        }
+    });
+    std::unique_ptr<int> item;
+    for (auto _ : state) {
+        while (!queue.TryPop(item)) {
+            CpuRelax();
+        }
+        benchmark::DoNotOptimize(item.get());
+    }
+    stop = true;
+    producer.join();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK_TEMPLATE(QueueTransfer, SpscQueue<std::unique_ptr<int>>)->UseRealTime();
+BENCHMARK_TEMPLATE(QueueTransfer, MpmcQueue<std::unique_ptr<int>>)->UseRealTime();
+
+// baseline for QueueTransfer
+void LockedQueueTransfer(benchmark::State& state)
+{
+    std::mutex mtx;
+    std::queue<std::unique_ptr<int>> queue;
+    std::atomic<bool> stop(false);
+    std::thread producer([&]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (queue.size() < 1024) {
+                queue.push(std::make_unique<int>(1));
+            }
+        }
+    });
+    std::unique_ptr<int> item;
+    for (auto _ : state) {
+        while (true) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!queue.empty()) {
+                item = std::move(queue.front());
+                queue.pop();
+                break;
+            }
+        }
+        benchmark::DoNotOptimize(item.get());
+    }
+    stop = true;
+    producer.join();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(LockedQueueTransfer)->UseRealTime();
+
+// round trips between two threads, each blocked while the other one runs
+template<typename Sem>
+void SemaphorePingPong(benchmark::State& state)
+{
+    Sem ping(0);
+    Sem pong(0);
+    std::atomic<bool> stop(false);
+    std::thread partner([&]() {
+        while (true) {
+            ping.Wait();
+            if (stop) {
+                break;
+            }
+            pong.Signal();
+        }
+    });
+    for (auto _ : state) {
+        ping.Signal();
+        pong.Wait();
+    }
+    stop = true;
+    ping.Signal();
+    partner.join();
+}
+BENCHMARK_TEMPLATE(SemaphorePingPong, FutexSemaphore)->UseRealTime();
+BENCHMARK_TEMPLATE(SemaphorePingPong, Semaphore)->UseRealTime();
+
+// round trips with a short spin before parking
+void SpinParkPingPong(benchmark::State& state)
+{
+    const int spins = static_cast<int>(state.range(0));
+    SpinParkWaiter pingWaiter(spins);
+    SpinParkWaiter pongWaiter(spins);
+    std::atomic<uint64_t> ping(0);
+    std::atomic<uint64_t> pong(0);
+    std::atomic<bool> stop(false);
+    std::thread partner([&]() {
+        for (uint64_t i = 1;; ++i) {
+            pingWaiter.Wait([&]() { return ping.load(std::memory_order_acquire) >= i || stop; });
+            if (stop) {
+                break;
+            }
+            pong.store(i, std::memory_order_release);
+            pongWaiter.Notify();
+        }
+    });
+    uint64_t i = 0;
+    for (auto _ : state) {
+        ping.store(++i, std::memory_order_release);
+        pingWaiter.Notify();
+        pongWaiter.Wait([&]() { return pong.load(std::memory_order_acquire) >= i; });
+    }
+    stop = true;
+    pingWaiter.Notify();
+    partner.join();
+}
+BENCHMARK(SpinParkPingPong)->Arg(0)->Arg(1000)->UseRealTime();
+
+std::atomic<uint64_t> gSharedCounter(0);
+PerThreadCounter gPerThreadCounter;
+
+void SharedCounter(benchmark::State& state)
+{
+    for (auto _ : state) {
+        gSharedCounter.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+BENCHMARK(SharedCounter)->ThreadRange(1, 8)->UseRealTime();
+
+void ShardedCounter(benchmark::State& state)
+{
+    for (auto _ : state) {
+        gPerThreadCounter.Add();
+    }
+}
+BENCHMARK(ShardedCounter)->ThreadRange(1, 8)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,51 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/ProgOptions.h>
+#include <fairmq/tools/RateLimit.h>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+namespace
+{
+
+using namespace fair::mq;
+
+void GetPropertyInt(benchmark::State& state)
+{
+    ProgOptions config;
+    config.SetProperty<int>("bench-int", 42);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(config.GetProperty<int>("bench-int"));
+    }
+}
+BENCHMARK(GetPropertyInt);
+
+void GetPropertyString(benchmark::State& state)
+{
+    ProgOptions config;
+    config.SetProperty<std::string>("bench-string", "tcp://localhost:5555");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(config.GetProperty<std::string>("bench-string"));
+    }
+}
+BENCHMARK(GetPropertyString);
+
+// the overhead of a rate limiter that never has to sleep
+void RateLimiter(benchmark::State& state)
+{
+    tools::RateLimiter limiter(1e9);
+    for (auto _ : state) {
+        limiter.maybe_sleep();
+    }
+}
+BENCHMARK(RateLimiter);
+
+} // namespace
@@ -0,0 +1,79 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "Common.h"
+
+#include <fairmq/Parts.h>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+namespace
+{
+
+using namespace fair::mq;
+using namespace fair::mq::bench;
+
+void CreateMessage(benchmark::State& state, const std::string& transportName)
+{
+    TransportSetup transport(transportName);
+    const auto size = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        MessagePtr msg(transport.fFactory->CreateMessage(size));
+        benchmark::DoNotOptimize(msg->GetData());
+    }
+}
+BENCHMARK_CAPTURE(CreateMessage, zeromq, std::string("zeromq"))->RangeMultiplier(64)->Range(64, 4 << 20);
+BENCHMARK_CAPTURE(CreateMessage, shmem, std::string("shmem"))->RangeMultiplier(64)->Range(64, 4 << 20);
+
+void Copy(benchmark::State& state, const std::string& transportName)
+{
+    TransportSetup transport(transportName);
+    const auto size = static_cast<size_t>(state.range(0));
+    MessagePtr src(transport.fFactory->CreateMessage(size));
+    for (auto _ : state) {
+        MessagePtr dst(transport.fFactory->CreateMessage());
+        dst->Copy(*src);
+        benchmark::DoNotOptimize(dst->GetData());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK_CAPTURE(Copy, zeromq, std::string("zeromq"))->RangeMultiplier(64)->Range(64, 4 << 20);
+BENCHMARK_CAPTURE(Copy, shmem, std::string("shmem"))->RangeMultiplier(64)->Range(64, 4 << 20);
+
+// includes the creation of the message, compare with CreateMessage
+void SetUsedSize(benchmark::State& state, const std::string& transportName)
+{
+    TransportSetup transport(transportName);
+    const auto size = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        MessagePtr msg(transport.fFactory->CreateMessage(size));
+        benchmark::DoNotOptimize(msg->SetUsedSize(size / 2));
+    }
+}
+BENCHMARK_CAPTURE(SetUsedSize, zeromq, std::string("zeromq"))->RangeMultiplier(64)->Range(64, 4 << 20);
+BENCHMARK_CAPTURE(SetUsedSize, shmem, std::string("shmem"))->RangeMultiplier(64)->Range(64, 4 << 20);
+
+void BuildParts(benchmark::State& state, const std::string& transportName)
+{
+    TransportSetup transport(transportName);
+    const auto numParts = state.range(0);
+    for (auto _ : state) {
+        Parts parts;
+        for (int64_t i = 0; i < numParts; ++i) {
+            parts.AddPart(transport.fFactory->CreateMessage(64));
+        }
+        benchmark::DoNotOptimize(parts.Size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numParts);
+}
+BENCHMARK_CAPTURE(BuildParts, zeromq, std::string("zeromq"))->RangeMultiplier(8)->Range(1, 512);
+BENCHMARK_CAPTURE(BuildParts, shmem, std::string("shmem"))->RangeMultiplier(8)->Range(1, 512);
+
+} // namespace
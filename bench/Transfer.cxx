@@ -0,0 +1,123 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "Common.h"
+
+#include <fairmq/Parts.h>
+#include <fairmq/Poller.h>
+#include <fairmq/UnmanagedRegion.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace fair::mq;
+using namespace fair::mq::bench;
+
+// one iteration sends a message back and forth
+void RoundTrip(benchmark::State& state, const std::string& transportName)
+{
+    TransportSetup transport(transportName);
+    ChannelPair pair(transport);
+    const auto size = static_cast<size_t>(state.range(0));
+    MessagePtr msg(pair.fBind.NewMessage(size));
+    for (auto _ : state) {
+        if (pair.fBind.Send(msg) < 0 || pair.fConnect.Receive(msg) < 0 || pair.fConnect.Send(msg) < 0 || pair.fBind.Receive(msg) < 0) {
+            state.SkipWithError("transfer failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * 2);
+}
+BENCHMARK_CAPTURE(RoundTrip, zeromq, std::string("zeromq"))->RangeMultiplier(64)->Range(64, 4 << 20);
+BENCHMARK_CAPTURE(RoundTrip, shmem, std::string("shmem"))->RangeMultiplier(64)->Range(64, 4 << 20);
+
+void MultipartRoundTrip(benchmark::State& state, const std::string& transportName)
+{
+    TransportSetup transport(transportName);
+    ChannelPair pair(transport);
+    const auto numParts = state.range(0);
+    Parts parts;
+    for (int64_t i = 0; i < numParts; ++i) {
+        parts.AddPart(pair.fBind.NewMessage(1024));
+    }
+    for (auto _ : state) {
+        if (pair.fBind.Send(parts) < 0 || pair.fConnect.Receive(parts) < 0 || pair.fConnect.Send(parts) < 0 || pair.fBind.Receive(parts) < 0) {
+            state.SkipWithError("transfer failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * numParts * 2);
+}
+BENCHMARK_CAPTURE(MultipartRoundTrip, zeromq, std::string("zeromq"))->RangeMultiplier(8)->Range(2, 512);
+BENCHMARK_CAPTURE(MultipartRoundTrip, shmem, std::string("shmem"))->RangeMultiplier(8)->Range(2, 512);
+
+// one of many polled channels receives a message per iteration
+void Poll(benchmark::State& state, const std::string& transportName)
+{
+    TransportSetup transport(transportName);
+    const auto numChannels = static_cast<size_t>(state.range(0));
+    std::vector<Channel> pulls;
+    pulls.reserve(numChannels);
+    std::string address;
+    for (size_t i = 0; i < numChannels; ++i) {
+        address = tools::ToString("ipc://@fairmq-microbench-", tools::Uuid());
+        pulls.emplace_back(tools::ToString("pull", i), "pull", transport.fFactory);
+        pulls.back().Bind(address);
+    }
+    Channel push("push", "push", transport.fFactory);
+    push.Connect(address); // the last one
+    PollerPtr poller(transport.fFactory->CreatePoller(pulls));
+    MessagePtr msg(push.NewMessage(64));
+    for (auto _ : state) {
+        push.Send(msg);
+        poller->Poll(-1);
+        if (!poller->CheckInput(static_cast<int>(numChannels - 1)) || pulls.back().Receive(msg) < 0) {
+            state.SkipWithError("poll failed");
+            break;
+        }
+    }
+}
+BENCHMARK_CAPTURE(Poll, zeromq, std::string("zeromq"))->RangeMultiplier(16)->Range(1, 256);
+BENCHMARK_CAPTURE(Poll, shmem, std::string("shmem"))->RangeMultiplier(16)->Range(1, 256);
+
+// one iteration sends a region message, releases it on the receiving side and waits for the region callback
+void RegionAckRoundTrip(benchmark::State& state)
+{
+    TransportSetup transport("shmem");
+    ChannelPair pair(transport);
+    std::atomic<uint64_t> acked(0);
+    RegionConfig cfg;
+    cfg.ackBunchSize = static_cast<uint32_t>(state.range(0));
+    UnmanagedRegionPtr region(transport.fFactory->CreateUnmanagedRegion(1 << 20, [&](const std::vector<RegionBlock>& blocks) {
+        acked.fetch_add(blocks.size(), std::memory_order_release);
+    }, cfg));
+    uint64_t sent = 0;
+    for (auto _ : state) {
+        MessagePtr msg(pair.fBind.NewMessage(region, region->GetData(), 64, nullptr));
+        MessagePtr received(pair.fConnect.NewMessage());
+        if (pair.fBind.Send(msg) < 0 || pair.fConnect.Receive(received) < 0) {
+            state.SkipWithError("transfer failed");
+            break;
+        }
+        received.reset();
+        ++sent;
+        while (acked.load(std::memory_order_acquire) < sent) {
+            std::this_thread::yield();
+        }
+    }
+}
+BENCHMARK(RegionAckRoundTrip)->Arg(1)->Arg(64)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,27 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+// fairmq-microbench: Google Benchmark suite of the core primitives, see docs/Development.md
+
+#include <fairlogger/Logger.h>
+
+#include <benchmark/benchmark.h>
+
+int main(int argc, char** argv)
+{
+    // transports log their creation and destruction, once per benchmark run
+    fair::Logger::SetConsoleSeverity(fair::Severity::error);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
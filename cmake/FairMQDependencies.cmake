@@ -35,6 +35,32 @@ if(BUILD_FAIRMQ)
   set(PicoSHA2_PREFIX "<bundled>")
 endif()
 
+if(BUILD_RDMA_TRANSPORT)
+  find_package2(PRIVATE IBVerbs REQUIRED)
+endif()
+
+if(BUILD_COMPRESSION)
+  find_package2(PRIVATE LZ4)
+  find_package2(PRIVATE zstd)
+  if(NOT LZ4_FOUND AND NOT zstd_FOUND)
+    message(FATAL_ERROR "BUILD_COMPRESSION requires lz4 and/or zstd (hint with LZ4_ROOT, ZSTD_ROOT)")
+  endif()
+endif()
+
+if(BUILD_XDP_SOURCE)
+  find_package2(PRIVATE XDP REQUIRED)
+endif()
+
+if(BUILD_GPU_REGIONS)
+  find_package2(PRIVATE CUDAToolkit)
+  if(NOT CUDAToolkit_FOUND)
+    find_package2(PRIVATE hip)
+  endif()
+  if(NOT CUDAToolkit_FOUND AND NOT hip_FOUND)
+    message(FATAL_ERROR "BUILD_GPU_REGIONS requires the CUDA toolkit or HIP (hint with CUDAToolkit_ROOT, hip_ROOT)")
+  endif()
+endif()
+
 if(BUILD_TESTING)
   if(NOT GTest_FOUND AND NOT GTest_BUNDLED AND NOT USE_EXTERNAL_GTEST)
     build_bundled(GTest extern/googletest)
@@ -46,6 +72,10 @@ if(BUILD_TESTING)
   endif()
 endif()
 
+if(BUILD_MICROBENCH)
+  find_package2(PRIVATE benchmark REQUIRED)
+endif()
+
 if(BUILD_DOCS)
   find_package2(PRIVATE Doxygen REQUIRED VERSION 1.8.8
     COMPONENTS dot
@@ -33,6 +33,12 @@ macro(fairmq_summary_components)
     set(examples_summary "${BRed} NO${CR}    (enable with ${BMagenta}-DBUILD_EXAMPLES=ON${CR})")
   endif()
   message(STATUS "  ${BWhite}examples${CR}           ${examples_summary}")
+  if(BUILD_MICROBENCH)
+    set(microbench_summary "${BGreen}YES${CR}    (disable with ${BMagenta}-DBUILD_MICROBENCH=OFF${CR})")
+  else()
+    set(microbench_summary "${BRed} NO${CR}    (default, enable with ${BMagenta}-DBUILD_MICROBENCH=ON${CR})")
+  endif()
+  message(STATUS "  ${BWhite}microbench${CR}         ${microbench_summary}")
   if(BUILD_DOCS)
     set(docs_summary "${BGreen}YES${CR}    (disable with ${BMagenta}-DBUILD_DOCS=OFF${CR})")
   else()
@@ -92,6 +98,11 @@ macro(fairmq_summary_debug_mode)
   else()
     message(STATUS "  ${Cyan}DEBUG MODE${CR}         ${BRed}${FAIRMQ_DEBUG_MODE}${CR} (enable with ${BMagenta}-DFAIRMQ_DEBUG_MODE=ON${CR})")
   endif()
+  if(FAIRMQ_DISABLE_SOCKET_COUNTERS)
+    message(STATUS "  ${Cyan}SOCKET COUNTERS${CR}    ${BRed}OFF${CR} (enable with ${BMagenta}-DFAIRMQ_DISABLE_SOCKET_COUNTERS=OFF${CR})")
+  else()
+    message(STATUS "  ${Cyan}SOCKET COUNTERS${CR}    ${BGreen}ON${CR} (disable with ${BMagenta}-DFAIRMQ_DISABLE_SOCKET_COUNTERS=ON${CR})")
+  endif()
 endmacro()
 
 macro(fairmq_summary_compile_definitions)
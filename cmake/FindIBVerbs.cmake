@@ -0,0 +1,67 @@
+################################################################################
+# Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       #
+#                                                                              #
+#              This software is distributed under the terms of the             #
+#              GNU Lesser General Public Licence (LGPL) version 3,             #
+#                  copied verbatim in the file "LICENSE"                       #
+################################################################################
+#
+# ###############################
+# # Locate the ibverbs library #
+# ###############################
+#
+#
+# Usage:
+#
+#   find_package(IBVerbs [QUIET] [REQUIRED])
+#
+#
+# Defines the following variables:
+#
+#   IBVerbs_FOUND - Found the ibverbs library (rdma-core)
+#   IBVerbs_INCLUDE_DIR (CMake cache) - Include directory
+#   IBVerbs_LIBRARY (CMake cache) - Path to libibverbs
+#
+# and the imported target ibverbs.
+#
+#
+# Accepts the following variables as hints for installation directories:
+#
+#   IBVERBS_ROOT (CMake var, ENV var)
+#
+
+if(NOT IBVERBS_ROOT)
+  set(IBVERBS_ROOT $ENV{IBVERBS_ROOT})
+endif()
+
+find_path(IBVerbs_INCLUDE_DIR
+  NAMES infiniband/verbs.h
+  HINTS ${IBVERBS_ROOT}
+  PATH_SUFFIXES include
+  DOC "ibverbs include directory"
+)
+
+find_library(IBVerbs_LIBRARY
+  NAMES ibverbs
+  HINTS ${IBVERBS_ROOT}
+  PATH_SUFFIXES lib lib64
+  DOC "Path to libibverbs"
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(IBVerbs
+    REQUIRED_VARS IBVerbs_LIBRARY IBVerbs_INCLUDE_DIR
+)
+
+if(IBVerbs_FOUND AND NOT TARGET ibverbs)
+  add_library(ibverbs SHARED IMPORTED)
+  set_target_properties(ibverbs PROPERTIES
+    IMPORTED_LOCATION ${IBVerbs_LIBRARY}
+    INTERFACE_INCLUDE_DIRECTORIES ${IBVerbs_INCLUDE_DIR}
+  )
+endif()
+
+mark_as_advanced(
+    IBVerbs_INCLUDE_DIR
+    IBVerbs_LIBRARY
+)
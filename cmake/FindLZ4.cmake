@@ -0,0 +1,67 @@
+################################################################################
+# Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       #
+#                                                                              #
+#              This software is distributed under the terms of the             #
+#              GNU Lesser General Public Licence (LGPL) version 3,             #
+#                  copied verbatim in the file "LICENSE"                       #
+################################################################################
+#
+# ##########################
+# # Locate the lz4 library #
+# ##########################
+#
+#
+# Usage:
+#
+#   find_package(LZ4 [QUIET] [REQUIRED])
+#
+#
+# Defines the following variables:
+#
+#   LZ4_FOUND - Found the lz4 library
+#   LZ4_INCLUDE_DIR (CMake cache) - Include directory
+#   LZ4_LIBRARY (CMake cache) - Path to liblz4
+#
+# and the imported target lz4.
+#
+#
+# Accepts the following variables as hints for installation directories:
+#
+#   LZ4_ROOT (CMake var, ENV var)
+#
+
+if(NOT LZ4_ROOT)
+  set(LZ4_ROOT $ENV{LZ4_ROOT})
+endif()
+
+find_path(LZ4_INCLUDE_DIR
+  NAMES lz4.h
+  HINTS ${LZ4_ROOT}
+  PATH_SUFFIXES include
+  DOC "lz4 include directory"
+)
+
+find_library(LZ4_LIBRARY
+  NAMES lz4
+  HINTS ${LZ4_ROOT}
+  PATH_SUFFIXES lib lib64
+  DOC "Path to liblz4"
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4
+    REQUIRED_VARS LZ4_LIBRARY LZ4_INCLUDE_DIR
+)
+
+if(LZ4_FOUND AND NOT TARGET lz4)
+  add_library(lz4 SHARED IMPORTED)
+  set_target_properties(lz4 PROPERTIES
+    IMPORTED_LOCATION ${LZ4_LIBRARY}
+    INTERFACE_INCLUDE_DIRECTORIES ${LZ4_INCLUDE_DIR}
+  )
+endif()
+
+mark_as_advanced(
+    LZ4_INCLUDE_DIR
+    LZ4_LIBRARY
+)
@@ -0,0 +1,80 @@
+################################################################################
+# Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       #
+#                                                                              #
+#              This software is distributed under the terms of the             #
+#              GNU Lesser General Public Licence (LGPL) version 3,             #
+#                  copied verbatim in the file "LICENSE"                       #
+################################################################################
+#
+# ##########################################
+# # Locate the libxdp and libbpf libraries #
+# ##########################################
+#
+#
+# Usage:
+#
+#   find_package(XDP [QUIET] [REQUIRED])
+#
+#
+# Defines the following variables:
+#
+#   XDP_FOUND - Found the AF_XDP socket API (libxdp, or the xsk API of libbpf < 1.0)
+#   XDP_INCLUDE_DIR (CMake cache) - Include directory
+#   XDP_LIBRARY (CMake cache) - Path to libxdp (empty with libbpf < 1.0)
+#   XDP_BPF_LIBRARY (CMake cache) - Path to libbpf
+#
+# and the imported target xdp.
+#
+#
+# Accepts the following variables as hints for installation directories:
+#
+#   XDP_ROOT (CMake var, ENV var)
+#
+
+if(NOT XDP_ROOT)
+  set(XDP_ROOT $ENV{XDP_ROOT})
+endif()
+
+find_path(XDP_INCLUDE_DIR
+  NAMES xdp/xsk.h bpf/xsk.h
+  HINTS ${XDP_ROOT}
+  PATH_SUFFIXES include
+  DOC "libxdp include directory"
+)
+
+find_library(XDP_LIBRARY
+  NAMES xdp
+  HINTS ${XDP_ROOT}
+  PATH_SUFFIXES lib lib64
+  DOC "Path to libxdp"
+)
+
+find_library(XDP_BPF_LIBRARY
+  NAMES bpf
+  HINTS ${XDP_ROOT}
+  PATH_SUFFIXES lib lib64
+  DOC "Path to libbpf"
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(XDP
+    REQUIRED_VARS XDP_BPF_LIBRARY XDP_INCLUDE_DIR
+)
+
+if(XDP_FOUND AND NOT TARGET xdp)
+  add_library(xdp INTERFACE IMPORTED)
+  set_target_properties(xdp PROPERTIES
+    INTERFACE_INCLUDE_DIRECTORIES ${XDP_INCLUDE_DIR}
+  )
+  if(XDP_LIBRARY)
+    set_property(TARGET xdp PROPERTY INTERFACE_LINK_LIBRARIES ${XDP_LIBRARY} ${XDP_BPF_LIBRARY})
+  else()
+    set_property(TARGET xdp PROPERTY INTERFACE_LINK_LIBRARIES ${XDP_BPF_LIBRARY})
+  endif()
+endif()
+
+mark_as_advanced(
+    XDP_INCLUDE_DIR
+    XDP_LIBRARY
+    XDP_BPF_LIBRARY
+)
@@ -0,0 +1,67 @@
+################################################################################
+# Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       #
+#                                                                              #
+#              This software is distributed under the terms of the             #
+#              GNU Lesser General Public Licence (LGPL) version 3,             #
+#                  copied verbatim in the file "LICENSE"                       #
+################################################################################
+#
+# ###########################
+# # Locate the zstd library #
+# ###########################
+#
+#
+# Usage:
+#
+#   find_package(zstd [QUIET] [REQUIRED])
+#
+#
+# Defines the following variables:
+#
+#   zstd_FOUND - Found the zstd library
+#   zstd_INCLUDE_DIR (CMake cache) - Include directory
+#   zstd_LIBRARY (CMake cache) - Path to libzstd
+#
+# and the imported target zstd.
+#
+#
+# Accepts the following variables as hints for installation directories:
+#
+#   ZSTD_ROOT (CMake var, ENV var)
+#
+
+if(NOT ZSTD_ROOT)
+  set(ZSTD_ROOT $ENV{ZSTD_ROOT})
+endif()
+
+find_path(zstd_INCLUDE_DIR
+  NAMES zstd.h
+  HINTS ${ZSTD_ROOT}
+  PATH_SUFFIXES include
+  DOC "zstd include directory"
+)
+
+find_library(zstd_LIBRARY
+  NAMES zstd
+  HINTS ${ZSTD_ROOT}
+  PATH_SUFFIXES lib lib64
+  DOC "Path to libzstd"
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(zstd
+    REQUIRED_VARS zstd_LIBRARY zstd_INCLUDE_DIR
+)
+
+if(zstd_FOUND AND NOT TARGET zstd)
+  add_library(zstd SHARED IMPORTED)
+  set_target_properties(zstd PROPERTIES
+    IMPORTED_LOCATION ${zstd_LIBRARY}
+    INTERFACE_INCLUDE_DIRECTORIES ${zstd_INCLUDE_DIR}
+  )
+endif()
+
+mark_as_advanced(
+    zstd_INCLUDE_DIR
+    zstd_LIBRARY
+)
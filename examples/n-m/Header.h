@@ -19,6 +19,16 @@ struct Header
     int senderIndex;
 };
 
+// published by the synchronizer for every timeframe
+struct SyncHeader
+{
+    std::uint16_t id;
+    // senders are split into this many groups, group g sends g slots after the sync message (1: all at once)
+    std::uint16_t numGroups;
+    // slot length, the timeframe period of the synchronizer
+    std::uint32_t slotUs;
+};
+
 } // namespace example_n_m
 
 #endif /* FAIR_MQ_EXAMPLE_N_M_HEADER_H */
@@ -11,6 +11,9 @@
 #include <fairmq/Device.h>
 #include <fairmq/runDevice.h>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <string>
 
 using namespace std;
@@ -31,25 +34,53 @@ struct Sender : fair::mq::Device
         fair::mq::Channel& dataInChannel = GetChannel("sync", 0);
 
         while (!NewStatePending()) {
-            Header h;
+            // wait for the next sync message, but not past the slot of a scheduled subtimeframe
+            int timeout = 100;
+            if (!fScheduled.empty()) {
+                auto left = chrono::duration_cast<chrono::milliseconds>(fScheduled.front().first - chrono::steady_clock::now()).count();
+                timeout = static_cast<int>(clamp<decltype(left)>(left, 0, timeout));
+            }
             fair::mq::MessagePtr id(NewMessage());
-            if (dataInChannel.Receive(id) > 0) {
-                h.id = *(static_cast<uint16_t*>(id->GetData()));
-                h.senderIndex = fIndex;
-            } else {
-                continue;
+            if (dataInChannel.Receive(id, timeout) >= static_cast<int64_t>(sizeof(SyncHeader))) {
+                Schedule(*(static_cast<SyncHeader*>(id->GetData())));
+            }
+
+            while (!fScheduled.empty() && fScheduled.front().first <= chrono::steady_clock::now()) {
+                SendSubtimeframe(fScheduled.front().second);
+                fScheduled.pop_front();
             }
+        }
+    }
+
+    // Senders of group g send g slots after the sync message. As the synchronizer publishes one timeframe per slot and
+    // the timeframes go to the receivers round-robin, the groups send different timeframes to different receivers at a
+    // time: a receiver gets the data of one group per slot instead of all senders at once (TCP incast).
+    void Schedule(const SyncHeader& sync)
+    {
+        const int groups = max<int>(sync.numGroups, 1);
+        if (groups > fNumReceivers && !fWarned) {
+            LOG(warn) << "More sender groups (" << groups << ") than receivers (" << fNumReceivers << "), groups will share receivers";
+            fWarned = true;
+        }
+        const int group = fIndex % groups;
+        fScheduled.emplace_back(chrono::steady_clock::now() + chrono::microseconds(static_cast<int64_t>(group) * sync.slotUs), sync.id);
+    }
 
-            fair::mq::Parts parts;
-            parts.AddPart(NewSimpleMessage(h));
-            parts.AddPart(NewMessage(fSubtimeframeSize));
+    void SendSubtimeframe(uint16_t tfId)
+    {
+        Header h;
+        h.id = tfId;
+        h.senderIndex = fIndex;
 
-            uint64_t currentDataId = h.id;
-            int direction = currentDataId % fNumReceivers;
+        fair::mq::Parts parts;
+        parts.AddPart(NewSimpleMessage(h));
+        parts.AddPart(NewMessage(fSubtimeframeSize));
 
-            if (Send(parts, "data", direction, 0) < 0) {
-                LOG(debug) << "Failed to queue Subtimeframe #" << currentDataId << " to Receiver[" << direction << "]";
-            }
+        uint64_t currentDataId = h.id;
+        int direction = currentDataId % fNumReceivers;
+
+        if (Send(parts, "data", direction, 0) < 0) {
+            LOG(debug) << "Failed to queue Subtimeframe #" << currentDataId << " to Receiver[" << direction << "]";
         }
     }
 
@@ -57,6 +88,9 @@ struct Sender : fair::mq::Device
     int fNumReceivers = 0;
     unsigned int fIndex = 0;
     int fSubtimeframeSize = 10000;
+    // subtimeframes waiting for their slot (in order, all senders of a group have the same delay)
+    deque<pair<chrono::steady_clock::time_point, uint16_t>> fScheduled;
+    bool fWarned = false;
 };
 
 void addCustomOptions(bpo::options_description& options)
@@ -6,6 +6,8 @@
  *                  copied verbatim in the file "LICENSE"                       *
  ********************************************************************************/
 
+#include "Header.h"
+
 #include <fairmq/Device.h>
 #include <fairmq/runDevice.h>
 
@@ -13,13 +15,29 @@
 #include <cstdint>
 
 using namespace std;
+using namespace example_n_m;
 namespace bpo = boost::program_options;
 
 struct Synchronizer : fair::mq::Device
 {
+    void InitTask() override
+    {
+        fNumGroups = GetConfig()->GetProperty<int>("stagger-groups");
+        if (fNumGroups < 1 || fNumGroups > UINT16_MAX) {
+            throw runtime_error("--stagger-groups has to be between 1 and 65535");
+        }
+        // one timeframe per slot, so that the groups send different timeframes (to different receivers) at a time
+        const float rate = GetConfig()->GetProperty<float>("rate");
+        fSlotUs = rate > 0 ? static_cast<uint32_t>(1000000 / rate) : 0;
+        if (fNumGroups > 1 && fSlotUs == 0) {
+            LOG(warn) << "--stagger-groups needs a --rate to derive the slot length from, senders will send at once";
+        }
+    }
+
     bool ConditionalRun() override
     {
-        fair::mq::MessagePtr msg(NewSimpleMessage(fTimeframeId));
+        SyncHeader sync{fTimeframeId, static_cast<uint16_t>(fNumGroups), fSlotUs};
+        fair::mq::MessagePtr msg(NewSimpleMessage(sync));
 
         if (Send(msg, "sync") > 0) {
             if (++fTimeframeId == UINT16_MAX - 1) {
@@ -34,9 +52,15 @@ struct Synchronizer : fair::mq::Device
 
   private:
     uint16_t fTimeframeId = 0;
+    int fNumGroups = 1;
+    uint32_t fSlotUs = 0;
 };
 
-void addCustomOptions(bpo::options_description& /* options */) {}
+void addCustomOptions(bpo::options_description& options)
+{
+    options.add_options()
+        ("stagger-groups", bpo::value<int>()->default_value(1), "Number of sender groups sending in consecutive slots of one timeframe period (1 - all senders at once)");
+}
 std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /* config */)
 {
     return std::make_unique<Synchronizer>();
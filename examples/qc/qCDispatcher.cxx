@@ -33,9 +33,8 @@ struct QCDispatcher : fair::mq::Device
     bool HandleData(fair::mq::MessagePtr& msg, int)
     {
         if (fDoQC.load() == true) {
-            fair::mq::MessagePtr msgCopy(NewMessage());
-            msgCopy->Copy(*msg);
-            if (Send(msg, "qc") < 0) {
+            // the qc channel samples the messages (see the sample property), only the sampled ones are copied
+            if (GetChannel("qc").SendCopy(msg) < 0) {
                 return false;
             }
         }
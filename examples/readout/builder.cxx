@@ -24,9 +24,9 @@ class Builder : public fair::mq::Device
         OnData("rb", &Builder::HandleData);
     }
 
-    bool HandleData(fair::mq::MessagePtr& msg, int /*index*/)
+    bool HandleData(fair::mq::Parts& parts, int /*index*/)
     {
-        if (Send(msg, fOutputChannelName) < 0) {
+        if (Send(parts, fOutputChannelName) < 0) {
             return false;
         }
 
@@ -7,6 +7,7 @@
  ********************************************************************************/
 
 #include <fairmq/Device.h>
+#include <fairmq/RegionExtents.h>
 #include <fairmq/runDevice.h>
 
 namespace bpo = boost::program_options;
@@ -18,9 +19,11 @@ struct Processor : fair::mq::Device
         OnData("bp", &Processor::HandleData);
     }
 
-    bool HandleData(fair::mq::MessagePtr& msg, int /*index*/)
+    bool HandleData(fair::mq::Parts& parts, int /*index*/)
     {
-        fair::mq::MessagePtr msg2(NewMessageFor("ps", 0, msg->GetSize()));
+        // a single region message or a region extents message (readout --pages-per-frame)
+        const size_t size = fair::mq::IsRegionExtents(parts) ? fair::mq::RegionExtentsView(parts).TotalSize() : parts[0].GetSize();
+        fair::mq::MessagePtr msg2(NewMessageFor("ps", 0, size));
         if (Send(msg2, "ps") < 0) {
             return false;
         }
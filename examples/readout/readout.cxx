@@ -7,11 +7,14 @@
  ********************************************************************************/
 
 #include <fairmq/Device.h>
+#include <fairmq/RegionExtents.h>
 #include <fairmq/runDevice.h>
 
+#include <algorithm>
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <vector>
 
 namespace bpo = boost::program_options;
 
@@ -21,10 +24,11 @@ struct Readout : fair::mq::Device
     {
         fMsgSize = fConfig->GetProperty<int>("msg-size");
         fMaxIterations = fConfig->GetProperty<uint64_t>("max-iterations");
+        fPagesPerFrame = std::max(fConfig->GetProperty<int>("pages-per-frame"), 1);
 
         fRegion = fair::mq::UnmanagedRegionPtr(NewUnmanagedRegionFor("rb",
                                                                 0,
-                                                                10000000,
+                                                                std::max<size_t>(10000000, 2 * fPagesPerFrame * fMsgSize),
                                                                 [this](const std::vector<fair::mq::RegionBlock>& blocks) { // callback to be called when message buffers no longer needed by transport
                                                                     fNumUnackedMsgs -= blocks.size();
                                                                     if (fMaxIterations > 0) {
@@ -36,15 +40,27 @@ struct Readout : fair::mq::Device
 
     bool ConditionalRun() override
     {
-        fair::mq::MessagePtr msg(NewMessageFor("rb", // channel
-                                            0, // sub-channel
-                                            fRegion, // region
-                                            fRegion->GetData(), // ptr within region
-                                            fMsgSize, // offset from ptr
-                                            nullptr // hint
-                                            ));
+        int64_t bytes = 0;
+        if (fPagesPerFrame > 1) {
+            // the pages of a frame (every other page of the region) as one message with a single ack
+            std::vector<fair::mq::Span<char>> pages;
+            for (int i = 0; i < fPagesPerFrame; ++i) {
+                pages.emplace_back(static_cast<char*>(fRegion->GetData()) + 2 * i * fMsgSize, fMsgSize);
+            }
+            fair::mq::Parts frame(fair::mq::NewRegionExtents(*GetChannel("rb", 0).Transport(), fRegion, pages));
+            bytes = Send(frame, "rb", 0);
+        } else {
+            fair::mq::MessagePtr msg(NewMessageFor("rb", // channel
+                                                0, // sub-channel
+                                                fRegion, // region
+                                                fRegion->GetData(), // ptr within region
+                                                fMsgSize, // offset from ptr
+                                                nullptr // hint
+                                                ));
+            bytes = Send(msg, "rb", 0);
+        }
 
-        if (Send(msg, "rb", 0) > 0) {
+        if (bytes > 0) {
             ++fNumUnackedMsgs;
 
             if (fMaxIterations > 0 && ++fNumIterations >= fMaxIterations) {
@@ -69,6 +85,7 @@ struct Readout : fair::mq::Device
 
   private:
     int fMsgSize = 10000;
+    int fPagesPerFrame = 1;
     uint64_t fMaxIterations = 0;
     uint64_t fNumIterations = 0;
     fair::mq::UnmanagedRegionPtr fRegion = nullptr;
@@ -79,6 +96,7 @@ void addCustomOptions(bpo::options_description& options)
 {
     options.add_options()
         ("msg-size", bpo::value<int>()->default_value(1000), "Message size in bytes")
+        ("pages-per-frame", bpo::value<int>()->default_value(1), "Pages of msg-size bytes sent together as one region extents message (1 - single messages)")
         ("max-iterations", bpo::value<uint64_t>()->default_value(0), "Maximum number of iterations of Run/ConditionalRun/OnData (0 - infinite)");
 }
 
@@ -29,8 +29,8 @@ struct Receiver : Device
         Channel& dataInChannel = GetChannel("sr", 0);
 
         while (!NewStatePending()) {
-            auto msg(dataInChannel.NewMessage());
-            dataInChannel.Receive(msg);
+            Parts parts;
+            dataInChannel.Receive(parts);
 
             if (fMaxIterations > 0 && ++fNumIterations >= fMaxIterations) {
                 LOG(info) << "Configured max number of iterations reached. Leaving RUNNING state.";
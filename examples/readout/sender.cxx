@@ -21,9 +21,9 @@ struct Sender : fair::mq::Device
         OnData(fInputChannelName, &Sender::HandleData);
     }
 
-    bool HandleData(fair::mq::MessagePtr& msg, int /*index*/)
+    bool HandleData(fair::mq::Parts& parts, int /*index*/)
     {
-        if (Send(msg, "sr") < 0) {
+        if (Send(parts, "sr") < 0) {
             return false;
         }
 
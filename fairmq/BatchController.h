@@ -0,0 +1,91 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_BATCHCONTROLLER_H
+#define FAIR_MQ_BATCHCONTROLLER_H
+
+#include <algorithm> // min, max
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint>
+
+namespace fair::mq
+{
+
+/// Adapts the size and flush timeout of send batches to the load, so that the messages of a batch wait at most a
+/// latency target (channel property batchLatencyTargetUs). The first message of a batch of n waits for the n - 1
+/// messages that follow it, so the size follows target / inter-arrival time (measured as a moving average) and the
+/// timeout flushes batches that do not fill up in time. A share of the target is kept as headroom for the transfer
+/// itself: it shrinks when the first message of a flushed batch waited longer than the target and grows back slowly
+/// otherwise. At low rates the batches shrink to single messages, at high rates they grow up to the maximum size.
+/// Not thread-safe, the socket calls it under the lock of its batch.
+class BatchController
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    /// @param targetUs latency target of the messages of a batch in microseconds
+    /// @param maxSize largest batch size
+    BatchController(int targetUs, size_t maxSize)
+        : fTargetNs(std::max<int64_t>(targetUs, 1) * 1000)
+        , fMaxSize(std::max<size_t>(maxSize, 1))
+    {}
+
+    /// a message was added to the batch
+    void OnArrival(clock::time_point now)
+    {
+        if (fLastArrival != clock::time_point()) {
+            const double gap = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - fLastArrival).count());
+            fInterArrivalNs = fInterArrivalNs > 0 ? fInterArrivalNs + kAlpha * (gap - fInterArrivalNs) : gap;
+        }
+        fLastArrival = now;
+    }
+
+    /// the batch has been sent
+    /// @param started time the first message of the batch was added
+    void OnFlush(clock::time_point started, clock::time_point now)
+    {
+        const auto waitedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - started).count();
+        if (waitedNs > fTargetNs) {
+            fShare = std::max(fShare * 0.8, kMinShare);
+        } else {
+            fShare = std::min(fShare + 0.02, kMaxShare);
+        }
+    }
+
+    /// @return number of messages after which the current batch is sent
+    size_t Size() const
+    {
+        if (fInterArrivalNs <= 0) {
+            return 1;
+        }
+        const double fit = fShare * static_cast<double>(fTargetNs) / fInterArrivalNs;
+        return fit >= static_cast<double>(fMaxSize - 1) ? fMaxSize : static_cast<size_t>(fit) + 1;
+    }
+
+    /// @return time after which a batch that did not fill up is sent, in microseconds
+    int TimeoutUs() const { return std::max(static_cast<int>(fShare * static_cast<double>(fTargetNs) / 1000), 1); }
+
+    /// @return average time between two messages in nanoseconds, 0 until two messages were added
+    double InterArrivalNs() const { return fInterArrivalNs; }
+
+  private:
+    static constexpr double kAlpha = 0.125; // weight of the newest gap
+    static constexpr double kMinShare = 0.1;
+    static constexpr double kMaxShare = 0.9;
+
+    const int64_t fTargetNs;
+    const size_t fMaxSize;
+    double fShare = 0.8; // of the target that the messages may wait for the batch to fill up
+    double fInterArrivalNs = 0;
+    clock::time_point fLastArrival;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_BATCHCONTROLLER_H */
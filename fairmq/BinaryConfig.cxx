@@ -0,0 +1,239 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/BinaryConfig.h>
+#include <fairmq/JSONParser.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fairlogger/Logger.h>
+
+#include <boost/any.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#define BOOST_BIND_GLOBAL_PLACEHOLDERS
+#include <boost/property_tree/json_parser.hpp>
+#undef BOOST_BIND_GLOBAL_PLACEHOLDERS
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string_view>
+
+using namespace std;
+using namespace fair::mq::tools;
+
+namespace
+{
+
+constexpr char kMagic[8] = {'F', 'M', 'Q', 'C', 'F', 'G', '0', '1'};
+
+enum class Type : uint8_t
+{
+    String = 0,
+    Int = 1,
+    Bool = 2
+};
+
+struct IndexEntry
+{
+    uint32_t idOffset;
+    uint32_t idLength;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+template<typename T>
+void Put(string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// bounds checked reads from the mapped file
+class Reader
+{
+  public:
+    Reader(const char* data, size_t size)
+        : fPos(data)
+        , fEnd(data + size)
+    {}
+
+    template<typename T>
+    T Get()
+    {
+        T value;
+        memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    string_view GetString(size_t length) { return string_view(Take(length), length); }
+
+  private:
+    const char* Take(size_t n)
+    {
+        if (static_cast<size_t>(fEnd - fPos) < n) {
+            throw fair::mq::ParserError("binary config file is truncated or corrupted");
+        }
+        const char* p = fPos;
+        fPos += n;
+        return p;
+    }
+
+    const char* fPos;
+    const char* fEnd;
+};
+
+} // namespace
+
+namespace fair::mq
+{
+
+void WriteBinaryConfig(const map<string, Properties>& devices, const string& filename)
+{
+    string ids;
+    string data;
+    vector<IndexEntry> index;
+    index.reserve(devices.size());
+
+    for (const auto& device : devices) { // std::map: sorted by id
+        if (ids.size() + device.first.size() > numeric_limits<uint32_t>::max()) {
+            throw ParserError("too many devices for a binary config file");
+        }
+        index.push_back({static_cast<uint32_t>(ids.size()), static_cast<uint32_t>(device.first.size()), data.size(), 0});
+        ids.append(device.first);
+
+        Put(data, static_cast<uint32_t>(device.second.size()));
+        for (const auto& p : device.second) {
+            if (p.first.size() > numeric_limits<uint16_t>::max()) {
+                throw ParserError(ToString("property key too long: ", p.first));
+            }
+            Put(data, static_cast<uint16_t>(p.first.size()));
+            data.append(p.first);
+            if (const string* s = boost::any_cast<string>(&p.second)) {
+                Put(data, Type::String);
+                Put(data, static_cast<uint32_t>(s->size()));
+                data.append(*s);
+            } else if (const int* i = boost::any_cast<int>(&p.second)) {
+                Put(data, Type::Int);
+                Put(data, static_cast<int32_t>(*i));
+            } else if (const bool* b = boost::any_cast<bool>(&p.second)) {
+                Put(data, Type::Bool);
+                Put(data, static_cast<uint8_t>(*b));
+            } else {
+                throw ParserError(ToString("unsupported type of property ", p.first, " for a binary config file"));
+            }
+        }
+        index.back().dataSize = data.size() - index.back().dataOffset;
+    }
+
+    // ids and data follow the index
+    const uint64_t idsBegin = sizeof(kMagic) + sizeof(uint32_t) + index.size() * sizeof(IndexEntry);
+    const uint64_t dataBegin = idsBegin + ids.size();
+    string out(kMagic, sizeof(kMagic));
+    Put(out, static_cast<uint32_t>(index.size()));
+    for (auto entry : index) {
+        entry.idOffset = static_cast<uint32_t>(idsBegin + entry.idOffset);
+        entry.dataOffset += dataBegin;
+        Put(out, entry);
+    }
+    out.append(ids);
+    out.append(data);
+
+    ofstream file(filename, ios::binary | ios::trunc);
+    if (!file.write(out.data(), static_cast<streamsize>(out.size()))) {
+        throw ParserError(ToString("cannot write binary config file ", filename));
+    }
+}
+
+void CompileJSONConfig(const string& jsonFile, const string& filename)
+{
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(jsonFile, pt);
+    auto devices = helper::DevicesParser(pt.get_child("fairMQOptions"));
+    WriteBinaryConfig(devices, filename);
+    LOG(debug) << "Compiled channel configuration of " << devices.size() << " devices from " << jsonFile << " into " << filename;
+}
+
+bool IsBinaryConfig(const string& filename)
+{
+    char magic[sizeof(kMagic)];
+    ifstream file(filename, ios::binary);
+    return file.read(magic, sizeof(magic)) && memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+Properties BinaryConfigParser(const string& filename, const string& deviceId)
+{
+    using namespace boost::interprocess;
+
+    if (deviceId.empty()) {
+        throw ParserError("no device ID provided. Provide with `--id` cmd option");
+    }
+
+    LOG(debug) << "Reading binary config from " << filename << " ...";
+    file_mapping mapping(filename.c_str(), read_only);
+    mapped_region region(mapping, read_only);
+    const char* base = static_cast<const char*>(region.get_address());
+    const size_t size = region.get_size();
+
+    Reader header(base, size);
+    if (header.GetString(sizeof(kMagic)) != string_view(kMagic, sizeof(kMagic))) {
+        throw ParserError(ToString(filename, " is not a binary config file"));
+    }
+    const uint32_t numDevices = header.Get<uint32_t>();
+    const size_t indexBegin = sizeof(kMagic) + sizeof(uint32_t);
+    if ((size - indexBegin) / sizeof(IndexEntry) < numDevices) {
+        throw ParserError("binary config file is truncated or corrupted");
+    }
+
+    auto entry = [&](uint32_t i) {
+        return Reader(base + indexBegin + i * sizeof(IndexEntry), sizeof(IndexEntry)).Get<IndexEntry>();
+    };
+    auto id = [&](const IndexEntry& e) {
+        if (e.idOffset > size || size - e.idOffset < e.idLength) {
+            throw ParserError("binary config file is truncated or corrupted");
+        }
+        return string_view(base + e.idOffset, e.idLength);
+    };
+
+    // binary search in the sorted index
+    uint32_t lo = 0, hi = numDevices;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (id(entry(mid)) < deviceId) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    Properties properties;
+    if (lo == numDevices || id(entry(lo)) != deviceId) {
+        return properties;
+    }
+
+    const IndexEntry e = entry(lo);
+    if (e.dataOffset > size || size - e.dataOffset < e.dataSize) {
+        throw ParserError("binary config file is truncated or corrupted");
+    }
+    Reader data(base + e.dataOffset, e.dataSize);
+    const uint32_t numProperties = data.Get<uint32_t>();
+    for (uint32_t i = 0; i < numProperties; ++i) {
+        string key(data.GetString(data.Get<uint16_t>()));
+        switch (data.Get<Type>()) {
+            case Type::String: properties.emplace(move(key), string(data.GetString(data.Get<uint32_t>()))); break;
+            case Type::Int: properties.emplace(move(key), static_cast<int>(data.Get<int32_t>())); break;
+            case Type::Bool: properties.emplace(move(key), data.Get<uint8_t>() != 0); break;
+            default: throw ParserError("binary config file is truncated or corrupted");
+        }
+    }
+    return properties;
+}
+
+} // namespace fair::mq
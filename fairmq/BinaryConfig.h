@@ -0,0 +1,44 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_BINARYCONFIG_H
+#define FAIR_MQ_BINARYCONFIG_H
+
+#include <fairmq/Properties.h>
+
+#include <map>
+#include <string>
+
+namespace fair::mq
+{
+
+/// Precompiled channel configuration of a topology: the properties of all devices, as produced by the JSON parser,
+/// in a binary file with a sorted device index. A device maps the file and decodes only its own properties.
+///
+/// Layout (native byte order):
+///   header:  char[8] magic "FMQCFG01", uint32 number of devices
+///   index:   per device (sorted by id): uint32 id offset, uint32 id length, uint64 data offset, uint64 data size
+///   data:    per device: uint32 number of properties, per property: uint16 key length, key,
+///            uint8 type (0: string, 1: int, 2: bool), value (uint32 length + characters / int32 / uint8)
+/// Offsets are relative to the begin of the file.
+
+/// Write the given device properties (by device id) to a binary config file. Supports the property types of channels.
+void WriteBinaryConfig(const std::map<std::string, fair::mq::Properties>& devices, const std::string& filename);
+
+/// Compile a JSON topology file into a binary config file, see JSONParser()
+void CompileJSONConfig(const std::string& jsonFile, const std::string& filename);
+
+/// @return true if the file starts with the magic of a binary config file
+bool IsBinaryConfig(const std::string& filename);
+
+/// Channel properties of a device from a binary config file (empty if the device is not in the file)
+fair::mq::Properties BinaryConfigParser(const std::string& filename, const std::string& deviceId);
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_BINARYCONFIG_H */
@@ -0,0 +1,48 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_BUFFERARENA_H
+#define FAIR_MQ_BUFFERARENA_H
+
+#include <fairmq/Message.h>
+
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <memory>
+
+namespace fair::mq {
+
+/// Arena for many short-lived messages with a common lifetime (e.g. all outputs of one time frame): one large
+/// buffer is reserved up front, messages are carved out of it without taking a lock, and the whole buffer is returned
+/// at once when the arena and the last of its messages are released. Messages behave like any other message of the
+/// transport (they can be sent, copied and resized, receivers see no difference), but their memory is only reused after
+/// all of them are gone. Create it via TransportFactory::CreateBufferArena().
+class BufferArena
+{
+  public:
+    /// @brief Create a message in the arena
+    /// @param size message size
+    /// @param alignment alignment of the message buffer
+    /// @return message, allocated outside of the arena if the arena is exhausted
+    virtual MessagePtr NewMessage(size_t size, Alignment alignment = Alignment{0}) = 0;
+
+    /// Size of the arena buffer
+    virtual size_t GetSize() const = 0;
+    /// Bytes of the arena buffer handed out so far (including message headers and padding)
+    virtual size_t GetUsedSize() const = 0;
+    /// Messages that did not fit into the arena and were allocated outside of it
+    virtual uint64_t GetNumFallbacks() const = 0;
+
+    virtual ~BufferArena() = default;
+};
+
+using BufferArenaPtr = std::unique_ptr<BufferArena>;
+
+}   // namespace fair::mq
+
+#endif   // FAIR_MQ_BUFFERARENA_H
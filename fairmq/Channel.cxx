@@ -6,15 +6,21 @@
  *                  copied verbatim in the file "LICENSE"                       *
  ********************************************************************************/
 
+#include <algorithm>                    // all_of, max, min
 #include <boost/algorithm/string.hpp>   // join/split
 #include <cstddef>                      // size_t
+#include <cstdlib>                      // strtoul
+#include <cstring>                      // memcpy
 #include <fairlogger/Logger.h>
 #include <fairmq/Channel.h>
+#include <fairmq/HybridSocket.h>
 #include <fairmq/Properties.h>
 #include <fairmq/Tools.h>
+#include <fairmq/tools/Log.h>
 #include <random>
 #include <regex>
 #include <set>
+#include <unistd.h>                     // getpid
 
 namespace fair::mq {
 
@@ -42,10 +48,44 @@ constexpr int Channel::DefaultRcvKernelSize;
 constexpr int Channel::DefaultSndTimeoutMs;
 constexpr int Channel::DefaultRcvTimeoutMs;
 constexpr int Channel::DefaultLinger;
+constexpr const char* Channel::DefaultRcvMode;
+constexpr int Channel::DefaultRcvSpinUs;
+constexpr int Channel::DefaultSndBatch;
+constexpr int Channel::DefaultSndBatchTimeoutUs;
+constexpr int Channel::DefaultBatchLatencyTargetUs;
+constexpr const char* Channel::DefaultMetaFormat;
+constexpr const char* Channel::DefaultContextGroup;
+constexpr int Channel::DefaultPackParts;
+constexpr const char* Channel::DefaultCompression;
+constexpr int Channel::DefaultCompressionLevel;
+constexpr int Channel::DefaultCompressionThreads;
+constexpr int Channel::DefaultCompressionMinSize;
+constexpr int Channel::DefaultChunkSize;
+constexpr int Channel::DefaultMulticastRate;
+constexpr int Channel::DefaultMulticastRecovery;
+constexpr bool Channel::DefaultTrace;
+constexpr const char* Channel::DefaultOverflow;
+constexpr int Channel::DefaultDeadline;
+constexpr const char* Channel::DefaultSample;
+constexpr int Channel::DefaultMaxBandwidth;
+constexpr int Channel::DefaultBurst;
+constexpr const char* Channel::DefaultChecksum;
+constexpr bool Channel::DefaultPriorityLane;
+constexpr bool Channel::DefaultMux;
+constexpr const char* Channel::DefaultRoute;
+constexpr int Channel::DefaultPeerTimeout;
+constexpr bool Channel::DefaultAutoTune;
+constexpr int Channel::DefaultAutoTuneMaxBufSize;
+constexpr int Channel::DefaultAutoTuneMaxKernelSize;
 constexpr int Channel::DefaultRateLogging;
 constexpr int Channel::DefaultPortRangeMin;
 constexpr int Channel::DefaultPortRangeMax;
 constexpr bool Channel::DefaultAutoBind;
+constexpr const char* Channel::DefaultAutoBindStrategy;
+constexpr bool Channel::DefaultHybrid;
+constexpr bool Channel::DefaultSharedSend;
+constexpr const char* Channel::DefaultSpillDir;
+constexpr int Channel::DefaultSpillSize;
 
 Channel::Channel()
     : Channel(DefaultName, DefaultType, DefaultMethod, DefaultAddress, nullptr)
@@ -78,12 +118,49 @@ Channel::Channel(string name, string type, string method, string address, shared
     , fSndTimeoutMs(DefaultSndTimeoutMs)
     , fRcvTimeoutMs(DefaultRcvTimeoutMs)
     , fLinger(DefaultLinger)
+    , fRcvMode(DefaultRcvMode)
+    , fRcvSpinUs(DefaultRcvSpinUs)
+    , fSndBatch(DefaultSndBatch)
+    , fSndBatchTimeoutUs(DefaultSndBatchTimeoutUs)
+    , fBatchLatencyTargetUs(DefaultBatchLatencyTargetUs)
+    , fMetaFormat(DefaultMetaFormat)
+    , fContextGroup(DefaultContextGroup)
+    , fPackParts(DefaultPackParts)
+    , fCompression(DefaultCompression)
+    , fCompressionLevel(DefaultCompressionLevel)
+    , fCompressionThreads(DefaultCompressionThreads)
+    , fCompressionMinSize(DefaultCompressionMinSize)
+    , fChunkSize(DefaultChunkSize)
+    , fMulticastRate(DefaultMulticastRate)
+    , fMulticastRecovery(DefaultMulticastRecovery)
+    , fTrace(DefaultTrace)
+    , fOverflow(DefaultOverflow)
+    , fDeadline(DefaultDeadline)
+    , fSample(DefaultSample)
+    , fMaxBandwidth(DefaultMaxBandwidth)
+    , fBurst(DefaultBurst)
+    , fChecksum(DefaultChecksum)
+    , fPriorityLane(DefaultPriorityLane)
+    , fMux(DefaultMux)
+    , fRoute(DefaultRoute)
+    , fPeerTimeout(DefaultPeerTimeout)
+    , fAutoTune(DefaultAutoTune)
+    , fAutoTuneMaxBufSize(DefaultAutoTuneMaxBufSize)
+    , fAutoTuneMaxKernelSize(DefaultAutoTuneMaxKernelSize)
     , fRateLogging(DefaultRateLogging)
     , fPortRangeMin(DefaultPortRangeMin)
     , fPortRangeMax(DefaultPortRangeMax)
     , fAutoBind(DefaultAutoBind)
+    , fAutoBindStrategy(DefaultAutoBindStrategy)
+    , fHybrid(DefaultHybrid)
+    , fSharedSend(DefaultSharedSend)
+    , fSpillDir(DefaultSpillDir)
+    , fSpillSize(DefaultSpillSize)
+    , fRemoteTransportFactory(nullptr)
     , fValid(false)
     , fMultipart(false)
+    , fTraceChannel(0)
+    , fLastLane(Lane::normal)
 {
     // LOG(warn) << "Constructing channel '" << fName << "'";
 }
@@ -104,10 +181,44 @@ Channel::Channel(const string& name, int index, const Properties& properties)
     fSndTimeoutMs = GetPropertyOrDefault(properties, string(prefix + "sndTimeoutMs"), DefaultSndTimeoutMs);
     fRcvTimeoutMs = GetPropertyOrDefault(properties, string(prefix + "rcvTimeoutMs"), DefaultRcvTimeoutMs);
     fLinger = GetPropertyOrDefault(properties, string(prefix + "linger"), DefaultLinger);
+    fRcvMode = GetPropertyOrDefault(properties, string(prefix + "rcvMode"), std::string(DefaultRcvMode));
+    fRcvSpinUs = GetPropertyOrDefault(properties, string(prefix + "rcvSpinUs"), DefaultRcvSpinUs);
+    fSndBatch = GetPropertyOrDefault(properties, string(prefix + "sndBatch"), DefaultSndBatch);
+    fSndBatchTimeoutUs = GetPropertyOrDefault(properties, string(prefix + "sndBatchTimeoutUs"), DefaultSndBatchTimeoutUs);
+    fBatchLatencyTargetUs = GetPropertyOrDefault(properties, string(prefix + "batchLatencyTargetUs"), DefaultBatchLatencyTargetUs);
+    fMetaFormat = GetPropertyOrDefault(properties, string(prefix + "metaFormat"), std::string(DefaultMetaFormat));
+    fContextGroup = GetPropertyOrDefault(properties, string(prefix + "contextGroup"), std::string(DefaultContextGroup));
+    fPackParts = GetPropertyOrDefault(properties, string(prefix + "packParts"), DefaultPackParts);
+    fCompression = GetPropertyOrDefault(properties, string(prefix + "compression"), std::string(DefaultCompression));
+    fCompressionLevel = GetPropertyOrDefault(properties, string(prefix + "compressionLevel"), DefaultCompressionLevel);
+    fCompressionThreads = GetPropertyOrDefault(properties, string(prefix + "compressionThreads"), DefaultCompressionThreads);
+    fCompressionMinSize = GetPropertyOrDefault(properties, string(prefix + "compressionMinSize"), DefaultCompressionMinSize);
+    fChunkSize = GetPropertyOrDefault(properties, string(prefix + "chunkSize"), DefaultChunkSize);
+    fMulticastRate = GetPropertyOrDefault(properties, string(prefix + "multicastRate"), DefaultMulticastRate);
+    fMulticastRecovery = GetPropertyOrDefault(properties, string(prefix + "multicastRecovery"), DefaultMulticastRecovery);
+    fTrace = GetPropertyOrDefault(properties, string(prefix + "trace"), DefaultTrace);
+    fOverflow = GetPropertyOrDefault(properties, string(prefix + "overflow"), std::string(DefaultOverflow));
+    fDeadline = GetPropertyOrDefault(properties, string(prefix + "deadline"), DefaultDeadline);
+    fSample = GetPropertyOrDefault(properties, string(prefix + "sample"), std::string(DefaultSample));
+    fMaxBandwidth = GetPropertyOrDefault(properties, string(prefix + "maxBandwidth"), DefaultMaxBandwidth);
+    fBurst = GetPropertyOrDefault(properties, string(prefix + "burst"), DefaultBurst);
+    fChecksum = GetPropertyOrDefault(properties, string(prefix + "checksum"), std::string(DefaultChecksum));
+    fPriorityLane = GetPropertyOrDefault(properties, string(prefix + "priorityLane"), DefaultPriorityLane);
+    fMux = GetPropertyOrDefault(properties, string(prefix + "mux"), DefaultMux);
+    fRoute = GetPropertyOrDefault(properties, string(prefix + "route"), std::string(DefaultRoute));
+    fPeerTimeout = GetPropertyOrDefault(properties, string(prefix + "peerTimeout"), DefaultPeerTimeout);
+    fAutoTune = GetPropertyOrDefault(properties, string(prefix + "autoTune"), DefaultAutoTune);
+    fAutoTuneMaxBufSize = GetPropertyOrDefault(properties, string(prefix + "autoTuneMaxBufSize"), DefaultAutoTuneMaxBufSize);
+    fAutoTuneMaxKernelSize = GetPropertyOrDefault(properties, string(prefix + "autoTuneMaxKernelSize"), DefaultAutoTuneMaxKernelSize);
     fRateLogging = GetPropertyOrDefault(properties, string(prefix + "rateLogging"), DefaultRateLogging);
     fPortRangeMin = GetPropertyOrDefault(properties, string(prefix + "portRangeMin"), DefaultPortRangeMin);
     fPortRangeMax = GetPropertyOrDefault(properties, string(prefix + "portRangeMax"), DefaultPortRangeMax);
     fAutoBind = GetPropertyOrDefault(properties, string(prefix + "autoBind"), DefaultAutoBind);
+    fAutoBindStrategy = GetPropertyOrDefault(properties, string(prefix + "autoBindStrategy"), std::string(DefaultAutoBindStrategy));
+    fHybrid = GetPropertyOrDefault(properties, string(prefix + "hybrid"), DefaultHybrid);
+    fSharedSend = GetPropertyOrDefault(properties, string(prefix + "sharedSend"), DefaultSharedSend);
+    fSpillDir = GetPropertyOrDefault(properties, string(prefix + "spillDir"), std::string(DefaultSpillDir));
+    fSpillSize = GetPropertyOrDefault(properties, string(prefix + "spillSize"), DefaultSpillSize);
 }
 
 Channel::Channel(const Channel& chan)
@@ -129,12 +240,49 @@ Channel::Channel(const Channel& chan, string newName)
     , fSndTimeoutMs(chan.fSndTimeoutMs)
     , fRcvTimeoutMs(chan.fRcvTimeoutMs)
     , fLinger(chan.fLinger)
+    , fRcvMode(chan.fRcvMode)
+    , fRcvSpinUs(chan.fRcvSpinUs)
+    , fSndBatch(chan.fSndBatch)
+    , fSndBatchTimeoutUs(chan.fSndBatchTimeoutUs)
+    , fBatchLatencyTargetUs(chan.fBatchLatencyTargetUs)
+    , fMetaFormat(chan.fMetaFormat)
+    , fContextGroup(chan.fContextGroup)
+    , fPackParts(chan.fPackParts)
+    , fCompression(chan.fCompression)
+    , fCompressionLevel(chan.fCompressionLevel)
+    , fCompressionThreads(chan.fCompressionThreads)
+    , fCompressionMinSize(chan.fCompressionMinSize)
+    , fChunkSize(chan.fChunkSize)
+    , fMulticastRate(chan.fMulticastRate)
+    , fMulticastRecovery(chan.fMulticastRecovery)
+    , fTrace(chan.fTrace)
+    , fOverflow(chan.fOverflow)
+    , fDeadline(chan.fDeadline)
+    , fSample(chan.fSample)
+    , fMaxBandwidth(chan.fMaxBandwidth)
+    , fBurst(chan.fBurst)
+    , fChecksum(chan.fChecksum)
+    , fPriorityLane(chan.fPriorityLane)
+    , fMux(chan.fMux)
+    , fRoute(chan.fRoute)
+    , fPeerTimeout(chan.fPeerTimeout)
+    , fAutoTune(chan.fAutoTune)
+    , fAutoTuneMaxBufSize(chan.fAutoTuneMaxBufSize)
+    , fAutoTuneMaxKernelSize(chan.fAutoTuneMaxKernelSize)
     , fRateLogging(chan.fRateLogging)
     , fPortRangeMin(chan.fPortRangeMin)
     , fPortRangeMax(chan.fPortRangeMax)
     , fAutoBind(chan.fAutoBind)
+    , fAutoBindStrategy(chan.fAutoBindStrategy)
+    , fHybrid(chan.fHybrid)
+    , fSharedSend(chan.fSharedSend)
+    , fSpillDir(chan.fSpillDir)
+    , fSpillSize(chan.fSpillSize)
+    , fRemoteTransportFactory(chan.fRemoteTransportFactory)
     , fValid(false)
     , fMultipart(chan.fMultipart)
+    , fTraceChannel(0)
+    , fLastLane(Lane::normal)
 {}
 
 Channel& Channel::operator=(const Channel& chan)
@@ -157,12 +305,57 @@ Channel& Channel::operator=(const Channel& chan)
     fSndTimeoutMs = chan.fSndTimeoutMs;
     fRcvTimeoutMs = chan.fRcvTimeoutMs;
     fLinger = chan.fLinger;
+    fRcvMode = chan.fRcvMode;
+    fRcvSpinUs = chan.fRcvSpinUs;
+    fSndBatch = chan.fSndBatch;
+    fSndBatchTimeoutUs = chan.fSndBatchTimeoutUs;
+    fBatchLatencyTargetUs = chan.fBatchLatencyTargetUs;
+    fMetaFormat = chan.fMetaFormat;
+    fContextGroup = chan.fContextGroup;
+    fPackParts = chan.fPackParts;
+    fCompression = chan.fCompression;
+    fCompressionLevel = chan.fCompressionLevel;
+    fCompressionThreads = chan.fCompressionThreads;
+    fCompressionMinSize = chan.fCompressionMinSize;
+    fChunkSize = chan.fChunkSize;
+    fMulticastRate = chan.fMulticastRate;
+    fMulticastRecovery = chan.fMulticastRecovery;
+    fTrace = chan.fTrace;
+    fOverflow = chan.fOverflow;
+    fDeadline = chan.fDeadline;
+    fSample = chan.fSample;
+    fMaxBandwidth = chan.fMaxBandwidth;
+    fBurst = chan.fBurst;
+    fChecksum = chan.fChecksum;
+    fPriorityLane = chan.fPriorityLane;
+    fMux = chan.fMux;
+    fRoute = chan.fRoute;
+    fPeerTimeout = chan.fPeerTimeout;
+    fAutoTune = chan.fAutoTune;
+    fAutoTuneMaxBufSize = chan.fAutoTuneMaxBufSize;
+    fAutoTuneMaxKernelSize = chan.fAutoTuneMaxKernelSize;
     fRateLogging = chan.fRateLogging;
     fPortRangeMin = chan.fPortRangeMin;
     fPortRangeMax = chan.fPortRangeMax;
     fAutoBind = chan.fAutoBind;
+    fAutoBindStrategy = chan.fAutoBindStrategy;
+    fHybrid = chan.fHybrid;
+    fSharedSend = chan.fSharedSend;
+    fSpillDir = chan.fSpillDir;
+    fSpillSize = chan.fSpillSize;
+    fRemoteTransportFactory = chan.fRemoteTransportFactory;
     fValid = false;
     fMultipart = chan.fMultipart;
+    fLanePoller = nullptr;
+    fLane = nullptr;
+    fLastLane = Lane::normal;
+    fTuner = nullptr;
+    fOverflowState = nullptr;
+    fSampleState = nullptr;
+    fShapingState = nullptr;
+    fRpc = nullptr;
+    fSendQueue = nullptr;
+    fSharedSender = nullptr;
 
     return *this;
 }
@@ -205,7 +398,13 @@ try {
     } else {
         vector<string> endpoints;
         boost::algorithm::split(endpoints, fAddress, boost::algorithm::is_any_of(";"));
-        for (const auto& endpoint : endpoints) {
+        bool multicast = false;
+        for (size_t i = 0; i < endpoints.size(); ++i) {
+            string endpoint = endpoints[i];
+            if (IsMulticastAddress(endpoint.substr(min(endpoint.find_first_not_of("@+>"), endpoint.size()))) && i + 1 < endpoints.size() && endpoints[i + 1].find("://") == string::npos) {
+                // the multicast group follows the interface after a ';' (e.g. epgm://eth0;239.192.1.1:5555)
+                endpoint += ";" + endpoints[++i];
+            }
             string address;
             if (endpoint[0] == '@' || endpoint[0] == '+' || endpoint[0] == '>') {
                 address = endpoint.substr(1);
@@ -220,6 +419,12 @@ try {
                 }
                 address = endpoint;
             }
+            if (fHybrid && address.compare(0, 6, "tcp://") != 0) {
+                ss << "INVALID";
+                LOG(debug) << ss.str();
+                LOG(error) << "invalid channel address: '" << address << "' (hybrid channels need tcp addresses)";
+                return false;
+            }
             // check if address is a tcp or ipc address
             if (address.compare(0, 6, "tcp://") == 0) {
                 // check if TCP address contains port delimiter
@@ -248,6 +453,15 @@ try {
                     LOG(error) << "invalid channel address: '" << address << "' (empty inproc address?)";
                     return false;
                 }
+            } else if (IsMulticastAddress(address)) {
+                // check if the multicast address contains the port
+                if (address.rfind(':') < address.find("://") + 3) {
+                    ss << "INVALID";
+                    LOG(debug) << ss.str();
+                    LOG(error) << "invalid channel address: '" << address << "' (missing port?)";
+                    return false;
+                }
+                multicast = true;
             } else if (address.compare(0, 8, "verbs://") == 0) {
                 // check if IPC address is not empty
                 string addressString = address.substr(8);
@@ -265,6 +479,37 @@ try {
                 return false;
             }
         }
+
+        // validate multicast endpoints
+        if (multicast) {
+            const set<string> multicastTypes{ "pub", "sub", "xpub", "xsub" };
+            if (multicastTypes.find(fType) == multicastTypes.end()) {
+                ss << "INVALID";
+                LOG(debug) << ss.str();
+                LOG(error) << "multicast addresses are not supported for channels of type '" << fType << "', supported are pub, sub, xpub and xsub";
+                throw ChannelConfigurationError(tools::ToString("multicast addresses are not supported for channels of type '", fType, "'"));
+            }
+            if (fTransportType != Transport::ZMQ && fTransportType != Transport::DEFAULT) {
+                ss << "INVALID";
+                LOG(debug) << ss.str();
+                LOG(error) << "multicast addresses are only supported by the zeromq transport";
+                throw ChannelConfigurationError("multicast addresses are only supported by the zeromq transport");
+            }
+            if (fPriorityLane) {
+                ss << "INVALID";
+                LOG(debug) << ss.str();
+                LOG(error) << "multicast addresses cannot be combined with a priority lane";
+                throw ChannelConfigurationError("multicast addresses cannot be combined with a priority lane");
+            }
+        }
+    }
+
+    // validate multicast rate and recovery interval
+    if (fMulticastRate < 0 || fMulticastRecovery < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel multicast rate or recovery interval (cannot be negative): '" << fMulticastRate << "', '" << fMulticastRecovery << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel multicast rate or recovery interval: '", fMulticastRate, "', '", fMulticastRecovery, "'"));
     }
 
     // validate socket buffer size for sending
@@ -299,6 +544,248 @@ try {
         throw ChannelConfigurationError(tools::ToString("invalid channel receive kernel transmit size (cannot be negative): '", fRcvKernelSize, "'"));
     }
 
+    // validate receive mode
+    const set<string> rcvModes{ "block", "spin", "hybrid" };
+    if (rcvModes.find(fRcvMode) == rcvModes.end()) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel receive mode: '" << fRcvMode << "', valid are 'block', 'spin' and 'hybrid'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel receive mode: '", fRcvMode, "'"));
+    }
+
+    // validate busy-poll budget
+    if (fRcvSpinUs < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel receive spin budget (cannot be negative): '" << fRcvSpinUs << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel receive spin budget (cannot be negative): '", fRcvSpinUs, "'"));
+    }
+
+    // validate send batching
+    if (fSndBatch < 1) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel send batch size (must be at least 1): '" << fSndBatch << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel send batch size (must be at least 1): '", fSndBatch, "'"));
+    }
+    if (fSndBatchTimeoutUs <= 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel send batch timeout (must be positive): '" << fSndBatchTimeoutUs << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel send batch timeout (must be positive): '", fSndBatchTimeoutUs, "'"));
+    }
+    if (fBatchLatencyTargetUs < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel batch latency target (must be non-negative): '" << fBatchLatencyTargetUs << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel batch latency target (must be non-negative): '", fBatchLatencyTargetUs, "'"));
+    }
+
+    // validate meta format
+    const set<string> metaFormats{ "default", "compact" };
+    if (metaFormats.find(fMetaFormat) == metaFormats.end()) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel meta format: '" << fMetaFormat << "', valid are 'default' and 'compact'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel meta format: '", fMetaFormat, "'"));
+    }
+
+    // validate part packing
+    if (fPackParts < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel packed part size (cannot be negative): '" << fPackParts << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel packed part size (cannot be negative): '", fPackParts, "'"));
+    }
+
+    // validate compression
+    const set<string> codecs{ "none", "lz4", "zstd" };
+    if (codecs.find(fCompression) == codecs.end()) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel compression: '" << fCompression << "', valid are 'none', 'lz4' and 'zstd'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel compression: '", fCompression, "'"));
+    }
+    if (fCompression != DefaultCompression) {
+        if (fTransportType != Transport::ZMQ && fTransportType != Transport::DEFAULT) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "channel compression is only supported by the zeromq transport";
+            throw ChannelConfigurationError("channel compression is only supported by the zeromq transport");
+        }
+        if (fPackParts > 0) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "channel compression cannot be combined with part packing (packParts)";
+            throw ChannelConfigurationError("channel compression cannot be combined with part packing (packParts)");
+        }
+        if (fCompressionThreads < 1 || fCompressionMinSize < 0) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "invalid channel compression threads (must be at least 1) or minimum size (cannot be negative): '" << fCompressionThreads << "', '" << fCompressionMinSize << "'";
+            throw ChannelConfigurationError(tools::ToString("invalid channel compression threads or minimum size: '", fCompressionThreads, "', '", fCompressionMinSize, "'"));
+        }
+    }
+
+    // validate chunked transfers
+    if (fChunkSize < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel chunk size (cannot be negative): '" << fChunkSize << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel chunk size (cannot be negative): '", fChunkSize, "'"));
+    }
+    if (fChunkSize > 0 && (fPackParts > 0 || fCompression != DefaultCompression)) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "chunked transfers (chunkSize) cannot be combined with part packing (packParts) or compression";
+        throw ChannelConfigurationError("chunked transfers (chunkSize) cannot be combined with part packing (packParts) or compression");
+    }
+
+    // validate overflow policy and deadline
+    const set<string> overflowPolicies{ "block", "drop-new", "drop-old", "spill" };
+    if (overflowPolicies.find(fOverflow) == overflowPolicies.end()) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel overflow policy: '" << fOverflow << "', valid are 'block', 'drop-new', 'drop-old' and 'spill'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel overflow policy: '", fOverflow, "'"));
+    }
+    if (fOverflow == "spill" && (fSpillDir.empty() || fSpillSize < 1)) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "the overflow policy 'spill' needs a spill directory (spillDir) and a spill size of at least 1 MiB (spillSize)";
+        throw ChannelConfigurationError("the overflow policy 'spill' needs a spill directory (spillDir) and a spill size of at least 1 MiB (spillSize)");
+    }
+    if (fDeadline < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel deadline (cannot be negative): '" << fDeadline << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel deadline (cannot be negative): '", fDeadline, "'"));
+    }
+
+    // validate sampling policy
+    if (!ParseSample(fSample, nullptr)) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel sampling policy: '" << fSample << "', valid are 'all', '1/N', 'rate:<Hz>' and 'bytes:<B/s>'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel sampling policy: '", fSample, "'"));
+    }
+
+    // validate bandwidth limit
+    if (fMaxBandwidth < 0 || fBurst < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel bandwidth limit (cannot be negative): maxBandwidth '" << fMaxBandwidth << "', burst '" << fBurst << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel bandwidth limit (cannot be negative): maxBandwidth '", fMaxBandwidth, "', burst '", fBurst, "'"));
+    }
+
+    // validate checksum
+    try {
+        if (!tools::ChecksumAvailable(tools::ParseChecksumType(fChecksum))) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "channel checksum '" << fChecksum << "' is not available in this build";
+            throw ChannelConfigurationError(tools::ToString("channel checksum '", fChecksum, "' is not available in this build"));
+        }
+    } catch (const tools::ChecksumError& e) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel checksum: '" << fChecksum << "', valid are 'none', 'crc32c' and 'xxh3'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel checksum: '", fChecksum, "'"));
+    }
+
+    // validate automatic binding
+    if (fAutoBindStrategy != "random" && fAutoBindStrategy != "ephemeral") {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel autoBind strategy: '" << fAutoBindStrategy << "', valid are 'random' and 'ephemeral'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel autoBind strategy: '", fAutoBindStrategy, "'"));
+    }
+
+    // validate hybrid channel
+    if (fHybrid) {
+        const set<string> hybridTypes{ "push", "pull", "pair", "pub", "sub" };
+        if (hybridTypes.find(fType) == hybridTypes.end()) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "hybrid channels are not supported for channels of type '" << fType << "', supported are push, pull, pair, pub and sub";
+            throw ChannelConfigurationError(tools::ToString("hybrid channels are not supported for channels of type '", fType, "'"));
+        }
+        if (fPriorityLane || fMux) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "hybrid channels cannot be combined with priority lanes or multiplexing (mux)";
+            throw ChannelConfigurationError("hybrid channels cannot be combined with priority lanes or multiplexing (mux)");
+        }
+    }
+
+    // validate shared send path
+    if (fSharedSend) {
+        if (fType != "push" && fType != "pub") {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "shared send paths (sharedSend) are not supported for channels of type '" << fType << "', supported are push and pub";
+            throw ChannelConfigurationError(tools::ToString("shared send paths (sharedSend) are not supported for channels of type '", fType, "'"));
+        }
+        if (fMux || fAutoTune) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "shared send paths (sharedSend) cannot be combined with multiplexing (mux) or auto-tuning";
+            throw ChannelConfigurationError("shared send paths (sharedSend) cannot be combined with multiplexing (mux) or auto-tuning");
+        }
+    }
+
+    // validate priority lane
+    if (fPriorityLane) {
+        const set<string> laneTypes{ "push", "pull", "pair", "pub", "sub" };
+        if (laneTypes.find(fType) == laneTypes.end()) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "priority lanes are not supported for channels of type '" << fType << "', supported are push, pull, pair, pub and sub";
+            throw ChannelConfigurationError(tools::ToString("priority lanes are not supported for channels of type '", fType, "'"));
+        }
+    }
+
+    // validate multiplexing
+    if (fMux) {
+        const set<string> muxTypes{ "push", "pull", "pair", "pub", "sub", "dealer" };
+        if (muxTypes.find(fType) == muxTypes.end()) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "multiplexing is not supported for channels of type '" << fType << "', supported are push, pull, pair, pub, sub and dealer";
+            throw ChannelConfigurationError(tools::ToString("multiplexing is not supported for channels of type '", fType, "'"));
+        }
+        if (fPriorityLane || fAutoTune) {
+            ss << "INVALID";
+            LOG(debug) << ss.str();
+            LOG(error) << "multiplexed channels (mux) cannot be combined with priority lanes or auto-tuning";
+            throw ChannelConfigurationError("multiplexed channels (mux) cannot be combined with priority lanes or auto-tuning");
+        }
+    }
+
+    // validate routing policy
+    if (fRoute != "none" && fRoute != "hash") {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "Invalid channel routing policy: '" << fRoute << "', valid are 'none' and 'hash'";
+        throw ChannelConfigurationError(tools::ToString("Invalid channel routing policy: '", fRoute, "'"));
+    }
+
+    // validate peer timeout
+    if (fPeerTimeout < 0) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel peer timeout (cannot be negative): '" << fPeerTimeout << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel peer timeout: '", fPeerTimeout, "'"));
+    }
+
+    // validate auto-tuning bounds
+    if (fAutoTune && (fAutoTuneMaxBufSize < 1 || fAutoTuneMaxKernelSize < 1)) {
+        ss << "INVALID";
+        LOG(debug) << ss.str();
+        LOG(error) << "invalid channel auto-tuning maximum queue or kernel buffer size (must be positive): '" << fAutoTuneMaxBufSize << "', '" << fAutoTuneMaxKernelSize << "'";
+        throw ChannelConfigurationError(tools::ToString("invalid channel auto-tuning maximum queue or kernel buffer size: '", fAutoTuneMaxBufSize, "', '", fAutoTuneMaxKernelSize, "'"));
+    }
+
     // validate socket rate logging interval
     if (fRateLogging < 0) {
         ss << "INVALID";
@@ -318,7 +805,16 @@ try {
 
 void Channel::Init()
 {
-    fSocket = fTransportFactory->CreateSocket(fType, fName);
+    SocketPtr socket(fTransportFactory->CreateSocket(fType, fName, fContextGroup));
+    if (fHybrid) {
+        if (fTransportType == Transport::SHM && fRemoteTransportFactory) {
+            socket = make_unique<HybridSocket>(std::move(socket), fRemoteTransportFactory->CreateSocket(fType, fName, fContextGroup), fType);
+        } else {
+            LOG(warn) << "channel " << fName << ": hybrid channels need the shmem transport (and a zeromq transport for the remote peers), using " << fTransportType << " for all peers";
+        }
+    }
+    fSocket = std::move(socket);
+    InitRoute();
 
     // set linger duration (how long socket should wait for outstanding transfers before shutdown)
     fSocket->SetLinger(fLinger);
@@ -334,14 +830,1017 @@ void Channel::Init()
     if (fRcvKernelSize != 0) {
         fSocket->SetRcvKernelSize(fRcvKernelSize);
     }
+
+    if (fRcvMode != DefaultRcvMode) {
+        fSocket->SetRcvMode(fRcvMode, fRcvSpinUs);
+    }
+
+    if (fSndBatch > 1) {
+        fSocket->SetSndBatch(fSndBatch, fSndBatchTimeoutUs);
+    }
+    if (fBatchLatencyTargetUs > 0) {
+        fSocket->SetSndBatchLatencyTarget(fBatchLatencyTargetUs);
+    }
+
+    if (fMetaFormat != DefaultMetaFormat) {
+        fSocket->SetMetaFormat(fMetaFormat);
+    }
+
+    if (fPackParts > 0) {
+        fSocket->SetPackParts(fPackParts);
+    }
+
+    if (fCompression != DefaultCompression) {
+        if (fTransportType != Transport::ZMQ) {
+            LOG(warn) << "channel " << fName << ": compression is only supported by the zeromq transport, sending uncompressed";
+        }
+        fSocket->SetCompression(fCompression, fCompressionLevel, fCompressionThreads, fCompressionMinSize);
+    }
+
+    // apply before the endpoints are attached, libzmq reads them when the multicast session is created
+    if (fMulticastRate > 0) {
+        fSocket->SetOption("rate", &fMulticastRate, sizeof(fMulticastRate));
+    }
+    if (fMulticastRecovery > 0) {
+        fSocket->SetOption("recovery-ivl", &fMulticastRecovery, sizeof(fMulticastRecovery));
+    }
+
+    // like the multicast options, heartbeats apply to the connections created after they are set
+    if (fPeerTimeout > 0) {
+        if (fTransportType == Transport::ZMQ || fTransportType == Transport::SHM) {
+            const int immediate = 1;
+            const int heartbeatIvl = std::max(fPeerTimeout / 3, 1);
+            fSocket->SetOption("immediate", &immediate, sizeof(immediate));
+            fSocket->SetOption("heartbeat-ivl", &heartbeatIvl, sizeof(heartbeatIvl));
+            fSocket->SetOption("heartbeat-timeout", &fPeerTimeout, sizeof(fPeerTimeout));
+            fSocket->SetOption("heartbeat-ttl", &fPeerTimeout, sizeof(fPeerTimeout));
+        } else {
+            LOG(warn) << "channel " << fName << ": peer timeouts are only supported by the zeromq and shmem transports, ignoring";
+        }
+    }
+
+    if (fChunkSize > 0) {
+        if (fTransportType != Transport::ZMQ) {
+            LOG(warn) << "channel " << fName << ": chunked transfers are only supported by the zeromq transport, sending parts in one piece";
+        }
+        fSocket->SetChunkSize(fChunkSize);
+    }
+    if (fRcvTarget) {
+        fSocket->SetChunkTarget(fRcvTarget.get());
+    }
+    if (fChunkCallback) {
+        fSocket->SetChunkCallback(fChunkCallback);
+    }
+
+    if (fTrace) {
+        InitTrace();
+    }
+
+    InitOverflow();
+    InitSample();
+    InitShaping();
+    InitChecksum();
+
+    fTuner = nullptr;
+    if (fAutoTune) {
+        fTuner = make_unique<ChannelTuner>(ChannelSizes{fSndBufSize, fRcvBufSize, fSndKernelSize, fRcvKernelSize}, fAutoTuneMaxBufSize, fAutoTuneMaxKernelSize);
+    }
+
+    fLanePoller = nullptr;
+    fLane = nullptr;
+    if (fPriorityLane) {
+        fLane = make_unique<Channel>(*this, fName + "#prio");
+        fLane->fPriorityLane = false;
+        fLane->fAutoTune = false;
+        fLane->InitTransport(fTransportFactory);
+        fLane->Init();
+        fLane->fMetrics = fMetrics;
+        fLane->fTraceChannel = fTraceChannel;
+        fLane->fFlightRecorder = fFlightRecorder;
+        fLane->fFlightChannel = fFlightChannel;
+        fLanePoller = fTransportFactory->CreatePoller(vector<Channel*>{fLane.get(), this});
+    }
+
+    InitSharedSender();
+}
+
+void Channel::InitSharedSender()
+{
+    fSharedSender = nullptr;
+    if (!fSharedSend) {
+        return;
+    }
+    fSharedSender = make_unique<SharedSender>(fName, static_cast<size_t>(fSndBufSize > 0 ? fSndBufSize : DefaultSndBufSize), [this](Parts& parts, bool single, int timeoutMs) {
+        if (!single) {
+            return SendNow(parts, timeoutMs);
+        }
+        MessagePtr msg(move(parts.fParts.front()));
+        const int64_t result = SendNow(msg, timeoutMs);
+        if (result < 0) {
+            parts.fParts.front() = move(msg);
+        }
+        return result;
+    });
+}
+
+void Channel::ApplyTunedSizes()
+{
+    const ChannelSizes sizes(fTuner->Take());
+    if (sizes.sndBufSize != fSocket->GetSndBufSize()) {
+        fSocket->SetSndBufSize(sizes.sndBufSize);
+    }
+    if (sizes.rcvBufSize != fSocket->GetRcvBufSize()) {
+        fSocket->SetRcvBufSize(sizes.rcvBufSize);
+    }
+    // 0 keeps the kernel defaults
+    if (sizes.sndKernelSize != 0 && sizes.sndKernelSize != fSocket->GetSndKernelSize()) {
+        fSocket->SetSndKernelSize(sizes.sndKernelSize);
+    }
+    if (sizes.rcvKernelSize != 0 && sizes.rcvKernelSize != fSocket->GetRcvKernelSize()) {
+        fSocket->SetRcvKernelSize(sizes.rcvKernelSize);
+    }
+}
+
+void Channel::InitOverflow()
+{
+    if (fOverflow == DefaultOverflow && fDeadline <= 0) {
+        fOverflowState = nullptr;
+        return;
+    }
+    if (!fOverflowState) {
+        fOverflowState = make_unique<OverflowState>();
+    }
+    using Policy = OverflowState::Policy;
+    fOverflowState->fPolicy = fOverflow == "drop-new" ? Policy::dropNew : fOverflow == "drop-old" ? Policy::dropOld : fOverflow == "spill" ? Policy::spill : Policy::block;
+    fOverflowState->fBacklog.clear();
+    fOverflowState->fSpill = nullptr;
+    if (fOverflowState->fPolicy == Policy::spill && fSocket) {
+        SpillBufferConfig cfg;
+        cfg.filename = tools::ToString(fSpillDir, "/fmq_spill_", getpid(), "_", fName);
+        cfg.capacity = static_cast<uint64_t>(fSpillSize) << 20;
+        fOverflowState->fSpill = make_unique<SpillBuffer>(cfg);
+        LOG(debug) << "channel " << fName << ": spilling to " << cfg.filename << " (" << fSpillSize << " MiB)";
+    }
+}
+
+bool Channel::ParseSample(const string& sample, SampleState* state)
+{
+    if (sample == DefaultSample) {
+        return true;
+    }
+    auto parse = [](const string& value, double& result) {
+        try {
+            size_t pos = 0;
+            result = stod(value, &pos);
+            return pos == value.size() && result > 0;
+        } catch (const exception&) {
+            return false;
+        }
+    };
+    double value = 0;
+    auto policy = SampleState::Policy::every;
+    if (sample.compare(0, 2, "1/") == 0 && parse(sample.substr(2), value) && value == static_cast<double>(static_cast<uint64_t>(value))) {
+        policy = SampleState::Policy::every;
+    } else if (sample.compare(0, 5, "rate:") == 0 && parse(sample.substr(5), value)) {
+        policy = SampleState::Policy::rate;
+    } else if (sample.compare(0, 6, "bytes:") == 0 && parse(sample.substr(6), value)) {
+        policy = SampleState::Policy::bytes;
+    } else {
+        return false;
+    }
+    if (state) {
+        state->fPolicy = policy;
+        state->fEvery = policy == SampleState::Policy::every ? static_cast<uint64_t>(value) : 1;
+        state->fRate = value;
+        // a full bucket, so that the first messages are sampled; at least one message for rates below 1 Hz
+        state->fTokens = policy == SampleState::Policy::rate ? max(value, 1.) : value;
+        state->fRefill = chrono::steady_clock::now();
+    }
+    return true;
+}
+
+void Channel::InitSample()
+{
+    fSampleState = nullptr;
+    if (fSample == DefaultSample) {
+        return;
+    }
+    auto state = make_unique<SampleState>();
+    if (ParseSample(fSample, state.get())) { // invalid policies are reported by Validate()
+        fSampleState = move(state);
+    }
+}
+
+void Channel::InitShaping()
+{
+    if (fMaxBandwidth <= 0 || fBurst < 0) {
+        fShapingState = nullptr;
+        return;
+    }
+    fShapingState = make_unique<ShapingState>();
+    fShapingState->fRate = fMaxBandwidth * 1e6;
+    fShapingState->fBurst = fBurst > 0 ? fBurst * 1e6 : fShapingState->fRate / 10;
+    fShapingState->fTokens = fShapingState->fBurst;
+    fShapingState->fRefill = chrono::steady_clock::now();
+}
+
+// a token bucket refilled at every call; messages larger than the bucket wait for a full one and leave it in debt
+bool Channel::Shape(size_t size, int timeout)
+{
+    ShapingState& state = *fShapingState;
+    auto refill = [&state]() {
+        auto now = chrono::steady_clock::now();
+        state.fTokens = min(state.fBurst, state.fTokens + state.fRate * chrono::duration<double>(now - state.fRefill).count());
+        state.fRefill = now;
+    };
+    refill();
+    const double needed = min(static_cast<double>(size), state.fBurst);
+    if (state.fTokens < needed) {
+        const auto wait = chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>((needed - state.fTokens) / state.fRate));
+        if (timeout >= 0 && wait > chrono::milliseconds(timeout)) {
+            return false;
+        }
+        const auto start = state.fRefill;
+        this_thread::sleep_for(wait);
+        refill();
+        state.fShaped.fetch_add(1, memory_order_relaxed);
+        state.fWaitNs.fetch_add(chrono::duration_cast<chrono::nanoseconds>(state.fRefill - start).count(), memory_order_relaxed);
+    }
+    state.fTokens -= static_cast<double>(size);
+    return true;
+}
+
+// 1/N: a shared counter, rate/bytes: a token bucket holding one second of the rate, refilled at every call
+bool Channel::SampleState::Take(size_t size)
+{
+    bool sampled = true;
+    if (fPolicy == Policy::every) {
+        sampled = fCount.fetch_add(1, memory_order_relaxed) % fEvery == 0;
+    } else {
+        lock_guard<mutex> lock(fMtx);
+        auto now = chrono::steady_clock::now();
+        const double capacity = fPolicy == Policy::rate ? max(fRate, 1.) : fRate;
+        fTokens = min(capacity, fTokens + fRate * chrono::duration<double>(now - fRefill).count());
+        fRefill = now;
+        if (fPolicy == Policy::rate) {
+            sampled = fTokens >= 1;
+            fTokens -= sampled ? 1 : 0;
+        } else {
+            // messages larger than the budget are sent when it is positive and leave it in debt
+            sampled = fTokens > 0;
+            fTokens -= sampled ? static_cast<double>(size) : 0;
+        }
+    }
+    if (!sampled) {
+        fSampledOut.fetch_add(1, memory_order_relaxed);
+    }
+    return sampled;
+}
+
+// The deadline travels as a frame in front of the message: int64_t ns since the epoch of the system clock
+int64_t Channel::SendGuarded(Parts& parts, bool single, int timeout)
+{
+    OverflowState& state = *fOverflowState;
+    const bool framed = fDeadline > 0;
+    if (framed) {
+        auto deadline = parts.Empty() ? chrono::system_clock::time_point() : parts.At(0)->GetDeadline();
+        if (deadline == chrono::system_clock::time_point()) {
+            deadline = chrono::system_clock::now() + chrono::milliseconds(fDeadline);
+        }
+        const int64_t ns = chrono::duration_cast<chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        MessagePtr frame(NewMessage(sizeof(ns)));
+        memcpy(frame->GetData(), &ns, sizeof(ns));
+        parts.fParts.insert(parts.fParts.begin(), move(frame));
+        single = false;
+    }
+    const int64_t frameSize = framed ? sizeof(int64_t) : 0;
+    constexpr auto timedOut = static_cast<int64_t>(TransferCode::timeout);
+
+    int64_t result = 0;
+    if (state.fPolicy == OverflowState::Policy::block) {
+        result = SendParts(parts, single, timeout);
+    } else {
+        // the backlog (and the spilled messages) go first, to keep the order
+        result = DrainBacklog() ? SendParts(parts, single, 0) : timedOut;
+        if (result == timedOut && state.fPolicy == OverflowState::Policy::dropNew) {
+            state.fDropped.fetch_add(1, memory_order_relaxed);
+            result = 0;
+        } else if (result == timedOut && state.fPolicy == OverflowState::Policy::spill) {
+            result = -frameSize;
+            for (const auto& part : parts) {
+                result += part->GetSize();
+            }
+            if (!state.fSpill->Push(parts, single)) {
+                state.fDropped.fetch_add(1, memory_order_relaxed);
+                result = 0;
+            }
+            parts.fParts.clear(); // releases the transport memory
+            return result;
+        } else if (result == timedOut) {
+            result = -frameSize;
+            for (const auto& part : parts) {
+                result += part->GetSize();
+            }
+            state.fBacklog.emplace_back(move(parts), single);
+            parts.fParts.clear();
+            if (state.fBacklog.size() > static_cast<size_t>(fSndBufSize > 0 ? fSndBufSize : DefaultSndBufSize)) {
+                state.fBacklog.pop_front();
+                state.fDropped.fetch_add(1, memory_order_relaxed);
+            }
+            return result;
+        }
+    }
+    if (framed) {
+        parts.fParts.erase(parts.fParts.begin());
+        if (result >= frameSize) {
+            result -= frameSize;
+        }
+    }
+    return result;
+}
+
+bool Channel::DrainBacklog()
+{
+    OverflowState& state = *fOverflowState;
+    while (true) {
+        if (!state.fBacklog.empty()) {
+            if (SendParts(state.fBacklog.front().first, state.fBacklog.front().second, 0) < 0) {
+                return false;
+            }
+            state.fBacklog.pop_front();
+            continue;
+        }
+        if (!state.fSpill) {
+            return true;
+        }
+        // read back one message at a time, while the socket accepts them
+        Parts parts;
+        bool single = false;
+        if (!state.fSpill->Pop(parts, single, *fTransportFactory)) {
+            return state.fSpill->GetNumSpilled() == 0;
+        }
+        state.fBacklog.emplace_back(move(parts), single);
+    }
+}
+
+int64_t Channel::ReceiveUnexpired(Parts& parts, bool single, int timeout)
+{
+    auto start = chrono::steady_clock::now();
+    while (true) {
+        int remaining = timeout;
+        if (timeout > 0) {
+            // after the timeout, the queued messages are still checked without waiting
+            auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            remaining = max(0, timeout - static_cast<int>(elapsed));
+        }
+        int64_t result = ReceiveRaw(parts.fParts, remaining);
+        if (result < 0) {
+            return result;
+        }
+        int64_t ns = 0;
+        if (parts.Size() < 2 || parts.At(0)->GetSize() != sizeof(ns)) {
+            LOG(error) << "received a message without deadline frame on " << fName << ", the peer has to set the deadline property too";
+            parts.Clear();
+            return static_cast<int>(TransferCode::error);
+        }
+        memcpy(&ns, parts.At(0)->GetData(), sizeof(ns));
+        parts.fParts.erase(parts.fParts.begin());
+        const chrono::system_clock::time_point deadline(chrono::duration_cast<chrono::system_clock::duration>(chrono::nanoseconds(ns)));
+        if (chrono::system_clock::now() > deadline) {
+            fOverflowState->fExpired.fetch_add(1, memory_order_relaxed);
+            parts.Clear();
+            continue;
+        }
+        if (single && parts.Size() != 1) {
+            LOG(error) << "received a multipart message with a single part receive on " << fName;
+            parts.Clear();
+            return static_cast<int>(TransferCode::error);
+        }
+        for (auto& part : parts) {
+            part->SetDeadline(deadline);
+        }
+        return result - static_cast<int64_t>(sizeof(ns));
+    }
+}
+
+void Channel::InitChecksum()
+{
+    const auto type = tools::ParseChecksumType(fChecksum);
+    if (type == tools::ChecksumType::none) {
+        fChecksumState = nullptr;
+        return;
+    }
+    if (!fChecksumState) {
+        fChecksumState = make_unique<ChecksumState>();
+    }
+    fChecksumState->fType = type;
+}
+
+namespace
+{
+// high bytes of the tag of the checksum frame, the low byte is the checksum type
+constexpr uint64_t kChecksumTag = 0x464d51435300ULL; // "FMQCS"
+} // namespace
+
+void Channel::AddChecksums(Parts& parts)
+{
+    const auto type = fChecksumState->fType;
+    MessagePtr frame(NewMessage(sizeof(uint64_t) * (1 + parts.Size())));
+    auto* sums = static_cast<uint64_t*>(frame->GetData());
+    sums[0] = kChecksumTag | static_cast<uint64_t>(type);
+    for (size_t i = 0; i < parts.Size(); ++i) {
+        sums[1 + i] = tools::Checksum(type, parts.At(i)->GetData(), parts.At(i)->GetSize());
+    }
+    parts.AddPart(move(frame));
+}
+
+int64_t Channel::VerifyChecksums(Parts& parts, bool single)
+{
+    const size_t numParts = parts.Size() - 1;
+    const size_t frameSize = sizeof(uint64_t) * parts.Size();
+    uint64_t tag = 0;
+    if (parts.Size() >= 2 && parts.fParts.back()->GetSize() == frameSize) {
+        memcpy(&tag, parts.fParts.back()->GetData(), sizeof(tag));
+    }
+    if ((tag & ~0xffULL) != kChecksumTag) {
+        LOG(error) << "received a message without checksum frame on " << fName << ", the peer has to set the checksum property too";
+        parts.Clear();
+        return static_cast<int64_t>(TransferCode::error);
+    }
+    // the checksum type of the sender is used, the peers may be configured differently
+    const auto type = static_cast<tools::ChecksumType>(tag & 0xff);
+    const auto* sums = static_cast<const char*>(parts.fParts.back()->GetData()) + sizeof(tag);
+    for (size_t i = 0; i < numParts; ++i) {
+        uint64_t sum = 0;
+        memcpy(&sum, sums + i * sizeof(sum), sizeof(sum));
+        if (!tools::ChecksumAvailable(type) || tools::Checksum(type, parts.At(i)->GetData(), parts.At(i)->GetSize()) != sum) {
+            FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "checksum mismatch in part " << i << " of a message received on " << fName << ", discarding it";
+            fChecksumState->fCorrupt.fetch_add(1, memory_order_relaxed);
+            parts.Clear();
+            return static_cast<int64_t>(TransferCode::error);
+        }
+    }
+    parts.fParts.pop_back();
+    if (single && parts.Size() != 1) {
+        LOG(error) << "received a multipart message with a single part receive on " << fName;
+        parts.Clear();
+        return static_cast<int64_t>(TransferCode::error);
+    }
+    return static_cast<int64_t>(frameSize);
+}
+
+void Channel::InitRoute()
+{
+    // the subchannel index, e.g. 3 for "data[3]"
+    const auto open = fName.rfind('[');
+    fMuxRoute = open == string::npos ? 0 : static_cast<uint32_t>(strtoul(fName.c_str() + open + 1, nullptr, 10));
+}
+
+void Channel::InitShared(const Channel& carrier)
+{
+    fSocket = carrier.fSocket;
+    InitRoute();
+    if (fTrace) {
+        InitTrace();
+    }
+    InitOverflow();
+    InitSample();
+    InitShaping();
+    InitChecksum();
+    fTuner = nullptr;
+    fLanePoller = nullptr;
+    fLane = nullptr;
+}
+
+bool Channel::TakeRoute(Parts& parts)
+{
+    if (parts.Size() < 2 || parts.At(0)->GetSize() != sizeof(fReceivedRoute)) {
+        LOG(error) << "received a message without routing id on " << fName << ", the peer has to set the mux property too";
+        return false;
+    }
+    memcpy(&fReceivedRoute, parts.At(0)->GetData(), sizeof(fReceivedRoute));
+    parts.fParts.erase(parts.fParts.begin());
+    return true;
+}
+
+void Channel::InitTrace()
+{
+    fSocket->SetTrace(fTrace);
+    if (fTrace) {
+        fTraceChannel = Tracer::RegisterChannel(fName);
+    }
+}
+
+int64_t Channel::ReceiveBatch(vector<MessagePtr>& msgs, size_t max, int rcvTimeoutMs)
+{
+    return Timed(false, [&]() {
+        int64_t totalSize = 0;
+        for (size_t n = 0; n < max; ++n) {
+            MessagePtr msg(NewMessage());
+            const int timeout = n == 0 ? rcvTimeoutMs : 0;
+            int64_t nbytes = fChecksumState ? ReceiveChecksummed(msg, timeout) : fMux ? ReceiveMuxed(msg, timeout) : ReceiveSocket(msg, timeout);
+            if (nbytes < 0) {
+                if (n == 0) {
+                    return nbytes;
+                }
+                break; // queue drained
+            }
+            totalSize += nbytes;
+            if (fTrace) {
+                TraceReceive(msg.get());
+            }
+            if (fFlightRecorder) {
+                RecordFlight(false, msg, 0);
+            }
+            msgs.push_back(move(msg));
+        }
+        return totalSize;
+    });
+}
+
+int64_t Channel::Request(Parts& request, ReplyCallback callback, int timeoutMs)
+{
+    if (!fRpc) {
+        fRpc = make_unique<RpcState>();
+    }
+    const uint64_t id = fRpc->fNextId++;
+    MessagePtr frame(NewMessage(sizeof(id)));
+    memcpy(frame->GetData(), &id, sizeof(id));
+    request.fParts.insert(request.fParts.begin(), move(frame));
+
+    int64_t result = Send(request);
+    if (result < 0) {
+        request.fParts.erase(request.fParts.begin());
+        return result;
+    }
+    auto deadline = chrono::steady_clock::time_point::max();
+    if (timeoutMs >= 0) {
+        deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+        fRpc->fDeadlines.emplace(deadline, id);
+    }
+    fRpc->fPending.emplace(id, RpcState::Pending{move(callback), deadline});
+    return result - static_cast<int64_t>(sizeof(id));
+}
+
+future<Parts> Channel::Request(Parts& request, int timeoutMs)
+{
+    auto promise = make_shared<std::promise<Parts>>();
+    future<Parts> reply = promise->get_future();
+    int64_t result = Request(request, [promise, name = fName](ReplyStatus status, Parts& parts) {
+        if (status == ReplyStatus::ok) {
+            promise->set_value(move(parts));
+        } else {
+            promise->set_exception(make_exception_ptr(RequestError(tools::ToString("request on ", name, " timed out"))));
+        }
+    }, timeoutMs);
+    if (result < 0) {
+        promise->set_exception(make_exception_ptr(RequestError(tools::ToString("sending request on ", fName, " failed: ", result))));
+    }
+    return reply;
+}
+
+int Channel::DispatchReplies(int timeoutMs)
+{
+    int completed = ExpireRequests();
+    int wait = timeoutMs;
+    while (fRpc && !fRpc->fPending.empty()) {
+        if (wait != 0 && !fRpc->fDeadlines.empty()) {
+            // wake up for the next expiry
+            auto untilExpiry = static_cast<int>(max<int64_t>(chrono::duration_cast<chrono::milliseconds>(fRpc->fDeadlines.top().first - chrono::steady_clock::now()).count() + 1, 0));
+            wait = wait < 0 ? untilExpiry : min(wait, untilExpiry);
+        }
+        Parts reply;
+        int64_t result = Receive(reply, wait);
+        if (result == static_cast<int64_t>(TransferCode::timeout)) {
+            break;
+        } else if (result < 0) {
+            return static_cast<int>(result);
+        }
+        completed += HandleReply(reply);
+        wait = 0; // drain the queued replies
+    }
+    return completed + ExpireRequests();
+}
+
+int Channel::HandleReply(Parts& reply)
+{
+    int completed = ExpireRequests();
+    uint64_t id = 0;
+    if (reply.Empty() || reply.At(0)->GetSize() != sizeof(id)) {
+        LOG(warn) << "received a reply without correlation id on " << fName << ", ignoring it";
+        return completed;
+    }
+    memcpy(&id, reply.At(0)->GetData(), sizeof(id));
+    reply.fParts.erase(reply.fParts.begin());
+    if (!fRpc || fRpc->fPending.count(id) == 0) {
+        LOG(debug) << "received a reply to an unknown or expired request on " << fName << ", ignoring it";
+        return completed;
+    }
+    auto pending = fRpc->fPending.find(id);
+    ReplyCallback callback = move(pending->second.fCallback);
+    fRpc->fPending.erase(pending); // before the callback, which may send new requests
+    callback(ReplyStatus::ok, reply);
+    return completed + 1;
+}
+
+int Channel::ExpireRequests()
+{
+    if (!fRpc) {
+        return 0;
+    }
+    int expired = 0;
+    const auto now = chrono::steady_clock::now();
+    while (!fRpc->fDeadlines.empty() && fRpc->fDeadlines.top().first <= now) {
+        uint64_t id = fRpc->fDeadlines.top().second;
+        fRpc->fDeadlines.pop();
+        auto pending = fRpc->fPending.find(id);
+        if (pending == fRpc->fPending.end()) {
+            continue; // replied in time
+        }
+        ReplyCallback callback = move(pending->second.fCallback);
+        fRpc->fPending.erase(pending);
+        Parts empty;
+        callback(ReplyStatus::timeout, empty);
+        ++expired;
+    }
+    return expired;
+}
+
+void Channel::SendAsync(MessagePtr& m, SendCallback callback, int timeoutMs)
+{
+    Parts parts(move(m));
+    EnqueueSend(parts, true, move(callback), timeoutMs);
+}
+
+void Channel::SendAsync(Parts& m, SendCallback callback, int timeoutMs)
+{
+    Parts parts(move(m));
+    EnqueueSend(parts, false, move(callback), timeoutMs);
+}
+
+void Channel::EnqueueSend(Parts& parts, bool single, SendCallback callback, int timeoutMs)
+{
+    if (!fSendQueue) {
+        fSendQueue = make_unique<SendQueue>();
+    }
+    auto& queued = fSendQueue->fQueued;
+    if (queued.empty()) {
+        // nothing to keep the order with, try the socket first
+        int64_t result = SendQueued(parts, single, 0);
+        if (result >= 0) {
+            callback(SendStatus::ok, result);
+            return;
+        } else if (result == static_cast<int64_t>(TransferCode::error)) {
+            callback(SendStatus::error, 0);
+            return;
+        }
+    }
+    if (queued.size() >= static_cast<size_t>(fSndBufSize > 0 ? fSndBufSize : DefaultSndBufSize)) {
+        callback(SendStatus::dropped, 0);
+        return;
+    }
+    auto deadline = chrono::steady_clock::time_point::max();
+    if (timeoutMs >= 0) {
+        deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+        fSendQueue->fNextDeadline = min(fSendQueue->fNextDeadline, deadline);
+    }
+    queued.push_back(SendQueue::Queued{move(parts), single, move(callback), deadline});
+}
+
+int64_t Channel::SendQueued(Parts& parts, bool single, int timeout)
+{
+    if (single) {
+        return Send(parts.fParts.front(), timeout);
+    }
+    return Send(parts, timeout);
+}
+
+int Channel::DispatchSends(int timeoutMs)
+{
+    if (fOverflowState && fOverflowState->fSpill && !fSharedSender) {
+        DrainBacklog();
+    }
+    int completed = ExpireSends();
+    int wait = timeoutMs;
+    while (fSendQueue && !fSendQueue->fQueued.empty()) {
+        auto& front = fSendQueue->fQueued.front();
+        if (wait != 0 && fSendQueue->fNextDeadline != chrono::steady_clock::time_point::max()) {
+            // wake up for the next expiry
+            auto untilExpiry = static_cast<int>(max<int64_t>(chrono::duration_cast<chrono::milliseconds>(fSendQueue->fNextDeadline - chrono::steady_clock::now()).count() + 1, 0));
+            wait = wait < 0 ? untilExpiry : min(wait, untilExpiry);
+        }
+        int64_t result = SendQueued(front.fParts, front.fSingle, wait);
+        if (result == static_cast<int64_t>(TransferCode::timeout) || result == static_cast<int64_t>(TransferCode::interrupted)) {
+            break; // stays queued
+        }
+        SendCallback callback = move(front.fCallback);
+        fSendQueue->fQueued.pop_front(); // before the callback, which may send new messages
+        if (result >= 0) {
+            callback(SendStatus::ok, result);
+        } else {
+            callback(SendStatus::error, 0);
+        }
+        ++completed;
+        wait = 0; // send what the socket accepts without waiting
+    }
+    return completed + ExpireSends();
+}
+
+int Channel::ExpireSends()
+{
+    if (!fSendQueue) {
+        return 0;
+    }
+    const auto now = chrono::steady_clock::now();
+    if (fSendQueue->fNextDeadline > now) {
+        return 0;
+    }
+    vector<SendCallback> expired;
+    auto& queued = fSendQueue->fQueued;
+    fSendQueue->fNextDeadline = chrono::steady_clock::time_point::max();
+    for (auto it = queued.begin(); it != queued.end();) {
+        if (it->fDeadline <= now) {
+            expired.push_back(move(it->fCallback));
+            it = queued.erase(it);
+        } else {
+            fSendQueue->fNextDeadline = min(fSendQueue->fNextDeadline, it->fDeadline);
+            ++it;
+        }
+    }
+    // after updating the queue, the callbacks may send new messages
+    for (auto& callback : expired) {
+        callback(SendStatus::timeout, 0);
+    }
+    return static_cast<int>(expired.size());
+}
+
+Parts Channel::TakeEnvelope(Parts& request)
+{
+    // router channels receive the identity of the peer in front
+    const size_t size = fType == "router" ? 2 : 1;
+    if (request.Size() < size || request.At(size - 1)->GetSize() != sizeof(uint64_t)) {
+        throw RequestError(tools::ToString("received a request without correlation id on ", fName));
+    }
+    Parts envelope;
+    move(request.fParts.begin(), request.fParts.begin() + size, back_inserter(envelope.fParts));
+    request.fParts.erase(request.fParts.begin(), request.fParts.begin() + size);
+    return envelope;
+}
+
+int64_t Channel::Reply(Parts& envelope, Parts& reply, int sndTimeoutMs)
+{
+    const size_t envelopeSize = envelope.Size();
+    int64_t envelopeBytes = 0;
+    for (const auto& frame : envelope) {
+        envelopeBytes += frame->GetSize();
+    }
+    reply.fParts.insert(reply.fParts.begin(), make_move_iterator(envelope.fParts.begin()), make_move_iterator(envelope.fParts.end()));
+    envelope.fParts.clear();
+    int64_t result = Send(reply, sndTimeoutMs);
+    if (result < 0) {
+        // give the envelope back for a retry
+        move(reply.fParts.begin(), reply.fParts.begin() + envelopeSize, back_inserter(envelope.fParts));
+        reply.fParts.erase(reply.fParts.begin(), reply.fParts.begin() + envelopeSize);
+        return result;
+    }
+    return result - envelopeBytes;
+}
+
+string Channel::GenericPathFeature() const
+{
+    if (fChecksumState) {
+        return "checksums";
+    } else if (fMux) {
+        return "multiplexing (mux)";
+    } else if (fOverflowState) {
+        return "an overflow policy or deadline";
+    } else if (fSampleState) {
+        return "a sampling policy";
+    } else if (fShapingState) {
+        return "a bandwidth limit";
+    } else if (fTrace) {
+        return "tracing";
+    } else if (fFlightRecorder) {
+        return "the flight recorder";
+    } else if (fRcvTarget || fRcvPool) {
+        return "a receive target";
+    } else if (fTuner) {
+        return "auto-tuning";
+    } else if (fHybrid) {
+        return "a hybrid socket";
+    } else if (fSharedSender) {
+        return "a shared send path";
+    }
+    return "";
+}
+
+bool Channel::CheckSendCompatibility(MessagePtr& msg)
+{
+    if (fTransportType == msg->GetType()) {
+        return true;
+    }
+    if (msg->GetSize() == 0) {
+        MessagePtr newMsg(NewMessage());
+        newMsg->SetTraceContext(msg->GetTraceContext());
+        msg = move(newMsg);
+        return true;
+    }
+    void* data = msg->GetData();
+    if (!data) {
+        // e.g. a region message of a region that is not available in this process
+        LOG(error) << "cannot send " << msg->GetType() << " message on " << fTransportType << " channel " << fName << ": its buffer is not accessible";
+        return false;
+    }
+    MessagePtr msgWrapper(NewMessage(
+        data,
+        msg->GetSize(),
+        [](void* /*data*/, void* _msg) { delete static_cast<Message*>(_msg); },
+        msg.get()
+    ));
+    msgWrapper->SetTraceContext(msg->GetTraceContext());
+    msg.release();
+    msg = move(msgWrapper);
+    return true;
+}
+
+bool Channel::MoveToReceiveTarget(MessagePtr& msg)
+{
+    TransportFactory* target = fRcvPool ? &fRcvPool->GetTransport() : fRcvTarget.get();
+    if (!fRcvPool && msg->GetType() == target->GetType()) {
+        return true;
+    }
+    const size_t size = msg->GetSize();
+    MessagePtr received;
+    try {
+        if (fRcvPool && size > 0 && size <= fRcvPool->GetMaxMessageSize()) {
+            received = fRcvPool->NewMessage(size, fRcvPoolTimeoutMs);
+        }
+        if (!received) {
+            received = target->CreateMessage(size);
+        }
+    } catch (const exception& e) {
+        LOG(error) << "channel " << fName << ": cannot create a " << target->GetType() << " message of " << size << " bytes for a received message: " << e.what();
+        return false;
+    }
+    if (size > 0) {
+        tools::CopyPayload(received->GetData(), msg->GetData(), size);
+    }
+    received->SetTraceContext(msg->GetTraceContext());
+    msg = move(received);
+    return true;
+}
+
+int64_t Channel::SendCopy(const MessagePtr* msgs, size_t numMsgs, int sndTimeoutMs)
+{
+    if (fSampleState) {
+        size_t size = 0;
+        for (size_t i = 0; i < numMsgs; ++i) {
+            size += msgs[i]->GetSize();
+        }
+        if (!fSampleState->Take(size)) {
+            return 0;
+        }
+    }
+    Tune();
+    bool sameTransport = all_of(msgs, msgs + numMsgs, [this](const MessagePtr& msg) { return msg->GetType() == fTransportType; });
+    int64_t result = 0;
+    auto start = chrono::steady_clock::now();
+    if (fTrace && numMsgs > 0 && !msgs[0]->GetTraceContext()) {
+        msgs[0]->SetTraceContext(Tracer::Current());
+    }
+    // (with an overflow policy, deadlines, checksums or multiplexing the copies are sent with Send())
+    if (sameTransport && !fOverflowState && !fShapingState && !fChecksumState && !fMux && fSocket->SendCopy(msgs, numMsgs, sndTimeoutMs, result)) {
+        RecordCall(true, start, result);
+        for (size_t i = 0; fFlightRecorder && i < numMsgs; ++i) {
+            fFlightRecorder->Record(fFlightChannel, true, msgs[i]->GetData(), msgs[i]->GetSize(), static_cast<uint16_t>(i), i + 1 == numMsgs);
+        }
+        if (fTrace && numMsgs > 0 && msgs[0]->GetTraceContext()) {
+            Tracer::Record(msgs[0]->GetTraceContext(), fTraceChannel, TraceEvent::Type::send);
+        }
+        return result;
+    }
+
+    Parts copies;
+    for (size_t i = 0; i < numMsgs; ++i) {
+        TransportFactory* transport = msgs[i]->GetTransport() ? msgs[i]->GetTransport() : Transport();
+        MessagePtr copy(transport->CreateMessage());
+        copy->Copy(*msgs[i]);
+        copy->SetTraceContext(msgs[i]->GetTraceContext());
+        copies.AddPart(move(copy));
+    }
+    if (numMsgs == 1) {
+        return SendSampled(copies.At(0), sndTimeoutMs);
+    }
+    return SendSampled(copies, sndTimeoutMs);
+}
+
+int64_t Channel::Forward(Channel& out, int rcvTimeoutMs)
+{
+    Tune();
+    out.Tune();
+    int64_t result = 0;
+    auto start = chrono::steady_clock::now();
+    // with checksums on both sides the checksum frame is forwarded as it is, so the checks stay end-to-end
+    const bool sameChecksums = (fChecksumState == nullptr) == (out.fChecksumState == nullptr);
+    if (!fLane && !out.fLane && !fOverflowState && !out.fOverflowState && !out.fSampleState && !out.fShapingState && !fMux && !out.fMux && sameChecksums && fTransportType == out.fTransportType && fSocket->Forward(*out.fSocket, rcvTimeoutMs, result)) {
+        RecordCall(false, start, result);
+        out.RecordCall(true, start, result);
+        return result;
+    }
+
+    Parts parts;
+    int64_t nbytes = Receive(parts, rcvTimeoutMs);
+    if (nbytes < 0) {
+        return nbytes;
+    }
+    // messages of the priority lane stay on it
+    return out.Send(parts, fLastLane);
+}
+
+ChannelMetrics Channel::GetMetrics() const
+{
+    ChannelMetrics metrics;
+    metrics.name = fName;
+    metrics.transport = GetTransportName();
+    if (fSocket) {
+        metrics.bytesTx = GetBytesTx();
+        metrics.bytesRx = GetBytesRx();
+        metrics.messagesTx = GetMessagesTx();
+        metrics.messagesRx = GetMessagesRx();
+        metrics.messagesDropped = GetMessagesDropped();
+        metrics.messagesExpired = GetMessagesExpired();
+        metrics.messagesCorrupt = GetMessagesCorrupt();
+        metrics.sendsShaped = GetSendsShaped();
+        metrics.shapingWaitNs = GetShapingWaitNs();
+        fSocket->GetCompressionMetrics(metrics);
+        metrics.queueDepth = GetQueueDepth(&metrics.queueDepthExact);
+    }
+    if (auto recorder = fMetrics) {
+        recorder->Fill(metrics);
+    }
+    return metrics;
+}
+
+int64_t Channel::GetQueueDepth(bool* exact) const
+{
+    bool counted = false;
+    int64_t depth = fSocket ? fSocket->GetQueueDepth(counted) : -1;
+    if (fLane && depth >= 0) {
+        bool laneCounted = false;
+        const int64_t laneDepth = fLane->GetQueueDepth(&laneCounted);
+        depth = laneDepth >= 0 ? depth + laneDepth : depth;
+        counted = counted && laneDepth >= 0 && laneCounted;
+    }
+    if (exact) {
+        *exact = counted && depth >= 0;
+    }
+    return depth;
+}
+
+bool Channel::IsMulticastAddress(const string& address)
+{
+    return address.compare(0, 7, "epgm://") == 0 || address.compare(0, 6, "pgm://") == 0 || address.compare(0, 7, "norm://") == 0;
+}
+
+string Channel::LaneAddress(const string& address)
+{
+    if (address.compare(0, 6, "tcp://") == 0) {
+        size_t pos = address.rfind(':');
+        try {
+            return address.substr(0, pos + 1) + to_string(stoi(address.substr(pos + 1)) + 1);
+        } catch (const logic_error&) {
+            throw ChannelConfigurationError(tools::ToString("cannot derive priority lane address from ", address, " (tcp address without port)"));
+        }
+    }
+    return address + ".prio";
 }
 
 bool Channel::ConnectEndpoint(const string& endpoint)
 {
-    return fSocket->Connect(endpoint);
+    if (!fSocket->Connect(endpoint)) {
+        return false;
+    }
+    if (fLane && !fLane->fSocket->Connect(LaneAddress(endpoint))) {
+        LOG(error) << "could not connect priority lane of channel " << fName << " to " << LaneAddress(endpoint);
+        return false;
+    }
+    return true;
 }
 
 bool Channel::BindEndpoint(string& endpoint)
+{
+    if (!BindChannelEndpoint(endpoint)) {
+        return false;
+    }
+    // the lane is bound next to the (possibly automatically chosen) endpoint of the channel, where the peers expect it
+    if (fLane && !fLane->fSocket->Bind(LaneAddress(endpoint))) {
+        LOG(error) << "could not bind priority lane of channel " << fName << " to " << LaneAddress(endpoint);
+        return false;
+    }
+    return true;
+}
+
+bool Channel::BindChannelEndpoint(string& endpoint)
 {
     // try to bind to the configured port. If it fails, try random one (if AutoBind is on).
     if (fSocket->Bind(endpoint)) {
@@ -355,6 +1854,10 @@ bool Channel::BindEndpoint(string& endpoint)
         }
 
         if (fAutoBind) {
+            if (fAutoBindStrategy == "ephemeral" && (fTransportType == Transport::ZMQ || fTransportType == Transport::SHM) && BindEphemeralPort(endpoint)) {
+                return true;
+            }
+
             // number of attempts when choosing a random port
             int numAttempts = 0;
             int maxAttempts = 1000;
@@ -383,4 +1886,18 @@ bool Channel::BindEndpoint(string& endpoint)
     }
 }
 
+bool Channel::BindEphemeralPort(string& endpoint)
+{
+    // one bind, the kernel picks a free port, so there are no collisions with other devices starting at the same time
+    const size_t pos = endpoint.rfind(':');
+    if (!fSocket->Bind(endpoint.substr(0, pos + 1) + "*")) {
+        LOG(debug) << "Could not bind to an ephemeral (TCP) port on " << endpoint.substr(0, pos) << ", trying random ports";
+        return false;
+    }
+    const string bound = fSocket->GetBoundAddress();
+    endpoint = endpoint.substr(0, pos + 1) + bound.substr(bound.rfind(':') + 1);
+    LOG(debug) << "Could not bind to configured (TCP) port, bound to ephemeral port: " << endpoint;
+    return true;
+}
+
 } // namespace fair::mq
@@ -9,19 +9,40 @@
 #ifndef FAIR_MQ_CHANNEL_H
 #define FAIR_MQ_CHANNEL_H
 
+#include <fairmq/ChannelMetrics.h>
+#include <fairmq/ChannelTuner.h>
+#include <fairmq/FlightRecorder.h>
 #include <fairmq/Message.h>
 #include <fairmq/Parts.h>
+#include <fairmq/Poller.h>
 #include <fairmq/Properties.h>
+#include <fairmq/SharedSender.h>
+#include <fairmq/SpillBuffer.h>
 #include <fairmq/Socket.h>
+#include <fairmq/Tracing.h>
 #include <fairmq/TransportFactory.h>
 #include <fairmq/Transports.h>
 #include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/Checksum.h>
+#include <fairmq/tools/Probes.h>
 
+#include <algorithm> // min
+#include <atomic>
+#include <chrono>
 #include <cstdint>   // int64_t
+#include <cstring>   // memcpy
+#include <deque>
+#include <functional>
+#include <future>
+#include <iterator>  // back_inserter
 #include <memory>   // unique_ptr, shared_ptr
+#include <mutex>
 #include <ostream>
+#include <queue>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>   // std::move
 #include <vector>
 
@@ -87,6 +108,26 @@ class Channel
     // { LOG(warn) << "Destroying channel '" << fName << "'"; }
 
     struct ChannelConfigurationError : std::runtime_error { using std::runtime_error::runtime_error; };
+    /// A request (see Request()) could not be sent or timed out
+    struct RequestError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+    enum class ReplyStatus : int
+    {
+        ok,
+        timeout
+    };
+    /// Called with the reply to a request (without the correlation id frame), or with empty parts on timeout
+    using ReplyCallback = std::function<void(ReplyStatus status, Parts& reply)>;
+
+    enum class SendStatus : int
+    {
+        ok,
+        timeout,
+        dropped,
+        error
+    };
+    /// Called with the result of an asynchronous send (see SendAsync()) and the number of bytes that have been queued
+    using SendCallback = std::function<void(SendStatus status, int64_t bytes)>;
 
     Socket& GetSocket() const
     {
@@ -98,16 +139,23 @@ class Channel
     {
         fMethod = "bind";
         fAddress = address;
-        return fSocket->Bind(address);
+        return fSocket->Bind(address) && (!fLane || fLane->fSocket->Bind(LaneAddress(address)));
     }
 
     bool Connect(const std::string& address)
     {
         fMethod = "connect";
         fAddress = address;
-        return fSocket->Connect(address);
+        return fSocket->Connect(address) && (!fLane || fLane->fSocket->Connect(LaneAddress(address)));
     }
 
+    /// Lanes of a channel, see the priorityLane property
+    enum class Lane
+    {
+        normal,
+        priority
+    };
+
     /// Get channel name
     /// @return Returns full channel name (e.g. "data[0]")
     std::string GetName() const { return fName; }
@@ -179,6 +227,126 @@ class Channel
     /// @return Returns linger duration (in milliseconds)
     int GetLinger() const { return fLinger; }
 
+    /// Get receive mode ("block", "spin" or "hybrid")
+    /// @return Returns receive mode
+    std::string GetRcvMode() const { return fRcvMode; }
+
+    /// Get busy-poll budget of the hybrid receive mode (in microseconds)
+    /// @return Returns busy-poll budget (in microseconds)
+    int GetRcvSpinUs() const { return fRcvSpinUs; }
+
+    /// Get maximum number of single-part sends coalesced into one transfer
+    /// @return Returns send batch size (1: no batching)
+    int GetSndBatch() const { return fSndBatch; }
+
+    /// Get maximum time a batched send waits for the batch to fill up (in microseconds)
+    /// @return Returns send batch timeout (in microseconds)
+    int GetSndBatchTimeoutUs() const { return fSndBatchTimeoutUs; }
+
+    /// Get latency target of the adaptive send batching (in microseconds)
+    /// @return Returns batch latency target (in microseconds, 0: fixed batch size and timeout)
+    int GetBatchLatencyTargetUs() const { return fBatchLatencyTargetUs; }
+
+    /// Get wire format of the transfer meta data
+    /// @return Returns meta format ("default" or "compact")
+    std::string GetMetaFormat() const { return fMetaFormat; }
+
+    /// Get context group of the channel sockets (zeromq based transports)
+    /// @return Returns context group name (empty for the default context)
+    std::string GetContextGroup() const { return fContextGroup; }
+
+    /// Get maximum size of multipart parts that are packed into one frame (zeromq transport)
+    /// @return Returns maximum packed part size in bytes (0: no packing)
+    int GetPackParts() const { return fPackParts; }
+
+    /// Get payload compression codec (zeromq transport)
+    /// @return Returns codec ("none", "lz4" or "zstd")
+    std::string GetCompression() const { return fCompression; }
+
+    /// Get compression level
+    /// @return Returns compression level (0: codec default)
+    int GetCompressionLevel() const { return fCompressionLevel; }
+
+    /// Get number of threads compressing a message
+    /// @return Returns number of compression threads, including the sending/receiving thread
+    int GetCompressionThreads() const { return fCompressionThreads; }
+
+    /// Get minimum size of compressed payloads
+    /// @return Returns minimum compressed payload size in bytes
+    int GetCompressionMinSize() const { return fCompressionMinSize; }
+
+    /// Get size of the chunks that large parts are streamed in (zeromq transport)
+    /// @return Returns chunk size in bytes (0: parts are sent in one piece)
+    int GetChunkSize() const { return fChunkSize; }
+
+    /// Get maximum send rate of multicast (epgm://, pgm://, norm://) endpoints
+    /// @return Returns rate in kbit/s (0: libzmq default)
+    int GetMulticastRate() const { return fMulticastRate; }
+
+    /// Get how long multicast senders keep data for the retransmission to receivers that lost it
+    /// @return Returns recovery interval in ms (0: libzmq default)
+    int GetMulticastRecovery() const { return fMulticastRecovery; }
+
+    /// Get whether the trace context of the messages is transferred and send/receive events are traced
+    /// @return true if tracing is enabled
+    bool GetTrace() const { return fTrace; }
+
+    /// Get policy for messages that do not fit into the send queue ("block", "drop-new" or "drop-old")
+    /// @return overflow policy
+    std::string GetOverflow() const { return fOverflow; }
+
+    /// Get time after which messages are discarded by the receiver (in ms, 0: no deadlines)
+    /// @return deadline
+    int GetDeadline() const { return fDeadline; }
+
+    /// Get sampling policy of the sent messages ("all", "1/N", "rate:<Hz>" or "bytes:<B/s>")
+    /// @return sampling policy
+    std::string GetSample() const { return fSample; }
+
+    /// Get maximum send bandwidth (in MB/s, 0: unlimited)
+    /// @return maximum bandwidth
+    int GetMaxBandwidth() const { return fMaxBandwidth; }
+
+    /// Get size of the bandwidth token bucket (in MB, 0: 100 ms of the maximum bandwidth)
+    /// @return burst size
+    int GetBurst() const { return fBurst; }
+
+    /// Get checksum of the message payloads ("none", "crc32c" or "xxh3")
+    /// @return checksum
+    std::string GetChecksum() const { return fChecksum; }
+
+    /// Get whether the channel has a priority lane (a second socket for urgent messages)
+    /// @return true if the channel has a priority lane
+    bool GetPriorityLane() const { return fPriorityLane; }
+
+    /// Get whether the channel is multiplexed (subchannels connecting to the same address share one connection)
+    /// @return true if the channel is multiplexed
+    bool GetMux() const { return fMux; }
+
+    /// Get the routing id of the last message received on a multiplexed channel, the subchannel index it was sent on
+    /// @return routing id
+    uint32_t GetReceivedRoute() const { return fReceivedRoute; }
+
+    /// Get the routing policy of the channel for Device::Route() ("none" or "hash")
+    /// @return routing policy
+    std::string GetRoute() const { return fRoute; }
+
+    /// Get time after which an unresponsive peer is disconnected (in ms, 0: no liveness checks)
+    /// @return peer timeout
+    int GetPeerTimeout() const { return fPeerTimeout; }
+
+    /// Get whether the queue and kernel buffer sizes are tuned to the measured rate and round-trip time
+    /// @return true if auto-tuning is enabled
+    bool GetAutoTune() const { return fAutoTune; }
+
+    /// Get upper bound of the auto-tuned queue sizes
+    /// @return Returns maximum auto-tuned sndBufSize/rcvBufSize (in messages)
+    int GetAutoTuneMaxBufSize() const { return fAutoTuneMaxBufSize; }
+
+    /// Get upper bound of the auto-tuned kernel buffer sizes
+    /// @return Returns maximum auto-tuned sndKernelSize/rcvKernelSize (in bytes)
+    int GetAutoTuneMaxKernelSize() const { return fAutoTuneMaxKernelSize; }
+
     /// Get socket rate logging interval (in seconds)
     /// @return Returns socket rate logging interval (in seconds)
     int GetRateLogging() const { return fRateLogging; }
@@ -195,6 +363,25 @@ class Channel
     /// @return true/false, true if automatic binding is enabled
     bool GetAutoBind() const { return fAutoBind; }
 
+    /// Get strategy of the automatic binding ("random" or "ephemeral")
+    /// @return automatic binding strategy
+    std::string GetAutoBindStrategy() const { return fAutoBindStrategy; }
+
+    /// Get whether the channel is hybrid (shmem to the peers on this host, zeromq over tcp to the others)
+    /// @return true if the channel is hybrid
+    bool GetHybrid() const { return fHybrid; }
+
+    /// Get whether any thread may call Send() on the channel (see UpdateSharedSend())
+    /// @return true if the sends go through the shared sender thread of the channel
+    bool GetSharedSend() const { return fSharedSend; }
+
+    /// Get directory of the spill file (see UpdateSpillDir())
+    /// @return spill directory
+    std::string GetSpillDir() const { return fSpillDir; }
+    /// Get size of the spill file in MiB (see UpdateSpillDir())
+    /// @return spill size
+    int GetSpillSize() const { return fSpillSize; }
+
     /// @par Thread Safety
     /// * @e Distinct @e objects: Safe.@n
     /// * @e Shared @e objects: Unsafe.
@@ -203,6 +390,14 @@ class Channel
         return fSocket ? fSocket->GetNumberOfConnectedPeers() : 0;
     }
 
+    /// Number of messages queued between the channel socket and its peers (in both directions): counted for the inproc
+    /// transport and for shmem channels with meta header rings (--shm-meta-ring), estimated from the kernel socket
+    /// queues and the average message size otherwise (zeromq does not expose the depth of its pipes). Does not include
+    /// the send queue (GetNumQueuedSends()) and the spilled messages (GetNumSpilled()). Can be called from any thread.
+    /// @param exact if given, set to whether the depth is counted rather than estimated
+    /// @return queue depth, -1 if unknown (e.g. no socket)
+    int64_t GetQueueDepth(bool* exact = nullptr) const;
+
     /// Set channel name
     /// @param name Arbitrary channel name
     void UpdateName(const std::string& name) { fName = name; Invalidate(); }
@@ -251,6 +446,150 @@ class Channel
     /// @param duration linger duration (in milliseconds)
     void UpdateLinger(int duration) { fLinger = duration; Invalidate(); }
 
+    /// Set receive mode
+    /// @param rcvMode "block" (wait in the kernel), "spin" (busy-poll) or "hybrid" (busy-poll for rcvSpinUs, then block)
+    void UpdateRcvMode(const std::string& rcvMode) { fRcvMode = rcvMode; Invalidate(); }
+
+    /// Set busy-poll budget of the hybrid receive mode (in microseconds)
+    /// @param rcvSpinUs busy-poll budget (in microseconds)
+    void UpdateRcvSpinUs(int rcvSpinUs) { fRcvSpinUs = rcvSpinUs; Invalidate(); }
+
+    /// Set maximum number of single-part sends coalesced into one transfer
+    /// @param sndBatch send batch size (1: no batching)
+    void UpdateSndBatch(int sndBatch) { fSndBatch = sndBatch; Invalidate(); }
+
+    /// Set maximum time a batched send waits for the batch to fill up (in microseconds)
+    /// @param sndBatchTimeoutUs send batch timeout (in microseconds)
+    void UpdateSndBatchTimeoutUs(int sndBatchTimeoutUs) { fSndBatchTimeoutUs = sndBatchTimeoutUs; Invalidate(); }
+
+    /// Set latency target of the adaptive send batching (in microseconds): the batch size (up to sndBatch, if set) and
+    /// timeout follow the message rate, so that batched messages wait at most this long (see BatchController)
+    /// @param batchLatencyTargetUs batch latency target (in microseconds, 0: fixed batch size and timeout)
+    void UpdateBatchLatencyTargetUs(int batchLatencyTargetUs) { fBatchLatencyTargetUs = batchLatencyTargetUs; Invalidate(); }
+
+    /// Set wire format of the transfer meta data
+    /// @param metaFormat meta format ("default" or "compact")
+    void UpdateMetaFormat(const std::string& metaFormat) { fMetaFormat = metaFormat; Invalidate(); }
+
+    /// Set context group of the channel sockets (zeromq based transports)
+    /// @param contextGroup name of a group configured with --zmq-context-group (empty for the default context)
+    void UpdateContextGroup(const std::string& contextGroup) { fContextGroup = contextGroup; Invalidate(); }
+
+    /// Set maximum size of multipart parts that are packed into one frame (zeromq transport)
+    /// @param packParts maximum packed part size in bytes (0: no packing)
+    void UpdatePackParts(int packParts) { fPackParts = packParts; Invalidate(); }
+
+    /// Set payload compression codec (zeromq transport, on both peers)
+    /// @param compression codec ("none", "lz4" or "zstd")
+    void UpdateCompression(const std::string& compression) { fCompression = compression; Invalidate(); }
+
+    /// Set compression level
+    /// @param compressionLevel compression level (0: codec default, lz4: > 0 selects the high compression mode)
+    void UpdateCompressionLevel(int compressionLevel) { fCompressionLevel = compressionLevel; Invalidate(); }
+
+    /// Set number of threads compressing a message (its parts and 1 MiB blocks of large parts in parallel)
+    /// @param compressionThreads number of compression threads, including the sending/receiving thread
+    void UpdateCompressionThreads(int compressionThreads) { fCompressionThreads = compressionThreads; Invalidate(); }
+
+    /// Set minimum size of compressed payloads, smaller ones are sent as they are
+    /// @param compressionMinSize minimum compressed payload size in bytes
+    void UpdateCompressionMinSize(int compressionMinSize) { fCompressionMinSize = compressionMinSize; Invalidate(); }
+
+    /// Set size of the chunks that large parts are streamed in (zeromq transport, on both peers)
+    /// @param chunkSize chunk size in bytes (0: parts are sent in one piece)
+    void UpdateChunkSize(int chunkSize) { fChunkSize = chunkSize; Invalidate(); }
+
+    /// Set maximum send rate of multicast (epgm://, pgm://, norm://) endpoints
+    /// @param multicastRate rate in kbit/s (0: libzmq default)
+    void UpdateMulticastRate(int multicastRate) { fMulticastRate = multicastRate; Invalidate(); }
+
+    /// Set how long multicast senders keep data for the retransmission to receivers that lost it
+    /// @param multicastRecovery recovery interval in ms (0: libzmq default)
+    void UpdateMulticastRecovery(int multicastRecovery) { fMulticastRecovery = multicastRecovery; Invalidate(); }
+
+    /// Set whether the trace context of the messages is transferred and send/receive events are traced (see Tracer)
+    /// @param trace true to enable tracing (zeromq transport: on both peers)
+    void UpdateTrace(bool trace) { fTrace = trace; Invalidate(); if (fSocket) { InitTrace(); } }
+
+    /// Set policy for messages that do not fit into the send queue: "block" waits for the send timeout (default),
+    /// "drop-new" drops the message, "drop-old" keeps it in a backlog of up to sndBufSize messages in the channel,
+    /// dropping the oldest one if the backlog is full. The backlog is sent with the next send calls. "spill" writes the
+    /// message to a spill file (see UpdateSpillDir()) instead, releasing its memory.
+    /// Dropped messages count as sent (with 0 bytes for drop-new) and are counted by GetMessagesDropped().
+    /// @param overflow overflow policy
+    void UpdateOverflow(const std::string& overflow) { fOverflow = overflow; Invalidate(); InitOverflow(); }
+
+    /// Set time after which messages are discarded at receive (in ms, 0: no deadlines). With deadlines, every message
+    /// is sent with a frame carrying its deadline (Message::GetDeadline() of the first part, otherwise now + deadline),
+    /// so the peer has to set the property too. Expired messages are counted by GetMessagesExpired().
+    /// @param deadline deadline
+    void UpdateDeadline(int deadline) { fDeadline = deadline; Invalidate(); InitOverflow(); }
+
+    /// Set sampling policy of the sent messages, e.g. for monitoring/QC outputs that only need a fraction of the data:
+    /// "all" sends every message (default), "1/N" every N-th one (starting with the first), "rate:<Hz>" at most the given
+    /// number of messages per second, "bytes:<B/s>" at most the given number of bytes per second (averaged over a second).
+    /// The decision is taken at the start of Send()/SendCopy(), before anything is copied, compressed or sent. Messages
+    /// that are not sampled are released (SendCopy() does not copy them) and count as sent with 0 bytes, they are
+    /// counted by GetMessagesSampledOut().
+    /// @param sample sampling policy
+    void UpdateSample(const std::string& sample) { fSample = sample; Invalidate(); InitSample(); }
+
+    /// Set maximum send bandwidth in MB/s (10^6 bytes), e.g. to share a WAN link predictably between senders.
+    /// Sends take the message size from a token bucket that refills at this rate and holds up to the burst size
+    /// (UpdateBurst()); a send waits until the bucket holds the message (or the burst size, if the message is larger),
+    /// for at most the send timeout, so that with timeout 0 (e.g. SendAsync()) the message is deferred. Sends that time
+    /// out return TransferCode::timeout and keep the message. The waits are counted by GetSendsShaped() and
+    /// GetShapingWaitNs(), the wait is not interrupted by state changes.
+    /// @param maxBandwidth maximum bandwidth in MB/s, 0: unlimited (default)
+    void UpdateMaxBandwidth(int maxBandwidth) { fMaxBandwidth = maxBandwidth; Invalidate(); InitShaping(); }
+
+    /// Set size of the bandwidth token bucket in MB (10^6 bytes), the number of bytes that may be sent back-to-back
+    /// after the channel was idle (see UpdateMaxBandwidth())
+    /// @param burst burst size in MB, 0: 100 ms of the maximum bandwidth (default)
+    void UpdateBurst(int burst) { fBurst = burst; Invalidate(); InitShaping(); }
+
+    /// Set checksum of the message payloads: "crc32c" (with the CRC instructions of the CPU, if available) or "xxh3".
+    /// Every message is sent with a trailing frame carrying the checksums of its parts, which the receiver verifies, so
+    /// the peer has to set the property too. Messages with a mismatching checksum are discarded (the receive fails) and
+    /// counted by GetMessagesCorrupt().
+    /// @param checksum "none" (default), "crc32c" or "xxh3"
+    void UpdateChecksum(const std::string& checksum) { fChecksum = checksum; Invalidate(); }
+
+    /// Set whether the channel has a priority lane: a second socket of the same type, bound/connected to the address
+    /// derived with LaneAddress(), for messages sent with Lane::priority. Receives take messages from it first.
+    /// @param priorityLane true to add the priority lane (push/pull/pair/pub/sub channels)
+    void UpdatePriorityLane(bool priorityLane) { fPriorityLane = priorityLane; Invalidate(); }
+
+    /// Set whether the channel is multiplexed: the connecting subchannels of a device with the same address share one
+    /// socket, and every message carries the index of the subchannel it was sent on as routing id (see GetReceivedRoute())
+    /// @param mux true to multiplex the channel (push/pull/pair/pub/sub/dealer channels)
+    void UpdateMux(bool mux) { fMux = mux; Invalidate(); }
+
+    /// Set the routing policy of the channel: with "hash" Device::Route() sends every message to the subchannel its key
+    /// is mapped to by consistent hashing (see HashRing), "none" (default) disables routing
+    /// @param route routing policy
+    void UpdateRoute(const std::string& route) { fRoute = route; Invalidate(); }
+
+    /// Set time after which an unresponsive peer is disconnected (in ms, 0: no liveness checks). With a peer timeout,
+    /// the connections exchange heartbeats and messages are only queued to connected peers: a peer that dies or hangs
+    /// leaves the round-robin of a push/dealer channel within the timeout, instead of collecting messages until its
+    /// queue is full (zeromq and shmem transports)
+    /// @param timeout peer timeout
+    void UpdatePeerTimeout(int timeout) { fPeerTimeout = timeout; Invalidate(); }
+
+    /// Set whether the queue and kernel buffer sizes are tuned while RUNNING (see ChannelTuner), the configured sizes
+    /// are the lower bounds
+    /// @param autoTune true to enable auto-tuning
+    void UpdateAutoTune(bool autoTune) { fAutoTune = autoTune; Invalidate(); }
+
+    /// Set upper bound of the auto-tuned queue sizes
+    /// @param autoTuneMaxBufSize maximum auto-tuned sndBufSize/rcvBufSize (in messages)
+    void UpdateAutoTuneMaxBufSize(int autoTuneMaxBufSize) { fAutoTuneMaxBufSize = autoTuneMaxBufSize; Invalidate(); }
+
+    /// Set upper bound of the auto-tuned kernel buffer sizes
+    /// @param autoTuneMaxKernelSize maximum auto-tuned sndKernelSize/rcvKernelSize (in bytes)
+    void UpdateAutoTuneMaxKernelSize(int autoTuneMaxKernelSize) { fAutoTuneMaxKernelSize = autoTuneMaxKernelSize; Invalidate(); }
+
     /// Set socket rate logging interval (in seconds)
     /// @param rateLogging Socket rate logging interval (in seconds)
     void UpdateRateLogging(int rateLogging) { fRateLogging = rateLogging; Invalidate(); }
@@ -267,6 +606,39 @@ class Channel
     /// @param autobind true/false, true to enable automatic binding
     void UpdateAutoBind(bool autobind) { fAutoBind = autobind; Invalidate(); }
 
+    /// Set strategy of the automatic binding: "random" tries random ports in [portRangeMin, portRangeMax] until one is
+    /// free, "ephemeral" binds once to a port chosen by the kernel (zeromq and shmem transports, others use "random")
+    /// @param strategy "random" (default) or "ephemeral"
+    void UpdateAutoBindStrategy(const std::string& strategy) { fAutoBindStrategy = strategy; Invalidate(); }
+
+    /// Set whether the channel is hybrid: a shmem channel that serves the peers on the same host with the shmem transport
+    /// and the others with the zeromq transport over tcp (see HybridSocket), local peers have to be in the same session
+    /// @param hybrid true to make the channel hybrid (shmem transport, push/pull/pair/pub/sub, tcp addresses)
+    void UpdateHybrid(bool hybrid) { fHybrid = hybrid; Invalidate(); }
+
+    /// Set whether any thread may call Send() on the channel: the messages are queued (up to sndBufSize of them) for a
+    /// sender thread of the channel, the only one that uses the socket. Send() returns once the message is queued, the
+    /// messages of one thread keep their order. Messages the sender thread cannot send are counted as dropped.
+    /// Other calls (SendAsync(), SendCopy(), receiving) stay single-threaded.
+    /// @param sharedSend true for a shared send path (push and pub channels)
+    void UpdateSharedSend(bool sharedSend) { fSharedSend = sharedSend; Invalidate(); }
+
+    /// Set directory of the spill file of the overflow policy "spill" (local storage, e.g. NVMe), created at Init()
+    /// and removed with the channel. Messages that do not fit into the send queue are copied to the file (through
+    /// O_DIRECT, written by a thread of the channel) and release their transport memory, so that a short stall of the
+    /// peer neither blocks the sender nor exhausts its shared memory. They are read back into new messages and sent in
+    /// order once the queue accepts them again: by the next send calls, and by DispatchSends() (called by the device
+    /// event loop) while no messages are sent. Messages that do not fit into the file are dropped.
+    /// @param spillDir directory of the spill file
+    void UpdateSpillDir(const std::string& spillDir) { fSpillDir = spillDir; Invalidate(); }
+    /// Set size of the spill file in MiB (see UpdateSpillDir())
+    /// @param spillSize spill size
+    void UpdateSpillSize(int spillSize) { fSpillSize = spillSize; Invalidate(); }
+
+    /// Set the transport of the remote peers of a hybrid channel (zeromq), done by the device for the configured channels
+    /// @param factory transport factory
+    void UpdateRemoteTransport(std::shared_ptr<TransportFactory> factory) { fRemoteTransportFactory = std::move(factory); }
+
     /// Checks if the configured channel settings are valid (checks the validity parameter, without running full validation (as oposed to ValidateChannel()))
     /// @return true if channel settings are valid, false otherwise.
     bool IsValid() const { return fValid; }
@@ -294,18 +666,47 @@ class Channel
     /// TransferCode::timeout if timed out,
     /// TransferCode::error if there was an error,
     /// TransferCode::interrupted if interrupted (e.g. by requested state change)
+    /// @par Thread Safety
+    /// Safe from several threads on channels with the sharedSend property (see UpdateSharedSend()), unsafe otherwise.
     template<typename M, typename... Timeout>
     std::enable_if_t<is_transferrable<M>::value, int64_t>
     Send(M& m, Timeout&&... sndTimeoutMs)
     {
         static_assert(sizeof...(sndTimeoutMs) <= 1, "Send called with too many arguments");
 
-        CheckSendCompatibility(m);
+        if (fSampleState && !fSampleState->Take(TotalSize(m))) {
+            m = M();
+            return 0;
+        }
         int t = fSndTimeoutMs;
         if constexpr (sizeof...(sndTimeoutMs) == 1) {
             t = {sndTimeoutMs...};
         }
-        return fSocket->Send(m, t);
+        return SendSampled(m, t);
+    }
+
+    /// Send message(s) on a lane of the channel. Messages sent on the priority lane do not queue behind the ones of the
+    /// normal lane and are received first. The order is kept only within a lane.
+    /// Without a priority lane (see UpdatePriorityLane()) all messages are sent on the channel socket.
+    /// @param m reference to MessagePtr/Parts/vector<MessagePtr>
+    /// @param lane Lane::normal or Lane::priority
+    /// @param sndTimeoutMs send timeout in ms (see Send). If not provided, default timeout will be taken.
+    /// @return as Send()
+    template<typename M>
+    std::enable_if_t<is_transferrable<M>::value, int64_t>
+    Send(M& m, Lane lane, int sndTimeoutMs)
+    {
+        if (lane == Lane::priority && fLane) {
+            return fLane->Send(m, sndTimeoutMs);
+        }
+        return Send(m, sndTimeoutMs);
+    }
+
+    template<typename M>
+    std::enable_if_t<is_transferrable<M>::value, int64_t>
+    Send(M& m, Lane lane)
+    {
+        return Send(m, lane, fSndTimeoutMs);
     }
 
     /// Receive message(s) from the socket queue.
@@ -329,13 +730,206 @@ class Channel
         if constexpr (sizeof...(rcvTimeoutMs) == 1) {
             t = {rcvTimeoutMs...};
         }
-        return fSocket->Receive(m, t);
+        const size_t numParts = fFlightRecorder ? NumParts(m) : 0; // received parts are appended
+        int64_t result = Timed(false, [&]() { return fChecksumState ? ReceiveChecksummed(m, t) : fMux ? ReceiveMuxed(m, t) : ReceiveSocket(m, t); });
+        if ((fRcvTarget || fRcvPool) && result >= 0 && !MoveToReceiveTarget(m)) {
+            return static_cast<int64_t>(TransferCode::error);
+        }
+        if (fTrace && result >= 0) {
+            TraceReceive(LastPart(m));
+        }
+        if (fFlightRecorder && result >= 0) {
+            RecordFlight(false, m, numParts);
+        }
+        return result;
+    }
+
+    /// Deliver received messages as messages of another transport, e.g. to receive data from a zeromq tcp channel into
+    /// shmem, where local consumers can use it without copying. The payload is placed into a message of the target
+    /// within the receive call and the buffer of the channel transport is released right away. libzmq offers no hook to
+    /// allocate received payloads, so this is the one copy that remains (it replaces the copy otherwise done by the user).
+    /// Not copied with the channel configuration.
+    /// @param target transport to create the received messages with, nullptr to receive messages of the channel transport
+    /// Chunked transfers (see UpdateChunkSize) are assembled directly in messages of the target.
+    void SetReceiveTarget(std::shared_ptr<TransportFactory> target)
+    {
+        fRcvTarget = std::move(target);
+        fRcvPool = nullptr;
+        if (fSocket) {
+            fSocket->SetChunkTarget(fRcvTarget.get());
+        }
+    }
+    /// Deliver received messages in slots of a region pool (see SetReceiveTarget(std::shared_ptr<TransportFactory>)).
+    /// Messages larger than its slots, or that find no free slot within timeoutMs (-1: wait forever),
+    /// are created with the transport of the pool instead.
+    /// @param pool region pool, has to outlive the channel (or be reset with SetReceiveTarget(nullptr))
+    void SetReceiveTarget(RegionPool& pool, int timeoutMs = 0) { SetReceiveTarget(nullptr); fRcvPool = &pool; fRcvPoolTimeoutMs = timeoutMs; }
+
+    /// Call the callback for every chunk of a chunked transfer (see UpdateChunkSize) that has been placed in its part,
+    /// from within the receive call, e.g. to start processing the beginning of a large part while the rest arrives.
+    /// Not copied with the channel configuration.
+    /// @param callback callback (empty: none)
+    void SetChunkCallback(ChunkCallback callback)
+    {
+        fChunkCallback = std::move(callback);
+        if (fSocket) {
+            fSocket->SetChunkCallback(fChunkCallback);
+        }
+    }
+
+    /// Send a copy of the message(s) (see Message::Copy) to the socket queue, the original remains valid,
+    /// e.g. to send the same data on several channels. Transports that support it (zeromq) queue a reference
+    /// to the shared payload without creating a message object per copy.
+    /// @param m message/parts to send
+    /// @param sndTimeoutMs send timeout in ms (see Send). If not provided, default timeout will be taken.
+    /// @return as Send()
+    int64_t SendCopy(const MessagePtr& msg, int sndTimeoutMs) { return SendCopy(&msg, 1, sndTimeoutMs); }
+    int64_t SendCopy(const MessagePtr& msg) { return SendCopy(&msg, 1, fSndTimeoutMs); }
+    int64_t SendCopy(const Parts& parts, int sndTimeoutMs) { return SendCopy(parts.fParts.data(), parts.Size(), sndTimeoutMs); }
+    int64_t SendCopy(const Parts& parts) { return SendCopy(parts.fParts.data(), parts.Size(), fSndTimeoutMs); }
+
+    /// Forward the next (single or multipart) message from this channel to out.
+    /// Between two channels of the zeromq or (plain, without meta rings and send batching) shmem transport
+    /// the message frames are moved as they are, without creating message objects or touching the allocator.
+    /// @param out output channel
+    /// @param rcvTimeoutMs timeout for receiving the message in ms (see Receive). If not provided, default timeout will be taken.
+    /// @return Number of bytes that have been forwarded,
+    /// TransferCode::timeout/error/interrupted if no message could be forwarded
+    int64_t Forward(Channel& out, int rcvTimeoutMs);
+    int64_t Forward(Channel& out) { return Forward(out, fRcvTimeoutMs); }
+
+    /// Receive up to max single-part messages: waits for the first one, then drains the already queued ones without blocking.
+    /// @param msgs vector the received messages are appended to
+    /// @param max maximum number of messages to receive
+    /// @param rcvTimeoutMs timeout for the first message in ms (see Receive). If not provided, default timeout will be taken.
+    /// @return Number of bytes that have been received,
+    /// TransferCode::timeout/error/interrupted if no message could be received
+    int64_t ReceiveBatch(std::vector<MessagePtr>& msgs, size_t max, int rcvTimeoutMs);
+    int64_t ReceiveBatch(std::vector<MessagePtr>& msgs, size_t max) { return ReceiveBatch(msgs, max, fRcvTimeoutMs); }
+
+    /// Send a request without waiting for its reply, any number of requests can be outstanding. The request is preceded by
+    /// a frame with a correlation id, which the server sends back in front of its reply (see TakeEnvelope() and Reply()).
+    /// Replies are matched by DispatchReplies() (or by Device::OnReplies()), which call the callback, in any order.
+    /// The client channel is a dealer (servers: router) or a pair. Requests and dispatching use the channel socket,
+    /// so they have to be done by the thread using the channel.
+    /// @param request request to send
+    /// @param callback called with the reply, or with ReplyStatus::timeout after timeoutMs (-1: never)
+    /// @param timeoutMs time to wait for the reply in ms. Expired requests are detected when replies are dispatched.
+    /// @return as Send(), the callback is only called for requests that have been sent
+    int64_t Request(Parts& request, ReplyCallback callback, int timeoutMs = -1);
+    int64_t Request(MessagePtr& request, ReplyCallback callback, int timeoutMs = -1)
+    {
+        Parts parts(std::move(request));
+        int64_t result = Request(parts, std::move(callback), timeoutMs);
+        if (result < 0) {
+            request = std::move(parts.fParts.front());
+        }
+        return result;
+    }
+    /// Send a request (see Request(Parts&, ReplyCallback, int)), the future gets the reply once it has been dispatched
+    /// @return future of the reply, throws RequestError if the request could not be sent or timed out
+    std::future<Parts> Request(Parts& request, int timeoutMs = -1);
+    /// Receive the replies to the outstanding requests and call their callbacks, expire timed out requests
+    /// @param timeoutMs time to wait for the first reply in ms (at most until the next request expires), -1: until one arrives
+    /// @return number of completed (replied or expired) requests, TransferCode::error/interrupted on failure
+    int DispatchReplies(int timeoutMs = 0);
+    /// Match a received reply (with its correlation id frame) to its request and call the callback, expire timed out requests
+    /// @return number of completed requests, replies to unknown (e.g. expired) requests are ignored
+    int HandleReply(Parts& reply);
+    /// @return number of requests waiting for their reply
+    size_t GetNumPendingRequests() const { return fRpc ? fRpc->fPending.size() : 0; }
+
+    /// Server side of Request(): remove the routing frames (the peer identity of router channels) and the correlation id
+    /// from the front of a received request
+    /// @return the removed frames, to be sent in front of the reply with Reply()
+    Parts TakeEnvelope(Parts& request);
+    /// Send a reply, preceded by the envelope of its request (see TakeEnvelope())
+    /// @return as Send()
+    int64_t Reply(Parts& envelope, Parts& reply, int sndTimeoutMs);
+    int64_t Reply(Parts& envelope, Parts& reply) { return Reply(envelope, reply, fSndTimeoutMs); }
+
+    /// Send message(s) without blocking: if the socket queue is full, the message is kept in a send queue of the channel
+    /// (of up to sndBufSize messages) and sent by DispatchSends() (or by the device event loop, see Device::DispatchSends())
+    /// once the socket accepts it, so that a slow peer does not stall the sends on other channels.
+    /// The message is always taken. The callback is called once: right away if the message could be sent (or is dropped
+    /// because the send queue is full), otherwise when it is sent or after timeoutMs. Messages are sent in order.
+    /// Sends and dispatching use the channel socket, so they have to be done by the thread using the channel.
+    /// @param m message/parts to send
+    /// @param callback called with the result (SendStatus::ok with the number of bytes, or timeout/dropped/error)
+    /// @param timeoutMs time the message may wait in the send queue in ms (-1: no limit)
+    void SendAsync(MessagePtr& m, SendCallback callback, int timeoutMs = -1);
+    void SendAsync(Parts& m, SendCallback callback, int timeoutMs = -1);
+    /// Send the messages of the send queue (see SendAsync()) that the socket accepts and call their callbacks,
+    /// expire timed out messages. Also sends the spilled messages that the socket accepts (see UpdateSpillDir())
+    /// @param timeoutMs time to wait for the socket to accept the first message in ms (at most until the next one expires)
+    /// @return number of completed (sent, expired or failed) messages
+    int DispatchSends(int timeoutMs = 0);
+    /// @return number of messages waiting in the send queue (see SendAsync())
+    size_t GetNumQueuedSends() const { return fSendQueue ? fSendQueue->fQueued.size() : 0; }
+    /// @return number of messages waiting in the spill file or read back from it (see UpdateSpillDir())
+    size_t GetNumSpilled() const
+    {
+        return fOverflowState && fOverflowState->fSpill ? fOverflowState->fSpill->GetNumSpilled() + fOverflowState->fBacklog.size() : 0;
+    }
+
+    unsigned long GetBytesTx() const { return fSocket->GetBytesTx() + (fLane ? fLane->GetBytesTx() : 0); }
+    unsigned long GetBytesRx() const { return fSocket->GetBytesRx() + (fLane ? fLane->GetBytesRx() : 0); }
+    unsigned long GetMessagesTx() const { return fSocket->GetMessagesTx() + (fLane ? fLane->GetMessagesTx() : 0); }
+    unsigned long GetMessagesRx() const { return fSocket->GetMessagesRx() + (fLane ? fLane->GetMessagesRx() : 0); }
+    unsigned long GetRcvSpinTime() const { return fSocket->GetRcvSpinTime(); }
+    /// @return number of messages dropped by the overflow policy (see UpdateOverflow) or not sent by the shared sender
+    /// (see UpdateSharedSend), can be called from any thread
+    uint64_t GetMessagesDropped() const
+    {
+        return (fOverflowState ? fOverflowState->fDropped.load(std::memory_order_relaxed) : 0) + (fSharedSender ? fSharedSender->GetNumFailed() : 0) + (fLane ? fLane->GetMessagesDropped() : 0);
+    }
+    /// @return number of received messages discarded after their deadline (see UpdateDeadline), can be called from any thread
+    uint64_t GetMessagesExpired() const { return (fOverflowState ? fOverflowState->fExpired.load(std::memory_order_relaxed) : 0) + (fLane ? fLane->GetMessagesExpired() : 0); }
+
+    /// @return number of messages not sent by the sampling policy (see UpdateSample), can be called from any thread
+    uint64_t GetMessagesSampledOut() const { return fSampleState ? fSampleState->fSampledOut.load(std::memory_order_relaxed) : 0; }
+
+    /// @return number of sends that waited for the bandwidth limit (see UpdateMaxBandwidth), can be called from any thread
+    uint64_t GetSendsShaped() const { return fShapingState ? fShapingState->fShaped.load(std::memory_order_relaxed) : 0; }
+    /// @return total time sends waited for the bandwidth limit in ns, can be called from any thread
+    uint64_t GetShapingWaitNs() const { return fShapingState ? fShapingState->fWaitNs.load(std::memory_order_relaxed) : 0; }
+
+    /// @return number of received messages discarded for a checksum mismatch (see UpdateChecksum), can be called from any thread
+    uint64_t GetMessagesCorrupt() const { return (fChecksumState ? fChecksumState->fCorrupt.load(std::memory_order_relaxed) : 0) + (fLane ? fLane->GetMessagesCorrupt() : 0); }
+
+    /// Enable/disable recording of the send/receive call metrics (call counts, blocking time, latency histograms).
+    /// Enabling resets them. Disabled by default, devices enable it on all channels with --channel-metrics.
+    /// @param perfCounters also count cycles, instructions, LLC and branch misses of the data callbacks (--perf-counters)
+    void EnableMetrics(bool enable, bool perfCounters = false)
+    {
+        fMetrics = enable ? std::make_shared<ChannelMetricsRecorder>(perfCounters) : nullptr;
+        if (fLane) {
+            fLane->fMetrics = fMetrics;
+        }
     }
+    bool MetricsEnabled() const { return fMetrics != nullptr; }
 
-    unsigned long GetBytesTx() const { return fSocket->GetBytesTx(); }
-    unsigned long GetBytesRx() const { return fSocket->GetBytesRx(); }
-    unsigned long GetMessagesTx() const { return fSocket->GetMessagesTx(); }
-    unsigned long GetMessagesRx() const { return fSocket->GetMessagesRx(); }
+    /// Record copies of the sent and received messages in a flight recorder (see FlightRecorder), devices tap their
+    /// channels with --flight-recorder. Not copied with the channel configuration.
+    /// @param recorder recorder shared by the tapped channels, nullptr to stop recording
+    void SetFlightRecorder(std::shared_ptr<FlightRecorder> recorder)
+    {
+        fFlightRecorder = std::move(recorder);
+        if (fFlightRecorder) {
+            fFlightChannel = fFlightRecorder->RegisterChannel(fName);
+        }
+        if (fLane) {
+            fLane->fFlightRecorder = fFlightRecorder;
+            fLane->fFlightChannel = fFlightChannel;
+        }
+    }
+    /// @return snapshot of the transfer counters and (if enabled) call metrics, can be called from any thread
+    ChannelMetrics GetMetrics() const;
+
+    /// Name of the first enabled feature that needs the generic transfer path of Send()/Receive() (checksum, mux,
+    /// overflow policy/deadline, trace, flight recording, receive target, auto-tuning, hybrid socket), see TypedChannel
+    /// @return empty if the transfers can go straight to the socket
+    std::string GenericPathFeature() const;
 
     auto Transport() -> TransportFactory* { return fTransportFactory.get(); };
 
@@ -345,6 +939,12 @@ class Channel
         return Transport()->CreateMessage(std::forward<Args>(args)...);
     }
 
+    template<typename... Args>
+    Parts NewMessages(Args&&... args)
+    {
+        return Transport()->CreateMessages(std::forward<Args>(args)...);
+    }
+
     template<typename T>
     MessagePtr NewSimpleMessage(const T& data)
     {
@@ -357,6 +957,12 @@ class Channel
         return Transport()->NewStaticMessage(data);
     }
 
+    template<typename T, typename... Args>
+    MessagePtr NewTypedMessage(Args&&... args)
+    {
+        return Transport()->template NewTypedMessage<T>(std::forward<Args>(args)...);
+    }
+
     template<typename... Args>
     UnmanagedRegionPtr NewUnmanagedRegion(Args&&... args)
     {
@@ -376,10 +982,44 @@ class Channel
     static constexpr int DefaultSndTimeoutMs = -1;
     static constexpr int DefaultRcvTimeoutMs = -1;
     static constexpr int DefaultLinger = 500;
+    static constexpr const char* DefaultRcvMode = "block";
+    static constexpr int DefaultRcvSpinUs = 50;
+    static constexpr int DefaultSndBatch = 1;
+    static constexpr int DefaultSndBatchTimeoutUs = 100;
+    static constexpr int DefaultBatchLatencyTargetUs = 0;
+    static constexpr const char* DefaultMetaFormat = "default";
+    static constexpr const char* DefaultContextGroup = "";
+    static constexpr int DefaultPackParts = 0;
+    static constexpr const char* DefaultCompression = "none";
+    static constexpr int DefaultCompressionLevel = 0;
+    static constexpr int DefaultCompressionThreads = 1;
+    static constexpr int DefaultCompressionMinSize = 4096;
+    static constexpr int DefaultChunkSize = 0;
+    static constexpr int DefaultMulticastRate = 0;
+    static constexpr int DefaultMulticastRecovery = 0;
+    static constexpr bool DefaultTrace = false;
+    static constexpr const char* DefaultOverflow = "block";
+    static constexpr int DefaultDeadline = 0;
+    static constexpr const char* DefaultSample = "all";
+    static constexpr int DefaultMaxBandwidth = 0;
+    static constexpr int DefaultBurst = 0;
+    static constexpr const char* DefaultChecksum = "none";
+    static constexpr bool DefaultPriorityLane = false;
+    static constexpr bool DefaultMux = false;
+    static constexpr const char* DefaultRoute = "none";
+    static constexpr int DefaultPeerTimeout = 0;
+    static constexpr bool DefaultAutoTune = false;
+    static constexpr int DefaultAutoTuneMaxBufSize = 100000;
+    static constexpr int DefaultAutoTuneMaxKernelSize = 64 << 20;
     static constexpr int DefaultRateLogging = 1;
     static constexpr int DefaultPortRangeMin = 22000;
     static constexpr int DefaultPortRangeMax = 23000;
     static constexpr bool DefaultAutoBind = true;
+    static constexpr const char* DefaultAutoBindStrategy = "random";
+    static constexpr bool DefaultHybrid = false;
+    static constexpr bool DefaultSharedSend = false;
+    static constexpr const char* DefaultSpillDir = "";
+    static constexpr int DefaultSpillSize = 1024;
 
     friend std::ostream& operator<<(std::ostream& os, const Channel& ch)
     {
@@ -392,7 +1032,7 @@ class Channel
   private:
     std::shared_ptr<TransportFactory> fTransportFactory;
     mq::Transport fTransportType;
-    std::unique_ptr<Socket> fSocket;
+    std::shared_ptr<Socket> fSocket; // shared by the subchannels of a multiplexed connection
 
     std::string fName;
     std::string fType;
@@ -405,54 +1045,519 @@ class Channel
     int fSndTimeoutMs;
     int fRcvTimeoutMs;
     int fLinger;
+    std::string fRcvMode;
+    int fRcvSpinUs;
+    int fSndBatch;
+    int fSndBatchTimeoutUs;
+    int fBatchLatencyTargetUs;
+    std::string fMetaFormat;
+    std::string fContextGroup;
+    int fPackParts;
+    std::string fCompression;
+    int fCompressionLevel;
+    int fCompressionThreads;
+    int fCompressionMinSize;
+    int fChunkSize;
+    int fMulticastRate;
+    int fMulticastRecovery;
+    bool fTrace;
+    std::string fOverflow;
+    int fDeadline;
+    std::string fSample;
+    int fMaxBandwidth;
+    int fBurst;
+    std::string fChecksum;
+    bool fPriorityLane;
+    bool fMux;
+    std::string fRoute;
+    int fPeerTimeout;
+    bool fAutoTune;
+    int fAutoTuneMaxBufSize;
+    int fAutoTuneMaxKernelSize;
     int fRateLogging;
     int fPortRangeMin;
     int fPortRangeMax;
     bool fAutoBind;
+    std::string fAutoBindStrategy;
+    bool fHybrid;
+    bool fSharedSend;
+    std::string fSpillDir;
+    int fSpillSize;
+    std::shared_ptr<TransportFactory> fRemoteTransportFactory;
 
     bool fValid;
 
     bool fMultipart;
 
-    void CheckSendCompatibility(MessagePtr& msg)
+    std::shared_ptr<ChannelMetricsRecorder> fMetrics; // not copied with the configuration
+    std::shared_ptr<FlightRecorder> fFlightRecorder; // not copied with the configuration
+    uint32_t fFlightChannel = 0; // id of the channel name in the flight recorder
+    std::shared_ptr<TransportFactory> fRcvTarget; // not copied with the configuration
+    RegionPool* fRcvPool = nullptr; // not copied with the configuration
+    int fRcvPoolTimeoutMs = 0;
+    ChunkCallback fChunkCallback; // not copied with the configuration
+    std::unique_ptr<ChannelTuner> fTuner; // created in Init() for auto-tuned channels, sampled by the device
+    uint32_t fTraceChannel; // id of the channel name in the trace events
+
+    // overflow policy and deadlines, exists if either is configured
+    struct OverflowState
     {
-        if (fTransportType != msg->GetType()) {
-            if (msg->GetSize() > 0) {
-                MessagePtr msgWrapper(NewMessage(
-                    msg->GetData(),
-                    msg->GetSize(),
-                    [](void* /*data*/, void* _msg) { delete static_cast<Message*>(_msg); },
-                    msg.get()
-                ));
-                msg.release();
-                msg = move(msgWrapper);
-            } else {
-                MessagePtr newMsg(NewMessage());
-                msg = move(newMsg);
+        enum class Policy { block, dropNew, dropOld, spill } fPolicy = Policy::block;
+        std::deque<std::pair<Parts, bool>> fBacklog; // drop-old, spill: messages (single part or not) waiting for the queue
+        std::unique_ptr<SpillBuffer> fSpill; // spill: created in Init()
+        std::atomic<uint64_t> fDropped{0};
+        std::atomic<uint64_t> fExpired{0};
+    };
+    std::unique_ptr<OverflowState> fOverflowState;
+
+    // sampling of the sent messages, exists if configured
+    struct SampleState
+    {
+        enum class Policy { every, rate, bytes } fPolicy = Policy::every;
+        uint64_t fEvery = 1;
+        double fRate = 0; // rate, bytes: per second, also the capacity of the token bucket
+        std::atomic<uint64_t> fCount{0}; // every: messages seen
+        std::mutex fMtx; // rate, bytes: guards the bucket (sharedSend channels send from several threads)
+        double fTokens = 0;
+        std::chrono::steady_clock::time_point fRefill;
+        std::atomic<uint64_t> fSampledOut{0};
+
+        /// @return whether a message of the given size is sampled, counts it otherwise
+        bool Take(size_t size);
+    };
+    std::unique_ptr<SampleState> fSampleState;
+    // parses a sampling policy into state (if given), returns false if it is invalid
+    static bool ParseSample(const std::string& sample, SampleState* state);
+
+    // bandwidth limit, exists if configured. Used on the sending thread only (the sender thread with sharedSend)
+    struct ShapingState
+    {
+        double fRate = 0;  // bytes per second
+        double fBurst = 0; // bytes, capacity of the token bucket
+        double fTokens = 0;
+        std::chrono::steady_clock::time_point fRefill;
+        std::atomic<uint64_t> fShaped{0};
+        std::atomic<uint64_t> fWaitNs{0};
+    };
+    std::unique_ptr<ShapingState> fShapingState;
+    void InitShaping();
+    // takes size bytes from the token bucket, waiting at most timeout ms (-1: as long as needed) for them
+    // @return false if the bucket does not refill in time
+    bool Shape(size_t size, int timeout);
+
+    // payload checksums, exists if configured
+    struct ChecksumState
+    {
+        tools::ChecksumType fType;
+        std::atomic<uint64_t> fCorrupt{0};
+    };
+    std::unique_ptr<ChecksumState> fChecksumState;
+    void InitChecksum();
+    // the checksums travel as a frame behind the message: a uint64 tag with the checksum type, then one uint64 per part
+    void AddChecksums(Parts& parts);
+    /// @param single the message is received into a MessagePtr
+    /// @return size of the removed checksum frame, or TransferCode::error for a missing frame, a mismatch or (single) more parts
+    int64_t VerifyChecksums(Parts& parts, bool single);
+    template<typename M>
+    int64_t SendChecksummed(M& m, int timeout)
+    {
+        Parts parts;
+        TakeParts(m, parts);
+        AddChecksums(parts);
+        const auto frameSize = static_cast<int64_t>(parts.fParts.back()->GetSize());
+        int64_t result = fMux ? SendMuxed(parts, timeout) : fOverflowState ? SendGuarded(parts, timeout) : fSocket->Send(parts.fParts, timeout);
+        if (parts.Empty()) {
+            // kept in the backlog
+            ReplaceTaken(m);
+        } else {
+            parts.fParts.pop_back();
+            GiveBack(parts, m);
+        }
+        if (result >= frameSize) {
+            result -= frameSize;
+        }
+        return result;
+    }
+    template<typename M>
+    int64_t ReceiveChecksummed(M& m, int timeout)
+    {
+        Parts parts;
+        int64_t result = fMux ? ReceiveMuxed(parts, timeout) : ReceiveSocket(parts, timeout);
+        if (result < 0) {
+            return result;
+        }
+        const int64_t frameSize = VerifyChecksums(parts, std::is_same_v<M, MessagePtr>);
+        if (frameSize < 0) {
+            return frameSize;
+        }
+        GiveBack(parts, m);
+        return result - frameSize;
+    }
+
+    // outstanding requests (see Request()), created with the first one
+    struct RpcState
+    {
+        struct Pending
+        {
+            ReplyCallback fCallback;
+            std::chrono::steady_clock::time_point fDeadline;
+        };
+        using Deadline = std::pair<std::chrono::steady_clock::time_point, uint64_t>;
+        uint64_t fNextId = 1;
+        std::unordered_map<uint64_t, Pending> fPending;
+        std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> fDeadlines; // of requests with a timeout
+    };
+    std::unique_ptr<RpcState> fRpc;
+    int ExpireRequests();
+
+    // asynchronous sends waiting for the socket (see SendAsync()), created with the first one
+    struct SendQueue
+    {
+        struct Queued
+        {
+            Parts fParts;
+            bool fSingle; // sent as MessagePtr
+            SendCallback fCallback;
+            std::chrono::steady_clock::time_point fDeadline;
+        };
+        std::deque<Queued> fQueued;
+        std::chrono::steady_clock::time_point fNextDeadline = std::chrono::steady_clock::time_point::max(); // earliest one
+    };
+    std::unique_ptr<SendQueue> fSendQueue;
+    void EnqueueSend(Parts& parts, bool single, SendCallback callback, int timeoutMs);
+    int64_t SendQueued(Parts& parts, bool single, int timeout);
+    int ExpireSends();
+
+    std::unique_ptr<Channel> fLane; // priority lane, created in Init()
+    PollerPtr fLanePoller; // polls the priority lane and the channel socket
+    Lane fLastLane; // lane of the last received message
+
+    /// Address of the priority lane for a channel endpoint: the next port for tcp, "<address>.prio" otherwise
+    static std::string LaneAddress(const std::string& address);
+    static bool IsMulticastAddress(const std::string& address);
+
+    template<typename M>
+    int64_t ReceiveSocket(M& m, int timeout)
+    {
+        if (fDeadline > 0 && fOverflowState) {
+            Parts parts;
+            int64_t result = ReceiveUnexpired(parts, std::is_same_v<M, MessagePtr>, timeout);
+            if (result >= 0) {
+                GiveBack(parts, m);
             }
+            return result;
         }
+        return ReceiveRaw(m, timeout);
     }
 
-    void CheckSendCompatibility(Parts& parts) { CheckSendCompatibility(parts.fParts); }
-    void CheckSendCompatibility(std::vector<MessagePtr>& msgVec)
+    template<typename M>
+    int64_t ReceiveRaw(M& m, int timeout)
     {
-        for (auto& msg : msgVec) {
-            if (fTransportType != msg->GetType()) {
-                if (msg->GetSize() > 0) {
-                    MessagePtr msgWrapper(NewMessage(
-                        msg->GetData(),
-                        msg->GetSize(),
-                        [](void* /*data*/, void* _msg) { delete static_cast<Message*>(_msg); },
-                        msg.get()
-                    ));
-                    msg.release();
-                    msg = move(msgWrapper);
-                } else {
-                    MessagePtr newMsg(NewMessage());
-                    msg = move(newMsg);
+        return fLane ? ReceiveLanes(m, timeout) : fSocket->Receive(m, timeout);
+    }
+
+    // multiplexed channels: the first frame of every message holds the routing id (the subchannel index of the sender)
+    uint32_t fMuxRoute = 0; // of this subchannel
+    uint32_t fReceivedRoute = 0; // of the last received message
+
+    // sharedSend: created in Init(), declared last to stop its thread before the state it sends with is destroyed
+    std::unique_ptr<SharedSender> fSharedSender;
+    void InitSharedSender();
+
+    // Send() after the sampling decision
+    template<typename M>
+    int64_t SendSampled(M& m, int t)
+    {
+        if (!CheckSendCompatibility(m)) {
+            return static_cast<int64_t>(TransferCode::error);
+        }
+        if (fSharedSender) {
+            return fSharedSender->Push(m, t);
+        }
+        return SendNow(m, t);
+    }
+
+    // the send path behind Send(), on the sender thread for channels with the sharedSend property
+    template<typename M>
+    int64_t SendNow(M& m, int t)
+    {
+        if (fShapingState && !Shape(TotalSize(m), t)) {
+            return static_cast<int64_t>(TransferCode::timeout);
+        }
+        if (fTrace) {
+            TraceSend(FirstPart(m));
+        }
+        if (fFlightRecorder) {
+            RecordFlight(true, m, 0);
+        }
+        if (fChecksumState) {
+            return Timed(true, [&]() { return SendChecksummed(m, t); });
+        }
+        if (fMux) {
+            return Timed(true, [&]() { return SendMuxed(m, t); });
+        }
+        if (fOverflowState) {
+            return Timed(true, [&]() { return SendGuarded(m, t); });
+        }
+        return Timed(true, [&]() { return fSocket->Send(m, t); });
+    }
+    void InitRoute();
+    // initializes a multiplexed subchannel on the socket of another one, instead of Init()
+    void InitShared(const Channel& carrier);
+    template<typename M>
+    int64_t SendMuxed(M& m, int timeout)
+    {
+        Parts parts;
+        TakeParts(m, parts);
+        MessagePtr route(NewMessage(sizeof(fMuxRoute)));
+        std::memcpy(route->GetData(), &fMuxRoute, sizeof(fMuxRoute));
+        parts.fParts.insert(parts.fParts.begin(), std::move(route));
+        int64_t result = fOverflowState ? SendGuarded(parts, false, timeout) : fSocket->Send(parts.fParts, timeout);
+        if (parts.Empty()) {
+            // kept in the backlog
+            ReplaceTaken(m);
+        } else {
+            parts.fParts.erase(parts.fParts.begin());
+            GiveBack(parts, m);
+        }
+        if (result >= static_cast<int64_t>(sizeof(fMuxRoute))) {
+            result -= sizeof(fMuxRoute);
+        }
+        return result;
+    }
+    template<typename M>
+    int64_t ReceiveMuxed(M& m, int timeout)
+    {
+        Parts parts;
+        int64_t result = ReceiveSocket(parts, timeout);
+        if (result < 0) {
+            return result;
+        }
+        if (!TakeRoute(parts)) {
+            return static_cast<int64_t>(TransferCode::error);
+        }
+        GiveBack(parts, m);
+        return result - sizeof(fReceivedRoute);
+    }
+    bool TakeRoute(Parts& parts);
+
+    void InitOverflow();
+    void InitSample();
+    // sends with the overflow policy and the deadline frame, the message is taken unless it was neither queued nor dropped
+    template<typename M>
+    int64_t SendGuarded(M& m, int timeout)
+    {
+        Parts parts;
+        const bool single = TakeParts(m, parts);
+        int64_t result = SendGuarded(parts, single, timeout);
+        if (parts.Empty()) {
+            // kept in the backlog
+            ReplaceTaken(m);
+        } else {
+            GiveBack(parts, m);
+        }
+        return result;
+    }
+    int64_t SendGuarded(Parts& parts, bool single, int timeout);
+    // sends the backlog and (spill) the spilled messages that the socket accepts, true if nothing is left
+    bool DrainBacklog();
+    int64_t SendParts(Parts& parts, bool single, int timeout) { return single ? fSocket->Send(parts.fParts.front(), timeout) : fSocket->Send(parts.fParts, timeout); }
+    int64_t ReceiveUnexpired(Parts& parts, bool single, int timeout);
+
+    static bool TakeParts(MessagePtr& msg, Parts& parts) { parts.AddPart(std::move(msg)); return true; }
+    static bool TakeParts(Parts& m, Parts& parts) { return TakeParts(m.fParts, parts); }
+    static bool TakeParts(std::vector<MessagePtr>& msgVec, Parts& parts)
+    {
+        parts.fParts = std::move(msgVec);
+        msgVec.clear();
+        return false;
+    }
+    void ReplaceTaken(MessagePtr& msg) { msg = NewMessage(); }
+    static void ReplaceTaken(Parts& m) { m.fParts.clear(); }
+    static void ReplaceTaken(std::vector<MessagePtr>& msgVec) { msgVec.clear(); }
+    // (received parts are appended)
+    static void GiveBack(Parts& parts, MessagePtr& msg) { msg = std::move(parts.fParts.front()); }
+    static void GiveBack(Parts& parts, Parts& m) { GiveBack(parts, m.fParts); }
+    static void GiveBack(Parts& parts, std::vector<MessagePtr>& msgVec)
+    {
+        if (msgVec.empty()) {
+            msgVec = std::move(parts.fParts);
+        } else {
+            std::move(parts.fParts.begin(), parts.fParts.end(), std::back_inserter(msgVec));
+            parts.fParts.clear();
+        }
+    }
+
+    // receive from the priority lane first, then from the channel socket, wait on both
+    template<typename M>
+    int64_t ReceiveLanes(M& m, int timeout)
+    {
+        constexpr int slice = 100; // ms, the non-blocking receives check for interruption
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            for (Lane lane : {Lane::priority, Lane::normal}) {
+                int64_t result = (lane == Lane::priority ? fLane->fSocket : fSocket)->Receive(m, 0);
+                if (result != static_cast<int>(TransferCode::timeout)) {
+                    fLastLane = lane;
+                    return result;
                 }
             }
+            int wait = slice;
+            if (timeout >= 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                if (elapsed >= timeout) {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+                wait = std::min(slice, timeout - static_cast<int>(elapsed));
+            }
+            fLanePoller->Poll(wait);
+        }
+    }
+
+    // call (a send or receive) and record its duration if metrics are enabled
+    template<typename Call>
+    int64_t Timed(bool send, Call&& call)
+    {
+        Tune();
+        if (send) {
+            FAIRMQ_PROBE(send_entry, fName.c_str());
+        } else {
+            FAIRMQ_PROBE(receive_entry, fName.c_str());
+        }
+        int64_t result = 0;
+        if (!fMetrics) {
+            result = call();
+        } else {
+            auto start = std::chrono::steady_clock::now();
+            result = call();
+            RecordCall(send, start, result);
+        }
+        if (send) {
+            FAIRMQ_PROBE(send_return, fName.c_str(), result);
+        } else {
+            FAIRMQ_PROBE(receive_return, fName.c_str(), result);
+        }
+        return result;
+    }
+
+    // call a data callback of the device (OnData) for this channel and record its duration if metrics are enabled
+    template<typename Call>
+    bool TimedHandler(Call&& call)
+    {
+        return fMetrics ? fMetrics->TimeHandler(std::forward<Call>(call)) : call();
+    }
+
+    void RecordCall(bool send, std::chrono::steady_clock::time_point start, int64_t result)
+    {
+        if (fMetrics) {
+            fMetrics->Record(send, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), result);
+        }
+    }
+
+    // apply the sizes chosen by the tuner, the sockets are only touched by the thread using the channel
+    void Tune()
+    {
+        if (fTuner && fTuner->Pending()) {
+            ApplyTunedSizes();
+        }
+    }
+    void ApplyTunedSizes();
+
+    int64_t SendCopy(const MessagePtr* msgs, size_t numMsgs, int sndTimeoutMs);
+
+    bool BindChannelEndpoint(std::string& endpoint);
+    bool BindEphemeralPort(std::string& endpoint);
+
+    void InitTrace();
+
+    // the trace context of a multipart message is the one of its first part
+    static Message* FirstPart(MessagePtr& msg) { return msg.get(); }
+    static Message* FirstPart(Parts& parts) { return FirstPart(parts.fParts); }
+    static Message* FirstPart(std::vector<MessagePtr>& msgVec) { return msgVec.empty() ? nullptr : msgVec.front().get(); }
+    // received parts are appended, all of them carry the context
+    static Message* LastPart(MessagePtr& msg) { return msg.get(); }
+    static Message* LastPart(Parts& parts) { return LastPart(parts.fParts); }
+    static Message* LastPart(std::vector<MessagePtr>& msgVec) { return msgVec.empty() ? nullptr : msgVec.back().get(); }
+
+    static size_t TotalSize(MessagePtr& msg) { return msg ? msg->GetSize() : 0; }
+    static size_t TotalSize(Parts& parts) { return TotalSize(parts.fParts); }
+    static size_t TotalSize(std::vector<MessagePtr>& msgVec)
+    {
+        size_t size = 0;
+        for (const auto& msg : msgVec) {
+            size += msg ? msg->GetSize() : 0;
+        }
+        return size;
+    }
+
+    static size_t NumParts(MessagePtr&) { return 0; }
+    static size_t NumParts(Parts& parts) { return parts.Size(); }
+    static size_t NumParts(std::vector<MessagePtr>& msgVec) { return msgVec.size(); }
+
+    // record the parts from index first on
+    void RecordFlight(bool send, MessagePtr& msg, size_t /* first */)
+    {
+        if (msg) {
+            fFlightRecorder->Record(fFlightChannel, send, msg->GetData(), msg->GetSize(), 0, true);
+        }
+    }
+    void RecordFlight(bool send, Parts& parts, size_t first) { RecordFlight(send, parts.fParts, first); }
+    void RecordFlight(bool send, std::vector<MessagePtr>& msgVec, size_t first)
+    {
+        for (size_t i = first; i < msgVec.size(); ++i) {
+            if (msgVec[i]) {
+                fFlightRecorder->Record(fFlightChannel, send, msgVec[i]->GetData(), msgVec[i]->GetSize(), static_cast<uint16_t>(i - first), i + 1 == msgVec.size());
+            }
+        }
+    }
+
+    // messages without a context of their own inherit the one of the last traced message received by the thread
+    void TraceSend(Message* msg)
+    {
+        if (!msg) {
+            return;
+        }
+        if (!msg->GetTraceContext()) {
+            msg->SetTraceContext(Tracer::Current());
+        }
+        if (msg->GetTraceContext()) {
+            Tracer::Record(msg->GetTraceContext(), fTraceChannel, TraceEvent::Type::send);
+        }
+    }
+
+    void TraceReceive(Message* msg)
+    {
+        if (msg && msg->GetTraceContext()) {
+            Tracer::Current() = msg->GetTraceContext();
+            Tracer::Record(msg->GetTraceContext(), fTraceChannel, TraceEvent::Type::receive);
+        }
+    }
+
+    // Messages of another transport are sent without copying their buffer: the message of the channel transport refers
+    // to it (e.g. zmq_msg_init_data on a shmem buffer) and owns the original message, which is released (dropping its
+    // buffer reference, or acknowledging its region block) by the free function, once the channel transport is done.
+    bool CheckSendCompatibility(MessagePtr& msg);
+    bool CheckSendCompatibility(Parts& parts) { return CheckSendCompatibility(parts.fParts); }
+    bool CheckSendCompatibility(std::vector<MessagePtr>& msgVec)
+    {
+        for (auto& msg : msgVec) {
+            if (!CheckSendCompatibility(msg)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool MoveToReceiveTarget(MessagePtr& msg);
+    bool MoveToReceiveTarget(Parts& parts) { return MoveToReceiveTarget(parts.fParts); }
+    bool MoveToReceiveTarget(std::vector<MessagePtr>& msgVec)
+    {
+        for (auto& msg : msgVec) {
+            if (!MoveToReceiveTarget(msg)) {
+                return false;
+            }
         }
+        return true;
     }
 
     void CheckReceiveCompatibility(MessagePtr& msg)
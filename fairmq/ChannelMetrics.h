@@ -0,0 +1,226 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_CHANNELMETRICS_H
+#define FAIR_MQ_CHANNELMETRICS_H
+
+#include <fairmq/tools/PerfCounters.h>
+
+#include <algorithm> // min
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace fair::mq
+{
+
+/// Snapshot of the metrics of a (sub)channel, see Channel::GetMetrics()
+struct ChannelMetrics
+{
+    static constexpr int kNumBuckets = 64;
+    /// bucket 0: calls below 1 ns, bucket i: calls that took [2^(i-1), 2^i) ns
+    using Buckets = std::array<uint64_t, kNumBuckets>;
+
+    std::string name; ///< channel name including the index, e.g. "data[0]"
+    std::string transport;
+
+    // transferred by the socket (always counted)
+    uint64_t bytesTx = 0;
+    uint64_t bytesRx = 0;
+    uint64_t messagesTx = 0;
+    uint64_t messagesRx = 0;
+    uint64_t messagesDropped = 0; ///< dropped by the overflow policy (overflow property)
+    uint64_t messagesExpired = 0; ///< discarded at receive after their deadline (deadline property)
+    uint64_t messagesCorrupt = 0; ///< discarded at receive for a checksum mismatch (checksum property)
+    uint64_t sendsShaped = 0;     ///< sends that waited for the bandwidth limit (maxBandwidth property)
+    uint64_t shapingWaitNs = 0;   ///< total time these sends waited
+    int64_t queueDepth = -1;      ///< messages queued between the socket and its peers, -1 if unknown (see Channel::GetQueueDepth)
+    bool queueDepthExact = false; ///< counted (inproc, shmem meta rings) rather than estimated from the kernel queues
+
+    // calls of Send/Receive/SendCopy/ReceiveBatch/Forward (only counted with metrics enabled)
+    bool callsRecorded = false;
+    uint64_t sendCalls = 0;
+    uint64_t receiveCalls = 0;
+    uint64_t sendFailed = 0;    ///< timed out, interrupted or failed calls
+    uint64_t receiveFailed = 0;
+    uint64_t sendNs = 0;        ///< total time spent in send calls (blocked by a full queue or waiting for the peer)
+    uint64_t receiveNs = 0;     ///< total time spent in receive calls (waiting for data)
+    Buckets sendLatency{};
+    Buckets receiveLatency{};
+
+    // data callbacks (OnData) of the channel (only counted with metrics enabled)
+    uint64_t handlerCalls = 0;
+    uint64_t handlerNs = 0;     ///< total time spent in the callbacks (busy)
+    uint64_t handlingNs = 0;    ///< time since the first callback started, busy or waiting for input
+    Buckets handlerLatency{};
+
+    // hardware counters of the data callbacks, in user space on the thread of the callback (only with --perf-counters)
+    bool perfRecorded = false;
+    uint64_t handlerCycles = 0;
+    uint64_t handlerInstructions = 0;
+    uint64_t handlerLLCMisses = 0;     ///< last level cache misses
+    uint64_t handlerBranchMisses = 0;
+
+    // payload compression (channels with the compression property)
+    bool compressed = false;
+    uint64_t rawBytesTx = 0;    ///< payload bytes of the sent messages
+    uint64_t wireBytesTx = 0;   ///< bytes sent for them, after compression
+    uint64_t rawBytesRx = 0;    ///< payload bytes of the received messages, after decompression
+    uint64_t wireBytesRx = 0;   ///< bytes received for them
+    uint64_t compressNs = 0;    ///< total time spent compressing (summed over the codec threads)
+    uint64_t decompressNs = 0;
+
+    /// @return raw bytes per sent byte, 1 if nothing was sent
+    double CompressionRatioTx() const { return wireBytesTx > 0 ? static_cast<double>(rawBytesTx) / wireBytesTx : 1.; }
+    double CompressionRatioRx() const { return wireBytesRx > 0 ? static_cast<double>(rawBytesRx) / wireBytesRx : 1.; }
+
+    /// @return fraction of the time since the first data callback spent in the callbacks of the channel, 0 if none
+    double BusyRatio() const { return handlingNs > 0 ? std::min(1., static_cast<double>(handlerNs) / handlingNs) : 0.; }
+
+    /// @return a handler counter (e.g. handlerLLCMisses) per data callback, i.e. per handled message, 0 if none
+    double PerHandlerCall(uint64_t count) const { return handlerCalls > 0 ? static_cast<double>(count) / handlerCalls : 0.; }
+    /// @return instructions per cycle of the data callbacks, 0 if not recorded
+    double HandlerIPC() const { return handlerCycles > 0 ? static_cast<double>(handlerInstructions) / handlerCycles : 0.; }
+
+    /// @return upper bound (exclusive) in ns of the bucket containing the percentile (in [0, 100]), 0 if no calls
+    static uint64_t Percentile(const Buckets& buckets, double percentile)
+    {
+        uint64_t count = 0;
+        for (uint64_t n : buckets) {
+            count += n;
+        }
+        if (count == 0) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(percentile / 100. * count + 0.5);
+        rank = std::min(std::max(rank, uint64_t(1)), count);
+        uint64_t seen = 0;
+        for (int i = 0; i < kNumBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return i == kNumBuckets - 1 ? UINT64_MAX : uint64_t(1) << i;
+            }
+        }
+        return UINT64_MAX;
+    }
+};
+
+/// Records the call metrics of a channel with relaxed atomic counters, so that they can be read by any thread
+/// (e.g. a monitoring plugin) while the channel is used. Costs two clock reads and a few uncontended increments per call.
+class ChannelMetricsRecorder
+{
+  public:
+    /// @param perfCounters also read the hardware counters of the thread around every handler (two read syscalls)
+    explicit ChannelMetricsRecorder(bool perfCounters = false)
+        : fPerfCounters(perfCounters)
+    {}
+
+    /// call a data callback (or ConditionalRun()) and record its duration, and its hardware counters if enabled
+    template<typename Call>
+    bool TimeHandler(Call&& call)
+    {
+        tools::PerfCounters* perf = fPerfCounters ? tools::PerfCounters::ForThisThread() : nullptr;
+        tools::PerfCounts before;
+        if (perf && !perf->Read(before)) {
+            perf = nullptr;
+        }
+        auto start = std::chrono::steady_clock::now();
+        bool proceed = call();
+        RecordHandler(start, std::chrono::steady_clock::now());
+        if (tools::PerfCounts after; perf && perf->Read(after)) {
+            RecordHandlerPerf(after - before);
+        }
+        return proceed;
+    }
+
+    void Record(bool send, uint64_t ns, int64_t result)
+    {
+        Direction& d = send ? fSend : fReceive;
+        if (result < 0) {
+            d.fFailed.fetch_add(1, std::memory_order_relaxed);
+        }
+        d.Add(ns);
+    }
+
+    void RecordHandler(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        if (fHandlingSince.load(std::memory_order_relaxed) == 0) {
+            fHandlingSince.store(start.time_since_epoch().count(), std::memory_order_relaxed);
+        }
+        fHandler.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    void RecordHandlerPerf(const tools::PerfCounts& counts)
+    {
+        fCycles.fetch_add(counts.cycles, std::memory_order_relaxed);
+        fInstructions.fetch_add(counts.instructions, std::memory_order_relaxed);
+        fLLCMisses.fetch_add(counts.llcMisses, std::memory_order_relaxed);
+        fBranchMisses.fetch_add(counts.branchMisses, std::memory_order_relaxed);
+    }
+
+    void Fill(ChannelMetrics& metrics) const
+    {
+        metrics.callsRecorded = true;
+        metrics.sendCalls = fSend.fCalls.load(std::memory_order_relaxed);
+        metrics.receiveCalls = fReceive.fCalls.load(std::memory_order_relaxed);
+        metrics.sendFailed = fSend.fFailed.load(std::memory_order_relaxed);
+        metrics.receiveFailed = fReceive.fFailed.load(std::memory_order_relaxed);
+        metrics.sendNs = fSend.fNs.load(std::memory_order_relaxed);
+        metrics.receiveNs = fReceive.fNs.load(std::memory_order_relaxed);
+        for (int i = 0; i < ChannelMetrics::kNumBuckets; ++i) {
+            metrics.sendLatency[i] = fSend.fBuckets[i].load(std::memory_order_relaxed);
+            metrics.receiveLatency[i] = fReceive.fBuckets[i].load(std::memory_order_relaxed);
+            metrics.handlerLatency[i] = fHandler.fBuckets[i].load(std::memory_order_relaxed);
+        }
+        metrics.handlerCalls = fHandler.fCalls.load(std::memory_order_relaxed);
+        metrics.handlerNs = fHandler.fNs.load(std::memory_order_relaxed);
+        if (auto since = fHandlingSince.load(std::memory_order_relaxed); since != 0) {
+            std::chrono::steady_clock::time_point start{std::chrono::steady_clock::duration(since)};
+            metrics.handlingNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+        metrics.perfRecorded = fPerfCounters;
+        metrics.handlerCycles = fCycles.load(std::memory_order_relaxed);
+        metrics.handlerInstructions = fInstructions.load(std::memory_order_relaxed);
+        metrics.handlerLLCMisses = fLLCMisses.load(std::memory_order_relaxed);
+        metrics.handlerBranchMisses = fBranchMisses.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Direction
+    {
+        std::atomic<uint64_t> fCalls{0};
+        std::atomic<uint64_t> fFailed{0};
+        std::atomic<uint64_t> fNs{0};
+        std::array<std::atomic<uint64_t>, ChannelMetrics::kNumBuckets> fBuckets{};
+
+        void Add(uint64_t ns)
+        {
+            fCalls.fetch_add(1, std::memory_order_relaxed);
+            fNs.fetch_add(ns, std::memory_order_relaxed);
+            int bucket = ns == 0 ? 0 : std::min(64 - __builtin_clzll(ns), ChannelMetrics::kNumBuckets - 1);
+            fBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    // separate cache lines for a sending and a receiving thread
+    alignas(64) Direction fSend;
+    alignas(64) Direction fReceive;
+    alignas(64) Direction fHandler;
+    std::atomic<std::chrono::steady_clock::rep> fHandlingSince{0}; // start of the first callback
+    std::atomic<uint64_t> fCycles{0};
+    std::atomic<uint64_t> fInstructions{0};
+    std::atomic<uint64_t> fLLCMisses{0};
+    std::atomic<uint64_t> fBranchMisses{0};
+    const bool fPerfCounters;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_CHANNELMETRICS_H */
@@ -0,0 +1,146 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_CHANNELTUNER_H
+#define FAIR_MQ_CHANNELTUNER_H
+
+#include <algorithm> // min, max
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace fair::mq
+{
+
+/// Sizes of the queues (high-water marks, in messages) and kernel buffers (in bytes) of a channel
+struct ChannelSizes
+{
+    int sndBufSize = 0;
+    int rcvBufSize = 0;
+    int sndKernelSize = 0; ///< 0: OS default (autotuned by the kernel)
+    int rcvKernelSize = 0;
+
+    bool operator==(const ChannelSizes& rhs) const
+    {
+        return sndBufSize == rhs.sndBufSize && rcvBufSize == rhs.rcvBufSize && sndKernelSize == rhs.sndKernelSize && rcvKernelSize == rhs.rcvKernelSize;
+    }
+    bool operator!=(const ChannelSizes& rhs) const { return !(*this == rhs); }
+};
+
+/// Chooses the queue and kernel buffer sizes of a channel with the autoTune property from its measured transfer rates and
+/// round-trip time (sampled by the device once per second while RUNNING), between the configured sizes and the maxima.
+///   - queues hold the messages of two round trips plus 10 ms of scheduling delays,
+///   - kernel buffers of tcp connections hold twice the bandwidth-delay product. They are left to the kernel (which
+///     autotunes up to a few MiB) until that is exceeded, setting them disables the autotuning of the kernel.
+/// Sizes are rounded up to powers of two, grow at once and shrink only when the need falls below a quarter of them, so
+/// that they do not follow every fluctuation of the rates. The chosen sizes are applied by the thread using the channel.
+class ChannelTuner
+{
+  public:
+    /// kernel buffers up to this size are left to the kernel
+    static constexpr int kKernelAutoSize = 4 << 20;
+
+    /// @param min configured sizes (lower bounds)
+    ChannelTuner(ChannelSizes min, int maxBufSize, int maxKernelSize)
+        : fMin(min)
+        , fMaxBufSize(maxBufSize)
+        , fMaxKernelSize(maxKernelSize)
+        , fSizes(min)
+        , fPending(false)
+    {}
+
+    /// Choose the sizes for the rates measured over the last interval
+    /// @param rttUs round-trip time, -1 if unknown (then the kernel buffers are not changed)
+    /// @return true if the sizes changed
+    bool Sample(uint64_t bytesTx, uint64_t bytesRx, uint64_t msgsTx, uint64_t msgsRx, double seconds, int rttUs)
+    {
+        if (seconds <= 0.) {
+            return false;
+        }
+        const double rtt = rttUs > 0 ? rttUs / 1e6 : 0.;
+        const double window = 2. * rtt + 0.01;
+
+        std::lock_guard<std::mutex> lock(fMtx);
+        ChannelSizes sizes(fSizes);
+        sizes.sndBufSize = BufSize(msgsTx / seconds * window, fMin.sndBufSize, fSizes.sndBufSize);
+        sizes.rcvBufSize = BufSize(msgsRx / seconds * window, fMin.rcvBufSize, fSizes.rcvBufSize);
+        if (rttUs > 0) {
+            sizes.sndKernelSize = KernelSize(bytesTx / seconds * 2. * rtt, fMin.sndKernelSize, fSizes.sndKernelSize);
+            sizes.rcvKernelSize = KernelSize(bytesRx / seconds * 2. * rtt, fMin.rcvKernelSize, fSizes.rcvKernelSize);
+        }
+        if (sizes == fSizes) {
+            return false;
+        }
+        fSizes = sizes;
+        fPending.store(true, std::memory_order_release);
+        return true;
+    }
+
+    /// @return true if sizes were chosen that are not applied yet
+    bool Pending() const { return fPending.load(std::memory_order_acquire); }
+
+    /// @return the chosen sizes, to be applied to the sockets (clears Pending())
+    ChannelSizes Take()
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fPending.store(false, std::memory_order_relaxed);
+        return fSizes;
+    }
+
+    ChannelSizes GetSizes() const
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        return fSizes;
+    }
+
+  private:
+    static int Pow2(double need, int max)
+    {
+        int64_t size = 1;
+        while (size < need && size < max) {
+            size <<= 1;
+        }
+        return static_cast<int>(std::min(size, static_cast<int64_t>(max)));
+    }
+
+    // grow at once, shrink only well below the current size
+    static int Hysteresis(int target, int current)
+    {
+        return (target > current || int64_t(target) * 4 <= current) ? target : current;
+    }
+
+    int BufSize(double need, int min, int current) const
+    {
+        if (min == 0) {
+            return 0; // unbounded queue
+        }
+        return Hysteresis(std::max(min, Pow2(need, fMaxBufSize)), current);
+    }
+
+    int KernelSize(double need, int min, int current) const
+    {
+        if (min == 0) {
+            if (current == 0 && need <= kKernelAutoSize) {
+                return 0; // left to the kernel
+            }
+            min = kKernelAutoSize;
+        }
+        return Hysteresis(std::max(min, Pow2(need, fMaxKernelSize)), current);
+    }
+
+    const ChannelSizes fMin;
+    const int fMaxBufSize;
+    const int fMaxKernelSize;
+    mutable std::mutex fMtx;
+    ChannelSizes fSizes;
+    std::atomic<bool> fPending;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_CHANNELTUNER_H */
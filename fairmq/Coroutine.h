@@ -0,0 +1,518 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_COROUTINE_H
+#define FAIR_MQ_COROUTINE_H
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "<fairmq/Coroutine.h> requires C++20 coroutines, compile with -std=c++20 or later"
+#endif
+
+#include <fairmq/Channel.h>
+#include <fairmq/Device.h>
+#include <fairmq/Poller.h>
+#include <fairmq/Socket.h> // TransferCode
+#include <fairmq/tools/Exceptions.h> // CallOnDestruction
+
+#include <poll.h>
+
+#include <algorithm> // min, remove_if, sort
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fair::mq::coro
+{
+
+template<typename T = void>
+class Task;
+
+namespace detail
+{
+
+template<typename T>
+struct PromiseBase
+{
+    std::coroutine_handle<> fContinuation; // the awaiting coroutine, resumed when this one completes
+    std::exception_ptr fException;
+
+    std::suspend_always initial_suspend() noexcept { return {}; } // lazy, started when awaited or spawned
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            auto continuation = h.promise().fContinuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { fException = std::current_exception(); }
+};
+
+template<typename T>
+struct Promise : PromiseBase<T>
+{
+    std::optional<T> fValue;
+
+    Task<T> get_return_object();
+    template<typename U>
+    void return_value(U&& value) { fValue.emplace(std::forward<U>(value)); }
+    T Result()
+    {
+        if (this->fException) {
+            std::rethrow_exception(this->fException);
+        }
+        return std::move(*fValue);
+    }
+};
+
+template<>
+struct Promise<void> : PromiseBase<void>
+{
+    Task<void> get_return_object();
+    void return_void() {}
+    void Result()
+    {
+        if (fException) {
+            std::rethrow_exception(fException);
+        }
+    }
+};
+
+// a suspended receive/send/timer, shared between the I/O wait lists and the timer queue (whichever completes it first)
+struct Waiter
+{
+    std::coroutine_handle<> fHandle;
+    std::function<int64_t()> fAttempt; // non-blocking transfer attempt, empty for timers
+    Channel* fChannel = nullptr;
+    bool fOutput = false;
+    bool fDone = false;
+    int64_t fResult = static_cast<int64_t>(TransferCode::timeout);
+};
+
+} // namespace detail
+
+/// Coroutine returning T, started when it is awaited (co_await task) or spawned on an Executor (Task<void> only).
+/// Exceptions are propagated to the awaiting coroutine, or rethrown by Executor::Run() for spawned tasks.
+template<typename T>
+class [[nodiscard]] Task
+{
+  public:
+    using promise_type = detail::Promise<T>;
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> handle) : fHandle(handle) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    Task(Task&& other) noexcept : fHandle(std::exchange(other.fHandle, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other) {
+            Destroy();
+            fHandle = std::exchange(other.fHandle, {});
+        }
+        return *this;
+    }
+    ~Task() { Destroy(); }
+
+    bool Done() const { return !fHandle || fHandle.done(); }
+
+    auto operator co_await() noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> fHandle;
+            bool await_ready() noexcept { return !fHandle || fHandle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                fHandle.promise().fContinuation = awaiting;
+                return fHandle; // symmetric transfer, no stack growth for deep chains
+            }
+            T await_resume() { return fHandle.promise().Result(); }
+        };
+        return Awaiter{fHandle};
+    }
+
+  private:
+    friend class Executor;
+
+    void Destroy()
+    {
+        if (fHandle) {
+            fHandle.destroy();
+            fHandle = {};
+        }
+    }
+
+    std::coroutine_handle<promise_type> fHandle;
+};
+
+namespace detail
+{
+template<typename T>
+Task<T> Promise<T>::get_return_object() { return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this)); }
+inline Task<void> Promise<void>::get_return_object() { return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this)); }
+} // namespace detail
+
+/// Single-threaded executor of coroutines on the channels of a device: the suspended receives and sends are polled
+/// with the pollers of their transports, timers are kept in a queue. All coroutines run on the thread calling Run(),
+/// so they need no synchronization among each other.
+///
+/// A transfer that can complete right away does not suspend: a coroutine that always finds data keeps running until
+/// it awaits something that is not ready (or Yield()).
+class Executor
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @param wakeupFd fd that is readable while Run() should check its stop condition, e.g. Device::GetStateWakeupFd().
+    /// Without one, the stop condition is checked at least every kStopCheckIntervalMs.
+    explicit Executor(int wakeupFd = -1) : fWakeupFd(wakeupFd) {}
+    Executor(const Executor&) = delete;
+    Executor(Executor&&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    Executor& operator=(Executor&&) = delete;
+    ~Executor() { Clear(); }
+
+    static constexpr int kStopCheckIntervalMs = 100;
+
+    void SetWakeupFd(int fd)
+    {
+        fWakeupFd = fd;
+        fPollers.clear();
+    }
+
+    /// Start a task on the next iteration of Run(), the executor owns it until it completes
+    void Spawn(Task<> task)
+    {
+        if (task.Done()) {
+            return;
+        }
+        fReady.push_back(task.fHandle);
+        fTasks.push_back(std::move(task));
+    }
+
+    /// Run the tasks until all of them completed or stop() returns true. Unfinished tasks are kept suspended, they
+    /// continue with the next Run() or are destroyed with Clear(). The first exception of a task is rethrown.
+    void Run(const std::function<bool()>& stop)
+    {
+        while (!fTasks.empty() && !stop()) {
+            while (!fReady.empty()) {
+                auto handle = fReady.front();
+                fReady.pop_front();
+                handle.resume();
+            }
+            Reap();
+            if (fTasks.empty() || stop()) {
+                break;
+            }
+            Wait();
+            FireTimers();
+        }
+    }
+
+    /// Destroy all unfinished tasks (and the coroutines they await)
+    void Clear()
+    {
+        fReady.clear();
+        fWaiters.clear();
+        fTimers = decltype(fTimers)();
+        fTasks.clear();
+        fPollers.clear();
+    }
+
+    size_t GetNumTasks() const { return fTasks.size(); }
+
+    /// co_await exec.ReceiveAsync(channel, msg[, timeoutMs]): as Channel::Receive(), without blocking the thread.
+    /// @return the number of received bytes or a TransferCode (timeout, interrupted, error)
+    template<typename M>
+    auto ReceiveAsync(Channel& channel, M& m, int timeoutMs = -1)
+    {
+        return Transfer(channel, false, [&channel, &m]() { return channel.Receive(m, 0); }, timeoutMs);
+    }
+
+    /// co_await exec.SendAsync(channel, msg[, timeoutMs]): as Channel::Send(), without blocking the thread
+    template<typename M>
+    auto SendAsync(Channel& channel, M& m, int timeoutMs = -1)
+    {
+        return Transfer(channel, true, [&channel, &m]() { return channel.Send(m, 0); }, timeoutMs);
+    }
+
+    /// co_await exec.Timer(duration): resume after the duration
+    auto Timer(std::chrono::milliseconds duration)
+    {
+        struct Awaiter
+        {
+            Executor& fExec;
+            std::chrono::milliseconds fDuration;
+            bool await_ready() const noexcept { return fDuration.count() <= 0; }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                auto waiter = std::make_shared<detail::Waiter>();
+                waiter->fHandle = handle;
+                fExec.AddTimer(Clock::now() + fDuration, std::move(waiter));
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this, duration};
+    }
+
+    /// co_await exec.Yield(): let the other ready coroutines run first
+    auto Yield()
+    {
+        struct Awaiter
+        {
+            Executor& fExec;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { fExec.fReady.push_back(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+  private:
+    using WaiterPtr = std::shared_ptr<detail::Waiter>;
+
+    struct TimerEntry
+    {
+        Clock::time_point fDeadline;
+        uint64_t fSeq; // keeps timers with the same deadline in order
+        WaiterPtr fWaiter;
+        bool operator>(const TimerEntry& rhs) const { return fDeadline != rhs.fDeadline ? fDeadline > rhs.fDeadline : fSeq > rhs.fSeq; }
+    };
+
+    struct ChannelWaiters
+    {
+        std::deque<WaiterPtr> fIn;
+        std::deque<WaiterPtr> fOut;
+    };
+
+    auto Transfer(Channel& channel, bool output, std::function<int64_t()> attempt, int timeoutMs)
+    {
+        struct Awaiter
+        {
+            Executor& fExec;
+            WaiterPtr fWaiter;
+            int fTimeoutMs;
+            bool await_ready()
+            {
+                fWaiter->fResult = fWaiter->fAttempt();
+                return fWaiter->fResult != static_cast<int64_t>(TransferCode::timeout) || fTimeoutMs == 0;
+            }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                fWaiter->fHandle = handle;
+                fExec.AddIoWaiter(fWaiter);
+                if (fTimeoutMs > 0) {
+                    fExec.AddTimer(Clock::now() + std::chrono::milliseconds(fTimeoutMs), fWaiter);
+                }
+            }
+            int64_t await_resume() const noexcept { return fWaiter->fResult; }
+        };
+        auto waiter = std::make_shared<detail::Waiter>();
+        waiter->fAttempt = std::move(attempt);
+        waiter->fChannel = &channel;
+        waiter->fOutput = output;
+        return Awaiter{*this, std::move(waiter), timeoutMs};
+    }
+
+    void AddIoWaiter(WaiterPtr waiter)
+    {
+        ChannelWaiters& waiters = fWaiters[waiter->fChannel];
+        (waiter->fOutput ? waiters.fOut : waiters.fIn).push_back(std::move(waiter));
+    }
+
+    void AddTimer(Clock::time_point deadline, WaiterPtr waiter) { fTimers.push(TimerEntry{deadline, fTimerSeq++, std::move(waiter)}); }
+
+    void Complete(detail::Waiter& waiter, int64_t result)
+    {
+        waiter.fDone = true;
+        waiter.fResult = result;
+        fReady.push_back(waiter.fHandle);
+    }
+
+    void FireTimers()
+    {
+        const auto now = Clock::now();
+        while (!fTimers.empty() && fTimers.top().fDeadline <= now) {
+            WaiterPtr waiter = fTimers.top().fWaiter;
+            fTimers.pop();
+            if (!waiter->fDone) {
+                Complete(*waiter, static_cast<int64_t>(TransferCode::timeout)); // removed from the I/O waiters lazily
+            }
+        }
+    }
+
+    // remove completed tasks, rethrow the first exception
+    void Reap()
+    {
+        std::exception_ptr exception;
+        fTasks.remove_if([&](Task<>& task) {
+            if (!task.Done()) {
+                return false;
+            }
+            if (!exception && task.fHandle.promise().fException) {
+                exception = task.fHandle.promise().fException;
+            }
+            return true;
+        });
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    // poll the channels with suspended transfers until one of them is ready, the next timer expires or the wakeup fd
+    // becomes readable
+    void Wait()
+    {
+        int timeout = -1;
+        if (!fReady.empty()) {
+            timeout = 0;
+        } else if (!fTimers.empty()) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(fTimers.top().fDeadline - Clock::now()).count() + 1;
+            timeout = static_cast<int>(std::max<int64_t>(0, wait));
+        }
+
+        // the channels with waiters, per transport
+        std::map<TransportFactory*, std::vector<Channel*>> groups;
+        for (auto it = fWaiters.begin(); it != fWaiters.end();) {
+            auto& [channel, waiters] = *it;
+            auto done = [](const WaiterPtr& w) { return w->fDone; };
+            waiters.fIn.erase(std::remove_if(waiters.fIn.begin(), waiters.fIn.end(), done), waiters.fIn.end());
+            waiters.fOut.erase(std::remove_if(waiters.fOut.begin(), waiters.fOut.end(), done), waiters.fOut.end());
+            if (waiters.fIn.empty() && waiters.fOut.empty()) {
+                it = fWaiters.erase(it);
+                continue;
+            }
+            groups[channel->Transport()].push_back(channel);
+            ++it;
+        }
+
+        if (groups.empty()) {
+            if (fWakeupFd >= 0) {
+                pollfd fd{fWakeupFd, POLLIN, 0};
+                ::poll(&fd, 1, timeout);
+            } else if (timeout != 0) {
+                ::poll(nullptr, 0, timeout < 0 ? kStopCheckIntervalMs : std::min(timeout, kStopCheckIntervalMs));
+            }
+            return;
+        }
+
+        for (auto& [transport, channels] : groups) {
+            std::sort(channels.begin(), channels.end());
+            auto& [poller, wakeup] = GetPoller(transport, channels);
+            int t = timeout;
+            if (groups.size() > 1) {
+                t = (t < 0) ? 1 : std::min(t, 1); // several transports are polled in turns
+            } else if (!wakeup) {
+                t = (t < 0) ? kStopCheckIntervalMs : std::min(t, kStopCheckIntervalMs);
+            }
+            poller->Poll(t);
+            for (size_t i = 0; i < channels.size(); ++i) {
+                ChannelWaiters& waiters = fWaiters.at(channels[i]);
+                if (poller->CheckInput(static_cast<int>(i))) {
+                    Attempt(waiters.fIn);
+                }
+                if (poller->CheckOutput(static_cast<int>(i))) {
+                    Attempt(waiters.fOut);
+                }
+            }
+        }
+    }
+
+    // complete the waiters of a ready channel in order, until one would block
+    void Attempt(std::deque<WaiterPtr>& waiters)
+    {
+        while (!waiters.empty()) {
+            WaiterPtr waiter = waiters.front();
+            if (!waiter->fDone) {
+                int64_t result = waiter->fAttempt();
+                if (result == static_cast<int64_t>(TransferCode::timeout)) {
+                    return;
+                }
+                Complete(*waiter, result);
+            }
+            waiters.pop_front();
+        }
+    }
+
+    // pollers are cached per set of channels (bounded), flows typically wait on a few recurring sets
+    std::pair<PollerPtr, bool>& GetPoller(TransportFactory* transport, const std::vector<Channel*>& channels)
+    {
+        auto key = std::make_pair(transport, channels);
+        auto it = fPollers.find(key);
+        if (it == fPollers.end()) {
+            if (fPollers.size() >= kMaxPollers) {
+                fPollers.clear();
+            }
+            PollerPtr poller = transport->CreatePoller(channels);
+            bool wakeup = fWakeupFd >= 0 && poller->AddWakeup(fWakeupFd);
+            it = fPollers.emplace(std::move(key), std::make_pair(std::move(poller), wakeup)).first;
+        }
+        return it->second;
+    }
+
+    static constexpr size_t kMaxPollers = 64;
+
+    int fWakeupFd;
+    std::list<Task<>> fTasks;
+    std::deque<std::coroutine_handle<>> fReady;
+    std::unordered_map<Channel*, ChannelWaiters> fWaiters;
+    std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry>> fTimers;
+    uint64_t fTimerSeq = 0;
+    std::map<std::pair<TransportFactory*, std::vector<Channel*>>, std::pair<PollerPtr, bool>> fPollers;
+};
+
+/// Device whose RUNNING state is a coroutine: RunTask() is spawned on an Executor when the device enters RUNNING,
+/// further flows can be spawned with GetExecutor().Spawn(). The state is left when all flows completed (as with Run())
+/// or when a transition is requested, the unfinished flows are then destroyed.
+///
+///     fair::mq::coro::Task<> RunTask() override
+///     {
+///         auto msg(NewMessageFor("data", 0));
+///         while (co_await GetExecutor().ReceiveAsync(GetChannel("data", 0), msg, 1000) >= 0) { ... }
+///     }
+class CoroutineDevice : public Device
+{
+  protected:
+    virtual Task<> RunTask() = 0;
+
+    Executor& GetExecutor() { return fExecutor; }
+
+    void Run() override
+    {
+        tools::CallOnDestruction clear([&]() { fExecutor.Clear(); });
+        fExecutor.SetWakeupFd(GetStateWakeupFd());
+        fExecutor.Spawn(RunTask());
+        fExecutor.Run([this]() { return NewStatePending(); });
+    }
+
+  private:
+    Executor fExecutor;
+};
+
+} // namespace fair::mq::coro
+
+#endif /* FAIR_MQ_COROUTINE_H */
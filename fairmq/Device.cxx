@@ -8,19 +8,29 @@
 
 // FairMQ
 #include <fairmq/Device.h>
+#include <fairmq/StartupProfile.h>
 #include <fairmq/Tools.h>
 
 // boost
 #include <boost/algorithm/string.hpp>   // join/split
 
 // std
-#include <algorithm>   // std::max, std::any_of
+#include <algorithm>   // std::max, std::any_of, std::sort
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>   // strerror
 #include <iomanip>
 #include <list>
 #include <memory>   // std::make_unique
 #include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+// system
+#include <poll.h>
 
 namespace fair::mq {
 
@@ -33,7 +43,146 @@ constexpr mq::Transport Device::DefaultTransportType;
 constexpr const char* Device::DefaultNetworkInterface;
 constexpr int Device::DefaultInitTimeout;
 constexpr float Device::DefaultRate;
+constexpr int Device::DefaultDataWorkers;
+constexpr const char* Device::DefaultInputDispatch;
 constexpr const char* Device::DefaultSession;
+constexpr bool Device::DefaultWarmReset;
+
+namespace
+{
+
+// poll timeout of the input loop while asynchronous sends are queued (see Device::DispatchSends())
+constexpr int kQueuedSendsPollMs = 10;
+// messages handled by the scheduled input dispatch (--input-dispatch) before the input loop dispatches the sends and
+// runs the timers, for inputs without budget that stay ready
+constexpr int kMaxScheduledInputs = 256;
+
+// Wakes up ConnectWrapper when the address of a channel is updated in the config (e.g. by a plugin)
+struct AddressSubscription
+{
+    struct Signal
+    {
+        mutex fMtx;
+        condition_variable fCV;
+        bool fUpdated = false;
+    };
+
+    ProgOptions& fConfig;
+    string fId;
+    shared_ptr<Signal> fSignal; // shared with the callback, which may still be running after unsubscribing
+
+    explicit AddressSubscription(string id, ProgOptions& config)
+        : fConfig(config)
+        , fId(std::move(id))
+        , fSignal(make_shared<Signal>())
+    {
+        fConfig.SubscribeAsString(fId, [signal = fSignal](const string& key, string) {
+            if (key.compare(0, 6, "chans.") == 0 && key.size() > 8 && key.compare(key.size() - 8, 8, ".address") == 0) {
+                {
+                    lock_guard<mutex> lock(signal->fMtx);
+                    signal->fUpdated = true;
+                }
+                signal->fCV.notify_all();
+            }
+        });
+    }
+
+    AddressSubscription(const AddressSubscription&) = delete;
+    AddressSubscription(AddressSubscription&&) = delete;
+    AddressSubscription& operator=(const AddressSubscription&) = delete;
+    AddressSubscription& operator=(AddressSubscription&&) = delete;
+
+    ~AddressSubscription() { fConfig.UnsubscribeAsString(fId); }
+
+    /// wait until an address is updated or the timeout expires
+    void Wait(chrono::milliseconds timeout)
+    {
+        unique_lock<mutex> lock(fSignal->fMtx);
+        fSignal->fCV.wait_for(lock, timeout, [&] { return fSignal->fUpdated; });
+        fSignal->fUpdated = false;
+    }
+};
+
+struct Endpoint
+{
+    string address; // without modifier
+    bool bind;
+    bool modifier;
+};
+
+// an endpoint of a channel address, the modifier ('@': bind, '+'/'>': connect) overrides the channel method
+Endpoint ParseEndpoint(const string& endpoint, bool bind)
+{
+    if (!endpoint.empty() && (endpoint[0] == '+' || endpoint[0] == '>')) {
+        return {endpoint.substr(1), false, true};
+    } else if (!endpoint.empty() && endpoint[0] == '@') {
+        return {endpoint.substr(1), true, true};
+    }
+    return {endpoint, bind, false};
+}
+
+// host of a tcp endpoint that has to be resolved, empty for other endpoints and wildcard binds
+string HostToResolve(const Endpoint& endpoint)
+{
+    if (endpoint.address.compare(0, 6, "tcp://") != 0) {
+        return "";
+    }
+    string host = endpoint.address.substr(6, endpoint.address.find(':', 6) - 6);
+    return (endpoint.bind && host == "*") ? "" : host;
+}
+
+// resolve the hosts of the channels concurrently, once per host
+unordered_map<string, string> ResolveHosts(const vector<Channel*>& chans)
+{
+    vector<string> hosts;
+    unordered_set<string> seen;
+    for (const Channel* chan : chans) {
+        vector<string> endpoints;
+        string address = chan->GetAddress();
+        boost::algorithm::split(endpoints, address, boost::algorithm::is_any_of(","));
+        for (const auto& endpoint : endpoints) {
+            string host = HostToResolve(ParseEndpoint(endpoint, chan->GetMethod() == "bind"));
+            if (!host.empty() && seen.insert(host).second) {
+                hosts.push_back(std::move(host));
+            }
+        }
+    }
+
+    vector<string> ips(hosts.size());
+    atomic<size_t> next(0);
+    auto resolve = [&] {
+        for (size_t i = next++; i < hosts.size(); i = next++) {
+            ips[i] = tools::getIpFromHostname(hosts[i]);
+        }
+    };
+    vector<thread> resolvers;
+    constexpr size_t maxResolvers = 16;
+    for (size_t i = 1; i < min(hosts.size(), maxResolvers); ++i) {
+        resolvers.emplace_back(resolve);
+    }
+    resolve();
+    for (auto& t : resolvers) {
+        t.join();
+    }
+
+    unordered_map<string, string> resolved;
+    for (size_t i = 0; i < hosts.size(); ++i) {
+        resolved.emplace(std::move(hosts[i]), std::move(ips[i]));
+    }
+    return resolved;
+}
+
+// properties read by the transport factories, a warm reset keeps the transports only if these are unchanged
+map<string, string> TransportConfig(const ProgOptions& config)
+{
+    map<string, string> properties;
+    for (const auto& prefix : {"shm", "zmq-", "uring-", "rdma-", "bad-alloc-", "io-", "sched-", "session", "id"}) {
+        properties.merge(config.GetPropertiesAsStringStartingWith(prefix));
+    }
+    return properties;
+}
+
+} // namespace
 
 struct StateSubscription
 {
@@ -88,18 +237,48 @@ Device::Device(ProgOptions* config, tools::Version version)
     , fDefaultTransportType(DefaultTransportType)
     , fDataCallbacks(false)
     , fMultitransportProceed(false)
+    , fDataWorkers(DefaultDataWorkers)
+    , fChannelMetrics(DefaultChannelMetrics)
     , fVersion(version)
     , fRate(DefaultRate)
+    , fRateMode(tools::RateLimitMode::adaptive)
+    , fRateBurst(DefaultRateBurst)
     , fInitializationTimeoutInS(DefaultInitTimeout)
 {
     SubscribeToNewTransition("device", [&](Transition transition) {
         LOG(trace) << "device notified on new transition: " << transition;
         InterruptTransports();
+        fInputWakeup.Signal();
     });
 
     fStateMachine.PrepareState([&](State state) {
         LOG(trace) << "Resuming transports for " << state << " state";
         ResumeTransports();
+        fInputWakeup.Clear();
+    });
+
+    fConfig->Subscribe<string>("device-flight-recorder", [&](const string& key, string reason) {
+        if (key == "flight-recorder-freeze") {
+            FreezeFlightRecorder(reason.empty() ? "freeze requested" : reason);
+        }
+    });
+
+    // "chans.<name>.numSockets" resizes the channel while running, see ResizeChannel()
+    fConfig->SubscribeAsString("device-channel-resize", [&](const string& key, string value) {
+        const string suffix(".numSockets");
+        if (key.compare(0, 6, "chans.") != 0 || key.size() <= 6 + suffix.size()
+            || key.compare(key.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            return;
+        }
+        const string name(key.substr(6, key.size() - 6 - suffix.size()));
+        if (name.find('.') != string::npos) {
+            return;
+        }
+        try {
+            ResizeChannel(name, stoi(value));
+        } catch (const logic_error&) {
+            LOG(error) << "Invalid number of subchannels for channel " << name << ": " << value;
+        }
     });
 
     fStateMachine.HandleStates([&](State state) {
@@ -132,6 +311,9 @@ Device::Device(ProgOptions* config, tools::Version version)
             case State::Exiting:
                 Exit();
                 break;
+            case State::Error:
+                FreezeFlightRecorder("device error");
+                break;
             default:
                 LOG(trace) << "device notified on new state without a matching handler: " << state;
                 break;
@@ -146,13 +328,39 @@ void Device::InitWrapper()
 {
     // run initialization once CompleteInit transition is requested
     fStateMachine.WaitForPendingState();
+    StartupProfile::Scope phase("init-device");
 
     fId = fConfig->GetProperty<string>("id", DefaultId);
 
     Init();
 
     fRate = fConfig->GetProperty<float>("rate", DefaultRate);
+    fRateMode = tools::ParseRateLimitMode(fConfig->GetProperty<string>("rate-mode", DefaultRateMode));
+    fRateBurst = fConfig->GetProperty<unsigned int>("rate-burst", DefaultRateBurst);
+    fDataWorkers = fConfig->GetProperty<int>("data-workers", DefaultDataWorkers);
+    fInputDispatch = ParseInputDispatch(fConfig->GetProperty<string>("input-dispatch", DefaultInputDispatch));
+    fPerfCounters = fConfig->GetProperty<bool>("perf-counters", DefaultPerfCounters);
+    fChannelMetrics = fConfig->GetProperty<bool>("channel-metrics", DefaultChannelMetrics) || fPerfCounters;
+    fRunMetrics = fChannelMetrics ? make_shared<ChannelMetricsRecorder>(fPerfCounters) : nullptr;
+    InitFlightRecorder();
     fInitializationTimeoutInS = fConfig->GetProperty<int>("init-timeout", DefaultInitTimeout);
+    fThreadSettings = tools::ParseThreadSettings(fConfig->GetProperty<string>("cpu-affinity", DefaultCpuAffinity),
+                                                 fConfig->GetProperty<string>("sched-policy", DefaultSchedPolicy),
+                                                 fConfig->GetProperty<int>("sched-priority", DefaultSchedPriority));
+    // the device thread runs the state handlers (InitTask, Run, ...) and the data callbacks without data workers
+    ApplyThreadSettings("device thread");
+    if (fConfig->GetProperty<bool>("mlockall", DefaultMlockall)) {
+        if (tools::LockAllMemory()) {
+            LOG(debug) << "Locked all current and future memory of the process";
+        } else {
+            LOG(warn) << "Could not lock the memory of the process (mlockall): " << strerror(errno);
+        }
+    }
+    // process wide, for the payload copies of all transports
+    size_t copyThreshold = fConfig->GetProperty<size_t>("copy-engine-threshold", DefaultCopyEngineThreshold);
+    string copyEngine = tools::SetCopyEngine(fConfig->GetProperty<string>("copy-engine", DefaultCopyEngine), copyThreshold,
+                                             fConfig->GetProperty<string>("copy-engine-wq", ""));
+    LOG(debug) << "Payload copies of at least " << copyThreshold << " bytes use the " << copyEngine << " copy engine";
 
     try {
         fDefaultTransportType = TransportTypes.at(fConfig->GetProperty<string>("transport", DefaultTransportName));
@@ -162,25 +370,70 @@ void Device::InitWrapper()
         throw;
     }
 
+    // after a warm reset: keep the transports only if their configuration is unchanged
+    if (!fRetainedTransportConfig.empty() && fRetainedTransportConfig != TransportConfig(*fConfig)) {
+        LOG(info) << "Transport configuration changed since the reset, recreating transports and channels";
+        fRetainedChannels.clear();
+        ReleaseTransports();
+    }
+    fRetainedTransportConfig.clear();
+
+    // channels kept by a warm reset are reused if their configuration is unchanged, others are created
+    unordered_set<string> keptChannels;
     unordered_map<string, int> infos = fConfig->GetChannelInfo();
     for (const auto& info : infos) {
         for (int i = 0; i < info.second; ++i) {
-            GetChannels()[info.first].emplace_back(info.first, i, fConfig->GetPropertiesStartingWith(tools::ToString("chans.", info.first, ".", i, ".")));
+            const string key(tools::ToString(info.first, ".", i));
+            const string prefix(tools::ToString("chans.", key, "."));
+            map<string, string> config(fConfig->GetPropertiesAsStringStartingWith(prefix));
+            auto retained = fRetainedChannels.find(key);
+            if (retained != fRetainedChannels.end() && (retained->second.fInitConfig == config || retained->second.fAttachedConfig == config)) {
+                LOG(debug) << "Reusing channel " << key << " from before the reset";
+                Channel& chan = GetChannels()[info.first].emplace_back(std::move(retained->second.fChannel));
+                if (config != retained->second.fAttachedConfig) {
+                    fConfig->SetProperty(prefix + "address", chan.GetAddress()); // the address it is bound/connected to
+                }
+                keptChannels.insert(key);
+            } else {
+                GetChannels()[info.first].emplace_back(info.first, i, fConfig->GetPropertiesStartingWith(prefix));
+            }
+            fChannelInitConfig[key] = std::move(config);
         }
     }
+    fRetainedChannels.clear(); // closes the sockets of changed and removed channels
 
     LOG(debug) << "Setting '" << TransportNames.at(fDefaultTransportType) << "' as default transport for the device";
     fTransportFactory = AddTransport(fDefaultTransportType);
 
     string networkInterface = fConfig->GetProperty<string>("network-interface", DefaultNetworkInterface);
 
+    vector<string> flightRecorderChannels;
+    string flightRecorderChannelList = fConfig->GetProperty<string>("flight-recorder-channels", DefaultFlightRecorderChannels);
+    if (!flightRecorderChannelList.empty()) {
+        boost::algorithm::split(flightRecorderChannels, flightRecorderChannelList, boost::algorithm::is_any_of(","));
+    }
+    auto flightRecorder = [&](const string& name) {
+        bool tapped = flightRecorderChannels.empty() || find(flightRecorderChannels.begin(), flightRecorderChannels.end(), name) != flightRecorderChannels.end();
+        return tapped ? fFlightRecorder : nullptr;
+    };
+
     // Fill the uninitialized channel containers
     for (auto& channel : GetChannels()) {
         int subChannelIndex = 0;
         for (auto& subChannel : channel.second) {
+            if (keptChannels.count(tools::ToString(channel.first, ".", subChannelIndex++))) {
+                subChannel.EnableMetrics(fChannelMetrics, fPerfCounters);
+                subChannel.SetFlightRecorder(flightRecorder(channel.first));
+                continue; // already bound/connected
+            }
             // set channel transport
             LOG(debug) << "Initializing transport for channel " << subChannel.fName << ": " << TransportNames.at(subChannel.fTransportType);
             subChannel.InitTransport(AddTransport(subChannel.fTransportType));
+            if (subChannel.fHybrid && subChannel.fTransportType == Transport::SHM) {
+                subChannel.UpdateRemoteTransport(AddTransport(Transport::ZMQ));
+            }
+            subChannel.EnableMetrics(fChannelMetrics, fPerfCounters);
+            subChannel.SetFlightRecorder(flightRecorder(channel.first));
 
             if (subChannel.fMethod == "bind") {
                 // if binding address is not specified, try getting it from the configured network interface
@@ -208,8 +461,6 @@ void Device::InitWrapper()
                 LOG(error) << "Cannot update configuration. Socket method (bind/connect) for channel '" << subChannel.fName << "' not specified.";
                 throw runtime_error(tools::ToString("Cannot update configuration. Socket method (bind/connect) for channel ", subChannel.fName, " not specified."));
             }
-
-            subChannelIndex++;
         }
     }
 
@@ -220,6 +471,7 @@ void Device::BindWrapper()
 {
     // Bind channels. Here one run is enough, because bind settings should be available locally
     // If necessary this could be handled in the same way as the connecting channels
+    StartupProfile::Scope phase("bind");
     AttachChannels(fUninitializedBindingChannels);
 
     if (!fUninitializedBindingChannels.empty()) {
@@ -237,14 +489,28 @@ void Device::BindWrapper()
 void Device::ConnectWrapper()
 {
     // go over the list of channels until all are initialized (and removed from the uninitialized list)
-    int numAttempts = 1;
-    auto sleepTimeInMS = 50;
-    auto maxAttempts = fInitializationTimeoutInS * 1000 / sleepTimeInMS;
+    // retry when a channel address is updated in the config, or at the latest after retryInterval
+    const auto retryInterval = chrono::milliseconds(50);
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(fInitializationTimeoutInS);
+    AddressSubscription addressUpdates(tools::ToString("Device::ConnectWrapper-", fId), *fConfig);
     // first attempt
-    AttachChannels(fUninitializedConnectingChannels);
+    {
+        StartupProfile::Scope phase("connect");
+        AttachChannels(fUninitializedConnectingChannels);
+    }
     // if not all channels could be connected, update their address values from config and retry
+    const auto waitStart = chrono::steady_clock::now();
     while (!fUninitializedConnectingChannels.empty() && !NewStatePending()) {
-        this_thread::sleep_for(chrono::milliseconds(sleepTimeInMS));
+        if (chrono::steady_clock::now() > deadline) {
+            LOG(error) << "could not connect all channels within " << fInitializationTimeoutInS << " s";
+            LOG(error) << "following channels are still invalid:";
+            for (auto& chan : fUninitializedConnectingChannels) {
+                LOG(error) << "channel: " << *chan;
+            }
+            throw runtime_error(tools::ToString("could not connect all channels within ", fInitializationTimeoutInS, " s"));
+        }
+
+        addressUpdates.Wait(retryInterval);
 
         for (auto& chan : fUninitializedConnectingChannels) {
             string key{"chans." + chan->GetPrefix() + "." + chan->GetIndex() + ".address"};
@@ -254,22 +520,18 @@ void Device::ConnectWrapper()
             }
         }
 
-        if (numAttempts++ > maxAttempts) {
-            LOG(error) << "could not connect all channels after " << fInitializationTimeoutInS << " attempts";
-            LOG(error) << "following channels are still invalid:";
-            for (auto& chan : fUninitializedConnectingChannels) {
-                LOG(error) << "channel: " << *chan;
-            }
-            throw runtime_error(tools::ToString("could not connect all channels after ", fInitializationTimeoutInS, " attempts"));
-        }
-
         AttachChannels(fUninitializedConnectingChannels);
     }
+    if (chrono::steady_clock::now() - waitStart > chrono::milliseconds(1)) {
+        StartupProfile::Add("connect-wait", waitStart, chrono::steady_clock::now()); // peers not yet bound/announced
+    }
 
     if (GetChannels().empty()) {
         LOG(warn) << "No channels created after finishing initialization";
     }
 
+    InitRoutes();
+
     Connect();
 
     if (!NewStatePending()) {
@@ -279,59 +541,60 @@ void Device::ConnectWrapper()
 
 void Device::AttachChannels(vector<Channel*>& chans)
 {
-    auto itr = chans.begin();
-
-    while (itr != chans.end()) {
-        if ((*itr)->Validate()) {
-            (*itr)->Init();
-            if (AttachChannel(**itr)) {
-                // remove the channel from the uninitialized container
-                itr = chans.erase(itr);
-            } else {
-                LOG(error) << "failed to attach channel " << (*itr)->fName << " (" << (*itr)->fMethod << ")";
-                ++itr;
+    vector<Channel*> validChans;
+    copy_if(chans.begin(), chans.end(), back_inserter(validChans), [](Channel* chan) { return chan->Validate(); });
+
+    // host name resolution is the slow part of attaching many channels, do it up front for all of them
+    const auto resolveStart = chrono::steady_clock::now();
+    const unordered_map<string, string> resolvedHosts = ResolveHosts(validChans);
+    StartupProfile::Add("resolve-hosts", resolveStart, chrono::steady_clock::now());
+
+    unordered_set<Channel*> attached;
+    for (Channel* chan : validChans) {
+        // multiplexed subchannels share the connection of the first one connected to the same address
+        const bool mux = chan->fMux && chan->fMethod == "connect";
+        const string muxKey = mux ? tools::ToString(chan->GetPrefix(), ":", static_cast<int>(chan->fTransportType), ":", chan->fAddress) : "";
+        if (auto carrier = fMuxCarriers.find(muxKey); mux && carrier != fMuxCarriers.end()) {
+            chan->InitShared(*carrier->second);
+            attached.insert(chan);
+            LOG(debug) << "Attached channel " << chan->fName << " to the connection of " << carrier->second->fName << " (mux)";
+            continue;
+        }
+        chan->Init();
+        if (AttachChannel(*chan, resolvedHosts)) {
+            attached.insert(chan);
+            if (mux) {
+                fMuxCarriers.emplace(muxKey, chan);
             }
         } else {
-            ++itr;
+            LOG(error) << "failed to attach channel " << chan->fName << " (" << chan->fMethod << ")";
         }
     }
+
+    // remove the attached channels from the uninitialized container
+    chans.erase(remove_if(chans.begin(), chans.end(), [&](Channel* chan) { return attached.count(chan) > 0; }), chans.end());
 }
 
-bool Device::AttachChannel(Channel& chan)
+bool Device::AttachChannel(Channel& chan, const unordered_map<string, string>& resolvedHosts)
 {
     vector<string> endpoints;
     string chanAddress = chan.GetAddress();
     boost::algorithm::split(endpoints, chanAddress, boost::algorithm::is_any_of(","));
 
     for (auto& endpoint : endpoints) {
-        // attach
-        bool bind = (chan.GetMethod() == "bind");
-        bool connectionModifier = false;
-        string address = endpoint;
-
-        // check if the default fMethod is overridden by a modifier
-        if (endpoint[0] == '+' || endpoint[0] == '>') {
-            connectionModifier = true;
-            bind = false;
-            address = endpoint.substr(1);
-        } else if (endpoint[0] == '@') {
-            connectionModifier = true;
-            bind = true;
-            address = endpoint.substr(1);
-        }
-
-        if (address.compare(0, 6, "tcp://") == 0) {
-            string addressString = address.substr(6);
-            auto pos = addressString.find(':');
-            string hostPart = addressString.substr(0, pos);
-            if (!(bind && hostPart == "*")) {
-                string portPart = addressString.substr(pos + 1);
-                string resolvedHost = tools::getIpFromHostname(hostPart);
-                if (resolvedHost.empty()) {
-                    return false;
-                }
-                address.assign("tcp://" + resolvedHost + ":" + portPart);
+        // attach, check if the default fMethod is overridden by a modifier
+        Endpoint ep = ParseEndpoint(endpoint, chan.GetMethod() == "bind");
+        bool bind = ep.bind;
+        string address = ep.address;
+
+        string host = HostToResolve(ep);
+        if (!host.empty()) {
+            auto it = resolvedHosts.find(host);
+            string resolvedHost = (it != resolvedHosts.end()) ? it->second : tools::getIpFromHostname(host);
+            if (resolvedHost.empty()) {
+                return false;
             }
+            address.assign("tcp://" + resolvedHost + address.substr(6 + host.size()));
         }
 
         bool success = true;
@@ -345,7 +608,7 @@ bool Device::AttachChannel(Channel& chan)
         // bind might bind to an address different than requested,
         // put the actual address back in the config
         endpoint.clear();
-        if (connectionModifier) {
+        if (ep.modifier) {
             endpoint.push_back(bind?'@':'+');
         }
         endpoint += address;
@@ -370,9 +633,42 @@ bool Device::AttachChannel(Channel& chan)
     return true;
 }
 
+void Device::InitRoutes()
+{
+    fRoutes.clear();
+    for (const auto& [name, subChannels] : GetChannels()) {
+        if (subChannels.empty() || subChannels.front().GetRoute() != "hash") {
+            continue;
+        }
+        // the addresses identify the subchannels on the ring, repeated ones (e.g. of multiplexed channels) are numbered
+        vector<string> nodes;
+        unordered_map<string, int> seen;
+        for (const auto& subChannel : subChannels) {
+            int n = seen[subChannel.GetAddress()]++;
+            nodes.push_back(n == 0 ? subChannel.GetAddress() : tools::ToString(subChannel.GetAddress(), "#", n));
+        }
+        fRoutes.emplace(name, HashRing(nodes));
+        LOG(debug) << "Routing the messages of channel " << name << " by hash over " << nodes.size() << " subchannels";
+    }
+}
+
+uint64_t Device::DefaultRouteKey(const Message& header)
+{
+    uint64_t key = 0;
+    if (header.GetSize() >= sizeof(key)) {
+        memcpy(&key, header.GetData(), sizeof(key));
+    }
+    return key;
+}
+
 void Device::InitTaskWrapper()
 {
-    InitTask();
+    {
+        StartupProfile::Scope phase("init-task");
+        InitTask();
+    }
+    // the first device of the process reaching READY completes the startup profile
+    StartupProfile::Complete();
 
     if (!NewStatePending()) {
         ChangeStateOrThrow(Transition::Auto);
@@ -396,25 +692,44 @@ void Device::RunWrapper()
         if (rateLogging && rateLogger->joinable()) { rateLogger->join(); }
     });
 
-    // change to Error state in case of an exception, to release LogSocketRates
+    unique_ptr<thread> tuner;
+    if (any_of(GetChannels().cbegin(), GetChannels().cend(), [](const auto& ch) {
+            return any_of(ch.second.cbegin(), ch.second.cend(), [](const auto& sub) { return sub.fTuner != nullptr; });
+        })) {
+        tuner = make_unique<thread>(&Device::TuneChannels, this);
+    }
+    tools::CallOnDestruction joinTuner([&](){
+        if (tuner && tuner->joinable()) { tuner->join(); }
+    });
+
+    // change to Error state in case of an exception, to release LogSocketRates and TuneChannels
     tools::CallOnDestruction cod([&](){
         ChangeStateOrThrow(Transition::ErrorFound);
     });
 
     PreRun();
+    StartTimers();
 
     // process either data callbacks or ConditionalRun/Run
     if (fDataCallbacks) {
+        ResolveInputs();
         // if only one input channel, do lightweight handling without additional polling.
-        if (fInputChannelKeys.size() == 1 && GetChannels().at(fInputChannelKeys.at(0)).size() == 1) {
+        // (timers need the poll loop)
+        if (fInputChannelKeys.size() == 1 && GetChannels().at(fInputChannelKeys.at(0)).size() == 1 && fTimers.empty()) {
             HandleSingleChannelInput();
         } else {// otherwise do full handling with polling
             HandleMultipleChannelInput();
         }
     } else {
-        tools::RateLimiter rateLimiter(fRate);
+        tools::RateLimiter rateLimiter(fRate, fRateMode, fRateBurst);
 
-        while (!NewStatePending() && ConditionalRun()) {
+        auto conditionalRun = [this]() { return fRunMetrics ? fRunMetrics->TimeHandler([this]() { return ConditionalRun(); }) : ConditionalRun(); };
+        while (!NewStatePending() && conditionalRun()) {
+            DispatchSends();
+            ApplyChannelResizes();
+            if (int timeout = -1; !RunTimers(timeout)) {
+                break;
+            }
             if (fRate > 0.001) {
                 rateLimiter.maybe_sleep();
             }
@@ -436,14 +751,28 @@ void Device::RunWrapper()
 void Device::HandleSingleChannelInput()
 {
     bool proceed = true;
+    Channel& channel = GetChannel(fInputChannelKeys.at(0), 0);
 
     if (!fMsgInputs.empty()) {
+        const auto& handler = fMsgInputs.begin()->second;
         while (!NewStatePending() && proceed) {
-            proceed = HandleMsgInput(fInputChannelKeys.at(0), fMsgInputs.begin()->second, 0);
+            proceed = HandleMsgInput(channel, handler, 0);
+            DispatchSends();
+            ApplyChannelResizes();
         }
     } else if (!fMultipartInputs.empty()) {
+        const auto& handler = fMultipartInputs.begin()->second;
         while (!NewStatePending() && proceed) {
-            proceed = HandleMultipartInput(fInputChannelKeys.at(0), fMultipartInputs.begin()->second, 0);
+            proceed = HandleMultipartInput(channel, handler, 0);
+            DispatchSends();
+            ApplyChannelResizes();
+        }
+    } else if (!fBatchInputs.empty()) {
+        const auto& batchInput = fBatchInputs.begin()->second;
+        while (!NewStatePending() && proceed) {
+            proceed = HandleBatchInput(channel, batchInput.first, batchInput.second, 0);
+            DispatchSends();
+            ApplyChannelResizes();
         }
     }
 }
@@ -474,26 +803,58 @@ void Device::HandleMultipleChannelInput()
         }
     }
 
-    // if more than one transport is used, handle poll of each in a separate thread
-    if (fMultitransportInputs.size() > 1) {
+    for (const auto& mi : fBatchInputs) {
+        for (auto& i : GetChannels().at(mi.first)) {
+            i.fMultipart = false;
+        }
+    }
+
+    if (fDataWorkers > 0) {
+        HandleInputWithWorkers();
+    } else if (fMultitransportInputs.size() > 1) { // if more than one transport is used, handle poll of each in a separate thread
         HandleMultipleTransportInput();
+    } else if (const auto items(PollItems(fInputChannelKeys)); HasPriorityLanes(items)) {
+        HandlePriorityLaneInput(GetChannel(fInputChannelKeys.at(0), 0).fTransportFactory.get(), items, 200, false);
     } else { // otherwise poll directly
         bool proceed = true;
 
         PollerPtr poller(GetChannel(fInputChannelKeys.at(0), 0).fTransportFactory->CreatePoller(GetChannels(), fInputChannelKeys));
+        // with the wakeup the poller returns on a new transition, the timeout only applies to pollers without one
+        const int timeout = poller->AddWakeup(fInputWakeup.Fd()) ? -1 : 200;
+        const auto pollItems(PollItems(fInputChannelKeys));
+        auto scheduler(CreateInputScheduler(pollItems));
+        vector<int> ready;
 
         while (!NewStatePending() && proceed) {
-            poller->Poll(200);
+            ApplyChannelResizes();
+            // queued sends are retried at least every kQueuedSendsPollMs, timers wake up the poller for their next tick
+            int pollTimeout = DispatchSends() > 0 ? kQueuedSendsPollMs : timeout;
+            if (!RunTimers(pollTimeout)) {
+                break;
+            }
+            poller->Poll(pollTimeout);
+
+            if (scheduler) {
+                proceed = HandleScheduledInputs(*poller, pollItems, *scheduler, ready, false);
+                continue;
+            }
+
+            // pollers that track the ready inputs save checking every (sub)channel
+            if (poller->ReadyInputs(ready)) {
+                for (int index : ready) {
+                    proceed = HandleChannelInput(*pollItems.at(index).first, pollItems.at(index).second);
+                    if (!proceed) {
+                        break;
+                    }
+                }
+                continue;
+            }
 
             // check which inputs are ready and call their data handlers if they are.
             for (const auto& ch : fInputChannelKeys) {
                 for (unsigned int i = 0; i < GetChannels().at(ch).size(); ++i) {
                     if (poller->CheckInput(ch, i)) {
-                        if (GetChannel(ch, i).fMultipart) {
-                            proceed = HandleMultipartInput(ch, fMultipartInputs.at(ch), i);
-                        } else {
-                            proceed = HandleMsgInput(ch, fMsgInputs.at(ch), i);
-                        }
+                        proceed = HandleChannelInput(ch, i);
 
                         if (!proceed) {
                             break;
@@ -508,77 +869,565 @@ void Device::HandleMultipleChannelInput()
     }
 }
 
+size_t Device::DispatchSends()
+{
+    size_t queued = 0;
+    for (auto& channel : GetChannels()) {
+        for (auto& sub : channel.second) {
+            // spilled messages are sent by the sender thread of shared send paths
+            const bool spilled = !sub.fSharedSend && sub.GetNumSpilled() > 0;
+            if (sub.GetNumQueuedSends() > 0 || spilled) {
+                sub.DispatchSends();
+                queued += sub.GetNumQueuedSends() + (sub.fSharedSend ? 0 : sub.GetNumSpilled());
+            }
+        }
+    }
+    return queued;
+}
+
+void Device::ResizeChannel(const string& channelName, int numSubChannels)
+{
+    if (numSubChannels < 1) {
+        LOG(error) << "Cannot resize channel " << channelName << " to " << numSubChannels << " subchannels, at least one is needed";
+        return;
+    }
+    if (fDataWorkers > 0) {
+        LOG(error) << "Cannot resize channel " << channelName << ", channels are not resizable with data workers";
+        return;
+    }
+    lock_guard<mutex> lock(fResizeMtx);
+    fPendingResizes[channelName] = numSubChannels;
+    fResizePending.store(true, memory_order_release);
+}
+
+size_t Device::ApplyChannelResizes()
+{
+    if (!fResizePending.load(memory_order_acquire)) {
+        return 0;
+    }
+    unordered_map<string, int> resizes;
+    {
+        lock_guard<mutex> lock(fResizeMtx);
+        resizes.swap(fPendingResizes);
+        fResizePending.store(false, memory_order_relaxed);
+    }
+    size_t resized = 0;
+    for (const auto& [name, numSubChannels] : resizes) {
+        if (ResizeChannelNow(name, numSubChannels)) {
+            ++resized;
+            SubChannelsChanged(name);
+        }
+    }
+    return resized;
+}
+
+bool Device::ResizeChannelNow(const string& name, int numSubChannels)
+{
+    auto channel = GetChannels().find(name);
+    if (channel == GetChannels().end()) {
+        LOG(error) << "Cannot resize channel " << name << ", it does not exist";
+        return false;
+    }
+    vector<Channel>& subChannels = channel->second;
+    if (find(fInputChannelKeys.begin(), fInputChannelKeys.end(), name) != fInputChannelKeys.end()) {
+        LOG(error) << "Cannot resize input channel " << name;
+        return false;
+    }
+    if (any_of(subChannels.begin(), subChannels.end(), [](const Channel& sub) { return sub.fMux || sub.fSharedSend; })) {
+        LOG(error) << "Cannot resize channel " << name << ", multiplexed (mux) and shared send (sharedSend) channels are not resizable";
+        return false;
+    }
+    const int current = static_cast<int>(subChannels.size());
+    if (numSubChannels == current) {
+        return false;
+    }
+
+    // the new subchannels are attached before they are added, a failure leaves the channel as it is
+    vector<Channel> added;
+    vector<Properties> addedProps;
+    if (numSubChannels > current) {
+        const string lastPrefix(tools::ToString("chans.", name, ".", current - 1, "."));
+        const Properties lastProps(fConfig->GetPropertiesStartingWith(lastPrefix));
+        added.reserve(numSubChannels - current);
+        for (int i = current; i < numSubChannels; ++i) {
+            const string prefix(tools::ToString("chans.", name, ".", i, "."));
+            Properties props;
+            for (const auto& [key, value] : lastProps) {
+                props.emplace(prefix + key.substr(lastPrefix.size()), value);
+            }
+            for (auto& [key, value] : fConfig->GetPropertiesStartingWith(prefix)) {
+                props[key] = std::move(value);
+            }
+            Channel& sub = added.emplace_back(name, i, props);
+            sub.InitTransport(AddTransport(sub.fTransportType));
+            if (sub.fHybrid && sub.fTransportType == Transport::SHM) {
+                sub.UpdateRemoteTransport(AddTransport(Transport::ZMQ));
+            }
+            sub.EnableMetrics(fChannelMetrics, fPerfCounters);
+            sub.SetFlightRecorder(subChannels.back().fFlightRecorder);
+            if (!sub.Validate()) {
+                LOG(error) << "Cannot resize channel " << name << ", subchannel " << i << " is invalid";
+                return false;
+            }
+            sub.Init();
+            if (!AttachChannel(sub, {})) {
+                LOG(error) << "Cannot resize channel " << name << ", failed to attach subchannel " << i << " (" << sub.fMethod << ")";
+                return false;
+            }
+            props[prefix + "address"] = boost::any(sub.GetAddress());
+            addedProps.push_back(std::move(props));
+        }
+    }
+
+    vector<Channel> removed;
+    {
+        lock_guard<mutex> lock(fChannelsMtx);
+        if (numSubChannels > current) {
+            for (auto& sub : added) {
+                subChannels.push_back(std::move(sub));
+            }
+        } else {
+            removed.insert(removed.end(), make_move_iterator(subChannels.begin() + numSubChannels), make_move_iterator(subChannels.end()));
+            subChannels.erase(subChannels.begin() + numSubChannels, subChannels.end());
+        }
+        ++fChannelsGeneration;
+    }
+    removed.clear(); // closes the sockets, outside of the lock
+
+    for (int i = current; i < numSubChannels; ++i) {
+        fConfig->SetProperties(addedProps.at(i - current));
+        const string key(tools::ToString(name, ".", i));
+        fChannelInitConfig[key] = fConfig->GetPropertiesAsStringStartingWith(tools::ToString("chans.", key, "."));
+    }
+    for (int i = numSubChannels; i < current; ++i) {
+        const string key(tools::ToString(name, ".", i));
+        const string prefix(tools::ToString("chans.", key, "."));
+        for (const auto& property : fConfig->GetPropertyKeys()) {
+            if (property.compare(0, prefix.size(), prefix) == 0) {
+                fConfig->DeleteProperty(property);
+            }
+        }
+        fChannelInitConfig.erase(key);
+    }
+    InitRoutes();
+
+    LOG(info) << "Resized channel " << name << " from " << current << " to " << numSubChannels << " subchannels";
+    return true;
+}
+
 void Device::HandleMultipleTransportInput()
 {
     vector<thread> threads;
 
     fMultitransportProceed = true;
+    fInputThreadError = nullptr;
 
     for (const auto& i : fMultitransportInputs) {
         threads.emplace_back(thread(&Device::PollForTransport, this, fTransports.at(i.first).get(), i.second));
     }
 
+    RunSharedTimers();
+
     for (thread& t : threads) {
         t.join();
     }
+
+    if (fInputThreadError) {
+        rethrow_exception(fInputThreadError);
+    }
 }
 
 void Device::PollForTransport(const TransportFactory* factory, const vector<string>& channelKeys)
 {
+    ApplyThreadSettings("input thread");
     try {
+        const auto pollItems(PollItems(channelKeys));
+        if (HasPriorityLanes(pollItems)) {
+            HandlePriorityLaneInput(factory, pollItems, 500, true);
+            return;
+        }
         PollerPtr poller(factory->CreatePoller(GetChannels(), channelKeys));
+        const int timeout = poller->AddWakeup(fInputWakeup.Fd()) ? -1 : 500;
+        auto scheduler(CreateInputScheduler(pollItems));
+        vector<int> ready;
 
         while (!NewStatePending() && fMultitransportProceed) {
-            poller->Poll(500);
+            poller->Poll(timeout);
 
-            for (const auto& ch : channelKeys) {
-                for (unsigned int i = 0; i < GetChannels().at(ch).size(); ++i) {
-                    if (poller->CheckInput(ch, i)) {
-                        lock_guard<mutex> lock(fMultitransportMutex);
+            if (scheduler) {
+                if (!HandleScheduledInputs(*poller, pollItems, *scheduler, ready, true)) {
+                    StopInputThreads();
+                }
+                continue;
+            }
 
-                        if (!fMultitransportProceed) {
-                            break;
-                        }
+            CollectReadyInputs(*poller, pollItems.size(), ready);
 
-                        if (GetChannel(ch, i).fMultipart) {
-                            fMultitransportProceed = HandleMultipartInput(ch, fMultipartInputs.at(ch), i);
-                        } else {
-                            fMultitransportProceed = HandleMsgInput(ch, fMsgInputs.at(ch), i);
-                        }
+            for (int index : ready) {
+                if (!HandleSharedInput(*pollItems.at(index).first, pollItems.at(index).second)) {
+                    StopInputThreads();
+                    break;
+                }
+            }
+        }
+    } catch (exception& e) {
+        LOG(error) << "fair::mq::Device::PollForTransport() failed: " << e.what() << ", going to ERROR state.";
+        StoreInputThreadError();
+    }
+}
 
-                        if (!fMultitransportProceed) {
-                            break;
-                        }
-                    }
+void Device::HandleInputWithWorkers()
+{
+    // subchannels are distributed round-robin over the workers of their transport,
+    // each worker polls its own subchannels, which keeps the callbacks of a subchannel in order
+    vector<thread> threads;
+    fMultitransportProceed = true;
+    fInputThreadError = nullptr;
+
+    for (const auto& i : fMultitransportInputs) {
+        const auto items(PollItems(i.second));
+        const size_t numWorkers = min(static_cast<size_t>(fDataWorkers), items.size());
+        vector<vector<pair<const string*, int>>> workerItems(numWorkers);
+        for (size_t n = 0; n < items.size(); ++n) {
+            workerItems.at(n % numWorkers).push_back(items.at(n));
+        }
+        for (auto& wi : workerItems) {
+            threads.emplace_back(&Device::DataWorker, this, fTransports.at(i.first).get(), move(wi));
+        }
+    }
+    LOG(debug) << "Handling " << fInputChannelKeys.size() << " input channel(s) with " << threads.size() << " data worker(s)";
+
+    RunSharedTimers();
+
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    if (fInputThreadError) {
+        rethrow_exception(fInputThreadError);
+    }
+}
+
+void Device::DataWorker(const TransportFactory* factory, const vector<pair<const string*, int>>& items)
+{
+    ApplyThreadSettings("data worker");
+    try {
+        if (HasPriorityLanes(items)) {
+            HandlePriorityLaneInput(factory, items, 200, true);
+            return;
+        }
+        vector<Channel*> channels;
+        for (const auto& item : items) {
+            channels.push_back(&GetChannel(*item.first, item.second));
+        }
+        PollerPtr poller(factory->CreatePoller(channels));
+        const int timeout = poller->AddWakeup(fInputWakeup.Fd()) ? -1 : 200;
+        auto scheduler(CreateInputScheduler(items));
+        vector<int> ready;
+
+        while (!NewStatePending() && fMultitransportProceed) {
+            poller->Poll(timeout);
+
+            if (scheduler) {
+                if (!HandleScheduledInputs(*poller, items, *scheduler, ready, true)) {
+                    StopInputThreads();
                 }
-                if (!fMultitransportProceed) {
+                continue;
+            }
+
+            CollectReadyInputs(*poller, items.size(), ready);
+
+            for (int index : ready) {
+                if (!HandleSharedInput(*items.at(index).first, items.at(index).second)) {
+                    StopInputThreads();
                     break;
                 }
             }
         }
     } catch (exception& e) {
-        LOG(error) << "fair::mq::Device::PollForTransport() failed: " << e.what() << ", going to ERROR state.";
-        throw runtime_error(tools::ToString("fair::mq::Device::PollForTransport() failed: ", e.what(), ", going to ERROR state."));
+        LOG(error) << "fair::mq::Device::DataWorker() failed: " << e.what() << ", going to ERROR state.";
+        StoreInputThreadError();
+    }
+}
+
+bool Device::HandleSharedInput(const string& chName, int i)
+{
+    if (fThreadSafeInputs.count(chName) > 0) {
+        return fMultitransportProceed && HandleChannelInput(chName, i);
+    }
+
+    lock_guard<mutex> lock(fMultitransportMutex);
+    return fMultitransportProceed && HandleChannelInput(chName, i);
+}
+
+void Device::StartTimers()
+{
+    const auto now = chrono::steady_clock::now();
+    for (auto& timer : fTimers) {
+        timer.fNext = now + timer.fInterval;
+    }
+}
+
+bool Device::RunTimers(int& timeout)
+{
+    if (fTimers.empty()) {
+        return true;
+    }
+    auto now = chrono::steady_clock::now();
+    for (auto& timer : fTimers) {
+        if (timer.fNext <= now) {
+            if (!timer.fCallback()) {
+                return false;
+            }
+            now = chrono::steady_clock::now();
+            timer.fNext += timer.fInterval;
+            if (timer.fNext <= now) {
+                timer.fNext = now + timer.fInterval; // skip the missed ticks
+            }
+        }
+        auto untilNext = static_cast<int>(chrono::duration_cast<chrono::milliseconds>(timer.fNext - now).count() + 1);
+        timeout = timeout < 0 ? untilNext : min(timeout, untilNext);
+    }
+    return true;
+}
+
+void Device::RunSharedTimers()
+{
+    try {
+        while (!fTimers.empty() && !NewStatePending() && fMultitransportProceed) {
+            int timeout = -1;
+            {
+                lock_guard<mutex> lock(fMultitransportMutex);
+                if (!RunTimers(timeout)) {
+                    StopInputThreads();
+                    break;
+                }
+            }
+            // the wakeup is signalled on new transitions and when an input thread stops
+            pollfd wakeup{fInputWakeup.Fd(), POLLIN, 0};
+            poll(&wakeup, 1, timeout);
+        }
+    } catch (exception& e) {
+        LOG(error) << "fair::mq::Device timer callback failed: " << e.what() << ", going to ERROR state.";
+        StoreInputThreadError();
+    }
+}
+
+void Device::ApplyThreadSettings(const char* thread) const
+{
+    if (!fThreadSettings.Empty() && !tools::ApplyThreadSettings(fThreadSettings)) {
+        LOG(warn) << "Could not apply the CPU affinity/scheduling settings to the " << thread << ": " << strerror(errno);
+    }
+}
+
+void Device::StoreInputThreadError()
+{
+    lock_guard<mutex> lock(fMultitransportMutex);
+    if (!fInputThreadError) {
+        fInputThreadError = current_exception();
+    }
+    StopInputThreads();
+}
+
+void Device::StopInputThreads()
+{
+    fMultitransportProceed = false;
+    fInputWakeup.Signal(); // the other input threads may be blocked in Poll()
+}
+
+vector<pair<const string*, int>> Device::PollItems(const vector<string>& channelKeys)
+{
+    vector<pair<const string*, int>> items;
+    for (const auto& ch : channelKeys) {
+        for (unsigned int i = 0; i < GetChannels().at(ch).size(); ++i) {
+            items.emplace_back(&ch, i);
+        }
+    }
+    return items;
+}
+
+bool Device::HasPriorityLanes(const vector<pair<const string*, int>>& items)
+{
+    return any_of(items.begin(), items.end(), [&](const auto& item) { return GetChannel(*item.first, item.second).fLane != nullptr; });
+}
+
+unique_ptr<InputScheduler> Device::CreateInputScheduler(const vector<pair<const string*, int>>& items) const
+{
+    if (fInputDispatch == InputDispatch::order) {
+        return nullptr;
+    }
+    vector<InputPriority> inputs;
+    for (const auto& item : items) {
+        auto it = fInputPriorities.find(*item.first);
+        inputs.push_back(it != fInputPriorities.end() ? it->second : InputPriority());
+    }
+    return make_unique<InputScheduler>(fInputDispatch, std::move(inputs));
+}
+
+bool Device::HandleScheduledInputs(Poller& poller, const vector<pair<const string*, int>>& items, InputScheduler& scheduler, vector<int>& ready, bool shared)
+{
+    scheduler.NewIteration();
+    for (int handled = 0; handled < kMaxScheduledInputs; ++handled) {
+        CollectReadyInputs(poller, items.size(), ready);
+        scheduler.SetReady(ready);
+        const int index = scheduler.Next();
+        if (index < 0) {
+            break;
+        }
+        const auto& item = items.at(index);
+        if (!(shared ? HandleSharedInput(*item.first, item.second) : HandleChannelInput(*item.first, item.second))) {
+            return false;
+        }
+        if (NewStatePending() || (shared && !fMultitransportProceed)) {
+            break;
+        }
+        poller.Poll(0);
+    }
+    return true;
+}
+
+void Device::CollectReadyInputs(Poller& poller, size_t numItems, vector<int>& ready)
+{
+    if (!poller.ReadyInputs(ready)) {
+        ready.clear();
+        for (size_t i = 0; i < numItems; ++i) {
+            if (poller.CheckInput(i)) {
+                ready.push_back(i);
+            }
+        }
+    }
+}
+
+void Device::HandlePriorityLaneInput(const TransportFactory* factory, const vector<pair<const string*, int>>& items, int timeout, bool shared)
+{
+    // the priority lanes are polled in front of all channel sockets, so that their inputs are handled first
+    // (the receive of an input with a lane takes the message from the lane first)
+    vector<Channel*> channels;
+    vector<size_t> inputs; // input index of every poll item
+    for (size_t i = 0; i < items.size(); ++i) {
+        Channel& ch = GetChannel(*items.at(i).first, items.at(i).second);
+        if (ch.fLane) {
+            channels.push_back(ch.fLane.get());
+            inputs.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < items.size(); ++i) {
+        channels.push_back(&GetChannel(*items.at(i).first, items.at(i).second));
+        inputs.push_back(i);
+    }
+    PollerPtr poller(factory->CreatePoller(channels));
+    if (poller->AddWakeup(fInputWakeup.Fd())) {
+        timeout = -1;
+    }
+    vector<int> ready;
+    vector<bool> handled(items.size());
+    bool proceed = true;
+
+    while (!NewStatePending() && proceed && (!shared || fMultitransportProceed)) {
+        int pollTimeout = timeout;
+        if (!shared && !RunTimers(pollTimeout)) { // shared: the device thread runs the timers
+            break;
+        }
+        poller->Poll(pollTimeout);
+
+        if (poller->ReadyInputs(ready)) {
+            sort(ready.begin(), ready.end());
+        } else {
+            ready.clear();
+            for (size_t i = 0; i < channels.size(); ++i) {
+                if (poller->CheckInput(i)) {
+                    ready.push_back(i);
+                }
+            }
+        }
+
+        fill(handled.begin(), handled.end(), false);
+        for (int index : ready) {
+            size_t input = inputs.at(index);
+            if (handled.at(input)) {
+                continue;
+            }
+            handled.at(input) = true;
+            const auto& item = items.at(input);
+            proceed = shared ? HandleSharedInput(*item.first, item.second) : HandleChannelInput(*item.first, item.second);
+            if (!proceed) {
+                if (shared) {
+                    StopInputThreads();
+                }
+                break;
+            }
+        }
     }
 }
 
-bool Device::HandleMsgInput(const string& chName, const InputMsgCallback& callback, int i)
+void Device::ResolveInputs()
 {
-    unique_ptr<Message> input(GetChannel(chName, i).fTransportFactory->CreateMessage());
+    fResolvedInputs.clear();
+    for (const auto& name : fInputChannelKeys) {
+        ResolvedInput& input = fResolvedInputs[name];
+        if (auto mi = fMsgInputs.find(name); mi != fMsgInputs.end()) {
+            input.fMsg = &mi->second;
+        }
+        if (auto mi = fMultipartInputs.find(name); mi != fMultipartInputs.end()) {
+            input.fMultipart = &mi->second;
+        }
+        if (auto bi = fBatchInputs.find(name); bi != fBatchInputs.end()) {
+            input.fBatch = &bi->second;
+        }
+        for (auto& sub : GetChannels().at(name)) {
+            input.fSubChannels.push_back(&sub);
+        }
+    }
+}
 
-    if (Receive(input, chName, i) >= 0) {
-        return callback(input, i);
+bool Device::HandleChannelInput(const string& chName, int i)
+{
+    const ResolvedInput& input = fResolvedInputs.at(chName);
+    Channel& channel = *input.fSubChannels.at(i);
+    if (channel.fMultipart && input.fMultipart) {
+        return HandleMultipartInput(channel, *input.fMultipart, i);
+    } else if (input.fBatch) {
+        return HandleBatchInput(channel, input.fBatch->first, input.fBatch->second, i);
+    } else {
+        return HandleMsgInput(channel, *input.fMsg, i);
+    }
+}
+
+bool Device::HandleMsgInput(Channel& channel, const InputHandler<MessagePtr>& handler, int i)
+{
+    unique_ptr<Message> input(channel.fTransportFactory->CreateMessage());
+
+    if (channel.Receive(input) >= 0) {
+        return channel.TimedHandler([&] { return handler(*this, input, i); });
     } else {
         return false;
     }
 }
 
-bool Device::HandleMultipartInput(const string& chName, const InputMultipartCallback& callback, int i)
+bool Device::HandleBatchInput(Channel& channel, const InputBatchCallback& callback, size_t maxBatch, int i)
 {
-    Parts input;
+    vector<MessagePtr> input;
+    input.reserve(maxBatch);
 
-    if (Receive(input, chName, i) >= 0) {
-        return callback(input, i);
+    if (channel.ReceiveBatch(input, maxBatch) >= 0) {
+        return channel.TimedHandler([&] { return callback(input, i); });
+    } else {
+        return false;
+    }
+}
+
+bool Device::HandleMultipartInput(Channel& channel, const InputHandler<Parts>& handler, int i)
+{
+    // reused per thread, so that the container keeps its capacity across receives (unless the callback moves the parts away)
+    thread_local Parts input;
+    struct ClearParts
+    {
+        Parts& parts;
+        ~ClearParts() { parts.Clear(); }
+    } clear{input};
+
+    if (channel.Receive(input) >= 0) {
+        return channel.TimedHandler([&] { return handler(*this, input, i); });
     } else {
         return false;
     }
@@ -595,8 +1444,14 @@ shared_ptr<TransportFactory> Device::AddTransport(mq::Transport transport)
     auto i = fTransports.find(transport);
 
     if (i == fTransports.end()) {
-        LOG(debug) << "Adding '" << TransportNames.at(transport) << "' transport";
-        auto tr = TransportFactory::CreateTransportFactory(TransportNames.at(transport), fId, fConfig);
+        shared_ptr<TransportFactory> tr;
+        StartupProfile::Scope phase("transport-" + TransportNames.at(transport));
+        if (fTransportRegistry) {
+            tr = fTransportRegistry->Get(transport, fId, fConfig);
+        } else {
+            LOG(debug) << "Adding '" << TransportNames.at(transport) << "' transport";
+            tr = TransportFactory::CreateTransportFactory(TransportNames.at(transport), fId, fConfig);
+        }
         fTransports.insert({transport, tr});
         return tr;
     } else {
@@ -611,8 +1466,72 @@ void Device::SetConfig(ProgOptions& config)
     fConfig = &config;
 }
 
+vector<ChannelMetrics> Device::GetChannelMetrics() const
+{
+    vector<ChannelMetrics> metrics;
+    lock_guard<mutex> lock(fChannelsMtx);
+    for (const auto& channel : GetChannels()) {
+        for (const auto& subChannel : channel.second) {
+            metrics.push_back(subChannel.GetMetrics());
+        }
+    }
+    return metrics;
+}
+
+ChannelMetrics Device::GetRunMetrics() const
+{
+    ChannelMetrics metrics;
+    metrics.name = "ConditionalRun";
+    if (auto recorder = fRunMetrics) {
+        recorder->Fill(metrics);
+    }
+    return metrics;
+}
+
+vector<TransportMetric> Device::GetTransportMetrics()
+{
+    lock_guard<mutex> lock(fTransportMtx);
+    vector<TransportMetric> metrics;
+    for (auto& [transportType, transport] : fTransports) {
+        for (auto& metric : transport->GetMetrics()) {
+            metric.labels.emplace_back("transport", TransportNames.at(transportType));
+            metrics.push_back(move(metric));
+        }
+    }
+    return metrics;
+}
+
+void Device::InitFlightRecorder()
+{
+    FlightRecorderConfig cfg;
+    cfg.path = fConfig->GetProperty<string>("flight-recorder", DefaultFlightRecorder);
+    cfg.size = fConfig->GetProperty<size_t>("flight-recorder-size", DefaultFlightRecorderSize);
+    lock_guard<mutex> lock(fFlightRecorderMtx);
+    if (cfg.path.empty()) {
+        fFlightRecorder = nullptr;
+    } else if (!fFlightRecorder || fFlightRecorder->GetPath() != cfg.path) {
+        fFlightRecorder = make_shared<FlightRecorder>(cfg);
+    } else if (fFlightRecorder->Frozen()) {
+        // a new recorder would truncate the file
+        LOG(warn) << "Flight recorder " << cfg.path << " stays frozen, configure another file to record again";
+    }
+}
+
+void Device::FreezeFlightRecorder(const string& reason)
+{
+    shared_ptr<FlightRecorder> recorder;
+    {
+        lock_guard<mutex> lock(fFlightRecorderMtx);
+        recorder = fFlightRecorder;
+    }
+    if (recorder) {
+        recorder->Freeze(reason);
+    }
+}
+
 void Device::LogSocketRates()
 {
+    ApplyThreadSettings("rate logging thread");
     vector<Channel*> filteredChannels;
     vector<string> filteredChannelNames;
     vector<int> logIntervals;
@@ -620,42 +1539,67 @@ void Device::LogSocketRates()
 
     size_t chanNameLen = 0;
 
-    // iterate over the channels map
-    for (auto& channel : GetChannels()) {
-        // iterate over the channels vector
-        for (auto& subChannel : channel.second) {
-            if (subChannel.fRateLogging > 0) {
-                filteredChannels.push_back(&subChannel);
-                logIntervals.push_back(subChannel.fRateLogging);
-                intervalCounters.push_back(0);
-                filteredChannelNames.push_back(subChannel.GetName());
-                chanNameLen = max(chanNameLen, filteredChannelNames.back().length());
-            }
-        }
-    }
+    vector<unsigned long> bytesIn;
+    vector<unsigned long> msgIn;
+    vector<unsigned long> bytesOut;
+    vector<unsigned long> msgOut;
+    vector<unsigned long> spinTime;
 
-    vector<unsigned long> bytesIn(filteredChannels.size());
-    vector<unsigned long> msgIn(filteredChannels.size());
-    vector<unsigned long> bytesOut(filteredChannels.size());
-    vector<unsigned long> msgOut(filteredChannels.size());
+    vector<unsigned long> bytesInNew;
+    vector<unsigned long> msgInNew;
+    vector<unsigned long> bytesOutNew;
+    vector<unsigned long> msgOutNew;
+    vector<unsigned long> spinTimeNew;
 
-    vector<unsigned long> bytesInNew(filteredChannels.size());
-    vector<unsigned long> msgInNew(filteredChannels.size());
-    vector<unsigned long> bytesOutNew(filteredChannels.size());
-    vector<unsigned long> msgOutNew(filteredChannels.size());
-
-    vector<double> mbPerSecIn(filteredChannels.size());
-    vector<double> msgPerSecIn(filteredChannels.size());
-    vector<double> mbPerSecOut(filteredChannels.size());
-    vector<double> msgPerSecOut(filteredChannels.size());
+    vector<double> mbPerSecIn;
+    vector<double> msgPerSecIn;
+    vector<double> mbPerSecOut;
+    vector<double> msgPerSecOut;
 
     int i = 0;
-    for (const auto& channel : filteredChannels) {
-        bytesIn.at(i) = channel->GetBytesRx();
-        bytesOut.at(i) = channel->GetBytesTx();
-        msgIn.at(i) = channel->GetMessagesRx();
-        msgOut.at(i) = channel->GetMessagesTx();
-        ++i;
+    uint64_t generation = 0;
+
+    // (re)collects the channels to log, called with fChannelsMtx held (the channels change with ResizeChannel())
+    auto collect = [&]() {
+        filteredChannels.clear();
+        filteredChannelNames.clear();
+        logIntervals.clear();
+        intervalCounters.clear();
+        // iterate over the channels map
+        for (auto& channel : GetChannels()) {
+            // iterate over the channels vector
+            for (auto& subChannel : channel.second) {
+                if (subChannel.fRateLogging > 0) {
+                    filteredChannels.push_back(&subChannel);
+                    logIntervals.push_back(subChannel.fRateLogging);
+                    intervalCounters.push_back(0);
+                    filteredChannelNames.push_back(subChannel.GetName());
+                    chanNameLen = max(chanNameLen, filteredChannelNames.back().length());
+                }
+            }
+        }
+
+        for (auto* values : {&bytesIn, &msgIn, &bytesOut, &msgOut, &spinTime, &bytesInNew, &msgInNew, &bytesOutNew, &msgOutNew, &spinTimeNew}) {
+            values->resize(filteredChannels.size());
+        }
+        for (auto* values : {&mbPerSecIn, &msgPerSecIn, &mbPerSecOut, &msgPerSecOut}) {
+            values->resize(filteredChannels.size());
+        }
+
+        i = 0;
+        for (const auto& channel : filteredChannels) {
+            bytesIn.at(i) = channel->GetBytesRx();
+            bytesOut.at(i) = channel->GetBytesTx();
+            msgIn.at(i) = channel->GetMessagesRx();
+            msgOut.at(i) = channel->GetMessagesTx();
+            spinTime.at(i) = channel->GetRcvSpinTime();
+            ++i;
+        }
+        generation = fChannelsGeneration;
+    };
+    {
+        lock_guard<mutex> lock(fChannelsMtx);
+        collect();
     }
 
     chrono::time_point<chrono::high_resolution_clock> t0(chrono::high_resolution_clock::now());
@@ -668,6 +1612,14 @@ void Device::LogSocketRates()
 
         uint64_t msSinceLastLog = chrono::duration_cast<chrono::milliseconds>(t1 - t0).count();
 
+        lock_guard<mutex> lock(fChannelsMtx);
+        if (generation != fChannelsGeneration) {
+            // resized, the rates start over
+            collect();
+            t0 = t1;
+            continue;
+        }
+
         i = 0;
 
         for (const auto& channel : filteredChannels) {
@@ -681,6 +1633,7 @@ void Device::LogSocketRates()
                     msgInNew.at(i) = channel->GetMessagesRx();
                     bytesOutNew.at(i) = channel->GetBytesTx();
                     msgOutNew.at(i) = channel->GetMessagesTx();
+                    spinTimeNew.at(i) = channel->GetRcvSpinTime();
 
                     mbPerSecIn.at(i) = (static_cast<double>(bytesInNew.at(i) - bytesIn.at(i)) / (1000. * 1000.)) / static_cast<double>(msSinceLastLog) * 1000.;
                     msgPerSecIn.at(i) = static_cast<double>(msgInNew.at(i) - msgIn.at(i)) / static_cast<double>(msSinceLastLog) * 1000.;
@@ -692,9 +1645,19 @@ void Device::LogSocketRates()
                     bytesOut.at(i) = bytesOutNew.at(i);
                     msgOut.at(i) = msgOutNew.at(i);
 
-                    LOG(info) << setw(static_cast<int>(chanNameLen)) << filteredChannelNames.at(i) << ": "
-                              << "in: " << msgPerSecIn.at(i) << " (" << mbPerSecIn.at(i) << " MB) "
-                              << "out: " << msgPerSecOut.at(i) << " (" << mbPerSecOut.at(i) << " MB)";
+                    if (channel->GetRcvMode() != Channel::DefaultRcvMode) {
+                        // share of the interval spent busy-polling in Receive
+                        double spinPercent = static_cast<double>(spinTimeNew.at(i) - spinTime.at(i)) / static_cast<double>(msSinceLastLog) / 10.;
+                        spinTime.at(i) = spinTimeNew.at(i);
+                        LOG(info) << setw(static_cast<int>(chanNameLen)) << filteredChannelNames.at(i) << ": "
+                                  << "in: " << msgPerSecIn.at(i) << " (" << mbPerSecIn.at(i) << " MB) "
+                                  << "out: " << msgPerSecOut.at(i) << " (" << mbPerSecOut.at(i) << " MB) "
+                                  << "spin: " << spinPercent << "%";
+                    } else {
+                        LOG(info) << setw(static_cast<int>(chanNameLen)) << filteredChannelNames.at(i) << ": "
+                                  << "in: " << msgPerSecIn.at(i) << " (" << mbPerSecIn.at(i) << " MB) "
+                                  << "out: " << msgPerSecOut.at(i) << " (" << mbPerSecOut.at(i) << " MB)";
+                    }
                 }
             }
 
@@ -705,8 +1668,88 @@ void Device::LogSocketRates()
     }
 }
 
+void Device::TuneChannels()
+{
+    ApplyThreadSettings("channel tuning thread");
+    struct Sample
+    {
+        Channel* fChannel;
+        unsigned long fBytesTx, fBytesRx, fMsgsTx, fMsgsRx;
+    };
+    vector<Sample> samples;
+    uint64_t generation = 0;
+    // (re)collects the tuned channels, called with fChannelsMtx held (the channels change with ResizeChannel())
+    auto collect = [&]() {
+        samples.clear();
+        for (auto& channel : GetChannels()) {
+            for (auto& subChannel : channel.second) {
+                if (subChannel.fTuner) {
+                    samples.push_back({&subChannel, subChannel.GetBytesTx(), subChannel.GetBytesRx(), subChannel.GetMessagesTx(), subChannel.GetMessagesRx()});
+                }
+            }
+        }
+        generation = fChannelsGeneration;
+    };
+    {
+        lock_guard<mutex> lock(fChannelsMtx);
+        collect();
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    while (!NewStatePending()) {
+        WaitFor(chrono::seconds(1));
+
+        auto t1 = chrono::steady_clock::now();
+        double seconds = chrono::duration<double>(t1 - t0).count();
+        t0 = t1;
+
+        lock_guard<mutex> lock(fChannelsMtx);
+        if (generation != fChannelsGeneration) {
+            collect();
+            continue;
+        }
+
+        for (auto& s : samples) {
+            Channel& ch = *s.fChannel;
+            const unsigned long bytesTx = ch.GetBytesTx();
+            const unsigned long bytesRx = ch.GetBytesRx();
+            const unsigned long msgsTx = ch.GetMessagesTx();
+            const unsigned long msgsRx = ch.GetMessagesRx();
+            const int rttUs = ch.fSocket->GetRttUs();
+            if (ch.fTuner->Sample(bytesTx - s.fBytesTx, bytesRx - s.fBytesRx, msgsTx - s.fMsgsTx, msgsRx - s.fMsgsRx, seconds, rttUs)) {
+                const ChannelSizes sizes(ch.fTuner->GetSizes());
+                LOG(info) << "Auto-tuned channel " << ch.GetName() << " (in: " << (msgsRx - s.fMsgsRx) / seconds << " msg/s, "
+                          << (bytesRx - s.fBytesRx) / seconds / 1e6 << " MB/s, out: " << (msgsTx - s.fMsgsTx) / seconds << " msg/s, "
+                          << (bytesTx - s.fBytesTx) / seconds / 1e6 << " MB/s, rtt: " << rttUs << " us): "
+                          << "sndBufSize=" << sizes.sndBufSize << ",rcvBufSize=" << sizes.rcvBufSize
+                          << ",sndKernelSize=" << sizes.sndKernelSize << ",rcvKernelSize=" << sizes.rcvKernelSize;
+            }
+            s.fBytesTx = bytesTx;
+            s.fBytesRx = bytesRx;
+            s.fMsgsTx = msgsTx;
+            s.fMsgsRx = msgsRx;
+        }
+    }
+
+    // the sizes to freeze into the channel configuration
+    lock_guard<mutex> lock(fChannelsMtx);
+    if (generation != fChannelsGeneration) {
+        collect();
+    }
+    for (auto& s : samples) {
+        const ChannelSizes sizes(s.fChannel->fTuner->GetSizes());
+        LOG(info) << "Auto-tuned sizes of channel " << s.fChannel->GetName() << ": "
+                  << "sndBufSize=" << sizes.sndBufSize << ",rcvBufSize=" << sizes.rcvBufSize
+                  << ",sndKernelSize=" << sizes.sndKernelSize << ",rcvKernelSize=" << sizes.rcvKernelSize;
+    }
+}
+
 void Device::InterruptTransports()
 {
+    if (fTransportRegistry) {
+        fTransportRegistry->Interrupt(this);
+        return;
+    }
     lock_guard<mutex> lock(fTransportMtx);
     for (auto& [transportType, transport] : fTransports) {
         transport->Interrupt();
@@ -715,6 +1758,10 @@ void Device::InterruptTransports()
 
 void Device::ResumeTransports()
 {
+    if (fTransportRegistry) {
+        fTransportRegistry->Resume(this);
+        return;
+    }
     lock_guard<mutex> lock(fTransportMtx);
     for (auto& [transportType, transport] : fTransports) {
         transport->Resume();
@@ -732,28 +1779,58 @@ void Device::ResetTaskWrapper()
 
 void Device::ResetWrapper()
 {
-    {
-        lock_guard<mutex> lock(fTransportMtx);
-        for (auto& [transportType, transport] : fTransports) {
-            transport->Reset();
-        }
-        fTransports.clear();
+    // warm reset: keep the transports and the bound/connected channels for the next initialization
+    const bool warmReset = fConfig->GetProperty<bool>("warm-reset", DefaultWarmReset);
+
+    if (!warmReset) {
+        ReleaseTransports();
     }
 
     Reset();
 
+    if (warmReset) {
+        for (auto& [name, subChannels] : GetChannels()) {
+            for (auto& subChannel : subChannels) {
+                const string key(tools::ToString(name, ".", subChannel.GetIndex()));
+                auto attachedConfig = fConfig->GetPropertiesAsStringStartingWith(tools::ToString("chans.", key, "."));
+                fRetainedChannels.emplace(key, RetainedChannel{std::move(subChannel), std::move(fChannelInitConfig[key]), std::move(attachedConfig)});
+            }
+        }
+        fRetainedTransportConfig = TransportConfig(*fConfig);
+    }
+    fChannelInitConfig.clear();
+    fUninitializedBindingChannels.clear();
+    fUninitializedConnectingChannels.clear();
+    fMuxCarriers.clear();
+    fRoutes.clear();
+
     GetChannels().clear();
-    fTransportFactory.reset();
+    if (!warmReset) {
+        fTransportFactory.reset();
+    }
     if (!NewStatePending()) {
         ChangeStateOrThrow(Transition::Auto);
     }
 }
 
+void Device::ReleaseTransports()
+{
+    lock_guard<mutex> lock(fTransportMtx);
+    if (!fTransportRegistry) { // shared transports are reset by the registry
+        for (auto& [transportType, transport] : fTransports) {
+            transport->Reset();
+        }
+    }
+    fTransports.clear();
+}
+
 /// TODO: Remove this once Device::fChannels is no longer public
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 Device::~Device()
 {
+    fConfig->Unsubscribe<string>("device-flight-recorder");
+    fConfig->UnsubscribeAsString("device-channel-resize");
     UnsubscribeFromNewTransition("device");
     fStateMachine.StopHandlingStates();
     LOG(debug) << "Shutting down device " << fId;
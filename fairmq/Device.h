@@ -12,11 +12,14 @@
 // FairMQ
 #include <fairmq/Channel.h>
 #include <fairmq/Error.h>
+#include <fairmq/HashRing.h>
+#include <fairmq/InputScheduler.h>
 #include <fairmq/Message.h>
 #include <fairmq/Parts.h>
 #include <fairmq/ProgOptions.h>
 #include <fairmq/StateMachine.h>
 #include <fairmq/StateQueue.h>
+#include <fairmq/TransportRegistry.h>
 #include <fairmq/Tools.h>
 #include <fairmq/TransportFactory.h>
 #include <fairmq/Transports.h>
@@ -26,16 +29,20 @@
 #include <fairlogger/Logger.h>
 
 // std
-#include <algorithm>   // find
+#include <algorithm>   // find, max
 #include <atomic>
 #include <chrono>
 #include <cstddef>
+#include <exception>   // exception_ptr
 #include <functional>
+#include <map>
 #include <memory>   // unique_ptr
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>   // pair
 #include <vector>
 
@@ -52,6 +59,51 @@ using InputMsgCallback = std::function<bool(MessagePtr&, int)>;
 
 using InputMultipartCallback = std::function<bool(Parts&, int)>;
 
+using InputBatchCallback = std::function<bool(std::vector<MessagePtr>&, int)>;
+
+/// request (without envelope, see Channel::TakeEnvelope), reply to fill, subchannel index
+using InputRequestCallback = std::function<bool(Parts&, Parts&, int)>;
+
+/// periodic work of the device event loop (see Device::OnTimer), returns false to leave RUNNING like a data callback
+using TimerCallback = std::function<bool()>;
+
+/// Handle to a subchannel, see Device::GetChannelRef.
+/// Avoids the lookup of the channel by name and index in Send/Receive/New*MessageFor.
+class SubChannelRef
+{
+  public:
+    SubChannelRef() = default;
+    explicit SubChannelRef(Channel& channel) : fChannel(&channel) {}
+
+    Channel& operator*() const { return *fChannel; }
+    Channel* operator->() const { return fChannel; }
+    explicit operator bool() const { return fChannel != nullptr; }
+
+  private:
+    Channel* fChannel = nullptr;
+};
+
+/// Handle to a channel (all its subchannels), see Device::GetChannelRef.
+class ChannelRef
+{
+  public:
+    ChannelRef() = default;
+    explicit ChannelRef(std::vector<Channel>& subChannels) : fSubChannels(&subChannels) {}
+
+    /// @return handle to the subchannel at index (unchecked)
+    SubChannelRef operator[](size_t index) const { return SubChannelRef((*fSubChannels)[index]); }
+    /// @return handle to the subchannel at index
+    /// @throw std::out_of_range if there is no such subchannel
+    SubChannelRef at(size_t index) const { return SubChannelRef(fSubChannels->at(index)); }
+    size_t size() const { return fSubChannels->size(); }
+    auto begin() const { return fSubChannels->begin(); }
+    auto end() const { return fSubChannels->end(); }
+    explicit operator bool() const { return fSubChannels != nullptr; }
+
+  private:
+    std::vector<Channel>* fSubChannels = nullptr;
+};
+
 class Device
 {
     friend class Channel;
@@ -153,6 +205,76 @@ class Device
         return GetChannel(channel, index).Receive(m, rcvTimeoutMs);
     }
 
+    /// Send `m` on the subchannel `ref`, see GetChannelRef. Same as Send(m, chan, i)
+    template<typename M>
+    std::enable_if_t<is_transferrable<M>::value, int64_t>
+    Send(M& m, SubChannelRef ref)
+    {
+        return ref->Send(m);
+    }
+
+    /// Receive `m` on the subchannel `ref`, see GetChannelRef. Same as Receive(m, chan, i)
+    template<typename M>
+    std::enable_if_t<is_transferrable<M>::value, int64_t>
+    Receive(M& m, SubChannelRef ref)
+    {
+        return ref->Receive(m);
+    }
+
+    /// Send `m` on the subchannel `ref` with a timeout, see GetChannelRef. Same as Send(m, chan, i, sndTimeoutMs)
+    template<typename M>
+    std::enable_if_t<is_transferrable<M>::value, int64_t>
+    Send(M& m, SubChannelRef ref, int sndTimeoutMs)
+    {
+        return ref->Send(m, sndTimeoutMs);
+    }
+
+    /// Receive `m` on the subchannel `ref` with a timeout, see GetChannelRef. Same as Receive(m, chan, i, rcvTimeoutMs)
+    template<typename M>
+    std::enable_if_t<is_transferrable<M>::value, int64_t>
+    Receive(M& m, SubChannelRef ref, int rcvTimeoutMs)
+    {
+        return ref->Receive(m, rcvTimeoutMs);
+    }
+
+    /// Returns the routing key of a message, from its first (header) part, see Route()
+    using RouteKeyCallback = std::function<uint64_t(const Message& header)>;
+
+    /// Set the routing key of the messages sent with Route() on a channel, by default the first 8 bytes of the
+    /// header part (0 if it is smaller)
+    void SetRouteKey(const std::string& channelName, RouteKeyCallback key) { fRouteKeys[channelName] = std::move(key); }
+
+    /// Index of the subchannel of a channel with route=hash that messages with the key of `m` are sent to by Route().
+    /// The subchannels are placed on a consistent hash ring by their addresses, so that adding or removing one only
+    /// moves the keys of this subchannel.
+    /// @throw std::out_of_range if the channel does not exist or has not the route=hash property
+    template<typename M>
+    std::enable_if_t<is_transferrable<M>::value, int>
+    RouteIndex(const M& m, const std::string& channelName) const
+    {
+        const auto ring = fRoutes.find(channelName);
+        if (ring == fRoutes.end()) {
+            throw std::out_of_range(tools::ToString("RouteIndex(): channel '", channelName, "' does not exist or has no route=hash property"));
+        }
+        const Message* header = RouteHeader(m);
+        uint64_t key = 0;
+        if (header) {
+            const auto keyFn = fRouteKeys.find(channelName);
+            key = keyFn != fRouteKeys.end() ? keyFn->second(*header) : DefaultRouteKey(*header);
+        }
+        return ring->second.Lookup(key);
+    }
+
+    /// Send `m` on the subchannel of a channel with route=hash its key is mapped to (see RouteIndex()),
+    /// messages with the same key go to the same subchannel.
+    /// @param sndTimeoutMs send timeout in ms, if not provided the default timeout of the subchannel is taken
+    template<typename M, typename... Timeout>
+    std::enable_if_t<is_transferrable<M>::value, int64_t>
+    Route(M& m, const std::string& channelName, Timeout&&... sndTimeoutMs)
+    {
+        return GetChannel(channelName, RouteIndex(m, channelName)).Send(m, std::forward<Timeout>(sndTimeoutMs)...);
+    }
+
     /// @brief Getter for default transport factory
     auto Transport() const -> TransportFactory* { return fTransportFactory.get(); }
 
@@ -170,6 +292,13 @@ class Device
         return GetChannel(channel, index).NewMessage(std::forward<Args>(args)...);
     }
 
+    // creates message with the transport of the specified subchannel handle
+    template<typename... Args>
+    MessagePtr NewMessageFor(SubChannelRef ref, Args&&... args)
+    {
+        return ref->NewMessage(std::forward<Args>(args)...);
+    }
+
     // creates a message that will not be cleaned up after transfer, with the default device
     // transport
     template<typename T>
@@ -186,6 +315,12 @@ class Device
         return GetChannel(channel, index).NewStaticMessage(data);
     }
 
+    template<typename T>
+    MessagePtr NewStaticMessageFor(SubChannelRef ref, const T& data)
+    {
+        return ref->NewStaticMessage(data);
+    }
+
     // creates a message with a copy of the provided data, with the default device transport
     template<typename T>
     MessagePtr NewSimpleMessage(const T& data)
@@ -201,6 +336,33 @@ class Device
         return GetChannel(channel, index).NewSimpleMessage(data);
     }
 
+    template<typename T>
+    MessagePtr NewSimpleMessageFor(SubChannelRef ref, const T& data)
+    {
+        return ref->NewSimpleMessage(data);
+    }
+
+    // creates a message with T constructed in place from args (see TransportFactory::NewTypedMessage), with the
+    // default device transport
+    template<typename T, typename... Args>
+    MessagePtr NewTypedMessage(Args&&... args)
+    {
+        return Transport()->template NewTypedMessage<T>(std::forward<Args>(args)...);
+    }
+
+    // creates a message with T constructed in place from args, with the transport of the specified channel
+    template<typename T, typename... Args>
+    MessagePtr NewTypedMessageFor(const std::string& channel, int index, Args&&... args)
+    {
+        return GetChannel(channel, index).template NewTypedMessage<T>(std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename... Args>
+    MessagePtr NewTypedMessageFor(SubChannelRef ref, Args&&... args)
+    {
+        return ref->template NewTypedMessage<T>(std::forward<Args>(args)...);
+    }
+
     // creates unamanaged region with the default device transport
     template<typename... Args>
     UnmanagedRegionPtr NewUnmanagedRegion(Args&&... args)
@@ -215,6 +377,12 @@ class Device
         return GetChannel(channel, index).NewUnmanagedRegion(std::forward<Args>(args)...);
     }
 
+    template<typename... Args>
+    UnmanagedRegionPtr NewUnmanagedRegionFor(SubChannelRef ref, Args&&... args)
+    {
+        return ref->NewUnmanagedRegion(std::forward<Args>(args)...);
+    }
+
     template<typename... Ts>
     PollerPtr NewPoller(const Ts&... inputs)
     {
@@ -260,6 +428,10 @@ class Device
     /// @param transport  Transport string ("zeromq"/"shmem")
     std::shared_ptr<TransportFactory> AddTransport(mq::Transport transport);
 
+    /// Share the transports with other devices of the process (call before InitDevice)
+    /// @param registry  transports shared by the devices, see fair::mq::MultiDeviceRunner
+    void SetTransportRegistry(std::shared_ptr<TransportRegistry> registry) { fTransportRegistry = std::move(registry); }
+
     /// Assigns config to the device
     void SetConfig(ProgOptions& config);
     /// Get pointer to the config
@@ -272,9 +444,9 @@ class Device
     {
         fDataCallbacks = true;
         fMsgInputs.insert(
-            std::make_pair(channelName, [this, memberFunction](MessagePtr& msg, int index) {
+            std::make_pair(channelName, InputHandler<MessagePtr>{nullptr, [this, memberFunction](MessagePtr& msg, int index) {
                 return (static_cast<T*>(this)->*memberFunction)(msg, index);
-            }));
+            }}));
 
         if (find(fInputChannelKeys.begin(), fInputChannelKeys.end(), channelName)
             == fInputChannelKeys.end()) {
@@ -285,7 +457,7 @@ class Device
     void OnData(const std::string& channelName, InputMsgCallback callback)
     {
         fDataCallbacks = true;
-        fMsgInputs.insert(make_pair(channelName, callback));
+        fMsgInputs.insert(make_pair(channelName, InputHandler<MessagePtr>{nullptr, std::move(callback)}));
 
         if (find(fInputChannelKeys.begin(), fInputChannelKeys.end(), channelName)
             == fInputChannelKeys.end()) {
@@ -299,9 +471,9 @@ class Device
     {
         fDataCallbacks = true;
         fMultipartInputs.insert(
-            std::make_pair(channelName, [this, memberFunction](Parts& parts, int index) {
+            std::make_pair(channelName, InputHandler<Parts>{nullptr, [this, memberFunction](Parts& parts, int index) {
                 return (static_cast<T*>(this)->*memberFunction)(parts, index);
-            }));
+            }}));
 
         if (find(fInputChannelKeys.begin(), fInputChannelKeys.end(), channelName)
             == fInputChannelKeys.end()) {
@@ -312,7 +484,7 @@ class Device
     void OnData(const std::string& channelName, InputMultipartCallback callback)
     {
         fDataCallbacks = true;
-        fMultipartInputs.insert(make_pair(channelName, callback));
+        fMultipartInputs.insert(make_pair(channelName, InputHandler<Parts>{nullptr, std::move(callback)}));
 
         if (find(fInputChannelKeys.begin(), fInputChannelKeys.end(), channelName)
             == fInputChannelKeys.end()) {
@@ -320,6 +492,155 @@ class Device
         }
     }
 
+    /// Registers a member function of the device as data handler, called directly instead of through a std::function:
+    /// OnData<&MyDevice::HandleData>("data"). For handlers of single messages (MessagePtr&, int) and of Parts (Parts&, int)
+    template<auto memberFunction>
+    void OnData(const std::string& channelName)
+    {
+        using Class = typename DataHandlerTraits<decltype(memberFunction)>::Class;
+        using Input = typename DataHandlerTraits<decltype(memberFunction)>::Input;
+        static_assert(std::is_base_of_v<Device, Class>, "OnData<&T::F>(): T has to be the device");
+        static_assert(std::is_same_v<Input, MessagePtr> || std::is_same_v<Input, Parts>, "OnData<&T::F>(): F has to take MessagePtr& or Parts&");
+
+        fDataCallbacks = true;
+        if constexpr (std::is_same_v<Input, MessagePtr>) {
+            fMsgInputs.insert(make_pair(channelName, InputHandler<MessagePtr>{&CallDataHandler<Class, Input, memberFunction>, {}}));
+        } else {
+            fMultipartInputs.insert(make_pair(channelName, InputHandler<Parts>{&CallDataHandler<Class, Input, memberFunction>, {}}));
+        }
+
+        if (find(fInputChannelKeys.begin(), fInputChannelKeys.end(), channelName)
+            == fInputChannelKeys.end()) {
+            fInputChannelKeys.push_back(channelName);
+        }
+    }
+
+    // overload to easily bind member functions
+    template<typename T>
+    void OnData(const std::string& channelName, bool (T::*memberFunction)(std::vector<MessagePtr>& msgs, int index), size_t maxBatch)
+    {
+        OnData(channelName, InputBatchCallback([this, memberFunction](std::vector<MessagePtr>& msgs, int index) {
+            return (static_cast<T*>(this)->*memberFunction)(msgs, index);
+        }), maxBatch);
+    }
+
+    /// Registers a callback that gets up to maxBatch (single-part) messages per call: all messages
+    /// that are already queued on the channel when the first one arrives (see Channel::ReceiveBatch).
+    void OnData(const std::string& channelName, InputBatchCallback callback, size_t maxBatch)
+    {
+        fDataCallbacks = true;
+        fBatchInputs.insert(make_pair(channelName, make_pair(callback, std::max<size_t>(maxBatch, 1))));
+
+        if (find(fInputChannelKeys.begin(), fInputChannelKeys.end(), channelName)
+            == fInputChannelKeys.end()) {
+            fInputChannelKeys.push_back(channelName);
+        }
+    }
+
+    /// Dispatches the replies to the requests sent on the channel (see Channel::Request()) as data input of the device,
+    /// the reply callbacks are then called like data callbacks. Timed out requests expire when the next reply is handled.
+    void OnReplies(const std::string& channelName)
+    {
+        OnData(channelName, InputMultipartCallback([this, channelName](Parts& reply, int index) {
+            GetChannel(channelName, index).HandleReply(reply);
+            return true;
+        }));
+    }
+
+    // overload to easily bind member functions
+    template<typename T>
+    void OnRequest(const std::string& channelName, bool (T::*memberFunction)(Parts& request, Parts& reply, int index))
+    {
+        OnRequest(channelName, InputRequestCallback([this, memberFunction](Parts& request, Parts& reply, int index) {
+            return (static_cast<T*>(this)->*memberFunction)(request, reply, index);
+        }));
+    }
+
+    /// Registers the handler of a server channel (router or pair) for requests sent with Channel::Request(). It gets the
+    /// request without routing frames and correlation id, and fills the reply, which is sent back to the client
+    /// (nothing is sent if it is left empty).
+    void OnRequest(const std::string& channelName, InputRequestCallback callback)
+    {
+        OnData(channelName, InputMultipartCallback([this, channelName, callback = std::move(callback)](Parts& request, int index) {
+            Channel& channel = GetChannel(channelName, index);
+            Parts envelope(channel.TakeEnvelope(request));
+            Parts reply;
+            bool proceed = callback(request, reply, index);
+            if (!reply.Empty() && channel.Reply(envelope, reply) < 0) {
+                return false;
+            }
+            return proceed;
+        }));
+    }
+
+    // overload to easily bind member functions
+    template<typename T>
+    void OnTimer(std::chrono::milliseconds interval, bool (T::*memberFunction)())
+    {
+        OnTimer(interval, TimerCallback([this, memberFunction]() { return (static_cast<T*>(this)->*memberFunction)(); }));
+    }
+
+    /// Registers a callback that the device event loop calls every interval while RUNNING (the first time one interval
+    /// after entering RUNNING), e.g. to flush partial batches or publish statistics. It runs on the thread of the data
+    /// callbacks (or between ConditionalRun() calls), so it needs no locking against them. With several input threads
+    /// (--data-workers, inputs of several transports) it runs on the device thread, serialized like the data callbacks.
+    /// Ticks that are missed while a callback runs late are skipped, not caught up. Not called for devices with own Run().
+    void OnTimer(std::chrono::milliseconds interval, TimerCallback callback)
+    {
+        fTimers.push_back(Timer{std::max(interval, std::chrono::milliseconds(1)), std::move(callback), {}});
+    }
+
+    /// Sends the queued asynchronous sends of all channels that their sockets accept (see Channel::SendAsync()), and
+    /// the spilled messages (see Channel::UpdateSpillDir()).
+    /// The device calls it between ConditionalRun() calls and between the data callbacks of a single input thread
+    /// (with several input channels at least every 10 ms while sends are queued), Run() implementations call it themselves.
+    /// @return number of messages still queued
+    size_t DispatchSends();
+
+    /// Requests to change the number of subchannels of an output channel while the device runs (elastic scaling), also
+    /// available as property "chans.<name>.numSockets" (e.g. set by the control plugin). Added subchannels take the
+    /// configuration of the last one, overlaid with properties "chans.<name>.<index>.*" set beforehand (e.g. the
+    /// address of a new consumer); they are bound/connected as on initialization. Removed subchannels are closed, last
+    /// ones first. Safe to call from any thread; the request is applied by the device thread (see ApplyChannelResizes())
+    /// with the next ConditionalRun() call, data callback or timer tick, then SubChannelsChanged() is called. Input
+    /// channels, multiplexed (mux) and shared send (sharedSend) channels cannot be resized, neither can any channel with
+    /// several input threads (--data-workers, inputs of several transports). Resizing invalidates the SubChannelRef and
+    /// Channel references of the channel, ChannelRef stays valid.
+    void ResizeChannel(const std::string& channelName, int numSubChannels);
+
+    /// Applies the requested channel resizes (see ResizeChannel()). The device calls it along with DispatchSends(),
+    /// Run() implementations call it themselves.
+    /// @return number of resized channels
+    size_t ApplyChannelResizes();
+
+    /// Declares the data callback of the channel as thread-safe. With --data-workers or input channels of several
+    /// transports (one thread per transport) it may then run concurrently for different subchannels of the channel
+    /// and with other callbacks, otherwise the callbacks are serialized.
+    /// Callbacks of one subchannel are always called in order, from one worker.
+    void SetDataThreadSafe(const std::string& channelName, bool threadSafe = true)
+    {
+        if (threadSafe) {
+            fThreadSafeInputs.insert(channelName);
+        } else {
+            fThreadSafeInputs.erase(channelName);
+        }
+    }
+
+    /// Sets how the device event loop prioritizes the input channel among the ready inputs, with --input-dispatch
+    /// "priority" (strict priority: higher inputs are drained first), "weighted" (weighted round-robin: up to priority
+    /// messages per round) or "deadline" (earliest deadline first; an input waits from when it is found ready or from
+    /// its last handled message). With these policies the loop polls again without waiting after every handled
+    /// message, so that a newly ready higher-priority input is handled next. Inputs not set have priority 0 and no
+    /// budget or deadline. The default --input-dispatch "order" handles one message of every ready input per poll and
+    /// ignores these settings, as do inputs with a priority lane (see Channel::UpdatePriorityLane()).
+    /// @param priority higher first, weight (at least 1) with "weighted", tie-break with "deadline"
+    /// @param budget maximum messages of the input per poll iteration of the loop (between sends and timers), 0: no limit
+    /// @param deadline latency target of the input with "deadline", 0: none (handled after the inputs with one)
+    void SetInputPriority(const std::string& channelName, int priority, int budget = 0, std::chrono::milliseconds deadline = {})
+    {
+        fInputPriorities[channelName] = InputPriority{priority, budget, deadline};
+    }
+
     Channel& GetChannel(const std::string& channelName, const int index = 0)
     try {
         return GetChannels().at(channelName).at(index);
@@ -328,6 +649,22 @@ class Device
         throw;
     }
 
+    /// @brief Resolve a channel once (e.g. in InitTask) for use in Send/Receive/New*MessageFor without lookup by name.
+    /// The handle is valid as long as the channels of the device are (until ResetDevice).
+    ChannelRef GetChannelRef(const std::string& channelName)
+    try {
+        return ChannelRef(GetChannels().at(channelName));
+    } catch (const std::out_of_range& oor) {
+        LOG(error) << "GetChannelRef(): '" << channelName << "' does not exist.";
+        throw;
+    }
+
+    /// @brief Resolve the subchannel at index of a channel once, see GetChannelRef(channelName)
+    SubChannelRef GetChannelRef(const std::string& channelName, const int index)
+    {
+        return SubChannelRef(GetChannel(channelName, index));
+    }
+
     size_t GetNumSubChannels(const std::string& channelName)
     try {
         return GetChannels().at(channelName).size();
@@ -344,6 +681,22 @@ class Device
         return GetChannel(channelName, index).GetNumberOfConnectedPeers();
     }
 
+    /// @return metrics snapshots of all subchannels, call metrics are recorded with --channel-metrics.
+    /// Safe to call from other threads (e.g. plugins) while the channels are initialized (between Binding and Resetting)
+    std::vector<ChannelMetrics> GetChannelMetrics() const;
+    /// @return metrics of all transports of the device (see TransportFactory::GetMetrics), safe to call from other threads
+    std::vector<TransportMetric> GetTransportMetrics();
+    /// @return duration and hardware counters of the ConditionalRun() calls in the handler fields (handlerCalls, handlerNs,
+    /// handlerCycles, ...), named "ConditionalRun". Recorded with --channel-metrics, the counters with --perf-counters.
+    /// Valid in the same states as GetChannelMetrics()
+    ChannelMetrics GetRunMetrics() const;
+
+    /// Stop the flight recorder of the device (--flight-recorder) and write the recorded messages to its file, for
+    /// post-mortem analysis with FlightRecorder::Read(). Called on the error state and when the property
+    /// "flight-recorder-freeze" is set (e.g. by the control plugin). Safe to call from any thread, no-op without recorder.
+    /// @param reason stored in the file
+    void FreezeFlightRecorder(const std::string& reason);
+
     virtual void RegisterChannelEndpoints() {}
 
     bool RegisterChannelEndpoint(const std::string& channelName,
@@ -490,6 +843,10 @@ class Device
     /// Called in the RUNNING state once after executing the Run()/ConditionalRun() method
     virtual void PostRun() {}
 
+    /// Called on the device thread after the number of subchannels of a channel changed (see ResizeChannel()), e.g.
+    /// to resize per-subchannel state
+    virtual void SubChannelsChanged(const std::string& /* channelName */) {}
+
     /// Resets the user task (to be overloaded in child classes)
     virtual void ResetTask() {}
 
@@ -589,11 +946,16 @@ class Device
     /// @brief Returns true if a new state has been requested, signaling the current handler to
     /// stop.
     bool NewStatePending() const { return fStateMachine.NewStatePending(); }
+    /// @brief File descriptor that is readable while a new state is pending, for custom event loops in the state
+    /// handlers (e.g. Poller::AddWakeup()). It is reset when the next state is entered.
+    int GetStateWakeupFd() const { return fInputWakeup.Fd(); }
 
     /// @brief Returns the current state
     State GetCurrentState() const { return fStateMachine.GetCurrentState(); }
     /// @brief Returns the name of the current state as a string
     std::string GetCurrentStateName() const { return fStateMachine.GetCurrentStateName(); }
+    /// @brief Returns the timings of the last state transitions (oldest first), see fair::mq::TransitionTiming
+    std::vector<TransitionTiming> GetTransitionTimings() const { return fStateMachine.GetTransitionTimings(); }
 
     /// @brief Returns name of the given state as a string
     /// @param state state
@@ -614,6 +976,22 @@ class Device
     static constexpr const char* DefaultNetworkInterface = "default";
     static constexpr int DefaultInitTimeout = 120;
     static constexpr float DefaultRate = 0.;
+    static constexpr const char* DefaultRateMode = "adaptive";
+    static constexpr unsigned int DefaultRateBurst = 1;
+    static constexpr int DefaultDataWorkers = 0;
+    static constexpr const char* DefaultInputDispatch = "order";
+    static constexpr bool DefaultChannelMetrics = false;
+    static constexpr bool DefaultPerfCounters = false;
+    static constexpr const char* DefaultFlightRecorder = "";
+    static constexpr size_t DefaultFlightRecorderSize = 64 << 20;
+    static constexpr const char* DefaultFlightRecorderChannels = "";
+    static constexpr bool DefaultWarmReset = false;
+    static constexpr const char* DefaultCpuAffinity = "";
+    static constexpr const char* DefaultSchedPolicy = "";
+    static constexpr int DefaultSchedPriority = -1;
+    static constexpr bool DefaultMlockall = false;
+    static constexpr const char* DefaultCopyEngine = "memcpy";
+    static constexpr size_t DefaultCopyEngineThreshold = 1 << 20;
     static constexpr const char* DefaultSession = "default";
 
   private:
@@ -622,6 +1000,7 @@ class Device
 
     /// Handles the initialization
     void InitWrapper();
+    void InitFlightRecorder();
     /// Initializes binding channels
     void BindWrapper();
     /// Initializes connecting channels
@@ -646,39 +1025,169 @@ class Device
 
     /// Attach (bind/connect) channels in the list
     void AttachChannels(std::vector<Channel*>& chans);
-    bool AttachChannel(Channel& ch);
+    bool AttachChannel(Channel& ch, const std::unordered_map<std::string, std::string>& resolvedHosts);
+
+    /// Samples the rates and round-trip times of the channels with the autoTune property once per second while RUNNING
+    void TuneChannels();
 
     void HandleSingleChannelInput();
     void HandleMultipleChannelInput();
     void HandleMultipleTransportInput();
     void PollForTransport(const TransportFactory* factory,
                           const std::vector<std::string>& channelKeys);
+    void HandleInputWithWorkers();
+    void DataWorker(const TransportFactory* factory, const std::vector<std::pair<const std::string*, int>>& items);
+    /// calls the data handler from one of several input threads, serialized unless declared thread-safe
+    bool HandleSharedInput(const std::string& chName, int i);
+    /// keeps the (first) exception of an input thread, to be rethrown by the device thread
+    void StoreInputThreadError();
+    /// lets all input threads (transports or workers) return
+    void StopInputThreads();
+    /// schedules the first tick of the timers (see OnTimer()), at the start of RUNNING
+    void StartTimers();
+    /// calls the due timer callbacks, lowers timeout (ms, -1: none) to the time until the next tick
+    /// @return false if a callback returned false
+    bool RunTimers(int& timeout);
+    /// runs the timers on the device thread while several input threads handle the data
+    void RunSharedTimers();
+    /// applies --cpu-affinity/--sched-policy/--sched-priority to the calling device thread
+    void ApplyThreadSettings(const char* thread) const;
+
+    /// (channel name, subchannel index) of every poll item of a poller created for the given channels
+    std::vector<std::pair<const std::string*, int>> PollItems(const std::vector<std::string>& channelKeys);
+    bool HasPriorityLanes(const std::vector<std::pair<const std::string*, int>>& items);
+    /// scheduler of the poll items for --input-dispatch, nullptr with "order"
+    std::unique_ptr<InputScheduler> CreateInputScheduler(const std::vector<std::pair<const std::string*, int>>& items) const;
+    /// handles the ready poll items in the order of the scheduler, polling again without waiting after every message,
+    /// until none is ready within its budget (one iteration of the input loop)
+    /// @return false if a data handler returned false
+    bool HandleScheduledInputs(Poller& poller,
+                               const std::vector<std::pair<const std::string*, int>>& items,
+                               InputScheduler& scheduler,
+                               std::vector<int>& ready,
+                               bool shared);
+    /// indices of the poll items with input after the last poll
+    static void CollectReadyInputs(Poller& poller, size_t numItems, std::vector<int>& ready);
+    /// polls the inputs together with their priority lanes and handles the inputs with a ready lane first
+    void HandlePriorityLaneInput(const TransportFactory* factory,
+                                 const std::vector<std::pair<const std::string*, int>>& items,
+                                 int timeout,
+                                 bool shared);
+    /// data handler of an input channel: a member function registered with OnData<&T::F>() is called through
+    /// fDirect (a plain function calling it), other handlers through fCallback
+    template<typename Input>
+    struct InputHandler
+    {
+        bool (*fDirect)(Device&, Input&, int);
+        std::function<bool(Input&, int)> fCallback;
 
-    bool HandleMsgInput(const std::string& chName, const InputMsgCallback& callback, int i);
-    bool HandleMultipartInput(const std::string& chName,
-                              const InputMultipartCallback& callback,
-                              int i);
+        bool operator()(Device& device, Input& input, int index) const { return fDirect ? fDirect(device, input, index) : fCallback(input, index); }
+    };
+
+    template<typename F>
+    struct DataHandlerTraits;
+    template<typename T, typename I>
+    struct DataHandlerTraits<bool (T::*)(I&, int)>
+    {
+        using Class = T;
+        using Input = I;
+    };
+
+    template<typename T, typename Input, auto memberFunction>
+    static bool CallDataHandler(Device& device, Input& input, int index)
+    {
+        return (static_cast<T&>(device).*memberFunction)(input, index);
+    }
+
+    /// handlers and subchannels of an input channel, resolved before RUNNING (see ResolveInputs())
+    struct ResolvedInput
+    {
+        const InputHandler<MessagePtr>* fMsg = nullptr;
+        const InputHandler<Parts>* fMultipart = nullptr;
+        const std::pair<InputBatchCallback, size_t>* fBatch = nullptr;
+        std::vector<Channel*> fSubChannels; ///< input channels are not resizable, the pointers stay valid while RUNNING
+    };
+    /// resolves the handlers and subchannels of the input channels, so that handling a message needs at most one lookup by name
+    void ResolveInputs();
+
+    /// calls the data handler registered for the channel
+    bool HandleChannelInput(const std::string& chName, int i);
+    bool HandleMsgInput(Channel& channel, const InputHandler<MessagePtr>& handler, int i);
+    bool HandleBatchInput(Channel& channel, const InputBatchCallback& callback, size_t maxBatch, int i);
+    bool HandleMultipartInput(Channel& channel, const InputHandler<Parts>& handler, int i);
 
     std::vector<Channel*> fUninitializedBindingChannels;
     std::vector<Channel*> fUninitializedConnectingChannels;
+    std::unordered_map<std::string, Channel*> fMuxCarriers; ///< connected multiplexed subchannels by channel, transport and address
+    std::unordered_map<std::string, HashRing> fRoutes; ///< hash rings of the channels with route=hash, built once connected
+    std::unordered_map<std::string, RouteKeyCallback> fRouteKeys;
+
+    void InitRoutes();
+    bool ResizeChannelNow(const std::string& channelName, int numSubChannels);
+    static const Message* RouteHeader(const MessagePtr& msg) { return msg.get(); }
+    static const Message* RouteHeader(const Parts& parts) { return parts.Empty() ? nullptr : parts.At(0).get(); }
+    static const Message* RouteHeader(const std::vector<MessagePtr>& msgs) { return msgs.empty() ? nullptr : msgs.front().get(); }
+    static uint64_t DefaultRouteKey(const Message& header);
+
+    /// a channel kept open across a warm reset, reused by the next initialization if its configuration is unchanged
+    struct RetainedChannel
+    {
+        Channel fChannel;
+        std::map<std::string, std::string> fInitConfig;       ///< channel properties at initialization
+        std::map<std::string, std::string> fAttachedConfig;   ///< channel properties after bind/connect
+    };
+    std::unordered_map<std::string, RetainedChannel> fRetainedChannels;   ///< by "<name>.<index>"
+    std::map<std::string, std::string> fRetainedTransportConfig;   ///< transport properties at the warm reset
+    std::unordered_map<std::string, std::map<std::string, std::string>> fChannelInitConfig;   ///< by "<name>.<index>"
+    /// resets and releases the transports (destroyed with the last channel using them)
+    void ReleaseTransports();
 
     bool fDataCallbacks;
-    std::unordered_map<std::string, InputMsgCallback> fMsgInputs;
-    std::unordered_map<std::string, InputMultipartCallback> fMultipartInputs;
+    std::unordered_map<std::string, InputHandler<MessagePtr>> fMsgInputs;
+    std::unordered_map<std::string, InputHandler<Parts>> fMultipartInputs;
+    std::unordered_map<std::string, std::pair<InputBatchCallback, size_t>> fBatchInputs;
+    std::unordered_map<std::string, ResolvedInput> fResolvedInputs;
     std::unordered_map<mq::Transport, std::vector<std::string>> fMultitransportInputs;
     std::unordered_map<std::string, std::pair<uint16_t, uint16_t>> fChannelRegistry;
     std::vector<std::string> fInputChannelKeys;
-    std::mutex fMultitransportMutex;
+    std::mutex fMultitransportMutex;   ///< serializes the data callbacks of multiple threads (transports or workers)
     std::atomic<bool> fMultitransportProceed;
+    tools::Wakeup fInputWakeup;   ///< signalled on new transitions and when an input thread stops, wakes up the input pollers
+    std::unordered_set<std::string> fThreadSafeInputs;
+    InputDispatch fInputDispatch = InputDispatch::order;   ///< --input-dispatch
+    std::unordered_map<std::string, InputPriority> fInputPriorities;   ///< by input channel, see SetInputPriority()
+    struct Timer
+    {
+        std::chrono::milliseconds fInterval;
+        TimerCallback fCallback;
+        std::chrono::steady_clock::time_point fNext;
+    };
+    std::vector<Timer> fTimers;   ///< see OnTimer()
+    std::mutex fResizeMtx;   ///< guards fPendingResizes
+    std::unordered_map<std::string, int> fPendingResizes;   ///< requested number of subchannels by channel, see ResizeChannel()
+    std::atomic<bool> fResizePending{false};
+    mutable std::mutex fChannelsMtx;   ///< held by the device thread while resizing channels, by other threads while using them
+    uint64_t fChannelsGeneration = 0;   ///< incremented by every resize, guarded by fChannelsMtx
+    int fDataWorkers;   ///< number of data callback worker threads per transport (0: device thread)
+    bool fChannelMetrics;   ///< record call metrics on all channels
+    bool fPerfCounters = false;   ///< count cycles, instructions, LLC and branch misses of the handlers (--perf-counters)
+    std::shared_ptr<ChannelMetricsRecorder> fRunMetrics;   ///< of the ConditionalRun() calls, with fChannelMetrics
+    std::shared_ptr<FlightRecorder> fFlightRecorder;   ///< --flight-recorder, kept across resets
+    std::mutex fFlightRecorderMtx;   ///< guards fFlightRecorder against FreezeFlightRecorder() from other threads
+    tools::ThreadSettings fThreadSettings;   ///< CPU affinity and scheduling of the device threads
+    std::exception_ptr fInputThreadError;   ///< first exception of the input threads (transports or workers)
 
     const tools::Version fVersion;
     float fRate;                  ///< Rate limiting for ConditionalRun
+    tools::RateLimitMode fRateMode; ///< How fRate is enforced
+    unsigned int fRateBurst;      ///< Burst size of tools::RateLimitMode::tokenBucket
     int fInitializationTimeoutInS;
     std::vector<std::string> fRawCmdLineArgs;
 
     StateQueue fStateQueue;
 
     std::mutex fTransportMtx;   ///< guards access to transports container
+    std::shared_ptr<TransportRegistry> fTransportRegistry;   ///< Transports shared with other devices (optional)
 };
 
 }   // namespace fair::mq
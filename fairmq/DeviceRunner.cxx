@@ -8,6 +8,7 @@
 
 #include "DeviceRunner.h"
 
+#include <fairmq/StartupProfile.h>
 #include <fairmq/tools/Strings.h>
 #include <fairmq/tools/Version.h>
 #include <fairmq/Version.h>
@@ -85,7 +86,11 @@ void DeviceRunner::SubscribeForConfigChange()
     });
     fConfig.Subscribe<string>("device-runner", [&](const std::string& key, const std::string& val) {
         if (key == "severity") {
-            fair::Logger::SetConsoleSeverity(val);
+            if (fAsyncLogSink) {
+                fAsyncLogSink->SetSeverity(val);
+            } else {
+                fair::Logger::SetConsoleSeverity(val);
+            }
         } else if (key == "file-severity") {
             fair::Logger::SetFileSeverity(val);
         } else if (key == "verbosity") {
@@ -104,14 +109,19 @@ void DeviceRunner::UnsubscribeFromConfigChange()
 
 auto DeviceRunner::Run() -> int
 {
-    fPluginManager.LoadPlugin("s:config");
-
-    ////// CALL HOOK ///////
-    fEvents.Emit<hooks::LoadPlugins>(*this);
-    ////////////////////////
-
-    // Load builtin plugins last
-    fPluginManager.LoadPlugin("s:control");
+    {
+        StartupProfile::Scope phase("load-plugins");
+        fPluginManager.LoadPlugin("s:config");
+
+        ////// CALL HOOK ///////
+        fEvents.Emit<hooks::LoadPlugins>(*this);
+        ////////////////////////
+
+        // Load builtin plugins last
+        fPluginManager.LoadPlugin("s:metrics");
+        fPluginManager.LoadPlugin("s:tracing");
+        fPluginManager.LoadPlugin("s:control");
+    }
 
     ////// CALL HOOK ///////
     fEvents.Emit<hooks::SetCustomCmdLineOptions>(*this);
@@ -126,10 +136,17 @@ auto DeviceRunner::Run() -> int
     fEvents.Emit<hooks::ModifyRawCmdLineArgs>(*this);
     ////////////////////////
 
-    fConfig.ParseAll(fRawCmdLineArgs, true);
+    {
+        StartupProfile::Scope phase("parse-options");
+        fConfig.ParseAll(fRawCmdLineArgs, true);
 
-    if (!HandleGeneralOptions(fConfig, fPrintLogo)) {
-        return 0;
+        if (!HandleGeneralOptions(fConfig, fPrintLogo)) {
+            return 0;
+        }
+    }
+
+    if (fConfig.GetProperty<bool>("log-async") && fConfig.GetProperty<string>("log-to-file").empty()) {
+        fAsyncLogSink = make_unique<tools::AsyncLogSink>();
     }
 
     fConfig.Notify();
@@ -137,9 +154,12 @@ auto DeviceRunner::Run() -> int
     // handle configuration updates (for general options)
     SubscribeForConfigChange();
 
-    ////// CALL HOOK ///////
-    fEvents.Emit<hooks::InstantiateDevice>(*this);
-    ////////////////////////
+    {
+        StartupProfile::Scope phase("instantiate-device");
+        ////// CALL HOOK ///////
+        fEvents.Emit<hooks::InstantiateDevice>(*this);
+        ////////////////////////
+    }
 
     if (!fDevice) {
         LOG(error) << "getDevice(): no valid device provided. Exiting.";
@@ -173,7 +193,10 @@ auto DeviceRunner::Run() -> int
     fPluginManager.EmplacePluginServices(fConfig, *fDevice);
 
     // Instantiate and run plugins
-    fPluginManager.InstantiatePlugins();
+    {
+        StartupProfile::Scope phase("instantiate-plugins");
+        fPluginManager.InstantiatePlugins();
+    }
 
     // Log IDLE configuration
     fConfig.PrintOptions();
@@ -13,6 +13,7 @@
 #include <fairmq/EventManager.h>
 #include <fairmq/PluginManager.h>
 #include <fairmq/ProgOptions.h>
+#include <fairmq/tools/Log.h>
 
 #include <functional>
 #include <memory>
@@ -79,6 +80,7 @@ class DeviceRunner
 
   private:
     EventManager fEvents;
+    std::unique_ptr<tools::AsyncLogSink> fAsyncLogSink; // --log-async
 };
 
 namespace hooks {
@@ -103,6 +103,22 @@ class EventManager
         (*GetSignal<E, Args...>(signalsKey))(key, std::forward<Args>(args)...);
     }
 
+    /// @return true if a callback (of any signature) is subscribed to the event type E
+    template<typename E>
+    auto HasSubscribers() const -> bool
+    {
+        const std::type_index event_type_index{typeid(E)};
+
+        std::lock_guard<std::mutex> lock{fMutex};
+
+        for (const auto& c : fConnections) {
+            if (c.first.second.first == event_type_index && c.second.connected()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
   private:
     using SignalsKey   = std::pair<std::type_index, std::type_index>;
                                 // event          , callback
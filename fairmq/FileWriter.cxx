@@ -0,0 +1,375 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairlogger/Logger.h>
+#include <fairmq/FileWriter.h>
+#include <fairmq/Tools.h>
+
+#ifdef BUILD_URING_TRANSPORT
+#include <fairmq/uring/Common.h>
+#endif
+
+#include <fcntl.h>    // open, O_DIRECT
+#include <unistd.h>   // close, ftruncate
+
+#include <algorithm>  // min
+#include <cerrno>
+#include <climits>    // IOV_MAX
+#include <cstring>    // memcpy, memset, strerror
+#include <stdexcept>
+
+using namespace std;
+
+namespace fair::mq {
+
+namespace {
+
+// alignment of buffers, offsets and sizes for O_DIRECT (logical block size of common devices)
+constexpr size_t kDirectAlignment = 4096;
+
+size_t AlignUp(size_t size) { return (size + kDirectAlignment - 1) / kDirectAlignment * kDirectAlignment; }
+
+// write all bytes of iov (after the first skip bytes) at offset
+void WriteAll(int fd, vector<iovec> iov, uint64_t offset, size_t skip)
+{
+    size_t i = 0;
+    auto advance = [&](size_t n) {
+        while (n > 0 && i < iov.size()) {
+            if (n >= iov[i].iov_len) {
+                n -= iov[i].iov_len;
+                ++i;
+            } else {
+                iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + n;
+                iov[i].iov_len -= n;
+                n = 0;
+            }
+        }
+    };
+    advance(skip);
+    offset += skip;
+    while (i < iov.size()) {
+        ssize_t n = pwritev(fd, iov.data() + i, static_cast<int>(min<size_t>(iov.size() - i, IOV_MAX)), static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error(tools::ToString("FileWriter: writing failed: ", strerror(errno)));
+        }
+        offset += n;
+        advance(n);
+    }
+}
+
+}   // namespace
+
+void FileWriter::RingDeleter::operator()([[maybe_unused]] uring::Ring* ring) const
+{
+#ifdef BUILD_URING_TRANSPORT
+    delete ring;
+#endif
+}
+
+FileWriter::FileWriter(FileWriterConfig cfg)
+    : fConfig(std::move(cfg))
+{
+    if (fConfig.filename.empty()) {
+        throw runtime_error("FileWriter: no file name given");
+    }
+    fConfig.bufferSize = max<size_t>(fConfig.bufferSize, kDirectAlignment);
+    if (fConfig.direct) {
+        fConfig.bufferSize = AlignUp(fConfig.bufferSize);
+        for (auto& buffer : fBuffers) {
+            void* ptr = nullptr;
+            if (posix_memalign(&ptr, kDirectAlignment, fConfig.bufferSize) != 0) {
+                throw runtime_error(tools::ToString("FileWriter: failed allocating write buffers of ", fConfig.bufferSize, " bytes"));
+            }
+            buffer.reset(static_cast<char*>(ptr));
+        }
+    }
+    if (fConfig.uring) {
+#ifdef BUILD_URING_TRANSPORT
+        try {
+            fRing.reset(new uring::Ring(4));
+        } catch (uring::UringError& e) {
+            LOG(warn) << "FileWriter: io_uring not available (" << e.what() << "), writing with pwritev";
+        }
+#else
+        LOG(warn) << "FileWriter: built without io_uring support (BUILD_URING_TRANSPORT), writing with pwritev";
+#endif
+    }
+
+    OpenFile();
+    fThread = thread(&FileWriter::Loop, this);
+}
+
+FileWriter::~FileWriter()
+{
+    try {
+        Close();
+    } catch (exception& e) {
+        LOG(error) << "FileWriter: " << e.what();
+    }
+}
+
+string FileWriter::GetFilename(size_t index) const
+{
+    return index == 0 ? fConfig.filename : tools::ToString(fConfig.filename, ".", index);
+}
+
+void FileWriter::Write(MessagePtr msg)
+{
+    size_t size = msg->GetSize();
+    {
+        unique_lock<mutex> lock(fMtx);
+        fSpaceCV.wait(lock, [&]() { return fError || fClosing || fBytesQueued < fConfig.maxQueuedBytes; });
+        if (fError) {
+            rethrow_exception(fError);
+        }
+        if (fClosing) {
+            throw runtime_error("FileWriter: Write() called after Close()");
+        }
+        fQueue.push_back(std::move(msg));
+        fBytesQueued += size;
+    }
+    fQueueCV.notify_one();
+}
+
+void FileWriter::Write(Parts& parts)
+{
+    for (auto& part : parts) {
+        Write(std::move(part));
+    }
+    parts = Parts();
+}
+
+void FileWriter::Close()
+{
+    {
+        lock_guard<mutex> lock(fMtx);
+        if (fClosed) {
+            return;
+        }
+        fClosing = true;
+        fClosed = true;
+    }
+    fQueueCV.notify_one();
+    fSpaceCV.notify_all();
+    if (fThread.joinable()) {
+        fThread.join();
+    }
+    if (fError) {
+        rethrow_exception(fError);
+    }
+}
+
+void FileWriter::Loop()
+{
+    try {
+        vector<MessagePtr> batch;
+        while (true) {
+            {
+                unique_lock<mutex> lock(fMtx);
+                if (fQueue.empty() && !fClosing) {
+                    // nothing to do meanwhile, complete the write in flight to release its messages
+                    lock.unlock();
+                    Complete();
+                    lock.lock();
+                }
+                fQueueCV.wait(lock, [&]() { return !fQueue.empty() || fClosing; });
+                if (fQueue.empty()) {
+                    break;
+                }
+                batch.swap(fQueue);
+            }
+            for (auto& msg : batch) {
+                Append(std::move(msg));
+            }
+            batch.clear();
+            // do not hold messages while waiting for more (direct: only complete buffers can be written)
+            Flush(false);
+        }
+        Flush(true);
+        Complete();
+        CloseFile();
+    } catch (exception& e) {
+        LOG(error) << e.what();
+        {
+            lock_guard<mutex> lock(fMtx);
+            fError = current_exception();
+            fQueue.clear();
+        }
+        fCollecting = Pending();
+        fInFlight = Pending();
+        if (fFd >= 0) {
+            close(fFd);
+            fFd = -1;
+        }
+        fSpaceCV.notify_all();
+    }
+}
+
+void FileWriter::Append(MessagePtr msg)
+{
+    size_t size = msg->GetSize();
+    if (fConfig.direct) {
+        const char* data = static_cast<const char*>(msg->GetData());
+        size_t left = size;
+        while (left > 0) {
+            size_t n = min(left, fConfig.bufferSize - fBufferFill);
+            memcpy(fBuffers[fCurrentBuffer].get() + fBufferFill, data, n);
+            fBufferFill += n;
+            data += n;
+            left -= n;
+            if (fBufferFill == fConfig.bufferSize) {
+                Flush(false);
+            }
+        }
+        msg.reset();
+        {
+            lock_guard<mutex> lock(fMtx);
+            fBytesQueued -= size;
+        }
+        fSpaceCV.notify_all();
+    } else if (size > 0) {
+        fCollecting.fIov.push_back(iovec{msg->GetData(), size});
+        fCollecting.fMsgs.push_back(std::move(msg));
+        fCollecting.fSize += size;
+        if (fCollecting.fSize >= fConfig.bufferSize || fCollecting.fIov.size() >= IOV_MAX) {
+            Flush(false);
+        }
+    }
+    fFileBytes += size;
+
+    if (fConfig.rotateSize > 0 && fFileBytes >= fConfig.rotateSize) {
+        Rotate();
+    }
+}
+
+void FileWriter::Flush(bool final)
+{
+    Pending pending;
+    if (fConfig.direct) {
+        if (fBufferFill == 0 || (!final && fBufferFill < fConfig.bufferSize)) {
+            return;
+        }
+        // direct writes have to be multiples of the block size, CloseFile() truncates the padding
+        size_t size = AlignUp(fBufferFill);
+        memset(fBuffers[fCurrentBuffer].get() + fBufferFill, 0, size - fBufferFill);
+        pending.fIov.push_back(iovec{fBuffers[fCurrentBuffer].get(), size});
+        pending.fSize = fBufferFill;
+        pending.fOffset = fFileOffset;
+        fFileOffset += size;
+        fCurrentBuffer = 1 - fCurrentBuffer;
+        fBufferFill = 0;
+    } else {
+        if (fCollecting.fIov.empty()) {
+            return;
+        }
+        pending = std::move(fCollecting);
+        fCollecting = Pending();
+        pending.fOffset = fFileOffset;
+        fFileOffset += pending.fSize;
+    }
+    Submit(std::move(pending));
+}
+
+void FileWriter::Submit(Pending&& pending)
+{
+    // one write in flight, the other buffer/batch is filled meanwhile
+    Complete();
+    fInFlight = std::move(pending);
+    fInFlight.fSubmitted = chrono::steady_clock::now();
+    fHasInFlight = true;
+#ifdef BUILD_URING_TRANSPORT
+    if (fRing) {
+        io_uring_sqe* sqe = fRing->GetSqe();
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fFd;
+        sqe->addr = reinterpret_cast<uint64_t>(fInFlight.fIov.data());
+        sqe->len = static_cast<uint32_t>(fInFlight.fIov.size());
+        sqe->off = fInFlight.fOffset;
+        fRing->Submit();
+        return;
+    }
+#endif
+    WriteAll(fFd, fInFlight.fIov, fInFlight.fOffset, 0);
+    Complete();
+}
+
+void FileWriter::Complete()
+{
+    if (!fHasInFlight) {
+        return;
+    }
+    fHasInFlight = false;
+#ifdef BUILD_URING_TRANSPORT
+    if (fRing) {
+        io_uring_cqe cqe{};
+        fRing->Wait(cqe);
+        if (cqe.res < 0) {
+            throw runtime_error(tools::ToString("FileWriter: writing failed: ", strerror(-cqe.res)));
+        }
+        size_t total = 0;
+        for (const auto& iov : fInFlight.fIov) {
+            total += iov.iov_len;
+        }
+        if (static_cast<size_t>(cqe.res) < total) {
+            WriteAll(fFd, fInFlight.fIov, fInFlight.fOffset, cqe.res);
+        }
+    }
+#endif
+    fWriteNs += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - fInFlight.fSubmitted).count();
+    fBytesWritten += fInFlight.fSize;
+    size_t size = fInFlight.fSize;
+    bool held = !fInFlight.fMsgs.empty();
+    fInFlight = Pending(); // releases the messages
+    if (held) {
+        {
+            lock_guard<mutex> lock(fMtx);
+            fBytesQueued -= size;
+        }
+        fSpaceCV.notify_all();
+    }
+}
+
+void FileWriter::OpenFile()
+{
+    string filename(GetFilename(fFileIndex));
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (fConfig.direct ? O_DIRECT : 0);
+    fFd = open(filename.c_str(), flags, 0644);
+    if (fFd < 0) {
+        LOG(error) << "Could not open '" << filename << "': " << strerror(errno);
+        throw runtime_error(tools::ToString("Could not open '", filename, "': ", strerror(errno)));
+    }
+    fFileOffset = 0;
+    fFileBytes = 0;
+}
+
+void FileWriter::CloseFile()
+{
+    if (fFd < 0) {
+        return;
+    }
+    if (fConfig.direct && fFileOffset != fFileBytes && ftruncate(fFd, static_cast<off_t>(fFileBytes)) != 0) {
+        throw runtime_error(tools::ToString("FileWriter: truncating '", GetFilename(fFileIndex), "' failed: ", strerror(errno)));
+    }
+    close(fFd);
+    fFd = -1;
+    LOG(debug) << "Closed '" << GetFilename(fFileIndex) << "' after writing " << fFileBytes << " bytes";
+}
+
+void FileWriter::Rotate()
+{
+    Flush(true);
+    Complete();
+    CloseFile();
+    ++fFileIndex;
+    OpenFile();
+}
+
+} // namespace fair::mq
@@ -0,0 +1,132 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_FILEWRITER_H
+#define FAIR_MQ_FILEWRITER_H
+
+#include <fairmq/Message.h>
+#include <fairmq/Parts.h>
+
+#include <sys/uio.h> // iovec
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <cstdlib>   // free
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fair::mq {
+
+namespace uring { class Ring; }
+
+struct FileWriterConfig
+{
+    std::string filename;
+    bool direct = false;                 // open with O_DIRECT and write via aligned buffers (copies), otherwise write the message buffers themselves
+    bool uring = false;                  // submit the writes via io_uring (only if built with BUILD_URING_TRANSPORT), otherwise pwritev
+    size_t bufferSize = 8 << 20;         // bytes per write (size of each of the two aligned buffers with direct)
+    size_t maxQueuedBytes = 256 << 20;   // Write() blocks while more bytes are waiting to be written
+    uint64_t rotateSize = 0;             // start a new file (filename.1, filename.2, ...) after this many bytes, 0: single file
+};
+
+/// Writes messages to a file on a separate thread, so that writing does not block receiving.
+/// Messages are held (not copied) until they have been written, unless direct I/O is used. Writes are batched
+/// and double buffered: the next batch is assembled while the previous one is in flight.
+/// Errors of the writer thread are rethrown (as std::runtime_error) by the next Write() or by Close().
+class FileWriter
+{
+  public:
+    explicit FileWriter(FileWriterConfig cfg);
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter(FileWriter&&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+    FileWriter& operator=(FileWriter&&) = delete;
+
+    /// closes the writer, errors are logged
+    ~FileWriter();
+
+    /// @brief Queue a message for writing, blocks while more than maxQueuedBytes are queued
+    void Write(MessagePtr msg);
+    /// @brief Queue all parts for writing (in order), parts is empty afterwards
+    void Write(Parts& parts);
+
+    /// @brief Write all queued messages, close the file and stop the writer thread
+    void Close();
+
+    /// Bytes written to disk (in all files)
+    uint64_t GetBytesWritten() const { return fBytesWritten.load(); }
+    /// Bytes queued but not yet written
+    uint64_t GetBytesQueued() const { return fBytesQueued.load(); }
+    /// Time the writer thread spent in write calls, in seconds
+    double GetWriteSeconds() const { return fWriteNs.load() / 1e9; }
+    /// Number of files opened so far
+    size_t GetNumFiles() const { return fFileIndex.load() + 1; }
+    /// name of the file with the given index
+    std::string GetFilename(size_t index) const;
+
+  private:
+    struct FreeDeleter { void operator()(char* ptr) const { std::free(ptr); } };
+    struct RingDeleter { void operator()(uring::Ring* ring) const; };
+    // a write in flight, buffers have to remain valid until it is completed
+    struct Pending
+    {
+        std::vector<iovec> fIov;
+        std::vector<MessagePtr> fMsgs;
+        uint64_t fOffset = 0;
+        size_t fSize = 0; // payload bytes (without the padding of direct writes)
+        std::chrono::steady_clock::time_point fSubmitted;
+    };
+
+    void Loop();
+    void Append(MessagePtr msg);
+    void Flush(bool final);
+    void Submit(Pending&& pending);
+    void Complete();
+    void OpenFile();
+    void CloseFile();
+    void Rotate();
+
+    FileWriterConfig fConfig;
+    int fFd = -1;
+    uint64_t fFileOffset = 0;   // submitted to the current file (including padding with direct)
+    uint64_t fFileBytes = 0;    // payload bytes in the current file
+    std::atomic<size_t> fFileIndex{0};
+
+    std::unique_ptr<char, FreeDeleter> fBuffers[2]; // direct
+    int fCurrentBuffer = 0;
+    size_t fBufferFill = 0;
+    Pending fCollecting;        // buffered: batch of the next write
+    Pending fInFlight;
+    bool fHasInFlight = false;
+    std::unique_ptr<uring::Ring, RingDeleter> fRing;
+
+    std::mutex fMtx;
+    std::condition_variable fQueueCV;  // queue not empty / closing
+    std::condition_variable fSpaceCV;  // queued bytes decreased / error
+    std::vector<MessagePtr> fQueue;
+    bool fClosing = false;
+    bool fClosed = false;
+    std::exception_ptr fError;
+
+    std::atomic<uint64_t> fBytesQueued{0};
+    std::atomic<uint64_t> fBytesWritten{0};
+    std::atomic<uint64_t> fWriteNs{0};
+    std::thread fThread;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_FILEWRITER_H */
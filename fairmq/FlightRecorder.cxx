@@ -0,0 +1,267 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairlogger/Logger.h>
+#include <fairmq/FlightRecorder.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fcntl.h>      // open
+#include <sys/mman.h>   // mmap, msync
+#include <sys/stat.h>   // fstat
+#include <unistd.h>     // close, ftruncate
+
+#include <algorithm>    // min
+#include <cerrno>
+#include <cstring>      // memcpy, strerror, strncpy
+#include <new>          // placement new
+#include <stdexcept>
+
+using namespace std;
+
+namespace fair::mq {
+
+namespace {
+
+constexpr char kMagic[8] = {'F', 'M', 'Q', 'F', 'R', 'E', 'C', '1'};
+constexpr size_t kMaxChannels = 256;
+constexpr size_t kNameSize = 64;
+constexpr size_t kReasonSize = 256;
+
+constexpr size_t AlignUp(size_t size) { return (size + 63) / 64 * 64; }
+
+} // namespace
+
+struct FlightRecorder::Header
+{
+    char fMagic[8];
+    uint64_t fNumEntries;
+    uint64_t fDataSize;
+    atomic<uint64_t> fNextEntry;  // entries recorded so far
+    atomic<uint64_t> fNextByte;   // data bytes recorded so far (position in the data ring before wrapping)
+    atomic<uint32_t> fFrozen;
+    atomic<uint32_t> fNumChannels;
+    char fReason[kReasonSize];
+    char fChannels[kMaxChannels][kNameSize];
+};
+
+struct FlightRecorder::Entry
+{
+    atomic<uint64_t> fSeq;  // entry number + 1 once recorded, 0 while being written
+    uint64_t fOffset;       // position of the data in the data ring (before wrapping)
+    uint64_t fSize;
+    uint64_t fStored;       // bytes in the data ring
+    int64_t fTimeNs;        // since the epoch of the system clock
+    uint32_t fChannel;
+    uint16_t fPart;
+    uint8_t fSend;
+    uint8_t fLast;
+};
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "the flight recorder needs lock-free 64 bit atomics in the mapping");
+
+FlightRecorder::FlightRecorder(FlightRecorderConfig cfg)
+    : fConfig(std::move(cfg))
+{
+    if (fConfig.path.empty() || fConfig.size == 0 || fConfig.numEntries == 0) {
+        throw runtime_error("FlightRecorder: path, size and number of entries have to be provided");
+    }
+    fConfig.maxMessageSize = min(fConfig.maxMessageSize, fConfig.size);
+
+    const size_t entriesOffset = AlignUp(sizeof(Header));
+    const size_t dataOffset = entriesOffset + AlignUp(fConfig.numEntries * sizeof(Entry));
+    fMappingSize = dataOffset + fConfig.size;
+
+    fFd = open(fConfig.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fFd < 0) {
+        throw runtime_error(tools::ToString("FlightRecorder: could not open ", fConfig.path, ": ", strerror(errno)));
+    }
+    if (ftruncate(fFd, static_cast<off_t>(fMappingSize)) != 0) {
+        int error = errno;
+        close(fFd);
+        throw runtime_error(tools::ToString("FlightRecorder: could not resize ", fConfig.path, " to ", fMappingSize, " bytes: ", strerror(error)));
+    }
+    void* mapping = mmap(nullptr, fMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fFd, 0);
+    if (mapping == MAP_FAILED) {
+        int error = errno;
+        close(fFd);
+        throw runtime_error(tools::ToString("FlightRecorder: could not map ", fConfig.path, ": ", strerror(error)));
+    }
+    fMapping = static_cast<char*>(mapping);
+
+    // the file is zero-filled, which is the initial state of the counters and entries
+    fHeader = new (fMapping) Header();
+    memcpy(fHeader->fMagic, kMagic, sizeof(kMagic));
+    fHeader->fNumEntries = fConfig.numEntries;
+    fHeader->fDataSize = fConfig.size;
+    fEntries = reinterpret_cast<Entry*>(fMapping + entriesOffset);
+    for (size_t i = 0; i < fConfig.numEntries; ++i) {
+        new (&fEntries[i]) Entry();
+    }
+    fData = fMapping + dataOffset;
+
+    LOG(debug) << "Flight recorder: recording into " << fConfig.path << " (" << fConfig.size << " bytes, " << fConfig.numEntries << " entries)";
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    munmap(fMapping, fMappingSize);
+    close(fFd);
+}
+
+uint32_t FlightRecorder::RegisterChannel(const string& name)
+{
+    lock_guard<mutex> lock(fNamesMtx);
+    const uint32_t numChannels = fHeader->fNumChannels.load(memory_order_relaxed);
+    for (uint32_t i = 0; i < numChannels; ++i) {
+        if (strncmp(fHeader->fChannels[i], name.c_str(), kNameSize - 1) == 0) {
+            return i;
+        }
+    }
+    if (numChannels == kMaxChannels) {
+        return kMaxChannels - 1;
+    }
+    strncpy(fHeader->fChannels[numChannels], name.c_str(), kNameSize - 1);
+    fHeader->fNumChannels.store(numChannels + 1, memory_order_release);
+    return numChannels;
+}
+
+void FlightRecorder::Record(uint32_t channel, bool send, const void* data, size_t size, uint16_t part, bool last)
+{
+    if (fHeader->fFrozen.load(memory_order_relaxed) != 0) {
+        return;
+    }
+    const size_t stored = min(size, fConfig.maxMessageSize);
+    const uint64_t n = fHeader->fNextEntry.fetch_add(1, memory_order_relaxed);
+    const uint64_t offset = fHeader->fNextByte.fetch_add(stored, memory_order_relaxed);
+
+    Entry& entry = fEntries[n % fConfig.numEntries];
+    entry.fSeq.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // readers must not see the new data with the old sequence number
+
+    const size_t pos = offset % fConfig.size;
+    const size_t first = min(stored, fConfig.size - pos);
+    memcpy(fData + pos, data, first);
+    if (first < stored) {
+        memcpy(fData, static_cast<const char*>(data) + first, stored - first);
+    }
+
+    entry.fOffset = offset;
+    entry.fSize = size;
+    entry.fStored = stored;
+    entry.fTimeNs = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    entry.fChannel = channel;
+    entry.fPart = part;
+    entry.fSend = send ? 1 : 0;
+    entry.fLast = last ? 1 : 0;
+    entry.fSeq.store(n + 1, memory_order_release);
+}
+
+void FlightRecorder::Freeze(const string& reason)
+{
+    if (fHeader->fFrozen.exchange(1) != 0) {
+        return;
+    }
+    strncpy(fHeader->fReason, reason.c_str(), kReasonSize - 1);
+    if (msync(fMapping, fMappingSize, MS_SYNC) != 0) {
+        LOG(error) << "Flight recorder: could not write " << fConfig.path << ": " << strerror(errno);
+        return;
+    }
+    LOG(warn) << "Flight recorder frozen (" << reason << "), " << fHeader->fNextEntry.load() << " messages recorded, last ones written to " << fConfig.path;
+}
+
+bool FlightRecorder::Frozen() const
+{
+    return fHeader->fFrozen.load(memory_order_relaxed) != 0;
+}
+
+namespace {
+
+// read-only mapping of a flight recorder file
+struct FileMapping
+{
+    explicit FileMapping(const string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw runtime_error(tools::ToString("FlightRecorder: could not open ", path, ": ", strerror(errno)));
+        }
+        struct stat st{};
+        if (fstat(fd, &st) == 0) {
+            fSize = static_cast<size_t>(st.st_size);
+        }
+        if (fSize >= sizeof(FlightRecorder::Header)) {
+            void* mapping = mmap(nullptr, fSize, PROT_READ, MAP_SHARED, fd, 0);
+            fPtr = mapping == MAP_FAILED ? nullptr : static_cast<const char*>(mapping);
+        }
+        close(fd);
+        if (!fPtr || memcmp(fPtr, kMagic, sizeof(kMagic)) != 0) {
+            throw runtime_error(tools::ToString("FlightRecorder: ", path, " is not a flight recorder file"));
+        }
+    }
+    FileMapping(const FileMapping&) = delete;
+    FileMapping(FileMapping&&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+    FileMapping& operator=(FileMapping&&) = delete;
+    ~FileMapping() { munmap(const_cast<char*>(fPtr), fSize); }
+
+    const char* fPtr = nullptr;
+    size_t fSize = 0;
+};
+
+} // namespace
+
+vector<FlightRecord> FlightRecorder::Read(const string& path, chrono::milliseconds window)
+{
+    FileMapping file(path);
+    const auto& header = *reinterpret_cast<const Header*>(file.fPtr);
+    const size_t entriesOffset = AlignUp(sizeof(Header));
+    const size_t dataOffset = entriesOffset + AlignUp(header.fNumEntries * sizeof(Entry));
+    if (file.fSize < dataOffset + header.fDataSize) {
+        throw runtime_error(tools::ToString("FlightRecorder: ", path, " is truncated"));
+    }
+    const auto* entries = reinterpret_cast<const Entry*>(file.fPtr + entriesOffset);
+    const char* data = file.fPtr + dataOffset;
+
+    const uint64_t next = header.fNextEntry.load(memory_order_acquire);
+    const uint64_t nextByte = header.fNextByte.load(memory_order_acquire);
+    const uint32_t numChannels = header.fNumChannels.load(memory_order_acquire);
+    vector<FlightRecord> records;
+    for (uint64_t n = next > header.fNumEntries ? next - header.fNumEntries : 0; n < next; ++n) {
+        const Entry& entry = entries[n % header.fNumEntries];
+        if (entry.fSeq.load(memory_order_acquire) != n + 1 || entry.fOffset + header.fDataSize < nextByte) {
+            continue; // being written, or its data has been overwritten
+        }
+        FlightRecord record;
+        record.channel = entry.fChannel < numChannels ? string(header.fChannels[entry.fChannel], strnlen(header.fChannels[entry.fChannel], kNameSize)) : string();
+        record.send = entry.fSend != 0;
+        record.part = entry.fPart;
+        record.last = entry.fLast != 0;
+        record.time = chrono::system_clock::time_point(chrono::duration_cast<chrono::system_clock::duration>(chrono::nanoseconds(entry.fTimeNs)));
+        record.size = entry.fSize;
+        record.data.resize(entry.fStored);
+        const size_t pos = entry.fOffset % header.fDataSize;
+        const size_t first = min<size_t>(entry.fStored, header.fDataSize - pos);
+        memcpy(record.data.data(), data + pos, first);
+        memcpy(record.data.data() + first, data, entry.fStored - first);
+        records.push_back(std::move(record));
+    }
+    if (window.count() > 0 && !records.empty()) {
+        const auto from = records.back().time - window;
+        records.erase(records.begin(), find_if(records.begin(), records.end(), [&](const FlightRecord& r) { return r.time >= from; }));
+    }
+    return records;
+}
+
+string FlightRecorder::ReadFreezeReason(const string& path)
+{
+    FileMapping file(path);
+    const auto& header = *reinterpret_cast<const Header*>(file.fPtr);
+    return string(header.fReason, strnlen(header.fReason, kReasonSize));
+}
+
+} // namespace fair::mq
@@ -0,0 +1,95 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_FLIGHTRECORDER_H
+#define FAIR_MQ_FLIGHTRECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fair::mq {
+
+struct FlightRecorderConfig
+{
+    std::string path;              // file of the ring, created or truncated
+    size_t size = 64 << 20;        // bytes of the data ring
+    size_t numEntries = 1 << 16;   // entries of the index ring
+    size_t maxMessageSize = 1 << 20; // larger messages are recorded truncated to this size
+};
+
+/// A message (part) read back from a flight recorder file, see FlightRecorder::Read()
+struct FlightRecord
+{
+    std::string channel;
+    bool send;             ///< recorded by Send (otherwise by Receive)
+    uint16_t part;         ///< index of the part in its multipart message
+    bool last;             ///< last part of its multipart message
+    std::chrono::system_clock::time_point time;
+    uint64_t size;         ///< size of the message, data holds at most FlightRecorderConfig::maxMessageSize bytes
+    std::vector<char> data;
+};
+
+/// Keeps copies of the most recent messages of the tapped channels (see Channel::SetFlightRecorder()) in a circular
+/// file-backed mapping: a header, a compact index ring and a data ring. Recording is lock-free (writers reserve their
+/// entry and data range with atomic counters) and costs one memcpy per message part. The oldest messages are
+/// overwritten, so the file holds the last seconds of traffic that fit into it. Freeze() stops the recording and
+/// writes the mapping to the file, for post-mortem analysis with Read().
+/// The mapping is shared, so the kernel writes back the recorded data even if the process dies without freezing.
+class FlightRecorder
+{
+  public:
+    explicit FlightRecorder(FlightRecorderConfig cfg);
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder(FlightRecorder&&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(FlightRecorder&&) = delete;
+
+    ~FlightRecorder();
+
+    /// @return id of the channel name in the records, names beyond the capacity of the name table share the last id
+    uint32_t RegisterChannel(const std::string& name);
+
+    /// Record a copy of a message (part), can be called from any thread. No-op once frozen.
+    void Record(uint32_t channel, bool send, const void* data, size_t size, uint16_t part, bool last);
+
+    /// Stop recording and write the ring to the file. Only the first call has an effect.
+    /// @param reason logged and stored in the file
+    void Freeze(const std::string& reason);
+    bool Frozen() const;
+
+    const std::string& GetPath() const { return fConfig.path; }
+
+    /// Read the records of a flight recorder file, oldest first
+    /// @param window only the records of the last window before the most recent one (0: all)
+    static std::vector<FlightRecord> Read(const std::string& path, std::chrono::milliseconds window = std::chrono::milliseconds(0));
+    /// @return the reason given to Freeze(), empty if the recorder was not frozen
+    static std::string ReadFreezeReason(const std::string& path);
+
+    struct Header;
+    struct Entry;
+
+  private:
+    FlightRecorderConfig fConfig;
+    int fFd = -1;
+    char* fMapping = nullptr;
+    size_t fMappingSize = 0;
+    Header* fHeader = nullptr;
+    Entry* fEntries = nullptr;
+    char* fData = nullptr;
+    std::mutex fNamesMtx; // channel registration
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_FLIGHTRECORDER_H */
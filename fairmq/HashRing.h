@@ -0,0 +1,85 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_HASHRING_H
+#define FAIR_MQ_HASHRING_H
+
+#include <algorithm> // sort, upper_bound
+#include <cstdint>
+#include <string>
+#include <utility>   // pair
+#include <vector>
+
+namespace fair::mq
+{
+
+/// Consistent hashing of keys onto nodes (e.g. the subchannels of a channel with route=hash).
+/// Every node is placed on a ring of 64 bit hashes with a number of replicas (virtual nodes), derived from its name
+/// only, and a key belongs to the first node following its hash. Adding or removing a node thus moves only the keys
+/// of this node (about 1/n of them), the other keys keep their node, in every process using the same node names.
+class HashRing
+{
+  public:
+    static constexpr int DefaultReplicas = 128;
+
+    HashRing() = default;
+
+    /// @param nodes names of the nodes, stable across reconfigurations (e.g. the subchannel addresses)
+    /// @param replicas number of points per node on the ring, more give a more even distribution
+    explicit HashRing(const std::vector<std::string>& nodes, int replicas = DefaultReplicas)
+    {
+        fRing.reserve(nodes.size() * replicas);
+        for (size_t node = 0; node < nodes.size(); ++node) {
+            const uint64_t nameHash = Fnv1a(nodes[node]);
+            for (int r = 0; r < replicas; ++r) {
+                fRing.emplace_back(Mix(nameHash + static_cast<uint64_t>(r)), static_cast<int>(node));
+            }
+        }
+        std::sort(fRing.begin(), fRing.end());
+        fNumNodes = nodes.size();
+    }
+
+    /// @return index of the node (in the order given to the constructor) that key belongs to, -1 without nodes
+    int Lookup(uint64_t key) const
+    {
+        if (fRing.empty()) {
+            return -1;
+        }
+        const uint64_t hash = Mix(key);
+        auto it = std::upper_bound(fRing.begin(), fRing.end(), hash, [](uint64_t h, const std::pair<uint64_t, int>& point) { return h < point.first; });
+        return it == fRing.end() ? fRing.front().second : it->second;
+    }
+
+    size_t GetNumNodes() const { return fNumNodes; }
+
+    /// 64 bit FNV-1a hash of a string, the same on every platform
+    static uint64_t Fnv1a(const std::string& str)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char c : str) {
+            hash = (hash ^ c) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    /// finalizer of splitmix64, spreads consecutive keys (e.g. frame ids) over the ring
+    static uint64_t Mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+  private:
+    std::vector<std::pair<uint64_t, int>> fRing; // sorted points: hash, node
+    size_t fNumNodes = 0;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_HASHRING_H */
@@ -0,0 +1,337 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_HYBRIDSOCKET_H
+#define FAIR_MQ_HYBRIDSOCKET_H
+
+#include <fairlogger/Logger.h>
+#include <fairmq/Socket.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Network.h>
+
+#include <zmq.h>
+#include <poll.h>
+#include <unistd.h> // gethostname
+
+#include <algorithm> // max
+#include <chrono>
+#include <cstring> // memcpy
+#include <string>
+#include <utility> // move
+#include <vector>
+
+namespace fair::mq
+{
+
+/// Socket of a hybrid channel (channel property hybrid): peers on the same host are served by the local (shmem) socket,
+/// the others by the remote (zeromq) socket. A bind binds the remote socket to the tcp address and the local one to an
+/// ipc address derived from its port, a connect picks one of them from the host of the address. Sends go to whichever
+/// socket can take the message first (push/pair), alternating between the two, or to both (pub, remote peers get a copy).
+/// Receives take the next message of either socket, alternating between the two.
+class HybridSocket final : public Socket
+{
+  public:
+    HybridSocket(SocketPtr local, SocketPtr remote, const std::string& type)
+        : Socket(local->GetTransport())
+        , fLocal(std::move(local))
+        , fRemote(std::move(remote))
+        , fBroadcast(type == "pub")
+    {}
+
+    HybridSocket(const HybridSocket&) = delete;
+    HybridSocket(HybridSocket&&) = delete;
+    HybridSocket& operator=(const HybridSocket&) = delete;
+    HybridSocket& operator=(HybridSocket&&) = delete;
+
+    /// ipc address of the local socket of a hybrid channel bound to the tcp address (ports are unique per host)
+    static std::string LocalAddress(const std::string& address)
+    {
+        const std::string port(address.substr(address.rfind(':') + 1));
+#ifdef __linux__
+        return "ipc://@fmq_hybrid_" + port; // abstract namespace, no file to clean up
+#else
+        return "ipc:///tmp/fmq_hybrid_" + port;
+#endif
+    }
+
+    /// @return true if the host of the tcp address is this host
+    static bool IsLocalAddress(const std::string& address)
+    {
+        const size_t begin = address.find("://") == std::string::npos ? 0 : address.find("://") + 3;
+        std::string host(address.substr(begin, address.rfind(':') - begin));
+        if (host.size() > 1 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+        if (host == "localhost" || host == "::1" || host.compare(0, 4, "127.") == 0) {
+            return true;
+        }
+        char hostname[256] = {};
+        if (gethostname(hostname, sizeof(hostname) - 1) == 0 && host == hostname) {
+            return true;
+        }
+        try {
+            const auto ips(tools::getHostIPs());
+            std::string ip(host);
+            for (int i = 0; i < 2; ++i) {
+                for (const auto& entry : ips) {
+                    if (entry.second == ip) {
+                        return true;
+                    }
+                }
+                ip = tools::getIpFromHostname(host);
+                if (ip.compare(0, 4, "127.") == 0) {
+                    return true;
+                }
+            }
+        } catch (const std::exception& e) {
+            LOG(debug) << "could not resolve " << host << ", assuming a remote peer: " << e.what();
+        }
+        return false;
+    }
+
+    std::string GetId() const override { return fLocal->GetId(); }
+
+    bool Bind(const std::string& address) override
+    {
+        if (!fRemote->Bind(address)) {
+            return false;
+        }
+        const std::string bound(fRemote->GetBoundAddress().empty() ? address : fRemote->GetBoundAddress());
+        if (!fLocal->Bind(LocalAddress(bound))) {
+            LOG(error) << "hybrid socket " << GetId() << ": could not bind the local socket to " << LocalAddress(bound) << " (for " << bound << ")";
+            return false;
+        }
+        fBoundAddress = bound;
+        return true;
+    }
+
+    bool Connect(const std::string& address) override
+    {
+        if (IsLocalAddress(address)) {
+            LOG(debug) << "hybrid socket " << GetId() << ": " << address << " is local, connecting via " << LocalAddress(address);
+            return fLocal->Connect(LocalAddress(address));
+        }
+        LOG(debug) << "hybrid socket " << GetId() << ": " << address << " is remote, connecting via tcp";
+        return fRemote->Connect(address);
+    }
+
+    std::string GetBoundAddress() const override { return fBoundAddress; }
+
+    int64_t Send(MessagePtr& msg, int timeout = -1) override { return SendAny(msg, timeout); }
+    int64_t Receive(MessagePtr& msg, int timeout = -1) override { return ReceiveAny(msg, timeout); }
+    int64_t Send(std::vector<MessagePtr>& msgVec, int timeout = -1) override { return SendAny(msgVec, timeout); }
+    int64_t Receive(std::vector<MessagePtr>& msgVec, int timeout = -1) override { return ReceiveAny(msgVec, timeout); }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    void Close() override
+    {
+        fLocal->Close();
+        fRemote->Close();
+    }
+#pragma GCC diagnostic pop
+
+    void SetOption(const std::string& option, const void* value, size_t valueSize) override
+    {
+        fLocal->SetOption(option, value, valueSize);
+        fRemote->SetOption(option, value, valueSize);
+    }
+    void GetOption(const std::string& option, void* value, size_t* valueSize) override { fLocal->GetOption(option, value, valueSize); }
+
+    int Events(uint32_t* events) override
+    {
+        uint32_t local = 0;
+        uint32_t remote = 0;
+        if (fLocal->Events(&local) < 0 || fRemote->Events(&remote) < 0) {
+            return -1;
+        }
+        *events = local | remote;
+        return 0;
+    }
+
+    void SetLinger(int value) override { fLocal->SetLinger(value); fRemote->SetLinger(value); }
+    int GetLinger() const override { return fLocal->GetLinger(); }
+    void SetSndBufSize(int value) override { fLocal->SetSndBufSize(value); fRemote->SetSndBufSize(value); }
+    int GetSndBufSize() const override { return fLocal->GetSndBufSize(); }
+    void SetRcvBufSize(int value) override { fLocal->SetRcvBufSize(value); fRemote->SetRcvBufSize(value); }
+    int GetRcvBufSize() const override { return fLocal->GetRcvBufSize(); }
+    void SetSndKernelSize(int value) override { fLocal->SetSndKernelSize(value); fRemote->SetSndKernelSize(value); }
+    int GetSndKernelSize() const override { return fLocal->GetSndKernelSize(); }
+    void SetRcvKernelSize(int value) override { fLocal->SetRcvKernelSize(value); fRemote->SetRcvKernelSize(value); }
+    int GetRcvKernelSize() const override { return fLocal->GetRcvKernelSize(); }
+    void SetRcvMode(const std::string& mode, int spinUs) override { fLocal->SetRcvMode(mode, spinUs); fRemote->SetRcvMode(mode, spinUs); }
+    unsigned long GetRcvSpinTime() const override { return fLocal->GetRcvSpinTime() + fRemote->GetRcvSpinTime(); }
+    void SetSndBatch(int size, int timeoutUs) override { fLocal->SetSndBatch(size, timeoutUs); fRemote->SetSndBatch(size, timeoutUs); }
+    void SetSndBatchLatencyTarget(int targetUs) override { fLocal->SetSndBatchLatencyTarget(targetUs); fRemote->SetSndBatchLatencyTarget(targetUs); }
+    void SetMetaFormat(const std::string& format) override { fLocal->SetMetaFormat(format); fRemote->SetMetaFormat(format); }
+    void SetPackParts(int maxPartSize) override { fLocal->SetPackParts(maxPartSize); fRemote->SetPackParts(maxPartSize); }
+    void SetTrace(bool enable) override { fLocal->SetTrace(enable); fRemote->SetTrace(enable); }
+    // the options of the wire (compression, chunks) concern the remote peers only
+    void SetCompression(const std::string& codec, int level, int threads, int minSize) override { fRemote->SetCompression(codec, level, threads, minSize); }
+    void SetChunkSize(int chunkSize) override { fRemote->SetChunkSize(chunkSize); }
+    void SetChunkTarget(TransportFactory* target) override { fRemote->SetChunkTarget(target); }
+    void SetChunkCallback(ChunkCallback callback) override { fRemote->SetChunkCallback(std::move(callback)); }
+    void GetCompressionMetrics(ChannelMetrics& metrics) const override { fRemote->GetCompressionMetrics(metrics); }
+
+    unsigned long GetBytesTx() const override { return fLocal->GetBytesTx() + fRemote->GetBytesTx(); }
+    unsigned long GetBytesRx() const override { return fLocal->GetBytesRx() + fRemote->GetBytesRx(); }
+    unsigned long GetMessagesTx() const override { return fLocal->GetMessagesTx() + fRemote->GetMessagesTx(); }
+    unsigned long GetMessagesRx() const override { return fLocal->GetMessagesRx() + fRemote->GetMessagesRx(); }
+
+    unsigned long GetNumberOfConnectedPeers() const override { return fLocal->GetNumberOfConnectedPeers() + fRemote->GetNumberOfConnectedPeers(); }
+    int GetRttUs() const override { return fRemote->GetRttUs(); }
+    int64_t GetQueueDepth(bool& exact) const override
+    {
+        bool localExact = false;
+        bool remoteExact = false;
+        const int64_t local = fLocal->GetQueueDepth(localExact);
+        const int64_t remote = fRemote->GetQueueDepth(remoteExact);
+        exact = local >= 0 && remote >= 0 && localExact && remoteExact;
+        return local < 0 && remote < 0 ? -1 : std::max<int64_t>(local, 0) + std::max<int64_t>(remote, 0);
+    }
+
+    Socket& GetLocalSocket() { return *fLocal; }
+    Socket& GetRemoteSocket() { return *fRemote; }
+
+    ~HybridSocket() override = default;
+
+  private:
+    // wrap a message of another transport (zero-copy where the target transport can use the buffer, e.g. zeromq)
+    static bool Adapt(MessagePtr& msg, TransportFactory& transport)
+    {
+        if (msg->GetType() == transport.GetType()) {
+            return true;
+        }
+        const TraceContext context(msg->GetTraceContext());
+        MessagePtr adapted;
+        if (msg->GetSize() == 0) {
+            adapted = transport.CreateMessage();
+        } else if (msg->GetData()) {
+            adapted = transport.CreateMessage(msg->GetData(), msg->GetSize(), [](void* /*data*/, void* _msg) { delete static_cast<Message*>(_msg); }, msg.get());
+            msg.release();
+        } else {
+            LOG(error) << "cannot send " << msg->GetType() << " message on " << transport.GetType() << " socket: its buffer is not accessible";
+            return false;
+        }
+        adapted->SetTraceContext(context);
+        msg = std::move(adapted);
+        return true;
+    }
+    static bool Adapt(std::vector<MessagePtr>& msgVec, TransportFactory& transport)
+    {
+        for (auto& msg : msgVec) {
+            if (!Adapt(msg, transport)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static MessagePtr Copy(const MessagePtr& msg, TransportFactory& transport)
+    {
+        MessagePtr copy(transport.CreateMessage(msg->GetSize()));
+        if (msg->GetSize() > 0) {
+            std::memcpy(copy->GetData(), msg->GetData(), msg->GetSize());
+        }
+        copy->SetTraceContext(msg->GetTraceContext());
+        return copy;
+    }
+    static std::vector<MessagePtr> Copy(const std::vector<MessagePtr>& msgVec, TransportFactory& transport)
+    {
+        std::vector<MessagePtr> copy;
+        copy.reserve(msgVec.size());
+        for (const auto& msg : msgVec) {
+            copy.push_back(Copy(msg, transport));
+        }
+        return copy;
+    }
+
+    static MessagePtr NewTarget(const MessagePtr&, Socket& socket) { return socket.GetTransport()->CreateMessage(); }
+    static std::vector<MessagePtr> NewTarget(const std::vector<MessagePtr>&, Socket&) { return {}; }
+
+    template<typename M>
+    int64_t SendAny(M& msgs, int timeout)
+    {
+        if (fBroadcast) {
+            // subscribers of both sockets get the message, the remote ones a copy
+            M copy(Copy(msgs, *fRemote->GetTransport()));
+            const int64_t remote = fRemote->Send(copy, timeout);
+            if (remote < 0) {
+                return remote;
+            }
+            return Adapt(msgs, *fLocal->GetTransport()) ? fLocal->Send(msgs, timeout) : static_cast<int64_t>(TransferCode::error);
+        }
+        return Transfer(timeout, ZMQ_POLLOUT, fNextSend, [&](Socket& socket) {
+            if (!Adapt(msgs, *socket.GetTransport())) {
+                return static_cast<int64_t>(TransferCode::error);
+            }
+            return socket.Send(msgs, 0);
+        });
+    }
+
+    template<typename M>
+    int64_t ReceiveAny(M& msgs, int timeout)
+    {
+        return Transfer(timeout, ZMQ_POLLIN, fNextReceive, [&](Socket& socket) {
+            // a message of the transport of the socket, handed out only if one is received
+            M received(NewTarget(msgs, socket));
+            const int64_t result = socket.Receive(received, 0);
+            if (result >= 0) {
+                msgs = std::move(received);
+            }
+            return result;
+        });
+    }
+
+    // non-blocking attempts on both sockets, starting with next, in between wait for the event on (at most) 1 ms steps
+    // (the file descriptors of the sockets do not signal meta ring transfers of the shmem transport)
+    template<typename Attempt>
+    int64_t Transfer(int timeout, uint32_t event, int& next, Attempt attempt)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        Socket* sockets[2] = { fLocal.get(), fRemote.get() };
+        while (true) {
+            for (int i = 0; i < 2; ++i) {
+                const int index = (next + i) % 2;
+                const int64_t result = attempt(*sockets[index]);
+                if (result != static_cast<int64_t>(TransferCode::timeout)) {
+                    next = (index + 1) % 2;
+                    return result;
+                }
+            }
+            if (timeout == 0 || (timeout > 0 && std::chrono::steady_clock::now() >= deadline)) {
+                return static_cast<int64_t>(TransferCode::timeout);
+            }
+            uint32_t events = 0;
+            if (Events(&events) == 0 && (events & event) != 0) {
+                continue;
+            }
+            pollfd fds[2] = { { Fd(*fLocal), POLLIN, 0 }, { Fd(*fRemote), POLLIN, 0 } };
+            poll(fds, 2, 1);
+        }
+    }
+
+    static int Fd(Socket& socket)
+    {
+        int fd = -1;
+        size_t size = sizeof(fd);
+        socket.GetOption("fd", &fd, &size);
+        return fd;
+    }
+
+    SocketPtr fLocal;
+    SocketPtr fRemote;
+    bool fBroadcast;
+    std::string fBoundAddress;
+    int fNextSend = 0;
+    int fNextReceive = 0;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_HYBRIDSOCKET_H */
@@ -0,0 +1,190 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPUTSCHEDULER_H
+#define FAIR_MQ_INPUTSCHEDULER_H
+
+#include <algorithm> // max
+#include <chrono>
+#include <cstddef> // size_t
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fair::mq
+{
+
+/// Order in which the device event loop handles the ready input (sub)channels, see Device::SetInputPriority()
+enum class InputDispatch
+{
+    order,    //! one message of every ready input per poll, in the order of the OnData() registrations
+    priority, //! strict priority: the highest priority ready input is always handled next
+    weighted, //! weighted round-robin: every ready input gets up to its priority (at least 1) messages per round
+    deadline  //! earliest deadline first: the input waiting longest relative to its deadline is handled next
+};
+
+/// @param dispatch "order", "priority", "weighted" or "deadline"
+inline InputDispatch ParseInputDispatch(const std::string& dispatch)
+{
+    if (dispatch == "order") {
+        return InputDispatch::order;
+    } else if (dispatch == "priority") {
+        return InputDispatch::priority;
+    } else if (dispatch == "weighted") {
+        return InputDispatch::weighted;
+    } else if (dispatch == "deadline") {
+        return InputDispatch::deadline;
+    }
+    throw std::runtime_error("Invalid input dispatch '" + dispatch + "', valid are 'order', 'priority', 'weighted' and 'deadline'");
+}
+
+/// Dispatch settings of an input channel, see Device::SetInputPriority()
+struct InputPriority
+{
+    int fPriority = 0;                       ///< higher first (priority), messages per round (weighted), tie-break (deadline)
+    int fBudget = 0;                         ///< messages per poll iteration of the event loop, 0: no limit
+    std::chrono::milliseconds fDeadline{0};  ///< latency target (deadline), 0: none, served after all inputs with one
+};
+
+/// Picks the next ready input of a poll loop according to an InputDispatch policy (other than order). The loop marks
+/// the inputs that are ready after every poll, handles the one returned by Next() and polls again without waiting
+/// until Next() finds none. Used by one thread.
+class InputScheduler
+{
+    using clock = std::chrono::steady_clock;
+
+  public:
+    InputScheduler(InputDispatch dispatch, std::vector<InputPriority> inputs)
+        : fDispatch(dispatch)
+        , fInputs(inputs.size())
+    {
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            fInputs[i].fSettings = inputs[i];
+        }
+        Refill();
+    }
+
+    /// start of an iteration of the event loop (before its blocking poll), resets the budgets
+    void NewIteration()
+    {
+        for (auto& input : fInputs) {
+            input.fHandled = 0;
+        }
+    }
+
+    /// @param ready indices of the inputs that are ready after the last poll (ascending)
+    void SetReady(const std::vector<int>& ready)
+    {
+        const auto now = clock::now();
+        auto it = ready.begin();
+        for (size_t i = 0; i < fInputs.size(); ++i) {
+            const bool isReady = it != ready.end() && static_cast<size_t>(*it) == i;
+            if (isReady) {
+                ++it;
+                if (!fInputs[i].fReady) {
+                    fInputs[i].fReadySince = now;
+                }
+            }
+            fInputs[i].fReady = isReady;
+        }
+    }
+
+    /// @return index of the input to handle next, -1 if no ready input is within its budget
+    int Next()
+    {
+        int next = -1;
+        switch (fDispatch) {
+            case InputDispatch::weighted: next = NextWeighted(); break;
+            case InputDispatch::deadline: next = NextDeadline(); break;
+            default: next = NextPriority(); break;
+        }
+        if (next >= 0) {
+            Input& input = fInputs[next];
+            ++input.fHandled;
+            --input.fCredit;
+            // the next message of the input waits from now on
+            input.fReadySince = clock::now();
+        }
+        return next;
+    }
+
+  private:
+    struct Input
+    {
+        InputPriority fSettings;
+        bool fReady = false;
+        clock::time_point fReadySince;
+        int fHandled = 0; // in the current iteration
+        int fCredit = 0;  // in the current round (weighted)
+    };
+
+    bool Eligible(const Input& input) const
+    {
+        return input.fReady && (input.fSettings.fBudget <= 0 || input.fHandled < input.fSettings.fBudget);
+    }
+
+    int NextPriority() const
+    {
+        int next = -1;
+        for (size_t i = 0; i < fInputs.size(); ++i) {
+            if (Eligible(fInputs[i]) && (next < 0 || fInputs[i].fSettings.fPriority > fInputs[next].fSettings.fPriority)) {
+                next = static_cast<int>(i);
+            }
+        }
+        return next;
+    }
+
+    // stays with the current input until its credit is used up, a round ends when no ready input has credit left
+    int NextWeighted()
+    {
+        for (int round = 0; round < 2; ++round) {
+            for (size_t n = 0; n < fInputs.size(); ++n) {
+                const size_t i = (fCursor + n) % fInputs.size();
+                if (Eligible(fInputs[i]) && fInputs[i].fCredit > 0) {
+                    fCursor = i;
+                    return static_cast<int>(i);
+                }
+            }
+            Refill();
+        }
+        return -1;
+    }
+
+    int NextDeadline() const
+    {
+        int next = -1;
+        clock::time_point nextDue;
+        for (size_t i = 0; i < fInputs.size(); ++i) {
+            const Input& input = fInputs[i];
+            if (!Eligible(input)) {
+                continue;
+            }
+            const clock::time_point due = input.fSettings.fDeadline.count() > 0 ? input.fReadySince + input.fSettings.fDeadline : clock::time_point::max();
+            if (next < 0 || due < nextDue || (due == nextDue && input.fSettings.fPriority > fInputs[next].fSettings.fPriority)) {
+                next = static_cast<int>(i);
+                nextDue = due;
+            }
+        }
+        return next;
+    }
+
+    void Refill()
+    {
+        for (auto& input : fInputs) {
+            input.fCredit = std::max(input.fSettings.fPriority, 1);
+        }
+    }
+
+    const InputDispatch fDispatch;
+    std::vector<Input> fInputs;
+    size_t fCursor = 0;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_INPUTSCHEDULER_H */
@@ -26,13 +26,262 @@
 #include <fairmq/JSONParser.h>
 #include <fairmq/PropertyOutput.h>
 #include <fairmq/tools/Strings.h>
+#include <fstream>
 #include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string_view>
+#include <vector>
 
 using namespace std;
 using namespace fair::mq;
 using namespace tools;
 using namespace boost::property_tree;
 
+namespace
+{
+
+struct ScanError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+// Minimal JSON scanner that locates the device objects of a topology file without building a tree of the whole file.
+// Only the selected devices are then parsed into a ptree. Any syntax it does not understand is reported as ScanError,
+// upon which the caller falls back to parsing the complete file.
+class DeviceScanner
+{
+  public:
+    DeviceScanner(string_view text, const string& deviceId)
+        : fPos(text.data())
+        , fEnd(text.data() + text.size())
+        , fDeviceId(deviceId)
+    {}
+
+    /// @return text of all device objects with the given id (or key), in file order
+    vector<string_view> Scan()
+    {
+        Members([&](const string& name) {
+            if (name == "fairMQOptions" && Peek() == '{') {
+                Members([&](const string& optName) {
+                    if (optName == "devices" && (Peek() == '[' || Peek() == '{')) {
+                        Devices();
+                    } else {
+                        SkipValue();
+                    }
+                });
+            } else {
+                SkipValue();
+            }
+        });
+        return fDevices;
+    }
+
+  private:
+    char Peek()
+    {
+        SkipWhitespace();
+        if (fPos == fEnd) {
+            throw ScanError("unexpected end of input");
+        }
+        return *fPos;
+    }
+
+    void Expect(char c)
+    {
+        if (Peek() != c) {
+            throw ScanError(ToString("expected '", c, "'"));
+        }
+        ++fPos;
+    }
+
+    void SkipWhitespace()
+    {
+        while (fPos != fEnd && (*fPos == ' ' || *fPos == '\n' || *fPos == '\r' || *fPos == '\t')) {
+            ++fPos;
+        }
+    }
+
+    // calls f(name) for each member of an object, f has to consume the value
+    template<typename F>
+    void Members(F&& f)
+    {
+        Expect('{');
+        if (Peek() == '}') {
+            ++fPos;
+            return;
+        }
+        while (true) {
+            string name = String();
+            Expect(':');
+            f(name);
+            if (Peek() == ',') {
+                ++fPos;
+            } else {
+                Expect('}');
+                return;
+            }
+        }
+    }
+
+    // elements of an array or member values of an object
+    void Devices()
+    {
+        bool array = Peek() == '[';
+        if (!array) {
+            Members([&](const string&) { Device(); });
+            return;
+        }
+        ++fPos;
+        if (Peek() == ']') {
+            ++fPos;
+            return;
+        }
+        while (true) {
+            Device();
+            if (Peek() == ',') {
+                ++fPos;
+            } else {
+                Expect(']');
+                return;
+            }
+        }
+    }
+
+    void Device()
+    {
+        if (Peek() != '{') {
+            SkipValue();
+            return;
+        }
+        const char* begin = fPos;
+        string key, id;
+        bool hasKey = false, hasId = false;
+        Members([&](const string& name) {
+            if (name == "key" && !hasKey) {
+                key = Scalar();
+                hasKey = true;
+            } else if (name == "id" && !hasId) {
+                id = Scalar();
+                hasId = true;
+            } else {
+                SkipValue();
+            }
+        });
+        // same precedence as in DeviceParser: key, then id
+        if ((hasKey ? key : id) == fDeviceId) {
+            fDevices.emplace_back(begin, fPos - begin);
+        }
+    }
+
+    string String()
+    {
+        Expect('"');
+        string result;
+        while (true) {
+            if (fPos == fEnd) {
+                throw ScanError("unterminated string");
+            }
+            char c = *fPos++;
+            if (c == '"') {
+                return result;
+            } else if (c != '\\') {
+                result.push_back(c);
+                continue;
+            }
+            if (fPos == fEnd) {
+                throw ScanError("unterminated string");
+            }
+            switch (char e = *fPos++) {
+                case '"': case '\\': case '/': result.push_back(e); break;
+                case 'b': result.push_back('\b'); break;
+                case 'f': result.push_back('\f'); break;
+                case 'n': result.push_back('\n'); break;
+                case 'r': result.push_back('\r'); break;
+                case 't': result.push_back('\t'); break;
+                default: throw ScanError("unsupported escape sequence"); // unicode escapes are left to the full parser
+            }
+        }
+    }
+
+    // string or literal value (as returned by ptree::get<string>)
+    string Scalar()
+    {
+        char c = Peek();
+        if (c == '"') {
+            return String();
+        } else if (c == '{' || c == '[') {
+            SkipValue();
+            return "";
+        }
+        const char* begin = fPos;
+        SkipLiteral();
+        return string(begin, fPos);
+    }
+
+    void SkipLiteral()
+    {
+        const char* begin = fPos;
+        while (fPos != fEnd && *fPos != ',' && *fPos != '}' && *fPos != ']' && *fPos != ' ' && *fPos != '\n' && *fPos != '\r' && *fPos != '\t') {
+            ++fPos;
+        }
+        if (fPos == begin) {
+            throw ScanError("expected value");
+        }
+    }
+
+    void SkipString()
+    {
+        ++fPos; // opening quote
+        while (fPos != fEnd) {
+            char c = *fPos++;
+            if (c == '"') {
+                return;
+            } else if (c == '\\' && fPos != fEnd) {
+                ++fPos;
+            }
+        }
+        throw ScanError("unterminated string");
+    }
+
+    void SkipValue()
+    {
+        char c = Peek();
+        if (c == '"') {
+            SkipString();
+            return;
+        } else if (c != '{' && c != '[') {
+            SkipLiteral();
+            return;
+        }
+        vector<char> closing;
+        do {
+            if (fPos == fEnd) {
+                throw ScanError("unexpected end of input");
+            }
+            c = *fPos;
+            if (c == '"') {
+                SkipString();
+                continue;
+            } else if (c == '{') {
+                closing.push_back('}');
+            } else if (c == '[') {
+                closing.push_back(']');
+            } else if (c == '}' || c == ']') {
+                if (closing.empty() || closing.back() != c) {
+                    throw ScanError("unbalanced brackets");
+                }
+                closing.pop_back();
+            }
+            ++fPos;
+        } while (!closing.empty());
+    }
+
+    const char* fPos;
+    const char* fEnd;
+    const string& fDeviceId;
+    vector<string_view> fDevices;
+};
+
+} // namespace
+
 namespace fair::mq
 {
 
@@ -49,10 +298,38 @@ Properties PtreeParser(const ptree& pt, const string& id)
 
 Properties JSONParser(const string& filename, const string& deviceId)
 {
-    ptree pt;
+    if (deviceId.empty()) {
+        throw ParserError("no device ID provided. Provide with `--id` cmd option");
+    }
+
     LOG(debug) << "Parsing JSON from " << filename << " ...";
-    read_json(filename, pt);
-    return PtreeParser(pt, deviceId);
+    ifstream file(filename, ios::binary);
+    if (!file) {
+        throw ParserError(ToString("cannot open config file ", filename));
+    }
+    const string text{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+
+    // build a tree only of the selected device(s), not of the whole topology
+    vector<string_view> devices;
+    try {
+        devices = DeviceScanner(text, deviceId).Scan();
+    } catch (ScanError& e) {
+        LOG(debug) << "Parsing complete JSON file (" << e.what() << ")";
+        ptree pt;
+        istringstream stream(text);
+        read_json(stream, pt);
+        return PtreeParser(pt, deviceId);
+    }
+
+    Properties properties;
+    LOG(trace) << "Found following channels for device ID '" << deviceId << "' :";
+    for (const auto device : devices) {
+        ptree pt;
+        istringstream stream{string(device)};
+        read_json(stream, pt);
+        helper::ChannelParser(pt, properties);
+    }
+    return properties;
 }
 
 namespace helper
@@ -82,6 +359,24 @@ Properties DeviceParser(const ptree& fairMQOptions, const string& deviceId)
     return properties;
 }
 
+map<string, Properties> DevicesParser(const ptree& fairMQOptions)
+{
+    map<string, Properties> devices;
+
+    for (const auto& node : fairMQOptions) {
+        if (node.first == "devices") {
+            for (const auto& device : node.second) {
+                string deviceIdKey = device.second.get<string>("key", device.second.get<string>("id", ""));
+                if (!deviceIdKey.empty()) {
+                    ChannelParser(device.second, devices[deviceIdKey]);
+                }
+            }
+        }
+    }
+
+    return devices;
+}
+
 void ChannelParser(const ptree& tree, Properties& properties)
 {
     for (const auto& node : tree) {
@@ -99,10 +394,44 @@ void ChannelParser(const ptree& tree, Properties& properties)
                 commonProperties.emplace("sndTimeoutMs", cn.second.get<int>("sndTimeoutMs", Channel::DefaultSndTimeoutMs));
                 commonProperties.emplace("rcvTimeoutMs", cn.second.get<int>("rcvTimeoutMs", Channel::DefaultRcvTimeoutMs));
                 commonProperties.emplace("linger", cn.second.get<int>("linger", Channel::DefaultLinger));
+                commonProperties.emplace("rcvMode", cn.second.get<string>("rcvMode", Channel::DefaultRcvMode));
+                commonProperties.emplace("rcvSpinUs", cn.second.get<int>("rcvSpinUs", Channel::DefaultRcvSpinUs));
+                commonProperties.emplace("sndBatch", cn.second.get<int>("sndBatch", Channel::DefaultSndBatch));
+                commonProperties.emplace("sndBatchTimeoutUs", cn.second.get<int>("sndBatchTimeoutUs", Channel::DefaultSndBatchTimeoutUs));
+                commonProperties.emplace("batchLatencyTargetUs", cn.second.get<int>("batchLatencyTargetUs", Channel::DefaultBatchLatencyTargetUs));
+                commonProperties.emplace("metaFormat", cn.second.get<string>("metaFormat", Channel::DefaultMetaFormat));
+                commonProperties.emplace("contextGroup", cn.second.get<string>("contextGroup", Channel::DefaultContextGroup));
+                commonProperties.emplace("packParts", cn.second.get<int>("packParts", Channel::DefaultPackParts));
+                commonProperties.emplace("compression", cn.second.get<string>("compression", Channel::DefaultCompression));
+                commonProperties.emplace("compressionLevel", cn.second.get<int>("compressionLevel", Channel::DefaultCompressionLevel));
+                commonProperties.emplace("compressionThreads", cn.second.get<int>("compressionThreads", Channel::DefaultCompressionThreads));
+                commonProperties.emplace("compressionMinSize", cn.second.get<int>("compressionMinSize", Channel::DefaultCompressionMinSize));
+                commonProperties.emplace("chunkSize", cn.second.get<int>("chunkSize", Channel::DefaultChunkSize));
+                commonProperties.emplace("multicastRate", cn.second.get<int>("multicastRate", Channel::DefaultMulticastRate));
+                commonProperties.emplace("multicastRecovery", cn.second.get<int>("multicastRecovery", Channel::DefaultMulticastRecovery));
+                commonProperties.emplace("trace", cn.second.get<bool>("trace", Channel::DefaultTrace));
+                commonProperties.emplace("overflow", cn.second.get<string>("overflow", Channel::DefaultOverflow));
+                commonProperties.emplace("deadline", cn.second.get<int>("deadline", Channel::DefaultDeadline));
+                commonProperties.emplace("sample", cn.second.get<string>("sample", Channel::DefaultSample));
+                commonProperties.emplace("maxBandwidth", cn.second.get<int>("maxBandwidth", Channel::DefaultMaxBandwidth));
+                commonProperties.emplace("burst", cn.second.get<int>("burst", Channel::DefaultBurst));
+                commonProperties.emplace("checksum", cn.second.get<string>("checksum", Channel::DefaultChecksum));
+                commonProperties.emplace("priorityLane", cn.second.get<bool>("priorityLane", Channel::DefaultPriorityLane));
+                commonProperties.emplace("mux", cn.second.get<bool>("mux", Channel::DefaultMux));
+                commonProperties.emplace("route", cn.second.get<string>("route", Channel::DefaultRoute));
+                commonProperties.emplace("peerTimeout", cn.second.get<int>("peerTimeout", Channel::DefaultPeerTimeout));
+                commonProperties.emplace("autoTune", cn.second.get<bool>("autoTune", Channel::DefaultAutoTune));
+                commonProperties.emplace("autoTuneMaxBufSize", cn.second.get<int>("autoTuneMaxBufSize", Channel::DefaultAutoTuneMaxBufSize));
+                commonProperties.emplace("autoTuneMaxKernelSize", cn.second.get<int>("autoTuneMaxKernelSize", Channel::DefaultAutoTuneMaxKernelSize));
                 commonProperties.emplace("rateLogging", cn.second.get<int>("rateLogging", Channel::DefaultRateLogging));
                 commonProperties.emplace("portRangeMin", cn.second.get<int>("portRangeMin", Channel::DefaultPortRangeMin));
                 commonProperties.emplace("portRangeMax", cn.second.get<int>("portRangeMax", Channel::DefaultPortRangeMax));
                 commonProperties.emplace("autoBind", cn.second.get<bool>("autoBind", Channel::DefaultAutoBind));
+                commonProperties.emplace("autoBindStrategy", cn.second.get<string>("autoBindStrategy", Channel::DefaultAutoBindStrategy));
+                commonProperties.emplace("hybrid", cn.second.get<bool>("hybrid", Channel::DefaultHybrid));
+                commonProperties.emplace("sharedSend", cn.second.get<bool>("sharedSend", Channel::DefaultSharedSend));
+                commonProperties.emplace("spillDir", cn.second.get<string>("spillDir", Channel::DefaultSpillDir));
+                commonProperties.emplace("spillSize", cn.second.get<int>("spillSize", Channel::DefaultSpillSize));
 
                 string name = cn.second.get<string>("name");
                 int numSockets = cn.second.get<int>("numSockets", 0);
@@ -151,10 +480,44 @@ void SubChannelParser(const ptree& channelTree, Properties& properties, const st
                 newProperties["sndTimeoutMs"] = sn.second.get<int>("sndTimeoutMs", boost::any_cast<int>(commonProperties.at("sndTimeoutMs")));
                 newProperties["rcvTimeoutMs"] = sn.second.get<int>("rcvTimeoutMs", boost::any_cast<int>(commonProperties.at("rcvTimeoutMs")));
                 newProperties["linger"] = sn.second.get<int>("linger", boost::any_cast<int>(commonProperties.at("linger")));
+                newProperties["rcvMode"] = sn.second.get<string>("rcvMode", boost::any_cast<string>(commonProperties.at("rcvMode")));
+                newProperties["rcvSpinUs"] = sn.second.get<int>("rcvSpinUs", boost::any_cast<int>(commonProperties.at("rcvSpinUs")));
+                newProperties["sndBatch"] = sn.second.get<int>("sndBatch", boost::any_cast<int>(commonProperties.at("sndBatch")));
+                newProperties["sndBatchTimeoutUs"] = sn.second.get<int>("sndBatchTimeoutUs", boost::any_cast<int>(commonProperties.at("sndBatchTimeoutUs")));
+                newProperties["batchLatencyTargetUs"] = sn.second.get<int>("batchLatencyTargetUs", boost::any_cast<int>(commonProperties.at("batchLatencyTargetUs")));
+                newProperties["metaFormat"] = sn.second.get<string>("metaFormat", boost::any_cast<string>(commonProperties.at("metaFormat")));
+                newProperties["contextGroup"] = sn.second.get<string>("contextGroup", boost::any_cast<string>(commonProperties.at("contextGroup")));
+                newProperties["packParts"] = sn.second.get<int>("packParts", boost::any_cast<int>(commonProperties.at("packParts")));
+                newProperties["compression"] = sn.second.get<string>("compression", boost::any_cast<string>(commonProperties.at("compression")));
+                newProperties["compressionLevel"] = sn.second.get<int>("compressionLevel", boost::any_cast<int>(commonProperties.at("compressionLevel")));
+                newProperties["compressionThreads"] = sn.second.get<int>("compressionThreads", boost::any_cast<int>(commonProperties.at("compressionThreads")));
+                newProperties["compressionMinSize"] = sn.second.get<int>("compressionMinSize", boost::any_cast<int>(commonProperties.at("compressionMinSize")));
+                newProperties["chunkSize"] = sn.second.get<int>("chunkSize", boost::any_cast<int>(commonProperties.at("chunkSize")));
+                newProperties["multicastRate"] = sn.second.get<int>("multicastRate", boost::any_cast<int>(commonProperties.at("multicastRate")));
+                newProperties["multicastRecovery"] = sn.second.get<int>("multicastRecovery", boost::any_cast<int>(commonProperties.at("multicastRecovery")));
+                newProperties["trace"] = sn.second.get<bool>("trace", boost::any_cast<bool>(commonProperties.at("trace")));
+                newProperties["overflow"] = sn.second.get<string>("overflow", boost::any_cast<string>(commonProperties.at("overflow")));
+                newProperties["deadline"] = sn.second.get<int>("deadline", boost::any_cast<int>(commonProperties.at("deadline")));
+                newProperties["sample"] = sn.second.get<string>("sample", boost::any_cast<string>(commonProperties.at("sample")));
+                newProperties["maxBandwidth"] = sn.second.get<int>("maxBandwidth", boost::any_cast<int>(commonProperties.at("maxBandwidth")));
+                newProperties["burst"] = sn.second.get<int>("burst", boost::any_cast<int>(commonProperties.at("burst")));
+                newProperties["checksum"] = sn.second.get<string>("checksum", boost::any_cast<string>(commonProperties.at("checksum")));
+                newProperties["priorityLane"] = sn.second.get<bool>("priorityLane", boost::any_cast<bool>(commonProperties.at("priorityLane")));
+                newProperties["mux"] = sn.second.get<bool>("mux", boost::any_cast<bool>(commonProperties.at("mux")));
+                newProperties["route"] = sn.second.get<string>("route", boost::any_cast<string>(commonProperties.at("route")));
+                newProperties["peerTimeout"] = sn.second.get<int>("peerTimeout", boost::any_cast<int>(commonProperties.at("peerTimeout")));
+                newProperties["autoTune"] = sn.second.get<bool>("autoTune", boost::any_cast<bool>(commonProperties.at("autoTune")));
+                newProperties["autoTuneMaxBufSize"] = sn.second.get<int>("autoTuneMaxBufSize", boost::any_cast<int>(commonProperties.at("autoTuneMaxBufSize")));
+                newProperties["autoTuneMaxKernelSize"] = sn.second.get<int>("autoTuneMaxKernelSize", boost::any_cast<int>(commonProperties.at("autoTuneMaxKernelSize")));
                 newProperties["rateLogging"] = sn.second.get<int>("rateLogging", boost::any_cast<int>(commonProperties.at("rateLogging")));
                 newProperties["portRangeMin"] = sn.second.get<int>("portRangeMin", boost::any_cast<int>(commonProperties.at("portRangeMin")));
                 newProperties["portRangeMax"] = sn.second.get<int>("portRangeMax", boost::any_cast<int>(commonProperties.at("portRangeMax")));
                 newProperties["autoBind"] = sn.second.get<bool>("autoBind", boost::any_cast<bool>(commonProperties.at("autoBind")));
+                newProperties["autoBindStrategy"] = sn.second.get<string>("autoBindStrategy", boost::any_cast<string>(commonProperties.at("autoBindStrategy")));
+                newProperties["hybrid"] = sn.second.get<bool>("hybrid", boost::any_cast<bool>(commonProperties.at("hybrid")));
+                newProperties["sharedSend"] = sn.second.get<bool>("sharedSend", boost::any_cast<bool>(commonProperties.at("sharedSend")));
+                newProperties["spillDir"] = sn.second.get<string>("spillDir", boost::any_cast<string>(commonProperties.at("spillDir")));
+                newProperties["spillSize"] = sn.second.get<int>("spillSize", boost::any_cast<int>(commonProperties.at("spillSize")));
 
                 LOG(trace) << "" << channelName << "[" << i << "]:";
                 for (auto& p : newProperties) {
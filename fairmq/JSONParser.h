@@ -18,6 +18,7 @@
 #include <fairmq/Properties.h>
 #include <boost/property_tree/ptree_fwd.hpp>
 
+#include <map>
 #include <stdexcept>
 #include <string>
 
@@ -28,12 +29,16 @@ struct ParserError : std::runtime_error { using std::runtime_error::runtime_erro
 
 fair::mq::Properties PtreeParser(const boost::property_tree::ptree& pt, const std::string& deviceId);
 
+/// Channel properties of a device from a JSON topology file. Only the objects of the requested device are parsed
+/// into a property tree, the rest of the file is skipped over.
 fair::mq::Properties JSONParser(const std::string& filename, const std::string& deviceId);
 
 namespace helper
 {
 
 fair::mq::Properties DeviceParser(const boost::property_tree::ptree& tree, const std::string& deviceId);
+/// channel properties of all devices, by device key (or id)
+std::map<std::string, fair::mq::Properties> DevicesParser(const boost::property_tree::ptree& tree);
 void ChannelParser(const boost::property_tree::ptree& tree, fair::mq::Properties& properties);
 void SubChannelParser(const boost::property_tree::ptree& tree, fair::mq::Properties& properties, const std::string& channelName, const fair::mq::Properties& commonProperties);
 
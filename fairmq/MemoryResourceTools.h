@@ -12,8 +12,20 @@
 ///
 /// @author Mikolaj Krzewicki, mkrzewic@cern.ch
 
+#ifndef FAIR_MQ_MEMORY_RESOURCE_TOOLS_H
+#define FAIR_MQ_MEMORY_RESOURCE_TOOLS_H
+
 #include <fairmq/TransportFactory.h>
 #include <fairmq/MemoryResources.h>
+#include <fairmq/tools/Copy.h>
+
+#include <boost/container/pmr/polymorphic_allocator.hpp>
+
+#include <memory>
+#include <new> // placement new
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace fair::mq
 {
@@ -56,10 +68,101 @@ MessagePtr getMessage(ContainerT &&container_, MemoryResource *targetResource =
     }
 
     auto message = targetResource->getTransportFactory()->CreateMessage(containerSizeBytes);
-    std::memcpy(static_cast<fair::mq::byte *>(message->GetData()),
+    tools::CopyPayload(static_cast<fair::mq::byte *>(message->GetData()),
         container.data(),
         containerSizeBytes);
     return message;
 }
 
+//_________________________________________________________________________________________________
+/// polymorphic allocator that default-initializes instead of value-initializing, so that elements of trivial types
+/// created without a value (e.g. resize()) keep the bytes of the memory, as needed to adopt existing data
+template<typename T>
+class DefaultInitAllocator : public pmr::polymorphic_allocator<T>
+{
+  public:
+    template<typename U>
+    struct rebind
+    {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    using pmr::polymorphic_allocator<T>::polymorphic_allocator;
+    DefaultInitAllocator() noexcept = default;
+    DefaultInitAllocator(const DefaultInitAllocator&) noexcept = default;
+    template<typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>& other) noexcept
+        : pmr::polymorphic_allocator<T>(other.resource())
+    {}
+    DefaultInitAllocator& operator=(const DefaultInitAllocator&) = delete;
+
+    template<typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value)
+    {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        pmr::polymorphic_allocator<T>::construct(p, std::forward<Args>(args)...);
+    }
+
+    // copies of a container use the default resource, as with pmr::polymorphic_allocator
+    DefaultInitAllocator select_on_container_copy_construction() const { return DefaultInitAllocator(); }
+};
+
+//_________________________________________________________________________________________________
+/// A message (e.g. a received one) adopted as the storage of a vector of its size / sizeof(T) elements, without a copy.
+/// The vector can be read, modified in place and grown (growing moves it into a new message of the same transport), the
+/// adopted message is released with the MessageVector. getMessage(std::move(*vec)) returns the adopted message again
+/// (with the used size of the vector), so that data modified in place can be sent on without a copy. If the data is not
+/// aligned for T, it is copied (isAdopted() returns false). Move-only, the vector must not outlive the MessageVector.
+template<typename T>
+class MessageVector
+{
+    static_assert(std::is_trivially_copyable<T>::value, "MessageVector: the element type has to be trivially copyable");
+
+  public:
+    using vector_type = std::vector<T, DefaultInitAllocator<T>>;
+
+    explicit MessageVector(MessagePtr message)
+        : fResource(std::make_unique<MessageResource>(std::move(message)))
+        , fVector(DefaultInitAllocator<T>(fResource.get()))
+    {
+        const size_t n = fResource->adoptedSize() / sizeof(T);
+        fVector.reserve(n);
+        fVector.resize(n);
+        if (n > 0 && !isAdopted()) {
+            tools::CopyPayload(fVector.data(), fResource->adoptedData(), n * sizeof(T));
+            fResource->getMessage(fResource->adoptedData()); // release it right away
+        }
+    }
+
+    MessageVector(MessageVector&&) noexcept = default;
+    MessageVector& operator=(MessageVector&&) = delete; // the vector of the target would outlive its resource
+
+    /// @return true if the vector uses the data of the message (false if it was copied or the vector was reallocated)
+    bool isAdopted() const noexcept { return fVector.data() == fResource->adoptedData(); }
+
+    vector_type& get() noexcept { return fVector; }
+    const vector_type& get() const noexcept { return fVector; }
+    vector_type& operator*() noexcept { return fVector; }
+    const vector_type& operator*() const noexcept { return fVector; }
+    vector_type* operator->() noexcept { return &fVector; }
+    const vector_type* operator->() const noexcept { return &fVector; }
+
+  private:
+    std::unique_ptr<MessageResource> fResource; // declared before the vector, to be destroyed after it
+    vector_type fVector;
+};
+
+/// adopt a message as the storage of a vector, see MessageVector
+template<typename T>
+MessageVector<T> adoptVector(MessagePtr message)
+{
+    return MessageVector<T>(std::move(message));
+}
+
 } // namespace fair::mq
+
+#endif /* FAIR_MQ_MEMORY_RESOURCE_TOOLS_H */
@@ -15,7 +15,149 @@
 #include <fairmq/TransportFactory.h>
 #include <fairmq/MemoryResources.h>
 
+#include <new> // placement new, bad_alloc
+#include <stdexcept> // runtime_error
+
 void *fair::mq::ChannelResource::do_allocate(std::size_t bytes, std::size_t alignment)
 {
     return setMessage(factory->CreateMessage(bytes, fair::mq::Alignment{alignment}));
 }
+
+namespace
+{
+fair::mq::TransportFactory* transportOf(const fair::mq::MessagePtr& message)
+{
+    if (!message) {
+        throw std::runtime_error("Tried to construct from a nullptr fair::mq::Message");
+    }
+    return message->GetTransport();
+}
+}   // namespace
+
+fair::mq::MessageResource::MessageResource(MessagePtr message)
+    : ChannelResource(transportOf(message))
+    , adopted(message->GetData())
+    , size(message->GetSize())
+{
+    if (adopted) {
+        setMessage(std::move(message));
+    }
+}
+
+void* fair::mq::MessageResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    if (!handedOut && adopted && bytes <= size && reinterpret_cast<uintptr_t>(adopted) % alignment == 0) {
+        handedOut = true;
+        return adopted;
+    }
+    return ChannelResource::do_allocate(bytes, alignment);
+}
+
+fair::mq::ConcurrentChannelResource::ConcurrentChannelResource(TransportFactory* _factory, size_t _capacity)
+    : factory(_factory)
+{
+    if (!_factory) {
+        throw std::runtime_error("Tried to construct from a nullptr fair::mq::TransportFactory");
+    }
+    size_t capacity = 16;
+    while (capacity < _capacity) {
+        capacity <<= 1;
+    }
+    mask = capacity - 1;
+    slots = std::make_unique<Slot[]>(capacity);
+}
+
+fair::mq::ConcurrentChannelResource::~ConcurrentChannelResource()
+{
+    for (size_t i = 0; i <= mask; ++i) {
+        delete slots[i].message;
+    }
+}
+
+fair::mq::ConcurrentChannelResource::Slot* fair::mq::ConcurrentChannelResource::find(const void* p)
+{
+    // keys are never reset to nullptr, so a probe for an outstanding allocation cannot stop short of it
+    for (size_t n = 0, i = detail::MessageTable::hash(p, mask); n <= mask; ++n, i = (i + 1) & mask) {
+        void* key = slots[i].key.load(std::memory_order_acquire);
+        if (key == p) {
+            return &slots[i];
+        }
+        if (key == nullptr) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+void* fair::mq::ConcurrentChannelResource::setMessage(MessagePtr message)
+{
+    void* addr = message->GetData();
+    if (addr == nullptr || addr == kFreed) {
+        throw std::runtime_error("ConcurrentChannelResource: cannot keep track of a message without data");
+    }
+    for (size_t n = 0, i = detail::MessageTable::hash(addr, mask); n <= mask; ++n, i = (i + 1) & mask) {
+        void* key = slots[i].key.load(std::memory_order_relaxed);
+        // outstanding data pointers are unique, a free slot before the end of the probe can be taken
+        while (key == nullptr || key == kFreed) {
+            if (slots[i].key.compare_exchange_weak(key, addr, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                slots[i].message = message.release();
+                count.fetch_add(1, std::memory_order_relaxed);
+                return addr;
+            }
+        }
+    }
+    throw std::bad_alloc();
+}
+
+fair::mq::MessagePtr fair::mq::ConcurrentChannelResource::getMessage(void* p)
+{
+    Slot* slot = find(p);
+    if (!slot) {
+        return nullptr;
+    }
+    MessagePtr message(slot->message);
+    slot->message = nullptr;
+    count.fetch_sub(1, std::memory_order_relaxed);
+    slot->key.store(kFreed, std::memory_order_release);
+    return message;
+}
+
+void* fair::mq::ConcurrentChannelResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    // empty messages may have no data pointer to look them up by
+    return setMessage(factory->CreateMessage(std::max<std::size_t>(bytes, 1), fair::mq::Alignment{alignment}));
+}
+
+void* fair::mq::ChannelPoolResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    if (!pooled(bytes, alignment)) {
+        return ChannelResource::do_allocate(bytes, alignment);
+    }
+    size_t size = blockSize(bytes);
+    FreeBlock*& freeList = freeLists[sizeClass(size)];
+    if (freeList) {
+        FreeBlock* block = freeList;
+        freeList = block->next;
+        return block;
+    }
+    // blocks of a chunk are carved with their own size as alignment (up to the chunk alignment)
+    size_t align = std::min(size, kChunkAlignment);
+    char* pos = chunkPos ? chunkPos + (align - reinterpret_cast<uintptr_t>(chunkPos) % align) % align : nullptr;
+    if (!pos || pos + size > chunkEnd) {
+        chunks.push_back(factory->CreateMessage(chunkSize, fair::mq::Alignment{kChunkAlignment}));
+        pos = static_cast<char*>(chunks.back()->GetData());
+        chunkEnd = pos + chunkSize;
+    }
+    chunkPos = pos + size;
+    return pos;
+}
+
+void fair::mq::ChannelPoolResource::do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+{
+    if (!pooled(bytes, alignment)) {
+        ChannelResource::do_deallocate(p, bytes, alignment);
+        return;
+    }
+    FreeBlock*& freeList = freeLists[sizeClass(blockSize(bytes))];
+    freeList = new (p) FreeBlock{freeList};
+}
@@ -16,12 +16,15 @@
 #define FAIR_MQ_MEMORY_RESOURCES_H
 
 #include <boost/container/container_fwd.hpp>
-#include <boost/container/flat_map.hpp>
 #include <boost/container/pmr/memory_resource.hpp>
+#include <algorithm> // std::min
+#include <atomic>
+#include <cstdint> // uintptr_t
 #include <cstring>
 #include <fairmq/Message.h>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 namespace fair::mq {
 
@@ -46,6 +49,85 @@ class MemoryResource : public pmr::memory_resource
     virtual size_t getNumberOfMessages() const noexcept = 0;
 };
 
+namespace detail {
+
+/// Open addressing (linear probing) table of the outstanding messages of a ChannelResource by data pointer, O(1) on
+/// average for insertion and removal. Removal shifts the following entries back, so no tombstones accumulate.
+/// Not thread-safe.
+class MessageTable
+{
+  public:
+    static size_t hash(const void* p, size_t mask)
+    {
+        // Fibonacci hashing, the low bits of data pointers are mostly zero (alignment)
+        return static_cast<size_t>((reinterpret_cast<uintptr_t>(p) >> 4) * UINT64_C(0x9E3779B97F4A7C15) >> 20) & mask;
+    }
+
+    void insert(MessagePtr message)
+    {
+        if ((count + 1) * 2 > slots.size()) {
+            grow();
+        }
+        void* key = message->GetData();
+        size_t mask = slots.size() - 1;
+        size_t i = hash(key, mask);
+        while (slots[i] && slots[i]->GetData() != key) {
+            i = (i + 1) & mask;
+        }
+        if (!slots[i]) {
+            ++count;
+        }
+        slots[i] = std::move(message);
+    }
+
+    /// @return the message with the data pointer, nullptr if there is none
+    MessagePtr take(const void* p)
+    {
+        if (count == 0) {
+            return nullptr;
+        }
+        size_t mask = slots.size() - 1;
+        size_t i = hash(p, mask);
+        while (slots[i] && slots[i]->GetData() != p) {
+            i = (i + 1) & mask;
+        }
+        if (!slots[i]) {
+            return nullptr;
+        }
+        MessagePtr message = std::move(slots[i]);
+        --count;
+        // move back the entries of the cluster that would not be found behind the gap
+        for (size_t j = (i + 1) & mask; slots[j]; j = (j + 1) & mask) {
+            size_t home = hash(slots[j]->GetData(), mask);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                slots[i] = std::move(slots[j]);
+                i = j;
+            }
+        }
+        return message;
+    }
+
+    size_t size() const noexcept { return count; }
+
+  private:
+    void grow()
+    {
+        std::vector<MessagePtr> old(std::max<size_t>(slots.size() * 2, 16));
+        old.swap(slots);
+        count = 0;
+        for (auto& message : old) {
+            if (message) {
+                insert(std::move(message));
+            }
+        }
+    }
+
+    std::vector<MessagePtr> slots; // size is a power of two, empty slots are nullptr
+    size_t count{0};
+};
+
+}   // namespace detail
+
 /// This is the allocator that interfaces to FairMQ memory management. All
 /// allocations are
 /// delegated to FairMQ so standard (e.g. STL) containers can construct their
@@ -55,10 +137,8 @@ class ChannelResource : public MemoryResource
 {
   protected:
     TransportFactory* factory{nullptr};
-    // TODO: for now a map to keep track of allocations, something else would
-    // probably be
-    // faster, but for now this does not need to be fast.
-    boost::container::flat_map<void*, MessagePtr> messageMap;
+    // outstanding allocations by data pointer, O(1) lookup (see ConcurrentChannelResource for multiple threads)
+    detail::MessageTable messageMap;
 
   public:
     ChannelResource() = delete;
@@ -72,17 +152,12 @@ class ChannelResource : public MemoryResource
         }
     };
 
-    MessagePtr getMessage(void* p) override
-    {
-        auto mes = std::move(messageMap[p]);
-        messageMap.erase(p);
-        return mes;
-    }
+    MessagePtr getMessage(void* p) override { return messageMap.take(p); }
 
     void* setMessage(MessagePtr message) override
     {
         void* addr = message->GetData();
-        messageMap[addr] = std::move(message);
+        messageMap.insert(std::move(message));
         return addr;
     }
 
@@ -94,7 +169,7 @@ class ChannelResource : public MemoryResource
     void* do_allocate(std::size_t bytes, std::size_t alignment) override;
     void do_deallocate(void* p, std::size_t /*bytes*/, std::size_t /*alignment*/) override
     {
-        messageMap.erase(p);
+        messageMap.take(p);
     };
 
     bool do_is_equal(const pmr::memory_resource& other) const noexcept override
@@ -103,6 +178,153 @@ class ChannelResource : public MemoryResource
     };
 };
 
+/// Pooling variant of ChannelResource, like pmr::unsynchronized_pool_resource but backed by transport messages:
+/// small allocations (up to maxPooledSize) are sub-allocated from larger chunk messages and recycled in per size
+/// class free lists, so that e.g. growing containers or node based containers do not create (and destroy) one transport
+/// message per allocation. Larger allocations get their own message as with ChannelResource, so getMessage() still
+/// hands out the owning message of a completed (large) container for a zero-copy send. For pooled allocations
+/// getMessage() returns nullptr (the fair::mq::getMessage() tool then copies). Not thread-safe.
+class ChannelPoolResource : public ChannelResource
+{
+  public:
+    static constexpr size_t kMinBlockSize = 16;
+    static constexpr size_t kChunkAlignment = 64;
+
+    /// @param chunkSize size of the chunk messages that pooled allocations are carved from
+    /// @param maxPooledSize largest pooled allocation (power of two, at most chunkSize)
+    ChannelPoolResource(TransportFactory* _factory, size_t _chunkSize = 1 << 20, size_t _maxPooledSize = 4096)
+        : ChannelResource(_factory)
+        , chunkSize(_chunkSize)
+        , maxPooledSize(_maxPooledSize)
+    {
+        if (maxPooledSize < kMinBlockSize || (maxPooledSize & (maxPooledSize - 1)) != 0 || maxPooledSize > chunkSize) {
+            throw std::runtime_error("ChannelPoolResource: maxPooledSize must be a power of two between 16 and chunkSize");
+        }
+        size_t numClasses = 0;
+        for (size_t s = kMinBlockSize; s <= maxPooledSize; s <<= 1) {
+            ++numClasses;
+        }
+        freeLists.assign(numClasses, nullptr);
+    }
+
+    /// release all chunk messages, invalidating all pooled allocations
+    void release()
+    {
+        chunks.clear();
+        freeLists.assign(freeLists.size(), nullptr);
+        chunkPos = nullptr;
+        chunkEnd = nullptr;
+    }
+
+    size_t getNumberOfChunks() const noexcept { return chunks.size(); }
+
+  protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+
+  private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    bool pooled(size_t bytes, size_t alignment) const { return bytes <= maxPooledSize && alignment <= std::min(blockSize(bytes), kChunkAlignment); }
+    static size_t blockSize(size_t bytes)
+    {
+        size_t size = kMinBlockSize;
+        while (size < bytes) {
+            size <<= 1;
+        }
+        return size;
+    }
+    static size_t sizeClass(size_t blockSize)
+    {
+        size_t c = 0;
+        for (size_t s = kMinBlockSize; s < blockSize; s <<= 1) {
+            ++c;
+        }
+        return c;
+    }
+
+    const size_t chunkSize;
+    const size_t maxPooledSize;
+    std::vector<MessagePtr> chunks;
+    std::vector<FreeBlock*> freeLists;
+    char* chunkPos{nullptr};
+    char* chunkEnd{nullptr};
+};
+
+/// Thread-safe variant of ChannelResource, for containers that are filled by several producer threads (e.g. workers of
+/// a time frame builder) from one resource. The outstanding messages are kept in a fixed size lock-free open
+/// addressing table: allocation claims a free slot with one CAS, getMessage()/deallocation find the slot in O(1) on
+/// average and free it again. An allocation fails with std::bad_alloc once capacity messages are outstanding.
+/// A given allocation is only ever handed back (getMessage/deallocate) once, by the thread owning it.
+class ConcurrentChannelResource : public MemoryResource
+{
+  public:
+    ConcurrentChannelResource() = delete;
+    ConcurrentChannelResource(const ConcurrentChannelResource&) = delete;
+    ConcurrentChannelResource& operator=(const ConcurrentChannelResource&) = delete;
+
+    /// @param _capacity maximum number of outstanding allocations (rounded up to a power of two)
+    ConcurrentChannelResource(TransportFactory* _factory, size_t _capacity = 1 << 16);
+    /// releases the messages still outstanding
+    ~ConcurrentChannelResource() override;
+
+    MessagePtr getMessage(void* p) override;
+    void* setMessage(MessagePtr message) override;
+    TransportFactory* getTransportFactory() noexcept override { return factory; }
+    size_t getNumberOfMessages() const noexcept override { return count.load(std::memory_order_relaxed); }
+    size_t getCapacity() const noexcept { return mask + 1; }
+
+  protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t /*bytes*/, std::size_t /*alignment*/) override { getMessage(p); }
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+  private:
+    // keys: nullptr (never used, ends a probe), kFreed (reusable) or a data pointer
+    static inline void* const kFreed = reinterpret_cast<void*>(uintptr_t(1));
+
+    struct Slot
+    {
+        std::atomic<void*> key{nullptr};
+        Message* message{nullptr}; // owned, written and read only by the thread owning the allocation
+    };
+
+    Slot* find(const void* p);
+
+    TransportFactory* factory;
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> count{0};
+};
+
+/// ChannelResource that adopts an existing (e.g. received) message: the first allocation that fits into the message and
+/// is aligned for it returns its data, so that a container created on the resource uses the message as its storage
+/// without a copy (see fair::mq::MessageVector). Further allocations (a growing container) get new messages of the
+/// transport of the adopted one. The adopted message is released when it is deallocated, or with the resource if it was
+/// never allocated; getMessage() hands it out again, e.g. to send a container modified in place. Not thread-safe.
+/// The message must not be null (its transport serves the further allocations), std::runtime_error is thrown otherwise.
+class MessageResource : public ChannelResource
+{
+  public:
+    explicit MessageResource(MessagePtr message);
+
+    /// @return data of the adopted message
+    void* adoptedData() const noexcept { return adopted; }
+    /// @return size of the adopted message
+    size_t adoptedSize() const noexcept { return size; }
+
+  protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+  private:
+    void* adopted;
+    size_t size;
+    bool handedOut{false};
+};
+
 using FairMQMemoryResource [[deprecated("Use fair::mq::MemoryResource")]] = MemoryResource;
 
 }   // namespace fair::mq
@@ -9,7 +9,9 @@
 #ifndef FAIR_MQ_MESSAGE_H
 #define FAIR_MQ_MESSAGE_H
 
+#include <chrono>
 #include <cstddef>   // for size_t
+#include <fairmq/Tracing.h>
 #include <fairmq/Transports.h>
 #include <memory>   // unique_ptr
 #include <stdexcept>
@@ -25,6 +27,13 @@ struct Alignment
     explicit operator size_t() const { return alignment; }
 };
 
+/// Space reserved in front of the message data, to prepend headers in place (see Message::Prepend)
+struct Headroom
+{
+    size_t headroom;
+    explicit operator size_t() const { return headroom; }
+};
+
 struct Message
 {
     Message() = default;
@@ -47,6 +56,31 @@ struct Message
     virtual size_t GetSize() const = 0;
 
     virtual bool SetUsedSize(size_t size) = 0;
+    /// Grow the message buffer to newSize bytes, keeping its content. The buffer is expanded in place where the
+    /// transport allows it, otherwise it is reallocated and the content copied (GetData() may change).
+    /// Does nothing if newSize is not larger than the current size.
+    /// @return false if the buffer could not be grown (or the transport does not support it), the message is unchanged then
+    virtual bool Grow(size_t /* newSize */) { return false; }
+
+    /// Make sure the message buffer can be modified without affecting other messages (copy-on-write): returns at once
+    /// if the buffer is not shared (see Copy() and Slice()), otherwise the content is copied into a new buffer
+    /// of the same size, which only this message refers to (GetData() changes then).
+    /// @return false if the buffer could not be copied (or the transport does not support it), the message is unchanged then
+    virtual bool MakeWritable() { return false; }
+
+    /// Extend the buffer by n bytes at its front, into the headroom reserved at creation
+    /// (TransportFactory::CreateMessage(size, Headroom)). GetData() moves back by n bytes, the content is kept.
+    /// @return false if the remaining headroom is smaller than n, the message is unchanged then
+    virtual bool Prepend(size_t /* n */) { return false; }
+    /// @return number of bytes that can still be prepended with Prepend()
+    virtual size_t GetHeadroom() const { return 0; }
+
+    /// Create a message referring to the range [offset, offset + size) of this message's buffer. The buffer is shared
+    /// (it stays alive as long as any of the messages referring to it), the slice can be sent like any other message.
+    /// Modifying the buffer after a call to Slice() is undefined behaviour, as with Copy().
+    /// @return nullptr if the transport does not support slicing
+    /// @throw MessageError if the range is not within the message
+    virtual std::unique_ptr<Message> Slice(size_t /* offset */, size_t /* size */) { return nullptr; }
 
     virtual Transport GetType() const = 0;
     TransportFactory* GetTransport() { return fTransport; }
@@ -58,10 +92,21 @@ struct Message
     /// @param msg message to copy the buffer from.
     virtual void Copy(const Message& msg) = 0;
 
+    /// Trace context carried with the message over channels with the trace property (see TraceContext)
+    const TraceContext& GetTraceContext() const { return fTraceContext; }
+    void SetTraceContext(const TraceContext& context) { fTraceContext = context; }
+
+    /// Deadline carried with the message over channels with the deadline property, the receiving channel discards
+    /// the message after it (see Channel::UpdateDeadline). Default (epoch): the deadline of the channel applies.
+    std::chrono::system_clock::time_point GetDeadline() const { return fDeadline; }
+    void SetDeadline(std::chrono::system_clock::time_point deadline) { fDeadline = deadline; }
+
     virtual ~Message() = default;
 
   private:
     TransportFactory* fTransport{nullptr};
+    TraceContext fTraceContext;
+    std::chrono::system_clock::time_point fDeadline{};
 };
 
 using MessagePtr = std::unique_ptr<Message>;
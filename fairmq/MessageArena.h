@@ -0,0 +1,219 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_MESSAGEARENA_H
+#define FAIR_MQ_MESSAGEARENA_H
+
+#include <atomic>
+#include <cstddef> // size_t, max_align_t
+#include <cstdlib> // malloc, free
+#include <new>     // std::bad_alloc
+#include <vector>
+
+namespace fair::mq {
+
+/// Allocates the message objects of one multipart receive contiguously, with a single malloc for all parts.
+/// Messages are still deleted individually (through MessagePtr), the block is freed with the last of its objects
+/// (or with the arena, if that comes last). Every object is preceded by a header, so that a message class using
+///
+///     static void* operator new(size_t size) { return MessageArena::AllocateSingle(size); }
+///     static void* operator new(size_t size, MessageArena& arena) { return arena.Allocate(size); }
+///     static void operator delete(void* ptr) { MessageArena::Release(ptr); }
+///     static void operator delete(void* ptr, MessageArena&) { MessageArena::Release(ptr); }
+///
+/// can be created either way (make_unique or new (arena) T(...)) and deleted from any thread.
+/// Freed objects and blocks are kept in a per-thread cache (up to kMaxCachedObjects/kMaxCachedBlocks) and reused by
+/// the next allocations of that thread, so that a steady-state receive loop does not allocate from the heap.
+class MessageArena
+{
+  public:
+    static constexpr size_t kMaxCachedObjects = 256;
+    static constexpr size_t kMaxCachedBlocks = 16;
+
+    /// @param n number of objects
+    /// @param objectSize size of one object
+    MessageArena(size_t n, size_t objectSize)
+        : fBlock(nullptr)
+        , fNext(nullptr)
+        , fEnd(nullptr)
+        , fSlotSize(SlotSize(objectSize))
+    {
+        if (n > 1) {
+            size_t capacity = n * fSlotSize;
+            fBlock = CachedBlock(capacity);
+            if (!fBlock) {
+                fBlock = static_cast<Block*>(malloc(sizeof(Block) + capacity));
+                if (fBlock) {
+                    new (&fBlock->fRefs) std::atomic<size_t>(0);
+                    fBlock->fCapacity = capacity;
+                }
+            }
+            if (fBlock) {
+                fBlock->fRefs.store(1, std::memory_order_relaxed); // the arena
+                fNext = reinterpret_cast<char*>(fBlock + 1);
+                fEnd = fNext + capacity;
+            }
+        }
+    }
+
+    MessageArena(const MessageArena&) = delete;
+    MessageArena(MessageArena&&) = delete;
+    MessageArena& operator=(const MessageArena&) = delete;
+    MessageArena& operator=(MessageArena&&) = delete;
+
+    ~MessageArena()
+    {
+        if (fBlock) {
+            Unref(fBlock);
+        }
+    }
+
+    /// next slot of the block, a separate allocation if the block is exhausted or the object is larger than expected
+    void* Allocate(size_t size)
+    {
+        if (fNext == fEnd || SlotSize(size) > fSlotSize) {
+            return AllocateSingle(size);
+        }
+        Header* header = reinterpret_cast<Header*>(fNext);
+        fNext += fSlotSize;
+        header->fBlock = fBlock;
+        fBlock->fRefs.fetch_add(1, std::memory_order_relaxed);
+        return header + 1;
+    }
+
+    static void* AllocateSingle(size_t size)
+    {
+        Cache* cache = ThreadCache();
+        if (cache && !cache->fObjects.empty() && cache->fObjects.back()->fSize == size) {
+            Header* header = cache->fObjects.back();
+            cache->fObjects.pop_back();
+            return header + 1;
+        }
+        Header* header = static_cast<Header*>(malloc(sizeof(Header) + size));
+        if (!header) {
+            throw std::bad_alloc();
+        }
+        header->fBlock = nullptr;
+        header->fSize = size;
+        return header + 1;
+    }
+
+    static void Release(void* ptr) noexcept
+    {
+        if (!ptr) {
+            return;
+        }
+        Header* header = static_cast<Header*>(ptr) - 1;
+        if (header->fBlock) {
+            Unref(header->fBlock);
+            return;
+        }
+        Cache* cache = ThreadCache();
+        if (cache && cache->fObjects.size() < kMaxCachedObjects) {
+            cache->fObjects.push_back(header);
+        } else {
+            free(header);
+        }
+    }
+
+  private:
+    struct alignas(std::max_align_t) Block
+    {
+        std::atomic<size_t> fRefs; // the arena + live objects
+        size_t fCapacity; // bytes of the slots following the block
+    };
+
+    // precedes every object, keeps the object aligned to max_align_t
+    struct alignas(std::max_align_t) Header
+    {
+        Block* fBlock; // nullptr for separately allocated objects
+        size_t fSize; // of separately allocated objects
+    };
+
+    struct Cache
+    {
+        explicit Cache(bool& destroyed)
+            : fDestroyed(destroyed)
+        {
+            // Release() is noexcept, the caches never grow beyond their reserved size
+            fObjects.reserve(kMaxCachedObjects);
+            fBlocks.reserve(kMaxCachedBlocks);
+        }
+        Cache(const Cache&) = delete;
+        Cache& operator=(const Cache&) = delete;
+
+        ~Cache()
+        {
+            for (Header* header : fObjects) {
+                free(header);
+            }
+            for (Block* block : fBlocks) {
+                free(block);
+            }
+            fDestroyed = true;
+        }
+
+        std::vector<Header*> fObjects;
+        std::vector<Block*> fBlocks;
+        bool& fDestroyed;
+    };
+
+    // nullptr once the cache of the thread is destroyed (objects released during thread exit go directly to free)
+    static Cache* ThreadCache()
+    {
+        thread_local bool destroyed = false;
+        if (destroyed) {
+            return nullptr;
+        }
+        thread_local Cache cache(destroyed);
+        return &cache;
+    }
+
+    static Block* CachedBlock(size_t capacity)
+    {
+        Cache* cache = ThreadCache();
+        if (!cache) {
+            return nullptr;
+        }
+        for (auto it = cache->fBlocks.begin(); it != cache->fBlocks.end(); ++it) {
+            if ((*it)->fCapacity >= capacity) {
+                Block* block = *it;
+                cache->fBlocks.erase(it);
+                return block;
+            }
+        }
+        return nullptr;
+    }
+
+    static size_t SlotSize(size_t objectSize)
+    {
+        constexpr size_t align = alignof(std::max_align_t);
+        return sizeof(Header) + (objectSize + align - 1) / align * align;
+    }
+
+    static void Unref(Block* block) noexcept
+    {
+        if (block->fRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            Cache* cache = ThreadCache();
+            if (cache && cache->fBlocks.size() < kMaxCachedBlocks) {
+                cache->fBlocks.push_back(block);
+            } else {
+                free(block);
+            }
+        }
+    }
+
+    Block* fBlock;
+    char* fNext;
+    char* fEnd;
+    const size_t fSlotSize;
+};
+
+}   // namespace fair::mq
+
+#endif /* FAIR_MQ_MESSAGEARENA_H */
@@ -0,0 +1,84 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_MESSAGEVIEW_H
+#define FAIR_MQ_MESSAGEVIEW_H
+
+#include <fairmq/Message.h>
+#include <fairmq/tools/Strings.h>
+
+#include <cstddef> // size_t
+#include <cstdint> // uintptr_t
+#include <type_traits>
+
+namespace fair::mq {
+
+/// Non-owning view of a contiguous sequence of T (a subset of C++20 std::span)
+template<typename T>
+class Span
+{
+  public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using size_type = size_t;
+    using iterator = T*;
+
+    constexpr Span() noexcept = default;
+    constexpr Span(T* data, size_type size) noexcept
+        : fData(data)
+        , fSize(size)
+    {}
+
+    constexpr T* data() const noexcept { return fData; }
+    constexpr size_type size() const noexcept { return fSize; }
+    constexpr size_type size_bytes() const noexcept { return fSize * sizeof(T); }
+    constexpr bool empty() const noexcept { return fSize == 0; }
+    constexpr T& operator[](size_type index) const { return fData[index]; }
+    constexpr T& front() const { return fData[0]; }
+    constexpr T& back() const { return fData[fSize - 1]; }
+    constexpr iterator begin() const noexcept { return fData; }
+    constexpr iterator end() const noexcept { return fData + fSize; }
+
+  private:
+    T* fData = nullptr;
+    size_type fSize = 0;
+};
+
+/// Zero-copy typed access to the buffer of a message.
+/// @throw MessageError if the buffer is too small for T or not aligned for T
+template<typename T>
+T& MessageAs(const Message& msg)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "message buffers can only be viewed as trivially copyable types");
+    if (msg.GetSize() < sizeof(T)) {
+        throw MessageError(tools::ToString("Message of ", msg.GetSize(), " bytes is too small for a type of ", sizeof(T), " bytes"));
+    }
+    if (reinterpret_cast<uintptr_t>(msg.GetData()) % alignof(T) != 0) {
+        throw MessageError(tools::ToString("Message buffer is not aligned to ", alignof(T), " bytes"));
+    }
+    return *static_cast<T*>(msg.GetData());
+}
+
+/// Zero-copy view of the buffer of a message as an array of T.
+/// @throw MessageError if the buffer size is not a multiple of the size of T or the buffer is not aligned for T
+template<typename T>
+Span<T> MessageSpan(const Message& msg)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "message buffers can only be viewed as trivially copyable types");
+    if (msg.GetSize() % sizeof(T) != 0) {
+        throw MessageError(tools::ToString("Message of ", msg.GetSize(), " bytes is not a multiple of the element size of ", sizeof(T), " bytes"));
+    }
+    if (msg.GetSize() > 0 && reinterpret_cast<uintptr_t>(msg.GetData()) % alignof(T) != 0) {
+        throw MessageError(tools::ToString("Message buffer is not aligned to ", alignof(T), " bytes"));
+    }
+    return {static_cast<T*>(msg.GetData()), msg.GetSize() / sizeof(T)};
+}
+
+}   // namespace fair::mq
+
+#endif /* FAIR_MQ_MESSAGEVIEW_H */
@@ -0,0 +1,282 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "MultiDeviceRunner.h"
+
+#include <fairmq/DeviceRunner.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Version.h>
+#include <fairmq/Version.h>
+
+#include <fairlogger/Logger.h>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h> // getpid
+
+using namespace std;
+using namespace fair::mq;
+
+namespace
+{
+
+const string kSubscriber("multi-device-runner");
+
+} // namespace
+
+namespace fair::mq
+{
+
+// what the leader knows about a follower
+struct MultiDeviceRunner::FollowerState
+{
+    mutex fMtx;
+    condition_variable fCV;
+    vector<State> fReached; // states reached by the follower, not yet reached by the leader
+    bool fError = false;
+    bool fRejected = false; // a forwarded transition was rejected
+};
+
+MultiDeviceRunner::MultiDeviceRunner(int argc, char*const* argv, DeviceFactory getDevice, CustomOptions addCustomOptions, bool printLogo)
+    : fRawCmdLineArgs(tools::ToStrVector(argc, argv, false))
+    , fTransports(make_shared<TransportRegistry>())
+    , fPrintLogo(printLogo)
+    , fGetDevice(std::move(getDevice))
+    , fAddCustomOptions(std::move(addCustomOptions))
+{}
+
+MultiDeviceRunner::~MultiDeviceRunner() { UnlinkFollowers(); }
+
+auto MultiDeviceRunner::CreateUnit(bool leader) -> Unit
+{
+    Unit unit;
+    unit.fConfig = make_unique<ProgOptions>();
+    // the followers are driven by the leader, they get only the config plugin
+    unit.fPluginManager = leader ? make_unique<PluginManager>(fRawCmdLineArgs) : make_unique<PluginManager>();
+
+    unit.fPluginManager->LoadPlugin("s:config");
+    if (leader) {
+        unit.fPluginManager->LoadPlugin("s:metrics");
+        unit.fPluginManager->LoadPlugin("s:tracing");
+        unit.fPluginManager->LoadPlugin("s:control");
+    }
+
+    namespace po = boost::program_options;
+    po::options_description runnerOptions("Multi-device runner options");
+    runnerOptions.add_options()
+        ("ids", po::value<vector<string>>()->multitoken()->composing(), "IDs of the devices to run in this process, the first one controls the others.");
+    unit.fConfig->AddToCmdLineOptions(runnerOptions);
+
+    if (fAddCustomOptions) {
+        po::options_description customOptions("Custom options");
+        fAddCustomOptions(customOptions);
+        unit.fConfig->AddToCmdLineOptions(customOptions);
+    }
+
+    unit.fPluginManager->ForEachPluginProgOptions([&](po::options_description options) {
+        unit.fConfig->AddToCmdLineOptions(options);
+    });
+    unit.fConfig->AddToCmdLineOptions(PluginManager::ProgramOptions());
+
+    unit.fConfig->ParseAll(fRawCmdLineArgs, true);
+    return unit;
+}
+
+auto MultiDeviceRunner::LinkFollowers() -> void
+{
+    Device& leader = *fUnits.front().fDevice;
+    for (size_t i = 1; i < fUnits.size(); ++i) {
+        auto state = make_shared<FollowerState>();
+        fUnits.at(i).fDevice->SubscribeToStateChange(kSubscriber, [state](State s) {
+            {
+                lock_guard<mutex> lock(state->fMtx);
+                state->fReached.push_back(s);
+                state->fError = state->fError || s == State::Error;
+            }
+            state->fCV.notify_all();
+        });
+        fFollowerStates.push_back(state);
+    }
+
+    // requested transitions are forwarded to the followers (automatic ones are done by every device itself)
+    leader.SubscribeToNewTransition(kSubscriber, [this](Transition transition) {
+        if (transition == Transition::Auto) {
+            return;
+        }
+        for (size_t i = 1; i < fUnits.size(); ++i) {
+            auto& state = fFollowerStates.at(i - 1);
+            if (!fUnits.at(i).fDevice->ChangeState(transition) && transition != Transition::ErrorFound) {
+                LOG(error) << "Device " << fUnits.at(i).fDevice->GetId() << " rejected transition " << transition << " requested on the leading device";
+                {
+                    lock_guard<mutex> lock(state->fMtx);
+                    state->fRejected = true;
+                }
+                state->fCV.notify_all();
+            }
+        }
+    });
+
+    // the leader reaches a state only when all followers reached it, before anybody else is notified about it
+    leader.SubscribeToStateChange(kSubscriber, [this](State s) {
+        if (s == State::Error) {
+            return;
+        }
+        for (size_t i = 1; i < fUnits.size(); ++i) {
+            auto& state = fFollowerStates.at(i - 1);
+            unique_lock<mutex> lock(state->fMtx);
+            auto reached = state->fReached.end();
+            state->fCV.wait(lock, [&] {
+                reached = find(state->fReached.begin(), state->fReached.end(), s);
+                return state->fError || state->fRejected || reached != state->fReached.end();
+            });
+            if (state->fError || state->fRejected) {
+                throw runtime_error(tools::ToString("device ", fUnits.at(i).fDevice->GetId(), " did not reach state ", s));
+            }
+            // both go through the same sequence of states
+            state->fReached.erase(state->fReached.begin(), std::next(reached));
+        }
+    });
+}
+
+auto MultiDeviceRunner::UnlinkFollowers() -> void
+{
+    if (fFollowerStates.empty()) {
+        return;
+    }
+    fUnits.front().fDevice->UnsubscribeFromNewTransition(kSubscriber);
+    fUnits.front().fDevice->UnsubscribeFromStateChange(kSubscriber);
+    for (size_t i = 1; i < fUnits.size(); ++i) {
+        fUnits.at(i).fDevice->UnsubscribeFromStateChange(kSubscriber);
+    }
+    fFollowerStates.clear();
+}
+
+auto MultiDeviceRunner::Run() -> int
+{
+    fUnits.push_back(CreateUnit(true));
+    ProgOptions& config = *fUnits.front().fConfig;
+
+    if (!DeviceRunner::HandleGeneralOptions(config, fPrintLogo)) {
+        return 0;
+    }
+
+    const auto ids = config.GetProperty<vector<string>>("ids", {});
+    if (ids.empty()) {
+        LOG(error) << "No device IDs provided. Provide with `--ids` cmd option. Exiting.";
+        return 1;
+    }
+
+    for (size_t i = 1; i < ids.size(); ++i) {
+        fUnits.push_back(CreateUnit(false));
+    }
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        Unit& unit = fUnits.at(i);
+        unit.fConfig->Notify();
+        unit.fConfig->SetProperty("id", ids.at(i));
+        if (unit.fConfig->Count("config-key")) {
+            LOG(warn) << "--config-key is ignored when running multiple devices, the channels of each device are configured by its id";
+            unit.fConfig->DeleteProperty("config-key");
+        }
+
+        unit.fDevice = fGetDevice(*unit.fConfig);
+        if (!unit.fDevice) {
+            LOG(error) << "getDevice(): no valid device provided for " << ids.at(i) << ". Exiting.";
+            return 1;
+        }
+        unit.fDevice->SetRawCmdLineArgs(fRawCmdLineArgs);
+        unit.fDevice->RegisterChannelEndpoints();
+    }
+
+    // Handle --print-channels and --version
+    if (config.Count("print-channels") || config.Count("version")) {
+        for (auto& unit : fUnits) {
+            if (config.Count("print-channels")) {
+                unit.fDevice->PrintRegisteredChannels();
+            } else {
+                LOGV(info, verylow) << "FairMQ version: " << FAIRMQ_GIT_VERSION;
+                LOGV(info, verylow) << "User device version: " << unit.fDevice->GetVersion();
+            }
+            unit.fDevice->ChangeStateOrThrow(Transition::End);
+        }
+        return 0;
+    }
+
+    LOG(debug) << "PID: " << getpid() << ", running " << ids.size() << " devices";
+
+    for (auto& unit : fUnits) {
+        unit.fDevice->SetConfig(*unit.fConfig);
+        unit.fDevice->SetTransportRegistry(fTransports);
+    }
+
+    // link before the plugins subscribe, so that they (e.g. the controller) see the states of the group
+    LinkFollowers();
+
+    for (auto& unit : fUnits) {
+        unit.fPluginManager->EmplacePluginServices(*unit.fConfig, *unit.fDevice);
+        unit.fPluginManager->InstantiatePlugins();
+    }
+
+    config.PrintOptions();
+
+    vector<thread> followers;
+    for (size_t i = 1; i < fUnits.size(); ++i) {
+        followers.emplace_back([this, i] {
+            try {
+                fUnits.at(i).fDevice->RunStateMachine();
+            } catch (exception& e) {
+                LOG(error) << "Device " << fUnits.at(i).fDevice->GetId() << " failed: " << e.what();
+                if (!fUnits.front().fDevice->ChangeState(Transition::ErrorFound)) {
+                    LOG(debug) << "Leading device is already in the error state";
+                }
+            }
+        });
+    }
+
+    try {
+        fUnits.front().fDevice->RunStateMachine();
+    } catch (...) {
+        for (auto& follower : followers) {
+            follower.join();
+        }
+        UnlinkFollowers();
+        throw;
+    }
+
+    for (auto& follower : followers) {
+        follower.join();
+    }
+
+    fUnits.front().fPluginManager->WaitForPluginsToReleaseDeviceControl();
+
+    UnlinkFollowers();
+
+    return 0;
+}
+
+auto MultiDeviceRunner::RunWithExceptionHandlers() -> int
+{
+    try {
+        return Run();
+    } catch (exception& e) {
+        LOG(error) << "Uncaught exception reached the top of MultiDeviceRunner: " << e.what();
+        return 1;
+    } catch (...) {
+        LOG(error) << "Uncaught exception reached the top of MultiDeviceRunner.";
+        return 1;
+    }
+}
+
+} // namespace fair::mq
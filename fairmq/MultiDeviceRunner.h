@@ -0,0 +1,87 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_MULTIDEVICERUNNER_H
+#define FAIR_MQ_MULTIDEVICERUNNER_H
+
+#include <fairmq/Device.h>
+#include <fairmq/PluginManager.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportRegistry.h>
+
+#include <boost/program_options/options_description.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fair::mq
+{
+
+/**
+ * @class MultiDeviceRunner MultiDeviceRunner.h <fairmq/MultiDeviceRunner.h>
+ * @brief Runs several devices of a topology in one process, sharing their transports.
+ *
+ * The devices are given with `--ids <id1> <id2> ...` and configured from the same topology (`--mq-config` or
+ * `--channel-config`), each with its own id. All devices share one fair::mq::TransportRegistry, i.e. one zmq context
+ * and one shmem segment manager (with their threads).
+ *
+ * The first device is the leader: it gets the plugins of the command line (including the control plugin) and is
+ * controlled as if it was the only device. The other devices follow it: every transition requested on the leader is
+ * requested on them too, and the leader reaches a state only after all followers reached it. An error of any device
+ * brings all devices into the error state.
+ *
+ * For an example usage of this class see the <fairmq/runDevices.h> header.
+ */
+class MultiDeviceRunner
+{
+  public:
+    using DeviceFactory = std::function<std::unique_ptr<Device>(ProgOptions&)>;
+    using CustomOptions = std::function<void(boost::program_options::options_description&)>;
+
+    /// @param getDevice called for every device with its configuration (id set), returns the device
+    /// @param addCustomOptions adds custom command line options (the same for all devices)
+    MultiDeviceRunner(int argc, char*const* argv, DeviceFactory getDevice, CustomOptions addCustomOptions = nullptr, bool printLogo = true);
+
+    MultiDeviceRunner(const MultiDeviceRunner&) = delete;
+    MultiDeviceRunner(MultiDeviceRunner&&) = delete;
+    MultiDeviceRunner& operator=(const MultiDeviceRunner&) = delete;
+    MultiDeviceRunner& operator=(MultiDeviceRunner&&) = delete;
+    ~MultiDeviceRunner();
+
+    auto Run() -> int;
+    auto RunWithExceptionHandlers() -> int;
+
+    struct Unit
+    {
+        std::unique_ptr<ProgOptions> fConfig;
+        std::unique_ptr<PluginManager> fPluginManager;
+        std::unique_ptr<Device> fDevice;
+    };
+
+    std::vector<std::string> fRawCmdLineArgs;
+    std::vector<Unit> fUnits; ///< leader first
+    std::shared_ptr<TransportRegistry> fTransports;
+    const bool fPrintLogo;
+
+  private:
+    struct FollowerState;
+
+    auto CreateUnit(bool leader) -> Unit;
+    auto LinkFollowers() -> void;
+    auto UnlinkFollowers() -> void;
+
+    DeviceFactory fGetDevice;
+    CustomOptions fAddCustomOptions;
+    std::vector<std::shared_ptr<FollowerState>> fFollowerStates;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_MULTIDEVICERUNNER_H */
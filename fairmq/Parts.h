@@ -11,12 +11,17 @@
 
 #include <algorithm>          // std::move
 #include <fairmq/Message.h>   // fair::mq::MessagePtr
+#include <fairmq/MessageView.h> // fair::mq::MessageAs, fair::mq::MessageSpan
 #include <iterator>           // std::back_inserter
 #include <utility>            // std::move, std::forward
 #include <vector>             // std::vector
 
 namespace fair::mq {
 
+/// Destroys the messages via TransportFactory::ReleaseMessages of their transport, which may release
+/// the buffers in bulk. Leaves msgs empty.
+void ReleaseMessages(std::vector<MessagePtr>& msgs) noexcept;
+
 /// fair::mq::Parts is a lightweight move-only convenience wrapper around a vector of unique pointers to
 /// Message, used for sending multi-part messages
 struct Parts
@@ -33,7 +38,7 @@ struct Parts
     Parts& operator=(const Parts&) = delete;
     Parts(Parts&&) = default;
     Parts& operator=(Parts&&) = default;
-    ~Parts() = default;
+    ~Parts() { Clear(); }
 
     template<typename... Ps>
     Parts(Ps&&... parts)
@@ -75,9 +80,21 @@ struct Parts
     reference At(size_type index) { return fParts.at(index); }
     const_reference At(size_type index) const { return fParts.at(index); }
 
+    /// Zero-copy typed access to the buffer of a part (see MessageAs)
+    template<typename T>
+    T& As(size_type index) const { return MessageAs<T>(*(fParts.at(index))); }
+    /// Zero-copy view of the buffer of a part as an array of T (see MessageSpan)
+    template<typename T>
+    Span<T> AsSpan(size_type index) const { return MessageSpan<T>(*(fParts.at(index))); }
+
     size_type Size() const noexcept { return fParts.size(); }
     bool Empty() const noexcept { return fParts.empty(); }
-    void Clear() noexcept { fParts.clear(); }
+    void Clear() noexcept
+    {
+        if (!fParts.empty()) {
+            ReleaseMessages(fParts);
+        }
+    }
 
     // range access
     iterator begin() noexcept { return fParts.begin(); }
@@ -0,0 +1,82 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_PARTSBUILDER_H
+#define FAIR_MQ_PARTSBUILDER_H
+
+#include <fairmq/MemoryResources.h>
+#include <fairmq/MessageView.h>
+#include <fairmq/Parts.h>
+#include <fairmq/TransportFactory.h>
+
+#include <type_traits>
+#include <utility>     // std::forward, std::move
+
+namespace fair::mq {
+
+/// Builds a multipart message in place: headers and payloads are constructed directly in the (e.g. shared memory)
+/// buffers of new messages of the given transport, without intermediate containers or copies.
+///
+///     PartsBuilder builder(*channel.Transport());
+///     builder.AddHeader<MyHeader>(42, 3);
+///     auto payload = builder.AddPayload<float>(1024);
+///     std::fill(payload.begin(), payload.end(), 0.f);
+///     channel.Send(builder.Finish());
+class PartsBuilder
+{
+  public:
+    explicit PartsBuilder(TransportFactory& transport)
+        : fTransport(transport)
+    {}
+    explicit PartsBuilder(MemoryResource& resource)
+        : fTransport(*resource.getTransportFactory())
+    {}
+
+    /// append a part holding a T constructed with args, aligned for T
+    /// @return the constructed object, valid as long as the part
+    template<typename T, typename... Args>
+    T& AddHeader(Args&&... args)
+    {
+        MessagePtr msg = fTransport.NewTypedMessage<T>(std::forward<Args>(args)...);
+        T* header = static_cast<T*>(msg->GetData());
+        fParts.AddPart(std::move(msg));
+        return *header;
+    }
+
+    /// append a part with room for n (uninitialized) elements of T, aligned for T
+    /// @return view of the elements, valid as long as the part
+    template<typename T>
+    Span<T> AddPayload(size_t n)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "payloads are transferred as bytes and have to be trivially copyable");
+        MessagePtr msg = fTransport.CreateMessage(n * sizeof(T), Alignment{alignof(T)});
+        Span<T> payload(static_cast<T*>(msg->GetData()), n);
+        fParts.AddPart(std::move(msg));
+        return payload;
+    }
+
+    /// shrink the last part to n elements of T, e.g. if less payload was produced than reserved with AddPayload
+    template<typename T>
+    void ShrinkLast(size_t n)
+    {
+        fParts.At(fParts.Size() - 1)->SetUsedSize(n * sizeof(T));
+    }
+
+    size_t Size() const { return fParts.Size(); }
+
+    /// @return the built parts, the builder is empty afterwards
+    Parts Finish() { return std::move(fParts); }
+
+  private:
+    TransportFactory& fTransport;
+    Parts fParts;
+};
+
+}   // namespace fair::mq
+
+#endif /* FAIR_MQ_PARTSBUILDER_H */
@@ -23,6 +23,7 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 namespace fair::mq
 {
@@ -92,6 +93,9 @@ class Plugin
     auto UnsubscribeFromDeviceStateChange() -> void { fPluginServices->UnsubscribeFromDeviceStateChange(fkName); }
 
     auto GetNumberOfConnectedPeers(const std::string& channelName, int index = 0) -> unsigned long { return fPluginServices->GetNumberOfConnectedPeers(channelName, index); }
+    auto GetChannelMetrics() const -> std::vector<ChannelMetrics> { return fPluginServices->GetChannelMetrics(); }
+    auto GetRunMetrics() const -> ChannelMetrics { return fPluginServices->GetRunMetrics(); }
+    auto GetTransportMetrics() -> std::vector<TransportMetric> { return fPluginServices->GetTransportMetrics(); }
 
     // device config API
     // see <fairmq/PluginServices.h> for docs
@@ -126,6 +130,8 @@ class Plugin
     auto UnsubscribeFromPropertyChange() -> void { fPluginServices->UnsubscribeFromPropertyChange<T>(fkName); }
     auto SubscribeToPropertyChangeAsString(std::function<void(const std::string& key, std::string newValue)> callback) -> void { fPluginServices->SubscribeToPropertyChangeAsString(fkName, callback); }
     auto UnsubscribeFromPropertyChangeAsString() -> void { fPluginServices->UnsubscribeFromPropertyChangeAsString(fkName); }
+    auto SubscribeToPropertiesChange(std::function<void(const std::vector<std::string>& keys)> callback) -> void { fPluginServices->SubscribeToPropertiesChange(fkName, callback); }
+    auto UnsubscribeFromPropertiesChange() -> void { fPluginServices->UnsubscribeFromPropertiesChange(fkName); }
 
     auto CycleLogConsoleSeverityUp() -> void { fPluginServices->CycleLogConsoleSeverityUp(); }
     auto CycleLogConsoleSeverityDown() -> void { fPluginServices->CycleLogConsoleSeverityDown(); }
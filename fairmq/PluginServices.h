@@ -85,6 +85,9 @@ class PluginServices
     /// @return current device state
     auto GetCurrentDeviceState() const -> DeviceState { return fDevice.GetCurrentState(); }
 
+    /// @return timings of the last device state transitions, oldest first
+    auto GetTransitionTimings() const -> std::vector<TransitionTiming> { return fDevice.GetTransitionTimings(); }
+
     /// @brief Become device controller
     /// @param controller id
     /// @throws fair::mq::PluginServices::DeviceControlError if there is already a device controller.
@@ -141,6 +144,19 @@ class PluginServices
     /// DO NOT USE, ONLY FOR TESTING, WILL BE REMOVED (and info made available via property api)
     auto GetNumberOfConnectedPeers(const std::string& channelName, int index = 0) -> unsigned long { return fDevice.GetNumberOfConnectedPeers(channelName, index); }
 
+    /// @brief Snapshots of the transfer counters and call metrics of all subchannels (see Device::GetChannelMetrics)
+    /// @return one entry per subchannel, call metrics are only recorded with --channel-metrics
+    ///
+    /// Only valid in the states between Binding and ResettingTask, e.g. poll it from a monitoring plugin while Running.
+    auto GetChannelMetrics() const -> std::vector<ChannelMetrics> { return fDevice.GetChannelMetrics(); }
+
+    /// @brief Duration and hardware counters of the ConditionalRun() calls (see Device::GetRunMetrics)
+    auto GetRunMetrics() const -> ChannelMetrics { return fDevice.GetRunMetrics(); }
+
+    /// @brief Transport specific metrics, e.g. free shared memory and allocation failures (see TransportFactory::GetMetrics)
+    /// @return metrics of all transports of the device, labeled with the transport name. Can be called in any state
+    auto GetTransportMetrics() -> std::vector<TransportMetric> { return fDevice.GetTransportMetrics(); }
+
     // Config API
 
     /// @brief Checks a property with the given key exist in the configuration
@@ -263,6 +279,18 @@ class PluginServices
     /// @param subscriber
     auto UnsubscribeFromPropertyChangeAsString(const std::string& subscriber) -> void { fConfig.UnsubscribeAsString(subscriber); }
 
+    /// @brief Subscribe to batched property updates
+    /// @param subscriber
+    /// @param callback function, receives the keys of all properties changed by one update
+    auto SubscribeToPropertiesChange(const std::string& subscriber, std::function<void(const std::vector<std::string>& keys)> callback) const -> void
+    {
+        fConfig.SubscribeToPropertiesChange(subscriber, callback);
+    }
+
+    /// @brief Unsubscribe from batched property updates
+    /// @param subscriber
+    auto UnsubscribeFromPropertiesChange(const std::string& subscriber) -> void { fConfig.UnsubscribeFromPropertiesChange(subscriber); }
+
     /// @brief Increases console logging severity, or sets it to lowest if it is already highest
     auto CycleLogConsoleSeverityUp() -> void { Logger::CycleConsoleSeverityUp(); }
     /// @brief Decreases console logging severity, or sets it to highest if it is already lowest
@@ -12,6 +12,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace fair::mq {
 
@@ -28,6 +29,12 @@ struct Poller
     virtual bool CheckOutput(int index) = 0;
     virtual bool CheckInput(const std::string& channelKey, int index) = 0;
     virtual bool CheckOutput(const std::string& channelKey, int index) = 0;
+    /// Indices (as for CheckInput(int)) of the items with input after the last Poll(), in ascending order.
+    /// @return false if the poller does not track ready items, then every item has to be checked with CheckInput()
+    virtual bool ReadyInputs(std::vector<int>& /* indices */) { return false; }
+    /// Let Poll() also return (without ready items) while fd is readable, e.g. the eventfd of a tools::Wakeup.
+    /// @return false if the poller does not support it, then Poll() has to be called with a finite timeout to notice events
+    virtual bool AddWakeup(int /* fd */) { return false; }
 
     virtual ~Poller() = default;
 };
@@ -77,6 +77,7 @@ ProgOptions::ProgOptions()
         ("verbosity",     po::value<string>()->default_value("medium"), "Log verbosity level: veryhigh, high, medium, low")
         ("color",         po::value<bool  >()->default_value(true),     "Log color (true/false)")
         ("log-to-file",   po::value<string>()->default_value(""),       "Log output to a file.")
+        ("log-async",     po::value<bool  >()->default_value(false),    "Write the console log from a background thread, dropping lines instead of blocking when it cannot keep up (true/false)")
         ("print-options", po::value<bool  >()->implicit_value(true),    "Print options in machine-readable format (<option>:<computed-value>:<type>:<description>)");
 
     ParseDefaults();
@@ -129,12 +130,21 @@ void ProgOptions::ParseAll(const int argc, char const* const* argv, bool allowUn
     fUnregisteredOptions = po::collect_unrecognized(parsed.options, po::include_positional);
 
     po::store(parsed, fVarMap);
+    UpdateAllPropertySlots();
 }
 
 void ProgOptions::Notify()
 {
     lock_guard<mutex> lock(fMtx);
     po::notify(fVarMap);
+    UpdateAllPropertySlots();
+}
+
+void ProgOptions::UpdateAllPropertySlots()
+{
+    for (const auto& slots : fPropertySlots) {
+        UpdatePropertySlots(slots.first);
+    }
 }
 
 void ProgOptions::AddToCmdLineOptions(const po::options_description optDesc, bool /* visible */)
@@ -306,13 +316,36 @@ void ProgOptions::SetProperties(const Properties& input)
     map<string, boost::program_options::variable_value>& vm = fVarMap;
     for (const auto& m : input) {
         vm[m.first].value() = m.second;
+        UpdatePropertySlots(m.first);
     }
 
     lock.unlock();
 
-    for (const auto& m : input) {
-        PropertyHelper::fEventEmitters.at(m.second.type())(fEvents, m.first, m.second);
-        fEvents.Emit<PropertyChangeAsString, string>(m.first, PropertyHelper::ConvertPropertyToString(m.second));
+    EmitPropertiesChange(input);
+}
+
+void ProgOptions::EmitPropertiesChange(const Properties& input) const
+{
+    const bool typed = fEvents.HasSubscribers<PropertyChange>();
+    const bool asString = fEvents.HasSubscribers<PropertyChangeAsString>();
+    if (typed || asString) {
+        for (const auto& m : input) {
+            if (typed) {
+                PropertyHelper::fEventEmitters.at(m.second.type())(fEvents, m.first, m.second);
+            }
+            if (asString) {
+                fEvents.Emit<PropertyChangeAsString, string>(m.first, PropertyHelper::ConvertPropertyToString(m.second));
+            }
+        }
+    }
+
+    if (fEvents.HasSubscribers<PropertiesChange>()) {
+        vector<string> keys;
+        keys.reserve(input.size());
+        for (const auto& m : input) {
+            keys.push_back(m.first);
+        }
+        fEvents.Emit<PropertiesChange>(keys);
     }
 }
 
@@ -330,14 +363,12 @@ bool ProgOptions::UpdateProperties(const Properties& input)
     map<string, boost::program_options::variable_value>& vm = fVarMap;
     for (const auto& m : input) {
         vm[m.first].value() = m.second;
+        UpdatePropertySlots(m.first);
     }
 
     lock.unlock();
 
-    for (const auto& m : input) {
-        PropertyHelper::fEventEmitters.at(m.second.type())(fEvents, m.first, m.second);
-        fEvents.Emit<PropertyChangeAsString, string>(m.first, PropertyHelper::ConvertPropertyToString(m.second));
-    }
+    EmitPropertiesChange(input);
 
     return true;
 }
@@ -370,10 +401,44 @@ void ProgOptions::AddChannel(const string& name, const Channel& channel)
     SetVarMapValue<int>(string(prefix + "sndKernelSize"), channel.GetSndKernelSize());
     SetVarMapValue<int>(string(prefix + "rcvKernelSize"), channel.GetRcvKernelSize());
     SetVarMapValue<int>(string(prefix + "linger"), channel.GetLinger());
+    SetVarMapValue<string>(string(prefix + "rcvMode"), channel.GetRcvMode());
+    SetVarMapValue<int>(string(prefix + "rcvSpinUs"), channel.GetRcvSpinUs());
+    SetVarMapValue<int>(string(prefix + "sndBatch"), channel.GetSndBatch());
+    SetVarMapValue<int>(string(prefix + "sndBatchTimeoutUs"), channel.GetSndBatchTimeoutUs());
+    SetVarMapValue<int>(string(prefix + "batchLatencyTargetUs"), channel.GetBatchLatencyTargetUs());
+    SetVarMapValue<string>(string(prefix + "metaFormat"), channel.GetMetaFormat());
+    SetVarMapValue<string>(string(prefix + "contextGroup"), channel.GetContextGroup());
+    SetVarMapValue<int>(string(prefix + "packParts"), channel.GetPackParts());
+    SetVarMapValue<string>(string(prefix + "compression"), channel.GetCompression());
+    SetVarMapValue<int>(string(prefix + "compressionLevel"), channel.GetCompressionLevel());
+    SetVarMapValue<int>(string(prefix + "compressionThreads"), channel.GetCompressionThreads());
+    SetVarMapValue<int>(string(prefix + "compressionMinSize"), channel.GetCompressionMinSize());
+    SetVarMapValue<int>(string(prefix + "chunkSize"), channel.GetChunkSize());
+    SetVarMapValue<int>(string(prefix + "multicastRate"), channel.GetMulticastRate());
+    SetVarMapValue<int>(string(prefix + "multicastRecovery"), channel.GetMulticastRecovery());
+    SetVarMapValue<bool>(string(prefix + "trace"), channel.GetTrace());
+    SetVarMapValue<string>(string(prefix + "overflow"), channel.GetOverflow());
+    SetVarMapValue<int>(string(prefix + "deadline"), channel.GetDeadline());
+    SetVarMapValue<string>(string(prefix + "sample"), channel.GetSample());
+    SetVarMapValue<int>(string(prefix + "maxBandwidth"), channel.GetMaxBandwidth());
+    SetVarMapValue<int>(string(prefix + "burst"), channel.GetBurst());
+    SetVarMapValue<string>(string(prefix + "checksum"), channel.GetChecksum());
+    SetVarMapValue<bool>(string(prefix + "priorityLane"), channel.GetPriorityLane());
+    SetVarMapValue<bool>(string(prefix + "mux"), channel.GetMux());
+    SetVarMapValue<string>(string(prefix + "route"), channel.GetRoute());
+    SetVarMapValue<int>(string(prefix + "peerTimeout"), channel.GetPeerTimeout());
+    SetVarMapValue<bool>(string(prefix + "autoTune"), channel.GetAutoTune());
+    SetVarMapValue<int>(string(prefix + "autoTuneMaxBufSize"), channel.GetAutoTuneMaxBufSize());
+    SetVarMapValue<int>(string(prefix + "autoTuneMaxKernelSize"), channel.GetAutoTuneMaxKernelSize());
     SetVarMapValue<int>(string(prefix + "rateLogging"), channel.GetRateLogging());
     SetVarMapValue<int>(string(prefix + "portRangeMin"), channel.GetPortRangeMin());
     SetVarMapValue<int>(string(prefix + "portRangeMax"), channel.GetPortRangeMax());
     SetVarMapValue<bool>(string(prefix + "autoBind"), channel.GetAutoBind());
+    SetVarMapValue<string>(string(prefix + "autoBindStrategy"), channel.GetAutoBindStrategy());
+    SetVarMapValue<bool>(string(prefix + "hybrid"), channel.GetHybrid());
+    SetVarMapValue<bool>(string(prefix + "sharedSend"), channel.GetSharedSend());
+    SetVarMapValue<string>(string(prefix + "spillDir"), channel.GetSpillDir());
+    SetVarMapValue<int>(string(prefix + "spillSize"), channel.GetSpillSize());
 }
 
 void ProgOptions::PrintHelp() const
@@ -16,11 +16,14 @@
 #include <fairmq/ProgOptionsFwd.h>
 #include <fairmq/Properties.h>
 #include <fairmq/tools/Strings.h>
+#include <atomic>
 #include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -29,6 +32,83 @@ namespace fair::mq
 
 struct PropertyNotFoundError : std::runtime_error { using std::runtime_error::runtime_error; };
 
+namespace detail
+{
+
+/// current value of a property, shared by the PropertyHandles of a key and type, updated by ProgOptions (with its lock held)
+struct PropertySlotBase
+{
+    virtual void Update(const boost::any& value) = 0;
+    virtual ~PropertySlotBase() = default;
+};
+
+template<typename T, bool = std::is_arithmetic<T>::value || std::is_enum<T>::value>
+struct PropertySlot : PropertySlotBase
+{
+    explicit PropertySlot(const T& value) : fValue(value) {}
+
+    void Update(const boost::any& value) override
+    {
+        if (const T* v = boost::any_cast<T>(&value)) {
+            fValue.store(*v, std::memory_order_relaxed);
+        }
+    }
+
+    T Get() const { return fValue.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<T> fValue;
+};
+
+// values of other types are published as immutable versions, superseded versions are kept alive with the slot,
+// so that readers never wait and never see a destroyed value
+template<typename T>
+struct PropertySlot<T, false> : PropertySlotBase
+{
+    explicit PropertySlot(const T& value)
+    {
+        Update(boost::any(value));
+    }
+
+    void Update(const boost::any& value) override
+    {
+        if (const T* v = boost::any_cast<T>(&value)) {
+            fVersions.push_back(std::make_unique<const T>(*v));
+            fCurrent.store(fVersions.back().get(), std::memory_order_release);
+        }
+    }
+
+    const T& Get() const { return *fCurrent.load(std::memory_order_acquire); }
+
+  private:
+    std::atomic<const T*> fCurrent{nullptr};
+    std::vector<std::unique_ptr<const T>> fVersions;
+};
+
+} // namespace detail
+
+/// @brief Typed handle to a config property, resolved once with ProgOptions::GetPropertyHandle
+///
+/// Get() is a single atomic load (no lock, no key lookup), for properties that are read in hot paths.
+/// The handle follows all updates of the property. If the property is deleted, or set to a value of another type,
+/// the handle keeps the last value.
+template<typename T>
+class PropertyHandle
+{
+  public:
+    PropertyHandle() = default;
+
+    /// @return current value of the property (a reference for non-arithmetic types, valid as long as the handle)
+    decltype(auto) Get() const { return fSlot->Get(); }
+    explicit operator bool() const { return static_cast<bool>(fSlot); }
+
+  private:
+    friend class ProgOptions;
+    explicit PropertyHandle(std::shared_ptr<const detail::PropertySlot<T>> slot) : fSlot(std::move(slot)) {}
+
+    std::shared_ptr<const detail::PropertySlot<T>> fSlot;
+};
+
 class ProgOptions
 {
   public:
@@ -86,6 +166,27 @@ class ProgOptions
         return ifNotFound;
     }
 
+    /// @brief Get a handle to a config property for repeated reads, throw if no property with this key exists
+    /// @param key
+    /// @return handle, reads the current value of the property without locking
+    template<typename T>
+    PropertyHandle<T> GetPropertyHandle(const std::string& key) const
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        if (!fVarMap.count(key)) {
+            throw PropertyNotFoundError(fair::mq::tools::ToString("Config has no key: ", key));
+        }
+        auto& slots = fPropertySlots[key];
+        for (const auto& slot : slots) {
+            if (auto typed = std::dynamic_pointer_cast<const detail::PropertySlot<T>>(slot)) {
+                return PropertyHandle<T>(std::move(typed));
+            }
+        }
+        auto slot = std::make_shared<detail::PropertySlot<T>>(fVarMap[key].as<T>());
+        slots.push_back(slot);
+        return PropertyHandle<T>(std::move(slot));
+    }
+
     /// @brief Read config property as string, throw if no property with this key exists
     /// @param key
     /// @return config property converted to string
@@ -137,8 +238,7 @@ class ProgOptions
 
         lock.unlock();
 
-        fEvents.Emit<fair::mq::PropertyChange, typename std::decay<T>::type>(key, val);
-        fEvents.Emit<fair::mq::PropertyChangeAsString, std::string>(key, GetPropertyAsString(key));
+        EmitPropertyChange<typename std::decay<T>::type>(key, val);
     }
 
     /// @brief Updates an existing config property (or fails if it doesn't exist)
@@ -154,8 +254,7 @@ class ProgOptions
 
             lock.unlock();
 
-            fEvents.Emit<fair::mq::PropertyChange, typename std::decay<T>::type>(key, val);
-            fEvents.Emit<fair::mq::PropertyChangeAsString, std::string>(key, GetPropertyAsString(key));
+            EmitPropertyChange<typename std::decay<T>::type>(key, val);
             return true;
         } else {
             LOG(debug) << "UpdateProperty failed, no property found with key '" << key << "'";
@@ -220,6 +319,26 @@ class ProgOptions
         fEvents.Unsubscribe<fair::mq::PropertyChangeAsString, std::string>(subscriber);
     }
 
+    /// @brief Subscribe to batched property updates
+    /// @param subscriber
+    /// @param callback function, receives the keys of all properties changed by one SetProperty/UpdateProperty/SetProperties/UpdateProperties call
+    ///
+    /// Called once per update instead of once per key, the new values can be read with GetProperty.
+    /// Considerably cheaper than Subscribe/SubscribeAsString for updates of many properties.
+    void SubscribeToPropertiesChange(const std::string& subscriber, std::function<void(const std::vector<std::string>& keys)> func) const
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fEvents.Subscribe<fair::mq::PropertiesChange>(subscriber, func);
+    }
+
+    /// @brief Unsubscribe from batched property updates
+    /// @param subscriber
+    void UnsubscribeFromPropertiesChange(const std::string& subscriber) const
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fEvents.Unsubscribe<fair::mq::PropertiesChange>(subscriber);
+    }
+
     /// @brief prints full options description
     void PrintHelp() const;
     /// @brief prints properties stored in the property container
@@ -264,7 +383,38 @@ class ProgOptions
     {
         std::map<std::string, boost::program_options::variable_value>& vm = fVarMap;
         vm[key].value() = boost::any(val);
+        UpdatePropertySlots(key);
+    }
+
+    // publish the current value of key to its property handles, call with fMtx held
+    void UpdatePropertySlots(const std::string& key)
+    {
+        if (fPropertySlots.empty()) {
+            return;
+        }
+        auto it = fPropertySlots.find(key);
+        if (it != fPropertySlots.end() && fVarMap.count(key)) {
+            for (const auto& slot : it->second) {
+                slot->Update(fVarMap[key].value());
+            }
+        }
+    }
+    void UpdateAllPropertySlots();
+
+    // notify the subscribers of a changed property, call without fMtx held.
+    // The string conversion and the batched event are skipped if nobody subscribed to them.
+    template<typename T>
+    void EmitPropertyChange(const std::string& key, const T& val) const
+    {
+        fEvents.Emit<fair::mq::PropertyChange, T>(key, val);
+        if (fEvents.HasSubscribers<fair::mq::PropertyChangeAsString>()) {
+            fEvents.Emit<fair::mq::PropertyChangeAsString, std::string>(key, GetPropertyAsString(key));
+        }
+        if (fEvents.HasSubscribers<fair::mq::PropertiesChange>()) {
+            fEvents.Emit<fair::mq::PropertiesChange>(std::vector<std::string>{key});
+        }
     }
+    void EmitPropertiesChange(const fair::mq::Properties& input) const;
 
     boost::program_options::variables_map fVarMap; ///< options container
     boost::program_options::options_description fAllOptions; ///< all options descriptions
@@ -272,6 +422,7 @@ class ProgOptions
 
     mutable fair::mq::EventManager fEvents;
     mutable std::mutex fMtx;
+    mutable std::unordered_map<std::string, std::vector<std::shared_ptr<detail::PropertySlotBase>>> fPropertySlots; ///< guarded by fMtx
 };
 
 } // namespace fair::mq
@@ -21,6 +21,7 @@
 #include <typeindex>
 #include <typeinfo>
 #include <utility> // pair
+#include <vector>
 
 namespace fair::mq
 {
@@ -30,6 +31,8 @@ using Properties = std::map<std::string, Property>;
 
 struct PropertyChange : Event<std::string> {};
 struct PropertyChangeAsString : Event<std::string> {};
+/// batched property change: all keys changed by one Set/UpdateProperty(ies) call
+struct PropertiesChange : Event<const std::vector<std::string>&> {};
 
 class PropertyHelper
 {
@@ -0,0 +1,158 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_REGIONEXTENTS_H
+#define FAIR_MQ_REGIONEXTENTS_H
+
+#include <fairmq/Message.h>
+#include <fairmq/MessageView.h>
+#include <fairmq/Parts.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/Strings.h>
+
+#include <algorithm> // min, max
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <cstring>   // memcpy
+#include <utility>   // move
+#include <vector>
+
+namespace fair::mq {
+
+/// range of a region extents message, relative to the start of its span
+struct RegionExtent
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+/// first part of a region extents message, followed by fNumExtents RegionExtent entries
+struct RegionExtentsHeader
+{
+    static constexpr uint32_t kMagic = 0x584d4646; // "FFMX"
+
+    uint32_t fMagic;
+    uint32_t fNumExtents;
+};
+
+/// Zero-copy aggregation of ranges of one unmanaged region (e.g. the DMA pages of a time frame) into one logical
+/// message of two parts: a descriptor listing the ranges, followed by one region message that spans from the lowest
+/// to the highest address of the ranges. The ranges thus cost one meta header, one reference count and one ack
+/// altogether, instead of one part each. The ranges may be in any order and do not have to be contiguous. The gaps
+/// between them belong to the span: the shmem transport does not touch them, transports that move the data (e.g.
+/// zeromq over tcp) transfer the whole span.
+/// The region callback is invoked once per extents message, for the span and with the given hint, the region owner
+/// releases all ranges of the message at once (e.g. the hint identifies the time frame).
+///
+///     std::vector<Span<char>> pages; // in the region, filled by the readout
+///     channel.Send(NewRegionExtents(*channel.Transport(), region, pages, frame));
+///
+///     RegionExtentsView frame(parts); // receiver
+///     for (size_t i = 0; i < frame.Size(); ++i) {
+///         Process(frame[i].data(), frame[i].size());
+///     }
+///
+/// @throw MessageError if there are no ranges or a range is outside of the region
+inline Parts NewRegionExtents(TransportFactory& transport, UnmanagedRegionPtr& region, const std::vector<Span<char>>& ranges, void* hint = nullptr)
+{
+    if (ranges.empty()) {
+        throw MessageError("Region extents message without ranges");
+    }
+    char* const regionBegin = static_cast<char*>(region->GetData());
+    char* const regionEnd = regionBegin + region->GetSize();
+    char* begin = ranges.front().data();
+    char* end = begin;
+    for (const auto& range : ranges) {
+        if (range.data() < regionBegin || range.data() + range.size() > regionEnd) {
+            throw MessageError(tools::ToString("Range of ", range.size(), " bytes is outside of region ", region->GetId()));
+        }
+        begin = std::min(begin, range.data());
+        end = std::max(end, range.data() + range.size());
+    }
+
+    MessagePtr descriptor(transport.CreateMessage(sizeof(RegionExtentsHeader) + ranges.size() * sizeof(RegionExtent), Alignment{alignof(RegionExtent)}));
+    char* const out = static_cast<char*>(descriptor->GetData());
+    const RegionExtentsHeader header{RegionExtentsHeader::kMagic, static_cast<uint32_t>(ranges.size())};
+    std::memcpy(out, &header, sizeof(header));
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const RegionExtent extent{static_cast<uint64_t>(ranges[i].data() - begin), ranges[i].size()};
+        std::memcpy(out + sizeof(header) + i * sizeof(RegionExtent), &extent, sizeof(extent));
+    }
+
+    Parts parts;
+    parts.AddPart(std::move(descriptor));
+    parts.AddPart(transport.CreateMessage(region, begin, end - begin, hint));
+    return parts;
+}
+
+/// @return true if the parts contain a region extents message at index
+inline bool IsRegionExtents(const Parts& parts, size_t index = 0)
+{
+    if (parts.Size() < index + 2 || parts[index].GetSize() < sizeof(RegionExtentsHeader)) {
+        return false;
+    }
+    RegionExtentsHeader header{};
+    std::memcpy(&header, parts[index].GetData(), sizeof(header));
+    return header.fMagic == RegionExtentsHeader::kMagic
+        && parts[index].GetSize() == sizeof(header) + header.fNumExtents * sizeof(RegionExtent);
+}
+
+/// Zero-copy access to the ranges of a received region extents message (see NewRegionExtents).
+/// Valid as long as the parts.
+class RegionExtentsView
+{
+  public:
+    /// @param parts received parts, with the extents message at index
+    /// @throw MessageError if the parts do not contain a (valid) extents message at index
+    explicit RegionExtentsView(Parts& parts, size_t index = 0)
+        : fSpan(nullptr)
+    {
+        if (!IsRegionExtents(parts, index)) {
+            throw MessageError(tools::ToString("Part ", index, " is not a region extents message"));
+        }
+        const char* in = static_cast<const char*>(parts[index].GetData());
+        RegionExtentsHeader header{};
+        std::memcpy(&header, in, sizeof(header));
+        fExtents.resize(header.fNumExtents);
+        std::memcpy(fExtents.data(), in + sizeof(header), fExtents.size() * sizeof(RegionExtent));
+        fSpan = parts.At(index + 1).get();
+        for (const auto& extent : fExtents) {
+            if (extent.offset + extent.size > fSpan->GetSize()) {
+                throw MessageError(tools::ToString("Region extent at ", extent.offset, " of ", extent.size, " bytes exceeds the span of ", fSpan->GetSize(), " bytes"));
+            }
+        }
+    }
+
+    /// number of ranges
+    size_t Size() const { return fExtents.size(); }
+    /// data of range i
+    Span<char> operator[](size_t i) const { return Span<char>(static_cast<char*>(fSpan->GetData()) + fExtents[i].offset, fExtents[i].size); }
+    /// total size of the ranges, without the gaps of the span
+    size_t TotalSize() const
+    {
+        size_t total = 0;
+        for (const auto& extent : fExtents) {
+            total += extent.size;
+        }
+        return total;
+    }
+    /// message spanning all ranges
+    Message& GetSpan() const { return *fSpan; }
+    /// range i as a message of its own, sharing the buffer of the span (see Message::Slice). It keeps the span (and
+    /// thus the ack of the whole extents message) alive. nullptr if the transport does not support slices
+    MessagePtr Slice(size_t i) const { return fSpan->Slice(fExtents[i].offset, fExtents[i].size); }
+
+  private:
+    std::vector<RegionExtent> fExtents;
+    Message* fSpan;
+};
+
+}   // namespace fair::mq
+
+#endif /* FAIR_MQ_REGIONEXTENTS_H */
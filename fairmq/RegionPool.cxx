@@ -0,0 +1,168 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairlogger/Logger.h>
+#include <fairmq/RegionPool.h>
+#include <fairmq/Tools.h>
+#include <fairmq/TransportFactory.h>
+
+#include <algorithm>   // sort
+#include <chrono>
+
+using namespace std;
+
+namespace fair::mq {
+
+namespace {
+
+vector<RegionPool::SizeClass> SortedClasses(vector<RegionPool::SizeClass> classes)
+{
+    sort(classes.begin(), classes.end(), [](const auto& a, const auto& b) { return a.slotSize < b.slotSize; });
+    return classes;
+}
+
+}   // namespace
+
+RegionPool::RegionPool(TransportFactory& factory, vector<SizeClass> sizeClasses, RegionConfig cfg)
+    : fTransport(factory)
+    , fClasses(sizeClasses.size())
+    , fNumSlots(0)
+    , fNumFree(0)
+    , fWaiters(0)
+    , fRegion(nullptr)
+{
+    if (sizeClasses.empty()) {
+        LOG(error) << "RegionPool: at least one size class is required";
+        throw RegionPoolError("RegionPool: at least one size class is required");
+    }
+    sizeClasses = SortedClasses(std::move(sizeClasses));
+
+    size_t offset = 0;
+    for (size_t i = 0; i < sizeClasses.size(); ++i) {
+        const SizeClass& sc = sizeClasses[i];
+        if (sc.slotSize == 0 || sc.numSlots == 0 || sc.numSlots >= kEmpty) {
+            LOG(error) << "RegionPool: invalid size class (slot size: " << sc.slotSize << ", slots: " << sc.numSlots << ")";
+            throw RegionPoolError(tools::ToString("RegionPool: invalid size class (slot size: ", sc.slotSize, ", slots: ", sc.numSlots, ")"));
+        }
+        Class& c = fClasses[i];
+        c.fSlotSize = sc.slotSize;
+        c.fStride = ((sc.slotSize + kSlotAlignment - 1) / kSlotAlignment) * kSlotAlignment;
+        c.fOffset = offset;
+        c.fNumSlots = sc.numSlots;
+        c.fNext = make_unique<atomic<uint32_t>[]>(sc.numSlots);
+        // all slots free, in ascending order
+        for (size_t s = 0; s < sc.numSlots; ++s) {
+            c.fNext[s].store(s + 1 < sc.numSlots ? static_cast<uint32_t>(s + 1) : kEmpty, memory_order_relaxed);
+        }
+        c.fHead.store(0, memory_order_relaxed);
+        offset += c.fStride * sc.numSlots;
+        fNumSlots += sc.numSlots;
+    }
+    fNumFree = fNumSlots;
+
+    fRegion = fTransport.CreateUnmanagedRegion(offset, RegionBulkCallback([this](const vector<RegionBlock>& blocks) { OnAcks(blocks); }), std::move(cfg));
+}
+
+RegionPool::~RegionPool()
+{
+    // destroy the region (and its ack threads) before the free lists
+    fRegion.reset();
+}
+
+uint32_t RegionPool::Acquire(Class& c)
+{
+    uint64_t head = c.fHead.load(memory_order_acquire);
+    while (true) {
+        uint32_t slot = static_cast<uint32_t>(head);
+        if (slot == kEmpty) {
+            return kEmpty;
+        }
+        uint64_t next = ((head >> 32) + 1) << 32 | c.fNext[slot].load(memory_order_relaxed);
+        if (c.fHead.compare_exchange_weak(head, next, memory_order_acquire, memory_order_acquire)) {
+            fNumFree.fetch_sub(1, memory_order_relaxed);
+            return slot;
+        }
+    }
+}
+
+void RegionPool::Release(Class& c, uint32_t slot)
+{
+    uint64_t head = c.fHead.load(memory_order_relaxed);
+    while (true) {
+        c.fNext[slot].store(static_cast<uint32_t>(head), memory_order_relaxed);
+        uint64_t next = ((head >> 32) + 1) << 32 | slot;
+        if (c.fHead.compare_exchange_weak(head, next, memory_order_release, memory_order_relaxed)) {
+            fNumFree.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+MessagePtr RegionPool::TryNewMessage(size_t size)
+{
+    for (size_t i = 0; i < fClasses.size(); ++i) {
+        Class& c = fClasses[i];
+        if (c.fSlotSize < size) {
+            continue;
+        }
+        uint32_t slot = Acquire(c);
+        if (slot != kEmpty) {
+            char* ptr = static_cast<char*>(fRegion->GetData()) + c.fOffset + slot * c.fStride;
+            // the hint identifies the slot when it is acknowledged
+            void* hint = reinterpret_cast<void*>((static_cast<uintptr_t>(i) << 32) | slot);
+            return fTransport.CreateMessage(fRegion, ptr, size, hint);
+        }
+    }
+    return nullptr;
+}
+
+MessagePtr RegionPool::NewMessage(size_t size, int timeoutMs)
+{
+    if (size > GetMaxMessageSize()) {
+        LOG(error) << "RegionPool: requested message size " << size << " exceeds the largest slot size " << GetMaxMessageSize();
+        throw RegionPoolError(tools::ToString("RegionPool: requested message size ", size, " exceeds the largest slot size ", GetMaxMessageSize()));
+    }
+    MessagePtr msg = TryNewMessage(size);
+    if (msg || timeoutMs == 0) {
+        return msg;
+    }
+
+    fWaiters.fetch_add(1);
+    {
+        unique_lock<mutex> lock(fWaitMtx);
+        auto ready = [&]() { return (msg = TryNewMessage(size)) != nullptr; };
+        if (timeoutMs < 0) {
+            fWaitCV.wait(lock, ready);
+        } else {
+            fWaitCV.wait_for(lock, chrono::milliseconds(timeoutMs), ready);
+        }
+    }
+    fWaiters.fetch_sub(1);
+    return msg;
+}
+
+void RegionPool::OnAcks(const vector<RegionBlock>& blocks)
+{
+    for (const auto& block : blocks) {
+        auto hint = reinterpret_cast<uintptr_t>(block.hint);
+        size_t c = hint >> 32;
+        uint32_t slot = static_cast<uint32_t>(hint);
+        if (c < fClasses.size() && slot < fClasses[c].fNumSlots) {
+            Release(fClasses[c], slot);
+        } else {
+            LOG(error) << "RegionPool: received an acknowledgement for an unknown slot (hint: " << block.hint << ")";
+        }
+    }
+    if (fWaiters.load() > 0) {
+        // lock to not miss a waiter that is between its check and the wait
+        { lock_guard<mutex> lock(fWaitMtx); }
+        fWaitCV.notify_all();
+    }
+}
+
+}   // namespace fair::mq
@@ -0,0 +1,109 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_REGIONPOOL_H
+#define FAIR_MQ_REGIONPOOL_H
+
+#include <fairmq/Message.h>
+#include <fairmq/UnmanagedRegion.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace fair::mq {
+
+class TransportFactory;
+
+/// Pool of fixed-size buffers on top of an unmanaged region. The region is carved into slots of one or several
+/// size classes. Messages are created from free slots and the slots are recycled automatically when the transport
+/// acknowledges their release (via the region bulk callback). Acquiring and releasing slots is lock-free.
+/// Create it via TransportFactory::CreateRegionPool().
+class RegionPool
+{
+  public:
+    struct SizeClass
+    {
+        size_t slotSize;
+        size_t numSlots;
+    };
+
+    /// @param factory transport to create the region and the messages with, has to outlive the pool
+    /// @param sizeClasses slot sizes and counts, slots are aligned to 64 bytes
+    /// @param cfg configuration of the underlying region
+    RegionPool(TransportFactory& factory, std::vector<SizeClass> sizeClasses, RegionConfig cfg = RegionConfig());
+
+    RegionPool(const RegionPool&) = delete;
+    RegionPool(RegionPool&&) = delete;
+    RegionPool& operator=(const RegionPool&) = delete;
+    RegionPool& operator=(RegionPool&&) = delete;
+
+    ~RegionPool();
+
+    /// @brief Create a message in a free slot of the smallest size class that fits size
+    /// @param size message size
+    /// @param timeoutMs time to wait for a free slot if none is available (0: do not wait, -1: wait forever)
+    /// @return message, nullptr if no slot was available in time
+    MessagePtr NewMessage(size_t size, int timeoutMs = 0);
+
+    /// Number of currently free slots (of all size classes)
+    size_t GetNumFreeSlots() const { return fNumFree.load(); }
+    /// Total number of slots
+    size_t GetNumSlots() const { return fNumSlots; }
+    /// Largest message size the pool can provide
+    size_t GetMaxMessageSize() const { return fClasses.empty() ? 0 : fClasses.back().fSlotSize; }
+
+    UnmanagedRegionPtr& GetRegion() { return fRegion; }
+    /// Transport the pool creates its messages with
+    TransportFactory& GetTransport() { return fTransport; }
+
+  private:
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+    static constexpr size_t kSlotAlignment = 64;
+
+    // Treiber stack of free slot indices, the head carries an ABA tag in its upper 32 bits
+    struct Class
+    {
+        size_t fSlotSize;
+        size_t fStride;
+        size_t fOffset;
+        size_t fNumSlots;
+        std::unique_ptr<std::atomic<uint32_t>[]> fNext;
+        std::atomic<uint64_t> fHead;
+    };
+
+    uint32_t Acquire(Class& c);
+    void Release(Class& c, uint32_t slot);
+    MessagePtr TryNewMessage(size_t size);
+    void OnAcks(const std::vector<RegionBlock>& blocks);
+
+    TransportFactory& fTransport;
+    std::vector<Class> fClasses;
+    size_t fNumSlots;
+    std::atomic<size_t> fNumFree;
+    std::mutex fWaitMtx;
+    std::condition_variable fWaitCV;
+    std::atomic<int> fWaiters;
+    UnmanagedRegionPtr fRegion; // last: destroyed first, the region callback accesses the members above
+};
+
+using RegionPoolPtr = std::unique_ptr<RegionPool>;
+
+struct RegionPoolError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+}   // namespace fair::mq
+
+#endif   // FAIR_MQ_REGIONPOOL_H
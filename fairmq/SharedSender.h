@@ -0,0 +1,272 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHAREDSENDER_H
+#define FAIR_MQ_SHAREDSENDER_H
+
+#include <fairmq/Message.h>
+#include <fairmq/Parts.h>
+#include <fairmq/Socket.h> // TransferCode
+
+#include <fairlogger/Logger.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility> // move
+#include <vector>
+
+namespace fair::mq
+{
+
+/// Send path of a channel with the sharedSend property: any thread may call Send(), the messages go through a bounded
+/// multi-producer/single-consumer queue (sequence-numbered cells of a Vyukov queue, a push is a single CAS) to a sender
+/// thread, which is the only one that uses the socket. The messages of one producer thread keep their order.
+class SharedSender
+{
+  public:
+    /// sends one queued message (as MessagePtr if single), waiting at most timeoutMs. Returns as Channel::Send()
+    using SendFunction = std::function<int64_t(Parts& parts, bool single, int timeoutMs)>;
+
+    SharedSender(std::string name, size_t capacity, SendFunction send)
+        : fName(std::move(name))
+        , fCapacity(RoundUpPow2(capacity))
+        , fCells(std::make_unique<Cell[]>(fCapacity))
+        , fEnqueuePos(0)
+        , fDequeuePos(0)
+        , fSend(std::move(send))
+    {
+        for (size_t i = 0; i < fCapacity; ++i) {
+            fCells[i].fSeq.store(i, std::memory_order_relaxed);
+        }
+        fThread = std::thread(&SharedSender::Run, this);
+    }
+
+    SharedSender(const SharedSender&) = delete;
+    SharedSender(SharedSender&&) = delete;
+    SharedSender& operator=(const SharedSender&) = delete;
+    SharedSender& operator=(SharedSender&&) = delete;
+
+    /// stops the sender thread, messages that are still queued are discarded
+    ~SharedSender()
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            fStop = true;
+        }
+        fSenderCV.notify_one();
+        fSpaceCV.notify_all();
+        fThread.join();
+    }
+
+    /// queue the message(s) for the sender thread, waiting up to timeoutMs (-1: no limit) while the queue is full.
+    /// The messages are moved out on success only.
+    /// @return number of bytes queued, TransferCode::timeout if the queue stayed full, TransferCode::interrupted if the
+    /// sender is stopping
+    int64_t Push(MessagePtr& msg, int timeoutMs)
+    {
+        Parts parts;
+        parts.AddPart(std::move(msg));
+        int64_t result = Push(parts, true, timeoutMs);
+        if (result < 0) {
+            msg = std::move(parts.fParts.front());
+        }
+        return result;
+    }
+    int64_t Push(std::vector<MessagePtr>& msgs, int timeoutMs)
+    {
+        Parts parts;
+        parts.fParts = std::move(msgs);
+        int64_t result = Push(parts, false, timeoutMs);
+        if (result < 0) {
+            msgs = std::move(parts.fParts);
+        }
+        return result;
+    }
+    int64_t Push(Parts& parts, int timeoutMs) { return Push(parts, false, timeoutMs); }
+
+    size_t GetNumQueued() const { return fEnqueuePos.load(std::memory_order_relaxed) - fDequeuePos.load(std::memory_order_relaxed); }
+    /// messages the sender thread could not send (error, or discarded at stop)
+    uint64_t GetNumFailed() const { return fFailed.load(std::memory_order_relaxed); }
+
+  private:
+    struct Cell
+    {
+        std::atomic<size_t> fSeq;
+        Parts fParts;
+        bool fSingle = false;
+    };
+
+    static size_t RoundUpPow2(size_t n)
+    {
+        size_t pow2 = 2;
+        while (pow2 < n) {
+            pow2 *= 2;
+        }
+        return pow2;
+    }
+
+    // a full queue retries until the deadline, woken up by the sender thread when it frees a cell
+    int64_t Push(Parts& parts, bool single, int timeoutMs)
+    {
+        int64_t bytes = 0;
+        for (const auto& part : parts) {
+            bytes += static_cast<int64_t>(part->GetSize());
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (!TryPush(parts, single)) {
+            std::unique_lock<std::mutex> lock(fMtx);
+            if (fStop) {
+                return static_cast<int64_t>(TransferCode::interrupted);
+            }
+            if (timeoutMs == 0 || (timeoutMs > 0 && std::chrono::steady_clock::now() >= deadline)) {
+                return static_cast<int64_t>(TransferCode::timeout);
+            }
+            ++fWaitingProducers;
+            // bounded, a cell freed between the failed push and the wait does not notify
+            fSpaceCV.wait_for(lock, std::chrono::milliseconds(1));
+            --fWaitingProducers;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (fSenderIdle.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(fMtx);
+            fSenderCV.notify_one();
+        }
+        return bytes;
+    }
+
+    bool TryPush(Parts& parts, bool single)
+    {
+        size_t pos = fEnqueuePos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &fCells[pos & (fCapacity - 1)];
+            const size_t seq = cell->fSeq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (fEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = fEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->fParts = std::move(parts);
+        cell->fSingle = single;
+        cell->fSeq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(Parts& parts, bool& single)
+    {
+        const size_t pos = fDequeuePos.load(std::memory_order_relaxed);
+        Cell& cell = fCells[pos & (fCapacity - 1)];
+        if (cell.fSeq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        parts = std::move(cell.fParts);
+        single = cell.fSingle;
+        cell.fSeq.store(pos + fCapacity, std::memory_order_release);
+        fDequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Run()
+    {
+        Parts parts;
+        bool single = false;
+        while (true) {
+            if (!TryPop(parts, single)) {
+                std::unique_lock<std::mutex> lock(fMtx);
+                if (fStop) {
+                    break;
+                }
+                fSenderIdle.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence of Push()
+                if (!TryPop(parts, single)) {
+                    fSenderCV.wait_for(lock, std::chrono::milliseconds(100));
+                    fSenderIdle.store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                fSenderIdle.store(false, std::memory_order_relaxed);
+            }
+            {
+                std::lock_guard<std::mutex> lock(fMtx);
+                if (fWaitingProducers > 0) {
+                    fSpaceCV.notify_all();
+                }
+            }
+            Send(parts, single);
+            parts.fParts.clear();
+        }
+
+        uint64_t discarded = 0;
+        while (TryPop(parts, single)) {
+            ++discarded;
+        }
+        if (discarded > 0) {
+            fFailed.fetch_add(discarded, std::memory_order_relaxed);
+            LOG(warn) << "channel " << fName << ": discarded " << discarded << " queued messages of the shared sender";
+        }
+    }
+
+    // retries in short slices, so that a stop does not wait for the send timeout. Interrupted transfers (device state
+    // changes) are retried until the transport resumes
+    void Send(Parts& parts, bool single)
+    {
+        while (true) {
+            const int64_t result = fSend(parts, single, 100);
+            if (result >= 0) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(fMtx);
+                if (fStop) {
+                    fFailed.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            if (result == static_cast<int64_t>(TransferCode::interrupted)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            } else if (result != static_cast<int64_t>(TransferCode::timeout)) {
+                fFailed.fetch_add(1, std::memory_order_relaxed);
+                LOG(error) << "channel " << fName << ": shared sender failed to send a message";
+                return;
+            }
+        }
+    }
+
+    const std::string fName;
+    const size_t fCapacity;
+    std::unique_ptr<Cell[]> fCells;
+    alignas(64) std::atomic<size_t> fEnqueuePos;
+    alignas(64) std::atomic<size_t> fDequeuePos;
+    SendFunction fSend;
+    std::atomic<uint64_t> fFailed{0};
+
+    std::mutex fMtx;
+    std::condition_variable fSenderCV; // the sender thread waits for messages
+    std::condition_variable fSpaceCV;  // producers wait for a free cell
+    std::atomic<bool> fSenderIdle{false};
+    int fWaitingProducers = 0;
+    bool fStop = false;
+    std::thread fThread;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_SHAREDSENDER_H */
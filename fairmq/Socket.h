@@ -9,9 +9,12 @@
 #ifndef FAIR_MQ_SOCKET_H
 #define FAIR_MQ_SOCKET_H
 
+#include <fairmq/ChannelMetrics.h>
 #include <fairmq/Message.h>
 #include <fairmq/Parts.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -22,6 +25,11 @@ namespace fair::mq {
 
 class TransportFactory;
 
+/// Called during a chunked receive (see Socket::SetChunkSize) for every chunk that has been placed in a part
+/// @param part the part that is being assembled, only the bytes [offset, offset + size) of the chunk are final
+/// @param partIndex index of the part in the (multipart) message
+using ChunkCallback = std::function<void(const Message& part, size_t partIndex, size_t offset, size_t size)>;
+
 enum class TransferCode : int
 {
     success = 0,
@@ -30,6 +38,39 @@ enum class TransferCode : int
     interrupted = -3
 };
 
+/// Transfer statistics counter of a socket (bytes/messages sent/received).
+/// Only the thread using the socket increments it, so an increment is a relaxed load and store instead of an atomic
+/// read-modify-write (no locked instruction on the hot path), while other threads (e.g. rate logging) can read it at any time.
+/// Building with FAIRMQ_DISABLE_SOCKET_COUNTERS removes the accounting completely, the counters then always read 0.
+class TransferCounter
+{
+  public:
+    TransferCounter(unsigned long value = 0)
+#ifndef FAIRMQ_DISABLE_SOCKET_COUNTERS
+        : fValue(value)
+#endif
+    {
+        (void)value;
+    }
+    TransferCounter(const TransferCounter&) = delete;
+    TransferCounter& operator=(const TransferCounter&) = delete;
+
+#ifdef FAIRMQ_DISABLE_SOCKET_COUNTERS
+    void operator+=(unsigned long) {}
+    void operator++() {}
+    void operator++(int) {}
+    operator unsigned long() const { return 0; }
+#else
+    void operator+=(unsigned long n) { fValue.store(fValue.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void operator++() { *this += 1; }
+    void operator++(int) { *this += 1; }
+    operator unsigned long() const { return fValue.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<unsigned long> fValue;
+#endif
+};
+
 template <typename T>
 struct is_transferrable : std::disjunction<std::is_same<T, MessagePtr>,
                                            std::is_same<T, std::vector<MessagePtr>>,
@@ -49,6 +90,9 @@ struct Socket
 
     virtual bool Bind(const std::string& address) = 0;
     virtual bool Connect(const std::string& address) = 0;
+    /// Address of the last successful Bind(), with the port chosen by the kernel for tcp://<host>:* addresses
+    /// @return empty if not supported by the transport (then tcp://<host>:* addresses are not supported either)
+    virtual std::string GetBoundAddress() const { return ""; }
 
     virtual int64_t Send(MessagePtr& msg, int timeout = -1) = 0;
     virtual int64_t Receive(MessagePtr& msg, int timeout = -1) = 0;
@@ -77,6 +121,49 @@ struct Socket
     virtual int GetSndKernelSize() const = 0;
     virtual void SetRcvKernelSize(int value) = 0;
     virtual int GetRcvKernelSize() const = 0;
+    /// Receive mode: "block" (wait in the kernel), "spin" (busy-poll) or "hybrid" (busy-poll for spinUs microseconds, then block).
+    /// Transports that do not support busy-polling ignore it.
+    virtual void SetRcvMode(const std::string& /* mode */, int /* spinUs */) {}
+    /// CPU time (in microseconds) spent busy-polling in Receive
+    virtual unsigned long GetRcvSpinTime() const { return 0; }
+    /// Coalesce up to size consecutive single-part sends into one transfer, flushed at the latest after timeoutUs microseconds.
+    /// Transports that do not support send batching ignore it.
+    virtual void SetSndBatch(int /* size */, int /* timeoutUs */) {}
+    /// Adapt the batch size (up to the one of SetSndBatch(), if set) and timeout to the message rate, so that batched
+    /// messages wait at most targetUs microseconds (see BatchController), 0 to go back to the fixed ones.
+    /// Transports that do not support send batching ignore it.
+    virtual void SetSndBatchLatencyTarget(int /* targetUs */) {}
+    /// Wire format of the transfer meta data: "default" or "compact" (variable length encoding).
+    /// Transports without transfer meta data ignore it.
+    virtual void SetMetaFormat(const std::string& /* format */) {}
+    /// Pack the parts of multipart messages of up to maxPartSize bytes into one frame, both peers have to enable it.
+    /// Transports that send multipart messages in one transfer anyway ignore it.
+    virtual void SetPackParts(int /* maxPartSize */) {}
+    /// Transfer the trace context of the messages (see Message::GetTraceContext). The zeromq transport sends it
+    /// in a prefix frame, so both peers have to enable it.
+    virtual void SetTrace(bool /* enable */) {}
+    /// Compress payloads of at least minSize bytes with the codec ("lz4" or "zstd", level 0: codec default) on the
+    /// given number of threads, both peers have to enable it. Transports that do not support compression ignore it.
+    virtual void SetCompression(const std::string& /* codec */, int /* level */, int /* threads */, int /* minSize */) {}
+    /// Stream parts larger than chunkSize bytes in chunks of chunkSize bytes, each one a transfer of its own, and assemble
+    /// them in a buffer allocated by the receiver, both peers have to enable it. Transports that send large parts without
+    /// buffering them in full anyway ignore it.
+    virtual void SetChunkSize(int /* chunkSize */) {}
+    /// Transport to allocate the assembly buffers of chunked transfers with (nullptr: the transport of the socket)
+    virtual void SetChunkTarget(TransportFactory* /* target */) {}
+    /// Callback for every received chunk of a chunked transfer (empty: none)
+    virtual void SetChunkCallback(ChunkCallback /* callback */) {}
+    /// Adds the compression statistics to the metrics, if the socket compresses
+    virtual void GetCompressionMetrics(ChannelMetrics& /* metrics */) const {}
+    /// Send copies (see Message::Copy) of numMsgs messages (as one multipart message if numMsgs > 1), the messages remain valid.
+    /// @param result as returned by Send()
+    /// @return false if not supported by the transport, then the caller sends copies created with Message::Copy()
+    virtual bool SendCopy(const MessagePtr* /* msgs */, size_t /* numMsgs */, int /* timeout */, int64_t& /* result */) { return false; }
+    /// Move the next (multipart) message to out, a socket of the same transport, without creating message objects.
+    /// @param timeout receive timeout, a received message is sent with retries until it is queued or the transfer is interrupted
+    /// @param result as returned by Receive()
+    /// @return false if not supported for this pair of sockets, then the caller receives and sends the message
+    virtual bool Forward(Socket& /* out */, int /* timeout */, int64_t& /* result */) { return false; }
 
     virtual unsigned long GetBytesTx() const = 0;
     virtual unsigned long GetBytesRx() const = 0;
@@ -84,6 +171,14 @@ struct Socket
     virtual unsigned long GetMessagesRx() const = 0;
 
     virtual unsigned long GetNumberOfConnectedPeers() const = 0;
+    /// Largest smoothed round-trip time (in microseconds) of the tcp connections of the socket, can be called from any thread
+    /// @return -1 if unknown (no tcp connections, or not supported by the transport)
+    virtual int GetRttUs() const { return -1; }
+    /// Number of messages queued between the socket and its peers (in both directions), as far as the transport can
+    /// see them, can be called from any thread
+    /// @param exact set to whether the depth is counted (true) or estimated (false)
+    /// @return -1 if unknown
+    virtual int64_t GetQueueDepth(bool& exact) const { exact = false; return -1; }
 
     TransportFactory* GetTransport() { return fTransport; }
     void SetTransport(TransportFactory* transport) { fTransport = transport; }
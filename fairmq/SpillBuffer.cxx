@@ -0,0 +1,279 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairlogger/Logger.h>
+#include <fairmq/SpillBuffer.h>
+#include <fairmq/Tools.h>
+#include <fairmq/TransportFactory.h>
+
+#ifdef BUILD_URING_TRANSPORT
+#include <fairmq/uring/Common.h>
+#endif
+
+#include <fcntl.h>    // open, O_DIRECT
+#include <sys/uio.h>  // iovec
+#include <unistd.h>   // close, pread, pwrite, unlink
+
+#include <algorithm>  // max
+#include <cerrno>
+#include <cstring>    // memcpy, strerror
+#include <stdexcept>
+
+using namespace std;
+
+namespace fair::mq {
+
+namespace {
+
+// alignment of buffers, offsets and sizes for O_DIRECT (logical block size of common devices)
+constexpr size_t kDirectAlignment = 4096;
+
+uint64_t AlignUp(uint64_t size) { return (size + kDirectAlignment - 1) / kDirectAlignment * kDirectAlignment; }
+
+}   // namespace
+
+void SpillBuffer::RingDeleter::operator()([[maybe_unused]] uring::Ring* ring) const
+{
+#ifdef BUILD_URING_TRANSPORT
+    delete ring;
+#endif
+}
+
+SpillBuffer::SpillBuffer(SpillBufferConfig cfg)
+    : fConfig(std::move(cfg))
+{
+    if (fConfig.filename.empty()) {
+        throw runtime_error("SpillBuffer: no file name given");
+    }
+    fConfig.capacity = max<uint64_t>(fConfig.capacity / kDirectAlignment * kDirectAlignment, kDirectAlignment);
+
+    const int flags = O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC;
+    fFd = fConfig.direct ? open(fConfig.filename.c_str(), flags | O_DIRECT, 0600) : -1;
+    if (fFd < 0) {
+        if (fConfig.direct) {
+            // e.g. tmpfs
+            LOG(debug) << "SpillBuffer: " << fConfig.filename << " does not support O_DIRECT (" << strerror(errno) << "), using buffered I/O";
+        }
+        fFd = open(fConfig.filename.c_str(), flags, 0600);
+    }
+    if (fFd < 0) {
+        LOG(error) << "Could not open spill file '" << fConfig.filename << "': " << strerror(errno);
+        throw runtime_error(tools::ToString("Could not open spill file '", fConfig.filename, "': ", strerror(errno)));
+    }
+
+    if (fConfig.uring) {
+#ifdef BUILD_URING_TRANSPORT
+        try {
+            fRing.reset(new uring::Ring(4));
+        } catch (uring::UringError& e) {
+            LOG(debug) << "SpillBuffer: io_uring not available (" << e.what() << "), writing with pwrite";
+        }
+#endif
+    }
+
+    fThread = thread(&SpillBuffer::Loop, this);
+}
+
+SpillBuffer::~SpillBuffer()
+{
+    {
+        lock_guard<mutex> lock(fMtx);
+        fStop = true;
+    }
+    fCV.notify_one();
+    fThread.join();
+    if (!fRecords.empty()) {
+        LOG(warn) << "SpillBuffer: discarding " << fRecords.size() << " spilled messages of " << fConfig.filename;
+    }
+    close(fFd);
+    unlink(fConfig.filename.c_str());
+}
+
+bool SpillBuffer::Push(const Parts& parts, bool single)
+{
+    Record record{0, 0, {}, single, nullptr, Record::State::queued};
+    uint64_t size = 0;
+    for (const auto& part : parts) {
+        record.fSizes.push_back(part->GetSize());
+        size += part->GetSize();
+    }
+    record.fSpan = AlignUp(max<uint64_t>(size, 1));
+    if (record.fSpan > fConfig.capacity) {
+        return false;
+    }
+
+    {
+        // the writer thread does not move the head, a reservation checked here still holds after the copy
+        lock_guard<mutex> lock(fMtx);
+        if (fQueuedBytes + record.fSpan > fConfig.maxQueuedBytes) {
+            return false;
+        }
+        // a record does not wrap around, the rest of the file is skipped
+        record.fStart = fHead;
+        const uint64_t pos = fHead % fConfig.capacity;
+        if (pos + record.fSpan > fConfig.capacity) {
+            record.fStart += fConfig.capacity - pos;
+        }
+        const uint64_t tail = fRecords.empty() ? fHead : fRecords.front().fStart;
+        if (record.fStart + record.fSpan - tail > fConfig.capacity) {
+            return false;
+        }
+    }
+
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, kDirectAlignment, record.fSpan) != 0) {
+        return false;
+    }
+    record.fData.reset(static_cast<char*>(ptr));
+    char* data = record.fData.get();
+    for (const auto& part : parts) {
+        memcpy(data, part->GetData(), part->GetSize());
+        data += part->GetSize();
+    }
+
+    {
+        lock_guard<mutex> lock(fMtx);
+        fQueuedBytes += record.fSpan;
+        fHead = record.fStart + record.fSpan;
+        fRecords.push_back(std::move(record));
+    }
+    fMessagesSpilled.fetch_add(1, memory_order_relaxed);
+    fCV.notify_one();
+    return true;
+}
+
+bool SpillBuffer::Pop(Parts& parts, bool& single, TransportFactory& transport)
+{
+    unique_lock<mutex> lock(fMtx);
+    if (fRecords.empty() || fRecords.front().fState == Record::State::writing) {
+        return false;
+    }
+    Record& front = fRecords.front();
+    unique_ptr<char, FreeDeleter> data(std::move(front.fData));
+    if (data) {
+        fQueuedBytes -= front.fSpan;
+    } else {
+        // written, the ring space stays reserved until the record is removed below
+        lock.unlock();
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, kDirectAlignment, front.fSpan) != 0) {
+            return false;
+        }
+        data.reset(static_cast<char*>(ptr));
+        const bool read = Read(data.get(), front.fSpan, front.fStart % fConfig.capacity);
+        lock.lock();
+        if (!read) {
+            fRecords.pop_front();
+            if (fNextWrite > 0) {
+                --fNextWrite;
+            }
+            return false;
+        }
+    }
+    Record record(std::move(front));
+    fRecords.pop_front();
+    if (fNextWrite > 0) {
+        --fNextWrite;
+    }
+    lock.unlock();
+
+    const char* src = data.get();
+    for (size_t size : record.fSizes) {
+        MessagePtr msg(transport.CreateMessage(size));
+        memcpy(msg->GetData(), src, size);
+        src += size;
+        parts.AddPart(std::move(msg));
+    }
+    single = record.fSingle;
+    return true;
+}
+
+size_t SpillBuffer::GetNumSpilled() const
+{
+    lock_guard<mutex> lock(fMtx);
+    return fRecords.size();
+}
+
+void SpillBuffer::Loop()
+{
+    unique_lock<mutex> lock(fMtx);
+    while (true) {
+        fCV.wait(lock, [&]() { return fStop || fNextWrite < fRecords.size(); });
+        if (fStop) {
+            return;
+        }
+        // the record stays in place while it is written, Pop() skips it and Push() only appends
+        Record& record = fRecords[fNextWrite];
+        record.fState = Record::State::writing;
+        const char* data = record.fData.get();
+        lock.unlock();
+        const bool written = Write(data, record.fSpan, record.fStart % fConfig.capacity);
+        lock.lock();
+        record.fState = Record::State::written;
+        ++fNextWrite;
+        if (written) {
+            fQueuedBytes -= record.fSpan;
+            record.fData.reset();
+        }
+    }
+}
+
+bool SpillBuffer::Write(const char* data, uint64_t span, uint64_t offset)
+{
+    uint64_t done = 0;
+#ifdef BUILD_URING_TRANSPORT
+    if (fRing) {
+        iovec iov{const_cast<char*>(data), span};
+        io_uring_sqe* sqe = fRing->GetSqe();
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fFd;
+        sqe->addr = reinterpret_cast<uint64_t>(&iov);
+        sqe->len = 1;
+        sqe->off = offset;
+        fRing->Submit();
+        io_uring_cqe cqe{};
+        fRing->Wait(cqe);
+        if (cqe.res < 0) {
+            LOG(error) << "SpillBuffer: writing to " << fConfig.filename << " failed: " << strerror(-cqe.res) << ", keeping the message in memory";
+            return false;
+        }
+        done = static_cast<uint64_t>(cqe.res);
+    }
+#endif
+    while (done < span) {
+        ssize_t n = pwrite(fFd, data + done, span - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            LOG(error) << "SpillBuffer: writing to " << fConfig.filename << " failed: " << strerror(errno) << ", keeping the message in memory";
+            return false;
+        }
+        done += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool SpillBuffer::Read(char* data, uint64_t span, uint64_t offset)
+{
+    uint64_t done = 0;
+    while (done < span) {
+        ssize_t n = pread(fFd, data + done, span - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            LOG(error) << "SpillBuffer: reading from " << fConfig.filename << " failed: " << (n < 0 ? strerror(errno) : "end of file") << ", discarding the message";
+            return false;
+        }
+        done += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+}   // namespace fair::mq
@@ -0,0 +1,110 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SPILLBUFFER_H
+#define FAIR_MQ_SPILLBUFFER_H
+
+#include <fairmq/Parts.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <cstdlib>   // free
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fair::mq {
+
+class TransportFactory;
+namespace uring { class Ring; }
+
+struct SpillBufferConfig
+{
+    std::string filename;
+    uint64_t capacity = 1ULL << 30;     // size of the ring file, messages that do not fit any more are rejected
+    size_t maxQueuedBytes = 64 << 20;   // spilled bytes not yet written, more are rejected
+    bool direct = true;                 // O_DIRECT (buffered I/O if the file system does not support it)
+    bool uring = true;                  // write via io_uring (only if built with BUILD_URING_TRANSPORT), otherwise pwrite
+};
+
+/// Ring file on local storage (e.g. NVMe) for the messages that a channel cannot send right away (overflow policy
+/// "spill"): they are copied out and release their transport memory (region or segment), and are given back in order
+/// once the channel drains. Push() copies the parts into an aligned buffer that a writer thread writes to the file,
+/// Pop() reads the oldest message back into new messages (from memory if it has not been written yet).
+/// Push() and Pop() are called by the thread using the channel. A failed write keeps the message in memory, a failed
+/// read discards it.
+/// The file is scratch space, it is removed with the buffer.
+class SpillBuffer
+{
+  public:
+    /// @throw std::runtime_error if the file cannot be created
+    explicit SpillBuffer(SpillBufferConfig cfg);
+
+    SpillBuffer(const SpillBuffer&) = delete;
+    SpillBuffer(SpillBuffer&&) = delete;
+    SpillBuffer& operator=(const SpillBuffer&) = delete;
+    SpillBuffer& operator=(SpillBuffer&&) = delete;
+
+    /// stops the writer thread and removes the file, messages still spilled are discarded
+    ~SpillBuffer();
+
+    /// @brief Spill a copy of the message (its parts stay untouched)
+    /// @return false if neither the file nor the write queue has room for it
+    bool Push(const Parts& parts, bool single);
+    /// @brief Take the oldest spilled message, as new messages of the transport
+    /// @return false if there is none, or it is being written right now
+    bool Pop(Parts& parts, bool& single, TransportFactory& transport);
+
+    /// number of messages in the buffer
+    size_t GetNumSpilled() const;
+    /// number of messages spilled so far
+    uint64_t GetMessagesSpilled() const { return fMessagesSpilled.load(std::memory_order_relaxed); }
+    const std::string& GetFilename() const { return fConfig.filename; }
+
+  private:
+    struct FreeDeleter { void operator()(char* ptr) const { free(ptr); } };
+    struct RingDeleter { void operator()(uring::Ring* ring) const; };
+
+    struct Record
+    {
+        enum class State { queued, writing, written };
+        uint64_t fStart;             // stream offset, the file position is fStart % capacity
+        uint64_t fSpan;              // aligned size in the file
+        std::vector<size_t> fSizes;  // of the parts, stored back to back
+        bool fSingle;
+        std::unique_ptr<char, FreeDeleter> fData;   // until written
+        State fState;
+    };
+
+    void Loop();
+    bool Write(const char* data, uint64_t span, uint64_t offset);
+    bool Read(char* data, uint64_t span, uint64_t offset);
+
+    SpillBufferConfig fConfig;
+    int fFd = -1;
+    std::unique_ptr<uring::Ring, RingDeleter> fRing;
+
+    mutable std::mutex fMtx;
+    std::condition_variable fCV;   // the writer thread waits for records
+    std::deque<Record> fRecords;   // oldest first
+    size_t fNextWrite = 0;         // index of the first queued record
+    uint64_t fHead = 0;            // stream offset behind the newest record
+    size_t fQueuedBytes = 0;       // held in memory
+    bool fStop = false;
+    std::atomic<uint64_t> fMessagesSpilled{0};
+    std::thread fThread;
+};
+
+}   // namespace fair::mq
+
+#endif /* FAIR_MQ_SPILLBUFFER_H */
@@ -0,0 +1,110 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/StartupProfile.h>
+
+#include <fairlogger/Logger.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+using namespace std;
+
+namespace fair::mq {
+
+namespace {
+
+struct Profile
+{
+    mutex mtx;
+    vector<StartupPhase> phases;
+    bool completed = false;
+};
+
+Profile& GetProfile()
+{
+    static Profile profile;
+    return profile;
+}
+
+// initialized when the library is loaded
+const chrono::steady_clock::time_point sOrigin = chrono::steady_clock::now();
+
+chrono::microseconds SinceOrigin(chrono::steady_clock::time_point t)
+{
+    return chrono::duration_cast<chrono::microseconds>(t - sOrigin);
+}
+
+} // namespace
+
+void StartupProfile::Add(const string& name, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end)
+{
+    Profile& profile = GetProfile();
+    lock_guard<mutex> lock(profile.mtx);
+    if (profile.completed) {
+        return;
+    }
+    auto duration = chrono::duration_cast<chrono::microseconds>(end - start);
+    auto phase = find_if(profile.phases.begin(), profile.phases.end(), [&](const StartupPhase& p) { return p.name == name; });
+    if (phase == profile.phases.end()) {
+        profile.phases.push_back(StartupPhase{name, SinceOrigin(start), duration, 1});
+    } else {
+        phase->duration += duration;
+        ++phase->count;
+    }
+}
+
+void StartupProfile::Complete()
+{
+    Profile& profile = GetProfile();
+    vector<StartupPhase> phases;
+    {
+        lock_guard<mutex> lock(profile.mtx);
+        if (profile.completed) {
+            return;
+        }
+        profile.phases.push_back(StartupPhase{"total", chrono::microseconds(0), SinceOrigin(chrono::steady_clock::now()), 1});
+        profile.completed = true;
+        phases = profile.phases;
+    }
+    LOG(info) << "startup profile: " << Format(phases);
+}
+
+bool StartupProfile::Completed()
+{
+    Profile& profile = GetProfile();
+    lock_guard<mutex> lock(profile.mtx);
+    return profile.completed;
+}
+
+vector<StartupPhase> StartupProfile::GetPhases()
+{
+    Profile& profile = GetProfile();
+    lock_guard<mutex> lock(profile.mtx);
+    return profile.phases;
+}
+
+string StartupProfile::Format(const vector<StartupPhase>& phases)
+{
+    ostringstream os;
+    os << fixed << setprecision(1);
+    for (const auto& phase : phases) {
+        if (&phase != &phases.front()) {
+            os << " ";
+        }
+        os << phase.name << "=" << double(phase.duration.count()) / 1000. << "ms";
+        if (phase.count > 1) {
+            os << "x" << phase.count;
+        }
+    }
+    return os.str();
+}
+
+} // namespace fair::mq
@@ -0,0 +1,64 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_STARTUPPROFILE_H
+#define FAIR_MQ_STARTUPPROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility> // move
+#include <vector>
+
+namespace fair::mq {
+
+/// Time spent in one initialization phase, summed over the times it was entered
+struct StartupPhase
+{
+    std::string name;
+    std::chrono::microseconds start;    ///< first entry, relative to the load of the library (~ process start)
+    std::chrono::microseconds duration; ///< summed over all entries
+    uint32_t count;                     ///< number of entries (e.g. channels attached)
+};
+
+/// Process wide record of the initialization phases (plugin loading, option parsing, transport creation, channel
+/// attachment, state handlers, ...), from the start of the process until the first device reaches READY.
+/// It is then completed (Complete()): the phases are logged in one line and no further phases are recorded.
+class StartupProfile
+{
+  public:
+    /// Records the lifetime of the object as one entry of the phase
+    class Scope
+    {
+      public:
+        explicit Scope(std::string name) : fName(std::move(name)), fStart(std::chrono::steady_clock::now()) {}
+        Scope(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope& operator=(Scope&&) = delete;
+        ~Scope() { StartupProfile::Add(fName, fStart, std::chrono::steady_clock::now()); }
+
+      private:
+        std::string fName;
+        std::chrono::steady_clock::time_point fStart;
+    };
+
+    static void Add(const std::string& name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+    /// Adds the "total" phase (until now), logs the profile and stops recording. Only the first call has an effect.
+    static void Complete();
+    static bool Completed();
+
+    /// @return the recorded phases, in the order they were first entered
+    static std::vector<StartupPhase> GetPhases();
+    /// @return the phases as "<name>=<ms>ms[x<count>] ...", the format of the logged line
+    static std::string Format(const std::vector<StartupPhase>& phases);
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_STARTUPPROFILE_H */
@@ -8,6 +8,8 @@
 
 #include <fairmq/StateMachine.h>
 #include <fairmq/tools/Exceptions.h>
+#include <fairmq/tools/Probes.h>
+#include <fairmq/tools/Strings.h>
 
 #include <fairlogger/Logger.h>
 
@@ -22,13 +24,16 @@
 #include <boost/msm/front/state_machine_def.hpp>
 #include <boost/msm/front/functor_row.hpp>
 #include <boost/core/demangle.hpp>
-#include <boost/signals2.hpp> // signal/slot for onStateChange callbacks
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <chrono>
-#include <unordered_map>
+#include <deque>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 using namespace std;
 using namespace boost::msm;
@@ -74,6 +79,199 @@ struct RESET_DEVICE_E  { static string Name() { return "RESET_DEVICE"; }  static
 struct END_E           { static string Name() { return "END"; }           static Transition Type() { return Transition::End; } };
 struct ERROR_FOUND_E   { static string Name() { return "ERROR_FOUND"; }   static Transition Type() { return Transition::ErrorFound; } };
 
+// Subscriber table for the state/transition callbacks: a fixed number of slots, each holding the key and the callback in
+// place. Emitting neither allocates nor locks: a call is registered in the state of the slot with a CAS (which fails once
+// the slot is removed) and released with a decrement. Only (un)subscribing takes the table lock, which is not held while
+// waiting for or calling back, so callbacks can (un)subscribe themselves.
+// There is at most one slot per key, subscribing with an existing key replaces its callback. Once Remove()/Clear()
+// returns, the removed callback is neither running on another thread nor called again. A callback that removes itself
+// keeps its slot until it returns, the slot is then freed by the emitting thread.
+template<typename T>
+class Callbacks
+{
+  public:
+    static constexpr size_t kMaxSubscribers = 64;
+
+    void Add(const string& key, function<void(const T)> callback)
+    {
+        Slot* replaced = nullptr;
+        {
+            lock_guard<mutex> lock(fMtx);
+            auto free = find_if(fSlots.begin(), fSlots.end(), [](const Slot& s) { return s.fState.load(memory_order_acquire) == 0; });
+            if (free == fSlots.end()) {
+                throw runtime_error(tools::ToString("Cannot subscribe '", key, "' to the state machine, all ", kMaxSubscribers, " subscriber slots are taken"));
+            }
+            replaced = Retire(key);
+            free->fKey = key;
+            free->fCallback = move(callback);
+            free->fState.store(kActive, memory_order_release);
+            const size_t used = static_cast<size_t>(free - fSlots.begin()) + 1;
+            if (used > fNumUsed.load(memory_order_relaxed)) {
+                fNumUsed.store(used, memory_order_release);
+            }
+        }
+        if (replaced) {
+            Drain(*replaced);
+        }
+    }
+
+    void Remove(const string& key)
+    {
+        Slot* removed = nullptr;
+        {
+            lock_guard<mutex> lock(fMtx);
+            removed = Retire(key);
+        }
+        if (removed) {
+            Drain(*removed);
+        }
+    }
+
+    void Clear()
+    {
+        vector<Slot*> removed;
+        {
+            lock_guard<mutex> lock(fMtx);
+            for (auto& slot : fSlots) {
+                if (slot.fState.load(memory_order_relaxed) & kActive) {
+                    slot.fState.fetch_xor(kActive | kRetired, memory_order_relaxed);
+                    removed.push_back(&slot);
+                }
+            }
+        }
+        for (Slot* slot : removed) {
+            Drain(*slot);
+        }
+    }
+
+    bool Empty() const
+    {
+        return none_of(fSlots.begin(), fSlots.end(), [](const Slot& s) { return s.fState.load(memory_order_relaxed) & kActive; });
+    }
+
+    void operator()(const T value) const
+    {
+        const size_t used = fNumUsed.load(memory_order_acquire);
+        for (size_t i = 0; i < used; ++i) {
+            Slot& slot = fSlots[i];
+            uint32_t state = slot.fState.load(memory_order_relaxed);
+            do {
+                if (!(state & kActive)) {
+                    break;
+                }
+            } while (!slot.fState.compare_exchange_weak(state, state + kCall, memory_order_acquire, memory_order_relaxed));
+            if (state & kActive) {
+                Call call(*this, slot);
+                slot.fCallback(value);
+            }
+        }
+    }
+
+  private:
+    // state of a slot: 0 if free, otherwise the flags and the number of calls in progress (in units of kCall)
+    static constexpr uint32_t kActive = 1;  // subscribed, new calls are allowed
+    static constexpr uint32_t kRetired = 2; // removed, waits for the calls in progress
+    static constexpr uint32_t kOrphan = 4;  // removed by its own callback, freed by the last call returning
+    static constexpr uint32_t kWaiting = 8; // a remover waits on fWaitCV for the calls to return
+    static constexpr uint32_t kCall = 16;
+
+    struct Slot
+    {
+        atomic<uint32_t> fState{0};
+        string fKey;
+        function<void(const T)> fCallback;
+    };
+
+    // registers the call of a slot on the calling thread (for nested emits, a callback may remove itself or its caller)
+    // and releases it when the callback returns or throws
+    class Call
+    {
+      public:
+        Call(const Callbacks& callbacks, Slot& slot)
+            : fCallbacks(callbacks)
+            , fSlot(slot)
+            , fPrev(tCurrent)
+        {
+            tCurrent = this;
+        }
+
+        Call(const Call&) = delete;
+        Call& operator=(const Call&) = delete;
+
+        ~Call()
+        {
+            tCurrent = fPrev;
+            const uint32_t prev = fSlot.fState.fetch_sub(kCall, memory_order_acq_rel);
+            if (prev & kWaiting) {
+                lock_guard<mutex> lock(fCallbacks.fWaitMtx);
+                fCallbacks.fWaitCV.notify_all();
+            }
+            if ((prev & kOrphan) && prev / kCall == 1) {
+                Free(fSlot);
+            }
+        }
+
+        // number of calls of the slot in progress on this thread
+        static uint32_t Own(const Slot& slot)
+        {
+            uint32_t n = 0;
+            for (const Call* c = tCurrent; c; c = c->fPrev) {
+                n += (&c->fSlot == &slot) ? 1 : 0;
+            }
+            return n;
+        }
+
+      private:
+        const Callbacks& fCallbacks;
+        Slot& fSlot;
+        const Call* fPrev;
+        static thread_local const Call* tCurrent;
+    };
+
+    // takes the slot of the key out of use, expects fMtx to be held. @return the slot, nullptr if the key is not subscribed
+    Slot* Retire(const string& key)
+    {
+        auto it = find_if(fSlots.begin(), fSlots.end(), [&](const Slot& s) { return (s.fState.load(memory_order_relaxed) & kActive) && s.fKey == key; });
+        if (it == fSlots.end()) {
+            return nullptr;
+        }
+        it->fState.fetch_xor(kActive | kRetired, memory_order_relaxed);
+        return &*it;
+    }
+
+    // waits for the calls of a retired slot on other threads, frees the slot unless it is still called on this one
+    void Drain(Slot& slot)
+    {
+        const uint32_t own = Call::Own(slot);
+        if (slot.fState.load(memory_order_acquire) / kCall > own) {
+            unique_lock<mutex> lock(fWaitMtx);
+            slot.fState.fetch_or(kWaiting, memory_order_relaxed);
+            fWaitCV.wait(lock, [&]() { return slot.fState.load(memory_order_acquire) / kCall <= own; });
+        }
+        if (own > 0) {
+            slot.fState.fetch_or(kOrphan, memory_order_release);
+        } else {
+            Free(slot);
+        }
+    }
+
+    static void Free(Slot& slot)
+    {
+        slot.fCallback = nullptr;
+        slot.fKey.clear();
+        slot.fState.store(0, memory_order_release);
+    }
+
+    mutex fMtx; // (un)subscribing
+    mutable mutex fWaitMtx;
+    mutable condition_variable fWaitCV;
+    mutable array<Slot, kMaxSubscribers> fSlots;
+    atomic<size_t> fNumUsed{0}; // slots up to the highest one ever used
+};
+
+template<typename T>
+thread_local const typename Callbacks<T>::Call* Callbacks<T>::Call::tCurrent = nullptr;
+
 // defining the boost MSM state machine
 struct Machine_ : public state_machine_def<Machine_>
 {
@@ -83,6 +281,7 @@ struct Machine_ : public state_machine_def<Machine_>
         , fNewState(State::Ok)
         , fLastTransitionResult(true)
         , fNewStatePending(false)
+        , fLastTransition(Transition::Auto)
     {}
 
     // initial states
@@ -108,6 +307,9 @@ struct Machine_ : public state_machine_def<Machine_>
         {
             fsm.fNewState = ts.Type();
             fsm.fLastTransitionResult = true;
+            fsm.fLastTransition = e.Type();
+            fsm.fTransitionRequested = chrono::steady_clock::now();
+            fsm.fTransitionRequestedWall = chrono::system_clock::now();
             fsm.CallNewTransitionCallbacks(e.Type());
             fsm.fNewStatePending = true;
             fsm.fNewStatePendingCV.notify_all();
@@ -143,32 +345,18 @@ struct Machine_ : public state_machine_def<Machine_>
 
         Row<OK_S,                  ERROR_FOUND_E,   ERROR_S,               DefaultFct, none>> {};
 
-    void CallStateChangeCallbacks(const State state) const
-    {
-        if (!fStateChangeSignal.empty()) {
-            fStateChangeSignal(state);
-        }
-    }
-
-    void CallStateHandler(const State state) const
-    {
-        if (!fStateHandleSignal.empty()) {
-            fStateHandleSignal(state);
-        }
-    }
-
-    void CallStatePrep(const State state) const
-    {
-        if (!fStatePrepSignal.empty()) {
-            fStatePrepSignal(state);
-        }
-    }
+    void CallStateChangeCallbacks(const State state) const { fStateChangeCallbacks(state); }
+    void CallStateHandler(const State state) const { fStateHandler(state); }
+    void CallStatePrep(const State state) const { fStatePrep(state); }
+    void CallNewTransitionCallbacks(const Transition transition) const { fNewTransitionCallbacks(transition); }
 
-    void CallNewTransitionCallbacks(const Transition transition) const
+    void AddTransitionTiming(TransitionTiming timing)
     {
-        if (!fNewTransitionSignal.empty()) {
-            fNewTransitionSignal(transition);
+        lock_guard<mutex> lock(fTimingsMtx);
+        if (fTimings.size() == StateMachine::kMaxTransitionTimings) {
+            fTimings.pop_front();
         }
+        fTimings.push_back(timing);
     }
 
 
@@ -180,24 +368,40 @@ struct Machine_ : public state_machine_def<Machine_>
     atomic<bool> fNewStatePending;
     condition_variable fNewStatePendingCV;
 
-    boost::signals2::signal<void(const State)> fStateChangeSignal;
-    boost::signals2::signal<void(const State)> fStateHandleSignal;
-    boost::signals2::signal<void(const State)> fStatePrepSignal;
-    boost::signals2::signal<void(const Transition)> fNewTransitionSignal;
-    unordered_map<string, boost::signals2::connection> fStateChangeSignalsMap;
-    unordered_map<string, boost::signals2::connection> fNewTransitionSignalsMap;
+    Callbacks<State> fStateChangeCallbacks;
+    Callbacks<State> fStateHandler;
+    Callbacks<State> fStatePrep;
+    Callbacks<Transition> fNewTransitionCallbacks;
+
+    // the pending transition, protected by fStateMtx
+    Transition fLastTransition;
+    chrono::steady_clock::time_point fTransitionRequested;
+    chrono::system_clock::time_point fTransitionRequestedWall;
+
+    mutable mutex fTimingsMtx;
+    deque<TransitionTiming> fTimings;
 
     void ProcessWork()
     {
         bool stop = false;
 
         while (!stop) {
+            TransitionTiming timing;
+            chrono::steady_clock::time_point entered;
             {
                 unique_lock<mutex> lock(fStateMtx);
 
                 fNewStatePendingCV.wait(lock, [this]{ return fNewStatePending.load(); });
 
+                entered = chrono::steady_clock::now();
+                timing.transition = fLastTransition;
+                timing.from = fState;
+                timing.to = fNewState;
+                timing.requested = fTransitionRequestedWall;
+                timing.dispatch = chrono::duration_cast<chrono::microseconds>(entered - fTransitionRequested);
+
                 LOG(state) << fState << " ---> " << fNewState;
+                FAIRMQ_PROBE(state_change, GetStateName(fState).c_str(), GetStateName(static_cast<State>(fNewState)).c_str());
                 fState = static_cast<State>(fNewState);
                 fNewStatePending = false;
 
@@ -209,6 +413,11 @@ struct Machine_ : public state_machine_def<Machine_>
             CallStatePrep(fState);
             CallStateChangeCallbacks(fState);
             CallStateHandler(fState);
+
+            timing.handling = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - entered);
+            LOG(debug) << timing.to << " reached " << timing.dispatch.count() << " us after " << GetTransitionName(timing.transition)
+                       << " was requested, handled in " << timing.handling.count() << " us";
+            AddTransitionTiming(timing);
         }
 
         if (fState == State::Error) {
@@ -310,23 +519,19 @@ try {
 
 void StateMachine::SubscribeToStateChange(const string& key, function<void(const State)> callback)
 {
-    static_pointer_cast<FairMQFSM>(fFsm)->fStateChangeSignalsMap.insert({key, static_pointer_cast<FairMQFSM>(fFsm)->fStateChangeSignal.connect(callback)});
+    static_pointer_cast<FairMQFSM>(fFsm)->fStateChangeCallbacks.Add(key, move(callback));
 }
 
 void StateMachine::UnsubscribeFromStateChange(const string& key)
 {
-    auto fsm = static_pointer_cast<FairMQFSM>(fFsm);
-    if (fsm->fStateChangeSignalsMap.count(key)) {
-        fsm->fStateChangeSignalsMap.at(key).disconnect();
-        fsm->fStateChangeSignalsMap.erase(key);
-    }
+    static_pointer_cast<FairMQFSM>(fFsm)->fStateChangeCallbacks.Remove(key);
 }
 
 void StateMachine::PrepareState(std::function<void(const State)> callback)
 {
     auto fsm = static_pointer_cast<FairMQFSM>(fFsm);
-    if (fsm->fStatePrepSignal.empty()) {
-        fsm->fStatePrepSignal.connect(callback);
+    if (fsm->fStatePrep.Empty()) {
+        fsm->fStatePrep.Add("", move(callback));
     } else {
         LOG(error) << "state preparation handler is already set";
     }
@@ -335,8 +540,8 @@ void StateMachine::PrepareState(std::function<void(const State)> callback)
 void StateMachine::HandleStates(function<void(const State)> callback)
 {
     auto fsm = static_pointer_cast<FairMQFSM>(fFsm);
-    if (fsm->fStateHandleSignal.empty()) {
-        fsm->fStateHandleSignal.connect(callback);
+    if (fsm->fStateHandler.Empty()) {
+        fsm->fStateHandler.Add("", move(callback));
     } else {
         LOG(error) << "state handler is already set";
     }
@@ -345,31 +550,30 @@ void StateMachine::HandleStates(function<void(const State)> callback)
 void StateMachine::StopHandlingStates()
 {
     auto fsm = static_pointer_cast<FairMQFSM>(fFsm);
-    if (!fsm->fStatePrepSignal.empty()) {
-        fsm->fStatePrepSignal.disconnect_all_slots();
-    }
-    if (!fsm->fStateHandleSignal.empty()) {
-        fsm->fStateHandleSignal.disconnect_all_slots();
-    }
+    fsm->fStatePrep.Clear();
+    fsm->fStateHandler.Clear();
 }
 
 void StateMachine::SubscribeToNewTransition(const string& key, function<void(const Transition)> callback)
 {
-    static_pointer_cast<FairMQFSM>(fFsm)->fNewTransitionSignalsMap.insert({key, static_pointer_cast<FairMQFSM>(fFsm)->fNewTransitionSignal.connect(callback)});
+    static_pointer_cast<FairMQFSM>(fFsm)->fNewTransitionCallbacks.Add(key, move(callback));
 }
 
 void StateMachine::UnsubscribeFromNewTransition(const string& key)
 {
-    auto fsm = static_pointer_cast<FairMQFSM>(fFsm);
-    if (fsm->fNewTransitionSignalsMap.count(key)) {
-        fsm->fNewTransitionSignalsMap.at(key).disconnect();
-        fsm->fNewTransitionSignalsMap.erase(key);
-    }
+    static_pointer_cast<FairMQFSM>(fFsm)->fNewTransitionCallbacks.Remove(key);
 }
 
 State StateMachine::GetCurrentState() const { return static_pointer_cast<FairMQFSM>(fFsm)->fState; }
 string StateMachine::GetCurrentStateName() const { return GetStateName(static_pointer_cast<FairMQFSM>(fFsm)->fState); }
 
+vector<TransitionTiming> StateMachine::GetTransitionTimings() const
+{
+    auto fsm = static_pointer_cast<FairMQFSM>(fFsm);
+    lock_guard<mutex> lock(fsm->fTimingsMtx);
+    return vector<TransitionTiming>(fsm->fTimings.begin(), fsm->fTimings.end());
+}
+
 bool StateMachine::NewStatePending() const { return static_cast<bool>(static_pointer_cast<FairMQFSM>(fFsm)->fNewStatePending); }
 void StateMachine::WaitForPendingState() const
 {
@@ -11,14 +11,27 @@
 
 #include <fairmq/States.h>
 
+#include <chrono>
 #include <string>
 #include <memory>
 #include <functional>
 #include <stdexcept>
+#include <vector>
 
 namespace fair::mq
 {
 
+/// Timing of one state transition, recorded when the handler of the target state returns
+struct TransitionTiming
+{
+    Transition transition;
+    State from;
+    State to;
+    std::chrono::system_clock::time_point requested; ///< wall clock time of the ChangeState() call
+    std::chrono::microseconds dispatch; ///< from the ChangeState() call until the state machine entered the new state
+    std::chrono::microseconds handling; ///< duration of the state handler (e.g. InitTask(), or the whole RUNNING state)
+};
+
 class StateMachine
 {
   public:
@@ -49,6 +62,10 @@ class StateMachine
     State GetCurrentState() const;
     std::string GetCurrentStateName() const;
 
+    /// @return timings of the last (up to kMaxTransitionTimings) transitions, oldest first
+    std::vector<TransitionTiming> GetTransitionTimings() const;
+    static constexpr size_t kMaxTransitionTimings = 64;
+
     void Start();
 
     void ProcessWork();
@@ -41,10 +41,44 @@ enum channelOptionKeyIds
     SNDTIMEOUTMS,
     RCVTIMEOUTMS,
     LINGER,
+    RCVMODE,        // block, spin or hybrid
+    RCVSPINUS,      // busy-poll budget of the hybrid receive mode
+    SNDBATCH,       // number of single-part sends coalesced into one transfer
+    SNDBATCHTIMEOUTUS,
+    BATCHLATENCYTARGETUS, // adapt the send batches to the rate, latency target in microseconds
+    METAFORMAT,     // default or compact
+    CONTEXTGROUP,   // zeromq context group of the sockets
+    PACKPARTS,      // maximum size of multipart parts packed into one frame
+    COMPRESSION,    // none, lz4 or zstd
+    COMPRESSIONLEVEL,
+    COMPRESSIONTHREADS,
+    COMPRESSIONMINSIZE,
+    CHUNKSIZE,      // size of the chunks large parts are streamed in
+    MULTICASTRATE,  // maximum send rate of multicast endpoints
+    MULTICASTRECOVERY, // retransmission window of multicast endpoints
+    TRACE,          // transfer trace contexts and trace send/receive events
+    OVERFLOWPOLICY, // block, drop-new or drop-old
+    DEADLINE,       // time after which messages are discarded at receive
+    SAMPLE,         // all, 1/N, rate:<Hz> or bytes:<B/s>
+    MAXBANDWIDTH,   // send bandwidth limit in MB/s
+    BURST,          // token bucket size of the bandwidth limit in MB
+    CHECKSUM,       // none, crc32c or xxh3
+    PRIORITYLANE,   // second socket for high-priority messages
+    MUX,            // subchannels to the same address share one connection
+    ROUTE,          // routing policy of Device::Route()
+    PEERTIMEOUT,    // time after which an unresponsive peer is disconnected
+    AUTOTUNE,       // tune queue and kernel buffer sizes to the measured rate
+    AUTOTUNEMAXBUFSIZE,
+    AUTOTUNEMAXKERNELSIZE,
     RATELOGGING,    // logging rate
     PORTRANGEMIN,
     PORTRANGEMAX,
     AUTOBIND,
+    AUTOBINDSTRATEGY, // random or ephemeral
+    HYBRID,         // shmem to local peers, zeromq to remote ones
+    SHAREDSEND,     // any thread may send, through a sender thread
+    SPILLDIR,       // directory of the spill file of the overflow policy spill
+    SPILLSIZE,      // size of the spill file in MiB
     NUMSOCKETS,
     lastsocketkey
 };
@@ -62,10 +96,44 @@ constexpr static const char* channelOptionKeys[] = {
     /*[SNDTIMEOUTMS]  = */ "sndTimeoutMs",
     /*[RCVTIMEOUTMS]  = */ "rcvTimeoutMs",
     /*[LINGER]        = */ "linger",
+    /*[RCVMODE]       = */ "rcvMode",
+    /*[RCVSPINUS]     = */ "rcvSpinUs",
+    /*[SNDBATCH]      = */ "sndBatch",
+    /*[SNDBATCHTIMEOUTUS] = */ "sndBatchTimeoutUs",
+    /*[BATCHLATENCYTARGETUS] = */ "batchLatencyTargetUs",
+    /*[METAFORMAT] = */ "metaFormat",
+    /*[CONTEXTGROUP]  = */ "contextGroup",
+    /*[PACKPARTS]     = */ "packParts",
+    /*[COMPRESSION]   = */ "compression",
+    /*[COMPRESSIONLEVEL] = */ "compressionLevel",
+    /*[COMPRESSIONTHREADS] = */ "compressionThreads",
+    /*[COMPRESSIONMINSIZE] = */ "compressionMinSize",
+    /*[CHUNKSIZE]     = */ "chunkSize",
+    /*[MULTICASTRATE] = */ "multicastRate",
+    /*[MULTICASTRECOVERY] = */ "multicastRecovery",
+    /*[TRACE]         = */ "trace",
+    /*[OVERFLOWPOLICY]= */ "overflow",
+    /*[DEADLINE]      = */ "deadline",
+    /*[SAMPLE]        = */ "sample",
+    /*[MAXBANDWIDTH]  = */ "maxBandwidth",
+    /*[BURST]         = */ "burst",
+    /*[CHECKSUM]      = */ "checksum",
+    /*[PRIORITYLANE]  = */ "priorityLane",
+    /*[MUX]           = */ "mux",
+    /*[ROUTE]         = */ "route",
+    /*[PEERTIMEOUT]   = */ "peerTimeout",
+    /*[AUTOTUNE]      = */ "autoTune",
+    /*[AUTOTUNEMAXBUFSIZE] = */ "autoTuneMaxBufSize",
+    /*[AUTOTUNEMAXKERNELSIZE] = */ "autoTuneMaxKernelSize",
     /*[RATELOGGING]   = */ "rateLogging",
     /*[PORTRANGEMIN]  = */ "portRangeMin",
     /*[PORTRANGEMAX]  = */ "portRangeMax",
     /*[AUTOBIND]      = */ "autoBind",
+    /*[AUTOBINDSTRATEGY] = */ "autoBindStrategy",
+    /*[HYBRID]        = */ "hybrid",
+    /*[SHAREDSEND]    = */ "sharedSend",
+    /*[SPILLDIR]      = */ "spillDir",
+    /*[SPILLSIZE]     = */ "spillSize",
     /*[NUMSOCKETS]    = */ "numSockets",
     nullptr
 };
@@ -11,16 +11,21 @@
 
 // IWYU pragma: begin_exports
 #include <fairmq/tools/Compiler.h>
+#include <fairmq/tools/Checksum.h>
+#include <fairmq/tools/Copy.h>
 #include <fairmq/tools/CppSTL.h>
 #include <fairmq/tools/Exceptions.h>
+#include <fairmq/tools/Gpu.h>
 #include <fairmq/tools/InstanceLimit.h>
 #include <fairmq/tools/Network.h>
 #include <fairmq/tools/Process.h>
 #include <fairmq/tools/RateLimit.h>
 #include <fairmq/tools/Semaphore.h>
 #include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Threads.h>
 #include <fairmq/tools/Unique.h>
 #include <fairmq/tools/Version.h>
+#include <fairmq/tools/Wakeup.h>
 // IWYU pragma: end_exports
 
 #endif // FAIR_MQ_TOOLS_H
@@ -0,0 +1,141 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/Tracing.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace fair::mq {
+
+namespace {
+
+// single producer (the owning thread), single consumer (Drain)
+struct TraceRing
+{
+    explicit TraceRing(uint32_t t) : thread(t) {}
+
+    const uint32_t thread;
+    alignas(64) atomic<uint64_t> head{0}; // written by the producer
+    alignas(64) atomic<uint64_t> tail{0}; // written by the consumer
+    array<TraceEvent, Tracer::kRingSize> events;
+};
+
+struct Registry
+{
+    mutex mtx;
+    vector<shared_ptr<TraceRing>> rings;
+    vector<string> channels;
+    uint32_t numThreads = 0;
+    atomic<uint64_t> dropped{0};
+};
+
+Registry& GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+TraceRing& ThreadRing()
+{
+    // owned by the registry as well, so that events of exited threads can still be drained
+    thread_local shared_ptr<TraceRing> ring = [] {
+        Registry& registry = GetRegistry();
+        lock_guard<mutex> lock(registry.mtx);
+        registry.rings.push_back(make_shared<TraceRing>(registry.numThreads++));
+        return registry.rings.back();
+    }();
+    return *ring;
+}
+
+} // namespace
+
+atomic<bool> Tracer::sEnabled{false};
+
+uint32_t Tracer::RegisterChannel(const string& name)
+{
+    Registry& registry = GetRegistry();
+    lock_guard<mutex> lock(registry.mtx);
+    for (size_t i = 0; i < registry.channels.size(); ++i) {
+        if (registry.channels[i] == name) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    registry.channels.push_back(name);
+    return static_cast<uint32_t>(registry.channels.size() - 1);
+}
+
+string Tracer::ChannelName(uint32_t channel)
+{
+    Registry& registry = GetRegistry();
+    lock_guard<mutex> lock(registry.mtx);
+    return channel < registry.channels.size() ? registry.channels[channel] : string();
+}
+
+void Tracer::RecordEvent(const TraceContext& context, uint32_t channel, TraceEvent::Type type)
+{
+    TraceRing& ring = ThreadRing();
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    if (head - ring.tail.load(memory_order_acquire) == kRingSize) {
+        GetRegistry().dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    TraceEvent& event = ring.events[head % kRingSize];
+    event.context = context;
+    event.timestamp = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    event.channel = channel;
+    event.type = type;
+    ring.head.store(head + 1, memory_order_release);
+}
+
+size_t Tracer::Drain(const function<void(uint32_t thread, const TraceEvent& event)>& callback)
+{
+    Registry& registry = GetRegistry();
+    vector<shared_ptr<TraceRing>> rings;
+    {
+        lock_guard<mutex> lock(registry.mtx);
+        rings = registry.rings;
+    }
+
+    size_t drained = 0;
+    for (auto& ring : rings) {
+        uint64_t tail = ring->tail.load(memory_order_relaxed);
+        uint64_t head = ring->head.load(memory_order_acquire);
+        for (; tail != head; ++tail, ++drained) {
+            callback(ring->thread, ring->events[tail % kRingSize]);
+        }
+        ring->tail.store(tail, memory_order_release);
+    }
+
+    // rings of exited threads (only referenced by the registry) are released once they are empty
+    rings.clear();
+    lock_guard<mutex> lock(registry.mtx);
+    for (auto it = registry.rings.begin(); it != registry.rings.end();) {
+        if (it->use_count() == 1 && (*it)->head.load(memory_order_acquire) == (*it)->tail.load(memory_order_relaxed)) {
+            it = registry.rings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return drained;
+}
+
+uint64_t Tracer::Dropped() { return GetRegistry().dropped.load(memory_order_relaxed); }
+
+TraceContext& Tracer::Current()
+{
+    thread_local TraceContext current;
+    return current;
+}
+
+} // namespace fair::mq
@@ -0,0 +1,88 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TRACING_H
+#define FAIR_MQ_TRACING_H
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace fair::mq {
+
+/// User defined context that travels with a message over channels with the trace property,
+/// e.g. the id of a time frame (traceId) and of the producing step (spanId).
+struct TraceContext
+{
+    uint64_t traceId = 0;
+    uint64_t spanId = 0;
+
+    explicit operator bool() const { return traceId != 0; }
+    bool operator==(const TraceContext& rhs) const { return traceId == rhs.traceId && spanId == rhs.spanId; }
+    bool operator!=(const TraceContext& rhs) const { return !(*this == rhs); }
+};
+
+struct TraceEvent
+{
+    enum class Type : uint8_t
+    {
+        receive, // the message entered the device
+        send     // the message left the device
+    };
+
+    TraceContext context;
+    uint64_t timestamp; // ns since epoch (system clock, comparable across processes of a host)
+    uint32_t channel;   // see Tracer::ChannelName()
+    Type type;
+};
+
+/// Process wide recorder of trace events. Events are written to a lock-free ring per thread
+/// (dropped when it is full) and drained asynchronously by an exporter (see the tracing plugin).
+class Tracer
+{
+  public:
+    static constexpr size_t kRingSize = 8192; // events per thread
+
+    /// Recording is disabled by default, Record() then returns immediately
+    static void Enable(bool enable) { sEnabled.store(enable, std::memory_order_relaxed); }
+    static bool Enabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+    /// @return id of the channel name to be used with Record(), the same name always gets the same id
+    static uint32_t RegisterChannel(const std::string& name);
+    static std::string ChannelName(uint32_t channel);
+
+    /// Record an event of the calling thread (if enabled)
+    static void Record(const TraceContext& context, uint32_t channel, TraceEvent::Type type)
+    {
+        if (Enabled()) {
+            RecordEvent(context, channel, type);
+        }
+    }
+
+    /// Pass the recorded events of all threads to the callback (with a process unique thread number), in order per thread.
+    /// Must not be called concurrently.
+    /// @return number of drained events
+    static size_t Drain(const std::function<void(uint32_t thread, const TraceEvent& event)>& callback);
+    /// @return number of events dropped because a ring was full
+    static uint64_t Dropped();
+
+    /// Context of the last traced message received by the calling thread. Messages sent by the thread over
+    /// a traced channel without a context of their own inherit it.
+    static TraceContext& Current();
+
+  private:
+    static void RecordEvent(const TraceContext& context, uint32_t channel, TraceEvent::Type type);
+
+    static std::atomic<bool> sEnabled;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_TRACING_H */
@@ -7,8 +7,15 @@
  ********************************************************************************/
 
 #include <fairmq/TransportFactory.h>
+#include <fairmq/inproc/TransportFactory.h>
 #include <fairmq/shmem/TransportFactory.h>
 #include <fairmq/zeromq/TransportFactory.h>
+#ifdef BUILD_URING_TRANSPORT
+#include <fairmq/uring/TransportFactory.h>
+#endif
+#ifdef BUILD_RDMA_TRANSPORT
+#include <fairmq/rdma/TransportFactory.h>
+#endif
 #include <fairlogger/Logger.h>
 #include <fairmq/Tools.h>
 #include <memory>
@@ -35,16 +42,80 @@ auto TransportFactory::CreateTransportFactory(const string& type,
         return make_shared<zmq::TransportFactory>(finalId, config);
     } else if (type == "shmem") {
         return make_shared<shmem::TransportFactory>(finalId, config);
+    } else if (type == "inproc") {
+        return make_shared<inproc::TransportFactory>(finalId, config);
     }
+#ifdef BUILD_URING_TRANSPORT
+    else if (type == "uring") {
+        return make_shared<uring::TransportFactory>(finalId, config);
+    }
+#endif
+#ifdef BUILD_RDMA_TRANSPORT
+    else if (type == "rdma") {
+        return make_shared<rdma::TransportFactory>(finalId, config);
+    }
+#endif
     else {
         LOG(error) << "Unavailable transport requested: "
                    << "\"" << type << "\""
                    << ". Available are: "
                    << "\"zeromq\","
-                   << "\"shmem\""
+                   << "\"shmem\","
+                   << "\"inproc\""
+#ifdef BUILD_URING_TRANSPORT
+                   << ",\"uring\""
+#endif
+#ifdef BUILD_RDMA_TRANSPORT
+                   << ",\"rdma\""
+#endif
                    << ". Exiting.";
         throw TransportFactoryError(tools::ToString("Unavailable transport requested: ", type));
     }
 }
 
+void ReleaseMessages(vector<MessagePtr>& msgs) noexcept
+{
+    TransportFactory* transport = nullptr;
+    for (auto& msg : msgs) {
+        if (msg) {
+            transport = msg->GetTransport();
+            break;
+        }
+    }
+    if (transport) {
+        try {
+            transport->ReleaseMessages(msgs);
+        } catch (exception& e) {
+            LOG(error) << "error releasing messages: " << e.what();
+        }
+    }
+    msgs.clear();
+}
+
+void ReleaseRegions(vector<UnmanagedRegionPtr>& regions) noexcept
+{
+    // grouped by transport, in the order of their first region
+    while (!regions.empty()) {
+        TransportFactory* transport = regions.front() ? regions.front()->GetTransport() : nullptr;
+        vector<UnmanagedRegionPtr> group;
+        vector<UnmanagedRegionPtr> rest;
+        for (auto& region : regions) {
+            if (region && region->GetTransport() == transport) {
+                group.push_back(move(region));
+            } else if (region) {
+                rest.push_back(move(region));
+            }
+        }
+        regions = move(rest);
+        try {
+            if (transport) {
+                transport->ReleaseRegions(group);
+            }
+        } catch (exception& e) {
+            LOG(error) << "error releasing regions: " << e.what();
+        }
+        group.clear();
+    }
+}
+
 }   // namespace fair::mq
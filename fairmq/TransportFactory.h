@@ -10,16 +10,23 @@
 #define FAIR_MQ_TRANSPORTFACTORY_H
 
 #include <cstddef>   // size_t
+#include <fairmq/BufferArena.h>
 #include <fairmq/MemoryResources.h>
 #include <fairmq/Message.h>
+#include <fairmq/Parts.h>
 #include <fairmq/Poller.h>
+#include <fairmq/RegionPool.h>
 #include <fairmq/Socket.h>
 #include <fairmq/Transports.h>
 #include <fairmq/UnmanagedRegion.h>
+#include <functional>
 #include <memory>   // shared_ptr
+#include <new>   // placement new
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>   // forward
 #include <vector>
 
 namespace fair::mq {
@@ -27,6 +34,29 @@ namespace fair::mq {
 class Channel;
 class ProgOptions;
 
+/// A transport specific metric, see TransportFactory::GetMetrics()
+struct TransportMetric
+{
+    std::string name;   ///< e.g. "shm_segment_free_bytes"
+    std::string help;
+    std::vector<std::pair<std::string, std::string>> labels;   ///< e.g. {{"segment", "0"}}
+    double value = 0;
+    bool counter = false;   ///< monotonically increasing, otherwise a gauge
+};
+
+/// The fill level of the memory a transport allocates messages from crossed a watermark,
+/// see TransportFactory::SubscribeToMemoryWatermarks()
+struct MemoryWatermarkEvent
+{
+    uint16_t segmentId = 0;   ///< managed segment (shmem)
+    size_t size = 0;          ///< total bytes
+    size_t used = 0;          ///< bytes in use when the crossing was observed
+    size_t level = 0;         ///< number of watermarks reached, 0: below the lowest one
+    bool rising = true;       ///< the fill level rose above watermark level-1, otherwise it fell below watermark level
+};
+
+using MemoryWatermarkCallback = std::function<void(const MemoryWatermarkEvent&)>;
+
 class TransportFactory
 {
   private:
@@ -70,6 +100,50 @@ class TransportFactory
     /// @param alignment message alignment
     /// @return pointer to Message
     virtual MessagePtr CreateMessage(size_t size, Alignment alignment) = 0;
+    /// @brief Create new Message of specified size, with room for headers to be prepended in place (Message::Prepend)
+    /// @param size message size
+    /// @param headroom bytes reserved in front of the data
+    /// @return pointer to Message (without headroom if the transport does not support it)
+    virtual MessagePtr CreateMessage(size_t size, Headroom /* headroom */) { return CreateMessage(size); }
+    /// @brief Create multiple new Messages of specified size
+    /// @param count number of messages
+    /// @param size size of each message
+    /// @return Parts containing the messages
+    /// Transports can override this to reserve all buffers in one allocator transaction, default creates them one by one
+    virtual Parts CreateMessages(size_t count, size_t size)
+    {
+        Parts parts;
+        parts.fParts.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            parts.AddPart(CreateMessage(size));
+        }
+        return parts;
+    }
+    /// @brief Create multiple new Messages of specified size and alignment
+    /// @param count number of messages
+    /// @param size size of each message
+    /// @param alignment alignment of each message
+    /// @return Parts containing the messages
+    /// Transports can override this to reserve all buffers in one allocator transaction, default creates them one by one
+    virtual Parts CreateMessages(size_t count, size_t size, Alignment alignment)
+    {
+        Parts parts;
+        parts.fParts.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            parts.AddPart(CreateMessage(size, alignment));
+        }
+        return parts;
+    }
+    /// @brief Destroy multiple Messages, leaves msgs empty
+    /// @param msgs messages to destroy
+    /// Transports can override this to return all buffers in one allocator transaction, default destroys them one by one.
+    /// Messages of other transports may be contained and have to be destroyed too.
+    virtual void ReleaseMessages(std::vector<MessagePtr>& msgs) { msgs.clear(); }
+    /// @brief Destroy multiple unmanaged regions of this transport, leaves regions empty
+    /// @param regions regions to destroy
+    /// Transports can override this to wait for the outstanding acknowledgements of the regions concurrently (one
+    /// RegionConfig::linger for all), default destroys them one by one.
+    virtual void ReleaseRegions(std::vector<UnmanagedRegionPtr>& regions) { regions.clear(); }
     /// @brief Create new Message with user provided buffer and size
     /// @param data pointer to user provided buffer
     /// @param size size of the user provided buffer
@@ -92,6 +166,12 @@ class TransportFactory
 
     /// @brief Create a socket
     virtual SocketPtr CreateSocket(const std::string& type, const std::string& name) = 0;
+    /// @brief Create a socket in the given context group (transports without context groups ignore it)
+    /// @param contextGroup name of the group, as configured with --zmq-context-group, empty for the default context
+    virtual SocketPtr CreateSocket(const std::string& type, const std::string& name, const std::string& /* contextGroup */)
+    {
+        return CreateSocket(type, name);
+    }
 
     /// @brief Create a poller for a single channel (all subchannels)
     virtual PollerPtr CreatePoller(const std::vector<Channel>& channels) const = 0;
@@ -159,6 +239,30 @@ class TransportFactory
     /// @return pointer to UnmanagedRegion
     virtual UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, RegionBulkCallback bulkCallback, RegionConfig cfg) = 0;
 
+    /// @brief Open an existing region of the session, e.g. to allocate from a slot pool region (RegionConfig::slotSize)
+    /// created by another process. The region stays with its creator, it is not removed with the returned object.
+    /// @param id region id
+    /// @return pointer to UnmanagedRegion, nullptr if the region does not exist or the transport does not support it
+    virtual UnmanagedRegionPtr OpenUnmanagedRegion(uint16_t /* id */) { return nullptr; }
+
+    /// @brief Create a pool of fixed-size buffers on top of a new UnmanagedRegion
+    /// @param slotSize size of each buffer
+    /// @param numSlots number of buffers
+    /// @param cfg region configuration
+    /// @return pointer to RegionPool, has to be destroyed before this factory
+    RegionPoolPtr CreateRegionPool(size_t slotSize, size_t numSlots, RegionConfig cfg = RegionConfig())
+    {
+        return std::make_unique<RegionPool>(*this, std::vector<RegionPool::SizeClass>{{slotSize, numSlots}}, std::move(cfg));
+    }
+    /// @brief Create a pool of buffers of several size classes on top of a new UnmanagedRegion
+    /// @param sizeClasses buffer sizes and counts
+    /// @param cfg region configuration
+    /// @return pointer to RegionPool, has to be destroyed before this factory
+    RegionPoolPtr CreateRegionPool(std::vector<RegionPool::SizeClass> sizeClasses, RegionConfig cfg = RegionConfig())
+    {
+        return std::make_unique<RegionPool>(*this, std::move(sizeClasses), std::move(cfg));
+    }
+
     /// @brief Subscribe to region events (creation, destruction, ...)
     /// @param callback the callback that is called when a region event occurs
     virtual void SubscribeToRegionEvents(RegionEventCallback callback) = 0;
@@ -170,6 +274,48 @@ class TransportFactory
 
     virtual std::vector<RegionInfo> GetRegionInfo() = 0;
 
+    /// @brief Get transport specific metrics (e.g. free segment memory). Can be called from any thread,
+    /// does not synchronize with sending/receiving threads beyond relaxed counter reads and short locks
+    /// @return metrics, empty if the transport has none
+    virtual std::vector<TransportMetric> GetMetrics() { return {}; }
+
+    /// @brief Subscribe to fill level watermarks of the memory messages are allocated from (shmem: the own managed segment),
+    /// e.g. to throttle a producer before allocations start failing. The callback is called from a transport thread
+    /// whenever the fill level crosses a watermark. A replaced subscription is stopped first.
+    /// @param watermarks ascending fill levels in (0, 1], e.g. {0.7, 0.85, 0.95}
+    /// @param callback called with the new level
+    /// @param intervalMs how often the fill level is checked
+    /// @return false if the transport does not support watermarks
+    virtual bool SubscribeToMemoryWatermarks(std::vector<double> /* watermarks */, MemoryWatermarkCallback /* callback */, int /* intervalMs */ = 10) { return false; }
+    /// @brief Stop the memory watermark subscription, no callback is running after the call returns
+    virtual void UnsubscribeFromMemoryWatermarks() {}
+
+    /// @brief Create an arena that provides messages from one buffer of the given size, which is returned as a whole
+    /// once the arena and all its messages are released (shmem: a chunk of the managed segment)
+    /// @param size size of the arena buffer
+    /// @return pointer to BufferArena, has to be destroyed before this factory. nullptr if the transport has no arenas
+    virtual BufferArenaPtr CreateBufferArena(size_t /* size */) { return nullptr; }
+
+    /// @brief Publish a message as the current version of a named, read-mostly object (e.g. calibration data) in the
+    /// object store of the session (shmem: all devices of the session on the node share one copy in shared memory).
+    /// The store keeps its own reference, so the object outlives the publishing device. The content must not be
+    /// modified after publishing. A previous version is freed once the store and all its readers have released it.
+    /// @param key name of the object
+    /// @param msg message with the object (shmem: in a managed segment)
+    /// @return version of the published object (larger than all previous versions), 0 if not supported
+    virtual uint64_t PublishObject(const std::string& /* key */, Message& /* msg */) { return 0; }
+    /// @brief Get a read-only view of the current version of an object: a message referring to the stored data,
+    /// which keeps this version alive until it is destroyed
+    /// @param version if not null, set to the version of the returned object
+    /// @return nullptr if there is no such object (or the transport has no object store)
+    virtual MessagePtr GetObject(const std::string& /* key */, uint64_t* /* version */ = nullptr) { return nullptr; }
+    /// @brief Get the current version of an object without referring to it, e.g. to poll for updates
+    /// @return 0 if there is no such object
+    virtual uint64_t GetObjectVersion(const std::string& /* key */) { return 0; }
+    /// @brief Remove an object from the store, readers keep their views
+    /// @return false if there is no such object
+    virtual bool RemoveObject(const std::string& /* key */) { return false; }
+
     /// Get transport type
     virtual Transport GetType() const = 0;
 
@@ -228,6 +374,18 @@ class TransportFactory
         return CreateMessage(data, sizeof(T), NoCleanup, nullptr);
     }
 
+    /// Create a message of sizeof(T) bytes, aligned to alignof(T), and construct T in its buffer from args
+    /// (T{args...}, value-initialized without args). Unlike NewSimpleMessage there is no separate allocation
+    /// and no copy. The receiver reads it with MessageAs<T>().
+    template<typename T, typename... Args>
+    MessagePtr NewTypedMessage(Args&&... args)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "NewTypedMessage requires a trivially copyable type");
+        MessagePtr msg = CreateMessage(sizeof(T), Alignment{alignof(T)});
+        new (msg->GetData()) T{std::forward<Args>(args)...};
+        return msg;
+    }
+
     MessagePtr NewStaticMessage(const std::string& str)
     {
         return CreateMessage(const_cast<char*>(str.c_str()), str.length(), NoCleanup, nullptr);
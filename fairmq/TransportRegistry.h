@@ -0,0 +1,94 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TRANSPORTREGISTRY_H
+#define FAIR_MQ_TRANSPORTREGISTRY_H
+
+#include <fairmq/TransportFactory.h>
+#include <fairmq/Transports.h>
+
+#include <fairlogger/Logger.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fair::mq {
+
+class ProgOptions;
+
+/// Transport factories shared by several devices of one process (see fair::mq::MultiDeviceRunner), so that they
+/// share one zmq context, one shmem segment manager and their threads.
+///
+/// A transport is created by the first device that needs it, with the id and configuration of that device, and lives
+/// until the registry is destroyed. Interruption is tracked per device: the transports are resumed only when all
+/// devices that interrupted them (on their state transitions) have resumed them again.
+class TransportRegistry
+{
+  public:
+    TransportRegistry() = default;
+    TransportRegistry(const TransportRegistry&) = delete;
+    TransportRegistry(TransportRegistry&&) = delete;
+    TransportRegistry& operator=(const TransportRegistry&) = delete;
+    TransportRegistry& operator=(TransportRegistry&&) = delete;
+
+    ~TransportRegistry()
+    {
+        for (auto& [type, transport] : fTransports) {
+            transport->Reset();
+        }
+    }
+
+    std::shared_ptr<TransportFactory> Get(Transport type, const std::string& id, ProgOptions* config)
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        auto it = fTransports.find(type);
+        if (it != fTransports.end()) {
+            LOG(debug) << "Using shared '" << TransportNames.at(type) << "' transport for " << id;
+            return it->second;
+        }
+        LOG(debug) << "Adding shared '" << TransportNames.at(type) << "' transport, created by " << id;
+        auto transport = TransportFactory::CreateTransportFactory(TransportNames.at(type), id, config);
+        if (!fInterrupted.empty()) {
+            transport->Interrupt();
+        }
+        fTransports.emplace(type, transport);
+        return transport;
+    }
+
+    void Interrupt(const void* device)
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fInterrupted.insert(device);
+        for (auto& [type, transport] : fTransports) {
+            transport->Interrupt();
+        }
+    }
+
+    void Resume(const void* device)
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fInterrupted.erase(device);
+        if (fInterrupted.empty()) {
+            for (auto& [type, transport] : fTransports) {
+                transport->Resume();
+            }
+        }
+    }
+
+  private:
+    std::mutex fMtx;
+    std::unordered_map<Transport, std::shared_ptr<TransportFactory>> fTransports;
+    std::unordered_set<const void*> fInterrupted;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_TRANSPORTREGISTRY_H */
@@ -22,7 +22,10 @@ enum class Transport
 {
     DEFAULT,
     ZMQ,
-    SHM
+    SHM,
+    URING,
+    RDMA,
+    INPROC
 };
 
 struct TransportError : std::runtime_error
@@ -33,13 +36,19 @@ struct TransportError : std::runtime_error
 static const std::unordered_map<std::string, Transport> TransportTypes{
     {"default", Transport::DEFAULT},
     {"zeromq", Transport::ZMQ},
-    {"shmem", Transport::SHM}
+    {"shmem", Transport::SHM},
+    {"uring", Transport::URING},
+    {"rdma", Transport::RDMA},
+    {"inproc", Transport::INPROC}
 };
 
 static const std::unordered_map<Transport, std::string> TransportNames{
     {Transport::DEFAULT, "default"},
     {Transport::ZMQ, "zeromq"},
-    {Transport::SHM, "shmem"}
+    {Transport::SHM, "shmem"},
+    {Transport::URING, "uring"},
+    {Transport::RDMA, "rdma"},
+    {Transport::INPROC, "inproc"}
 };
 
 inline std::string TransportName(Transport transport) { return TransportNames.at(transport); }
@@ -58,7 +67,7 @@ inline std::ostream& operator<<(std::ostream& os, const Transport& transport)
 
 inline auto GetEnabledTransports() -> std::vector<Transport>
 {
-    return {Transport::ZMQ, Transport::SHM};
+    return {Transport::ZMQ, Transport::SHM, Transport::INPROC};
 }
 
 }   // namespace fair::mq
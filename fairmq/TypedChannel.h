@@ -0,0 +1,127 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TYPEDCHANNEL_H
+#define FAIR_MQ_TYPEDCHANNEL_H
+
+#include <fairmq/Channel.h>
+#include <fairmq/Parts.h>
+#include <fairmq/Transports.h>
+#include <fairmq/shmem/Message.h>
+#include <fairmq/shmem/Socket.h>
+#include <fairmq/shmem/TransportFactory.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/zeromq/Message.h>
+#include <fairmq/zeromq/Socket.h>
+#include <fairmq/zeromq/TransportFactory.h>
+
+#include <cstddef> // size_t
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fair::mq
+{
+
+struct TypedChannelError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+/// Concrete (final) classes of a transport, for calls without virtual dispatch
+template<Transport T>
+struct TransportTraits;
+
+template<>
+struct TransportTraits<Transport::ZMQ>
+{
+    using SocketType = zmq::Socket;
+    using MessageType = zmq::Message;
+    using FactoryType = zmq::TransportFactory;
+};
+
+template<>
+struct TransportTraits<Transport::SHM>
+{
+    using SocketType = shmem::Socket;
+    using MessageType = shmem::Message;
+    using FactoryType = shmem::TransportFactory;
+};
+
+/// Fast path of a channel whose transport is known at build time: transfers go straight to the concrete socket class
+/// of the transport (no virtual dispatch, no transport compatibility check of the messages), messages are created
+/// with its concrete transport factory and can be accessed as its concrete message class.
+///
+/// It skips everything the channel layers around the socket: metrics of the calls, auto-tuning, probes and flight
+/// recording. Channels that need the generic path (checksums, mux, overflow policies/deadlines, tracing, receive
+/// targets, hybrid sockets, shared send paths) are refused. Messages have to be of the transport T. The byte and message counters of the
+/// socket (rate logging) are kept.
+///
+/// Refers to the socket and transport of the channel as they are at construction: create it after the channel is
+/// initialized (e.g. in InitTask()) and do not use it after the channel is reset.
+/// @tparam T transport of the channel, Transport::ZMQ or Transport::SHM
+template<Transport T>
+class TypedChannel
+{
+  public:
+    using SocketType = typename TransportTraits<T>::SocketType;
+    using MessageType = typename TransportTraits<T>::MessageType;
+    using FactoryType = typename TransportTraits<T>::FactoryType;
+
+    /// @throw TypedChannelError if the channel is not of the transport T or needs the generic path
+    explicit TypedChannel(Channel& channel)
+        : fChannel(channel)
+        , fSocket(dynamic_cast<SocketType*>(&channel.GetSocket()))
+        , fFactory(dynamic_cast<FactoryType*>(channel.Transport()))
+        , fSndTimeoutMs(channel.GetSndTimeout())
+        , fRcvTimeoutMs(channel.GetRcvTimeout())
+    {
+        if (!fSocket || !fFactory) {
+            throw TypedChannelError(tools::ToString("channel ", channel.GetName(), " is not a plain ", TransportNames.at(T), " channel (transport ", TransportNames.at(channel.GetTransportType()), ")"));
+        }
+        const std::string generic(channel.GenericPathFeature());
+        if (!generic.empty()) {
+            throw TypedChannelError(tools::ToString("channel ", channel.GetName(), " uses ", generic, ", which needs the generic transfer path"));
+        }
+    }
+
+    Channel& GetChannel() const { return fChannel; }
+    SocketType& GetSocket() const { return *fSocket; }
+    FactoryType& GetTransport() const { return *fFactory; }
+
+    MessagePtr NewMessage() { return fFactory->CreateMessage(); }
+    MessagePtr NewMessage(size_t size) { return fFactory->CreateMessage(size); }
+
+    /// Access a message of the transport T as its concrete class (no check)
+    static MessageType& Get(const MessagePtr& msg) { return static_cast<MessageType&>(*msg); }
+    static void* Data(const MessagePtr& msg) { return Get(msg).GetData(); }
+    static size_t Size(const MessagePtr& msg) { return Get(msg).GetSize(); }
+
+    /// Send message(s) of the transport T, return values as Channel::Send()
+    int64_t Send(MessagePtr& msg, int sndTimeoutMs) { return fSocket->Send(msg, sndTimeoutMs); }
+    int64_t Send(std::vector<MessagePtr>& msgVec, int sndTimeoutMs) { return fSocket->Send(msgVec, sndTimeoutMs); }
+    int64_t Send(Parts& parts, int sndTimeoutMs) { return fSocket->Send(parts.fParts, sndTimeoutMs); }
+    template<typename M>
+    int64_t Send(M& m) { return Send(m, fSndTimeoutMs); }
+
+    /// Receive message(s) of the transport T, return values as Channel::Receive()
+    int64_t Receive(MessagePtr& msg, int rcvTimeoutMs) { return fSocket->Receive(msg, rcvTimeoutMs); }
+    int64_t Receive(std::vector<MessagePtr>& msgVec, int rcvTimeoutMs) { return fSocket->Receive(msgVec, rcvTimeoutMs); }
+    int64_t Receive(Parts& parts, int rcvTimeoutMs) { return fSocket->Receive(parts.fParts, rcvTimeoutMs); }
+    template<typename M>
+    int64_t Receive(M& m) { return Receive(m, fRcvTimeoutMs); }
+
+  private:
+    Channel& fChannel;
+    SocketType* fSocket;
+    FactoryType* fFactory;
+    int fSndTimeoutMs;
+    int fRcvTimeoutMs;
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_TYPEDCHANNEL_H */
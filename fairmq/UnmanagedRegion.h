@@ -29,7 +29,9 @@ enum class RegionEvent : int
 {
     created,
     destroyed,
-    local_only
+    local_only,
+    initialized, // local event: asynchronous initialization of the own managed segment is complete (shmem, --shm-segment-init-async)
+    resized      // the owner resized the region (UnmanagedRegion::Resize()), size is the new size, ptr is unchanged
 };
 
 struct RegionInfo
@@ -71,6 +73,14 @@ struct RegionBlock
     {}
 };
 
+/// How blocks are distributed over the region callback threads (RegionConfig::ackCallbackThreads)
+enum class RegionAckSharding : int
+{
+    none,    // whole bunches of acknowledgements, round-robin (no ordering between threads)
+    address, // by block address, blocks of the same address are processed by the same thread, in the order they are received
+    hint     // by block hint, blocks with the same hint are processed by the same thread, in the order they are received
+};
+
 using RegionCallback = std::function<void(void*, size_t, void*)>;
 using RegionBulkCallback = std::function<void(const std::vector<RegionBlock>&)>;
 using RegionEventCallback = std::function<void(RegionInfo)>;
@@ -93,6 +103,28 @@ struct UnmanagedRegion
     virtual void SetLinger(uint32_t linger) = 0;
     virtual uint32_t GetLinger() const = 0;
 
+    /// Reserve the next block of a ring buffer region (RegionConfig::ringBuffer). Send it as a region message starting
+    /// at the returned pointer, it is acknowledged cumulatively once it and all blocks reserved before it are released.
+    /// To be called by the region owner only.
+    /// Of a slot pool region (RegionConfig::slotSize), take a free slot instead. Any thread of any process of the session
+    /// that has the region (see TransportFactory::OpenUnmanagedRegion()) may allocate, the slot returns to the pool when
+    /// the message in it is released.
+    /// @param timeoutMs time to wait for older blocks (free slots) to be released if the region is full (-1: no limit)
+    /// @return nullptr on timeout, if the region is not a ring buffer or slot pool or if it is filled by another host (RegionConfig::crossHost)
+    virtual void* Allocate(size_t /* size */, int /* timeoutMs */ = 0) { return nullptr; }
+    /// @return bytes of a ring buffer region not held by unreleased blocks, bytes of the free slots of a slot pool
+    /// region, 0 for other regions
+    virtual size_t GetFreeSpace() const { return 0; }
+    /// @return stream offset up to which all blocks of a ring buffer region have been released (region position:
+    /// offset % region size), 0 for other regions
+    virtual uint64_t GetAckedOffset() const { return 0; }
+    /// Grow or shrink a resizable region (RegionConfig::maxSize) to size bytes, up to its maxSize. The region stays at
+    /// the same address in all processes, they see the new size with the next GetSize() and get a RegionEvent::resized.
+    /// Before shrinking, the owner has to make sure that no blocks beyond the new size are in use anymore.
+    /// To be called by the region owner only.
+    /// @return false if the region is not resizable, size is out of range or the memory could not be resized
+    virtual bool Resize(size_t /* size */) { return false; }
+
     virtual Transport GetType() const = 0;
     TransportFactory* GetTransport() { return fTransport; }
     void SetTransport(TransportFactory* transport) { fTransport = transport; }
@@ -105,6 +137,10 @@ struct UnmanagedRegion
 
 using UnmanagedRegionPtr = std::unique_ptr<UnmanagedRegion>;
 
+/// Destroys the regions via TransportFactory::ReleaseRegions of their transports, which may wait for the outstanding
+/// acknowledgements of all of them at once (one linger instead of one per region). Leaves regions empty.
+void ReleaseRegions(std::vector<UnmanagedRegionPtr>& regions) noexcept;
+
 inline std::ostream& operator<<(std::ostream& os, const RegionEvent& event)
 {
     switch (event) {
@@ -114,6 +150,10 @@ inline std::ostream& operator<<(std::ostream& os, const RegionEvent& event)
             return os << "destroyed";
         case RegionEvent::local_only:
             return os << "local_only";
+        case RegionEvent::initialized:
+            return os << "initialized";
+        case RegionEvent::resized:
+            return os << "resized";
         default:
             return os << "unrecognized event";
     }
@@ -135,8 +175,26 @@ struct RegionConfig
     int64_t userFlags = 0; /// custom flags that have no effect on the transport, but can be retrieved from the region by the user
     uint64_t size = 0; /// region size
     std::string path = ""; /// file path, if the region is backed by a file
+    bool hugepages = false; /// back the region with huge pages (shmem: file on the hugetlbfs mount in path, default /dev/hugepages/; zeromq: MAP_HUGETLB)
     std::optional<uint16_t> id = std::nullopt; /// region id
+    int numaNode = -1; /// NUMA node to bind the region memory and its ack threads to (shmem only, -1: no binding)
     uint32_t linger = 100; /// delay in ms before region destruction to collect outstanding events
+    uint32_t ackBunchSize = 256; /// maximum number of block acknowledgements sent to the region owner together (shmem only)
+    uint32_t ackMaxDelayUs = 500000; /// maximum time in us an incomplete bunch of acknowledgements waits before it is sent (shmem only)
+    bool ackAdaptive = false; /// send acknowledgements immediately while the region owner keeps up, bunch them only under load (shmem only)
+    bool ackRing = false; /// return acknowledgements through a lock-free shared memory ring instead of a message queue (shmem only)
+    uint32_t ackCallbackThreads = 0; /// number of threads executing the region callbacks concurrently, 0: the ack receiver thread (shmem only)
+    RegionAckSharding ackSharding = RegionAckSharding::none; /// distribution of the blocks over the callback threads (shmem only)
+    uint32_t refCountSlots = 1024; /// ref counters reserved with the region for copied messages, when exhausted (or 0) they are allocated in the managed segment (shmem only)
+    bool gpuRegister = false; /// page-lock the region and register it with the GPU runtime (cudaHostRegister/hipHostRegister), in every process mapping it (requires BUILD_GPU_REGIONS)
+    bool memfd = false; /// back the region with an anonymous memory file (memfd_create) instead of a named object, opened by the other processes via the file descriptor of the creator and freed by the kernel when the last process unmaps it. Cannot be combined with path and removeOnDestruction = false (shmem only, Linux)
+    int fd = -1; /// map size bytes at fdOffset of this file descriptor (e.g. the DMA buffer of a device driver) instead of allocating the region memory. The descriptor stays owned by the caller and has to stay open while the region exists, other processes of the session map it via /proc/<pid>/fd/<fd>. Cannot be combined with path, memfd, hugepages and gpuDevice (shmem, zeromq; Linux)
+    uint64_t fdOffset = 0; /// offset of the region in fd, a multiple of the page size
+    bool ringBuffer = false; /// fill the region sequentially with UnmanagedRegion::Allocate() and acknowledge the blocks cumulatively (no region callbacks, no per-block acks). Cannot be combined with gpuDevice (shmem only)
+    bool crossHost = false; /// the memory of fd (e.g. a CXL DAX device) is shared with another host, which registers the same window with the same region id in its session: blocks are released to a ring state in the window behind the region. The host filling the region sets ringBuffer, the other one not (shmem only)
+    uint64_t slotSize = 0; /// divide the region into slots of this size (aligned to 64 bytes), allocated with UnmanagedRegion::Allocate() by any process of the session from a lock-free free list in the region. Released slots go straight back to it (no region callbacks, no acks, no ack threads). Cannot be combined with ringBuffer, crossHost and gpuDevice (shmem only, 0: no slots)
+    uint64_t maxSize = 0; /// make the region resizable up to this size (UnmanagedRegion::Resize()): address space for maxSize bytes is reserved in every process mapping the region, memory is only committed for the current size. Cannot be combined with path, hugepages, memfd, fd, gpuDevice, gpuRegister, ringBuffer, crossHost and slotSize (shmem only, 0: fixed size)
+    int gpuDevice = -1; /// allocate the region in the memory of this GPU device instead of host memory, shared with other processes via IPC handles (shmem only, requires BUILD_GPU_REGIONS, -1: host memory)
 };
 
 }   // namespace fair::mq
@@ -10,20 +10,38 @@
 #define FAIR_MQ_BENCHMARKSAMPLER_H
 
 #include <fairmq/Device.h>
+#include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/Latency.h>
 #include <fairmq/tools/RateLimit.h>
+#include <fairmq/tools/Strings.h>
 
+#include <algorithm> // max
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>   // size_t
 #include <cstdint>   // uint64_t
 #include <cstring>   // memset
 #include <fairlogger/Logger.h>
+#include <functional> // hash
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace fair::mq
 {
 
 /**
  * Sampler to generate traffic for benchmarking.
+ * With --latency every message (the first part) starts with a tools::LatencyStamp, evaluated by the Sink.
+ * With --use-region the messages are slots of an unmanaged region, recycled when the transport returns them
+ * via the bulk region callback (so that the acknowledgement path is measured under load).
+ * With --threads N the traffic is generated by N threads, each sending on its own sub-channels (--all-subchannels
+ * drives all sub-channels of the output channel, distributed round-robin over the threads), to measure allocator
+ * contention and multi-producer scaling. --msg-rate is divided among the threads.
  */
 
 class BenchmarkSampler : public Device
@@ -37,30 +55,122 @@ class BenchmarkSampler : public Device
         fMsgSize = fConfig->GetProperty<size_t>("msg-size");
         fMsgAlignment = fConfig->GetProperty<size_t>("msg-alignment");
         fMsgRate = fConfig->GetProperty<float>("msg-rate");
+        fMsgRateMode = tools::ParseRateLimitMode(fConfig->GetProperty<std::string>("msg-rate-mode", "adaptive"));
+        fMsgRateBurst = fConfig->GetProperty<unsigned int>("msg-rate-burst", 1);
         fMaxIterations = fConfig->GetProperty<uint64_t>("max-iterations");
         fOutChannelName = fConfig->GetProperty<std::string>("out-channel");
+        fLatency = fConfig->GetProperty<bool>("latency", false);
+        fLatencyClock = tools::ParseLatencyClock(fConfig->GetProperty<std::string>("latency-clock", "monotonic"));
+        fSource = std::hash<std::string>()(GetId());
+        fUseRegion = fConfig->GetProperty<bool>("use-region", false);
+        fNumThreads = std::max(fConfig->GetProperty<size_t>("threads", 1), size_t(1));
+        fRegionPerThread = fConfig->GetProperty<bool>("region-per-thread", false);
+
+        fOutChannels.clear();
+        const size_t numSubChannels = fConfig->GetProperty<bool>("all-subchannels", false) ? GetNumSubChannels(fOutChannelName) : 1;
+        for (size_t i = 0; i < numSubChannels; ++i) {
+            fOutChannels.push_back(GetChannelRef(fOutChannelName, static_cast<int>(i)));
+        }
+        fOutChannel = fOutChannels.front();
+
+        if (fLatency && fMsgSize < sizeof(tools::LatencyStamp)) {
+            LOG(error) << "--latency requires a message size of at least " << sizeof(tools::LatencyStamp) << " bytes";
+            throw std::runtime_error(tools::ToString("--latency requires a message size of at least ", sizeof(tools::LatencyStamp), " bytes"));
+        }
+        // sockets are not thread-safe, every thread needs sub-channels of its own
+        if (fNumThreads > fOutChannels.size()) {
+            LOG(error) << "--threads " << fNumThreads << " requires as many sub-channels of " << fOutChannelName << " (with --all-subchannels), it has " << GetNumSubChannels(fOutChannelName);
+            throw std::runtime_error(tools::ToString("--threads ", fNumThreads, " requires as many sub-channels of ", fOutChannelName, " (with --all-subchannels), it has ", GetNumSubChannels(fOutChannelName)));
+        }
+
+        fRegions.clear();
+        if (fUseRegion) {
+            const size_t numRegions = fRegionPerThread ? fNumThreads : 1;
+            for (size_t i = 0; i < numRegions; ++i) {
+                fRegions.push_back(InitRegion(fConfig->GetProperty<size_t>("region-size", 0)));
+            }
+        }
     }
 
     void Run() override
     {
-        // store the channel reference to avoid traversing the map on every loop iteration
-        Channel& dataOutChannel = GetChannel(fOutChannelName, 0);
-
-        LOG(info) << "Starting the benchmark with message size of " << fMsgSize << " and " << fMaxIterations << " iterations.";
+        LOG(info) << "Starting the benchmark with message size of " << fMsgSize << " and " << fMaxIterations << " iterations"
+                  << " (" << fNumThreads << " thread(s), " << fOutChannels.size() << " sub-channel(s)).";
         auto tStart = std::chrono::high_resolution_clock::now();
 
-        fair::mq::tools::RateLimiter rateLimiter(fMsgRate);
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < fNumThreads; ++t) {
+            threads.emplace_back(&BenchmarkSampler::Produce, this, t);
+        }
+        Produce(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        auto tEnd = std::chrono::high_resolution_clock::now();
+
+        LOG(info) << "Done " << fNumIterations << " iterations in " << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << "ms.";
+
+        for (auto& region : fRegions) {
+            WaitForAcks(*region);
+        }
+    }
+
+    void ResetTask() override
+    {
+        fRegions.clear();
+        fOutChannels.clear();
+    }
+
+  protected:
+    /// region with its free slots, shared by all threads or one per thread (--region-per-thread)
+    struct RegionSlots
+    {
+        UnmanagedRegionPtr fRegion;
+        size_t fNumSlots = 0;
+        std::mutex fSlotsMtx;
+        std::condition_variable fSlotsCV;
+        std::vector<size_t> fFreeSlots; // region slot indices, used as message hints
+        uint64_t fNumAcks = 0;
+    };
+
+    /// send loop of one thread, on the sub-channels thread, thread + fNumThreads, ... in turn
+    void Produce(size_t thread)
+    {
+        std::vector<Channel*> channels;
+        for (size_t i = thread; i < fOutChannels.size(); i += fNumThreads) {
+            channels.push_back(&*fOutChannels[i]);
+        }
+        RegionSlots* region = fRegions.empty() ? nullptr : fRegions[fRegionPerThread ? thread : 0].get();
+        // sequence numbers of the latency stamps are per thread
+        const uint64_t source = fSource + thread;
+        uint64_t seq = 0;
+        size_t next = 0;
+
+        fair::mq::tools::RateLimiter rateLimiter(fMsgRate / fNumThreads, fMsgRateMode, fMsgRateBurst);
 
         while (!NewStatePending()) {
+            Channel& dataOutChannel = *channels[next];
+            next = (next + 1) % channels.size();
+
             if (fMultipart) {
                 Parts parts;
+                if (region) {
+                    if (!NewRegionMessages(dataOutChannel, *region, parts, fNumParts)) {
+                        continue;
+                    }
+                } else {
+                    parts = Parts(dataOutChannel.NewMessages(fNumParts, fMsgSize, fair::mq::Alignment{fMsgAlignment}));
+                }
 
-                for (size_t i = 0; i < fNumParts; ++i) {
-                    parts.AddPart(dataOutChannel.NewMessage(fMsgSize, fair::mq::Alignment{fMsgAlignment}));
-                    if (fMemSet) {
-                        std::memset(parts.At(i)->GetData(), 0, parts.At(i)->GetSize());
+                if (fMemSet) {
+                    for (auto& part : parts) {
+                        std::memset(part->GetData(), 0, part->GetSize());
                     }
                 }
+                if (fLatency) {
+                    tools::LatencyStamp::Write(parts[0].GetData(), fLatencyClock, source, seq);
+                }
 
                 if (dataOutChannel.Send(parts) >= 0) {
                     if (fMaxIterations > 0) {
@@ -69,12 +179,25 @@ class BenchmarkSampler : public Device
                         }
                     }
                     ++fNumIterations;
+                    ++seq;
                 }
             } else {
-                MessagePtr msg(dataOutChannel.NewMessage(fMsgSize, fair::mq::Alignment{fMsgAlignment}));
+                MessagePtr msg;
+                if (region) {
+                    Parts parts;
+                    if (!NewRegionMessages(dataOutChannel, *region, parts, 1)) {
+                        continue;
+                    }
+                    msg = std::move(parts.At(0));
+                } else {
+                    msg = dataOutChannel.NewMessage(fMsgSize, fair::mq::Alignment{fMsgAlignment});
+                }
                 if (fMemSet) {
                     std::memset(msg->GetData(), 0, msg->GetSize());
                 }
+                if (fLatency) {
+                    tools::LatencyStamp::Write(msg->GetData(), fLatencyClock, source, seq);
+                }
 
                 if (dataOutChannel.Send(msg) >= 0) {
                     if (fMaxIterations > 0) {
@@ -83,6 +206,7 @@ class BenchmarkSampler : public Device
                         }
                     }
                     ++fNumIterations;
+                    ++seq;
                 }
             }
 
@@ -90,22 +214,98 @@ class BenchmarkSampler : public Device
                 rateLimiter.maybe_sleep();
             }
         }
+    }
 
-        auto tEnd = std::chrono::high_resolution_clock::now();
+    /// create a region with slots of msg-size bytes (rounded up to msg-alignment), regionSize 0: 128 slots per part
+    std::unique_ptr<RegionSlots> InitRegion(size_t regionSize)
+    {
+        fSlotSize = fMsgSize;
+        if (fMsgAlignment > 0 && fSlotSize % fMsgAlignment != 0) {
+            fSlotSize += fMsgAlignment - fSlotSize % fMsgAlignment;
+        }
+        fSlotSize = std::max(fSlotSize, size_t(1));
+        size_t numParts = fMultipart ? fNumParts : 1;
+        if (regionSize == 0) {
+            regionSize = fSlotSize * 128 * numParts;
+        }
+        size_t numSlots = regionSize / fSlotSize;
+        if (numSlots < numParts) {
+            LOG(error) << "--region-size of " << regionSize << " bytes does not fit " << numParts << " parts of " << fSlotSize << " bytes";
+            throw std::runtime_error(tools::ToString("--region-size of ", regionSize, " bytes does not fit ", numParts, " parts of ", fSlotSize, " bytes"));
+        }
 
-        LOG(info) << "Done " << fNumIterations << " iterations in " << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << "ms.";
+        auto slots = std::make_unique<RegionSlots>();
+        slots->fFreeSlots.reserve(numSlots);
+        for (size_t i = numSlots; i > 0; --i) {
+            slots->fFreeSlots.push_back(i - 1);
+        }
+        slots->fNumSlots = numSlots;
+
+        RegionSlots* s = slots.get();
+        slots->fRegion = NewUnmanagedRegionFor(fOutChannel, numSlots * fSlotSize, [s](const std::vector<RegionBlock>& blocks) {
+            {
+                std::lock_guard<std::mutex> lock(s->fSlotsMtx);
+                for (const auto& block : blocks) {
+                    s->fFreeSlots.push_back(reinterpret_cast<size_t>(block.hint));
+                }
+                s->fNumAcks += blocks.size();
+            }
+            s->fSlotsCV.notify_one();
+        }, RegionConfig());
+        LOG(info) << "Sending from an unmanaged region of " << numSlots << " slots of " << fSlotSize << " bytes";
+        return slots;
+    }
+
+    /// add n messages in free slots of the region to parts, waiting for acknowledgements if necessary
+    /// @return false if no slots became free within 100ms (parts unchanged)
+    bool NewRegionMessages(Channel& channel, RegionSlots& region, Parts& parts, size_t n)
+    {
+        std::vector<size_t> slots;
+        {
+            std::unique_lock<std::mutex> lock(region.fSlotsMtx);
+            if (!region.fSlotsCV.wait_for(lock, std::chrono::milliseconds(100), [&]() { return region.fFreeSlots.size() >= n; })) {
+                return false;
+            }
+            slots.assign(region.fFreeSlots.end() - n, region.fFreeSlots.end());
+            region.fFreeSlots.resize(region.fFreeSlots.size() - n);
+        }
+        for (size_t slot : slots) {
+            parts.AddPart(channel.NewMessage(region.fRegion, static_cast<char*>(region.fRegion->GetData()) + slot * fSlotSize, fMsgSize, reinterpret_cast<void*>(slot)));
+        }
+        return true;
+    }
+
+    void WaitForAcks(RegionSlots& region)
+    {
+        std::unique_lock<std::mutex> lock(region.fSlotsMtx);
+        while (region.fFreeSlots.size() < region.fNumSlots && !NewStatePending()) {
+            region.fSlotsCV.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        LOG(info) << "Received " << region.fNumAcks << " acknowledgements, " << region.fNumSlots - region.fFreeSlots.size() << " region slots still in use.";
     }
 
-  protected:
     bool fMultipart = false;
     bool fMemSet = false;
     size_t fNumParts = 1;
     size_t fMsgSize = 10000;
     size_t fMsgAlignment = 0;
     float fMsgRate = 0;
-    uint64_t fNumIterations = 0;
+    tools::RateLimitMode fMsgRateMode = tools::RateLimitMode::adaptive;
+    unsigned int fMsgRateBurst = 1;
+    std::atomic<uint64_t> fNumIterations = 0;
     uint64_t fMaxIterations = 0;
     std::string fOutChannelName;
+    SubChannelRef fOutChannel;
+    std::vector<SubChannelRef> fOutChannels; // driven sub-channels
+    size_t fNumThreads = 1;
+    bool fLatency = false;
+    tools::LatencyClock fLatencyClock = tools::LatencyClock::monotonic;
+    uint64_t fSource = 0;
+
+    bool fUseRegion = false;
+    bool fRegionPerThread = false;
+    std::vector<std::unique_ptr<RegionSlots>> fRegions;
+    size_t fSlotSize = 0;
 };
 
 } // namespace fair::mq
@@ -0,0 +1,253 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_FILESOURCE_H
+#define FAIR_MQ_FILESOURCE_H
+
+#include <fairmq/Device.h>
+#include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/RateLimit.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+#include <algorithm> // min
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <cstring>   // memcpy, strerror
+#include <fairlogger/Logger.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fair::mq
+{
+
+/**
+ * Replays a recorded file (e.g. written by the Sink) on the output channel, the counterpart of the Sink file output.
+ *
+ * The file is memory mapped. Without --index-file it is sent in messages of --msg-size bytes, with an index file
+ * every (non-empty, non-#) line of the index describes one message as whitespace separated part sizes in bytes,
+ * the parts following each other in the file.
+ * With --playback-mode copy every part is copied from the mapping into a new message of the channel transport.
+ * With --playback-mode region the file is loaded into an unmanaged region once (optionally on huge pages) and the
+ * messages refer to the region, so that the playback itself does not copy.
+ * The messages are sent at --msg-rate (0: as fast as possible), the file is replayed --loops times (0: endlessly).
+ */
+class FileSource : public Device
+{
+  protected:
+    std::string fInFilename;
+    std::string fIndexFilename;
+    std::string fOutChannelName;
+    SubChannelRef fOutChannel;
+    bool fUseRegion = false;
+    bool fHugePages = false;
+    size_t fMsgSize = 1000000;
+    float fMsgRate = 0;
+    uint64_t fLoops = 1;
+    std::vector<std::vector<size_t>> fMessages; // part sizes of every message
+    const char* fData = nullptr; // mapping of the file (copy mode)
+    size_t fFileSize = 0;
+    UnmanagedRegionPtr fRegion;
+    std::atomic<uint64_t> fNumUnacked{0};
+    uint64_t fNumSent = 0;
+    uint64_t fBytesSent = 0;
+
+    void InitTask() override
+    {
+        fInFilename = fConfig->GetProperty<std::string>("in-filename");
+        fIndexFilename = fConfig->GetProperty<std::string>("index-file");
+        fOutChannelName = fConfig->GetProperty<std::string>("out-channel");
+        fOutChannel = GetChannelRef(fOutChannelName, 0);
+        fMsgSize = fConfig->GetProperty<size_t>("msg-size");
+        fMsgRate = fConfig->GetProperty<float>("msg-rate");
+        fLoops = fConfig->GetProperty<uint64_t>("loops");
+        fHugePages = fConfig->GetProperty<bool>("region-hugepages", false);
+        std::string mode = fConfig->GetProperty<std::string>("playback-mode");
+        if (mode != "copy" && mode != "region") {
+            LOG(error) << "Invalid playback mode '" << mode << "', valid are 'copy' and 'region'";
+            throw std::runtime_error(tools::ToString("Invalid playback mode '", mode, "', valid are 'copy' and 'region'"));
+        }
+        fUseRegion = mode == "region";
+        if (fInFilename.empty()) {
+            LOG(error) << "No file to replay given (--in-filename)";
+            throw std::runtime_error("No file to replay given (--in-filename)");
+        }
+        fNumSent = 0;
+        fBytesSent = 0;
+
+        MapFile();
+        if (fIndexFilename.empty()) {
+            if (fMsgSize == 0) {
+                throw std::runtime_error("--msg-size has to be at least 1 without --index-file");
+            }
+            for (size_t offset = 0; offset < fFileSize; offset += fMsgSize) {
+                fMessages.push_back({std::min(fMsgSize, fFileSize - offset)});
+            }
+        } else {
+            ReadIndex();
+        }
+
+        if (fUseRegion) {
+            RegionConfig cfg;
+            cfg.hugepages = fHugePages;
+            fRegion = NewUnmanagedRegionFor(fOutChannel, fFileSize, [this](const std::vector<RegionBlock>& blocks) {
+                fNumUnacked -= blocks.size();
+            }, cfg);
+            std::memcpy(fRegion->GetData(), fData, fFileSize);
+            UnmapFile();
+        }
+        LOG(info) << "Replaying " << fMessages.size() << " messages (" << fFileSize << " bytes) of '" << fInFilename << "' from "
+                  << (fUseRegion ? "an unmanaged region" : "the file mapping");
+    }
+
+    void Run() override
+    {
+        Channel& dataOutChannel = *fOutChannel;
+
+        tools::RateLimiter rateLimiter(fMsgRate);
+        auto tStart = std::chrono::steady_clock::now();
+
+        for (uint64_t loop = 0; (fLoops == 0 || loop < fLoops) && !NewStatePending(); ++loop) {
+            size_t offset = 0;
+            for (const auto& sizes : fMessages) {
+                if (NewStatePending()) {
+                    break;
+                }
+                Parts parts;
+                for (size_t size : sizes) {
+                    parts.AddPart(NewPart(dataOutChannel, offset, size));
+                    offset += size;
+                }
+                if (fUseRegion) {
+                    fNumUnacked += parts.Size();
+                }
+                int64_t bytes = parts.Size() == 1 ? dataOutChannel.Send(parts.At(0)) : dataOutChannel.Send(parts);
+                if (bytes >= 0) {
+                    ++fNumSent;
+                    fBytesSent += bytes;
+                }
+                if (fMsgRate > 0) {
+                    rateLimiter.maybe_sleep();
+                }
+            }
+        }
+
+        auto sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+        LOG(info) << "Sent " << fNumSent << " messages (" << fBytesSent << " bytes) in " << sec * 1000. << "ms ("
+                  << (fBytesSent / (1000. * 1000.)) / sec << " MB/s)";
+
+        if (fUseRegion) {
+            // the region has to outlive the messages that refer to it
+            while (fNumUnacked > 0 && !NewStatePending()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            if (fNumUnacked > 0) {
+                LOG(info) << "Done, still not acknowledged: " << fNumUnacked;
+            }
+        }
+    }
+
+    void ResetTask() override
+    {
+        fRegion.reset();
+        UnmapFile();
+        fMessages.clear();
+    }
+
+    MessagePtr NewPart(Channel& channel, size_t offset, size_t size)
+    {
+        if (size == 0) {
+            return channel.NewMessage();
+        }
+        if (fUseRegion) {
+            return channel.NewMessage(fRegion, static_cast<char*>(fRegion->GetData()) + offset, size);
+        }
+        MessagePtr msg(channel.NewMessage(size));
+        std::memcpy(msg->GetData(), fData + offset, size);
+        return msg;
+    }
+
+    void MapFile()
+    {
+        int fd = open(fInFilename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            LOG(error) << "Could not open '" << fInFilename << "': " << strerror(errno);
+            throw std::runtime_error(tools::ToString("Could not open '", fInFilename, "': ", strerror(errno)));
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            LOG(error) << "'" << fInFilename << "' is empty or cannot be read";
+            throw std::runtime_error(tools::ToString("'", fInFilename, "' is empty or cannot be read"));
+        }
+        fFileSize = static_cast<size_t>(st.st_size);
+        void* ptr = mmap(nullptr, fFileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            LOG(error) << "Could not map '" << fInFilename << "': " << strerror(errno);
+            throw std::runtime_error(tools::ToString("Could not map '", fInFilename, "': ", strerror(errno)));
+        }
+        madvise(ptr, fFileSize, MADV_SEQUENTIAL);
+        fData = static_cast<const char*>(ptr);
+    }
+
+    void UnmapFile()
+    {
+        if (fData) {
+            munmap(const_cast<char*>(fData), fFileSize);
+            fData = nullptr;
+        }
+    }
+
+    void ReadIndex()
+    {
+        std::ifstream index(fIndexFilename);
+        if (!index) {
+            LOG(error) << "Could not open index '" << fIndexFilename << "'";
+            throw std::runtime_error(tools::ToString("Could not open index '", fIndexFilename, "'"));
+        }
+        size_t total = 0;
+        std::string line;
+        while (std::getline(index, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#') {
+                continue;
+            }
+            std::istringstream parts(line);
+            std::vector<size_t> sizes;
+            size_t size = 0;
+            while (parts >> size) {
+                sizes.push_back(size);
+                total += size;
+            }
+            if (!parts.eof() || sizes.empty()) {
+                LOG(error) << "Invalid line in index '" << fIndexFilename << "': '" << line << "'";
+                throw std::runtime_error(tools::ToString("Invalid line in index '", fIndexFilename, "': '", line, "'"));
+            }
+            fMessages.push_back(std::move(sizes));
+        }
+        if (total > fFileSize) {
+            LOG(error) << "Index '" << fIndexFilename << "' describes " << total << " bytes, but '" << fInFilename << "' has only " << fFileSize;
+            throw std::runtime_error(tools::ToString("Index '", fIndexFilename, "' describes ", total, " bytes, but '", fInFilename, "' has only ", fFileSize));
+        }
+    }
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_FILESOURCE_H */
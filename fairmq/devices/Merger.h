@@ -11,26 +11,136 @@
 
 #include <fairmq/Poller.h>
 #include <fairmq/Device.h>
+#include <fairmq/tools/Strings.h>
 
+#include <algorithm> // lower_bound, minmax_element
+#include <chrono>
+#include <cstdint>
+#include <cstring> // memcpy
 #include <fairlogger/Logger.h>
+#include <functional> // greater
+#include <queue>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility> // pair
 #include <vector>
 
 namespace fair::mq
 {
 
+/// Forwards the messages of all input subchannels to the output channel.
+///
+/// --merge-mode index (default): one message per ready input and poll, in index order.
+/// --merge-mode round-robin: up to weight (--input-weights, default 1) messages per ready input and round,
+/// the round starts after the input served last, so that no input is preferred by its index.
+/// --merge-mode timestamp: k-way merge in the order of the key returned by GetMergeKey() (by default the first
+/// 8 bytes of the (first part's) payload). A message is forwarded once every input has a message queued,
+/// inputs without a message for longer than --merge-timeout ms are not waited for.
+/// --merge-mode sequence: restores the order of a stream that has been split over parallel workers, with GetMergeKey()
+/// as the sequence number (consecutive, starting at --first-sequence). The messages of all inputs are kept (moved, not
+/// copied) in a reorder window of --reorder-window slots and forwarded in sequence. A missing message is not waited for
+/// once the window has held later ones for --reorder-timeout ms, or once a message does not fit into the window any more;
+/// messages that arrive after their sequence number has been skipped or forwarded are dropped. The skipped numbers, the
+/// dropped messages and the window occupancy are logged every --report-interval seconds and at the end.
+///
+/// With --batch-size (bytes) and/or --batch-count (messages) the forwarded messages are collected (moved, not copied)
+/// into one multipart message, sent when either threshold is reached or the oldest message has waited --batch-timeout ms.
+/// Batches of multipart inputs start with an index part (uint32_t number of parts of every bundled message), the
+/// receiver keeps the batch or splits it with Unbundle().
 class Merger : public Device
 {
+  public:
+    /// split a batch of the merger into the original messages
+    /// @param multipart the merger handled multipart messages (the batch starts with the index part)
+    /// @throw std::runtime_error if the index does not match the batch
+    static std::vector<Parts> Unbundle(Parts& batch, bool multipart)
+    {
+        std::vector<Parts> msgs;
+        if (!multipart) {
+            for (auto& part : batch) {
+                msgs.emplace_back(std::move(part));
+            }
+            return msgs;
+        }
+        if (batch.Size() == 0 || batch[0].GetSize() % sizeof(uint32_t) != 0) {
+            throw std::runtime_error("Invalid merger batch, no index part");
+        }
+        std::vector<uint32_t> counts(batch[0].GetSize() / sizeof(uint32_t));
+        std::memcpy(counts.data(), batch[0].GetData(), batch[0].GetSize());
+        size_t next = 1;
+        for (uint32_t count : counts) {
+            if (next + count > batch.Size()) {
+                throw std::runtime_error(tools::ToString("Invalid merger batch, index of ", counts.size(), " messages does not match its ", batch.Size() - 1, " parts"));
+            }
+            Parts msg;
+            for (uint32_t p = 0; p < count; ++p) {
+                msg.AddPart(std::move(batch.At(next++)));
+            }
+            msgs.push_back(std::move(msg));
+        }
+        return msgs;
+    }
+
   protected:
     bool fMultipart = true;
     std::string fInChannelName{"data-in"};
     std::string fOutChannelName{"data-out"};
+    ChannelRef fInChannel;
+    SubChannelRef fOutChannel;
+    std::string fMergeMode{"index"};
+    std::vector<int> fWeights; // per input, messages per round in round-robin mode
+    std::chrono::milliseconds fMergeTimeout{10};
+    std::vector<uint64_t> fNumReceived; // per input
+    int fNextInput = 0;
+    size_t fBatchSize = 0;  // bytes, 0: no limit
+    size_t fBatchCount = 0; // messages, 0: no limit
+    std::chrono::milliseconds fBatchTimeout{10};
+    Parts fBatch;
+    std::vector<uint32_t> fBatchIndex; // parts per bundled message
+    size_t fBatchBytes = 0;
+    std::chrono::steady_clock::time_point fBatchStart;
+    uint64_t fNumBatches = 0;
+    // sequence mode
+    size_t fReorderWindow = 1024;
+    std::chrono::milliseconds fReorderTimeout{100};
+    uint64_t fFirstSequence = 0;
+    std::chrono::seconds fReportInterval{0};
+    uint64_t fNumSkipped = 0;    // sequence numbers not waited for
+    uint64_t fNumLate = 0;       // messages dropped, sequence number already skipped or forwarded
+    uint64_t fNumDuplicate = 0;  // messages dropped, sequence number already in the window
+    size_t fMaxOccupancy = 0;
 
     void InitTask() override
     {
         fMultipart = fConfig->GetProperty<bool>("multipart");
         fInChannelName = fConfig->GetProperty<std::string>("in-channel");
         fOutChannelName = fConfig->GetProperty<std::string>("out-channel");
+        fMergeMode = fConfig->GetProperty<std::string>("merge-mode", "index");
+        fWeights = fConfig->GetProperty<std::vector<int>>("input-weights", std::vector<int>());
+        fMergeTimeout = std::chrono::milliseconds(fConfig->GetProperty<int>("merge-timeout", 10));
+        fBatchSize = fConfig->GetProperty<size_t>("batch-size", 0);
+        fBatchCount = fConfig->GetProperty<size_t>("batch-count", 0);
+        fBatchTimeout = std::chrono::milliseconds(fConfig->GetProperty<int>("batch-timeout", 10));
+        fReorderWindow = fConfig->GetProperty<size_t>("reorder-window", 1024);
+        fReorderTimeout = std::chrono::milliseconds(fConfig->GetProperty<int>("reorder-timeout", 100));
+        fFirstSequence = fConfig->GetProperty<uint64_t>("first-sequence", 0);
+        fReportInterval = std::chrono::seconds(fConfig->GetProperty<unsigned int>("report-interval", 0));
+        fInChannel = GetChannelRef(fInChannelName);
+        fOutChannel = GetChannelRef(fOutChannelName, 0);
+
+        if (fMergeMode != "index" && fMergeMode != "round-robin" && fMergeMode != "timestamp" && fMergeMode != "sequence") {
+            LOG(error) << "Invalid merge mode '" << fMergeMode << "', valid are 'index', 'round-robin', 'timestamp' and 'sequence'";
+            throw std::runtime_error(tools::ToString("Invalid merge mode '", fMergeMode, "', valid are 'index', 'round-robin', 'timestamp' and 'sequence'"));
+        }
+        if (fMergeMode == "sequence" && fReorderWindow < 1) {
+            LOG(error) << "The reorder window needs at least 1 slot";
+            throw std::runtime_error("The reorder window needs at least 1 slot");
+        }
+        if (std::any_of(fWeights.begin(), fWeights.end(), [](int w) { return w < 1; })) {
+            LOG(error) << "Input weights have to be at least 1";
+            throw std::runtime_error("Input weights have to be at least 1");
+        }
     }
 
     void RegisterChannelEndpoints() override
@@ -43,60 +153,423 @@ class Merger : public Device
 
     void Run() override
     {
-        int numInputs = GetNumSubChannels(fInChannelName);
+        int numInputs = fInChannel.size();
 
         std::vector<Channel*> chans;
 
-        for (auto& chan : GetChannels().at(fInChannelName)) {
+        for (auto& chan : fInChannel) {
             chans.push_back(&chan);
         }
 
         PollerPtr poller(NewPoller(chans));
 
+        // missing weights default to 1
+        fWeights.resize(numInputs, 1);
+        fNumReceived.assign(numInputs, 0);
+        fNextInput = 0;
+
+        fBatch = Parts();
+        fBatchIndex.clear();
+        fBatchBytes = 0;
+        fNumBatches = 0;
+
         if (fMultipart) {
-            while (!NewStatePending()) {
-                poller->Poll(100);
-
-                // Loop over the data input channels.
-                for (int i = 0; i < numInputs; ++i) {
-                    // Check if the channel has data ready to be received.
-                    if (poller->CheckInput(i)) {
-                        Parts payload;
-
-                        if (Receive(payload, fInChannelName, i) >= 0) {
-                            if (Send(payload, fOutChannelName) < 0) {
-                                LOG(debug) << "Transfer interrupted";
-                                break;
-                            }
-                        } else {
-                            LOG(debug) << "Transfer interrupted";
-                            break;
-                        }
+            Merge<Parts>(*poller, numInputs);
+        } else {
+            Merge<MessagePtr>(*poller, numInputs);
+        }
+        const size_t pending = fBatchIndex.size();
+        if (FlushBatch() < 0) {
+            LOG(debug) << "Last batch of " << pending << " messages not sent, transfer interrupted";
+        }
+
+        ReportFairness();
+        if (fMergeMode == "sequence") {
+            ReportSequence(0);
+        }
+        if (Batching()) {
+            LOG(info) << "Sent " << fNumBatches << " batches";
+        }
+    }
+
+    /// Key for the timestamp ordered merge and sequence number in sequence mode, by default the first 8 bytes of the payload (0 if smaller)
+    virtual uint64_t GetMergeKey(const MessagePtr& msg)
+    {
+        uint64_t key = 0;
+        if (msg->GetSize() >= sizeof(key)) {
+            std::memcpy(&key, msg->GetData(), sizeof(key));
+        }
+        return key;
+    }
+
+    /// Key for the timestamp ordered merge of multipart messages, by default the key of the first part
+    virtual uint64_t GetMergeKey(const Parts& parts) { return GetMergeKey(parts.At(0)); }
+
+    template<typename T>
+    void Merge(Poller& poller, int numInputs)
+    {
+        if (fMergeMode == "timestamp") {
+            MergeOrdered<T>(poller, numInputs);
+            return;
+        }
+        if (fMergeMode == "sequence") {
+            MergeSequenced<T>(poller, numInputs);
+            return;
+        }
+
+        const bool roundRobin = (fMergeMode == "round-robin");
+        std::vector<int> ready;
+
+        while (!NewStatePending()) {
+            poller.Poll(BatchPollTimeout(100));
+            ReadyInputs(poller, numInputs, ready);
+            if (BatchExpired() && FlushBatch() < 0) {
+                LOG(debug) << "Transfer interrupted";
+                continue;
+            }
+            if (ready.empty()) {
+                continue;
+            }
+
+            // in round-robin mode the round starts after the input served last
+            size_t first = roundRobin ? std::lower_bound(ready.begin(), ready.end(), fNextInput) - ready.begin() : 0;
+            for (size_t n = 0; n < ready.size(); ++n) {
+                int i = ready[(first + n) % ready.size()];
+                int quota = roundRobin ? fWeights[i] : 1;
+                bool interrupted = false;
+                for (int q = 0; q < quota; ++q) {
+                    T payload;
+                    // the first message is ready, further ones are only taken if already queued
+                    if (ReceiveInput(payload, i, q == 0 ? -1 : 0) < 0) {
+                        interrupted = (q == 0);
+                        break;
                     }
+                    ++fNumReceived[i];
+                    if (Forward(payload) < 0) {
+                        interrupted = true;
+                        break;
+                    }
+                }
+                if (interrupted) {
+                    LOG(debug) << "Transfer interrupted";
+                    break;
                 }
+                fNextInput = i + 1;
             }
-        } else {
-            while (!NewStatePending()) {
-                poller->Poll(100);
-
-                // Loop over the data input channels.
-                for (int i = 0; i < numInputs; ++i) {
-                    // Check if the channel has data ready to be received.
-                    if (poller->CheckInput(i)) {
-                        MessagePtr payload(fTransportFactory->CreateMessage());
-
-                        if (Receive(payload, fInChannelName, i) >= 0) {
-                            if (Send(payload, fOutChannelName) < 0) {
-                                LOG(debug) << "Transfer interrupted";
-                                break;
-                            }
-                        } else {
-                            LOG(debug) << "Transfer interrupted";
-                            break;
-                        }
+        }
+    }
+
+    template<typename T>
+    void MergeOrdered(Poller& poller, int numInputs)
+    {
+        using Clock = std::chrono::steady_clock;
+        using Head = std::pair<uint64_t, int>; // key, input
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+        std::vector<T> heads(numInputs);
+        std::vector<bool> hasHead(numInputs, false);
+        std::vector<Clock::time_point> emptySince(numInputs, Clock::now());
+        std::vector<int> ready;
+
+        // @return true if a message of input i has been queued as its head
+        auto fill = [&](int i) {
+            if (ReceiveInput(heads[i], i, 0) < 0) {
+                emptySince[i] = Clock::now();
+                return false;
+            }
+            ++fNumReceived[i];
+            hasHead[i] = true;
+            heap.emplace(GetMergeKey(heads[i]), i);
+            return true;
+        };
+
+        int pollTimeout = 100;
+        while (!NewStatePending()) {
+            poller.Poll(BatchPollTimeout(pollTimeout));
+            ReadyInputs(poller, numInputs, ready);
+            if (BatchExpired() && FlushBatch() < 0) {
+                LOG(debug) << "Transfer interrupted";
+                continue;
+            }
+            bool filled = false;
+            for (int i : ready) {
+                if (!hasHead[i]) {
+                    filled = fill(i) || filled;
+                }
+            }
+            if (!filled && !ready.empty() && pollTimeout < 100) {
+                // only inputs with a head are ready, the poller would return immediately until the blocking input sends
+                WaitFor(std::chrono::microseconds(100));
+            }
+
+            // inputs without a head that are not yet idle block the merge
+            auto now = Clock::now();
+            auto deadline = Clock::time_point::max();
+            for (int i = 0; i < numInputs; ++i) {
+                if (!hasHead[i] && emptySince[i] + fMergeTimeout > now) {
+                    deadline = std::min(deadline, emptySince[i] + fMergeTimeout);
+                }
+            }
+
+            bool interrupted = false;
+            while (!heap.empty() && deadline == Clock::time_point::max()) {
+                int i = heap.top().second;
+                heap.pop();
+                hasHead[i] = false;
+                if (Forward(heads[i]) < 0) {
+                    interrupted = true;
+                    break;
+                }
+                if (!fill(i)) {
+                    deadline = emptySince[i] + fMergeTimeout;
+                }
+            }
+            if (interrupted) {
+                LOG(debug) << "Transfer interrupted";
+                continue;
+            }
+
+            // wait at most until the first blocking input becomes idle
+            pollTimeout = 100;
+            if (!heap.empty() && deadline != Clock::time_point::max()) {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count() + 1;
+                pollTimeout = static_cast<int>(std::clamp<decltype(wait)>(wait, 0, 100));
+            }
+        }
+    }
+
+    template<typename T>
+    void MergeSequenced(Poller& poller, int numInputs)
+    {
+        using Clock = std::chrono::steady_clock;
+        const size_t size = fReorderWindow;
+        std::vector<T> window(size); // message with sequence number s in slot s % size
+        std::vector<bool> present(size, false);
+        uint64_t next = fFirstSequence; // sequence number to forward next
+        size_t occupancy = 0;
+        Clock::time_point blockedSince; // since when the window holds messages behind a missing one
+        auto lastReport = Clock::now();
+        std::vector<int> ready;
+        fNumSkipped = 0;
+        fNumLate = 0;
+        fNumDuplicate = 0;
+        fMaxOccupancy = 0;
+
+        // forward the messages at the head of the window, @return false if interrupted
+        auto release = [&]() {
+            bool progress = false;
+            while (present[next % size]) {
+                present[next % size] = false;
+                --occupancy;
+                ++next;
+                progress = true;
+                if (Forward(window[(next - 1) % size]) < 0) {
+                    return false;
+                }
+            }
+            if (progress) {
+                blockedSince = Clock::now();
+            }
+            return true;
+        };
+        // skip the missing sequence numbers up to the first message in the window
+        auto skipGap = [&]() {
+            while (occupancy > 0 && !present[next % size]) {
+                ++next;
+                ++fNumSkipped;
+            }
+            return release();
+        };
+        // @return false if interrupted
+        auto insert = [&](T& payload) {
+            const uint64_t seq = GetMergeKey(payload);
+            if (seq < next) {
+                ++fNumLate;
+                return true;
+            }
+            if (seq - next >= size) {
+                // no slot before seq: give up the missing messages in front of the window, jump ahead if it is empty
+                while (occupancy > 0 && seq - next >= size) {
+                    if (!skipGap()) {
+                        return false;
+                    }
+                }
+                if (seq - next >= size) {
+                    fNumSkipped += seq - next - size + 1;
+                    next = seq - size + 1;
+                }
+            }
+            if (present[seq % size]) {
+                ++fNumDuplicate;
+                return true;
+            }
+            if (occupancy == 0) {
+                blockedSince = Clock::now();
+            }
+            window[seq % size] = std::move(payload);
+            present[seq % size] = true;
+            fMaxOccupancy = std::max(fMaxOccupancy, ++occupancy);
+            return release();
+        };
+
+        int pollTimeout = 100;
+        while (!NewStatePending()) {
+            poller.Poll(BatchPollTimeout(pollTimeout));
+            ReadyInputs(poller, numInputs, ready);
+            if (BatchExpired() && FlushBatch() < 0) {
+                LOG(debug) << "Transfer interrupted";
+                continue;
+            }
+            bool interrupted = false;
+            for (int i : ready) {
+                // take what is queued, up to a window per input, so that no input is starved
+                for (size_t n = 0; n < size && !interrupted; ++n) {
+                    T payload;
+                    if (ReceiveInput(payload, i, 0) < 0) {
+                        break;
                     }
+                    ++fNumReceived[i];
+                    interrupted = !insert(payload);
                 }
             }
+            if (!interrupted && occupancy > 0 && Clock::now() - blockedSince >= fReorderTimeout) {
+                interrupted = !skipGap();
+            }
+            if (interrupted) {
+                LOG(debug) << "Transfer interrupted";
+                continue;
+            }
+
+            // wait at most until the missing message is given up
+            pollTimeout = 100;
+            if (occupancy > 0) {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(blockedSince + fReorderTimeout - Clock::now()).count() + 1;
+                pollTimeout = static_cast<int>(std::clamp<decltype(wait)>(wait, 0, 100));
+            }
+            if (fReportInterval.count() > 0 && Clock::now() - lastReport >= fReportInterval) {
+                lastReport = Clock::now();
+                ReportSequence(occupancy);
+            }
+        }
+    }
+
+    /// log the skipped sequence numbers, dropped messages and the reorder window occupancy
+    void ReportSequence(size_t occupancy)
+    {
+        LOG(info) << "Reorder window: " << occupancy << "/" << fReorderWindow << " slots used (max " << fMaxOccupancy << "), "
+                  << fNumSkipped << " sequence numbers skipped, " << fNumLate << " late and " << fNumDuplicate << " duplicate messages dropped";
+    }
+
+    bool Batching() const { return fBatchSize > 0 || fBatchCount > 0; }
+
+    /// send the payload, or add it to the batch and send the batch if it is full
+    /// @return as Send(), 0 if only batched
+    template<typename T>
+    int64_t Forward(T& payload)
+    {
+        if (!Batching()) {
+            return Send(payload, fOutChannel);
+        }
+        if (fBatchIndex.empty()) {
+            fBatchStart = std::chrono::steady_clock::now();
+        }
+        if constexpr (std::is_same_v<T, MessagePtr>) {
+            fBatchBytes += payload->GetSize();
+            fBatchIndex.push_back(1);
+            fBatch.AddPart(std::move(payload));
+        } else {
+            for (const auto& part : payload) {
+                fBatchBytes += part->GetSize();
+            }
+            fBatchIndex.push_back(static_cast<uint32_t>(payload.Size()));
+            fBatch.AddPart(std::move(payload));
+        }
+        if ((fBatchSize > 0 && fBatchBytes >= fBatchSize) || (fBatchCount > 0 && fBatchIndex.size() >= fBatchCount)) {
+            return FlushBatch();
+        }
+        return 0;
+    }
+
+    /// send the collected messages as one multipart message (multipart inputs: preceded by the index part)
+    int64_t FlushBatch()
+    {
+        if (fBatchIndex.empty()) {
+            return 0;
+        }
+        int64_t result = 0;
+        if (fMultipart) {
+            Parts batch;
+            MessagePtr index(fOutChannel->NewMessage(fBatchIndex.size() * sizeof(uint32_t)));
+            std::memcpy(index->GetData(), fBatchIndex.data(), index->GetSize());
+            batch.AddPart(std::move(index));
+            batch.AddPart(std::move(fBatch));
+            result = Send(batch, fOutChannel);
+        } else {
+            result = Send(fBatch, fOutChannel);
+        }
+        fBatch = Parts();
+        fBatchIndex.clear();
+        fBatchBytes = 0;
+        if (result >= 0) {
+            ++fNumBatches;
+        }
+        return result;
+    }
+
+    bool BatchExpired() const { return !fBatchIndex.empty() && std::chrono::steady_clock::now() - fBatchStart >= fBatchTimeout; }
+
+    /// poll timeout bounded by the time until the batch expires
+    int BatchPollTimeout(int timeout) const
+    {
+        if (fBatchIndex.empty()) {
+            return timeout;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(fBatchStart + fBatchTimeout - std::chrono::steady_clock::now()).count();
+        return static_cast<int>(std::clamp<decltype(remaining)>(remaining, 0, timeout));
+    }
+
+    // fill ready with the inputs that have data, ascending
+    static void ReadyInputs(Poller& poller, int numInputs, std::vector<int>& ready)
+    {
+        if (!poller.ReadyInputs(ready)) {
+            ready.clear();
+            for (int i = 0; i < numInputs; ++i) {
+                if (poller.CheckInput(i)) {
+                    ready.push_back(i);
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    int64_t ReceiveInput(T& payload, int i, int timeout)
+    {
+        Channel& channel = *fInChannel[i];
+        if constexpr (std::is_same_v<T, MessagePtr>) {
+            payload = channel.NewMessage();
+        } else {
+            payload = Parts();
+        }
+        return timeout < 0 ? channel.Receive(payload) : channel.Receive(payload, timeout);
+    }
+
+    /// log the number of messages received per input and Jain's fairness index (1: all inputs equally served)
+    void ReportFairness()
+    {
+        if (fNumReceived.empty()) {
+            return;
+        }
+        double sum = 0;
+        double sumSquares = 0;
+        for (uint64_t n : fNumReceived) {
+            sum += n;
+            sumSquares += static_cast<double>(n) * n;
+        }
+        auto minmax = std::minmax_element(fNumReceived.begin(), fNumReceived.end());
+        double fairness = sumSquares > 0 ? (sum * sum) / (fNumReceived.size() * sumSquares) : 1.;
+        LOG(info) << "Merged " << static_cast<uint64_t>(sum) << " messages from " << fNumReceived.size() << " inputs"
+                  << " (per input min " << *minmax.first << ", max " << *minmax.second << ", fairness index " << fairness << ")";
+        for (size_t i = 0; i < fNumReceived.size(); ++i) {
+            LOG(debug) << fInChannelName << "[" << i << "]: " << fNumReceived[i] << " messages";
         }
     }
 };
@@ -24,6 +24,7 @@ class Multiplier : public Device
     int fNumOutputs = 0;
     std::string fInChannelName;
     std::vector<std::string> fOutChannelNames;
+    std::vector<ChannelRef> fOutChannels;
 
     void InitTask() override
     {
@@ -31,71 +32,35 @@ class Multiplier : public Device
         fInChannelName = fConfig->GetProperty<std::string>("in-channel");
         fOutChannelNames = fConfig->GetProperty<std::vector<std::string>>("out-channel");
         fNumOutputs = GetNumSubChannels(fOutChannelNames.at(0));
+        fOutChannels.clear();
+        for (const auto& name : fOutChannelNames) {
+            fOutChannels.push_back(GetChannelRef(name));
+        }
 
         if (fMultipart) {
-            OnData(fInChannelName, &Multiplier::HandleMultipartData);
+            OnData(fInChannelName, &Multiplier::HandleData<Parts>);
         } else {
-            OnData(fInChannelName, &Multiplier::HandleSingleData);
-        }
-    }
-
-
-    bool HandleSingleData(std::unique_ptr<Message>& payload, int)
-    {
-        for (unsigned int i = 0; i < fOutChannelNames.size() - 1; ++i) { // all except last channel
-            for (unsigned int j = 0; j < GetNumSubChannels(fOutChannelNames.at(i)); ++j) { // all subChannels in a channel
-                MessagePtr msgCopy(fTransportFactory->CreateMessage());
-                msgCopy->Copy(*payload);
-
-                Send(msgCopy, fOutChannelNames.at(i), j);
-            }
-        }
-
-        unsigned int lastChannelSize = GetNumSubChannels(fOutChannelNames.back());
-
-        for (unsigned int i = 0; i < lastChannelSize - 1; ++i) { // iterate over all except last subChannels of the last channel
-            MessagePtr msgCopy(fTransportFactory->CreateMessage());
-            msgCopy->Copy(*payload);
-
-            Send(msgCopy, fOutChannelNames.back(), i);
+            OnData(fInChannelName, &Multiplier::HandleData<MessagePtr>);
         }
-
-        Send(payload, fOutChannelNames.back(), lastChannelSize - 1); // send final message to last subChannel of last channel
-
-        return true;
     }
 
-    bool HandleMultipartData(Parts& payload, int)
+    // all outputs except the last one get copies sharing the payload (see Channel::SendCopy)
+    template<typename T>
+    bool HandleData(T& payload, int)
     {
-        for (unsigned int i = 0; i < fOutChannelNames.size() - 1; ++i) { // all except last channel
-            for (unsigned int j = 0; j < GetNumSubChannels(fOutChannelNames.at(i)); ++j) { // all subChannels in a channel
-                Parts parts;
-
-                for (unsigned int k = 0; k < payload.Size(); ++k) {
-                    MessagePtr msgCopy(fTransportFactory->CreateMessage());
-                    msgCopy->Copy(*(payload.At(k)));
-                    parts.AddPart(std::move(msgCopy));
-                }
-
-                Send(parts, fOutChannelNames.at(i), j);
+        for (unsigned int i = 0; i < fOutChannels.size() - 1; ++i) { // all except last channel
+            for (auto& subChannel : fOutChannels[i]) { // all subChannels in a channel
+                subChannel.SendCopy(payload);
             }
         }
 
-        unsigned int lastChannelSize = GetNumSubChannels(fOutChannelNames.back());
-
-        for (unsigned int i = 0; i < lastChannelSize - 1; ++i) { // iterate over all except last subChannels of the last channel
-            Parts parts;
-
-            for (unsigned int k = 0; k < payload.Size(); ++k) {
-                MessagePtr msgCopy(fTransportFactory->CreateMessage());
-                msgCopy->Copy(*(payload.At(k)));
-                parts.AddPart(std::move(msgCopy));
-            }
+        const ChannelRef& last = fOutChannels.back();
 
-            Send(parts, fOutChannelNames.back(), i);
+        for (unsigned int i = 0; i < last.size() - 1; ++i) { // iterate over all except last subChannels of the last channel
+            last[i]->SendCopy(payload);
         }
 
-        Send(payload, fOutChannelNames.back(), lastChannelSize - 1); // send final message to last subChannel of last channel
+        Send(payload, last[last.size() - 1]); // send final message to last subChannel of last channel
 
         return true;
     }
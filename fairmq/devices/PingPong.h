@@ -0,0 +1,229 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_PINGPONG_H
+#define FAIR_MQ_PINGPONG_H
+
+#include <fairmq/Device.h>
+#include <fairmq/tools/Latency.h>
+#include <fairmq/tools/Strings.h>
+
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <cstring>   // memcpy
+#include <fairlogger/Logger.h>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>   // pair
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>   // sched_getcpu
+#endif
+
+namespace fair::mq
+{
+
+/**
+ * Measures the round-trip latency between two devices, to qualify nodes, transports and kernel settings.
+ *
+ * The initiator (--role initiator) sends a ping and waits for it to come back from the reflector (--role reflector),
+ * one message in flight, for every size of --msg-size (--warmup + --iterations round trips each), and reports the
+ * percentiles of the round-trip times. Pings go out on --channel and come back on --return-channel, on --channel
+ * itself if that is empty: one pair or req/rep (initiator req, reflector rep) channel, or a push/pull loop of two channels.
+ * Every ping starts with a PingStamp; the reflector sends the received message back as it is (moved, no copy), after
+ * writing the CPU it runs on into the stamp, so that the round trips are counted per pair of initiator/reflector CPUs.
+ * With --busy-poll both sides receive with non-blocking calls in a loop instead of blocking in the transport.
+ * With --output the results are appended to a CSV file, one line per message size.
+ */
+class PingPong : public Device
+{
+  public:
+    /// start of every ping
+    struct PingStamp
+    {
+        uint64_t fSeq;
+        int64_t fSendTime; // ns, CLOCK_MONOTONIC of the initiator
+        int32_t fInitiatorCpu;
+        int32_t fReflectorCpu; // written by the reflector
+    };
+
+    /// @return CPU the calling thread runs on, -1 if unknown
+    static int32_t CurrentCpu()
+    {
+#ifdef __linux__
+        return sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+
+  protected:
+    bool fInitiator = true;
+    std::string fChannelName{"ping"};
+    std::string fReturnChannelName;
+    std::vector<size_t> fMsgSizes;
+    uint64_t fIterations = 10000;
+    uint64_t fWarmup = 1000;
+    bool fBusyPoll = false;
+    std::string fOutput;
+
+    void InitTask() override
+    {
+        const auto role = fConfig->GetProperty<std::string>("role");
+        if (role != "initiator" && role != "reflector") {
+            LOG(error) << "Invalid role '" << role << "', valid are 'initiator' and 'reflector'";
+            throw std::runtime_error(tools::ToString("Invalid role '", role, "', valid are 'initiator' and 'reflector'"));
+        }
+        fInitiator = (role == "initiator");
+        fChannelName = fConfig->GetProperty<std::string>("channel");
+        fReturnChannelName = fConfig->GetProperty<std::string>("return-channel");
+        if (fReturnChannelName.empty()) {
+            fReturnChannelName = fChannelName;
+        }
+        fMsgSizes = fConfig->GetProperty<std::vector<size_t>>("msg-size", std::vector<size_t>{64});
+        fIterations = fConfig->GetProperty<uint64_t>("iterations");
+        fWarmup = fConfig->GetProperty<uint64_t>("warmup");
+        fBusyPoll = fConfig->GetProperty<bool>("busy-poll");
+        fOutput = fConfig->GetProperty<std::string>("output");
+
+        for (size_t size : fMsgSizes) {
+            if (size < sizeof(PingStamp)) {
+                LOG(error) << "Message size " << size << " is smaller than the ping stamp (" << sizeof(PingStamp) << " bytes)";
+                throw std::runtime_error(tools::ToString("Message size ", size, " is smaller than the ping stamp (", sizeof(PingStamp), " bytes)"));
+            }
+        }
+    }
+
+    void Run() override
+    {
+        // a pair/req/rep channel serves both directions, a push/pull loop has one channel per direction
+        Channel& out = fInitiator ? GetChannel(fChannelName) : GetChannel(fReturnChannelName);
+        Channel& in = fInitiator ? GetChannel(fReturnChannelName) : GetChannel(fChannelName);
+        if (fInitiator) {
+            RunInitiator(out, in);
+        } else {
+            RunReflector(out, in);
+        }
+    }
+
+    void RunInitiator(Channel& out, Channel& in)
+    {
+        for (size_t size : fMsgSizes) {
+            tools::LatencyHistogram histogram;
+            std::map<std::pair<int32_t, int32_t>, uint64_t> cpus; // round trips per initiator/reflector CPU
+            for (uint64_t i = 0; i < fWarmup + fIterations; ++i) {
+                MessagePtr ping(out.NewMessage(size));
+                PingStamp stamp{i, tools::LatencyClockNow(tools::LatencyClock::monotonic), CurrentCpu(), -1};
+                std::memcpy(ping->GetData(), &stamp, sizeof(stamp));
+                if (out.Send(ping) < 0) {
+                    return;
+                }
+                MessagePtr pong(in.NewMessage());
+                if (!ReceiveReply(in, pong)) {
+                    return;
+                }
+                const int64_t now = tools::LatencyClockNow(tools::LatencyClock::monotonic);
+                if (pong->GetSize() < sizeof(stamp)) {
+                    LOG(warn) << "Ignoring reply of " << pong->GetSize() << " bytes, not a ping";
+                    continue;
+                }
+                std::memcpy(&stamp, pong->GetData(), sizeof(stamp));
+                if (stamp.fSeq != i) {
+                    LOG(warn) << "Ignoring reply to ping " << stamp.fSeq << ", expected " << i;
+                    continue;
+                }
+                if (i >= fWarmup) {
+                    histogram.Record(static_cast<uint64_t>(now - stamp.fSendTime));
+                    ++cpus[{stamp.fInitiatorCpu, stamp.fReflectorCpu}];
+                }
+            }
+            Report(out, size, histogram, cpus);
+        }
+        LOG(info) << "Ping-pong done, " << fMsgSizes.size() << " message sizes measured";
+    }
+
+    void RunReflector(Channel& out, Channel& in)
+    {
+        while (!NewStatePending()) {
+            MessagePtr msg(in.NewMessage());
+            if (!ReceiveReply(in, msg)) {
+                return;
+            }
+            if (msg->GetSize() >= sizeof(PingStamp)) {
+                const int32_t cpu = CurrentCpu();
+                std::memcpy(static_cast<char*>(msg->GetData()) + offsetof(PingStamp, fReflectorCpu), &cpu, sizeof(cpu));
+            }
+            if (out.Send(msg) < 0) {
+                return;
+            }
+        }
+    }
+
+    /// receive the next message, spinning on non-blocking receives with --busy-poll
+    /// @return false if the device is about to leave RUNNING
+    bool ReceiveReply(Channel& in, MessagePtr& msg)
+    {
+        while (!NewStatePending()) {
+            const int64_t result = fBusyPoll ? in.Receive(msg, 0) : in.Receive(msg, 100);
+            if (result >= 0) {
+                return true;
+            }
+            if (result != static_cast<int64_t>(TransferCode::timeout)) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /// log the round-trip percentiles of a message size (and append them to --output)
+    void Report(const Channel& channel, size_t size, const tools::LatencyHistogram& histogram, const std::map<std::pair<int32_t, int32_t>, uint64_t>& cpus)
+    {
+        auto us = [&](double percentile) { return histogram.Percentile(percentile) / 1000.; };
+        LOG(info) << "Round trip (" << channel.GetType() << ", " << channel.GetTransportName() << ", " << size << " bytes, " << histogram.Count() << " pings) [us]:"
+                  << " min " << histogram.Min() / 1000.
+                  << ", p50 " << us(50.)
+                  << ", p90 " << us(90.)
+                  << ", p99 " << us(99.)
+                  << ", p99.9 " << us(99.9)
+                  << ", max " << histogram.Max() / 1000.;
+        std::string cpuList;
+        for (const auto& [pair, count] : cpus) {
+            cpuList += tools::ToString(cpuList.empty() ? "" : " ", pair.first, "/", pair.second, ":", count);
+        }
+        if (cpus.size() > 1) {
+            LOG(warn) << "The devices moved between CPUs (initiator/reflector:pings): " << cpuList << ", pin them (e.g. --cpu-affinity) for stable results";
+        } else {
+            LOG(info) << "CPUs (initiator/reflector:pings): " << cpuList;
+        }
+
+        if (fOutput.empty()) {
+            return;
+        }
+        std::ifstream existing(fOutput);
+        const bool header = !existing.good() || existing.peek() == std::ifstream::traits_type::eof();
+        existing.close();
+        std::ofstream csv(fOutput, std::ios::app);
+        if (!csv) {
+            LOG(error) << "Cannot open the output file " << fOutput;
+            return;
+        }
+        if (header) {
+            csv << "type,transport,msg_size,pings,min_us,p50_us,p90_us,p99_us,p999_us,max_us,cpus\n";
+        }
+        csv << channel.GetType() << "," << channel.GetTransportName() << "," << size << "," << histogram.Count() << ","
+            << histogram.Min() / 1000. << "," << us(50.) << "," << us(90.) << "," << us(99.) << "," << us(99.9) << ","
+            << histogram.Max() / 1000. << "," << cpuList << "\n";
+    }
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_PINGPONG_H */
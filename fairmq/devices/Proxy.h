@@ -19,44 +19,32 @@ namespace fair::mq
 class Proxy : public Device
 {
   protected:
-    bool fMultipart = true;
+    bool fMultipart = true; // deprecated, messages are always forwarded with all their parts
     std::string fInChannelName;
     std::string fOutChannelName;
+    SubChannelRef fInChannel;
+    SubChannelRef fOutChannel;
 
     void InitTask() override
     {
         fMultipart = fConfig->GetProperty<bool>("multipart");
         fInChannelName = fConfig->GetProperty<std::string>("in-channel");
         fOutChannelName = fConfig->GetProperty<std::string>("out-channel");
+        fInChannel = GetChannelRef(fInChannelName, 0);
+        fOutChannel = GetChannelRef(fOutChannelName, 0);
     }
 
     void Run() override
     {
-        if (fMultipart) {
-            while (!NewStatePending()) {
-                Parts payload;
-                if (Receive(payload, fInChannelName) >= 0) {
-                    if (Send(payload, fOutChannelName) < 0) {
-                        LOG(debug) << "Transfer interrupted";
-                        break;
-                    }
-                } else {
-                    LOG(debug) << "Transfer interrupted";
-                    break;
-                }
-            }
-        } else {
-            while (!NewStatePending()) {
-                MessagePtr payload(fTransportFactory->CreateMessage());
-                if (Receive(payload, fInChannelName) >= 0) {
-                    if (Send(payload, fOutChannelName) < 0) {
-                        LOG(debug) << "Transfer interrupted";
-                        break;
-                    }
-                } else {
-                    LOG(debug) << "Transfer interrupted";
-                    break;
-                }
+        Channel& inChannel = *fInChannel;
+        Channel& outChannel = *fOutChannel;
+
+        // messages are forwarded with all their parts, between channels of the same transport
+        // without creating message objects (see Channel::Forward)
+        while (!NewStatePending()) {
+            if (inChannel.Forward(outChannel) < 0) {
+                LOG(debug) << "Transfer interrupted";
+                break;
             }
         }
     }
@@ -10,28 +10,71 @@
 #define FAIR_MQ_SINK_H
 
 #include <fairmq/Device.h>
+#include <fairmq/FileWriter.h>
+#include <fairmq/tools/Latency.h>
 #include <fairmq/tools/Strings.h>
 
+#include <algorithm> // max
+#include <atomic>
 #include <chrono>
 #include <fairlogger/Logger.h>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace fair::mq
 {
 
+/**
+ * Receives and discards (or writes to a file) the messages of the input channel.
+ * With --latency the one-way latency of the messages stamped by the BenchmarkSampler (--latency) is recorded
+ * in a histogram, which is reported every --latency-report-interval seconds and at the end of RUNNING,
+ * together with the messages lost or reordered according to the sequence numbers of the stamps.
+ * With --async-write the file is written by a FileWriter on a separate thread, which holds the messages until they
+ * are written (or with --direct-io copies them into aligned buffers for O_DIRECT) and rotates files (--rotate-file-size).
+ * With --threads N the messages are received by N threads, each on its own sub-channels (--all-subchannels receives on
+ * all sub-channels of the input channel, distributed round-robin over the threads), with statistics per thread that
+ * are merged at the end. --touch reads every cache line of the received data, like a consumer processing it.
+ */
 class Sink : public Device
 {
   protected:
+    /// statistics of one receiving thread
+    struct ReceiverStats
+    {
+        uint64_t fMessages = 0;
+        uint64_t fBytes = 0;
+        uint64_t fNumUnstamped = 0;
+        uint64_t fTouched = 0; // sum of the bytes read by --touch, so the reads are not optimized away
+        std::chrono::steady_clock::time_point fLastLatencyReport;
+        tools::LatencyHistogram fLatencyInterval; // since the last report
+        tools::LatencyHistogram fLatencyTotal;
+    };
+
     bool fMultipart = false;
     uint64_t fMaxIterations = 0;
-    uint64_t fNumIterations = 0;
+    std::atomic<uint64_t> fNumIterations = 0;
     uint64_t fMaxFileSize = 0;
     uint64_t fBytesWritten = 0;
     std::string fInChannelName;
+    SubChannelRef fInChannel;
+    std::vector<SubChannelRef> fInChannels; // received sub-channels
+    size_t fNumThreads = 1;
+    bool fTouch = false;
     std::string fOutFilename;
     std::fstream fOutputFile;
+    bool fAsyncWrite = false;
+    FileWriterConfig fWriterConfig;
+    std::unique_ptr<FileWriter> fWriter;
+    bool fLatency = false;
+    std::chrono::seconds fLatencyReportInterval{1};
+    std::vector<ReceiverStats> fStats; // per thread
+    std::mutex fSequenceMtx;
+    tools::SequenceTracker fSequence; // shared, the messages of a source may arrive on the sub-channels of several threads
 
     void InitTask() override
     {
@@ -40,17 +83,44 @@ class Sink : public Device
         fMaxFileSize   = fConfig->GetProperty<uint64_t>("max-file-size");
         fInChannelName = fConfig->GetProperty<std::string>("in-channel");
         fOutFilename   = fConfig->GetProperty<std::string>("out-filename");
+        fLatency       = fConfig->GetProperty<bool>("latency", false);
+        fLatencyReportInterval = std::chrono::seconds(fConfig->GetProperty<unsigned int>("latency-report-interval", 1));
+        fAsyncWrite    = fConfig->GetProperty<bool>("async-write", false);
+        fWriterConfig.filename = fOutFilename;
+        fWriterConfig.direct = fConfig->GetProperty<bool>("direct-io", false);
+        fWriterConfig.uring = fConfig->GetProperty<bool>("uring-write", false);
+        fWriterConfig.bufferSize = fConfig->GetProperty<size_t>("write-buffer-size", fWriterConfig.bufferSize);
+        fWriterConfig.maxQueuedBytes = fConfig->GetProperty<size_t>("write-queue-size", fWriterConfig.maxQueuedBytes);
+        fWriterConfig.rotateSize = fConfig->GetProperty<uint64_t>("rotate-file-size", 0);
+        fNumThreads    = std::max(fConfig->GetProperty<size_t>("threads", 1), size_t(1));
+        fTouch         = fConfig->GetProperty<bool>("touch", false);
+
+        fInChannels.clear();
+        const size_t numSubChannels = fConfig->GetProperty<bool>("all-subchannels", false) ? GetNumSubChannels(fInChannelName) : 1;
+        for (size_t i = 0; i < numSubChannels; ++i) {
+            fInChannels.push_back(GetChannelRef(fInChannelName, static_cast<int>(i)));
+        }
+        fInChannel = fInChannels.front();
+
+        // sockets are not thread-safe, every thread needs sub-channels of its own
+        if (fNumThreads > fInChannels.size()) {
+            LOG(error) << "--threads " << fNumThreads << " requires as many sub-channels of " << fInChannelName << " (with --all-subchannels), it has " << GetNumSubChannels(fInChannelName);
+            throw std::runtime_error(tools::ToString("--threads ", fNumThreads, " requires as many sub-channels of ", fInChannelName, " (with --all-subchannels), it has ", GetNumSubChannels(fInChannelName)));
+        }
+        if (fNumThreads > 1 && !fOutFilename.empty()) {
+            LOG(error) << "--out-filename cannot be combined with --threads";
+            throw std::runtime_error("--out-filename cannot be combined with --threads");
+        }
 
         fBytesWritten = 0;
     }
 
     void Run() override
     {
-        // store the channel reference to avoid traversing the map on every loop iteration
-        Channel& dataInChannel = GetChannel(fInChannelName, 0);
-
-        LOG(info) << "Starting sink and expecting to receive " << fMaxIterations << " messages.";
+        LOG(info) << "Starting sink and expecting to receive " << fMaxIterations << " messages"
+                  << " (" << fNumThreads << " thread(s), " << fInChannels.size() << " sub-channel(s)).";
         auto tStart = std::chrono::high_resolution_clock::now();
+        fStats = std::vector<ReceiverStats>(fNumThreads);
 
         if (!fOutFilename.empty()) {
             LOG(debug) << "Incoming messages will be written to file: " << fOutFilename;
@@ -60,33 +130,126 @@ class Sink : public Device
                 LOG(debug) << "ATTENTION: --max-file-size is 0 - output file will continue to grow until sink is stopped";
             }
 
-            fOutputFile.open(fOutFilename, std::ios::out | std::ios::binary);
-            if (!fOutputFile) {
-                LOG(error) << "Could not open '" << fOutFilename;
-                throw std::runtime_error(fair::mq::tools::ToString("Could not open '", fOutFilename));
+            if (fAsyncWrite) {
+                fWriter = std::make_unique<FileWriter>(fWriterConfig);
+            } else {
+                fOutputFile.open(fOutFilename, std::ios::out | std::ios::binary);
+                if (!fOutputFile) {
+                    LOG(error) << "Could not open '" << fOutFilename;
+                    throw std::runtime_error(fair::mq::tools::ToString("Could not open '", fOutFilename));
+                }
+            }
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < fNumThreads; ++t) {
+            threads.emplace_back(&Sink::Consume, this, t);
+        }
+        Consume(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (fOutputFile.is_open()) {
+            fOutputFile.flush();
+            fOutputFile.close();
+        }
+        if (fWriter) {
+            fWriter->Close();
+        }
+
+        auto tEnd = std::chrono::high_resolution_clock::now();
+        auto ms = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+        ReceiverStats total;
+        for (size_t t = 0; t < fStats.size(); ++t) {
+            const auto& stats = fStats[t];
+            if (fNumThreads > 1) {
+                LOG(info) << "Thread " << t << " received " << stats.fMessages << " messages, " << stats.fBytes << " bytes ("
+                          << (stats.fBytes / (1000. * 1000.)) / (ms / 1000.) << " MB/s).";
+            }
+            total.fMessages += stats.fMessages;
+            total.fBytes += stats.fBytes;
+            total.fNumUnstamped += stats.fNumUnstamped;
+            total.fTouched += stats.fTouched;
+            total.fLatencyTotal.Add(stats.fLatencyTotal);
+        }
+        LOG(info) << "Received " << fNumIterations << " messages in " << ms << "ms"
+                  << " (" << total.fBytes << " bytes, " << (total.fBytes / (1000. * 1000.)) / (ms / 1000.) << " MB/s).";
+        if (fTouch) {
+            LOG(debug) << "Checksum of the touched bytes: " << total.fTouched;
+        }
+        if (fLatency) {
+            ReportLatency(total.fLatencyTotal, total.fNumUnstamped, "total");
+        }
+        if (!fOutFilename.empty()) {
+            auto sec = std::chrono::duration<double>(tEnd - tStart).count();
+            LOG(info) << "Closed '" << fOutFilename << "' after writing " << fBytesWritten << " bytes."
+                      << "(" << (fBytesWritten / (1000. * 1000.)) / sec << " MB/s)";
+            if (fWriter) {
+                LOG(info) << "Asynchronous writer: " << fWriter->GetNumFiles() << " file(s), "
+                          << (fWriter->GetBytesWritten() / (1000. * 1000.)) / fWriter->GetWriteSeconds() << " MB/s while writing";
+                fWriter.reset();
             }
         }
 
+        LOG(info) << "Leaving RUNNING state.";
+    }
+
+    /// receive loop of one thread, on the sub-channels thread, thread + fNumThreads, ... in turn
+    void Consume(size_t thread)
+    {
+        std::vector<Channel*> channels;
+        for (size_t i = thread; i < fInChannels.size(); i += fNumThreads) {
+            channels.push_back(&*fInChannels[i]);
+        }
+        ReceiverStats& stats = fStats[thread];
+        stats.fLastLatencyReport = std::chrono::steady_clock::now();
+        size_t next = 0;
+
         while (!NewStatePending()) {
+            Channel& dataInChannel = *channels[next];
+            next = (next + 1) % channels.size();
+            // with several sub-channels a receive must not block the others
+            const int timeoutMs = channels.size() > 1 ? 10 : dataInChannel.GetRcvTimeout();
+
             if (fMultipart) {
                 Parts parts;
-                if (dataInChannel.Receive(parts) < 0) {
+                if (dataInChannel.Receive(parts, timeoutMs) < 0) {
                     continue;
                 }
-                if (fOutputFile.is_open()) {
+                if (fLatency) {
+                    RecordLatency(stats, parts[0].GetData(), parts[0].GetSize());
+                }
+                for (const auto& part : parts) {
+                    Consumed(stats, part->GetData(), part->GetSize());
+                }
+                if (fWriter) {
+                    for (const auto& part : parts) {
+                        fBytesWritten += part->GetSize();
+                    }
+                    fWriter->Write(parts);
+                } else if (fOutputFile.is_open()) {
                     for (const auto& part : parts) {
                         WriteToFile(static_cast<const char*>(part->GetData()), part->GetSize());
                     }
                 }
             } else {
                 MessagePtr msg(dataInChannel.NewMessage());
-                if (dataInChannel.Receive(msg) < 0) {
+                if (dataInChannel.Receive(msg, timeoutMs) < 0) {
                     continue;
                 }
-                if (fOutputFile.is_open()) {
+                if (fLatency) {
+                    RecordLatency(stats, msg->GetData(), msg->GetSize());
+                }
+                Consumed(stats, msg->GetData(), msg->GetSize());
+                if (fWriter) {
+                    fBytesWritten += msg->GetSize();
+                    fWriter->Write(std::move(msg));
+                } else if (fOutputFile.is_open()) {
                     WriteToFile(static_cast<const char*>(msg->GetData()), msg->GetSize());
                 }
             }
+            ++stats.fMessages;
 
             if (fMaxFileSize > 0 && fBytesWritten >= fMaxFileSize) {
                 LOG(info) << "Written " << fBytesWritten << " bytes, stopping...";
@@ -100,22 +263,54 @@ class Sink : public Device
             }
             fNumIterations++;
         }
+    }
 
-        if (fOutputFile.is_open()) {
-            fOutputFile.flush();
-            fOutputFile.close();
+    void Consumed(ReceiverStats& stats, const void* data, size_t size)
+    {
+        stats.fBytes += size;
+        if (fTouch) {
+            // one read per cache line
+            const auto* p = static_cast<const volatile unsigned char*>(data);
+            uint64_t sum = 0;
+            for (size_t i = 0; i < size; i += 64) {
+                sum += p[i];
+            }
+            stats.fTouched += sum;
         }
+    }
 
-        auto tEnd = std::chrono::high_resolution_clock::now();
-        auto ms = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-        LOG(info) << "Received " << fNumIterations << " messages in " << ms << "ms.";
-        if (!fOutFilename.empty()) {
-            auto sec = std::chrono::duration<double>(tEnd - tStart).count();
-            LOG(info) << "Closed '" << fOutFilename << "' after writing " << fBytesWritten << " bytes."
-                      << "(" << (fBytesWritten / (1000. * 1000.)) / sec << " MB/s)";
+    void RecordLatency(ReceiverStats& stats, const void* data, size_t size)
+    {
+        tools::LatencyStamp stamp;
+        if (!tools::LatencyStamp::Read(data, size, stamp)) {
+            ++stats.fNumUnstamped;
+        } else {
+            int64_t latency = tools::LatencyClockNow(static_cast<tools::LatencyClock>(stamp.fClock)) - stamp.fSendTime;
+            // negative with realtime clocks that are not (yet) synchronized
+            uint64_t ns = latency > 0 ? static_cast<uint64_t>(latency) : 0;
+            stats.fLatencyInterval.Record(ns);
+            stats.fLatencyTotal.Record(ns);
+            std::lock_guard<std::mutex> lock(fSequenceMtx);
+            fSequence.Record(stamp.fSource, stamp.fSeq);
         }
 
-        LOG(info) << "Leaving RUNNING state.";
+        if (fLatencyReportInterval.count() > 0 && std::chrono::steady_clock::now() - stats.fLastLatencyReport >= fLatencyReportInterval) {
+            ReportLatency(stats.fLatencyInterval, stats.fNumUnstamped, fNumThreads > 1 ? tools::ToString("interval, thread ", &stats - fStats.data()) : "interval");
+            stats.fLatencyInterval.Reset();
+            stats.fLastLatencyReport = std::chrono::steady_clock::now();
+        }
+    }
+
+    void ReportLatency(const tools::LatencyHistogram& histogram, uint64_t numUnstamped, const std::string& label)
+    {
+        std::lock_guard<std::mutex> lock(fSequenceMtx);
+        LOG(info) << "Latency (" << label << ", " << histogram.Count() << " messages) [us]:"
+                  << " p50 " << histogram.Percentile(50.) / 1000.
+                  << ", p99 " << histogram.Percentile(99.) / 1000.
+                  << ", p99.9 " << histogram.Percentile(99.9) / 1000.
+                  << ", max " << histogram.Max() / 1000.
+                  << " | lost " << fSequence.Lost() << ", reordered " << fSequence.Reordered()
+                  << ", sources " << fSequence.NumSources() << ", unstamped " << numUnstamped;
     }
 
     void WriteToFile(const char* ptr, size_t size)
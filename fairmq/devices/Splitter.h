@@ -10,47 +10,382 @@
 #define FAIR_MQ_SPLITTER_H
 
 #include <fairmq/Device.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Threads.h> // NumaNodeOf
 
+#include <boost/algorithm/string.hpp> // split
+#include <algorithm> // min
+#include <chrono>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <fairlogger/Logger.h>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace fair::mq
 {
 
+/// Distributes the messages of the input channel over the subchannels of the output channel.
+///
+/// With --dispatch round-robin (default) the outputs are served in turn.
+/// If the output channel has the route=hash property, messages with the same key go to the same output (see
+/// Device::Route(), the key extractor can be set with SetRouteKey() by a derived device).
+/// With --dispatch credit the consumers advertise their free capacity as credits on the credit channel,
+/// which has one subchannel per output (credits on credit subchannel i are for output i).
+/// A credit message carries the number of credits as uint32_t (any other payload counts as one credit),
+/// the first one of a consumer announces its capacity. Every message is sent to the output with the
+/// most credits left, if no output has credits the splitter waits for the next credit message.
+/// With --dispatch scatter every multipart message is split: output i gets the i-th range of its parts, with the
+/// number of parts per output given by --scatter-parts (e.g. "1,2,1"), one part per output if empty (per-detector
+/// payloads). The parts are moved to the outputs (MessagePtr, no copy or re-allocation, for shmem only the metadata is
+/// sent); messages that do not have the expected number of parts are dropped.
+/// With --numa-nodes (the NUMA node of the consumer of every output, e.g. "0,0,1,1") messages are sent to the outputs
+/// on the NUMA node of their memory (of the largest part, see tools::NumaNodeOf()), so that the consumers do not read
+/// them across the interconnect. Round-robin dispatch turns among the local outputs, and sends to the least loaded output
+/// once all local ones have --numa-max-queue messages queued (Channel::GetQueueDepth()). Credit dispatch takes the local
+/// output with the most credits, any output with credits if no local one has some. Messages on other nodes (or of
+/// unknown location) are dispatched as without --numa-nodes.
+/// The output channel (and the credit channel along with it) can be resized while running (see
+/// Device::ResizeChannel()), new outputs are served from the next message on.
 class Splitter : public Device
 {
   protected:
     bool fMultipart = true;
     int fNumOutputs = 0;
     int fDirection = 0;
+    bool fCreditBased = false;
+    bool fScatter = false;
+    std::vector<size_t> fScatterParts;   // number of parts per output, empty: one each
+    Parts fScatterOut;                   // reused for the part ranges of more than one part
+    bool fHashRouting = false;
     std::string fInChannelName;
     std::string fOutChannelName;
+    std::string fCreditChannelName;
+    ChannelRef fOutChannel;
+    ChannelRef fCreditChannel;
+    std::chrono::seconds fReportInterval{0};
+    std::chrono::steady_clock::time_point fLastReport;
+    PollerPtr fCreditPoller;
+    std::vector<int64_t> fCredits;   // per output, credits left
+    std::vector<int64_t> fCapacity;  // per output, announced with the first credit message, 0 if not yet known
+    std::vector<uint64_t> fNumSent;  // per output
+    std::vector<int> fOutputNodes;   // per output, NUMA node of its consumer (-1: unknown), empty: no locality
+    int64_t fNumaMaxQueue = 0;       // queue depth of the local outputs from which on the least loaded is taken, 0: never
+    uint64_t fNumLocal = 0;          // messages sent to an output on the NUMA node of their memory
+    uint64_t fNumRemote = 0;         // messages sent to an output on another node
 
     void InitTask() override
     {
         fMultipart = fConfig->GetProperty<bool>("multipart");
         fInChannelName = fConfig->GetProperty<std::string>("in-channel");
         fOutChannelName = fConfig->GetProperty<std::string>("out-channel");
-        fNumOutputs = GetNumSubChannels(fOutChannelName);
+        fCreditChannelName = fConfig->GetProperty<std::string>("credit-channel");
+        fReportInterval = std::chrono::seconds(fConfig->GetProperty<unsigned int>("report-interval"));
+        fOutChannel = GetChannelRef(fOutChannelName);
+        fNumOutputs = fOutChannel.size();
         fDirection = 0;
 
-        if (fMultipart) {
+        std::string dispatch = fConfig->GetProperty<std::string>("dispatch");
+        if (dispatch != "round-robin" && dispatch != "credit" && dispatch != "scatter") {
+            LOG(error) << "Invalid dispatch mode '" << dispatch << "', valid are 'round-robin', 'credit' and 'scatter'";
+            throw std::runtime_error(tools::ToString("Invalid dispatch mode '", dispatch, "', valid are 'round-robin', 'credit' and 'scatter'"));
+        }
+        fCreditBased = (dispatch == "credit");
+        fScatter = (dispatch == "scatter");
+        fHashRouting = (fNumOutputs > 0 && fOutChannel[0]->GetRoute() == "hash");
+        if ((fCreditBased || fScatter) && fHashRouting) {
+            LOG(error) << "Dispatch mode '" << dispatch << "' cannot be combined with the route=hash property of the output channel";
+            throw std::runtime_error(tools::ToString("Dispatch mode '", dispatch, "' cannot be combined with the route=hash property of the output channel"));
+        }
+        if (fScatter) {
+            if (!fMultipart) {
+                LOG(error) << "Scatter dispatch needs multipart payloads (--multipart true)";
+                throw std::runtime_error("Scatter dispatch needs multipart payloads (--multipart true)");
+            }
+            fScatterParts.clear();
+            std::vector<std::string> counts;
+            if (const auto list = fConfig->GetProperty<std::string>("scatter-parts"); !list.empty()) {
+                boost::algorithm::split(counts, list, boost::algorithm::is_any_of(","));
+            }
+            for (const auto& count : counts) {
+                try {
+                    fScatterParts.push_back(std::stoul(count));
+                } catch (const std::exception&) {
+                    LOG(error) << "Invalid number of parts '" << count << "' in --scatter-parts";
+                    throw std::runtime_error(tools::ToString("Invalid number of parts '", count, "' in --scatter-parts"));
+                }
+            }
+        }
+
+        fOutputNodes.clear();
+        fNumaMaxQueue = fConfig->GetProperty<int>("numa-max-queue");
+        fNumLocal = 0;
+        fNumRemote = 0;
+        if (const auto list = fConfig->GetProperty<std::string>("numa-nodes"); !list.empty()) {
+            if (fScatter || fHashRouting) {
+                LOG(error) << "--numa-nodes cannot be combined with scatter dispatch or the route=hash property of the output channel";
+                throw std::runtime_error("--numa-nodes cannot be combined with scatter dispatch or the route=hash property of the output channel");
+            }
+            std::vector<std::string> nodes;
+            boost::algorithm::split(nodes, list, boost::algorithm::is_any_of(","));
+            for (const auto& node : nodes) {
+                try {
+                    fOutputNodes.push_back(std::stoi(node));
+                } catch (const std::exception&) {
+                    LOG(error) << "Invalid NUMA node '" << node << "' in --numa-nodes";
+                    throw std::runtime_error(tools::ToString("Invalid NUMA node '", node, "' in --numa-nodes"));
+                }
+            }
+        }
+
+        fCredits.assign(fNumOutputs, 0);
+        fCapacity.assign(fNumOutputs, 0);
+        fNumSent.assign(fNumOutputs, 0);
+
+        if (fCreditBased) {
+            fCreditChannel = GetChannelRef(fCreditChannelName);
+            int numCreditChannels = fCreditChannel.size();
+            if (numCreditChannels != fNumOutputs) {
+                LOG(error) << "Credit channel '" << fCreditChannelName << "' has " << numCreditChannels << " subchannels, expected one per output (" << fNumOutputs << ")";
+                throw std::runtime_error(tools::ToString("Credit channel '", fCreditChannelName, "' has ", numCreditChannels, " subchannels, expected one per output (", fNumOutputs, ")"));
+            }
+            fCreditPoller = NewPoller(fCreditChannelName);
+        }
+
+        if (fScatter) {
+            OnData(fInChannelName, &Splitter::HandleScatter);
+        } else if (fMultipart) {
             OnData(fInChannelName, &Splitter::HandleData<Parts>);
         } else {
             OnData(fInChannelName, &Splitter::HandleData<MessagePtr>);
         }
     }
 
+    void PreRun() override { fLastReport = std::chrono::steady_clock::now(); }
+
+    void PostRun() override { Report(); }
+
+    void ResetTask() override { fCreditPoller.reset(); }
+
+    void SubChannelsChanged(const std::string& channelName) override
+    {
+        if (channelName != fOutChannelName && !(fCreditBased && channelName == fCreditChannelName)) {
+            return;
+        }
+        // in credit mode, an output is used once both its subchannels exist
+        fNumOutputs = fCreditBased ? std::min(fOutChannel.size(), fCreditChannel.size()) : fOutChannel.size();
+        fCredits.resize(fNumOutputs, 0);
+        fCapacity.resize(fNumOutputs, 0);
+        fNumSent.resize(fNumOutputs, 0);
+        if (fDirection >= fNumOutputs) {
+            fDirection = 0;
+        }
+        if (fCreditBased && channelName == fCreditChannelName) {
+            fCreditPoller = NewPoller(fCreditChannelName);
+        }
+        LOG(info) << "Splitting over " << fNumOutputs << " outputs";
+    }
+
     template<typename T>
     bool HandleData(T& payload, int)
     {
-        Send(payload, fOutChannelName, fDirection);
+        const int node = fOutputNodes.empty() ? -1 : NumaNode(payload);
+        if (fCreditBased) {
+            // a negative direction only occurs when the device is about to leave RUNNING
+            if ((fDirection = SelectByCredit(node)) < 0) {
+                LOG(warn) << "Dropping message, no consumer has free capacity";
+                fDirection = 0;
+                return true;
+            }
+            --fCredits.at(fDirection);
+        } else if (fHashRouting) {
+            fDirection = RouteIndex(payload, fOutChannelName);
+        } else if (node >= 0) {
+            fDirection = SelectByLocality(node);
+        }
+        if (node >= 0) {
+            ++(OutputNode(fDirection) == node ? fNumLocal : fNumRemote);
+        }
+
+        Send(payload, fOutChannel[fDirection]);
+        ++fNumSent.at(fDirection);
 
         if (++fDirection >= fNumOutputs) {
             fDirection = 0;
         }
 
+        if (fReportInterval.count() > 0 && std::chrono::steady_clock::now() - fLastReport >= fReportInterval) {
+            Report();
+        }
+
+        return true;
+    }
+
+    /// send part range i of the message to output i, moving the messages
+    bool HandleScatter(Parts& parts, int)
+    {
+        const int numRanges = fScatterParts.empty() ? static_cast<int>(parts.Size()) : static_cast<int>(fScatterParts.size());
+        size_t expected = parts.Size();
+        if (!fScatterParts.empty()) {
+            expected = 0;
+            for (size_t count : fScatterParts) {
+                expected += count;
+            }
+        }
+        if (numRanges > fNumOutputs || parts.Size() != expected) {
+            LOG(warn) << "Dropping message of " << parts.Size() << " parts, scatter expects " << expected << " parts for at most " << fNumOutputs << " outputs";
+            return true;
+        }
+
+        size_t next = 0;
+        for (int i = 0; i < numRanges; ++i) {
+            const size_t count = fScatterParts.empty() ? 1 : fScatterParts[i];
+            if (count == 1) {
+                Send(parts.At(next), fOutChannel[i]);
+            } else if (count > 1) {
+                fScatterOut.fParts.clear();
+                for (size_t n = 0; n < count; ++n) {
+                    fScatterOut.AddPart(std::move(parts.At(next + n)));
+                }
+                Send(fScatterOut, fOutChannel[i]);
+            }
+            next += count;
+            if (count > 0) {
+                ++fNumSent.at(i);
+            }
+        }
+
+        if (fReportInterval.count() > 0 && std::chrono::steady_clock::now() - fLastReport >= fReportInterval) {
+            Report();
+        }
         return true;
     }
+
+    /// NUMA node of the consumer of output i, -1 if unknown
+    int OutputNode(int i) const { return i < static_cast<int>(fOutputNodes.size()) ? fOutputNodes[i] : -1; }
+
+    /// NUMA node of the memory of the message (of its largest part), -1 if unknown
+    static int NumaNode(MessagePtr& msg) { return msg && msg->GetSize() > 0 ? tools::NumaNodeOf(msg->GetData()) : -1; }
+    static int NumaNode(Parts& parts)
+    {
+        Message* largest = nullptr;
+        for (auto& part : parts) {
+            if (part && (!largest || part->GetSize() > largest->GetSize())) {
+                largest = part.get();
+            }
+        }
+        return largest && largest->GetSize() > 0 ? tools::NumaNodeOf(largest->GetData()) : -1;
+    }
+
+    /// @return next output (from fDirection on) on the given NUMA node with less than fNumaMaxQueue queued messages,
+    /// the least loaded output if all of them have more, fDirection if the node has no outputs
+    int SelectByLocality(int node)
+    {
+        bool local = false;
+        for (int n = 0; n < fNumOutputs; ++n) {
+            int i = (fDirection + n) % fNumOutputs;
+            if (OutputNode(i) != node) {
+                continue;
+            }
+            local = true;
+            // an unknown depth (-1) counts as empty
+            if (fNumaMaxQueue <= 0 || fOutChannel[i]->GetQueueDepth() < fNumaMaxQueue) {
+                return i;
+            }
+        }
+        if (!local) {
+            return fDirection;
+        }
+        int best = fDirection;
+        int64_t bestDepth = -1;
+        for (int n = 0; n < fNumOutputs; ++n) {
+            int i = (fDirection + n) % fNumOutputs;
+            int64_t depth = fOutChannel[i]->GetQueueDepth();
+            if (bestDepth < 0 || depth < bestDepth) {
+                best = i;
+                bestDepth = depth;
+            }
+        }
+        return best;
+    }
+
+    /// @return output with the most credits left (ties are broken round-robin), preferring outputs on the given NUMA
+    /// node (-1: none), waits for credits if there are none, -1 if a state change is pending meanwhile
+    int SelectByCredit(int node = -1)
+    {
+        int timeout = 0;
+        while (true) {
+            ReceiveCredits(timeout);
+            int best = -1;
+            int bestLocal = -1;
+            for (int n = 0; n < fNumOutputs; ++n) {
+                int i = (fDirection + n) % fNumOutputs;
+                if (fCredits[i] <= 0) {
+                    continue;
+                }
+                if (best < 0 || fCredits[i] > fCredits[best]) {
+                    best = i;
+                }
+                if (node >= 0 && OutputNode(i) == node && (bestLocal < 0 || fCredits[i] > fCredits[bestLocal])) {
+                    bestLocal = i;
+                }
+            }
+            if (bestLocal >= 0) {
+                return bestLocal;
+            }
+            if (best >= 0) {
+                return best;
+            }
+            if (NewStatePending()) {
+                return -1;
+            }
+            timeout = 100;
+        }
+    }
+
+    /// add the pending credit messages, waiting up to timeout ms for the first one
+    void ReceiveCredits(int timeout)
+    {
+        fCreditPoller->Poll(timeout);
+        for (int i = 0; i < fNumOutputs; ++i) {
+            if (!fCreditPoller->CheckInput(i)) {
+                continue;
+            }
+            Channel& channel = *fCreditChannel[i];
+            while (true) {
+                MessagePtr msg(channel.NewMessage());
+                if (channel.Receive(msg, 0) < 0) {
+                    break;
+                }
+                uint32_t credits = 1;
+                if (msg->GetSize() == sizeof(credits)) {
+                    std::memcpy(&credits, msg->GetData(), sizeof(credits));
+                }
+                if (fCapacity[i] == 0) {
+                    fCapacity[i] = credits;
+                }
+                fCredits[i] += credits;
+            }
+        }
+    }
+
+    /// log the number of sent messages and, in credit mode, the queue depth per output
+    void Report()
+    {
+        fLastReport = std::chrono::steady_clock::now();
+        if (!fOutputNodes.empty()) {
+            LOG(info) << fOutChannelName << ": sent " << fNumLocal << " messages to outputs on their NUMA node, " << fNumRemote << " to other nodes";
+        }
+        for (int i = 0; i < fNumOutputs; ++i) {
+            if (fCreditBased) {
+                LOG(info) << fOutChannelName << "[" << i << "]: sent " << fNumSent[i] << ", queue depth "
+                          << (fCapacity[i] - fCredits[i]) << "/" << fCapacity[i];
+            } else {
+                LOG(info) << fOutChannelName << "[" << i << "]: sent " << fNumSent[i];
+            }
+        }
+    }
 };
 
 } // namespace fair::mq
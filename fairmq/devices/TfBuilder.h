@@ -0,0 +1,459 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TFBUILDER_H
+#define FAIR_MQ_TFBUILDER_H
+
+#include <fairmq/Device.h>
+#include <fairmq/Poller.h>
+#include <fairmq/tools/Strings.h>
+
+#include <algorithm> // clamp
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <cstring> // memcpy
+#include <deque>
+#include <fairlogger/Logger.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility> // move, pair
+#include <vector>
+
+namespace fair::mq
+{
+
+/// Reassembly table of a frame builder: the contributions to a frame are collected in a slot, found by the frame id
+/// (open addressing with linear probing). The slots are allocated up front, the table does not grow.
+/// Not thread-safe, the TfBuilder has one table per completion thread.
+class FrameTable
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot
+    {
+        uint64_t fId = 0;
+        bool fUsed = false;
+        size_t fContributions = 0;
+        Clock::time_point fStart;
+        Parts fParts;
+    };
+
+    /// @param capacity number of frames that can be built at the same time
+    explicit FrameTable(size_t capacity)
+        : fCapacity(capacity)
+    {
+        // at most half full, to keep the probe sequences short
+        size_t size = 1;
+        while (size < 2 * capacity) {
+            size <<= 1;
+        }
+        fSlots.resize(size);
+        fMask = size - 1;
+    }
+
+    /// slot of frame id, a new one if there is none and the table is not full
+    /// @return nullptr if the table is full
+    Slot* Get(uint64_t id, Clock::time_point now)
+    {
+        for (size_t i = Hash(id) & fMask;; i = (i + 1) & fMask) {
+            Slot& slot = fSlots[i];
+            if (slot.fUsed && slot.fId == id) {
+                return &slot;
+            }
+            if (!slot.fUsed) {
+                if (fSize == fCapacity) {
+                    return nullptr;
+                }
+                slot.fUsed = true;
+                slot.fId = id;
+                slot.fContributions = 0;
+                slot.fStart = now;
+                ++fSize;
+                return &slot;
+            }
+        }
+    }
+
+    /// takes the parts of a slot and frees it
+    Parts Take(Slot& slot)
+    {
+        Parts parts(std::move(slot.fParts));
+        slot.fParts = Parts();
+        // backward shift deletion: move entries of the probe sequence into the gap, so that lookups need no tombstones
+        size_t gap = &slot - fSlots.data();
+        for (size_t i = (gap + 1) & fMask; fSlots[i].fUsed; i = (i + 1) & fMask) {
+            const size_t home = Hash(fSlots[i].fId) & fMask;
+            // the entry may move to the gap if its home is not within (gap, i]
+            if (((i - home) & fMask) >= ((i - gap) & fMask)) {
+                fSlots[gap] = std::move(fSlots[i]);
+                fSlots[i].fParts = Parts();
+                gap = i;
+            }
+        }
+        fSlots[gap].fUsed = false;
+        --fSize;
+        return parts;
+    }
+
+    /// calls f(slot) for the frames started before deadline, f has to Take() them
+    template<typename F>
+    void ForEachStartedBefore(Clock::time_point deadline, F&& f)
+    {
+        // Take() moves entries backwards, so a slot is visited again after its entry was taken
+        for (size_t i = 0; i < fSlots.size(); ++i) {
+            while (fSlots[i].fUsed && fSlots[i].fStart < deadline) {
+                f(fSlots[i]);
+            }
+        }
+    }
+
+    /// slot of the frame started first
+    Slot* Oldest()
+    {
+        Slot* oldest = nullptr;
+        for (Slot& slot : fSlots) {
+            if (slot.fUsed && (!oldest || slot.fStart < oldest->fStart)) {
+                oldest = &slot;
+            }
+        }
+        return oldest;
+    }
+
+    size_t Size() const { return fSize; }
+
+  private:
+    std::vector<Slot> fSlots;
+    size_t fMask = 0;
+    size_t fCapacity;
+    size_t fSize = 0;
+
+    static size_t Hash(uint64_t id)
+    {
+        // consecutive ids are spread over the table (Fibonacci hashing)
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ULL) >> 32);
+    }
+};
+
+/// Builds frames (e.g. time frames) from the messages of all input subchannels: the (multipart) messages with the same
+/// frame id are collected and sent as one multipart message on the output channel, once --tf-contributions of them
+/// have arrived. The contributing messages are moved into the frame, not copied.
+///
+/// The frame id is read from the payload of part --tf-id-part of every message, --tf-id-size bytes (1, 2, 4 or 8,
+/// host byte order) at --tf-id-offset, or returned by an override of GetFrameId(). Frames are built in a table of
+/// --tf-slots slots, frames that are incomplete --tf-timeout ms after their first contribution are evicted (see
+/// HandleIncomplete()), as is the oldest frame when the table is full. Contributions arriving for a recently evicted
+/// frame are discarded.
+///
+/// With --tf-threads n > 1 the frames are built by n threads, frame ids are assigned to them by hash, each with a
+/// table of its own. Thread i sends on subchannel i % m of the m output subchannels.
+class TfBuilder : public Device
+{
+  protected:
+    using Clock = FrameTable::Clock;
+
+    std::string fInChannelName{"data-in"};
+    std::string fOutChannelName{"data-out"};
+    ChannelRef fInChannel;
+    ChannelRef fOutChannel;
+    int fIdPart = 0;
+    size_t fIdOffset = 0;
+    size_t fIdSize = 8;
+    size_t fContributions = 0;
+    size_t fSlots = 1024;
+    std::chrono::milliseconds fTimeout{1000};
+    int fThreads = 1;
+
+    std::atomic<uint64_t> fCompleted{0};
+    std::atomic<uint64_t> fEvicted{0};
+    std::atomic<uint64_t> fDiscarded{0};
+
+    void InitTask() override
+    {
+        fInChannelName = fConfig->GetProperty<std::string>("in-channel", "data-in");
+        fOutChannelName = fConfig->GetProperty<std::string>("out-channel", "data-out");
+        fIdPart = fConfig->GetProperty<int>("tf-id-part", 0);
+        fIdOffset = fConfig->GetProperty<size_t>("tf-id-offset", 0);
+        fIdSize = fConfig->GetProperty<size_t>("tf-id-size", 8);
+        fContributions = fConfig->GetProperty<size_t>("tf-contributions", 0);
+        fSlots = fConfig->GetProperty<size_t>("tf-slots", 1024);
+        fTimeout = std::chrono::milliseconds(fConfig->GetProperty<int>("tf-timeout", 1000));
+        fThreads = fConfig->GetProperty<int>("tf-threads", 1);
+        fInChannel = GetChannelRef(fInChannelName);
+        fOutChannel = GetChannelRef(fOutChannelName);
+
+        if (fIdSize != 1 && fIdSize != 2 && fIdSize != 4 && fIdSize != 8) {
+            LOG(error) << "Invalid frame id size " << fIdSize << ", valid are 1, 2, 4 and 8 bytes";
+            throw std::runtime_error(tools::ToString("Invalid frame id size ", fIdSize, ", valid are 1, 2, 4 and 8 bytes"));
+        }
+        if (fIdPart < 0 || fSlots < 1 || fThreads < 1) {
+            LOG(error) << "The frame id part cannot be negative, the number of slots and threads have to be at least 1";
+            throw std::runtime_error("The frame id part cannot be negative, the number of slots and threads have to be at least 1");
+        }
+        if (fContributions == 0) {
+            fContributions = fInChannel.size();
+        }
+        fCompleted = 0;
+        fEvicted = 0;
+        fDiscarded = 0;
+    }
+
+    void RegisterChannelEndpoints() override
+    {
+        RegisterChannelEndpoint(fInChannelName, 1, 10000);
+        RegisterChannelEndpoint(fOutChannelName, 1, 10000);
+
+        PrintRegisteredChannels();
+    }
+
+    /// Frame id of a contribution, by default read from the payload of part --tf-id-part
+    /// @return false if the contribution has no frame id, it is discarded
+    virtual bool GetFrameId(const Parts& parts, uint64_t& id)
+    {
+        if (parts.Size() <= static_cast<size_t>(fIdPart) || parts.At(fIdPart)->GetSize() < fIdOffset + fIdSize) {
+            return false;
+        }
+        const auto* field = static_cast<const char*>(parts.At(fIdPart)->GetData()) + fIdOffset;
+        switch (fIdSize) {
+            case 1: { uint8_t v = 0; std::memcpy(&v, field, 1); id = v; break; }
+            case 2: { uint16_t v = 0; std::memcpy(&v, field, 2); id = v; break; }
+            case 4: { uint32_t v = 0; std::memcpy(&v, field, 4); id = v; break; }
+            default: std::memcpy(&id, field, 8);
+        }
+        return true;
+    }
+
+    /// Called with every complete frame (from the thread building it), by default sends it on the output subchannel
+    /// of the thread. Channels are not thread-safe, send only on the subchannel given here.
+    /// @return false to leave RUNNING
+    virtual bool HandleFrame(uint64_t /* id */, Parts& frame, Channel& out)
+    {
+        return out.Send(frame) >= 0;
+    }
+
+    /// Called with the contributions of an evicted frame, by default they are dropped
+    virtual void HandleIncomplete(uint64_t id, Parts& frame)
+    {
+        LOG(debug) << "Frame " << id << " incomplete (" << frame.Size() << " parts), discarding it";
+    }
+
+    void Run() override
+    {
+        std::vector<Channel*> chans;
+        for (auto& chan : fInChannel) {
+            chans.push_back(&chan);
+        }
+        PollerPtr poller(NewPoller(chans));
+        const int numInputs = static_cast<int>(chans.size());
+
+        std::vector<std::unique_ptr<Builder>> builders;
+        for (int i = 0; i < fThreads; ++i) {
+            builders.push_back(std::make_unique<Builder>(*this, *fOutChannel[i % fOutChannel.size()]));
+        }
+        // with several threads the builders share the output subchannels, one thread per subchannel sends at a time
+        std::vector<std::mutex> outMutexes(fThreads > 1 ? fOutChannel.size() : 0);
+        std::vector<std::thread> threads;
+        if (fThreads > 1) {
+            for (int i = 0; i < fThreads; ++i) {
+                builders[i]->fOutMutex = &outMutexes[i % fOutChannel.size()];
+                threads.emplace_back(&Builder::Run, builders[i].get());
+            }
+        }
+
+        auto nextEviction = Clock::now() + EvictionInterval();
+        std::vector<int> ready;
+        bool running = true;
+        while (running && !NewStatePending()) {
+            poller->Poll(100);
+            ready.clear();
+            if (!poller->ReadyInputs(ready)) {
+                for (int i = 0; i < numInputs; ++i) {
+                    if (poller->CheckInput(i)) {
+                        ready.push_back(i);
+                    }
+                }
+            }
+            for (int i : ready) {
+                // take what is queued, bounded to serve the other inputs too
+                for (int n = 0; n < 64 && running; ++n) {
+                    Parts parts;
+                    if (fInChannel[i]->Receive(parts, 0) < 0) {
+                        break;
+                    }
+                    uint64_t id = 0;
+                    if (!GetFrameId(parts, id)) {
+                        LOG(warn) << "Discarding a message without frame id on " << fInChannel[i]->GetName();
+                        ++fDiscarded;
+                        continue;
+                    }
+                    Builder& builder = *builders[fThreads > 1 ? (id * 0x9E3779B97F4A7C15ULL >> 40) % fThreads : 0];
+                    running = fThreads > 1 ? builder.Post(id, std::move(parts)) : builder.Add(id, parts);
+                }
+            }
+            if (fThreads == 1 && Clock::now() >= nextEviction) {
+                builders.front()->Evict(Clock::now());
+                nextEviction = Clock::now() + EvictionInterval();
+            }
+        }
+
+        for (auto& builder : builders) {
+            builder->Stop();
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        LOG(info) << "Built " << fCompleted << " frames, evicted " << fEvicted << " incomplete frames, discarded " << fDiscarded << " late or invalid contributions";
+        if (!running && !NewStatePending()) {
+            LOG(info) << "Frame handler returned false, leaving RUNNING";
+        }
+    }
+
+  private:
+    std::chrono::milliseconds EvictionInterval() const { return std::clamp(fTimeout / 4, std::chrono::milliseconds(1), std::chrono::milliseconds(100)); }
+
+    /// builds the frames of one thread
+    struct Builder
+    {
+        Builder(TfBuilder& device, Channel& out)
+            : fDevice(device)
+            , fOut(out)
+            , fTable(device.fSlots)
+        {}
+
+        /// adds a contribution (on the builder thread)
+        /// @return false if the frame handler asked to leave RUNNING
+        bool Add(uint64_t id, Parts& parts)
+        {
+            if (fEvictedIds.count(id) > 0) {
+                ++fDevice.fDiscarded;
+                return true;
+            }
+            const auto now = Clock::now();
+            FrameTable::Slot* slot = fTable.Get(id, now);
+            if (!slot) {
+                // table full: make room by evicting the oldest frame
+                EvictSlot(*fTable.Oldest());
+                slot = fTable.Get(id, now);
+            }
+            if (slot->fParts.Empty()) {
+                slot->fParts.fParts.reserve(fDevice.fContributions * parts.Size());
+            }
+            for (auto& part : parts) {
+                slot->fParts.AddPart(std::move(part));
+            }
+            if (++slot->fContributions < fDevice.fContributions) {
+                return true;
+            }
+            Parts frame(fTable.Take(*slot));
+            ++fDevice.fCompleted;
+            if (fOutMutex) {
+                std::lock_guard<std::mutex> lock(*fOutMutex);
+                return fDevice.HandleFrame(id, frame, fOut);
+            }
+            return fDevice.HandleFrame(id, frame, fOut);
+        }
+
+        /// evicts the frames that timed out
+        void Evict(Clock::time_point now)
+        {
+            fTable.ForEachStartedBefore(now - fDevice.fTimeout, [&](FrameTable::Slot& slot) { EvictSlot(slot); });
+        }
+
+        void EvictSlot(FrameTable::Slot& slot)
+        {
+            const uint64_t id = slot.fId;
+            Parts frame(fTable.Take(slot));
+            ++fDevice.fEvicted;
+            // remember as many evicted ids as there are slots, to discard their late contributions
+            if (fEvictedIds.insert(id).second) {
+                fEvictedOrder.push_back(id);
+                if (fEvictedOrder.size() > fDevice.fSlots) {
+                    fEvictedIds.erase(fEvictedOrder.front());
+                    fEvictedOrder.pop_front();
+                }
+            }
+            fDevice.HandleIncomplete(id, frame);
+        }
+
+        /// queues a contribution for the builder thread
+        /// @return false if the builder thread stopped (its frame handler returned false)
+        bool Post(uint64_t id, Parts&& parts)
+        {
+            {
+                std::lock_guard<std::mutex> lock(fMtx);
+                if (!fRunning) {
+                    return false;
+                }
+                fQueue.emplace_back(id, std::move(parts));
+            }
+            fCV.notify_one();
+            return true;
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(fMtx);
+                fStopped = true;
+            }
+            fCV.notify_one();
+        }
+
+        void Run()
+        {
+            std::deque<std::pair<uint64_t, Parts>> batch;
+            auto nextEviction = Clock::now() + fDevice.EvictionInterval();
+            bool running = true;
+            while (running) {
+                {
+                    std::unique_lock<std::mutex> lock(fMtx);
+                    fCV.wait_until(lock, nextEviction, [&] { return fStopped || !fQueue.empty(); });
+                    if (fStopped) {
+                        break;
+                    }
+                    batch.swap(fQueue);
+                }
+                for (auto& [id, parts] : batch) {
+                    running = running && Add(id, parts);
+                }
+                batch.clear();
+                if (Clock::now() >= nextEviction) {
+                    Evict(Clock::now());
+                    nextEviction = Clock::now() + fDevice.EvictionInterval();
+                }
+            }
+            std::lock_guard<std::mutex> lock(fMtx);
+            fRunning = false;
+            fQueue.clear();
+        }
+
+        TfBuilder& fDevice;
+        Channel& fOut;
+        std::mutex* fOutMutex = nullptr;
+        FrameTable fTable;
+        std::unordered_set<uint64_t> fEvictedIds;
+        std::deque<uint64_t> fEvictedOrder;
+
+        std::mutex fMtx;
+        std::condition_variable fCV;
+        std::deque<std::pair<uint64_t, Parts>> fQueue;
+        bool fStopped = false;
+        bool fRunning = true;
+    };
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_TFBUILDER_H */
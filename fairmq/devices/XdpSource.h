@@ -0,0 +1,322 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_XDPSOURCE_H
+#define FAIR_MQ_XDPSOURCE_H
+
+#include <fairmq/Device.h>
+#include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/Strings.h>
+
+#if __has_include(<xdp/xsk.h>)
+#include <xdp/xsk.h> // libxdp
+#else
+#include <bpf/xsk.h> // libbpf < 1.0
+#endif
+
+#include <linux/if_ether.h> // ETH_P_IP, ETH_P_IPV6, ETH_P_8021Q
+#include <linux/if_link.h>  // XDP_FLAGS_*
+#include <linux/if_xdp.h>   // XDP_ZEROCOPY, XDP_COPY, XDP_STATISTICS
+#include <poll.h>
+#include <sys/socket.h>     // recvfrom, getsockopt
+
+#include <algorithm> // min
+#include <cerrno>
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <cstring> // strerror
+#include <fairlogger/Logger.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fair::mq
+{
+
+/**
+ * Receives the packets of a NIC queue via an AF_XDP socket, bypassing the kernel network stack, and sends them on the
+ * output channel without copying them.
+ *
+ * The UMEM of the socket (the packet buffers the NIC writes into) is an unmanaged region of the output channel, every
+ * received packet becomes a region message referring to its frame. Each batch of up to --batch-size packets is sent as one
+ * multipart message. The frames of released messages are returned to the fill ring of the socket in the bulk region
+ * callback, so frames are only reused once all consumers are done with them. If the consumers fall behind, the fill ring
+ * runs empty and the NIC drops packets (reported as rx_fill_ring_empty at the end of the run).
+ * With --strip-headers the messages start at the UDP payload, non-UDP packets are dropped.
+ */
+class XdpSource : public Device
+{
+  protected:
+    std::string fOutChannelName;
+    SubChannelRef fOutChannel;
+    std::string fInterface;
+    uint32_t fQueue = 0;
+    uint32_t fNumFrames = 4096;
+    uint32_t fFrameSize = XSK_UMEM__DEFAULT_FRAME_SIZE;
+    uint32_t fBatchSize = 64;
+    std::string fXdpMode;
+    bool fStripHeaders = false;
+    bool fBusyPoll = false;
+
+    UnmanagedRegionPtr fRegion;
+    char* fUmemArea = nullptr; // page aligned start of the frames in the region
+    xsk_umem* fUmem = nullptr;
+    xsk_socket* fXsk = nullptr;
+    xsk_ring_prod fFillRing{};
+    xsk_ring_cons fCompRing{};
+    xsk_ring_cons fRxRing{};
+    std::mutex fFillMtx;
+    std::vector<uint64_t> fPendingFrames; // released frames that did not fit into the fill ring yet
+    uint64_t fNumPackets = 0;
+    uint64_t fNumDropped = 0; // non-UDP packets with --strip-headers
+    uint64_t fBytesReceived = 0;
+
+    static constexpr size_t kPageSize = 4096;
+
+    void InitTask() override
+    {
+        fOutChannelName = fConfig->GetProperty<std::string>("out-channel");
+        fOutChannel = GetChannelRef(fOutChannelName, 0);
+        fInterface = fConfig->GetProperty<std::string>("interface");
+        fQueue = fConfig->GetProperty<uint32_t>("queue");
+        fNumFrames = fConfig->GetProperty<uint32_t>("num-frames");
+        fFrameSize = fConfig->GetProperty<uint32_t>("frame-size");
+        fBatchSize = fConfig->GetProperty<uint32_t>("batch-size");
+        fXdpMode = fConfig->GetProperty<std::string>("xdp-mode");
+        fStripHeaders = fConfig->GetProperty<bool>("strip-headers");
+        fBusyPoll = fConfig->GetProperty<bool>("busy-poll");
+        fNumPackets = 0;
+        fNumDropped = 0;
+        fBytesReceived = 0;
+
+        if (fInterface.empty()) {
+            LOG(error) << "No network interface given (--interface)";
+            throw std::runtime_error("No network interface given (--interface)");
+        }
+        if (fNumFrames == 0 || (fNumFrames & (fNumFrames - 1)) != 0 || (fFrameSize != 2048 && fFrameSize != 4096) || fBatchSize == 0) {
+            LOG(error) << "--num-frames has to be a power of two, --frame-size 2048 or 4096 and --batch-size at least 1";
+            throw std::runtime_error("--num-frames has to be a power of two, --frame-size 2048 or 4096 and --batch-size at least 1");
+        }
+        uint32_t bindFlags = 0;
+        if (fXdpMode == "zerocopy") {
+            bindFlags = XDP_ZEROCOPY;
+        } else if (fXdpMode == "copy") {
+            bindFlags = XDP_COPY;
+        } else if (fXdpMode != "auto") {
+            LOG(error) << "Invalid XDP mode '" << fXdpMode << "', valid are 'auto', 'zerocopy' and 'copy'";
+            throw std::runtime_error(tools::ToString("Invalid XDP mode '", fXdpMode, "', valid are 'auto', 'zerocopy' and 'copy'"));
+        }
+
+        // the UMEM has to be page aligned, the region of some transports is not
+        const size_t umemSize = static_cast<size_t>(fNumFrames) * fFrameSize;
+        fRegion = NewUnmanagedRegionFor(fOutChannel, umemSize + kPageSize, [this](const std::vector<RegionBlock>& blocks) {
+            ReleaseFrames(blocks);
+        });
+        fUmemArea = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(fRegion->GetData()) + kPageSize - 1) / kPageSize * kPageSize);
+
+        xsk_umem_config umemCfg{};
+        umemCfg.fill_size = fNumFrames;
+        umemCfg.comp_size = XSK_RING_CONS__DEFAULT_NUM_DESCS;
+        umemCfg.frame_size = fFrameSize;
+        umemCfg.frame_headroom = 0;
+        umemCfg.flags = 0;
+        if (int err = xsk_umem__create(&fUmem, fUmemArea, umemSize, &fFillRing, &fCompRing, &umemCfg); err != 0) {
+            fRegion.reset();
+            LOG(error) << "Could not register the region as UMEM: " << strerror(-err);
+            throw std::runtime_error(tools::ToString("Could not register the region as UMEM: ", strerror(-err)));
+        }
+
+        xsk_socket_config xskCfg{};
+        xskCfg.rx_size = fNumFrames;
+        xskCfg.tx_size = 0;
+        xskCfg.bind_flags = static_cast<uint16_t>(bindFlags | XDP_USE_NEED_WAKEUP);
+        if (int err = xsk_socket__create(&fXsk, fInterface.c_str(), fQueue, fUmem, &fRxRing, nullptr, &xskCfg); err != 0) {
+            Cleanup();
+            LOG(error) << "Could not create AF_XDP socket on " << fInterface << " queue " << fQueue << ": " << strerror(-err);
+            throw std::runtime_error(tools::ToString("Could not create AF_XDP socket on ", fInterface, " queue ", fQueue, ": ", strerror(-err)));
+        }
+
+        // hand all frames to the NIC
+        uint32_t idx = 0;
+        if (xsk_ring_prod__reserve(&fFillRing, fNumFrames, &idx) != fNumFrames) {
+            Cleanup();
+            throw std::runtime_error("Could not populate the fill ring");
+        }
+        for (uint32_t i = 0; i < fNumFrames; ++i) {
+            *xsk_ring_prod__fill_addr(&fFillRing, idx++) = static_cast<uint64_t>(i) * fFrameSize;
+        }
+        xsk_ring_prod__submit(&fFillRing, fNumFrames);
+
+        LOG(info) << "Receiving from " << fInterface << " queue " << fQueue << " into " << fNumFrames << " frames of " << fFrameSize
+                  << " bytes (" << fXdpMode << " mode)";
+    }
+
+    void Run() override
+    {
+        Channel& dataOutChannel = *fOutChannel;
+        const int fd = xsk_socket__fd(fXsk);
+        auto tStart = std::chrono::steady_clock::now();
+
+        while (!NewStatePending()) {
+            uint32_t idx = 0;
+            uint32_t num = xsk_ring_cons__peek(&fRxRing, fBatchSize, &idx);
+            if (num == 0) {
+                Kick(fd);
+                if (!fBusyPoll) {
+                    pollfd pfd{fd, POLLIN, 0};
+                    poll(&pfd, 1, 100);
+                }
+                continue;
+            }
+
+            Parts parts;
+            std::vector<uint64_t> dropped;
+            for (uint32_t i = 0; i < num; ++i) {
+                const xdp_desc* desc = xsk_ring_cons__rx_desc(&fRxRing, idx++);
+                const uint64_t addr = xsk_umem__add_offset_to_addr(desc->addr);
+                const uint64_t frame = addr - addr % fFrameSize;
+                char* packet = static_cast<char*>(xsk_umem__get_data(fUmemArea, addr));
+                size_t offset = 0;
+                size_t size = desc->len;
+                if (fStripHeaders && !UdpPayload(packet, desc->len, offset, size)) {
+                    dropped.push_back(frame);
+                    continue;
+                }
+                // the frame is returned to the fill ring when the message is released (the hint of the region block)
+                parts.AddPart(dataOutChannel.NewMessage(fRegion, packet + offset, size, reinterpret_cast<void*>(frame)));
+                fBytesReceived += size;
+            }
+            xsk_ring_cons__release(&fRxRing, num);
+            fNumPackets += num;
+            if (!dropped.empty()) {
+                fNumDropped += dropped.size();
+                Recycle(dropped.data(), dropped.size());
+            }
+
+            if (parts.Size() == 1) {
+                dataOutChannel.Send(parts.At(0));
+            } else if (parts.Size() > 1) {
+                dataOutChannel.Send(parts);
+            }
+        }
+
+        auto sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+        LOG(info) << "Received " << fNumPackets << " packets (" << fBytesReceived << " bytes) in " << sec * 1000. << "ms ("
+                  << (fBytesReceived / (1000. * 1000.)) / sec << " MB/s), dropped " << fNumDropped << " non-UDP packets";
+        LogStatistics();
+    }
+
+    void ResetTask() override { Cleanup(); }
+
+    void Cleanup()
+    {
+        {
+            std::lock_guard<std::mutex> lock(fFillMtx);
+            if (fXsk) {
+                xsk_socket__delete(fXsk);
+                fXsk = nullptr;
+            }
+            if (fUmem) {
+                xsk_umem__delete(fUmem);
+                fUmem = nullptr;
+            }
+            fPendingFrames.clear();
+        }
+        // messages still referring to the region are only acknowledged, no longer recycled
+        // (not under the lock, the region delivers the outstanding acknowledgements when it is destroyed)
+        fRegion.reset();
+    }
+
+    // region callback: the consumers are done with these frames
+    void ReleaseFrames(const std::vector<RegionBlock>& blocks)
+    {
+        std::vector<uint64_t> frames;
+        frames.reserve(blocks.size());
+        for (const auto& block : blocks) {
+            frames.push_back(reinterpret_cast<uint64_t>(block.hint));
+        }
+        Recycle(frames.data(), frames.size());
+    }
+
+    void Recycle(const uint64_t* frames, size_t num)
+    {
+        std::lock_guard<std::mutex> lock(fFillMtx);
+        if (!fXsk) {
+            return;
+        }
+        fPendingFrames.insert(fPendingFrames.end(), frames, frames + num);
+        uint32_t idx = 0;
+        uint32_t reserved = xsk_ring_prod__reserve(&fFillRing, static_cast<uint32_t>(fPendingFrames.size()), &idx);
+        for (uint32_t i = 0; i < reserved; ++i) {
+            *xsk_ring_prod__fill_addr(&fFillRing, idx++) = fPendingFrames[fPendingFrames.size() - reserved + i];
+        }
+        xsk_ring_prod__submit(&fFillRing, reserved);
+        fPendingFrames.resize(fPendingFrames.size() - reserved);
+        Kick(xsk_socket__fd(fXsk));
+    }
+
+    // with XDP_USE_NEED_WAKEUP the driver only processes the fill ring after a syscall, once it asks for it
+    void Kick(int fd)
+    {
+        if (xsk_ring_prod__needs_wakeup(&fFillRing)) {
+            recvfrom(fd, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+        }
+    }
+
+    // locate the UDP payload in an Ethernet frame (IPv4/IPv6, optionally VLAN tagged)
+    static bool UdpPayload(const char* packet, size_t len, size_t& offset, size_t& size)
+    {
+        auto u8 = [packet](size_t pos) { return static_cast<uint8_t>(packet[pos]); };
+        auto u16 = [&u8](size_t pos) { return static_cast<uint16_t>(u8(pos) << 8 | u8(pos + 1)); };
+        size_t pos = 12; // ethertype
+        if (len < pos + 2) {
+            return false;
+        }
+        uint16_t ethertype = u16(pos);
+        pos += 2;
+        if (ethertype == ETH_P_8021Q && len >= pos + 4) {
+            ethertype = u16(pos + 2);
+            pos += 4;
+        }
+        uint8_t protocol = 0;
+        if (ethertype == ETH_P_IP && len >= pos + 20) {
+            protocol = u8(pos + 9);
+            pos += (u8(pos) & 0x0f) * 4;
+        } else if (ethertype == ETH_P_IPV6 && len >= pos + 40) {
+            protocol = u8(pos + 6); // no extension headers
+            pos += 40;
+        }
+        constexpr uint8_t kUdp = 17;
+        if (protocol != kUdp || len < pos + 8 || u16(pos + 4) < 8) {
+            return false;
+        }
+        offset = pos + 8;
+        size = std::min<size_t>(u16(pos + 4) - 8, len - offset);
+        return true;
+    }
+
+    void LogStatistics()
+    {
+        xdp_statistics stats{};
+        socklen_t optlen = sizeof(stats);
+        if (getsockopt(xsk_socket__fd(fXsk), SOL_XDP, XDP_STATISTICS, &stats, &optlen) == 0) {
+            LOG(info) << "AF_XDP statistics: rx_dropped " << stats.rx_dropped << ", rx_invalid_descs " << stats.rx_invalid_descs
+                      << ", rx_ring_full " << stats.rx_ring_full << ", rx_fill_ring_empty " << stats.rx_fill_ring_empty_descs;
+        }
+    }
+
+  public:
+    ~XdpSource() override { Cleanup(); }
+};
+
+} // namespace fair::mq
+
+#endif /* FAIR_MQ_XDPSOURCE_H */
@@ -21,7 +21,16 @@ void addCustomOptions(bpo::options_description& options)
         ("msg-size", bpo::value<size_t>()->default_value(1000000), "Message size in bytes")
         ("msg-alignment", bpo::value<size_t>()->default_value(0), "Message alignment")
         ("max-iterations", bpo::value<uint64_t>()->default_value(0), "Number of run iterations (0 - infinite)")
-        ("msg-rate", bpo::value<float>()->default_value(0), "Msg rate limit in maximum number of messages per second");
+        ("msg-rate", bpo::value<float>()->default_value(0), "Msg rate limit in maximum number of messages per second")
+        ("msg-rate-mode", bpo::value<std::string>()->default_value("adaptive"), "How --msg-rate is enforced: 'adaptive' (sleeps), 'precise' (spins for short waits, smooth high rates) or 'token-bucket' (precise with bursts of --msg-rate-burst)")
+        ("msg-rate-burst", bpo::value<unsigned int>()->default_value(1), "Burst size (messages) of --msg-rate-mode token-bucket")
+        ("latency", bpo::value<bool>()->default_value(false), "Stamp a timestamp and sequence number into every message for latency measurement by the sink")
+        ("latency-clock", bpo::value<std::string>()->default_value("monotonic"), "Clock of the latency timestamps: 'monotonic' (same host) or 'realtime' (hosts with PTP synchronized clocks)")
+        ("use-region", bpo::value<bool>()->default_value(false), "Send slices of an unmanaged region, recycled via the region (acknowledgement) callback")
+        ("region-size", bpo::value<size_t>()->default_value(0), "Size of the unmanaged region in bytes (0 - 128 slots of msg-size per part)")
+        ("region-per-thread", bpo::value<bool>()->default_value(false), "With --use-region and --threads, one region per thread instead of one shared by all threads")
+        ("threads", bpo::value<size_t>()->default_value(1), "Number of sending threads, each on its own sub-channels (requires as many sub-channels, see --all-subchannels)")
+        ("all-subchannels", bpo::value<bool>()->default_value(false), "Send on all sub-channels of the output channel in turn, distributed over the threads (default: sub-channel 0 only)");
 }
 
 std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /* config */)
@@ -0,0 +1,30 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/devices/FileSource.h>
+#include <fairmq/runDevice.h>
+
+namespace bpo = boost::program_options;
+
+void addCustomOptions(bpo::options_description& options)
+{
+    options.add_options()
+        ("out-channel", bpo::value<std::string>()->default_value("data"), "Name of the output channel")
+        ("in-filename", bpo::value<std::string>()->default_value(""), "Recorded file to replay")
+        ("index-file", bpo::value<std::string>()->default_value(""), "Index with the part sizes of every message (one message per line), empty - messages of --msg-size bytes")
+        ("msg-size", bpo::value<size_t>()->default_value(1000000), "Message size in bytes without --index-file")
+        ("playback-mode", bpo::value<std::string>()->default_value("copy"), "'copy' (from the file mapping into new messages) or 'region' (load the file into an unmanaged region once, send without copies)")
+        ("region-hugepages", bpo::value<bool>()->default_value(false), "Back the region of --playback-mode region with huge pages")
+        ("msg-rate", bpo::value<float>()->default_value(0), "Msg rate limit in maximum number of messages per second")
+        ("loops", bpo::value<uint64_t>()->default_value(1), "Number of times to replay the file (0 - infinite)");
+}
+
+std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /* config */)
+{
+    return std::make_unique<fair::mq::FileSource>();
+}
@@ -16,7 +16,17 @@ void addCustomOptions(bpo::options_description& options)
     options.add_options()
         ("in-channel", bpo::value<std::string>()->default_value("data-in"), "Name of the input channel")
         ("out-channel", bpo::value<std::string>()->default_value("data-out"), "Name of the output channel")
-        ("multipart", bpo::value<bool>()->default_value(true), "Handle multipart payloads");
+        ("multipart", bpo::value<bool>()->default_value(true), "Handle multipart payloads")
+        ("merge-mode", bpo::value<std::string>()->default_value("index"), "Merge mode: 'index' (ready inputs in index order), 'round-robin' (weighted, see --input-weights), 'timestamp' (ordered by the first 8 payload bytes) or 'sequence' (reordered by a sequence number in the first 8 payload bytes)")
+        ("input-weights", bpo::value<std::vector<int>>()->multitoken()->composing(), "Messages per input and round in round-robin mode (missing weights are 1)")
+        ("merge-timeout", bpo::value<int>()->default_value(10), "Time in ms after which an input without data is not waited for in timestamp mode")
+        ("reorder-window", bpo::value<size_t>()->default_value(1024), "Number of messages the reorder window holds in sequence mode")
+        ("reorder-timeout", bpo::value<int>()->default_value(100), "Time in ms after which a missing message is not waited for in sequence mode")
+        ("first-sequence", bpo::value<uint64_t>()->default_value(0), "First sequence number in sequence mode")
+        ("report-interval", bpo::value<unsigned int>()->default_value(0), "Interval in seconds for logging the reorder window in sequence mode (0 - only at the end of RUNNING)")
+        ("batch-size", bpo::value<size_t>()->default_value(0), "Bundle the forwarded messages into one multipart message of at least this many bytes (0 - no size threshold)")
+        ("batch-count", bpo::value<size_t>()->default_value(0), "Bundle this many forwarded messages into one multipart message (0 - no count threshold)")
+        ("batch-timeout", bpo::value<int>()->default_value(10), "Time in ms after which an incomplete batch is sent");
 }
 
 std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /*config*/)
@@ -0,0 +1,32 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/devices/PingPong.h>
+#include <fairmq/runDevice.h>
+
+#include <vector>
+
+namespace bpo = boost::program_options;
+
+void addCustomOptions(bpo::options_description& options)
+{
+    options.add_options()
+        ("role", bpo::value<std::string>()->default_value("initiator"), "'initiator' (sends the pings and measures) or 'reflector' (sends them back)")
+        ("channel", bpo::value<std::string>()->default_value("ping"), "Name of the channel the pings go out on (pair, req/rep or push/pull)")
+        ("return-channel", bpo::value<std::string>()->default_value(""), "Name of the channel the pings come back on (push/pull loops, empty - the same channel)")
+        ("msg-size", bpo::value<std::vector<size_t>>()->multitoken()->default_value(std::vector<size_t>{64}, "64"), "Message sizes in bytes to measure one after the other (initiator, at least 24)")
+        ("iterations", bpo::value<uint64_t>()->default_value(10000), "Measured round trips per message size (initiator)")
+        ("warmup", bpo::value<uint64_t>()->default_value(1000), "Round trips per message size before measuring (initiator)")
+        ("busy-poll", bpo::value<bool>()->default_value(false), "Receive with non-blocking calls in a loop instead of blocking")
+        ("output", bpo::value<std::string>()->default_value(""), "Append the results to this CSV file (initiator, empty - only log them)");
+}
+
+std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /*config*/)
+{
+    return std::make_unique<fair::mq::PingPong>();
+}
@@ -18,7 +18,18 @@ void addCustomOptions(bpo::options_description& options)
         ("out-filename", bpo::value<std::string>()->default_value(""), "Write incoming message buffers to the specified file")
         ("max-file-size", bpo::value<uint64_t>()->default_value(2000000000), "Maximum file size for the file output (0 - unlimited)")
         ("max-iterations", bpo::value<uint64_t>()->default_value(0), "Number of run iterations (0 - infinite)")
-        ("multipart", bpo::value<bool>()->default_value(false), "Handle multipart payloads");
+        ("multipart", bpo::value<bool>()->default_value(false), "Handle multipart payloads")
+        ("latency", bpo::value<bool>()->default_value(false), "Record the one-way latency of messages stamped by fairmq-bsampler --latency")
+        ("latency-report-interval", bpo::value<unsigned int>()->default_value(1), "Interval in seconds for reporting the latency percentiles (0 - only at the end of RUNNING)")
+        ("async-write", bpo::value<bool>()->default_value(false), "Write the output file on a separate thread, holding the messages until written")
+        ("direct-io", bpo::value<bool>()->default_value(false), "With --async-write: write with O_DIRECT via aligned buffers")
+        ("uring-write", bpo::value<bool>()->default_value(false), "With --async-write: submit the writes via io_uring (if FairMQ is built with the io_uring transport)")
+        ("write-buffer-size", bpo::value<size_t>()->default_value(8 << 20), "With --async-write: bytes per write call")
+        ("write-queue-size", bpo::value<size_t>()->default_value(256 << 20), "With --async-write: maximum bytes waiting to be written before receiving blocks")
+        ("rotate-file-size", bpo::value<uint64_t>()->default_value(0), "With --async-write: start a new file (<out-filename>.1, .2, ...) after this many bytes (0 - single file)")
+        ("threads", bpo::value<size_t>()->default_value(1), "Number of receiving threads, each on its own sub-channels (requires as many sub-channels, see --all-subchannels; not with --out-filename)")
+        ("all-subchannels", bpo::value<bool>()->default_value(false), "Receive on all sub-channels of the input channel in turn, distributed over the threads (default: sub-channel 0 only)")
+        ("touch", bpo::value<bool>()->default_value(false), "Read every cache line of the received data, like a consumer processing it");
 }
 
 std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /*config*/)
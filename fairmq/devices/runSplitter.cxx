@@ -16,7 +16,13 @@ void addCustomOptions(bpo::options_description& options)
     options.add_options()
         ("in-channel", bpo::value<std::string>()->default_value("data-in"), "Name of the input channel")
         ("out-channel", bpo::value<std::string>()->default_value("data-out"), "Name of the output channel")
-        ("multipart", bpo::value<bool>()->default_value(true), "Handle multipart payloads");
+        ("multipart", bpo::value<bool>()->default_value(true), "Handle multipart payloads")
+        ("dispatch", bpo::value<std::string>()->default_value("round-robin"), "Dispatch mode: 'round-robin', 'credit' (to the output with most credits on the credit channel) or 'scatter' (part range i of every multipart message to output i)")
+        ("scatter-parts", bpo::value<std::string>()->default_value(""), "Number of parts per output with --dispatch scatter, comma separated (e.g. '1,2,1'), empty: one part per output")
+        ("numa-nodes", bpo::value<std::string>()->default_value(""), "NUMA node of the consumer of every output, comma separated (e.g. '0,0,1,1'): messages go to the outputs on the NUMA node of their memory (empty: no locality)")
+        ("numa-max-queue", bpo::value<int>()->default_value(0), "With --numa-nodes and round-robin dispatch: queue depth of all local outputs from which on the least loaded output is taken (0: always local)")
+        ("credit-channel", bpo::value<std::string>()->default_value("credits"), "Name of the channel with the consumer credits (one subchannel per output, only with --dispatch credit)")
+        ("report-interval", bpo::value<unsigned int>()->default_value(0), "Interval in seconds for logging the messages sent and queue depth per output (0 - only at the end of RUNNING)");
 }
 
 std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /*config*/)
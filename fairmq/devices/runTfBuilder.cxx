@@ -0,0 +1,31 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/devices/TfBuilder.h>
+#include <fairmq/runDevice.h>
+
+namespace bpo = boost::program_options;
+
+void addCustomOptions(bpo::options_description& options)
+{
+    options.add_options()
+        ("in-channel", bpo::value<std::string>()->default_value("data-in"), "Name of the input channel")
+        ("out-channel", bpo::value<std::string>()->default_value("data-out"), "Name of the output channel")
+        ("tf-id-part", bpo::value<int>()->default_value(0), "Part of the messages holding the frame id")
+        ("tf-id-offset", bpo::value<size_t>()->default_value(0), "Offset of the frame id in the payload of the part, in bytes")
+        ("tf-id-size", bpo::value<size_t>()->default_value(8), "Size of the frame id (1, 2, 4 or 8 bytes, host byte order)")
+        ("tf-contributions", bpo::value<size_t>()->default_value(0), "Number of messages per frame (0 - number of input subchannels)")
+        ("tf-slots", bpo::value<size_t>()->default_value(1024), "Number of frames built at the same time (per thread)")
+        ("tf-timeout", bpo::value<int>()->default_value(1000), "Time in ms after the first contribution after which an incomplete frame is evicted")
+        ("tf-threads", bpo::value<int>()->default_value(1), "Number of threads building frames");
+}
+
+std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /*config*/)
+{
+    return std::make_unique<fair::mq::TfBuilder>();
+}
@@ -0,0 +1,31 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/devices/XdpSource.h>
+#include <fairmq/runDevice.h>
+
+namespace bpo = boost::program_options;
+
+void addCustomOptions(bpo::options_description& options)
+{
+    options.add_options()
+        ("out-channel", bpo::value<std::string>()->default_value("data"), "Name of the output channel")
+        ("interface", bpo::value<std::string>()->default_value(""), "Network interface to receive from")
+        ("queue", bpo::value<uint32_t>()->default_value(0), "Receive queue of the interface (steer the detector streams to it, e.g. with ethtool -N)")
+        ("num-frames", bpo::value<uint32_t>()->default_value(4096), "Number of packet buffers (power of two), allocated in an unmanaged region of the output channel")
+        ("frame-size", bpo::value<uint32_t>()->default_value(4096), "Size of a packet buffer in bytes (2048 or 4096), the maximum packet size")
+        ("batch-size", bpo::value<uint32_t>()->default_value(64), "Maximum number of packets sent together as one multipart message")
+        ("xdp-mode", bpo::value<std::string>()->default_value("auto"), "'zerocopy' (the NIC writes into the region, requires driver support), 'copy' (the kernel copies into the region) or 'auto'")
+        ("strip-headers", bpo::value<bool>()->default_value(true), "Send the UDP payload only, drop non-UDP packets")
+        ("busy-poll", bpo::value<bool>()->default_value(false), "Poll the receive ring without sleeping");
+}
+
+std::unique_ptr<fair::mq::Device> getDevice(fair::mq::ProgOptions& /* config */)
+{
+    return std::make_unique<fair::mq::XdpSource>();
+}
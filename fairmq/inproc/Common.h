@@ -0,0 +1,141 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPROC_COMMON_H
+#define FAIR_MQ_INPROC_COMMON_H
+
+#include <fairmq/tools/Queues.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace fair::mq::inproc
+{
+
+// event bits returned by Socket::Events(), same values as ZMQ_POLLIN/ZMQ_POLLOUT
+constexpr uint32_t kPollIn = 1;
+constexpr uint32_t kPollOut = 2;
+
+/// Bounded lock-free multi-producer/multi-consumer queue of the endpoints
+template<typename T>
+using BoundedQueue = tools::MpmcQueue<T>;
+
+class MultiWaiter;
+
+/// Wakes up threads blocked in send, receive or poll calls on one pipe. Costs a fence and a load when nobody waits.
+class Notifier
+{
+  public:
+    /// Wait until notified or the timeout expired. ready is checked under the lock after registering as waiter,
+    /// so a notification between the caller's last check and the wait is not lost.
+    template<typename Ready>
+    void Wait(Ready&& ready, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(fMtx);
+        fWaiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            fCV.wait_for(lock, timeout);
+        }
+        fWaiters.fetch_sub(1);
+    }
+
+    inline void Notify();
+
+  private:
+    friend class MultiWaiter;
+
+    void Attach(MultiWaiter* waiter)
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fAttached.push_back(waiter);
+        fWaiters.fetch_add(1);
+    }
+
+    void Detach(MultiWaiter* waiter)
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        for (auto it = fAttached.begin(); it != fAttached.end(); ++it) {
+            if (*it == waiter) {
+                fAttached.erase(it);
+                break;
+            }
+        }
+        fWaiters.fetch_sub(1);
+    }
+
+    std::mutex fMtx;
+    std::condition_variable fCV;
+    std::atomic<int> fWaiters{0}; // blocked in Wait() or attached
+    std::vector<MultiWaiter*> fAttached;
+};
+
+/// Wait of one thread on the notifiers of several pipes (a poller, a socket with several endpoints). It is attached
+/// to these notifiers only for the duration of the wait, so it is woken up by its own pipes only, and wakes up no one else.
+class MultiWaiter
+{
+  public:
+    /// Wait until one of the notifiers is notified or the timeout expired. ready is checked after attaching.
+    template<typename Ready>
+    void Wait(const std::vector<Notifier*>& notifiers, Ready&& ready, std::chrono::milliseconds timeout)
+    {
+        for (Notifier* notifier : notifiers) {
+            notifier->Attach(this);
+        }
+        {
+            std::unique_lock<std::mutex> lock(fMtx);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!fSignaled && !ready()) {
+                fCV.wait_for(lock, timeout, [this]() { return fSignaled; });
+            }
+            fSignaled = false;
+        }
+        for (Notifier* notifier : notifiers) {
+            notifier->Detach(this);
+        }
+    }
+
+  private:
+    friend class Notifier;
+
+    void Signal()
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            fSignaled = true;
+        }
+        fCV.notify_one();
+    }
+
+    std::mutex fMtx;
+    std::condition_variable fCV;
+    bool fSignaled = false;
+};
+
+void Notifier::Notify()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (fWaiters.load(std::memory_order_relaxed) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            for (MultiWaiter* waiter : fAttached) {
+                waiter->Signal();
+            }
+        }
+        fCV.notify_all();
+    }
+}
+
+} // namespace fair::mq::inproc
+
+#endif /* FAIR_MQ_INPROC_COMMON_H */
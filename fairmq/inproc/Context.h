@@ -0,0 +1,151 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPROC_CONTEXT_H_
+#define FAIR_MQ_INPROC_CONTEXT_H_
+
+#include <fairmq/UnmanagedRegion.h>
+
+#include <fairlogger/Logger.h>
+
+#include <algorithm> // find_if
+#include <atomic>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace fair::mq::inproc
+{
+
+/// State shared by all sockets and regions of an inproc transport: interruption flag and (process local) region events
+class Context
+{
+  public:
+    Context()
+        : fInterrupted(false)
+        , fRegionCounter(1)
+        , fRegionEventsSubscriptionActive(false)
+    {
+        fRegionEvents.emplace(true, 0, nullptr, 0, 0, RegionEvent::local_only);
+    }
+
+    Context(const Context&) = delete;
+    Context(Context&&) = delete;
+    Context& operator=(const Context&) = delete;
+    Context& operator=(Context&&) = delete;
+
+    void SubscribeToRegionEvents(RegionEventCallback callback)
+    {
+        if (fRegionEventThread.joinable()) {
+            LOG(debug) << "Already subscribed. Overwriting previous subscription.";
+            {
+                std::lock_guard<std::mutex> lock(fMtx);
+                fRegionEventsSubscriptionActive = false;
+            }
+            fRegionEventsCV.notify_one();
+            fRegionEventThread.join();
+        }
+        std::lock_guard<std::mutex> lock(fMtx);
+        fRegionEventCallback = callback;
+        fRegionEventsSubscriptionActive = true;
+        fRegionEventThread = std::thread(&Context::RegionEventsSubscription, this);
+    }
+
+    bool SubscribedToRegionEvents() const { return fRegionEventThread.joinable(); }
+
+    void UnsubscribeFromRegionEvents()
+    {
+        if (fRegionEventThread.joinable()) {
+            std::unique_lock<std::mutex> lock(fMtx);
+            fRegionEventsSubscriptionActive = false;
+            lock.unlock();
+            fRegionEventsCV.notify_one();
+            fRegionEventThread.join();
+            lock.lock();
+            fRegionEventCallback = nullptr;
+        }
+    }
+
+    std::vector<RegionInfo> GetRegionInfo() const
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        return fRegionInfos;
+    }
+
+    uint16_t NextRegionId()
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        return fRegionCounter++;
+    }
+
+    void AddRegion(uint16_t id, void* ptr, size_t size, int64_t userFlags)
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            fRegionInfos.emplace_back(false, id, ptr, size, userFlags, RegionEvent::created);
+            fRegionEvents.emplace(false, id, ptr, size, userFlags, RegionEvent::created);
+        }
+        fRegionEventsCV.notify_one();
+    }
+
+    void RemoveRegion(uint16_t id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            auto it = find_if(fRegionInfos.begin(), fRegionInfos.end(), [id](const RegionInfo& i) { return i.id == id; });
+            if (it != fRegionInfos.end()) {
+                fRegionEvents.push(*it);
+                fRegionEvents.back().event = RegionEvent::destroyed;
+                fRegionInfos.erase(it);
+            } else {
+                LOG(error) << "RemoveRegion: given id (" << id << ") not found.";
+            }
+        }
+        fRegionEventsCV.notify_one();
+    }
+
+    void Interrupt() { fInterrupted.store(true); }
+    void Resume() { fInterrupted.store(false); }
+    void Reset() {}
+    bool Interrupted() const { return fInterrupted.load(); }
+
+    ~Context() { UnsubscribeFromRegionEvents(); }
+
+  private:
+    void RegionEventsSubscription()
+    {
+        std::unique_lock<std::mutex> lock(fMtx);
+        while (fRegionEventsSubscriptionActive) {
+            while (!fRegionEvents.empty()) {
+                auto i = fRegionEvents.front();
+                fRegionEventCallback(i);
+                fRegionEvents.pop();
+            }
+            fRegionEventsCV.wait(lock, [&]() { return !fRegionEventsSubscriptionActive || !fRegionEvents.empty(); });
+        }
+    }
+
+    mutable std::mutex fMtx;
+    std::atomic<bool> fInterrupted;
+
+    uint16_t fRegionCounter;
+    std::condition_variable fRegionEventsCV;
+    std::vector<RegionInfo> fRegionInfos;
+    std::queue<RegionInfo> fRegionEvents;
+    std::thread fRegionEventThread;
+    std::function<void(RegionInfo)> fRegionEventCallback;
+    bool fRegionEventsSubscriptionActive;
+};
+
+} // namespace fair::mq::inproc
+
+#endif /* FAIR_MQ_INPROC_CONTEXT_H_ */
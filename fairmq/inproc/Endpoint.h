@@ -0,0 +1,138 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPROC_ENDPOINT_H
+#define FAIR_MQ_INPROC_ENDPOINT_H
+
+#include <fairmq/inproc/Common.h>
+#include <fairmq/inproc/Message.h>
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <iterator> // next
+#include <memory> // shared_ptr, weak_ptr
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fair::mq::inproc
+{
+
+// a queued message: either a single message or the parts of a multipart message
+struct Item
+{
+    Message* fMsg = nullptr;
+    std::vector<MessagePtr>* fParts = nullptr;
+};
+
+// one direction of an endpoint
+class Pipe
+{
+  public:
+    explicit Pipe(size_t capacity)
+        : fQueue(capacity)
+    {}
+
+    bool TryPush(Item item)
+    {
+        if (!fQueue.TryPush(item)) {
+            return false;
+        }
+        Notify();
+        return true;
+    }
+
+    bool TryPop(Item& item)
+    {
+        if (!fQueue.TryPop(item)) {
+            return false;
+        }
+        Notify(); // blocked senders
+        return true;
+    }
+
+    bool Empty() const { return fQueue.Empty(); }
+    bool Full() const { return fQueue.Full(); }
+    size_t Size() const { return fQueue.Size(); }
+
+    Notifier& GetNotifier() { return fNotifier; }
+
+    ~Pipe()
+    {
+        Item item;
+        while (fQueue.TryPop(item)) {
+            delete item.fMsg;
+            delete item.fParts;
+        }
+    }
+
+  private:
+    void Notify() { fNotifier.Notify(); }
+
+    BoundedQueue<Item> fQueue;
+    Notifier fNotifier;
+};
+
+/// An inproc:// address, shared by the sockets bound and connected to it. Messages queued in it stay valid until the
+/// last of these sockets is gone.
+struct Endpoint
+{
+    static constexpr size_t kSpares = 256;
+
+    explicit Endpoint(size_t capacity)
+        : fToBinder(capacity)
+        , fToConnector(capacity)
+        , fSpares(kSpares)
+        , fBound(false)
+        , fConnectors(0)
+    {}
+
+    Endpoint(const Endpoint&) = delete;
+    Endpoint(Endpoint&&) = delete;
+    Endpoint& operator=(const Endpoint&) = delete;
+    Endpoint& operator=(Endpoint&&) = delete;
+
+    ~Endpoint()
+    {
+        Message* msg = nullptr;
+        while (fSpares.TryPop(msg)) {
+            delete msg;
+        }
+    }
+
+    Pipe fToBinder;
+    Pipe fToConnector;
+    // empty message objects released by receivers, handed to senders to replace the sent ones
+    BoundedQueue<Message*> fSpares;
+    std::atomic<bool> fBound;
+    std::atomic<int> fConnectors;
+};
+
+/// Finds or creates the endpoint of an address. The first socket that uses an address sets the queue capacity.
+inline std::shared_ptr<Endpoint> GetEndpoint(const std::string& address, size_t capacity)
+{
+    static std::mutex mtx;
+    static std::unordered_map<std::string, std::weak_ptr<Endpoint>> endpoints;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto it = endpoints.begin(); it != endpoints.end();) {
+        it = it->second.expired() ? endpoints.erase(it) : std::next(it);
+    }
+    auto& weak = endpoints[address];
+    auto endpoint = weak.lock();
+    if (!endpoint) {
+        endpoint = std::make_shared<Endpoint>(capacity);
+        weak = endpoint;
+    }
+    return endpoint;
+}
+
+} // namespace fair::mq::inproc
+
+#endif /* FAIR_MQ_INPROC_ENDPOINT_H */
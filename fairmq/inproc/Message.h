@@ -0,0 +1,196 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPROC_MESSAGE_H
+#define FAIR_MQ_INPROC_MESSAGE_H
+
+#include <fairmq/Message.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/Transports.h>
+#include <fairmq/UnmanagedRegion.h>
+#include <fairmq/inproc/UnmanagedRegion.h>
+
+#include <fairlogger/Logger.h>
+
+#include <algorithm> // max
+#include <cstddef>
+#include <cstdlib> // malloc, posix_memalign
+#include <memory> // shared_ptr
+#include <new> // bad_alloc
+
+namespace fair::mq::inproc
+{
+
+/// Heap (or unmanaged region) buffer. The sockets pass the message objects themselves, the buffer is never copied.
+class Message final : public fair::mq::Message
+{
+  public:
+    Message(const Message&) = delete;
+    Message(Message&&) = delete;
+    Message& operator=(const Message&) = delete;
+    Message& operator=(Message&&) = delete;
+
+    Message(fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Message(factory)
+    {}
+
+    Message(Alignment alignment, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Message(factory)
+        , fAlignment(alignment.alignment)
+    {}
+
+    Message(const size_t size, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Message(factory)
+    {
+        Allocate(size);
+    }
+
+    Message(const size_t size, Alignment alignment, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Message(factory)
+        , fAlignment(alignment.alignment)
+    {
+        Allocate(size);
+    }
+
+    Message(void* data, const size_t size, fair::mq::FreeFn* ffn, void* hint = nullptr, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Message(factory)
+    {
+        Adopt(data, size, ffn, hint);
+    }
+
+    Message(UnmanagedRegionPtr& region, void* data, const size_t size, void* hint = 0, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Message(factory)
+    {
+        if (region->GetType() != GetType()) {
+            LOG(error) << "region type (" << region->GetType() << ") does not match message type (" << GetType() << ")";
+            throw TransportError(tools::ToString("region type (", region->GetType(), ") does not match message type (", GetType(), ")"));
+        }
+        const char* begin = static_cast<const char*>(region->GetData());
+        if (static_cast<const char*>(data) < begin || static_cast<const char*>(data) + size > begin + region->GetSize()) {
+            LOG(error) << "trying to create region message with data from outside the region";
+            throw TransportError("trying to create region message with data from outside the region");
+        }
+
+        // zero-copy: the buffer stays in the region, the region callback is called once the last reference is gone
+        fRegion = static_cast<UnmanagedRegion*>(region.get())->fState;
+        fBuffer = std::shared_ptr<char>(static_cast<char*>(data), [state = fRegion, size, hint](char* ptr) { state->Release(ptr, size, hint); });
+        fData = fBuffer.get();
+        fSize = size;
+    }
+
+    void Rebuild() override { CloseMessage(); }
+
+    void Rebuild(Alignment alignment) override
+    {
+        CloseMessage();
+        fAlignment = alignment.alignment;
+    }
+
+    void Rebuild(size_t size) override
+    {
+        CloseMessage();
+        Allocate(size);
+    }
+
+    void Rebuild(size_t size, Alignment alignment) override
+    {
+        CloseMessage();
+        fAlignment = alignment.alignment;
+        Allocate(size);
+    }
+
+    void Rebuild(void* data, size_t size, fair::mq::FreeFn* ffn, void* hint = nullptr) override
+    {
+        CloseMessage();
+        Adopt(data, size, ffn, hint);
+    }
+
+    void* GetData() const override { return fSize > 0 ? fData : nullptr; }
+    size_t GetSize() const override { return fSize; }
+
+    bool SetUsedSize(size_t size) override
+    {
+        if (size > fSize) {
+            LOG(error) << "cannot set used size higher than original.";
+            return false;
+        }
+        fSize = size;
+        return true;
+    }
+
+    Transport GetType() const override { return Transport::INPROC; }
+
+    void Copy(const fair::mq::Message& msg) override
+    {
+        const Message& other = static_cast<const Message&>(msg);
+        // shares the buffer
+        fBuffer = other.fBuffer;
+        fRegion = other.fRegion;
+        fData = other.fData;
+        fSize = other.fSize;
+    }
+
+    ~Message() override = default;
+
+  private:
+    size_t fAlignment = 0;
+    std::shared_ptr<char> fBuffer;
+    std::shared_ptr<RegionState> fRegion; // set for messages in an unmanaged region
+    char* fData = nullptr;
+    size_t fSize = 0;
+
+    char* Allocate(size_t size)
+    {
+        if (size == 0) {
+            return nullptr;
+        }
+        void* ptr = nullptr;
+        if (fAlignment != 0) {
+            size_t alignment = std::max(fAlignment, sizeof(void*));
+            if (posix_memalign(&ptr, alignment, size) != 0) {
+                ptr = nullptr;
+            }
+        } else {
+            ptr = malloc(size);
+        }
+        if (!ptr) {
+            LOG(error) << "failed to allocate buffer with provided size (" << size << ") and alignment (" << fAlignment << ").";
+            throw std::bad_alloc();
+        }
+        fBuffer = std::shared_ptr<char>(static_cast<char*>(ptr), [](char* p) { free(p); });
+        fData = fBuffer.get();
+        fSize = size;
+        return fData;
+    }
+
+    void Adopt(void* data, size_t size, fair::mq::FreeFn* ffn, void* hint)
+    {
+        fBuffer = std::shared_ptr<char>(static_cast<char*>(data), [ffn, hint](char* p) {
+            if (ffn) {
+                ffn(p, hint);
+            } else {
+                free(p);
+            }
+        });
+        fData = fBuffer.get();
+        fSize = size;
+    }
+
+    void CloseMessage()
+    {
+        fBuffer.reset();
+        fRegion.reset();
+        fData = nullptr;
+        fSize = 0;
+        fAlignment = 0;
+    }
+};
+
+} // namespace fair::mq::inproc
+
+#endif /* FAIR_MQ_INPROC_MESSAGE_H */
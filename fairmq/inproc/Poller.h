@@ -0,0 +1,163 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPROC_POLLER_H
+#define FAIR_MQ_INPROC_POLLER_H
+
+#include <fairlogger/Logger.h>
+#include <fairmq/Channel.h>
+#include <fairmq/Poller.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/inproc/Common.h>
+#include <fairmq/inproc/Socket.h>
+
+#include <algorithm> // min, max
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+namespace fair::mq::inproc
+{
+
+class Poller final : public fair::mq::Poller
+{
+  public:
+    Poller() = default;
+    Poller(const Poller&) = delete;
+    Poller(Poller&&) = delete;
+    Poller& operator=(const Poller&) = delete;
+    Poller& operator=(Poller&&) = delete;
+
+    Poller(const std::vector<Channel>& channels)
+    {
+        for (const auto& channel : channels) {
+            fSockets.push_back(static_cast<Socket*>(&(channel.GetSocket())));
+        }
+        fEvents.resize(fSockets.size(), 0);
+    }
+
+    Poller(const std::vector<Channel*>& channels)
+    {
+        for (const auto& channel : channels) {
+            fSockets.push_back(static_cast<Socket*>(&(channel->GetSocket())));
+        }
+        fEvents.resize(fSockets.size(), 0);
+    }
+
+    Poller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList)
+    {
+        try {
+            int offset = 0;
+            // calculate offsets and the total size of the poll item set
+            for (std::string const & channel : channelList) {
+                fOffsetMap[channel] = offset;
+                offset += channelsMap.at(channel).size();
+                for (const auto& c : channelsMap.at(channel)) {
+                    fSockets.push_back(static_cast<Socket*>(&(c.GetSocket())));
+                }
+            }
+            fEvents.resize(fSockets.size(), 0);
+        } catch (const std::out_of_range& oor) {
+            LOG(error) << "at least one of the provided channel keys for poller initialization is invalid";
+            LOG(error) << "out of range error: " << oor.what();
+            throw fair::mq::PollerError(fair::mq::tools::ToString("At least one of the provided channel keys for poller initialization is invalid. ", "Out of range error: ", oor.what()));
+        }
+    }
+
+    void Poll(int timeout) override
+    {
+        // wait in slices, to return on interruption
+        constexpr int slice = 20;
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            if (Update() || timeout == 0) {
+                return;
+            }
+            int wait = slice;
+            if (timeout > 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                if (elapsed >= timeout) {
+                    return;
+                }
+                wait = std::min(slice, timeout - static_cast<int>(elapsed));
+            }
+            for (Socket* socket : fSockets) {
+                if (socket->fCtx.Interrupted()) {
+                    return;
+                }
+            }
+            // woken up by the pipes of the polled sockets only
+            fNotifiers.clear();
+            for (Socket* socket : fSockets) {
+                socket->AddNotifiers(fNotifiers, kPollIn | kPollOut);
+            }
+            fWaiter.Wait(fNotifiers, [this]() { return Ready(); }, std::chrono::milliseconds(wait));
+        }
+    }
+
+    bool CheckInput(int index) override { return fEvents.at(index) & kPollIn; }
+
+    bool CheckOutput(int index) override { return fEvents.at(index) & kPollOut; }
+
+    bool CheckInput(const std::string& channelKey, int index) override
+    {
+        try {
+            return fEvents.at(fOffsetMap.at(channelKey) + index) & kPollIn;
+        } catch (const std::out_of_range& oor) {
+            LOG(error) << "invalid channel key: '" << channelKey << "'";
+            LOG(error) << "out of range error: " << oor.what();
+            throw fair::mq::PollerError(fair::mq::tools::ToString("Invalid channel key '", channelKey, "'. Out of range error: ", oor.what()));
+        }
+    }
+
+    bool CheckOutput(const std::string& channelKey, int index) override
+    {
+        try {
+            return fEvents.at(fOffsetMap.at(channelKey) + index) & kPollOut;
+        } catch (const std::out_of_range& oor) {
+            LOG(error) << "invalid channel key: '" << channelKey << "'";
+            LOG(error) << "out of range error: " << oor.what();
+            throw fair::mq::PollerError(fair::mq::tools::ToString("Invalid channel key '", channelKey, "'. Out of range error: ", oor.what()));
+        }
+    }
+
+    ~Poller() override = default;
+
+  private:
+    // @return true if any socket has events
+    bool Update()
+    {
+        bool ready = false;
+        for (size_t i = 0; i < fSockets.size(); ++i) {
+            fEvents[i] = fSockets[i]->PollResult();
+            ready = ready || fEvents[i] != 0;
+        }
+        return ready;
+    }
+
+    bool Ready() const
+    {
+        for (const Socket* socket : fSockets) {
+            if (socket->PollResult() != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Socket*> fSockets;
+    std::vector<uint32_t> fEvents;
+    MultiWaiter fWaiter;
+    std::vector<Notifier*> fNotifiers;
+
+    std::unordered_map<std::string, int> fOffsetMap;
+};
+
+} // namespace fair::mq::inproc
+
+#endif /* FAIR_MQ_INPROC_POLLER_H */
@@ -0,0 +1,508 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPROC_SOCKET_H
+#define FAIR_MQ_INPROC_SOCKET_H
+
+#include <fairmq/inproc/Common.h>
+#include <fairmq/inproc/Context.h>
+#include <fairmq/inproc/Endpoint.h>
+#include <fairmq/inproc/Message.h>
+#include <fairmq/Socket.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/Transports.h>
+
+#include <fairlogger/Logger.h>
+
+#include <algorithm> // min, max
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <memory> // shared_ptr, unique_ptr
+#include <string>
+#include <utility> // move
+#include <vector>
+
+namespace fair::mq::inproc
+{
+
+class Poller;
+
+/// PUSH/PULL and PAIR socket within one process. Sending queues the message object itself (a pointer) into a
+/// lock-free queue of the inproc:// endpoint, receiving takes it out: the data is neither copied nor moved.
+/// The sender gets an empty message object back, recycled from earlier receives.
+class Socket final : public fair::mq::Socket
+{
+    friend class Poller;
+
+    static constexpr int kWaitSlice = 20; // ms, interruption is checked between the slices of a blocking wait
+
+  public:
+    Socket(Context& ctx, const std::string& type, const std::string& name, const std::string& id, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Socket(factory)
+        , fCtx(ctx)
+        , fId(id + "." + name + "." + type)
+        , fType(type)
+        , fBytesTx(0)
+        , fBytesRx(0)
+        , fMessagesTx(0)
+        , fMessagesRx(0)
+        , fLinger(1000)
+        , fSndHwm(1000)
+        , fRcvHwm(1000)
+        , fNextIn(0)
+        , fNextOut(0)
+        , fPendingPos(0)
+        , fLastEndpoint(nullptr)
+    {
+        if (type != "push" && type != "pull" && type != "pair") {
+            LOG(error) << "Failed creating socket " << fId << ", reason: socket type '" << type << "' is not supported by the inproc transport (push, pull, pair)";
+            throw SocketError(tools::ToString("Unavailable socket type for the inproc transport requested: ", type));
+        }
+        LOG(debug) << "Created socket " << GetId();
+    }
+
+    Socket(const Socket&) = delete;
+    Socket(Socket&&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket& operator=(Socket&&) = delete;
+
+    std::string GetId() const override { return fId; }
+
+    bool Bind(const std::string& address) override
+    {
+        auto endpoint = Attach(address);
+        if (!endpoint) {
+            return false;
+        }
+        if (endpoint->fBound.exchange(true)) {
+            LOG(error) << "Failed binding socket " << fId << ", address: " << address << ", reason: address already in use";
+            return false;
+        }
+        fLinks.push_back({endpoint, &endpoint->fToBinder, &endpoint->fToConnector, true});
+        return true;
+    }
+
+    bool Connect(const std::string& address) override
+    {
+        auto endpoint = Attach(address);
+        if (!endpoint) {
+            return false;
+        }
+        ++endpoint->fConnectors;
+        // like zeromq, messages can be queued before the peer binds
+        fLinks.push_back({endpoint, &endpoint->fToConnector, &endpoint->fToBinder, false});
+        return true;
+    }
+
+    int64_t Send(MessagePtr& msg, int timeout = -1) override
+    {
+        if (!CanSend(msg.get())) {
+            return static_cast<int>(TransferCode::error);
+        }
+        const int64_t size = msg->GetSize();
+        int64_t link = Push({static_cast<Message*>(msg.get()), nullptr}, timeout);
+        if (link < 0) {
+            return link;
+        }
+        msg.release();
+        msg = TakeSpare(*fLinks[link].fEndpoint);
+        fBytesTx += size;
+        ++fMessagesTx;
+        return size;
+    }
+
+    /// The parts are moved into the queue as one item, msgVec is left empty.
+    int64_t Send(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
+    {
+        if (msgVec.empty()) {
+            LOG(warn) << "Will not send empty vector";
+            return static_cast<int>(TransferCode::error);
+        }
+        int64_t size = 0;
+        for (const auto& part : msgVec) {
+            if (!CanSend(part.get())) {
+                return static_cast<int>(TransferCode::error);
+            }
+            size += part->GetSize();
+        }
+        auto parts = std::make_unique<std::vector<MessagePtr>>();
+        parts->swap(msgVec);
+        int64_t link = Push({nullptr, parts.get()}, timeout);
+        if (link < 0) {
+            msgVec.swap(*parts);
+            return link;
+        }
+        parts.release();
+        fBytesTx += size;
+        ++fMessagesTx;
+        return size;
+    }
+
+    /// A multipart message is returned part by part by consecutive calls.
+    int64_t Receive(MessagePtr& msg, int timeout = -1) override
+    {
+        if (fType == "push") {
+            LOG(error) << "Cannot receive on push socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+        if (fPending.empty()) {
+            Item item;
+            int64_t link = Pop(item, timeout);
+            if (link < 0) {
+                return link;
+            }
+            fLastEndpoint = fLinks[link].fEndpoint.get();
+            if (item.fMsg) {
+                return Deliver(msg, MessagePtr(item.fMsg));
+            }
+            fPending = std::move(*item.fParts);
+            delete item.fParts;
+            fPendingPos = 0;
+        }
+        MessagePtr part = std::move(fPending[fPendingPos++]);
+        if (fPendingPos == fPending.size()) {
+            fPending.clear();
+        }
+        return Deliver(msg, std::move(part));
+    }
+
+    int64_t Receive(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
+    {
+        if (fType == "push") {
+            LOG(error) << "Cannot receive on push socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+        if (fPending.empty()) {
+            Item item;
+            int64_t link = Pop(item, timeout);
+            if (link < 0) {
+                return link;
+            }
+            if (item.fMsg) {
+                item.fMsg->SetTransport(GetTransport());
+                int64_t size = item.fMsg->GetSize();
+                msgVec.emplace_back(item.fMsg);
+                fBytesRx += size;
+                ++fMessagesRx;
+                return size;
+            }
+            fPending = std::move(*item.fParts);
+            delete item.fParts;
+            fPendingPos = 0;
+        }
+        // store statistics on how many messages have been received (handle all parts as a single message)
+        int64_t size = 0;
+        for (; fPendingPos < fPending.size(); ++fPendingPos) {
+            fPending[fPendingPos]->SetTransport(GetTransport());
+            size += fPending[fPendingPos]->GetSize();
+            msgVec.push_back(std::move(fPending[fPendingPos]));
+        }
+        fPending.clear();
+        fBytesRx += size;
+        ++fMessagesRx;
+        return size;
+    }
+
+    void Close() override
+    {
+        for (auto& link : fLinks) {
+            if (link.fBinder) {
+                link.fEndpoint->fBound.store(false);
+            } else {
+                --link.fEndpoint->fConnectors;
+            }
+        }
+        // messages still queued stay in the endpoint for the peers
+        fLinks.clear();
+        fPending.clear();
+        fLastEndpoint = nullptr;
+    }
+
+    void SetOption(const std::string& option, const void* value, size_t /* valueSize */) override
+    {
+        int intValue = *static_cast<const int*>(value);
+        if (option == "linger") {
+            SetLinger(intValue);
+        } else if (option == "snd-hwm") {
+            SetSndBufSize(intValue);
+        } else if (option == "rcv-hwm") {
+            SetRcvBufSize(intValue);
+        } else if (option == "snd-size" || option == "rcv-size") {
+            LOG(debug) << "Socket option '" << option << "' has no effect in the inproc transport";
+        } else {
+            LOG(error) << "Failed setting socket option, reason: option '" << option << "' is not supported by the inproc transport";
+        }
+    }
+
+    void GetOption(const std::string& option, void* value, size_t* valueSize) override
+    {
+        int intValue = 0;
+        if (option == "linger") {
+            intValue = GetLinger();
+        } else if (option == "snd-hwm") {
+            intValue = GetSndBufSize();
+        } else if (option == "rcv-hwm") {
+            intValue = GetRcvBufSize();
+        } else if (option == "snd-size" || option == "rcv-size") {
+            intValue = 0;
+        } else if (option == "rcv-more") {
+            intValue = fPending.empty() ? 0 : 1;
+        } else {
+            LOG(error) << "Failed getting socket option, reason: option '" << option << "' is not supported by the inproc transport";
+            return;
+        }
+        *static_cast<int*>(value) = intValue;
+        *valueSize = sizeof(intValue);
+    }
+
+    int Events(uint32_t* events) override
+    {
+        *events = PollResult();
+        return 0;
+    }
+
+    // messages queued in the endpoint are kept while any of its sockets is alive
+    void SetLinger(int value) override { fLinger = value; }
+    int GetLinger() const override { return fLinger; }
+    // the queue capacity of an endpoint is given by the high-water marks of the first socket using it
+    void SetSndBufSize(int value) override { fSndHwm = value; }
+    int GetSndBufSize() const override { return fSndHwm; }
+    void SetRcvBufSize(int value) override { fRcvHwm = value; }
+    int GetRcvBufSize() const override { return fRcvHwm; }
+    void SetSndKernelSize(int /* value */) override {}
+    int GetSndKernelSize() const override { return 0; }
+    void SetRcvKernelSize(int /* value */) override {}
+    int GetRcvKernelSize() const override { return 0; }
+
+    unsigned long GetNumberOfConnectedPeers() const override
+    {
+        unsigned long peers = 0;
+        for (const auto& link : fLinks) {
+            peers += link.fBinder ? link.fEndpoint->fConnectors.load() : (link.fEndpoint->fBound.load() ? 1 : 0);
+        }
+        return peers;
+    }
+
+    // messages in the pipes of the endpoints, shared with the other sockets attached to them
+    int64_t GetQueueDepth(bool& exact) const override
+    {
+        exact = true;
+        size_t depth = 0;
+        for (const auto& link : fLinks) {
+            depth += link.fIn->Size() + link.fOut->Size();
+        }
+        return static_cast<int64_t>(depth);
+    }
+
+    unsigned long GetBytesTx() const override { return fBytesTx; }
+    unsigned long GetBytesRx() const override { return fBytesRx; }
+    unsigned long GetMessagesTx() const override { return fMessagesTx; }
+    unsigned long GetMessagesRx() const override { return fMessagesRx; }
+
+    ~Socket() override { Close(); }
+
+  private:
+    struct Link
+    {
+        std::shared_ptr<Endpoint> fEndpoint;
+        Pipe* fIn;
+        Pipe* fOut;
+        bool fBinder;
+    };
+
+    std::shared_ptr<Endpoint> Attach(const std::string& address)
+    {
+        if (address.compare(0, 9, "inproc://") != 0 || address.size() == 9) {
+            LOG(error) << "Failed attaching socket " << fId << ", address: " << address << ", reason: the inproc transport supports only inproc://<name> addresses";
+            return nullptr;
+        }
+        int hwm = std::max(fSndHwm, fRcvHwm);
+        return GetEndpoint(address, hwm > 0 ? static_cast<size_t>(hwm) : 65536);
+    }
+
+    bool CanSend(const fair::mq::Message* msg) const
+    {
+        if (fType == "pull") {
+            LOG(error) << "Cannot send on pull socket " << fId;
+            return false;
+        }
+        // fair::mq::Channel wraps messages of other transports
+        if (!msg || msg->GetType() != Transport::INPROC) {
+            LOG(error) << "Cannot send a message of another transport on inproc socket " << fId;
+            return false;
+        }
+        return true;
+    }
+
+    // @return the index of the link the item was queued in, or a TransferCode
+    int64_t Push(Item item, int timeout)
+    {
+        return Transfer(timeout, false, [&]() -> int64_t {
+            for (size_t i = 0; i < fLinks.size(); ++i) {
+                size_t link = (fNextOut + i) % fLinks.size();
+                if (fLinks[link].fOut->TryPush(item)) {
+                    fNextOut = link + 1;
+                    return link;
+                }
+            }
+            return -1;
+        });
+    }
+
+    // @return the index of the link the item was taken from, or a TransferCode
+    int64_t Pop(Item& item, int timeout)
+    {
+        return Transfer(timeout, true, [&]() -> int64_t {
+            for (size_t i = 0; i < fLinks.size(); ++i) {
+                size_t link = (fNextIn + i) % fLinks.size();
+                if (fLinks[link].fIn->TryPop(item)) {
+                    fNextIn = link + 1;
+                    return link;
+                }
+            }
+            return -1;
+        });
+    }
+
+    template<typename Attempt>
+    int64_t Transfer(int timeout, bool in, Attempt&& attempt)
+    {
+        int64_t link = attempt();
+        if (link >= 0) {
+            return link;
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            if (fCtx.Interrupted()) {
+                return static_cast<int>(TransferCode::interrupted);
+            }
+            int wait = kWaitSlice;
+            if (timeout >= 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                if (elapsed >= timeout) {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+                wait = std::min(wait, timeout - static_cast<int>(elapsed));
+            }
+            const uint32_t event = in ? kPollIn : kPollOut;
+            auto ready = [&]() { return (PollResult() & event) != 0 || fCtx.Interrupted(); };
+            if (fLinks.size() == 1) {
+                (in ? fLinks.front().fIn : fLinks.front().fOut)->GetNotifier().Wait(ready, std::chrono::milliseconds(wait));
+            } else {
+                fWaitNotifiers.clear();
+                AddNotifiers(fWaitNotifiers, event);
+                fWaiter.Wait(fWaitNotifiers, ready, std::chrono::milliseconds(wait));
+            }
+            link = attempt();
+            if (link >= 0) {
+                return link;
+            }
+        }
+    }
+
+    int64_t Deliver(MessagePtr& msg, MessagePtr received)
+    {
+        received->SetTransport(GetTransport());
+        Recycle(std::move(msg));
+        msg = std::move(received);
+        int64_t size = msg->GetSize();
+        fBytesRx += size;
+        ++fMessagesRx;
+        return size;
+    }
+
+    // the receiving message object is replaced, keep it for the senders of the endpoint
+    void Recycle(MessagePtr msg)
+    {
+        if (!msg || !fLastEndpoint || msg->GetType() != Transport::INPROC) {
+            return;
+        }
+        msg->Rebuild();
+        msg->SetTraceContext({});
+        if (fLastEndpoint->fSpares.TryPush(static_cast<Message*>(msg.get()))) {
+            msg.release();
+        }
+    }
+
+    MessagePtr TakeSpare(Endpoint& endpoint)
+    {
+        Message* spare = nullptr;
+        if (endpoint.fSpares.TryPop(spare)) {
+            spare->SetTransport(GetTransport());
+            return MessagePtr(spare);
+        }
+        return std::make_unique<Message>(GetTransport());
+    }
+
+    /// notifiers of the pipes that signal the given events (kPollIn, kPollOut) of this socket
+    void AddNotifiers(std::vector<Notifier*>& notifiers, uint32_t events) const
+    {
+        for (const auto& link : fLinks) {
+            if ((events & kPollIn) && fType != "push") {
+                notifiers.push_back(&link.fIn->GetNotifier());
+            }
+            if ((events & kPollOut) && fType != "pull") {
+                notifiers.push_back(&link.fOut->GetNotifier());
+            }
+        }
+    }
+
+    uint32_t PollResult() const
+    {
+        uint32_t events = 0;
+        if (fType != "push") {
+            if (!fPending.empty()) {
+                events |= kPollIn;
+            }
+            for (const auto& link : fLinks) {
+                if (!link.fIn->Empty()) {
+                    events |= kPollIn;
+                    break;
+                }
+            }
+        }
+        if (fType != "pull") {
+            for (const auto& link : fLinks) {
+                if (!link.fOut->Full()) {
+                    events |= kPollOut;
+                    break;
+                }
+            }
+        }
+        return events;
+    }
+
+    Context& fCtx;
+    std::string fId;
+    std::string fType;
+    std::atomic<unsigned long> fBytesTx;
+    std::atomic<unsigned long> fBytesRx;
+    std::atomic<unsigned long> fMessagesTx;
+    std::atomic<unsigned long> fMessagesRx;
+    int fLinger;
+    int fSndHwm;
+    int fRcvHwm;
+
+    std::vector<Link> fLinks;
+    size_t fNextIn;
+    size_t fNextOut;
+
+    // parts of a multipart message being received with single part receives
+    std::vector<MessagePtr> fPending;
+    size_t fPendingPos;
+    Endpoint* fLastEndpoint; // endpoint of the last receive, gets the replaced message objects
+
+    // blocking waits on several endpoints
+    MultiWaiter fWaiter;
+    std::vector<Notifier*> fWaitNotifiers;
+};
+
+} // namespace fair::mq::inproc
+
+#endif /* FAIR_MQ_INPROC_SOCKET_H */
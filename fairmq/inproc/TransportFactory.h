@@ -0,0 +1,146 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_INPROC_TRANSPORTFACTORY_H
+#define FAIR_MQ_INPROC_TRANSPORTFACTORY_H
+
+#include <fairmq/inproc/Context.h>
+#include <fairmq/inproc/Message.h>
+#include <fairmq/inproc/Socket.h>
+#include <fairmq/inproc/Poller.h>
+#include <fairmq/inproc/UnmanagedRegion.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/ProgOptions.h>
+
+#include <memory> // unique_ptr, make_unique
+#include <string>
+#include <vector>
+
+namespace fair::mq::inproc
+{
+
+/// PUSH/PULL and PAIR between devices of one process (inproc:// addresses), messages are passed by pointer
+class TransportFactory final : public fair::mq::TransportFactory
+{
+  public:
+    TransportFactory(const std::string& id = "", const ProgOptions* /* config */ = nullptr)
+        : fair::mq::TransportFactory(id)
+        , fCtx(std::make_unique<Context>())
+    {
+        LOG(debug) << "Transport: Using inproc";
+    }
+
+    TransportFactory(const TransportFactory&) = delete;
+    TransportFactory(TransportFactory&&) = delete;
+    TransportFactory& operator=(const TransportFactory&) = delete;
+    TransportFactory& operator=(TransportFactory&&) = delete;
+
+    MessagePtr CreateMessage() override
+    {
+        return std::make_unique<Message>(this);
+    }
+
+    MessagePtr CreateMessage(Alignment alignment) override
+    {
+        return std::make_unique<Message>(alignment, this);
+    }
+
+    MessagePtr CreateMessage(size_t size) override
+    {
+        return std::make_unique<Message>(size, this);
+    }
+
+    MessagePtr CreateMessage(size_t size, Alignment alignment) override
+    {
+        return std::make_unique<Message>(size, alignment, this);
+    }
+
+    MessagePtr CreateMessage(void* data, size_t size, fair::mq::FreeFn* ffn, void* hint = nullptr) override
+    {
+        return std::make_unique<Message>(data, size, ffn, hint, this);
+    }
+
+    MessagePtr CreateMessage(UnmanagedRegionPtr& region, void* data, size_t size, void* hint = 0) override
+    {
+        return std::make_unique<Message>(region, data, size, hint, this);
+    }
+
+    SocketPtr CreateSocket(const std::string& type, const std::string& name) override
+    {
+        return std::make_unique<Socket>(*fCtx, type, name, GetId(), this);
+    }
+
+    PollerPtr CreatePoller(const std::vector<Channel>& channels) const override
+    {
+        return std::make_unique<Poller>(channels);
+    }
+
+    PollerPtr CreatePoller(const std::vector<Channel*>& channels) const override
+    {
+        return std::make_unique<Poller>(channels);
+    }
+
+    PollerPtr CreatePoller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList) const override
+    {
+        return std::make_unique<Poller>(channelsMap, channelList);
+    }
+
+    UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, RegionCallback callback, const std::string& path = "", int flags = 0, fair::mq::RegionConfig cfg = fair::mq::RegionConfig()) override
+    {
+        return CreateUnmanagedRegion(size, 0, callback, nullptr, path, flags, cfg);
+    }
+
+    UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, RegionBulkCallback bulkCallback, const std::string& path = "", int flags = 0, fair::mq::RegionConfig cfg = fair::mq::RegionConfig()) override
+    {
+        return CreateUnmanagedRegion(size, 0, nullptr, bulkCallback, path, flags, cfg);
+    }
+
+    UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, int64_t userFlags, RegionCallback callback, const std::string& path = "", int flags = 0, fair::mq::RegionConfig cfg = fair::mq::RegionConfig()) override
+    {
+        return CreateUnmanagedRegion(size, userFlags, callback, nullptr, path, flags, cfg);
+    }
+
+    UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, int64_t userFlags, RegionBulkCallback bulkCallback, const std::string& path = "", int flags = 0, fair::mq::RegionConfig cfg = fair::mq::RegionConfig()) override
+    {
+        return CreateUnmanagedRegion(size, userFlags, nullptr, bulkCallback, path, flags, cfg);
+    }
+
+    UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, RegionCallback callback, RegionConfig cfg) override
+    {
+        return CreateUnmanagedRegion(size, cfg.userFlags, callback, nullptr, cfg.path, cfg.creationFlags, cfg);
+    }
+    UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, RegionBulkCallback bulkCallback, RegionConfig cfg) override
+    {
+        return CreateUnmanagedRegion(size, cfg.userFlags, nullptr, bulkCallback, cfg.path, cfg.creationFlags, cfg);
+    }
+
+    UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, int64_t userFlags, RegionCallback callback, RegionBulkCallback bulkCallback, const std::string&, int /* flags */, fair::mq::RegionConfig cfg)
+    {
+        return std::make_unique<UnmanagedRegion>(*fCtx, size, userFlags, callback, bulkCallback, this, cfg);
+    }
+
+    void SubscribeToRegionEvents(RegionEventCallback callback) override { fCtx->SubscribeToRegionEvents(callback); }
+    bool SubscribedToRegionEvents() override { return fCtx->SubscribedToRegionEvents(); }
+    void UnsubscribeFromRegionEvents() override { fCtx->UnsubscribeFromRegionEvents(); }
+    std::vector<RegionInfo> GetRegionInfo() override { return fCtx->GetRegionInfo(); }
+
+    Transport GetType() const override { return Transport::INPROC; }
+
+    void Interrupt() override { fCtx->Interrupt(); }
+    void Resume() override { fCtx->Resume(); }
+    void Reset() override { fCtx->Reset(); }
+
+    ~TransportFactory() override { LOG(debug) << "Destroying inproc transport..."; }
+
+  private:
+    std::unique_ptr<Context> fCtx;
+};
+
+} // namespace fair::mq::inproc
+
+#endif /* FAIR_MQ_INPROC_TRANSPORTFACTORY_H */
@@ -8,6 +8,7 @@
 
 #include "Config.h"
 
+#include <fairmq/BinaryConfig.h>
 #include <fairmq/JSONParser.h>
 #include <fairmq/SuboptParser.h>
 
@@ -34,8 +35,14 @@ Config::Config(const string& name, Plugin::Version version, const string& mainta
             if (!idForParser.empty()) {
                 try {
                     if (PropertyExists("mq-config")) {
-                        LOG(debug) << "mq-config: Using default JSON parser";
-                        SetProperties(JSONParser(GetProperty<string>("mq-config"), idForParser));
+                        const string configFile = GetProperty<string>("mq-config");
+                        if (IsBinaryConfig(configFile)) {
+                            LOG(debug) << "mq-config: Using precompiled binary config";
+                            SetProperties(BinaryConfigParser(configFile, idForParser));
+                        } else {
+                            LOG(debug) << "mq-config: Using default JSON parser";
+                            SetProperties(JSONParser(configFile, idForParser));
+                        }
                     } else if (PropertyExists("channel-config")) {
                         LOG(debug) << "channel-config: Parsing channel configuration";
                         SetProperties(SuboptParser(GetProperty<vector<string>>("channel-config"), idForParser));
@@ -59,27 +66,93 @@ Plugin::ProgOptions ConfigPluginProgramOptions()
     pluginOptions.add_options()
         ("id",                            po::value<string        >()->default_value(""),                "Device ID.")
         ("io-threads",                    po::value<int           >()->default_value(1),                 "Number of I/O threads.")
-        ("transport",                     po::value<string        >()->default_value("zeromq"),          "Transport ('zeromq'/'shmem').")
+        ("cpu-affinity",                  po::value<string        >()->default_value(""),                "Pin the device threads (state handlers incl. Run/ConditionalRun, data callbacks and workers, rate logging, channel tuning) to these CPUs, e.g. 2:4-7.")
+        ("io-cpu-affinity",               po::value<string        >()->default_value(""),                "Pin the transport threads (ZeroMQ I/O threads of the default context, region events/acks, shmem heartbeats) to these CPUs, e.g. 2:4-7.")
+        ("sched-policy",                  po::value<string        >()->default_value(""),                "Scheduling policy of the device and transport threads, 'other'/'fifo'/'rr' (empty: unchanged). Real-time policies need CAP_SYS_NICE or an RLIMIT_RTPRIO.")
+        ("sched-priority",                po::value<int           >()->default_value(-1),                "Scheduling priority with --sched-policy (-1: the minimum of the policy, 1 for fifo/rr).")
+        ("mlockall",                      po::value<bool          >()->default_value(false),             "Lock all current and future memory of the process (mlockall), to avoid page faults in latency critical code.")
+        ("copy-engine",                   po::value<string        >()->default_value("memcpy"),          "Engine for payload copies of at least --copy-engine-threshold bytes (e.g. growing or receiving into another transport), 'memcpy'/'streaming' (non-temporal stores, bypassing the caches)/'dsa' (Intel DSA work queue, streaming copies if there is none).")
+        ("copy-engine-threshold",         po::value<size_t        >()->default_value(1 << 20),           "Minimum payload copy size (in bytes) for the --copy-engine, smaller copies use memcpy.")
+        ("copy-engine-wq",                po::value<string        >()->default_value(""),                "DSA work queue for --copy-engine dsa, e.g. /dev/dsa/wq0.0 (empty: the first usable one).")
+        ("zmq-context-group",             po::value<vector<string>>()->multitoken()->composing(),        "ZeroMQ/Shared memory: additional zeromq context with own I/O threads for the channels with this contextGroup, given as name=<name>,io-threads=<n>,cpus=<cpu list, e.g. 2:4-7>,sched=<other|fifo|rr>,priority=<p>. The name 'default' configures the default context.")
+        ("zmq-poller",                    po::value<string        >()->default_value("zmq_poll"),        "ZeroMQ/Shared memory: poller backend, 'zmq_poll' (checks all channels on every poll) or 'epoll' (ZMQ_FD with epoll, only the ready channels are checked).")
+        ("zmq-msg-pool",                  po::value<bool          >()->default_value(false),             "ZeroMQ: recycle the payload buffers of created messages in a per transport pool of power of two size classes.")
+        ("zmq-msg-pool-depth",            po::value<size_t        >()->default_value(256),               "ZeroMQ: maximum number of pooled buffers per size class (with --zmq-msg-pool).")
+        ("transport",                     po::value<string        >()->default_value("zeromq"),          "Transport ('zeromq'/'shmem'/'inproc'/'uring'/'rdma').")
         ("network-interface",             po::value<string        >()->default_value("default"),         "Network interface to bind on (e.g. eth0, ib0..., default will try to detect the interface of the default route).")
         ("init-timeout",                  po::value<int           >()->default_value(120),               "Timeout for the initialization in seconds (when expecting dynamic initialization).")
         ("print-channels",                po::value<bool          >()->implicit_value(true),             "Print registered channel endpoints in a machine-readable format (<channel name>:<min num subchannels>:<max num subchannels>)")
         ("shm-segment-size",              po::value<size_t        >()->default_value(2ULL << 30),        "Shared memory: size of the shared memory segment (in bytes).")
-        ("shm-allocation",                po::value<string        >()->default_value("rbtree_best_fit"), "Shared memory allocation algorithm: rbtree_best_fit/simple_seq_fit.")
+        ("shm-allocation",                po::value<string        >()->default_value("rbtree_best_fit"), "Shared memory allocation algorithm: rbtree_best_fit/simple_seq_fit/slab_fit.")
         ("shm-segment-id",                po::value<uint16_t      >()->default_value(0),                 "EXPERIMENTAL: Shared memory segment id for message creation.")
         ("shmid",                         po::value<uint64_t      >(),                                   "EXPERIMENTAL: Fixed shmid to use instead of deriving it from the session name.")
         ("shm-mlock-segment",             po::value<bool          >()->default_value(false),             "Shared memory: mlock the shared memory segment after initialization (opened or created).")
         ("shm-mlock-segment-on-creation", po::value<bool          >()->default_value(false),             "Shared memory: mlock the shared memory segment only once when created.")
         ("shm-zero-segment",              po::value<bool          >()->default_value(false),             "Shared memory: zero the shared memory segment memory after initialization (opened or created).")
         ("shm-zero-segment-on-creation",  po::value<bool          >()->default_value(false),             "Shared memory: zero the shared memory segment memory only once when created.")
+        ("shm-prefault-segment",          po::value<bool          >()->default_value(false),             "Shared memory: pre-fault all pages of the shared memory segment after initialization (opened or created).")
+        ("shm-management-segment-size",   po::value<size_t        >()->default_value(6553600),           "Shared memory: size of the management segment (session, segment and region bookkeeping), set by the first process of a session. Roughly 250 bytes per region.")
+        ("shm-region-memfd",              po::value<bool          >()->default_value(false),             "Shared memory: back the unmanaged regions created by this process with memfds (RegionConfig::memfd), if they are not file backed, GPU or persistent regions.")
+        ("shm-fixed-address",             po::value<bool          >()->default_value(false),             "Shared memory: map the segments and regions created by this process at the same address in all processes of the session (if free there), so that raw pointers into them are valid across processes.")
+        ("shm-premap",                    po::value<bool          >()->default_value(false),             "Shared memory: map all segments and regions of the session when a socket is bound/connected, and new ones as they are created, instead of on the first message.")
+        ("shm-premap-prefault",           po::value<bool          >()->default_value(false),             "Shared memory: with --shm-premap, also pre-fault all pages of the mapped segments and regions.")
+        ("shm-segment-init-async",        po::value<bool          >()->default_value(false),             "Shared memory: run prefault/mlock/zero of the shared memory segment in the background, signalled by the 'initialized' region event.")
+        ("shm-segment-init-threads",      po::value<int           >()->default_value(1),                 "Shared memory: number of threads used to prefault/mlock the shared memory segment.")
+        ("shm-segment-hugepages",         po::value<bool          >()->default_value(false),             "Shared memory: back the shared memory segment with (transparent) huge pages. Requires shmem THP support ('advise' or 'always').")
+        ("shm-refcount-table",            po::value<bool          >()->default_value(false),             "Shared memory: keep message ref counts in a separate table instead of a header in front of each message buffer (set by the segment creator).")
+        ("shm-spill-over",                po::value<string        >()->default_value("none"),            "Shared memory: if the own segment is full, allocate from other segments of the session, 'none'/'free-memory' (most free memory first)/'numa' (same NUMA node first).")
+        ("shm-alloc-policy",              po::value<string        >()->default_value(""),                "Shared memory: route allocations by size to segments of the session, '<store>[:<=<size>[k|M|G]],...' with stores segment (own), segment<id>, slab<id> (slab_fit), e.g. 'slab1:<=4k,segment'.")
+        ("shm-spill-over-max-segments",   po::value<int           >()->default_value(0),                 "Shared memory: maximum number of additional segments to create on demand when spilling over.")
+        ("shm-meta-ring",                 po::value<bool          >()->default_value(false),             "Shared memory: exchange message meta headers of PUSH/PULL/PAIR channels via rings in shared memory instead of the zmq socket (zmq is used for connection setup only). Must be set on both sides of a channel.")
+        ("shm-meta-ring-capacity",        po::value<size_t        >()->default_value(1024),              "Shared memory: capacity (message parts, rounded up to a power of two) of the meta header rings (set by the ring creator).")
+        ("shm-inline-size",               po::value<size_t        >()->default_value(0),                 "Shared memory: messages up to this size (bytes, at most 4096, 0: off) are not allocated in shared memory, their payload is sent in the meta data frame.")
+        ("shm-numa-node",                 po::value<int           >()->default_value(-1),                "Shared memory: bind the managed segment memory to this NUMA node (-1: no binding).")
+        ("shm-ack-reactor",               po::value<bool          >()->default_value(false),             "Shared memory: run the ack senders and receivers of all unmanaged regions of the transport on one thread instead of two threads per region (the region callbacks run on it, unless offloaded with RegionConfig::ackCallbackThreads).")
+        ("shm-ack-reactor-interval",      po::value<int           >()->default_value(1000),              "Shared memory: with --shm-ack-reactor, maximum sleep of the idle reactor thread between polls of the region ack queues (in us).")
+        ("shm-thread-numa-node",          po::value<int           >()->default_value(-1),                "Shared memory: pin the transport threads (heartbeats, region events, region acks) to the CPUs of this NUMA node (-1: no pinning).")
         ("shm-throw-bad-alloc",           po::value<bool          >()->default_value(true),              "Shared memory: throw fair::mq::MessageBadAlloc if cannot allocate a message (retry if false).")
         ("bad-alloc-max-attempts",        po::value<int           >(),                                   "Maximum number of allocation attempts before throwing fair::mq::MessageBadAlloc. -1 is infinite. There is always at least one attempt, so 0 has safe effect as 1.")
         ("bad-alloc-attempt-interval",    po::value<int           >()->default_value(50),                "Interval between attempts if cannot allocate a message (in ms).")
+        ("shm-bad-alloc-wait",            po::value<bool          >()->default_value(false),             "Shared memory: if cannot allocate a message, wait until memory is freed in the session instead of retrying in fixed intervals.")
+        ("bad-alloc-max-wait",            po::value<int           >()->default_value(-1),                "Maximum total wait for memory with shm-bad-alloc-wait (in ms). -1 derives it from the attempts and interval (infinite if attempts are infinite).")
+        ("shm-allocation-cache",          po::value<bool          >()->default_value(false),             "Shared memory: cache freed message buffers per thread and size class, refill/drain them in bulk from the managed segment.")
+        ("shm-allocation-cache-depth",    po::value<size_t        >()->default_value(32),                "Shared memory: maximum number of cached buffers per size class and cache shard (with --shm-allocation-cache).")
+        ("shm-allocation-cache-max-bytes", po::value<size_t       >()->default_value(0),                 "Shared memory: maximum number of bytes cached by the process (with --shm-allocation-cache), 0 for an eighth of the segment size.")
+        ("shm-deferred-free",             po::value<bool          >()->default_value(false),             "Shared memory: queue released message buffers and return them to the managed segment in batches from a background thread, instead of in the releasing thread.")
+        ("shm-deferred-free-max-bytes",   po::value<size_t        >()->default_value(64 << 20),          "Shared memory: maximum bytes waiting for the deallocation thread (with --shm-deferred-free), beyond it buffers are returned synchronously.")
+        ("shm-deferred-free-interval",    po::value<int           >()->default_value(1),                 "Shared memory: maximum interval between the batches of the deallocation thread (in ms, with --shm-deferred-free).")
+        ("shm-alloc-stats",               po::value<unsigned int  >()->default_value(0),                 "Shared memory: record the size and allocator time of every n-th allocation (per thread) for fairmq-shmmonitor, 0 to disable. Allocation failures are always recorded.")
+        ("shm-alloc-trace",               po::value<string        >()->default_value(""),                "Shared memory: record every allocation and deallocation of the managed segments (size, alignment, time, lifetime) to '<path>.<pid>', for fairmq-shm-replay. Empty to disable.")
+        ("shm-owner-sampling",            po::value<unsigned int  >()->default_value(0),                 "Shared memory: tag every n-th allocation (per thread) with this device, its age and the channel it is sent on, for the usage view of fairmq-shmmonitor, 0 to disable.")
+        ("shm-quota-soft",                po::value<size_t        >()->default_value(0),                 "Shared memory: managed segment bytes this device may hold before a warning is logged (counted in fairmq-shmmonitor), 0 for none.")
+        ("shm-quota-hard",                po::value<size_t        >()->default_value(0),                 "Shared memory: managed segment bytes this device may hold, allocations beyond are handled like a full segment (retried, waited for or rejected), 0 for none.")
+        ("shm-reclaim",                   po::value<bool          >()->default_value(false),             "Shared memory: record the message buffers held by this process in a ledger, so that the next process of the session starting with this option releases them if this one dies.")
+        ("shm-reclaim-slots",             po::value<size_t        >()->default_value(65536),             "Shared memory: number of buffers the ledger of a process can record (with --shm-reclaim, rounded up to a power of two, 16 bytes each).")
         ("shm-monitor",                   po::value<bool          >()->default_value(false),             "Shared memory: run monitor daemon.")
+        ("shm-liveness",                  po::value<string        >()->default_value("heartbeat"),       "Shared memory: how the monitor detects live processes of the session, 'heartbeat' (periodic heartbeat thread)/'pid' (process registered in the session, no thread).")
+        ("shm-heartbeat-interval",        po::value<int           >()->default_value(100),               "Shared memory: interval of the heartbeats (in ms, with --shm-liveness heartbeat). Should be well below the monitor timeout.")
+        ("shm-stats-interval",            po::value<int           >()->default_value(0),                 "Shared memory: interval (in ms) of the publication of the usage counters (free memory, allocations, region acks) for fairmq-shmmonitor --stats, on the heartbeat thread (0: not published).")
         ("shm-no-cleanup",                po::value<bool          >()->default_value(false),             "Shared memory: do not cleanup the memory when last device leaves.")
+        ("uring-queue-depth",             po::value<unsigned int  >()->default_value(64),                "io_uring (experimental): submission queue depth of the per socket rings.")
+        ("uring-zc-threshold",            po::value<size_t        >()->default_value(16384),             "io_uring (experimental): minimum message part size (in bytes) sent with zero-copy send, 0 disables zero-copy.")
+        ("rdma-device",                   po::value<string        >()->default_value(""),                "RDMA (experimental): name of the ibverbs device (empty: first device).")
+        ("rdma-port",                     po::value<int           >()->default_value(1),                 "RDMA (experimental): port of the ibverbs device.")
+        ("rdma-gid-index",                po::value<int           >()->default_value(0),                 "RDMA (experimental): GID index for global routing (required for RoCE), -1 addresses by LID (InfiniBand only).")
+        ("rdma-threshold",                po::value<size_t        >()->default_value(65536),             "RDMA (experimental): minimum message part size (in bytes) written with RDMA, smaller parts are sent over the TCP connection. 0: never.")
         ("rate",                          po::value<float         >()->default_value(0.),                "Rate for conditional run loop (Hz).")
+        ("rate-mode",                     po::value<string        >()->default_value("adaptive"),        "How --rate is enforced: 'adaptive' (sleeps), 'precise' (spins for short waits, smooth high rates) or 'token-bucket' (precise with bursts of --rate-burst).")
+        ("rate-burst",                    po::value<unsigned int  >()->default_value(1),                 "Burst size (iterations) of --rate-mode token-bucket.")
+        ("data-workers",                  po::value<int           >()->default_value(0),                 "Number of threads (per transport) calling the data callbacks of the input subchannels, each subchannel is handled by one of them. 0: device thread.")
+        ("input-dispatch",                po::value<string        >()->default_value("order"),           "Order of the ready inputs in the device event loop: 'order' (one message of every ready input per poll), 'priority' (strict priority), 'weighted' (weighted round-robin) or 'deadline' (earliest deadline first), see Device::SetInputPriority.")
+        ("channel-metrics",               po::value<bool          >()->default_value(false),             "Record send/receive call counts, blocking time and latency histograms of all channels (see Device::GetChannelMetrics).")
+        ("perf-counters",                 po::value<bool          >()->default_value(false),             "Count cycles, instructions, last level cache and branch misses of the data callbacks and ConditionalRun calls with the hardware performance counters of their threads (perf_event, implies --channel-metrics).")
+        ("flight-recorder",               po::value<string        >()->default_value(""),                "Record copies of the messages of the channels into this file (circular, the oldest are overwritten), frozen on error or when the property flight-recorder-freeze is set (see FlightRecorder).")
+        ("flight-recorder-size",          po::value<size_t        >()->default_value(64 << 20),          "Size (in bytes) of the message data kept by --flight-recorder.")
+        ("flight-recorder-channels",      po::value<string        >()->default_value(""),                "Comma separated names of the channels recorded by --flight-recorder (empty: all).")
+        ("warm-reset",                    po::value<bool          >()->default_value(false),             "Keep transports and bound/connected channels across ResetDevice, reuse them in the next InitDevice if their configuration is unchanged.")
         ("session",                       po::value<string        >()->default_value("default"),         "Session name.")
         ("config-key",                    po::value<string        >(),                                   "Use provided value instead of device id for fetching the configuration from JSON file.")
-        ("mq-config",                     po::value<string        >(),                                   "JSON input as file.")
+        ("mq-config",                     po::value<string        >(),                                   "JSON input as file (or a binary config file compiled from it with fairmq-config-compile).")
         ("channel-config",                po::value<vector<string>>()->multitoken()->composing(),        "Configuration of single or multiple channel(s) by comma separated key=value list");
     return pluginOptions;
 }
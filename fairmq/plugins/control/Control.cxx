@@ -8,6 +8,7 @@
 
 #include "Control.h"
 
+#include <fairmq/shmem/CommandBoard.h>
 #include <fairmq/tools/IO.h>
 
 #include <atomic>
@@ -19,6 +20,7 @@
 #include <thread>
 
 #include <poll.h> // for the interactive mode
+#include <unistd.h> // getpid
 
 using namespace std;
 
@@ -78,6 +80,9 @@ Control::Control(const string& name, Plugin::Version version, const string& main
         } else if (control == "dynamic" || control == "external" || control == "interactive") {
             LOG(debug) << "Running builtin controller: interactive";
             fControllerThread = thread(&Control::InteractiveMode, this);
+        } else if (control == "board") {
+            LOG(debug) << "Running builtin controller: board";
+            fControllerThread = thread(&Control::BoardMode, this);
         } else {
             LOG(error) << "Unrecognized control mode '" << control << "' requested. " << "Ignoring and falling back to static control mode.";
             fControllerThread = thread(&Control::StaticMode, this);
@@ -142,7 +147,7 @@ auto ControlPluginProgramOptions() -> Plugin::ProgOptions
     namespace po = boost::program_options;
     auto pluginOptions = po::options_description{"Control (builtin) Plugin"};
     pluginOptions.add_options()
-        ("control",       po::value<string>()->default_value("dynamic"), "Control mode, 'static' or 'dynamic' (aliases for dynamic are external and interactive)")
+        ("control",       po::value<string>()->default_value("dynamic"), "Control mode, 'static', 'dynamic' (aliases for dynamic are external and interactive) or 'board' (shmem command board of the session)")
         ("catch-signals", po::value<int   >()->default_value(1),             "Enable signal handling (1/0).");
     return pluginOptions;
 }
@@ -235,6 +240,10 @@ auto Control::RunREPL() -> void
                     cout << "\n --> [p] print number of connected peers for all channels\n\n" << flush;
                     PrintNumberOfConnectedPeers();
                 break;
+                case 'f':
+                    cout << "\n --> [f] freeze flight recorder\n\n" << flush;
+                    SetProperty<string>("flight-recorder-freeze", "control command");
+                break;
                 case 'h':
                     cout << "\n --> [h] help\n\n" << flush;
                     if (color) {
@@ -293,7 +302,8 @@ auto Control::PrintInteractiveHelpColor() -> void
        << " [\033[01;32mi\033[0m] init device, [\033[01;32mb\033[0m] bind, [\033[01;32mx\033[0m] connect, [\033[01;32mj\033[0m] init task,"
        << " [\033[01;32mr\033[0m] run, [\033[01;32ms\033[0m] stop,\n"
        << " [\033[01;32mt\033[0m] reset task, [\033[01;32md\033[0m] reset device, [\033[01;32mq\033[0m] end,\n"
-       << " [\033[01;32mk\033[0m] increase log severity, [\033[01;32ml\033[0m] decrease log severity, [\033[01;32mn\033[0m] increase log verbosity, [\033[01;32mm\033[0m] decrease log verbosity\n\n";
+       << " [\033[01;32mk\033[0m] increase log severity, [\033[01;32ml\033[0m] decrease log severity, [\033[01;32mn\033[0m] increase log verbosity, [\033[01;32mm\033[0m] decrease log verbosity,\n"
+       << " [\033[01;32mf\033[0m] freeze flight recorder\n\n";
     cout << ss.str() << flush;
 }
 
@@ -305,7 +315,8 @@ auto Control::PrintInteractiveHelp() -> void
        << " [i] init device, [b] bind, [x] connect, [j] init task,\n"
        << " [r] run, [s] stop,\n"
        << " [t] reset task, [d] reset device, [q] end,\n"
-       << " [k] increase log severity, [l] decrease log severity, [n] increase log verbosity, [m] decrease log verbosity.\n\n";
+       << " [k] increase log severity, [l] decrease log severity, [n] increase log verbosity, [m] decrease log verbosity,\n"
+       << " [f] freeze flight recorder.\n\n";
     cout << ss.str() << flush;
 }
 
@@ -432,6 +443,88 @@ try {
     ReleaseDeviceControl();
 }
 
+auto Control::BoardMode() -> void
+try {
+    auto session = GetProperty<string>("session");
+    auto shmId = PropertyExists("shmid") ? shmem::makeShmIdStr(GetProperty<uint64_t>("shmid")) : shmem::makeShmIdStr(session);
+    auto mngSize = PropertyExists("shm-management-segment-size") ? GetProperty<size_t>("shm-management-segment-size") : shmem::kManagementSegmentSize;
+    shmem::CommandBoard board(shmId, mngSize);
+    if (!board.Join(getpid(), GetCurrentDeviceState())) {
+        LOG(error) << "Command board of session '" << session << "' is full, falling back to static control mode.";
+        StaticMode();
+        return;
+    }
+    LOG(debug) << "Joined command board of session '" << session << "' (shm id: " << shmId << ")";
+
+    uint32_t seen = board.Command();
+    while (!fDeviceShutdownRequested && !fPluginShutdownRequested) {
+        uint32_t command = board.WaitForCommand(seen, 100);
+        if (command == seen) {
+            continue;
+        }
+        seen = command;
+        auto transition = shmem::CommandBoard::GetTransition(command);
+        LOG(debug) << "Command board: " << transition;
+        bool accepted = ApplyBoardCommand(transition);
+        auto state = GetCurrentDeviceState();
+        board.Acknowledge(command, accepted, state);
+
+        if (state == DeviceState::Error) {
+            throw DeviceErrorState("Controlled device transitioned to error state.");
+        }
+        if (state == DeviceState::Exiting) {
+            break;
+        }
+    }
+    board.Leave();
+
+    if (!fDeviceShutdownRequested) {
+        RunShutdownSequence();
+    }
+} catch (PluginServices::DeviceControlError& e) {
+    // If we are here, it means another plugin has taken control. That's fine, just print the
+    // exception message and do nothing else.
+    LOG(debug) << e.what();
+} catch (DeviceErrorState&) {
+    ReleaseDeviceControl();
+}
+
+// changes the state and waits for the next idling state, so that the ack reports the outcome of the transition
+auto Control::ApplyBoardCommand(DeviceStateTransition transition) -> bool
+{
+    using Transition = DeviceStateTransition;
+    using State = DeviceState;
+    auto shutdownRequested = [this]{ return fDeviceShutdownRequested.load(); };
+
+    fStateQueue.Clear();
+    if (!ChangeDeviceState(transition)) {
+        return false;
+    }
+
+    State target = State::Undefined;
+    switch (transition) {
+        case Transition::InitDevice:
+            fStateQueue.WaitForStateOrCustom(State::InitializingDevice, shutdownRequested);
+            if (fDeviceShutdownRequested || !ChangeDeviceState(Transition::CompleteInit)) {
+                return !fDeviceShutdownRequested;
+            }
+            target = State::Initialized;
+            break;
+        case Transition::CompleteInit: target = State::Initialized; break;
+        case Transition::Bind:         target = State::Bound; break;
+        case Transition::Connect:      target = State::DeviceReady; break;
+        case Transition::InitTask:     target = State::Ready; break;
+        case Transition::Run:          target = State::Running; break;
+        case Transition::Stop:         target = State::Ready; break;
+        case Transition::ResetTask:    target = State::DeviceReady; break;
+        case Transition::ResetDevice:  target = State::Idle; break;
+        case Transition::End:          target = State::Exiting; break;
+        default: return true;
+    }
+    fStateQueue.WaitForStateOrCustom(target, shutdownRequested);
+    return true;
+}
+
 auto Control::SignalHandler() -> void
 {
     while (gSignalCount == 0 && !fPluginShutdownRequested) {
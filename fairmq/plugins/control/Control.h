@@ -44,6 +44,8 @@ class Control : public Plugin
     auto PrintNumberOfConnectedPeers() -> void;
     auto StaticMode() -> void;
     auto GUIMode() -> void;
+    auto BoardMode() -> void;
+    auto ApplyBoardCommand(DeviceStateTransition transition) -> bool;
     auto SignalHandler() -> void;
     auto RunShutdownSequence() -> void;
     auto RunREPL() -> void;
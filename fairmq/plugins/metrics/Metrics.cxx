@@ -0,0 +1,374 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "Metrics.h"
+
+#include <fairmq/StartupProfile.h>
+#include <fairmq/tools/Strings.h>
+
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+
+#include <algorithm> // any_of, copy_if, find, remove_if
+#include <iterator> // back_inserter
+#include <iomanip>
+#include <istream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+namespace
+{
+    auto Escape(const string& value) -> string
+    {
+        string escaped;
+        for (char c : value) {
+            switch (c) {
+                case '\\': escaped += "\\\\"; break;
+                case '"': escaped += "\\\""; break;
+                case '\n': escaped += "\\n"; break;
+                default: escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    auto Labels(const vector<pair<string, string>>& labels) -> string
+    {
+        if (labels.empty()) {
+            return "";
+        }
+        string result("{");
+        for (const auto& [key, value] : labels) {
+            result += (result.size() > 1 ? "," : "") + key + "=\"" + Escape(value) + "\"";
+        }
+        return result + "}";
+    }
+
+    auto Header(ostream& os, const string& name, const string& type, const string& help) -> void
+    {
+        os << "# HELP " << name << " " << help << "\n"
+           << "# TYPE " << name << " " << type << "\n";
+    }
+
+    // one HTTP request per connection, answered with Connection: close
+    struct Session : enable_shared_from_this<Session>
+    {
+        Session(tcp::socket socket, fair::mq::plugins::Metrics& metrics)
+            : fSocket(move(socket))
+            , fMetrics(metrics)
+        {}
+
+        auto Start() -> void
+        {
+            auto self(shared_from_this());
+            asio::async_read_until(fSocket, fRequest, "\r\n\r\n", [this, self](const boost::system::error_code& ec, size_t) {
+                if (ec) {
+                    return;
+                }
+                istream request(&fRequest);
+                string method, target;
+                request >> method >> target;
+
+                string status("200 OK");
+                string body;
+                if (method != "GET") {
+                    status = "405 Method Not Allowed";
+                } else if (target != "/metrics" && target.rfind("/metrics?", 0) != 0) {
+                    status = "404 Not Found";
+                } else {
+                    try {
+                        body = fMetrics.Collect();
+                    } catch (const exception& e) {
+                        LOG(error) << "metrics plugin: failed collecting metrics: " << e.what();
+                        status = "500 Internal Server Error";
+                    }
+                }
+
+                fResponse = fair::mq::tools::ToString("HTTP/1.1 ", status, "\r\n",
+                                                      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n",
+                                                      "Content-Length: ", body.size(), "\r\n",
+                                                      "Connection: close\r\n\r\n", body);
+                asio::async_write(fSocket, asio::buffer(fResponse), [self](const boost::system::error_code&, size_t) {
+                    boost::system::error_code ignored;
+                    self->fSocket.shutdown(tcp::socket::shutdown_both, ignored);
+                });
+            });
+        }
+
+        tcp::socket fSocket;
+        fair::mq::plugins::Metrics& fMetrics;
+        asio::streambuf fRequest{8192};
+        string fResponse;
+    };
+}
+
+namespace fair::mq::plugins
+{
+
+Metrics::Metrics(const string& name, Plugin::Version version, const string& maintainer, const string& homepage, PluginServices* pluginServices)
+    : Plugin(name, version, maintainer, homepage, pluginServices)
+    , fAcceptor(fIoContext)
+    , fState(GetCurrentDeviceState())
+    , fStateEntered(chrono::steady_clock::now())
+{
+    auto port = GetProperty<int>("metrics-port");
+    if (port <= 0) {
+        return; // disabled
+    }
+
+    SubscribeToDeviceStateChange([&](DeviceState newState) { OnStateChange(newState); });
+
+    try {
+        tcp::endpoint endpoint(asio::ip::make_address(GetProperty<string>("metrics-address")), static_cast<unsigned short>(port));
+        fAcceptor.open(endpoint.protocol());
+        fAcceptor.set_option(tcp::acceptor::reuse_address(true));
+        fAcceptor.bind(endpoint);
+        fAcceptor.listen();
+    } catch (const boost::system::system_error& e) {
+        UnsubscribeFromDeviceStateChange();
+        LOG(error) << "metrics plugin: cannot listen on " << GetProperty<string>("metrics-address") << ":" << port << ": " << e.what();
+        throw runtime_error(tools::ToString("metrics plugin: cannot listen on ", GetProperty<string>("metrics-address"), ":", port, ": ", e.what()));
+    }
+
+    LOG(debug) << "metrics plugin: serving metrics on http://" << GetProperty<string>("metrics-address") << ":" << port << "/metrics";
+    Accept();
+    fServerThread = thread([this] { fIoContext.run(); });
+}
+
+auto Metrics::Accept() -> void
+{
+    fAcceptor.async_accept([this](const boost::system::error_code& ec, tcp::socket socket) {
+        if (ec == asio::error::operation_aborted) {
+            return;
+        }
+        if (!ec) {
+            make_shared<Session>(move(socket), *this)->Start();
+        }
+        Accept();
+    });
+}
+
+auto Metrics::OnStateChange(DeviceState newState) -> void
+{
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(fMtx);
+    StateStats& stats = fStateStats[fState];
+    stats.lastDuration = chrono::duration<double>(now - fStateEntered).count();
+    stats.totalDuration += stats.lastDuration;
+    ++fStateStats[newState].entered;
+    fState = newState;
+    fStateEntered = now;
+}
+
+auto Metrics::Collect() -> string
+{
+    ostringstream os;
+    os << setprecision(15);
+
+    // transports are guarded by the device, collect them first to not hold fMtx meanwhile
+    vector<TransportMetric> transportMetrics = GetTransportMetrics();
+
+    lock_guard<mutex> lock(fMtx);
+
+    Header(os, "fairmq_device_state", "gauge", "Current state of the device");
+    os << "fairmq_device_state{state=\"" << ToStr(fState) << "\"} 1\n";
+    Header(os, "fairmq_state_entered_total", "counter", "Number of times the state was entered");
+    for (const auto& [state, stats] : fStateStats) {
+        os << "fairmq_state_entered_total{state=\"" << ToStr(state) << "\"} " << stats.entered << "\n";
+    }
+    Header(os, "fairmq_state_last_duration_seconds", "gauge", "Time spent in the state on its last (completed) visit, e.g. the duration of a transition");
+    for (const auto& [state, stats] : fStateStats) {
+        os << "fairmq_state_last_duration_seconds{state=\"" << ToStr(state) << "\"} " << stats.lastDuration << "\n";
+    }
+    Header(os, "fairmq_state_duration_seconds_total", "counter", "Total time spent in the state, excluding the current visit");
+    for (const auto& [state, stats] : fStateStats) {
+        os << "fairmq_state_duration_seconds_total{state=\"" << ToStr(state) << "\"} " << stats.totalDuration << "\n";
+    }
+
+    // process wide, see StartupProfile, complete once the first device reached READY
+    vector<StartupPhase> phases = StartupProfile::GetPhases();
+    if (!phases.empty()) {
+        Header(os, "fairmq_startup_phase_seconds", "gauge", "Time spent in the initialization phase, summed over its entries (phase total: until the first READY)");
+        for (const auto& phase : phases) {
+            os << "fairmq_startup_phase_seconds{phase=\"" << phase.name << "\"} " << double(phase.duration.count()) / 1e6 << "\n";
+        }
+        Header(os, "fairmq_startup_phase_entries", "gauge", "Number of entries of the initialization phase, e.g. channels or transports");
+        for (const auto& phase : phases) {
+            os << "fairmq_startup_phase_entries{phase=\"" << phase.name << "\"} " << phase.count << "\n";
+        }
+    }
+
+    // channels only exist (with stable sockets) between Connecting and ResettingDevice, fMtx delays these state changes
+    if (fState == DeviceState::DeviceReady || fState == DeviceState::InitializingTask || fState == DeviceState::Ready
+        || fState == DeviceState::Running || fState == DeviceState::ResettingTask) {
+        vector<ChannelMetrics> channels = GetChannelMetrics();
+
+        auto perChannel = [&](const string& name, const string& type, const string& help, auto value) {
+            Header(os, name, type, help);
+            for (const auto& c : channels) {
+                value(c, "{channel=\"" + Escape(c.name) + "\",transport=\"" + c.transport + "\"");
+            }
+        };
+        perChannel("fairmq_channel_bytes_total", "counter", "Bytes transferred by the channel", [&](const ChannelMetrics& c, const string& l) {
+            os << "fairmq_channel_bytes_total" << l << ",direction=\"tx\"} " << c.bytesTx << "\n";
+            os << "fairmq_channel_bytes_total" << l << ",direction=\"rx\"} " << c.bytesRx << "\n";
+        });
+        perChannel("fairmq_channel_messages_total", "counter", "Messages transferred by the channel", [&](const ChannelMetrics& c, const string& l) {
+            os << "fairmq_channel_messages_total" << l << ",direction=\"tx\"} " << c.messagesTx << "\n";
+            os << "fairmq_channel_messages_total" << l << ",direction=\"rx\"} " << c.messagesRx << "\n";
+        });
+        perChannel("fairmq_channel_discarded_messages_total", "counter", "Messages dropped by the overflow policy, discarded after their deadline or for a checksum mismatch", [&](const ChannelMetrics& c, const string& l) {
+            os << "fairmq_channel_discarded_messages_total" << l << ",reason=\"overflow\"} " << c.messagesDropped << "\n";
+            os << "fairmq_channel_discarded_messages_total" << l << ",reason=\"deadline\"} " << c.messagesExpired << "\n";
+            os << "fairmq_channel_discarded_messages_total" << l << ",reason=\"checksum\"} " << c.messagesCorrupt << "\n";
+        });
+        if (any_of(channels.begin(), channels.end(), [](const ChannelMetrics& c) { return c.sendsShaped > 0; })) {
+            perChannel("fairmq_channel_shaped_sends_total", "counter", "Sends that waited for the bandwidth limit of the channel (maxBandwidth)", [&](const ChannelMetrics& c, const string& l) {
+                os << "fairmq_channel_shaped_sends_total" << l << "} " << c.sendsShaped << "\n";
+            });
+            perChannel("fairmq_channel_shaping_wait_seconds_total", "counter", "Time sends waited for the bandwidth limit of the channel (maxBandwidth)", [&](const ChannelMetrics& c, const string& l) {
+                os << "fairmq_channel_shaping_wait_seconds_total" << l << "} " << c.shapingWaitNs / 1e9 << "\n";
+            });
+        }
+        perChannel("fairmq_channel_queue_depth", "gauge", "Messages queued between the channel and its peers, counted (exact=\"true\") or estimated from the kernel socket queues", [&](const ChannelMetrics& c, const string& l) {
+            if (c.queueDepth >= 0) {
+                os << "fairmq_channel_queue_depth" << l << ",exact=\"" << (c.queueDepthExact ? "true" : "false") << "\"} " << c.queueDepth << "\n";
+            }
+        });
+
+        // compression, only for compressing channels
+        if (any_of(channels.begin(), channels.end(), [](const ChannelMetrics& c) { return c.compressed; })) {
+            perChannel("fairmq_channel_compression_bytes_total", "counter", "Payload bytes of compressing channels before (raw) and after (wire) compression", [&](const ChannelMetrics& c, const string& l) {
+                if (c.compressed) {
+                    os << "fairmq_channel_compression_bytes_total" << l << ",direction=\"tx\",stage=\"raw\"} " << c.rawBytesTx << "\n";
+                    os << "fairmq_channel_compression_bytes_total" << l << ",direction=\"tx\",stage=\"wire\"} " << c.wireBytesTx << "\n";
+                    os << "fairmq_channel_compression_bytes_total" << l << ",direction=\"rx\",stage=\"raw\"} " << c.rawBytesRx << "\n";
+                    os << "fairmq_channel_compression_bytes_total" << l << ",direction=\"rx\",stage=\"wire\"} " << c.wireBytesRx << "\n";
+                }
+            });
+            perChannel("fairmq_channel_codec_seconds_total", "counter", "Time spent compressing and decompressing, summed over the codec threads", [&](const ChannelMetrics& c, const string& l) {
+                if (c.compressed) {
+                    os << "fairmq_channel_codec_seconds_total" << l << ",op=\"compress\"} " << double(c.compressNs) / 1e9 << "\n";
+                    os << "fairmq_channel_codec_seconds_total" << l << ",op=\"decompress\"} " << double(c.decompressNs) / 1e9 << "\n";
+                }
+            });
+        }
+
+        // call metrics, only for channels recording them (--channel-metrics)
+        auto recorded = [](const ChannelMetrics& c) { return c.callsRecorded; };
+        if (any_of(channels.begin(), channels.end(), recorded)) {
+            channels.erase(remove_if(channels.begin(), channels.end(), [&](const ChannelMetrics& c) { return !recorded(c); }), channels.end());
+            perChannel("fairmq_channel_failed_calls_total", "counter", "Send/receive calls that timed out, were interrupted or failed", [&](const ChannelMetrics& c, const string& l) {
+                os << "fairmq_channel_failed_calls_total" << l << ",op=\"send\"} " << c.sendFailed << "\n";
+                os << "fairmq_channel_failed_calls_total" << l << ",op=\"receive\"} " << c.receiveFailed << "\n";
+            });
+            // buckets from ~1 us to ~17 s, every second power of two of the recorded ones
+            auto histogram = [&](const string& name, const string& l, const ChannelMetrics::Buckets& buckets, uint64_t calls, uint64_t ns) {
+                uint64_t cumulative = 0;
+                int next = 0;
+                for (int le = 10; le <= 34; le += 2) {
+                    for (; next <= le; ++next) {
+                        cumulative += buckets[next];
+                    }
+                    os << name << "_bucket" << l << ",le=\"" << double(uint64_t(1) << le) / 1e9 << "\"} " << cumulative << "\n";
+                }
+                os << name << "_bucket" << l << ",le=\"+Inf\"} " << calls << "\n";
+                os << name << "_sum" << l << "} " << double(ns) / 1e9 << "\n";
+                os << name << "_count" << l << "} " << calls << "\n";
+            };
+            perChannel("fairmq_channel_call_duration_seconds", "histogram", "Duration of the send/receive calls (time blocked)", [&](const ChannelMetrics& c, const string& l) {
+                histogram("fairmq_channel_call_duration_seconds", l + ",op=\"send\"", c.sendLatency, c.sendCalls, c.sendNs);
+                histogram("fairmq_channel_call_duration_seconds", l + ",op=\"receive\"", c.receiveLatency, c.receiveCalls, c.receiveNs);
+            });
+
+            // data callbacks, only for input channels
+            channels.erase(remove_if(channels.begin(), channels.end(), [](const ChannelMetrics& c) { return c.handlerCalls == 0; }), channels.end());
+            if (!channels.empty()) {
+                perChannel("fairmq_channel_handler_duration_seconds", "histogram", "Duration of the data callbacks (OnData) of the channel", [&](const ChannelMetrics& c, const string& l) {
+                    histogram("fairmq_channel_handler_duration_seconds", l, c.handlerLatency, c.handlerCalls, c.handlerNs);
+                });
+                perChannel("fairmq_channel_busy_ratio", "gauge", "Fraction of the time since the first data callback spent in the callbacks of the channel", [&](const ChannelMetrics& c, const string& l) {
+                    os << "fairmq_channel_busy_ratio" << l << "} " << c.BusyRatio() << "\n";
+                });
+            }
+        }
+
+        // hardware counters of the data callbacks and ConditionalRun (--perf-counters)
+        vector<ChannelMetrics> handlers;
+        copy_if(channels.begin(), channels.end(), back_inserter(handlers), [](const ChannelMetrics& c) { return c.perfRecorded && c.handlerCalls > 0; });
+        if (ChannelMetrics run = GetRunMetrics(); run.perfRecorded && run.handlerCalls > 0) {
+            handlers.push_back(move(run));
+        }
+        if (!handlers.empty()) {
+            Header(os, "fairmq_handler_calls_total", "counter", "Calls of the data callbacks of the channel or of ConditionalRun (handler label)");
+            for (const auto& h : handlers) {
+                os << "fairmq_handler_calls_total{handler=\"" << Escape(h.name) << "\"} " << h.handlerCalls << "\n";
+            }
+            Header(os, "fairmq_handler_perf_events_total", "counter", "Hardware events of the handlers in user space, per message: divided by fairmq_handler_calls_total");
+            for (const auto& h : handlers) {
+                const string l("{handler=\"" + Escape(h.name) + "\",event=\"");
+                os << "fairmq_handler_perf_events_total" << l << "cycles\"} " << h.handlerCycles << "\n";
+                os << "fairmq_handler_perf_events_total" << l << "instructions\"} " << h.handlerInstructions << "\n";
+                os << "fairmq_handler_perf_events_total" << l << "llc_misses\"} " << h.handlerLLCMisses << "\n";
+                os << "fairmq_handler_perf_events_total" << l << "branch_misses\"} " << h.handlerBranchMisses << "\n";
+            }
+        }
+    }
+
+    // group the transport metrics by name, each name gets one header
+    vector<string> names;
+    for (const auto& m : transportMetrics) {
+        if (find(names.begin(), names.end(), "fairmq_" + m.name) == names.end()) {
+            names.push_back("fairmq_" + m.name);
+        }
+    }
+    for (const auto& name : names) {
+        bool first = true;
+        for (const auto& m : transportMetrics) {
+            if ("fairmq_" + m.name != name) {
+                continue;
+            }
+            if (first) {
+                Header(os, name, m.counter ? "counter" : "gauge", m.help);
+                first = false;
+            }
+            os << name << Labels(m.labels) << " " << m.value << "\n";
+        }
+    }
+
+    return os.str();
+}
+
+Metrics::~Metrics()
+{
+    if (fServerThread.joinable()) {
+        fIoContext.stop();
+        fServerThread.join();
+        UnsubscribeFromDeviceStateChange();
+    }
+}
+
+auto MetricsPluginProgramOptions() -> Plugin::ProgOptions
+{
+    namespace po = boost::program_options;
+    auto pluginOptions = po::options_description{"Metrics (builtin) Plugin"};
+    pluginOptions.add_options()
+        ("metrics-port",    po::value<int   >()->default_value(0),         "Port of the Prometheus/OpenMetrics endpoint (http://<metrics-address>:<port>/metrics), 0 to disable.")
+        ("metrics-address", po::value<string>()->default_value("0.0.0.0"), "Address the metrics endpoint listens on.");
+    return pluginOptions;
+}
+
+} // namespace fair::mq::plugins
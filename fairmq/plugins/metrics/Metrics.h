@@ -0,0 +1,79 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_PLUGINS_METRICS
+#define FAIR_MQ_PLUGINS_METRICS
+
+#include <fairmq/Plugin.h>
+#include <fairmq/Version.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fair::mq::plugins
+{
+
+/// Serves the channel, transport and state machine metrics of the device on http://<metrics-address>:<metrics-port>/metrics
+/// in the Prometheus/OpenMetrics text format. Scrapes are handled by the plugin thread and only read counters.
+class Metrics : public Plugin
+{
+  public:
+    Metrics(const std::string& name, Plugin::Version version, const std::string& maintainer, const std::string& homepage, PluginServices* pluginServices);
+    Metrics(const Metrics&) = delete;
+    Metrics(Metrics&&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+    Metrics& operator=(Metrics&&) = delete;
+
+    ~Metrics() override;
+
+    /// @return the metrics in the Prometheus text exposition format
+    auto Collect() -> std::string;
+
+  private:
+    auto Accept() -> void;
+    auto OnStateChange(DeviceState newState) -> void;
+
+    struct StateStats
+    {
+        double lastDuration = 0;   ///< in seconds
+        double totalDuration = 0;
+        unsigned long entered = 0;
+    };
+
+    boost::asio::io_context fIoContext;
+    boost::asio::ip::tcp::acceptor fAcceptor;
+    std::thread fServerThread;
+
+    std::mutex fMtx;   ///< guards the state info, held while collecting so that channels are not reset meanwhile
+    DeviceState fState;
+    std::chrono::steady_clock::time_point fStateEntered;
+    std::map<DeviceState, StateStats> fStateStats;
+}; /* class Metrics */
+
+auto MetricsPluginProgramOptions() -> Plugin::ProgOptions;
+
+REGISTER_FAIRMQ_PLUGIN(
+    Metrics,   // Class name
+    metrics,   // Plugin name (string, lower case chars only)
+    (Plugin::Version{FAIRMQ_VERSION_MAJOR, FAIRMQ_VERSION_MINOR, FAIRMQ_VERSION_PATCH}), // Version
+    "FairRootGroup <fairroot@gsi.de>",             // Maintainer
+    "https://github.com/FairRootGroup/FairMQ",     // Homepage
+    MetricsPluginProgramOptions   // Free function which declares custom program options for the
+                                  // plugin signature: () ->
+                                  // boost::optional<boost::program_options::options_description>
+)
+
+} // namespace fair::mq::plugins
+
+#endif /* FAIR_MQ_PLUGINS_METRICS */
@@ -0,0 +1,112 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "Tracing.h"
+
+#include <fairmq/tools/Strings.h>
+
+#include <unistd.h> // getpid
+
+#include <chrono>
+#include <iomanip>
+#include <ios>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace fair::mq::plugins
+{
+
+Tracing::Tracing(const string& name, Plugin::Version version, const string& maintainer, const string& homepage, PluginServices* pluginServices)
+    : Plugin(name, version, maintainer, homepage, pluginServices)
+    , fFlushIntervalMs(GetProperty<int>("trace-flush-interval"))
+    , fPid(getpid())
+    , fDeviceId(GetProperty<string>("id"))
+    , fStop(false)
+{
+    auto filename = GetProperty<string>("trace-file");
+    if (filename.empty()) {
+        return; // disabled
+    }
+
+    fFile.open(filename, ios::out | ios::trunc);
+    if (!fFile) {
+        LOG(error) << "tracing plugin: cannot open trace file " << filename;
+        throw runtime_error(tools::ToString("tracing plugin: cannot open trace file ", filename));
+    }
+    fFile << "[\n{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << fPid << ",\"args\":{\"name\":\"" << fDeviceId << "\"}}";
+
+    Tracer::Enable(true);
+    LOG(debug) << "tracing plugin: writing trace events to " << filename;
+    fThread = thread(&Tracing::Run, this);
+}
+
+auto Tracing::Run() -> void
+{
+    unique_lock<mutex> lock(fMtx);
+    while (!fCV.wait_for(lock, chrono::milliseconds(fFlushIntervalMs), [&] { return fStop; })) {
+        Flush();
+    }
+}
+
+auto Tracing::Flush() -> void
+{
+    if (Tracer::Drain([&](uint32_t thread, const TraceEvent& event) { Write(thread, event); }) > 0) {
+        fFile.flush();
+    }
+}
+
+// Every event is an instant event on the thread, a receive (send) additionally begins (ends) an async slice
+// of the trace id, so that the time a trace spent in the device is shown across threads.
+auto Tracing::Write(uint32_t thread, const TraceEvent& event) -> void
+{
+    const bool receive = event.type == TraceEvent::Type::receive;
+    const string channel = Tracer::ChannelName(event.channel);
+    ostringstream ts;
+    ts << event.timestamp / 1000 << "." << setw(3) << setfill('0') << event.timestamp % 1000; // us
+    ostringstream id;
+    id << "\"0x" << hex << event.context.traceId << "\"";
+
+    fFile << ",\n"
+          << "{\"ph\":\"i\",\"s\":\"t\",\"cat\":\"fairmq\",\"name\":\"" << (receive ? "receive " : "send ") << channel
+          << "\",\"ts\":" << ts.str() << ",\"pid\":" << fPid << ",\"tid\":" << thread
+          << ",\"args\":{\"trace\":" << id.str() << ",\"span\":" << event.context.spanId << "}},\n"
+          << "{\"ph\":\"" << (receive ? "b" : "e") << "\",\"cat\":\"fairmq\",\"name\":\"" << fDeviceId << "\",\"id\":" << id.str()
+          << ",\"ts\":" << ts.str() << ",\"pid\":" << fPid << ",\"tid\":" << thread << "}";
+}
+
+Tracing::~Tracing()
+{
+    if (fThread.joinable()) {
+        {
+            lock_guard<mutex> lock(fMtx);
+            fStop = true;
+        }
+        fCV.notify_one();
+        fThread.join();
+        Tracer::Enable(false);
+        Flush();
+        fFile << "\n]\n";
+        if (Tracer::Dropped() > 0) {
+            LOG(warn) << "tracing plugin: " << Tracer::Dropped() << " trace events were dropped, the trace rings were full";
+        }
+    }
+}
+
+auto TracingPluginProgramOptions() -> Plugin::ProgOptions
+{
+    namespace po = boost::program_options;
+    auto pluginOptions = po::options_description{"Tracing (builtin) Plugin"};
+    pluginOptions.add_options()
+        ("trace-file",           po::value<string>()->default_value(""),  "File the trace events of the channels with the trace property are written to (Chrome trace event format), empty to disable.")
+        ("trace-flush-interval", po::value<int   >()->default_value(100), "Interval (in ms) in which the recorded trace events are written to the trace file.");
+    return pluginOptions;
+}
+
+} // namespace fair::mq::plugins
@@ -0,0 +1,70 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_PLUGINS_TRACING
+#define FAIR_MQ_PLUGINS_TRACING
+
+#include <fairmq/Plugin.h>
+#include <fairmq/Tracing.h>
+#include <fairmq/Version.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fair::mq::plugins
+{
+
+/// Enables the recording of the trace events (see fair::mq::Tracer) of the channels with the trace property
+/// and writes them periodically from its own thread to --trace-file in the Chrome trace event format
+/// (chrome://tracing, https://ui.perfetto.dev).
+class Tracing : public Plugin
+{
+  public:
+    Tracing(const std::string& name, Plugin::Version version, const std::string& maintainer, const std::string& homepage, PluginServices* pluginServices);
+    Tracing(const Tracing&) = delete;
+    Tracing(Tracing&&) = delete;
+    Tracing& operator=(const Tracing&) = delete;
+    Tracing& operator=(Tracing&&) = delete;
+
+    ~Tracing() override;
+
+  private:
+    auto Run() -> void;
+    auto Flush() -> void;
+    auto Write(uint32_t thread, const TraceEvent& event) -> void;
+
+    std::ofstream fFile;
+    int fFlushIntervalMs;
+    int fPid;
+    std::string fDeviceId;
+    std::thread fThread;
+    std::mutex fMtx;
+    std::condition_variable fCV;
+    bool fStop;
+}; /* class Tracing */
+
+auto TracingPluginProgramOptions() -> Plugin::ProgOptions;
+
+REGISTER_FAIRMQ_PLUGIN(
+    Tracing,   // Class name
+    tracing,   // Plugin name (string, lower case chars only)
+    (Plugin::Version{FAIRMQ_VERSION_MAJOR, FAIRMQ_VERSION_MINOR, FAIRMQ_VERSION_PATCH}), // Version
+    "FairRootGroup <fairroot@gsi.de>",             // Maintainer
+    "https://github.com/FairRootGroup/FairMQ",     // Homepage
+    TracingPluginProgramOptions   // Free function which declares custom program options for the
+                                  // plugin signature: () ->
+                                  // boost::optional<boost::program_options::options_description>
+)
+
+} // namespace fair::mq::plugins
+
+#endif /* FAIR_MQ_PLUGINS_TRACING */
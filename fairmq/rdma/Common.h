@@ -0,0 +1,164 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_RDMA_COMMON_H
+#define FAIR_MQ_RDMA_COMMON_H
+
+#include <fairmq/stream/Common.h>
+
+#include <infiniband/verbs.h>
+#include <netdb.h> // getaddrinfo
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h> // iovec, writev
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <string>
+
+namespace fair::mq::rdma
+{
+
+struct RdmaError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+using stream::kPollIn;
+using stream::kPollOut;
+
+constexpr uint32_t kMagic = 0x464d5152; // "FMQR"
+
+// queue pair attributes, exchanged over the TCP connection when a peer connects
+struct QpInfo
+{
+    uint32_t fQpn;
+    uint32_t fPsn;
+    uint16_t fLid;
+    uint16_t fReserved;
+    uint32_t fMagic;
+    uint8_t fGid[16];
+};
+
+// precedes every message part on the TCP connection
+struct FrameHeader
+{
+    static constexpr uint32_t kMore = 1; // more parts of the same multipart message follow
+    static constexpr uint32_t kRdma = 2; // payload is written with RDMA after the receiver has provided a buffer
+
+    uint64_t fSize;
+    uint32_t fFlags;
+    uint32_t fMagic;
+};
+
+// receiver -> sender: target of the RDMA write of a kRdma part
+struct WriteTarget
+{
+    uint64_t fAddr;
+    uint32_t fRkey;
+    uint32_t fMagic;
+};
+
+// sender -> receiver: the RDMA write of a kRdma part has completed (fStatus == 0) or failed
+struct WriteDone
+{
+    uint32_t fStatus;
+    uint32_t fMagic;
+};
+
+/// read exactly size bytes from a (blocking) descriptor
+/// @return size, 0 if the peer closed the connection or -errno
+inline int64_t ReadAll(int fd, void* data, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = recv(fd, static_cast<char*>(data) + done, size - done, MSG_WAITALL);
+        if (n > 0) {
+            done += n;
+        } else if (n == 0) {
+            return 0;
+        } else if (errno != EINTR) {
+            return -errno;
+        }
+    }
+    return done;
+}
+
+/// write all buffers to a (blocking) descriptor, the iovec array is modified
+/// @return 0 or -errno
+inline int WriteVec(int fd, iovec* iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        while (iovcnt > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+inline int WriteAll(int fd, const void* data, size_t size)
+{
+    iovec iov{const_cast<void*>(data), size};
+    return WriteVec(fd, &iov, 1);
+}
+
+/// Resolve a "tcp://<host>:<port>" address (used for connection setup), host "*" binds to all interfaces.
+/// Like the zeromq transport (without ZMQ_IPV6), host names resolve to IPv4, IPv6 needs a literal "[addr]".
+/// @return false if the address is not a valid tcp address
+inline bool ResolveTcpAddress(const std::string& address, sockaddr_storage& addr, socklen_t& addrLen, bool passive)
+{
+    const std::string prefix("tcp://");
+    if (address.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    std::string endpoint(address.substr(prefix.size()));
+    size_t pos = endpoint.rfind(':');
+    if (pos == std::string::npos || pos == 0 || pos == endpoint.size() - 1) {
+        return false;
+    }
+    std::string host(endpoint.substr(0, pos));
+    std::string port(endpoint.substr(pos + 1));
+    bool ipv6 = false;
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+        ipv6 = true;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = ipv6 ? AF_INET6 : AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    std::memcpy(&addr, result->ai_addr, result->ai_addrlen);
+    addrLen = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+} // namespace fair::mq::rdma
+
+#endif /* FAIR_MQ_RDMA_COMMON_H */
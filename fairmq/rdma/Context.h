@@ -0,0 +1,235 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_RDMA_CONTEXT_H_
+#define FAIR_MQ_RDMA_CONTEXT_H_
+
+#include <fairmq/rdma/Common.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/Transports.h>
+#include <fairmq/UnmanagedRegion.h>
+
+#include <fairlogger/Logger.h>
+
+#include <infiniband/verbs.h>
+
+#include <algorithm> // find_if
+#include <atomic>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstring> // strerror
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fair::mq::rdma
+{
+
+/// Verbs device and protection domain shared by all sockets and regions of an rdma transport,
+/// interruption flag and (process local) region events
+class Context
+{
+  public:
+    Context(const std::string& deviceName, uint8_t port, int gidIndex, size_t rdmaThreshold)
+        : fDevice(nullptr)
+        , fPd(nullptr)
+        , fPort(port)
+        , fGidIndex(gidIndex)
+        , fPortAttr()
+        , fGid()
+        , fRdmaThreshold(rdmaThreshold)
+        , fInterrupted(false)
+        , fRegionCounter(1)
+        , fRegionEventsSubscriptionActive(false)
+    {
+        int numDevices = 0;
+        ibv_device** devices = ibv_get_device_list(&numDevices);
+        if (!devices || numDevices == 0) {
+            if (devices) {
+                ibv_free_device_list(devices);
+            }
+            LOG(error) << "No RDMA devices found";
+            throw TransportError("No RDMA devices found");
+        }
+        ibv_device* device = nullptr;
+        for (int i = 0; i < numDevices; ++i) {
+            if (deviceName.empty() || deviceName == ibv_get_device_name(devices[i])) {
+                device = devices[i];
+                break;
+            }
+        }
+        if (!device) {
+            ibv_free_device_list(devices);
+            LOG(error) << "RDMA device '" << deviceName << "' not found";
+            throw TransportError(tools::ToString("RDMA device '", deviceName, "' not found"));
+        }
+        fDeviceName = ibv_get_device_name(device);
+        fDevice = ibv_open_device(device);
+        ibv_free_device_list(devices);
+        if (!fDevice) {
+            LOG(error) << "Could not open RDMA device " << fDeviceName << ", reason: " << strerror(errno);
+            throw TransportError(tools::ToString("Could not open RDMA device ", fDeviceName, ", reason: ", strerror(errno)));
+        }
+
+        if (ibv_query_port(fDevice, fPort, &fPortAttr) != 0) {
+            ibv_close_device(fDevice);
+            LOG(error) << "Could not query port " << static_cast<int>(fPort) << " of RDMA device " << fDeviceName;
+            throw TransportError(tools::ToString("Could not query port ", static_cast<int>(fPort), " of RDMA device ", fDeviceName));
+        }
+        if (fGidIndex >= 0 && ibv_query_gid(fDevice, fPort, fGidIndex, &fGid) != 0) {
+            ibv_close_device(fDevice);
+            LOG(error) << "Could not query gid " << fGidIndex << " of RDMA device " << fDeviceName;
+            throw TransportError(tools::ToString("Could not query gid ", fGidIndex, " of RDMA device ", fDeviceName));
+        }
+
+        fPd = ibv_alloc_pd(fDevice);
+        if (!fPd) {
+            ibv_close_device(fDevice);
+            LOG(error) << "Could not allocate protection domain on RDMA device " << fDeviceName;
+            throw TransportError(tools::ToString("Could not allocate protection domain on RDMA device ", fDeviceName));
+        }
+
+        LOG(debug) << "Using RDMA device " << fDeviceName << ", port " << static_cast<int>(fPort);
+        fRegionEvents.emplace(true, 0, nullptr, 0, 0, RegionEvent::local_only);
+    }
+
+    Context(const Context&) = delete;
+    Context(Context&&) = delete;
+    Context& operator=(const Context&) = delete;
+    Context& operator=(Context&&) = delete;
+
+    ibv_context* GetDevice() const { return fDevice; }
+    ibv_pd* GetPd() const { return fPd; }
+    uint8_t GetPort() const { return fPort; }
+    int GetGidIndex() const { return fGidIndex; }
+    const ibv_port_attr& GetPortAttr() const { return fPortAttr; }
+    const ibv_gid& GetGid() const { return fGid; }
+    size_t GetRdmaThreshold() const { return fRdmaThreshold; }
+
+    void SubscribeToRegionEvents(RegionEventCallback callback)
+    {
+        if (fRegionEventThread.joinable()) {
+            LOG(debug) << "Already subscribed. Overwriting previous subscription.";
+            {
+                std::lock_guard<std::mutex> lock(fMtx);
+                fRegionEventsSubscriptionActive = false;
+            }
+            fRegionEventsCV.notify_one();
+            fRegionEventThread.join();
+        }
+        std::lock_guard<std::mutex> lock(fMtx);
+        fRegionEventCallback = callback;
+        fRegionEventsSubscriptionActive = true;
+        fRegionEventThread = std::thread(&Context::RegionEventsSubscription, this);
+    }
+
+    bool SubscribedToRegionEvents() const { return fRegionEventThread.joinable(); }
+
+    void UnsubscribeFromRegionEvents()
+    {
+        if (fRegionEventThread.joinable()) {
+            std::unique_lock<std::mutex> lock(fMtx);
+            fRegionEventsSubscriptionActive = false;
+            lock.unlock();
+            fRegionEventsCV.notify_one();
+            fRegionEventThread.join();
+            lock.lock();
+            fRegionEventCallback = nullptr;
+        }
+    }
+
+    std::vector<RegionInfo> GetRegionInfo() const
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        return fRegionInfos;
+    }
+
+    uint16_t NextRegionId()
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        return fRegionCounter++;
+    }
+
+    void AddRegion(uint16_t id, void* ptr, size_t size, int64_t userFlags)
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            fRegionInfos.emplace_back(false, id, ptr, size, userFlags, RegionEvent::created);
+            fRegionEvents.emplace(false, id, ptr, size, userFlags, RegionEvent::created);
+        }
+        fRegionEventsCV.notify_one();
+    }
+
+    void RemoveRegion(uint16_t id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            auto it = find_if(fRegionInfos.begin(), fRegionInfos.end(), [id](const RegionInfo& i) { return i.id == id; });
+            if (it != fRegionInfos.end()) {
+                fRegionEvents.push(*it);
+                fRegionEvents.back().event = RegionEvent::destroyed;
+                fRegionInfos.erase(it);
+            } else {
+                LOG(error) << "RemoveRegion: given id (" << id << ") not found.";
+            }
+        }
+        fRegionEventsCV.notify_one();
+    }
+
+    void Interrupt() { fInterrupted.store(true); }
+    void Resume() { fInterrupted.store(false); }
+    void Reset() {}
+    bool Interrupted() const { return fInterrupted.load(); }
+
+    ~Context()
+    {
+        UnsubscribeFromRegionEvents();
+        ibv_dealloc_pd(fPd);
+        ibv_close_device(fDevice);
+    }
+
+  private:
+    void RegionEventsSubscription()
+    {
+        std::unique_lock<std::mutex> lock(fMtx);
+        while (fRegionEventsSubscriptionActive) {
+            while (!fRegionEvents.empty()) {
+                auto i = fRegionEvents.front();
+                fRegionEventCallback(i);
+                fRegionEvents.pop();
+            }
+            fRegionEventsCV.wait(lock, [&]() { return !fRegionEventsSubscriptionActive || !fRegionEvents.empty(); });
+        }
+    }
+
+    ibv_context* fDevice;
+    ibv_pd* fPd;
+    std::string fDeviceName;
+    uint8_t fPort;
+    int fGidIndex; // -1: InfiniBand addressing by LID, >= 0: global routing (RoCE)
+    ibv_port_attr fPortAttr;
+    ibv_gid fGid;
+    size_t fRdmaThreshold;
+
+    mutable std::mutex fMtx;
+    std::atomic<bool> fInterrupted;
+    uint16_t fRegionCounter;
+    std::condition_variable fRegionEventsCV;
+    std::vector<RegionInfo> fRegionInfos;
+    std::queue<RegionInfo> fRegionEvents;
+    std::thread fRegionEventThread;
+    std::function<void(RegionInfo)> fRegionEventCallback;
+    bool fRegionEventsSubscriptionActive;
+};
+
+} // namespace fair::mq::rdma
+
+#endif /* FAIR_MQ_RDMA_CONTEXT_H_ */
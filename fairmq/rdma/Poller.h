@@ -0,0 +1,22 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_RDMA_POLLER_H
+#define FAIR_MQ_RDMA_POLLER_H
+
+#include <fairmq/stream/Poller.h>
+#include <fairmq/rdma/Socket.h>
+
+namespace fair::mq::rdma
+{
+
+using Poller = stream::Poller<Socket>;
+
+} // namespace fair::mq::rdma
+
+#endif /* FAIR_MQ_RDMA_POLLER_H */
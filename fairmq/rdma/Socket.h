@@ -0,0 +1,1023 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_RDMA_SOCKET_H
+#define FAIR_MQ_RDMA_SOCKET_H
+
+#include <fairmq/Message.h>
+#include <fairmq/Socket.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/rdma/Common.h>
+#include <fairmq/rdma/Context.h>
+#include <fairmq/rdma/Message.h>
+#include <fairmq/rdma/UnmanagedRegion.h>
+
+#include <fairlogger/Logger.h>
+
+#include <infiniband/verbs.h>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm> // min, find_if, find
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits> // IOV_MAX
+#include <cstring> // strerror, memcpy
+#include <memory> // unique_ptr, make_unique
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fair::mq::rdma
+{
+
+/// PUSH/PULL and PAIR socket between RDMA capable hosts.
+/// Connections are set up over TCP, which also carries the frame headers and the content of small parts.
+/// Parts of at least the rdma threshold are written by the sender into a buffer provided by the receiver
+/// (one-sided RDMA write over a reliable connected queue pair), without intermediate copies. The receiver
+/// provides the buffer on the TCP connection, which is therefore only used in one direction for this
+/// rendezvous: PUSH/PULL. PAIR sockets send all parts over TCP (two peers sending large parts at the same
+/// time would each read the frame of the other as the write target).
+/// Blocks of unmanaged regions are acknowledged once the write has completed, all blocks of one
+/// (multipart) message of a region with a single call of the region bulk callback.
+class Socket final : public fair::mq::Socket
+{
+    friend class stream::Poller<Socket>;
+
+    static constexpr int kReconnectInterval = 100; // ms
+    static constexpr int kMaxSendWr = 64;
+    static constexpr int kCqSize = 128;
+
+  public:
+    Socket(Context& ctx, const std::string& type, const std::string& name, const std::string& id, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Socket(factory)
+        , fCtx(ctx)
+        , fId(id + "." + name + "." + type)
+        , fType(type)
+        , fCq(nullptr)
+        , fBytesTx(0)
+        , fBytesRx(0)
+        , fMessagesTx(0)
+        , fMessagesRx(0)
+        , fTimeout(100)
+        , fLinger(1000)
+        , fSndHwm(1000)
+        , fRcvHwm(1000)
+        , fSndKernelSize(0)
+        , fRcvKernelSize(0)
+        , fNextPeer(0)
+        , fMoreFd(-1)
+        , fRdmaThreshold(type == "pair" ? 0 : fCtx.GetRdmaThreshold())
+        , fNextWrId(1)
+    {
+        if (type != "push" && type != "pull" && type != "pair") {
+            LOG(error) << "Failed creating socket " << fId << ", reason: socket type '" << type << "' is not supported by the rdma transport (push, pull, pair)";
+            throw SocketError(tools::ToString("Unavailable socket type for the rdma transport requested: ", type));
+        }
+
+        fCq = ibv_create_cq(fCtx.GetDevice(), kCqSize, nullptr, nullptr, 0);
+        if (!fCq) {
+            LOG(error) << "Failed creating socket " << fId << ", reason: could not create completion queue: " << strerror(errno);
+            throw SocketError(tools::ToString("Failed creating socket ", fId, ", reason: could not create completion queue: ", strerror(errno)));
+        }
+
+        LOG(debug) << "Created socket " << GetId();
+    }
+
+    Socket(const Socket&) = delete;
+    Socket(Socket&&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket& operator=(Socket&&) = delete;
+
+    std::string GetId() const override { return fId; }
+
+    bool Bind(const std::string& address) override
+    {
+        sockaddr_storage addr{};
+        socklen_t addrLen = 0;
+        if (!ResolveTcpAddress(address, addr, addrLen, true)) {
+            LOG(error) << "Failed binding socket " << fId << ", address: " << address << ", reason: the rdma transport supports only tcp://<host>:<port> addresses (for connection setup)";
+            return false;
+        }
+
+        int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            LOG(error) << "Failed binding socket " << fId << ", address: " << address << ", reason: " << strerror(errno);
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), addrLen) != 0 || listen(fd, SOMAXCONN) != 0) {
+            int err = errno;
+            close(fd);
+            // as in the zeromq transport, a busy port is handled upstream (by trying other ports from a range)
+            if (err != EADDRINUSE && err != EACCES) {
+                LOG(error) << "Failed binding socket " << fId << ", address: " << address << ", reason: " << strerror(err);
+            } else {
+                LOG(debug) << "Failed binding socket " << fId << ", address: " << address << ", reason: " << strerror(err);
+            }
+            return false;
+        }
+
+        fListenFds.push_back(fd);
+        return true;
+    }
+
+    bool Connect(const std::string& address) override
+    {
+        Endpoint endpoint;
+        if (!ResolveTcpAddress(address, endpoint.fAddr, endpoint.fAddrLen, false)) {
+            LOG(error) << "Failed connecting socket " << fId << ", address: " << address << ", reason: the rdma transport supports only tcp://<host>:<port> addresses (for connection setup)";
+            return false;
+        }
+        endpoint.fAddress = address;
+        // like zeromq, the connection is established (and re-established) in the background of send/receive/poll calls
+        fEndpoints.push_back(endpoint);
+        UpdatePeers();
+        return true;
+    }
+
+    int64_t Send(MessagePtr& msg, int timeout = -1) override { return SendParts(&msg, 1, timeout); }
+
+    int64_t Send(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
+    {
+        if (msgVec.empty()) {
+            LOG(warn) << "Will not send empty vector";
+            return static_cast<int>(TransferCode::error);
+        }
+        return SendParts(msgVec.data(), msgVec.size(), timeout);
+    }
+
+    int64_t Receive(MessagePtr& msg, int timeout = -1) override
+    {
+        if (fType == "push") {
+            LOG(error) << "Cannot receive on push socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+
+        while (true) {
+            int fd = fMoreFd;
+            if (fd < 0) {
+                int peer = WaitForPeer(POLLIN, timeout);
+                if (peer < 0) {
+                    return peer;
+                }
+                fd = fPeers[peer].fFd;
+            }
+
+            FrameHeader header{};
+            int64_t result = ReceivePart(fd, *static_cast<Message*>(msg.get()), header);
+            if (result < 0) {
+                continue; // peer is gone, wait for the next one
+            }
+            // remaining parts of a multipart message are returned by the next calls
+            fMoreFd = (header.fFlags & FrameHeader::kMore) ? fd : -1;
+            fBytesRx += result;
+            ++fMessagesRx;
+            return result;
+        }
+    }
+
+    int64_t Receive(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
+    {
+        if (fType == "push") {
+            LOG(error) << "Cannot receive on push socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+
+        while (true) {
+            int fd = fMoreFd;
+            if (fd < 0) {
+                int peer = WaitForPeer(POLLIN, timeout);
+                if (peer < 0) {
+                    return peer;
+                }
+                fd = fPeers[peer].fFd;
+            }
+
+            size_t initialSize = msgVec.size();
+            int64_t totalSize = 0;
+            FrameHeader header{};
+            do {
+                fair::mq::MessagePtr part = std::make_unique<Message>(GetTransport());
+                int64_t result = ReceivePart(fd, *static_cast<Message*>(part.get()), header);
+                if (result < 0) {
+                    totalSize = -1;
+                    break;
+                }
+                msgVec.push_back(move(part));
+                totalSize += result;
+            } while (header.fFlags & FrameHeader::kMore);
+
+            fMoreFd = -1;
+            if (totalSize < 0) {
+                // connection was lost within the message, drop the incomplete parts
+                msgVec.resize(initialSize);
+                continue;
+            }
+
+            // store statistics on how many messages have been received (handle all parts as a single message)
+            ++fMessagesRx;
+            fBytesRx += totalSize;
+            return totalSize;
+        }
+    }
+
+    void Close() override
+    {
+        // LOG(debug) << "Closing socket " << fId;
+
+        while (!fPeers.empty()) {
+            ClosePeer(fPeers.size() - 1);
+        }
+        for (Endpoint& endpoint : fEndpoints) {
+            if (endpoint.fFd >= 0 && !endpoint.fConnected) {
+                close(endpoint.fFd);
+            }
+        }
+        fEndpoints.clear();
+        for (int fd : fListenFds) {
+            close(fd);
+        }
+        fListenFds.clear();
+        fMoreFd = -1;
+
+        if (fCq && ibv_destroy_cq(fCq) != 0) {
+            LOG(error) << "Failed destroying completion queue of socket " << fId;
+        }
+        fCq = nullptr;
+    }
+
+    void SetOption(const std::string& option, const void* value, size_t /* valueSize */) override
+    {
+        int intValue = *static_cast<const int*>(value);
+        if (option == "linger") {
+            SetLinger(intValue);
+        } else if (option == "snd-hwm") {
+            SetSndBufSize(intValue);
+        } else if (option == "rcv-hwm") {
+            SetRcvBufSize(intValue);
+        } else if (option == "snd-size") {
+            SetSndKernelSize(intValue);
+        } else if (option == "rcv-size") {
+            SetRcvKernelSize(intValue);
+        } else {
+            LOG(error) << "Failed setting socket option, reason: option '" << option << "' is not supported by the rdma transport";
+        }
+    }
+
+    void GetOption(const std::string& option, void* value, size_t* valueSize) override
+    {
+        int intValue = 0;
+        if (option == "linger") {
+            intValue = GetLinger();
+        } else if (option == "snd-hwm") {
+            intValue = GetSndBufSize();
+        } else if (option == "rcv-hwm") {
+            intValue = GetRcvBufSize();
+        } else if (option == "snd-size") {
+            intValue = GetSndKernelSize();
+        } else if (option == "rcv-size") {
+            intValue = GetRcvKernelSize();
+        } else if (option == "rcv-more") {
+            intValue = fMoreFd >= 0 ? 1 : 0;
+        } else {
+            LOG(error) << "Failed getting socket option, reason: option '" << option << "' is not supported by the rdma transport";
+            return;
+        }
+        *static_cast<int*>(value) = intValue;
+        *valueSize = sizeof(intValue);
+    }
+
+    int Events(uint32_t* events) override
+    {
+        UpdatePeers();
+        std::vector<pollfd> fds;
+        AddPollFds(fds);
+        if (!fds.empty() && poll(fds.data(), fds.size(), 0) < 0 && errno != EINTR) {
+            LOG(error) << "Failed getting events of socket " << fId << ", reason: " << strerror(errno);
+            return -1;
+        }
+        *events = PollResult(fds.data());
+        return 0;
+    }
+
+    void SetLinger(int value) override { fLinger = value; }
+    int GetLinger() const override { return fLinger; }
+    // high-water marks are accepted for compatibility, sends are synchronous (rendezvous with the receiver for rdma parts)
+    void SetSndBufSize(int value) override { fSndHwm = value; }
+    int GetSndBufSize() const override { return fSndHwm; }
+    void SetRcvBufSize(int value) override { fRcvHwm = value; }
+    int GetRcvBufSize() const override { return fRcvHwm; }
+
+    void SetSndKernelSize(int value) override
+    {
+        fSndKernelSize = value;
+        for (const Peer& peer : fPeers) {
+            ConfigureFd(peer.fFd);
+        }
+    }
+
+    int GetSndKernelSize() const override { return fSndKernelSize; }
+
+    void SetRcvKernelSize(int value) override
+    {
+        fRcvKernelSize = value;
+        for (const Peer& peer : fPeers) {
+            ConfigureFd(peer.fFd);
+        }
+    }
+
+    int GetRcvKernelSize() const override { return fRcvKernelSize; }
+
+    unsigned long GetNumberOfConnectedPeers() const override
+    {
+        UpdatePeers();
+        return std::count_if(fPeers.begin(), fPeers.end(), [](const Peer& p) { return p.fReady; });
+    }
+
+    unsigned long GetBytesTx() const override { return fBytesTx; }
+    unsigned long GetBytesRx() const override { return fBytesRx; }
+    unsigned long GetMessagesTx() const override { return fMessagesTx; }
+    unsigned long GetMessagesRx() const override { return fMessagesRx; }
+
+    ~Socket() override { Close(); }
+
+  private:
+    struct Peer
+    {
+        int fFd;
+        int fEndpoint; // index into fEndpoints for connected peers, -1 for accepted peers
+        ibv_qp* fQp;
+        bool fReady; // queue pair is connected
+        QpInfo fLocal;
+        QpInfo fRemote;
+        size_t fRemoteReceived; // bytes of fRemote received so far
+    };
+
+    struct Endpoint
+    {
+        std::string fAddress;
+        sockaddr_storage fAddr{};
+        socklen_t fAddrLen = 0;
+        int fFd = -1; // connection in progress or established
+        bool fConnected = false;
+        std::chrono::steady_clock::time_point fNextAttempt;
+    };
+
+    int64_t SendParts(MessagePtr* msgs, size_t numParts, int timeout)
+    {
+        if (fType == "pull") {
+            LOG(error) << "Cannot send on pull socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+
+        // acknowledge the region blocks of the message with one bulk callback per region
+        std::vector<std::shared_ptr<RegionState>> regions;
+        for (size_t i = 0; i < numParts; ++i) {
+            const auto& region = static_cast<Message*>(msgs[i].get())->fRegion;
+            if (region && std::find(regions.begin(), regions.end(), region) == regions.end()) {
+                regions.push_back(region);
+                region->BeginBatch();
+            }
+        }
+
+        const auto deadline = timeout >= 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout) : std::chrono::steady_clock::time_point::max();
+        int64_t result = 0;
+        while (true) {
+            int peer = WaitForPeer(POLLOUT, timeout);
+            if (peer < 0) {
+                result = peer;
+                break;
+            }
+
+            result = Transmit(fPeers[peer], msgs, numParts, deadline);
+            if (result == -ETIMEDOUT || result == -EINTR) {
+                // the rendezvous of an rdma part has been given up, the connection is in the middle of a message
+                LOG(debug) << "Dropping the connection of socket " << fId << " after " << (result == -EINTR ? "an interruption" : "a timeout") << " in the middle of a message";
+                ClosePeer(peer);
+                result = static_cast<int>(result == -EINTR ? TransferCode::interrupted : TransferCode::timeout);
+                break;
+            }
+            if (result < 0) {
+                LOG(debug) << "Lost peer of socket " << fId << " while sending, reason: " << strerror(static_cast<int>(-result));
+                ClosePeer(peer);
+                continue;
+            }
+
+            for (size_t i = 0; i < numParts; ++i) {
+                msgs[i]->Rebuild();
+            }
+
+            // store statistics on how many messages have been sent (handle all parts as a single message)
+            ++fMessagesTx;
+            fBytesTx += result;
+            break;
+        }
+
+        for (auto& region : regions) {
+            region->EndBatch();
+        }
+        return result;
+    }
+
+    /// send all parts (with their headers) to the peer, the rdma parts waiting for the receiver until the deadline
+    /// @return number of payload bytes or -errno (-ETIMEDOUT after the deadline, -EINTR after an interruption)
+    int64_t Transmit(Peer& peer, MessagePtr* msgs, size_t numParts, std::chrono::steady_clock::time_point deadline)
+    {
+        fHeaders.resize(numParts);
+        fIovs.clear();
+
+        int64_t totalSize = 0;
+        for (size_t i = 0; i < numParts; ++i) {
+            Message& msg = *static_cast<Message*>(msgs[i].get());
+            size_t size = msg.GetSize();
+            totalSize += size;
+            bool rdma = fRdmaThreshold > 0 && size >= fRdmaThreshold;
+            uint32_t flags = (i + 1 < numParts ? FrameHeader::kMore : 0) | (rdma ? FrameHeader::kRdma : 0);
+            fHeaders[i] = {size, flags, kMagic};
+            fIovs.push_back({&fHeaders[i], sizeof(FrameHeader)});
+
+            if (rdma) {
+                int rc = WriteVec(peer.fFd, fIovs.data(), fIovs.size());
+                fIovs.clear();
+                if (rc == 0) {
+                    rc = WriteRdma(peer, msg, deadline);
+                }
+                if (rc < 0) {
+                    return rc;
+                }
+            } else if (size > 0) {
+                fIovs.push_back({msg.fData, size});
+            }
+
+            if (fIovs.size() >= IOV_MAX - 1) {
+                int rc = WriteVec(peer.fFd, fIovs.data(), fIovs.size());
+                fIovs.clear();
+                if (rc < 0) {
+                    return rc;
+                }
+            }
+        }
+
+        if (!fIovs.empty()) {
+            int rc = WriteVec(peer.fFd, fIovs.data(), fIovs.size());
+            fIovs.clear();
+            if (rc < 0) {
+                return rc;
+            }
+        }
+        return totalSize;
+    }
+
+    /// wait for the target buffer from the receiver, write the part into it and report the completion
+    /// @return 0 or -errno (-ETIMEDOUT after the deadline, -EINTR after an interruption)
+    int WriteRdma(Peer& peer, Message& msg, std::chrono::steady_clock::time_point deadline)
+    {
+        WriteTarget target{};
+        int64_t res = WaitReadable(peer.fFd, deadline);
+        if (res == 0) {
+            res = ReadAll(peer.fFd, &target, sizeof(target));
+        } else {
+            return static_cast<int>(res);
+        }
+        if (res <= 0) {
+            return res < 0 ? res : -ECONNRESET;
+        }
+        if (target.fMagic != kMagic) {
+            LOG(error) << "Received invalid write target on socket " << fId;
+            return -EPROTO;
+        }
+
+        // region memory is registered with the region, other buffers only for the duration of the write
+        ibv_mr* mr = msg.fRegion ? msg.fRegion->fMr : nullptr;
+        ibv_mr* tmpMr = nullptr;
+        if (!mr) {
+            tmpMr = mr = ibv_reg_mr(fCtx.GetPd(), msg.fData, msg.fSize, IBV_ACCESS_LOCAL_WRITE);
+        }
+
+        int rc = -EIO;
+        if (mr) {
+            rc = PostWrite(peer, mr, msg.fData, msg.fSize, target, deadline);
+        } else {
+            LOG(error) << "Failed registering message buffer of " << msg.fSize << " bytes on socket " << fId << ", reason: " << strerror(errno);
+        }
+        if (tmpMr) {
+            ibv_dereg_mr(tmpMr);
+        }
+        if (rc == -ETIMEDOUT || rc == -EINTR) {
+            return rc; // the connection is dropped, the receiver sees it instead of the WriteDone
+        }
+
+        WriteDone done{rc == 0 ? 0u : 1u, kMagic};
+        int wrc = WriteAll(peer.fFd, &done, sizeof(done));
+        return rc < 0 ? rc : wrc;
+    }
+
+    /// RDMA write of [data, data + size) to the target, in chunks of the maximum message size of the port
+    int PostWrite(Peer& peer, ibv_mr* mr, const char* data, size_t size, const WriteTarget& target, std::chrono::steady_clock::time_point deadline)
+    {
+        const size_t chunkSize = fCtx.GetPortAttr().max_msg_sz;
+        size_t offset = 0;
+        while (offset < size) {
+            // post up to kMaxSendWr chunks, only the last one signaled
+            int numWr = 0;
+            ibv_send_wr* badWr = nullptr;
+            uint64_t wrId = fNextWrId++;
+            fSges.clear();
+            fWrs.clear();
+            fSges.reserve(kMaxSendWr);
+            fWrs.reserve(kMaxSendWr);
+            while (offset < size && numWr < kMaxSendWr) {
+                size_t len = std::min(chunkSize, size - offset);
+                fSges.push_back({reinterpret_cast<uint64_t>(data + offset), static_cast<uint32_t>(len), mr->lkey});
+                ibv_send_wr wr{};
+                wr.wr_id = wrId;
+                wr.sg_list = &fSges.back();
+                wr.num_sge = 1;
+                wr.opcode = IBV_WR_RDMA_WRITE;
+                wr.wr.rdma.remote_addr = target.fAddr + offset;
+                wr.wr.rdma.rkey = target.fRkey;
+                fWrs.push_back(wr);
+                offset += len;
+                ++numWr;
+            }
+            for (int i = 0; i + 1 < numWr; ++i) {
+                fWrs[i].next = &fWrs[i + 1];
+                fWrs[i].wr_id = 0; // completes only with an error (or flushed), before the last one
+            }
+            fWrs.back().send_flags = IBV_SEND_SIGNALED;
+
+            if (ibv_post_send(peer.fQp, fWrs.data(), &badWr) != 0) {
+                LOG(error) << "Failed posting RDMA write on socket " << fId << ", reason: " << strerror(errno);
+                return -EIO;
+            }
+            int rc = WaitForCompletion(peer, wrId, deadline);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+        return 0;
+    }
+
+    /// busy poll the completion queue for the completion of the work request, until the deadline or an interruption.
+    /// When giving up, the queue pair is moved to the error state and the flushed request is collected, so that the
+    /// device no longer reads the buffer once this returns
+    /// @return 0 or -errno (-ETIMEDOUT after the deadline, -EINTR after an interruption)
+    int WaitForCompletion(Peer& peer, uint64_t wrId, std::chrono::steady_clock::time_point deadline)
+    {
+        ibv_wc wc{};
+        int rc = 0;
+        bool flushing = false;
+        while (true) {
+            int n = ibv_poll_cq(fCq, 1, &wc);
+            if (n < 0) {
+                LOG(error) << "Failed polling completion queue of socket " << fId;
+                return -EIO;
+            } else if (n == 0) {
+                if (!flushing && (fCtx.Interrupted() || std::chrono::steady_clock::now() >= deadline)) {
+                    rc = fCtx.Interrupted() ? -EINTR : -ETIMEDOUT;
+                    ibv_qp_attr attr{};
+                    attr.qp_state = IBV_QPS_ERR;
+                    if (ibv_modify_qp(peer.fQp, &attr, IBV_QP_STATE) != 0) {
+                        LOG(error) << "Failed moving the queue pair of socket " << fId << " to the error state: " << strerror(errno);
+                        return -EIO;
+                    }
+                    flushing = true;
+                }
+                continue;
+            }
+            if (wc.wr_id != wrId) {
+                continue;
+            }
+            if (flushing) {
+                return rc;
+            }
+            if (wc.status != IBV_WC_SUCCESS) {
+                LOG(error) << "RDMA write on socket " << fId << " failed: " << ibv_wc_status_str(wc.status);
+                return -EIO;
+            }
+            return 0;
+        }
+    }
+
+    /// wait until fd is readable, in slices of the socket timeout to notice interruptions
+    /// @return 0, -ETIMEDOUT after the deadline, -EINTR after an interruption or -errno
+    int WaitReadable(int fd, std::chrono::steady_clock::time_point deadline)
+    {
+        while (true) {
+            if (fCtx.Interrupted()) {
+                return -EINTR;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return -ETIMEDOUT;
+            }
+            int wait = fTimeout;
+            if (deadline != std::chrono::steady_clock::time_point::max()) {
+                wait = static_cast<int>(std::min<int64_t>(fTimeout, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1));
+            }
+            pollfd pfd{fd, POLLIN, 0};
+            int n = poll(&pfd, 1, wait);
+            if (n > 0) {
+                return 0; // readable, or an error/hangup that the read reports
+            } else if (n < 0 && errno != EINTR) {
+                return -errno;
+            }
+        }
+    }
+
+    /// receive one part (header and data) from fd into msg
+    /// @return size of the part or -1 if the peer is gone
+    int64_t ReceivePart(int fd, Message& msg, FrameHeader& header)
+    {
+        int64_t res = ReadAll(fd, &header, sizeof(header));
+        if (res > 0 && header.fMagic != kMagic) {
+            LOG(error) << "Received invalid frame on socket " << fId << ", closing the connection";
+            res = -EPROTO;
+        }
+        if (res > 0 && (header.fFlags & FrameHeader::kRdma)) {
+            res = ReadRdma(fd, msg.Reset(header.fSize), header.fSize);
+        } else if (res > 0 && header.fSize > 0) {
+            res = ReadAll(fd, msg.Reset(header.fSize), header.fSize);
+        } else if (res > 0) {
+            msg.Reset(0);
+        }
+
+        if (res <= 0) {
+            if (res < 0) {
+                LOG(debug) << "Lost peer of socket " << fId << " while receiving, reason: " << strerror(static_cast<int>(-res));
+            }
+            auto it = std::find_if(fPeers.begin(), fPeers.end(), [fd](const Peer& p) { return p.fFd == fd; });
+            if (it != fPeers.end()) {
+                ClosePeer(it - fPeers.begin());
+            }
+            if (fMoreFd == fd) {
+                fMoreFd = -1;
+            }
+            return -1;
+        }
+        return header.fSize;
+    }
+
+    /// provide the buffer to the sender and wait until it has been written
+    /// @return size, 0 if the peer closed the connection or -errno
+    int64_t ReadRdma(int fd, char* data, size_t size)
+    {
+        ibv_mr* mr = ibv_reg_mr(fCtx.GetPd(), data, size, IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+        if (!mr) {
+            LOG(error) << "Failed registering receive buffer of " << size << " bytes on socket " << fId << ", reason: " << strerror(errno);
+            return -ENOMEM;
+        }
+
+        WriteTarget target{reinterpret_cast<uint64_t>(data), mr->rkey, kMagic};
+        int64_t res = WriteAll(fd, &target, sizeof(target));
+        WriteDone done{};
+        if (res == 0) {
+            res = ReadAll(fd, &done, sizeof(done));
+        }
+        ibv_dereg_mr(mr);
+
+        if (res > 0 && (done.fMagic != kMagic || done.fStatus != 0)) {
+            LOG(error) << "RDMA write of " << size << " bytes to socket " << fId << " failed on the sender side";
+            return -EIO;
+        }
+        return res > 0 ? static_cast<int64_t>(size) : res;
+    }
+
+    /// wait until a peer is ready for the given events
+    /// @return peer index or a (negative) TransferCode
+    int WaitForPeer(short events, int timeout)
+    {
+        int elapsed = 0;
+        while (true) {
+            UpdatePeers();
+            fPollFds.clear();
+            AddPollFds(fPollFds, events);
+            int wait = timeout < 0 ? fTimeout : std::min(fTimeout, timeout - elapsed);
+            if (poll(fPollFds.data(), fPollFds.size(), wait) < 0 && errno != EINTR) {
+                LOG(error) << "Failed polling socket " << fId << ", reason: " << strerror(errno);
+                return static_cast<int>(TransferCode::error);
+            }
+
+            int peer = ReadyPeer(fPollFds.data(), events);
+            if (peer >= 0) {
+                return peer;
+            } else if (fCtx.Interrupted()) {
+                return static_cast<int>(TransferCode::interrupted);
+            } else if (timeout >= 0) {
+                elapsed += wait;
+                if (elapsed >= timeout) {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            }
+        }
+    }
+
+    /// pick the next ready peer (round-robin), close dead ones
+    int ReadyPeer(const pollfd* fds, short events)
+    {
+        const size_t numPeers = fPeers.size();
+        for (size_t k = 0; k < numPeers; ++k) {
+            size_t i = (fNextPeer + k) % numPeers;
+            if (fPeers[i].fReady && (fds[i].revents & events)) {
+                fNextPeer = i + 1;
+                return i;
+            }
+        }
+        for (size_t i = numPeers; i-- > 0;) {
+            if (fPeers[i].fReady && (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+                ClosePeer(i);
+            }
+        }
+        return -1;
+    }
+
+    /// descriptors to poll: the peers (first, in order), listening sockets and connections in progress
+    void AddPollFds(std::vector<pollfd>& fds, short events = 0) const
+    {
+        if (events == 0) {
+            events = fType == "push" ? POLLOUT : (fType == "pull" ? POLLIN : POLLIN | POLLOUT);
+        }
+        for (const Peer& peer : fPeers) {
+            // peers in the handshake wait for the queue pair attributes of the other side
+            fds.push_back({peer.fFd, peer.fReady ? events : static_cast<short>(POLLIN), 0});
+        }
+        for (int fd : fListenFds) {
+            fds.push_back({fd, POLLIN, 0});
+        }
+        for (const Endpoint& endpoint : fEndpoints) {
+            if (endpoint.fFd >= 0 && !endpoint.fConnected) {
+                fds.push_back({endpoint.fFd, POLLOUT, 0});
+            }
+        }
+    }
+
+    /// kPollIn/kPollOut from the polled descriptors of AddPollFds()
+    uint32_t PollResult(const pollfd* fds) const
+    {
+        uint32_t result = fMoreFd >= 0 ? kPollIn : 0;
+        for (size_t i = 0; i < fPeers.size(); ++i) {
+            if (!fPeers[i].fReady) {
+                continue;
+            }
+            if (fds[i].revents & POLLIN) {
+                result |= kPollIn;
+            }
+            if (fds[i].revents & POLLOUT) {
+                result |= kPollOut;
+            }
+        }
+        return result;
+    }
+
+    /// accept incoming connections, progress outgoing ones and the queue pair handshakes
+    void UpdatePeers() const
+    {
+        for (int listenFd : fListenFds) {
+            while (true) {
+                int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd < 0) {
+                    break;
+                }
+                if (fType == "pair" && !fPeers.empty()) {
+                    LOG(warn) << "Rejecting additional connection to pair socket " << fId;
+                    close(fd);
+                    continue;
+                }
+                AddPeer(fd, -1);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < fEndpoints.size(); ++i) {
+            Endpoint& endpoint = fEndpoints[i];
+            if (endpoint.fConnected) {
+                continue;
+            }
+            if (endpoint.fFd < 0) {
+                if (now < endpoint.fNextAttempt) {
+                    continue;
+                }
+                endpoint.fFd = socket(endpoint.fAddr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (endpoint.fFd < 0) {
+                    LOG(error) << "Failed connecting socket " << fId << ", address: " << endpoint.fAddress << ", reason: " << strerror(errno);
+                    endpoint.fNextAttempt = now + std::chrono::milliseconds(kReconnectInterval);
+                    continue;
+                }
+                if (connect(endpoint.fFd, reinterpret_cast<const sockaddr*>(&endpoint.fAddr), endpoint.fAddrLen) != 0 && errno != EINPROGRESS) {
+                    close(endpoint.fFd);
+                    endpoint.fFd = -1;
+                    endpoint.fNextAttempt = now + std::chrono::milliseconds(kReconnectInterval);
+                    continue;
+                }
+            }
+
+            pollfd pfd{endpoint.fFd, POLLOUT, 0};
+            if (poll(&pfd, 1, 0) <= 0) {
+                continue; // still in progress
+            }
+            int err = 0;
+            socklen_t errLen = sizeof(err);
+            if (getsockopt(endpoint.fFd, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0 || err != 0 || (fType == "pair" && !fPeers.empty())) {
+                close(endpoint.fFd);
+                endpoint.fFd = -1;
+                endpoint.fNextAttempt = now + std::chrono::milliseconds(kReconnectInterval);
+                continue;
+            }
+            fcntl(endpoint.fFd, F_SETFL, fcntl(endpoint.fFd, F_GETFL) & ~O_NONBLOCK);
+            endpoint.fConnected = true;
+            AddPeer(endpoint.fFd, static_cast<int>(i));
+        }
+
+        for (size_t i = fPeers.size(); i-- > 0;) {
+            if (!fPeers[i].fReady && !ProgressHandshake(fPeers[i])) {
+                ClosePeer(i);
+            }
+        }
+    }
+
+    /// create the queue pair for a new TCP connection and send its attributes to the other side
+    void AddPeer(int fd, int endpoint) const
+    {
+        ConfigureFd(fd);
+
+        Peer peer{fd, endpoint, nullptr, false, QpInfo{}, QpInfo{}, 0};
+        ibv_qp_init_attr initAttr{};
+        initAttr.send_cq = fCq;
+        initAttr.recv_cq = fCq;
+        initAttr.cap.max_send_wr = kMaxSendWr;
+        initAttr.cap.max_recv_wr = 1;
+        initAttr.cap.max_send_sge = 1;
+        initAttr.cap.max_recv_sge = 1;
+        initAttr.qp_type = IBV_QPT_RC;
+        peer.fQp = ibv_create_qp(fCtx.GetPd(), &initAttr);
+        if (!peer.fQp) {
+            LOG(error) << "Failed creating queue pair for a peer of socket " << fId << ", reason: " << strerror(errno);
+            DropConnection(fd, endpoint);
+            return;
+        }
+
+        ibv_qp_attr attr{};
+        attr.qp_state = IBV_QPS_INIT;
+        attr.pkey_index = 0;
+        attr.port_num = fCtx.GetPort();
+        attr.qp_access_flags = IBV_ACCESS_REMOTE_WRITE;
+        if (ibv_modify_qp(peer.fQp, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) != 0) {
+            LOG(error) << "Failed initializing queue pair for a peer of socket " << fId << ", reason: " << strerror(errno);
+            ibv_destroy_qp(peer.fQp);
+            DropConnection(fd, endpoint);
+            return;
+        }
+
+        static thread_local std::mt19937 gen(std::random_device{}());
+        peer.fLocal.fQpn = peer.fQp->qp_num;
+        peer.fLocal.fPsn = gen() & 0xffffff;
+        peer.fLocal.fLid = fCtx.GetPortAttr().lid;
+        peer.fLocal.fMagic = kMagic;
+        std::memcpy(peer.fLocal.fGid, fCtx.GetGid().raw, sizeof(peer.fLocal.fGid));
+        if (WriteAll(fd, &peer.fLocal, sizeof(peer.fLocal)) != 0) {
+            ibv_destroy_qp(peer.fQp);
+            DropConnection(fd, endpoint);
+            return;
+        }
+        fPeers.push_back(peer);
+    }
+
+    /// read (without blocking) the attributes of the remote queue pair and connect to it
+    /// @return false if the connection failed
+    bool ProgressHandshake(Peer& peer) const
+    {
+        ssize_t n = recv(peer.fFd, reinterpret_cast<char*>(&peer.fRemote) + peer.fRemoteReceived, sizeof(QpInfo) - peer.fRemoteReceived, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return false;
+        } else if (n < 0) {
+            return true;
+        }
+        peer.fRemoteReceived += n;
+        if (peer.fRemoteReceived < sizeof(QpInfo)) {
+            return true;
+        }
+        if (peer.fRemote.fMagic != kMagic) {
+            LOG(error) << "Received invalid queue pair attributes on socket " << fId;
+            return false;
+        }
+
+        ibv_qp_attr attr{};
+        attr.qp_state = IBV_QPS_RTR;
+        attr.path_mtu = fCtx.GetPortAttr().active_mtu;
+        attr.dest_qp_num = peer.fRemote.fQpn;
+        attr.rq_psn = peer.fRemote.fPsn;
+        attr.max_dest_rd_atomic = 1;
+        attr.min_rnr_timer = 12;
+        attr.ah_attr.dlid = peer.fRemote.fLid;
+        attr.ah_attr.port_num = fCtx.GetPort();
+        if (fCtx.GetGidIndex() >= 0) {
+            attr.ah_attr.is_global = 1;
+            std::memcpy(attr.ah_attr.grh.dgid.raw, peer.fRemote.fGid, sizeof(peer.fRemote.fGid));
+            attr.ah_attr.grh.sgid_index = fCtx.GetGidIndex();
+            attr.ah_attr.grh.hop_limit = 1;
+        }
+        if (ibv_modify_qp(peer.fQp, &attr, IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN | IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0) {
+            LOG(error) << "Failed connecting queue pair (RTR) of socket " << fId << ", reason: " << strerror(errno);
+            return false;
+        }
+
+        attr = ibv_qp_attr{};
+        attr.qp_state = IBV_QPS_RTS;
+        attr.timeout = 14;
+        attr.retry_cnt = 7;
+        attr.rnr_retry = 7;
+        attr.sq_psn = peer.fLocal.fPsn;
+        attr.max_rd_atomic = 1;
+        if (ibv_modify_qp(peer.fQp, &attr, IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+            LOG(error) << "Failed connecting queue pair (RTS) of socket " << fId << ", reason: " << strerror(errno);
+            return false;
+        }
+
+        peer.fReady = true;
+        return true;
+    }
+
+    void ClosePeer(size_t index) const
+    {
+        const Peer peer = fPeers.at(index);
+        if (peer.fQp) {
+            ibv_destroy_qp(peer.fQp);
+        }
+        fPeers.erase(fPeers.begin() + index);
+        DropConnection(peer.fFd, peer.fEndpoint);
+    }
+
+    void DropConnection(int fd, int endpointIndex) const
+    {
+        close(fd);
+        if (endpointIndex >= 0) {
+            Endpoint& endpoint = fEndpoints.at(endpointIndex);
+            endpoint.fFd = -1;
+            endpoint.fConnected = false;
+            endpoint.fNextAttempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(kReconnectInterval);
+        }
+    }
+
+    void ConfigureFd(int fd) const
+    {
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (fSndKernelSize > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &fSndKernelSize, sizeof(fSndKernelSize)) != 0) {
+            LOG(error) << "Failed setting SO_SNDBUF on socket " << fId << ", reason: " << strerror(errno);
+        }
+        if (fRcvKernelSize > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &fRcvKernelSize, sizeof(fRcvKernelSize)) != 0) {
+            LOG(error) << "Failed setting SO_RCVBUF on socket " << fId << ", reason: " << strerror(errno);
+        }
+    }
+
+    Context& fCtx;
+    std::string fId;
+    std::string fType;
+    ibv_cq* fCq;
+    TransferCounter fBytesTx;
+    TransferCounter fBytesRx;
+    TransferCounter fMessagesTx;
+    TransferCounter fMessagesRx;
+
+    int fTimeout;
+    int fLinger;
+    int fSndHwm;
+    int fRcvHwm;
+    int fSndKernelSize;
+    int fRcvKernelSize;
+
+    // connections are updated lazily, also from const getters
+    std::vector<int> fListenFds;
+    mutable std::vector<Endpoint> fEndpoints;
+    mutable std::vector<Peer> fPeers;
+    size_t fNextPeer;
+    int fMoreFd; // peer with the remaining parts of a partially received multipart message
+    std::vector<pollfd> fPollFds;
+
+    size_t fRdmaThreshold; // parts of at least this size are written with RDMA, 0: never
+    uint64_t fNextWrId;
+
+    // reused per send
+    std::vector<FrameHeader> fHeaders;
+    std::vector<iovec> fIovs;
+    std::vector<ibv_sge> fSges;
+    std::vector<ibv_send_wr> fWrs;
+};
+
+} // namespace fair::mq::rdma
+
+#endif /* FAIR_MQ_RDMA_SOCKET_H */
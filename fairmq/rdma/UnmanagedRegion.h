@@ -0,0 +1,226 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_RDMA_UNMANAGEDREGION_H
+#define FAIR_MQ_RDMA_UNMANAGEDREGION_H
+
+#include <fairmq/stream/Common.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/Transports.h>
+#include <fairmq/rdma/Context.h>
+#include <fairmq/UnmanagedRegion.h>
+
+#include <fairlogger/Logger.h>
+
+#include <infiniband/verbs.h>
+
+#include <cerrno>
+#include <cstddef> // size_t
+#include <cstdlib> // malloc
+#include <cstring> // strerror, memset
+#include <memory> // shared_ptr
+#include <mutex>
+#include <utility> // move
+#include <vector>
+
+#include <sys/mman.h> // mlock, mmap
+
+namespace fair::mq::rdma
+{
+
+// memory, memory registration and callbacks of a region, shared with the messages of the region,
+// so that the memory stays valid while messages are in flight (zero-copy send)
+struct RegionState
+{
+    RegionState(ibv_pd* pd, uint16_t id, size_t size, bool hugepages, RegionCallback callback, RegionBulkCallback bulkCallback)
+        : fId(id)
+        , fBuffer(nullptr)
+        , fSize(size)
+        , fMappedSize(0)
+        , fMr(nullptr)
+        , fActive(true)
+        , fBatchDepth(0)
+        , fCallback(std::move(callback))
+        , fBulkCallback(std::move(bulkCallback))
+    {
+        if (hugepages) {
+            constexpr size_t hugePageSize = 2 * 1024 * 1024;
+            fMappedSize = ((fSize + hugePageSize - 1) / hugePageSize) * hugePageSize;
+            fBuffer = mmap(nullptr, fMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (fBuffer == MAP_FAILED) {
+                int err = errno;
+                fBuffer = nullptr;
+                LOG(error) << "Could not allocate huge page backed region " << fId << " of " << fMappedSize << " bytes. Code: " << err << ", reason: " << strerror(err);
+                throw TransportError(tools::ToString("Could not allocate huge page backed region ", fId, ": ", strerror(err)));
+            }
+        } else {
+            fBuffer = malloc(size);
+            if (!fBuffer) {
+                throw TransportError(tools::ToString("Could not allocate region ", fId, " of ", size, " bytes"));
+            }
+        }
+
+        // the whole region is registered once, region messages are written to the peers without further registration
+        fMr = ibv_reg_mr(pd, fBuffer, fSize, IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ);
+        if (!fMr) {
+            int err = errno;
+            Free();
+            LOG(error) << "Could not register region " << fId << " of " << fSize << " bytes with the RDMA device. Code: " << err << ", reason: " << strerror(err);
+            throw TransportError(tools::ToString("Could not register region ", fId, " with the RDMA device: ", strerror(err)));
+        }
+    }
+
+    RegionState(const RegionState&) = delete;
+    RegionState(RegionState&&) = delete;
+    RegionState& operator=(const RegionState&) = delete;
+    RegionState& operator=(RegionState&&) = delete;
+
+    // called when the transport no longer needs a block of the region
+    void Release(void* data, size_t size, void* hint)
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        if (!fActive) {
+            return;
+        }
+        if (fBatchDepth > 0) {
+            fPending.emplace_back(data, size, hint);
+        } else if (fBulkCallback) {
+            fBulkCallback({{data, size, hint}});
+        } else if (fCallback) {
+            fCallback(data, size, hint);
+        }
+    }
+
+    // blocks released between BeginBatch() and EndBatch() (e.g. all parts of a sent multipart message)
+    // are acknowledged with a single bulk callback
+    void BeginBatch()
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        ++fBatchDepth;
+    }
+
+    void EndBatch()
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        if (--fBatchDepth > 0 || fPending.empty()) {
+            return;
+        }
+        if (fActive) {
+            if (fBulkCallback) {
+                fBulkCallback(fPending);
+            } else if (fCallback) {
+                for (const auto& b : fPending) {
+                    fCallback(b.ptr, b.size, b.hint);
+                }
+            }
+        }
+        fPending.clear();
+    }
+
+    // no callbacks after the region object is destroyed
+    void Deactivate()
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fActive = false;
+    }
+
+    ~RegionState()
+    {
+        ibv_dereg_mr(fMr);
+        Free();
+    }
+
+    const uint16_t fId;
+    void* fBuffer;
+    const size_t fSize;
+    size_t fMappedSize; // non-zero if the buffer is a huge page mapping
+    ibv_mr* fMr;
+
+  private:
+    void Free()
+    {
+        if (fMappedSize > 0) {
+            munmap(fBuffer, fMappedSize);
+        } else {
+            free(fBuffer);
+        }
+    }
+
+    std::mutex fMtx;
+    bool fActive;
+    int fBatchDepth;
+    std::vector<RegionBlock> fPending;
+    RegionCallback fCallback;
+    RegionBulkCallback fBulkCallback;
+};
+
+class Socket;
+
+class UnmanagedRegion final : public fair::mq::UnmanagedRegion
+{
+    friend class stream::Message<Socket, UnmanagedRegion, Transport::RDMA>;
+    friend class Socket;
+
+  public:
+    UnmanagedRegion(Context& ctx,
+                    size_t size,
+                    int64_t userFlags,
+                    RegionCallback callback,
+                    RegionBulkCallback bulkCallback,
+                    fair::mq::TransportFactory* factory,
+                    fair::mq::RegionConfig cfg)
+        : fair::mq::UnmanagedRegion(factory)
+        , fCtx(ctx)
+        , fState(std::make_shared<RegionState>(fCtx.GetPd(), fCtx.NextRegionId(), size, cfg.hugepages, std::move(callback), std::move(bulkCallback)))
+        , fUserFlags(userFlags)
+    {
+        if (cfg.lock) {
+            LOG(debug) << "Locking region " << GetId() << "...";
+            if (mlock(fState->fBuffer, fState->fSize) == -1) {
+                LOG(error) << "Could not lock region " << GetId() << ". Code: " << errno << ", reason: " << strerror(errno);
+            }
+            LOG(debug) << "Successfully locked region " << GetId() << ".";
+        }
+        if (cfg.zero) {
+            LOG(debug) << "Zeroing free memory of region " << GetId() << "...";
+            memset(fState->fBuffer, 0x00, fState->fSize);
+            LOG(debug) << "Successfully zeroed free memory of region " << GetId() << ".";
+        }
+        fCtx.AddRegion(GetId(), GetData(), GetSize(), fUserFlags);
+    }
+
+    UnmanagedRegion(const UnmanagedRegion&) = delete;
+    UnmanagedRegion(UnmanagedRegion&&) = delete;
+    UnmanagedRegion& operator=(const UnmanagedRegion&) = delete;
+    UnmanagedRegion& operator=(UnmanagedRegion&&) = delete;
+
+    void* GetData() const override { return fState->fBuffer; }
+    size_t GetSize() const override { return fState->fSize; }
+    uint16_t GetId() const override { return fState->fId; }
+    int64_t GetUserFlags() const { return fUserFlags; }
+    void SetLinger(uint32_t /* linger */) override { LOG(debug) << "rdma UnmanagedRegion linger option not implemented. Acknowledgements are local."; }
+    uint32_t GetLinger() const override { LOG(debug) << "rdma UnmanagedRegion linger option not implemented. Acknowledgements are local."; return 0; }
+
+    Transport GetType() const override { return Transport::RDMA; }
+
+    ~UnmanagedRegion() override
+    {
+        LOG(debug) << "destroying region " << GetId();
+        fState->Deactivate();
+        fCtx.RemoveRegion(GetId());
+    }
+
+  private:
+    Context& fCtx;
+    std::shared_ptr<RegionState> fState;
+    int64_t fUserFlags;
+};
+
+} // namespace fair::mq::rdma
+
+#endif /* FAIR_MQ_RDMA_UNMANAGEDREGION_H */
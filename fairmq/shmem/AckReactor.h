@@ -0,0 +1,170 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_ACKREACTOR_H_
+#define FAIR_MQ_SHMEM_ACKREACTOR_H_
+
+#include <fairmq/shmem/Common.h>
+#include <fairmq/tools/Futex.h>
+#include <fairmq/tools/Threads.h>
+
+#include <fairlogger/Logger.h>
+
+#include <algorithm> // remove_if
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring> // strerror
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility> // move
+#include <vector>
+
+namespace fair::mq::shmem
+{
+
+// --shm-ack-reactor: one thread of the transport that runs the ack senders and receivers of all its unmanaged regions,
+// instead of two threads per region. Tasks are polled without blocking, in rounds. A round in which no task made
+// progress is followed by a sleep until a task is notified or the poll interval expired, which bounds the extra latency
+// of acks that are not notified (max delay, stops, acks of other processes).
+class AckReactor
+{
+  public:
+    // polled on the reactor thread, returns true if it made progress, sets done once it has finished
+    using Task = std::function<bool(bool& done)>;
+
+    AckReactor(std::chrono::microseconds interval, int threadNumaNode, const tools::ThreadSettings& threadSettings)
+        : fInterval(interval)
+        , fThreadNumaNode(threadNumaNode)
+        , fThreadSettings(threadSettings)
+        , fWaiter(0)
+        , fSignaled(false)
+        , fChanged(false)
+        , fStop(false)
+        , fNextId(1)
+    {
+        fThread = std::thread(&AckReactor::Run, this);
+    }
+
+    AckReactor(const AckReactor&) = delete;
+    AckReactor& operator=(const AckReactor&) = delete;
+
+    // @return id of the task, for WaitDone()
+    uint64_t Add(Task task)
+    {
+        uint64_t id = 0;
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            id = fNextId++;
+            fAdded.emplace_back(id, std::move(task));
+            fChanged = true;
+        }
+        Notify();
+        return id;
+    }
+
+    // blocks until the task has finished (it has to be told to by its owner)
+    void WaitDone(uint64_t id)
+    {
+        Notify();
+        std::unique_lock<std::mutex> lock(fMtx);
+        fDoneCV.wait(lock, [&]() { return fDone.count(id) > 0; });
+        fDone.erase(id);
+    }
+
+    // wakes the reactor up for a round
+    void Notify()
+    {
+        fSignaled.store(true, std::memory_order_release);
+        fWaiter.Notify();
+    }
+
+    ~AckReactor()
+    {
+        fStop = true;
+        Notify();
+        fThread.join();
+    }
+
+  private:
+    void Run()
+    {
+        if (fThreadNumaNode >= 0 && !SetThreadNumaAffinity(fThreadNumaNode)) {
+            LOG(warn) << "Could not pin the region ack reactor to NUMA node " << fThreadNumaNode << ": " << strerror(errno);
+        }
+        if (!fThreadSettings.Empty() && !tools::ApplyThreadSettings(fThreadSettings)) {
+            LOG(warn) << "Could not apply the CPU affinity/scheduling settings to the region ack reactor: " << strerror(errno);
+        }
+
+        std::vector<std::pair<uint64_t, Task>> tasks;
+        while (true) {
+            if (fChanged.load(std::memory_order_acquire)) {
+                std::lock_guard<std::mutex> lock(fMtx);
+                for (auto& task : fAdded) {
+                    tasks.push_back(std::move(task));
+                }
+                fAdded.clear();
+                fChanged = false;
+            }
+            if (fStop && tasks.empty()) {
+                break;
+            }
+
+            bool progress = false;
+            bool finished = false;
+            for (auto& [id, task] : tasks) {
+                bool done = false;
+                progress |= task(done);
+                if (done) {
+                    task = nullptr;
+                    finished = true;
+                }
+            }
+            if (finished) {
+                std::lock_guard<std::mutex> lock(fMtx);
+                tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [this](auto& t) {
+                    if (!t.second) {
+                        fDone.insert(t.first);
+                        return true;
+                    }
+                    return false;
+                }), tasks.end());
+                fDoneCV.notify_all();
+            }
+
+            if (!progress) {
+                fWaiter.Wait([this]() { return fSignaled.exchange(false, std::memory_order_acq_rel); }, fInterval);
+            }
+        }
+        LOG(trace) << "Region ack reactor leaving.";
+    }
+
+    const std::chrono::microseconds fInterval;
+    const int fThreadNumaNode;
+    const tools::ThreadSettings fThreadSettings;
+    tools::SpinParkWaiter fWaiter;
+    std::atomic<bool> fSignaled;
+    std::atomic<bool> fChanged; // fAdded is not empty
+    std::atomic<bool> fStop;
+
+    std::mutex fMtx;
+    std::condition_variable fDoneCV;
+    std::vector<std::pair<uint64_t, Task>> fAdded;
+    std::set<uint64_t> fDone; // finished, until collected by WaitDone()
+    uint64_t fNextId;
+
+    std::thread fThread;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_ACKREACTOR_H_ */
@@ -0,0 +1,156 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_ALLOCTRACE_H
+#define FAIR_MQ_SHMEM_ALLOCTRACE_H
+
+#include <fairmq/tools/Strings.h>
+#include <fairmq/Transports.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio> // FILE
+#include <cstring> // memcmp
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fair::mq::shmem
+{
+
+/// One event of an allocation trace (--shm-alloc-trace), written in the native byte order
+struct AllocTraceRecord
+{
+    enum Op : uint8_t
+    {
+        alloc,   ///< chunk allocated
+        dealloc, ///< chunk returned to the segment (or the allocation cache)
+        failure  ///< allocation ended with MessageBadAlloc
+    };
+
+    uint64_t fTimeNs;     ///< steady clock, comparable between the processes of a host
+    uint64_t fKey;        ///< ChunkOwnerTable::Key of the chunk, pairs the alloc and dealloc records (0 for failures)
+    uint64_t fSize;       ///< bytes requested from the segment allocator (including the header)
+    uint64_t fLifetimeNs; ///< dealloc: time since the alloc record, 0 if the chunk was allocated by another process
+    uint32_t fAlignment;  ///< alignment passed to the allocator, 0 for the default one
+    uint8_t fOp;
+    uint8_t fPad[3];
+};
+
+static_assert(sizeof(AllocTraceRecord) == 40, "AllocTraceRecord is part of the trace file format");
+
+/// the trace file starts with these 8 bytes, followed by the records
+constexpr char kAllocTraceMagic[8] = {'F', 'M', 'Q', 'A', 'T', 'R', '0', '1'};
+
+/// Buffers the trace records of a process and appends them to its trace file in blocks. The allocation times of the
+/// chunks of the process are kept to record their lifetime. Thread-safe, the lock is held for a push_back (and a
+/// write of the buffer every kBufferedRecords records).
+class AllocTraceWriter
+{
+  public:
+    AllocTraceWriter(const std::string& filename)
+        : fFile(std::fopen(filename.c_str(), "wb"))
+    {
+        if (!fFile) {
+            throw TransportError(tools::ToString("shmem: could not open allocation trace file '", filename, "'"));
+        }
+        std::fwrite(kAllocTraceMagic, sizeof(kAllocTraceMagic), 1, fFile);
+        fBuffer.reserve(kBufferedRecords);
+    }
+
+    AllocTraceWriter(const AllocTraceWriter&) = delete;
+    AllocTraceWriter& operator=(const AllocTraceWriter&) = delete;
+
+    void Alloc(uint64_t key, size_t size, size_t alignment)
+    {
+        const uint64_t now = Now();
+        std::lock_guard<std::mutex> lock(fMtx);
+        fAllocTimes[key] = now;
+        Add(AllocTraceRecord{now, key, size, 0, static_cast<uint32_t>(alignment), AllocTraceRecord::alloc, {}});
+    }
+
+    void Dealloc(uint64_t key, size_t size)
+    {
+        const uint64_t now = Now();
+        std::lock_guard<std::mutex> lock(fMtx);
+        uint64_t lifetime = 0;
+        auto it = fAllocTimes.find(key);
+        if (it != fAllocTimes.end()) {
+            lifetime = now - it->second;
+            fAllocTimes.erase(it);
+        }
+        Add(AllocTraceRecord{now, key, size, lifetime, 0, AllocTraceRecord::dealloc, {}});
+    }
+
+    void Failure(size_t size)
+    {
+        const uint64_t now = Now();
+        std::lock_guard<std::mutex> lock(fMtx);
+        Add(AllocTraceRecord{now, 0, size, 0, 0, AllocTraceRecord::failure, {}});
+    }
+
+    ~AllocTraceWriter()
+    {
+        Flush();
+        std::fclose(fFile);
+    }
+
+  private:
+    static constexpr size_t kBufferedRecords = 4096;
+
+    static uint64_t Now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+    void Add(const AllocTraceRecord& record)
+    {
+        fBuffer.push_back(record);
+        if (fBuffer.size() == kBufferedRecords) {
+            Flush();
+        }
+    }
+
+    void Flush()
+    {
+        if (!fBuffer.empty()) {
+            std::fwrite(fBuffer.data(), sizeof(AllocTraceRecord), fBuffer.size(), fFile);
+            fBuffer.clear();
+        }
+    }
+
+    std::FILE* fFile;
+    std::mutex fMtx;
+    std::vector<AllocTraceRecord> fBuffer;
+    std::unordered_map<uint64_t, uint64_t> fAllocTimes;
+};
+
+/// reads all records of a trace file, throws TransportError if it is not one
+inline std::vector<AllocTraceRecord> ReadAllocTrace(const std::string& filename)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        throw TransportError(tools::ToString("shmem: could not open allocation trace file '", filename, "'"));
+    }
+    char magic[sizeof(kAllocTraceMagic)] = {};
+    std::vector<AllocTraceRecord> records;
+    bool valid = std::fread(magic, sizeof(magic), 1, file) == 1 && std::memcmp(magic, kAllocTraceMagic, sizeof(magic)) == 0;
+    if (valid) {
+        AllocTraceRecord record;
+        while (std::fread(&record, sizeof(record), 1, file) == 1) {
+            records.push_back(record);
+        }
+    }
+    std::fclose(file);
+    if (!valid) {
+        throw TransportError(tools::ToString("shmem: '", filename, "' is not an allocation trace"));
+    }
+    return records;
+}
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_ALLOCTRACE_H */
@@ -0,0 +1,116 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef FAIR_MQ_SHMEM_BUFFERARENA_H_
+#define FAIR_MQ_SHMEM_BUFFERARENA_H_
+
+#include "Common.h"
+#include "Manager.h"
+#include "Message.h"
+#include <fairmq/BufferArena.h>
+#include <fairmq/TransportFactory.h>
+
+#include <algorithm> // max
+#include <atomic>
+#include <cstddef> // size_t, max_align_t
+#include <cstdint>
+#include <memory>
+
+namespace fair::mq::shmem
+{
+
+// Arena in one chunk of the managed segment. Message chunks are bump allocated from it (a CAS on the offset), each one
+// with its own header or ref count table entry, so that receivers treat them like any other chunk. The arena chunk holds
+// one reference for the arena itself and one per message chunk, see Manager::ConstructArenaChunk/ReleaseArenaChunk.
+class BufferArena final : public fair::mq::BufferArena
+{
+  public:
+    // references of the arena chunk are 16 bit, like all ref counts
+    static constexpr uint16_t kMaxReferences = 0xfff0;
+
+    BufferArena(Manager& manager, size_t size, fair::mq::TransportFactory* factory)
+        : fManager(manager)
+        , fFactory(factory)
+        , fSegmentId(manager.GetSegmentId())
+        , fChunk(fManager.Allocate(size, 0, &fSegmentId))
+        , fBegin(fManager.UserPtr(fChunk, fSegmentId))
+        , fSize(size)
+        , fRefCountTable(fManager.HasRefCountTable(fSegmentId))
+        , fOffset(0)
+        , fNumFallbacks(0)
+    {
+        fManager.Own(fSegmentId, fManager.GetHandleFromAddress(fChunk, fSegmentId));
+    }
+
+    BufferArena(const BufferArena&) = delete;
+    BufferArena(BufferArena&&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+    BufferArena& operator=(BufferArena&&) = delete;
+
+    MessagePtr NewMessage(size_t size, Alignment alignment = Alignment{0}) override
+    {
+        const size_t align = std::max(alignment.alignment, alignof(std::max_align_t));
+        char* ptr = nullptr;
+        size_t offset = fOffset.load(std::memory_order_relaxed);
+        size_t end = 0;
+        do {
+            // [distance to the arena chunk][chunk header][user buffer] (or [distance][user buffer] with a ref count table)
+            const size_t chunk = fRefCountTable ? AlignUp(offset + sizeof(uint64_t), std::max(align, RefCountTable::kChunkSize))
+                                                : AlignUp(offset + sizeof(uint64_t), alignof(uint64_t));
+            end = chunk + (fRefCountTable ? RefCountTable::FullSize(size) : ShmHeader::FullSize(size, align));
+            if (end > fSize) {
+                return Fallback(size, alignment);
+            }
+            ptr = fBegin + chunk;
+        } while (!fOffset.compare_exchange_weak(offset, end, std::memory_order_relaxed));
+
+        if (fManager.AddRefCount(fChunk, fSegmentId, 1) >= kMaxReferences) {
+            fManager.DecrementRefCount(fChunk, fSegmentId);
+            return Fallback(size, alignment);
+        }
+        fManager.ConstructArenaChunk(fChunk, ptr, size, align, fSegmentId);
+
+        MetaHeader meta{size, 0, fManager.GetHandleFromAddress(ptr, fSegmentId), -1, 0, fSegmentId, true, 0, 0};
+        return std::make_unique<Message>(fManager, meta, fFactory);
+    }
+
+    size_t GetSize() const override { return fSize; }
+    size_t GetUsedSize() const override { return std::min(fOffset.load(std::memory_order_relaxed), fSize); }
+    uint64_t GetNumFallbacks() const override { return fNumFallbacks.load(std::memory_order_relaxed); }
+
+    ~BufferArena() override
+    {
+        // the messages of the arena keep the chunk alive
+        fManager.Disown(fSegmentId, fManager.GetHandleFromAddress(fChunk, fSegmentId));
+        if (fManager.DecrementRefCount(fChunk, fSegmentId) == 1) {
+            fManager.Deallocate(fManager.GetHandleFromAddress(fChunk, fSegmentId), fSegmentId);
+        }
+    }
+
+  private:
+    static size_t AlignUp(size_t offset, size_t alignment) { return (offset + alignment - 1) / alignment * alignment; }
+
+    MessagePtr Fallback(size_t size, Alignment alignment)
+    {
+        fNumFallbacks.fetch_add(1, std::memory_order_relaxed);
+        return std::make_unique<Message>(fManager, size, alignment, fFactory);
+    }
+
+    Manager& fManager;
+    fair::mq::TransportFactory* fFactory;
+    uint16_t fSegmentId;
+    char* fChunk;
+    char* fBegin;
+    const size_t fSize;
+    const bool fRefCountTable;
+    std::atomic<size_t> fOffset;
+    std::atomic<uint64_t> fNumFallbacks;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_BUFFERARENA_H_ */
@@ -0,0 +1,190 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_CHUNKLEDGER_H_
+#define FAIR_MQ_SHMEM_CHUNKLEDGER_H_
+
+#include <fairmq/shmem/Common.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/Transports.h>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace fair::mq::shmem
+{
+
+// References to managed segment chunks held by one process (--shm-reclaim), in a shared memory object of the process
+// (see LedgerTable), so that another process of the session can release them when the process dies (Manager::Reclaim).
+// Entries (chunk key, number of references) are kept in an open addressing table with linear probing, split into shards
+// with a process local mutex each. Only the owning process writes the ledger, only reclaimers of a dead owner read it.
+// A reference is added after it has been acquired and removed before it is released or handed over to a socket, and
+// every step of a table update leaves at most the count of the entry before it: the ledger never counts more references
+// than the process holds, a process killed in the middle of an update leaks a reference instead of releasing one twice.
+class ChunkLedger
+{
+  public:
+    static constexpr size_t kNumShards = 16;
+    static constexpr size_t kMinSlots = 1024;
+
+    ChunkLedger(const std::string& name, size_t numSlots, bool create)
+    {
+        using namespace boost::interprocess;
+        if (create) {
+            size_t slots = kMinSlots;
+            while (slots < numSlots) {
+                slots <<= 1;
+            }
+            shared_memory_object::remove(name.c_str()); // a ledger left behind is not reclaimed any more
+            fObject = shared_memory_object(create_only, name.c_str(), read_write);
+            fObject.truncate(static_cast<offset_t>(sizeof(Header) + slots * sizeof(Entry)));
+            fRegion = mapped_region(fObject, read_write);
+            fHeader = new (fRegion.get_address()) Header{slots};
+        } else {
+            fObject = shared_memory_object(open_only, name.c_str(), read_write);
+            fRegion = mapped_region(fObject, read_write);
+            fHeader = static_cast<Header*>(fRegion.get_address());
+            if (fRegion.get_size() < sizeof(Header) + fHeader->fNumSlots * sizeof(Entry)) {
+                throw TransportError(tools::ToString("Chunk ledger ", name, " is too small for ", fHeader->fNumSlots, " entries"));
+            }
+        }
+        fEntries = reinterpret_cast<Entry*>(fHeader + 1);
+        fShardSize = fHeader->fNumSlots / kNumShards;
+    }
+
+    ChunkLedger(const ChunkLedger&) = delete;
+    ChunkLedger(ChunkLedger&&) = delete;
+    ChunkLedger& operator=(const ChunkLedger&) = delete;
+    ChunkLedger& operator=(ChunkLedger&&) = delete;
+
+    // same keys as the owner tags
+    static uint64_t Key(uint16_t segmentId, int64_t handle) { return ChunkOwnerTable::Key(segmentId, handle); }
+    static uint16_t SegmentId(uint64_t key) { return static_cast<uint16_t>((key - 1) >> 48); }
+    static int64_t Handle(uint64_t key) { return static_cast<int64_t>((key - 1) & 0xffffffffffffULL); }
+
+    void Add(uint64_t key)
+    {
+        const uint64_t hash = Hash(key);
+        Shard& shard = fShards[hash >> 60];
+        std::lock_guard<std::mutex> lock(shard.fMtx);
+        Entry* entries = fEntries + (hash >> 60) * fShardSize;
+        const size_t mask = fShardSize - 1;
+        for (size_t i = (hash >> 20) & mask;; i = (i + 1) & mask) {
+            const uint64_t k = entries[i].fKey.load(std::memory_order_relaxed);
+            if (k == key) {
+                entries[i].fCount.store(entries[i].fCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                return;
+            }
+            if (k == 0) {
+                // keep a free probe position per shard, entries beyond 7/8 of the shard are not recorded
+                if (shard.fNumEntries >= fShardSize - fShardSize / 8) {
+                    fHeader->fNumUntracked.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                entries[i].fCount.store(1, std::memory_order_relaxed);
+                entries[i].fKey.store(key, std::memory_order_release);
+                ++shard.fNumEntries;
+                return;
+            }
+        }
+    }
+
+    // a key that is not recorded (not tracked, or acquired before the ledger existed) is ignored
+    void Remove(uint64_t key)
+    {
+        const uint64_t hash = Hash(key);
+        Shard& shard = fShards[hash >> 60];
+        std::lock_guard<std::mutex> lock(shard.fMtx);
+        Entry* entries = fEntries + (hash >> 60) * fShardSize;
+        const size_t mask = fShardSize - 1;
+        size_t hole = (hash >> 20) & mask;
+        while (entries[hole].fKey.load(std::memory_order_relaxed) != key) {
+            if (entries[hole].fKey.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            hole = (hole + 1) & mask;
+        }
+        const uint32_t count = entries[hole].fCount.load(std::memory_order_relaxed);
+        entries[hole].fCount.store(count > 0 ? count - 1 : 0, std::memory_order_release);
+        if (count > 1) {
+            return;
+        }
+
+        // backward shift deletion: the moved entry is cleared before it is written to the hole
+        for (size_t j = (hole + 1) & mask;; j = (j + 1) & mask) {
+            const uint64_t k = entries[j].fKey.load(std::memory_order_relaxed);
+            if (k == 0) {
+                break;
+            }
+            const size_t home = (Hash(k) >> 20) & mask;
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                const uint32_t moved = entries[j].fCount.load(std::memory_order_relaxed);
+                entries[j].fCount.store(0, std::memory_order_release);
+                entries[hole].fKey.store(k, std::memory_order_release);
+                entries[hole].fCount.store(moved, std::memory_order_release);
+                hole = j;
+            }
+        }
+        entries[hole].fKey.store(0, std::memory_order_release);
+        --shard.fNumEntries;
+    }
+
+    // calls f(key, count) for the recorded references, for reclaimers of a dead owner
+    template<typename F>
+    void ForEach(F&& f) const
+    {
+        for (size_t i = 0; i < fHeader->fNumSlots; ++i) {
+            const uint64_t key = fEntries[i].fKey.load(std::memory_order_acquire);
+            const uint32_t count = fEntries[i].fCount.load(std::memory_order_acquire);
+            if (key != 0 && count > 0) {
+                f(key, count);
+            }
+        }
+    }
+
+    uint64_t GetNumUntracked() const { return fHeader->fNumUntracked.load(std::memory_order_relaxed); }
+
+  private:
+    struct Header
+    {
+        explicit Header(uint64_t numSlots) : fNumSlots(numSlots) {}
+        uint64_t fNumSlots;
+        std::atomic<uint64_t> fNumUntracked{0}; // references that found no free entry
+    };
+
+    struct Entry
+    {
+        std::atomic<uint64_t> fKey; // 0 for a free entry (a new object is zero-filled)
+        std::atomic<uint32_t> fCount;
+    };
+
+    struct Shard
+    {
+        std::mutex fMtx;
+        size_t fNumEntries = 0;
+    };
+
+    static uint64_t Hash(uint64_t key) { return key * 0x9e3779b97f4a7c15ULL; }
+
+    boost::interprocess::shared_memory_object fObject;
+    boost::interprocess::mapped_region fRegion;
+    Header* fHeader = nullptr;
+    Entry* fEntries = nullptr;
+    size_t fShardSize = 0;
+    std::array<Shard, kNumShards> fShards;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_CHUNKLEDGER_H_ */
@@ -0,0 +1,221 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_COMMANDBOARD_H_
+#define FAIR_MQ_SHMEM_COMMANDBOARD_H_
+
+#include <fairmq/shmem/Common.h>
+#include <fairmq/States.h>
+
+#include <boost/interprocess/managed_shared_memory.hpp>
+
+#include <algorithm> // max
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits> // INT_MAX
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <signal.h> // kill
+#include <sys/types.h> // pid_t
+
+namespace fair::mq::shmem
+{
+
+// node-wide state control (--control board): the devices of a session wait on the command word (futex) and report the
+// outcome of each command in their slot, the controller waits on the ack counter (futex)
+struct CommandBoardData
+{
+    static constexpr size_t kNumSlots = 1024;
+
+    struct Slot
+    {
+        std::atomic<pid_t> fPid;
+        std::atomic<uint32_t> fAck;      // last command word processed by the device, written after fState/fAccepted
+        std::atomic<int32_t> fState;     // state of the device after the command
+        std::atomic<uint32_t> fAccepted; // the transition was accepted by the state machine
+    };
+
+    std::atomic<uint32_t> fCommand;      // (sequence << 8) | transition, sequence 0 is never posted
+    std::atomic<uint32_t> fAcks;         // incremented on every ack
+    std::atomic<uint32_t> fNumSlots;     // high-water mark of the claimed slots
+    std::array<Slot, kNumSlots> fSlots;
+};
+
+/// Access to the command board of a session, in the management segment of its shmem id (opened or created).
+/// Devices Join() the board and Acknowledge() the commands they see, a controller Post()s transitions and waits for the
+/// acknowledgements of all devices with WaitForAcks(). Only the latest command is kept: devices busy with a long
+/// transition skip the commands posted in the meantime, so a controller should wait for the acks before the next Post().
+class CommandBoard
+{
+  public:
+    struct DeviceAck
+    {
+        pid_t pid;
+        bool acknowledged; ///< the device processed the command
+        bool accepted;     ///< the state machine accepted the transition (false also for devices that joined after it)
+        State state;       ///< state of the device after the command
+    };
+
+    explicit CommandBoard(const std::string& shmId, size_t managementSegmentSize = kManagementSegmentSize)
+        : fSegment(boost::interprocess::open_or_create, std::string("fmq_" + shmId + "_mng").c_str(), managementSegmentSize)
+        , fBoard(fSegment.find_or_construct<CommandBoardData>(boost::interprocess::unique_instance)())
+    {}
+
+    CommandBoard(const CommandBoard&) = delete;
+    CommandBoard(CommandBoard&&) = delete;
+    CommandBoard& operator=(const CommandBoard&) = delete;
+    CommandBoard& operator=(CommandBoard&&) = delete;
+
+    ~CommandBoard() { Leave(); }
+
+    static Transition GetTransition(uint32_t command) { return static_cast<Transition>(command & 0xff); }
+    static uint32_t GetSequence(uint32_t command) { return command >> 8; }
+
+    uint32_t Command() const { return fBoard->fCommand.load(std::memory_order_acquire); }
+
+    /// Claim a slot for the calling device. The current command counts as seen (not applied).
+    /// @return false if all slots are taken
+    bool Join(pid_t pid, State state)
+    {
+        for (size_t i = 0; i < CommandBoardData::kNumSlots; ++i) {
+            pid_t expected = 0;
+            auto& slot = fBoard->fSlots[i];
+            if (slot.fPid.load(std::memory_order_relaxed) == 0 && slot.fPid.compare_exchange_strong(expected, pid)) {
+                fSlot = static_cast<int>(i);
+                uint32_t numSlots = fBoard->fNumSlots.load();
+                while (numSlots < i + 1 && !fBoard->fNumSlots.compare_exchange_weak(numSlots, static_cast<uint32_t>(i + 1))) {}
+                Acknowledge(Command(), false, state);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Leave()
+    {
+        if (fSlot >= 0) {
+            fBoard->fSlots[fSlot].fPid.store(0);
+            fSlot = -1;
+            // a controller waiting for this device does not have to wait for the timeout
+            fBoard->fAcks.fetch_add(1);
+            FutexWake(fBoard->fAcks, INT_MAX);
+        }
+    }
+
+    /// Block while the command word equals seen, for at most timeoutMs
+    /// @return the command word
+    uint32_t WaitForCommand(uint32_t seen, int timeoutMs)
+    {
+        FutexWait(fBoard->fCommand, seen, timeoutMs);
+        return Command();
+    }
+
+    void Acknowledge(uint32_t command, bool accepted, State state)
+    {
+        auto& slot = fBoard->fSlots[fSlot];
+        slot.fState.store(static_cast<int32_t>(state), std::memory_order_relaxed);
+        slot.fAccepted.store(accepted ? 1 : 0, std::memory_order_relaxed);
+        slot.fAck.store(command, std::memory_order_release);
+        fBoard->fAcks.fetch_add(1, std::memory_order_release);
+        FutexWake(fBoard->fAcks, INT_MAX);
+    }
+
+    /// Post a transition to all devices of the board and wake them up
+    /// @return the command word, to wait for with WaitForAcks()
+    uint32_t Post(Transition transition)
+    {
+        uint32_t current = fBoard->fCommand.load();
+        uint32_t command = 0;
+        do {
+            uint32_t seq = (GetSequence(current) + 1) & 0xffffff;
+            command = (std::max(seq, 1u) << 8) | (static_cast<uint32_t>(transition) & 0xff);
+        } while (!fBoard->fCommand.compare_exchange_weak(current, command));
+        FutexWake(fBoard->fCommand, INT_MAX);
+        return command;
+    }
+
+    /// Wait until all devices of the board processed the command. Slots of processes that are gone are released.
+    /// @return false on timeout
+    bool WaitForAcks(uint32_t command, std::chrono::milliseconds timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            uint32_t acks = fBoard->fAcks.load(std::memory_order_acquire);
+            if (NumPending(command) == 0) {
+                return true;
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                return false;
+            }
+            // bounded wait, to notice processes that died without acknowledging
+            FutexWait(fBoard->fAcks, acks, static_cast<int>(std::min<long>(remaining, 100)));
+        }
+    }
+
+    /// @return the state of the acknowledgements of the command, one per device of the board
+    std::vector<DeviceAck> GetAcks(uint32_t command) const
+    {
+        std::vector<DeviceAck> acks;
+        const uint32_t numSlots = fBoard->fNumSlots.load();
+        for (uint32_t i = 0; i < numSlots; ++i) {
+            const auto& slot = fBoard->fSlots[i];
+            pid_t pid = slot.fPid.load();
+            if (pid != 0) {
+                bool acknowledged = slot.fAck.load(std::memory_order_acquire) == command;
+                acks.push_back(DeviceAck{pid,
+                                         acknowledged,
+                                         acknowledged && slot.fAccepted.load(std::memory_order_relaxed) != 0,
+                                         static_cast<State>(slot.fState.load(std::memory_order_relaxed))});
+            }
+        }
+        return acks;
+    }
+
+    size_t NumDevices() const
+    {
+        size_t n = 0;
+        const uint32_t numSlots = fBoard->fNumSlots.load();
+        for (uint32_t i = 0; i < numSlots; ++i) {
+            n += fBoard->fSlots[i].fPid.load(std::memory_order_relaxed) != 0 ? 1 : 0;
+        }
+        return n;
+    }
+
+  private:
+    size_t NumPending(uint32_t command)
+    {
+        size_t pending = 0;
+        const uint32_t numSlots = fBoard->fNumSlots.load();
+        for (uint32_t i = 0; i < numSlots; ++i) {
+            auto& slot = fBoard->fSlots[i];
+            pid_t pid = slot.fPid.load(std::memory_order_relaxed);
+            if (pid == 0 || slot.fAck.load(std::memory_order_acquire) == command) {
+                continue;
+            }
+            if (kill(pid, 0) == -1 && errno == ESRCH) {
+                slot.fPid.compare_exchange_strong(pid, 0);
+                continue;
+            }
+            ++pending;
+        }
+        return pending;
+    }
+
+    boost::interprocess::managed_shared_memory fSegment;
+    CommandBoardData* fBoard;
+    int fSlot = -1;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_COMMANDBOARD_H_ */
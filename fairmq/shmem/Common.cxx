@@ -11,14 +11,88 @@
 #include <picosha2.h>
 
 #include <unistd.h>
+#ifdef __linux__
+#include <fcntl.h> // fcntl
+#include <pthread.h> // pthread_setaffinity_np
+#include <sched.h> // cpu_set_t
+#include <linux/futex.h> // FUTEX_WAIT, FUTEX_WAKE
+#include <sys/mman.h> // madvise
+#include <sys/syscall.h> // SYS_mbind
+#include <sys/vfs.h> // statfs
+#endif
 
+#include <algorithm> // std::min
+#include <cerrno>
+#include <chrono>
+#include <cstring> // memcpy
+#include <fstream>
 #include <iomanip>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 
 namespace fair::mq::shmem
 {
 
+std::vector<AllocRoute> ParseAllocPolicy(const std::string& policy, uint16_t ownSegmentId)
+{
+    std::vector<AllocRoute> routes;
+    std::stringstream ss(policy);
+    std::string route;
+    while (std::getline(ss, route, ',')) {
+        if (!routes.empty() && routes.back().fMaxSize == std::numeric_limits<size_t>::max()) {
+            throw std::invalid_argument("only the last route of the allocation policy '" + policy + "' may have no size limit");
+        }
+        std::string store(route.substr(0, route.find(':')));
+        AllocRoute r{std::numeric_limits<size_t>::max(), ownSegmentId, false};
+        try {
+            if (store.rfind("slab", 0) == 0) {
+                r.fSlab = true;
+                r.fSegmentId = static_cast<uint16_t>(std::stoul(store.substr(4)));
+            } else if (store != "segment") {
+                if (store.rfind("segment", 0) != 0) {
+                    throw std::invalid_argument("");
+                }
+                r.fSegmentId = static_cast<uint16_t>(std::stoul(store.substr(7)));
+            }
+        } catch (std::logic_error&) {
+            throw std::invalid_argument("unknown store '" + store + "' in the allocation policy '" + policy + "', supported are segment, segment<id> and slab<id>");
+        }
+        if (r.fSlab && r.fSegmentId == ownSegmentId) {
+            throw std::invalid_argument("the slab store of the allocation policy '" + policy + "' cannot be the own segment");
+        }
+        if (store.size() != route.size()) {
+            std::string limit(route.substr(store.size() + 1));
+            size_t pos = 0;
+            try {
+                if (limit.rfind("<=", 0) != 0) {
+                    throw std::invalid_argument("");
+                }
+                r.fMaxSize = std::stoull(limit.substr(2), &pos);
+                const std::string unit(limit.substr(2 + pos));
+                if (unit == "k" || unit == "K") {
+                    r.fMaxSize <<= 10;
+                } else if (unit == "M") {
+                    r.fMaxSize <<= 20;
+                } else if (unit == "G") {
+                    r.fMaxSize <<= 30;
+                } else if (!unit.empty()) {
+                    throw std::invalid_argument("");
+                }
+            } catch (std::logic_error&) {
+                throw std::invalid_argument("invalid size limit '" + limit + "' in the allocation policy '" + policy + "', expected <=<size>[k|M|G]");
+            }
+        }
+        if (!routes.empty() && r.fMaxSize <= routes.back().fMaxSize) {
+            throw std::invalid_argument("the size limits of the allocation policy '" + policy + "' have to be ascending");
+        }
+        routes.push_back(r);
+    }
+    return routes;
+}
+
 std::string makeShmIdStr(const std::string& sessionId, const std::string& userId)
 {
     std::string seed(userId + sessionId);
@@ -52,5 +126,376 @@ std::string makeShmIdStr(uint64_t val)
     return ss.str();
 }
 
+size_t GetHugetlbfsPageSize(const std::string& path)
+{
+#ifdef __linux__
+    struct statfs fs{};
+    constexpr decltype(fs.f_type) hugetlbfsMagic = 0x958458f6; // HUGETLBFS_MAGIC from linux/magic.h
+    if (statfs(path.c_str(), &fs) == 0 && fs.f_type == hugetlbfsMagic) {
+        return static_cast<size_t>(fs.f_bsize);
+    }
+#else
+    (void)path;
+#endif
+    return 0;
+}
+
+size_t GetFreeHugePages()
+{
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    while (meminfo >> key) {
+        if (key == "HugePages_Free:") {
+            size_t free = 0;
+            meminfo >> free;
+            return free;
+        }
+        meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+}
+
+size_t GetDefaultHugePageSize()
+{
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    while (meminfo >> key) {
+        if (key == "Hugepagesize:") {
+            size_t kB = 0;
+            meminfo >> kB;
+            return kB * 1024;
+        }
+        meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+}
+
+int CreateMemfd(const std::string& name, size_t size, bool hugepages)
+{
+#ifdef __linux__
+    constexpr unsigned int mfdCloexec = 0x1U; // MFD_CLOEXEC
+    constexpr unsigned int mfdAllowSealing = 0x2U; // MFD_ALLOW_SEALING
+    constexpr unsigned int mfdHugetlb = 0x4U; // MFD_HUGETLB, Linux >= 4.14
+    constexpr int fAddSeals = 1033; // F_ADD_SEALS
+    constexpr int fSeals = 0x1 | 0x2 | 0x4; // F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW
+    const int fd = static_cast<int>(syscall(SYS_memfd_create, name.c_str(), mfdCloexec | mfdAllowSealing | (hugepages ? mfdHugetlb : 0U)));
+    if (fd == -1) {
+        return -1;
+    }
+    // sealed against resizing, a peer cannot truncate the memory under the mappings of the others
+    if (::ftruncate(fd, static_cast<off_t>(size)) == -1 || ::fcntl(fd, fAddSeals, fSeals) == -1) {
+        const int err = errno;
+        ::close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+#else
+    (void)name;
+    (void)size;
+    (void)hugepages;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+std::string GetShmemThpMode()
+{
+    // the active mode is the bracketed one, e.g. "always within_size [advise] never deny force"
+    std::ifstream modes("/sys/kernel/mm/transparent_hugepage/shmem_enabled");
+    std::string mode;
+    while (modes >> mode) {
+        if (mode.size() > 2 && mode.front() == '[' && mode.back() == ']') {
+            return mode.substr(1, mode.size() - 2);
+        }
+    }
+    return "";
+}
+
+bool BindToNumaNode(void* ptr, size_t size, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr int mpolBind = 2; // MPOL_BIND from numaif.h
+    constexpr unsigned mpolMfMove = 1 << 1; // MPOL_MF_MOVE from numaif.h
+    constexpr size_t bitsPerLong = 8 * sizeof(unsigned long);
+    if (node < 0) {
+        errno = EINVAL;
+        return false;
+    }
+    std::vector<unsigned long> nodemask(static_cast<size_t>(node) / bitsPerLong + 1, 0);
+    nodemask.at(static_cast<size_t>(node) / bitsPerLong) |= 1UL << (static_cast<size_t>(node) % bitsPerLong);
+    // the kernel expects maxnode to be one more than the number of bits it should read
+    return syscall(SYS_mbind, ptr, size, mpolBind, nodemask.data(), nodemask.size() * bitsPerLong + 1, mpolMfMove) == 0;
+#else
+    (void)ptr;
+    (void)size;
+    (void)node;
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+bool SetThreadNumaAffinity(int node)
+{
+#ifdef __linux__
+    // cpulist has the form "0-7,16-23"
+    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (node < 0 || !cpulist) {
+        errno = ENOENT;
+        return false;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    std::string range;
+    while (std::getline(cpulist, range, ',')) {
+        int first = 0;
+        int last = 0;
+        char dash = 0;
+        std::istringstream ss(range);
+        if (!(ss >> first)) {
+            continue;
+        }
+        last = (ss >> dash >> last && dash == '-') ? last : first;
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    if (CPU_COUNT(&cpus) == 0) {
+        errno = ENOENT;
+        return false;
+    }
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (rc != 0) {
+        errno = rc;
+        return false;
+    }
+    return true;
+#else
+    (void)node;
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+
+bool AddressRangeFree(void* address, size_t size)
+{
+    // the kernel honors the hint only if the whole range is free
+    void* ptr = mmap(address, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    munmap(ptr, size);
+    return ptr == address;
+}
+
+void PrefaultMemory(void* ptr, size_t size)
+{
+#ifdef __linux__
+    constexpr int madvPopulateWrite = 23; // MADV_POPULATE_WRITE, Linux >= 5.14
+    if (madvise(ptr, size, madvPopulateWrite) == 0) {
+        return;
+    }
+#endif
+    // fallback: touch every page with an atomic no-op, which is safe for memory that is already in use
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    char* const begin = static_cast<char*>(ptr);
+    for (size_t offset = 0; offset < size; offset += pageSize) {
+        __atomic_fetch_or(begin + offset, 0, __ATOMIC_RELAXED);
+    }
+}
+
+namespace
+{
+
+enum CompactMetaFlags : uint8_t
+{
+    kCompactManaged = 1,
+    kCompactShared = 2, // unmanaged region message with a ref count in a managed segment (fShared >= 0)
+    kCompactTrace = 4,  // followed by the trace context of the message (first part only)
+    kCompactOffset = 8, // data not at the start of the chunk/region block (slice or headroom), followed by fOffset and fBufferSize
+    kCompactInline = 16, // managed message with its payload in the frame: followed by its size and the payload only
+};
+
+void PutVarint(char*& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+}
+
+bool GetVarint(const char*& in, const char* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*in++);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// handles are signed (-1: none), zigzag keeps small magnitudes short
+uint64_t ZigZag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+int64_t UnZigZag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+} // namespace
+
+size_t EncodeCompactMeta(const MetaHeader* metas, size_t n, char* out, const TraceContext* trace, const char* const* payloads)
+{
+    char* begin = out;
+    std::memcpy(out, &kCompactMetaMagic, sizeof(kCompactMetaMagic));
+    out += sizeof(kCompactMetaMagic);
+    PutVarint(out, n);
+    for (size_t i = 0; i < n; ++i) {
+        const MetaHeader& meta = metas[i];
+        if (payloads && payloads[i]) {
+            *out++ = static_cast<char>(kCompactInline | kCompactManaged | (i == 0 && trace ? kCompactTrace : 0));
+            PutVarint(out, meta.fSize);
+            std::memcpy(out, payloads[i], meta.fSize);
+            out += meta.fSize;
+            if (i == 0 && trace) {
+                std::memcpy(out, trace, sizeof(TraceContext));
+                out += sizeof(TraceContext);
+            }
+            continue;
+        }
+        uint8_t flags = (meta.fManaged ? kCompactManaged : 0) | (!meta.fManaged && meta.fShared >= 0 ? kCompactShared : 0) | (i == 0 && trace ? kCompactTrace : 0)
+                      | (meta.fOffset > 0 || meta.fBufferSize > 0 ? kCompactOffset : 0);
+        *out++ = static_cast<char>(flags);
+        PutVarint(out, meta.fSize);
+        PutVarint(out, ZigZag(meta.fHandle));
+        PutVarint(out, meta.fSegmentId); // also for unmanaged messages: segment of a future refcount (Copy)
+        if (!meta.fManaged) {
+            PutVarint(out, meta.fRegionId);
+            PutVarint(out, meta.fHint);
+            if (flags & kCompactShared) {
+                PutVarint(out, static_cast<uint64_t>(meta.fShared));
+            }
+        }
+        if (flags & kCompactOffset) {
+            PutVarint(out, meta.fOffset);
+            PutVarint(out, meta.fBufferSize);
+        }
+        if (flags & kCompactTrace) {
+            std::memcpy(out, trace, sizeof(TraceContext));
+            out += sizeof(TraceContext);
+        }
+    }
+    if ((out - begin) % sizeof(MetaHeader) == 0) {
+        *out++ = 0;
+    }
+    return out - begin;
+}
+
+bool DecodeCompactMeta(const char* frame, size_t size, std::vector<MetaHeader>& out, TraceContext* trace)
+{
+    uint32_t magic = 0;
+    if (size < sizeof(magic) + 1 || size % sizeof(MetaHeader) == 0) {
+        return false;
+    }
+    std::memcpy(&magic, frame, sizeof(magic));
+    if (magic != kCompactMetaMagic) {
+        return false;
+    }
+    const char* in = frame + sizeof(magic);
+    const char* end = frame + size;
+    uint64_t count = 0;
+    if (!GetVarint(in, end, count)) {
+        return false;
+    }
+    size_t initialSize = out.size();
+    for (uint64_t i = 0; i < count; ++i) {
+        if (in >= end) {
+            out.resize(initialSize);
+            return false;
+        }
+        uint8_t flags = static_cast<uint8_t>(*in++);
+        if (flags & kCompactInline) {
+            uint64_t msgSize = 0;
+            bool ok = GetVarint(in, end, msgSize) && msgSize <= static_cast<uint64_t>(end - in);
+            MetaHeader meta{msgSize, 0, -1, -1, 0, kInlineSegment, true, ok ? static_cast<size_t>(in - frame) : 0, 0};
+            in += ok ? msgSize : 0;
+            if (ok && (flags & kCompactTrace)) {
+                ok = static_cast<size_t>(end - in) >= sizeof(TraceContext);
+                if (ok && trace) {
+                    std::memcpy(trace, in, sizeof(TraceContext));
+                }
+                in += ok ? sizeof(TraceContext) : 0;
+            }
+            if (!ok) {
+                out.resize(initialSize);
+                return false;
+            }
+            out.push_back(meta);
+            continue;
+        }
+        uint64_t msgSize = 0, handle = 0, segmentId = 0, regionId = 0, hint = 0, shared = 0, offset = 0, bufferSize = 0;
+        bool ok = GetVarint(in, end, msgSize) && GetVarint(in, end, handle) && GetVarint(in, end, segmentId);
+        if (!(flags & kCompactManaged)) {
+            ok = ok && GetVarint(in, end, regionId) && GetVarint(in, end, hint);
+            if (flags & kCompactShared) {
+                ok = ok && GetVarint(in, end, shared);
+            }
+        }
+        if (flags & kCompactOffset) {
+            ok = ok && GetVarint(in, end, offset) && GetVarint(in, end, bufferSize);
+        }
+        if (flags & kCompactTrace) {
+            ok = ok && static_cast<size_t>(end - in) >= sizeof(TraceContext);
+            if (ok && trace) {
+                std::memcpy(trace, in, sizeof(TraceContext));
+            }
+            in += ok ? sizeof(TraceContext) : 0;
+        }
+        if (!ok) {
+            out.resize(initialSize);
+            return false;
+        }
+        MetaHeader meta{};
+        meta.fSize = msgSize;
+        meta.fHint = (flags & kCompactManaged) ? 0 : hint;
+        meta.fHandle = UnZigZag(handle);
+        meta.fShared = (flags & kCompactShared) ? static_cast<boost::interprocess::managed_shared_memory::handle_t>(shared) : -1;
+        meta.fRegionId = static_cast<uint16_t>(regionId);
+        meta.fSegmentId = static_cast<uint16_t>(segmentId);
+        meta.fManaged = (flags & kCompactManaged) != 0;
+        meta.fOffset = offset;
+        meta.fBufferSize = bufferSize;
+        out.push_back(meta);
+    }
+    return true;
+}
+
+bool FutexWait(std::atomic<uint32_t>& word, uint32_t expected, int timeoutMs)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32 bit integer");
+#ifdef __linux__
+    timespec ts{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+    // shared (non-private) futex, the word may be mapped at different addresses in different processes
+    long rc = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, timeoutMs < 0 ? nullptr : &ts, nullptr, 0);
+    return !(rc == -1 && errno == ETIMEDOUT);
+#else
+    if (word.load() == expected) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs < 0 ? 1 : std::min(timeoutMs, 1)));
+        return word.load() != expected;
+    }
+    return true;
+#endif
+}
+
+void FutexWake(std::atomic<uint32_t>& word, int count)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+#else
+    (void)word;
+    (void)count;
+#endif
+}
 
 }   // namespace fair::mq::shmem
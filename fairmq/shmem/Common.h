@@ -8,9 +8,13 @@
 #ifndef FAIR_MQ_SHMEM_COMMON_H_
 #define FAIR_MQ_SHMEM_COMMON_H_
 
+#include <algorithm> // min
+#include <array>
 #include <atomic>
 #include <string>
 #include <functional> // std::equal_to
+#include <new> // std::nothrow
+#include <vector>
 
 #include <boost/functional/hash.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
@@ -20,15 +24,27 @@
 #include <boost/interprocess/indexes/null_index.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/mem_algo/simple_seq_fit.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/variant.hpp>
 
+#include <fairmq/shmem/RobustMutex.h>
+#include <fairmq/shmem/SlabFit.h>
+#include <fairmq/Tracing.h>
+#include <fairmq/tools/Gpu.h>
+
 #include <sys/types.h>
 
 namespace fair::mq::shmem
 {
 
 static constexpr uint64_t kManagementSegmentSize = 6553600;
+// MetaHeader::fSegmentId of an unmanaged region message whose ref count lives in the region ref count slab
+static constexpr uint16_t kRegionRefCountSegment = UINT16_MAX;
+// MetaHeader::fSegmentId of a managed message whose payload is held by the message itself (--shm-inline-size)
+static constexpr uint16_t kInlineSegment = UINT16_MAX - 1;
+// upper limit of --shm-inline-size, inline payloads travel in the meta data frame
+static constexpr size_t kMaxInlineSize = 4096;
 
 struct SharedMemoryError : std::runtime_error { using std::runtime_error::runtime_error; };
 
@@ -40,6 +56,9 @@ using RBTreeBestFitSegment = boost::interprocess::basic_managed_shared_memory<ch
     boost::interprocess::rbtree_best_fit<boost::interprocess::mutex_family, boost::interprocess::offset_ptr<void>>,
     boost::interprocess::null_index>;
     // boost::interprocess::iset_index>;
+using SlabFitSegment = boost::interprocess::basic_managed_shared_memory<char,
+    SlabFitAlgorithm<boost::interprocess::mutex_family, boost::interprocess::offset_ptr<void>>,
+    boost::interprocess::null_index>;
 
 using SegmentManager = boost::interprocess::managed_shared_memory::segment_manager;
 using VoidAlloc      = boost::interprocess::allocator<void, SegmentManager>;
@@ -51,7 +70,8 @@ using StrVector      = boost::interprocess::vector<Str, StrAlloc>;
 enum class AllocationAlgorithm : int
 {
     rbtree_best_fit,
-    simple_seq_fit
+    simple_seq_fit,
+    slab_fit
 };
 
 struct RegionInfo
@@ -77,6 +97,22 @@ struct RegionInfo
     uint64_t fUserFlags;
     uint64_t fSize;
     bool fDestroyed;
+    // acknowledgement settings of the region owner, applied by the senders
+    uint32_t fAckBunchSize = 256;
+    uint32_t fAckMaxDelayUs = 500000;
+    bool fAckAdaptive = false;
+    bool fAckRing = false;
+    uint32_t fRefCountSlots = 0; // size of the ref count slab (fmq_<shmId>_rgrc_<id>), 0: none
+    bool fGpuRegister = false; // viewers register the region with the GPU runtime as well
+    int fGpuDevice = -1; // >= 0: the region is GPU device memory, opened by the viewers via fGpuIpcHandle
+    bool fMemfd = false; // the region is a memfd (or an external descriptor) of its controller, fPath is its /proc/<pid>/fd/<fd> link
+    uint64_t fFdOffset = 0; // offset of the region in the descriptor (RegionConfig::fdOffset)
+    uint64_t fAddress = 0; // address all processes map the region at (--shm-fixed-address), 0: any
+    bool fRingBuffer = false; // blocks are released to the ring state (fmq_<shmId>_rgrb_<id>) instead of acknowledged
+    bool fCrossHost = false; // the ring state is in the memory window behind the region (RegionConfig::crossHost)
+    uint64_t fSlotSize = 0; // > 0: slot pool region, slots are allocated and released via the free list in the region
+    uint64_t fMaxSize = 0; // > 0: resizable region (RegionConfig::maxSize), mapped with this size, fSize is the current size
+    tools::GpuIpcHandle fGpuIpcHandle{};
 };
 
 using Uint16RegionInfoPairAlloc = boost::interprocess::allocator<std::pair<const uint16_t, RegionInfo>, SegmentManager>;
@@ -85,11 +121,16 @@ using Uint16RegionInfoHashMap = boost::unordered_map<uint16_t, RegionInfo, boost
 
 struct SegmentInfo
 {
-    SegmentInfo(AllocationAlgorithm aa)
+    SegmentInfo(AllocationAlgorithm aa, bool refCountTable = false, int numaNode = -1)
         : fAllocationAlgorithm(aa)
+        , fRefCountTable(refCountTable)
+        , fNumaNode(numaNode)
     {}
 
     AllocationAlgorithm fAllocationAlgorithm;
+    bool fRefCountTable; // message ref counts are kept in a separate table object (fmq_<shmId>_rc_<segmentId>) instead of a chunk header
+    int fNumaNode; // NUMA node the segment memory is bound to by its creator, -1 if not bound
+    uint64_t fAddress = 0; // address all processes map the segment at (--shm-fixed-address), 0: any
 };
 
 struct SessionInfo
@@ -103,6 +144,204 @@ struct SessionInfo
     int fCreatorId;
 };
 
+struct SegmentCacheCounter
+{
+    SegmentCacheCounter()
+        : fBytes(0)
+        , fReleaseRequests(0)
+    {}
+
+    std::atomic<uint64_t> fBytes; // bytes held in per-process allocation caches (allocated in the segment, but not in use)
+    std::atomic<uint64_t> fReleaseRequests; // incremented by failed allocations, the caching processes then return their buffers
+};
+
+using Uint16SegmentCacheCounterPairAlloc = boost::interprocess::allocator<std::pair<const uint16_t, SegmentCacheCounter>, SegmentManager>;
+using Uint16SegmentCacheCounterHashMap = boost::unordered_map<uint16_t, SegmentCacheCounter, boost::hash<uint16_t>, std::equal_to<uint16_t>, Uint16SegmentCacheCounterPairAlloc>;
+
+// allocator statistics of a segment, published for fairmq-shmmonitor. The latencies and sizes are sampled (--shm-alloc-stats),
+// the failures are always recorded
+struct SegmentAllocStats
+{
+    static constexpr int kNumBuckets = 48;
+    // bucket 0: value 0, bucket i: values in [2^(i-1), 2^i)
+    static int Bucket(uint64_t value) { return value == 0 ? 0 : std::min(64 - __builtin_clzll(value), kNumBuckets - 1); }
+
+    std::atomic<uint64_t> fSampledAllocs{0};
+    std::atomic<uint64_t> fAllocNs{0}; // total time of the sampled allocations
+    std::array<std::atomic<uint64_t>, kNumBuckets> fAllocNsBuckets{};
+    std::array<std::atomic<uint64_t>, kNumBuckets> fSizeBuckets{};
+    std::atomic<uint64_t> fSampledDeallocs{0}; // chunks
+    std::atomic<uint64_t> fDeallocNs{0};
+
+    std::atomic<uint64_t> fFailures{0};
+    std::atomic<uint64_t> fFragmentedFailures{0}; // failures although the free memory would have sufficed
+    std::atomic<uint64_t> fLastFailureSize{0};
+    std::atomic<uint64_t> fLastFailureFreeMemory{0};
+    std::atomic<uint64_t> fLastFailureLargestFreeBlock{0};
+};
+
+using Uint16SegmentAllocStatsPairAlloc = boost::interprocess::allocator<std::pair<const uint16_t, SegmentAllocStats>, SegmentManager>;
+using Uint16SegmentAllocStatsHashMap = boost::unordered_map<uint16_t, SegmentAllocStats, boost::hash<uint16_t>, std::equal_to<uint16_t>, Uint16SegmentAllocStatsPairAlloc>;
+
+// owner tags of sampled managed segment chunks (--shm-owner-sampling): producing device, allocation time and the channel
+// the chunk was last sent on, for the usage view of fairmq-shmmonitor. A fixed size open addressing table in the management
+// segment, written lock-free by the allocating, sending and deallocating processes. Names are added under the management mutex.
+struct ChunkOwnerTable
+{
+    static constexpr size_t kNumSlots = 16384; // power of two
+    static constexpr size_t kMaxProbes = 8;
+    static constexpr uint16_t kMaxNames = 256;
+    static constexpr size_t kMaxNameLength = 96;
+    static constexpr uint16_t kNoName = 0xffff;
+
+    struct Tag
+    {
+        std::atomic<uint64_t> fKey{0};  // see Key(), 0 for a free slot
+        std::atomic<uint64_t> fTime{0}; // allocation time in ns since epoch (system clock), 0 while the slot is (un)claimed
+        std::atomic<uint64_t> fSize{0};
+        std::atomic<uint16_t> fDevice{kNoName};
+        std::atomic<uint16_t> fChannel{kNoName};
+    };
+
+    struct Name
+    {
+        char fName[kMaxNameLength];
+        uint32_t fSampling; // of a device (one tagged allocation per fSampling), 0 for channels
+    };
+
+    static uint64_t Key(uint16_t segmentId, int64_t handle) { return ((static_cast<uint64_t>(segmentId) << 48) | (static_cast<uint64_t>(handle) & 0xffffffffffffULL)) + 1; }
+
+    // returns false if the probed slots are all in use (the chunk is then counted as dropped)
+    bool Add(uint64_t key, uint64_t size, uint16_t device, uint64_t time)
+    {
+        for (size_t i = 0; i < kMaxProbes; ++i) {
+            Tag& tag = fTags[Slot(key, i)];
+            uint64_t expected = 0;
+            if (tag.fKey.load(std::memory_order_relaxed) == 0 && tag.fKey.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+                tag.fSize.store(size, std::memory_order_relaxed);
+                tag.fDevice.store(device, std::memory_order_relaxed);
+                tag.fChannel.store(kNoName, std::memory_order_relaxed);
+                tag.fTime.store(time, std::memory_order_release);
+                fNumTags.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        fNumDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Tag* Find(uint64_t key)
+    {
+        // slots are freed in place, so all probe positions are checked
+        for (size_t i = 0; i < kMaxProbes; ++i) {
+            Tag& tag = fTags[Slot(key, i)];
+            if (tag.fKey.load(std::memory_order_acquire) == key) {
+                return &tag;
+            }
+        }
+        return nullptr;
+    }
+
+    void Remove(uint64_t key)
+    {
+        Tag* tag = Find(key);
+        if (tag) {
+            tag->fTime.store(0, std::memory_order_relaxed);
+            tag->fKey.store(0, std::memory_order_release);
+            fNumTags.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    alignas(64) std::atomic<uint32_t> fNumTags{0}; // checked before every lookup, so that untagged sessions skip the table
+    std::atomic<uint64_t> fNumDropped{0};
+    uint16_t fNumNames = 0;
+    std::array<Name, kMaxNames> fNames{};
+    std::array<Tag, kNumSlots> fTags{};
+
+  private:
+    static size_t Slot(uint64_t key, size_t probe) { return (((key * 0x9e3779b97f4a7c15ULL) >> 50) + probe) & (kNumSlots - 1); }
+};
+
+// byte quotas of the producing devices of the session (--shm-quota-soft, --shm-quota-hard), in the management segment.
+// Every managed chunk allocated by a device with a quota records the slot of the device, the allocator size of the chunk is
+// added to fUsed on allocation and subtracted by whichever process deallocates it. Slots are added under the management mutex.
+struct QuotaTable
+{
+    static constexpr uint16_t kMaxQuotas = 256;
+    static constexpr size_t kMaxNameLength = 96;
+    static constexpr uint16_t kNoQuota = 0xffff;
+    static constexpr uint16_t kArenaChunk = 0xfffe; // instead of a slot: the chunk is part of an arena (BufferArena), charged with it
+
+    struct Quota
+    {
+        char fName[kMaxNameLength];
+        std::atomic<uint64_t> fSoft{0}; // 0: none
+        std::atomic<uint64_t> fHard{0}; // 0: none
+        std::atomic<uint64_t> fUsed{0};
+        std::atomic<uint64_t> fPeak{0};
+        std::atomic<bool> fAboveSoft{false};
+        std::atomic<uint64_t> fSoftExceeded{0}; // crossings of the soft quota
+        std::atomic<uint64_t> fHardRejected{0}; // allocation attempts rejected by the hard quota
+    };
+
+    uint16_t fNumQuotas = 0;
+    std::array<Quota, kMaxQuotas> fQuotas{};
+};
+
+// usage counters of the segments and regions of the session, published by their processes every --shm-stats-interval ms
+// for the stats stream of fairmq-shmmonitor (--stats). A fixed size table in the management segment: entries are claimed
+// under the management mutex, written and read with relaxed atomics only, so that neither the publishing processes nor
+// the monitor take a lock or open a segment to collect them.
+struct UsageTable
+{
+    static constexpr size_t kNumSlots = 1024;
+
+    struct alignas(64) Entry
+    {
+        std::atomic<uint32_t> fKey{0}; // see Key(), 0 for a free slot
+        std::atomic<uint64_t> fSize{0};
+        std::atomic<uint64_t> fFreeBytes{0}; // segments
+        std::atomic<uint64_t> fAllocations{0}; // segments: by the processes that use the segment as their own (any segment they allocate from)
+        std::atomic<uint64_t> fDeallocations{0}; // segments: by these processes, of chunks of any segment
+        std::atomic<uint64_t> fAcksSent{0}; // regions: blocks acknowledged by the processes that release them
+        std::atomic<uint64_t> fAcksReceived{0}; // regions: blocks received by the region creator
+        std::atomic<uint64_t> fUpdated{0}; // ns since epoch (system clock) of the last update
+    };
+
+    static uint32_t Key(bool managed, uint16_t id) { return (managed ? 1u : 2u) << 16 | id; }
+
+    // returns the entry of key, claimed if there is none. nullptr if the table is full. Caller holds the management mutex
+    Entry* Claim(uint32_t key)
+    {
+        Entry* free = nullptr;
+        for (auto& entry : fEntries) {
+            const uint32_t k = entry.fKey.load(std::memory_order_relaxed);
+            if (k == key) {
+                return &entry;
+            }
+            if (k == 0 && !free) {
+                free = &entry;
+            }
+        }
+        if (free) {
+            free->fSize = 0;
+            free->fFreeBytes = 0;
+            free->fAllocations = 0;
+            free->fDeallocations = 0;
+            free->fAcksSent = 0;
+            free->fAcksReceived = 0;
+            free->fUpdated = 0;
+            free->fKey.store(key, std::memory_order_release);
+        }
+        return free;
+    }
+
+    // the entry of a destroyed region
+    void Release(Entry& entry) { entry.fKey.store(0, std::memory_order_release); }
+
+    std::array<Entry, kNumSlots> fEntries{};
+};
+
 using Uint16SegmentInfoPairAlloc = boost::interprocess::allocator<std::pair<const uint16_t, SegmentInfo>, SegmentManager>;
 using Uint16SegmentInfoHashMap = boost::unordered_map<uint16_t, SegmentInfo, boost::hash<uint16_t>, std::equal_to<uint16_t>, Uint16SegmentInfoPairAlloc>;
 // using Uint16SegmentInfoMap = boost::interprocess::map<uint16_t, SegmentInfo, std::less<uint16_t>, Uint16SegmentInfoPairAlloc>;
@@ -116,13 +355,44 @@ struct DeviceCounter
     std::atomic<unsigned int> fCount;
 };
 
+// counts the segment and region events of the session and keeps the most recent ones in a ring, so that the region
+// event subscribers only look at what changed (instead of all segments and regions of the session) as long as they keep up.
+// Subscribers sleep on fCV until the count changes. fMtx guards the ring, it is the innermost lock of the management segment
 struct EventCounter
 {
+    static constexpr uint64_t kNumEvents = 4096;
+
+    struct Event
+    {
+        uint16_t fId;
+        bool fManaged;
+        bool fDestroyed;
+        bool fResized;
+    };
+
     EventCounter(uint64_t c)
         : fCount(c)
     {}
 
+    void Increment(uint16_t id, bool managed, bool destroyed, bool resized = false)
+    {
+        boost::interprocess::scoped_lock<RobustMutex> lock(fMtx);
+        fEvents[fCount % kNumEvents] = Event{id, managed, destroyed, resized};
+        ++fCount;
+        fCV.notify_all();
+    }
+
+    // wakes up all subscribers of the session, also used for local state changes of a subscriber (they re-check and sleep again)
+    void Notify()
+    {
+        boost::interprocess::scoped_lock<RobustMutex> lock(fMtx);
+        fCV.notify_all();
+    }
+
     std::atomic<uint64_t> fCount;
+    std::array<Event, kNumEvents> fEvents{}; // event n is at n % kNumEvents
+    RobustMutex fMtx;
+    RobustCondition fCV;
 };
 
 struct Heartbeat
@@ -134,6 +404,65 @@ struct Heartbeat
     std::atomic<uint64_t> fCount;
 };
 
+// processes of the session using pid based liveness (--shm-liveness pid) instead of heartbeats, checked by the monitor
+struct LivenessTable
+{
+    static constexpr size_t kNumSlots = 1024;
+
+    // returns the claimed slot, or -1 if the table is full
+    int Add(pid_t pid)
+    {
+        for (size_t i = 0; i < kNumSlots; ++i) {
+            pid_t expected = 0;
+            if (fPids[i].load(std::memory_order_relaxed) == 0 && fPids[i].compare_exchange_strong(expected, pid)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void Remove(int slot) { fPids[slot].store(0); }
+
+    std::array<std::atomic<pid_t>, kNumSlots> fPids{};
+};
+
+// processes of the session recording the chunks they hold in a ChunkLedger (--shm-reclaim). The ledger of slot i is the
+// shared memory object Name(shmId, i), a slot of a process that is not alive any more is reclaimed by the next one starting
+struct LedgerTable
+{
+    static constexpr size_t kNumSlots = 1024;
+    static constexpr pid_t kReclaiming = -1;
+
+    static std::string Name(const std::string& shmId, size_t slot) { return "fmq_" + shmId + "_ldg_" + std::to_string(slot); }
+
+    // returns the claimed slot, or -1 if the table is full
+    int Add(pid_t pid)
+    {
+        for (size_t i = 0; i < kNumSlots; ++i) {
+            pid_t expected = 0;
+            if (fPids[i].load(std::memory_order_relaxed) == 0 && fPids[i].compare_exchange_strong(expected, pid)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void Remove(int slot) { fPids[slot].store(0); }
+
+    std::array<std::atomic<pid_t>, kNumSlots> fPids{};
+    std::atomic<uint64_t> fReclaimedChunks{0}; // released by Manager::Reclaim, counted over the session
+    std::atomic<uint64_t> fReclaimedRefs{0};
+};
+
+// lets allocations that failed on a full segment sleep until memory is freed in the session (--shm-bad-alloc-wait)
+struct DeallocationNotifier
+{
+    RobustMutex fMtx;
+    RobustCondition fCV;
+    std::atomic<uint32_t> fWaiters{0};
+    uint64_t fGeneration = 0; // incremented (under fMtx) on every deallocation while there are waiters
+};
+
 struct RegionCounter
 {
     RegionCounter(uint16_t c)
@@ -152,8 +481,65 @@ struct MetaHeader
     uint16_t fRegionId;
     mutable uint16_t fSegmentId;
     bool fManaged;
+    size_t fOffset;     // offset of the data in the chunk/region block (slices and headroom, see Message::Slice/Prepend)
+    size_t fBufferSize; // size of the chunk/region block a slice refers to, 0 if the message is not a slice
 };
 
+// object store of the session (TransportFactory::PublishObject), every entry holds one reference to its message
+struct ObjectInfo
+{
+    ObjectInfo(const MetaHeader& meta, uint64_t version)
+        : fMeta(meta)
+        , fVersion(version)
+    {}
+
+    MetaHeader fMeta;
+    uint64_t fVersion;
+};
+
+using StrObjectInfoPairAlloc = boost::interprocess::allocator<std::pair<const Str, ObjectInfo>, SegmentManager>;
+using StrObjectInfoMap = boost::interprocess::map<Str, ObjectInfo, std::less<Str>, StrObjectInfoPairAlloc>;
+
+struct ObjectStore
+{
+    ObjectStore(const VoidAlloc& alloc)
+        : fObjects(alloc)
+        , fLastVersion(0)
+    {}
+
+    StrObjectInfoMap fObjects;
+    uint64_t fLastVersion; // versions are unique within the session, a new version is always larger
+};
+
+// prefix of a frame carrying a batch of single-part messages (send batching, see Socket::SetSndBatch)
+struct MetaBatchHeader
+{
+    static constexpr uint32_t kMagic = 0x464d5142; // "FMQB"
+    uint32_t fMagic;
+    uint32_t fCount;
+};
+// batch frames (header + n MetaHeaders) must be distinguishable from multipart frames (n MetaHeaders) by their size
+static_assert(sizeof(MetaBatchHeader) % sizeof(MetaHeader) != 0, "batch frame size must not be a multiple of the MetaHeader size");
+
+// Compact (varint) encoding of MetaHeaders, only fields relevant to the message kind are written.
+// Frame: kCompactMetaMagic, varint count, per part: flags, varint fields. Padded so that its size
+// is never a multiple of sizeof(MetaHeader), which keeps it distinguishable from the default format.
+// A trace context (TraceContext) of the message is flagged in the first part and follows its fields.
+// Parts with an inline payload consist of the flags, the varint size and the payload bytes.
+constexpr uint32_t kCompactMetaMagic = 0x464d5143; // "FMQC"
+// upper bound for the encoded size of n headers with inlineBytes of inline payloads in total:
+// magic + count + per part: flags + 7 varints (max 10 bytes each) + 2 uint16 varints (max 3 bytes each), + trace context + padding byte
+constexpr size_t CompactMetaMaxSize(size_t n, size_t inlineBytes = 0) { return sizeof(kCompactMetaMagic) + 10 + n * (1 + 7 * 10 + 2 * 3) + inlineBytes + sizeof(TraceContext) + 1; }
+// encodes n headers (and the trace context, if given) into out (at least CompactMetaMaxSize(n, inlineBytes) bytes), returns
+// the frame size. payloads (optional, one per part) points to the inline payload of a part, nullptr for the others
+size_t EncodeCompactMeta(const MetaHeader* metas, size_t n, char* out, const TraceContext* trace = nullptr, const char* const* payloads = nullptr);
+// decodes a compact frame, appending the headers to out and storing its trace context (if any) in trace. Inline parts
+// get kInlineSegment as segment id and the position of their payload in the frame as fOffset (see IsInline()).
+// Returns false if the frame is not a valid compact frame
+bool DecodeCompactMeta(const char* frame, size_t size, std::vector<MetaHeader>& out, TraceContext* trace = nullptr);
+// the payload of the message is not in shared memory, but in the meta data frame it was received with
+inline bool IsInline(const MetaHeader& meta) { return meta.fManaged && meta.fSegmentId == kInlineSegment; }
+
 #ifdef FAIRMQ_DEBUG_MODE
 struct MsgCounter
 {
@@ -219,6 +605,64 @@ std::string makeShmIdStr(const std::string& sessionId);
 std::string makeShmIdStr(uint64_t val);
 uint64_t makeShmIdUint64(const std::string& sessionId);
 
+// returns the huge page size of the hugetlbfs mount that contains the given path, 0 if the path is not on hugetlbfs
+size_t GetHugetlbfsPageSize(const std::string& path);
+// returns the number of free huge pages of the default size, as reported by /proc/meminfo
+size_t GetFreeHugePages();
+// returns the size of the default huge pages, as reported by /proc/meminfo, 0 if unknown
+size_t GetDefaultHugePageSize();
+// creates an anonymous memory file (memfd_create) of the given size, sealed against resizing. Returns the file descriptor, -1 on failure (errno is set)
+int CreateMemfd(const std::string& name, size_t size, bool hugepages);
+// returns the active transparent huge page mode for shared memory (always/within_size/advise/never/deny), empty if not supported
+std::string GetShmemThpMode();
+
+// binds the memory range [ptr, ptr + size) to the given NUMA node (mbind with MPOL_BIND), moving already present pages. Returns false on failure (errno is set)
+bool BindToNumaNode(void* ptr, size_t size, int node);
+// restricts the calling thread to the CPUs of the given NUMA node. Returns false on failure (errno is set)
+bool SetThreadNumaAffinity(int node);
+// returns true if [address, address + size) is not mapped in the calling process
+bool AddressRangeFree(void* address, size_t size);
+
+// address space of a session for --shm-fixed-address (in the management segment): segments and regions are placed one
+// after another from a base derived from the shmId, in a part of the 47 bit user address space that mmap, the heap and
+// position independent executables do not use by default
+struct FixedAddressSpace
+{
+    static constexpr uint64_t kAlignment = 2 << 20; // also the gap between two ranges
+
+    explicit FixedAddressSpace(uint64_t shmId64)
+        : fNext(0x100000000000ULL + (shmId64 % 256) * 0x4000000000ULL)
+    {}
+
+    // next range of size bytes, from any process without a lock
+    uint64_t Reserve(size_t size)
+    {
+        return fNext.fetch_add((size + kAlignment - 1) / kAlignment * kAlignment + kAlignment);
+    }
+
+    std::atomic<uint64_t> fNext;
+};
+
+// faults in the pages of [ptr, ptr + size) for writing, without modifying their content
+void PrefaultMemory(void* ptr, size_t size);
+// blocks while *word == expected, for at most timeoutMs (< 0: no limit). Works across processes for words in shared memory.
+// Without futex support (non-Linux) it sleeps for up to 1 ms. Returns false on timeout.
+bool FutexWait(std::atomic<uint32_t>& word, uint32_t expected, int timeoutMs);
+// wakes up to count threads blocked in FutexWait on the given word
+void FutexWake(std::atomic<uint32_t>& word, int count);
+
+// route of the size-routed allocation policy (shm-alloc-policy): messages of up to fMaxSize bytes come from segment fSegmentId
+struct AllocRoute
+{
+    size_t fMaxSize;
+    uint16_t fSegmentId;
+    bool fSlab; // the segment is created with slab_fit
+};
+// parses "<store>[:<=<size>],...", with the stores segment (the own segment), segment<id> and slab<id> (segments of the
+// session) and sizes with optional k/M/G suffix, in ascending order (only the last route may have no limit).
+// Throws std::invalid_argument on malformed policies.
+std::vector<AllocRoute> ParseAllocPolicy(const std::string& policy, uint16_t ownSegmentId);
+
 
 struct SegmentSize : public boost::static_visitor<size_t>
 {
@@ -244,6 +688,43 @@ struct SegmentFreeMemory : public boost::static_visitor<size_t>
     size_t operator()(S& s) const { return s.get_free_memory(); }
 };
 
+// size of the largest buffer that could currently be allocated. The boost algorithms have no query for it, so the largest
+// free block is briefly allocated (allocate_new with a preferred size larger than any block falls back to it). Only use it
+// when allocations fail anyway, concurrent allocations of the same size could fail meanwhile.
+struct SegmentLargestFreeBlock : public boost::static_visitor<size_t>
+{
+    template<typename S>
+    size_t operator()(S& s) const
+    {
+        size_t size = s.get_free_memory() + 1; // larger than any free block
+        char* reuse = nullptr;
+        char* ptr = s.template allocation_command<char>(boost::interprocess::allocate_new | boost::interprocess::nothrow_allocation, 1, size, reuse);
+        if (!ptr) {
+            return 0;
+        }
+        s.deallocate(ptr);
+        return size;
+    }
+
+    size_t operator()(SlabFitSegment& s) const
+    {
+        // the segment manager inherits the algorithm privately, a C-style cast is the only way to reach the base
+        using Algorithm = SlabFitSegment::segment_manager::memory_algorithm;
+        return ((const Algorithm*)s.get_segment_manager())->get_largest_free_block();
+    }
+};
+
+// size of an allocated chunk as accounted by the allocator (at least the requested size)
+struct SegmentChunkSize : public boost::static_visitor<size_t>
+{
+    SegmentChunkSize(const void* _ptr) : ptr(_ptr) {}
+
+    template<typename S>
+    size_t operator()(S& s) const { return s.get_segment_manager()->size(ptr); }
+
+    const void* ptr;
+};
+
 struct SegmentHandleFromAddress : public boost::static_visitor<boost::interprocess::managed_shared_memory::handle_t>
 {
     SegmentHandleFromAddress(const void* _ptr) : ptr(_ptr) {}
@@ -303,6 +784,25 @@ struct SegmentBufferShrink : public boost::static_visitor<char*>
     mutable char* local_ptr;
 };
 
+struct SegmentBufferExpand : public boost::static_visitor<char*>
+{
+    SegmentBufferExpand(const size_t _new_size, char* _local_ptr)
+        : new_size(_new_size)
+        , local_ptr(_local_ptr)
+    {}
+
+    // returns local_ptr if the buffer could be expanded forward in place, nullptr otherwise
+    template<typename S>
+    char* operator()(S& s) const
+    {
+        boost::interprocess::managed_shared_memory::size_type expanded_size = new_size;
+        return s.template allocation_command<char>(boost::interprocess::expand_fwd | boost::interprocess::nothrow_allocation, new_size, expanded_size, local_ptr);
+    }
+
+    const size_t new_size;
+    mutable char* local_ptr;
+};
+
 struct SegmentDeallocate : public boost::static_visitor<>
 {
     SegmentDeallocate(char* _ptr) : ptr(_ptr) {}
@@ -313,6 +813,56 @@ struct SegmentDeallocate : public boost::static_visitor<>
     char* ptr;
 };
 
+// usable size of a buffer previously allocated from the segment (can be larger than the requested size)
+struct SegmentBufferSize : public boost::static_visitor<size_t>
+{
+    SegmentBufferSize(const char* _ptr) : ptr(_ptr) {}
+
+    template<typename S>
+    size_t operator()(S& s) const { return s.get_segment_manager()->size(ptr); }
+
+    const char* ptr;
+};
+
+// allocates up to n buffers of the given size under a single segment lock, appends them to out.
+// does not throw - on failure nothing is appended.
+struct SegmentAllocateMany : public boost::static_visitor<>
+{
+    SegmentAllocateMany(const size_t _size, const size_t _n, std::vector<char*>& _out) : size(_size), n(_n), out(_out) {}
+
+    template<typename S>
+    void operator()(S& s) const
+    {
+        typename S::segment_manager::multiallocation_chain chain;
+        s.get_segment_manager()->allocate_many(std::nothrow, size, n, chain);
+        while (!chain.empty()) {
+            out.push_back(static_cast<char*>(boost::interprocess::ipcdetail::to_raw_pointer(chain.pop_front())));
+        }
+    }
+
+    const size_t size;
+    const size_t n;
+    std::vector<char*>& out;
+};
+
+// returns all the given buffers to the segment under a single segment lock
+struct SegmentDeallocateMany : public boost::static_visitor<>
+{
+    SegmentDeallocateMany(const std::vector<char*>& _ptrs) : ptrs(_ptrs) {}
+
+    template<typename S>
+    void operator()(S& s) const
+    {
+        typename S::segment_manager::multiallocation_chain chain;
+        for (char* ptr : ptrs) {
+            chain.push_back(ptr);
+        }
+        s.get_segment_manager()->deallocate_many(chain);
+    }
+
+    const std::vector<char*>& ptrs;
+};
+
 } // namespace fair::mq::shmem
 
 #endif /* FAIR_MQ_SHMEM_COMMON_H_ */
@@ -0,0 +1,108 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_DEFERREDFREEQUEUE_H_
+#define FAIR_MQ_SHMEM_DEFERREDFREEQUEUE_H_
+
+#include <boost/interprocess/managed_shared_memory.hpp>
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <memory>
+
+namespace fair::mq::shmem
+{
+
+struct DeferredFree
+{
+    boost::interprocess::managed_shared_memory::handle_t fHandle;
+    uint64_t fSize; // allocator size of the chunk
+    uint16_t fSegmentId;
+};
+
+// Chunks released with --shm-deferred-free, on their way to the deallocation thread of the process.
+// A bounded multi-producer/single-consumer queue (sequence-numbered cells of a Vyukov queue): pushing takes a single CAS
+// and never blocks, a full queue makes the caller deallocate synchronously. Consumers have to be serialized by the caller.
+class DeferredFreeQueue
+{
+  public:
+    explicit DeferredFreeQueue(size_t capacity)
+        : fCapacity(RoundUpPow2(capacity))
+        , fCells(std::make_unique<Cell[]>(fCapacity))
+        , fEnqueuePos(0)
+        , fDequeuePos(0)
+    {
+        for (size_t i = 0; i < fCapacity; ++i) {
+            fCells[i].fSeq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // @return false if the queue is full
+    bool Push(const DeferredFree& entry)
+    {
+        size_t pos = fEnqueuePos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &fCells[pos & (fCapacity - 1)];
+            const size_t seq = cell->fSeq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (fEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = fEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->fEntry = entry;
+        cell->fSeq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // @return false if the queue is empty
+    bool Pop(DeferredFree& entry)
+    {
+        const size_t pos = fDequeuePos.load(std::memory_order_relaxed);
+        Cell& cell = fCells[pos & (fCapacity - 1)];
+        if (cell.fSeq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        entry = cell.fEntry;
+        cell.fSeq.store(pos + fCapacity, std::memory_order_release);
+        fDequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<size_t> fSeq;
+        DeferredFree fEntry;
+    };
+
+    static size_t RoundUpPow2(size_t n)
+    {
+        size_t pow2 = 2;
+        while (pow2 < n) {
+            pow2 *= 2;
+        }
+        return pow2;
+    }
+
+    const size_t fCapacity;
+    std::unique_ptr<Cell[]> fCells;
+    alignas(64) std::atomic<size_t> fEnqueuePos;
+    alignas(64) std::atomic<size_t> fDequeuePos;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_DEFERREDFREEQUEUE_H_ */
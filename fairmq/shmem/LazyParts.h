@@ -0,0 +1,163 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_LAZYPARTS_H_
+#define FAIR_MQ_SHMEM_LAZYPARTS_H_
+
+#include "Common.h"
+#include "Manager.h"
+#include "Message.h"
+#include <fairmq/Message.h>
+#include <fairmq/Tracing.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fairlogger/Logger.h>
+
+#include <cstddef> // size_t
+#include <memory>
+#include <utility> // pair
+#include <vector>
+
+namespace fair::mq::shmem
+{
+
+class Socket;
+
+/// Multipart message received with Socket::ReceiveLazy(): the meta data of the parts as received, message objects are
+/// created on first access only. The parts that are still in the view can be sent on with Socket::Send(LazyParts&),
+/// which transfers the meta data of the untouched ones as it is. Parts still in the view when it is cleared or
+/// destroyed are released in bulk.
+class LazyParts
+{
+    friend class Socket;
+
+  public:
+    LazyParts() = default;
+    LazyParts(const LazyParts&) = delete;
+    LazyParts(LazyParts&&) = delete;
+    LazyParts& operator=(const LazyParts&) = delete;
+    LazyParts& operator=(LazyParts&&) = delete;
+    ~LazyParts() { Clear(); }
+
+    /// number of parts, including the ones taken out with Take()
+    size_t Size() const { return fMetas.size(); }
+    bool Empty() const { return fMetas.empty(); }
+    /// payload size of a part, without creating its message
+    size_t GetSize(size_t i) const { return fMetas.at(i).fSize; }
+    /// the part has a message object
+    bool Materialized(size_t i) const { return fMessages.at(i) != nullptr; }
+    /// number of parts with a message object
+    size_t NumMaterialized() const
+    {
+        size_t n = 0;
+        for (const auto& msg : fMessages) {
+            n += msg ? 1 : 0;
+        }
+        return n;
+    }
+    const TraceContext& GetTraceContext() const { return fTrace; }
+
+    /// message of a part, created on first access. Its buffer is mapped on the first GetData()
+    /// @throw fair::mq::MessageError if the part has been taken out of the view
+    fair::mq::Message& At(size_t i) { return *Materialize(i); }
+    fair::mq::Message& operator[](size_t i) { return At(i); }
+
+    /// moves the message of a part out of the view, the part is neither sent nor released with the view any more
+    /// @throw fair::mq::MessageError if the part has been taken out of the view already
+    MessagePtr Take(size_t i)
+    {
+        Materialize(i);
+        fTaken.at(i) = true;
+        return std::move(fMessages.at(i));
+    }
+
+    /// moves all parts that are still in the view to msgs, as messages
+    void TakeAll(std::vector<MessagePtr>& msgs)
+    {
+        msgs.reserve(msgs.size() + fMetas.size());
+        for (size_t i = 0; i < fMetas.size(); ++i) {
+            if (!fTaken[i]) {
+                msgs.emplace_back(Take(i));
+            }
+        }
+        Reset();
+    }
+
+    /// releases the parts that are still in the view, the managed chunks with one allocator transaction per segment
+    void Clear()
+    {
+        if (fMetas.empty()) {
+            return;
+        }
+        std::vector<std::pair<uint16_t, boost::interprocess::managed_shared_memory::handle_t>> chunks;
+        chunks.reserve(fMetas.size());
+        try {
+            for (size_t i = 0; i < fMetas.size(); ++i) {
+                if (fTaken[i]) {
+                    continue;
+                }
+                if (fMessages[i]) {
+                    static_cast<Message*>(fMessages[i].get())->Release(chunks);
+                } else {
+                    fManager->Disown(fMetas[i]); // recorded by the receive, the message records it again
+                    Message msg(*fManager, fMetas[i], fTransport);
+                    msg.Release(chunks);
+                }
+            }
+            fManager->DeallocateMany(chunks);
+        } catch (SharedMemoryError& sme) {
+            LOG(error) << "error releasing message parts: " << sme.what();
+        } catch (boost::interprocess::lock_exception& le) {
+            LOG(error) << "error releasing message parts: " << le.what();
+        }
+        Reset();
+    }
+
+  private:
+    Manager* fManager = nullptr;
+    fair::mq::TransportFactory* fTransport = nullptr;
+    std::vector<MetaHeader> fMetas;    // as received, each one holds a reference until its part is materialized or sent
+    std::vector<MessagePtr> fMessages; // nullptr: not materialized (or taken)
+    std::vector<bool> fTaken;
+    TraceContext fTrace;
+
+    Message* Materialize(size_t i)
+    {
+        if (fTaken.at(i)) {
+            throw MessageError(tools::ToString("part ", i, " has been taken out of the view"));
+        }
+        if (!fMessages[i]) {
+            fManager->Disown(fMetas[i]); // recorded by the receive, the message records it again
+            fMessages[i] = std::make_unique<Message>(*fManager, fMetas[i], fTransport);
+            fMessages[i]->SetTraceContext(fTrace);
+        }
+        return static_cast<Message*>(fMessages[i].get());
+    }
+
+    // prepares the view for n received parts, as not materialized
+    void Init(Manager& manager, fair::mq::TransportFactory* transport, size_t n)
+    {
+        fManager = &manager;
+        fTransport = transport;
+        fMessages.resize(n);
+        fTaken.assign(n, false);
+    }
+
+    // forgets the parts, without releasing them
+    void Reset()
+    {
+        fMetas.clear();
+        fMessages.clear();
+        fTaken.clear();
+        fTrace = TraceContext();
+    }
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_LAZYPARTS_H_ */
@@ -9,29 +9,45 @@
 #ifndef FAIR_MQ_SHMEM_MANAGER_H_
 #define FAIR_MQ_SHMEM_MANAGER_H_
 
+#include "AckReactor.h"
+#include "AllocTrace.h"
+#include "ChunkLedger.h"
 #include "Common.h"
+#include "DeferredFreeQueue.h"
+#include "Ring.h"
+#include "RobustMutex.h"
 #include "Monitor.h"
 #include "UnmanagedRegion.h"
 #include <fairmq/Message.h>
 #include <fairmq/ProgOptions.h>
+#include <fairmq/StartupProfile.h>
+#include <fairmq/tools/Log.h>
+#include <fairmq/tools/PerThreadCounter.h>
+#include <fairmq/tools/Probes.h>
 #include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Threads.h>
+#include <fairmq/TransportFactory.h>
 #include <fairmq/Transports.h>
 
 #include <fairlogger/Logger.h>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
-#include <boost/interprocess/sync/interprocess_condition.hpp>
-#include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/named_mutex.hpp>
 #include <boost/variant.hpp>
 
 #include <algorithm> // max
+#include <array>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <condition_variable>
+#include <csignal> // kill
 #include <cstddef> // max_align_t
 #include <cstdlib> // getenv
 #include <cstring> // memcpy
+#include <limits>
 #include <memory> // make_unique
 #include <mutex>
 #include <set>
@@ -51,7 +67,7 @@
 namespace fair::mq::shmem
 {
 
-// ShmHeader stores user buffer alignment and the reference count in the following structure:
+// ShmHeader stores user buffer alignment, the reference count and the quota of the producer in the following structure:
 // [HdrOffset(uint16_t)][Hdr alignment][Hdr][user buffer alignment][user buffer]
 // The alignment of Hdr depends on the alignment of std::atomic and is stored in the first entry
 struct ShmHeader
@@ -60,6 +76,7 @@ struct ShmHeader
     {
         uint16_t userOffset;
         std::atomic<uint16_t> refCount;
+        uint16_t quota; // slot in the QuotaTable the chunk is charged to, QuotaTable::kNoQuota if none, QuotaTable::kArenaChunk
     };
 
     static Hdr* HdrPtr(char* ptr)
@@ -94,6 +111,8 @@ struct ShmHeader
         return ptr + HdrPartSize() + HdrPtr(ptr)->userOffset;
     }
 
+    static uint16_t& Quota(char* ptr) { return HdrPtr(ptr)->quota; }
+
     static uint16_t RefCount(char* ptr) { return RefCountPtr(ptr).load(); }
     static uint16_t IncrementRefCount(char* ptr) { return RefCountPtr(ptr).fetch_add(1); }
     static uint16_t DecrementRefCount(char* ptr) { return RefCountPtr(ptr).fetch_sub(1); }
@@ -118,12 +137,65 @@ struct ShmHeader
 
         // offset to the beginning of the user buffer, store in Hdr together with the ref count
         uint16_t userOffset = alignment - ((reinterpret_cast<uintptr_t>(ptr) + HdrPartSize()) % alignment);
-        new(ptr + sizeof(uint16_t) + hdrOffset) Hdr{ userOffset, std::atomic<uint16_t>(1) };
+        new(ptr + sizeof(uint16_t) + hdrOffset) Hdr{ userOffset, std::atomic<uint16_t>(1), QuotaTable::kNoQuota };
     }
 
     static void Destruct(char* ptr) { RefCountPtr(ptr).~atomic(); }
 };
 
+// RefCountTable is the alternative to ShmHeader: the reference counts of a managed segment are kept out of band
+// in a dense table (a separate shared memory object), with one entry per kChunkSize bytes of the segment.
+// Chunks are allocated with at least kChunkSize bytes, so that every chunk maps to a distinct entry,
+// and the user buffer starts directly at the (naturally aligned) address returned by the allocator.
+// The quota slots of the chunks follow the reference counts in the same object.
+class RefCountTable
+{
+  public:
+    static constexpr size_t kChunkSize = 64;
+
+    RefCountTable(const std::string& name, size_t segmentSize, bool create)
+    {
+        using namespace boost::interprocess;
+        if (create) {
+            fObject = shared_memory_object(open_or_create, name.c_str(), read_write);
+            fObject.truncate(static_cast<offset_t>(NumEntries(segmentSize) * kEntrySize));
+        } else {
+            fObject = shared_memory_object(open_only, name.c_str(), read_write);
+        }
+        fRegion = mapped_region(fObject, read_write);
+        fEntries = static_cast<std::atomic<uint16_t>*>(fRegion.get_address());
+        fNumEntries = fRegion.get_size() / kEntrySize;
+        fQuotas = reinterpret_cast<uint16_t*>(fEntries + fNumEntries);
+        if (fNumEntries < NumEntries(segmentSize)) {
+            throw TransportError(tools::ToString("Ref count table ", name, " is too small (", fNumEntries, " entries) for a segment of ", segmentSize, " bytes"));
+        }
+    }
+
+    static std::string Name(const std::string& shmId, uint16_t segmentId) { return "fmq_" + shmId + "_rc_" + std::to_string(segmentId); }
+    static size_t NumEntries(size_t segmentSize) { return (segmentSize + kChunkSize - 1) / kChunkSize; }
+    static size_t FullSize(size_t size) { return std::max(size, kChunkSize); }
+
+    std::atomic<uint16_t>& RefCount(boost::interprocess::managed_shared_memory::handle_t handle) { return fEntries[static_cast<size_t>(handle) / kChunkSize]; }
+    uint16_t& Quota(boost::interprocess::managed_shared_memory::handle_t handle) { return fQuotas[static_cast<size_t>(handle) / kChunkSize]; }
+    void Construct(boost::interprocess::managed_shared_memory::handle_t handle)
+    {
+        RefCount(handle).store(1, std::memory_order_relaxed);
+        Quota(handle) = QuotaTable::kNoQuota;
+    }
+    void Destruct(boost::interprocess::managed_shared_memory::handle_t handle) { RefCount(handle).store(0, std::memory_order_relaxed); }
+
+  private:
+    static constexpr size_t kEntrySize = sizeof(std::atomic<uint16_t>) + sizeof(uint16_t); // ref count + quota slot
+
+    boost::interprocess::shared_memory_object fObject;
+    boost::interprocess::mapped_region fRegion;
+    std::atomic<uint16_t>* fEntries = nullptr;
+    uint16_t* fQuotas = nullptr;
+    size_t fNumEntries = 0;
+};
+
+using SegmentVariant = boost::variant<RBTreeBestFitSegment, SimpleSeqFitSegment, SlabFitSegment>;
+
 class Manager
 {
   public:
@@ -131,9 +203,13 @@ class Manager
         : fShmId64(config ? config->GetProperty<uint64_t>("shmid", makeShmIdUint64(sessionName)) : makeShmIdUint64(sessionName))
         , fShmId(makeShmIdStr(fShmId64))
         , fSegmentId(config ? config->GetProperty<uint16_t>("shm-segment-id", 0) : 0)
-        , fManagementSegment(boost::interprocess::open_or_create, std::string("fmq_" + fShmId + "_mng").c_str(), kManagementSegmentSize)
+        , fManagementSegment(boost::interprocess::open_or_create, std::string("fmq_" + fShmId + "_mng").c_str(), config ? config->GetProperty<size_t>("shm-management-segment-size", kManagementSegmentSize) : kManagementSegmentSize)
         , fShmVoidAlloc(fManagementSegment.get_segment_manager())
-        , fShmMtx(fManagementSegment.find_or_construct<boost::interprocess::interprocess_mutex>(boost::interprocess::unique_instance)())
+        , fShmMtx(fManagementSegment.find_or_construct<RobustMutex>(boost::interprocess::unique_instance)())
+        , fRegionsMtx(fManagementSegment.find_or_construct<RobustMutex>(kRegionTableMtx)())
+#ifdef FAIRMQ_DEBUG_MODE
+        , fDebugMtx(nullptr)
+#endif
         , fNumObservedEvents(0)
         , fDeviceCounter(nullptr)
         , fEventCounter(nullptr)
@@ -146,15 +222,81 @@ class Manager
         , fMsgCounterDelete(0)
 #endif
         , fBeatTheHeart(true)
+        , fHeartbeatIntervalInMs(config ? config->GetProperty<int>("shm-heartbeat-interval", 100) : 100)
+        , fStatsIntervalInMs(config ? config->GetProperty<int>("shm-stats-interval", 0) : 0)
+        , fUsageTable(nullptr)
+        , fPublishUsage(false)
+        , fLivenessTable(nullptr)
+        , fLivenessSlot(-1)
+        , fLedgerTable(nullptr)
+        , fLedgerSlot(-1)
         , fRegionEventsSubscriptionActive(false)
         , fInterrupted(false)
         , fBadAllocMaxAttempts(1)
         , fBadAllocAttemptIntervalInMs(config ? config->GetProperty<int>("bad-alloc-attempt-interval", 50) : 50)
+        , fBadAllocWait(config ? config->GetProperty<bool>("shm-bad-alloc-wait", false) : false)
+        , fBadAllocMaxWaitInMs(config ? config->GetProperty<int>("bad-alloc-max-wait", -1) : -1)
+        , fNumBadAllocs(0)
+        , fNumAllocFailures(0)
+        , fAllocStats(nullptr)
+        , fAllocStatsSampling(config ? config->GetProperty<unsigned int>("shm-alloc-stats", 0) : 0)
+        , fOwnerTable(nullptr)
+        , fOwnerSampling(config ? config->GetProperty<unsigned int>("shm-owner-sampling", 0) : 0)
+        , fOwnerDevice(ChunkOwnerTable::kNoName)
+        , fQuotaTable(nullptr)
+        , fQuota(nullptr)
+        , fQuotaSlot(QuotaTable::kNoQuota)
+        , fDeallocationNotifier(nullptr)
         , fNoCleanup(config ? config->GetProperty<bool>("shm-no-cleanup", false) : false)
+        , fAllocationCacheEnabled(config ? config->GetProperty<bool>("shm-allocation-cache", false) : false)
+        , fAllocationCacheDepth(config ? config->GetProperty<size_t>("shm-allocation-cache-depth", 32) : 32)
+        , fAllocationCacheMaxBytes(config ? config->GetProperty<size_t>("shm-allocation-cache-max-bytes", 0) : 0)
+        , fCacheCounter(nullptr)
+        , fCachedBytes(nullptr)
+        , fLocalCachedBytes(0)
+        , fCacheReleaseRequestsSeen(0)
+        , fWatchCacheReleaseRequests(false)
+        , fNumaNode(config ? config->GetProperty<int>("shm-numa-node", -1) : -1)
+        , fThreadNumaNode(config ? config->GetProperty<int>("shm-thread-numa-node", -1) : -1)
+        , fThreadSettings(config ? tools::ParseThreadSettings(config->GetProperty<std::string>("io-cpu-affinity", ""),
+                                                              config->GetProperty<std::string>("sched-policy", ""),
+                                                              config->GetProperty<int>("sched-priority", -1))
+                                 : tools::ThreadSettings())
+        , fLocalRefCountTable(nullptr)
+        , fSpillOver(SpillOverPolicy::none)
+        , fSpillOverMaxSegments(config ? config->GetProperty<int>("shm-spill-over-max-segments", 0) : 0)
+        , fSpillOverCreatedSegments(0)
+        , fSegmentSize(size)
+        , fSegmentInitAsync(config ? config->GetProperty<bool>("shm-segment-init-async", false) : false)
+        , fSegmentInitThreads(config ? config->GetProperty<int>("shm-segment-init-threads", 1) : 1)
+        , fSegmentInitTotalChunks(0)
+        , fSegmentInitDoneChunks(0)
+        , fSegmentInitialized(false)
+        , fSegmentInitReported(false)
+        , fStopSegmentInit(false)
+        , fMetaRing(config ? config->GetProperty<bool>("shm-meta-ring", false) : false)
+        , fMetaRingCapacity(config ? config->GetProperty<size_t>("shm-meta-ring-capacity", 1024) : 1024)
+        , fWatermarksActive(false)
+        , fDeferredFree(config ? config->GetProperty<bool>("shm-deferred-free", false) : false)
+        , fDeferredFreeMaxBytes(config ? config->GetProperty<size_t>("shm-deferred-free-max-bytes", 64 << 20) : 64 << 20)
+        , fDeferredFreeIntervalInMs(config ? config->GetProperty<int>("shm-deferred-free-interval", 1) : 1)
+        , fDeferredBytes(0)
+        , fDeferredFreeStop(false)
+        , fDeferredFreeWakeup(false)
+        , fPremap(config ? config->GetProperty<bool>("shm-premap", false) : false)
+        , fPremapPrefault(config ? config->GetProperty<bool>("shm-premap-prefault", false) : false)
+        , fPremapActive(false)
+        , fRegionMemfd(config ? config->GetProperty<bool>("shm-region-memfd", false) : false)
+        , fFixedAddress(config ? config->GetProperty<bool>("shm-fixed-address", false) : false)
+        , fFixedAddressFallback(false)
+        , fInlineSize(std::min(config ? config->GetProperty<size_t>("shm-inline-size", 0) : 0, kMaxInlineSize))
     {
         using namespace boost::interprocess;
 
         LOG(debug) << "Generated shmid '" << fShmId << "' out of session id '" << sessionName << "'.";
+        if (config && fManagementSegment.get_size() < config->GetProperty<size_t>("shm-management-segment-size", kManagementSegmentSize)) {
+            LOG(warn) << "The management segment of the session already exists with " << fManagementSegment.get_size() << " bytes, --shm-management-segment-size applies to the first process of a session only.";
+        }
 
         if (config) {
             // if 'shm-throw-bad-alloc' is explicitly set to false (true is default), ignore other settings
@@ -168,32 +310,71 @@ class Manager
             // otherwise leave fBadAllocMaxAttempts at 1 (the original default, set in the initializer list)
         }
 
+        if (config && config->GetProperty<bool>("shm-ack-reactor", false)) {
+            const auto interval = std::chrono::microseconds(std::max(config->GetProperty<int>("shm-ack-reactor-interval", 1000), 1));
+            fAckReactor = std::make_unique<AckReactor>(interval, fThreadNumaNode, fThreadSettings);
+        }
+
         bool mlockSegment = false;
         bool mlockSegmentOnCreation = false;
         bool zeroSegment = false;
         bool zeroSegmentOnCreation = false;
+        bool hugepagesSegment = false;
+        bool prefaultSegment = false;
+        bool refCountTable = false;
         bool autolaunchMonitor = false;
+        bool reclaim = false;
+        size_t ledgerSlots = 65536;
         std::string allocationAlgorithm("rbtree_best_fit");
+        std::string spillOver("none");
+        std::string liveness("heartbeat");
         if (config) {
             mlockSegment = config->GetProperty<bool>("shm-mlock-segment", mlockSegment);
             mlockSegmentOnCreation = config->GetProperty<bool>("shm-mlock-segment-on-creation", mlockSegmentOnCreation);
             zeroSegment = config->GetProperty<bool>("shm-zero-segment", zeroSegment);
             zeroSegmentOnCreation = config->GetProperty<bool>("shm-zero-segment-on-creation", zeroSegmentOnCreation);
+            hugepagesSegment = config->GetProperty<bool>("shm-segment-hugepages", hugepagesSegment);
+            prefaultSegment = config->GetProperty<bool>("shm-prefault-segment", prefaultSegment);
+            refCountTable = config->GetProperty<bool>("shm-refcount-table", refCountTable);
             autolaunchMonitor = config->GetProperty<bool>("shm-monitor", autolaunchMonitor);
             allocationAlgorithm = config->GetProperty<std::string>("shm-allocation", allocationAlgorithm);
+            spillOver = config->GetProperty<std::string>("shm-spill-over", spillOver);
+            liveness = config->GetProperty<std::string>("shm-liveness", liveness);
+            reclaim = config->GetProperty<bool>("shm-reclaim", reclaim);
+            ledgerSlots = config->GetProperty<size_t>("shm-reclaim-slots", ledgerSlots);
         } else {
             LOG(debug) << "ProgOptions not available! Using defaults.";
         }
 
+        if (spillOver == "free-memory") {
+            fSpillOver = SpillOverPolicy::free_memory;
+        } else if (spillOver == "numa") {
+            fSpillOver = SpillOverPolicy::numa;
+        } else if (spillOver != "none") {
+            LOG(error) << "Provided shared memory spill-over policy '" << spillOver << "' is not supported. Supported are 'none'/'free-memory'/'numa'";
+            throw TransportError(tools::ToString("Provided shared memory spill-over policy '", spillOver, "' is not supported. Supported are 'none'/'free-memory'/'numa'"));
+        }
+
+        if (liveness != "heartbeat" && liveness != "pid") {
+            LOG(error) << "Provided shared memory liveness mechanism '" << liveness << "' is not supported. Supported are 'heartbeat'/'pid'";
+            throw TransportError(tools::ToString("Provided shared memory liveness mechanism '", liveness, "' is not supported. Supported are 'heartbeat'/'pid'"));
+        }
+        if (fHeartbeatIntervalInMs <= 0) {
+            throw TransportError(tools::ToString("Shared memory heartbeat interval must be positive, provided: ", fHeartbeatIntervalInMs));
+        }
+
         if (autolaunchMonitor) {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*fShmMtx);
+            boost::interprocess::scoped_lock<RobustMutex> lock(*fShmMtx);
             StartMonitor(fShmId);
         }
 
-        fHeartbeatThread = std::thread(&Manager::Heartbeats, this);
+        if (liveness == "heartbeat" || fStatsIntervalInMs > 0) {
+            fHeartbeatThread = std::thread(&Manager::Heartbeats, this, liveness == "heartbeat");
+        }
 
+        std::vector<size_t> deadLedgers;
         try {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*fShmMtx);
+            boost::interprocess::scoped_lock<RobustMutex> lock(*fShmMtx);
 
             SessionInfo* sessionInfo = fManagementSegment.find<SessionInfo>(unique_instance).first;
             if (sessionInfo) {
@@ -226,73 +407,184 @@ class Manager
 
             fShmSegments = fManagementSegment.find_or_construct<Uint16SegmentInfoHashMap>(unique_instance)(fShmVoidAlloc);
             fShmRegions = fManagementSegment.find_or_construct<Uint16RegionInfoHashMap>(unique_instance)(fShmVoidAlloc);
+            fDeallocationNotifier = fManagementSegment.find_or_construct<DeallocationNotifier>(unique_instance)();
 
             bool createdSegment = false;
 
+            const auto segmentStart = std::chrono::steady_clock::now();
             try {
                 std::string segmentName("fmq_" + fShmId + "_m_" + std::to_string(fSegmentId));
                 auto it = fShmSegments->find(fSegmentId);
                 if (it == fShmSegments->end()) {
                     // no segment with given id exists, creating
-                    if (allocationAlgorithm == "rbtree_best_fit") {
-                        fSegments.emplace(fSegmentId, RBTreeBestFitSegment(open_or_create, segmentName.c_str(), size));
-                        fShmSegments->emplace(fSegmentId, AllocationAlgorithm::rbtree_best_fit);
-                    } else if (allocationAlgorithm == "simple_seq_fit") {
-                        fSegments.emplace(fSegmentId, SimpleSeqFitSegment(open_or_create, segmentName.c_str(), size));
-                        fShmSegments->emplace(fSegmentId, AllocationAlgorithm::simple_seq_fit);
-                    }
-                    if (mlockSegmentOnCreation) {
+                    CreateSegment(fSegmentId, size, allocationAlgorithm, refCountTable);
+                    if (mlockSegmentOnCreation && !fSegmentInitAsync) {
                         MlockSegment(fSegmentId);
                     }
-                    if (zeroSegmentOnCreation) {
+                    if (zeroSegmentOnCreation && !fSegmentInitAsync) {
                         ZeroSegment(fSegmentId);
                     }
                     createdSegment = true;
                 } else {
                     // found segment with the given id, opening
+                    const void* address = reinterpret_cast<void*>(it->second.fAddress);
                     if (it->second.fAllocationAlgorithm == AllocationAlgorithm::rbtree_best_fit) {
-                        fSegments.emplace(fSegmentId, RBTreeBestFitSegment(open_or_create, segmentName.c_str(), size));
+                        EmplaceSegment<RBTreeBestFitSegment>(fSegmentId, address, open_or_create, segmentName.c_str(), size);
                         if (allocationAlgorithm != "rbtree_best_fit") {
                             LOG(warn) << "Allocation algorithm of the opened segment is rbtree_best_fit, but requested is " << allocationAlgorithm << ". Ignoring requested setting.";
                             allocationAlgorithm = "rbtree_best_fit";
                         }
+                    } else if (it->second.fAllocationAlgorithm == AllocationAlgorithm::slab_fit) {
+                        EmplaceSegment<SlabFitSegment>(fSegmentId, address, open_or_create, segmentName.c_str(), size);
+                        if (allocationAlgorithm != "slab_fit") {
+                            LOG(warn) << "Allocation algorithm of the opened segment is slab_fit, but requested is " << allocationAlgorithm << ". Ignoring requested setting.";
+                            allocationAlgorithm = "slab_fit";
+                        }
                     } else {
-                        fSegments.emplace(fSegmentId, SimpleSeqFitSegment(open_or_create, segmentName.c_str(), size));
+                        EmplaceSegment<SimpleSeqFitSegment>(fSegmentId, address, open_or_create, segmentName.c_str(), size);
                         if (allocationAlgorithm != "simple_seq_fit") {
                             LOG(warn) << "Allocation algorithm of the opened segment is simple_seq_fit, but requested is " << allocationAlgorithm << ". Ignoring requested setting.";
                             allocationAlgorithm = "simple_seq_fit";
                         }
                     }
+                    RegisterSegment(fSegmentId, it->second.fRefCountTable ? OpenRefCountTable(fSegmentId, false) : nullptr);
+                    if (it->second.fRefCountTable != refCountTable) {
+                        LOG(warn) << "Message ref counts of the opened segment are stored " << (it->second.fRefCountTable ? "in a ref count table" : "in chunk headers")
+                                  << ", but requested is " << (refCountTable ? "a ref count table" : "chunk headers") << ". Ignoring requested setting.";
+                    }
                 }
                 LOG(debug) << (createdSegment ? "Created" : "Opened") << " managed shared memory segment " << "fmq_" << fShmId << "_m_" << fSegmentId
-                    << ". Size: " << boost::apply_visitor(SegmentSize(), fSegments.at(fSegmentId)) << " bytes."
-                    << " Available: " << boost::apply_visitor(SegmentFreeMemory(), fSegments.at(fSegmentId)) << " bytes."
-                    << " Allocation algorithm: " << allocationAlgorithm;
+                    << ". Size: " << boost::apply_visitor(SegmentSize(), SegmentRef(fSegmentId)) << " bytes."
+                    << " Available: " << boost::apply_visitor(SegmentFreeMemory(), SegmentRef(fSegmentId)) << " bytes."
+                    << " Allocation algorithm: " << allocationAlgorithm << "."
+                    << " Ref counts: " << (fLocalRefCountTable ? "table" : "header");
+                fSegmentSize = boost::apply_visitor(SegmentSize(), SegmentRef(fSegmentId));
+                fAllocationAlgorithm = allocationAlgorithm;
             } catch (interprocess_exception& bie) {
                 LOG(error) << "Failed to create/open shared memory segment '" << "fmq_" << fShmId << "_m_" << fSegmentId << "': " << bie.what();
                 throw TransportError(tools::ToString("Failed to create/open shared memory segment '", "fmq_", fShmId, "_m_", fSegmentId, "': ", bie.what()));
             }
+            StartupProfile::Add(createdSegment ? "shm-segment-create" : "shm-segment-open", segmentStart, std::chrono::steady_clock::now());
 
-            if (mlockSegment) {
-                MlockSegment(fSegmentId);
+            if (hugepagesSegment) {
+                AdviseHugePagesSegment(fSegmentId);
             }
-            if (zeroSegment) {
-                ZeroSegment(fSegmentId);
+            if (fNumaNode >= 0) {
+                BindSegmentToNumaNode(fSegmentId);
+            }
+            if (fSegmentInitAsync) {
+                // the segment is usable right away, the (chunked, parallel) initialization runs in the background
+                bool mlock = mlockSegment || (createdSegment && mlockSegmentOnCreation);
+                bool zero = zeroSegment || (createdSegment && zeroSegmentOnCreation);
+                fSegmentInitThread = std::thread(&Manager::InitSegment, this, fSegmentId, prefaultSegment, mlock, zero);
+            } else if (prefaultSegment || mlockSegment || zeroSegment) {
+                StartupProfile::Scope phase("shm-segment-init");
+                if (prefaultSegment) {
+                    InitSegment(fSegmentId, true, false, false);
+                }
+                if (mlockSegment) {
+                    MlockSegment(fSegmentId);
+                }
+                if (zeroSegment) {
+                    ZeroSegment(fSegmentId);
+                }
             }
 
             if (createdSegment) {
-                (fEventCounter->fCount)++;
+                fEventCounter->Increment(fSegmentId, true, false);
+            }
+
+            if (config) {
+                InitAllocRoutes(config->GetProperty<std::string>("shm-alloc-policy", ""), refCountTable);
+            }
+
+            fAllocStats = &((*fManagementSegment.find_or_construct<Uint16SegmentAllocStatsHashMap>(unique_instance)(fShmVoidAlloc))[fSegmentId]);
+            if (fAllocStatsSampling > 0) {
+                LOG(debug) << "Sampling every " << fAllocStatsSampling << ". allocation for the allocator statistics.";
+            }
+            const std::string allocTrace = config ? config->GetProperty<std::string>("shm-alloc-trace", "") : "";
+            if (!allocTrace.empty()) {
+                const std::string traceFile = tools::ToString(allocTrace, ".", getpid());
+                fAllocTrace = std::make_unique<AllocTraceWriter>(traceFile);
+                LOG(debug) << "Tracing the allocations of the process to " << traceFile << ".";
+            }
+
+            if (liveness == "pid") {
+                fLivenessTable = fManagementSegment.find_or_construct<LivenessTable>(unique_instance)();
+                fLivenessSlot = fLivenessTable->Add(getpid());
+                if (fLivenessSlot < 0) {
+                    throw TransportError(tools::ToString("Shared memory liveness table is full (", LivenessTable::kNumSlots, " processes), use heartbeats"));
+                }
+                LOG(debug) << "Using pid based liveness instead of heartbeats.";
+            }
+
+            fOwnerTable = fManagementSegment.find_or_construct<ChunkOwnerTable>(unique_instance)();
+            if (fOwnerSampling > 0) {
+                std::string deviceId = config->GetProperty<std::string>("id", "");
+                fOwnerDevice = AddOwnerName(deviceId.empty() ? "pid " + std::to_string(getpid()) : deviceId, fOwnerSampling);
+                LOG(debug) << "Tagging every " << fOwnerSampling << ". allocation with its owner for the usage view of the monitor.";
+            }
+
+            fQuotaTable = fManagementSegment.find_or_construct<QuotaTable>(unique_instance)();
+            fUsageTable = fManagementSegment.find_or_construct<UsageTable>(unique_instance)();
+            size_t quotaSoft = config ? config->GetProperty<size_t>("shm-quota-soft", 0) : 0;
+            size_t quotaHard = config ? config->GetProperty<size_t>("shm-quota-hard", 0) : 0;
+            if (quotaSoft > 0 || quotaHard > 0) {
+                std::string deviceId = config->GetProperty<std::string>("id", "");
+                AddQuota(deviceId.empty() ? "pid " + std::to_string(getpid()) : deviceId, quotaSoft, quotaHard);
+                LOG(debug) << "Managed segment quota of this device: soft " << quotaSoft << " bytes, hard " << quotaHard << " bytes.";
+            }
+
+            // also without a cache of its own, the process asks the others to return theirs when the segment is full
+            fCacheCounter = &((*fManagementSegment.find_or_construct<Uint16SegmentCacheCounterHashMap>(unique_instance)(fShmVoidAlloc))[fSegmentId]);
+            if (fAllocationCacheEnabled && fAllocationCacheDepth > 0) {
+                fCachedBytes = &(fCacheCounter->fBytes);
+                if (fAllocationCacheMaxBytes == 0) {
+                    fAllocationCacheMaxBytes = boost::apply_visitor(SegmentSize(), SegmentRef(fSegmentId)) / 8;
+                }
+                fCacheReleaseRequestsSeen = fCacheCounter->fReleaseRequests.load(std::memory_order_relaxed);
+                fWatchCacheReleaseRequests.store(true, std::memory_order_release);
+                LOG(debug) << "Allocation cache enabled with depth of " << fAllocationCacheDepth << " buffers per size class, up to " << fAllocationCacheMaxBytes << " bytes.";
+            } else {
+                fAllocationCacheEnabled = false;
             }
 
 #ifdef FAIRMQ_DEBUG_MODE
+            fDebugMtx = fManagementSegment.find_or_construct<RobustMutex>(kDebugMapsMtx)();
             fMsgDebug = fManagementSegment.find_or_construct<Uint16MsgDebugMapHashMap>(unique_instance)(fShmVoidAlloc);
             fShmMsgCounters = fManagementSegment.find_or_construct<Uint16MsgCounterHashMap>(unique_instance)(fShmVoidAlloc);
 #endif
+
+            if (fDeferredFree) {
+                fDeferredFrees = std::make_unique<DeferredFreeQueue>(kDeferredFreeQueueCapacity);
+                fDeferredFreeThread = std::thread(&Manager::FreeDeferred, this);
+                LOG(debug) << "Deferring deallocations to a background thread, up to " << fDeferredFreeMaxBytes << " bytes.";
+            }
+
+            if (reclaim) {
+                fLedgerTable = fManagementSegment.find_or_construct<LedgerTable>(unique_instance)();
+                deadLedgers = ClaimDeadLedgers();
+                fLedgerSlot = fLedgerTable->Add(getpid());
+                if (fLedgerSlot < 0) {
+                    throw TransportError(tools::ToString("Shared memory ledger table is full (", LedgerTable::kNumSlots, " processes), cannot use --shm-reclaim"));
+                }
+                fLedger = std::make_unique<ChunkLedger>(LedgerTable::Name(fShmId, fLedgerSlot), ledgerSlots, true);
+                LOG(debug) << "Recording the held chunks in ledger " << fLedgerSlot << " for the reclamation after a crash.";
+            }
         } catch (...) {
             StopHeartbeats();
+            RemoveFromLivenessTable();
+            RemoveLedger();
             CleanupIfLast();
             throw;
         }
+
+        // outside of the management mutex, releasing chunks may take it
+        for (size_t slot : deadLedgers) {
+            Reclaim(slot);
+        }
+
+        fPublishUsage.store(fStatsIntervalInMs > 0, std::memory_order_release);
     }
 
     Manager() = delete;
@@ -304,20 +596,113 @@ class Manager
     void ZeroSegment(uint16_t id)
     {
         LOG(debug) << "Zeroing the managed segment free memory...";
-        boost::apply_visitor(SegmentMemoryZeroer(), fSegments.at(id));
+        boost::apply_visitor(SegmentMemoryZeroer(), SegmentRef(id));
         LOG(debug) << "Successfully zeroed the managed segment free memory.";
     }
 
+    // pre-faults, mlocks and zeroes the segment in chunks, using fSegmentInitThreads threads.
+    // Zeroing (of the free memory) takes the segment lock, the other steps are safe while the segment is in use.
+    void InitSegment(uint16_t id, bool prefault, bool mlock, bool zero)
+    {
+        auto start = std::chrono::steady_clock::now();
+        char* base = static_cast<char*>(boost::apply_visitor(SegmentAddress(), SegmentRef(id)));
+        size_t size = boost::apply_visitor(SegmentSize(), SegmentRef(id));
+        const size_t numChunks = (prefault || mlock) ? (size + kSegmentInitChunkSize - 1) / kSegmentInitChunkSize : 0;
+        fSegmentInitTotalChunks = numChunks;
+
+        if (zero) {
+            ZeroSegment(id);
+        }
+
+        std::atomic<size_t> nextChunk(0);
+        std::atomic<bool> mlockFailed(false);
+        auto worker = [&]() {
+            for (size_t c = nextChunk++; c < numChunks && !fStopSegmentInit; c = nextChunk++) {
+                char* ptr = base + c * kSegmentInitChunkSize;
+                size_t len = std::min(kSegmentInitChunkSize, size - c * kSegmentInitChunkSize);
+                if (prefault) {
+                    PrefaultMemory(ptr, len);
+                }
+                if (mlock && ::mlock(ptr, len) == -1 && !mlockFailed.exchange(true)) {
+                    LOG(error) << "Could not lock the managed segment memory. Code: " << errno << ", reason: " << strerror(errno);
+                }
+                size_t done = ++fSegmentInitDoneChunks;
+                if (done * 10 / numChunks != (done - 1) * 10 / numChunks) {
+                    LOG(debug) << "Initializing managed segment " << id << ": " << done * 100 / numChunks << "%";
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int i = 1; i < fSegmentInitThreads; ++i) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& w : workers) {
+            w.join();
+        }
+
+        if (fStopSegmentInit || !fSegmentInitAsync) {
+            return;
+        }
+        LOG(debug) << "Initialized managed segment " << id << " (prefault: " << prefault << ", mlock: " << mlock << ", zero: " << zero << ") in "
+                   << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << "ms, using " << std::max(fSegmentInitThreads, 1) << " thread(s).";
+        {
+            std::lock_guard<std::mutex> lock(fRegionEventsMtx);
+            fSegmentInitialized = true;
+        }
+        fEventCounter->Notify();
+    }
+
+    // fraction of the segment initialization (prefault/mlock) that has been completed
+    double SegmentInitProgress() const
+    {
+        if (fSegmentInitialized || fSegmentInitTotalChunks == 0) {
+            return fSegmentInitialized || !fSegmentInitAsync ? 1.0 : 0.0;
+        }
+        return static_cast<double>(fSegmentInitDoneChunks) / fSegmentInitTotalChunks;
+    }
+    bool SegmentInitialized() const { return fSegmentInitialized || !fSegmentInitAsync; }
+
     void MlockSegment(uint16_t id)
     {
         LOG(debug) << "Locking the managed segment memory pages...";
-        if (mlock(boost::apply_visitor(SegmentAddress(), fSegments.at(id)), boost::apply_visitor(SegmentSize(), fSegments.at(id))) == -1) {
+        if (mlock(boost::apply_visitor(SegmentAddress(), SegmentRef(id)), boost::apply_visitor(SegmentSize(), SegmentRef(id))) == -1) {
             LOG(error) << "Could not lock the managed segment memory. Code: " << errno << ", reason: " << strerror(errno);
             throw TransportError(tools::ToString("Could not lock the managed segment memory: ", strerror(errno)));
         }
         LOG(debug) << "Successfully locked the managed segment memory pages.";
     }
 
+    void BindSegmentToNumaNode(uint16_t id)
+    {
+        LOG(debug) << "Binding the managed segment memory to NUMA node " << fNumaNode << "...";
+        if (!BindToNumaNode(boost::apply_visitor(SegmentAddress(), SegmentRef(id)), boost::apply_visitor(SegmentSize(), SegmentRef(id)), fNumaNode)) {
+            LOG(error) << "Could not bind the managed segment memory to NUMA node " << fNumaNode << ". Code: " << errno << ", reason: " << strerror(errno);
+            throw TransportError(tools::ToString("Could not bind the managed segment memory to NUMA node ", fNumaNode, ": ", strerror(errno)));
+        }
+        LOG(debug) << "Successfully bound the managed segment memory to NUMA node " << fNumaNode << ".";
+    }
+
+    void AdviseHugePagesSegment(uint16_t id)
+    {
+        // managed segments live on /dev/shm, so huge pages come from the transparent huge page support for shmem
+        std::string thpMode = GetShmemThpMode();
+        if (thpMode.empty() || thpMode == "never" || thpMode == "deny") {
+            LOG(error) << "Huge pages requested for the managed segment, but transparent huge pages for shared memory are " << (thpMode.empty() ? "not supported" : thpMode)
+                       << ". Set /sys/kernel/mm/transparent_hugepage/shmem_enabled to 'advise' or 'always'.";
+            throw TransportError(tools::ToString("Huge pages requested for the managed segment, but transparent huge pages for shared memory are ", (thpMode.empty() ? "not supported" : thpMode),
+                                                 ". Set /sys/kernel/mm/transparent_hugepage/shmem_enabled to 'advise' or 'always'."));
+        }
+        LOG(debug) << "Advising huge pages for the managed segment memory (shmem_enabled: " << thpMode << ")...";
+#ifdef MADV_HUGEPAGE
+        if (madvise(boost::apply_visitor(SegmentAddress(), SegmentRef(id)), boost::apply_visitor(SegmentSize(), SegmentRef(id)), MADV_HUGEPAGE) == -1) {
+            LOG(error) << "Could not advise huge pages for the managed segment memory. Code: " << errno << ", reason: " << strerror(errno);
+            throw TransportError(tools::ToString("Could not advise huge pages for the managed segment memory: ", strerror(errno)));
+        }
+#endif
+        LOG(debug) << "Successfully advised huge pages for the managed segment memory.";
+    }
+
   private:
     static bool SpawnShmMonitor(const std::string& id);
 
@@ -350,7 +735,15 @@ class Manager
         }
     }
 
-    void Interrupt() { fInterrupted.store(true); }
+    void Interrupt()
+    {
+        fInterrupted.store(true);
+        if (fBadAllocWait) {
+            // wake up allocations waiting for deallocations, so that they notice the interruption
+            boost::interprocess::scoped_lock<RobustMutex> lock(fDeallocationNotifier->fMtx);
+            fDeallocationNotifier->fCV.notify_all();
+        }
+    }
     void Resume() { fInterrupted.store(false); }
     void Reset()
     {
@@ -364,37 +757,98 @@ class Manager
     }
     bool Interrupted() { return fInterrupted.load(); }
 
+    bool MetaRingEnabled() const { return fMetaRing; }
+    // Attaches to the meta header rings of one direction of a connection (found or created in the management segment),
+    // returns their keys and the rings. Every attachment is undone with DetachMetaRing(), the last one destroys the ring.
+    // key is derived from the full address. For tcp, wildcardKey is the key of a wildcard bind on the same port:
+    // connecting sockets use the wildcard ring if it exists, and a wildcard bind (key == wildcardKey) also takes the rings
+    // that sockets connecting to one of the host addresses created before the bind.
+    std::vector<std::pair<std::string, MetaRing*>> AttachMetaRings(const std::string& key, const std::string& wildcardKey)
+    {
+        using namespace boost::interprocess;
+        const std::string prefix("fmq_meta_ring_");
+        try {
+            scoped_lock<RobustMutex> lock(*fShmMtx);
+            std::vector<std::string> keys;
+            if (!wildcardKey.empty() && key != wildcardKey && fManagementSegment.find<MetaRing>((prefix + wildcardKey).c_str()).first) {
+                keys.push_back(wildcardKey);
+            } else {
+                keys.push_back(key);
+            }
+            if (!wildcardKey.empty() && key == wildcardKey) {
+                // tcp_*_<port>.<direction> -> tcp_<host>_<port>.<direction>
+                const std::string portSuffix(wildcardKey.substr(wildcardKey.find('*') + 1));
+                for (auto it = fManagementSegment.named_begin(); it != fManagementSegment.named_end(); ++it) {
+                    std::string name(it->name(), it->name_length());
+                    if (name.rfind(prefix + "tcp_", 0) == 0 && name.size() > portSuffix.size()
+                     && name.compare(name.size() - portSuffix.size(), portSuffix.size(), portSuffix) == 0 && name != prefix + wildcardKey) {
+                        keys.push_back(name.substr(prefix.size()));
+                    }
+                }
+            }
+
+            std::vector<std::pair<std::string, MetaRing*>> rings;
+            for (const auto& k : keys) {
+                std::string name(prefix + k);
+                MetaRing* ring = fManagementSegment.find<MetaRing>(name.c_str()).first;
+                if (!ring) {
+                    ring = fManagementSegment.construct<MetaRing>(name.c_str())(fMetaRingCapacity, fManagementSegment.get_segment_manager());
+                    LOG(debug) << "Created meta header ring '" << name << "' with capacity " << ring->Capacity();
+                }
+                ++(ring->fAttached);
+                rings.emplace_back(k, ring);
+            }
+            return rings;
+        } catch (interprocess_exception& e) {
+            LOG(error) << "Failed to attach to meta header ring '" << prefix << key << "': " << e.what();
+            throw TransportError(tools::ToString("Failed to attach to meta header ring '", prefix, key, "': ", e.what()));
+        }
+    }
+
+    // undoes one AttachMetaRings() attachment. The last one destroys the ring,
+    // the meta headers of the messages that were not received are appended to leftover.
+    void DetachMetaRing(const std::string& key, std::vector<MetaHeader>& leftover)
+    {
+        using namespace boost::interprocess;
+        std::string name("fmq_meta_ring_" + key);
+        try {
+            scoped_lock<RobustMutex> lock(*fShmMtx);
+            MetaRing* ring = fManagementSegment.find<MetaRing>(name.c_str()).first;
+            if (!ring || --(ring->fAttached) > 0) {
+                return;
+            }
+            while (ring->TryPop(leftover) > 0) {}
+            fManagementSegment.destroy<MetaRing>(name.c_str());
+            LOG(debug) << "Destroyed meta header ring '" << name << "'";
+        } catch (interprocess_exception& e) {
+            LOG(error) << "Failed to detach from meta header ring '" << name << "': " << e.what();
+        }
+    }
+
     std::pair<UnmanagedRegion*, uint16_t> CreateRegion(size_t size,
                                                        RegionCallback callback,
                                                        RegionBulkCallback bulkCallback,
                                                        RegionConfig cfg)
     {
         using namespace boost::interprocess;
+        if (fRegionMemfd && cfg.path.empty() && cfg.gpuDevice < 0 && cfg.fd < 0 && cfg.maxSize == 0 && cfg.removeOnDestruction) {
+            cfg.memfd = true;
+        }
         try {
             std::pair<UnmanagedRegion*, uint16_t> result;
 
             {
-                boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> shmLock(*fShmMtx);
-
                 if (!cfg.id.has_value()) {
-                    RegionCounter* rc = fManagementSegment.find<RegionCounter>(unique_instance).first;
-
-                    if (rc) {
-                        LOG(trace) << "region counter found, with value of " << rc->fCount << ". incrementing.";
-                        (rc->fCount)++;
-                        LOG(trace) << "incremented region counter, now: " << rc->fCount;
-                    } else {
-                        LOG(trace) << "no region counter found, creating one and initializing with 1024";
-                        rc = fManagementSegment.construct<RegionCounter>(unique_instance)(1024);
-                        LOG(trace) << "initialized region counter with: " << rc->fCount;
-                    }
-
-                    cfg.id = rc->fCount;
+                    // automatic ids start at 1024
+                    RegionCounter* rc = fManagementSegment.find_or_construct<RegionCounter>(unique_instance)(1023);
+                    cfg.id = ++(rc->fCount);
+                    LOG(trace) << "incremented region counter, now: " << cfg.id.value();
                 }
 
                 const uint16_t id = cfg.id.value();
 
                 std::lock_guard<std::mutex> lock(fLocalRegionsMtx);
+                boost::interprocess::scoped_lock<RobustMutex> regionsLock(*fRegionsMtx);
 
                 UnmanagedRegion* region = nullptr;
 
@@ -409,8 +863,11 @@ class Manager
                     LOG(debug) << "Unmanaged region (view) already present, promoting to controller";
                     region->BecomeController(cfg);
                 } else {
-                    auto res = fRegions.emplace(id, std::make_unique<UnmanagedRegion>(fShmId, size, true, cfg));
+                    const size_t mappedSize = cfg.maxSize > 0 ? cfg.maxSize : (size > 0 ? size : cfg.size);
+                    void* address = fFixedAddress && cfg.gpuDevice < 0 ? ReserveFixedAddress(mappedSize) : nullptr;
+                    auto res = fRegions.emplace(id, std::make_unique<UnmanagedRegion>(fShmId, size, true, cfg, tools::GpuIpcHandle{}, address));
                     region = res.first->second.get();
+                    NoteFixedAddress(address, region->GetData());
                 }
                 // LOG(debug) << "Created region with id '" << id << "', path: '" << cfg.path << "', flags: '" << cfg.creationFlags << "'";
 
@@ -418,6 +875,8 @@ class Manager
                 if (callback || bulkCallback) {
                     region->SetCallbacks(callback, bulkCallback);
                     region->InitializeQueues();
+                    region->SetDefaultThreadSettings(fThreadNumaNode, fThreadSettings);
+                    region->SetAckReactor(fAckReactor.get());
                     region->StartAckSender();
                     region->StartAckReceiver();
                 }
@@ -468,18 +927,39 @@ class Manager
         } else {
             try {
                 RegionConfig cfg;
+                tools::GpuIpcHandle gpuIpcHandle{};
+                void* address = nullptr;
                 // get region info
                 {
-                    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> shmLock(*fShmMtx);
+                    boost::interprocess::scoped_lock<RobustMutex> regionsLock(*fRegionsMtx);
                     RegionInfo regionInfo = fShmRegions->at(id);
                     cfg.id = id;
                     cfg.creationFlags = regionInfo.fCreationFlags;
                     cfg.path = regionInfo.fPath.c_str();
+                    cfg.ackBunchSize = regionInfo.fAckBunchSize;
+                    cfg.ackMaxDelayUs = regionInfo.fAckMaxDelayUs;
+                    cfg.ackAdaptive = regionInfo.fAckAdaptive;
+                    cfg.ackRing = regionInfo.fAckRing;
+                    cfg.refCountSlots = regionInfo.fRefCountSlots;
+                    cfg.gpuRegister = regionInfo.fGpuRegister;
+                    cfg.gpuDevice = regionInfo.fGpuDevice;
+                    cfg.memfd = regionInfo.fMemfd;
+                    cfg.fdOffset = regionInfo.fFdOffset;
+                    cfg.ringBuffer = regionInfo.fRingBuffer;
+                    cfg.crossHost = regionInfo.fCrossHost;
+                    cfg.slotSize = regionInfo.fSlotSize;
+                    cfg.maxSize = regionInfo.fMaxSize;
+                    cfg.size = regionInfo.fSize;
+                    gpuIpcHandle = regionInfo.fGpuIpcHandle;
+                    address = reinterpret_cast<void*>(regionInfo.fAddress);
                 }
                 // LOG(debug) << "Located remote region with id '" << id << "', path: '" << cfg.path << "', flags: '" << cfg.creationFlags << "'";
 
-                auto r = fRegions.emplace(id, std::make_unique<UnmanagedRegion>(fShmId, 0, false, std::move(cfg)));
+                auto r = fRegions.emplace(id, std::make_unique<UnmanagedRegion>(fShmId, 0, false, std::move(cfg), gpuIpcHandle, address));
+                NoteFixedAddress(address, r.first->second->GetData());
                 r.first->second->InitializeQueues();
+                r.first->second->SetDefaultThreadSettings(fThreadNumaNode, fThreadSettings);
+                r.first->second->SetAckReactor(fAckReactor.get());
                 r.first->second->StartAckSender();
                 return r.first->second.get();
             } catch (std::out_of_range& oor) {
@@ -493,32 +973,216 @@ class Manager
         }
     }
 
-    void RemoveRegion(uint16_t id)
+    void RemoveRegion(uint16_t id) { RemoveRegions({id}); }
+
+    // resizes an own region (RegionConfig::maxSize) and tells the session via a resized region event
+    bool ResizeRegion(uint16_t id, size_t size)
+    {
+        UnmanagedRegion* region = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(fLocalRegionsMtx);
+            auto it = fRegions.find(id);
+            if (it != fRegions.end()) {
+                region = it->second.get();
+            }
+        }
+        if (!region || !region->Resize(size)) {
+            return false;
+        }
+        {
+            boost::interprocess::scoped_lock<RobustMutex> regionsLock(*fRegionsMtx);
+            auto it = fShmRegions->find(id);
+            if (it != fShmRegions->end()) {
+                it->second.fSize = size;
+            }
+        }
+        fEventCounter->Increment(id, false, false, true);
+        return true;
+    }
+
+    // removes the regions together: their ack threads linger concurrently, until one deadline (the longest linger of them)
+    void RemoveRegions(const std::vector<uint16_t>& ids)
     {
         try {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> shmLock(*fShmMtx);
             std::lock_guard<std::mutex> lock(fLocalRegionsMtx);
-            fRegions.at(id)->StopAcks();
-            {
+            std::vector<uint16_t> found;
+            uint32_t linger = 0;
+            for (uint16_t id : ids) {
+                auto it = fRegions.find(id);
+                if (it == fRegions.end()) {
+                    LOG(debug) << "RemoveRegion() could not locate region with id '" << id << "'";
+                    continue;
+                }
+                found.push_back(id);
+                linger = std::max(linger, it->second->GetLinger());
+            }
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(linger);
+            for (uint16_t id : found) {
+                fRegions.at(id)->RequestStopAcks(deadline);
+            }
+            for (uint16_t id : found) {
+                fRegions.at(id)->StopAcks();
                 if (fRegions.at(id)->RemoveOnDestruction()) {
+                    // the region table is not locked during the linger above
+                    boost::interprocess::scoped_lock<RobustMutex> regionsLock(*fRegionsMtx);
                     fShmRegions->at(id).fDestroyed = true;
-                    (fEventCounter->fCount)++;
+                    fEventCounter->Increment(id, false, true);
                 }
                 fRegions.erase(id);
             }
         } catch (std::out_of_range& oor) {
-            LOG(debug) << "RemoveRegion() could not locate region with id '" << id << "'";
+            LOG(debug) << "RemoveRegions() could not locate region info: " << oor.what();
         }
         fRegionsGen += 1; // signal TL cache invalidation
     }
 
+    std::vector<TransportMetric> GetMetrics()
+    {
+        std::vector<TransportMetric> metrics;
+        const std::string segment = std::to_string(fSegmentId);
+        auto& seg = SegmentRef(fSegmentId);
+        metrics.push_back({"shm_segment_size_bytes", "Size of the managed segment", {{"segment", segment}}, double(boost::apply_visitor(SegmentSize(), seg))});
+        metrics.push_back({"shm_segment_free_bytes", "Free memory of the managed segment", {{"segment", segment}}, double(boost::apply_visitor(SegmentFreeMemory(), seg))});
+        if (fDeferredFree) {
+            metrics.push_back({"shm_deferred_free_bytes", "Released bytes waiting for the deallocation thread", {}, double(fDeferredBytes.load(std::memory_order_relaxed))});
+        }
+        if (fCachedBytes) {
+            metrics.push_back({"shm_allocation_cache_bytes", "Bytes held in the allocation caches of the segment", {{"segment", segment}}, double(fCachedBytes->load(std::memory_order_relaxed))});
+        }
+        metrics.push_back({"shm_bad_allocs_total", "Failed allocation attempts, retried or thrown", {}, double(fNumBadAllocs.load(std::memory_order_relaxed)), true});
+        metrics.push_back({"shm_allocation_failures_total", "Allocations that failed with MessageBadAlloc", {}, double(fNumAllocFailures.load(std::memory_order_relaxed)), true});
+        if (fPremap) {
+            std::lock_guard<std::mutex> lock(fPremapMtx);
+            size_t numSegments = 0;
+            for (const auto& p : fPremapped) {
+                numSegments += p.second ? 1 : 0;
+            }
+            metrics.push_back({"shm_premapped", "Segments and regions of the session mapped by --shm-premap", {{"kind", "segment"}}, double(numSegments)});
+            metrics.push_back({"shm_premapped", "Segments and regions of the session mapped by --shm-premap", {{"kind", "region"}}, double(fPremapped.size() - numSegments)});
+        }
+
+        std::lock_guard<std::mutex> lock(fLocalRegionsMtx);
+        for (const auto& [id, region] : fRegions) {
+            const std::string regionId = std::to_string(id);
+            const std::string role = region->fControlling ? "controller" : "viewer";
+            metrics.push_back({"shm_region_pending_acks", "Released blocks of the unmanaged region whose acks have not been sent yet", {{"region", regionId}, {"role", role}}, double(region->GetNumPendingAcks())});
+            metrics.push_back({"shm_region_queued_acks", "Acks of the unmanaged region not yet received by its owner (ring blocks or queue messages)", {{"region", regionId}, {"role", role}}, double(region->GetNumQueuedAcks())});
+        }
+        return metrics;
+    }
+
+    bool SubscribeToMemoryWatermarks(std::vector<double> watermarks, MemoryWatermarkCallback callback, int intervalMs)
+    {
+        if (watermarks.empty() || !std::is_sorted(watermarks.begin(), watermarks.end()) || watermarks.front() <= 0 || watermarks.back() > 1 || intervalMs <= 0 || !callback) {
+            LOG(error) << "shmem: memory watermarks have to be ascending fill levels in (0, 1], with a callback and a positive interval";
+            throw TransportError("shmem: memory watermarks have to be ascending fill levels in (0, 1], with a callback and a positive interval");
+        }
+        UnsubscribeFromMemoryWatermarks();
+        fWatermarksActive = true;
+        fWatermarkThread = std::thread(&Manager::WatchWatermarks, this, std::move(watermarks), std::move(callback), intervalMs);
+        return true;
+    }
+
+    void UnsubscribeFromMemoryWatermarks()
+    {
+        if (fWatermarkThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(fWatermarksMtx);
+                fWatermarksActive = false;
+            }
+            fWatermarksCV.notify_one();
+            fWatermarkThread.join();
+        }
+    }
+
+    // Object store: every entry holds one reference to a message in a managed segment. Entries are replaced under
+    // fShmMtx, and readers take their reference under it, so a reader gets either the old or the new version and the
+    // old version is deallocated by whoever releases its last reference.
+
+    /// stores the message (the caller has added the reference of the store) under key
+    /// @return new version, the replaced entry (its reference to be released by the caller) in replaced
+    uint64_t StoreObject(const std::string& key, const MetaHeader& meta, MetaHeader& replaced, bool& hasReplaced)
+    {
+        using namespace boost::interprocess;
+        scoped_lock<RobustMutex> lock(*fShmMtx);
+        ObjectStore* store = fManagementSegment.find_or_construct<ObjectStore>(unique_instance)(fShmVoidAlloc);
+        uint64_t version = ++store->fLastVersion;
+        Str name(key.c_str(), fShmVoidAlloc);
+        auto it = store->fObjects.find(name);
+        hasReplaced = it != store->fObjects.end();
+        if (hasReplaced) {
+            replaced = it->second.fMeta;
+            it->second = ObjectInfo(meta, version);
+        } else {
+            store->fObjects.emplace(std::move(name), ObjectInfo(meta, version));
+        }
+        return version;
+    }
+
+    /// adds a reference to the current version of the object (to be released by the caller)
+    /// @return false if there is no object with this key
+    bool LoadObject(const std::string& key, MetaHeader& meta, uint64_t& version)
+    {
+        using namespace boost::interprocess;
+        scoped_lock<RobustMutex> lock(*fShmMtx);
+        ObjectStore* store = fManagementSegment.find<ObjectStore>(unique_instance).first;
+        if (!store) {
+            return false;
+        }
+        auto it = store->fObjects.find(Str(key.c_str(), fShmVoidAlloc));
+        if (it == store->fObjects.end()) {
+            return false;
+        }
+        meta = it->second.fMeta;
+        version = it->second.fVersion;
+        if (meta.fHandle >= 0) {
+            GetSegment(meta.fSegmentId);
+            IncrementRefCount(GetAddressFromHandle(meta.fHandle, meta.fSegmentId), meta.fSegmentId);
+        }
+        return true;
+    }
+
+    /// @return current version of the object, 0 if there is none
+    uint64_t ObjectVersion(const std::string& key)
+    {
+        using namespace boost::interprocess;
+        scoped_lock<RobustMutex> lock(*fShmMtx);
+        ObjectStore* store = fManagementSegment.find<ObjectStore>(unique_instance).first;
+        if (!store) {
+            return 0;
+        }
+        auto it = store->fObjects.find(Str(key.c_str(), fShmVoidAlloc));
+        return it == store->fObjects.end() ? 0 : it->second.fVersion;
+    }
+
+    /// removes the object from the store
+    /// @return false if there is no object with this key, otherwise its entry (reference to be released by the caller) in removed
+    bool EraseObject(const std::string& key, MetaHeader& removed)
+    {
+        using namespace boost::interprocess;
+        scoped_lock<RobustMutex> lock(*fShmMtx);
+        ObjectStore* store = fManagementSegment.find<ObjectStore>(unique_instance).first;
+        if (!store) {
+            return false;
+        }
+        auto it = store->fObjects.find(Str(key.c_str(), fShmVoidAlloc));
+        if (it == store->fObjects.end()) {
+            return false;
+        }
+        removed = it->second.fMeta;
+        store->fObjects.erase(it);
+        return true;
+    }
+
     std::vector<fair::mq::RegionInfo> GetRegionInfo()
     {
         std::vector<fair::mq::RegionInfo> result;
         std::map<uint64_t, RegionConfig> regionCfgs;
+        std::map<uint64_t, tools::GpuIpcHandle> gpuIpcHandles;
+        std::map<uint64_t, void*> addresses;
 
         {
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> shmLock(*fShmMtx);
+            boost::interprocess::scoped_lock<RobustMutex> shmLock(*fShmMtx);
 
             for (const auto& [segmentId, segmentInfo] : *fShmSegments) {
                 // make sure any segments in the session are found
@@ -528,14 +1192,18 @@ class Manager
                     info.managed = true;
                     info.id = segmentId;
                     info.event = RegionEvent::created;
-                    info.ptr = boost::apply_visitor(SegmentAddress(), fSegments.at(segmentId));
-                    info.size = boost::apply_visitor(SegmentSize(), fSegments.at(segmentId));
+                    info.ptr = boost::apply_visitor(SegmentAddress(), SegmentRef(segmentId));
+                    info.size = boost::apply_visitor(SegmentSize(), SegmentRef(segmentId));
                     result.push_back(info);
                 } catch (const std::out_of_range& oor) {
                     LOG(error) << "could not find segment with id " << segmentId;
                     LOG(error) << oor.what();
                 }
             }
+        }
+
+        {
+            boost::interprocess::scoped_lock<RobustMutex> regionsLock(*fRegionsMtx);
 
             for (const auto& [regionId, regionInfo] : *fShmRegions) {
                 fair::mq::RegionInfo info;
@@ -548,8 +1216,24 @@ class Manager
                     cfg.id = info.id;
                     cfg.creationFlags = regionInfo.fCreationFlags;
                     cfg.path = regionInfo.fPath.c_str();
+                    cfg.ackBunchSize = regionInfo.fAckBunchSize;
+                    cfg.ackMaxDelayUs = regionInfo.fAckMaxDelayUs;
+                    cfg.ackAdaptive = regionInfo.fAckAdaptive;
+                    cfg.ackRing = regionInfo.fAckRing;
+                    cfg.refCountSlots = regionInfo.fRefCountSlots;
+                    cfg.gpuRegister = regionInfo.fGpuRegister;
+                    cfg.gpuDevice = regionInfo.fGpuDevice;
+                    cfg.memfd = regionInfo.fMemfd;
+                    cfg.fdOffset = regionInfo.fFdOffset;
+                    cfg.ringBuffer = regionInfo.fRingBuffer;
+                    cfg.crossHost = regionInfo.fCrossHost;
+                    cfg.slotSize = regionInfo.fSlotSize;
+                    cfg.maxSize = regionInfo.fMaxSize;
+                    cfg.size = regionInfo.fSize;
                     regionCfgs.emplace(info.id, cfg);
-                    // fill the ptr+size info after shmLock is released, to avoid constructing local region under it
+                    gpuIpcHandles.emplace(info.id, regionInfo.fGpuIpcHandle);
+                    addresses.emplace(info.id, reinterpret_cast<void*>(regionInfo.fAddress));
+                    // fill the ptr+size info after regionsLock is released, to avoid constructing local region under it
                 } else {
                     info.ptr = nullptr;
                     info.size = 0;
@@ -558,7 +1242,7 @@ class Manager
             }
         }
 
-        // do another iteration outside of shm lock, to fill ptr+size of unmanaged regions
+        // do another iteration outside of the region table lock, to fill ptr+size of unmanaged regions
         for (auto& info : result) {
             if (!info.managed && info.event == RegionEvent::created) {
                 auto cfgIt = regionCfgs.find(info.id);
@@ -569,9 +1253,12 @@ class Manager
                     if (it != fRegions.end()) {
                         region = it->second.get();
                     } else {
-                        auto r = fRegions.emplace(cfgIt->first, std::make_unique<UnmanagedRegion>(fShmId, 0, false, cfgIt->second));
+                        auto r = fRegions.emplace(cfgIt->first, std::make_unique<UnmanagedRegion>(fShmId, 0, false, cfgIt->second, gpuIpcHandles[info.id], addresses[info.id]));
                         region = r.first->second.get();
+                        NoteFixedAddress(addresses[info.id], region->GetData());
                         region->InitializeQueues();
+                        region->SetDefaultThreadSettings(fThreadNumaNode, fThreadSettings);
+                        region->SetAckReactor(fAckReactor.get());
                         region->StartAckSender();
                     }
 
@@ -594,7 +1281,7 @@ class Manager
             std::unique_lock<std::mutex> lock(fRegionEventsMtx);
             fRegionEventsSubscriptionActive = false;
             lock.unlock();
-            fRegionEventsCV.notify_one();
+            fEventCounter->Notify();
             fRegionEventThread.join();
         }
         std::lock_guard<std::mutex> lock(fRegionEventsMtx);
@@ -611,94 +1298,510 @@ class Manager
             std::unique_lock<std::mutex> lock(fRegionEventsMtx);
             fRegionEventsSubscriptionActive = false;
             lock.unlock();
-            fRegionEventsCV.notify_one();
+            fEventCounter->Notify();
             fRegionEventThread.join();
             lock.lock();
             fRegionEventCallback = nullptr;
         }
     }
 
-    void RegionEventsSubscription()
+    // --shm-premap: maps the managed segments and unmanaged regions of the session that are not mapped yet (and pre-faults
+    // their pages with --shm-premap-prefault), so that the first message from them does not pay for it in the data path.
+    // Called when a socket is bound or connected, the first call starts a thread that does the same for segments and
+    // regions created later (woken up by the event counter, like the region events subscription).
+    void Premap()
     {
-        std::unique_lock<std::mutex> lock(fRegionEventsMtx);
-
-        while (fRegionEventsSubscriptionActive) {
-            if (fNumObservedEvents != fEventCounter->fCount) {
-                auto infos = GetRegionInfo();
-
-                for (const auto& i : infos) {
-                    auto el = fObservedRegionEvents.find({i.id, i.managed});
-                    if (el == fObservedRegionEvents.end()) { // if event id has not been observed
-                        fObservedRegionEvents.emplace(std::make_pair(i.id, i.managed), i.event);
-                        // if a region has been created and destroyed rapidly, we could see 'destroyed' without ever seeing 'created'
-                        // TODO: do we care to show 'created' events if we know region is already destroyed?
-                        if (i.event == RegionEvent::created) {
-                            fRegionEventCallback(i);
-                            ++fNumObservedEvents;
-                        } else {
-                            fNumObservedEvents += 2;
-                        }
-                    } else { // if event id has been observed (expected - there are two events per id - created & destroyed)
-                        // fire a callback if we have observed 'created' event and incoming is 'destroyed'
-                        if (el->second == RegionEvent::created && i.event == RegionEvent::destroyed) {
-                            fRegionEventCallback(i);
-                            el->second = i.event;
-                            ++fNumObservedEvents;
-                        } else {
-                            // LOG(debug) << "ignoring event " << i.id << ": incoming: " << i.event << ", stored: " << el->second;
-                        }
-                    }
-                }
-            }
-            // TODO: do better than polling here, without adding too much shmem contention
-            fRegionEventsCV.wait_for(lock, std::chrono::milliseconds(50), [&] { return !fRegionEventsSubscriptionActive; });
+        if (!fPremap) {
+            return;
+        }
+        PremapKnown();
+        std::lock_guard<std::mutex> lock(fPremapMtx);
+        if (!fPremapThread.joinable()) {
+            fPremapActive = true;
+            fPremapThread = std::thread(&Manager::PremapNew, this);
         }
     }
 
-    void IncrementMsgCounter()
+    void StopPremap()
     {
-#ifdef FAIRMQ_DEBUG_MODE
-        fMsgCounterNew.fetch_add(1, std::memory_order_relaxed);
-#endif
+        if (fPremapThread.joinable()) {
+            fPremapActive = false;
+            fEventCounter->Notify();
+            fPremapThread.join();
+        }
     }
-    void DecrementMsgCounter()
+
+    void PremapKnown()
     {
-#ifdef FAIRMQ_DEBUG_MODE
-        fMsgCounterDelete.fetch_add(1, std::memory_order_relaxed);
-#endif
-    }
+        std::lock_guard<std::mutex> lock(fPremapMtx);
+        std::vector<std::pair<uint16_t, bool>> newRegions; // id, gpu region
+        std::vector<std::pair<char*, size_t>> toPrefault;
+        {
+            boost::interprocess::scoped_lock<RobustMutex> shmLock(*fShmMtx);
+            for (const auto& [segmentId, segmentInfo] : *fShmSegments) {
+                if (fPremapped.count({segmentId, true}) > 0) {
+                    continue;
+                }
+                GetSegment(segmentId);
+                auto it = fSegments.find(segmentId);
+                if (it == fSegments.end()) {
+                    continue;
+                }
+                fPremapped.emplace(segmentId, true);
+                if (segmentId != fSegmentId) { // the own segment is covered by --shm-prefault-segment
+                    toPrefault.emplace_back(static_cast<char*>(boost::apply_visitor(SegmentAddress(), it->second)), boost::apply_visitor(SegmentSize(), it->second));
+                }
+                LOG(debug) << "Pre-mapped managed segment " << segmentId << ".";
+            }
+        }
+        {
+            boost::interprocess::scoped_lock<RobustMutex> regionsLock(*fRegionsMtx);
+            for (const auto& [regionId, regionInfo] : *fShmRegions) {
+                if (regionInfo.fDestroyed) {
+                    fPremapped.erase({regionId, false}); // the id may be reused by a new region
+                } else if (fPremapped.count({regionId, false}) == 0) {
+                    newRegions.emplace_back(regionId, regionInfo.fGpuDevice >= 0);
+                }
+            }
+        }
+        // outside of the region table lock, opening a region takes it
+        for (const auto& [regionId, gpu] : newRegions) {
+            UnmanagedRegion* region = GetRegion(regionId);
+            if (!region) {
+                continue;
+            }
+            fPremapped.emplace(regionId, false);
+            if (!gpu) { // device memory is not touched from the host
+                toPrefault.emplace_back(static_cast<char*>(region->GetData()), region->GetSize());
+            }
+            LOG(debug) << "Pre-mapped unmanaged region " << regionId << ".";
+        }
 
-#ifdef FAIRMQ_DEBUG_MODE
-    void IncrementShmMsgCounter(uint16_t segmentId) { ++((*fShmMsgCounters)[segmentId].fCount); }
-    void DecrementShmMsgCounter(uint16_t segmentId) { --((*fShmMsgCounters)[segmentId].fCount); }
-#endif
+        if (fPremapPrefault) {
+            for (const auto& [ptr, size] : toPrefault) {
+                auto start = std::chrono::steady_clock::now();
+                PrefaultMemory(ptr, size);
+                LOG(debug) << "Pre-faulted " << size << " bytes in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << "ms.";
+            }
+        }
+    }
 
-    void Heartbeats()
+    void PremapNew()
     {
-        using namespace boost::interprocess;
+        ApplyThreadSettings("premap thread");
 
-        Heartbeat* hb = fManagementSegment.find_or_construct<Heartbeat>(unique_instance)(0);
-        std::unique_lock<std::mutex> lock(fHeartbeatsMtx);
-        while (fBeatTheHeart) {
-            (hb->fCount)++;
-            fHeartbeatsCV.wait_for(lock, std::chrono::milliseconds(100), [&]() { return !fBeatTheHeart; });
+        while (fPremapActive) {
+            uint64_t scannedEvents = fEventCounter->fCount;
+            PremapKnown();
+            boost::interprocess::scoped_lock<RobustMutex> lock(fEventCounter->fMtx);
+            fEventCounter->fCV.wait(lock, [&] { return !fPremapActive || fEventCounter->fCount != scannedEvents; });
         }
     }
 
-    void StopHeartbeats()
+    // the segments and regions created/destroyed since the last call, taken from the ring of recent events of the session.
+    // All current segments and regions (GetRegionInfo) on the first call, or after more events than the ring holds
+    std::vector<fair::mq::RegionInfo> GetNewRegionEvents()
     {
+        std::vector<fair::mq::RegionInfo> result;
+        std::vector<EventCounter::Event> events;
+        bool rescan = false;
         {
-            std::unique_lock<std::mutex> lock(fHeartbeatsMtx);
-            fBeatTheHeart = false;
+            boost::interprocess::scoped_lock<RobustMutex> eventsLock(fEventCounter->fMtx);
+            const uint64_t count = fEventCounter->fCount;
+            rescan = fNumObservedEvents == 0 || count - fNumObservedEvents > EventCounter::kNumEvents;
+            if (!rescan) {
+                for (uint64_t n = fNumObservedEvents; n < count; ++n) {
+                    events.push_back(fEventCounter->fEvents[n % EventCounter::kNumEvents]);
+                }
+            }
+            fNumObservedEvents = count;
         }
-        fHeartbeatsCV.notify_one();
-        if (fHeartbeatThread.joinable()) {
-            fHeartbeatThread.join();
+        if (rescan) {
+            return GetRegionInfo();
+        }
+        {
+            boost::interprocess::scoped_lock<RobustMutex> shmLock(*fShmMtx);
+            boost::interprocess::scoped_lock<RobustMutex> regionsLock(*fRegionsMtx);
+            for (const auto& e : events) {
+                fair::mq::RegionInfo info;
+                info.managed = e.fManaged;
+                info.id = e.fId;
+                info.event = e.fDestroyed ? RegionEvent::destroyed : (e.fResized ? RegionEvent::resized : RegionEvent::created);
+                if (e.fManaged) {
+                    GetSegment(e.fId);
+                    auto it = fSegments.find(e.fId);
+                    if (it == fSegments.end()) {
+                        continue;
+                    }
+                    info.ptr = boost::apply_visitor(SegmentAddress(), it->second);
+                    info.size = boost::apply_visitor(SegmentSize(), it->second);
+                } else {
+                    auto it = fShmRegions->find(e.fId);
+                    if (it == fShmRegions->end()) {
+                        continue;
+                    }
+                    info.flags = it->second.fUserFlags;
+                    if (!e.fDestroyed && it->second.fDestroyed) {
+                        continue; // destroyed meanwhile, the following event reports it
+                    }
+                }
+                result.push_back(info);
+            }
         }
-    }
 
-    void GetSegment(uint16_t id)
+        // map the created regions outside of the shm locks (opening a region takes the region table lock)
+        for (auto& info : result) {
+            if (!info.managed && (info.event == RegionEvent::created || info.event == RegionEvent::resized)) {
+                UnmanagedRegion* region = GetRegion(info.id);
+                info.ptr = region ? region->GetData() : nullptr;
+                info.size = region ? region->GetSize() : 0;
+            }
+        }
+        return result;
+    }
+
+    void RegionEventsSubscription()
+    {
+        ApplyThreadSettings("region events thread");
+
+        while (true) {
+            uint64_t scannedEvents = fEventCounter->fCount;
+            {
+                std::lock_guard<std::mutex> lock(fRegionEventsMtx);
+                if (!fRegionEventsSubscriptionActive) {
+                    break;
+                }
+                if (fSegmentInitialized && !fSegmentInitReported) {
+                    fSegmentInitReported = true;
+                    fRegionEventCallback(fair::mq::RegionInfo(true, fSegmentId, boost::apply_visitor(SegmentAddress(), SegmentRef(fSegmentId)), fSegmentSize, 0, RegionEvent::initialized));
+                }
+                if (fNumObservedEvents != fEventCounter->fCount) {
+                    auto infos = GetNewRegionEvents();
+
+                    for (const auto& i : infos) {
+                        auto el = fObservedRegionEvents.find({i.id, i.managed});
+                        if (el == fObservedRegionEvents.end()) { // if event id has not been observed
+                            // a region resized before it was observed is reported as created (with its current size)
+                            auto info = i;
+                            if (info.event == RegionEvent::resized) {
+                                info.event = RegionEvent::created;
+                            }
+                            fObservedRegionEvents.emplace(std::make_pair(info.id, info.managed), info.event);
+                            // if a region has been created and destroyed rapidly, we could see 'destroyed' without ever seeing 'created'
+                            // TODO: do we care to show 'created' events if we know region is already destroyed?
+                            if (info.event == RegionEvent::created) {
+                                fRegionEventCallback(info);
+                            }
+                        } else { // if event id has been observed (expected - there are two events per id - created & destroyed)
+                            // fire a callback if we have observed 'created' event and incoming is 'destroyed' (or 'resized')
+                            if (el->second == RegionEvent::created && i.event == RegionEvent::destroyed) {
+                                fRegionEventCallback(i);
+                                el->second = i.event;
+                            } else if (el->second == RegionEvent::created && i.event == RegionEvent::resized) {
+                                fRegionEventCallback(i);
+                            } else {
+                                // LOG(debug) << "ignoring event " << i.id << ": incoming: " << i.event << ", stored: " << el->second;
+                            }
+                        }
+                    }
+                }
+            }
+            // sleep until the next event of the session or a local state change (see EventCounter)
+            boost::interprocess::scoped_lock<RobustMutex> lock(fEventCounter->fMtx);
+            fEventCounter->fCV.wait(lock, [&] { return !fRegionEventsSubscriptionActive || fEventCounter->fCount != scannedEvents || (fSegmentInitialized && !fSegmentInitReported); });
+        }
+    }
+
+    // polls the fill level of the own segment (buffers held by allocation caches count as free). A level is only left downwards
+    // once the fill level is kWatermarkHysteresis below its watermark, so that a fill level around a watermark does not flap
+    void WatchWatermarks(std::vector<double> watermarks, MemoryWatermarkCallback callback, int intervalMs)
+    {
+        ApplyThreadSettings("watermark thread");
+        auto& segment = SegmentRef(fSegmentId);
+        const size_t size = boost::apply_visitor(SegmentSize(), segment);
+        size_t level = 0;
+
+        std::unique_lock<std::mutex> lock(fWatermarksMtx);
+        while (fWatermarksActive) {
+            size_t free = boost::apply_visitor(SegmentFreeMemory(), segment) + (fCachedBytes ? fCachedBytes->load(std::memory_order_relaxed) : 0);
+            size_t used = size - std::min(free, size);
+            double fill = static_cast<double>(used) / size;
+
+            size_t reached = std::upper_bound(watermarks.begin(), watermarks.end(), fill) - watermarks.begin();
+            size_t kept = std::upper_bound(watermarks.begin(), watermarks.end(), fill + kWatermarkHysteresis) - watermarks.begin();
+            size_t newLevel = reached > level ? reached : std::min(level, kept);
+            if (newLevel != level) {
+                MemoryWatermarkEvent event{fSegmentId, size, used, newLevel, newLevel > level};
+                level = newLevel;
+                lock.unlock();
+                callback(event);
+                lock.lock();
+                continue; // check again right away, the fill level may have moved on while the callback ran
+            }
+            fWatermarksCV.wait_for(lock, std::chrono::milliseconds(intervalMs), [&] { return !fWatermarksActive; });
+        }
+    }
+
+    void IncrementMsgCounter()
+    {
+#ifdef FAIRMQ_DEBUG_MODE
+        fMsgCounterNew.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+    void DecrementMsgCounter()
     {
+#ifdef FAIRMQ_DEBUG_MODE
+        fMsgCounterDelete.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+#ifdef FAIRMQ_DEBUG_MODE
+    void IncrementShmMsgCounter(uint16_t segmentId) { ++((*fShmMsgCounters)[segmentId].fCount); }
+    void DecrementShmMsgCounter(uint16_t segmentId) { --((*fShmMsgCounters)[segmentId].fCount); }
+
+    void AddMsgDebug(char* ptr, size_t size, uint16_t segmentId)
+    {
+        boost::interprocess::scoped_lock<RobustMutex> lock(*fDebugMtx);
+        IncrementShmMsgCounter(segmentId);
+        if (fMsgDebug->count(segmentId) == 0) {
+            fMsgDebug->emplace(segmentId, fShmVoidAlloc);
+        }
+        fMsgDebug->at(segmentId).emplace(
+            static_cast<size_t>(GetHandleFromAddress(UserPtr(ptr, segmentId), segmentId)),
+            MsgDebug(getpid(), size, std::chrono::system_clock::now().time_since_epoch().count())
+        );
+    }
+#endif
+
+    // UsageTable entries written by the heartbeat thread, with the counters already published into them
+    struct PublishedUsage
+    {
+        UsageTable::Entry* fEntry; // nullptr if the table was full
+        uint64_t fFirst; // allocations of the segment, acks sent of a region
+        uint64_t fSecond; // deallocations of the segment
+        bool fRelease; // the region was created by this process, its entry is released when it is gone
+    };
+
+    // beats the heart with --shm-liveness heartbeat, publishes the usage counters every --shm-stats-interval ms
+    void Heartbeats(bool beat)
+    {
+        using namespace boost::interprocess;
+
+        ApplyThreadSettings("heartbeat thread");
+        Heartbeat* hb = beat ? fManagementSegment.find_or_construct<Heartbeat>(unique_instance)(0) : nullptr;
+        auto nextBeat = std::chrono::steady_clock::now();
+        auto nextStats = nextBeat;
+        std::unique_lock<std::mutex> lock(fHeartbeatsMtx);
+        while (fBeatTheHeart) {
+            const auto now = std::chrono::steady_clock::now();
+            if (hb && now >= nextBeat) {
+                (hb->fCount)++;
+                nextBeat = now + std::chrono::milliseconds(fHeartbeatIntervalInMs);
+            }
+            if (fStatsIntervalInMs > 0 && now >= nextStats) {
+                lock.unlock();
+                PublishUsage();
+                lock.lock();
+                nextStats = now + std::chrono::milliseconds(fStatsIntervalInMs);
+            }
+            if (fWatchCacheReleaseRequests.load(std::memory_order_acquire)) {
+                // an idle process has no cache accesses that would notice the requests
+                lock.unlock();
+                CheckCacheReleaseRequests();
+                lock.lock();
+            }
+            const auto until = !hb ? nextStats : (fStatsIntervalInMs > 0 ? std::min(nextBeat, nextStats) : nextBeat);
+            fHeartbeatsCV.wait_until(lock, until, [&]() { return !fBeatTheHeart; });
+        }
+        if (fStatsIntervalInMs > 0) {
+            lock.unlock();
+            PublishUsage();
+        }
+    }
+
+    // writes the usage counters of the own segment and of the regions of this process into the UsageTable. Counters
+    // of several processes (allocations, acks sent) are added as the deltas since the last publication
+    void PublishUsage()
+    {
+        if (!fPublishUsage.load(std::memory_order_acquire)) {
+            return; // the constructor has not finished yet
+        }
+        const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+        SegmentVariant& segment = SegmentRef(fSegmentId);
+        if (PublishedUsage* usage = UsageEntry(UsageTable::Key(true, fSegmentId), false)) {
+            const uint64_t allocations = fNumAllocations.Get();
+            const uint64_t deallocations = fNumDeallocations.Get();
+            usage->fEntry->fSize.store(boost::apply_visitor(SegmentSize(), segment), std::memory_order_relaxed);
+            usage->fEntry->fFreeBytes.store(boost::apply_visitor(SegmentFreeMemory(), segment), std::memory_order_relaxed);
+            usage->fEntry->fAllocations.fetch_add(allocations - usage->fFirst, std::memory_order_relaxed);
+            usage->fEntry->fDeallocations.fetch_add(deallocations - usage->fSecond, std::memory_order_relaxed);
+            usage->fEntry->fUpdated.store(now, std::memory_order_relaxed);
+            usage->fFirst = allocations;
+            usage->fSecond = deallocations;
+        }
+
+        struct RegionUsage { uint16_t id; bool controlling; uint64_t size; uint64_t sent; uint64_t received; };
+        std::vector<RegionUsage> regions;
+        {
+            std::lock_guard<std::mutex> lock(fLocalRegionsMtx);
+            for (const auto& [id, region] : fRegions) {
+                if (region->fRing || region->fSlots) {
+                    continue; // not acknowledged
+                }
+                regions.push_back({id, region->fControlling, region->GetSize(),
+                                   region->fNumAcksSent.load(std::memory_order_relaxed),
+                                   region->fNumAcksReceived.load(std::memory_order_relaxed)});
+            }
+        }
+        for (const auto& region : regions) {
+            PublishedUsage* usage = UsageEntry(UsageTable::Key(false, region.id), region.controlling);
+            if (!usage) {
+                continue;
+            }
+            usage->fEntry->fAcksSent.fetch_add(region.sent - usage->fFirst, std::memory_order_relaxed);
+            usage->fFirst = region.sent;
+            if (region.controlling) {
+                usage->fEntry->fSize.store(region.size, std::memory_order_relaxed);
+                usage->fEntry->fAcksReceived.store(region.received, std::memory_order_relaxed);
+            }
+            usage->fEntry->fUpdated.store(now, std::memory_order_relaxed);
+        }
+
+        // regions of this process that are gone, their creator frees the entry
+        for (auto it = fPublishedUsage.begin(); it != fPublishedUsage.end();) {
+            const bool managed = (it->first >> 16) == 1;
+            const uint16_t id = it->first & 0xffff;
+            if (!managed && std::none_of(regions.begin(), regions.end(), [id](const RegionUsage& r) { return r.id == id; })) {
+                if (it->second.fEntry && it->second.fRelease) {
+                    fUsageTable->Release(*it->second.fEntry);
+                }
+                it = fPublishedUsage.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // @return the published state of the UsageTable entry of key, claimed on first use. nullptr if the table is full
+    PublishedUsage* UsageEntry(uint32_t key, bool release)
+    {
+        auto it = fPublishedUsage.find(key);
+        if (it == fPublishedUsage.end()) {
+            UsageTable::Entry* entry = nullptr;
+            {
+                boost::interprocess::scoped_lock<RobustMutex> lock(*fShmMtx);
+                entry = fUsageTable->Claim(key);
+            }
+            if (!entry) {
+                LOG(warn) << "Shared memory usage table is full (" << UsageTable::kNumSlots << " entries), not publishing the stats of " << ((key >> 16) == 1 ? "segment " : "region ") << (key & 0xffff);
+            }
+            it = fPublishedUsage.emplace(key, PublishedUsage{entry, 0, 0, release}).first;
+        }
+        return it->second.fEntry ? &it->second : nullptr;
+    }
+
+    void ApplyThreadSettings(const char* thread)
+    {
+        if (fThreadNumaNode >= 0 && !SetThreadNumaAffinity(fThreadNumaNode)) {
+            LOG(warn) << "Could not pin the shmem " << thread << " to NUMA node " << fThreadNumaNode << ": " << strerror(errno);
+        }
+        // an explicit CPU list takes precedence over the CPUs of the NUMA node
+        if (!fThreadSettings.Empty() && !tools::ApplyThreadSettings(fThreadSettings)) {
+            LOG(warn) << "Could not apply the CPU affinity/scheduling settings to the shmem " << thread << ": " << strerror(errno);
+        }
+    }
+
+    void StopHeartbeats()
+    {
+        {
+            std::unique_lock<std::mutex> lock(fHeartbeatsMtx);
+            fBeatTheHeart = false;
+        }
+        fHeartbeatsCV.notify_one();
+        if (fHeartbeatThread.joinable()) {
+            fHeartbeatThread.join();
+        }
+    }
+
+    void RemoveFromLivenessTable()
+    {
+        if (fLivenessSlot >= 0) {
+            fLivenessTable->Remove(fLivenessSlot);
+            fLivenessSlot = -1;
+        }
+    }
+
+    // on a regular exit the process holds no references any more, its ledger is dropped
+    void RemoveLedger()
+    {
+        if (fLedgerSlot >= 0) {
+            fLedger.reset();
+            boost::interprocess::shared_memory_object::remove(LedgerTable::Name(fShmId, fLedgerSlot).c_str());
+            fLedgerTable->Remove(fLedgerSlot);
+            fLedgerSlot = -1;
+        }
+    }
+
+    // marks the ledgers of processes that are not alive any more as being reclaimed by this one. Caller holds fShmMtx
+    std::vector<size_t> ClaimDeadLedgers()
+    {
+        std::vector<size_t> slots;
+        for (size_t i = 0; i < LedgerTable::kNumSlots; ++i) {
+            pid_t pid = fLedgerTable->fPids[i].load();
+            if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH && fLedgerTable->fPids[i].compare_exchange_strong(pid, LedgerTable::kReclaiming)) {
+                LOG(debug) << "Process " << pid << " of ledger " << i << " is gone, reclaiming its chunks.";
+                slots.push_back(i);
+            }
+        }
+        return slots;
+    }
+
+    // releases the references recorded in the ledger of a dead process and removes the ledger
+    void Reclaim(size_t slot)
+    {
+        const std::string name = LedgerTable::Name(fShmId, slot);
+        uint64_t numChunks = 0;
+        uint64_t numRefs = 0;
+        try {
+            ChunkLedger ledger(name, 0, false);
+            ledger.ForEach([&](uint64_t key, uint32_t count) {
+                const uint16_t segmentId = ChunkLedger::SegmentId(key);
+                const auto handle = static_cast<boost::interprocess::managed_shared_memory::handle_t>(ChunkLedger::Handle(key));
+                GetSegment(segmentId);
+                if (fSegments.count(segmentId) == 0) {
+                    return;
+                }
+                char* ptr = GetAddressFromHandle(handle, segmentId);
+                for (uint32_t i = 0; i < count; ++i) {
+                    ++numRefs;
+                    if (DecrementRefCount(ptr, segmentId) == 1) {
+                        Deallocate(handle, segmentId);
+                        ++numChunks;
+                        break;
+                    }
+                }
+            });
+            if (ledger.GetNumUntracked() > 0) {
+                LOG(warn) << "Ledger " << slot << " was full, " << ledger.GetNumUntracked() << " references of the dead process could not be reclaimed (increase --shm-reclaim-slots)";
+            }
+        } catch (boost::interprocess::interprocess_exception& e) {
+            LOG(warn) << "Could not open ledger '" << name << "' of a dead process: " << e.what();
+        } catch (TransportError& e) {
+            LOG(warn) << "Could not open ledger '" << name << "' of a dead process: " << e.what();
+        }
+        boost::interprocess::shared_memory_object::remove(name.c_str());
+        fLedgerTable->fReclaimedChunks.fetch_add(numChunks, std::memory_order_relaxed);
+        fLedgerTable->fReclaimedRefs.fetch_add(numRefs, std::memory_order_relaxed);
+        fLedgerTable->Remove(static_cast<int>(slot));
+        LOG(info) << "Reclaimed " << numChunks << " chunks (" << numRefs << " references) held by a dead process of the session.";
+    }
+
+    void GetSegment(uint16_t id)
+    {
+        if (SegmentBase(id)) {
+            return;
+        }
         auto it = fSegments.find(id);
         if (it == fSegments.end()) {
             try {
@@ -706,108 +1809,1060 @@ class Manager
                 SegmentInfo segmentInfo = fShmSegments->at(id);
                 LOG(debug) << "Located segment with id '" << id << "'";
 
-                using namespace boost::interprocess;
+                using namespace boost::interprocess;
+
+                const std::string segmentName("fmq_" + fShmId + "_m_" + std::to_string(id));
+                const void* address = reinterpret_cast<void*>(segmentInfo.fAddress);
+                if (segmentInfo.fAllocationAlgorithm == AllocationAlgorithm::rbtree_best_fit) {
+                    EmplaceSegment<RBTreeBestFitSegment>(id, address, open_only, segmentName.c_str());
+                } else if (segmentInfo.fAllocationAlgorithm == AllocationAlgorithm::slab_fit) {
+                    EmplaceSegment<SlabFitSegment>(id, address, open_only, segmentName.c_str());
+                } else {
+                    EmplaceSegment<SimpleSeqFitSegment>(id, address, open_only, segmentName.c_str());
+                }
+                // registered last: the segment is used by other threads as soon as its base is published
+                RegisterSegment(id, segmentInfo.fRefCountTable ? OpenRefCountTable(id, false) : nullptr);
+            } catch (std::out_of_range& oor) {
+                LOG(error) << "Could not get segment with id '" << id << "': " << oor.what();
+            } catch (boost::interprocess::interprocess_exception& bie) {
+                LOG(error) << "Could not get segment with id '" << id << "': " << bie.what();
+            }
+        }
+    }
+
+    // next range of the fixed address space of the session (--shm-fixed-address), nullptr if it is not free in this
+    // process
+    void* ReserveFixedAddress(size_t size)
+    {
+        FixedAddressSpace* space = fManagementSegment.find_or_construct<FixedAddressSpace>(boost::interprocess::unique_instance)(fShmId64);
+        void* address = reinterpret_cast<void*>(space->Reserve(size));
+        if (!AddressRangeFree(address, size)) {
+            LOG(warn) << "Fixed address range " << address << " (" << size << " bytes) is in use in this process, mapping at any address. Raw pointers into it are not valid across processes.";
+            return nullptr;
+        }
+        return address;
+    }
+
+    // maps a managed segment at address (if not nullptr), falls back to any address
+    template<typename S, typename... Args>
+    void EmplaceSegment(uint16_t id, const void* address, const Args&... args)
+    {
+        if (address) {
+            try {
+                fSegments.emplace(id, S(args..., address));
+                return;
+            } catch (boost::interprocess::interprocess_exception& e) {
+                LOG(warn) << "Could not map managed segment " << id << " at its fixed address " << address << ": " << e.what() << ". Mapping at any address, raw pointers into it are not valid in this process.";
+            }
+        }
+        fSegments.emplace(id, S(args...));
+        NoteFixedAddress(nullptr, nullptr);
+    }
+
+    // --shm-fixed-address: a segment or region that was requested at address got mapped at mapped
+    void NoteFixedAddress(const void* address, const void* mapped)
+    {
+        if (fFixedAddress && (!address || address != mapped)) {
+            fFixedAddressFallback = true;
+        }
+    }
+
+    // creates and registers a new managed segment, the caller must hold fShmMtx
+    void CreateSegment(uint16_t id, size_t size, const std::string& allocationAlgorithm, bool refCountTable)
+    {
+        using namespace boost::interprocess;
+        std::string segmentName("fmq_" + fShmId + "_m_" + std::to_string(id));
+        const void* address = fFixedAddress ? ReserveFixedAddress(size) : nullptr;
+        SegmentInfo info(AllocationAlgorithm::rbtree_best_fit, refCountTable, fNumaNode);
+        if (allocationAlgorithm == "rbtree_best_fit") {
+            EmplaceSegment<RBTreeBestFitSegment>(id, address, open_or_create, segmentName.c_str(), size);
+        } else if (allocationAlgorithm == "simple_seq_fit") {
+            EmplaceSegment<SimpleSeqFitSegment>(id, address, open_or_create, segmentName.c_str(), size);
+            info.fAllocationAlgorithm = AllocationAlgorithm::simple_seq_fit;
+        } else if (allocationAlgorithm == "slab_fit") {
+            EmplaceSegment<SlabFitSegment>(id, address, open_or_create, segmentName.c_str(), size);
+            info.fAllocationAlgorithm = AllocationAlgorithm::slab_fit;
+        }
+        if (address && boost::apply_visitor(SegmentAddress(), SegmentRef(id)) == address) {
+            info.fAddress = reinterpret_cast<uint64_t>(address);
+        }
+        RefCountTable* refCounts = refCountTable ? OpenRefCountTable(id, true) : nullptr;
+        fShmSegments->emplace(id, info);
+        RegisterSegment(id, refCounts);
+    }
+
+    // opens the ref count table of a segment before the segment is registered (RegisterSegment publishes it)
+    RefCountTable* OpenRefCountTable(uint16_t id, bool create)
+    {
+        const size_t segmentSize = boost::apply_visitor(SegmentSize(), SegmentRef(id));
+        std::lock_guard<std::mutex> lock(fSegmentBasesMtx);
+        RefCountTable& table = fRefCountTables.emplace(std::piecewise_construct, std::forward_as_tuple(id),
+            std::forward_as_tuple(RefCountTable::Name(fShmId, id), segmentSize, create)).first->second;
+        if (id == fSegmentId) {
+            fLocalRefCountTable = &table;
+        }
+        return &table;
+    }
+
+    // @return ref count table of the segment, nullptr if it uses ShmHeader (or is not opened)
+    RefCountTable* GetRefCountTable(uint16_t segmentId) const
+    {
+        if (segmentId == fSegmentId) {
+            return fLocalRefCountTable;
+        }
+        const SegmentBlock* block = fSegmentBases[segmentId / kSegmentBlockSize].load(std::memory_order_acquire);
+        return block ? (*block)[segmentId % kSegmentBlockSize].fRefCounts.load(std::memory_order_acquire) : nullptr;
+    }
+
+    // chunk layout accessors, dispatching between ShmHeader and RefCountTable, depending on the segment
+    char* UserPtr(char* ptr, uint16_t segmentId)
+    {
+        return GetRefCountTable(segmentId) ? ptr : ShmHeader::UserPtr(ptr);
+    }
+
+    uint16_t UserOffset(char* ptr, uint16_t segmentId)
+    {
+        return GetRefCountTable(segmentId) ? 0 : ShmHeader::UserOffset(ptr);
+    }
+
+    std::atomic<uint16_t>& RefCountPtr(char* ptr, uint16_t segmentId)
+    {
+        RefCountTable* table = GetRefCountTable(segmentId);
+        return table ? table->RefCount(GetHandleFromAddress(ptr, segmentId)) : ShmHeader::RefCountPtr(ptr);
+    }
+
+    uint16_t RefCount(char* ptr, uint16_t segmentId) { return RefCountPtr(ptr, segmentId).load(); }
+    uint16_t IncrementRefCount(char* ptr, uint16_t segmentId) { return RefCountPtr(ptr, segmentId).fetch_add(1); }
+    uint16_t DecrementRefCount(char* ptr, uint16_t segmentId) { return RefCountPtr(ptr, segmentId).fetch_sub(1); }
+    uint16_t AddRefCount(char* ptr, uint16_t segmentId, uint16_t n) { return RefCountPtr(ptr, segmentId).fetch_add(n); }
+
+    uint16_t& ChunkQuota(char* ptr, uint16_t segmentId)
+    {
+        RefCountTable* table = GetRefCountTable(segmentId);
+        return table ? table->Quota(GetHandleFromAddress(ptr, segmentId)) : ShmHeader::Quota(ptr);
+    }
+
+    // --shm-fixed-address: all segments and regions mapped by this process so far are at the same address as in the other
+    // processes of the session, raw pointers into them can be exchanged
+    bool FixedAddressMapping() const { return fFixedAddress && !fFixedAddressFallback; }
+
+    // --shm-inline-size: messages up to this size keep their payload in process memory and send it in the meta data frame
+    size_t InlineSize() const { return fInlineSize; }
+
+    boost::interprocess::managed_shared_memory::handle_t GetHandleFromAddress(const void* ptr, uint16_t segmentId) const
+    {
+        if (const char* base = SegmentBase(segmentId)) {
+            return static_cast<boost::interprocess::managed_shared_memory::handle_t>(static_cast<const char*>(ptr) - base);
+        }
+        return boost::apply_visitor(SegmentHandleFromAddress(ptr), SegmentRef(segmentId));
+    }
+    char* GetAddressFromHandle(const boost::interprocess::managed_shared_memory::handle_t handle, uint16_t segmentId) const
+    {
+        if (char* base = SegmentBase(segmentId)) {
+            return base + handle;
+        }
+        return boost::apply_visitor(SegmentAddressFromHandle(handle), SegmentRef(segmentId)); // throws for unknown segments
+    }
+
+    // segment of the given id, the own segment without a lookup
+    SegmentVariant& SegmentRef(uint16_t id) { return (id == fSegmentId && fLocalSegment) ? *fLocalSegment : fSegments.at(id); }
+    const SegmentVariant& SegmentRef(uint16_t id) const { return (id == fSegmentId && fLocalSegment) ? *fLocalSegment : fSegments.at(id); }
+
+    // @return base address of the segment (as get_address() of the boost segment), nullptr if it is not opened
+    char* SegmentBase(uint16_t id) const
+    {
+        const SegmentBlock* block = fSegmentBases[id / kSegmentBlockSize].load(std::memory_order_acquire);
+        return block ? (*block)[id % kSegmentBlockSize].fBase.load(std::memory_order_acquire) : nullptr;
+    }
+
+    // publishes the base address of an opened segment in the flat table, after its ref count table (if any): a thread
+    // that sees the base also sees the table
+    void RegisterSegment(uint16_t id, RefCountTable* refCounts)
+    {
+        char* base = static_cast<char*>(boost::apply_visitor(SegmentAddress(), fSegments.at(id)));
+        std::lock_guard<std::mutex> lock(fSegmentBasesMtx);
+        SegmentBlock* block = fSegmentBases[id / kSegmentBlockSize].load(std::memory_order_relaxed);
+        if (!block) {
+            fSegmentBlocks.push_back(std::make_unique<SegmentBlock>());
+            block = fSegmentBlocks.back().get();
+            for (auto& entry : *block) {
+                entry.fBase.store(nullptr, std::memory_order_relaxed);
+                entry.fRefCounts.store(nullptr, std::memory_order_relaxed);
+            }
+            fSegmentBases[id / kSegmentBlockSize].store(block, std::memory_order_release);
+        }
+        (*block)[id % kSegmentBlockSize].fRefCounts.store(refCounts, std::memory_order_release);
+        (*block)[id % kSegmentBlockSize].fBase.store(base, std::memory_order_release);
+        if (id == fSegmentId) {
+            fLocalSegment = &fSegments.at(id);
+        }
+    }
+
+    size_t ChunkFullSize(size_t size, size_t alignment) const
+    {
+        return fLocalRefCountTable ? RefCountTable::FullSize(size) : ShmHeader::FullSize(size, alignment);
+    }
+
+    void ConstructChunk(char* ptr, size_t alignment)
+    {
+        if (fLocalRefCountTable) {
+            fLocalRefCountTable->Construct(GetHandleFromAddress(ptr, fSegmentId));
+        } else {
+            ShmHeader::Construct(ptr, alignment);
+        }
+    }
+
+    // Arenas (BufferArena) carve message chunks out of one managed chunk, which holds one reference per message chunk.
+    // Every message chunk is preceded by its distance to the arena chunk (uint64_t) and marked with QuotaTable::kArenaChunk.
+    void ConstructArenaChunk(char* arena, char* ptr, [[maybe_unused]] size_t size, size_t alignment, uint16_t segmentId)
+    {
+        const uint64_t distance = ptr - arena;
+        std::memcpy(ptr - sizeof(distance), &distance, sizeof(distance));
+        RefCountTable* table = GetRefCountTable(segmentId);
+        if (table) {
+            table->Construct(GetHandleFromAddress(ptr, segmentId));
+        } else {
+            ShmHeader::Construct(ptr, alignment);
+        }
+        ChunkQuota(ptr, segmentId) = QuotaTable::kArenaChunk;
+        fNumAllocations.Add(); // its release is counted as a deallocation, like that of any chunk
+        FAIRMQ_PROBE(shm_allocate, ptr, size, segmentId);
+    }
+
+    // drops the reference of a message chunk of an arena (deallocating the arena chunk with the last one),
+    // returns false if ptr is not part of an arena
+    bool ReleaseArenaChunk(char* ptr, uint16_t segmentId)
+    {
+        if (ChunkQuota(ptr, segmentId) != QuotaTable::kArenaChunk) {
+            return false;
+        }
+        uint64_t distance = 0;
+        std::memcpy(&distance, ptr - sizeof(distance), sizeof(distance));
+        char* arena = ptr - distance;
+        RefCountTable* table = GetRefCountTable(segmentId);
+        if (table) {
+            table->Destruct(GetHandleFromAddress(ptr, segmentId));
+        }
+        if (DecrementRefCount(arena, segmentId) == 1) {
+            Deallocate(GetHandleFromAddress(arena, segmentId), segmentId);
+        }
+        return true;
+    }
+
+    bool HasRefCountTable(uint16_t segmentId) { return GetRefCountTable(segmentId) != nullptr; }
+
+    // allocates from the own segment. If segmentId is provided and spill-over is enabled,
+    // a full segment falls back to the other segments of the session, segmentId is set to the used one.
+    char* Allocate(size_t size, size_t alignment = 0, uint16_t* segmentId = nullptr)
+    {
+        const bool sampled = SampleAllocStats();
+        const auto sampleStart = sampled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        alignment = std::max(alignment, alignof(std::max_align_t));
+
+        char* ptr = nullptr;
+        uint16_t allocatedSegmentId = fSegmentId;
+        int numAttempts = 0;
+        std::unique_ptr<DeallocationWaiter> waiter;
+        std::chrono::steady_clock::time_point waitStart;
+        size_t fullSize = ChunkFullSize(size, alignment);
+        // without a header to pad, alignments beyond the natural one have to come from the allocator
+        const bool allocateAligned = fLocalRefCountTable && alignment > alignof(std::max_align_t);
+        if (allocateAligned && (alignment & (alignment - 1)) != 0) {
+            LOG(error) << "shmem: alignment " << alignment << " is not a power of two, which is required for segments with a ref count table";
+            throw TransportError(tools::ToString("shmem: alignment ", alignment, " is not a power of two, which is required for segments with a ref count table"));
+        }
+
+        // with a quota, fullSize is reserved before allocating and replaced by the allocator size of the chunk afterwards
+        bool reserved = false;
+        bool overQuota = false;
+        // size-routed allocation (shm-alloc-policy), a full store falls back to the own segment
+        if (segmentId && !fAllocRoutes.empty() && !allocateAligned) {
+            const uint16_t routed = RouteAllocation(size);
+            if (routed != fSegmentId && (!fQuota || (reserved = ReserveQuota(fullSize)))) {
+                ptr = TryAllocate(routed, size, alignment);
+                if (ptr) {
+                    allocatedSegmentId = routed;
+                }
+            }
+        }
+        if (!ptr && fAllocationCacheEnabled && !allocateAligned && (!fQuota || reserved || (reserved = ReserveQuota(fullSize)))) {
+            ptr = AllocateFromCache(fullSize);
+            if (ptr) {
+                ConstructChunk(ptr, alignment);
+            }
+        }
+
+        try {
+            while (!ptr) {
+                try {
+                    size_t segmentSize = boost::apply_visitor(SegmentSize(), SegmentRef(fSegmentId));
+                    if (fullSize > segmentSize) {
+                        AllocationFailed(fullSize, overQuota);
+                        throw MessageBadAlloc(tools::ToString("Requested message size (", fullSize, ") exceeds segment size (", segmentSize, ")"));
+                    }
+                    if (fQuota && !reserved) {
+                        // exceeding the hard quota is handled like a full segment: retried, waited for or thrown
+                        overQuota = !ReserveQuota(fullSize);
+                        if (overQuota) {
+                            throw boost::interprocess::bad_alloc();
+                        }
+                        reserved = true;
+                    }
+
+                    if (allocateAligned) {
+                        ptr = static_cast<char*>(boost::apply_visitor(SegmentAllocateAligned(fullSize, alignment), SegmentRef(fSegmentId)));
+                    } else {
+                        ptr = boost::apply_visitor(SegmentAllocate{fullSize}, SegmentRef(fSegmentId));
+                    }
+                    ConstructChunk(ptr, alignment);
+                } catch (boost::interprocess::bad_alloc& ba) {
+                    // LOG(warn) << "Shared memory full...";
+                    fNumBadAllocs.fetch_add(1, std::memory_order_relaxed);
+                    if (fDeferredFree && DrainDeferredFrees() > 0) {
+                        continue; // deferred deallocations were completed, retry immediately
+                    }
+                    if (!overQuota && RequestCacheRelease() > 0) {
+                        continue; // cached buffers were returned to the segment, retry immediately
+                    }
+                    if (!overQuota && segmentId && fSpillOver != SpillOverPolicy::none) {
+                        ptr = AllocateSpillOver(size, alignment, allocatedSegmentId);
+                        if (ptr) {
+                            continue; // allocated from another segment of the session
+                        }
+                    }
+                    if (fBadAllocWait) {
+                        if (!waiter) {
+                            // register before retrying, so that no deallocation after the failed attempt is missed
+                            waiter = std::make_unique<DeallocationWaiter>(*fDeallocationNotifier);
+                            waitStart = std::chrono::steady_clock::now();
+                            continue;
+                        }
+                        int64_t waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - waitStart).count();
+                        int64_t maxWait = BadAllocMaxWait();
+                        if ((maxWait >= 0 && waited >= maxWait) || Interrupted()) {
+                            AllocationFailed(fullSize, overQuota);
+                            throw MessageBadAlloc(tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), SegmentRef(fSegmentId)), QuotaState(overQuota), ", waited ", waited, "ms for deallocations"));
+                        }
+                        if (++numAttempts == 1) {
+                            FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), SegmentRef(fSegmentId)), QuotaState(overQuota), ". Will wait for deallocations ", (maxWait >= 0 ? "for up to " + std::to_string(maxWait) + "ms" : "until success"));
+                        }
+                        // the interval only bounds a single wait, e.g. to notice interruptions. Deallocations wake the waiter immediately
+                        int64_t nextWait = (maxWait >= 0) ? std::min<int64_t>(maxWait - waited, std::max(fBadAllocAttemptIntervalInMs, 1)) : std::max(fBadAllocAttemptIntervalInMs, 1);
+                        waiter->Wait(nextWait);
+                        continue;
+                    }
+                    if (fBadAllocMaxAttempts >= 0 && ++numAttempts >= fBadAllocMaxAttempts) {
+                        AllocationFailed(fullSize, overQuota);
+                        throw MessageBadAlloc(tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), SegmentRef(fSegmentId)), QuotaState(overQuota)));
+                    }
+                    if (numAttempts == 1 && fBadAllocMaxAttempts > 1) {
+                        FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), SegmentRef(fSegmentId)), QuotaState(overQuota), ". Will try ", (fBadAllocMaxAttempts > 1 ? (std::to_string(fBadAllocMaxAttempts - 1)) + " more times" : " until success"), ", in ", fBadAllocAttemptIntervalInMs, "ms intervals");
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(fBadAllocAttemptIntervalInMs));
+                    if (Interrupted()) {
+                        AllocationFailed(fullSize, overQuota);
+                        throw MessageBadAlloc(tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), SegmentRef(fSegmentId)), QuotaState(overQuota)));
+                    } else {
+                        continue;
+                    }
+                }
+#ifdef FAIRMQ_DEBUG_MODE
+                AddMsgDebug(ptr, size, fSegmentId);
+#endif
+            }
+        } catch (MessageBadAlloc&) {
+            if (reserved) {
+                fQuota->fUsed.fetch_sub(fullSize, std::memory_order_relaxed);
+            }
+            throw;
+        }
+
+        if (fQuota) {
+            ChargeQuota(ptr, allocatedSegmentId, fullSize);
+        }
+        if (segmentId) {
+            *segmentId = allocatedSegmentId;
+        }
+        if (fOwnerSampling > 0) {
+            TagOwner(ptr, size, allocatedSegmentId);
+        }
+        NoteAllocation(ptr, size, fullSize, allocateAligned ? alignment : 0, allocatedSegmentId);
+        if (sampled) {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sampleStart).count();
+            fAllocStats->fSampledAllocs.fetch_add(1, std::memory_order_relaxed);
+            fAllocStats->fAllocNs.fetch_add(ns, std::memory_order_relaxed);
+            fAllocStats->fAllocNsBuckets[SegmentAllocStats::Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+            fAllocStats->fSizeBuckets[SegmentAllocStats::Bucket(size)].fetch_add(1, std::memory_order_relaxed);
+        }
+        return ptr;
+    }
+
+    // whether the calling thread records the current (de)allocation into the allocator statistics
+    bool SampleAllocStats() const
+    {
+        if (fAllocStatsSampling == 0) {
+            return false;
+        }
+        thread_local unsigned int counter = 0;
+        return ++counter % fAllocStatsSampling == 0;
+    }
+
+    // tags every fOwnerSampling-th allocation of the calling thread with the device (see ChunkOwnerTable)
+    void TagOwner(char* ptr, size_t size, uint16_t segmentId)
+    {
+        thread_local unsigned int counter = 0;
+        if (++counter % fOwnerSampling == 0) {
+            uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            fOwnerTable->Add(ChunkOwnerTable::Key(segmentId, GetHandleFromAddress(ptr, segmentId)), size, fOwnerDevice, now);
+        }
+    }
+
+    // adds a device or channel name to the owner table, returns its index (kNoName if the table is full). Caller holds fShmMtx
+    uint16_t AddOwnerName(const std::string& name, uint32_t sampling)
+    {
+        ChunkOwnerTable& table = *fOwnerTable;
+        for (uint16_t i = 0; i < table.fNumNames; ++i) {
+            if (name == table.fNames[i].fName) {
+                table.fNames[i].fSampling = sampling;
+                return i;
+            }
+        }
+        if (table.fNumNames == ChunkOwnerTable::kMaxNames) {
+            LOG(warn) << "shmem: owner table is full, '" << name << "' is not attributed in the monitor";
+            return ChunkOwnerTable::kNoName;
+        }
+        ChunkOwnerTable::Name& entry = table.fNames[table.fNumNames];
+        name.copy(entry.fName, ChunkOwnerTable::kMaxNameLength - 1);
+        entry.fName[std::min(name.size(), ChunkOwnerTable::kMaxNameLength - 1)] = '\0';
+        entry.fSampling = sampling;
+        return table.fNumNames++;
+    }
+
+    // adds (or updates) the quota slot of this device. Caller holds fShmMtx
+    void AddQuota(const std::string& name, size_t soft, size_t hard)
+    {
+        QuotaTable& table = *fQuotaTable;
+        uint16_t slot = 0;
+        while (slot < table.fNumQuotas && name != table.fQuotas[slot].fName) {
+            ++slot;
+        }
+        if (slot == table.fNumQuotas) {
+            if (table.fNumQuotas == QuotaTable::kMaxQuotas) {
+                throw TransportError(tools::ToString("Shared memory quota table is full (", QuotaTable::kMaxQuotas, " devices), cannot add the quota of '", name, "'"));
+            }
+            QuotaTable::Quota& entry = table.fQuotas[slot];
+            name.copy(entry.fName, QuotaTable::kMaxNameLength - 1);
+            entry.fName[std::min(name.size(), QuotaTable::kMaxNameLength - 1)] = '\0';
+            ++table.fNumQuotas;
+        }
+        // chunks of a previous run of the device stay charged to the slot until they are deallocated
+        fQuotaSlot = slot;
+        fQuota = &table.fQuotas[slot];
+        fQuota->fSoft.store(soft, std::memory_order_relaxed);
+        fQuota->fHard.store(hard, std::memory_order_relaxed);
+    }
+
+    std::string QuotaState(bool overQuota) const
+    {
+        return overQuota ? tools::ToString(", hard quota of ", fQuota->fHard.load(std::memory_order_relaxed), " bytes reached by '", fQuota->fName, "'") : "";
+    }
+
+    // reserves size bytes of the quota of this device, false if that exceeds the hard quota
+    bool ReserveQuota(size_t size)
+    {
+        const uint64_t hard = fQuota->fHard.load(std::memory_order_relaxed);
+        if (fQuota->fUsed.fetch_add(size, std::memory_order_relaxed) + size > hard && hard > 0) {
+            fQuota->fUsed.fetch_sub(size, std::memory_order_relaxed);
+            fQuota->fHardRejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // charges the allocated chunk to the quota of this device, replacing the reservation
+    void ChargeQuota(char* ptr, uint16_t segmentId, size_t reservedSize)
+    {
+        ChunkQuota(ptr, segmentId) = fQuotaSlot;
+        const size_t size = boost::apply_visitor(SegmentChunkSize(ptr), SegmentRef(segmentId));
+        const uint64_t used = fQuota->fUsed.fetch_add(size - reservedSize, std::memory_order_relaxed) + (size - reservedSize);
+        uint64_t peak = fQuota->fPeak.load(std::memory_order_relaxed);
+        while (used > peak && !fQuota->fPeak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+        const uint64_t soft = fQuota->fSoft.load(std::memory_order_relaxed);
+        if (soft > 0 && used > soft && !fQuota->fAboveSoft.exchange(true, std::memory_order_relaxed)) {
+            fQuota->fSoftExceeded.fetch_add(1, std::memory_order_relaxed);
+            LOG(warn) << "shmem: '" << fQuota->fName << "' uses " << used << " bytes of managed shared memory, exceeding its soft quota of " << soft << " bytes";
+        }
+    }
+
+    // returns a chunk to the quota it is charged to (if any), before it is deallocated
+    void UnchargeQuota(char* ptr, uint16_t segmentId)
+    {
+        uint16_t& slot = ChunkQuota(ptr, segmentId);
+        if (slot == QuotaTable::kNoQuota) {
+            return;
+        }
+        QuotaTable::Quota& quota = fQuotaTable->fQuotas[slot];
+        slot = QuotaTable::kNoQuota;
+        const size_t size = boost::apply_visitor(SegmentChunkSize(ptr), SegmentRef(segmentId));
+        if (quota.fUsed.fetch_sub(size, std::memory_order_relaxed) - size <= quota.fSoft.load(std::memory_order_relaxed)) {
+            quota.fAboveSoft.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void RecordDeallocations(std::chrono::steady_clock::time_point start, uint64_t numChunks)
+    {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        fAllocStats->fSampledDeallocs.fetch_add(numChunks, std::memory_order_relaxed);
+        fAllocStats->fDeallocNs.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    // counts an allocation that ends with MessageBadAlloc and records the state of the segment for fairmq-shmmonitor
+    // (unless the hard quota was the reason)
+    void AllocationFailed(size_t fullSize, bool overQuota = false)
+    {
+        fNumAllocFailures.fetch_add(1, std::memory_order_relaxed);
+        if (overQuota) {
+            return;
+        }
+        if (fAllocTrace) {
+            fAllocTrace->Failure(fullSize);
+        }
+        auto& segment = SegmentRef(fSegmentId);
+        size_t freeMemory = boost::apply_visitor(SegmentFreeMemory(), segment);
+        size_t largestFreeBlock = boost::apply_visitor(SegmentLargestFreeBlock(), segment);
+        fAllocStats->fFailures.fetch_add(1, std::memory_order_relaxed);
+        if (freeMemory >= fullSize) {
+            fAllocStats->fFragmentedFailures.fetch_add(1, std::memory_order_relaxed);
+        }
+        fAllocStats->fLastFailureSize.store(fullSize, std::memory_order_relaxed);
+        fAllocStats->fLastFailureFreeMemory.store(freeMemory, std::memory_order_relaxed);
+        fAllocStats->fLastFailureLargestFreeBlock.store(largestFreeBlock, std::memory_order_relaxed);
+    }
 
-                if (segmentInfo.fAllocationAlgorithm == AllocationAlgorithm::rbtree_best_fit) {
-                    fSegments.emplace(id, RBTreeBestFitSegment(open_only, std::string("fmq_" + fShmId + "_m_" + std::to_string(id)).c_str()));
+    // single allocation attempt in the given segment, without retries. Returns nullptr if the segment is full
+    char* TryAllocate(uint16_t segmentId, size_t size, size_t alignment)
+    {
+        RefCountTable* table = GetRefCountTable(segmentId);
+        size_t fullSize = table ? RefCountTable::FullSize(size) : ShmHeader::FullSize(size, alignment);
+        if (fullSize > boost::apply_visitor(SegmentSize(), SegmentRef(segmentId))) {
+            return nullptr;
+        }
+        try {
+            char* ptr = nullptr;
+            if (table && alignment > alignof(std::max_align_t)) {
+                ptr = static_cast<char*>(boost::apply_visitor(SegmentAllocateAligned(fullSize, alignment), SegmentRef(segmentId)));
+                table->Construct(GetHandleFromAddress(ptr, segmentId));
+            } else {
+                ptr = boost::apply_visitor(SegmentAllocate{fullSize}, SegmentRef(segmentId));
+                if (table) {
+                    table->Construct(GetHandleFromAddress(ptr, segmentId));
                 } else {
-                    fSegments.emplace(id, SimpleSeqFitSegment(open_only, std::string("fmq_" + fShmId + "_m_" + std::to_string(id)).c_str()));
+                    ShmHeader::Construct(ptr, alignment);
                 }
-            } catch (std::out_of_range& oor) {
-                LOG(error) << "Could not get segment with id '" << id << "': " << oor.what();
-            } catch (boost::interprocess::interprocess_exception& bie) {
-                LOG(error) << "Could not get segment with id '" << id << "': " << bie.what();
             }
+#ifdef FAIRMQ_DEBUG_MODE
+            AddMsgDebug(ptr, size, segmentId);
+#endif
+            return ptr;
+        } catch (boost::interprocess::bad_alloc&) {
+            return nullptr;
         }
     }
 
-    boost::interprocess::managed_shared_memory::handle_t GetHandleFromAddress(const void* ptr, uint16_t segmentId) const
+    // opens (or creates, with the size of the own segment) the segments of the allocation policy, the caller must hold fShmMtx
+    void InitAllocRoutes(const std::string& policy, bool refCountTable)
     {
-        return boost::apply_visitor(SegmentHandleFromAddress(ptr), fSegments.at(segmentId));
+        try {
+            fAllocRoutes = ParseAllocPolicy(policy, fSegmentId);
+        } catch (std::invalid_argument& e) {
+            LOG(error) << "shmem: " << e.what();
+            throw TransportError(tools::ToString("shmem: ", e.what()));
+        }
+        for (const auto& route : fAllocRoutes) {
+            if (route.fSegmentId == fSegmentId || fSegments.count(route.fSegmentId) > 0) {
+                continue;
+            }
+            if (fShmSegments->count(route.fSegmentId) > 0) {
+                GetSegment(route.fSegmentId);
+                if (route.fSlab && fShmSegments->at(route.fSegmentId).fAllocationAlgorithm != AllocationAlgorithm::slab_fit) {
+                    LOG(warn) << "shmem: segment " << route.fSegmentId << " of the allocation policy exists without slab_fit allocation, using it as it is";
+                }
+            } else {
+                CreateSegment(route.fSegmentId, fSegmentSize, route.fSlab ? "slab_fit" : fAllocationAlgorithm, refCountTable);
+                fEventCounter->Increment(route.fSegmentId, true, false);
+                LOG(debug) << "shmem: created segment " << route.fSegmentId << " of the allocation policy (" << (route.fSlab ? "slab_fit" : fAllocationAlgorithm) << ")";
+            }
+            if (fSegments.count(route.fSegmentId) == 0) {
+                throw TransportError(tools::ToString("shmem: could not open segment ", route.fSegmentId, " of the allocation policy '", policy, "'"));
+            }
+        }
     }
-    char* GetAddressFromHandle(const boost::interprocess::managed_shared_memory::handle_t handle, uint16_t segmentId) const
+
+    // segment of the allocation policy for a message of the given size
+    uint16_t RouteAllocation(size_t size) const
     {
-        return boost::apply_visitor(SegmentAddressFromHandle(handle), fSegments.at(segmentId));
+        for (const auto& route : fAllocRoutes) {
+            if (size <= route.fMaxSize) {
+                return route.fSegmentId;
+            }
+        }
+        return fSegmentId;
     }
 
-    char* Allocate(size_t size, size_t alignment = 0)
+    // tries the other segments of the session (preferring the own NUMA node with the numa policy, then the most free memory),
+    // creating new ones (with the size and configuration of the own segment) up to shm-spill-over-max-segments
+    char* AllocateSpillOver(size_t size, size_t alignment, uint16_t& segmentId)
     {
-        alignment = std::max(alignment, alignof(std::max_align_t));
-
-        char* ptr = nullptr;
-        int numAttempts = 0;
-        size_t fullSize = ShmHeader::FullSize(size, alignment);
+        using namespace boost::interprocess;
 
-        while (!ptr) {
-            try {
-                size_t segmentSize = boost::apply_visitor(SegmentSize(), fSegments.at(fSegmentId));
-                if (fullSize > segmentSize) {
-                    throw MessageBadAlloc(tools::ToString("Requested message size (", fullSize, ") exceeds segment size (", segmentSize, ")"));
+        std::vector<std::pair<uint16_t, int>> segments; // id, NUMA node
+        {
+            scoped_lock<RobustMutex> lock(*fShmMtx);
+            for (const auto& s : *fShmSegments) {
+                if (s.first != fSegmentId) {
+                    segments.emplace_back(s.first, s.second.fNumaNode);
                 }
+            }
+        }
 
-                ptr = boost::apply_visitor(SegmentAllocate{fullSize}, fSegments.at(fSegmentId));
-                ShmHeader::Construct(ptr, alignment);
-            } catch (boost::interprocess::bad_alloc& ba) {
-                // LOG(warn) << "Shared memory full...";
-                if (fBadAllocMaxAttempts >= 0 && ++numAttempts >= fBadAllocMaxAttempts) {
-                    throw MessageBadAlloc(tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), fSegments.at(fSegmentId))));
-                }
-                if (numAttempts == 1 && fBadAllocMaxAttempts > 1) {
-                    LOG(warn) << tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), fSegments.at(fSegmentId)), ". Will try ", (fBadAllocMaxAttempts > 1 ? (std::to_string(fBadAllocMaxAttempts - 1)) + " more times" : " until success"), ", in ", fBadAllocAttemptIntervalInMs, "ms intervals");
-                }
-                std::this_thread::sleep_for(std::chrono::milliseconds(fBadAllocAttemptIntervalInMs));
-                if (Interrupted()) {
-                    throw MessageBadAlloc(tools::ToString("shmem: could not create a message of size ", size, ", alignment: ", (alignment != 0) ? std::to_string(alignment) : "default", ", free memory: ", boost::apply_visitor(SegmentFreeMemory(), fSegments.at(fSegmentId))));
-                } else {
-                    continue;
+        std::vector<std::tuple<bool, size_t, uint16_t>> candidates; // remote NUMA node, free memory, id
+        for (const auto& [id, numaNode] : segments) {
+            GetSegment(id);
+            if (fSegments.count(id) == 0) {
+                continue;
+            }
+            bool remote = fSpillOver == SpillOverPolicy::numa && numaNode != fNumaNode;
+            candidates.emplace_back(remote, boost::apply_visitor(SegmentFreeMemory(), SegmentRef(id)), id);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+            return std::get<0>(a) != std::get<0>(b) ? !std::get<0>(a) : std::get<1>(a) > std::get<1>(b);
+        });
+
+        for (const auto& c : candidates) {
+            if (std::get<1>(c) < size) {
+                continue;
+            }
+            char* ptr = TryAllocate(std::get<2>(c), size, alignment);
+            if (ptr) {
+                segmentId = std::get<2>(c);
+                return ptr;
+            }
+        }
+
+        uint16_t id = 0;
+        try {
+            scoped_lock<RobustMutex> lock(*fShmMtx);
+            if (fSpillOverCreatedSegments >= fSpillOverMaxSegments) {
+                return nullptr;
+            }
+            while (fShmSegments->count(id) > 0) {
+                if (id == std::numeric_limits<uint16_t>::max()) {
+                    return nullptr;
                 }
+                ++id;
+            }
+            CreateSegment(id, fSegmentSize, fAllocationAlgorithm, fLocalRefCountTable != nullptr);
+            ++fSpillOverCreatedSegments;
+            fEventCounter->Increment(id, true, false);
+        } catch (interprocess_exception& e) {
+            LOG(warn) << "shmem: could not create spill-over segment " << id << ": " << e.what();
+            return nullptr;
+        }
+        LOG(debug) << "shmem: own segment " << fSegmentId << " is full, created spill-over segment " << id << " (" << fSpillOverCreatedSegments << "/" << fSpillOverMaxSegments << ")";
+        if (fNumaNode >= 0) {
+            BindSegmentToNumaNode(id);
+        }
+
+        char* ptr = TryAllocate(id, size, alignment);
+        if (ptr) {
+            segmentId = id;
+        }
+        return ptr;
+    }
+
+    // records a chunk allocated from a segment (by Allocate or AllocateMany) in the instrumentation of the allocations.
+    // alignment is the explicit alignment of the allocation, 0 if the chunk is aligned by its layout
+    void NoteAllocation(char* ptr, [[maybe_unused]] size_t size, size_t fullSize, size_t alignment, uint16_t segmentId)
+    {
+        fNumAllocations.Add();
+        FAIRMQ_PROBE(shm_allocate, ptr, size, segmentId);
+        if (fAllocTrace) {
+            fAllocTrace->Alloc(ChunkOwnerTable::Key(segmentId, GetHandleFromAddress(ptr, segmentId)), fullSize, alignment);
+        }
+    }
+
+    // allocates count buffers of the given size, in a single segment transaction if possible.
+    // falls back to individual allocations (with their retry/bad_alloc behaviour, shm-alloc-policy routing and spill-over)
+    // if this fails. @return the chunks with the ids of the segments they were allocated from
+    std::vector<std::pair<char*, uint16_t>> AllocateMany(size_t count, size_t size, size_t alignment = 0)
+    {
+        std::vector<std::pair<char*, uint16_t>> chunks;
+        chunks.reserve(count);
+
+        if (count == 0) {
+            return chunks;
+        }
+
+        alignment = std::max(alignment, alignof(std::max_align_t));
+        // chunks charged to a quota go through Allocate, which enforces it, as well as chunks routed to another segment
+        if (!fAllocationCacheEnabled && !fQuota && !(fLocalRefCountTable && alignment > alignof(std::max_align_t))
+            && (fAllocRoutes.empty() || RouteAllocation(size) == fSegmentId)) {
+            size_t fullSize = ChunkFullSize(size, alignment);
+            std::vector<char*> ptrs;
+            ptrs.reserve(count);
+            if (fullSize <= boost::apply_visitor(SegmentSize(), SegmentRef(fSegmentId))) {
+                boost::apply_visitor(SegmentAllocateMany(fullSize, count, ptrs), SegmentRef(fSegmentId));
             }
+            for (char* ptr : ptrs) {
+                ConstructChunk(ptr, alignment);
 #ifdef FAIRMQ_DEBUG_MODE
-            boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*fShmMtx);
-            IncrementShmMsgCounter(fSegmentId);
-            if (fMsgDebug->count(fSegmentId) == 0) {
-                fMsgDebug->emplace(fSegmentId, fShmVoidAlloc);
-            }
-            fMsgDebug->at(fSegmentId).emplace(
-                static_cast<size_t>(GetHandleFromAddress(ShmHeader::UserPtr(ptr), fSegmentId)),
-                MsgDebug(getpid(), size, std::chrono::system_clock::now().time_since_epoch().count())
-            );
+                AddMsgDebug(ptr, size, fSegmentId);
 #endif
+                if (fOwnerSampling > 0) {
+                    TagOwner(ptr, size, fSegmentId);
+                }
+                NoteAllocation(ptr, size, fullSize, 0, fSegmentId);
+                chunks.emplace_back(ptr, fSegmentId);
+            }
         }
 
-        return ptr;
+        try {
+            while (chunks.size() < count) {
+                uint16_t segmentId = fSegmentId;
+                char* ptr = Allocate(size, alignment, &segmentId);
+                chunks.emplace_back(ptr, segmentId);
+            }
+        } catch (MessageBadAlloc&) {
+            for (const auto& [ptr, segmentId] : chunks) {
+                Deallocate(GetHandleFromAddress(ptr, segmentId), segmentId);
+            }
+            throw;
+        }
+
+        return chunks;
     }
 
     void Deallocate(boost::interprocess::managed_shared_memory::handle_t handle, uint16_t segmentId)
     {
+        if (DeferringFrees() && DeferDeallocation(handle, segmentId)) {
+            return;
+        }
+        fNumDeallocations.Add();
+        const bool sampled = SampleAllocStats();
+        const auto sampleStart = sampled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
         char* ptr = GetAddressFromHandle(handle, segmentId);
+        FAIRMQ_PROBE(shm_deallocate, ptr, handle, segmentId);
+        if (ReleaseArenaChunk(ptr, segmentId)) {
+            return;
+        }
+        if (fAllocTrace) {
+            fAllocTrace->Dealloc(ChunkOwnerTable::Key(segmentId, handle), boost::apply_visitor(SegmentChunkSize(ptr), SegmentRef(segmentId)));
+        }
+        if (OwnerTagsPresent()) {
+            fOwnerTable->Remove(ChunkOwnerTable::Key(segmentId, handle));
+        }
 #ifdef FAIRMQ_DEBUG_MODE
-        boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(*fShmMtx);
+        boost::interprocess::scoped_lock<RobustMutex> lock(*fDebugMtx);
         DecrementShmMsgCounter(segmentId);
         try {
-            fMsgDebug->at(segmentId).erase(GetHandleFromAddress(ShmHeader::UserPtr(ptr), fSegmentId));
+            fMsgDebug->at(segmentId).erase(GetHandleFromAddress(UserPtr(ptr, segmentId), segmentId));
         } catch (const std::out_of_range& oor) {
             LOG(debug) << "could not locate debug container for " << segmentId << ": " << oor.what();
         }
 #endif
-        ShmHeader::Destruct(ptr);
-        boost::apply_visitor(SegmentDeallocate(ptr), fSegments.at(segmentId));
+        UnchargeQuota(ptr, segmentId);
+        RefCountTable* table = GetRefCountTable(segmentId);
+        if (table) {
+            table->Destruct(handle);
+        } else {
+            ShmHeader::Destruct(ptr);
+        }
+        if (fAllocationCacheEnabled && segmentId == fSegmentId && DeallocateToCache(ptr)) {
+            if (sampled) {
+                RecordDeallocations(sampleStart, 1);
+            }
+            return;
+        }
+        boost::apply_visitor(SegmentDeallocate(ptr), SegmentRef(segmentId));
+        NotifyDeallocation();
+        if (sampled) {
+            RecordDeallocations(sampleStart, 1);
+        }
+    }
+
+    // deallocates chunks given as (segment id, handle), with one allocator transaction per segment
+    void DeallocateMany(std::vector<std::pair<uint16_t, boost::interprocess::managed_shared_memory::handle_t>>& chunks)
+    {
+        if (DeferringFrees()) {
+            chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [&](const auto& chunk) { return DeferDeallocation(chunk.second, chunk.first); }), chunks.end());
+        }
+        if (chunks.empty()) {
+            return;
+        }
+        fNumDeallocations.Add(chunks.size());
+        const bool sampled = SampleAllocStats();
+        const auto sampleStart = sampled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        std::sort(chunks.begin(), chunks.end());
+        if (OwnerTagsPresent()) {
+            for (const auto& [segmentId, handle] : chunks) {
+                fOwnerTable->Remove(ChunkOwnerTable::Key(segmentId, handle));
+            }
+        }
+        std::vector<char*> ptrs;
+        auto it = chunks.begin();
+        while (it != chunks.end()) {
+            const uint16_t segmentId = it->first;
+            RefCountTable* table = GetRefCountTable(segmentId);
+            ptrs.clear();
+            for (; it != chunks.end() && it->first == segmentId; ++it) {
+                char* ptr = GetAddressFromHandle(it->second, segmentId);
+                if (ReleaseArenaChunk(ptr, segmentId)) {
+                    continue;
+                }
+                if (fAllocTrace) {
+                    fAllocTrace->Dealloc(ChunkOwnerTable::Key(segmentId, it->second), boost::apply_visitor(SegmentChunkSize(ptr), SegmentRef(segmentId)));
+                }
+#ifdef FAIRMQ_DEBUG_MODE
+                boost::interprocess::scoped_lock<RobustMutex> lock(*fDebugMtx);
+                DecrementShmMsgCounter(segmentId);
+                try {
+                    fMsgDebug->at(segmentId).erase(GetHandleFromAddress(UserPtr(ptr, segmentId), segmentId));
+                } catch (const std::out_of_range& oor) {
+                    LOG(debug) << "could not locate debug container for " << segmentId << ": " << oor.what();
+                }
+#endif
+                UnchargeQuota(ptr, segmentId);
+                if (table) {
+                    table->Destruct(it->second);
+                } else {
+                    ShmHeader::Destruct(ptr);
+                }
+                if (fAllocationCacheEnabled && segmentId == fSegmentId && DeallocateToCache(ptr)) {
+                    continue;
+                }
+                ptrs.push_back(ptr);
+            }
+            if (!ptrs.empty()) {
+                boost::apply_visitor(SegmentDeallocateMany(ptrs), SegmentRef(segmentId));
+            }
+        }
+        NotifyDeallocation();
+        if (sampled) {
+            RecordDeallocations(sampleStart, chunks.size());
+        }
+    }
+
+    // Deferred deallocation (--shm-deferred-free): chunks released by the threads of the process are queued and deallocated
+    // in batches (DeallocateMany) by a background thread, within fDeferredFreeIntervalInMs. Queued bytes are bounded by
+    // fDeferredFreeMaxBytes, beyond it (or with a full queue) chunks are deallocated synchronously.
+    static bool& InDeferredFreeThread()
+    {
+        thread_local bool inThread = false;
+        return inThread;
+    }
+
+    bool DeferringFrees() const { return fDeferredFree && !InDeferredFreeThread(); }
+
+    // @return false if the chunk has to be deallocated synchronously
+    bool DeferDeallocation(boost::interprocess::managed_shared_memory::handle_t handle, uint16_t segmentId)
+    {
+        char* ptr = GetAddressFromHandle(handle, segmentId);
+        if (ChunkQuota(ptr, segmentId) == QuotaTable::kArenaChunk) {
+            return false; // only drops a reference of the arena
+        }
+        const size_t size = boost::apply_visitor(SegmentChunkSize(ptr), SegmentRef(segmentId));
+        const uint64_t queued = fDeferredBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        if (queued > fDeferredFreeMaxBytes || !fDeferredFrees->Push(DeferredFree{handle, size, segmentId})) {
+            fDeferredBytes.fetch_sub(size, std::memory_order_relaxed);
+            WakeDeferredFrees();
+            return false;
+        }
+        if (queued > fDeferredFreeMaxBytes / 2) {
+            WakeDeferredFrees();
+        }
+        return true;
+    }
+
+    void WakeDeferredFrees()
+    {
+        if (!fDeferredFreeWakeup.exchange(true, std::memory_order_relaxed)) {
+            fDeferredFreeCV.notify_one();
+        }
+    }
+
+    // deallocates the queued chunks, returns the number of bytes
+    size_t DrainDeferredFrees()
+    {
+        std::lock_guard<std::mutex> lock(fDeferredDrainMtx);
+        bool& inThread = InDeferredFreeThread();
+        const bool wasInThread = inThread;
+        inThread = true; // not deferred again
+        uint64_t bytes = 0;
+        DeferredFree entry{};
+        fDeferredBatch.clear();
+        while (fDeferredFrees->Pop(entry)) {
+            fDeferredBatch.emplace_back(entry.fSegmentId, entry.fHandle);
+            bytes += entry.fSize;
+        }
+        DeallocateMany(fDeferredBatch);
+        fDeferredBytes.fetch_sub(bytes, std::memory_order_relaxed);
+        inThread = wasInThread;
+        return bytes;
+    }
+
+    void FreeDeferred()
+    {
+        ApplyThreadSettings("deallocation thread");
+        InDeferredFreeThread() = true;
+        std::unique_lock<std::mutex> lock(fDeferredFreeMtx);
+        while (!fDeferredFreeStop) {
+            lock.unlock();
+            DrainDeferredFrees();
+            lock.lock();
+            fDeferredFreeCV.wait_for(lock, std::chrono::milliseconds(fDeferredFreeIntervalInMs), [&]() { return fDeferredFreeStop || fDeferredFreeWakeup.load(std::memory_order_relaxed); });
+            fDeferredFreeWakeup.store(false, std::memory_order_relaxed);
+        }
+        lock.unlock();
+        DrainDeferredFrees();
+    }
+
+    void StopDeferredFrees()
+    {
+        if (!fDeferredFreeThread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(fDeferredFreeMtx);
+            fDeferredFreeStop = true;
+        }
+        fDeferredFreeCV.notify_one();
+        fDeferredFreeThread.join();
+        fDeferredFree = false;
+    }
+
+    // asks all processes of the session to return their caches of the local segment (on their next cache access or
+    // heartbeat, which wakes waiters of --shm-bad-alloc-wait), returns the number of bytes released by this process
+    size_t RequestCacheRelease()
+    {
+        if (fCacheCounter->fBytes.load(std::memory_order_relaxed) == 0) {
+            return 0;
+        }
+        const uint64_t requests = fCacheCounter->fReleaseRequests.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (!fAllocationCacheEnabled) {
+            return 0;
+        }
+        fCacheReleaseRequestsSeen.store(requests, std::memory_order_relaxed);
+        return ReleaseAllocationCache();
+    }
+
+    // returns all buffers held by the allocation cache to the segment, returns number of released bytes
+    size_t ReleaseAllocationCache()
+    {
+        size_t released = 0;
+        for (auto& shard : fAllocationCache) {
+            std::lock_guard<std::mutex> lock(shard.fMtx);
+            for (size_t c = 0; c < kNumSizeClasses; ++c) {
+                released += ReleaseCachedBuffers(shard.fFreeLists.at(c), c, shard.fFreeLists.at(c).size());
+            }
+        }
+        return released;
     }
 
     char* ShrinkInPlace(size_t newSize, char* localPtr, uint16_t segmentId)
     {
-        return boost::apply_visitor(SegmentBufferShrink(newSize, localPtr), fSegments.at(segmentId));
+        const uint16_t slot = ChunkQuota(localPtr, segmentId);
+        if (slot == QuotaTable::kArenaChunk) {
+            return localPtr; // arena memory is only returned with the arena
+        }
+        if (GetRefCountTable(segmentId)) {
+            newSize = RefCountTable::FullSize(newSize); // keep chunks at least one table entry apart
+        }
+        const size_t oldSize = slot != QuotaTable::kNoQuota ? boost::apply_visitor(SegmentChunkSize(localPtr), SegmentRef(segmentId)) : 0;
+        char* ptr = boost::apply_visitor(SegmentBufferShrink(newSize, localPtr), SegmentRef(segmentId));
+        if (ptr && slot != QuotaTable::kNoQuota) {
+            fQuotaTable->fQuotas[slot].fUsed.fetch_sub(oldSize - boost::apply_visitor(SegmentChunkSize(ptr), SegmentRef(segmentId)), std::memory_order_relaxed);
+        }
+        return ptr;
+    }
+
+    // @return true if the chunk at localPtr could be expanded to newSize without moving it (and within the hard quota)
+    bool ExpandInPlace(size_t newSize, char* localPtr, uint16_t segmentId)
+    {
+        if (GetRefCountTable(segmentId)) {
+            newSize = RefCountTable::FullSize(newSize);
+        }
+        const uint16_t slot = ChunkQuota(localPtr, segmentId);
+        if (slot == QuotaTable::kArenaChunk) {
+            return false;
+        }
+        if (slot == QuotaTable::kNoQuota) {
+            return boost::apply_visitor(SegmentBufferExpand(newSize, localPtr), SegmentRef(segmentId)) == localPtr;
+        }
+        QuotaTable::Quota& quota = fQuotaTable->fQuotas[slot];
+        const size_t oldSize = boost::apply_visitor(SegmentChunkSize(localPtr), SegmentRef(segmentId));
+        const uint64_t hard = quota.fHard.load(std::memory_order_relaxed);
+        if (hard > 0 && newSize > oldSize && quota.fUsed.load(std::memory_order_relaxed) + (newSize - oldSize) > hard) {
+            return false; // the caller reallocates, which waits for or rejects the quota
+        }
+        if (boost::apply_visitor(SegmentBufferExpand(newSize, localPtr), SegmentRef(segmentId)) != localPtr) {
+            return false;
+        }
+        quota.fUsed.fetch_add(boost::apply_visitor(SegmentChunkSize(localPtr), SegmentRef(segmentId)) - oldSize, std::memory_order_relaxed);
+        return true;
     }
 
     uint16_t GetSegmentId() const { return fSegmentId; }
 
+    /// whether chunks of the session are tagged with their owners (--shm-owner-sampling of any device)
+    bool OwnerTagsPresent() const { return fOwnerTable->fNumTags.load(std::memory_order_relaxed) != 0; }
+    uint16_t RegisterOwnerChannel(const std::string& name)
+    {
+        boost::interprocess::scoped_lock<RobustMutex> lock(*fShmMtx);
+        return AddOwnerName(name, 0);
+    }
+    /// records a reference to a managed chunk acquired by this process in its ledger (--shm-reclaim)
+    void Own(uint16_t segmentId, boost::interprocess::managed_shared_memory::handle_t handle)
+    {
+        if (fLedger) {
+            fLedger->Add(ChunkLedger::Key(segmentId, handle));
+        }
+    }
+    void Own(const MetaHeader& meta)
+    {
+        if (fLedger && meta.fManaged && meta.fHandle >= 0) {
+            fLedger->Add(ChunkLedger::Key(meta.fSegmentId, meta.fHandle));
+        }
+    }
+    /// removes a reference from the ledger of this process, before it is released or handed over to a socket
+    void Disown(uint16_t segmentId, boost::interprocess::managed_shared_memory::handle_t handle)
+    {
+        if (fLedger) {
+            fLedger->Remove(ChunkLedger::Key(segmentId, handle));
+        }
+    }
+    void Disown(const MetaHeader& meta)
+    {
+        if (fLedger && meta.fManaged && meta.fHandle >= 0) {
+            fLedger->Remove(ChunkLedger::Key(meta.fSegmentId, meta.fHandle));
+        }
+    }
+
+    /// records the channel a (tagged) chunk is sent on
+    void TagOwnerChannel(uint16_t segmentId, boost::interprocess::managed_shared_memory::handle_t handle, uint16_t channel)
+    {
+        ChunkOwnerTable::Tag* tag = fOwnerTable->Find(ChunkOwnerTable::Key(segmentId, handle));
+        if (tag) {
+            tag->fChannel.store(channel, std::memory_order_relaxed);
+        }
+    }
+
     void CleanupIfLast()
     {
         using namespace boost::interprocess;
 
         bool lastRemoved = false;
         try {
-            boost::interprocess::scoped_lock<interprocess_mutex> lock(*fShmMtx);
+            boost::interprocess::scoped_lock<RobustMutex> lock(*fShmMtx);
 
             (fDeviceCounter->fCount)--;
 
@@ -831,25 +2886,247 @@ class Manager
     ~Manager()
     {
         fRegionsGen += 1; // signal TL cache invalidation
+        {
+            // the regions still mapped (viewers, regions not released by the user) linger concurrently with the rest of
+            // the teardown, they are joined when fRegions is destroyed
+            std::lock_guard<std::mutex> lock(fLocalRegionsMtx);
+            const auto now = std::chrono::steady_clock::now();
+            for (auto& [id, region] : fRegions) {
+                region->RequestStopAcks(now + std::chrono::milliseconds(region->GetLinger()));
+            }
+        }
         UnsubscribeFromRegionEvents();
+        UnsubscribeFromMemoryWatermarks();
+        StopPremap();
+
+        if (fSegmentInitThread.joinable()) {
+            fStopSegmentInit = true;
+            fSegmentInitThread.join();
+        }
+
+        StopDeferredFrees();
+
+        if (fAllocationCacheEnabled) {
+            ReleaseAllocationCache();
+        }
 
         StopHeartbeats();
+        RemoveFromLivenessTable();
+        RemoveLedger();
 
         CleanupIfLast();
     }
 
   private:
+    // Allocation cache: buffers of the local managed segment, grouped by power of two size classes.
+    // The buffers stay allocated in the segment while cached (and are accounted as such by the monitor),
+    // which allows serving allocations and deallocations without taking the segment lock.
+    // The cache is split into mutex guarded shards, threads are mapped to them by a hash of their id.
+    // The shards are refilled and drained in bulk (one segment lock per batch).
+    // A process caches at most fAllocationCacheMaxBytes and returns the cache when another process of the session fails
+    // to allocate from the segment (the buffers freed by a consumer are cached by the consumer).
+    static constexpr size_t kMinSizeClassShift = 8;   // 256 bytes
+    static constexpr size_t kMaxSizeClassShift = 20;  // 1 MiB
+    static constexpr size_t kNumSizeClasses = kMaxSizeClassShift - kMinSizeClassShift + 1;
+    static constexpr size_t kNumCacheShards = 16;
+
+    struct AllocationCacheShard
+    {
+        std::mutex fMtx;
+        std::array<std::vector<char*>, kNumSizeClasses> fFreeLists;
+    };
+
+    static size_t SizeClassSize(size_t sizeClass) { return size_t(1) << (sizeClass + kMinSizeClassShift); }
+
+    AllocationCacheShard& LocalCacheShard()
+    {
+        return fAllocationCache.at(std::hash<std::thread::id>()(std::this_thread::get_id()) % kNumCacheShards);
+    }
+
+    char* AllocateFromCache(size_t fullSize)
+    {
+        if (fullSize > SizeClassSize(kNumSizeClasses - 1)) {
+            return nullptr;
+        }
+        // smallest class that fits the request
+        size_t sizeClass = 0;
+        while (SizeClassSize(sizeClass) < fullSize) {
+            ++sizeClass;
+        }
+
+        if (CheckCacheReleaseRequests()) {
+            return nullptr; // the segment is short of memory, do not refill
+        }
+        AllocationCacheShard& shard = LocalCacheShard();
+        std::lock_guard<std::mutex> lock(shard.fMtx);
+        std::vector<char*>& freeList = shard.fFreeLists.at(sizeClass);
+        if (freeList.empty()) {
+            // refill half of the depth in one go, within the limit of the process (the first buffer is handed out)
+            const size_t cached = fLocalCachedBytes.load(std::memory_order_relaxed);
+            const size_t room = fAllocationCacheMaxBytes > cached ? fAllocationCacheMaxBytes - cached : 0;
+            size_t batch = std::min(std::max(fAllocationCacheDepth / 2, size_t(1)), room / SizeClassSize(sizeClass) + 1);
+            boost::apply_visitor(SegmentAllocateMany(SizeClassSize(sizeClass), batch, freeList), SegmentRef(fSegmentId));
+            if (freeList.empty()) {
+                return nullptr;
+            }
+            fCachedBytes->fetch_add(freeList.size() * SizeClassSize(sizeClass), std::memory_order_relaxed);
+            fLocalCachedBytes.fetch_add(freeList.size() * SizeClassSize(sizeClass), std::memory_order_relaxed);
+        }
+        char* ptr = freeList.back();
+        freeList.pop_back();
+        fCachedBytes->fetch_sub(SizeClassSize(sizeClass), std::memory_order_relaxed);
+        fLocalCachedBytes.fetch_sub(SizeClassSize(sizeClass), std::memory_order_relaxed);
+        return ptr;
+    }
+
+    bool DeallocateToCache(char* ptr)
+    {
+        size_t bufferSize = boost::apply_visitor(SegmentBufferSize(ptr), SegmentRef(fSegmentId));
+        if (bufferSize < SizeClassSize(0) || bufferSize >= 2 * SizeClassSize(kNumSizeClasses - 1)) {
+            return false;
+        }
+        // largest class that is covered by the buffer
+        size_t sizeClass = kNumSizeClasses - 1;
+        while (SizeClassSize(sizeClass) > bufferSize) {
+            --sizeClass;
+        }
+
+        if (CheckCacheReleaseRequests()) {
+            return false;
+        }
+        AllocationCacheShard& shard = LocalCacheShard();
+        std::lock_guard<std::mutex> lock(shard.fMtx);
+        std::vector<char*>& freeList = shard.fFreeLists.at(sizeClass);
+        if (freeList.size() >= fAllocationCacheDepth) {
+            // drain half of the depth in one go
+            ReleaseCachedBuffers(freeList, sizeClass, std::max(fAllocationCacheDepth / 2, size_t(1)));
+        }
+        if (fLocalCachedBytes.load(std::memory_order_relaxed) + SizeClassSize(sizeClass) > fAllocationCacheMaxBytes) {
+            return false;
+        }
+        freeList.push_back(ptr);
+        fCachedBytes->fetch_add(SizeClassSize(sizeClass), std::memory_order_relaxed);
+        fLocalCachedBytes.fetch_add(SizeClassSize(sizeClass), std::memory_order_relaxed);
+        return true;
+    }
+
+    // returns the cache if another process asked for it (RequestCacheRelease) since the last check, @return true if so
+    bool CheckCacheReleaseRequests()
+    {
+        const uint64_t requests = fCacheCounter->fReleaseRequests.load(std::memory_order_relaxed);
+        if (requests == fCacheReleaseRequestsSeen.load(std::memory_order_relaxed) || fCacheReleaseRequestsSeen.exchange(requests, std::memory_order_relaxed) == requests) {
+            return false;
+        }
+        ReleaseAllocationCache();
+        return true;
+    }
+
+    // registers the calling thread as waiting for deallocations (see DeallocationNotifier) for its lifetime
+    class DeallocationWaiter
+    {
+      public:
+        explicit DeallocationWaiter(DeallocationNotifier& notifier)
+            : fNotifier(notifier)
+        {
+            boost::interprocess::scoped_lock<RobustMutex> lock(fNotifier.fMtx);
+            ++(fNotifier.fWaiters);
+            fGeneration = fNotifier.fGeneration;
+        }
+
+        DeallocationWaiter(const DeallocationWaiter&) = delete;
+        DeallocationWaiter& operator=(const DeallocationWaiter&) = delete;
+
+        // waits until memory has been freed since the registration or the previous wait, returns false on timeout
+        bool Wait(int64_t timeoutInMs)
+        {
+            auto until = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeoutInMs);
+            boost::interprocess::scoped_lock<RobustMutex> lock(fNotifier.fMtx);
+            while (fNotifier.fGeneration == fGeneration) {
+                if (!fNotifier.fCV.timed_wait(lock, until)) {
+                    break;
+                }
+            }
+            bool freed = fNotifier.fGeneration != fGeneration;
+            fGeneration = fNotifier.fGeneration;
+            return freed;
+        }
+
+        ~DeallocationWaiter() { --(fNotifier.fWaiters); }
+
+      private:
+        DeallocationNotifier& fNotifier;
+        uint64_t fGeneration;
+    };
+
+    void NotifyDeallocation()
+    {
+        if (fDeallocationNotifier->fWaiters.load() > 0) {
+            boost::interprocess::scoped_lock<RobustMutex> lock(fDeallocationNotifier->fMtx);
+            ++(fDeallocationNotifier->fGeneration);
+            fDeallocationNotifier->fCV.notify_all();
+        }
+    }
+
+    // total time an allocation waits for deallocations with --shm-bad-alloc-wait, -1 is infinite.
+    // defaults to the total retry time of the interval based mode
+    int64_t BadAllocMaxWait() const
+    {
+        if (fBadAllocMaxWaitInMs >= 0) {
+            return fBadAllocMaxWaitInMs;
+        }
+        if (fBadAllocMaxAttempts < 0) {
+            return -1;
+        }
+        return static_cast<int64_t>(std::max(fBadAllocMaxAttempts - 1, 0)) * fBadAllocAttemptIntervalInMs;
+    }
+
+    // returns n buffers from the back of the free list to the segment. expects shard lock to be held.
+    size_t ReleaseCachedBuffers(std::vector<char*>& freeList, size_t sizeClass, size_t n)
+    {
+        n = std::min(n, freeList.size());
+        if (n == 0) {
+            return 0;
+        }
+        std::vector<char*> toRelease(freeList.end() - n, freeList.end());
+        freeList.resize(freeList.size() - n);
+        boost::apply_visitor(SegmentDeallocateMany(toRelease), SegmentRef(fSegmentId));
+        fCachedBytes->fetch_sub(n * SizeClassSize(sizeClass), std::memory_order_relaxed);
+        fLocalCachedBytes.fetch_sub(n * SizeClassSize(sizeClass), std::memory_order_relaxed);
+        NotifyDeallocation();
+        return n * SizeClassSize(sizeClass);
+    }
+
     uint64_t fShmId64;
     std::string fShmId;
     uint16_t fSegmentId;
-    std::unordered_map<uint16_t, boost::variant<RBTreeBestFitSegment, SimpleSeqFitSegment>> fSegments; // TODO: refactor to use Segment class
+    std::unordered_map<uint16_t, SegmentVariant> fSegments; // TODO: refactor to use Segment class
+    SegmentVariant* fLocalSegment = nullptr; // fSegments.at(fSegmentId), the nodes of the map are stable
+
+    // base addresses and ref count tables of the opened segments, indexed by id in blocks of kSegmentBlockSize ids
+    // (created on first use): handle <-> pointer translations are a load and an add instead of a hash lookup and a
+    // variant dispatch. Every entry is written once (under fSegmentBasesMtx) before the segment is used and read without
+    // locking, the table before the base.
+    static constexpr size_t kSegmentBlockSize = 256;
+    struct SegmentEntry
+    {
+        std::atomic<char*> fBase;
+        std::atomic<RefCountTable*> fRefCounts; // nullptr if the segment uses ShmHeader
+    };
+    using SegmentBlock = std::array<SegmentEntry, kSegmentBlockSize>;
+    std::array<std::atomic<SegmentBlock*>, (std::numeric_limits<uint16_t>::max() + 1) / kSegmentBlockSize> fSegmentBases{};
+    std::vector<std::unique_ptr<SegmentBlock>> fSegmentBlocks;
+    std::mutex fSegmentBasesMtx;
     boost::interprocess::managed_shared_memory fManagementSegment; // TODO: refactor to use ManagementSegment class
     VoidAlloc fShmVoidAlloc;
-    boost::interprocess::interprocess_mutex* fShmMtx;
+    // locks of the management segment, taken in this order (after fLocalRegionsMtx, before the EventCounter mutex)
+    RobustMutex* fShmMtx;     // segment table, session info, process tables, object store
+    RobustMutex* fRegionsMtx; // unmanaged region table
+#ifdef FAIRMQ_DEBUG_MODE
+    RobustMutex* fDebugMtx;   // message debug maps
+#endif
 
     std::mutex fLocalRegionsMtx;
     std::mutex fRegionEventsMtx;
-    std::condition_variable fRegionEventsCV;
     std::thread fRegionEventThread;
     std::function<void(fair::mq::RegionInfo)> fRegionEventCallback;
     std::map<std::pair<uint16_t, bool>, RegionEvent> fObservedRegionEvents; // pair: <region id, managed>
@@ -859,6 +3136,7 @@ class Manager
     EventCounter* fEventCounter;
     Uint16SegmentInfoHashMap* fShmSegments;
     Uint16RegionInfoHashMap* fShmRegions;
+    std::unique_ptr<AckReactor> fAckReactor; // --shm-ack-reactor, outlives the regions
     std::unordered_map<uint16_t, std::unique_ptr<UnmanagedRegion>> fRegions;
     inline static std::atomic<unsigned long> fRegionsGen = 0ul;
     inline static thread_local struct ManagerTLCache {
@@ -877,13 +3155,109 @@ class Manager
     std::mutex fHeartbeatsMtx;
     std::condition_variable fHeartbeatsCV;
     bool fBeatTheHeart;
-
-    bool fRegionEventsSubscriptionActive;
+    int fHeartbeatIntervalInMs;
+    int fStatsIntervalInMs; // --shm-stats-interval, 0: the usage counters are not published
+    UsageTable* fUsageTable; // in the management segment
+    std::atomic<bool> fPublishUsage; // set once the constructor has finished
+    tools::PerThreadCounter fNumAllocations; // of this process, published into the UsageTable entry of fSegmentId
+    tools::PerThreadCounter fNumDeallocations;
+    std::unordered_map<uint32_t, PublishedUsage> fPublishedUsage;
+    LivenessTable* fLivenessTable; // in the management segment, with --shm-liveness pid
+    int fLivenessSlot;
+    LedgerTable* fLedgerTable; // in the management segment, with --shm-reclaim
+    int fLedgerSlot;
+    std::unique_ptr<ChunkLedger> fLedger; // references held by this process, with --shm-reclaim
+
+    std::atomic<bool> fRegionEventsSubscriptionActive;
     std::atomic<bool> fInterrupted;
 
     int fBadAllocMaxAttempts;
     int fBadAllocAttemptIntervalInMs;
+    bool fBadAllocWait;
+    int fBadAllocMaxWaitInMs;
+    std::atomic<uint64_t> fNumBadAllocs; // failed allocation attempts (retried, waited for or thrown)
+    std::atomic<uint64_t> fNumAllocFailures; // MessageBadAlloc thrown to the caller
+    SegmentAllocStats* fAllocStats; // of fSegmentId, in the management segment
+    unsigned int fAllocStatsSampling; // record every n-th (de)allocation per thread into fAllocStats, 0: off
+    std::unique_ptr<AllocTraceWriter> fAllocTrace; // --shm-alloc-trace, nullptr: off
+    ChunkOwnerTable* fOwnerTable; // in the management segment
+    unsigned int fOwnerSampling; // tag every n-th allocation per thread with its owner, 0: off
+    uint16_t fOwnerDevice; // name index of this device in fOwnerTable
+    QuotaTable* fQuotaTable; // in the management segment
+    QuotaTable::Quota* fQuota; // of this device, nullptr without --shm-quota-soft/--shm-quota-hard
+    uint16_t fQuotaSlot;
+    DeallocationNotifier* fDeallocationNotifier;
     bool fNoCleanup;
+
+    bool fAllocationCacheEnabled;
+    size_t fAllocationCacheDepth;
+    size_t fAllocationCacheMaxBytes; // per process
+    SegmentCacheCounter* fCacheCounter; // of the local segment, in the management segment
+    std::atomic<uint64_t>* fCachedBytes; // of fCacheCounter if the cache is enabled, nullptr otherwise
+    std::atomic<size_t> fLocalCachedBytes;
+    std::atomic<uint64_t> fCacheReleaseRequestsSeen;
+    std::atomic<bool> fWatchCacheReleaseRequests; // set once the cache is set up, checked by the heartbeat thread
+    std::array<AllocationCacheShard, kNumCacheShards> fAllocationCache;
+
+    int fNumaNode;
+    int fThreadNumaNode;
+    tools::ThreadSettings fThreadSettings; // of the transport threads
+
+    std::unordered_map<uint16_t, RefCountTable> fRefCountTables; // modified under fSegmentBasesMtx, read via fSegmentBases
+    RefCountTable* fLocalRefCountTable; // ref count table of fSegmentId, nullptr if it uses ShmHeader
+
+    enum class SpillOverPolicy { none, free_memory, numa };
+    SpillOverPolicy fSpillOver;
+    int fSpillOverMaxSegments; // segments this manager may create on demand, guarded by fShmMtx
+    int fSpillOverCreatedSegments;
+    size_t fSegmentSize; // size and allocation algorithm of the own segment, used for spill-over segments
+    std::string fAllocationAlgorithm;
+    std::vector<AllocRoute> fAllocRoutes; // shm-alloc-policy, the segments are opened in the constructor
+
+    static constexpr size_t kSegmentInitChunkSize = 32 * 1024 * 1024;
+    bool fSegmentInitAsync;
+    int fSegmentInitThreads;
+    std::atomic<size_t> fSegmentInitTotalChunks;
+    std::atomic<size_t> fSegmentInitDoneChunks;
+    std::atomic<bool> fSegmentInitialized;
+    bool fSegmentInitReported; // guarded by fRegionEventsMtx
+    std::atomic<bool> fStopSegmentInit;
+    std::thread fSegmentInitThread;
+
+    bool fMetaRing;
+    size_t fMetaRingCapacity;
+
+    static constexpr double kWatermarkHysteresis = 0.01;
+    std::thread fWatermarkThread;
+    std::mutex fWatermarksMtx;
+    std::condition_variable fWatermarksCV;
+    bool fWatermarksActive; // guarded by fWatermarksMtx
+
+    static constexpr size_t kDeferredFreeQueueCapacity = 65536;
+    bool fDeferredFree;
+    size_t fDeferredFreeMaxBytes;
+    int fDeferredFreeIntervalInMs;
+    std::unique_ptr<DeferredFreeQueue> fDeferredFrees;
+    std::atomic<uint64_t> fDeferredBytes;
+    std::mutex fDeferredDrainMtx; // serializes the consumers of fDeferredFrees
+    std::vector<std::pair<uint16_t, boost::interprocess::managed_shared_memory::handle_t>> fDeferredBatch; // guarded by fDeferredDrainMtx
+    std::mutex fDeferredFreeMtx;
+    std::condition_variable fDeferredFreeCV;
+    bool fDeferredFreeStop; // guarded by fDeferredFreeMtx
+    std::atomic<bool> fDeferredFreeWakeup;
+    std::thread fDeferredFreeThread;
+
+    bool fPremap;
+    bool fPremapPrefault;
+    std::mutex fPremapMtx;
+    std::set<std::pair<uint16_t, bool>> fPremapped; // pair: <segment/region id, managed>, guarded by fPremapMtx
+    std::atomic<bool> fPremapActive;
+    std::thread fPremapThread;
+
+    bool fRegionMemfd; // --shm-region-memfd: RegionConfig::memfd for the regions created by this process where applicable
+    bool fFixedAddress; // --shm-fixed-address: map the segments and regions created by this process at the same address in all processes
+    std::atomic<bool> fFixedAddressFallback; // a segment or region is not mapped at its fixed address in this process
+    size_t fInlineSize; // --shm-inline-size: largest payload sent inline, 0: none
 };
 
 } // namespace fair::mq::shmem
@@ -13,14 +13,19 @@
 #include "UnmanagedRegion.h"
 #include "UnmanagedRegionImpl.h"
 #include <fairmq/Message.h>
+#include <fairmq/MessageArena.h>
 #include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/Copy.h>
+#include <fairmq/tools/Log.h>
 
 #include <fairlogger/Logger.h>
 
 #include <boost/interprocess/mapped_region.hpp>
 
-#include <cstddef> // size_t
+#include <cstddef> // size_t, max_align_t
 #include <atomic>
+#include <cstring> // memcpy
+#include <memory>
 
 #include <sys/types.h> // getpid
 #include <unistd.h> // pid_t
@@ -32,14 +37,16 @@ class Socket;
 
 class Message final : public fair::mq::Message
 {
+    friend class LazyParts;
     friend class Socket;
+    friend class TransportFactory;
 
   public:
     Message(Manager& manager, fair::mq::TransportFactory* factory = nullptr)
         : fair::mq::Message(factory)
         , fManager(manager)
         , fQueued(false)
-        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true}
+        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true, 0, 0}
         , fRegionPtr(nullptr)
         , fLocalPtr(nullptr)
     {
@@ -50,7 +57,7 @@ class Message final : public fair::mq::Message
         : fair::mq::Message(factory)
         , fManager(manager)
         , fQueued(false)
-        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true}
+        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true, 0, 0}
         , fAlignment(alignment.alignment)
         , fRegionPtr(nullptr)
         , fLocalPtr(nullptr)
@@ -62,11 +69,11 @@ class Message final : public fair::mq::Message
         : fair::mq::Message(factory)
         , fManager(manager)
         , fQueued(false)
-        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true}
+        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true, 0, 0}
         , fRegionPtr(nullptr)
         , fLocalPtr(nullptr)
     {
-        InitializeChunk(size);
+        Initialize(size);
         fManager.IncrementMsgCounter();
     }
 
@@ -74,12 +81,30 @@ class Message final : public fair::mq::Message
         : fair::mq::Message(factory)
         , fManager(manager)
         , fQueued(false)
-        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true}
+        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true, 0, 0}
         , fAlignment(alignment.alignment)
         , fRegionPtr(nullptr)
         , fLocalPtr(nullptr)
     {
-        InitializeChunk(size, fAlignment);
+        Initialize(size, fAlignment);
+        fManager.IncrementMsgCounter();
+    }
+
+    Message(Manager& manager, const size_t size, Headroom headroom, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Message(factory)
+        , fManager(manager)
+        , fQueued(false)
+        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true, 0, 0}
+        , fAlignment(0)
+        , fRegionPtr(nullptr)
+        , fLocalPtr(nullptr)
+    {
+        // the headroom is kept at the start of the user buffer, the data follows it at fMeta.fOffset
+        if (InitializeChunk(headroom.headroom + size)) {
+            fMeta.fOffset = headroom.headroom;
+            fMeta.fSize = size;
+            fLocalPtr += headroom.headroom;
+        }
         fManager.IncrementMsgCounter();
     }
 
@@ -87,12 +112,12 @@ class Message final : public fair::mq::Message
         : fair::mq::Message(factory)
         , fManager(manager)
         , fQueued(false)
-        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true}
+        , fMeta{0, 0, -1, -1, 0, fManager.GetSegmentId(), true, 0, 0}
         , fRegionPtr(nullptr)
         , fLocalPtr(nullptr)
     {
-        if (InitializeChunk(size)) {
-            std::memcpy(fLocalPtr, data, size);
+        if (Initialize(size)) {
+            tools::CopyPayload(fLocalPtr, data, size);
             if (ffn) {
                 ffn(data, hint);
             } else {
@@ -106,7 +131,7 @@ class Message final : public fair::mq::Message
         : fair::mq::Message(factory)
         , fManager(manager)
         , fQueued(false)
-        , fMeta{size, reinterpret_cast<size_t>(hint), -1, -1, static_cast<UnmanagedRegionImpl*>(region.get())->fRegionId, fManager.GetSegmentId(), false}
+        , fMeta{size, reinterpret_cast<size_t>(hint), -1, -1, static_cast<UnmanagedRegionImpl*>(region.get())->fRegionId, fManager.GetSegmentId(), false, 0, 0}
         , fRegionPtr(nullptr)
         , fLocalPtr(static_cast<char*>(data))
     {
@@ -133,6 +158,7 @@ class Message final : public fair::mq::Message
         , fRegionPtr(nullptr)
         , fLocalPtr(nullptr)
     {
+        fManager.Own(fMeta);
         fManager.IncrementMsgCounter();
     }
 
@@ -141,6 +167,12 @@ class Message final : public fair::mq::Message
     Message& operator=(const Message&) = delete;
     Message& operator=(Message&&) = delete;
 
+    // the parts of a multipart receive are allocated from one MessageArena
+    static void* operator new(size_t size) { return MessageArena::AllocateSingle(size); }
+    static void* operator new(size_t size, MessageArena& arena) { return arena.Allocate(size); }
+    static void operator delete(void* ptr) noexcept { MessageArena::Release(ptr); }
+    static void operator delete(void* ptr, MessageArena&) noexcept { MessageArena::Release(ptr); }
+
     void Rebuild() override
     {
         CloseMessage();
@@ -158,7 +190,7 @@ class Message final : public fair::mq::Message
     {
         CloseMessage();
         fQueued = false;
-        InitializeChunk(size);
+        Initialize(size);
     }
 
     void Rebuild(size_t size, Alignment alignment) override
@@ -166,7 +198,7 @@ class Message final : public fair::mq::Message
         CloseMessage();
         fQueued = false;
         fAlignment = alignment.alignment;
-        InitializeChunk(size, fAlignment);
+        Initialize(size, fAlignment);
     }
 
     void Rebuild(void* data, size_t size, fair::mq::FreeFn* ffn, void* hint = nullptr) override
@@ -174,8 +206,8 @@ class Message final : public fair::mq::Message
         CloseMessage();
         fQueued = false;
 
-        if (InitializeChunk(size)) {
-            std::memcpy(fLocalPtr, data, size);
+        if (Initialize(size)) {
+            tools::CopyPayload(fLocalPtr, data, size);
             if (ffn) {
                 ffn(data, hint);
             } else {
@@ -190,14 +222,14 @@ class Message final : public fair::mq::Message
             if (fMeta.fManaged) {
                 if (fMeta.fSize > 0) {
                     fManager.GetSegment(fMeta.fSegmentId);
-                    fLocalPtr = ShmHeader::UserPtr(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId));
+                    fLocalPtr = fManager.UserPtr(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId), fMeta.fSegmentId) + fMeta.fOffset;
                 } else {
                     fLocalPtr = nullptr;
                 }
             } else {
                 fRegionPtr = fManager.GetRegionFromCache(fMeta.fRegionId);
                 if (fRegionPtr) {
-                    fLocalPtr = reinterpret_cast<char*>(fRegionPtr->GetData()) + fMeta.fHandle;
+                    fLocalPtr = reinterpret_cast<char*>(fRegionPtr->GetData()) + fMeta.fHandle + fMeta.fOffset;
                 } else {
                     // LOG(warn) << "could not get pointer from a region message";
                     fLocalPtr = nullptr;
@@ -217,13 +249,17 @@ class Message final : public fair::mq::Message
         } else if (newSize == 0) {
             Deallocate();
             return true;
+        } else if (newSize <= fMeta.fSize && (fMeta.fBufferSize > 0 || fInline)) {
+            // a slice shares its buffer with other messages, only the view is shrunk (inline payloads are not reallocated)
+            fMeta.fSize = newSize;
+            return true;
         } else if (newSize <= fMeta.fSize) {
             try {
                 try {
                     char* oldPtr = fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId);
-                    uint16_t userOffset = ShmHeader::UserOffset(oldPtr);
-                    char* ptr = fManager.ShrinkInPlace(userOffset + newSize, oldPtr, fMeta.fSegmentId);
-                    fLocalPtr = ShmHeader::UserPtr(ptr);
+                    uint16_t userOffset = fManager.UserOffset(oldPtr, fMeta.fSegmentId);
+                    char* ptr = fManager.ShrinkInPlace(userOffset + fMeta.fOffset + newSize, oldPtr, fMeta.fSegmentId);
+                    fLocalPtr = fManager.UserPtr(ptr, fMeta.fSegmentId) + fMeta.fOffset;
                     fMeta.fSize = newSize;
                     return true;
                 } catch (boost::interprocess::bad_alloc& e) {
@@ -231,12 +267,16 @@ class Message final : public fair::mq::Message
                     // unused size >= 1000000 bytes: reallocate fully
                     // unused size < 1000000 bytes: simply reset the size and keep the rest of the buffer until message destruction
                     if (fMeta.fSize - newSize >= 1000000) {
-                        char* ptr = fManager.Allocate(newSize, fAlignment);
-                        char* userPtr = ShmHeader::UserPtr(ptr);
-                        std::memcpy(userPtr, fLocalPtr, newSize);
+                        uint16_t segmentId = fManager.GetSegmentId();
+                        char* ptr = fManager.Allocate(fMeta.fOffset + newSize, fAlignment, &segmentId);
+                        char* userPtr = fManager.UserPtr(ptr, segmentId) + fMeta.fOffset;
+                        tools::CopyPayload(userPtr, fLocalPtr, newSize);
+                        fManager.Disown(fMeta);
                         fManager.Deallocate(fMeta.fHandle, fMeta.fSegmentId);
                         fLocalPtr = userPtr;
+                        fMeta.fSegmentId = segmentId;
                         fMeta.fHandle = fManager.GetHandleFromAddress(ptr, fMeta.fSegmentId);
+                        fManager.Own(fMeta);
                     }
                     fMeta.fSize = newSize;
                     return true;
@@ -251,6 +291,45 @@ class Message final : public fair::mq::Message
         }
     }
 
+    bool Grow(size_t newSize) override
+    {
+        if (newSize <= fMeta.fSize) {
+            return true;
+        } else if (fQueued || !fMeta.fManaged || fMeta.fBufferSize > 0) {
+            return false; // region buffers have a fixed size, slices share their buffer
+        }
+        try {
+            Materialize();
+            if (fMeta.fHandle < 0) {
+                InitializeChunk(newSize, fAlignment);
+                return true;
+            }
+            char* oldPtr = fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId);
+            const size_t headroom = fMeta.fOffset;
+            if (fManager.ExpandInPlace(fManager.UserOffset(oldPtr, fMeta.fSegmentId) + headroom + newSize, oldPtr, fMeta.fSegmentId)) {
+                fMeta.fSize = newSize;
+                return true;
+            }
+            uint16_t segmentId = fManager.GetSegmentId();
+            char* ptr = fManager.Allocate(headroom + newSize, fAlignment, &segmentId);
+            if (!ptr) {
+                return false;
+            }
+            tools::CopyPayload(fManager.UserPtr(ptr, segmentId) + headroom, GetData(), fMeta.fSize);
+            Deallocate(); // drops the reference to the old chunk
+            InitializeChunk(ptr, segmentId, newSize);
+            fMeta.fOffset = headroom;
+            fLocalPtr += headroom;
+            return true;
+        } catch (MessageBadAlloc& e) {
+            LOG(debug) << "could not grow message: " << e.what();
+            return false;
+        } catch (boost::interprocess::interprocess_exception& e) {
+            LOG(debug) << "could not grow message: " << e.what();
+            return false;
+        }
+    }
+
     Transport GetType() const override { return fair::mq::Transport::SHM; }
 
     uint16_t GetRefCount() const
@@ -261,13 +340,16 @@ class Message final : public fair::mq::Message
 
         if (fMeta.fManaged) { // managed segment
             fManager.GetSegment(fMeta.fSegmentId);
-            return ShmHeader::RefCount(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId));
+            return fManager.RefCount(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId), fMeta.fSegmentId);
         } else { // unmanaged region
             if (fMeta.fShared < 0) { // UR msg is not yet shared
                 return 1;
+            } else if (fMeta.fSegmentId == kRegionRefCountSegment) {
+                RegionRefCounts* refCounts = GetRegionRefCounts();
+                return refCounts ? refCounts->RefCount(static_cast<uint32_t>(fMeta.fShared)).load() : 1;
             } else {
                 fManager.GetSegment(fMeta.fSegmentId);
-                return ShmHeader::RefCount(fManager.GetAddressFromHandle(fMeta.fShared, fMeta.fSegmentId));
+                return fManager.RefCount(fManager.GetAddressFromHandle(fMeta.fShared, fMeta.fSegmentId), fMeta.fSegmentId);
             }
         }
     }
@@ -275,37 +357,141 @@ class Message final : public fair::mq::Message
     void Copy(const fair::mq::Message& other) override
     {
         const Message& otherMsg = static_cast<const Message&>(other);
+        if (otherMsg.fInline) {
+            // inline payloads are not shared, the copy gets its own
+            Deallocate();
+            std::memcpy(InitializeInline(otherMsg.fMeta.fSize), otherMsg.fInline.get(), otherMsg.fMeta.fSize);
+            return;
+        }
         if (otherMsg.fMeta.fHandle < 0) {
             // if the other message is not initialized, close this one too and return
             CloseMessage();
             return;
         }
 
-        if (fMeta.fHandle >= 0) {
+        if (fMeta.fHandle >= 0 || fInline) {
             // if this msg is already initialized, close it first
             CloseMessage();
         }
 
-        if (otherMsg.fMeta.fManaged) { // managed segment
-            fMeta = otherMsg.fMeta;
+        otherMsg.AddReferences(1);
+        // point this message to the same content
+        fMeta = otherMsg.fMeta;
+        fManager.Own(fMeta);
+    }
+
+    bool MakeWritable() override
+    {
+        if (fQueued) {
+            return false;
+        } else if (fMeta.fHandle < 0 || fMeta.fSize == 0 || GetRefCount() == 1) {
+            return true;
+        }
+        try {
+            const size_t size = fMeta.fSize;
+            const size_t headroom = GetHeadroom();
+            uint16_t segmentId = fManager.GetSegmentId();
+            char* ptr = fManager.Allocate(headroom + size, fAlignment, &segmentId);
+            if (!ptr) {
+                return false;
+            }
+            tools::CopyPayload(fManager.UserPtr(ptr, segmentId) + headroom, GetData(), size);
+            Deallocate(); // drops the reference to the shared buffer
+            // the copy of a region message (or of a slice) is a plain managed segment message
+            fMeta.fManaged = true;
+            fMeta.fShared = -1;
+            fMeta.fHint = 0;
+            InitializeChunk(ptr, segmentId, size);
+            fMeta.fOffset = headroom;
+            fLocalPtr += headroom;
+            return true;
+        } catch (MessageBadAlloc& e) {
+            LOG(debug) << "could not make message writable: " << e.what();
+            return false;
+        } catch (boost::interprocess::interprocess_exception& e) {
+            LOG(debug) << "could not make message writable: " << e.what();
+            return false;
+        }
+    }
+
+    bool Prepend(size_t n) override
+    {
+        if (n > GetHeadroom()) {
+            return false;
+        }
+        fMeta.fOffset -= n;
+        fMeta.fSize += n;
+        if (fLocalPtr) {
+            fLocalPtr -= n;
+        }
+        return true;
+    }
+
+    // the headroom travels with the message, receivers can prepend to it as well. Slices have none, their buffer is shared
+    size_t GetHeadroom() const override { return (fMeta.fHandle < 0 || fQueued || fMeta.fBufferSize > 0) ? 0 : fMeta.fOffset; }
+
+    MessagePtr Slice(size_t offset, size_t size) override
+    {
+        if (offset + size > fMeta.fSize || offset + size < offset) {
+            throw MessageError(tools::ToString("slice [", offset, ", ", offset + size, ") is out of the range of the message (size ", fMeta.fSize, ")"));
+        }
+        if ((fMeta.fHandle < 0 && !fInline) || fQueued) {
+            return std::make_unique<Message>(fManager, GetTransport());
+        }
+        if (fInline) {
+            // an inline payload is small, the slice gets a copy of its range
+            auto slice = std::make_unique<Message>(fManager, GetTransport());
+            if (size > 0) {
+                std::memcpy(slice->InitializeInline(size), fInline.get() + offset, size);
+            }
+            slice->SetTraceContext(GetTraceContext());
+            return slice;
+        }
+        AddReferences(1);
+        MetaHeader meta = fMeta;
+        meta.fOffset += offset;
+        meta.fSize = size;
+        meta.fBufferSize = fMeta.fBufferSize > 0 ? fMeta.fBufferSize : fMeta.fSize;
+        auto slice = std::make_unique<Message>(fManager, meta, GetTransport());
+        slice->SetTraceContext(GetTraceContext());
+        return slice;
+    }
+
+    /// Add n references to the buffer in one step, each one released by the destruction of a message referring to it
+    /// (a copy, or a message received from a socket the meta data was sent to). Unmanaged region messages get a
+    /// shared ref count on the first call.
+    void AddReferences(uint16_t n) const
+    {
+        if (fMeta.fHandle < 0 || n == 0) {
+            return;
+        }
+
+        if (fMeta.fManaged) { // managed segment
             fManager.GetSegment(fMeta.fSegmentId);
-            ShmHeader::IncrementRefCount(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId));
+            fManager.AddRefCount(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId), fMeta.fSegmentId, n);
         } else { // unmanaged region
-            if (otherMsg.fMeta.fShared < 0) { // if UR msg is not yet shared
+            if (fMeta.fShared < 0) { // if UR msg is not yet shared
+                // prefer a counter from the ref count slab of the region, it does not touch the managed segment
+                RegionRefCounts* refCounts = GetRegionRefCounts();
+                uint32_t slot = refCounts ? refCounts->Acquire(1 + n) : RegionRefCounts::kNone;
+                if (slot != RegionRefCounts::kNone) {
+                    fMeta.fShared = slot;
+                    fMeta.fSegmentId = kRegionRefCountSegment;
+                    return;
+                }
                 // TODO: minimize the size to 0 and don't create extra space for user buffer alignment
-                char* ptr = fManager.Allocate(2, 0);
+                uint16_t segmentId = fManager.GetSegmentId();
+                char* ptr = fManager.Allocate(2, 0, &segmentId);
                 // point the fShared in the unmanaged region message to the refCount holder
-                otherMsg.fMeta.fShared = fManager.GetHandleFromAddress(ptr, fMeta.fSegmentId);
+                fMeta.fShared = fManager.GetHandleFromAddress(ptr, segmentId);
                 // the message needs to be able to locate in which segment the refCount is stored
-                otherMsg.fMeta.fSegmentId = fMeta.fSegmentId;
-                // point this message to the same content as the unmanaged region message
-                fMeta = otherMsg.fMeta;
-                // increment the refCount
-                ShmHeader::IncrementRefCount(ptr);
+                fMeta.fSegmentId = segmentId;
+                fManager.AddRefCount(ptr, segmentId, n);
+            } else if (fMeta.fSegmentId == kRegionRefCountSegment) { // already shared, ref count in the region slab
+                GetRegionRefCounts()->RefCount(static_cast<uint32_t>(fMeta.fShared)).fetch_add(n);
             } else { // if the UR msg is already shared
-                fMeta = otherMsg.fMeta;
                 fManager.GetSegment(fMeta.fSegmentId);
-                ShmHeader::IncrementRefCount(fManager.GetAddressFromHandle(fMeta.fShared, fMeta.fSegmentId));
+                fManager.AddRefCount(fManager.GetAddressFromHandle(fMeta.fShared, fMeta.fSegmentId), fMeta.fSegmentId, n);
             }
         }
     }
@@ -316,9 +502,44 @@ class Message final : public fair::mq::Message
     Manager& fManager;
     bool fQueued;
     MetaHeader fMeta;
-    size_t fAlignment;
+    size_t fAlignment = 0;
     mutable UnmanagedRegion* fRegionPtr;
     mutable char* fLocalPtr;
+    std::unique_ptr<char[]> fInline; // payload of an inline message (--shm-inline-size), not in shared memory
+
+    // the payload of small messages is kept inline (--shm-inline-size), larger ones are allocated in shared memory
+    char* Initialize(const size_t size, size_t alignment = 0)
+    {
+        if (size > 0 && size <= fManager.InlineSize() && alignment <= alignof(std::max_align_t)) {
+            return InitializeInline(size);
+        }
+        return InitializeChunk(size, alignment);
+    }
+
+    // the meta data of an inline message carries no handle, it is sent together with the payload (compact format only)
+    char* InitializeInline(const size_t size)
+    {
+        fInline.reset(new char[size]);
+        fMeta = MetaHeader{size, 0, -1, -1, 0, kInlineSegment, true, 0, 0};
+        fLocalPtr = fInline.get();
+        return fLocalPtr;
+    }
+
+    // payload of an inline message, nullptr for the others
+    const char* InlineData() const { return fInline.get(); }
+
+    // moves an inline payload into a chunk of the managed segment, for the transfers that pass the meta data only
+    // (meta header rings, send batches, publishers, the object store)
+    void Materialize()
+    {
+        if (!fInline) {
+            return;
+        }
+        std::unique_ptr<char[]> payload(std::move(fInline));
+        const size_t size = fMeta.fSize;
+        InitializeChunk(size, fAlignment);
+        tools::CopyPayload(fLocalPtr, payload.get(), size);
+    }
 
     char* InitializeChunk(const size_t size, size_t alignment = 0)
     {
@@ -326,10 +547,19 @@ class Message final : public fair::mq::Message
             fMeta.fSize = 0;
             return fLocalPtr;
         }
-        char* ptr = fManager.Allocate(size, alignment);
+        uint16_t segmentId = fManager.GetSegmentId();
+        char* ptr = fManager.Allocate(size, alignment, &segmentId);
+        return InitializeChunk(ptr, segmentId, size);
+    }
+
+    // take ownership of an already allocated (and constructed) chunk of the given segment
+    char* InitializeChunk(char* ptr, uint16_t segmentId, const size_t size)
+    {
+        fMeta.fSegmentId = segmentId;
         fMeta.fHandle = fManager.GetHandleFromAddress(ptr, fMeta.fSegmentId);
         fMeta.fSize = size;
-        fLocalPtr = ShmHeader::UserPtr(ptr);
+        fLocalPtr = fManager.UserPtr(ptr, fMeta.fSegmentId);
+        fManager.Own(fMeta.fSegmentId, fMeta.fHandle);
         return fLocalPtr;
     }
 
@@ -337,17 +567,26 @@ class Message final : public fair::mq::Message
     {
         if (fMeta.fHandle >= 0 && !fQueued) {
             if (fMeta.fManaged) { // managed segment
+                fManager.Disown(fMeta.fSegmentId, fMeta.fHandle);
                 fManager.GetSegment(fMeta.fSegmentId);
-                uint16_t refCount = ShmHeader::DecrementRefCount(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId));
+                uint16_t refCount = fManager.DecrementRefCount(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId), fMeta.fSegmentId);
                 if (refCount == 1) {
                     fManager.Deallocate(fMeta.fHandle, fMeta.fSegmentId);
                 }
             } else { // unmanaged region
-                if (fMeta.fShared >= 0) {
+                if (fMeta.fShared >= 0 && fMeta.fSegmentId == kRegionRefCountSegment) {
+                    RegionRefCounts* refCounts = GetRegionRefCounts();
+                    if (!refCounts) {
+                        FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << "ref count slab of region " << fMeta.fRegionId << " is not available. Not sending ack";
+                    } else if (refCounts->RefCount(static_cast<uint32_t>(fMeta.fShared)).fetch_sub(1) == 1) {
+                        refCounts->Release(static_cast<uint32_t>(fMeta.fShared));
+                        ReleaseUnmanagedRegionBlock();
+                    }
+                } else if (fMeta.fShared >= 0) {
                     // make sure segment is initialized in this transport
                     fManager.GetSegment(fMeta.fSegmentId);
                     // release unmanaged region block if ref count is one
-                    uint16_t refCount = ShmHeader::DecrementRefCount(fManager.GetAddressFromHandle(fMeta.fShared, fMeta.fSegmentId));
+                    uint16_t refCount = fManager.DecrementRefCount(fManager.GetAddressFromHandle(fMeta.fShared, fMeta.fSegmentId), fMeta.fSegmentId);
                     if (refCount == 1) {
                         fManager.Deallocate(fMeta.fShared, fMeta.fSegmentId);
                         ReleaseUnmanagedRegionBlock();
@@ -357,9 +596,45 @@ class Message final : public fair::mq::Message
                 }
             }
         }
+        if (fInline) {
+            fInline.reset();
+            fMeta.fSegmentId = fManager.GetSegmentId();
+        }
         fMeta.fHandle = -1;
         fLocalPtr = nullptr;
+        fRegionPtr = nullptr;
         fMeta.fSize = 0;
+        fMeta.fOffset = 0;
+        fMeta.fBufferSize = 0;
+    }
+
+    // like Deallocate, but managed chunks that are no longer referenced are appended to chunks
+    // instead of being deallocated, so that the caller can return them with Manager::DeallocateMany
+    void Release(std::vector<std::pair<uint16_t, boost::interprocess::managed_shared_memory::handle_t>>& chunks)
+    {
+        if (fMeta.fHandle >= 0 && !fQueued && fMeta.fManaged) {
+            fManager.Disown(fMeta.fSegmentId, fMeta.fHandle);
+            fManager.GetSegment(fMeta.fSegmentId);
+            uint16_t refCount = fManager.DecrementRefCount(fManager.GetAddressFromHandle(fMeta.fHandle, fMeta.fSegmentId), fMeta.fSegmentId);
+            if (refCount == 1) {
+                chunks.emplace_back(fMeta.fSegmentId, fMeta.fHandle);
+            }
+            fMeta.fHandle = -1;
+            fLocalPtr = nullptr;
+            fMeta.fSize = 0;
+            fMeta.fOffset = 0;
+            fMeta.fBufferSize = 0;
+        } else {
+            Deallocate();
+        }
+    }
+
+    RegionRefCounts* GetRegionRefCounts() const
+    {
+        if (!fRegionPtr) {
+            fRegionPtr = fManager.GetRegionFromCache(fMeta.fRegionId);
+        }
+        return fRegionPtr ? fRegionPtr->GetRefCounts() : nullptr;
     }
 
     void ReleaseUnmanagedRegionBlock()
@@ -369,9 +644,9 @@ class Message final : public fair::mq::Message
         }
 
         if (fRegionPtr) {
-            fRegionPtr->ReleaseBlock({fMeta.fHandle, fMeta.fSize, fMeta.fHint});
+            fRegionPtr->ReleaseBlock({fMeta.fHandle, fMeta.fBufferSize > 0 ? fMeta.fBufferSize : fMeta.fSize, fMeta.fHint});
         } else {
-            LOG(warn) << "region ack queue for id " << fMeta.fRegionId << " no longer exist. Not sending ack";
+            FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << "region ack queue for id " << fMeta.fRegionId << " no longer exist. Not sending ack";
         }
     }
 
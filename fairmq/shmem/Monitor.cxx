@@ -8,6 +8,7 @@
 
 #include "Common.h"
 #include "Monitor.h"
+#include "RobustMutex.h"
 #include "Segment.h"
 #include <fairmq/shmem/UnmanagedRegion.h>
 
@@ -22,16 +23,26 @@
 #include <boost/interprocess/sync/named_condition.hpp>
 #include <boost/interprocess/ipc/message_queue.hpp>
 
+#include <algorithm>
+#include <cerrno>
 #include <csignal>
 #include <cstdio>
+#include <cstring> // memset
 #include <iostream>
 #include <iomanip>
 #include <chrono>
 #include <ctime>
 #include <iomanip>
+#include <map>
+#include <memory> // make_unique
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 
 #include <poll.h>
+#include <sys/syscall.h> // SYS_pidfd_open
+#include <unistd.h> // unlink
 
 #if FAIRMQ_HAS_STD_FILESYSTEM
 #include <filesystem>
@@ -175,6 +186,216 @@ void Monitor::Watch()
     }
 }
 
+namespace
+{
+
+// upper bound of the power of two bucket containing the percentile (in [0, 100])
+uint64_t BucketPercentile(const std::array<std::atomic<uint64_t>, SegmentAllocStats::kNumBuckets>& buckets, double percentile)
+{
+    uint64_t count = 0;
+    for (const auto& b : buckets) {
+        count += b.load();
+    }
+    if (count == 0) {
+        return 0;
+    }
+    auto rank = std::max<uint64_t>(static_cast<uint64_t>(percentile / 100. * count + 0.5), 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < SegmentAllocStats::kNumBuckets; ++i) {
+        seen += buckets[i].load();
+        if (seen >= rank) {
+            return uint64_t(1) << i;
+        }
+    }
+    return uint64_t(1) << (SegmentAllocStats::kNumBuckets - 1);
+}
+
+std::string AllocStatsStr(const SegmentAllocStats& stats)
+{
+    stringstream ss;
+    uint64_t allocs = stats.fSampledAllocs.load();
+    uint64_t deallocs = stats.fSampledDeallocs.load();
+    if (allocs > 0 || deallocs > 0) {
+        ss << "       sampled allocs: " << allocs
+           << ", avg: " << (allocs > 0 ? stats.fAllocNs.load() / allocs : 0) << " ns"
+           << ", p50: <" << BucketPercentile(stats.fAllocNsBuckets, 50) << " ns"
+           << ", p99: <" << BucketPercentile(stats.fAllocNsBuckets, 99) << " ns"
+           << ", size p50: <" << BucketPercentile(stats.fSizeBuckets, 50)
+           << ", size p99: <" << BucketPercentile(stats.fSizeBuckets, 99)
+           << "; sampled deallocs: " << deallocs
+           << ", avg: " << (deallocs > 0 ? stats.fDeallocNs.load() / deallocs : 0) << " ns\n";
+    }
+    uint64_t failures = stats.fFailures.load();
+    if (failures > 0) {
+        uint64_t free = stats.fLastFailureFreeMemory.load();
+        uint64_t largest = stats.fLastFailureLargestFreeBlock.load();
+        // external fragmentation: share of the free memory that is not in the largest free block
+        double fragmentation = free > 0 ? 1. - static_cast<double>(std::min(largest, free)) / free : 0.;
+        ss << "       allocation failures: " << failures
+           << " (fragmented: " << stats.fFragmentedFailures.load() << ")"
+           << ", last: size: " << stats.fLastFailureSize.load()
+           << ", free: " << free
+           << ", largest free block: " << largest
+           << ", fragmentation: " << std::fixed << std::setprecision(2) << fragmentation << "\n";
+    }
+    return ss.str();
+}
+
+SessionOwnerUsage CollectOwnerUsage(const ChunkOwnerTable& table)
+{
+    SessionOwnerUsage usage;
+    usage.droppedTags = table.fNumDropped.load();
+
+    // indexed by the name index, the last entry collects the chunks without (known) name
+    const uint16_t numNames = std::min(table.fNumNames, ChunkOwnerTable::kMaxNames);
+    std::vector<OwnerUsage> devices(numNames + 1);
+    std::vector<OwnerUsage> channels(numNames + 1);
+    uint64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+    for (const auto& tag : table.fTags) {
+        uint64_t time = tag.fTime.load(std::memory_order_acquire);
+        if (time == 0) {
+            continue;
+        }
+        uint64_t size = tag.fSize.load(std::memory_order_relaxed);
+        uint16_t device = std::min(tag.fDevice.load(std::memory_order_relaxed), numNames);
+        uint16_t channel = std::min(tag.fChannel.load(std::memory_order_relaxed), numNames);
+        uint64_t sampling = device < numNames ? std::max<uint64_t>(table.fNames[device].fSampling, 1) : 1;
+        uint64_t ageMs = now > time ? (now - time) / 1000000 : 0;
+        size_t bucket = std::find_if(OwnerUsage::kAgeBucketsMs.begin(), OwnerUsage::kAgeBucketsMs.end(), [&](uint64_t b) { return ageMs < b; }) - OwnerUsage::kAgeBucketsMs.begin();
+        for (OwnerUsage* u : {&devices[device], &channels[channel]}) {
+            u->taggedChunks++;
+            u->taggedBytes += size;
+            u->estimatedBytes += size * sampling;
+            u->estimatedBytesByAge[bucket] += size * sampling;
+            u->maxAgeMs = std::max(u->maxAgeMs, ageMs);
+        }
+    }
+
+    auto collect = [&](std::vector<OwnerUsage>& from, std::vector<OwnerUsage>& to) {
+        for (size_t i = 0; i < from.size(); ++i) {
+            if (from[i].taggedChunks > 0) {
+                from[i].name = i < numNames ? std::string(table.fNames[i].fName, strnlen(table.fNames[i].fName, ChunkOwnerTable::kMaxNameLength)) : "unknown";
+                to.push_back(std::move(from[i]));
+            }
+        }
+        std::sort(to.begin(), to.end(), [](const OwnerUsage& a, const OwnerUsage& b) { return a.estimatedBytes > b.estimatedBytes; });
+    };
+    collect(devices, usage.devices);
+    collect(channels, usage.channels);
+    return usage;
+}
+
+std::string OwnerUsageStr(const SessionOwnerUsage& usage)
+{
+    stringstream ss;
+    auto print = [&](const std::vector<OwnerUsage>& owners) {
+        for (const auto& o : owners) {
+            ss << "      " << o.name << ": ~" << o.estimatedBytes << " bytes (" << o.taggedChunks << " tagged chunks), by age:";
+            for (size_t i = 0; i < o.estimatedBytesByAge.size(); ++i) {
+                if (i < OwnerUsage::kAgeBucketsMs.size()) {
+                    ss << " <" << OwnerUsage::kAgeBucketsMs[i] << "ms: ";
+                } else {
+                    ss << " older: ";
+                }
+                ss << o.estimatedBytesByAge[i];
+            }
+            ss << ", oldest: " << o.maxAgeMs << "ms\n";
+        }
+    };
+    ss << "   held memory by device (estimated from owner tags, dropped tags: " << usage.droppedTags << "):\n";
+    print(usage.devices);
+    ss << "   held memory by channel last sent on:\n";
+    print(usage.channels);
+    return ss.str();
+}
+
+std::vector<QuotaUsage> CollectQuotas(const QuotaTable& table)
+{
+    std::vector<QuotaUsage> quotas;
+    for (uint16_t i = 0; i < std::min(table.fNumQuotas, QuotaTable::kMaxQuotas); ++i) {
+        const QuotaTable::Quota& q = table.fQuotas[i];
+        QuotaUsage quota;
+        quota.name = std::string(q.fName, strnlen(q.fName, QuotaTable::kMaxNameLength));
+        quota.soft = q.fSoft.load();
+        quota.hard = q.fHard.load();
+        quota.used = q.fUsed.load();
+        quota.peak = q.fPeak.load();
+        quota.softExceeded = q.fSoftExceeded.load();
+        quota.hardRejected = q.fHardRejected.load();
+        quotas.push_back(std::move(quota));
+    }
+    return quotas;
+}
+
+std::vector<UsageStats> CollectUsageStats(const UsageTable& table)
+{
+    const uint64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<UsageStats> stats;
+    for (const auto& entry : table.fEntries) {
+        const uint32_t key = entry.fKey.load(std::memory_order_acquire);
+        if (key == 0) {
+            continue;
+        }
+        UsageStats s;
+        s.managed = (key >> 16) == 1;
+        s.id = key & 0xffff;
+        s.size = entry.fSize.load(std::memory_order_relaxed);
+        s.freeBytes = entry.fFreeBytes.load(std::memory_order_relaxed);
+        s.allocations = entry.fAllocations.load(std::memory_order_relaxed);
+        s.deallocations = entry.fDeallocations.load(std::memory_order_relaxed);
+        s.acksSent = entry.fAcksSent.load(std::memory_order_relaxed);
+        s.acksReceived = entry.fAcksReceived.load(std::memory_order_relaxed);
+        // the counters of the senders and of the receiver are published independently, one may be ahead
+        s.ackBacklog = s.acksSent > s.acksReceived ? s.acksSent - s.acksReceived : 0;
+        const uint64_t updated = entry.fUpdated.load(std::memory_order_relaxed);
+        s.ageMs = (updated > 0 && now > updated) ? (now - updated) / 1000000 : 0;
+        stats.push_back(s);
+    }
+    std::sort(stats.begin(), stats.end(), [](const UsageStats& a, const UsageStats& b) { return std::make_pair(!a.managed, a.id) < std::make_pair(!b.managed, b.id); });
+    return stats;
+}
+
+std::string UsageStatsJson(const std::string& shmId, unsigned int numDevices, const std::vector<UsageStats>& stats)
+{
+    stringstream ss;
+    ss << R"({"time":)" << chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count()
+       << R"(,"shmid":")" << shmId << R"(","devices":)" << numDevices << R"(,"segments":[)";
+    bool first = true;
+    for (const auto& s : stats) {
+        if (s.managed) {
+            ss << (first ? "" : ",") << R"({"id":)" << s.id << R"(,"size":)" << s.size << R"(,"free":)" << s.freeBytes
+               << R"(,"allocations":)" << s.allocations << R"(,"deallocations":)" << s.deallocations << R"(,"age_ms":)" << s.ageMs << "}";
+            first = false;
+        }
+    }
+    ss << R"(],"regions":[)";
+    first = true;
+    for (const auto& s : stats) {
+        if (!s.managed) {
+            ss << (first ? "" : ",") << R"({"id":)" << s.id << R"(,"size":)" << s.size << R"(,"acks_sent":)" << s.acksSent
+               << R"(,"acks_received":)" << s.acksReceived << R"(,"ack_backlog":)" << s.ackBacklog << R"(,"age_ms":)" << s.ageMs << "}";
+            first = false;
+        }
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+std::string QuotasStr(const std::vector<QuotaUsage>& quotas)
+{
+    stringstream ss;
+    ss << "   quotas:\n";
+    for (const auto& q : quotas) {
+        ss << "      " << q.name << ": used: " << q.used << ", peak: " << q.peak
+           << ", soft: " << (q.soft > 0 ? std::to_string(q.soft) : "none") << " (exceeded " << q.softExceeded << " times)"
+           << ", hard: " << (q.hard > 0 ? std::to_string(q.hard) : "none") << " (rejected " << q.hardRejected << " allocation attempts)\n";
+    }
+    return ss.str();
+}
+
+} // namespace
+
 bool Monitor::PrintShm(const ShmId& shmId)
 {
     using namespace boost::interprocess;
@@ -184,9 +405,14 @@ bool Monitor::PrintShm(const ShmId& shmId)
         VoidAlloc allocInstance(managementSegment.get_segment_manager());
 
         Uint16SegmentInfoHashMap* shmSegments = managementSegment.find<Uint16SegmentInfoHashMap>(unique_instance).first;
-        std::unordered_map<uint16_t, boost::variant<RBTreeBestFitSegment, SimpleSeqFitSegment>> segments;
+        std::unordered_map<uint16_t, boost::variant<RBTreeBestFitSegment, SimpleSeqFitSegment, SlabFitSegment>> segments;
 
         Uint16RegionInfoHashMap* shmRegions = managementSegment.find<Uint16RegionInfoHashMap>(unique_instance).first;
+        Uint16SegmentCacheCounterHashMap* cacheCounters = managementSegment.find<Uint16SegmentCacheCounterHashMap>(unique_instance).first;
+        Uint16SegmentAllocStatsHashMap* allocStats = managementSegment.find<Uint16SegmentAllocStatsHashMap>(unique_instance).first;
+        ChunkOwnerTable* ownerTable = managementSegment.find<ChunkOwnerTable>(unique_instance).first;
+        QuotaTable* quotaTable = managementSegment.find<QuotaTable>(unique_instance).first;
+        LedgerTable* ledgerTable = managementSegment.find<LedgerTable>(unique_instance).first;
 
         if (!shmSegments) {
             LOG(error) << "Found management segment, but cannot locate segment info, something went wrong...";
@@ -200,6 +426,8 @@ bool Monitor::PrintShm(const ShmId& shmId)
         for (const auto& s : *shmSegments) {
             if (s.second.fAllocationAlgorithm == AllocationAlgorithm::rbtree_best_fit) {
                 segments.emplace(s.first, RBTreeBestFitSegment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + to_string(s.first)).c_str()));
+            } else if (s.second.fAllocationAlgorithm == AllocationAlgorithm::slab_fit) {
+                segments.emplace(s.first, SlabFitSegment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + to_string(s.first)).c_str()));
             } else {
                 segments.emplace(s.first, SimpleSeqFitSegment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + to_string(s.first)).c_str()));
             }
@@ -256,8 +484,35 @@ bool Monitor::PrintShm(const ShmId& shmId)
                << ": total: " << total
                << ", msgs: " << msgCount
                << ", free: " << free
-               << ", used: " << used
-               << "\n";
+               << ", used: " << used;
+            if (cacheCounters) {
+                auto it = cacheCounters->find(s.first);
+                if (it != cacheCounters->end()) {
+                    ss << " (cached: " << it->second.fBytes.load() << ")";
+                }
+            }
+            ss << "\n";
+            if (allocStats) {
+                auto it = allocStats->find(s.first);
+                if (it != allocStats->end()) {
+                    ss << AllocStatsStr(it->second);
+                }
+            }
+        }
+
+        if (ownerTable && (ownerTable->fNumTags.load() > 0 || ownerTable->fNumDropped.load() > 0)) {
+            ss << OwnerUsageStr(CollectOwnerUsage(*ownerTable));
+        }
+
+        if (quotaTable && quotaTable->fNumQuotas > 0) {
+            ss << QuotasStr(CollectQuotas(*quotaTable));
+        }
+
+        if (ledgerTable) {
+            size_t numLedgers = std::count_if(ledgerTable->fPids.begin(), ledgerTable->fPids.end(), [](const auto& pid) { return pid.load() > 0; });
+            ss << "   ledgers (--shm-reclaim): " << numLedgers
+               << ", reclaimed chunks: " << ledgerTable->fReclaimedChunks.load()
+               << ", references: " << ledgerTable->fReclaimedRefs.load() << "\n";
         }
 
         ss << "   [m]: "
@@ -316,11 +571,39 @@ void Monitor::ListAll(const std::string& path)
     }
 }
 
+namespace
+{
+
+// liveness of a process registered in the LivenessTable. A pidfd (opened on first sight) stays bound to the process even if
+// the pid is reused later, without pidfd support the check falls back to kill(pid, 0).
+bool ProcessAlive(pid_t pid, std::map<pid_t, int>& pidfds)
+{
+    auto it = pidfds.find(pid);
+    if (it == pidfds.end()) {
+        int fd = -1;
+#ifdef SYS_pidfd_open
+        fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (fd < 0 && errno == ESRCH) {
+            return false;
+        }
+#endif
+        it = pidfds.emplace(pid, fd).first;
+    }
+    if (it->second >= 0) {
+        pollfd pfd{it->second, POLLIN, 0};
+        return poll(&pfd, 1, 0) == 0; // readable once the process has exited
+    }
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+} // namespace
+
 void Monitor::CheckHeartbeats()
 {
     using namespace boost::interprocess;
 
     uint64_t localHb = 0;
+    std::map<pid_t, int> pidfds;
 
     while (!fTerminating) {
         std::this_thread::sleep_for(std::chrono::milliseconds(200));
@@ -336,10 +619,44 @@ void Monitor::CheckHeartbeats()
                     localHb = globalHb;
                 }
             }
+
+            // processes using pid based liveness count as a heartbeat as long as one of them is alive
+            LivenessTable* liveness = managementSegment.find<LivenessTable>(unique_instance).first;
+            if (liveness) {
+                set<pid_t> registered;
+                bool alive = false;
+                for (const auto& p : liveness->fPids) {
+                    pid_t pid = p.load();
+                    if (pid != 0) {
+                        registered.insert(pid);
+                        alive = ProcessAlive(pid, pidfds) || alive;
+                    }
+                }
+                if (alive) {
+                    fHeartbeatTriggered = true;
+                    fLastHeartbeat.store(chrono::high_resolution_clock::now());
+                }
+                for (auto it = pidfds.begin(); it != pidfds.end();) {
+                    if (registered.count(it->first) == 0) {
+                        if (it->second >= 0) {
+                            close(it->second);
+                        }
+                        it = pidfds.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
         } catch (bie&) {
             // management segment not found, simply retry.
         }
     }
+
+    for (const auto& [pid, fd] : pidfds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
 }
 
 void Monitor::Interactive()
@@ -410,8 +727,8 @@ void Monitor::PrintDebugInfo(const ShmId& shmId __attribute__((unused)))
     string managementSegmentName("fmq_" + shmId.shmId + "_mng");
     try {
         bipc::managed_shared_memory managementSegment(bipc::open_only, managementSegmentName.c_str());
-        bipc::interprocess_mutex* mtx(managementSegment.find_or_construct<bipc::interprocess_mutex>(bipc::unique_instance)());
-        bipc::scoped_lock<bipc::interprocess_mutex> lock(*mtx);
+        RobustMutex* mtx(managementSegment.find_or_construct<RobustMutex>(kDebugMapsMtx)());
+        bipc::scoped_lock<RobustMutex> lock(*mtx);
 
         Uint16MsgDebugMapHashMap* debug = managementSegment.find<Uint16MsgDebugMapHashMap>(bipc::unique_instance).first;
 
@@ -448,6 +765,108 @@ void Monitor::PrintDebugInfo(const ShmId& shmId __attribute__((unused)))
 #endif
 }
 
+SessionOwnerUsage Monitor::GetOwnerUsage(const ShmId& shmId)
+{
+    try {
+        bipc::managed_shared_memory managementSegment(bipc::open_read_only, std::string("fmq_" + shmId.shmId + "_mng").c_str());
+        ChunkOwnerTable* ownerTable = managementSegment.find<ChunkOwnerTable>(bipc::unique_instance).first;
+        if (ownerTable) {
+            return CollectOwnerUsage(*ownerTable);
+        }
+    } catch (bie&) {
+        // no session, nothing held
+    }
+    return SessionOwnerUsage();
+}
+
+SessionOwnerUsage Monitor::GetOwnerUsage(const SessionId& sessionId)
+{
+    ShmId shmId{makeShmIdStr(sessionId.sessionId)};
+    return GetOwnerUsage(shmId);
+}
+
+std::vector<QuotaUsage> Monitor::GetQuotas(const ShmId& shmId)
+{
+    try {
+        bipc::managed_shared_memory managementSegment(bipc::open_read_only, std::string("fmq_" + shmId.shmId + "_mng").c_str());
+        QuotaTable* quotaTable = managementSegment.find<QuotaTable>(bipc::unique_instance).first;
+        if (quotaTable) {
+            return CollectQuotas(*quotaTable);
+        }
+    } catch (bie&) {
+        // no session, no quotas
+    }
+    return std::vector<QuotaUsage>();
+}
+
+std::vector<QuotaUsage> Monitor::GetQuotas(const SessionId& sessionId)
+{
+    ShmId shmId{makeShmIdStr(sessionId.sessionId)};
+    return GetQuotas(shmId);
+}
+
+std::vector<UsageStats> Monitor::GetUsageStats(const ShmId& shmId)
+{
+    try {
+        bipc::managed_shared_memory managementSegment(bipc::open_read_only, std::string("fmq_" + shmId.shmId + "_mng").c_str());
+        UsageTable* usageTable = managementSegment.find_no_lock<UsageTable>(bipc::unique_instance).first;
+        if (usageTable) {
+            return CollectUsageStats(*usageTable);
+        }
+    } catch (bie&) {
+        // no session, no stats
+    }
+    return std::vector<UsageStats>();
+}
+
+std::vector<UsageStats> Monitor::GetUsageStats(const SessionId& sessionId)
+{
+    ShmId shmId{makeShmIdStr(sessionId.sessionId)};
+    return GetUsageStats(shmId);
+}
+
+void Monitor::StreamStats(const ShmId& shmId, unsigned int intervalInMS)
+{
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    const string managementSegmentName("fmq_" + shmId.shmId + "_mng");
+    // opened once, the counters are read from the mapping without any further system call or lock
+    unique_ptr<bipc::managed_shared_memory> managementSegment;
+    UsageTable* usageTable = nullptr;
+    DeviceCounter* deviceCounter = nullptr;
+    auto next = chrono::steady_clock::now();
+    while (gSignalStatus == 0) {
+        // a new session of the same id creates a new management segment
+        if (managementSegment && !fs::exists(fs::path("/dev/shm") / managementSegmentName)) {
+            managementSegment.reset();
+            usageTable = nullptr;
+            deviceCounter = nullptr;
+        }
+        if (!managementSegment) {
+            try {
+                managementSegment = make_unique<bipc::managed_shared_memory>(bipc::open_read_only, managementSegmentName.c_str());
+                usageTable = managementSegment->find_no_lock<UsageTable>(bipc::unique_instance).first;
+                deviceCounter = managementSegment->find_no_lock<DeviceCounter>(bipc::unique_instance).first;
+                if (!usageTable) {
+                    managementSegment.reset(); // session of an older version or still initializing
+                }
+            } catch (bie&) {
+                // no session (yet)
+            }
+        }
+
+        cout << UsageStatsJson(shmId.shmId, deviceCounter ? deviceCounter->fCount.load() : 0, usageTable ? CollectUsageStats(*usageTable) : vector<UsageStats>()) << endl;
+
+        next += chrono::milliseconds(intervalInMS);
+        const auto now = chrono::steady_clock::now();
+        if (next < now) {
+            next = now; // fell behind, e.g. a blocked stdout
+        }
+        this_thread::sleep_until(next);
+    }
+}
+
 void Monitor::PrintDebugInfo(const SessionId& sessionId)
 {
     ShmId shmId{makeShmIdStr(sessionId.sessionId)};
@@ -462,8 +881,8 @@ unordered_map<uint16_t, std::vector<BufferDebugInfo>> Monitor::GetDebugInfo(cons
     string managementSegmentName("fmq_" + shmId.shmId + "_mng");
     try {
         bipc::managed_shared_memory managementSegment(bipc::open_only, managementSegmentName.c_str());
-        bipc::interprocess_mutex* mtx(managementSegment.find_or_construct<bipc::interprocess_mutex>(bipc::unique_instance)());
-        bipc::scoped_lock<bipc::interprocess_mutex> lock(*mtx);
+        RobustMutex* mtx(managementSegment.find_or_construct<RobustMutex>(kDebugMapsMtx)());
+        bipc::scoped_lock<RobustMutex> lock(*mtx);
 
         Uint16MsgDebugMapHashMap* debug = managementSegment.find<Uint16MsgDebugMapHashMap>(bipc::unique_instance).first;
 
@@ -500,8 +919,8 @@ unsigned long Monitor::GetFreeMemory(const ShmId& shmId, uint16_t segmentId)
     using namespace boost::interprocess;
     try {
         bipc::managed_shared_memory managementSegment(bipc::open_only, std::string("fmq_" + shmId.shmId + "_mng").c_str());
-        boost::interprocess::interprocess_mutex* mtx(managementSegment.find_or_construct<bipc::interprocess_mutex>(bipc::unique_instance)());
-        boost::interprocess::scoped_lock<bipc::interprocess_mutex> lock(*mtx);
+        RobustMutex* mtx(managementSegment.find_or_construct<RobustMutex>(bipc::unique_instance)());
+        bipc::scoped_lock<RobustMutex> lock(*mtx);
 
         Uint16SegmentInfoHashMap* shmSegments = managementSegment.find<Uint16SegmentInfoHashMap>(unique_instance).first;
 
@@ -515,6 +934,9 @@ unsigned long Monitor::GetFreeMemory(const ShmId& shmId, uint16_t segmentId)
             if (it->second.fAllocationAlgorithm == AllocationAlgorithm::rbtree_best_fit) {
                 RBTreeBestFitSegment segment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + std::to_string(segmentId)).c_str());
                 return segment.get_free_memory();
+            } else if (it->second.fAllocationAlgorithm == AllocationAlgorithm::slab_fit) {
+                SlabFitSegment segment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + std::to_string(segmentId)).c_str());
+                return segment.get_free_memory();
             } else {
                 SimpleSeqFitSegment segment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + std::to_string(segmentId)).c_str());
                 return segment.get_free_memory();
@@ -551,6 +973,8 @@ bool Monitor::SegmentIsPresent(const ShmId& shmId, uint16_t segmentId)
             try {
                 if (it->second.fAllocationAlgorithm == AllocationAlgorithm::rbtree_best_fit) {
                     RBTreeBestFitSegment segment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + std::to_string(segmentId)).c_str());
+                } else if (it->second.fAllocationAlgorithm == AllocationAlgorithm::slab_fit) {
+                    SlabFitSegment segment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + std::to_string(segmentId)).c_str());
                 } else {
                     SimpleSeqFitSegment segment(open_read_only, std::string("fmq_" + shmId.shmId + "_m_" + std::to_string(segmentId)).c_str());
                 }
@@ -672,12 +1096,23 @@ std::vector<std::pair<std::string, bool>> Monitor::Cleanup(const ShmId& shmIdT,
                 if (verbose) {
                     LOG(info) << "Found UnmanagedRegion with id: " << id << ", path: '" << path << "', flags: " << flags << ", fDestroyed: " << info.fDestroyed << ".";
                 }
-                if (!path.empty()) {
+                if (info.fMemfd) {
+                    // nothing to remove, the kernel frees the memory with the last mapping
+                } else if (!path.empty()) {
                     result.emplace_back(Remove<bipc::file_mapping>(path + "fmq_" + shmId + "_rg_" + to_string(id), verbose));
                 } else {
                     result.emplace_back(Remove<bipc::shared_memory_object>("fmq_" + shmId + "_rg_" + to_string(id), verbose));
                 }
                 result.emplace_back(Remove<bipc::message_queue>("fmq_" + shmId + "_rgq_" + to_string(id), verbose));
+                if (info.fAckRing) {
+                    result.emplace_back(Remove<bipc::shared_memory_object>("fmq_" + shmId + "_rga_" + to_string(id), verbose));
+                }
+                if (info.fRefCountSlots > 0) {
+                    result.emplace_back(Remove<bipc::shared_memory_object>("fmq_" + shmId + "_rgrc_" + to_string(id), verbose));
+                }
+                if (info.fRingBuffer && !info.fCrossHost) {
+                    result.emplace_back(Remove<bipc::shared_memory_object>("fmq_" + shmId + "_rgrb_" + to_string(id), verbose));
+                }
             }
         }
 
@@ -688,6 +1123,9 @@ std::vector<std::pair<std::string, bool>> Monitor::Cleanup(const ShmId& shmIdT,
             }
             for (const auto& segment : *shmSegments) {
                 result.emplace_back(Remove<bipc::shared_memory_object>("fmq_" + shmId + "_m_" + to_string(segment.first), verbose));
+                if (segment.second.fRefCountTable) {
+                    result.emplace_back(Remove<bipc::shared_memory_object>("fmq_" + shmId + "_rc_" + to_string(segment.first), verbose));
+                }
             }
         } else {
             if (verbose) {
@@ -695,6 +1133,15 @@ std::vector<std::pair<std::string, bool>> Monitor::Cleanup(const ShmId& shmIdT,
             }
         }
 
+        LedgerTable* ledgers = managementSegment.find<LedgerTable>(bipc::unique_instance).first;
+        if (ledgers) {
+            for (size_t i = 0; i < LedgerTable::kNumSlots; ++i) {
+                if (ledgers->fPids[i].load() != 0) {
+                    result.emplace_back(Remove<bipc::shared_memory_object>(LedgerTable::Name(shmId, i), verbose));
+                }
+            }
+        }
+
         result.emplace_back(Remove<bipc::shared_memory_object>(managementSegmentName, verbose));
     } catch (bie&) {
         if (verbose) {
@@ -730,6 +1177,101 @@ std::vector<std::pair<std::string, bool>> Monitor::CleanupFull(const SessionId&
     return CleanupFull(shmId, verbose);
 }
 
+std::vector<std::pair<std::string, bool>> Monitor::CleanupBatch(const std::vector<ShmId>& shmIds, const std::string& path, unsigned int numThreads, bool verbose /* = true */)
+{
+    std::vector<std::pair<std::string, bool>> result;
+
+    // index of the objects per session, from one directory scan. Object names are "fmq_<shmId>_...",
+    // named mutexes and conditions appear as "sem.fmq_<shmId>_..."
+    std::set<std::string> selected;
+    for (const auto& id : shmIds) {
+        selected.insert(id.shmId);
+    }
+    std::map<std::string, std::vector<std::string>> index;
+    try {
+        for (const auto& entry : fs::directory_iterator(path)) {
+            string filename = entry.path().filename().string();
+            size_t begin = tools::StrStartsWith(filename, "sem.") ? 4 : 0;
+            if (filename.compare(begin, 4, "fmq_") != 0 || filename.size() < begin + 13 || filename[begin + 12] != '_') {
+                continue;
+            }
+            string shmId = filename.substr(begin + 4, 8);
+            if (selected.empty() || selected.count(shmId) > 0) {
+                index[shmId].push_back(std::move(filename));
+            }
+        }
+    } catch (fs::filesystem_error& fse) {
+        LOG(error) << "error: " << fse.what();
+        return result;
+    }
+
+    std::vector<std::pair<const std::string, std::vector<std::string>>*> sessions;
+    for (auto& session : index) {
+        sessions.push_back(&session);
+    }
+    if (verbose) {
+        LOG(info) << "Found " << sessions.size() << " sessions to clean up in " << path;
+    }
+
+    std::mutex resultMtx;
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        std::vector<std::pair<std::string, bool>> removed;
+        for (size_t i = next++; i < sessions.size(); i = next++) {
+            const string& shmId = sessions[i]->first;
+            std::vector<std::string>& files = sessions[i]->second;
+            string managementSegmentName("fmq_" + shmId + "_mng");
+            // the management segment goes last, so that an interrupted cleanup can be repeated
+            auto mng = std::find(files.begin(), files.end(), managementSegmentName);
+            if (mng != files.end()) {
+                std::iter_swap(mng, files.end() - 1);
+                // regions backed by files outside of path are only known to the management segment
+                try {
+                    bipc::managed_shared_memory managementSegment(bipc::open_read_only, managementSegmentName.c_str());
+                    Uint16RegionInfoHashMap* shmRegions = managementSegment.find<Uint16RegionInfoHashMap>(bipc::unique_instance).first;
+                    if (shmRegions) {
+                        for (const auto& region : *shmRegions) {
+                            if (!region.second.fPath.empty() && !region.second.fMemfd) {
+                                removed.emplace_back(Remove<bipc::file_mapping>(region.second.fPath.c_str() + ("fmq_" + shmId + "_rg_" + to_string(region.first)), verbose));
+                            }
+                        }
+                    }
+                } catch (bie&) {
+                    // not a valid management segment, remove the objects anyway
+                }
+            }
+            for (const auto& file : files) {
+                bool success = ::unlink((fs::path(path) / file).string().c_str()) == 0;
+                if (verbose) {
+                    if (success) {
+                        LOG(info) << "Successfully removed '" << file << "'.";
+                    } else {
+                        LOG(debug) << "Did not remove '" << file << "': " << strerror(errno);
+                    }
+                }
+                removed.emplace_back(file, success);
+            }
+        }
+        std::lock_guard<std::mutex> lock(resultMtx);
+        result.insert(result.end(), removed.begin(), removed.end());
+    };
+
+    if (numThreads == 0) {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    numThreads = std::min<size_t>(numThreads, sessions.size());
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < numThreads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    return result;
+}
+
 void Monitor::ResetContent(const ShmId& shmIdT, bool verbose /* = true */)
 {
     std::string shmId = shmIdT.shmId;
@@ -755,12 +1297,22 @@ void Monitor::ResetContent(const ShmId& shmIdT, bool verbose /* = true */)
                         void* ptr = segment.get_segment_manager();
                         size_t size = segment.get_segment_manager()->get_size();
                         new(ptr) segment_manager<char, rbtree_best_fit<mutex_family, offset_ptr<void>>, null_index>(size);
+                    } else if (s.second.fAllocationAlgorithm == AllocationAlgorithm::slab_fit) {
+                        SlabFitSegment segment(open_only, std::string("fmq_" + shmId + "_m_" + to_string(s.first)).c_str());
+                        void* ptr = segment.get_segment_manager();
+                        size_t size = segment.get_segment_manager()->get_size();
+                        new(ptr) segment_manager<char, SlabFitAlgorithm<mutex_family, offset_ptr<void>>, null_index>(size);
                     } else {
                         SimpleSeqFitSegment segment(open_only, std::string("fmq_" + shmId + "_m_" + to_string(s.first)).c_str());
                         void* ptr = segment.get_segment_manager();
                         size_t size = segment.get_segment_manager()->get_size();
                         new(ptr) segment_manager<char, simple_seq_fit<mutex_family, offset_ptr<void>>, null_index>(size);
                     }
+                    if (s.second.fRefCountTable) {
+                        shared_memory_object refCountTable(open_only, std::string("fmq_" + shmId + "_rc_" + to_string(s.first)).c_str(), read_write);
+                        mapped_region refCounts(refCountTable, read_write);
+                        memset(refCounts.get_address(), 0, refCounts.get_size());
+                    }
                     if (verbose) {
                         cout << "Done." << endl;
                     }
@@ -779,6 +1331,12 @@ void Monitor::ResetContent(const ShmId& shmIdT, bool verbose /* = true */)
             for (const auto& region : *shmRegions) {
                 uint16_t id = region.first;
                 Remove<bipc::message_queue>("fmq_" + shmId + "_rgq_" + to_string(id), verbose);
+                if (region.second.fAckRing) {
+                    Remove<bipc::shared_memory_object>("fmq_" + shmId + "_rga_" + to_string(id), verbose);
+                }
+                if (region.second.fRefCountSlots > 0) {
+                    Remove<bipc::shared_memory_object>("fmq_" + shmId + "_rgrc_" + to_string(id), verbose);
+                }
             }
         }
     } catch (bie& e) {
@@ -808,12 +1366,18 @@ void Monitor::ResetContent(const ShmId& shmIdT, const std::vector<SegmentConfig>
 
     std::string shmId = shmIdT.shmId;
     std::string managementSegmentName("fmq_" + shmId + "_mng");
+    // keep the size of the management segment (--shm-management-segment-size)
+    size_t managementSegmentSize = kManagementSegmentSize;
+    try {
+        managementSegmentSize = managed_shared_memory(open_read_only, managementSegmentName.c_str()).get_size();
+    } catch (bie&) {
+    }
     // delete management segment
     cout << "deleting management segment" << endl;
     Remove<bipc::shared_memory_object>(managementSegmentName, verbose);
     // recreate management segment
     cout << "recreating management segment..." << endl;
-    managed_shared_memory mngSegment(create_only, managementSegmentName.c_str(), kManagementSegmentSize);
+    managed_shared_memory mngSegment(create_only, managementSegmentName.c_str(), managementSegmentSize);
     cout << "done." << endl;
     // fill management segment with segment & region infos
     cout << "filling management segment with managed segment configs..." << endl;
@@ -822,6 +1386,8 @@ void Monitor::ResetContent(const ShmId& shmIdT, const std::vector<SegmentConfig>
             Segment::Register(shmId, s.id, AllocationAlgorithm::rbtree_best_fit);
         } else if (s.allocationAlgorithm == "simple_seq_fit") {
             Segment::Register(shmId, s.id, AllocationAlgorithm::simple_seq_fit);
+        } else if (s.allocationAlgorithm == "slab_fit") {
+            Segment::Register(shmId, s.id, AllocationAlgorithm::slab_fit);
         } else {
             LOG(error) << "Unknown allocation algorithm provided: " << s.allocationAlgorithm;
             throw MonitorError("Unknown allocation algorithm provided: " + s.allocationAlgorithm);
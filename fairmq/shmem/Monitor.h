@@ -17,6 +17,7 @@
 #include <atomic>
 #include <string>
 #include <stdexcept>
+#include <array>
 #include <unordered_map>
 #include <utility> // pair
 #include <vector>
@@ -51,6 +52,54 @@ struct BufferDebugInfo
     uint64_t fCreationTime;
 };
 
+/// Managed segment memory held by one device or channel, estimated from the chunks tagged with --shm-owner-sampling
+struct OwnerUsage
+{
+    /// upper bounds (in ms) of the age buckets, the last bucket holds the older chunks
+    static constexpr std::array<uint64_t, 5> kAgeBucketsMs{1, 10, 100, 1000, 10000};
+
+    std::string name; // device id or channel (socket id, "<device>.<channel>.<type>"), "unknown" for chunks never sent
+    uint64_t taggedChunks = 0;
+    uint64_t taggedBytes = 0;
+    uint64_t estimatedBytes = 0; // tagged bytes scaled with the sampling of the producing devices
+    std::array<uint64_t, kAgeBucketsMs.size() + 1> estimatedBytesByAge{};
+    uint64_t maxAgeMs = 0;
+};
+
+struct SessionOwnerUsage
+{
+    std::vector<OwnerUsage> devices;  // by producing device
+    std::vector<OwnerUsage> channels; // by the channel the chunks were last sent on
+    uint64_t droppedTags = 0; // allocations that could not be tagged (table full)
+};
+
+/// Managed segment quota of a device (--shm-quota-soft, --shm-quota-hard) and the memory charged to it
+struct QuotaUsage
+{
+    std::string name; // device id
+    uint64_t soft = 0; // 0: none
+    uint64_t hard = 0; // 0: none
+    uint64_t used = 0; // allocator size of the chunks of the device that are not deallocated yet
+    uint64_t peak = 0;
+    uint64_t softExceeded = 0; // crossings of the soft quota
+    uint64_t hardRejected = 0; // allocation attempts rejected by the hard quota
+};
+
+/// Usage counters of a managed segment or an unmanaged region, published by the devices every --shm-stats-interval ms
+struct UsageStats
+{
+    bool managed = true; // managed segment or unmanaged region
+    uint16_t id = 0;
+    uint64_t size = 0;
+    uint64_t freeBytes = 0; // managed segments
+    uint64_t allocations = 0; // managed segments: by the devices that use the segment as their own
+    uint64_t deallocations = 0; // managed segments: by these devices
+    uint64_t acksSent = 0; // regions: released blocks acknowledged to the region creator
+    uint64_t acksReceived = 0; // regions: acknowledged blocks received by the region creator
+    uint64_t ackBacklog = 0; // regions: acknowledged blocks not yet received (queued or in the bunches of the senders)
+    uint64_t ageMs = 0; // since the last publication
+};
+
 struct SegmentConfig
 {
     uint16_t id;
@@ -88,6 +137,14 @@ class Monitor
     /// @param sessionId session id
     /// @param verbose output cleanup results to stdout
     static std::vector<std::pair<std::string, bool>> CleanupFull(const SessionId& sessionId, bool verbose = true);
+    /// @brief Cleanup all shared memory artifacts of many sessions (created by devices and monitors) at once.
+    /// The objects are indexed with a single scan of path and removed by name, sessions are processed in parallel.
+    /// Only call this for sessions without running devices.
+    /// @param shmIds shared memory ids, all sessions found in path if empty
+    /// @param path directory of the shared memory objects
+    /// @param numThreads number of threads removing sessions in parallel, 0: one per CPU core
+    /// @param verbose output cleanup results to stdout
+    static std::vector<std::pair<std::string, bool>> CleanupBatch(const std::vector<ShmId>& shmIds, const std::string& path = "/dev/shm/", unsigned int numThreads = 0, bool verbose = true);
 
     /// @brief [EXPERIMENTAL] cleanup the content of the shem segment, without recreating it
     /// @param shmId shared memory id
@@ -118,6 +175,30 @@ class Monitor
     /// @brief Returns a list of messages in shmem (if compiled with FAIRMQ_DEBUG_MODE=ON)
     /// @param sessionId session id
     static std::unordered_map<uint16_t, std::vector<BufferDebugInfo>> GetDebugInfo(const SessionId& sessionId);
+    /// @brief Returns the managed segment memory held per device and channel (if devices run with --shm-owner-sampling)
+    /// @param shmId shmem id
+    static SessionOwnerUsage GetOwnerUsage(const ShmId& shmId);
+    /// @brief Returns the managed segment memory held per device and channel (if devices run with --shm-owner-sampling)
+    /// @param sessionId session id
+    static SessionOwnerUsage GetOwnerUsage(const SessionId& sessionId);
+    /// @brief Returns the managed segment quotas of the devices of the session and their usage
+    /// @param shmId shmem id
+    static std::vector<QuotaUsage> GetQuotas(const ShmId& shmId);
+    /// @brief Returns the managed segment quotas of the devices of the session and their usage
+    /// @param sessionId session id
+    static std::vector<QuotaUsage> GetQuotas(const SessionId& sessionId);
+    /// @brief Returns the usage counters of the segments and regions of the session (if devices run with --shm-stats-interval).
+    /// Only reads atomics of the management segment, without taking its locks
+    /// @param shmId shmem id
+    static std::vector<UsageStats> GetUsageStats(const ShmId& shmId);
+    /// @brief Returns the usage counters of the segments and regions of the session (if devices run with --shm-stats-interval).
+    /// Only reads atomics of the management segment, without taking its locks
+    /// @param sessionId session id
+    static std::vector<UsageStats> GetUsageStats(const SessionId& sessionId);
+    /// @brief Prints the usage counters of the session as one JSON object per line to stdout, every intervalInMS, until SIGINT/SIGTERM
+    /// @param shmId shmem id
+    /// @param intervalInMS output interval
+    static void StreamStats(const ShmId& shmId, unsigned int intervalInMS);
     /// @brief Returns the amount of free memory in the specified segment
     /// @param shmId shmem id
     /// @param segmentId segment id
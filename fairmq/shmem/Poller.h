@@ -13,7 +13,11 @@
 #include <fairmq/Channel.h>
 #include <fairmq/Poller.h>
 #include <fairmq/shmem/Socket.h>
+#include <fairmq/zeromq/EpollSet.h>
 #include <fairmq/tools/Strings.h>
+#include <algorithm> // any_of, copy
+#include <chrono>
+#include <memory> // unique_ptr
 #include <unordered_map>
 #include <vector>
 #include <zmq.h>
@@ -24,7 +28,7 @@ namespace fair::mq::shmem
 class Poller final : public fair::mq::Poller
 {
   public:
-    Poller(const std::vector<Channel>& channels)
+    Poller(const std::vector<Channel>& channels, bool epoll = false)
         : fItems()
         , fNumItems(0)
     {
@@ -32,7 +36,8 @@ class Poller final : public fair::mq::Poller
         fItems = new zmq_pollitem_t[fNumItems];
 
         for (int i = 0; i < fNumItems; ++i) {
-            fItems[i].socket = static_cast<const Socket*>(&(channels.at(i).GetSocket()))->GetSocket();
+            fSockets.push_back(static_cast<const Socket*>(&(channels.at(i).GetSocket())));
+            fItems[i].socket = fSockets.back()->GetSocket();
             fItems[i].fd = 0;
             fItems[i].revents = 0;
 
@@ -42,9 +47,11 @@ class Poller final : public fair::mq::Poller
 
             SetItemEvents(fItems[i], type);
         }
+
+        InitEpoll(epoll);
     }
 
-    Poller(const std::vector<Channel*>& channels)
+    Poller(const std::vector<Channel*>& channels, bool epoll = false)
         : fItems()
         , fNumItems(0)
     {
@@ -52,7 +59,8 @@ class Poller final : public fair::mq::Poller
         fItems = new zmq_pollitem_t[fNumItems];
 
         for (int i = 0; i < fNumItems; ++i) {
-            fItems[i].socket = static_cast<const Socket*>(&(channels.at(i)->GetSocket()))->GetSocket();
+            fSockets.push_back(static_cast<const Socket*>(&(channels.at(i)->GetSocket())));
+            fItems[i].socket = fSockets.back()->GetSocket();
             fItems[i].fd = 0;
             fItems[i].revents = 0;
 
@@ -62,9 +70,11 @@ class Poller final : public fair::mq::Poller
 
             SetItemEvents(fItems[i], type);
         }
+
+        InitEpoll(epoll);
     }
 
-    Poller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList)
+    Poller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList, bool epoll = false)
         : fItems()
         , fNumItems(0)
     {
@@ -78,13 +88,15 @@ class Poller final : public fair::mq::Poller
             }
 
             fItems = new zmq_pollitem_t[fNumItems];
+            fSockets.resize(fNumItems);
 
             int index = 0;
             for (std::string channel : channelList) {
                 for (unsigned int i = 0; i < channelsMap.at(channel).size(); ++i) {
                     index = fOffsetMap[channel] + i;
 
-                    fItems[index].socket = static_cast<const Socket*>(&(channelsMap.at(channel).at(i).GetSocket()))->GetSocket();
+                    fSockets[index] = static_cast<const Socket*>(&(channelsMap.at(channel).at(i).GetSocket()));
+                    fItems[index].socket = fSockets[index]->GetSocket();
                     fItems[index].fd = 0;
                     fItems[index].revents = 0;
 
@@ -95,6 +107,8 @@ class Poller final : public fair::mq::Poller
                     SetItemEvents(fItems[index], type);
                 }
             }
+
+            InitEpoll(epoll);
         } catch (const std::out_of_range& oor) {
             LOG(error) << "At least one of the provided channel keys for poller initialization is invalid." << " Out of range error: " << oor.what();
             throw fair::mq::PollerError(fair::mq::tools::ToString("At least one of the provided channel keys for poller initialization is invalid. ", "Out of range error: ", oor.what()));
@@ -122,8 +136,17 @@ class Poller final : public fair::mq::Poller
 
     void Poll(int timeout) override
     {
+        if (std::any_of(fSockets.begin(), fSockets.end(), [](const Socket* s) { return s->UsesMetaRings(); })) {
+            PollWithMetaRings(timeout);
+            return;
+        }
+        if (fEpoll) {
+            fEpoll->Poll(fItems, timeout);
+            return;
+        }
+
         while (true) {
-            if (zmq_poll(fItems, fNumItems, timeout) < 0) {
+            if (zmq_poll(fItems, fNumItems + (fWakeup ? 1 : 0), timeout) < 0) {
                 if (errno == ETERM) {
                     LOG(debug) << "polling exited, reason: " << zmq_strerror(errno);
                     return;
@@ -187,13 +210,89 @@ class Poller final : public fair::mq::Poller
         }
     }
 
+    bool ReadyInputs(std::vector<int>& indices) override
+    {
+        if (!fEpoll) {
+            return false;
+        }
+        fEpoll->ReadyInputs(fItems, indices);
+        return true;
+    }
+
+    bool AddWakeup(int fd) override
+    {
+        if (fWakeup) {
+            return false; // one wakeup fd per poller
+        }
+        // the wakeup item follows the channel items, it is polled but never reported as ready input
+        auto items = new zmq_pollitem_t[fNumItems + 1];
+        std::copy(fItems, fItems + fNumItems, items);
+        items[fNumItems].socket = nullptr;
+        items[fNumItems].fd = fd;
+        items[fNumItems].events = ZMQ_POLLIN;
+        items[fNumItems].revents = 0;
+        delete[] fItems;
+        fItems = items;
+        fWakeup = true;
+        if (fEpoll) {
+            fEpoll->AddWakeup(fd);
+        }
+        return true;
+    }
+
     ~Poller() override { delete[] fItems; }
 
   private:
+    void InitEpoll(bool epoll)
+    {
+        if (!epoll) {
+            return;
+        }
+        if (std::any_of(fSockets.begin(), fSockets.end(), [](const Socket* s) { return s->UsesMetaRings(); })) {
+            LOG(debug) << "meta header rings have no file descriptor, polling with zmq_poll instead of epoll";
+            return;
+        }
+        fEpoll = std::make_unique<zmq::EpollSet>();
+        fEpoll->Init(fItems, fNumItems);
+    }
+
+    // meta header rings have no file descriptor for zmq_poll, check them in (at most) 1 ms steps
+    void PollWithMetaRings(int timeout)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int step = 0;
+        while (true) {
+            if (zmq_poll(fItems, fNumItems + (fWakeup ? 1 : 0), step) < 0) {
+                if (errno == ETERM) {
+                    LOG(debug) << "polling exited, reason: " << zmq_strerror(errno);
+                    return;
+                } else if (errno != EINTR) {
+                    LOG(error) << "polling failed, reason: " << zmq_strerror(errno);
+                    throw fair::mq::PollerError(fair::mq::tools::ToString("Polling failed, reason: ", zmq_strerror(errno)));
+                }
+            }
+            bool ready = false;
+            for (int i = 0; i < fNumItems; ++i) {
+                if (fSockets[i]->UsesMetaRings()) {
+                    fItems[i].revents = ((fSockets[i]->MetaRingReadable() ? ZMQ_POLLIN : 0) | (fSockets[i]->MetaRingWritable() ? ZMQ_POLLOUT : 0)) & fItems[i].events;
+                }
+                ready = ready || fItems[i].revents != 0;
+            }
+            if (ready || timeout == 0 || (fWakeup && fItems[fNumItems].revents != 0)
+                || (timeout > 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeout))) {
+                return;
+            }
+            step = 1;
+        }
+    }
+
     zmq_pollitem_t* fItems;
     int fNumItems;
+    std::vector<const Socket*> fSockets;
 
     std::unordered_map<std::string, int> fOffsetMap;
+    std::unique_ptr<zmq::EpollSet> fEpoll; // set if polling with epoll
+    bool fWakeup = false; // fItems[fNumItems] is the wakeup item
 };
 
 } // namespace fair::mq::shmem
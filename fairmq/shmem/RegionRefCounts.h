@@ -0,0 +1,114 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_REGIONREFCOUNTS_H_
+#define FAIR_MQ_SHMEM_REGIONREFCOUNTS_H_
+
+#include <fairmq/shmem/Common.h>
+#include <fairmq/tools/Strings.h>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace fair::mq::shmem
+{
+
+// Reference counts of shared unmanaged region messages (see RegionConfig::refCountSlots), kept in a slab that is
+// reserved together with the region (fmq_<shmId>_rgrc_<regionId>). A copied region message references its counter
+// by slot index (MetaHeader::fShared, with fSegmentId == kRegionRefCountSegment), so that copying region messages
+// does not allocate from a managed segment. Free slots are kept in a lock-free stack, usable from all processes.
+class RegionRefCounts
+{
+  public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    RegionRefCounts(const std::string& name, uint32_t numSlots, bool create)
+    {
+        using namespace boost::interprocess;
+        if (create) {
+            fObject = shared_memory_object(open_or_create, name.c_str(), read_write);
+            fObject.truncate(static_cast<offset_t>(sizeof(Header) + numSlots * sizeof(Slot)));
+        } else {
+            fObject = shared_memory_object(open_only, name.c_str(), read_write);
+        }
+        fRegion = mapped_region(fObject, read_write);
+        fHeader = static_cast<Header*>(fRegion.get_address());
+        fSlots = reinterpret_cast<Slot*>(fHeader + 1);
+
+        if (create) {
+            fHeader->fNumSlots = numSlots;
+            for (uint32_t i = 0; i < numSlots; ++i) {
+                fSlots[i].fCount.store(0, std::memory_order_relaxed);
+                fSlots[i].fNext.store(i + 1 < numSlots ? i + 1 : kNone, std::memory_order_relaxed);
+            }
+            fHeader->fHead.store(numSlots > 0 ? 0 : kNone, std::memory_order_release);
+        } else if (fRegion.get_size() < sizeof(Header) + fHeader->fNumSlots * sizeof(Slot)) {
+            throw TransportError(tools::ToString("Region ref count slab ", name, " is too small for ", fHeader->fNumSlots, " slots"));
+        }
+    }
+
+    static std::string Name(const std::string& shmId, uint16_t regionId) { return "fmq_" + shmId + "_rgrc_" + std::to_string(regionId); }
+
+    // reserve a counter and initialize it to count, returns kNone if all counters are in use
+    uint32_t Acquire(uint16_t count)
+    {
+        uint64_t head = fHeader->fHead.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t slot = static_cast<uint32_t>(head);
+            if (slot == kNone) {
+                return kNone;
+            }
+            // the upper 32 bits of the head are a tag against ABA
+            uint64_t next = ((head >> 32) + 1) << 32 | fSlots[slot].fNext.load(std::memory_order_relaxed);
+            if (fHeader->fHead.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+                fSlots[slot].fCount.store(count, std::memory_order_relaxed);
+                return slot;
+            }
+        }
+    }
+
+    void Release(uint32_t slot)
+    {
+        uint64_t head = fHeader->fHead.load(std::memory_order_relaxed);
+        while (true) {
+            fSlots[slot].fNext.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            uint64_t next = ((head >> 32) + 1) << 32 | slot;
+            if (fHeader->fHead.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    std::atomic<uint16_t>& RefCount(uint32_t slot) { return fSlots[slot].fCount; }
+    uint32_t NumSlots() const { return fHeader->fNumSlots; }
+
+  private:
+    struct Header
+    {
+        std::atomic<uint64_t> fHead;
+        uint32_t fNumSlots;
+    };
+    struct Slot
+    {
+        std::atomic<uint16_t> fCount;
+        std::atomic<uint32_t> fNext;
+    };
+
+    boost::interprocess::shared_memory_object fObject;
+    boost::interprocess::mapped_region fRegion;
+    Header* fHeader = nullptr;
+    Slot* fSlots = nullptr;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_REGIONREFCOUNTS_H_ */
@@ -0,0 +1,235 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_REGIONRING_H_
+#define FAIR_MQ_SHMEM_REGIONRING_H_
+
+#include <fairmq/shmem/Common.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fairlogger/Logger.h>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include <algorithm> // min
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility> // move
+
+namespace fair::mq::shmem
+{
+
+// Ring buffer mode of an unmanaged region (RegionConfig::ringBuffer). The owner reserves the blocks of the region
+// strictly sequentially with Allocate(), each block is preceded by a small header in the region memory. Releasing a
+// block marks its header, and the process that releases the oldest outstanding block advances the cumulative
+// acknowledgement (tail) over all consecutive released blocks - no per-block acks are sent to the owner. Head and tail
+// are monotonic stream offsets (region position = offset % capacity) in a dedicated object (fmq_<shmId>_rgrb_<regionId>),
+// or, for regions shared with another host (RegionConfig::crossHost), in the memory window behind the region.
+class RegionRing
+{
+  public:
+    static constexpr size_t kAlignment = 16;
+    static constexpr size_t kHeaderSize = 16;
+    // the ring state of a cross-host region starts at the next multiple of this behind the region (device DAX alignment)
+    // and takes as much of the window
+    static constexpr uint64_t kStateAlignment = 2 << 20;
+
+    RegionRing(const std::string& name, char* base, uint64_t regionSize, bool create)
+        : fBase(base)
+    {
+        using namespace boost::interprocess;
+        if (create) {
+            fObject = shared_memory_object(open_or_create, name.c_str(), read_write);
+            fObject.truncate(static_cast<offset_t>(sizeof(Header)));
+        } else {
+            fObject = shared_memory_object(open_only, name.c_str(), read_write);
+        }
+        fRegion = mapped_region(fObject, read_write);
+        Init(name, regionSize, create);
+    }
+
+    // ring state in an existing mapping (cross-host regions). Releases of the other host do not wake a waiting owner
+    // (futexes are per kernel), Allocate() polls for them
+    RegionRing(boost::interprocess::mapped_region&& state, const std::string& name, char* base, uint64_t regionSize, bool create)
+        : fBase(base)
+        , fRegion(std::move(state))
+        , fPollMs(1)
+    {
+        Init(name, regionSize, create);
+    }
+
+    static std::string Name(const std::string& shmId, uint16_t regionId) { return "fmq_" + shmId + "_rgrb_" + std::to_string(regionId); }
+    // offset of the ring state of a cross-host region in its memory window
+    static uint64_t StateOffset(uint64_t regionOffset, uint64_t regionSize) { return (regionOffset + regionSize + kStateAlignment - 1) / kStateAlignment * kStateAlignment; }
+
+    // the ring state was initialized by this process, which allocates the blocks
+    bool Owner() const { return fOwner; }
+
+    // reserve the next block of size bytes, waiting up to timeoutMs (-1: no limit) for releases if the region is full.
+    // Returns nullptr on timeout. Not thread-safe, the region owner serializes the calls
+    void* Allocate(size_t size, int timeoutMs)
+    {
+        const uint64_t capacity = fHeader->fCapacity;
+        const uint64_t span = (kHeaderSize + size + kAlignment - 1) / kAlignment * kAlignment;
+        if (span > capacity) {
+            throw TransportError(tools::ToString("Cannot allocate ", size, " bytes in a ring buffer region of ", capacity, " bytes"));
+        }
+
+        uint64_t head = fHeader->fHead.load(std::memory_order_relaxed);
+        const uint64_t pos = head % capacity;
+        // a block does not wrap around, the rest of the region is skipped by a released padding block
+        const uint64_t skip = pos + span > capacity ? capacity - pos : 0;
+
+        if (!WaitForSpace(head + skip + span, timeoutMs)) {
+            return nullptr;
+        }
+
+        if (skip > 0) {
+            BlockHeader* padding = HeaderAt(pos);
+            padding->fSize.store(skip, std::memory_order_relaxed);
+            padding->fReleased.store(1, std::memory_order_relaxed);
+            head += skip;
+        }
+        BlockHeader* header = HeaderAt(head % capacity);
+        header->fSize.store(span, std::memory_order_relaxed);
+        header->fReleased.store(0, std::memory_order_relaxed);
+        fHeader->fHead.store(head + span, std::memory_order_release);
+        if (skip > 0) {
+            // the padding block may be the oldest outstanding one
+            Advance();
+        }
+        return fBase + head % capacity + kHeaderSize;
+    }
+
+    // release the block at the given offset in the region (as returned by Allocate()), from any process
+    void Release(size_t handle)
+    {
+        if (handle < kHeaderSize || handle >= fHeader->fCapacity) {
+            LOG(error) << "Invalid block offset " << handle << " released to ring buffer region of " << fHeader->fCapacity << " bytes";
+            return;
+        }
+        HeaderAt(handle - kHeaderSize)->fReleased.store(1, std::memory_order_seq_cst);
+        Advance();
+    }
+
+    uint64_t Capacity() const { return fHeader->fCapacity; }
+    // stream offset of the next block
+    uint64_t Head() const { return fHeader->fHead.load(std::memory_order_acquire); }
+    // stream offset up to which all blocks have been released
+    uint64_t Tail() const { return fHeader->fTail.load(std::memory_order_acquire); }
+    // bytes not held by unreleased blocks (an allocation needs its header and alignment, and does not wrap around)
+    uint64_t FreeSpace() const { return fHeader->fCapacity - (Head() - Tail()); }
+
+  private:
+    void Init(const std::string& name, uint64_t regionSize, bool create)
+    {
+        fHeader = static_cast<Header*>(fRegion.get_address());
+        fOwner = create;
+
+        if (create) {
+            fHeader->fCapacity = regionSize / kAlignment * kAlignment;
+            fHeader->fHead.store(0, std::memory_order_relaxed);
+            fHeader->fTail.store(0, std::memory_order_relaxed);
+            fHeader->fAcks.store(0, std::memory_order_relaxed);
+            fHeader->fWaiting.store(0, std::memory_order_release);
+        } else if (fHeader->fCapacity > regionSize) {
+            throw TransportError(tools::ToString("Region ring ", name, " is larger (", fHeader->fCapacity, ") than its region (", regionSize, ")"));
+        }
+    }
+
+    struct BlockHeader
+    {
+        std::atomic<uint64_t> fSize; // including header and alignment
+        std::atomic<uint32_t> fReleased;
+        uint32_t fReserved;
+    };
+    static_assert(sizeof(BlockHeader) == kHeaderSize);
+
+    struct Header
+    {
+        alignas(64) std::atomic<uint64_t> fHead; // written by the owner only
+        uint64_t fCapacity;
+        alignas(64) std::atomic<uint64_t> fTail;
+        std::atomic<uint32_t> fAcks;    // incremented when the tail advances (futex word of a waiting owner)
+        std::atomic<uint32_t> fWaiting; // the owner waits for space
+    };
+
+    BlockHeader* HeaderAt(uint64_t pos) const { return reinterpret_cast<BlockHeader*>(fBase + pos); }
+
+    // move the tail over the consecutive released blocks. Whoever releases last of two concurrent releases sees the mark
+    // of the other (sequentially consistent mark and check), so no advance is lost
+    void Advance()
+    {
+        const uint64_t capacity = fHeader->fCapacity;
+        uint64_t tail = fHeader->fTail.load(std::memory_order_seq_cst);
+        bool advanced = false;
+        while (tail < fHeader->fHead.load(std::memory_order_acquire)) {
+            BlockHeader* header = HeaderAt(tail % capacity);
+            if (header->fReleased.load(std::memory_order_seq_cst) == 0) {
+                break;
+            }
+            // a stale tail fails the exchange (the offsets never repeat), even if the header has been reused already
+            const uint64_t size = header->fSize.load(std::memory_order_relaxed);
+            if (fHeader->fTail.compare_exchange_strong(tail, tail + size, std::memory_order_seq_cst)) {
+                tail += size;
+                advanced = true;
+            }
+        }
+        if (advanced) {
+            fHeader->fAcks.fetch_add(1, std::memory_order_seq_cst);
+            if (fHeader->fWaiting.load(std::memory_order_seq_cst) != 0) {
+                FutexWake(fHeader->fAcks, 1);
+            }
+        }
+    }
+
+    bool WaitForSpace(uint64_t end, int timeoutMs)
+    {
+        const uint64_t capacity = fHeader->fCapacity;
+        if (end - fHeader->fTail.load(std::memory_order_acquire) <= capacity) {
+            return true;
+        }
+        if (timeoutMs == 0) {
+            return false;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (true) {
+            fHeader->fWaiting.store(1, std::memory_order_seq_cst);
+            uint32_t acks = fHeader->fAcks.load(std::memory_order_seq_cst);
+            if (end - fHeader->fTail.load(std::memory_order_seq_cst) <= capacity) {
+                fHeader->fWaiting.store(0, std::memory_order_relaxed);
+                return true;
+            }
+            int waitMs = -1;
+            if (timeoutMs > 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    fHeader->fWaiting.store(0, std::memory_order_relaxed);
+                    return false;
+                }
+                waitMs = static_cast<int>(remaining);
+            }
+            // bounded, a releasing process may have died between advancing and waking
+            FutexWait(fHeader->fAcks, acks, waitMs < 0 ? fPollMs : std::min(waitMs, fPollMs));
+        }
+    }
+
+    char* fBase;
+    boost::interprocess::shared_memory_object fObject;
+    boost::interprocess::mapped_region fRegion;
+    Header* fHeader = nullptr;
+    int fPollMs = 100; // bound of a wait for releases
+    bool fOwner = false;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_REGIONRING_H_ */
@@ -0,0 +1,180 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_REGIONSLOTS_H_
+#define FAIR_MQ_SHMEM_REGIONSLOTS_H_
+
+#include <fairmq/shmem/Common.h>
+#include <fairmq/Transports.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fairlogger/Logger.h>
+
+#include <algorithm> // min
+#include <atomic>
+#include <chrono>
+#include <climits> // INT_MAX
+#include <cstddef> // size_t
+#include <cstdint>
+#include <string>
+
+namespace fair::mq::shmem
+{
+
+// Shared slot pool mode of an unmanaged region (RegionConfig::slotSize). The region is divided into slots of a fixed
+// size, the free ones are kept in a lock-free stack in the region itself (state and per-slot links in front of the
+// slots). Any process of the session that maps the region allocates slots from it, and a released slot goes back to
+// the stack by the process that releases it - no acks, no region callbacks, no owner thread. Slots of a process that
+// dies while holding them are lost until the region is recreated.
+class RegionSlots
+{
+  public:
+    static constexpr size_t kAlignment = 64;
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    RegionSlots(const std::string& name, char* base, uint64_t regionSize, uint64_t slotSize, bool create)
+        : fBase(base)
+        , fHeader(reinterpret_cast<Header*>(base))
+        , fNext(reinterpret_cast<std::atomic<uint32_t>*>(base + sizeof(Header)))
+    {
+        if (create) {
+            const uint64_t stride = (slotSize + kAlignment - 1) / kAlignment * kAlignment;
+            uint64_t numSlots = regionSize > sizeof(Header) ? (regionSize - sizeof(Header)) / (stride + sizeof(uint32_t)) : 0;
+            while (numSlots > 0 && SlotsOffset(numSlots) + numSlots * stride > regionSize) {
+                --numSlots;
+            }
+            if (slotSize == 0 || numSlots == 0 || numSlots >= kEmpty) {
+                throw TransportError(tools::ToString("Cannot divide region ", name, " of ", regionSize, " bytes into slots of ", slotSize, " bytes"));
+            }
+            fHeader->fSlotSize = stride;
+            fHeader->fNumSlots = numSlots;
+            fHeader->fSlotsOffset = SlotsOffset(numSlots);
+            for (uint64_t i = 0; i < numSlots; ++i) {
+                fNext[i].store(i + 1 < numSlots ? static_cast<uint32_t>(i + 1) : kEmpty, std::memory_order_relaxed);
+            }
+            fHeader->fHead.store(0, std::memory_order_relaxed);
+            fHeader->fNumFree.store(numSlots, std::memory_order_relaxed);
+            fHeader->fReleases.store(0, std::memory_order_relaxed);
+            fHeader->fWaiting.store(0, std::memory_order_relaxed);
+            fHeader->fMagic.store(kMagic, std::memory_order_release);
+        } else if (fHeader->fMagic.load(std::memory_order_acquire) != kMagic || fHeader->fSlotSize < slotSize) {
+            throw TransportError(tools::ToString("Region ", name, " is not a slot pool of slots of ", slotSize, " bytes"));
+        }
+    }
+
+    // take a free slot for size bytes, waiting up to timeoutMs (-1: no limit) for releases if none is free. Returns
+    // nullptr on timeout. Thread-safe and usable by all processes of the session
+    void* Allocate(size_t size, int timeoutMs)
+    {
+        if (size > fHeader->fSlotSize) {
+            throw TransportError(tools::ToString("Cannot allocate ", size, " bytes in a slot pool region with slots of ", fHeader->fSlotSize, " bytes"));
+        }
+        uint32_t slot = Pop();
+        if (slot == kEmpty && timeoutMs != 0) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+            fHeader->fWaiting.fetch_add(1, std::memory_order_seq_cst);
+            while (true) {
+                uint32_t releases = fHeader->fReleases.load(std::memory_order_seq_cst);
+                slot = Pop();
+                if (slot != kEmpty) {
+                    break;
+                }
+                int waitMs = fPollMs;
+                if (timeoutMs > 0) {
+                    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                    if (remaining <= 0) {
+                        break;
+                    }
+                    waitMs = std::min(static_cast<int>(remaining), fPollMs);
+                }
+                // bounded, a releasing process may have died between pushing and waking
+                FutexWait(fHeader->fReleases, releases, waitMs);
+            }
+            fHeader->fWaiting.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (slot == kEmpty) {
+            return nullptr;
+        }
+        return fBase + fHeader->fSlotsOffset + slot * fHeader->fSlotSize;
+    }
+
+    // return the slot containing the given offset in the region (as handle of a message in it), from any process
+    void Release(size_t handle)
+    {
+        const uint64_t offset = fHeader->fSlotsOffset;
+        if (handle < offset || handle >= offset + fHeader->fNumSlots * fHeader->fSlotSize) {
+            LOG(error) << "Invalid slot offset " << handle << " released to slot pool region of " << fHeader->fNumSlots << " slots";
+            return;
+        }
+        Push(static_cast<uint32_t>((handle - offset) / fHeader->fSlotSize));
+        fHeader->fReleases.fetch_add(1, std::memory_order_seq_cst);
+        if (fHeader->fWaiting.load(std::memory_order_seq_cst) != 0) {
+            FutexWake(fHeader->fReleases, INT_MAX);
+        }
+    }
+
+    uint64_t SlotSize() const { return fHeader->fSlotSize; }
+    uint64_t NumSlots() const { return fHeader->fNumSlots; }
+    uint64_t NumFree() const { return fHeader->fNumFree.load(std::memory_order_relaxed); }
+
+  private:
+    static constexpr uint64_t kMagic = 0x666d71736c6f7473; // "fmqslots"
+
+    struct Header
+    {
+        std::atomic<uint64_t> fMagic; // set last by the creator
+        uint64_t fSlotSize;           // including alignment
+        uint64_t fNumSlots;
+        uint64_t fSlotsOffset;
+        alignas(64) std::atomic<uint64_t> fHead; // ABA tag (upper 32 bits) and index of the first free slot
+        std::atomic<uint64_t> fNumFree;
+        alignas(64) std::atomic<uint32_t> fReleases; // incremented by every release (futex word of waiting allocations)
+        std::atomic<uint32_t> fWaiting;              // number of waiting allocations
+    };
+
+    static uint64_t SlotsOffset(uint64_t numSlots) { return (sizeof(Header) + numSlots * sizeof(uint32_t) + kAlignment - 1) / kAlignment * kAlignment; }
+
+    uint32_t Pop()
+    {
+        uint64_t head = fHeader->fHead.load(std::memory_order_acquire);
+        while (true) {
+            const auto slot = static_cast<uint32_t>(head);
+            if (slot == kEmpty) {
+                return kEmpty;
+            }
+            // the link may be stale if another process popped the slot meanwhile, the tag then fails the exchange
+            const uint64_t next = ((head >> 32) + 1) << 32 | fNext[slot].load(std::memory_order_relaxed);
+            if (fHeader->fHead.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                fHeader->fNumFree.fetch_sub(1, std::memory_order_relaxed);
+                return slot;
+            }
+        }
+    }
+
+    void Push(uint32_t slot)
+    {
+        uint64_t head = fHeader->fHead.load(std::memory_order_relaxed);
+        while (true) {
+            fNext[slot].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            const uint64_t next = ((head >> 32) + 1) << 32 | slot;
+            if (fHeader->fHead.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed)) {
+                fHeader->fNumFree.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    char* fBase;
+    Header* fHeader;
+    std::atomic<uint32_t>* fNext; // links of the free slots, in front of the slots
+    int fPollMs = 100; // bound of a wait for releases
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_REGIONSLOTS_H_ */
@@ -0,0 +1,246 @@
+/********************************************************************************
+ *    Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef FAIR_MQ_SHMEM_RING_H_
+#define FAIR_MQ_SHMEM_RING_H_
+
+#include <fairmq/shmem/Common.h>
+
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/offset_ptr.hpp>
+
+#include <atomic>
+#include <climits> // INT_MAX
+#include <cstdint>
+#include <new> // placement new
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace fair::mq::shmem
+{
+
+template<typename T>
+struct RingCell
+{
+    std::atomic<uint64_t> fSeq;
+    std::atomic<uint32_t> fParts; // number of elements of the record starting at this cell, 0 for continuation cells
+    T fValue;
+};
+
+// Bounded multi-producer/multi-consumer queue of trivially copyable elements, living in shared memory.
+// Based on the sequence-numbered cells of a Vyukov queue, extended to variable length records:
+// a record (e.g. a multipart message) occupies consecutive cells, which are reserved (and released) with a single CAS.
+// Wakeups go through futexes, which are only touched when the other side registered as waiting,
+// i.e. blocked on an empty (or full) ring.
+template<typename T>
+class Ring
+{
+    static_assert(std::is_trivially_copyable<T>::value, "ring elements are copied between processes");
+
+  public:
+    using SegmentManager = boost::interprocess::managed_shared_memory::segment_manager;
+
+    Ring(size_t capacity, SegmentManager* segmentManager)
+        : fEnqueuePos(0)
+        , fDequeuePos(0)
+        , fDataFutex(0)
+        , fConsumersWaiting(0)
+        , fSpaceFutex(0)
+        , fProducersWaiting(0)
+        , fCapacity(2)
+        , fCells(nullptr)
+        , fSegmentManager(segmentManager)
+    {
+        while (fCapacity < capacity) {
+            fCapacity *= 2;
+        }
+        fMask = fCapacity - 1;
+        fCells = static_cast<RingCell<T>*>(segmentManager->allocate(fCapacity * sizeof(RingCell<T>)));
+        for (uint64_t i = 0; i < fCapacity; ++i) {
+            RingCell<T>* cell = new (fCells.get() + i) RingCell<T>();
+            cell->fSeq.store(i, std::memory_order_relaxed);
+            cell->fParts.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Ring(const Ring&) = delete;
+    Ring(Ring&&) = delete;
+    Ring& operator=(const Ring&) = delete;
+    Ring& operator=(Ring&&) = delete;
+
+    ~Ring() { fSegmentManager->deallocate(fCells.get()); }
+
+    size_t Capacity() const { return fCapacity; }
+
+    // publishes n elements as one record. Returns false if there is not enough free space.
+    bool TryPush(const T* values, uint32_t n)
+    {
+        if (n == 0 || n > fCapacity) {
+            return false;
+        }
+        uint64_t pos = fEnqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            // the last cell of the range is free -> all cells before it have been claimed by consumers
+            int64_t diff = static_cast<int64_t>(Cell(pos + n - 1).fSeq.load(std::memory_order_acquire)) - static_cast<int64_t>(pos + n - 1);
+            if (diff == 0) {
+                if (fEnqueuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = fEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            RingCell<T>& cell = Cell(pos + i);
+            while (cell.fSeq.load(std::memory_order_acquire) != pos + i) {
+                std::this_thread::yield(); // a consumer is still copying out of this cell
+            }
+            cell.fParts.store(i == 0 ? n : 0, std::memory_order_relaxed);
+            cell.fValue = values[i];
+            cell.fSeq.store(pos + i + 1, std::memory_order_release);
+        }
+        fDataFutex.fetch_add(1);
+        if (fConsumersWaiting.load() > 0) {
+            FutexWake(fDataFutex, 1);
+        }
+        return true;
+    }
+
+    // appends the elements of the next record to out. Returns their number, 0 if the ring is empty.
+    uint32_t TryPop(std::vector<T>& out)
+    {
+        uint64_t pos = fDequeuePos.load(std::memory_order_relaxed);
+        uint32_t parts = 0;
+        while (true) {
+            RingCell<T>& head = Cell(pos);
+            int64_t diff = static_cast<int64_t>(head.fSeq.load(std::memory_order_acquire)) - static_cast<int64_t>(pos + 1);
+            if (diff == 0) {
+                parts = head.fParts.load(std::memory_order_relaxed);
+                if (fDequeuePos.compare_exchange_weak(pos, pos + parts, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return 0;
+            } else {
+                pos = fDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        for (uint32_t i = 0; i < parts; ++i) {
+            RingCell<T>& cell = Cell(pos + i);
+            while (cell.fSeq.load(std::memory_order_acquire) != pos + i + 1) {
+                std::this_thread::yield(); // the producer is still writing this part
+            }
+            out.push_back(cell.fValue);
+            cell.fSeq.store(pos + i + fCapacity, std::memory_order_release);
+        }
+        fSpaceFutex.fetch_add(1);
+        if (fProducersWaiting.load() > 0) {
+            FutexWake(fSpaceFutex, INT_MAX);
+        }
+        return parts;
+    }
+
+    bool Empty() const
+    {
+        uint64_t pos = fDequeuePos.load(std::memory_order_relaxed);
+        return Cell(pos).fSeq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // number of occupied cells (approximate while producers/consumers are active)
+    size_t Size() const
+    {
+        uint64_t enq = fEnqueuePos.load(std::memory_order_relaxed);
+        uint64_t deq = fDequeuePos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    // number of published records (messages), walks the occupied cells. A snapshot while producers/consumers are active.
+    size_t NumRecords() const
+    {
+        uint64_t pos = fDequeuePos.load(std::memory_order_relaxed);
+        const uint64_t end = fEnqueuePos.load(std::memory_order_relaxed);
+        size_t records = 0;
+        while (pos < end) {
+            const RingCell<T>& head = Cell(pos);
+            // not yet published, or taken by a consumer in the meantime
+            if (head.fSeq.load(std::memory_order_acquire) != pos + 1) {
+                break;
+            }
+            const uint32_t parts = head.fParts.load(std::memory_order_relaxed);
+            if (parts == 0) {
+                break;
+            }
+            pos += parts;
+            ++records;
+        }
+        return records;
+    }
+
+    bool HasSpace(uint32_t n = 1) const
+    {
+        uint64_t pos = fEnqueuePos.load(std::memory_order_relaxed);
+        return Cell(pos + n - 1).fSeq.load(std::memory_order_acquire) == pos + n - 1;
+    }
+
+    // block until the ring may be non-empty, at most timeoutMs
+    void WaitForData(int timeoutMs)
+    {
+        fConsumersWaiting.fetch_add(1);
+        uint32_t seq = fDataFutex.load();
+        if (Empty()) {
+            FutexWait(fDataFutex, seq, timeoutMs);
+        }
+        fConsumersWaiting.fetch_sub(1);
+    }
+
+    // block until the ring may have space for n elements, at most timeoutMs
+    void WaitForSpace(uint32_t n, int timeoutMs)
+    {
+        fProducersWaiting.fetch_add(1);
+        uint32_t seq = fSpaceFutex.load();
+        if (!HasSpace(n)) {
+            FutexWait(fSpaceFutex, seq, timeoutMs);
+        }
+        fProducersWaiting.fetch_sub(1);
+    }
+
+  private:
+    RingCell<T>& Cell(uint64_t pos) const { return fCells[pos & fMask]; }
+
+    // producer and consumer positions on separate cache lines
+    std::atomic<uint64_t> fEnqueuePos;
+    char fPad0[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> fDequeuePos;
+    char fPad1[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint32_t> fDataFutex;
+    std::atomic<uint32_t> fConsumersWaiting;
+    char fPad2[64 - 2 * sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> fSpaceFutex;
+    std::atomic<uint32_t> fProducersWaiting;
+    char fPad3[64 - 2 * sizeof(std::atomic<uint32_t>)];
+    uint64_t fCapacity;
+    uint64_t fMask;
+    boost::interprocess::offset_ptr<RingCell<T>> fCells;
+    boost::interprocess::offset_ptr<SegmentManager> fSegmentManager;
+};
+
+// meta headers of the messages of a connection (see Manager::AttachMetaRings)
+struct MetaRing : Ring<MetaHeader>
+{
+    using Ring<MetaHeader>::Ring;
+
+    uint32_t fAttached = 0; // sockets using the ring, guarded by the management segment mutex
+};
+// acknowledgements of released blocks of an unmanaged region (see RegionConfig::ackRing)
+using AckRing = Ring<RegionBlock>;
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_RING_H_ */
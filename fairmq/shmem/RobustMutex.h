@@ -0,0 +1,163 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_SHMEM_ROBUSTMUTEX_H_
+#define FAIR_MQ_SHMEM_ROBUSTMUTEX_H_
+
+#include <fairlogger/Logger.h>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/interprocess/exceptions.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <ctime> // timespec
+
+#include <pthread.h>
+
+namespace fair::mq::shmem
+{
+
+// names of the mutexes in the management segment besides the session mutex (the unique RobustMutex instance), which
+// guards the segment table, the session info and the process tables
+static constexpr const char* kRegionTableMtx = "RegionTableMtx"; // unmanaged region table (Uint16RegionInfoHashMap)
+static constexpr const char* kDebugMapsMtx = "DebugMapsMtx";     // message debug maps (FAIRMQ_DEBUG_MODE)
+
+// Process-shared mutex for the structures of the management segment, usable with boost::interprocess::scoped_lock.
+// It is robust where the platform supports it (Linux): when its owner dies while holding it, the next lock() makes it
+// consistent again and takes it over instead of blocking the session forever. The structure it guards may be half
+// updated then, the users keep their critical sections to single, self-contained updates.
+class RobustMutex
+{
+    friend class RobustCondition;
+
+  public:
+    RobustMutex()
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+        pthread_mutex_init(&fMtx, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    RobustMutex(const RobustMutex&) = delete;
+    RobustMutex(RobustMutex&&) = delete;
+    RobustMutex& operator=(const RobustMutex&) = delete;
+    RobustMutex& operator=(RobustMutex&&) = delete;
+
+    ~RobustMutex() { pthread_mutex_destroy(&fMtx); }
+
+    /// @throw boost::interprocess::lock_exception if the mutex is not recoverable
+    void lock() { Acquired(pthread_mutex_lock(&fMtx)); }
+
+    bool try_lock()
+    {
+        int rc = pthread_mutex_trylock(&fMtx);
+        if (rc == EBUSY) {
+            return false;
+        }
+        Acquired(rc);
+        return true;
+    }
+
+    void unlock() { pthread_mutex_unlock(&fMtx); }
+
+    // number of times the mutex was taken over from a dead owner
+    uint64_t NumRecoveries() const { return fRecoveries.load(std::memory_order_relaxed); }
+
+  private:
+    void Acquired(int rc)
+    {
+        if (rc == 0) {
+            return;
+        }
+#ifdef __linux__
+        if (rc == EOWNERDEAD) {
+            pthread_mutex_consistent(&fMtx);
+            fRecoveries.fetch_add(1, std::memory_order_relaxed);
+            LOG(warn) << "Owner of a shared memory management mutex died while holding it, recovered the mutex.";
+            return;
+        }
+#endif
+        LOG(error) << "Could not lock shared memory management mutex, error " << rc;
+        throw boost::interprocess::lock_exception();
+    }
+
+    pthread_mutex_t fMtx;
+    std::atomic<uint64_t> fRecoveries{0};
+};
+
+// Process-shared condition variable for a RobustMutex held by a boost::interprocess::scoped_lock. Waking up with a mutex
+// whose owner died recovers it the same way as RobustMutex::lock().
+class RobustCondition
+{
+  public:
+    RobustCondition()
+    {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_cond_init(&fCV, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+    RobustCondition(const RobustCondition&) = delete;
+    RobustCondition(RobustCondition&&) = delete;
+    RobustCondition& operator=(const RobustCondition&) = delete;
+    RobustCondition& operator=(RobustCondition&&) = delete;
+
+    ~RobustCondition() { pthread_cond_destroy(&fCV); }
+
+    void notify_one() { pthread_cond_signal(&fCV); }
+    void notify_all() { pthread_cond_broadcast(&fCV); }
+
+    template<typename Lock>
+    void wait(Lock& lock)
+    {
+        RobustMutex& mtx = *lock.mutex();
+        mtx.Acquired(pthread_cond_wait(&fCV, &mtx.fMtx));
+    }
+
+    template<typename Lock, typename Pred>
+    void wait(Lock& lock, Pred pred)
+    {
+        while (!pred()) {
+            wait(lock);
+        }
+    }
+
+    /// @param absTime (UTC) deadline, as for boost::interprocess::interprocess_condition::timed_wait
+    /// @return false if the deadline passed
+    template<typename Lock>
+    bool timed_wait(Lock& lock, const boost::posix_time::ptime& absTime)
+    {
+        const int64_t us = (absTime - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_microseconds();
+        timespec ts;
+        ts.tv_sec = us / 1000000;
+        ts.tv_nsec = (us % 1000000) * 1000;
+        RobustMutex& mtx = *lock.mutex();
+        int rc = pthread_cond_timedwait(&fCV, &mtx.fMtx, &ts);
+        if (rc == ETIMEDOUT) {
+            return false;
+        }
+        mtx.Acquired(rc);
+        return true;
+    }
+
+  private:
+    pthread_cond_t fCV;
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_ROBUSTMUTEX_H_ */
@@ -21,8 +21,10 @@ namespace fair::mq::shmem
 
 struct SimpleSeqFit {};
 struct RBTreeBestFit {};
+struct SlabFit {};
 static const SimpleSeqFit simpleSeqFit = SimpleSeqFit();
 static const RBTreeBestFit rbTreeBestFit = RBTreeBestFit();
+static const SlabFit slabFit = SlabFit();
 
 struct Segment
 {
@@ -44,6 +46,14 @@ struct Segment
         Register(shmId, id, AllocationAlgorithm::rbtree_best_fit);
     }
 
+    Segment(const std::string& shmId, uint16_t id, size_t size, SlabFit)
+        : fSegment(SlabFitSegment(boost::interprocess::open_or_create,
+                                  std::string("fmq_" + shmId + "_m_" + std::to_string(id)).c_str(),
+                                  size))
+    {
+        Register(shmId, id, AllocationAlgorithm::slab_fit);
+    }
+
     size_t GetSize() const { return boost::apply_visitor(SegmentSize(), fSegment); }
     void* GetData() { return boost::apply_visitor(SegmentAddress(), fSegment); }
 
@@ -63,7 +73,7 @@ struct Segment
     }
 
   private:
-    boost::variant<RBTreeBestFitSegment, SimpleSeqFitSegment> fSegment;
+    boost::variant<RBTreeBestFitSegment, SimpleSeqFitSegment, SlabFitSegment> fSegment;
 
     static void Register(const std::string& shmId, uint16_t id, AllocationAlgorithm allocAlgo)
     {
@@ -77,7 +87,7 @@ struct Segment
 
         bool newSegmentRegistered = shmSegments->emplace(id, allocAlgo).second;
         if (newSegmentRegistered) {
-            (eventCounter->fCount)++;
+            eventCounter->Increment(id, true, false);
         }
     }
 };
@@ -0,0 +1,388 @@
+/********************************************************************************
+ *    Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+#ifndef FAIR_MQ_SHMEM_SLABFIT_H_
+#define FAIR_MQ_SHMEM_SLABFIT_H_
+
+#include <boost/interprocess/containers/allocation_type.hpp>
+#include <boost/interprocess/mem_algo/detail/mem_algo_common.hpp>
+
+#include <algorithm> // min
+#include <atomic>
+#include <cstddef> // size_t, ptrdiff_t
+#include <cstdint>
+#include <cstring> // memset
+
+namespace fair::mq::shmem
+{
+
+// Segregated fit (slab) memory algorithm for boost::interprocess managed segments.
+//
+// Memory is carved from the segment with a bump pointer into blocks of fixed size classes
+// (four classes per power of two, i.e. at most 25% internal fragmentation).
+// Freed blocks are pushed to a per size class free list (tagged Treiber stack) and reused for the same class.
+// All bookkeeping is stored in the segment and updated with atomics only, so allocation and deallocation
+// from multiple processes do not take a mutex. Freed blocks are not coalesced:
+// memory given to a size class is only reused by allocations of that class (or of smaller classes once the bump area is exhausted).
+//
+// Block layout: [BlockHdr][user buffer]. Aligned allocations place an additional BlockHdr right before the aligned user buffer,
+// storing the offset back to the beginning of the user buffer of the block.
+template<class MutexFamily, class VoidPointer>
+class SlabFitAlgorithm
+{
+  public:
+    using mutex_family = MutexFamily;
+    using void_pointer = VoidPointer;
+    using multiallocation_chain = boost::interprocess::ipcdetail::basic_multiallocation_chain<VoidPointer>;
+    using difference_type = std::ptrdiff_t;
+    using size_type = std::size_t;
+
+    static constexpr size_type Alignment = 16;
+
+  private:
+    struct BlockHdr
+    {
+        uint32_t fSizeClass;
+        uint32_t fBackOffset; // aligned allocations: distance from the block user buffer to the aligned user buffer, in Alignment units
+        std::atomic<uint64_t> fNext; // next free block (offset from the algorithm in Alignment units), valid only while the block is free
+    };
+
+    static_assert(sizeof(BlockHdr) == Alignment, "block header has to occupy exactly one alignment unit");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "slab_fit requires lock-free 64 bit atomics");
+
+    static constexpr size_type kMinShift = 6;  // smallest block: 64 bytes (header included)
+    static constexpr size_type kMaxShift = 44; // largest block: 16 TiB
+    static constexpr size_type kStepsPerShift = 4;
+    static constexpr size_type kNumClasses = (kMaxShift - kMinShift) * kStepsPerShift + 1;
+    // how many larger classes are searched when the requested class and the bump area are both exhausted
+    static constexpr size_type kMaxFallbackClasses = 8;
+
+    // free list head: [tag (20 bits)][offset in Alignment units (44 bits)]
+    static constexpr uint64_t kOffsetBits = 44;
+    static constexpr uint64_t kOffsetMask = (uint64_t(1) << kOffsetBits) - 1;
+
+  public:
+    SlabFitAlgorithm(const SlabFitAlgorithm&) = delete;
+    SlabFitAlgorithm& operator=(const SlabFitAlgorithm&) = delete;
+
+    SlabFitAlgorithm(size_type size, size_type extraHdrBytes)
+        : fSize(size)
+        , fExtraHdrBytes(extraHdrBytes)
+        , fFirstBlockOffset(FirstBlockOffset(this, extraHdrBytes))
+        , fBumpOffset(fFirstBlockOffset)
+        , fFreeListBytes(0)
+    {
+        for (auto& head : fFreeLists) {
+            head.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static size_type get_min_size(size_type extraHdrBytes)
+    {
+        return sizeof(SlabFitAlgorithm) + extraHdrBytes + 2 * Alignment + ClassBlockSize(0);
+    }
+
+    void* allocate(size_type nbytes)
+    {
+        size_type sizeClass = ClassFor(nbytes + sizeof(BlockHdr));
+        if (sizeClass >= kNumClasses) {
+            return nullptr;
+        }
+
+        BlockHdr* block = Pop(sizeClass);
+        if (!block) {
+            block = Carve(sizeClass);
+        }
+        if (!block) {
+            // bump area exhausted - accept a block from one of the next larger classes
+            for (size_type c = sizeClass + 1; c < std::min(kNumClasses, sizeClass + 1 + kMaxFallbackClasses) && !block; ++c) {
+                block = Pop(c);
+            }
+        }
+        if (!block) {
+            return nullptr;
+        }
+
+        block->fBackOffset = 0;
+        return UserPtr(block);
+    }
+
+    void* allocate_aligned(size_type nbytes, size_type alignment)
+    {
+        if (alignment <= Alignment) {
+            return allocate(nbytes);
+        }
+        char* raw = static_cast<char*>(allocate(nbytes + alignment));
+        if (!raw) {
+            return nullptr;
+        }
+        // raw is Alignment-aligned, so the distance to the aligned address is a multiple of Alignment
+        char* aligned = raw + (alignment - (reinterpret_cast<uintptr_t>(raw) % alignment)) % alignment;
+        if (aligned != raw) {
+            BlockHdr* block = reinterpret_cast<BlockHdr*>(raw) - 1;
+            BlockHdr* alignedHdr = reinterpret_cast<BlockHdr*>(aligned) - 1;
+            alignedHdr->fSizeClass = block->fSizeClass;
+            alignedHdr->fBackOffset = static_cast<uint32_t>((aligned - raw) / Alignment);
+        }
+        return aligned;
+    }
+
+    void deallocate(void* addr)
+    {
+        if (!addr) {
+            return;
+        }
+        Push(BlockFromUserPtr(addr));
+    }
+
+    void allocate_many(size_type elemBytes, size_type numElements, multiallocation_chain& chain)
+    {
+        multiallocation_chain allocated;
+        for (size_type i = 0; i < numElements; ++i) {
+            void* ptr = allocate(elemBytes);
+            if (!ptr) {
+                deallocate_many(allocated);
+                return;
+            }
+            allocated.push_back(ptr);
+        }
+        while (!allocated.empty()) {
+            chain.push_back(allocated.pop_front());
+        }
+    }
+
+    void allocate_many(const size_type* elemSizes, size_type numElements, size_type sizeofElement, multiallocation_chain& chain)
+    {
+        multiallocation_chain allocated;
+        for (size_type i = 0; i < numElements; ++i) {
+            void* ptr = allocate(elemSizes[i] * sizeofElement);
+            if (!ptr) {
+                deallocate_many(allocated);
+                return;
+            }
+            allocated.push_back(ptr);
+        }
+        while (!allocated.empty()) {
+            chain.push_back(allocated.pop_front());
+        }
+    }
+
+    void deallocate_many(multiallocation_chain& chain)
+    {
+        while (!chain.empty()) {
+            deallocate(boost::interprocess::ipcdetail::to_raw_pointer(chain.pop_front()));
+        }
+    }
+
+    size_type get_size() const { return fSize; }
+    size_type get_free_memory() const
+    {
+        size_type bumpOffset = fBumpOffset.load(std::memory_order_relaxed);
+        return (fSize > bumpOffset ? fSize - bumpOffset : 0) + fFreeListBytes.load(std::memory_order_relaxed);
+    }
+
+    // largest user buffer an allocation could currently get: the rest of the bump area or a block of the largest non-empty free list
+    size_type get_largest_free_block() const
+    {
+        size_type bumpOffset = fBumpOffset.load(std::memory_order_relaxed);
+        size_type largest = fSize > bumpOffset + sizeof(BlockHdr) ? fSize - bumpOffset - sizeof(BlockHdr) : 0;
+        for (size_type c = kNumClasses; c-- > 0;) {
+            if ((fFreeLists[c].load(std::memory_order_relaxed) & kOffsetMask) != 0) {
+                return std::max(largest, ClassBlockSize(c) - sizeof(BlockHdr));
+            }
+        }
+        return largest;
+    }
+
+    // usable size of the user buffer
+    size_type size(const void* ptr) const
+    {
+        const BlockHdr* hdr = static_cast<const BlockHdr*>(ptr) - 1;
+        return ClassBlockSize(hdr->fSizeClass) - sizeof(BlockHdr) - hdr->fBackOffset * Alignment;
+    }
+
+    // zeroes the never carved part of the segment and the user buffers of the blocks in the free lists.
+    // should only be called while the segment is not used by others.
+    void zero_free_memory()
+    {
+        size_type bumpOffset = fBumpOffset.load();
+        if (fSize > bumpOffset) {
+            std::memset(Base() + bumpOffset, 0, fSize - bumpOffset);
+        }
+        for (size_type c = 0; c < kNumClasses; ++c) {
+            uint64_t offset = fFreeLists[c].load() & kOffsetMask;
+            while (offset != 0) {
+                BlockHdr* block = BlockAt(offset);
+                std::memset(UserPtr(block), 0, ClassBlockSize(c) - sizeof(BlockHdr));
+                offset = block->fNext.load() & kOffsetMask;
+            }
+        }
+    }
+
+    void grow(size_type extraSize) { fSize += extraSize; }
+    void shrink_to_fit() {}
+
+    bool all_memory_deallocated()
+    {
+        return fFreeListBytes.load() == fBumpOffset.load() - fFirstBlockOffset;
+    }
+
+    bool check_sanity() { return fBumpOffset.load() <= fSize; }
+
+    template<class T>
+    T* allocation_command(boost::interprocess::allocation_type command, size_type limitSize, size_type& preferInRecvdOutSize, T*& reuse)
+    {
+        void* rawReuse = reuse;
+        void* ret = raw_allocation_command(command, limitSize, preferInRecvdOutSize, rawReuse, sizeof(T));
+        reuse = static_cast<T*>(rawReuse);
+        return static_cast<T*>(ret);
+    }
+
+    void* raw_allocation_command(boost::interprocess::allocation_type command, size_type limitObjects, size_type& preferInRecvdOutObjects, void*& reusePtr, size_type sizeofObject = 1)
+    {
+        using namespace boost::interprocess;
+
+        if (sizeofObject == 0) {
+            return nullptr;
+        }
+
+        if (reusePtr && (command & (expand_fwd | expand_bwd | shrink_in_place))) {
+            size_type available = size(reusePtr) / sizeofObject;
+            if (command & shrink_in_place) {
+                // blocks have a fixed size, the buffer can only be kept as is if it already fits into the limit
+                if (available <= limitObjects) {
+                    preferInRecvdOutObjects = available;
+                    return reusePtr;
+                }
+                return nullptr;
+            }
+            if (available >= limitObjects) {
+                preferInRecvdOutObjects = available;
+                return reusePtr;
+            }
+        }
+
+        if (command & allocate_new) {
+            reusePtr = nullptr;
+            size_type objects = std::max(preferInRecvdOutObjects, limitObjects);
+            void* ret = allocate(objects * sizeofObject);
+            if (!ret && objects != limitObjects) {
+                objects = limitObjects;
+                ret = allocate(objects * sizeofObject);
+            }
+            if (ret) {
+                preferInRecvdOutObjects = size(ret) / sizeofObject;
+            }
+            return ret;
+        }
+
+        return nullptr;
+    }
+
+  private:
+    char* Base() { return reinterpret_cast<char*>(this); }
+    const char* Base() const { return reinterpret_cast<const char*>(this); }
+
+    static size_type FirstBlockOffset(const void* thisPtr, size_type extraHdrBytes)
+    {
+        uintptr_t start = reinterpret_cast<uintptr_t>(thisPtr) + sizeof(SlabFitAlgorithm) + extraHdrBytes;
+        uintptr_t aligned = (start + Alignment - 1) / Alignment * Alignment;
+        return aligned - reinterpret_cast<uintptr_t>(thisPtr);
+    }
+
+    static size_type ClassBlockSize(size_type sizeClass)
+    {
+        size_type shift = kMinShift + sizeClass / kStepsPerShift;
+        size_type step = sizeClass % kStepsPerShift;
+        return (size_type(1) << shift) + step * (size_type(1) << (shift - 2));
+    }
+
+    // smallest class with a block size >= size
+    static size_type ClassFor(size_type size)
+    {
+        if (size <= (size_type(1) << kMinShift)) {
+            return 0;
+        }
+        size_type shift = 63 - __builtin_clzll(size - 1); // 2^shift <= size - 1 < 2^(shift + 1)
+        if (shift >= kMaxShift) {
+            return kNumClasses;
+        }
+        size_type stepSize = size_type(1) << (shift - 2);
+        size_type step = (size - (size_type(1) << shift) + stepSize - 1) / stepSize;
+        return (shift - kMinShift) * kStepsPerShift + step; // step == kStepsPerShift rolls over to the next power of two
+    }
+
+    BlockHdr* BlockAt(uint64_t offset) { return reinterpret_cast<BlockHdr*>(Base() + offset * Alignment); }
+    uint64_t OffsetOf(const BlockHdr* block) const { return (reinterpret_cast<const char*>(block) - Base()) / Alignment; }
+
+    static char* UserPtr(BlockHdr* block) { return reinterpret_cast<char*>(block + 1); }
+
+    static BlockHdr* BlockFromUserPtr(void* ptr)
+    {
+        BlockHdr* hdr = static_cast<BlockHdr*>(ptr) - 1;
+        return reinterpret_cast<BlockHdr*>(reinterpret_cast<char*>(hdr) - hdr->fBackOffset * Alignment);
+    }
+
+    BlockHdr* Carve(size_type sizeClass)
+    {
+        size_type blockSize = ClassBlockSize(sizeClass);
+        size_type offset = fBumpOffset.load(std::memory_order_relaxed);
+        do {
+            if (offset + blockSize > fSize) {
+                return nullptr;
+            }
+        } while (!fBumpOffset.compare_exchange_weak(offset, offset + blockSize, std::memory_order_relaxed));
+
+        BlockHdr* block = reinterpret_cast<BlockHdr*>(Base() + offset);
+        block->fSizeClass = static_cast<uint32_t>(sizeClass);
+        new (&block->fNext) std::atomic<uint64_t>(0);
+        return block;
+    }
+
+    BlockHdr* Pop(size_type sizeClass)
+    {
+        std::atomic<uint64_t>& head = fFreeLists[sizeClass];
+        uint64_t current = head.load(std::memory_order_acquire);
+        while (true) {
+            uint64_t offset = current & kOffsetMask;
+            if (offset == 0) {
+                return nullptr;
+            }
+            BlockHdr* block = BlockAt(offset);
+            // the block might be popped concurrently, in which case the tag has changed and the exchange fails
+            uint64_t next = block->fNext.load(std::memory_order_relaxed) & kOffsetMask;
+            uint64_t tag = (current >> kOffsetBits) + 1;
+            if (head.compare_exchange_weak(current, (tag << kOffsetBits) | next, std::memory_order_acquire, std::memory_order_acquire)) {
+                fFreeListBytes.fetch_sub(ClassBlockSize(sizeClass), std::memory_order_relaxed);
+                return block;
+            }
+        }
+    }
+
+    void Push(BlockHdr* block)
+    {
+        size_type sizeClass = block->fSizeClass;
+        std::atomic<uint64_t>& head = fFreeLists[sizeClass];
+        uint64_t offset = OffsetOf(block);
+        fFreeListBytes.fetch_add(ClassBlockSize(sizeClass), std::memory_order_relaxed);
+        uint64_t current = head.load(std::memory_order_relaxed);
+        do {
+            block->fNext.store(current & kOffsetMask, std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(current, ((((current >> kOffsetBits) + 1) << kOffsetBits) | offset), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    size_type fSize;
+    size_type fExtraHdrBytes;
+    size_type fFirstBlockOffset;
+    std::atomic<size_type> fBumpOffset;
+    std::atomic<size_type> fFreeListBytes;
+    std::atomic<uint64_t> fFreeLists[kNumClasses];
+};
+
+} // namespace fair::mq::shmem
+
+#endif /* FAIR_MQ_SHMEM_SLABFIT_H_ */
@@ -9,11 +9,17 @@
 #define FAIR_MQ_SHMEM_SOCKET_H_
 
 #include "Common.h"
+#include "LazyParts.h"
 #include "Manager.h"
 #include "Message.h"
+#include "Ring.h"
+#include <fairmq/BatchController.h>
 #include <fairmq/Error.h>
 #include <fairmq/Message.h>
+#include <fairmq/MessageArena.h>
 #include <fairmq/Socket.h>
+#include <fairmq/tools/Log.h>
+#include <fairmq/tools/Network.h>
 #include <fairmq/tools/Strings.h>
 #include <fairmq/zeromq/Common.h>
 
@@ -21,8 +27,15 @@
 
 #include <zmq.h>
 
+#include <algorithm> // min
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory> // make_unique
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace fair::mq {
     class TransportFactory;
@@ -42,6 +55,14 @@ struct ZMsg
     ZMsg& operator=(const ZMsg&) = delete;
     ZMsg& operator=(ZMsg&&) = delete;
 
+    void Rebuild(size_t size)
+    {
+        int rc __attribute__((unused)) = zmq_msg_close(&fMsg);
+        assert(rc == 0);
+        rc = zmq_msg_init_size(&fMsg, size);
+        assert(rc == 0);
+    }
+
     void* Data() { return zmq_msg_data(&fMsg); }
     size_t Size() { return zmq_msg_size(&fMsg); }
     zmq_msg_t* Msg() { return &fMsg; }
@@ -64,15 +85,29 @@ class Socket final : public fair::mq::Socket
         , fMessagesRx(0)
         , fTimeout(100)
         , fConnectedPeersCount(0)
+        , fMetaRingSend(manager.MetaRingEnabled() && (type == "push" || type == "pair"))
+        , fMetaRingRecv(manager.MetaRingEnabled() && (type == "pull" || type == "pair"))
+        , fNextSendRing(0)
+        , fNextRecvRing(0)
+        , fRcvMode(RcvMode::block)
+        , fRcvSpinUs(0)
+        , fRcvSpinTime(0)
+        , fSndBatchAllowed(type == "push")
+        , fSndBatchSize(1)
+        , fSndBatchLimit(1)
+        , fSndBatchTimeoutUs(0)
+        , fSndBatchStop(false)
+        , fCompactMeta(false)
+        , fTrace(false)
+        , fOwnerChannel(ChunkOwnerTable::kNoName)
+        , fOwnerChannelRegistered(false)
+        , fPublisher(type == "pub")
     {
         assert(context);
 
-        if (type == "sub" || type == "pub") {
-            LOG(error) << "PUB/SUB socket type is not supported for shared memory transport";
-            throw SocketError("PUB/SUB socket type is not supported for shared memory transport");
-        }
-
-        fSocket = zmq_socket(context, zmq::getConstant(type));
+        // PUB/SUB is done with ROUTER/DEALER sockets, so that the publisher knows the subscribers (see Publish())
+        int zmqType = type == "pub" ? ZMQ_ROUTER : (type == "sub" ? ZMQ_DEALER : zmq::getConstant(type));
+        fSocket = zmq_socket(context, zmqType);
         fMonitorSocket = zmq::makeMonitorSocket(context, fSocket, fId);
 
         if (fSocket == nullptr) {
@@ -80,9 +115,23 @@ class Socket final : public fair::mq::Socket
             throw SocketError(tools::ToString("Failed creating socket ", fId, ", reason: ", zmq_strerror(errno)));
         }
 
-        if (zmq_setsockopt(fSocket, ZMQ_IDENTITY, fId.c_str(), fId.length()) != 0) {
+        if (type == "sub") {
+            // every new connection announces the subscriber to the publisher with an empty message,
+            // the publisher identifies it by the identity it assigns to the connection
+            int probe = 1;
+            if (zmq_setsockopt(fSocket, ZMQ_PROBE_ROUTER, &probe, sizeof(probe)) != 0) {
+                LOG(error) << "Failed setting ZMQ_PROBE_ROUTER socket option, reason: " << zmq_strerror(errno);
+            }
+        } else if (zmq_setsockopt(fSocket, ZMQ_IDENTITY, fId.c_str(), fId.length()) != 0) {
             LOG(error) << "Failed setting ZMQ_IDENTITY socket option, reason: " << zmq_strerror(errno);
         }
+        if (fPublisher) {
+            // report subscribers that are gone (EHOSTUNREACH) instead of dropping silently
+            int mandatory = 1;
+            if (zmq_setsockopt(fSocket, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof(mandatory)) != 0) {
+                LOG(error) << "Failed setting ZMQ_ROUTER_MANDATORY socket option, reason: " << zmq_strerror(errno);
+            }
+        }
 
         // Tell socket to try and send/receive outstanding messages for <linger> milliseconds before terminating.
         // Default value for ZeroMQ is -1, which is to wait forever.
@@ -99,13 +148,13 @@ class Socket final : public fair::mq::Socket
             LOG(error) << "Failed setting ZMQ_RCVTIMEO socket option, reason: " << zmq_strerror(errno);
         }
 
-        // if (type == "sub")
-        // {
-        //     if (zmq_setsockopt(fSocket, ZMQ_SUBSCRIBE, nullptr, 0) != 0)
-        //     {
-        //         LOG(error) << "Failed setting ZMQ_SUBSCRIBE socket option, reason: " << zmq_strerror(errno);
-        //     }
-        // }
+        if (type == "pull") {
+            // large enough for a frame of a batching sender
+            // large enough for a frame of a batching sender, or a message with an inline payload
+            fRcvFrame.resize(std::max(sizeof(MetaBatchHeader) + kMaxSndBatch * sizeof(MetaHeader), CompactMetaMaxSize(1, kMaxInlineSize)));
+        } else if (type != "push") {
+            fRcvFrame.resize(std::max(sizeof(MetaHeader), CompactMetaMaxSize(1, kMaxInlineSize)));
+        }
         LOG(debug) << "Created socket " << GetId();
     }
 
@@ -118,12 +167,25 @@ class Socket final : public fair::mq::Socket
 
     bool Bind(const std::string& address) override
     {
-        return zmq::Bind(fSocket, address, fId);
+        if (!zmq::Bind(fSocket, address, fId)) {
+            return false;
+        }
+        // the meta rings are keyed by the port, which the peers know only after a wildcard bind resolved it
+        AttachMetaRings(address.back() == '*' ? GetBoundAddress() : address, true);
+        fManager.Premap();
+        return true;
     }
 
+    std::string GetBoundAddress() const override { return zmq::GetLastEndpoint(fSocket); }
+
     bool Connect(const std::string& address) override
     {
-        return zmq::Connect(fSocket, address, fId);
+        if (!zmq::Connect(fSocket, address, fId)) {
+            return false;
+        }
+        AttachMetaRings(address, false);
+        fManager.Premap();
+        return true;
     }
 
     int64_t Send(mq::MessagePtr& msg, int timeout = -1) override
@@ -134,15 +196,43 @@ class Socket final : public fair::mq::Socket
         }
         assertm(dynamic_cast<shmem::Message*>(msgPtr), "given mq::Message is a shmem::Message");   // NOLINT
         auto shmMsg = static_cast<shmem::Message*>(msgPtr);   // NOLINT(cppcoreguidelines-pro-type-static-cast-downcast)
+        if (fPublisher) {
+            return Publish(&shmMsg, 1);
+        }
+        if (!fSendRings.empty() || fSndBatchSize > 1) {
+            shmMsg->Materialize();
+        }
+        HandOver(shmMsg->fMeta);
 
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
+        if (!fSendRings.empty()) {
+            int64_t rc = SendToMetaRing(&(shmMsg->fMeta), 1, timeout);
+            if (rc < 0) {
+                return rc;
+            }
+            shmMsg->fQueued = true;
+            ++fMessagesTx;
+            size_t size = msg->GetSize();
+            fBytesTx += size;
+            return size;
         }
-        int elapsed = 0;
+
+        if (fSndBatchSize > 1) {
+            return SendBatched(shmMsg, timeout);
+        }
+
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+
+        // the trace context and inline payloads travel in the compact format
+        const TraceContext* trace = (fTrace && msg->GetTraceContext()) ? &msg->GetTraceContext() : nullptr;
+        const char* payload = shmMsg->InlineData();
+        const bool compact = fCompactMeta || trace || payload;
+        char compactFrame[CompactMetaMaxSize(1, kMaxInlineSize)];
+        size_t compactSize = compact ? EncodeCompactMeta(&(shmMsg->fMeta), 1, compactFrame, trace, &payload) : 0;
 
         while (true) {
-            int nbytes = zmq_send(fSocket, &(shmMsg->fMeta), sizeof(MetaHeader), flags);
+            int nbytes = compact ? zmq_send(fSocket, compactFrame, compactSize, flags)
+                                 : zmq_send(fSocket, &(shmMsg->fMeta), sizeof(MetaHeader), flags);
             if (nbytes > 0) {
                 shmMsg->fQueued = true;
                 ++fMessagesTx;
@@ -152,7 +242,7 @@ class Socket final : public fair::mq::Socket
             } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                 if (fManager.Interrupted()) {
                     return static_cast<int>(TransferCode::interrupted);
-                } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                } else if (wait.Retry()) {
                     continue;
                 } else {
                     return static_cast<int>(TransferCode::timeout);
@@ -167,23 +257,67 @@ class Socket final : public fair::mq::Socket
 
     int64_t Receive(MessagePtr& msg, int timeout = -1) override
     {
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
+        if (fPublisher) {
+            return NotReceiving();
+        }
+        if (!fRcvBatch.empty()) {
+            Message* shmMsg = static_cast<Message*>(msg.get());
+            shmMsg->fMeta = fRcvBatch.front();
+            fRcvBatch.pop_front();
+            fManager.Own(shmMsg->fMeta);
+            size_t size = shmMsg->GetSize();
+            fBytesRx += size;
+            ++fMessagesRx;
+            return size;
+        }
+
+        if (fRcvMode != RcvMode::block && timeout != 0) {
+            int64_t rc = 0;
+            if (SpinReceive([&]() { return Receive(msg, 0); }, timeout, rc)) {
+                return rc;
+            }
         }
-        int elapsed = 0;
+
+        if (!fRecvRings.empty()) {
+            int64_t rc = ReceiveFromMetaRing(timeout);
+            if (rc < 0) {
+                return rc;
+            }
+            if (fRingMetas.size() != 1) {
+                throw SocketError(
+                    tools::ToString("Received message is not a valid FairMQ shared memory message. ",
+                        "Possibly due to a misconfigured transport on the sender side. ",
+                        "Expected a single part, received ", fRingMetas.size()));
+            }
+            Message* shmMsg = static_cast<Message*>(msg.get());
+            shmMsg->fMeta = fRingMetas.front();
+            fManager.Own(shmMsg->fMeta);
+            size_t size = shmMsg->GetSize();
+            fBytesRx += size;
+            ++fMessagesRx;
+            return size;
+        }
+
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
 
         while (true) {
             Message* shmMsg = static_cast<Message*>(msg.get());
-            int nbytes = zmq_recv(fSocket, &(shmMsg->fMeta), sizeof(MetaHeader), flags);
+            int nbytes = zmq_recv(fSocket, fRcvFrame.data(), fRcvFrame.size(), flags);
             if (nbytes > 0) {
-                // check for number of received messages. must be 1
-                if (nbytes != sizeof(MetaHeader)) {
+                // check for number of received messages. must be 1 (or a batch)
+                if (static_cast<size_t>(nbytes) > fRcvFrame.size() || !UnpackFrame(fRcvFrame.data(), nbytes, shmMsg->fMeta)) {
                     throw SocketError(
                         tools::ToString("Received message is not a valid FairMQ shared memory message. ",
                             "Possibly due to a misconfigured transport on the sender side. ",
                             "Expected size of ", sizeof(MetaHeader), " bytes, received ", nbytes));
                 }
+                if (IsInline(shmMsg->fMeta)) {
+                    CopyInline(*shmMsg, fRcvFrame.data());
+                } else {
+                    fManager.Own(shmMsg->fMeta);
+                }
+                shmMsg->SetTraceContext(fRcvTrace);
 
                 size_t size = shmMsg->GetSize();
                 fBytesRx += size;
@@ -192,7 +326,7 @@ class Socket final : public fair::mq::Socket
             } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                 if (fManager.Interrupted()) {
                     return static_cast<int>(TransferCode::interrupted);
-                } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                } else if (wait.Retry()) {
                     continue;
                 } else {
                     return static_cast<int>(TransferCode::timeout);
@@ -205,11 +339,58 @@ class Socket final : public fair::mq::Socket
 
     int64_t Send(std::vector<MessagePtr>& msgVec, int timeout = -1) override
     {
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
+        if (fPublisher) {
+            std::vector<Message*> msgs;
+            msgs.reserve(msgVec.size());
+            for (auto& msg : msgVec) {
+                if (!msg) {
+                    return static_cast<int>(TransferCode::error);
+                }
+                assertm(dynamic_cast<shmem::Message*>(msg.get()), "given mq::Message is a shmem::Message");   // NOLINT
+                msgs.push_back(static_cast<Message*>(msg.get()));   // NOLINT(cppcoreguidelines-pro-type-static-cast-downcast)
+            }
+            return Publish(msgs.data(), msgs.size());
+        }
+
+        std::unique_lock<std::mutex> batchLock(fSndBatchMtx, std::defer_lock);
+        if (fSndBatchSize > 1 && fSendRings.empty()) {
+            // keep the order: pending batched messages go first
+            batchLock.lock();
+            int64_t rc = FlushSndBatch(timeout);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+
+        if (!fSendRings.empty()) {
+            fRingMetas.clear();
+            for (auto& msg : msgVec) {
+                auto msgPtr = msg.get();
+                if (!msgPtr) {
+                    return static_cast<int>(TransferCode::error);
+                }
+                assertm(dynamic_cast<shmem::Message*>(msgPtr), "given mq::Message is a shmem::Message");   // NOLINT
+                static_cast<shmem::Message*>(msgPtr)->Materialize();   // NOLINT(cppcoreguidelines-pro-type-static-cast-downcast)
+                fRingMetas.push_back(static_cast<shmem::Message*>(msgPtr)->fMeta);   // NOLINT(cppcoreguidelines-pro-type-static-cast-downcast)
+                HandOver(fRingMetas.back());
+            }
+            int64_t rc = SendToMetaRing(fRingMetas.data(), fRingMetas.size(), timeout);
+            if (rc < 0) {
+                return rc;
+            }
+            int64_t totalSize = 0;
+            for (auto& msg : msgVec) {
+                Message* shmMsg = static_cast<Message*>(msg.get());
+                shmMsg->fQueued = true;
+                totalSize += shmMsg->fMeta.fSize;
+            }
+            fMessagesTx++;
+            fBytesTx += totalSize;
+            return totalSize;
         }
-        int elapsed = 0;
+
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
 
         // put it into zmq message
         const unsigned int vecSize = msgVec.size();
@@ -217,6 +398,8 @@ class Socket final : public fair::mq::Socket
 
         // prepare the message with shm metas
         MetaHeader* metas = static_cast<MetaHeader*>(zmqMsg.Data());
+        fInlinePayloads.clear();
+        size_t inlineBytes = 0;
 
         for (auto& msg : msgVec) {
             auto msgPtr = msg.get();
@@ -226,13 +409,25 @@ class Socket final : public fair::mq::Socket
             assertm(dynamic_cast<shmem::Message*>(msgPtr), "given mq::Message is a shmem::Message");   // NOLINT
             auto shmMsg = static_cast<shmem::Message*>(msgPtr);   // NOLINT(cppcoreguidelines-pro-type-static-cast-downcast)
             std::memcpy(metas++, &(shmMsg->fMeta), sizeof(MetaHeader));
+            HandOver(shmMsg->fMeta);
+            fInlinePayloads.push_back(shmMsg->InlineData());
+            inlineBytes += fInlinePayloads.back() ? shmMsg->fMeta.fSize : 0;
         }
 
+        const TraceContext* trace = (fTrace && vecSize > 0 && msgVec.front()->GetTraceContext()) ? &msgVec.front()->GetTraceContext() : nullptr;
+        if (fCompactMeta || trace || inlineBytes > 0) {
+            fCompactFrame.resize(CompactMetaMaxSize(vecSize, inlineBytes));
+            size_t len = EncodeCompactMeta(static_cast<const MetaHeader*>(zmqMsg.Data()), vecSize, fCompactFrame.data(), trace, fInlinePayloads.data());
+            zmqMsg.Rebuild(len);
+            std::memcpy(zmqMsg.Data(), fCompactFrame.data(), len);
+        }
+        const size_t frameSize = zmqMsg.Size();
+
         while (true) {
             int64_t totalSize = 0;
             int nbytes = zmq_msg_send(zmqMsg.Msg(), fSocket, flags);
             if (nbytes > 0) {
-                assert(static_cast<unsigned int>(nbytes) == (vecSize * sizeof(MetaHeader))); // all or nothing
+                assert(static_cast<size_t>(nbytes) == frameSize); // all or nothing
 
                 for (auto& msg : msgVec) {
                     Message* shmMsg = static_cast<Message*>(msg.get());
@@ -248,7 +443,7 @@ class Socket final : public fair::mq::Socket
             } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                 if (fManager.Interrupted()) {
                     return static_cast<int>(TransferCode::interrupted);
-                } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                } else if (wait.Retry()) {
                     continue;
                 } else {
                     return static_cast<int>(TransferCode::timeout);
@@ -261,13 +456,67 @@ class Socket final : public fair::mq::Socket
         return static_cast<int>(TransferCode::error);
     }
 
+    bool Forward(fair::mq::Socket& out, int timeout, int64_t& result) override
+    {
+        auto& shmOut = static_cast<Socket&>(out);
+        // the meta data frames are moved as they are, so both sockets have to use the zeromq socket for them
+        // (no meta rings, no messages held back in a send or receive batch, not publishing) and refer to the same segments
+        if (&shmOut.fManager != &fManager || !fRecvRings.empty() || !fRcvBatch.empty() || !shmOut.fSendRings.empty() || shmOut.fSndBatchSize > 1 || shmOut.fPublisher) {
+            return false;
+        }
+        result = zmq::ForwardFrames(fSocket, shmOut.fSocket, fTimeout, timeout, fId,
+                                    [this](const void* data, size_t size) { return PayloadSize(static_cast<const char*>(data), size); },
+                                    [this]() { return fManager.Interrupted(); });
+        if (result >= 0) {
+            ++fMessagesRx;
+            fBytesRx += result;
+            ++shmOut.fMessagesTx;
+            shmOut.fBytesTx += result;
+        }
+        return true;
+    }
+
     int64_t Receive(std::vector<MessagePtr>& msgVec, int timeout = -1) override
     {
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
+        if (fPublisher) {
+            return NotReceiving();
+        }
+        if (!fRcvBatch.empty()) {
+            // a message of a batch is delivered as a single part
+            msgVec.emplace_back(std::make_unique<Message>(fManager, fRcvBatch.front(), GetTransport()));
+            fRcvBatch.pop_front();
+            int64_t size = msgVec.back()->GetSize();
+            fMessagesRx++;
+            fBytesRx += size;
+            return size;
         }
-        int elapsed = 0;
+
+        if (fRcvMode != RcvMode::block && timeout != 0) {
+            int64_t rc = 0;
+            if (SpinReceive([&]() { return Receive(msgVec, 0); }, timeout, rc)) {
+                return rc;
+            }
+        }
+
+        if (!fRecvRings.empty()) {
+            int64_t rc = ReceiveFromMetaRing(timeout);
+            if (rc < 0) {
+                return rc;
+            }
+            int64_t totalSize = 0;
+            msgVec.reserve(msgVec.size() + fRingMetas.size());
+            MessageArena arena(fRingMetas.size(), sizeof(Message));
+            for (auto& meta : fRingMetas) {
+                msgVec.emplace_back(NewMessage(arena, meta));
+                totalSize += msgVec.back()->GetSize();
+            }
+            fMessagesRx++;
+            fBytesRx += totalSize;
+            return totalSize;
+        }
+
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
 
         ZMsg zmqMsg;
 
@@ -279,7 +528,38 @@ class Socket final : public fair::mq::Socket
                 const auto hdrVecSize = zmqMsg.Size();
 
                 assert(hdrVecSize > 0);
+                if (hdrVecSize % sizeof(MetaHeader) == sizeof(MetaBatchHeader)) {
+                    MetaHeader first;
+                    if (UnpackFrame(static_cast<const char*>(zmqMsg.Data()), hdrVecSize, first)) {
+                        msgVec.emplace_back(std::make_unique<Message>(fManager, first, GetTransport()));
+                        if (IsInline(first)) {
+                            CopyInline(static_cast<Message&>(*msgVec.back()), static_cast<const char*>(zmqMsg.Data()));
+                        }
+                        msgVec.back()->SetTraceContext(fRcvTrace);
+                        totalSize = msgVec.back()->GetSize();
+                        fMessagesRx++;
+                        fBytesRx += totalSize;
+                        return totalSize;
+                    }
+                }
                 if (hdrVecSize % sizeof(MetaHeader) != 0) {
+                    fCompactMetas.clear();
+                    TraceContext trace;
+                    if (DecodeCompactMeta(static_cast<const char*>(zmqMsg.Data()), hdrVecSize, fCompactMetas, &trace)) {
+                        msgVec.reserve(msgVec.size() + fCompactMetas.size());
+                        MessageArena arena(fCompactMetas.size(), sizeof(Message));
+                        for (auto& meta : fCompactMetas) {
+                            msgVec.emplace_back(NewMessage(arena, meta));
+                            if (IsInline(meta)) {
+                                CopyInline(static_cast<Message&>(*msgVec.back()), static_cast<const char*>(zmqMsg.Data()));
+                            }
+                            msgVec.back()->SetTraceContext(trace);
+                            totalSize += msgVec.back()->GetSize();
+                        }
+                        fMessagesRx++;
+                        fBytesRx += totalSize;
+                        return totalSize;
+                    }
                     throw SocketError(
                         tools::ToString("Received message is not a valid FairMQ shared memory message. ",
                             "Possibly due to a misconfigured transport on the sender side. ",
@@ -287,11 +567,12 @@ class Socket final : public fair::mq::Socket
                 }
 
                 const auto numMessages = hdrVecSize / sizeof(MetaHeader);
-                msgVec.reserve(numMessages);
+                msgVec.reserve(msgVec.size() + numMessages);
+                MessageArena arena(numMessages, sizeof(Message));
 
                 for (size_t m = 0; m < numMessages; m++) {
                     // create new message (part)
-                    msgVec.emplace_back(std::make_unique<Message>(fManager, hdrVec[m], GetTransport()));
+                    msgVec.emplace_back(NewMessage(arena, hdrVec[m]));
                     Message* shmMsg = static_cast<Message*>(msgVec.back().get());
                     totalSize += shmMsg->GetSize();
                 }
@@ -304,7 +585,7 @@ class Socket final : public fair::mq::Socket
             } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                 if (fManager.Interrupted()) {
                     return static_cast<int>(TransferCode::interrupted);
-                } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                } else if (wait.Retry()) {
                     continue;
                 } else {
                     return static_cast<int>(TransferCode::timeout);
@@ -317,18 +598,220 @@ class Socket final : public fair::mq::Socket
         return static_cast<int>(TransferCode::error);
     }
 
+    /// Receive a multipart message as a view over its meta data (see LazyParts), message objects are created on first
+    /// access. Messages from meta header rings and send batches, and inline payloads, are materialized right away.
+    /// Parts of a previous message still in the view are released first. Return values as Receive()
+    int64_t ReceiveLazy(LazyParts& parts, int timeout = -1)
+    {
+        parts.Clear();
+        if (fPublisher) {
+            return NotReceiving();
+        }
+        if (!fRcvBatch.empty() || !fRecvRings.empty()) {
+            std::vector<MessagePtr> msgs;
+            int64_t rc = Receive(msgs, timeout);
+            if (rc >= 0) {
+                parts.Init(fManager, GetTransport(), msgs.size());
+                for (size_t i = 0; i < msgs.size(); ++i) {
+                    parts.fMetas.push_back(static_cast<Message*>(msgs[i].get())->fMeta);
+                    parts.fMessages[i] = std::move(msgs[i]);
+                }
+            }
+            return rc;
+        }
+
+        if (fRcvMode != RcvMode::block && timeout != 0) {
+            int64_t rc = 0;
+            if (SpinReceive([&]() { return ReceiveLazy(parts, 0); }, timeout, rc)) {
+                return rc;
+            }
+        }
+
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
+
+        ZMsg zmqMsg;
+
+        while (true) {
+            int nbytes = zmq_msg_recv(zmqMsg.Msg(), fSocket, flags);
+            if (nbytes > 0) {
+                const char* frame = static_cast<const char*>(zmqMsg.Data());
+                const size_t size = zmqMsg.Size();
+                bool valid = true;
+                if (size % sizeof(MetaHeader) == 0) {
+                    parts.fMetas.resize(size / sizeof(MetaHeader));
+                    std::memcpy(parts.fMetas.data(), frame, size);
+                } else if (size % sizeof(MetaHeader) == sizeof(MetaBatchHeader) && UnpackFrame(frame, size, fLazyFirst)) {
+                    parts.fMetas.push_back(fLazyFirst);
+                    parts.fTrace = fRcvTrace;
+                } else {
+                    valid = DecodeCompactMeta(frame, size, parts.fMetas, &parts.fTrace);
+                }
+                if (!valid) {
+                    throw SocketError(
+                        tools::ToString("Received message is not a valid FairMQ shared memory message. ",
+                            "Possibly due to a misconfigured transport on the sender side. ",
+                            "Expected size of ", sizeof(MetaHeader), " bytes, received ", nbytes));
+                }
+
+                parts.Init(fManager, GetTransport(), parts.fMetas.size());
+                int64_t totalSize = 0;
+                for (size_t i = 0; i < parts.fMetas.size(); ++i) {
+                    MetaHeader& meta = parts.fMetas[i];
+                    if (IsInline(meta)) {
+                        // the payload is in the frame, which does not outlive this call
+                        parts.fMessages[i] = std::make_unique<Message>(fManager, meta, GetTransport());
+                        CopyInline(static_cast<Message&>(*parts.fMessages[i]), frame);
+                        parts.fMessages[i]->SetTraceContext(parts.fTrace);
+                        meta = static_cast<Message&>(*parts.fMessages[i]).fMeta;
+                    } else {
+                        fManager.Own(meta);
+                    }
+                    totalSize += meta.fSize;
+                }
+                fMessagesRx++;
+                fBytesRx += totalSize;
+                return totalSize;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fManager.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+    }
+
+    /// Send the parts that are still in the view as one multipart message. The meta data of the parts without a message
+    /// object is sent as received (no message objects are created, the buffers are not touched). The view is empty
+    /// afterwards if the send succeeds. Return values as Send()
+    int64_t Send(LazyParts& parts, int timeout = -1)
+    {
+        if (parts.fManager && parts.fManager != &fManager) {
+            throw SocketError(tools::ToString("Socket ", fId, " cannot send message parts of another shared memory session"));
+        }
+        if (fPublisher || !fSendRings.empty() || fSndBatchSize > 1) {
+            // these paths need message objects (references of subscribers, materialized inline payloads, batch order)
+            std::vector<MessagePtr> msgs;
+            parts.TakeAll(msgs);
+            int64_t rc = Send(msgs, timeout);
+            if (rc < 0) {
+                // the view keeps the parts for a retry
+                parts.Init(fManager, GetTransport(), msgs.size());
+                for (size_t i = 0; i < msgs.size(); ++i) {
+                    parts.fMetas.push_back(static_cast<Message*>(msgs[i].get())->fMeta);
+                    parts.fMessages[i] = std::move(msgs[i]);
+                }
+            }
+            return rc;
+        }
+
+        fLazyMetas.clear();
+        fInlinePayloads.clear();
+        size_t inlineBytes = 0;
+        int64_t totalSize = 0;
+        for (size_t i = 0; i < parts.fMetas.size(); ++i) {
+            if (parts.fTaken[i]) {
+                continue;
+            }
+            const Message* msg = static_cast<const Message*>(parts.fMessages[i].get());
+            fLazyMetas.push_back(msg ? msg->fMeta : parts.fMetas[i]);
+            fInlinePayloads.push_back(msg ? msg->InlineData() : nullptr);
+            inlineBytes += fInlinePayloads.back() ? fLazyMetas.back().fSize : 0;
+            totalSize += fLazyMetas.back().fSize;
+            HandOver(fLazyMetas.back());
+        }
+
+        const TraceContext* trace = (fTrace && parts.fTrace) ? &parts.fTrace : nullptr;
+        ZMsg zmqMsg;
+        if (fCompactMeta || trace || inlineBytes > 0) {
+            fCompactFrame.resize(CompactMetaMaxSize(fLazyMetas.size(), inlineBytes));
+            size_t len = EncodeCompactMeta(fLazyMetas.data(), fLazyMetas.size(), fCompactFrame.data(), trace, fInlinePayloads.data());
+            zmqMsg.Rebuild(len);
+            std::memcpy(zmqMsg.Data(), fCompactFrame.data(), len);
+        } else {
+            zmqMsg.Rebuild(fLazyMetas.size() * sizeof(MetaHeader));
+            std::memcpy(zmqMsg.Data(), fLazyMetas.data(), fLazyMetas.size() * sizeof(MetaHeader));
+        }
+
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+
+        while (true) {
+            int nbytes = zmq_msg_send(zmqMsg.Msg(), fSocket, flags);
+            if (nbytes > 0) {
+                // the references are passed on with the meta data
+                for (auto& msg : parts.fMessages) {
+                    if (msg) {
+                        static_cast<Message*>(msg.get())->fQueued = true;
+                    }
+                }
+                parts.Reset();
+                fMessagesTx++;
+                fBytesTx += totalSize;
+                return totalSize;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fManager.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+    }
+
     void* GetSocket() const { return fSocket; }
 
+    // whether messages of this socket travel through meta header rings instead of the zmq socket (--shm-meta-ring)
+    bool UsesMetaRings() const { return !fSendRings.empty() || !fRecvRings.empty(); }
+    bool MetaRingReadable() const
+    {
+        return std::any_of(fRecvRings.begin(), fRecvRings.end(), [](const MetaRing* r) { return !r->Empty(); });
+    }
+    bool MetaRingWritable() const
+    {
+        return std::any_of(fSendRings.begin(), fSendRings.end(), [](const MetaRing* r) { return r->HasSpace(); });
+    }
+
     void Close() override
     {
         // LOG(debug) << "Closing socket " << fId;
 
+        if (fSndBatchThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(fSndBatchMtx);
+                fSndBatchStop = true;
+            }
+            fSndBatchCV.notify_one();
+            fSndBatchThread.join();
+        }
+        if (fSocket) {
+            std::lock_guard<std::mutex> lock(fSndBatchMtx);
+            if (!fSndBatch.empty() && FlushSndBatch(GetLinger()) < 0) {
+                LOG(warn) << "Socket " << fId << ": dropping " << fSndBatch.size() << " batched message(s) that could not be sent before closing";
+                for (auto& meta : fSndBatch) {
+                    Message dropped(fManager, meta); // releases the buffer
+                }
+                fSndBatch.clear();
+            }
+        }
+
         if (fSocket && zmq_close(fSocket) != 0) {
             LOG(error) << "Failed closing data socket " << fId
                        << ", reason: " << zmq_strerror(errno);
         }
         fSocket = nullptr;
 
+        DetachMetaRings();
+
         if (fMonitorSocket && zmq_close(fMonitorSocket) != 0) {
             LOG(error) << "Failed closing monitor socket " << fId
                        << ", reason: " << zmq_strerror(errno);
@@ -359,6 +842,10 @@ class Socket final : public fair::mq::Socket
 
     int Events(uint32_t* events) override
     {
+        if (UsesMetaRings()) {
+            *events = (MetaRingReadable() ? ZMQ_POLLIN : 0) | (MetaRingWritable() ? ZMQ_POLLOUT : 0);
+            return 0;
+        }
         size_t eventsSize = sizeof(uint32_t);
         return zmq_getsockopt(fSocket, ZMQ_EVENTS, events, &eventsSize);
     }
@@ -412,6 +899,10 @@ class Socket final : public fair::mq::Socket
         if (zmq_setsockopt(fSocket, ZMQ_SNDBUF, &value, sizeof(value)) < 0) {
             throw SocketError(tools::ToString("failed getting ZMQ_SNDBUF, reason: ", zmq_strerror(errno)));
         }
+        // applies to new connections only, the established ones are resized directly
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = zmq::updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+        zmq::setConnectionKernelSize(fConnectionFds, SO_SNDBUF, value);
     }
 
     int GetSndKernelSize() const override
@@ -429,6 +920,10 @@ class Socket final : public fair::mq::Socket
         if (zmq_setsockopt(fSocket, ZMQ_RCVBUF, &value, sizeof(value)) < 0) {
             throw SocketError(tools::ToString("failed getting ZMQ_RCVBUF, reason: ", zmq_strerror(errno)));
         }
+        // applies to new connections only, the established ones are resized directly
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = zmq::updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+        zmq::setConnectionKernelSize(fConnectionFds, SO_RCVBUF, value);
     }
 
     int GetRcvKernelSize() const override
@@ -441,12 +936,124 @@ class Socket final : public fair::mq::Socket
         return value;
     }
 
+    void SetRcvMode(const std::string& mode, int spinUs) override
+    {
+        if (mode == "spin") {
+            fRcvMode = RcvMode::spin;
+        } else if (mode == "hybrid") {
+            fRcvMode = RcvMode::hybrid;
+        } else if (mode == "block") {
+            fRcvMode = RcvMode::block;
+        } else {
+            throw SocketError(tools::ToString("Invalid receive mode '", mode, "' for socket ", fId, ", valid are 'block', 'spin' and 'hybrid'"));
+        }
+        fRcvSpinUs = spinUs;
+    }
+
+    unsigned long GetRcvSpinTime() const override { return fRcvSpinTime; }
+
+    void SetMetaFormat(const std::string& format) override
+    {
+        if (format == "compact") {
+            fCompactMeta = true;
+        } else if (format == "default") {
+            fCompactMeta = false;
+        } else {
+            throw SocketError(tools::ToString("Invalid meta format '", format, "' for socket ", fId, ", must be 'default' or 'compact'"));
+        }
+        if (fCompactMeta && (fMetaRingSend || fSndBatchSize > 1)) {
+            LOG(debug) << fId << ": compact meta format applies only to messages sent via zmq, not to meta rings or send batches";
+        }
+    }
+
+    void SetTrace(bool enable) override
+    {
+        fTrace = enable;
+        if (fTrace && (fMetaRingSend || fSndBatchSize > 1)) {
+            LOG(debug) << fId << ": trace contexts are only transferred with messages sent via zmq, not with meta rings or send batches";
+        }
+    }
+
+    void SetSndBatch(int size, int timeoutUs) override
+    {
+        if (!fSndBatchAllowed) {
+            LOG(warn) << "Send batching is only supported for PUSH sockets, ignoring it for " << fId;
+            return;
+        }
+        if (size < 1 || size > static_cast<int>(kMaxSndBatch)) {
+            throw SocketError(tools::ToString("Invalid send batch size ", size, " for socket ", fId, ", must be between 1 and ", kMaxSndBatch));
+        }
+        {
+            std::lock_guard<std::mutex> lock(fSndBatchMtx);
+            fSndBatchSize = size;
+            fSndBatchLimit = size;
+            fSndBatchTimeoutUs = timeoutUs;
+        }
+        if (size > 1 && !fSndBatchThread.joinable()) {
+            fSndBatchThread = std::thread(&Socket::SndBatchFlusher, this);
+        }
+    }
+
+    void SetSndBatchLatencyTarget(int targetUs) override
+    {
+        if (!fSndBatchAllowed) {
+            LOG(warn) << "Send batching is only supported for PUSH sockets, ignoring the batch latency target for " << fId;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(fSndBatchMtx);
+            if (targetUs <= 0) {
+                fSndBatchController.reset();
+                fSndBatchLimit = fSndBatchSize;
+                return;
+            }
+            if (fSndBatchSize == 1) {
+                fSndBatchSize = kMaxSndBatch;
+            }
+            fSndBatchController = std::make_unique<BatchController>(targetUs, fSndBatchSize);
+            fSndBatchLimit = fSndBatchController->Size();
+            fSndBatchTimeoutUs = fSndBatchController->TimeoutUs();
+        }
+        if (!fSndBatchThread.joinable()) {
+            fSndBatchThread = std::thread(&Socket::SndBatchFlusher, this);
+        }
+    }
+
     unsigned long GetNumberOfConnectedPeers() const override
     {
-        fConnectedPeersCount = zmq::updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket);
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = zmq::updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
         return fConnectedPeersCount;
     }
 
+    int GetRttUs() const override
+    {
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = zmq::updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+        return zmq::connectionRttUs(fConnectionFds);
+    }
+
+    // counted in the meta header rings, otherwise estimated from the kernel queues of the connections (that carry the
+    // meta headers, not the payload)
+    int64_t GetQueueDepth(bool& exact) const override
+    {
+        if (UsesMetaRings()) {
+            exact = true;
+            size_t depth = 0;
+            for (const MetaRing* ring : fSendRings) {
+                depth += ring->NumRecords();
+            }
+            for (const MetaRing* ring : fRecvRings) {
+                depth += ring->NumRecords();
+            }
+            return static_cast<int64_t>(depth);
+        }
+        exact = false;
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = zmq::updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+        return static_cast<int64_t>((zmq::connectionQueuedBytes(fConnectionFds) + sizeof(MetaHeader) - 1) / sizeof(MetaHeader));
+    }
+
     unsigned long GetBytesTx() const override { return fBytesTx; }
     unsigned long GetBytesRx() const override { return fBytesRx; }
     unsigned long GetMessagesTx() const override { return fMessagesTx; }
@@ -458,17 +1065,504 @@ class Socket final : public fair::mq::Socket
     ~Socket() override { Close(); }
 
   private:
+    MessagePtr NewMessage(MessageArena& arena, MetaHeader& meta) { return MessagePtr(new (arena) Message(fManager, meta, GetTransport())); }
+
+    // a received inline message (see IsInline()) takes a copy of its payload from the frame, at the offset given in its meta data
+    static void CopyInline(Message& msg, const char* frame)
+    {
+        const MetaHeader meta = msg.fMeta;
+        std::memcpy(msg.InitializeInline(meta.fSize), frame + meta.fOffset, meta.fSize);
+    }
+
+    // called for every message part before it is sent: its reference leaves the ledger of this process (--shm-reclaim),
+    // even if the send fails (the ledger may count less than held, never more)
+    void HandOver(const MetaHeader& meta)
+    {
+        fManager.Disown(meta);
+        TagOwnerChannel(meta);
+    }
+
+    // records this channel for the chunks tagged with their owner (--shm-owner-sampling), shown by fairmq-shmmonitor
+    void TagOwnerChannel(const MetaHeader& meta)
+    {
+        if (meta.fManaged && meta.fHandle >= 0 && fManager.OwnerTagsPresent()) {
+            if (!fOwnerChannelRegistered) {
+                fOwnerChannel = fManager.RegisterOwnerChannel(fId);
+                fOwnerChannelRegistered = true;
+            }
+            fManager.TagOwnerChannel(meta.fSegmentId, meta.fHandle, fOwnerChannel);
+        }
+    }
+
+    int64_t NotReceiving() const
+    {
+        LOG(error) << "Socket " << fId << " is a pub socket, it cannot receive";
+        return static_cast<int>(TransferCode::error);
+    }
+
+    // registers the subscribers that connected since the last call (by their probe message)
+    void UpdateSubscribers()
+    {
+        ZMsg id;
+        while (zmq_msg_recv(id.Msg(), fSocket, ZMQ_DONTWAIT) >= 0) {
+            std::string subscriber(static_cast<const char*>(id.Data()), id.Size());
+            // the (empty) probe frame
+            for (bool more = zmq_msg_more(id.Msg()); more;) {
+                ZMsg part;
+                zmq_msg_recv(part.Msg(), fSocket, 0);
+                more = zmq_msg_more(part.Msg());
+            }
+            if (std::find(fSubscribers.begin(), fSubscribers.end(), subscriber) == fSubscribers.end()) {
+                fSubscribers.push_back(std::move(subscriber));
+                LOG(debug) << "Socket " << fId << " has " << fSubscribers.size() << " subscribers";
+            }
+        }
+    }
+
+    // The meta data of the message(s) is sent to every subscriber. The messages get one reference per subscriber,
+    // added in one step (per part) before sending, and the references of the subscribers that could not take the
+    // message (gone or at their high-water mark) are released again. Like zeromq pub sockets it never blocks, without
+    // subscribers the messages are discarded (when the caller releases them).
+    int64_t Publish(Message* const* msgs, size_t numMsgs)
+    {
+        UpdateSubscribers();
+        int64_t totalSize = 0;
+        for (size_t i = 0; i < numMsgs; ++i) {
+            totalSize += msgs[i]->GetSize();
+        }
+        ++fMessagesTx;
+        fBytesTx += totalSize;
+        if (fSubscribers.empty()) {
+            return totalSize;
+        }
+        if (fSubscribers.size() > UINT16_MAX - 1) {
+            LOG(error) << "Socket " << fId << " cannot publish to more than " << UINT16_MAX - 1 << " subscribers";
+            return static_cast<int>(TransferCode::error);
+        }
+
+        // references for the subscribers, the one of the sender is passed on to the first of them
+        fPubMetas.clear();
+        for (size_t i = 0; i < numMsgs; ++i) {
+            msgs[i]->Materialize();
+            msgs[i]->AddReferences(static_cast<uint16_t>(fSubscribers.size() - 1));
+            msgs[i]->fQueued = true;
+            HandOver(msgs[i]->fMeta);
+            fPubMetas.push_back(msgs[i]->fMeta);
+        }
+
+        const TraceContext* trace = (fTrace && numMsgs > 0 && msgs[0]->GetTraceContext()) ? &msgs[0]->GetTraceContext() : nullptr;
+        const char* frame = reinterpret_cast<const char*>(fPubMetas.data());
+        size_t frameSize = fPubMetas.size() * sizeof(MetaHeader);
+        if (fCompactMeta || trace) {
+            fCompactFrame.resize(CompactMetaMaxSize(numMsgs));
+            frameSize = EncodeCompactMeta(fPubMetas.data(), numMsgs, fCompactFrame.data(), trace);
+            frame = fCompactFrame.data();
+        }
+
+        size_t failed = 0;
+        for (auto it = fSubscribers.begin(); it != fSubscribers.end();) {
+            if (zmq_send(fSocket, it->data(), it->size(), ZMQ_SNDMORE | ZMQ_DONTWAIT) >= 0
+             && zmq_send(fSocket, frame, frameSize, ZMQ_DONTWAIT) >= 0) {
+                ++it;
+                continue;
+            }
+            ++failed;
+            if (zmq_errno() == EHOSTUNREACH) {
+                LOG(debug) << "Socket " << fId << " lost a subscriber";
+                it = fSubscribers.erase(it);
+            } else { // EAGAIN: a slow subscriber misses the message
+                ++it;
+            }
+        }
+
+        for (size_t f = 0; f < failed; ++f) {
+            for (auto meta : fPubMetas) {
+                Message release(fManager, meta, GetTransport());
+            }
+        }
+
+        return totalSize;
+    }
+
+    int64_t SendBatched(Message* shmMsg, int timeout)
+    {
+        std::lock_guard<std::mutex> lock(fSndBatchMtx);
+        if (fSndBatch.size() >= fSndBatchLimit) {
+            // a full batch could not be sent earlier, the message is only accepted once there is room
+            int64_t rc = FlushSndBatch(timeout);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+        fSndBatch.push_back(shmMsg->fMeta);
+        shmMsg->fQueued = true;
+        ++fMessagesTx;
+        size_t size = shmMsg->GetSize();
+        fBytesTx += size;
+        if (fSndBatchController) {
+            const auto now = std::chrono::steady_clock::now();
+            fSndBatchController->OnArrival(now);
+            fSndBatchLimit = fSndBatchController->Size();
+            if (fSndBatch.size() == 1) {
+                fSndBatchFirst = now;
+            }
+        }
+        if (fSndBatch.size() == 1) {
+            fSndBatchStart = std::chrono::steady_clock::now();
+            fSndBatchCV.notify_one();
+        }
+        if (fSndBatch.size() >= fSndBatchLimit) {
+            FlushSndBatch(0); // if the peer is not ready, the next send or the flusher retries
+        }
+        return size;
+    }
+
+    // sends the pending batch as one frame, caller holds fSndBatchMtx. Returns 0 on success or a (negative) TransferCode
+    int64_t FlushSndBatch(int timeout)
+    {
+        if (fSndBatch.empty()) {
+            return 0;
+        }
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+
+        ZMsg zmqMsg(sizeof(MetaBatchHeader) + fSndBatch.size() * sizeof(MetaHeader));
+        MetaBatchHeader hdr{MetaBatchHeader::kMagic, static_cast<uint32_t>(fSndBatch.size())};
+        std::memcpy(zmqMsg.Data(), &hdr, sizeof(MetaBatchHeader));
+        std::memcpy(static_cast<char*>(zmqMsg.Data()) + sizeof(MetaBatchHeader), fSndBatch.data(), fSndBatch.size() * sizeof(MetaHeader));
+
+        while (true) {
+            int nbytes = zmq_msg_send(zmqMsg.Msg(), fSocket, flags);
+            if (nbytes > 0) {
+                fSndBatch.clear();
+                if (fSndBatchController) {
+                    fSndBatchController->OnFlush(fSndBatchFirst, std::chrono::steady_clock::now());
+                    fSndBatchLimit = fSndBatchController->Size();
+                    fSndBatchTimeoutUs = fSndBatchController->TimeoutUs();
+                }
+                return 0;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fManager.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+    }
+
+    // flushes batches that did not fill up within fSndBatchTimeoutUs
+    void SndBatchFlusher()
+    {
+        std::unique_lock<std::mutex> lock(fSndBatchMtx);
+        while (!fSndBatchStop) {
+            if (fSndBatch.empty()) {
+                fSndBatchCV.wait(lock, [&]() { return fSndBatchStop || !fSndBatch.empty(); });
+                continue;
+            }
+            auto deadline = fSndBatchStart + std::chrono::microseconds(fSndBatchTimeoutUs);
+            if (fSndBatchCV.wait_until(lock, deadline, [&]() { return fSndBatchStop.load(); })) {
+                break;
+            }
+            if (!fSndBatch.empty() && std::chrono::steady_clock::now() >= fSndBatchStart + std::chrono::microseconds(fSndBatchTimeoutUs)) {
+                if (FlushSndBatch(fTimeout) < 0) {
+                    fSndBatchStart = std::chrono::steady_clock::now() + std::chrono::milliseconds(fTimeout); // peer not ready or interrupted, retry later
+                }
+            }
+        }
+    }
+
+    // payload size of the messages described by a meta data frame (any of the formats accepted by the receive functions)
+    size_t PayloadSize(const char* frame, size_t size)
+    {
+        size_t payloadSize = 0;
+        uint32_t magic = 0;
+        if (size >= sizeof(magic)) {
+            std::memcpy(&magic, frame, sizeof(magic));
+        }
+        size_t offset = 0;
+        if (size % sizeof(MetaHeader) != 0) {
+            if (magic == kCompactMetaMagic) {
+                fCompactMetas.clear();
+                if (DecodeCompactMeta(frame, size, fCompactMetas)) {
+                    for (const auto& meta : fCompactMetas) {
+                        payloadSize += meta.fSize;
+                    }
+                }
+                return payloadSize;
+            }
+            if (magic != MetaBatchHeader::kMagic) {
+                return 0;
+            }
+            offset = sizeof(MetaBatchHeader);
+        }
+        for (; offset + sizeof(MetaHeader) <= size; offset += sizeof(MetaHeader)) {
+            MetaHeader meta;
+            std::memcpy(&meta, frame + offset, sizeof(MetaHeader));
+            payloadSize += meta.fSize;
+        }
+        return payloadSize;
+    }
+
+    // Fills first with the received single message or the first message of a batch (the rest is queued in fRcvBatch).
+    // Returns false if the frame is neither.
+    bool UnpackFrame(const char* frame, size_t size, MetaHeader& first)
+    {
+        fRcvTrace = TraceContext();
+        if (size == sizeof(MetaHeader)) {
+            std::memcpy(&first, frame, sizeof(MetaHeader));
+            return true;
+        }
+        uint32_t magic = 0;
+        if (size >= sizeof(magic)) {
+            std::memcpy(&magic, frame, sizeof(magic));
+        }
+        if (magic == kCompactMetaMagic) {
+            fCompactMetas.clear();
+            if (DecodeCompactMeta(frame, size, fCompactMetas, &fRcvTrace) && fCompactMetas.size() == 1) {
+                first = fCompactMetas.front();
+                return true;
+            }
+            return false;
+        }
+        if (size < sizeof(MetaBatchHeader) + sizeof(MetaHeader)) {
+            return false;
+        }
+        MetaBatchHeader hdr;
+        std::memcpy(&hdr, frame, sizeof(MetaBatchHeader));
+        if (hdr.fMagic != MetaBatchHeader::kMagic || size != sizeof(MetaBatchHeader) + hdr.fCount * sizeof(MetaHeader)) {
+            return false;
+        }
+        const char* metas = frame + sizeof(MetaBatchHeader);
+        std::memcpy(&first, metas, sizeof(MetaHeader));
+        for (uint32_t i = 1; i < hdr.fCount; ++i) {
+            fRcvBatch.emplace_back();
+            std::memcpy(&fRcvBatch.back(), metas + i * sizeof(MetaHeader), sizeof(MetaHeader));
+        }
+        return true;
+    }
+
+    // Busy-polls tryReceive (a non-blocking receive) until it succeeds, the timeout expires or (hybrid mode)
+    // the spin budget is used up. Returns true if rc holds the final result, false if the caller should block
+    // for the remaining timeout.
+    template<typename TryReceive>
+    bool SpinReceive(TryReceive tryReceive, int& timeout, int64_t& rc)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto spent = std::chrono::steady_clock::duration::zero();
+        bool done = true;
+        while (true) {
+            rc = tryReceive();
+            if (rc != static_cast<int>(TransferCode::timeout)) {
+                break;
+            }
+            spent = std::chrono::steady_clock::now() - start;
+            if (fManager.Interrupted()) {
+                rc = static_cast<int>(TransferCode::interrupted);
+                break;
+            }
+            if (timeout > 0 && spent >= std::chrono::milliseconds(timeout)) {
+                break;
+            }
+            if (fRcvMode == RcvMode::hybrid && spent >= std::chrono::microseconds(fRcvSpinUs)) {
+                if (timeout > 0) {
+                    timeout = std::max(1, timeout - static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(spent).count()));
+                }
+                done = false;
+                break;
+            }
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        fRcvSpinTime += std::chrono::duration_cast<std::chrono::microseconds>(spent).count();
+        return done;
+    }
+
+    // Both sides of a connection derive the ring names from the endpoint: the path for ipc/inproc, the (resolved) host
+    // and port for tcp, with the host of a wildcard bind as '*' (see Manager::AttachMetaRings).
+    // One ring per direction, so that PAIR sockets can use the same endpoint for sending and receiving.
+    void AttachMetaRings(const std::string& address, bool bind)
+    {
+        if (!fMetaRingSend && !fMetaRingRecv) {
+            return;
+        }
+        std::string key;
+        std::string wildcardKey;
+        size_t protocolPos = address.find("://");
+        std::string protocol = address.substr(0, protocolPos);
+        if (protocol == "tcp") {
+            size_t portPos = address.rfind(':');
+            std::string host = address.substr(protocolPos + 3, portPos - protocolPos - 3);
+            std::string port = address.substr(portPos + 1);
+            if (host == "*" || host == "0.0.0.0" || host == "[::]") {
+                host = "*";
+            } else if (std::string ip = tools::getIpFromHostname(host); !ip.empty()) {
+                host = ip;
+            }
+            key = "tcp_" + host + "_" + port;
+            wildcardKey = "tcp_*_" + port;
+        } else {
+            key = protocol + "_" + address.substr(protocolPos == std::string::npos ? 0 : protocolPos + 3);
+            std::replace(key.begin(), key.end(), '/', '_');
+        }
+        for (const std::string direction : { ".b2c", ".c2b" }) {
+            bool send = (direction == ".b2c") == bind;
+            if (send ? !fMetaRingSend : !fMetaRingRecv) {
+                continue;
+            }
+            for (const auto& ring : fManager.AttachMetaRings(key + direction, wildcardKey.empty() ? "" : wildcardKey + direction)) {
+                fMetaRingKeys.push_back(ring.first);
+                (send ? fSendRings : fRecvRings).push_back(ring.second);
+            }
+        }
+        LOG(debug) << "Socket " << fId << " exchanges meta headers for " << address << " via shared memory ring";
+    }
+
+    // the last socket leaving a ring destroys it, together with the messages that were not received
+    void DetachMetaRings()
+    {
+        std::vector<MetaHeader> leftover;
+        for (const auto& key : fMetaRingKeys) {
+            fManager.DetachMetaRing(key, leftover);
+        }
+        if (!leftover.empty()) {
+            LOG(debug) << "Socket " << fId << ": releasing " << leftover.size() << " message part(s) left in its meta header rings";
+            for (auto& meta : leftover) {
+                Message dropped(fManager, meta); // releases the buffer
+            }
+        }
+        fMetaRingKeys.clear();
+        fSendRings.clear();
+        fRecvRings.clear();
+        fNextSendRing = 0;
+        fNextRecvRing = 0;
+    }
+
+    // returns 0 on success or a (negative) TransferCode
+    int64_t SendToMetaRing(const MetaHeader* metas, size_t n, int timeout)
+    {
+        if (n > fSendRings.front()->Capacity()) {
+            FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "Cannot send " << n << " parts on " << fId << ", meta header ring capacity is " << fSendRings.front()->Capacity();
+            return static_cast<int>(TransferCode::error);
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            for (size_t i = 0; i < fSendRings.size(); ++i) {
+                size_t r = (fNextSendRing + i) % fSendRings.size();
+                if (fSendRings[r]->TryPush(metas, n)) {
+                    fNextSendRing = (r + 1) % fSendRings.size();
+                    return 0;
+                }
+            }
+            int wait = RemainingWait(start, timeout); // also handles interruption
+            if (wait < 0) {
+                return wait;
+            }
+            fSendRings[fNextSendRing]->WaitForSpace(n, fSendRings.size() > 1 ? 1 : wait);
+        }
+    }
+
+    // receives the next record into fRingMetas, returns 0 on success or a (negative) TransferCode
+    int64_t ReceiveFromMetaRing(int timeout)
+    {
+        fRingMetas.clear();
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            for (size_t i = 0; i < fRecvRings.size(); ++i) {
+                size_t r = (fNextRecvRing + i) % fRecvRings.size();
+                if (fRecvRings[r]->TryPop(fRingMetas) > 0) {
+                    fNextRecvRing = (r + 1) % fRecvRings.size();
+                    return 0;
+                }
+            }
+            int wait = RemainingWait(start, timeout);
+            if (wait < 0) {
+                return wait;
+            }
+            fRecvRings[fNextRecvRing]->WaitForData(fRecvRings.size() > 1 ? 1 : wait);
+        }
+    }
+
+    // how long to block next (at most the socket timeout, to notice interruptions), or a (negative) TransferCode
+    int RemainingWait(std::chrono::steady_clock::time_point start, int timeout) const
+    {
+        if (fManager.Interrupted()) {
+            return static_cast<int>(TransferCode::interrupted);
+        }
+        if (timeout == 0) {
+            return static_cast<int>(TransferCode::timeout);
+        }
+        if (timeout < 0) {
+            return fTimeout;
+        }
+        int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= timeout) {
+            return static_cast<int>(TransferCode::timeout);
+        }
+        return std::min(fTimeout, timeout - elapsed);
+    }
+
     Manager& fManager;
     std::string fId;
     void* fSocket;
     void* fMonitorSocket;
-    std::atomic<unsigned long> fBytesTx;
-    std::atomic<unsigned long> fBytesRx;
-    std::atomic<unsigned long> fMessagesTx;
-    std::atomic<unsigned long> fMessagesRx;
+    TransferCounter fBytesTx;
+    TransferCounter fBytesRx;
+    TransferCounter fMessagesTx;
+    TransferCounter fMessagesRx;
 
     int fTimeout;
     mutable unsigned long fConnectedPeersCount;
+    mutable std::vector<int> fConnectionFds; // of the established connections, from the monitor events
+    mutable std::mutex fMonitorMtx; // the peers and RTTs are queried by other threads than the one using the socket
+
+    bool fMetaRingSend;
+    bool fMetaRingRecv;
+    std::vector<MetaRing*> fSendRings;
+    std::vector<MetaRing*> fRecvRings;
+    std::vector<std::string> fMetaRingKeys; // of the attached rings, to detach on Close()
+    size_t fNextSendRing;
+    size_t fNextRecvRing;
+    std::vector<MetaHeader> fRingMetas;
+
+    enum class RcvMode { block, spin, hybrid };
+    RcvMode fRcvMode;
+    int fRcvSpinUs;
+    std::atomic<unsigned long> fRcvSpinTime; // in microseconds
+
+    static constexpr size_t kMaxSndBatch = 1024;
+    const bool fSndBatchAllowed;
+    size_t fSndBatchSize; // guarded by fSndBatchMtx, read without lock only by the sending thread
+    size_t fSndBatchLimit; // current batch size: fSndBatchSize, or set by fSndBatchController (guarded by fSndBatchMtx)
+    int fSndBatchTimeoutUs;
+    std::unique_ptr<BatchController> fSndBatchController; // with a latency target (batchLatencyTargetUs)
+    std::chrono::steady_clock::time_point fSndBatchFirst;  // arrival of the first message of the batch
+    std::vector<MetaHeader> fSndBatch;
+    std::chrono::steady_clock::time_point fSndBatchStart;
+    std::mutex fSndBatchMtx;
+    std::condition_variable fSndBatchCV;
+    std::atomic<bool> fSndBatchStop;
+    std::thread fSndBatchThread;
+    std::vector<char> fRcvFrame;         // receive buffer for single messages, on pull sockets large enough for a batch frame
+    std::deque<MetaHeader> fRcvBatch;    // received, not yet delivered messages of a batch
+    bool fCompactMeta;                   // send meta headers in the compact format
+    std::vector<char> fCompactFrame;     // encoding buffer for compact multipart frames
+    std::vector<MetaHeader> fCompactMetas; // decoded compact headers
+    std::vector<const char*> fInlinePayloads; // inline payloads of the parts of a multipart send, nullptr for the others
+    std::vector<MetaHeader> fLazyMetas; // meta data of a send of LazyParts
+    MetaHeader fLazyFirst;              // first message of a batch received with ReceiveLazy()
+    bool fTrace;                         // send the trace contexts of the messages (in the compact format)
+    TraceContext fRcvTrace;              // trace context of the frame last unpacked by UnpackFrame
+    uint16_t fOwnerChannel;              // name index of this socket in the chunk owner table
+    bool fOwnerChannelRegistered;
+    bool fPublisher;                     // pub socket, sends to the registered subscribers
+    std::vector<std::string> fSubscribers; // routing ids of the subscribers of a pub socket
+    std::vector<MetaHeader> fPubMetas;
 };
 
 } // namespace fair::mq::shmem
@@ -9,6 +9,7 @@
 #ifndef FAIR_MQ_SHMEM_TRANSPORTFACTORY_H_
 #define FAIR_MQ_SHMEM_TRANSPORTFACTORY_H_
 
+#include "BufferArena.h"
 #include "Common.h"
 #include "Manager.h"
 #include "Message.h"
@@ -17,7 +18,10 @@
 #include "UnmanagedRegionImpl.h"
 #include <fairmq/ProgOptions.h>
 #include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Threads.h>
 #include <fairmq/TransportFactory.h>
+#include <fairmq/zeromq/Common.h>
+#include <fairmq/zeromq/EpollSet.h>
 
 #include <fairlogger/Logger.h>
 
@@ -25,6 +29,7 @@
 
 #include <zmq.h>
 
+#include <map>
 #include <memory> // unique_ptr, make_unique
 #include <string>
 #include <vector>
@@ -40,6 +45,7 @@ class TransportFactory final : public fair::mq::TransportFactory
         : fair::mq::TransportFactory(deviceId)
         , fZmqCtx(zmq_ctx_new())
         , fManager(nullptr)
+        , fEpollPoller(false)
     {
         int major = 0, minor = 0, patch = 0;
         zmq_version(&major, &minor, &patch);
@@ -59,13 +65,14 @@ class TransportFactory final : public fair::mq::TransportFactory
             sessionName = config->GetProperty<std::string>("session", sessionName);
             segmentSize = config->GetProperty<size_t>("shm-segment-size", segmentSize);
             allocationAlgorithm = config->GetProperty<std::string>("shm-allocation", allocationAlgorithm);
+            fEpollPoller = zmq::ParsePollerBackend(config->GetProperty<std::string>("zmq-poller", "zmq_poll"));
         } else {
             LOG(debug) << "ProgOptions not available! Using defaults.";
         }
 
-        if (allocationAlgorithm != "rbtree_best_fit" && allocationAlgorithm != "simple_seq_fit") {
-            LOG(error) << "Provided shared memory allocation algorithm '" << allocationAlgorithm << "' is not supported. Supported are 'rbtree_best_fit'/'simple_seq_fit'";
-            throw SharedMemoryError(tools::ToString("Provided shared memory allocation algorithm '", allocationAlgorithm, "' is not supported. Supported are 'rbtree_best_fit'/'simple_seq_fit'"));
+        if (allocationAlgorithm != "rbtree_best_fit" && allocationAlgorithm != "simple_seq_fit" && allocationAlgorithm != "slab_fit") {
+            LOG(error) << "Provided shared memory allocation algorithm '" << allocationAlgorithm << "' is not supported. Supported are 'rbtree_best_fit'/'simple_seq_fit'/'slab_fit'";
+            throw SharedMemoryError(tools::ToString("Provided shared memory allocation algorithm '", allocationAlgorithm, "' is not supported. Supported are 'rbtree_best_fit'/'simple_seq_fit'/'slab_fit'"));
         }
 
         try {
@@ -78,6 +85,29 @@ class TransportFactory final : public fair::mq::TransportFactory
                 LOG(error) << "failed configuring context, reason: " << zmq_strerror(errno);
             }
 
+            // zmq sockets of the (meta data) channels can be assigned to context groups with their own I/O threads
+            // (the default context gets the --io-cpu-affinity/--sched-policy/--sched-priority settings)
+            if (config) {
+                tools::ThreadSettings ioThreads = tools::ParseThreadSettings(config->GetProperty<std::string>("io-cpu-affinity", ""),
+                                                                             config->GetProperty<std::string>("sched-policy", ""),
+                                                                             config->GetProperty<int>("sched-priority", -1));
+                for (const auto& [name, group] : zmq::ContextGroups(config->GetProperty<std::vector<std::string>>("zmq-context-group", {}), numIoThreads, ioThreads)) {
+                    if (name == "default") {
+                        zmq::ConfigureContext(fZmqCtx, group);
+                    } else {
+                        void* ctx = zmq_ctx_new();
+                        if (!ctx) {
+                            throw std::runtime_error(tools::ToString("failed creating context for context group '", name, "', reason: ", zmq_strerror(errno)));
+                        }
+                        fGroupZmqCtxs.emplace(name, ctx);
+                        zmq::ConfigureContext(ctx, group);
+                        if (zmq_ctx_set(ctx, ZMQ_MAX_SOCKETS, 10000) != 0) {
+                            LOG(error) << "failed configuring context, reason: " << zmq_strerror(errno);
+                        }
+                    }
+                }
+            }
+
             fManager = std::make_unique<Manager>(sessionName, segmentSize, config);
         } catch (boost::interprocess::interprocess_exception& e) {
             LOG(error) << "Could not initialize shared memory transport: " << e.what();
@@ -113,6 +143,72 @@ class TransportFactory final : public fair::mq::TransportFactory
         return std::make_unique<Message>(*fManager, size, alignment, this);
     }
 
+    MessagePtr CreateMessage(size_t size, Headroom headroom) override
+    {
+        return std::make_unique<Message>(*fManager, size, headroom, this);
+    }
+
+    Parts CreateMessages(size_t count, size_t size) override
+    {
+        return CreateMessages(count, size, Alignment{0});
+    }
+
+    Parts CreateMessages(size_t count, size_t size, Alignment alignment) override
+    {
+        Parts parts;
+        if (size == 0) {
+            for (size_t i = 0; i < count; ++i) {
+                parts.AddPart(CreateMessage(size, alignment));
+            }
+            return parts;
+        }
+        std::vector<std::pair<char*, uint16_t>> chunks = fManager->AllocateMany(count, size, alignment.alignment);
+        parts.fParts.reserve(count);
+        for (const auto& [ptr, segmentId] : chunks) {
+            auto msg = std::make_unique<Message>(*fManager, alignment, this);
+            msg->InitializeChunk(ptr, segmentId, size);
+            parts.fParts.emplace_back(std::move(msg));
+        }
+        return parts;
+    }
+
+    void ReleaseMessages(std::vector<MessagePtr>& msgs) override
+    {
+        // managed chunks of the messages, returned with one allocator transaction per segment
+        std::vector<std::pair<uint16_t, boost::interprocess::managed_shared_memory::handle_t>> chunks;
+        chunks.reserve(msgs.size());
+        for (auto& msg : msgs) {
+            if (msg && msg->GetType() == fair::mq::Transport::SHM && msg->GetTransport() == this) {
+                try {
+                    static_cast<Message*>(msg.get())->Release(chunks);
+                } catch (SharedMemoryError& sme) {
+                    LOG(error) << "error releasing message: " << sme.what();
+                } catch (boost::interprocess::lock_exception& le) {
+                    LOG(error) << "error releasing message: " << le.what();
+                }
+            }
+        }
+        msgs.clear();
+        fManager->DeallocateMany(chunks);
+    }
+
+    void ReleaseRegions(std::vector<UnmanagedRegionPtr>& regions) override
+    {
+        std::vector<uint16_t> ids;
+        for (auto& region : regions) {
+            if (region && region->GetType() == fair::mq::Transport::SHM && region->GetTransport() == this) {
+                auto& impl = static_cast<UnmanagedRegionImpl&>(*region);   // NOLINT(cppcoreguidelines-pro-type-static-cast-downcast)
+                if (impl.fOpened) {
+                    continue;
+                }
+                ids.push_back(impl.fRegionId);
+                impl.fRemoved = true;
+            }
+        }
+        fManager->RemoveRegions(ids);
+        regions.clear();
+    }
+
     MessagePtr CreateMessage(void* data, size_t size, fair::mq::FreeFn* ffn, void* hint = nullptr) override
     {
         return std::make_unique<Message>(*fManager, data, size, ffn, hint, this);
@@ -128,19 +224,32 @@ class TransportFactory final : public fair::mq::TransportFactory
         return std::make_unique<Socket>(*fManager, type, name, GetId(), fZmqCtx, this);
     }
 
+    SocketPtr CreateSocket(const std::string& type, const std::string& name, const std::string& contextGroup) override
+    {
+        if (contextGroup.empty() || contextGroup == "default") {
+            return CreateSocket(type, name);
+        }
+        auto it = fGroupZmqCtxs.find(contextGroup);
+        if (it == fGroupZmqCtxs.end()) {
+            LOG(error) << "Unknown context group '" << contextGroup << "' for socket " << name << ", configure it with --zmq-context-group";
+            throw TransportFactoryError(tools::ToString("Unknown context group '", contextGroup, "' for socket ", name));
+        }
+        return std::make_unique<Socket>(*fManager, type, name, GetId(), it->second, this);
+    }
+
     PollerPtr CreatePoller(const std::vector<Channel>& channels) const override
     {
-        return std::make_unique<Poller>(channels);
+        return std::make_unique<Poller>(channels, fEpollPoller);
     }
 
     PollerPtr CreatePoller(const std::vector<Channel*>& channels) const override
     {
-        return std::make_unique<Poller>(channels);
+        return std::make_unique<Poller>(channels, fEpollPoller);
     }
 
     PollerPtr CreatePoller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList) const override
     {
-        return std::make_unique<Poller>(channelsMap, channelList);
+        return std::make_unique<Poller>(channelsMap, channelList, fEpollPoller);
     }
 
     UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, RegionCallback callback = nullptr, const std::string& path = "", int flags = 0, fair::mq::RegionConfig cfg = fair::mq::RegionConfig()) override
@@ -187,10 +296,80 @@ class TransportFactory final : public fair::mq::TransportFactory
         return std::make_unique<UnmanagedRegionImpl>(*fManager, size, callback, bulkCallback, std::move(cfg), this);
     }
 
+    UnmanagedRegionPtr OpenUnmanagedRegion(uint16_t id) override
+    {
+        shmem::UnmanagedRegion* region = fManager->GetRegion(id);
+        if (!region) {
+            return nullptr;
+        }
+        return std::make_unique<UnmanagedRegionImpl>(*fManager, region, id, this);
+    }
+
     void SubscribeToRegionEvents(RegionEventCallback callback) override { fManager->SubscribeToRegionEvents(callback); }
     bool SubscribedToRegionEvents() override { return fManager->SubscribedToRegionEvents(); }
     void UnsubscribeFromRegionEvents() override { fManager->UnsubscribeFromRegionEvents(); }
     std::vector<fair::mq::RegionInfo> GetRegionInfo() override { return fManager->GetRegionInfo(); }
+    /// @return true with --shm-fixed-address if all segments and regions mapped by this process so far are at the same
+    /// address as in the other processes of the session (raw pointers into them can be exchanged)
+    bool FixedAddressMapping() const { return fManager->FixedAddressMapping(); }
+
+    std::vector<TransportMetric> GetMetrics() override { return fManager->GetMetrics(); }
+    bool SubscribeToMemoryWatermarks(std::vector<double> watermarks, MemoryWatermarkCallback callback, int intervalMs = 10) override
+    {
+        return fManager->SubscribeToMemoryWatermarks(std::move(watermarks), std::move(callback), intervalMs);
+    }
+    void UnsubscribeFromMemoryWatermarks() override { fManager->UnsubscribeFromMemoryWatermarks(); }
+
+    BufferArenaPtr CreateBufferArena(size_t size) override
+    {
+        return std::make_unique<BufferArena>(*fManager, size, this);
+    }
+
+    uint64_t PublishObject(const std::string& key, fair::mq::Message& msg) override
+    {
+        if (msg.GetType() != fair::mq::Transport::SHM) {
+            throw TransportError(tools::ToString("shmem: object '", key, "' has to be published with a shmem message"));
+        }
+        auto& shmMsg = static_cast<Message&>(msg);   // NOLINT(cppcoreguidelines-pro-type-static-cast-downcast)
+        if (!shmMsg.fMeta.fManaged) {
+            throw TransportError(tools::ToString("shmem: object '", key, "' has to be in a managed segment, unmanaged region messages cannot be published"));
+        }
+        shmMsg.Materialize();
+        shmMsg.AddReferences(1); // the reference of the store
+        MetaHeader replaced{};
+        bool hasReplaced = false;
+        uint64_t version = fManager->StoreObject(key, shmMsg.fMeta, replaced, hasReplaced);
+        if (hasReplaced) {
+            Message release(*fManager, replaced, this);
+        }
+        LOG(debug) << "shmem: published object '" << key << "' version " << version << " (" << shmMsg.GetSize() << " bytes)";
+        return version;
+    }
+
+    MessagePtr GetObject(const std::string& key, uint64_t* version = nullptr) override
+    {
+        MetaHeader meta{};
+        uint64_t objectVersion = 0;
+        if (!fManager->LoadObject(key, meta, objectVersion)) {
+            return nullptr;
+        }
+        if (version) {
+            *version = objectVersion;
+        }
+        return std::make_unique<Message>(*fManager, meta, this);
+    }
+
+    uint64_t GetObjectVersion(const std::string& key) override { return fManager->ObjectVersion(key); }
+
+    bool RemoveObject(const std::string& key) override
+    {
+        MetaHeader removed{};
+        if (!fManager->EraseObject(key, removed)) {
+            return false;
+        }
+        Message release(*fManager, removed, this);
+        return true;
+    }
 
     Transport GetType() const override { return fair::mq::Transport::SHM; }
 
@@ -202,26 +381,28 @@ class TransportFactory final : public fair::mq::TransportFactory
     {
         LOG(debug) << "Destroying Shared Memory transport...";
 
+        for (auto& [name, ctx] : fGroupZmqCtxs) {
+            TerminateContext(ctx);
+        }
         if (fZmqCtx) {
-            while (true) {
-                if (zmq_ctx_term(fZmqCtx) != 0) {
-                    if (errno == EINTR) {
-                        LOG(debug) << "zmq_ctx_term interrupted by system call, retrying";
-                        continue;
-                    } else {
-                        fZmqCtx = nullptr;
-                    }
-                }
-                break;
-            }
+            TerminateContext(fZmqCtx);
         } else {
             LOG(error) << "context not available for shutdown";
         }
     }
 
   private:
+    static void TerminateContext(void* ctx)
+    {
+        while (zmq_ctx_term(ctx) != 0 && errno == EINTR) {
+            LOG(debug) << "zmq_ctx_term interrupted by system call, retrying";
+        }
+    }
+
     void* fZmqCtx;
+    std::map<std::string, void*> fGroupZmqCtxs; // additional zmq contexts of the configured context groups
     std::unique_ptr<Manager> fManager;
+    bool fEpollPoller;
 };
 
 } // namespace fair::mq::shmem
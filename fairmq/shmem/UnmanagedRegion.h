@@ -9,9 +9,19 @@
 #ifndef FAIR_MQ_SHMEM_UNMANAGEDREGION_H_
 #define FAIR_MQ_SHMEM_UNMANAGEDREGION_H_
 
+#include <fairmq/shmem/AckReactor.h>
 #include <fairmq/shmem/Common.h>
 #include <fairmq/shmem/Monitor.h>
+#include <fairmq/shmem/RegionRefCounts.h>
+#include <fairmq/shmem/RegionRing.h>
+#include <fairmq/shmem/RegionSlots.h>
+#include <fairmq/shmem/Ring.h>
+#include <fairmq/tools/Futex.h>
+#include <fairmq/tools/Gpu.h>
+#include <fairmq/tools/Probes.h>
+#include <fairmq/tools/Queues.h>
 #include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Threads.h>
 #include <fairmq/UnmanagedRegion.h>
 
 #include <fairlogger/Logger.h>
@@ -33,6 +43,11 @@
 #include <ios>
 #include <utility> // move
 
+#include <fcntl.h> // open
+#include <sys/mman.h> // mlock
+#include <sys/stat.h> // fstat
+#include <unistd.h> // ftruncate, close
+
 namespace fair::mq::shmem
 {
 
@@ -54,39 +69,204 @@ struct UnmanagedRegion
         : UnmanagedRegion(shmId, cfg.size, true, std::move(cfg))
     {}
 
-    UnmanagedRegion(const std::string& shmId, uint64_t size, bool controlling, RegionConfig cfg)
+    // gpuIpcHandle: device memory exported by the controller (viewers of RegionConfig::gpuDevice regions)
+    // address: map the region at this address, if possible (--shm-fixed-address), registered for the viewers by the controller
+    UnmanagedRegion(const std::string& shmId, uint64_t size, bool controlling, RegionConfig cfg, const tools::GpuIpcHandle& gpuIpcHandle = {}, const void* address = nullptr)
         : fControlling(controlling)
         , fRemoveOnDestruction(cfg.removeOnDestruction)
         , fLinger(cfg.linger)
+        , fThreadNumaNode(cfg.numaNode)
         , fStopAcks(false)
         , fName("fmq_" + shmId + "_rg_" + std::to_string(cfg.id.value()))
         , fQueueName("fmq_" + shmId + "_rgq_" + std::to_string(cfg.id.value()))
+        , fAckRingName("fmq_" + shmId + "_rga_" + std::to_string(cfg.id.value()))
+        , fRefCountsName(RegionRefCounts::Name(shmId, cfg.id.value()))
+        , fRingName(RegionRing::Name(shmId, cfg.id.value()))
         , fShmemObject()
         , fFile(nullptr)
         , fFileMapping()
+        , fMemfd(-1)
+        , fCrossHost(cfg.crossHost)
+        , fGpuDevice(cfg.gpuDevice)
+        , fGpuData(nullptr)
+        , fGpuSize(0)
+        , fGpuRegistered(false)
+        , fMaxSize(cfg.maxSize)
+        , fSize(0)
+        , fLocked(false)
+        , fNumOverflowBlocks(0)
+        , fNumAcksSent(0)
+        , fNumAcksReceived(0)
+        , fAckBunchSize(cfg.ackBunchSize)
+        , fAckMaxDelay(cfg.ackMaxDelayUs)
+        , fAckAdaptive(cfg.ackAdaptive)
+        , fAckIdle(true)
+        , fAckWaiter(0)
         , fQueue(nullptr)
+        , fUseAckRing(cfg.ackRing)
+        , fAckRing(nullptr)
+        , fAckCallbackThreads(cfg.ackCallbackThreads)
+        , fAckSharding(cfg.ackSharding)
+        , fNextAckWorker(0)
+        , fAckReactor(nullptr)
+        , fReactorSender(0)
+        , fReactorReceiver(0)
+        , fReactorBlocksToSend(0)
+        , fReactorPendingSince(std::chrono::steady_clock::time_point::max())
         , fCallback(nullptr)
         , fBulkCallback(nullptr)
     {
         using namespace boost::interprocess;
 
         // TODO: refactor this
+        if ((cfg.gpuDevice >= 0 || cfg.memfd) && !fControlling && size == 0) {
+            size = cfg.size; // from the region info, device memory and external descriptors have no size of their own
+        }
         cfg.size = size;
         const uint16_t id = cfg.id.value();
         bool created = false;
 
         LOG(debug) << "UnmanagedRegion(): " << fName << " (" << (fControlling ? "controller" : "viewer") << ")";
 
-        if (!cfg.path.empty()) {
+        if (cfg.ackBunchSize == 0) {
+            LOG(error) << "Invalid ack bunch size for region " << id << ", must be at least 1";
+            throw TransportError(tools::ToString("Invalid ack bunch size for region ", id, ", must be at least 1"));
+        }
+
+        if (cfg.gpuDevice >= 0 && (cfg.gpuRegister || cfg.hugepages || cfg.lock || !cfg.path.empty() || cfg.numaNode >= 0)) {
+            LOG(error) << "GPU device memory region " << id << " cannot be combined with gpuRegister, hugepages, lock, path or numaNode";
+            throw TransportError(tools::ToString("GPU device memory region ", id, " cannot be combined with gpuRegister, hugepages, lock, path or numaNode"));
+        }
+
+        if (cfg.ringBuffer && cfg.gpuDevice >= 0) {
+            LOG(error) << "GPU device memory region " << id << " cannot be a ring buffer region";
+            throw TransportError(tools::ToString("GPU device memory region ", id, " cannot be a ring buffer region"));
+        }
+
+        if (cfg.slotSize > 0 && (cfg.ringBuffer || cfg.crossHost || cfg.gpuDevice >= 0)) {
+            LOG(error) << "Slot pool region " << id << " cannot be combined with ringBuffer, crossHost or gpuDevice";
+            throw TransportError(tools::ToString("Slot pool region ", id, " cannot be combined with ringBuffer, crossHost or gpuDevice"));
+        }
+
+        if (cfg.maxSize > 0 && fControlling && (cfg.maxSize < size || !cfg.path.empty() || cfg.hugepages || cfg.memfd || cfg.fd >= 0 || cfg.gpuDevice >= 0 || cfg.gpuRegister || cfg.ringBuffer || cfg.crossHost || cfg.slotSize > 0)) {
+            LOG(error) << "Resizable region " << id << " needs maxSize >= size and cannot be combined with path, hugepages, memfd, fd, gpuDevice, gpuRegister, ringBuffer, crossHost or slotSize";
+            throw TransportError(tools::ToString("Resizable region ", id, " needs maxSize >= size and cannot be combined with path, hugepages, memfd, fd, gpuDevice, gpuRegister, ringBuffer, crossHost or slotSize"));
+        }
+
+        if (cfg.memfd && fControlling && (!cfg.path.empty() || cfg.gpuDevice >= 0 || !cfg.removeOnDestruction)) {
+            LOG(error) << "memfd region " << id << " cannot be combined with path, gpuDevice or removeOnDestruction = false";
+            throw TransportError(tools::ToString("memfd region ", id, " cannot be combined with path, gpuDevice or removeOnDestruction = false"));
+        }
+
+        if (cfg.fd >= 0 && fControlling && (cfg.memfd || !cfg.path.empty() || cfg.hugepages || cfg.gpuDevice >= 0 || size == 0)) {
+            LOG(error) << "Region " << id << " of an external descriptor needs a size and cannot be combined with memfd, path, hugepages or gpuDevice";
+            throw TransportError(tools::ToString("Region ", id, " of an external descriptor needs a size and cannot be combined with memfd, path, hugepages or gpuDevice"));
+        }
+
+        if (cfg.crossHost && fControlling && cfg.fd < 0) {
+            LOG(error) << "Cross-host region " << id << " needs the descriptor of the shared memory window (fd)";
+            throw TransportError(tools::ToString("Cross-host region ", id, " needs the descriptor of the shared memory window (fd)"));
+        }
+
+        if (cfg.hugepages && cfg.path.empty() && !cfg.memfd) {
+            cfg.path = "/dev/hugepages/";
+        }
+
+        if (cfg.gpuDevice >= 0) {
+            try {
+                if (fControlling) {
+                    fGpuData = tools::GpuMalloc(cfg.gpuDevice, size, fGpuIpcHandle);
+                    created = true;
+                } else {
+                    fGpuIpcHandle = gpuIpcHandle;
+                    fGpuData = tools::GpuIpcOpen(cfg.gpuDevice, fGpuIpcHandle);
+                }
+            } catch (tools::GpuError& e) {
+                LOG(error) << "Failed " << (fControlling ? "allocating" : "opening") << " GPU device memory region " << id << " on device " << cfg.gpuDevice << ": " << e.what();
+                throw TransportError(tools::ToString("Failed ", (fControlling ? "allocating" : "opening"), " GPU device memory region ", id, " on device ", cfg.gpuDevice, ": ", e.what()));
+            }
+            fGpuSize = size;
+            LOG(debug) << (fControlling ? "Allocated " : "Opened ") << size << " bytes of GPU device memory on device " << cfg.gpuDevice << " (" << tools::GpuRuntime() << ") for region " << id;
+        } else if (cfg.fd >= 0 && fControlling) {
+            // external memory (e.g. a DMA buffer of a device driver), the descriptor stays with the caller.
+            // It is registered like a memfd, viewers open it via its /proc link
+            try {
+                fRegion = MapRegion(DescriptorMapping{cfg.fd}, static_cast<offset_t>(cfg.fdOffset), size, address, cfg.creationFlags);
+            } catch (interprocess_exception& e) {
+                LOG(error) << "Failed mapping descriptor " << cfg.fd << " (offset " << cfg.fdOffset << ") of region " << id << ": " << e.what();
+                throw TransportError(tools::ToString("Failed mapping descriptor ", cfg.fd, " (offset ", cfg.fdOffset, ") of region ", id, ": ", e.what()));
+            }
+            cfg.path = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(cfg.fd);
+            cfg.memfd = true;
+            created = true;
+        } else if (cfg.memfd) {
+            // the controller keeps the memfd open, viewers open it via its /proc link (registered as the region path)
+            if (fControlling) {
+                if (cfg.hugepages) {
+                    size_t hugePageSize = GetDefaultHugePageSize();
+                    if (hugePageSize > 0) {
+                        size = ((size + hugePageSize - 1) / hugePageSize) * hugePageSize;
+                        cfg.size = size;
+                    }
+                }
+                fMemfd = CreateMemfd(fName, size, cfg.hugepages);
+                if (fMemfd == -1) {
+                    int err = errno;
+                    LOG(error) << "Failed to create memfd for region " << id << ". Code: " << err << ", reason: " << strerror(err)
+                               << (cfg.hugepages ? tools::ToString(". Free huge pages: ", GetFreeHugePages()) : "");
+                    throw TransportError(tools::ToString("Failed to create memfd for region ", id, ": ", strerror(err)));
+                }
+                cfg.path = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(fMemfd);
+                created = true;
+            }
+            try {
+                fFileMapping = file_mapping(cfg.path.c_str(), read_write);
+                fRegion = MapRegion(fFileMapping, static_cast<offset_t>(cfg.fdOffset), size, address, cfg.creationFlags);
+            } catch (interprocess_exception& e) {
+                LOG(error) << "Failed mapping memfd of region " << id << " (" << cfg.path << "): " << e.what() << (fControlling ? "" : ". Has its creator exited?");
+                if (fMemfd != -1) {
+                    ::close(fMemfd);
+                }
+                throw TransportError(tools::ToString("Failed mapping memfd of region ", id, " (", cfg.path, "): ", e.what()));
+            }
+        } else if (!cfg.path.empty()) {
             fName = std::string(cfg.path + fName);
 
+            if (cfg.hugepages) {
+                size_t hugePageSize = GetHugetlbfsPageSize(cfg.path);
+                if (hugePageSize == 0) {
+                    LOG(error) << "Huge pages requested for region " << id << ", but '" << cfg.path << "' is not on a hugetlbfs mount";
+                    throw TransportError(tools::ToString("Huge pages requested for region ", id, ", but '", cfg.path, "' is not on a hugetlbfs mount"));
+                }
+                if (fControlling) {
+                    // hugetlbfs files can only be mapped in multiples of the huge page size
+                    size = ((size + hugePageSize - 1) / hugePageSize) * hugePageSize;
+                    cfg.size = size;
+                    LOG(debug) << "Region " << id << " uses huge pages of " << hugePageSize << " bytes, size set to " << size << " bytes";
+                }
+            }
+
             if (fControlling) {
-                // create a file
-                std::filebuf fbuf;
-                if (fbuf.open(fName, std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary)) {
-                    // set the size
-                    fbuf.pubseekoff(size - 1, std::ios_base::beg);
-                    fbuf.sputc(0);
+                if (cfg.hugepages) {
+                    // hugetlbfs does not support write(), set the size via ftruncate
+                    int fd = ::open(fName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+                    if (fd == -1 || ::ftruncate(fd, static_cast<off_t>(size)) == -1) {
+                        int err = errno;
+                        LOG(error) << "Failed to create huge page file " << fName << ". Code: " << err << ", reason: " << strerror(err);
+                        if (fd != -1) {
+                            ::close(fd);
+                        }
+                        throw TransportError(tools::ToString("Failed to create huge page file for shared memory region: ", strerror(err)));
+                    }
+                    ::close(fd);
+                } else {
+                    // create a file
+                    std::filebuf fbuf;
+                    if (fbuf.open(fName, std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary)) {
+                        // set the size
+                        fbuf.pubseekoff(size - 1, std::ios_base::beg);
+                        fbuf.sputc(0);
+                    }
                 }
             }
 
@@ -99,7 +279,18 @@ struct UnmanagedRegion
             }
             fFileMapping = file_mapping(fName.c_str(), read_write);
             LOG(debug) << "UnmanagedRegion(): initialized file: " << fName;
-            fRegion = mapped_region(fFileMapping, read_write, 0, size, 0, cfg.creationFlags);
+            try {
+                fRegion = MapRegion(fFileMapping, 0, size, address, cfg.creationFlags);
+            } catch (interprocess_exception& e) {
+                if (!cfg.hugepages) {
+                    throw;
+                }
+                // mapping a hugetlbfs file reserves the pages, which fails if not enough of them are available
+                LOG(error) << "Failed mapping huge page backed region " << id << ": " << e.what() << ". Free huge pages: " << GetFreeHugePages()
+                           << ". Reserve more via /proc/sys/vm/nr_hugepages (or the hugepages kernel parameter).";
+                throw TransportError(tools::ToString("Failed mapping huge page backed region ", id, ": ", e.what(), ". Free huge pages: ", GetFreeHugePages(),
+                                                     ". Reserve more via /proc/sys/vm/nr_hugepages (or the hugepages kernel parameter)."));
+            }
         } else {
             try {
                 // if opening fails, create
@@ -123,8 +314,9 @@ struct UnmanagedRegion
             }
 
             try {
-                fRegion = mapped_region(fShmemObject, read_write, 0, 0, 0, cfg.creationFlags);
-                if (size != 0 && size != fRegion.get_size()) {
+                // a resizable region is mapped with its maximum size, the memory beyond the current size is not committed
+                fRegion = MapRegion(fShmemObject, 0, fMaxSize, address, cfg.creationFlags);
+                if (fMaxSize == 0 && size != 0 && size != fRegion.get_size()) {
                     LOG(error) << "Created/opened region size (" << fRegion.get_size() << ") does not match configured size (" << size << ")";
                     throw TransportError(tools::ToString("Created/opened region size (", fRegion.get_size(), ") does not match configured size (", size, ")"));
                 }
@@ -134,19 +326,104 @@ struct UnmanagedRegion
             }
         }
 
+        if (fMaxSize > 0) {
+            fSize = CommittedSize();
+        }
+
+        if (fControlling && cfg.numaNode >= 0) {
+            // bind before lock/zero to fault the pages in on the requested node (of a resizable region the whole
+            // mapping, the pages committed later are placed by the same policy)
+            if (!BindToNumaNode(fRegion.get_address(), fRegion.get_size(), cfg.numaNode)) {
+                LOG(error) << "Could not bind region " << id << " to NUMA node " << cfg.numaNode << ". Code: " << errno << ", reason: " << strerror(errno);
+                throw TransportError(tools::ToString("Could not bind region ", id, " to NUMA node ", cfg.numaNode, ": ", strerror(errno)));
+            }
+            LOG(debug) << "Bound region " << id << " to NUMA node " << cfg.numaNode << ".";
+        }
         if (cfg.lock) {
             LOG(debug) << "Locking region " << id << "...";
             Lock();
             LOG(debug) << "Successfully locked region " << id << ".";
         }
-        if (cfg.zero) {
+        if (cfg.zero && (fControlling || !fGpuData)) {
             LOG(debug) << "Zeroing free memory of region " << id << "...";
             Zero();
             LOG(debug) << "Successfully zeroed free memory of region " << id << ".";
         }
+        if (cfg.gpuRegister) {
+            // each process registers its own mapping
+            try {
+                tools::GpuHostRegister(fRegion.get_address(), fRegion.get_size());
+            } catch (tools::GpuError& e) {
+                LOG(error) << "Could not register region " << id << " with the GPU runtime: " << e.what();
+                throw TransportError(tools::ToString("Could not register region ", id, " with the GPU runtime: ", e.what()));
+            }
+            fGpuRegistered = true;
+            LOG(debug) << "Registered region " << id << " with the GPU runtime (" << tools::GpuRuntime() << ").";
+        }
+
+        if (cfg.refCountSlots > 0) {
+            // the controller reserves the slab before the region is registered, viewers open it
+            bool createRefCounts = fControlling && (created || !cfg.path.empty());
+            try {
+                fRefCounts = std::make_unique<RegionRefCounts>(fRefCountsName, cfg.refCountSlots, createRefCounts);
+            } catch (interprocess_exception& e) {
+                if (createRefCounts) {
+                    LOG(error) << "Failed creating ref count slab for region " << id << ": " << e.what();
+                    throw TransportError(tools::ToString("Failed creating ref count slab for region ", id, ": ", e.what()));
+                }
+                if (fControlling) {
+                    // the region memory was kept, but not its slab (Monitor::ResetContent)
+                    LOG(debug) << "Could not open ref count slab for region " << id << ": " << e.what() << ", creating...";
+                    try {
+                        fRefCounts = std::make_unique<RegionRefCounts>(fRefCountsName, cfg.refCountSlots, true);
+                    } catch (interprocess_exception& ce) {
+                        LOG(error) << "Failed creating ref count slab for region " << id << ": " << ce.what();
+                        throw TransportError(tools::ToString("Failed creating ref count slab for region ", id, ": ", ce.what()));
+                    }
+                } else {
+                    LOG(debug) << "Could not open ref count slab for region " << id << ", ref counts of copied messages are allocated in the managed segment: " << e.what();
+                }
+            }
+        }
+
+        if (cfg.crossHost) {
+            // the ring state is behind the region in the shared window, initialized by the host filling the region.
+            // The other host only releases blocks to it
+            bool createRing = fControlling && cfg.ringBuffer;
+            const auto stateOffset = static_cast<offset_t>(RegionRing::StateOffset(cfg.fdOffset, size));
+            try {
+                mapped_region state = fControlling ? mapped_region(DescriptorMapping{cfg.fd}, read_write, stateOffset, RegionRing::kStateAlignment)
+                                                   : mapped_region(fFileMapping, read_write, stateOffset, RegionRing::kStateAlignment);
+                fRing = std::make_unique<RegionRing>(std::move(state), fName, static_cast<char*>(fRegion.get_address()), fRegion.get_size(), createRing);
+            } catch (interprocess_exception& e) {
+                LOG(error) << "Failed mapping ring state of cross-host region " << id << " at offset " << stateOffset << ": " << e.what();
+                throw TransportError(tools::ToString("Failed mapping ring state of cross-host region ", id, " at offset ", stateOffset, ": ", e.what()));
+            }
+        } else if (cfg.ringBuffer) {
+            // the block headers are in the region, the ring state is created before the region is registered
+            bool createRing = fControlling && (created || !cfg.path.empty());
+            try {
+                fRing = std::make_unique<RegionRing>(fRingName, static_cast<char*>(fRegion.get_address()), fRegion.get_size(), createRing);
+            } catch (interprocess_exception& e) {
+                LOG(error) << "Failed " << (createRing ? "creating" : "opening") << " ring of ring buffer region " << id << ": " << e.what();
+                throw TransportError(tools::ToString("Failed ", (createRing ? "creating" : "opening"), " ring of ring buffer region ", id, ": ", e.what()));
+            }
+        } else if (cfg.slotSize > 0) {
+            // the free list is in the region, initialized before the region is registered
+            fSlots = std::make_unique<RegionSlots>(fName, static_cast<char*>(fRegion.get_address()), fRegion.get_size(), cfg.slotSize, fControlling && (created || !cfg.path.empty()));
+        }
 
         if (fControlling && created) {
-            Register(shmId, cfg);
+            try {
+                Register(shmId, cfg, fGpuIpcHandle, address == fRegion.get_address() ? address : nullptr);
+            } catch (...) {
+                // the destructor does not run, device memory is not released with the process' mappings
+                ReleaseGpuMemory();
+                if (fMemfd != -1) {
+                    ::close(fMemfd);
+                }
+                throw;
+            }
         }
 
         LOG(debug) << (created ? "Created" : "Opened") << " unmanaged shared memory region: " << fName << " (" << (fControlling ? "controller" : "viewer") << ")";
@@ -161,25 +438,119 @@ struct UnmanagedRegion
 
     void BecomeController(RegionConfig& cfg)
     {
+        if (fGpuData || cfg.gpuDevice >= 0) {
+            // the device memory belongs to the process that allocated it
+            LOG(error) << "Cannot take over GPU device memory region " << fName << ", it is still opened as a viewer";
+            throw TransportError(tools::ToString("Cannot take over GPU device memory region ", fName, ", it is still opened as a viewer"));
+        }
         fControlling = true;
+        if (fMaxSize > 0) {
+            fSize = CommittedSize();
+        }
         fLinger = cfg.linger;
         fRemoveOnDestruction = cfg.removeOnDestruction;
+        fAckCallbackThreads = cfg.ackCallbackThreads;
+        fAckSharding = cfg.ackSharding;
+        {
+            std::lock_guard<std::mutex> lock(fBlockMtx);
+            fAckMaxDelay = std::chrono::microseconds(cfg.ackMaxDelayUs);
+            fAckAdaptive = cfg.ackAdaptive;
+        }
+        if (cfg.numaNode >= 0) {
+            fThreadNumaNode = cfg.numaNode;
+        }
+    }
+
+    // NUMA node for the ack threads, if not already set by the region config, and their CPU affinity/scheduling.
+    // Must be called before starting them
+    void SetDefaultThreadSettings(int node, const tools::ThreadSettings& settings)
+    {
+        if (fThreadNumaNode < 0) {
+            fThreadNumaNode = node;
+        }
+        fThreadSettings = settings;
     }
 
+    // runs the ack sender/receiver on the reactor (--shm-ack-reactor) instead of own threads. Must be called before starting them
+    void SetAckReactor(AckReactor* reactor) { fAckReactor = reactor; }
+
     void Zero()
     {
-        memset(fRegion.get_address(), 0x00, fRegion.get_size());
+        if (fGpuData) {
+            tools::GpuMemset(fGpuDevice, fGpuData, 0x00, fGpuSize);
+            return;
+        }
+        memset(fRegion.get_address(), 0x00, GetSize());
     }
     void Lock()
     {
-        if (mlock(fRegion.get_address(), fRegion.get_size()) == -1) {
+        if (mlock(fRegion.get_address(), GetSize()) == -1) {
             LOG(error) << "Could not lock region " << fName << ". Code: " << errno << ", reason: " << strerror(errno);
             throw TransportError(tools::ToString("Could not lock region ", fName, ": ", strerror(errno)));
         }
+        fLocked = true;
     }
 
-    void* GetData() const { return fRegion.get_address(); }
-    size_t GetSize() const { return fRegion.get_size(); }
+    // grows or shrinks a resizable region (RegionConfig::maxSize) by truncating its memory object. The mappings of all
+    // processes span maxSize from the start, so nothing is remapped and the region keeps its address
+    bool Resize(size_t size)
+    {
+        if (!fControlling || fMaxSize == 0) {
+            LOG(error) << "Cannot resize region " << fName << ", only the owner of a region with a maxSize can resize it";
+            return false;
+        }
+        if (size == 0 || size > fMaxSize) {
+            LOG(error) << "Cannot resize region " << fName << " to " << size << " bytes, the size has to be between 1 and " << fMaxSize;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(fResizeMtx);
+        const size_t current = fSize;
+        if (size < current) {
+            fSize = size; // no new messages in the released part
+        }
+        if (::ftruncate(BackingFd(), static_cast<off_t>(size)) == -1) {
+            LOG(error) << "Could not resize region " << fName << " to " << size << " bytes. Code: " << errno << ", reason: " << strerror(errno);
+            fSize = current;
+            return false;
+        }
+        if (fLocked && size > current && mlock(static_cast<char*>(fRegion.get_address()) + current, size - current) == -1) {
+            LOG(warn) << "Could not lock the added " << size - current << " bytes of region " << fName << ". Code: " << errno << ", reason: " << strerror(errno);
+        }
+        fSize = size;
+        LOG(debug) << "Resized region " << fName << " from " << current << " to " << size << " bytes";
+        return true;
+    }
+
+    // device pointer for RegionConfig::gpuDevice regions
+    void* GetData() const { return fGpuData ? fGpuData : fRegion.get_address(); }
+    // nullptr if the region has no ref count slab (RegionConfig::refCountSlots)
+    RegionRefCounts* GetRefCounts() const { return fRefCounts.get(); }
+    // nullptr if the region is not a ring buffer (RegionConfig::ringBuffer)
+    RegionRing* GetRing() const { return fRing.get(); }
+    // nullptr if the region is not a slot pool (RegionConfig::slotSize)
+    RegionSlots* GetSlots() const { return fSlots.get(); }
+    // of a resizable region the current size, viewers get it from the memory object (the owner may resize it any time)
+    size_t GetSize() const
+    {
+        if (fMaxSize > 0) {
+            return fControlling ? fSize.load() : CommittedSize();
+        }
+        return fGpuData ? fGpuSize : fRegion.get_size();
+    }
+
+    // blocks released locally whose acks have not been sent to the region owner yet
+    size_t GetNumPendingAcks() const
+    {
+        return (fReleasedBlocks ? fReleasedBlocks->Size() : 0) + fNumOverflowBlocks.load(std::memory_order_relaxed);
+    }
+    // acks sent but not yet received by the region owner: blocks in the ack ring or ack messages in the queue
+    size_t GetNumQueuedAcks() const
+    {
+        if (fAckRing) {
+            return fAckRing->Size();
+        }
+        return fQueue ? fQueue->get_num_msg() : 0;
+    }
 
     void SetLinger(uint32_t linger) { fLinger = linger; }
     uint32_t GetLinger() const { return fLinger; }
@@ -189,12 +560,15 @@ struct UnmanagedRegion
     ~UnmanagedRegion()
     {
         LOG(debug) << "~UnmanagedRegion(): " << fName << " (" << (fControlling ? "controller" : "viewer") << ")";
-        fStopAcks = true;
+        if (!fStopAcks) {
+            RequestStopAcks(std::chrono::steady_clock::now() + std::chrono::milliseconds(fLinger));
+        }
 
         if (fAcksSender.joinable()) {
-            fBlockSendCV.notify_one();
+            fAckWaiter.Notify();
             fAcksSender.join();
         }
+        WaitForReactorTasks();
 
         if (fControlling) {
             if (fAcksReceiver.joinable()) {
@@ -208,11 +582,21 @@ struct UnmanagedRegion
                 if (Monitor::RemoveFileMapping(fName.c_str())) {
                     LOG(trace) << "File mapping '" << fName << "' destroyed.";
                 }
+                if (fRefCounts && Monitor::RemoveObject(fRefCountsName.c_str())) {
+                    LOG(trace) << "Region ref count slab '" << fRefCountsName << "' destroyed.";
+                }
+                if (fRing && !fCrossHost && Monitor::RemoveObject(fRingName.c_str())) {
+                    LOG(trace) << "Region ring '" << fRingName << "' destroyed.";
+                }
             } else {
                 LOG(debug) << "Skipping removal of " << fName << " unmanaged region, because RegionConfig::removeOnDestruction is false";
             }
 
-            if (boost::interprocess::message_queue::remove(fQueueName.c_str())) {
+            if (fUseAckRing) {
+                if (Monitor::RemoveObject(fAckRingName.c_str())) {
+                    LOG(trace) << "Region ack ring '" << fAckRingName << "' destroyed.";
+                }
+            } else if (boost::interprocess::message_queue::remove(fQueueName.c_str())) {
                 LOG(trace) << "Region queue '" << fQueueName << "' destroyed.";
             } else {
                 LOG(debug) << "Region queue '" << fQueueName << "' not destroyed.";
@@ -221,33 +605,108 @@ struct UnmanagedRegion
             if (fFile) {
                 fclose(fFile);
             }
+            if (fMemfd != -1) {
+                ::close(fMemfd); // the memory is freed by the kernel once the viewers have unmapped it as well
+            }
         } else {
             // LOG(debug) << "Region queue '" << fQueueName << "' is viewer, no cleanup necessary";
         }
 
+        if (fGpuRegistered) {
+            try {
+                tools::GpuHostUnregister(fRegion.get_address());
+            } catch (tools::GpuError& e) {
+                LOG(warn) << "Could not unregister region " << fName << " from the GPU runtime: " << e.what();
+            }
+        }
+        ReleaseGpuMemory();
+
         // LOG(debug) << "Region '" << fName << "' (" << (fControlling ? "controller" : "viewer") << ") destructed.";
     }
 
   private:
+    // maps a descriptor that is owned by the caller (RegionConfig::fd)
+    struct DescriptorMapping
+    {
+        int fFd;
+        boost::interprocess::mapping_handle_t get_mapping_handle() const { return boost::interprocess::ipcdetail::mapping_handle_from_file_handle(fFd); }
+    };
+
     bool fControlling;
     bool fRemoveOnDestruction;
     uint32_t fLinger;
+    int fThreadNumaNode;
+    tools::ThreadSettings fThreadSettings;
     std::atomic<bool> fStopAcks;
+    std::chrono::steady_clock::time_point fStopDeadline; // acks are collected until then after a stop, written before fStopAcks
     std::string fName;
     std::string fQueueName;
+    std::string fAckRingName;
+    std::string fRefCountsName;
+    std::string fRingName;
     boost::interprocess::shared_memory_object fShmemObject;
     FILE* fFile;
     boost::interprocess::file_mapping fFileMapping;
+    int fMemfd; // file descriptor of a RegionConfig::memfd region, held by the controller
     boost::interprocess::mapped_region fRegion;
+    std::unique_ptr<RegionRefCounts> fRefCounts;
+    std::unique_ptr<RegionRing> fRing; // RegionConfig::ringBuffer, acknowledged cumulatively instead of via fQueue/fAckRing
+    bool fCrossHost; // fRing is in the memory window shared with another host
+    std::unique_ptr<RegionSlots> fSlots; // RegionConfig::slotSize, released to the free list in the region instead of acknowledged
+    int fGpuDevice;
+    void* fGpuData; // RegionConfig::gpuDevice: allocated by the controller, IPC mapping of the viewers
+    size_t fGpuSize;
+    tools::GpuIpcHandle fGpuIpcHandle;
+    bool fGpuRegistered; // RegionConfig::gpuRegister
+    uint64_t fMaxSize; // RegionConfig::maxSize, size of the mapping of a resizable region
+    std::atomic<size_t> fSize; // current size of a resizable region, set by its owner (Resize())
+    std::mutex fResizeMtx;
+    bool fLocked; // RegionConfig::lock, the committed part of a resizable region stays locked
 
     std::mutex fBlockMtx;
-    std::condition_variable fBlockSendCV;
-    std::vector<RegionBlock> fBlocksToFree;
-    const std::size_t fAckBunchSize = 256;
+    std::unique_ptr<tools::MpmcQueue<RegionBlock>> fReleasedBlocks; // blocks released by the threads of the process, until acked
+    std::vector<RegionBlock> fBlocksToFree; // released while fReleasedBlocks was full (or not yet created)
+    std::atomic<size_t> fNumOverflowBlocks; // fBlocksToFree.size()
+    std::atomic<uint64_t> fNumAcksSent; // blocks taken for sending by this process, published with --shm-stats-interval
+    std::atomic<uint64_t> fNumAcksReceived; // blocks received by the controller
+    std::size_t fAckBunchSize; // max blocks per ack message, fixed once the queue is initialized
+    std::chrono::microseconds fAckMaxDelay;
+    bool fAckAdaptive;
+    std::atomic<bool> fAckIdle; // the region owner keeps up with the acks (adaptive mode)
+    tools::SpinParkWaiter fAckWaiter; // of the ack sender, for a bunch of released blocks or a stop
     std::unique_ptr<boost::interprocess::message_queue> fQueue;
+    bool fUseAckRing;
+    boost::interprocess::managed_shared_memory fAckRingSegment;
+    AckRing* fAckRing; // used instead of fQueue with RegionConfig::ackRing
+
+    // executes the region callbacks for its share of the received blocks (RegionConfig::ackCallbackThreads)
+    struct AckWorker
+    {
+        std::mutex fMtx;
+        std::condition_variable fCV;
+        std::vector<RegionBlock> fBlocks;
+        bool fStop = false;
+        std::thread fThread;
+    };
+    uint32_t fAckCallbackThreads;
+    RegionAckSharding fAckSharding;
+    std::vector<std::unique_ptr<AckWorker>> fAckWorkers;
+    std::vector<std::vector<RegionBlock>> fAckShards; // used by the ack receiver only
+    size_t fNextAckWorker;
 
     std::thread fAcksReceiver;
     std::thread fAcksSender;
+
+    // ack sender/receiver on the reactor of the transport (--shm-ack-reactor), used by the reactor thread only
+    AckReactor* fAckReactor;
+    uint64_t fReactorSender; // task ids, 0: not running
+    uint64_t fReactorReceiver;
+    std::unique_ptr<RegionBlock[]> fReactorBlocks; // collected, not yet sent (fReactorBlocksToSend)
+    size_t fReactorBlocksToSend;
+    std::chrono::steady_clock::time_point fReactorPendingSince; // of the oldest pending ack, max() if none
+    std::vector<RegionBlock> fReactorReceived;
+    std::vector<fair::mq::RegionBlock> fReactorResult;
+
     RegionCallback fCallback;
     RegionBulkCallback fBulkCallback;
 
@@ -258,7 +717,7 @@ struct UnmanagedRegion
         return regionCfg;
     }
 
-    static void Register(const std::string& shmId, const RegionConfig& cfg)
+    static void Register(const std::string& shmId, const RegionConfig& cfg, const tools::GpuIpcHandle& gpuIpcHandle = {}, const void* address = nullptr)
     {
         using namespace boost::interprocess;
         LOG(debug) << "Registering unmanaged shared memory region with id " << cfg.id.value();
@@ -275,8 +734,73 @@ struct UnmanagedRegion
             throw TransportError(tools::ToString("Unmanaged Region with id ", cfg.id.value(), " has already been registered. Only unique IDs per session are allowed."));
         }
 
-        shmRegions->emplace(cfg.id.value(), RegionInfo(cfg.path.c_str(), cfg.creationFlags, cfg.userFlags, cfg.size, alloc));
-        (eventCounter->fCount)++;
+        std::pair<Uint16RegionInfoHashMap::iterator, bool> res;
+        try {
+            res = shmRegions->emplace(cfg.id.value(), RegionInfo(cfg.path.c_str(), cfg.creationFlags, cfg.userFlags, cfg.size, alloc));
+        } catch (bad_alloc&) {
+            LOG(error) << "Management segment is full (" << mngSegment.get_size() << " bytes, " << shmRegions->size() << " regions), cannot register region " << cfg.id.value() << ". Increase --shm-management-segment-size.";
+            throw TransportError(tools::ToString("Management segment is full (", mngSegment.get_size(), " bytes, ", shmRegions->size(), " regions), cannot register region ", cfg.id.value(), ". Increase --shm-management-segment-size."));
+        }
+        res.first->second.fAckBunchSize = cfg.ackBunchSize;
+        res.first->second.fAckMaxDelayUs = cfg.ackMaxDelayUs;
+        res.first->second.fAckAdaptive = cfg.ackAdaptive;
+        res.first->second.fAckRing = cfg.ackRing;
+        res.first->second.fRefCountSlots = cfg.refCountSlots;
+        res.first->second.fGpuRegister = cfg.gpuRegister;
+        res.first->second.fGpuDevice = cfg.gpuDevice;
+        res.first->second.fGpuIpcHandle = gpuIpcHandle;
+        res.first->second.fMemfd = cfg.memfd;
+        res.first->second.fFdOffset = cfg.fdOffset;
+        res.first->second.fAddress = reinterpret_cast<uint64_t>(address);
+        res.first->second.fRingBuffer = cfg.ringBuffer || cfg.crossHost;
+        res.first->second.fCrossHost = cfg.crossHost;
+        res.first->second.fSlotSize = cfg.slotSize;
+        res.first->second.fMaxSize = cfg.maxSize;
+        eventCounter->Increment(cfg.id.value(), false, false);
+    }
+
+    // a resizable region is always a shared memory object (memfds are sealed against resizing)
+    int BackingFd() const { return fShmemObject.get_mapping_handle().handle; }
+    size_t CommittedSize() const
+    {
+        struct stat st;
+        if (::fstat(BackingFd(), &st) == -1) {
+            return 0;
+        }
+        return std::min(static_cast<size_t>(st.st_size), static_cast<size_t>(fMaxSize));
+    }
+
+    // maps at address (if not nullptr), falls back to any address
+    template<typename M>
+    boost::interprocess::mapped_region MapRegion(const M& mappable, boost::interprocess::offset_t offset, size_t size, const void* address, int flags)
+    {
+        using namespace boost::interprocess;
+        if (address) {
+            try {
+                return mapped_region(mappable, read_write, offset, size, address, flags);
+            } catch (interprocess_exception& e) {
+                LOG(warn) << "Could not map region " << fName << " at its fixed address " << address << ": " << e.what() << ". Mapping at any address, raw pointers into it are not valid in this process.";
+            }
+        }
+        return mapped_region(mappable, read_write, offset, size, nullptr, flags);
+    }
+
+    // device memory lives as long as the controller, viewers unmap it
+    void ReleaseGpuMemory()
+    {
+        if (!fGpuData) {
+            return;
+        }
+        try {
+            if (fControlling) {
+                tools::GpuFree(fGpuDevice, fGpuData);
+            } else {
+                tools::GpuIpcClose(fGpuDevice, fGpuData);
+            }
+        } catch (tools::GpuError& e) {
+            LOG(warn) << "Could not release GPU device memory of region " << fName << ": " << e.what();
+        }
+        fGpuData = nullptr;
     }
 
     void SetCallbacks(RegionCallback callback, RegionBulkCallback bulkCallback)
@@ -288,93 +812,409 @@ struct UnmanagedRegion
     void InitializeQueues()
     {
         using namespace boost::interprocess;
-        if (!fQueue) {
+        if (fRing || fSlots) {
+            return;
+        }
+        if (!fReleasedBlocks) {
+            fReleasedBlocks = std::make_unique<tools::MpmcQueue<RegionBlock>>(std::max<size_t>(4 * fAckBunchSize, 4096));
+        }
+        if (fUseAckRing) {
+            if (!fAckRing) {
+                // room for a few bunches in flight
+                size_t capacity = 65536;
+                while (capacity < 4 * fAckBunchSize) {
+                    capacity *= 2;
+                }
+                fAckRingSegment = managed_shared_memory(open_or_create, fAckRingName.c_str(), capacity * sizeof(RingCell<RegionBlock>) + 65536);
+                fAckRing = fAckRingSegment.find_or_construct<AckRing>(unique_instance)(capacity, fAckRingSegment.get_segment_manager());
+                fAckBunchSize = std::min(fAckBunchSize, fAckRing->Capacity());
+                LOG(trace) << "shmem: initialized region ack ring: " << fAckRingName << " (capacity: " << fAckRing->Capacity() << ")";
+            }
+        } else if (!fQueue) {
             fQueue = std::make_unique<message_queue>(open_or_create, fQueueName.c_str(), 1024, fAckBunchSize * sizeof(RegionBlock));
+            // the queue may have been created by another process with a smaller message size
+            fAckBunchSize = std::min(fAckBunchSize, static_cast<size_t>(fQueue->get_max_msg_size() / sizeof(RegionBlock)));
             LOG(trace) << "shmem: initialized region queue: " << fQueueName;
         }
     }
 
     void StartAckSender()
     {
-        if (!fAcksSender.joinable()) {
+        if (fRing || fSlots) {
+            return;
+        }
+        if (fAckReactor) {
+            if (fReactorSender == 0) {
+                fReactorBlocks = std::make_unique<RegionBlock[]>(fAckBunchSize);
+                fReactorSender = fAckReactor->Add([this](bool& done) { return PollAckSender(done); });
+            }
+        } else if (!fAcksSender.joinable()) {
             fAcksSender = std::thread(&UnmanagedRegion::SendAcks, this);
         }
     }
+    void ApplyThreadSettings(const char* thread)
+    {
+        if (fThreadNumaNode >= 0 && !SetThreadNumaAffinity(fThreadNumaNode)) {
+            LOG(warn) << "Could not pin " << thread << " of " << fName << " to NUMA node " << fThreadNumaNode << ": " << strerror(errno);
+        }
+        if (!fThreadSettings.Empty() && !tools::ApplyThreadSettings(fThreadSettings)) {
+            LOG(warn) << "Could not apply the CPU affinity/scheduling settings to " << thread << " of " << fName << ": " << strerror(errno);
+        }
+    }
+
     void SendAcks()
     {
+        ApplyThreadSettings("AcksSender");
         std::unique_ptr<RegionBlock[]> blocks = std::make_unique<RegionBlock[]>(fAckBunchSize);
         size_t blocksToSend = 0;
 
         while (true) {
-            {
-                std::unique_lock<std::mutex> lock(fBlockMtx);
-
-                // try to get <fAckBunchSize> blocks
-                if (fBlocksToFree.size() < fAckBunchSize) {
-                    fBlockSendCV.wait_for(lock, std::chrono::milliseconds(500));
+            // try to get <fAckBunchSize> blocks, in adaptive mode send right away while the receiver is idle
+            auto ready = [this]() {
+                const size_t pending = GetNumPendingAcks();
+                return pending >= fAckBunchSize || fStopAcks || (fAckAdaptive && fAckIdle && pending > 0);
+            };
+            const auto deadline = std::chrono::steady_clock::now() + fAckMaxDelay;
+            while (true) {
+                const auto now = std::chrono::steady_clock::now();
+                auto until = fAckAdaptive ? std::min(deadline, now + std::chrono::milliseconds(1)) : deadline;
+                auto timeout = std::max(std::chrono::duration_cast<std::chrono::microseconds>(until - now), std::chrono::microseconds(0));
+                if (fAckWaiter.Wait(ready, timeout) || std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+                if (GetNumPendingAcks() > 0) {
+                    // the receiver may have drained the queue in the meantime
+                    fAckIdle = fAckRing ? fAckRing->Empty() : fQueue->get_num_msg() == 0;
                 }
-
-                // send whatever blocks we have
-                blocksToSend = std::min(fBlocksToFree.size(), fAckBunchSize);
-
-                copy_n(fBlocksToFree.end() - blocksToSend, blocksToSend, blocks.get());
-                fBlocksToFree.resize(fBlocksToFree.size() - blocksToSend);
             }
 
-            if (blocksToSend > 0) {
-                while (!fQueue->try_send(blocks.get(), blocksToSend * sizeof(RegionBlock), 0) && !fStopAcks) {
+            // send whatever blocks we have
+            blocksToSend = CollectAcks(blocks.get());
+            bool sent = true;
+            if (blocksToSend > 0 && fAckRing) {
+                while (!(sent = fAckRing->TryPush(blocks.get(), blocksToSend)) && !fStopAcks) {
+                    // receiver slow? wait for it to make room
+                    fAckRing->WaitForSpace(blocksToSend, 10);
+                }
+                if (fAckAdaptive) {
+                    // only our own blocks are pending -> the receiver keeps up
+                    fAckIdle = fAckRing->Size() <= blocksToSend;
+                }
+            } else if (blocksToSend > 0) {
+                while (!(sent = fQueue->try_send(blocks.get(), blocksToSend * sizeof(RegionBlock), 0)) && !fStopAcks) {
                     // receiver slow? yield and try again...
                     std::this_thread::yield();
                 }
+                if (fAckAdaptive) {
+                    // only our own message is pending -> the receiver keeps up
+                    fAckIdle = fQueue->get_num_msg() <= 1;
+                }
                 // LOG(debug) << "Sent " << blocksToSend << " blocks.";
             } else { // blocksToSend == 0
                 if (fStopAcks) {
                     break;
                 }
             }
+            if (!sent) {
+                // the receiver did not make room before the stop
+                LOG(trace) << "AcksSender for " << fName << " dropping " << blocksToSend << " blocks after a stop.";
+            }
         }
 
-        LOG(trace) << "AcksSender for " << fName << " leaving " << "(blocks left to free: " << fBlocksToFree.size() << ", "
+        LOG(trace) << "AcksSender for " << fName << " leaving " << "(blocks left to free: " << GetNumPendingAcks() << ", "
                                                                 << " blocks left to send: " << blocksToSend << ").";
     }
 
+    // takes up to fAckBunchSize released blocks into blocks, those that did not fit into the queue first
+    size_t CollectAcks(RegionBlock* blocks)
+    {
+        size_t numBlocks = 0;
+        if (fNumOverflowBlocks.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(fBlockMtx);
+            numBlocks = std::min(fBlocksToFree.size(), fAckBunchSize);
+            copy_n(fBlocksToFree.end() - numBlocks, numBlocks, blocks);
+            fBlocksToFree.resize(fBlocksToFree.size() - numBlocks);
+            fNumOverflowBlocks = fBlocksToFree.size();
+        }
+        while (numBlocks < fAckBunchSize && fReleasedBlocks && fReleasedBlocks->TryPop(blocks[numBlocks])) {
+            ++numBlocks;
+        }
+
+        if (numBlocks > 0) {
+            FAIRMQ_PROBE(region_ack_send, fName.c_str(), numBlocks);
+            fNumAcksSent.fetch_add(numBlocks, std::memory_order_relaxed);
+        }
+        return numBlocks;
+    }
+
+    // SendAcks() on the reactor: one non-blocking step, returns true if a bunch was sent
+    bool PollAckSender(bool& done)
+    {
+        if (fReactorBlocksToSend == 0) {
+            const size_t pending = GetNumPendingAcks();
+            if (pending == 0) {
+                done = fStopAcks;
+                return false;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (fReactorPendingSince == std::chrono::steady_clock::time_point::max()) {
+                fReactorPendingSince = now;
+            }
+            if (fAckAdaptive && !fAckIdle) {
+                // the receiver may have drained the queue in the meantime
+                fAckIdle = fAckRing ? fAckRing->Empty() : fQueue->get_num_msg() == 0;
+            }
+            if (pending < fAckBunchSize && !fStopAcks && !(fAckAdaptive && fAckIdle) && now - fReactorPendingSince < fAckMaxDelay) {
+                return false;
+            }
+            fReactorPendingSince = std::chrono::steady_clock::time_point::max();
+            fReactorBlocksToSend = CollectAcks(fReactorBlocks.get());
+        }
+
+        // a full queue is retried in the next round, given up after a stop (like SendAcks())
+        const size_t numBlocks = fReactorBlocksToSend;
+        const bool sent = fAckRing ? fAckRing->TryPush(fReactorBlocks.get(), numBlocks)
+                                   : fQueue->try_send(fReactorBlocks.get(), numBlocks * sizeof(RegionBlock), 0);
+        if (!sent) {
+            if (fStopAcks) {
+                LOG(trace) << "Ack sender of " << fName << " on the reactor dropping " << numBlocks << " blocks after a stop.";
+                fReactorBlocksToSend = 0;
+            }
+            return false;
+        }
+        fReactorBlocksToSend = 0;
+        if (fAckAdaptive) {
+            // only our own blocks are pending -> the receiver keeps up
+            fAckIdle = fAckRing ? fAckRing->Size() <= numBlocks : fQueue->get_num_msg() <= 1;
+        }
+        return true;
+    }
+
     void StartAckReceiver()
     {
-        if (!fAcksReceiver.joinable()) {
+        if (fRing || fSlots) {
+            return;
+        }
+        if (fAckReactor) {
+            if (fReactorReceiver == 0) {
+                StartAckWorkers();
+                if (fAckRing) {
+                    fReactorReceived.reserve(fAckBunchSize);
+                } else {
+                    fReactorReceived.resize(fQueue->get_max_msg_size() / sizeof(RegionBlock));
+                }
+                fReactorReceiver = fAckReactor->Add([this](bool& done) { return PollAckReceiver(done); });
+            }
+        } else if (!fAcksReceiver.joinable()) {
             fAcksReceiver = std::thread(&UnmanagedRegion::ReceiveAcks, this);
         }
     }
+
+    // ReceiveAcks() on the reactor: delivers the available acks (a limited number of bunches per round, for the other
+    // regions), returns true if there were any. Finishes once the linger of a stop has passed
+    bool PollAckReceiver(bool& done)
+    {
+        const bool leave = fStopAcks && LingerLeft() == 0;
+        bool progress = false;
+        for (int i = 0; i < 16; ++i) {
+            if (fAckRing) {
+                fReactorReceived.clear();
+                if (fAckRing->TryPop(fReactorReceived) == 0) {
+                    break;
+                }
+                DeliverAcks(fReactorReceived.data(), fReactorReceived.size(), fReactorResult);
+            } else {
+                unsigned int priority = 0;
+                boost::interprocess::message_queue::size_type recvdSize = 0;
+                if (!fQueue->try_receive(fReactorReceived.data(), fReactorReceived.size() * sizeof(RegionBlock), recvdSize, priority)) {
+                    break;
+                }
+                DeliverAcks(fReactorReceived.data(), recvdSize / sizeof(RegionBlock), fReactorResult);
+            }
+            progress = true;
+        }
+        done = leave;
+        return progress;
+    }
+
+    // waits for the ack sender/receiver of the region on the reactor to finish, after RequestStopAcks()
+    void WaitForReactorTasks()
+    {
+        if (fReactorSender != 0) {
+            fAckReactor->WaitDone(fReactorSender);
+            fReactorSender = 0;
+        }
+        if (fReactorReceiver != 0) {
+            fAckReactor->WaitDone(fReactorReceiver);
+            fReactorReceiver = 0;
+            StopAckWorkers();
+        }
+    }
+    void StartAckWorkers()
+    {
+        for (uint32_t i = 0; i < fAckCallbackThreads; ++i) {
+            auto worker = std::make_unique<AckWorker>();
+            worker->fThread = std::thread(&UnmanagedRegion::RunAckWorker, this, worker.get());
+            fAckWorkers.push_back(std::move(worker));
+        }
+        fAckShards.resize(fAckWorkers.size());
+    }
+
+    void StopAckWorkers()
+    {
+        for (auto& worker : fAckWorkers) {
+            {
+                std::lock_guard<std::mutex> lock(worker->fMtx);
+                worker->fStop = true;
+            }
+            worker->fCV.notify_one();
+        }
+        for (auto& worker : fAckWorkers) {
+            worker->fThread.join();
+        }
+        fAckWorkers.clear();
+    }
+
+    void RunAckWorker(AckWorker* worker)
+    {
+        ApplyThreadSettings("AckWorker");
+        std::vector<RegionBlock> blocks;
+        std::vector<fair::mq::RegionBlock> result;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(worker->fMtx);
+                worker->fCV.wait(lock, [worker]() { return !worker->fBlocks.empty() || worker->fStop; });
+                if (worker->fBlocks.empty()) {
+                    break; // stopped and drained
+                }
+                std::swap(blocks, worker->fBlocks);
+            }
+            InvokeCallbacks(blocks.data(), blocks.size(), result);
+            blocks.clear();
+        }
+    }
+
+    void PostToAckWorker(size_t i, const RegionBlock* blocks, size_t numBlocks)
+    {
+        AckWorker& worker = *fAckWorkers[i];
+        {
+            std::lock_guard<std::mutex> lock(worker.fMtx);
+            worker.fBlocks.insert(worker.fBlocks.end(), blocks, blocks + numBlocks);
+        }
+        worker.fCV.notify_one();
+    }
+
+    size_t AckShard(const RegionBlock& block) const
+    {
+        uint64_t key = fAckSharding == RegionAckSharding::hint ? block.fHint : static_cast<uint64_t>(block.fHandle);
+        // Fibonacci hashing, spreads aligned addresses/pointers over the shards
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) % fAckWorkers.size();
+    }
+
+    // hands the blocks to the callback threads, or invokes the callbacks directly if there are none
+    void DeliverAcks(const RegionBlock* blocks, size_t numBlocks, std::vector<fair::mq::RegionBlock>& result)
+    {
+        FAIRMQ_PROBE(region_ack_receive, fName.c_str(), numBlocks);
+        fNumAcksReceived.fetch_add(numBlocks, std::memory_order_relaxed);
+        if (fAckWorkers.empty()) {
+            InvokeCallbacks(blocks, numBlocks, result);
+        } else if (fAckSharding == RegionAckSharding::none) {
+            PostToAckWorker(fNextAckWorker, blocks, numBlocks);
+            fNextAckWorker = (fNextAckWorker + 1) % fAckWorkers.size();
+        } else {
+            for (size_t i = 0; i < numBlocks; ++i) {
+                fAckShards[AckShard(blocks[i])].push_back(blocks[i]);
+            }
+            for (size_t s = 0; s < fAckShards.size(); ++s) {
+                if (!fAckShards[s].empty()) {
+                    PostToAckWorker(s, fAckShards[s].data(), fAckShards[s].size());
+                    fAckShards[s].clear();
+                }
+            }
+        }
+    }
+
+    void InvokeCallbacks(const RegionBlock* blocks, size_t numBlocks, std::vector<fair::mq::RegionBlock>& result)
+    {
+        if (fBulkCallback) {
+            result.clear();
+            for (size_t i = 0; i < numBlocks; i++) {
+                result.emplace_back(static_cast<char*>(GetData()) + blocks[i].fHandle, blocks[i].fSize, reinterpret_cast<void*>(blocks[i].fHint));
+            }
+            fBulkCallback(result);
+        } else if (fCallback) {
+            for (size_t i = 0; i < numBlocks; i++) {
+                fCallback(static_cast<char*>(GetData()) + blocks[i].fHandle, blocks[i].fSize, reinterpret_cast<void*>(blocks[i].fHint));
+            }
+        }
+    }
+
+    void ReceiveAcksFromRing()
+    {
+        std::vector<RegionBlock> blocks;
+        blocks.reserve(fAckBunchSize);
+        std::vector<fair::mq::RegionBlock> result;
+        result.reserve(fAckBunchSize);
+
+        while (true) {
+            uint32_t timeout = 100;
+            bool leave = false;
+            if (fStopAcks) {
+                timeout = LingerLeft();
+                leave = true;
+            }
+            auto rcvTill = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+            while (true) {
+                blocks.clear();
+                if (fAckRing->TryPop(blocks) > 0) {
+                    DeliverAcks(blocks.data(), blocks.size(), result);
+                    continue;
+                }
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(rcvTill - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    break;
+                }
+                fAckRing->WaitForData(static_cast<int>(remaining));
+            }
+
+            if (leave) {
+                break;
+            }
+        }
+
+        LOG(trace) << "AcksReceiver for " << fName << " leaving (remaining ring size: " << fAckRing->Size() << ").";
+    }
+
     void ReceiveAcks()
     {
+        ApplyThreadSettings("AcksReceiver");
+        StartAckWorkers();
+        if (fAckRing) {
+            ReceiveAcksFromRing();
+            StopAckWorkers();
+            return;
+        }
         unsigned int priority = 0;
         boost::interprocess::message_queue::size_type recvdSize = 0;
-        std::unique_ptr<RegionBlock[]> blocks = std::make_unique<RegionBlock[]>(fAckBunchSize);
+        const size_t maxBlocks = fQueue->get_max_msg_size() / sizeof(RegionBlock);
+        std::unique_ptr<RegionBlock[]> blocks = std::make_unique<RegionBlock[]>(maxBlocks);
         std::vector<fair::mq::RegionBlock> result;
-        result.reserve(fAckBunchSize);
+        result.reserve(maxBlocks);
 
         while (true) {
             uint32_t timeout = 100;
             bool leave = false;
             if (fStopAcks) {
-                timeout = fLinger;
+                timeout = LingerLeft();
                 leave = true;
             }
             auto rcvTill = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(timeout);
 
-            while (fQueue->timed_receive(blocks.get(), fAckBunchSize * sizeof(RegionBlock), recvdSize, priority, rcvTill)) {
+            while (fQueue->timed_receive(blocks.get(), maxBlocks * sizeof(RegionBlock), recvdSize, priority, rcvTill)) {
                 const auto numBlocks = recvdSize / sizeof(RegionBlock);
                 // LOG(debug) << "Received " << numBlocks << " blocks (recvdSize: " << recvdSize << "). (remaining queue size: " << fQueue->get_num_msg() << ").";
-                if (fBulkCallback) {
-                    result.clear();
-                    for (size_t i = 0; i < numBlocks; i++) {
-                        result.emplace_back(reinterpret_cast<char*>(fRegion.get_address()) + blocks[i].fHandle, blocks[i].fSize, reinterpret_cast<void*>(blocks[i].fHint));
-                    }
-                    fBulkCallback(result);
-                } else if (fCallback) {
-                    for (size_t i = 0; i < numBlocks; i++) {
-                        fCallback(reinterpret_cast<char*>(fRegion.get_address()) + blocks[i].fHandle, blocks[i].fSize, reinterpret_cast<void*>(blocks[i].fHint));
-                    }
-                }
+                DeliverAcks(blocks.get(), numBlocks, result);
             }
 
             if (leave) {
@@ -382,33 +1222,73 @@ struct UnmanagedRegion
             }
         }
 
+        StopAckWorkers();
         LOG(trace) << "AcksReceiver for " << fName << " leaving (remaining queue size: " << fQueue->get_num_msg() << ").";
     }
 
     void ReleaseBlock(const RegionBlock& block)
     {
-        std::unique_lock<std::mutex> lock(fBlockMtx);
+        if (fRing) {
+            fRing->Release(static_cast<size_t>(block.fHandle));
+            return;
+        }
+        if (fSlots) {
+            fSlots->Release(static_cast<size_t>(block.fHandle));
+            return;
+        }
+        if (!fReleasedBlocks || !fReleasedBlocks->TryPush(block)) {
+            std::lock_guard<std::mutex> lock(fBlockMtx);
+            fBlocksToFree.emplace_back(block);
+            fNumOverflowBlocks = fBlocksToFree.size();
+        }
 
-        fBlocksToFree.emplace_back(block);
+        const size_t pending = GetNumPendingAcks();
+        if (pending >= fAckBunchSize || (fAckAdaptive && fAckIdle && pending == 1)) {
+            if (fAckReactor) {
+                fAckReactor->Notify();
+            } else {
+                fAckWaiter.Notify();
+            }
+        }
+    }
 
-        if (fBlocksToFree.size() >= fAckBunchSize) {
-            lock.unlock();
-            fBlockSendCV.notify_one();
+    // lets the ack threads finish: pending acks are sent, outstanding ones are collected until deadline (the linger).
+    // Regions that are removed together share one deadline (Manager::RemoveRegions), their threads linger concurrently
+    void RequestStopAcks(std::chrono::steady_clock::time_point deadline)
+    {
+        {
+            std::lock_guard<std::mutex> lock(fBlockMtx);
+            fStopDeadline = deadline;
+            fStopAcks = true;
+        }
+        fAckWaiter.Notify();
+        if (fAckReactor) {
+            fAckReactor->Notify();
         }
     }
 
+    // milliseconds until the deadline of a stop
+    uint32_t LingerLeft() const
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(fStopDeadline - std::chrono::steady_clock::now()).count();
+        return left > 0 ? static_cast<uint32_t>(left) : 0;
+    }
+
     void StopAcks()
     {
-        fStopAcks = true;
+        if (!fStopAcks) {
+            RequestStopAcks(std::chrono::steady_clock::now() + std::chrono::milliseconds(fLinger));
+        }
 
         if (fAcksSender.joinable()) {
-            fBlockSendCV.notify_one();
+            fAckWaiter.Notify();
             fAcksSender.join();
         }
 
         if (fAcksReceiver.joinable()) {
             fAcksReceiver.join();
         }
+        WaitForReactorTasks();
     }
 };
 
@@ -16,17 +16,20 @@
 #include <fairlogger/Logger.h>
 
 #include <cstddef> // size_t
+#include <mutex>
 
 namespace fair::mq::shmem
 {
 
 class Message;
 class Socket;
+class TransportFactory;
 
 class UnmanagedRegionImpl final : public fair::mq::UnmanagedRegion
 {
     friend class Message;
     friend class Socket;
+    friend class TransportFactory;
 
   public:
     UnmanagedRegionImpl(Manager& manager,
@@ -45,6 +48,15 @@ class UnmanagedRegionImpl final : public fair::mq::UnmanagedRegion
         fRegionId = regionId;
     }
 
+    // an existing region of the session (TransportFactory::OpenUnmanagedRegion()), not removed with this object
+    UnmanagedRegionImpl(Manager& manager, shmem::UnmanagedRegion* region, uint16_t id, fair::mq::TransportFactory* factory)
+        : fair::mq::UnmanagedRegion(factory)
+        , fManager(manager)
+        , fRegion(region)
+        , fRegionId(id)
+        , fOpened(true)
+    {}
+
     UnmanagedRegionImpl(const UnmanagedRegionImpl&) = delete;
     UnmanagedRegionImpl(UnmanagedRegionImpl&&) = delete;
     UnmanagedRegionImpl& operator=(const UnmanagedRegionImpl&) = delete;
@@ -56,14 +68,44 @@ class UnmanagedRegionImpl final : public fair::mq::UnmanagedRegion
     void SetLinger(uint32_t linger) override { fRegion->SetLinger(linger); }
     uint32_t GetLinger() const override { return fRegion->GetLinger(); }
 
+    void* Allocate(size_t size, int timeoutMs = 0) override
+    {
+        if (fRegion->GetSlots()) {
+            return fRegion->GetSlots()->Allocate(size, timeoutMs);
+        }
+        // the other host of a cross-host region fills it
+        if (!fRegion->GetRing() || !fRegion->GetRing()->Owner()) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(fRingMtx);
+        return fRegion->GetRing()->Allocate(size, timeoutMs);
+    }
+    size_t GetFreeSpace() const override
+    {
+        if (fRegion->GetSlots()) {
+            return fRegion->GetSlots()->NumFree() * fRegion->GetSlots()->SlotSize();
+        }
+        return fRegion->GetRing() ? fRegion->GetRing()->FreeSpace() : 0;
+    }
+    uint64_t GetAckedOffset() const override { return fRegion->GetRing() ? fRegion->GetRing()->Tail() : 0; }
+    bool Resize(size_t size) override { return !fOpened && fManager.ResizeRegion(fRegionId, size); }
+
     Transport GetType() const override { return fair::mq::Transport::SHM; }
 
-    ~UnmanagedRegionImpl() override { fManager.RemoveRegion(fRegionId); }
+    ~UnmanagedRegionImpl() override
+    {
+        if (!fRemoved && !fOpened) {
+            fManager.RemoveRegion(fRegionId);
+        }
+    }
 
   private:
     Manager& fManager;
     shmem::UnmanagedRegion* fRegion;
     uint16_t fRegionId;
+    bool fRemoved = false; // removed together with others (TransportFactory::ReleaseRegions)
+    bool fOpened = false;  // region of another process (TransportFactory::OpenUnmanagedRegion())
+    std::mutex fRingMtx;
 };
 
 } // namespace fair::mq::shmem
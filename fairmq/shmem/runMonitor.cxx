@@ -7,6 +7,7 @@
  ********************************************************************************/
 #include "Monitor.h"
 #include "Common.h"
+#include "CommandBoard.h"
 
 #include <boost/program_options.hpp>
 
@@ -16,8 +17,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <algorithm> // count_if
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace boost::program_options;
@@ -88,16 +92,26 @@ int main(int argc, char** argv)
         bool cleanOnExit = false;
         bool getShmId = false;
         bool listAll = false;
+        bool stats = false;
         string listAllPath;
+        vector<string> cleanupSessions;
+        vector<string> cleanupShmIds;
+        bool cleanupAll = false;
+        unsigned int cleanupThreads = 0;
         bool verbose = false;
         string severity;
         int userId = -1;
+        string transition;
 
         options_description desc("Options");
         desc.add_options()
             ("session,s"      , value<string>(&sessionName)->default_value("default"),  "Session id")
             ("shmid"          , value<string>(&shmId)->default_value(""),               "Shmem id (if not provided, it is generated out of session id and user id)")
             ("cleanup,c"      , value<bool>(&cleanup)->implicit_value(true),            "Perform cleanup and quit")
+            ("cleanup-sessions", value<vector<string>>(&cleanupSessions)->multitoken(),  "Clean up the given sessions in one batch and quit (see --cleanup-threads)")
+            ("cleanup-shmids" , value<vector<string>>(&cleanupShmIds)->multitoken(),    "Clean up the given shmem ids in one batch and quit (see --cleanup-threads)")
+            ("cleanup-all"    , value<bool>(&cleanupAll)->implicit_value(true),         "Clean up all sessions found in --list-all-path and quit (only if no devices are running!)")
+            ("cleanup-threads", value<unsigned int>(&cleanupThreads)->default_value(0), "Number of threads for the batched cleanup, 0: one per CPU core")
             ("reset-content,r", value<bool>(&resetContent)->implicit_value(true),       "[EXPERIMENTAL] Reset content of the segments (only call this when segment is not in use)")
             ("self-destruct,x", value<bool>(&selfDestruct)->implicit_value(true),       "Quit after first closing of the memory")
             ("interactive,i"  , value<bool>(&interactive)->implicit_value(true),        "Interactive run")
@@ -110,10 +124,12 @@ int main(int argc, char** argv)
             ("interval"       , value<unsigned int>(&intervalInMS)->default_value(1000),"Output interval for interactive mode")
             ("get-shmid"      , value<bool>(&getShmId)->implicit_value(true),           "Translate given session id and user id to a shmem id (uses current user id if none provided)")
             ("list-all"       , value<bool>(&listAll)->implicit_value(true),            "List all sessions & segments")
-            ("list-all-path"  , value<string>(&listAllPath)->default_value("/dev/shm/"),"Path for the --list-all command to search segments in")
+            ("stats"          , value<bool>(&stats)->implicit_value(true),              "Print the usage counters published by the devices (--shm-stats-interval) as one JSON line per --interval, without locking the session")
+            ("list-all-path"  , value<string>(&listAllPath)->default_value("/dev/shm/"),"Path for the --list-all and batched cleanup commands to search segments in")
             ("verbose"        , value<bool>(&verbose)->implicit_value(true),            "Verbose mode (daemon will output to a file 'fairmq-shmmonitor_<timestamp>')")
             ("severity"       , value<string>(&severity)->default_value("info"),        "Log severity")
             ("user-id"        , value<int>(&userId)->default_value(-1),                 "User id (used with --get-shmid)")
+            ("transition"     , value<string>(&transition),                             "Post a state transition to all devices of the session running with --control board, wait for them (up to --timeout) and quit")
             ("help,h",                                                                  "Print help");
 
         variables_map vm;
@@ -148,6 +164,40 @@ int main(int argc, char** argv)
             return 0;
         }
 
+        if (cleanupAll || !cleanupSessions.empty() || !cleanupShmIds.empty()) {
+            vector<ShmId> shmIds;
+            if (!cleanupAll) {
+                for (const auto& s : cleanupSessions) {
+                    shmIds.push_back(ShmId{makeShmIdStr(s)});
+                }
+                for (const auto& id : cleanupShmIds) {
+                    shmIds.push_back(ShmId{id});
+                }
+            }
+            auto result = Monitor::CleanupBatch(shmIds, listAllPath, cleanupThreads, verbose);
+            size_t numRemoved = count_if(result.begin(), result.end(), [](const auto& r) { return r.second; });
+            LOG(info) << "Removed " << numRemoved << " of " << result.size() << " shared memory objects.";
+            return 0;
+        }
+
+        if (!transition.empty()) {
+            CommandBoard board(shmId);
+            auto start = chrono::steady_clock::now();
+            uint32_t command = board.Post(fair::mq::GetTransition(transition));
+            bool complete = board.WaitForAcks(command, chrono::milliseconds(timeoutInMS));
+            auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            auto acks = board.GetAcks(command);
+            size_t numFailed = 0;
+            for (const auto& ack : acks) {
+                if (!ack.acknowledged || !ack.accepted) {
+                    ++numFailed;
+                    LOG(error) << "device (pid " << ack.pid << "): " << (ack.acknowledged ? "transition rejected in state " + fair::mq::GetStateName(ack.state) : string("no acknowledgement"));
+                }
+            }
+            LOG(info) << transition << ": " << acks.size() - numFailed << " of " << acks.size() << " devices transitioned in " << elapsed << " us";
+            return complete && numFailed == 0 ? 0 : 1;
+        }
+
         if (resetContent) {
             Monitor::ResetContent(ShmId{shmId});
             return 0;
@@ -163,6 +213,11 @@ int main(int argc, char** argv)
             return 0;
         }
 
+        if (stats) {
+            Monitor::StreamStats(ShmId{shmId}, intervalInMS);
+            return 0;
+        }
+
         if (!viewOnly && !interactive && !monitor) {
             // if neither of the run modes are selected, use view only mode.
             viewOnly = true;
@@ -0,0 +1,432 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+// fairmq-shm-replay: replays allocation traces recorded with --shm-alloc-trace against the allocation algorithms of the
+// managed segment and reports throughput, failures, peak usage and peak fragmentation as CSV or JSON. The records of all
+// given trace files (e.g. of all processes of a session) are merged by time. For the throughput every chunk is assigned
+// to one of threads x processes workers, which replay its allocation and deallocation in trace order as fast as possible.
+// Usage and fragmentation are sampled in a second, sequential replay of the merged trace.
+
+#include "AllocTrace.h"
+#include "Common.h"
+
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/program_options.hpp>
+
+#include <sys/mman.h> // mmap
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // fork
+
+#include <algorithm> // stable_sort, max
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <new> // nothrow
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+namespace bpo = boost::program_options;
+using namespace fair::mq;
+using namespace fair::mq::shmem;
+
+namespace
+{
+
+struct Event
+{
+    uint64_t size;
+    uint32_t alignment;
+    uint32_t slot; // of the chunk in its worker
+    bool alloc;
+};
+
+struct Worker
+{
+    vector<Event> events;
+    uint32_t numSlots = 0;
+};
+
+struct TraceSummary
+{
+    uint64_t allocs = 0;
+    uint64_t deallocs = 0;
+    uint64_t unmatched = 0; // deallocations of chunks allocated before the trace or by untraced processes
+    uint64_t failures = 0;
+    uint64_t peakBytes = 0;
+    uint64_t lifetimeNs = 0; // sum over the deallocations with known lifetime
+    uint64_t numLifetimes = 0;
+};
+
+vector<AllocTraceRecord> ReadTraces(const vector<string>& files)
+{
+    vector<AllocTraceRecord> records;
+    for (const auto& file : files) {
+        vector<AllocTraceRecord> fileRecords = ReadAllocTrace(file);
+        records.insert(records.end(), fileRecords.begin(), fileRecords.end());
+    }
+    stable_sort(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.fTimeNs < b.fTimeNs; });
+    return records;
+}
+
+// splits the merged trace into the event lists of numWorkers workers, all events of a chunk go to the same worker
+vector<Worker> Partition(const vector<AllocTraceRecord>& records, size_t numWorkers, TraceSummary& summary)
+{
+    struct Live { size_t worker; uint32_t slot; uint64_t size; };
+    vector<Worker> workers(numWorkers);
+    unordered_map<uint64_t, Live> live;
+    uint64_t liveBytes = 0;
+    summary = TraceSummary();
+
+    for (const auto& r : records) {
+        if (r.fOp == AllocTraceRecord::failure) {
+            ++summary.failures;
+        } else if (r.fOp == AllocTraceRecord::alloc) {
+            const size_t w = ((r.fKey * 0x9e3779b97f4a7c15ULL) >> 32) % numWorkers;
+            Worker& worker = workers[w];
+            worker.events.push_back(Event{r.fSize, r.fAlignment, worker.numSlots, true});
+            live[r.fKey] = Live{w, worker.numSlots++, r.fSize};
+            liveBytes += r.fSize;
+            summary.peakBytes = max(summary.peakBytes, liveBytes);
+            ++summary.allocs;
+        } else {
+            auto it = live.find(r.fKey);
+            if (it == live.end()) {
+                ++summary.unmatched;
+                continue;
+            }
+            workers[it->second.worker].events.push_back(Event{0, 0, it->second.slot, false});
+            liveBytes -= it->second.size;
+            live.erase(it);
+            ++summary.deallocs;
+            if (r.fLifetimeNs > 0) {
+                summary.lifetimeNs += r.fLifetimeNs;
+                ++summary.numLifetimes;
+            }
+        }
+    }
+    return workers;
+}
+
+uint64_t NowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AtomicMax(atomic<uint64_t>& target, uint64_t value)
+{
+    uint64_t current = target.load(memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, memory_order_relaxed)) {}
+}
+
+// results of the workers of all processes, in anonymous shared memory
+struct Shared
+{
+    atomic<int> ready{0};
+    atomic<bool> go{false};
+    atomic<uint64_t> allocs{0};
+    atomic<uint64_t> failures{0};
+    atomic<uint64_t> startNs{0}; // when the workers are released
+    atomic<uint64_t> endNs{0};   // when the last one finished
+};
+
+struct Result
+{
+    uint64_t allocs = 0;
+    uint64_t failures = 0;
+    double seconds = 0;
+    uint64_t peakUsed = 0;
+    double peakFragmentation = 0;
+};
+
+template<typename S>
+void* Allocate(S& segment, const Event& e)
+{
+    return e.alignment > 0 ? segment.allocate_aligned(e.size, e.alignment, nothrow) : segment.allocate(e.size, nothrow);
+}
+
+// replays the events of one worker. With sampleInterval > 0 the usage and fragmentation (1 - largest free block / free
+// memory) are sampled every sampleInterval events, which probes with a temporary allocation (see SegmentLargestFreeBlock)
+template<typename S>
+void Replay(S& segment, const Worker& worker, uint64_t& allocs, uint64_t& failures, size_t sampleInterval, Result* samples)
+{
+    vector<void*> slots(worker.numSlots, nullptr);
+    size_t n = 0;
+    for (const Event& e : worker.events) {
+        if (e.alloc) {
+            slots[e.slot] = Allocate(segment, e);
+            if (slots[e.slot]) {
+                ++allocs;
+            } else {
+                ++failures;
+            }
+        } else if (slots[e.slot]) {
+            segment.deallocate(slots[e.slot]);
+            slots[e.slot] = nullptr;
+        }
+        if (sampleInterval > 0 && ++n % sampleInterval == 0) {
+            const size_t free = segment.get_free_memory();
+            samples->peakUsed = max<uint64_t>(samples->peakUsed, segment.get_size() - free);
+            if (free > 0) {
+                samples->peakFragmentation = max(samples->peakFragmentation, 1. - static_cast<double>(SegmentLargestFreeBlock()(segment)) / free);
+            }
+        }
+    }
+    for (void* ptr : slots) {
+        if (ptr) {
+            segment.deallocate(ptr);
+        }
+    }
+}
+
+// runs threads x processes workers against the segment. The children of a fork share its mapping with the parent
+template<typename S>
+void RunWorkers(S& segment, const vector<Worker>& workers, int threads, int processes, Shared& shared)
+{
+    auto runThreads = [&](int process) {
+        vector<thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t]() {
+                const Worker& worker = workers[process * threads + t];
+                uint64_t allocs = 0;
+                uint64_t failures = 0;
+                shared.ready.fetch_add(1);
+                while (!shared.go.load()) {
+                    this_thread::yield();
+                }
+                Replay(segment, worker, allocs, failures, 0, nullptr);
+                AtomicMax(shared.endNs, NowNs());
+                shared.allocs.fetch_add(allocs);
+                shared.failures.fetch_add(failures);
+            });
+        }
+        for (auto& th : pool) {
+            th.join();
+        }
+    };
+
+    if (processes == 1) {
+        thread runner(runThreads, 0);
+        while (shared.ready.load() < threads) {
+            this_thread::yield();
+        }
+        shared.startNs.store(NowNs());
+        shared.go.store(true);
+        runner.join();
+        return;
+    }
+
+    vector<pid_t> children;
+    for (int p = 0; p < processes; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            runThreads(p);
+            _exit(0);
+        } else if (pid < 0) {
+            throw runtime_error("fork() failed");
+        }
+        children.push_back(pid);
+    }
+    while (shared.ready.load() < threads * processes) {
+        this_thread::yield();
+    }
+    shared.startNs.store(NowNs());
+    shared.go.store(true);
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            throw runtime_error(tools::ToString("replay process ", pid, " failed"));
+        }
+    }
+}
+
+template<typename S>
+Result Run(const vector<AllocTraceRecord>& records, size_t segmentSize, int threads, int processes, size_t sampleInterval)
+{
+    namespace bipc = boost::interprocess;
+    const string name("fmq_replay_" + tools::Uuid());
+    Result result;
+    TraceSummary summary;
+
+    void* mem = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        throw runtime_error("mmap() failed");
+    }
+    Shared* shared = new (mem) Shared();
+
+    try {
+        {
+            S segment(bipc::create_only, name.c_str(), segmentSize);
+            const vector<Worker> workers = Partition(records, threads * processes, summary);
+            RunWorkers(segment, workers, threads, processes, *shared);
+            result.allocs = shared->allocs.load();
+            result.failures = shared->failures.load();
+            result.seconds = static_cast<double>(shared->endNs.load() - shared->startNs.load()) / 1e9;
+        }
+        bipc::shared_memory_object::remove(name.c_str());
+        {
+            S segment(bipc::create_only, name.c_str(), segmentSize);
+            const vector<Worker> sequential = Partition(records, 1, summary);
+            uint64_t allocs = 0;
+            uint64_t failures = 0;
+            Replay(segment, sequential.front(), allocs, failures, sampleInterval, &result);
+        }
+        bipc::shared_memory_object::remove(name.c_str());
+    } catch (...) {
+        bipc::shared_memory_object::remove(name.c_str());
+        munmap(mem, sizeof(Shared));
+        throw;
+    }
+    munmap(mem, sizeof(Shared));
+    return result;
+}
+
+const vector<string> kColumns{"allocation", "threads", "processes", "segment_size", "allocs", "failures", "seconds",
+    "ops_per_s", "peak_used_bytes", "peak_fragmentation"};
+
+vector<string> Row(const string& allocation, int threads, int processes, size_t segmentSize, const TraceSummary& summary, const Result& r)
+{
+    const double ops = static_cast<double>(summary.allocs + summary.deallocs);
+    return {allocation, to_string(threads), to_string(processes), to_string(segmentSize), to_string(r.allocs),
+        to_string(r.failures), tools::ToString(r.seconds), tools::ToString(r.seconds > 0 ? ops / r.seconds : 0),
+        to_string(r.peakUsed), tools::ToString(r.peakFragmentation)};
+}
+
+void Report(ostream& out, const string& format, const vector<vector<string>>& rows)
+{
+    if (format == "json") {
+        out << "[\n";
+        for (size_t i = 0; i < rows.size(); ++i) {
+            out << "  {";
+            for (size_t c = 0; c < kColumns.size(); ++c) {
+                const string value = c == 0 ? "\"" + rows[i][c] + "\"" : rows[i][c];
+                out << (c > 0 ? ", " : "") << "\"" << kColumns[c] << "\": " << value;
+            }
+            out << "}" << (i + 1 < rows.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    } else {
+        for (size_t c = 0; c < kColumns.size(); ++c) {
+            out << (c > 0 ? "," : "") << kColumns[c];
+        }
+        out << "\n";
+        for (const auto& row : rows) {
+            for (size_t c = 0; c < row.size(); ++c) {
+                out << (c > 0 ? "," : "") << row[c];
+            }
+            out << "\n";
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        vector<string> traces;
+        vector<string> allocations;
+        vector<int> threads;
+        vector<int> processes;
+        size_t segmentSize = 0;
+        size_t sampleInterval = 0;
+        string format;
+        string output;
+
+        bpo::options_description desc("Replays shared memory allocation traces (--shm-alloc-trace) against the allocation algorithms");
+        desc.add_options()
+            ("trace", bpo::value<vector<string>>(&traces)->multitoken()->required(), "Trace files, merged by time (e.g. all processes of a session)")
+            ("allocation", bpo::value<vector<string>>(&allocations)->multitoken()->default_value({"rbtree_best_fit", "simple_seq_fit", "slab_fit"}, "rbtree_best_fit simple_seq_fit slab_fit"), "Allocation algorithms")
+            ("threads", bpo::value<vector<int>>(&threads)->multitoken()->default_value({1}, "1"), "Numbers of replay threads per process")
+            ("processes", bpo::value<vector<int>>(&processes)->multitoken()->default_value({1}, "1"), "Numbers of replay processes")
+            ("segment-size", bpo::value<size_t>(&segmentSize)->default_value(0), "Segment size in bytes, 0: twice the peak of the bytes allocated by the trace")
+            ("sample-interval", bpo::value<size_t>(&sampleInterval)->default_value(1024), "Events between two samples of the usage and fragmentation")
+            ("format", bpo::value<string>(&format)->default_value("csv"), "Report format: csv or json")
+            ("output", bpo::value<string>(&output)->default_value(""), "Report file (default: standard output)")
+            ("help", "Print help");
+
+        bpo::variables_map vm;
+        bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help")) {
+            cout << "FairMQ shared memory allocation replay" << endl << desc << endl;
+            return 0;
+        }
+
+        bpo::notify(vm);
+
+        if (format != "csv" && format != "json") {
+            throw runtime_error(tools::ToString("Invalid report format '", format, "', valid are 'csv' and 'json'"));
+        }
+        for (const auto& allocation : allocations) {
+            if (allocation != "rbtree_best_fit" && allocation != "simple_seq_fit" && allocation != "slab_fit") {
+                throw runtime_error(tools::ToString("Invalid allocation algorithm '", allocation, "', valid are 'rbtree_best_fit', 'simple_seq_fit' and 'slab_fit'"));
+            }
+        }
+        for (const auto& n : threads) {
+            if (n < 1) {
+                throw runtime_error(tools::ToString("Invalid number of threads: ", n));
+            }
+        }
+        for (const auto& n : processes) {
+            if (n < 1) {
+                throw runtime_error(tools::ToString("Invalid number of processes: ", n));
+            }
+        }
+
+        const vector<AllocTraceRecord> records = ReadTraces(traces);
+        TraceSummary summary;
+        Partition(records, 1, summary);
+        cerr << "Trace: " << summary.allocs << " allocations, " << summary.deallocs << " deallocations ("
+             << summary.unmatched << " of chunks allocated outside of the trace skipped), " << summary.failures
+             << " failed allocations, peak " << summary.peakBytes << " bytes allocated, mean lifetime "
+             << (summary.numLifetimes > 0 ? summary.lifetimeNs / summary.numLifetimes / 1000 : 0) << " us" << endl;
+        if (segmentSize == 0) {
+            segmentSize = max<size_t>(2 * summary.peakBytes, 1 << 20);
+        }
+
+        vector<vector<string>> rows;
+        for (const auto& allocation : allocations) {
+            for (int t : threads) {
+                for (int p : processes) {
+                    Result result;
+                    if (allocation == "rbtree_best_fit") {
+                        result = Run<RBTreeBestFitSegment>(records, segmentSize, t, p, sampleInterval);
+                    } else if (allocation == "simple_seq_fit") {
+                        result = Run<SimpleSeqFitSegment>(records, segmentSize, t, p, sampleInterval);
+                    } else {
+                        result = Run<SlabFitSegment>(records, segmentSize, t, p, sampleInterval);
+                    }
+                    rows.push_back(Row(allocation, t, p, segmentSize, summary, result));
+                }
+            }
+        }
+
+        if (output.empty()) {
+            Report(cout, format, rows);
+        } else {
+            ofstream file(output);
+            if (!file) {
+                throw runtime_error(tools::ToString("Could not open '", output, "'"));
+            }
+            Report(file, format, rows);
+        }
+
+        return 0;
+    } catch (exception& e) {
+        cerr << "Unhandled Exception reached the top of main: " << e.what() << ", application will now exit" << endl;
+        return 2;
+    }
+}
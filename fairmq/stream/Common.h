@@ -0,0 +1,34 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_STREAM_COMMON_H
+#define FAIR_MQ_STREAM_COMMON_H
+
+#include <fairmq/Transports.h>
+
+#include <cstdint>
+
+// Parts shared by the transports that stream message parts over TCP connections (uring, rdma).
+// They differ in how the data is moved, the message and poller are the same and are instantiated
+// with the socket (and region) type of the transport.
+namespace fair::mq::stream
+{
+
+// event bits returned by Socket::PollResult(), same values as ZMQ_POLLIN/ZMQ_POLLOUT
+constexpr uint32_t kPollIn = 1;
+constexpr uint32_t kPollOut = 2;
+
+template<typename Socket, typename Region, Transport type>
+class Message;
+
+template<typename Socket>
+class Poller;
+
+} // namespace fair::mq::stream
+
+#endif /* FAIR_MQ_STREAM_COMMON_H */
@@ -0,0 +1,175 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_STREAM_POLLER_H
+#define FAIR_MQ_STREAM_POLLER_H
+
+#include <fairlogger/Logger.h>
+#include <fairmq/Channel.h>
+#include <fairmq/Poller.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/stream/Common.h>
+
+#include <poll.h>
+
+#include <algorithm> // min
+#include <cerrno>
+#include <chrono>
+#include <cstring> // strerror
+#include <unordered_map>
+#include <vector>
+
+namespace fair::mq::stream
+{
+
+/// Polls the TCP (and completion) descriptors of the sockets of a stream transport.
+template<typename Socket>
+class Poller final : public fair::mq::Poller
+{
+  public:
+    Poller() = default;
+    Poller(const Poller&) = delete;
+    Poller(Poller&&) = delete;
+    Poller& operator=(const Poller&) = delete;
+    Poller& operator=(Poller&&) = delete;
+
+    Poller(const std::vector<Channel>& channels)
+    {
+        for (const auto& channel : channels) {
+            fSockets.push_back(static_cast<Socket*>(&(channel.GetSocket())));
+        }
+        fEvents.resize(fSockets.size(), 0);
+    }
+
+    Poller(const std::vector<Channel*>& channels)
+    {
+        for (const auto& channel : channels) {
+            fSockets.push_back(static_cast<Socket*>(&(channel->GetSocket())));
+        }
+        fEvents.resize(fSockets.size(), 0);
+    }
+
+    Poller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList)
+    {
+        try {
+            int offset = 0;
+            // calculate offsets and the total size of the poll item set
+            for (std::string const & channel : channelList) {
+                fOffsetMap[channel] = offset;
+                offset += channelsMap.at(channel).size();
+                for (const auto& c : channelsMap.at(channel)) {
+                    fSockets.push_back(static_cast<Socket*>(&(c.GetSocket())));
+                }
+            }
+            fEvents.resize(fSockets.size(), 0);
+        } catch (const std::out_of_range& oor) {
+            LOG(error) << "at least one of the provided channel keys for poller initialization is invalid";
+            LOG(error) << "out of range error: " << oor.what();
+            throw fair::mq::PollerError(fair::mq::tools::ToString("At least one of the provided channel keys for poller initialization is invalid. ", "Out of range error: ", oor.what()));
+        }
+    }
+
+    void Poll(int timeout) override
+    {
+        // poll in slices, new connections are accepted between them
+        constexpr int slice = 100;
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            fFds.clear();
+            fOffsets.clear();
+            for (Socket* socket : fSockets) {
+                socket->UpdatePeers();
+                fOffsets.push_back(fFds.size());
+                socket->AddPollFds(fFds);
+            }
+            if (fWakeupFd >= 0) {
+                fFds.push_back(pollfd{fWakeupFd, POLLIN, 0});
+            }
+
+            int wait = slice;
+            if (timeout >= 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                wait = std::max(0, std::min(slice, timeout - static_cast<int>(elapsed)));
+            }
+            // a partially received multipart message is ready without polling
+            for (Socket* socket : fSockets) {
+                if (socket->fMoreFd >= 0) {
+                    wait = 0;
+                }
+            }
+
+            if (poll(fFds.data(), fFds.size(), wait) < 0) {
+                if (errno == EINTR) {
+                    LOG(debug) << "polling interrupted by system call";
+                    continue;
+                }
+                LOG(error) << "polling failed, reason: " << strerror(errno);
+                throw fair::mq::PollerError(fair::mq::tools::ToString("Polling failed, reason: ", strerror(errno)));
+            }
+
+            bool ready = false;
+            for (size_t i = 0; i < fSockets.size(); ++i) {
+                fEvents[i] = fSockets[i]->PollResult(fFds.data() + fOffsets[i]);
+                ready = ready || fEvents[i] != 0;
+            }
+            if (ready || wait < slice || (fWakeupFd >= 0 && fFds.back().revents != 0)) {
+                return;
+            }
+        }
+    }
+
+    bool CheckInput(int index) override { return fEvents.at(index) & kPollIn; }
+
+    bool CheckOutput(int index) override { return fEvents.at(index) & kPollOut; }
+
+    bool CheckInput(const std::string& channelKey, int index) override
+    {
+        try {
+            return fEvents.at(fOffsetMap.at(channelKey) + index) & kPollIn;
+        } catch (const std::out_of_range& oor) {
+            LOG(error) << "invalid channel key: '" << channelKey << "'";
+            LOG(error) << "out of range error: " << oor.what();
+            throw fair::mq::PollerError(fair::mq::tools::ToString("Invalid channel key '", channelKey, "'. Out of range error: ", oor.what()));
+        }
+    }
+
+    bool CheckOutput(const std::string& channelKey, int index) override
+    {
+        try {
+            return fEvents.at(fOffsetMap.at(channelKey) + index) & kPollOut;
+        } catch (const std::out_of_range& oor) {
+            LOG(error) << "invalid channel key: '" << channelKey << "'";
+            LOG(error) << "out of range error: " << oor.what();
+            throw fair::mq::PollerError(fair::mq::tools::ToString("Invalid channel key '", channelKey, "'. Out of range error: ", oor.what()));
+        }
+    }
+
+    bool AddWakeup(int fd) override
+    {
+        if (fWakeupFd >= 0) {
+            return false; // one wakeup fd per poller
+        }
+        fWakeupFd = fd;
+        return true;
+    }
+
+    ~Poller() override = default;
+
+  private:
+    std::vector<Socket*> fSockets;
+    std::vector<uint32_t> fEvents;
+    std::vector<pollfd> fFds;
+    std::vector<size_t> fOffsets;
+    int fWakeupFd = -1; // polled after the socket fds
+
+    std::unordered_map<std::string, int> fOffsetMap;
+};
+
+} // namespace fair::mq::stream
+
+#endif /* FAIR_MQ_STREAM_POLLER_H */
@@ -0,0 +1,294 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_BENCH_H
+#define FAIR_MQ_TOOLS_BENCH_H
+
+#include <fairmq/Channel.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/Latency.h>
+#include <fairmq/tools/RateLimit.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <algorithm> // max, min, max_element
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <ctime> // clock_gettime
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fair::mq::tools
+{
+
+/// Workload and transport settings of one run of the in-process benchmark of fairmq-bench and fairmq-tune
+struct BenchConfig
+{
+    std::string transport{"zeromq"}; // zeromq, shmem, region (shmem with unmanaged region messages)
+    std::string allocation{"rbtree_best_fit"};
+    std::vector<size_t> msgSizes{1000}; // (part) sizes, the producers send them in turn
+    size_t numParts = 1;
+    int producers = 1; // every producer connects to every consumer
+    int consumers = 1;
+    float rate = 0; // per producer, 0: unlimited
+    size_t segmentSize = 2000000000;
+    int ioThreads = 1;
+    int sndBufSize = Channel::DefaultSndBufSize;
+    int rcvBufSize = Channel::DefaultRcvBufSize;
+    int sndKernelSize = Channel::DefaultSndKernelSize; // 0: left to the kernel
+    int rcvKernelSize = Channel::DefaultRcvKernelSize;
+    uint32_t ackBunchSize = RegionConfig().ackBunchSize; // region
+};
+
+struct BenchResult
+{
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+    LatencyHistogram latency;
+    std::string error; // of a failed producer, empty if none failed
+
+    double MessagesPerSecond() const { return seconds > 0 ? received / seconds : 0; }
+    double MBPerSecond() const { return seconds > 0 ? bytes / seconds / 1e6 : 0; }
+};
+
+inline double BenchCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// slots of slotSize bytes in an unmanaged region, returned by the region callback
+class BenchRegionSlots
+{
+  public:
+    BenchRegionSlots(TransportFactory& factory, size_t slotSize, size_t numSlots, uint32_t ackBunchSize)
+        : fSlotSize(slotSize)
+    {
+        RegionConfig cfg;
+        cfg.ackBunchSize = ackBunchSize;
+        fRegion = factory.CreateUnmanagedRegion(slotSize * numSlots, [this](void* /* data */, size_t /* size */, void* hint) {
+            std::lock_guard<std::mutex> lock(fMtx);
+            fFree.push_back(reinterpret_cast<size_t>(hint));
+            fCV.notify_one();
+        }, cfg);
+        for (size_t i = 0; i < numSlots; ++i) {
+            fFree.push_back(i);
+        }
+    }
+
+    /// @return message of a free slot, nullptr if none became free within the timeout
+    MessagePtr NewMessage(TransportFactory& factory, size_t size, std::chrono::milliseconds timeout)
+    {
+        size_t slot = 0;
+        {
+            std::unique_lock<std::mutex> lock(fMtx);
+            if (!fCV.wait_for(lock, timeout, [this]() { return !fFree.empty(); })) {
+                return nullptr;
+            }
+            slot = fFree.front();
+            fFree.pop_front();
+        }
+        return factory.CreateMessage(fRegion, static_cast<char*>(fRegion->GetData()) + slot * fSlotSize, size, reinterpret_cast<void*>(slot));
+    }
+
+  private:
+    size_t fSlotSize;
+    UnmanagedRegionPtr fRegion;
+    std::mutex fMtx;
+    std::condition_variable fCV;
+    std::deque<size_t> fFree;
+};
+
+/// Runs cfg.producers producer and cfg.consumers consumer threads over push/pull channels (ipc) in the calling process,
+/// sending for the given duration, and measures the throughput, the latency and the CPU time of the process.
+inline BenchResult RunBench(const BenchConfig& cfg, std::chrono::duration<double> duration)
+{
+    if (cfg.msgSizes.empty()) {
+        throw std::runtime_error("no message sizes given");
+    }
+    ProgOptions config;
+    config.SetProperty<std::string>("session", Uuid());
+    config.SetProperty<size_t>("shm-segment-size", cfg.segmentSize);
+    config.SetProperty<std::string>("shm-allocation", cfg.allocation);
+    config.SetProperty<bool>("shm-monitor", false);
+    config.SetProperty<int>("io-threads", cfg.ioThreads);
+    auto factory(TransportFactory::CreateTransportFactory(cfg.transport == "region" ? "shmem" : cfg.transport, Uuid(), &config));
+
+    auto configure = [&cfg](Channel& channel) {
+        channel.UpdateSndBufSize(cfg.sndBufSize);
+        channel.UpdateRcvBufSize(cfg.rcvBufSize);
+        channel.UpdateSndKernelSize(cfg.sndKernelSize);
+        channel.UpdateRcvKernelSize(cfg.rcvKernelSize);
+        channel.Init();
+    };
+
+    const std::string prefix(ToString("ipc://@fairmq-bench-", Uuid(), "-"));
+    std::vector<Channel> pulls;
+    pulls.reserve(cfg.consumers);
+    for (int c = 0; c < cfg.consumers; ++c) {
+        pulls.emplace_back(ToString("pull", c), "pull", factory);
+        configure(pulls.back());
+        if (!pulls.back().Bind(ToString(prefix, c))) {
+            throw std::runtime_error(ToString("failed binding consumer ", c));
+        }
+    }
+    std::vector<Channel> pushes;
+    pushes.reserve(cfg.producers);
+    for (int p = 0; p < cfg.producers; ++p) {
+        pushes.emplace_back(ToString("push", p), "push", factory);
+        configure(pushes.back());
+        for (int c = 0; c < cfg.consumers; ++c) {
+            pushes.back().Connect(ToString(prefix, c));
+        }
+    }
+    std::vector<std::unique_ptr<BenchRegionSlots>> regions;
+    if (cfg.transport == "region") {
+        const size_t slotSize = std::max<size_t>(*std::max_element(cfg.msgSizes.begin(), cfg.msgSizes.end()), 1);
+        const size_t numSlots = std::max<size_t>(16, std::min<size_t>(1024, (256 << 20) / slotSize));
+        for (int p = 0; p < cfg.producers; ++p) {
+            regions.push_back(std::make_unique<BenchRegionSlots>(*factory, slotSize, numSlots, cfg.ackBunchSize));
+        }
+    }
+    // let the connections establish
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    BenchResult result;
+    std::atomic<uint64_t> sent(0);
+    std::atomic<uint64_t> received(0);
+    std::atomic<bool> producersDone(false);
+    std::mutex errorMtx;
+    std::string error;
+    std::vector<LatencyHistogram> latencies(cfg.consumers);
+    std::vector<uint64_t> bytes(cfg.consumers, 0);
+    std::vector<std::chrono::steady_clock::time_point> lastReceive(cfg.consumers);
+
+    const double cpuStart = BenchCpuSeconds();
+    const auto start = std::chrono::steady_clock::now();
+    const auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < cfg.consumers; ++c) {
+        consumers.emplace_back([&, c]() {
+            Channel& pull = pulls.at(c);
+            auto idleSince = std::chrono::steady_clock::now();
+            while (true) {
+                Parts parts;
+                MessagePtr msg;
+                int64_t nbytes = 0;
+                if (cfg.numParts > 1) {
+                    nbytes = pull.Receive(parts, 100);
+                } else {
+                    msg = pull.NewMessage();
+                    nbytes = pull.Receive(msg, 100);
+                }
+                auto now = std::chrono::steady_clock::now();
+                if (nbytes >= 0) {
+                    const Message& first = cfg.numParts > 1 ? parts[0] : *msg;
+                    LatencyStamp stamp;
+                    if (LatencyStamp::Read(first.GetData(), first.GetSize(), stamp)) {
+                        int64_t latency = LatencyClockNow(LatencyClock::monotonic) - stamp.fSendTime;
+                        latencies[c].Record(latency > 0 ? latency : 0);
+                    }
+                    bytes[c] += nbytes;
+                    lastReceive[c] = now;
+                    idleSince = now;
+                    ++received;
+                } else if (producersDone && (received >= sent || now - idleSince > std::chrono::seconds(1))) {
+                    break;
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < cfg.producers; ++p) {
+        producers.emplace_back([&, p]() {
+            Channel& push = pushes.at(p);
+            RateLimiter rateLimiter(cfg.rate > 0 ? cfg.rate : 1);
+            uint64_t seq = 0;
+            size_t next = 0; // index into msgSizes
+            // e.g. a segment too small for the queued messages, ends the sending of this producer
+            try {
+                while (std::chrono::steady_clock::now() < end) {
+                    Parts parts;
+                    for (size_t i = 0; i < cfg.numParts; ++i) {
+                        const size_t size = cfg.msgSizes[next];
+                        next = (next + 1) % cfg.msgSizes.size();
+                        MessagePtr part = regions.empty() ? push.NewMessage(size) : regions.at(p)->NewMessage(*factory, size, std::chrono::milliseconds(100));
+                        if (!part) {
+                            break;
+                        }
+                        parts.AddPart(std::move(part));
+                    }
+                    if (parts.Size() != cfg.numParts) {
+                        continue;
+                    }
+                    if (parts[0].GetSize() >= sizeof(LatencyStamp)) {
+                        LatencyStamp::Write(parts[0].GetData(), LatencyClock::monotonic, p, seq);
+                    }
+                    int64_t rc = cfg.numParts > 1 ? push.Send(parts, 100) : push.Send(parts.At(0), 100);
+                    if (rc >= 0) {
+                        ++seq;
+                        ++sent;
+                    }
+                    if (cfg.rate > 0) {
+                        rateLimiter.maybe_sleep();
+                    }
+                }
+            } catch (std::exception& e) {
+                std::lock_guard<std::mutex> lock(errorMtx);
+                error = e.what();
+            }
+        });
+    }
+
+    for (auto& t : producers) {
+        t.join();
+    }
+    producersDone = true;
+    for (auto& t : consumers) {
+        t.join();
+    }
+
+    result.cpuSeconds = BenchCpuSeconds() - cpuStart;
+    result.sent = sent;
+    result.error = error;
+    result.received = received;
+    auto last = start;
+    for (int c = 0; c < cfg.consumers; ++c) {
+        result.latency.Add(latencies[c]);
+        result.bytes += bytes[c];
+        last = std::max(last, lastReceive[c]);
+    }
+    result.seconds = std::chrono::duration<double>(last - start).count();
+
+    // messages have to be released before their regions, and channels before the transport
+    regions.clear();
+    pushes.clear();
+    pulls.clear();
+    return result;
+}
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_BENCH_H */
@@ -0,0 +1,258 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/tools/Checksum.h>
+#include <fairmq/tools/Strings.h>
+
+#include <array>
+#include <cstring> // memcpy
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define FAIRMQ_CRC32C_X86
+#elif defined(__aarch64__) && defined(__linux__) && __has_include(<sys/auxv.h>)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#define FAIRMQ_CRC32C_ARM
+#endif
+
+#if __has_include(<xxhash.h>)
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+#define FAIRMQ_WITH_XXH3
+#endif
+
+using namespace std;
+
+namespace fair::mq::tools
+{
+
+namespace
+{
+
+constexpr uint32_t kPoly = 0x82f63b78; // reflected Castagnoli polynomial
+
+// The CRC register update without the pre- and post-inversion is linear: the register after a block of data is the one
+// after as many zero bytes, xor the one the data produces from 0. So the accelerated versions compute three lanes of a
+// block in parallel (to hide the latency of the CRC instruction) and combine them with the "shift by kLane zero bytes"
+// operator, tabulated per register byte.
+constexpr size_t kLane = 4096;
+
+using Table = array<array<uint32_t, 256>, 8>;
+
+// slicing-by-8 tables of the portable implementation
+Table MakeSliceTable()
+{
+    Table t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; ++k) {
+            crc = (crc >> 1) ^ (kPoly & (0 - (crc & 1)));
+        }
+        t[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (size_t s = 1; s < 8; ++s) {
+            t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+        }
+    }
+    return t;
+}
+
+const Table gSlice = MakeSliceTable();
+
+uint32_t UpdatePortable(uint32_t crc, const char* p, size_t size)
+{
+    while (size >= 8) {
+        uint64_t word = 0;
+        memcpy(&word, p, 8);
+        word ^= crc;
+        crc = gSlice[7][word & 0xff] ^ gSlice[6][(word >> 8) & 0xff] ^ gSlice[5][(word >> 16) & 0xff] ^ gSlice[4][(word >> 24) & 0xff]
+            ^ gSlice[3][(word >> 32) & 0xff] ^ gSlice[2][(word >> 40) & 0xff] ^ gSlice[1][(word >> 48) & 0xff] ^ gSlice[0][word >> 56];
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ gSlice[0][(crc ^ static_cast<uint8_t>(*p++)) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(FAIRMQ_CRC32C_X86) || defined(FAIRMQ_CRC32C_ARM)
+// tabulated register update for kLane zero bytes
+Table MakeShiftTable()
+{
+    array<uint32_t, 32> bits{};
+    const string zeros(kLane, '\0');
+    for (int b = 0; b < 32; ++b) {
+        bits[b] = UpdatePortable(1u << b, zeros.data(), zeros.size());
+    }
+    Table t{};
+    for (size_t s = 0; s < 4; ++s) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t v = 0;
+            for (int b = 0; b < 8; ++b) {
+                if (i & (1u << b)) {
+                    v ^= bits[s * 8 + b];
+                }
+            }
+            t[s][i] = v;
+        }
+    }
+    return t;
+}
+
+uint32_t ShiftLane(const Table& t, uint32_t crc)
+{
+    return t[0][crc & 0xff] ^ t[1][(crc >> 8) & 0xff] ^ t[2][(crc >> 16) & 0xff] ^ t[3][crc >> 24];
+}
+#endif
+
+#ifdef FAIRMQ_CRC32C_X86
+const Table gShift = MakeShiftTable();
+
+__attribute__((target("sse4.2"))) uint32_t UpdateHw(uint32_t crc, const char* p, size_t size)
+{
+    while (size >= 3 * kLane) {
+        uint64_t a = crc, b = 0, c = 0;
+        for (size_t i = 0; i < kLane; i += 8) {
+            uint64_t wa, wb, wc;
+            memcpy(&wa, p + i, 8);
+            memcpy(&wb, p + kLane + i, 8);
+            memcpy(&wc, p + 2 * kLane + i, 8);
+            a = _mm_crc32_u64(a, wa);
+            b = _mm_crc32_u64(b, wb);
+            c = _mm_crc32_u64(c, wc);
+        }
+        crc = ShiftLane(gShift, ShiftLane(gShift, static_cast<uint32_t>(a)) ^ static_cast<uint32_t>(b)) ^ static_cast<uint32_t>(c);
+        p += 3 * kLane;
+        size -= 3 * kLane;
+    }
+    uint64_t crc64 = crc;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; size > 0; ++p, --size) {
+        crc = _mm_crc32_u8(crc, static_cast<uint8_t>(*p));
+    }
+    return crc;
+}
+
+bool Accelerated()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+#endif
+
+#ifdef FAIRMQ_CRC32C_ARM
+const Table gShift = MakeShiftTable();
+
+__attribute__((target("+crc"))) uint32_t UpdateHw(uint32_t crc, const char* p, size_t size)
+{
+    while (size >= 3 * kLane) {
+        uint32_t a = crc, b = 0, c = 0;
+        for (size_t i = 0; i < kLane; i += 8) {
+            uint64_t wa, wb, wc;
+            memcpy(&wa, p + i, 8);
+            memcpy(&wb, p + kLane + i, 8);
+            memcpy(&wc, p + 2 * kLane + i, 8);
+            a = __crc32cd(a, wa);
+            b = __crc32cd(b, wb);
+            c = __crc32cd(c, wc);
+        }
+        crc = ShiftLane(gShift, ShiftLane(gShift, a) ^ b) ^ c;
+        p += 3 * kLane;
+        size -= 3 * kLane;
+    }
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; size > 0; ++p, --size) {
+        crc = __crc32cb(crc, static_cast<uint8_t>(*p));
+    }
+    return crc;
+}
+
+bool Accelerated() { return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+#endif
+
+#if defined(FAIRMQ_CRC32C_X86) || defined(FAIRMQ_CRC32C_ARM)
+const bool gAccelerated = Accelerated();
+#else
+const bool gAccelerated = false;
+#endif
+
+} // namespace
+
+ChecksumType ParseChecksumType(const string& name)
+{
+    if (name == "none") {
+        return ChecksumType::none;
+    } else if (name == "crc32c") {
+        return ChecksumType::crc32c;
+    } else if (name == "xxh3") {
+        return ChecksumType::xxh3;
+    }
+    throw ChecksumError(ToString("unknown checksum: '", name, "', valid are 'none', 'crc32c' and 'xxh3'"));
+}
+
+const char* ChecksumName(ChecksumType type)
+{
+    switch (type) {
+        case ChecksumType::crc32c: return "crc32c";
+        case ChecksumType::xxh3: return "xxh3";
+        default: return "none";
+    }
+}
+
+bool ChecksumAvailable([[maybe_unused]] ChecksumType type)
+{
+#ifdef FAIRMQ_WITH_XXH3
+    return true;
+#else
+    return type != ChecksumType::xxh3;
+#endif
+}
+
+uint32_t Crc32c(const void* data, size_t size, uint32_t crc)
+{
+    const char* p = static_cast<const char*>(data);
+#if defined(FAIRMQ_CRC32C_X86) || defined(FAIRMQ_CRC32C_ARM)
+    if (gAccelerated) {
+        return ~UpdateHw(~crc, p, size);
+    }
+#endif
+    return ~UpdatePortable(~crc, p, size);
+}
+
+bool Crc32cAccelerated() { return gAccelerated; }
+
+uint64_t Checksum(ChecksumType type, const void* data, size_t size)
+{
+    switch (type) {
+        case ChecksumType::crc32c:
+            return Crc32c(data, size);
+        case ChecksumType::xxh3:
+#ifdef FAIRMQ_WITH_XXH3
+            return XXH3_64bits(data, size);
+#else
+            throw ChecksumError("xxh3 checksums are not available, FairMQ was built without the xxHash header");
+#endif
+        default:
+            return 0;
+    }
+}
+
+} // namespace fair::mq::tools
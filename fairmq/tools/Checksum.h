@@ -0,0 +1,47 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_CHECKSUM_H
+#define FAIR_MQ_TOOLS_CHECKSUM_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace fair::mq::tools
+{
+
+struct ChecksumError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+/// Payload checksums of the channels (channel property checksum)
+enum class ChecksumType : uint8_t
+{
+    none = 0,
+    crc32c = 1, ///< SSE4.2 or ARMv8 CRC instructions, a table based implementation without them
+    xxh3 = 2    ///< 64 bit XXH3, available if FairMQ was built with the xxHash header
+};
+
+/// @throw ChecksumError for an unknown checksum type
+ChecksumType ParseChecksumType(const std::string& name);
+const char* ChecksumName(ChecksumType type);
+/// @return true if the checksum can be computed by this build
+bool ChecksumAvailable(ChecksumType type);
+
+/// CRC-32C (Castagnoli) of size bytes, continuing from crc (the result of the previous block)
+uint32_t Crc32c(const void* data, size_t size, uint32_t crc = 0);
+/// @return true if Crc32c() uses the CRC instructions of the CPU
+bool Crc32cAccelerated();
+
+/// @return checksum of the given type (0 for none)
+/// @throw ChecksumError if the type is not available
+uint64_t Checksum(ChecksumType type, const void* data, size_t size);
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_CHECKSUM_H */
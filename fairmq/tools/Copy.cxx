@@ -0,0 +1,332 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/tools/Copy.h>
+
+#include <fairlogger/Logger.h>
+
+#include <algorithm> // min
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define FAIRMQ_COPY_X86
+#endif
+
+#if defined(__x86_64__) && defined(__linux__) && __has_include(<linux/idxd.h>)
+#include <linux/idxd.h>
+#include <cpuid.h>
+#include <dirent.h>
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap
+#include <unistd.h>   // close
+#include <fstream>
+#include <vector>
+#define FAIRMQ_COPY_DSA
+#endif
+
+using namespace std;
+
+namespace fair::mq::tools
+{
+
+namespace detail
+{
+atomic<size_t> gCopyEngineThreshold(numeric_limits<size_t>::max());
+} // namespace detail
+
+namespace
+{
+
+#ifdef FAIRMQ_COPY_X86
+// Copy size bytes (a multiple of 64) to the 64 byte aligned dst with non-temporal stores
+__attribute__((target("avx512f"))) void StreamAvx512(char* dst, const char* src, size_t size)
+{
+    for (size_t i = 0; i < size; i += 64) {
+        _mm_prefetch(src + i + 512, _MM_HINT_NTA);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(dst + i), _mm512_loadu_si512(src + i));
+    }
+}
+
+__attribute__((target("avx2"))) void StreamAvx2(char* dst, const char* src, size_t size)
+{
+    for (size_t i = 0; i < size; i += 64) {
+        _mm_prefetch(src + i + 512, _MM_HINT_NTA);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32)));
+    }
+}
+
+void StreamSse2(char* dst, const char* src, size_t size)
+{
+    for (size_t i = 0; i < size; i += 64) {
+        _mm_prefetch(src + i + 512, _MM_HINT_NTA);
+        for (size_t j = 0; j < 64; j += 16) {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + j), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + j)));
+        }
+    }
+}
+
+using StreamFn = void (*)(char*, const char*, size_t);
+
+StreamFn SelectStream()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return &StreamAvx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        return &StreamAvx2;
+    }
+    return &StreamSse2;
+}
+
+const StreamFn gStream = SelectStream();
+#endif
+
+void StreamingCopy(char* dst, const char* src, size_t size)
+{
+#ifdef FAIRMQ_COPY_X86
+    // the non-temporal stores are aligned, the head up to the first cache line of dst and the tail are copied with memcpy
+    const size_t head = min(size, (64 - reinterpret_cast<uintptr_t>(dst) % 64) % 64);
+    memcpy(dst, src, head);
+    const size_t body = (size - head) / 64 * 64;
+    gStream(dst + head, src + head, body);
+    memcpy(dst + head + body, src + head + body, size - head - body);
+    // non-temporal stores are weakly ordered, make them visible before e.g. the message is sent
+    _mm_sfence();
+#else
+    memcpy(dst, src, size);
+#endif
+}
+
+#ifdef FAIRMQ_COPY_DSA
+// Work queue of an Intel DSA device (idxd driver, user mode with shared virtual memory), configured with accel-config.
+// Copies are split into descriptors of at most the maximum transfer size of the queue, submitted at once, so the device
+// works on them in parallel. What the queue does not accept is copied by the CPU in the meantime.
+class DsaQueue
+{
+  public:
+    static DsaQueue* Open(const string& wq)
+    {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return nullptr;
+        }
+        const bool movdir64b = ecx & (1U << 28);
+        const bool enqcmd = ecx & (1U << 29);
+
+        vector<string> names;
+        if (!wq.empty()) {
+            names.push_back(wq.substr(wq.find_last_of('/') + 1));
+        } else if (DIR* dir = opendir("/dev/dsa")) {
+            while (dirent* entry = readdir(dir)) {
+                if (string(entry->d_name).rfind("wq", 0) == 0) {
+                    names.emplace_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+            sort(names.begin(), names.end());
+        }
+        for (const auto& name : names) {
+            const string sysfs("/sys/bus/dsa/devices/" + name + "/");
+            const bool shared = ReadSysfs<string>(sysfs + "mode") == "shared";
+            // (the transfer size of a descriptor is 32 bit)
+            const size_t maxTransfer = min<size_t>(ReadSysfs<size_t>(sysfs + "max_transfer_size"), size_t(1) << 31);
+            const int slots = ReadSysfs<int>(sysfs + "size");
+            if ((shared ? !enqcmd : !movdir64b) || maxTransfer == 0 || slots <= 0) {
+                continue;
+            }
+            int fd = open(("/dev/dsa/" + name).c_str(), O_RDWR);
+            if (fd < 0) {
+                continue;
+            }
+            void* portal = mmap(nullptr, 0x1000, PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+            if (portal == MAP_FAILED) {
+                close(fd);
+                continue;
+            }
+            LOG(debug) << "Copy engine: DSA work queue " << name << " (" << (shared ? "shared" : "dedicated") << ", "
+                       << slots << " entries, maximum transfer size " << maxTransfer << " bytes)";
+            return new DsaQueue(fd, portal, shared, maxTransfer, slots);
+        }
+        return nullptr;
+    }
+
+    void Copy(char* dst, const char* src, size_t size)
+    {
+        constexpr size_t kMaxBatch = 32;
+        alignas(64) dsa_hw_desc descs[kMaxBatch];
+        alignas(32) dsa_completion_record comps[kMaxBatch];
+        while (size > 0) {
+            size_t submitted[kMaxBatch];
+            size_t num = 0;
+            size_t offset = 0;
+            for (; num < kMaxBatch && offset < size; ++num) {
+                const size_t piece = min(fMaxTransfer, size - offset);
+                dsa_hw_desc& desc = descs[num];
+                memset(&desc, 0, sizeof(desc));
+                // without IDXD_OP_FLAG_CC the destination is written to memory, not to the caches
+                desc.opcode = DSA_OPCODE_MEMMOVE;
+                desc.flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR;
+                desc.src_addr = reinterpret_cast<uintptr_t>(src + offset);
+                desc.dst_addr = reinterpret_cast<uintptr_t>(dst + offset);
+                desc.xfer_size = piece;
+                desc.completion_addr = reinterpret_cast<uintptr_t>(&comps[num]);
+                comps[num].status = 0;
+                submitted[num] = Submit(desc) ? piece : 0;
+                if (submitted[num] == 0) {
+                    StreamingCopy(dst + offset, src + offset, piece);
+                }
+                offset += piece;
+            }
+
+            offset = 0;
+            for (size_t i = 0; i < num; ++i) {
+                const size_t piece = min(fMaxTransfer, size - offset);
+                if (submitted[i] > 0) {
+                    while (comps[i].status == 0) {
+                        _mm_pause();
+                    }
+                    if (!fShared) {
+                        fInFlight.fetch_sub(1, memory_order_relaxed);
+                    }
+                    if (comps[i].status != DSA_COMP_SUCCESS) {
+                        // e.g. a page fault, the CPU copies what the device did not
+                        const size_t done = comps[i].status == DSA_COMP_PAGE_FAULT_NOBOF ? min<size_t>(comps[i].bytes_completed, piece) : 0;
+                        StreamingCopy(dst + offset + done, src + offset + done, piece - done);
+                    }
+                }
+                offset += piece;
+            }
+            dst += offset;
+            src += offset;
+            size -= offset;
+        }
+    }
+
+  private:
+    DsaQueue(int fd, void* portal, bool shared, size_t maxTransfer, int slots)
+        : fFd(fd)
+        , fPortal(portal)
+        , fShared(shared)
+        , fMaxTransfer(maxTransfer)
+        , fSlots(slots)
+        , fInFlight(0)
+    {}
+
+    template<typename T>
+    static T ReadSysfs(const string& path)
+    {
+        T value{};
+        ifstream(path) >> value;
+        return value;
+    }
+
+    // @return false if the queue is full
+    bool Submit(dsa_hw_desc& desc)
+    {
+        if (fShared) {
+            // ENQCMD, reports a full queue
+            unsigned char retry = 0;
+            asm volatile("sfence\n\t"
+                         ".byte 0xf2, 0x0f, 0x38, 0xf8, 0x02\n\t"
+                         "setz %0"
+                         : "=r"(retry) : "a"(fPortal), "d"(&desc) : "memory");
+            return !retry;
+        }
+        // MOVDIR64B drops descriptors to a full dedicated queue silently, its entries are counted
+        if (fInFlight.fetch_add(1, memory_order_relaxed) >= fSlots) {
+            fInFlight.fetch_sub(1, memory_order_relaxed);
+            return false;
+        }
+        asm volatile("sfence\n\t"
+                     ".byte 0x66, 0x0f, 0x38, 0xf8, 0x02"
+                     : : "a"(fPortal), "d"(&desc) : "memory");
+        return true;
+    }
+
+    int fFd;
+    void* fPortal;
+    const bool fShared;
+    const size_t fMaxTransfer;
+    const int fSlots;
+    atomic<int> fInFlight; // descriptors submitted to a dedicated queue
+};
+
+// opened once, used for the lifetime of the process
+atomic<DsaQueue*> gDsa(nullptr);
+#endif
+
+enum class Engine
+{
+    memcpy,
+    streaming,
+    dsa
+};
+
+atomic<Engine> gEngine(Engine::memcpy);
+
+} // namespace
+
+namespace detail
+{
+
+void CopyLarge(void* dst, const void* src, size_t size)
+{
+    switch (gEngine.load(memory_order_relaxed)) {
+#ifdef FAIRMQ_COPY_DSA
+        case Engine::dsa:
+            gDsa.load(memory_order_acquire)->Copy(static_cast<char*>(dst), static_cast<const char*>(src), size);
+            return;
+#endif
+        case Engine::streaming:
+            StreamingCopy(static_cast<char*>(dst), static_cast<const char*>(src), size);
+            return;
+        default:
+            memcpy(dst, src, size);
+    }
+}
+
+} // namespace detail
+
+string SetCopyEngine(const string& engine, size_t threshold, const string& wq)
+{
+    Engine selected = Engine::memcpy;
+    if (engine == "memcpy") {
+        selected = Engine::memcpy;
+    } else if (engine == "streaming") {
+        selected = Engine::streaming;
+    } else if (engine == "dsa") {
+        selected = Engine::streaming;
+#ifdef FAIRMQ_COPY_DSA
+        static mutex mtx;
+        lock_guard<mutex> lock(mtx);
+        if (!gDsa.load(memory_order_acquire)) {
+            gDsa.store(DsaQueue::Open(wq), memory_order_release);
+        }
+        if (gDsa.load(memory_order_acquire)) {
+            selected = Engine::dsa;
+        } else {
+            LOG(warn) << "Copy engine: no usable DSA work queue" << (wq.empty() ? "" : " " + wq) << ", using streaming copies";
+        }
+#else
+        (void)wq;
+        LOG(warn) << "Copy engine: DSA is not supported on this platform, using streaming copies";
+#endif
+    } else {
+        throw CopyEngineError("Invalid copy engine '" + engine + "', valid are 'memcpy', 'streaming' and 'dsa'");
+    }
+
+    gEngine.store(selected, memory_order_relaxed);
+    detail::gCopyEngineThreshold.store(selected == Engine::memcpy ? numeric_limits<size_t>::max() : threshold, memory_order_relaxed);
+    return selected == Engine::memcpy ? "memcpy" : selected == Engine::streaming ? "streaming" : "dsa";
+}
+
+} // namespace fair::mq::tools
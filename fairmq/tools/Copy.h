@@ -0,0 +1,51 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_COPY_H
+#define FAIR_MQ_TOOLS_COPY_H
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <string>
+
+namespace fair::mq::tools
+{
+
+struct CopyEngineError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+namespace detail
+{
+// copies of at least this size go to the copy engine, the maximum for the memcpy engine
+extern std::atomic<size_t> gCopyEngineThreshold;
+void CopyLarge(void* dst, const void* src, size_t size);
+} // namespace detail
+
+/// Select the process wide engine for payload copies of at least threshold bytes (--copy-engine, --copy-engine-threshold):
+/// "memcpy" (always memcpy), "streaming" (non-temporal AVX-512/AVX2/SSE2 stores that bypass the caches of the copying core)
+/// or "dsa" (an Intel Data Streaming Accelerator work queue of the idxd driver, see wq, streaming copies if there is none).
+/// Smaller copies always use memcpy.
+/// @param wq DSA work queue device, e.g. "/dev/dsa/wq0.0" (empty: the first one that can be opened)
+/// @return the selected engine, "streaming" instead of an unavailable "dsa"
+/// @throw CopyEngineError for an unknown engine
+std::string SetCopyEngine(const std::string& engine, size_t threshold, const std::string& wq = "");
+
+/// Copy size bytes of payload from src to dst (not overlapping) with the copy engine
+inline void CopyPayload(void* dst, const void* src, size_t size)
+{
+    if (size < detail::gCopyEngineThreshold.load(std::memory_order_relaxed)) {
+        std::memcpy(dst, src, size);
+    } else {
+        detail::CopyLarge(dst, src, size);
+    }
+}
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_COPY_H */
@@ -0,0 +1,52 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "Futex.h"
+
+#ifdef __linux__
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#include <sys/syscall.h> // SYS_futex
+#include <unistd.h> // syscall
+#endif
+
+#include <algorithm> // min
+#include <cerrno>
+#include <ctime> // timespec
+
+namespace fair::mq::tools
+{
+
+bool FutexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::microseconds timeout)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32 bit integer");
+#ifdef __linux__
+    const auto us = timeout.count();
+    timespec ts{static_cast<time_t>(us / 1000000), static_cast<long>((us % 1000000) * 1000)};
+    long rc = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, us < 0 ? nullptr : &ts, nullptr, 0);
+    return !(rc == -1 && errno == ETIMEDOUT);
+#else
+    if (word.load() == expected) {
+        const auto us = timeout.count();
+        std::this_thread::sleep_for(std::chrono::microseconds(us < 0 ? 1000 : std::min<int64_t>(us, 1000)));
+        return word.load() != expected;
+    }
+    return true;
+#endif
+}
+
+void FutexWake(std::atomic<uint32_t>& word, int count)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    (void)word;
+    (void)count;
+#endif
+}
+
+} // namespace fair::mq::tools
@@ -0,0 +1,186 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_FUTEX_H
+#define FAIR_MQ_TOOLS_FUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+namespace fair::mq::tools
+{
+
+/// blocks while word == expected, for at most timeout (< 0: no limit). Futex of the process (not usable across
+/// processes), without futex support (non-Linux) it sleeps for up to 1 ms. Returns false on timeout.
+bool FutexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::microseconds timeout);
+/// wakes up to count threads blocked in FutexWait on the given word
+void FutexWake(std::atomic<uint32_t>& word, int count);
+
+/// hint to the CPU that the calling thread spins
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/**
+ * @class FutexSemaphore Futex.h <fairmq/tools/Futex.h>
+ * @brief Counting semaphore on a futex
+ *
+ * Wait() on a positive count and Signal() without blocked waiters are a single atomic operation each, the kernel is
+ * only entered to block and to wake blocked waiters. Not copyable, see SharedSemaphore for that.
+ */
+class FutexSemaphore
+{
+  public:
+    explicit FutexSemaphore(uint32_t initialCount = 0)
+        : fCount(initialCount)
+    {}
+
+    FutexSemaphore(const FutexSemaphore&) = delete;
+    FutexSemaphore& operator=(const FutexSemaphore&) = delete;
+
+    bool TryWait()
+    {
+        uint32_t count = fCount.load(std::memory_order_relaxed);
+        while (count > 0) {
+            if (fCount.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Wait()
+    {
+        while (!TryWait()) {
+            Block(std::chrono::microseconds(-1));
+        }
+    }
+
+    /// @return false if the count stayed 0 for the timeout
+    bool WaitFor(std::chrono::microseconds timeout)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!TryWait()) {
+            const auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) {
+                return false;
+            }
+            Block(left);
+        }
+        return true;
+    }
+
+    void Signal(uint32_t n = 1)
+    {
+        // seq_cst pairs with the registration of the waiters in Block()
+        fCount.fetch_add(n);
+        if (fWaiters.load() > 0) {
+            FutexWake(fCount, static_cast<int>(n));
+        }
+    }
+
+    uint32_t GetCount() const { return fCount.load(std::memory_order_relaxed); }
+
+  private:
+    void Block(std::chrono::microseconds timeout)
+    {
+        fWaiters.fetch_add(1);
+        FutexWait(fCount, 0, timeout);
+        fWaiters.fetch_sub(1);
+    }
+
+    std::atomic<uint32_t> fCount;
+    std::atomic<uint32_t> fWaiters{0};
+};
+
+/**
+ * @class SpinParkWaiter Futex.h <fairmq/tools/Futex.h>
+ * @brief Waits for a condition that other threads make true without a lock, e.g. a non-empty lock-free queue
+ *
+ * The waiting thread checks the condition for a number of spins, then parks on a futex until it is notified. Notify()
+ * costs a fence and a load while no thread is parked. A notification is not lost if it comes between the last check of
+ * the condition and the parking: the waiter registers before its final check, the notifier checks for registered
+ * waiters after making the condition true. Notify() wakes one parked thread, so all threads waiting on one
+ * SpinParkWaiter should wait for the same condition (use separate ones e.g. for data and for space of a queue).
+ */
+class SpinParkWaiter
+{
+  public:
+    /// @param spins number of checks of the condition before parking
+    explicit SpinParkWaiter(int spins = 1000)
+        : fSpins(spins)
+    {}
+
+    SpinParkWaiter(const SpinParkWaiter&) = delete;
+    SpinParkWaiter& operator=(const SpinParkWaiter&) = delete;
+
+    /// waits until ready() returns true or the timeout (< 0: no limit) expired
+    /// @return the last result of ready()
+    template<typename Ready>
+    bool Wait(Ready&& ready, std::chrono::microseconds timeout = std::chrono::microseconds(-1))
+    {
+        for (int i = 0; i < fSpins; ++i) {
+            if (ready()) {
+                return true;
+            }
+            CpuRelax();
+        }
+        const bool infinite = timeout.count() < 0;
+        const auto deadline = infinite ? std::chrono::steady_clock::time_point::max() : std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            const uint32_t epoch = fEpoch.load(std::memory_order_acquire);
+            fParked.fetch_add(1);
+            if (ready()) {
+                fParked.fetch_sub(1);
+                return true;
+            }
+            auto left = std::chrono::microseconds(-1);
+            if (!infinite) {
+                left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0) {
+                    fParked.fetch_sub(1);
+                    return false;
+                }
+            }
+            FutexWait(fEpoch, epoch, left);
+            fParked.fetch_sub(1);
+            if (ready()) {
+                return true;
+            }
+        }
+    }
+
+    /// call after making the condition true
+    void Notify(bool all = false)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (fParked.load(std::memory_order_relaxed) > 0) {
+            fEpoch.fetch_add(1, std::memory_order_release);
+            FutexWake(fEpoch, all ? std::numeric_limits<int>::max() : 1);
+        }
+    }
+
+  private:
+    const int fSpins;
+    std::atomic<uint32_t> fEpoch{0};
+    std::atomic<uint32_t> fParked{0};
+};
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_FUTEX_H */
@@ -0,0 +1,148 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/tools/Gpu.h>
+#include <fairmq/tools/Strings.h>
+
+#include <cstring> // memcpy
+
+#if defined(FAIRMQ_WITH_CUDA)
+#include <cuda_runtime_api.h>
+#define FAIRMQ_GPU(name) cuda##name
+#elif defined(FAIRMQ_WITH_HIP)
+#include <hip/hip_runtime_api.h>
+#define FAIRMQ_GPU(name) hip##name
+#endif
+
+using namespace std;
+
+namespace fair::mq::tools
+{
+
+#ifdef FAIRMQ_GPU
+
+namespace
+{
+
+void Check(FAIRMQ_GPU(Error_t) err, const char* call)
+{
+    if (err != FAIRMQ_GPU(Success)) {
+        throw GpuError(ToString(GpuRuntime(), " ", call, " failed: ", FAIRMQ_GPU(GetErrorString)(err)));
+    }
+}
+
+// makes the device current for the calling thread, restores the previous one
+class DeviceGuard
+{
+  public:
+    explicit DeviceGuard(int device)
+    {
+        Check(FAIRMQ_GPU(GetDevice)(&fPrevious), "GetDevice");
+        if (device != fPrevious) {
+            Check(FAIRMQ_GPU(SetDevice)(device), "SetDevice");
+        }
+    }
+    DeviceGuard(const DeviceGuard&) = delete;
+    DeviceGuard& operator=(const DeviceGuard&) = delete;
+    ~DeviceGuard() { FAIRMQ_GPU(SetDevice)(fPrevious); }
+
+  private:
+    int fPrevious = 0;
+};
+
+static_assert(sizeof(FAIRMQ_GPU(IpcMemHandle_t)) <= sizeof(GpuIpcHandle), "GPU IPC handle does not fit into GpuIpcHandle");
+
+} // namespace
+
+const char* GpuRuntime()
+{
+#if defined(FAIRMQ_WITH_CUDA)
+    return "cuda";
+#else
+    return "hip";
+#endif
+}
+
+void GpuHostRegister(void* ptr, size_t size)
+{
+    Check(FAIRMQ_GPU(HostRegister)(ptr, size, FAIRMQ_GPU(HostRegisterPortable)), "HostRegister");
+}
+
+void GpuHostUnregister(void* ptr)
+{
+    Check(FAIRMQ_GPU(HostUnregister)(ptr), "HostUnregister");
+}
+
+void* GpuMalloc(int device, size_t size, GpuIpcHandle& handle)
+{
+    DeviceGuard guard(device);
+    void* ptr = nullptr;
+    Check(FAIRMQ_GPU(Malloc)(&ptr, size), "Malloc");
+    FAIRMQ_GPU(IpcMemHandle_t) ipcHandle;
+    auto err = FAIRMQ_GPU(IpcGetMemHandle)(&ipcHandle, ptr);
+    if (err != FAIRMQ_GPU(Success)) {
+        FAIRMQ_GPU(Free)(ptr);
+        Check(err, "IpcGetMemHandle");
+    }
+    handle.fill(0);
+    memcpy(handle.data(), &ipcHandle, sizeof(ipcHandle));
+    return ptr;
+}
+
+void GpuFree(int device, void* ptr)
+{
+    DeviceGuard guard(device);
+    Check(FAIRMQ_GPU(Free)(ptr), "Free");
+}
+
+void* GpuIpcOpen(int device, const GpuIpcHandle& handle)
+{
+    DeviceGuard guard(device);
+    FAIRMQ_GPU(IpcMemHandle_t) ipcHandle;
+    memcpy(&ipcHandle, handle.data(), sizeof(ipcHandle));
+    void* ptr = nullptr;
+    Check(FAIRMQ_GPU(IpcOpenMemHandle)(&ptr, ipcHandle, FAIRMQ_GPU(IpcMemLazyEnablePeerAccess)), "IpcOpenMemHandle");
+    return ptr;
+}
+
+void GpuIpcClose(int device, void* ptr)
+{
+    DeviceGuard guard(device);
+    Check(FAIRMQ_GPU(IpcCloseMemHandle)(ptr), "IpcCloseMemHandle");
+}
+
+void GpuMemset(int device, void* ptr, int value, size_t size)
+{
+    DeviceGuard guard(device);
+    Check(FAIRMQ_GPU(Memset)(ptr, value, size), "Memset");
+}
+
+#else
+
+namespace
+{
+
+[[noreturn]] void Unavailable()
+{
+    throw GpuError("GPU regions are not available, build FairMQ with -DBUILD_GPU_REGIONS=ON and CUDA or HIP");
+}
+
+} // namespace
+
+const char* GpuRuntime() { return ""; }
+void GpuHostRegister(void*, size_t) { Unavailable(); }
+void GpuHostUnregister(void*) { Unavailable(); }
+void* GpuMalloc(int, size_t, GpuIpcHandle&) { Unavailable(); }
+void GpuFree(int, void*) { Unavailable(); }
+void* GpuIpcOpen(int, const GpuIpcHandle&) { Unavailable(); }
+void GpuIpcClose(int, void*) { Unavailable(); }
+void GpuMemset(int, void*, int, size_t) { Unavailable(); }
+
+#endif
+
+} // namespace fair::mq::tools
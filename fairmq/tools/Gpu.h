@@ -0,0 +1,43 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_GPU_H
+#define FAIR_MQ_TOOLS_GPU_H
+
+#include <array>
+#include <cstddef> // size_t
+#include <stdexcept>
+
+namespace fair::mq::tools
+{
+
+/// GPU runtime calls of the unmanaged regions (RegionConfig::gpuRegister, RegionConfig::gpuDevice), CUDA or HIP,
+/// built with -DBUILD_GPU_REGIONS=ON. Without a runtime all of them throw GpuError.
+struct GpuError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+/// handle to export device memory to another process (cudaIpcMemHandle_t/hipIpcMemHandle_t)
+using GpuIpcHandle = std::array<char, 64>;
+
+/// @return "cuda", "hip" or "" (not built with a GPU runtime)
+const char* GpuRuntime();
+
+/// Page-lock host memory and register it with the GPU runtime (for all devices/contexts)
+void GpuHostRegister(void* ptr, size_t size);
+void GpuHostUnregister(void* ptr);
+
+/// Allocate device memory on the given device and export it for GpuIpcOpen in other processes
+void* GpuMalloc(int device, size_t size, GpuIpcHandle& handle);
+void GpuFree(int device, void* ptr);
+/// Map device memory exported by another process
+void* GpuIpcOpen(int device, const GpuIpcHandle& handle);
+void GpuIpcClose(int device, void* ptr);
+void GpuMemset(int device, void* ptr, int value, size_t size);
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_GPU_H */
@@ -0,0 +1,205 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_LATENCY_H
+#define FAIR_MQ_TOOLS_LATENCY_H
+
+#include <algorithm> // min
+#include <cstddef>   // size_t
+#include <cstdint>
+#include <cstring>   // memcpy
+#include <ctime>     // clock_gettime
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fair::mq::tools
+{
+
+enum class LatencyClock : uint32_t
+{
+    monotonic = 0, // CLOCK_MONOTONIC, for sender and receiver on the same host
+    realtime = 1   // CLOCK_REALTIME, across hosts with synchronized (e.g. PTP disciplined) clocks
+};
+
+inline LatencyClock ParseLatencyClock(const std::string& clock)
+{
+    if (clock == "monotonic") {
+        return LatencyClock::monotonic;
+    } else if (clock == "realtime") {
+        return LatencyClock::realtime;
+    }
+    throw std::runtime_error("Invalid latency clock '" + clock + "', valid are 'monotonic' and 'realtime'");
+}
+
+/// @return current time of the clock in nanoseconds
+inline int64_t LatencyClockNow(LatencyClock clock)
+{
+    timespec ts{};
+    clock_gettime(clock == LatencyClock::realtime ? CLOCK_REALTIME : CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/// Written by the sender at the start of a payload to measure the one-way latency at the receiver
+struct LatencyStamp
+{
+    static constexpr uint32_t kMagic = 0x464d514c; // "FMQL"
+
+    uint32_t fMagic;
+    uint32_t fClock;   // LatencyClock
+    uint64_t fSource;  // identifies the sender, sequence numbers are per source
+    uint64_t fSeq;
+    int64_t fSendTime; // ns of fClock
+
+    /// write a stamp with the current time to the start of data (at least sizeof(LatencyStamp) bytes)
+    static void Write(void* data, LatencyClock clock, uint64_t source, uint64_t seq)
+    {
+        LatencyStamp stamp{kMagic, static_cast<uint32_t>(clock), source, seq, LatencyClockNow(clock)};
+        std::memcpy(data, &stamp, sizeof(stamp));
+    }
+
+    /// @return false if data does not start with a stamp
+    static bool Read(const void* data, size_t size, LatencyStamp& stamp)
+    {
+        if (size < sizeof(stamp)) {
+            return false;
+        }
+        std::memcpy(&stamp, data, sizeof(stamp));
+        return stamp.fMagic == kMagic && stamp.fClock <= static_cast<uint32_t>(LatencyClock::realtime);
+    }
+};
+
+/// Histogram with logarithmic buckets of linear sub-buckets (as HDR histograms), recording values
+/// with a relative precision of 2^-(subBucketBits-1) in constant time and memory.
+class LatencyHistogram
+{
+  public:
+    explicit LatencyHistogram(unsigned int subBucketBits = 8)
+        : fSubBucketBits(std::min(std::max(subBucketBits, 2U), 16U))
+        , fCounts(Index(UINT64_MAX) + 1, 0)
+    {}
+
+    void Record(uint64_t value)
+    {
+        ++fCounts[Index(value)];
+        ++fCount;
+        fMax = std::max(fMax, value);
+        fMin = std::min(fMin, value);
+    }
+
+    /// @param percentile in [0, 100]
+    /// @return value at or above which (100 - percentile)% of the recorded values are (within the precision)
+    uint64_t Percentile(double percentile) const
+    {
+        if (fCount == 0) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(percentile / 100. * fCount + 0.5);
+        rank = std::min(std::max(rank, uint64_t(1)), fCount);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < fCounts.size(); ++i) {
+            seen += fCounts[i];
+            if (seen >= rank) {
+                return std::min(std::max(HighestEquivalent(i), fMin), fMax);
+            }
+        }
+        return fMax;
+    }
+
+    /// add the values recorded by other (with the same number of sub-bucket bits)
+    void Add(const LatencyHistogram& other)
+    {
+        if (other.fSubBucketBits != fSubBucketBits) {
+            throw std::runtime_error("Cannot add latency histograms of different precision");
+        }
+        for (size_t i = 0; i < fCounts.size(); ++i) {
+            fCounts[i] += other.fCounts[i];
+        }
+        fCount += other.fCount;
+        fMax = std::max(fMax, other.fMax);
+        fMin = std::min(fMin, other.fMin);
+    }
+
+    uint64_t Count() const { return fCount; }
+    uint64_t Max() const { return fCount > 0 ? fMax : 0; }
+    uint64_t Min() const { return fCount > 0 ? fMin : 0; }
+
+    void Reset()
+    {
+        std::fill(fCounts.begin(), fCounts.end(), 0);
+        fCount = 0;
+        fMax = 0;
+        fMin = UINT64_MAX;
+    }
+
+  private:
+    // values below 2^bits have their own bucket, above the bucket width doubles every 2^(bits-1) buckets
+    size_t Index(uint64_t value) const
+    {
+        if (value < (uint64_t(1) << fSubBucketBits)) {
+            return value;
+        }
+        unsigned int shift = 64 - __builtin_clzll(value) - fSubBucketBits;
+        return (size_t(shift) << (fSubBucketBits - 1)) + (value >> shift);
+    }
+
+    uint64_t HighestEquivalent(size_t index) const
+    {
+        if (index < (size_t(1) << fSubBucketBits)) {
+            return index;
+        }
+        size_t shift = (index >> (fSubBucketBits - 1)) - 1;
+        uint64_t subBucket = index - (shift << (fSubBucketBits - 1));
+        uint64_t next = (subBucket + 1) << shift;
+        return next == 0 ? UINT64_MAX : next - 1;
+    }
+
+    unsigned int fSubBucketBits;
+    std::vector<uint64_t> fCounts;
+    uint64_t fCount = 0;
+    uint64_t fMax = 0;
+    uint64_t fMin = UINT64_MAX;
+};
+
+/// Detects lost and reordered messages from the sequence numbers of the stamps, per source
+class SequenceTracker
+{
+  public:
+    void Record(uint64_t source, uint64_t seq)
+    {
+        auto it = fNext.find(source);
+        if (it == fNext.end()) {
+            fNext.emplace(source, seq + 1);
+            return;
+        }
+        if (seq >= it->second) {
+            fLost += seq - it->second;
+            it->second = seq + 1;
+        } else {
+            // arrived after a later message, was counted as lost
+            ++fReordered;
+            if (fLost > 0) {
+                --fLost;
+            }
+        }
+    }
+
+    uint64_t Lost() const { return fLost; }
+    uint64_t Reordered() const { return fReordered; }
+    size_t NumSources() const { return fNext.size(); }
+
+  private:
+    std::unordered_map<uint64_t, uint64_t> fNext; // next expected sequence number per source
+    uint64_t fLost = 0;
+    uint64_t fReordered = 0;
+};
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_LATENCY_H */
@@ -0,0 +1,102 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "Log.h"
+
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <utility> // swap
+
+namespace fair::mq::tools
+{
+
+namespace
+{
+const std::string kSinkName = "fairmq-async-console";
+}
+
+AsyncLogSink::AsyncLogSink(size_t capacity)
+    : fCapacity(capacity > 0 ? capacity : 1)
+    , fConsoleSeverity(fair::Logger::GetConsoleSeverity())
+    , fStop(false)
+    , fNumDropped(0)
+{
+    fThread = std::thread(&AsyncLogSink::Run, this);
+    fair::Logger::AddCustomSink(kSinkName, fConsoleSeverity, [this](const std::string& content, const fair::LogMetaData& metadata) { Push(content, metadata); });
+    fair::Logger::SetConsoleSeverity(fair::Severity::nolog);
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+    fair::Logger::RemoveCustomSink(kSinkName);
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        fStop = true;
+    }
+    fCV.notify_one();
+    fThread.join();
+    fair::Logger::SetConsoleSeverity(fConsoleSeverity);
+}
+
+void AsyncLogSink::SetSeverity(const std::string& severity)
+{
+    fair::Logger::RemoveCustomSink(kSinkName);
+    fair::Logger::AddCustomSink(kSinkName, severity, [this](const std::string& content, const fair::LogMetaData& metadata) { Push(content, metadata); });
+}
+
+void AsyncLogSink::Push(const std::string& content, const fair::LogMetaData& metadata)
+{
+    std::tm time{};
+    std::time_t timestamp = metadata.timestamp;
+    localtime_r(&timestamp, &time);
+    std::ostringstream line;
+    line << "[" << std::put_time(&time, "%H:%M:%S") << "." << std::setw(6) << std::setfill('0') << metadata.us.count() << "]"
+         << "[" << std::string(metadata.severity_name) << "] " << content << '\n';
+
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        if (fLines.size() >= fCapacity) {
+            fNumDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        fLines.push_back(line.str());
+    }
+    fCV.notify_one();
+}
+
+void AsyncLogSink::Run()
+{
+    std::deque<std::string> lines;
+    uint64_t reportedDropped = 0;
+    while (true) {
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(fMtx);
+            fCV.wait(lock, [&] { return fStop || !fLines.empty(); });
+            std::swap(lines, fLines);
+            stop = fStop;
+        }
+        const uint64_t dropped = fNumDropped.load(std::memory_order_relaxed);
+        if (dropped != reportedDropped) {
+            std::fprintf(stdout, "[fairmq] %llu log line(s) dropped, the console could not keep up\n", static_cast<unsigned long long>(dropped - reportedDropped));
+            reportedDropped = dropped;
+        }
+        for (const auto& line : lines) {
+            std::fwrite(line.data(), 1, line.size(), stdout);
+        }
+        std::fflush(stdout);
+        lines.clear();
+        if (stop) {
+            break;
+        }
+    }
+}
+
+} // namespace fair::mq::tools
@@ -0,0 +1,106 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_LOG_H
+#define FAIR_MQ_TOOLS_LOG_H
+
+#include <fairlogger/Logger.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fair::mq::tools
+{
+
+/// State of one FAIRMQ_LOG_RATE_LIMITED call site: the first message of every interval passes, the others are counted
+class LogRateLimiter
+{
+  public:
+    explicit LogRateLimiter(std::chrono::milliseconds interval)
+        : fIntervalNs(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count())
+    {}
+
+    /// @param suppressed returns the number of messages suppressed since the last one that passed
+    /// @return true if the message passes
+    bool Allow(uint64_t& suppressed)
+    {
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t next = fNextNs.load(std::memory_order_relaxed);
+        if (now < next || !fNextNs.compare_exchange_strong(next, now + fIntervalNs, std::memory_order_relaxed)) {
+            fSuppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = fSuppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+  private:
+    int64_t fIntervalNs;
+    std::atomic<int64_t> fNextNs{0};
+    std::atomic<uint64_t> fSuppressed{0};
+};
+
+inline std::string SuppressedNote(uint64_t suppressed)
+{
+    return suppressed == 0 ? std::string() : "[" + std::to_string(suppressed) + " similar message(s) suppressed] ";
+}
+
+/// Console output of FairLogger from a background thread (--log-async): the logging threads only format their lines
+/// and queue them, the thread writes them to stdout. Lines that do not fit into the queue are dropped (and counted)
+/// instead of blocking the logging thread, the next written line reports how many.
+class AsyncLogSink
+{
+  public:
+    static constexpr size_t DefaultCapacity = 65536;
+
+    /// takes over the console output with the current console severity, the console sink is set to nolog meanwhile
+    explicit AsyncLogSink(size_t capacity = DefaultCapacity);
+    AsyncLogSink(const AsyncLogSink&) = delete;
+    AsyncLogSink(AsyncLogSink&&) = delete;
+    AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+    AsyncLogSink& operator=(AsyncLogSink&&) = delete;
+    /// writes the queued lines and restores the console sink
+    ~AsyncLogSink();
+
+    void SetSeverity(const std::string& severity);
+    uint64_t GetNumDropped() const { return fNumDropped.load(std::memory_order_relaxed); }
+
+  private:
+    void Push(const std::string& content, const fair::LogMetaData& metadata);
+    void Run();
+
+    size_t fCapacity;
+    fair::Severity fConsoleSeverity;
+    std::mutex fMtx;
+    std::condition_variable fCV;
+    std::deque<std::string> fLines; // guarded by fMtx
+    bool fStop; // guarded by fMtx
+    std::atomic<uint64_t> fNumDropped;
+    std::thread fThread;
+};
+
+} // namespace fair::mq::tools
+
+/// LOG(severity) for hot paths (per message/transfer): per call site at most one message per interval passes, it
+/// reports how many were suppressed in between. Usage: FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << "...";
+#define FAIRMQ_LOG_RATE_LIMITED(severity, intervalMs)                                                          \
+    if (uint64_t fairMqLogSuppressed = 0; ![]() -> ::fair::mq::tools::LogRateLimiter& {                          \
+            static ::fair::mq::tools::LogRateLimiter limiter{std::chrono::milliseconds(intervalMs)};            \
+            return limiter;                                                                                      \
+        }().Allow(fairMqLogSuppressed)) {                                                                        \
+    } else                                                                                                       \
+        LOG(severity) << ::fair::mq::tools::SuppressedNote(fairMqLogSuppressed)
+
+#endif /* FAIR_MQ_TOOLS_LOG_H */
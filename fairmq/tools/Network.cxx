@@ -15,19 +15,35 @@
 
 #include <algorithm>
 #include <array>
-#include <boost/algorithm/string.hpp>   // trim
 #include <boost/asio.hpp>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>   // memcpy, strerror
 #include <exception>
 #include <fstream>
 #include <ifaddrs.h>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <net/if.h>  // if_indextoname
 #include <netdb.h>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <unistd.h>  // close
+#include <vector>
+
+#ifdef __APPLE__
+#include <net/route.h>
+#include <netinet/in.h>
+#include <sys/sysctl.h>
+#else
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
 
 using namespace std;
 
@@ -74,34 +90,114 @@ map<string, string> getHostIPs()
     return addressMap;
 }
 
-// get IP address of a given interface name
-string getInterfaceIP(const string& interface)
+namespace {
+
+mutex gCacheMtx;
+map<string, string> gInterfaceIPs; // successful lookups of getInterfaceIP
+string gDefaultRouteInterface;     // result of getDefaultRouteNetworkInterface
+
+#ifdef __APPLE__
+// walk the routing table (sysctl NET_RT_DUMP) for the IPv4 default route
+string queryDefaultRouteInterface()
 {
-    try {
-        auto IPs = getHostIPs();
-        if (IPs.count(interface) > 0) {
-            return IPs[interface];
+    array<int, 6> mib{CTL_NET, PF_ROUTE, 0, AF_INET, NET_RT_DUMP, 0};
+    size_t size = 0;
+    if (sysctl(mib.data(), mib.size(), nullptr, &size, nullptr, 0) != 0) {
+        return "";
+    }
+    vector<char> buf(size);
+    if (sysctl(mib.data(), mib.size(), buf.data(), &size, nullptr, 0) != 0) {
+        return "";
+    }
+    for (size_t pos = 0; pos + sizeof(rt_msghdr) <= size;) {
+        const auto* rtm = reinterpret_cast<const rt_msghdr*>(buf.data() + pos);
+        if (rtm->rtm_msglen == 0) {
+            break;
         }
-        LOG(error) << "Could not find provided network interface: \""
-                   << interface << "\"!, exiting.";
+        const auto* dst = reinterpret_cast<const sockaddr_in*>(rtm + 1);
+        if ((rtm->rtm_flags & RTF_GATEWAY) && (rtm->rtm_addrs & RTA_DST) && dst->sin_family == AF_INET && dst->sin_addr.s_addr == INADDR_ANY) {
+            array<char, IF_NAMESIZE> name{};
+            if (if_indextoname(rtm->rtm_index, name.data())) {
+                return name.data();
+            }
+        }
+        pos += rtm->rtm_msglen;
+    }
+    return "";
+}
+#else
+// dump the main IPv4 routing table via rtnetlink and return the output interface of the default route (the one with
+// the lowest metric, if there are several)
+string queryDefaultRouteInterface()
+{
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        LOG(debug) << "could not open rtnetlink socket: " << strerror(errno);
         return "";
-    } catch (runtime_error& re) {
-        cout << "could not get interface IP: " << re.what();
+    }
+    unique_ptr<int, void(*)(int*)> closer(&fd, [](int* f) { close(*f); });
+
+    struct
+    {
+        nlmsghdr nlh;
+        rtmsg rtm;
+    } req{};
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(rtmsg));
+    req.nlh.nlmsg_type = RTM_GETROUTE;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = 1;
+    req.rtm.rtm_family = AF_INET;
+    req.rtm.rtm_table = RT_TABLE_MAIN;
+    if (send(fd, &req, req.nlh.nlmsg_len, 0) < 0) {
+        LOG(debug) << "could not send rtnetlink route request: " << strerror(errno);
         return "";
     }
+
+    int oif = 0;
+    uint32_t bestMetric = numeric_limits<uint32_t>::max();
+    array<char, 32768> buf{};
+    while (true) {
+        ssize_t len = recv(fd, buf.data(), buf.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG(debug) << "could not receive rtnetlink routes: " << strerror(errno);
+            return "";
+        }
+        for (auto* nlh = reinterpret_cast<nlmsghdr*>(buf.data()); NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                array<char, IF_NAMESIZE> name{};
+                return oif > 0 && if_indextoname(static_cast<unsigned int>(oif), name.data()) ? string(name.data()) : string();
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                return "";
+            }
+            auto* rtm = static_cast<rtmsg*>(NLMSG_DATA(nlh));
+            if (nlh->nlmsg_type != RTM_NEWROUTE || rtm->rtm_family != AF_INET || rtm->rtm_dst_len != 0 || rtm->rtm_table != RT_TABLE_MAIN) {
+                continue;
+            }
+            int routeOif = 0;
+            uint32_t metric = 0;
+            int attrLen = static_cast<int>(RTM_PAYLOAD(nlh));
+            for (auto* rta = RTM_RTA(rtm); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+                if (rta->rta_type == RTA_OIF) {
+                    memcpy(&routeOif, RTA_DATA(rta), sizeof(routeOif));
+                } else if (rta->rta_type == RTA_PRIORITY) {
+                    memcpy(&metric, RTA_DATA(rta), sizeof(metric));
+                }
+            }
+            if (routeOif > 0 && (oif == 0 || metric < bestMetric)) {
+                oif = routeOif;
+                bestMetric = metric;
+            }
+        }
+    }
 }
 
-// get name of the default route interface
-string getDefaultRouteNetworkInterface()
+// fallback for systems without rtnetlink access (e.g. restricted containers)
+string readDefaultRouteInterfaceFromProc()
 {
-    const int BUFSIZE(128);
-    array<char, BUFSIZE> buffer{};
-    string interfaceName;
-
-#ifdef __APPLE__   // MacOS
-    unique_ptr<FILE, decltype(pclose)*> file(
-        popen("route -n get default | grep interface | cut -d \":\" -f 2", "r"), pclose);
-#else   // Linux
     ifstream is("/proc/net/route");
     string line;
 
@@ -109,51 +205,70 @@ string getDefaultRouteNetworkInterface()
     getline(is, line);
 
     // check each line, until 00000000 destination is found
-    while (!is.eof()) {
-        getline(is, line);
+    while (getline(is, line)) {
         size_t pos = line.find('\t');
-
         if (pos == string::npos) {
             break;
         }
-
         if (line.substr(pos + 1, 8) == "00000000") {
-            interfaceName = line.substr(0, pos);
-            LOG(debug) << "Detected network interface name for the default route: "
-                       << interfaceName;
-            return interfaceName;
+            return line.substr(0, pos);
         }
     }
-
-    LOG(debug) << "could not get network interface of the default route from /proc/net/route, "
-                  "going to try via 'ip route'";
-
-    unique_ptr<FILE, decltype(pclose)*> file(
-        popen("ip route | grep default | cut -d \" \" -f 5 | head -n 1", "r"), pclose);
+    return "";
+}
 #endif
 
-    if (!file) {
-        LOG(error) << "Could not detect default route network interface name - popen() failed!";
+} // namespace
+
+// get IP address of a given interface name
+string getInterfaceIP(const string& interface)
+{
+    {
+        lock_guard<mutex> lock(gCacheMtx);
+        auto it = gInterfaceIPs.find(interface);
+        if (it != gInterfaceIPs.end()) {
+            return it->second;
+        }
+    }
+    try {
+        auto IPs = getHostIPs();
+        if (IPs.count(interface) > 0) {
+            lock_guard<mutex> lock(gCacheMtx);
+            gInterfaceIPs.insert(IPs.begin(), IPs.end());
+            return IPs[interface];
+        }
+        LOG(error) << "Could not find provided network interface: \""
+                   << interface << "\"!, exiting.";
+        return "";
+    } catch (runtime_error& re) {
+        cout << "could not get interface IP: " << re.what();
         return "";
     }
+}
 
-    while (feof(file.get()) == 0) {
-        if (fgets(buffer.data(), BUFSIZE, file.get()) != nullptr) {
-            interfaceName += buffer.data();
-        }
+// get name of the default route interface
+string getDefaultRouteNetworkInterface()
+{
+    lock_guard<mutex> lock(gCacheMtx);
+    if (!gDefaultRouteInterface.empty()) {
+        return gDefaultRouteInterface;
     }
 
-    boost::algorithm::trim(interfaceName);
+    string interfaceName = queryDefaultRouteInterface();
+#ifndef __APPLE__
+    if (interfaceName.empty()) {
+        LOG(debug) << "could not get network interface of the default route via rtnetlink, going to try /proc/net/route";
+        interfaceName = readDefaultRouteInterfaceFromProc();
+    }
+#endif
 
     if (interfaceName.empty()) {
-        LOG(debug) << "Could not detect default route network interface name from /proc/net/route "
-                      "nor 'ip route'";
-        throw DefaultRouteDetectionError("Could not detect default route network interface name "
-                                         "from /proc/net/route nor 'ip route'");
-    } else {
-        LOG(debug) << "Detected network interface name for the default route: " << interfaceName;
+        LOG(debug) << "Could not detect default route network interface name";
+        throw DefaultRouteDetectionError("Could not detect default route network interface name");
     }
 
+    LOG(debug) << "Detected network interface name for the default route: " << interfaceName;
+    gDefaultRouteInterface = interfaceName;
     return interfaceName;
 }
 
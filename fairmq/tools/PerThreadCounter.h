@@ -0,0 +1,69 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_PERTHREADCOUNTER_H
+#define FAIR_MQ_TOOLS_PERTHREADCOUNTER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstdint>
+
+namespace fair::mq::tools
+{
+
+/**
+ * @class PerThreadCounter PerThreadCounter.h <fairmq/tools/PerThreadCounter.h>
+ * @brief Counter that many threads increment without sharing a cache line
+ *
+ * Every thread adds to one of kNumShards cache-line-padded shards (chosen by a per-thread index, so up to kNumShards
+ * threads never share one), Get() sums the shards. Add() is a relaxed fetch_add on a line that usually stays in the
+ * cache of the adding thread. Get() is not a snapshot across the shards, concurrent additions may or may not be included.
+ */
+class PerThreadCounter
+{
+  public:
+    static constexpr size_t kNumShards = 32;
+
+    void Add(uint64_t n = 1) { fShards[ThreadIndex() % kNumShards].fValue.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t Get() const
+    {
+        uint64_t sum = 0;
+        for (const auto& shard : fShards) {
+            sum += shard.fValue.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    void Reset()
+    {
+        for (auto& shard : fShards) {
+            shard.fValue.store(0, std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> fValue{0};
+    };
+
+    static size_t ThreadIndex()
+    {
+        static std::atomic<size_t> next{0};
+        thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    std::array<Shard, kNumShards> fShards;
+};
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_PERTHREADCOUNTER_H */
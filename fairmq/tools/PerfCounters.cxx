@@ -0,0 +1,95 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/tools/PerfCounters.h>
+
+#include <fairlogger/Logger.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h> // close, read, syscall
+
+#include <cerrno>
+#include <cstring> // strerror
+#include <memory>
+
+namespace fair::mq::tools
+{
+
+namespace
+{
+
+int OpenEvent(uint32_t type, uint64_t config, int groupFd)
+{
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = groupFd < 0 ? 1 : 0; // the group is enabled with its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // pid 0, cpu -1: the calling thread on any CPU
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+}
+
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+    const uint64_t configs[kNumEvents] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < kNumEvents; ++i) {
+        fFds[i] = OpenEvent(PERF_TYPE_HARDWARE, configs[i], i == 0 ? -1 : fFds[0]);
+        fIndex[i] = fFds[i] < 0 ? -1 : fNumOpen++;
+        if (i == 0 && fFds[0] < 0) {
+            return;
+        }
+    }
+    ioctl(fFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int fd : fFds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+PerfCounters* PerfCounters::ForThisThread()
+{
+    thread_local std::unique_ptr<PerfCounters> counters = [] {
+        std::unique_ptr<PerfCounters> c(new PerfCounters());
+        if (c->fFds[0] < 0) {
+            LOG(warn) << "Hardware performance counters not available for this thread: " << strerror(errno);
+            c.reset();
+        }
+        return c;
+    }();
+    return counters.get();
+}
+
+bool PerfCounters::Read(PerfCounts& counts) const
+{
+    // PERF_FORMAT_GROUP: number of events, then their values in the order they were added
+    uint64_t values[1 + kNumEvents] = {};
+    if (::read(fFds[0], values, sizeof(values)) < static_cast<ssize_t>((1 + fNumOpen) * sizeof(uint64_t))) {
+        return false;
+    }
+    auto value = [&](int event) { return fIndex[event] < 0 ? 0 : values[1 + fIndex[event]]; };
+    counts.cycles = value(0);
+    counts.instructions = value(1);
+    counts.llcMisses = value(2);
+    counts.branchMisses = value(3);
+    return true;
+}
+
+} // namespace fair::mq::tools
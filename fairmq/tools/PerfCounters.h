@@ -0,0 +1,65 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_PERFCOUNTERS_H
+#define FAIR_MQ_TOOLS_PERFCOUNTERS_H
+
+#include <cstdint>
+
+namespace fair::mq::tools
+{
+
+/// Values of the hardware counters of PerfCounters (counted in user space only)
+struct PerfCounts
+{
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t llcMisses = 0;      ///< last level cache misses
+    uint64_t branchMisses = 0;
+
+    PerfCounts operator-(const PerfCounts& other) const
+    {
+        return {cycles - other.cycles, instructions - other.instructions, llcMisses - other.llcMisses, branchMisses - other.branchMisses};
+    }
+};
+
+/**
+ * @class PerfCounters PerfCounters.h <fairmq/tools/PerfCounters.h>
+ * @brief Hardware performance counters of the calling thread (Linux perf_event, one group read with one syscall)
+ *
+ * Counters the CPU or the virtual machine does not provide stay 0. Opening fails without the permission to count the
+ * own threads (kernel.perf_event_paranoid > 2, or seccomp filters of containers).
+ */
+class PerfCounters
+{
+  public:
+    /// counters of the calling thread, opened on first use
+    /// @return nullptr if perf_event is not available
+    static PerfCounters* ForThisThread();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters(PerfCounters&&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    PerfCounters& operator=(PerfCounters&&) = delete;
+    ~PerfCounters();
+
+    /// @return false if the counters could not be read
+    bool Read(PerfCounts& counts) const;
+
+  private:
+    PerfCounters();
+
+    static constexpr int kNumEvents = 4;
+    int fFds[kNumEvents]; // group leader (cycles) first, -1 if not available
+    int fIndex[kNumEvents]; // position of the event in the group read, -1 if not available
+    int fNumOpen = 0;
+};
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_PERFCOUNTERS_H */
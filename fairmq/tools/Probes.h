@@ -0,0 +1,29 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_PROBES_H
+#define FAIR_MQ_TOOLS_PROBES_H
+
+// Static tracepoints (USDT) of the provider "fairmq", for bpftrace, perf and SystemTap (see docs/Development.md).
+// A probe compiles to a nop and an ELF note, so it costs nothing while no tracer is attached, but its arguments are
+// still evaluated: keep them to values at hand. Requires <sys/sdt.h> (systemtap-sdt-dev(el)), without it or with
+// FAIRMQ_DISABLE_PROBES defined the probes compile to nothing.
+#if !defined(FAIRMQ_DISABLE_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define FAIRMQ_HAS_PROBES 1
+#endif
+#endif
+
+#ifdef FAIRMQ_HAS_PROBES
+#define FAIRMQ_PROBE(name, ...) STAP_PROBEV(fairmq, name, __VA_ARGS__)
+#else
+#define FAIRMQ_PROBE(name, ...) do {} while (false)
+#endif
+
+#endif /* FAIR_MQ_TOOLS_PROBES_H */
@@ -0,0 +1,233 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_QUEUES_H
+#define FAIR_MQ_TOOLS_QUEUES_H
+
+#include <atomic>
+#include <cstddef> // size_t, ptrdiff_t
+#include <memory> // unique_ptr
+#include <utility> // move
+
+namespace fair::mq::tools
+{
+
+namespace detail
+{
+
+inline size_t RoundUpToPowerOfTwo(size_t n)
+{
+    size_t c = 2;
+    while (c < n) {
+        c <<= 1;
+    }
+    return c;
+}
+
+} // namespace detail
+
+/**
+ * @class SpscQueue Queues.h <fairmq/tools/Queues.h>
+ * @brief Bounded lock-free single-producer/single-consumer queue
+ *
+ * A ring of cells with the push and pop positions on separate cache lines. Each side keeps a copy of the position of the
+ * other side and only reloads it when the ring looks full (empty), so that a push or pop usually touches no cache line
+ * written by the other thread. T has to be default constructible and movable, e.g. MessagePtr or Parts. Non-blocking,
+ * combine it with a SpinParkWaiter (<fairmq/tools/Futex.h>) to wait for data or space.
+ */
+template<typename T>
+class SpscQueue
+{
+  public:
+    /// @param capacity rounded up to a power of two
+    explicit SpscQueue(size_t capacity)
+        : fMask(detail::RoundUpToPowerOfTwo(capacity) - 1)
+        , fCells(std::make_unique<T[]>(fMask + 1))
+    {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue(SpscQueue&&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    SpscQueue& operator=(SpscQueue&&) = delete;
+
+    /// producer only. value is only moved from on success
+    bool TryPush(T&& value)
+    {
+        const size_t pos = fPushPos.load(std::memory_order_relaxed);
+        if (!HasSpace(pos)) {
+            return false;
+        }
+        fCells[pos & fMask] = std::move(value);
+        fPushPos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    bool TryPush(const T& value)
+    {
+        T copy(value);
+        return TryPush(std::move(copy));
+    }
+
+    /// consumer only
+    bool TryPop(T& value)
+    {
+        const size_t pos = fPopPos.load(std::memory_order_relaxed);
+        if (pos == fCachedPushPos) {
+            fCachedPushPos = fPushPos.load(std::memory_order_acquire);
+            if (pos == fCachedPushPos) {
+                return false; // empty
+            }
+        }
+        value = std::move(fCells[pos & fMask]);
+        fPopPos.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // snapshots, exact only on the side that does not change them
+    bool Empty() const { return fPopPos.load(std::memory_order_acquire) == fPushPos.load(std::memory_order_acquire); }
+    size_t Size() const
+    {
+        const size_t pop = fPopPos.load(std::memory_order_acquire);
+        const size_t push = fPushPos.load(std::memory_order_acquire);
+        return push > pop ? push - pop : 0;
+    }
+    size_t Capacity() const { return fMask + 1; }
+
+  private:
+    bool HasSpace(size_t pos)
+    {
+        if (pos - fCachedPopPos <= fMask) {
+            return true;
+        }
+        fCachedPopPos = fPopPos.load(std::memory_order_acquire);
+        return pos - fCachedPopPos <= fMask;
+    }
+
+    const size_t fMask;
+    std::unique_ptr<T[]> fCells;
+    alignas(64) std::atomic<size_t> fPushPos{0};
+    size_t fCachedPopPos = 0; // producer's copy of fPopPos
+    alignas(64) std::atomic<size_t> fPopPos{0};
+    size_t fCachedPushPos = 0; // consumer's copy of fPushPos
+};
+
+/**
+ * @class MpmcQueue Queues.h <fairmq/tools/Queues.h>
+ * @brief Bounded lock-free multi-producer/multi-consumer queue (D. Vyukov)
+ *
+ * Every cell carries a sequence number that tells producers and consumers whether it is free for the current lap, so a
+ * push or a pop is a single CAS on the position. T has to be default constructible and movable, e.g. MessagePtr or Parts.
+ * Non-blocking, combine it with a SpinParkWaiter (<fairmq/tools/Futex.h>) to wait for data or space.
+ */
+template<typename T>
+class MpmcQueue
+{
+    struct Cell
+    {
+        std::atomic<size_t> fSeq;
+        T fData;
+    };
+
+  public:
+    /// @param capacity rounded up to a power of two
+    explicit MpmcQueue(size_t capacity)
+        : fMask(detail::RoundUpToPowerOfTwo(capacity) - 1)
+        , fCells(std::make_unique<Cell[]>(fMask + 1))
+        , fPushPos(0)
+        , fPopPos(0)
+    {
+        for (size_t i = 0; i <= fMask; ++i) {
+            fCells[i].fSeq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue(MpmcQueue&&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(MpmcQueue&&) = delete;
+
+    /// value is only moved from on success
+    bool TryPush(T&& value)
+    {
+        size_t pos = fPushPos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &fCells[pos & fMask];
+            auto diff = static_cast<std::ptrdiff_t>(cell->fSeq.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (fPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = fPushPos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->fData = std::move(value);
+        cell->fSeq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    bool TryPush(const T& value)
+    {
+        T copy(value);
+        return TryPush(std::move(copy));
+    }
+
+    bool TryPop(T& value)
+    {
+        size_t pos = fPopPos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &fCells[pos & fMask];
+            auto diff = static_cast<std::ptrdiff_t>(cell->fSeq.load(std::memory_order_acquire) - (pos + 1));
+            if (diff == 0) {
+                if (fPopPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = fPopPos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->fData);
+        cell->fSeq.store(pos + fMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // snapshots, exact only while nobody else pushes/pops
+    bool Empty() const
+    {
+        size_t pos = fPopPos.load(std::memory_order_relaxed);
+        return static_cast<std::ptrdiff_t>(fCells[pos & fMask].fSeq.load(std::memory_order_acquire) - (pos + 1)) < 0;
+    }
+    bool Full() const
+    {
+        size_t pos = fPushPos.load(std::memory_order_relaxed);
+        return static_cast<std::ptrdiff_t>(fCells[pos & fMask].fSeq.load(std::memory_order_acquire) - pos) < 0;
+    }
+
+    size_t Size() const
+    {
+        size_t push = fPushPos.load(std::memory_order_relaxed);
+        size_t pop = fPopPos.load(std::memory_order_relaxed);
+        return push > pop ? push - pop : 0;
+    }
+
+    size_t Capacity() const { return fMask + 1; }
+
+  private:
+    const size_t fMask;
+    std::unique_ptr<Cell[]> fCells;
+    alignas(64) std::atomic<size_t> fPushPos;
+    alignas(64) std::atomic<size_t> fPopPos;
+};
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_QUEUES_H */
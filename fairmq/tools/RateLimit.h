@@ -9,7 +9,9 @@
 #ifndef FAIR_MQ_TOOLS_RATELIMIT_H
 #define FAIR_MQ_TOOLS_RATELIMIT_H
 
+#include <algorithm> // max, min
 #include <cassert>
+#include <stdexcept>
 #include <string>
 // #include <iostream>
 #include <iomanip>
@@ -19,6 +21,26 @@
 namespace fair::mq::tools
 {
 
+enum class RateLimitMode
+{
+    adaptive,   //! sleeps, adapting the sleep time to the measured rate (for low rates, least CPU)
+    precise,    //! paces every call: sleeps for long waits and spins for the last part (smooth high rates, spins a core)
+    tokenBucket //! as precise, but after idle time up to `burst` calls pass without waiting
+};
+
+/// @param mode "adaptive", "precise" or "token-bucket"
+inline RateLimitMode ParseRateLimitMode(const std::string& mode)
+{
+    if (mode == "adaptive") {
+        return RateLimitMode::adaptive;
+    } else if (mode == "precise") {
+        return RateLimitMode::precise;
+    } else if (mode == "token-bucket") {
+        return RateLimitMode::tokenBucket;
+    }
+    throw std::runtime_error("Invalid rate limit mode '" + mode + "', valid are 'adaptive', 'precise' and 'token-bucket'");
+}
+
 /**
  * Objects of type RateLimiter can be used to limit a loop to a given rate of iterations per second.
  *
@@ -31,6 +53,11 @@ namespace fair::mq::tools
  *                          // correct time measurement of the first iterations
  * }
  * \endcode
+ *
+ * The default (adaptive) mode only sleeps, with the scheduler granularity rates above ~100 kHz become jittery
+ * and the iterations come in bursts. RateLimitMode::precise spaces every iteration by spinning on the
+ * (vDSO, TSC based) steady_clock for waits shorter than the sleep granularity. RateLimitMode::tokenBucket
+ * additionally lets up to `burst` iterations pass back-to-back after the loop was slower than the rate.
  */
 class RateLimiter
 {
@@ -43,16 +70,24 @@ class RateLimiter
      * \param rate Work rate in Hz (calls to maybe_sleep per second). Values less than/equal
      *             to 0 set the rate to 1 GHz (which is impossible to achieve, even with a
      *             loop that only calls RateLimiter::maybe_sleep).
+     * \param mode How the rate is enforced, see RateLimitMode.
+     * \param burst Size of the token bucket (RateLimitMode::tokenBucket only).
      */
-    explicit RateLimiter(float rate)
+    explicit RateLimiter(float rate, RateLimitMode mode = RateLimitMode::adaptive, unsigned int burst = 1)
         : tw_req(std::chrono::seconds(1))
         , start_time(clock::now())
+        , rate_mode(mode)
     {
         if (rate <= 0) {
             tw_req = std::chrono::nanoseconds(1);
         } else {
             tw_req = std::chrono::duration_cast<clock::duration>(tw_req / rate);
         }
+        if (mode == RateLimitMode::tokenBucket) {
+            tau = tw_req * (std::max(burst, 1U) - 1);
+        }
+        // the first call passes (the first `burst` calls in tokenBucket mode), like the first after idle time
+        tat = start_time;
         skip_check_count = std::max(1, int(std::chrono::milliseconds(5) / tw_req));
         count = skip_check_count;
         // std::cerr << "skip_check_count: " << skip_check_count << '\n';
@@ -68,6 +103,10 @@ class RateLimiter
     void maybe_sleep()
     {
         using namespace std::chrono;
+        if (rate_mode != RateLimitMode::adaptive) {
+            pace();
+            return;
+        }
         if (--count == 0) {
             auto now = clock::now();
             if (tw == clock::duration::zero()) {
@@ -124,12 +163,41 @@ class RateLimiter
     }
 
   private:
+    // waits shorter than this are spun instead of slept (sleeps overshoot by the timer slack and wakeup latency)
+    static constexpr std::chrono::microseconds spin_threshold{100};
+
+    // virtual scheduling (GCRA): tat is the theoretical start time of the next iteration, which may start
+    // up to tau (burst - 1 periods) earlier
+    void pace()
+    {
+        auto now = clock::now();
+        auto allowed = tat - tau;
+        if (allowed > now) {
+            if (allowed - now > spin_threshold) {
+                std::this_thread::sleep_for(allowed - now - spin_threshold);
+            }
+            while (clock::now() < allowed) {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#elif defined(__aarch64__)
+                asm volatile("yield");
+#endif
+            }
+            now = allowed;
+        }
+        // a loop slower than the rate does not build up credit beyond the burst
+        tat = std::max(tat, now) + tw_req;
+    }
+
     clock::duration tw{},   //! deduced duration between maybe_sleep calls
         ts{},               //! sleep duration
         tw_req;             //! requested duration between maybe_sleep calls
     clock::time_point start_time;
     int count = 1;
     int skip_check_count = 1;
+    RateLimitMode rate_mode;
+    clock::duration tau{};  //! burst tolerance (tokenBucket)
+    clock::time_point tat;  //! theoretical arrival time (precise, tokenBucket)
 };
 
 } // namespace fair::mq::tools
@@ -0,0 +1,145 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/tools/Threads.h>
+#include <fairmq/tools/Strings.h>
+
+#include <cerrno>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h> // pthread_setaffinity_np, pthread_setschedparam
+#include <sched.h>
+#include <sys/mman.h> // mlockall
+#include <sys/syscall.h> // SYS_get_mempolicy
+#include <unistd.h> // syscall
+#endif
+
+using namespace std;
+
+namespace fair::mq::tools
+{
+
+vector<int> ParseCpuList(const string& list)
+{
+    vector<int> cpus;
+    istringstream ss(list);
+    string item;
+    while (getline(ss, item, ':')) {
+        try {
+            size_t dash = item.find('-');
+            if (dash == string::npos) {
+                cpus.push_back(stoi(item));
+            } else {
+                int first = stoi(item.substr(0, dash));
+                int last = stoi(item.substr(dash + 1));
+                if (first > last) {
+                    throw invalid_argument(item);
+                }
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+        } catch (const logic_error&) {
+            throw ThreadSettingsError(ToString("invalid CPU list '", list, "'"));
+        }
+    }
+    return cpus;
+}
+
+ThreadSettings ParseThreadSettings(const string& cpus, const string& policy, int priority)
+{
+    ThreadSettings settings;
+    settings.cpus = ParseCpuList(cpus);
+#ifdef __linux__
+    if (policy == "other") {
+        settings.schedPolicy = SCHED_OTHER;
+    } else if (policy == "fifo") {
+        settings.schedPolicy = SCHED_FIFO;
+    } else if (policy == "rr") {
+        settings.schedPolicy = SCHED_RR;
+    } else if (!policy.empty()) {
+        throw ThreadSettingsError(ToString("invalid scheduling policy '", policy, "', valid are 'other', 'fifo' and 'rr'"));
+    }
+    if (settings.schedPolicy >= 0 && priority >= 0
+     && (priority < sched_get_priority_min(settings.schedPolicy) || priority > sched_get_priority_max(settings.schedPolicy))) {
+        throw ThreadSettingsError(ToString("scheduling priority ", priority, " is out of the range of policy '", policy, "' (",
+            sched_get_priority_min(settings.schedPolicy), "-", sched_get_priority_max(settings.schedPolicy), ")"));
+    }
+#else
+    if (!policy.empty()) {
+        throw ThreadSettingsError("scheduling policies are only supported on Linux");
+    }
+#endif
+    settings.priority = priority;
+    return settings;
+}
+
+bool ApplyThreadSettings(const ThreadSettings& settings)
+{
+#ifdef __linux__
+    if (!settings.cpus.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu : settings.cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (rc != 0) {
+            errno = rc;
+            return false;
+        }
+    }
+    if (settings.schedPolicy >= 0) {
+        sched_param param{};
+        param.sched_priority = settings.priority >= 0 ? settings.priority : sched_get_priority_min(settings.schedPolicy);
+        int rc = pthread_setschedparam(pthread_self(), settings.schedPolicy, &param);
+        if (rc != 0) {
+            errno = rc;
+            return false;
+        }
+    }
+    return true;
+#else
+    if (settings.Empty()) {
+        return true;
+    }
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+bool LockAllMemory()
+{
+#ifdef __linux__
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#else
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+int NumaNodeOf(const void* ptr)
+{
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+    constexpr unsigned long mpolFNode = 1 << 0; // MPOL_F_NODE from numaif.h
+    constexpr unsigned long mpolFAddr = 1 << 1; // MPOL_F_ADDR from numaif.h
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0, const_cast<void*>(ptr), mpolFNode | mpolFAddr) != 0) {
+        return -1;
+    }
+    return node;
+#else
+    (void)ptr;
+    return -1;
+#endif
+}
+
+} // namespace fair::mq::tools
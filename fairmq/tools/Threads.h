@@ -0,0 +1,59 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_THREADS_H
+#define FAIR_MQ_TOOLS_THREADS_H
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fair::mq::tools
+{
+
+struct ThreadSettingsError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+/**
+ * @struct ThreadSettings Threads.h <fairmq/tools/Threads.h>
+ * @brief CPU affinity and scheduling of a thread (--cpu-affinity, --io-cpu-affinity, --sched-policy, --sched-priority)
+ */
+struct ThreadSettings
+{
+    std::vector<int> cpus;  ///< CPUs the thread is pinned to (empty: no pinning)
+    int schedPolicy = -1;   ///< SCHED_OTHER/SCHED_FIFO/SCHED_RR (-1: unchanged)
+    int priority = -1;      ///< scheduling priority (-1: the minimum of the policy)
+
+    bool Empty() const { return cpus.empty() && schedPolicy < 0; }
+};
+
+/// parse a list of CPUs, e.g. "2:4-7" (':' separated CPUs or ranges)
+/// @throw ThreadSettingsError
+std::vector<int> ParseCpuList(const std::string& list);
+
+/// @param cpus CPU list (empty: no pinning)
+/// @param policy "other", "fifo" or "rr" (empty: unchanged)
+/// @param priority scheduling priority (-1: the minimum of the policy)
+/// @throw ThreadSettingsError
+ThreadSettings ParseThreadSettings(const std::string& cpus, const std::string& policy, int priority);
+
+/// Apply the settings to the calling thread (Linux only)
+/// @return false on failure, with errno set
+bool ApplyThreadSettings(const ThreadSettings& settings);
+
+/// Lock all current and future pages of the process in memory (mlockall)
+/// @return false on failure, with errno set
+bool LockAllMemory();
+
+/// NUMA node of the memory page at ptr (get_mempolicy, faults the page in if it is not present). A system call,
+/// about as expensive as a small send on a local socket.
+/// @return NUMA node, -1 if unknown (no NUMA support, non-Linux)
+int NumaNodeOf(const void* ptr);
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_THREADS_H */
@@ -0,0 +1,64 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_TOOLS_WAKEUP_H
+#define FAIR_MQ_TOOLS_WAKEUP_H
+
+#include <fairmq/tools/Strings.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h> // close, read, write
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring> // strerror
+#include <stdexcept>
+
+namespace fair::mq::tools
+{
+
+/// An eventfd that stays readable from Signal() until Clear(), to wake up threads blocked in poll/epoll on it
+/// (see Poller::AddWakeup()). Signal() and Clear() are safe to call from any thread.
+class Wakeup
+{
+  public:
+    Wakeup()
+        : fFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    {
+        if (fFd < 0) {
+            throw std::runtime_error(ToString("Failed creating eventfd, reason: ", strerror(errno)));
+        }
+    }
+    Wakeup(const Wakeup&) = delete;
+    Wakeup(Wakeup&&) = delete;
+    Wakeup& operator=(const Wakeup&) = delete;
+    Wakeup& operator=(Wakeup&&) = delete;
+    ~Wakeup() { close(fFd); }
+
+    void Signal()
+    {
+        const uint64_t one = 1;
+        // the counter cannot overflow in practice, EAGAIN would mean it is readable anyway
+        [[maybe_unused]] auto written = write(fFd, &one, sizeof(one));
+    }
+
+    void Clear()
+    {
+        uint64_t count = 0;
+        [[maybe_unused]] auto read = ::read(fFd, &count, sizeof(count)); // EAGAIN if not signalled
+    }
+
+    int Fd() const { return fFd; }
+
+  private:
+    int fFd;
+};
+
+} // namespace fair::mq::tools
+
+#endif /* FAIR_MQ_TOOLS_WAKEUP_H */
@@ -0,0 +1,190 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+// fairmq-bench: runs producers and consumers in one process for every combination of the given parameters
+// and reports throughput, latency percentiles and CPU time per message as CSV or JSON.
+
+#include <fairmq/tools/Bench.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fairlogger/Logger.h>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm> // max
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace bpo = boost::program_options;
+using namespace fair::mq;
+
+namespace
+{
+
+using tools::BenchConfig;
+using tools::BenchResult;
+
+const vector<string> kColumns{"transport", "allocation", "msg_size", "num_parts", "producers", "consumers", "rate",
+    "sent", "received", "seconds", "msgs_per_s", "mb_per_s", "lat_p50_us", "lat_p99_us", "lat_p999_us", "lat_max_us", "cpu_us_per_msg"};
+
+vector<string> Row(const BenchConfig& cfg, const BenchResult& r)
+{
+    return {
+        cfg.transport,
+        cfg.transport == "zeromq" ? "-" : cfg.allocation,
+        to_string(cfg.msgSizes.front()),
+        to_string(cfg.numParts),
+        to_string(cfg.producers),
+        to_string(cfg.consumers),
+        tools::ToString(cfg.rate),
+        to_string(r.sent),
+        to_string(r.received),
+        tools::ToString(r.seconds),
+        tools::ToString(r.MessagesPerSecond()),
+        tools::ToString(r.MBPerSecond()),
+        tools::ToString(r.latency.Percentile(50.) / 1e3),
+        tools::ToString(r.latency.Percentile(99.) / 1e3),
+        tools::ToString(r.latency.Percentile(99.9) / 1e3),
+        tools::ToString(r.latency.Max() / 1e3),
+        tools::ToString(r.received > 0 ? r.cpuSeconds * 1e6 / r.received : 0)
+    };
+}
+
+void Report(ostream& out, const string& format, const vector<vector<string>>& rows)
+{
+    if (format == "json") {
+        out << "[\n";
+        for (size_t i = 0; i < rows.size(); ++i) {
+            out << "  {";
+            for (size_t c = 0; c < kColumns.size(); ++c) {
+                // the first two columns are strings
+                out << (c > 0 ? ", " : "") << "\"" << kColumns[c] << "\": " << (c < 2 ? "\"" : "") << rows[i][c] << (c < 2 ? "\"" : "");
+            }
+            out << "}" << (i + 1 < rows.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    } else {
+        for (size_t c = 0; c < kColumns.size(); ++c) {
+            out << (c > 0 ? "," : "") << kColumns[c];
+        }
+        out << "\n";
+        for (const auto& row : rows) {
+            for (size_t c = 0; c < row.size(); ++c) {
+                out << (c > 0 ? "," : "") << row[c];
+            }
+            out << "\n";
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        vector<string> transports;
+        vector<string> allocations;
+        vector<size_t> msgSizes;
+        vector<size_t> numParts;
+        vector<int> producers;
+        vector<int> consumers;
+        vector<float> rates;
+        double duration = 2;
+        size_t segmentSize = 0;
+        string format;
+        string output;
+        string severity;
+
+        bpo::options_description desc("Sweeps all combinations of the given parameters (lists are space separated)");
+        desc.add_options()
+            ("transport", bpo::value<vector<string>>(&transports)->multitoken()->default_value({"zeromq", "shmem"}, "zeromq shmem"), "Transports: zeromq, shmem, region (shmem with unmanaged region messages)")
+            ("allocation", bpo::value<vector<string>>(&allocations)->multitoken()->default_value({"rbtree_best_fit"}, "rbtree_best_fit"), "Shared memory allocation algorithms (shmem, region)")
+            ("msg-size", bpo::value<vector<size_t>>(&msgSizes)->multitoken()->default_value({1000, 100000, 1000000}, "1000 100000 1000000"), "Message (part) sizes in bytes")
+            ("num-parts", bpo::value<vector<size_t>>(&numParts)->multitoken()->default_value({1}, "1"), "Parts per message")
+            ("producers", bpo::value<vector<int>>(&producers)->multitoken()->default_value({1}, "1"), "Numbers of producers")
+            ("consumers", bpo::value<vector<int>>(&consumers)->multitoken()->default_value({1}, "1"), "Numbers of consumers")
+            ("rate", bpo::value<vector<float>>(&rates)->multitoken()->default_value({0}, "0"), "Message rates per producer in messages per second (0 - unlimited)")
+            ("duration", bpo::value<double>(&duration)->default_value(2), "Sending time per combination in seconds")
+            ("segment-size", bpo::value<size_t>(&segmentSize)->default_value(2000000000), "Shared memory segment size in bytes")
+            ("format", bpo::value<string>(&format)->default_value("csv"), "Report format: csv or json")
+            ("output", bpo::value<string>(&output)->default_value(""), "Report file (default: standard output)")
+            ("severity", bpo::value<string>(&severity)->default_value("warn"), "Log severity")
+            ("help", "Print help");
+
+        bpo::variables_map vm;
+        bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help")) {
+            cout << "FairMQ benchmark" << endl << desc << endl;
+            return 0;
+        }
+
+        bpo::notify(vm);
+
+        if (format != "csv" && format != "json") {
+            throw runtime_error(tools::ToString("Invalid report format '", format, "', valid are 'csv' and 'json'"));
+        }
+        fair::Logger::SetConsoleSeverity(severity);
+
+        vector<vector<string>> rows;
+        for (const auto& transport : transports) {
+            // the allocation algorithm only applies to the shared memory transport
+            vector<string> transportAllocations = transport == "zeromq" ? vector<string>{allocations.front()} : allocations;
+            for (const auto& allocation : transportAllocations) {
+                for (size_t msgSize : msgSizes) {
+                    for (size_t parts : numParts) {
+                        for (int p : producers) {
+                            for (int c : consumers) {
+                                for (float rate : rates) {
+                                    BenchConfig cfg;
+                                    cfg.transport = transport;
+                                    cfg.allocation = allocation;
+                                    cfg.msgSizes = {msgSize};
+                                    cfg.numParts = max<size_t>(parts, 1);
+                                    cfg.producers = max(p, 1);
+                                    cfg.consumers = max(c, 1);
+                                    cfg.rate = rate;
+                                    cfg.segmentSize = segmentSize;
+                                    BenchResult result = tools::RunBench(cfg, chrono::duration<double>(duration));
+                                    rows.push_back(Row(cfg, result));
+                                    if (!result.error.empty()) {
+                                        cerr << "failed: " << result.error << endl;
+                                    }
+                                    cerr << "done:";
+                                    for (size_t i = 0; i < kColumns.size(); ++i) {
+                                        cerr << " " << kColumns[i] << "=" << rows.back()[i];
+                                    }
+                                    cerr << endl;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        if (output.empty()) {
+            Report(cout, format, rows);
+        } else {
+            ofstream file(output);
+            if (!file) {
+                throw runtime_error(tools::ToString("Could not open '", output, "'"));
+            }
+            Report(file, format, rows);
+        }
+
+        return 0;
+    } catch (exception& e) {
+        cerr << "Unhandled Exception reached the top of main: " << e.what() << ", application will now exit" << endl;
+        return 2;
+    }
+}
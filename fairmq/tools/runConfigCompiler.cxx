@@ -0,0 +1,54 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/BinaryConfig.h>
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace boost::program_options;
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        string input;
+        string output;
+
+        options_description desc("Options");
+        desc.add_options()
+            ("input,i", value<string>(&input)->required(), "JSON topology file (as for --mq-config).")
+            ("output,o", value<string>(&output)->required(), "Binary config file to write, to be passed to the devices via --mq-config.")
+            ("help,h", "Print help");
+
+        variables_map vm;
+        store(parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help"))
+        {
+            cout << "Compiles the channel configuration of all devices of a JSON topology into a binary config file" << endl << desc << endl;
+            return 0;
+        }
+
+        notify(vm);
+
+        fair::mq::CompileJSONConfig(input, output);
+
+        return 0;
+    }
+    catch (exception& e)
+    {
+        cerr << "Error: " << e.what() << endl;
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,334 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+// fairmq-topology-gen: writes the JSON channel configuration, a DDS topology and a local start script for scaling
+// studies with the builtin devices (fairmq-bsampler, fairmq-sink, fairmq-merger, fairmq-splitter):
+//   n-m:     N samplers, each connected to all M sinks (N x M connections)
+//   fan-in:  N samplers -> merger -> sink
+//   fan-out: sampler -> splitter -> M sinks
+// The start script runs the devices on this host and collects a report with fairmq-topology-report.
+
+#include <fairmq/tools/Strings.h>
+
+#include <boost/program_options.hpp>
+
+#include <sys/stat.h> // chmod
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace bpo = boost::program_options;
+using namespace fair::mq;
+
+namespace
+{
+
+struct Socket
+{
+    string type;
+    string method;
+    string address;
+};
+
+struct Channel
+{
+    string name;
+    vector<Socket> sockets;
+};
+
+struct Device
+{
+    string id;
+    string role; // sampler, sink, merger, splitter
+    vector<Channel> channels;
+    int metricsPort;
+};
+
+struct GenConfig
+{
+    string shape;
+    int senders;
+    int receivers;
+    string name;
+    string dir;
+    string transport;
+    string host;
+    int basePort;
+    int metricsBasePort;
+    size_t msgSize;
+    float msgRate;
+    int bufSize;
+    int ioThreads;
+    double duration;
+};
+
+string Executable(const string& role)
+{
+    return role == "sampler" ? "fairmq-bsampler" : "fairmq-" + role;
+}
+
+// samplers send on "data", the merger forwards it on "merged", the splitter on "split"
+string SinkChannel(const GenConfig& cfg)
+{
+    return cfg.shape == "fan-in" ? "merged" : cfg.shape == "fan-out" ? "split" : "data";
+}
+
+string RoleArgs(const string& role, const GenConfig& cfg)
+{
+    if (role == "sampler") {
+        return tools::ToString("--msg-size ", cfg.msgSize, " --msg-rate ", cfg.msgRate, " --latency true --all-subchannels true");
+    } else if (role == "sink") {
+        return tools::ToString("--in-channel ", SinkChannel(cfg), " --latency true --all-subchannels true");
+    } else if (role == "merger") {
+        return "--in-channel data --out-channel merged --multipart false";
+    }
+    return "--in-channel data --out-channel split --multipart false";
+}
+
+vector<Device> Build(const GenConfig& cfg)
+{
+    vector<Device> devices;
+    int port = cfg.basePort;
+    int metricsPort = cfg.metricsBasePort;
+    auto bindAddress = [](int p) { return tools::ToString("tcp://*:", p); };
+    auto connectAddress = [&](int p) { return tools::ToString("tcp://", cfg.host, ":", p); };
+    auto add = [&](const string& id, const string& role, vector<Channel> channels) {
+        devices.push_back({id, role, std::move(channels), metricsPort++});
+    };
+
+    if (cfg.shape == "n-m") {
+        vector<int> sinkPorts;
+        for (int j = 0; j < cfg.receivers; ++j) {
+            sinkPorts.push_back(port++);
+        }
+        for (int i = 0; i < cfg.senders; ++i) {
+            Channel data{"data", {}};
+            for (int p : sinkPorts) {
+                data.sockets.push_back({"push", "connect", connectAddress(p)});
+            }
+            add(tools::ToString("sampler", i), "sampler", {data});
+        }
+        for (int j = 0; j < cfg.receivers; ++j) {
+            add(tools::ToString("sink", j), "sink", {{"data", {{"pull", "bind", bindAddress(sinkPorts[j])}}}});
+        }
+    } else if (cfg.shape == "fan-in") {
+        const int in = port++;
+        const int out = port++;
+        for (int i = 0; i < cfg.senders; ++i) {
+            add(tools::ToString("sampler", i), "sampler", {{"data", {{"push", "connect", connectAddress(in)}}}});
+        }
+        add("merger", "merger", {{"data", {{"pull", "bind", bindAddress(in)}}}, {"merged", {{"push", "bind", bindAddress(out)}}}});
+        add("sink0", "sink", {{"merged", {{"pull", "connect", connectAddress(out)}}}});
+    } else if (cfg.shape == "fan-out") {
+        const int in = port++;
+        const int out = port++;
+        add("sampler0", "sampler", {{"data", {{"push", "connect", connectAddress(in)}}}});
+        add("splitter", "splitter", {{"data", {{"pull", "bind", bindAddress(in)}}}, {"split", {{"push", "bind", bindAddress(out)}}}});
+        for (int j = 0; j < cfg.receivers; ++j) {
+            add(tools::ToString("sink", j), "sink", {{"split", {{"pull", "connect", connectAddress(out)}}}});
+        }
+    } else {
+        throw runtime_error(tools::ToString("Invalid shape '", cfg.shape, "', valid are 'n-m', 'fan-in' and 'fan-out'"));
+    }
+    return devices;
+}
+
+void WriteJson(ostream& out, const vector<Device>& devices, const GenConfig& cfg)
+{
+    out << "{\n    \"fairMQOptions\": {\n        \"devices\": [\n";
+    for (size_t d = 0; d < devices.size(); ++d) {
+        out << "            {\n                \"id\": \"" << devices[d].id << "\",\n                \"channels\": [\n";
+        for (size_t c = 0; c < devices[d].channels.size(); ++c) {
+            const Channel& channel = devices[d].channels[c];
+            out << "                    {\n                        \"name\": \"" << channel.name << "\",\n";
+            out << "                        \"transport\": \"" << cfg.transport << "\",\n";
+            out << "                        \"sndBufSize\": " << cfg.bufSize << ",\n";
+            out << "                        \"rcvBufSize\": " << cfg.bufSize << ",\n";
+            out << "                        \"rateLogging\": 0,\n";
+            out << "                        \"sockets\": [\n";
+            for (size_t s = 0; s < channel.sockets.size(); ++s) {
+                const Socket& socket = channel.sockets[s];
+                out << "                            { \"type\": \"" << socket.type << "\", \"method\": \"" << socket.method << "\", \"address\": \"" << socket.address << "\" }"
+                    << (s + 1 < channel.sockets.size() ? "," : "") << "\n";
+            }
+            out << "                        ]\n                    }" << (c + 1 < devices[d].channels.size() ? "," : "") << "\n";
+        }
+        out << "                ]\n            }" << (d + 1 < devices.size() ? "," : "") << "\n";
+    }
+    out << "        ]\n    }\n}\n";
+}
+
+// addresses are exchanged via DDS properties (fmqchan_<channel>), connecting channels with numSockets get one per binder
+void WriteDds(ostream& out, const vector<Device>& devices, const GenConfig& cfg)
+{
+    struct Task
+    {
+        string name;
+        string role;
+        string channelConfig;
+        vector<pair<string, string>> properties; // access, name
+        int n;
+    };
+    vector<Task> tasks;
+    int numSamplers = 0;
+    int numSinks = 0;
+    for (const auto& device : devices) {
+        numSamplers += device.role == "sampler" ? 1 : 0;
+        numSinks += device.role == "sink" ? 1 : 0;
+    }
+    if (cfg.shape == "n-m") {
+        tasks.push_back({"Sink", "sink", "name=data,type=pull,method=bind", {{"write", "data"}}, numSinks});
+        tasks.push_back({"Sampler", "sampler", tools::ToString("name=data,type=push,method=connect,numSockets=", numSinks), {{"read", "data"}}, numSamplers});
+    } else if (cfg.shape == "fan-in") {
+        tasks.push_back({"Merger", "merger", "name=data,type=pull,method=bind name=merged,type=push,method=bind", {{"write", "data"}, {"write", "merged"}}, 1});
+        tasks.push_back({"Sampler", "sampler", "name=data,type=push,method=connect", {{"read", "data"}}, numSamplers});
+        tasks.push_back({"Sink", "sink", "name=merged,type=pull,method=connect", {{"read", "merged"}}, 1});
+    } else {
+        tasks.push_back({"Splitter", "splitter", "name=data,type=pull,method=bind name=split,type=push,method=bind", {{"write", "data"}, {"write", "split"}}, 1});
+        tasks.push_back({"Sampler", "sampler", "name=data,type=push,method=connect", {{"read", "data"}}, 1});
+        tasks.push_back({"Sink", "sink", "name=split,type=pull,method=connect", {{"read", "split"}}, numSinks});
+    }
+
+    out << "<topology name=\"" << cfg.name << "\">\n\n";
+    for (const auto& task : tasks) {
+        for (const auto& [access, name] : task.properties) {
+            if (access == "write") {
+                out << "    <property name=\"fmqchan_" << name << "\" />\n";
+            }
+        }
+    }
+    out << "\n";
+    for (const auto& task : tasks) {
+        out << "    <decltask name=\"" << task.name << "\">\n";
+        out << "        <exe reachable=\"true\">" << Executable(task.role) << " --id " << task.role << "%taskIndex% --color false -P dds --transport " << cfg.transport
+            << " --io-threads " << cfg.ioThreads << " --channel-metrics true --channel-config " << task.channelConfig << " " << RoleArgs(task.role, cfg) << "</exe>\n";
+        out << "        <properties>\n";
+        for (const auto& [access, name] : task.properties) {
+            out << "            <name access=\"" << access << "\">fmqchan_" << name << "</name>\n";
+        }
+        out << "        </properties>\n    </decltask>\n\n";
+    }
+    out << "    <main name=\"main\">\n";
+    for (const auto& task : tasks) {
+        if (task.n == 1) {
+            out << "        <task>" << task.name << "</task>\n";
+        } else {
+            out << "        <group name=\"" << task.name << "s\" n=\"" << task.n << "\">\n            <task>" << task.name << "</task>\n        </group>\n";
+        }
+    }
+    out << "    </main>\n\n</topology>\n";
+}
+
+// one line per device: id role host metrics-port, read by fairmq-topology-report
+void WriteDeviceList(ostream& out, const vector<Device>& devices, const GenConfig& cfg)
+{
+    for (const auto& device : devices) {
+        out << device.id << " " << device.role << " " << cfg.host << " " << device.metricsPort << "\n";
+    }
+}
+
+// binding devices first, so that the connecting ones find their peers
+void WriteStartScript(ostream& out, const vector<Device>& devices, const GenConfig& cfg)
+{
+    const string prefix = cfg.dir + "/" + cfg.name;
+    out << "#!/bin/bash\n\n";
+    out << "# generated by fairmq-topology-gen: starts the " << devices.size() << " devices of the " << cfg.shape << " topology '" << cfg.name << "' on this host,\n";
+    out << "# writes the report of fairmq-topology-report after a warm-up of 2 s and stops the devices\n\n";
+    out << "set -e\n\nDURATION=${1:-" << cfg.duration << "}\nmkdir -p " << prefix << "-logs\npids=()\n";
+    out << "cleanup() {\n    kill -INT \"${pids[@]}\" 2>/dev/null || true\n    wait\n}\ntrap cleanup EXIT\n\n";
+    for (int binders = 1; binders >= 0; --binders) {
+        for (const auto& device : devices) {
+            bool binds = device.channels.front().sockets.front().method == "bind";
+            if (binds != (binders == 1)) {
+                continue;
+            }
+            out << Executable(device.role) << " --id " << device.id << " --mq-config " << prefix << ".json --control static --color false --severity info"
+                << " --transport " << cfg.transport << " --io-threads " << cfg.ioThreads << " --channel-metrics true --metrics-port " << device.metricsPort
+                << " " << RoleArgs(device.role, cfg) << " > " << prefix << "-logs/" << device.id << ".log 2>&1 &\npids+=($!)\n";
+        }
+        if (binders == 1) {
+            out << "sleep 1\n";
+        }
+    }
+    out << "\nsleep 2\nfairmq-topology-report --devices " << prefix << "-devices.txt --logs " << prefix << "-logs --interval ${DURATION} --output " << prefix << "-report.csv\n";
+    out << "cat " << prefix << "-report.csv\n";
+}
+
+void WriteFile(const string& filename, const function<void(ostream&)>& write)
+{
+    ofstream file(filename);
+    if (!file) {
+        throw runtime_error(tools::ToString("Could not open '", filename, "'"));
+    }
+    write(file);
+    cerr << "wrote " << filename << endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        GenConfig cfg;
+
+        bpo::options_description desc("Generates a scaling study topology of the builtin devices");
+        desc.add_options()
+            ("shape", bpo::value<string>(&cfg.shape)->default_value("n-m"), "Shape: n-m (every sampler to every sink), fan-in (samplers -> merger -> sink) or fan-out (sampler -> splitter -> sinks)")
+            ("senders", bpo::value<int>(&cfg.senders)->default_value(4), "Number of samplers (n-m, fan-in)")
+            ("receivers", bpo::value<int>(&cfg.receivers)->default_value(4), "Number of sinks (n-m, fan-out)")
+            ("name", bpo::value<string>(&cfg.name)->default_value("scaling"), "Name of the topology, prefix of the written files")
+            ("output-dir", bpo::value<string>(&cfg.dir)->default_value("."), "Directory of the written files")
+            ("transport", bpo::value<string>(&cfg.transport)->default_value("zeromq"), "Transport of the channels")
+            ("host", bpo::value<string>(&cfg.host)->default_value("127.0.0.1"), "Host the connecting channels (and the report) use to reach the devices (JSON configuration)")
+            ("base-port", bpo::value<int>(&cfg.basePort)->default_value(22000), "First port of the bound channels (JSON configuration)")
+            ("metrics-base-port", bpo::value<int>(&cfg.metricsBasePort)->default_value(23000), "First port of the metrics endpoints (start script)")
+            ("msg-size", bpo::value<size_t>(&cfg.msgSize)->default_value(10000), "Message size in bytes")
+            ("msg-rate", bpo::value<float>(&cfg.msgRate)->default_value(0), "Messages per second and sampler (0 - unlimited)")
+            ("buf-size", bpo::value<int>(&cfg.bufSize)->default_value(1000), "Send and receive queue size (sndBufSize, rcvBufSize) of the channels")
+            ("io-threads", bpo::value<int>(&cfg.ioThreads)->default_value(1), "Number of zeromq I/O threads per device")
+            ("duration", bpo::value<double>(&cfg.duration)->default_value(10), "Measuring time of the start script in seconds")
+            ("help", "Print help");
+
+        bpo::variables_map vm;
+        bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help")) {
+            cout << "FairMQ topology generator" << endl << desc << endl;
+            return 0;
+        }
+
+        bpo::notify(vm);
+
+        if (cfg.senders < 1 || cfg.receivers < 1) {
+            throw runtime_error("--senders and --receivers must be at least 1");
+        }
+        if (cfg.shape == "fan-in" && cfg.receivers != 1) {
+            cerr << "fan-in has one sink, ignoring --receivers" << endl;
+        } else if (cfg.shape == "fan-out" && cfg.senders != 1) {
+            cerr << "fan-out has one sampler, ignoring --senders" << endl;
+        }
+
+        vector<Device> devices = Build(cfg);
+        const string prefix = cfg.dir + "/" + cfg.name;
+        WriteFile(prefix + ".json", [&](ostream& out) { WriteJson(out, devices, cfg); });
+        WriteFile(prefix + "-dds.xml", [&](ostream& out) { WriteDds(out, devices, cfg); });
+        WriteFile(prefix + "-devices.txt", [&](ostream& out) { WriteDeviceList(out, devices, cfg); });
+        WriteFile(prefix + "-start.sh", [&](ostream& out) { WriteStartScript(out, devices, cfg); });
+        chmod((prefix + "-start.sh").c_str(), 0755);
+
+        return 0;
+    } catch (exception& e) {
+        cerr << "Unhandled Exception reached the top of main: " << e.what() << ", application will now exit" << endl;
+        return 2;
+    }
+}
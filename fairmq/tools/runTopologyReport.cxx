@@ -0,0 +1,335 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+// fairmq-topology-report: scrapes the metrics endpoints (--metrics-port, with --channel-metrics) of the devices of a
+// topology at the start and the end of an interval and reports per device the message and byte rates, the average
+// send/receive call durations and the queue depth, plus the last one-way latency percentiles that the sinks
+// (fairmq-sink --latency) logged, as CSV or JSON. The device list has one line per device: id role host metrics-port
+// (written by fairmq-topology-gen).
+
+#include <fairmq/tools/Strings.h>
+
+#include <boost/program_options.hpp>
+
+#include <netdb.h> // getaddrinfo
+#include <sys/socket.h>
+#include <unistd.h> // close
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+namespace bpo = boost::program_options;
+using namespace fair::mq;
+
+namespace
+{
+
+struct DeviceEntry
+{
+    string id;
+    string role;
+    string host;
+    string port;
+};
+
+// sums of the samples of a scrape, keyed by metric name and the value of one label (e.g. direction or op)
+using Sample = map<string, double>;
+
+vector<DeviceEntry> ReadDevices(const string& filename)
+{
+    ifstream file(filename);
+    if (!file) {
+        throw runtime_error(tools::ToString("Could not open '", filename, "'"));
+    }
+    vector<DeviceEntry> devices;
+    string line;
+    while (getline(file, line)) {
+        istringstream ss(line);
+        DeviceEntry device;
+        if (ss >> device.id >> device.role >> device.host >> device.port) {
+            devices.push_back(device);
+        }
+    }
+    return devices;
+}
+
+// GET http://host:port/metrics, empty if the device cannot be reached
+string Fetch(const DeviceEntry& device)
+{
+    addrinfo hints{};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(device.host.c_str(), device.port.c_str(), &hints, &result) != 0) {
+        return "";
+    }
+    int fd = -1;
+    for (addrinfo* ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (fd < 0) {
+        return "";
+    }
+    const string request = "GET /metrics HTTP/1.0\r\nHost: " + device.host + "\r\n\r\n";
+    string response;
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size())) {
+        char buf[65536];
+        ssize_t n = 0;
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            response.append(buf, n);
+        }
+    }
+    close(fd);
+    size_t body = response.find("\r\n\r\n");
+    return body == string::npos ? "" : response.substr(body + 4);
+}
+
+string Label(const string& labels, const string& name)
+{
+    size_t pos = labels.find(name + "=\"");
+    if (pos == string::npos) {
+        return "";
+    }
+    pos += name.size() + 2;
+    return labels.substr(pos, labels.find('"', pos) - pos);
+}
+
+Sample Parse(const string& text)
+{
+    Sample sample;
+    istringstream ss(text);
+    string line;
+    while (getline(ss, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t brace = line.find('{');
+        size_t space = line.rfind(' ');
+        if (brace == string::npos || space == string::npos || space < brace) {
+            continue;
+        }
+        const string name = line.substr(0, brace);
+        const string labels = line.substr(brace, space - brace);
+        double value = 0;
+        try {
+            value = stod(line.substr(space + 1));
+        } catch (const logic_error&) {
+            continue;
+        }
+        if (name == "fairmq_device_state") {
+            sample["state:" + Label(labels, "state")] = value;
+        } else if (name == "fairmq_channel_messages_total" || name == "fairmq_channel_bytes_total") {
+            sample[name + ":" + Label(labels, "direction")] += value;
+        } else if (name == "fairmq_channel_call_duration_seconds_sum" || name == "fairmq_channel_call_duration_seconds_count") {
+            sample[name + ":" + Label(labels, "op")] += value;
+        } else if (name == "fairmq_channel_queue_depth") {
+            sample[name] += value;
+        }
+    }
+    return sample;
+}
+
+string State(const Sample& sample)
+{
+    for (const auto& [key, value] : sample) {
+        if (key.compare(0, 6, "state:") == 0 && value > 0) {
+            return key.substr(6);
+        }
+    }
+    return "UNREACHABLE";
+}
+
+// the last latency line of the sink log: "Latency (<label>, <n> messages) [us]: p50 <x>, p99 <y>, p99.9 <z>, max <m> | lost <l>, ..."
+vector<string> SinkLatency(const string& logDir, const string& id)
+{
+    vector<string> values{"", "", "", "", ""};
+    if (logDir.empty()) {
+        return values;
+    }
+    ifstream file(logDir + "/" + id + ".log");
+    string line;
+    string last;
+    while (getline(file, line)) {
+        if (line.find("Latency (") != string::npos) {
+            last = line;
+        }
+    }
+    const vector<string> keys{"p50 ", "p99 ", "p99.9 ", "max ", "lost "};
+    for (size_t i = 0; i < keys.size(); ++i) {
+        size_t pos = last.find(keys[i]);
+        if (pos != string::npos) {
+            pos += keys[i].size();
+            values[i] = last.substr(pos, last.find_first_of(", |", pos) - pos);
+        }
+    }
+    return values;
+}
+
+const vector<string> kColumns{"id", "role", "state", "msgs_tx_per_s", "msgs_rx_per_s", "mb_tx_per_s", "mb_rx_per_s",
+    "send_call_us", "receive_call_us", "queue_depth", "lat_p50_us", "lat_p99_us", "lat_p999_us", "lat_max_us", "lost"};
+
+vector<string> Row(const DeviceEntry& device, const Sample& begin, const Sample& end, double seconds, const string& logDir)
+{
+    auto get = [](const Sample& s, const string& key) {
+        auto it = s.find(key);
+        return it == s.end() ? 0. : it->second;
+    };
+    auto rate = [&](const string& key, double scale) { return tools::ToString((get(end, key) - get(begin, key)) / seconds / scale); };
+    auto callUs = [&](const string& op) {
+        double calls = get(end, "fairmq_channel_call_duration_seconds_count:" + op) - get(begin, "fairmq_channel_call_duration_seconds_count:" + op);
+        double secs = get(end, "fairmq_channel_call_duration_seconds_sum:" + op) - get(begin, "fairmq_channel_call_duration_seconds_sum:" + op);
+        return tools::ToString(calls > 0 ? secs * 1e6 / calls : 0);
+    };
+    vector<string> row{
+        device.id,
+        device.role,
+        State(end),
+        rate("fairmq_channel_messages_total:tx", 1),
+        rate("fairmq_channel_messages_total:rx", 1),
+        rate("fairmq_channel_bytes_total:tx", 1e6),
+        rate("fairmq_channel_bytes_total:rx", 1e6),
+        callUs("send"),
+        callUs("receive"),
+        tools::ToString(get(end, "fairmq_channel_queue_depth"))
+    };
+    vector<string> latency = device.role == "sink" ? SinkLatency(logDir, device.id) : vector<string>(5);
+    row.insert(row.end(), latency.begin(), latency.end());
+    return row;
+}
+
+// totals over all devices: summed rates, queue depths and lost messages, the worst sink latencies
+vector<string> Total(const vector<vector<string>>& rows)
+{
+    vector<string> total{"total", "-", "-"};
+    for (size_t c = 3; c < kColumns.size(); ++c) {
+        const bool sum = c <= 6 || c == 9 || c == 14;
+        const bool max = c >= 10 && c <= 13;
+        double value = 0;
+        bool any = false;
+        for (const auto& row : rows) {
+            if (row[c].empty()) {
+                continue;
+            }
+            double v = stod(row[c]);
+            value = sum ? value + v : (!any || v > value ? v : value);
+            any = true;
+        }
+        total.push_back(any && (sum || max) ? tools::ToString(value) : "");
+    }
+    return total;
+}
+
+void Report(ostream& out, const string& format, const vector<vector<string>>& rows)
+{
+    if (format == "json") {
+        out << "[\n";
+        for (size_t i = 0; i < rows.size(); ++i) {
+            out << "  {";
+            for (size_t c = 0; c < kColumns.size(); ++c) {
+                // the first three columns are strings, unknown values are null
+                const string value = c < 3 ? "\"" + rows[i][c] + "\"" : rows[i][c].empty() ? "null" : rows[i][c];
+                out << (c > 0 ? ", " : "") << "\"" << kColumns[c] << "\": " << value;
+            }
+            out << "}" << (i + 1 < rows.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    } else {
+        for (size_t c = 0; c < kColumns.size(); ++c) {
+            out << (c > 0 ? "," : "") << kColumns[c];
+        }
+        out << "\n";
+        for (const auto& row : rows) {
+            for (size_t c = 0; c < row.size(); ++c) {
+                out << (c > 0 ? "," : "") << row[c];
+            }
+            out << "\n";
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        string devicesFile;
+        string logDir;
+        double interval = 10;
+        string format;
+        string output;
+
+        bpo::options_description desc("Collects the rates and latencies of the devices of a topology into one report");
+        desc.add_options()
+            ("devices", bpo::value<string>(&devicesFile)->required(), "Device list, one line per device: id role host metrics-port")
+            ("logs", bpo::value<string>(&logDir)->default_value(""), "Directory with the logs of the devices (<id>.log), for the sink latencies")
+            ("interval", bpo::value<double>(&interval)->default_value(10), "Measuring interval in seconds")
+            ("format", bpo::value<string>(&format)->default_value("csv"), "Report format: csv or json")
+            ("output", bpo::value<string>(&output)->default_value(""), "Report file (default: standard output)")
+            ("help", "Print help");
+
+        bpo::variables_map vm;
+        bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help")) {
+            cout << "FairMQ topology report" << endl << desc << endl;
+            return 0;
+        }
+
+        bpo::notify(vm);
+
+        if (format != "csv" && format != "json") {
+            throw runtime_error(tools::ToString("Invalid report format '", format, "', valid are 'csv' and 'json'"));
+        }
+
+        vector<DeviceEntry> devices = ReadDevices(devicesFile);
+        vector<Sample> begin;
+        for (const auto& device : devices) {
+            begin.push_back(Parse(Fetch(device)));
+        }
+        const auto start = chrono::steady_clock::now();
+        this_thread::sleep_for(chrono::duration<double>(interval));
+        vector<Sample> end;
+        for (const auto& device : devices) {
+            end.push_back(Parse(Fetch(device)));
+        }
+        const double seconds = max(chrono::duration<double>(chrono::steady_clock::now() - start).count(), 1e-9);
+
+        vector<vector<string>> rows;
+        for (size_t i = 0; i < devices.size(); ++i) {
+            rows.push_back(Row(devices[i], begin[i], end[i], seconds, logDir));
+        }
+        rows.push_back(Total(rows));
+
+        if (output.empty()) {
+            Report(cout, format, rows);
+        } else {
+            ofstream file(output);
+            if (!file) {
+                throw runtime_error(tools::ToString("Could not open '", output, "'"));
+            }
+            Report(file, format, rows);
+        }
+
+        return 0;
+    } catch (exception& e) {
+        cerr << "Unhandled Exception reached the top of main: " << e.what() << ", application will now exit" << endl;
+        return 2;
+    }
+}
@@ -0,0 +1,306 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+// fairmq-tune: searches the transport settings (io threads, queue and kernel buffer sizes, shared memory segment size
+// and allocation algorithm, region ack batching) for a described workload with the in-process benchmark of
+// fairmq-bench, and reports the recommended settings with their measured throughput and latency.
+
+#include <fairmq/tools/Bench.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fairlogger/Logger.h>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm> // max
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace bpo = boost::program_options;
+using namespace fair::mq;
+
+namespace
+{
+
+using tools::BenchConfig;
+using tools::BenchResult;
+
+// a setting searched over, values are kept as strings to treat numbers and names alike
+struct Parameter
+{
+    string name;
+    vector<string> candidates;
+    function<bool(const BenchConfig&)> applies;
+    function<void(BenchConfig&, const string&)> set;
+    function<string(const BenchConfig&)> get;
+};
+
+struct Trial
+{
+    BenchConfig cfg;
+    BenchResult result;
+    bool feasible = false;
+};
+
+// throughput: the highest MB/s. latency: the lowest p99 latency of the trials that reached the requested rate
+class Objective
+{
+  public:
+    Objective(bool latency, double targetRate, double minGain)
+        : fLatency(latency)
+        , fTargetRate(targetRate)
+        , fMinGain(minGain)
+    {}
+
+    bool Feasible(const BenchResult& r) const
+    {
+        if (!r.error.empty() || r.received == 0) {
+            return false;
+        }
+        return fTargetRate <= 0 || r.MessagesPerSecond() >= 0.95 * fTargetRate;
+    }
+
+    /// @return true if a is better than b by more than the minimum gain (the measurement noise)
+    bool Better(const Trial& a, const Trial& b) const
+    {
+        if (a.feasible != b.feasible) {
+            return a.feasible;
+        }
+        if (!a.feasible) {
+            return false;
+        }
+        if (fLatency) {
+            return a.result.latency.Percentile(99.) < b.result.latency.Percentile(99.) * (1 - fMinGain);
+        }
+        return a.result.MBPerSecond() > b.result.MBPerSecond() * (1 + fMinGain);
+    }
+
+  private:
+    bool fLatency;
+    double fTargetRate; // messages per second of all producers, 0: unlimited
+    double fMinGain;
+};
+
+vector<Parameter> Parameters(const bpo::variables_map& vm)
+{
+    auto candidates = [&vm](const string& option) { return vm[option].as<vector<string>>(); };
+    auto shmem = [](const BenchConfig& cfg) { return cfg.transport != "zeromq"; };
+    return {
+        {"io-threads", candidates("io-threads"), [](const BenchConfig&) { return true; },
+            [](BenchConfig& cfg, const string& v) { cfg.ioThreads = stoi(v); }, [](const BenchConfig& cfg) { return to_string(cfg.ioThreads); }},
+        {"buf-size", candidates("buf-size"), [](const BenchConfig&) { return true; },
+            [](BenchConfig& cfg, const string& v) { cfg.sndBufSize = cfg.rcvBufSize = stoi(v); }, [](const BenchConfig& cfg) { return to_string(cfg.sndBufSize); }},
+        {"kernel-size", candidates("kernel-size"), [](const BenchConfig&) { return true; },
+            [](BenchConfig& cfg, const string& v) { cfg.sndKernelSize = cfg.rcvKernelSize = stoi(v); }, [](const BenchConfig& cfg) { return to_string(cfg.sndKernelSize); }},
+        {"segment-size", candidates("segment-size"), shmem,
+            [](BenchConfig& cfg, const string& v) { cfg.segmentSize = stoull(v); }, [](const BenchConfig& cfg) { return to_string(cfg.segmentSize); }},
+        {"allocation", candidates("allocation"), shmem,
+            [](BenchConfig& cfg, const string& v) { cfg.allocation = v; }, [](const BenchConfig& cfg) { return cfg.allocation; }},
+        {"ack-bunch-size", candidates("ack-bunch-size"), [](const BenchConfig& cfg) { return cfg.transport == "region"; },
+            [](BenchConfig& cfg, const string& v) { cfg.ackBunchSize = static_cast<uint32_t>(stoul(v)); }, [](const BenchConfig& cfg) { return to_string(cfg.ackBunchSize); }},
+    };
+}
+
+string Settings(const vector<Parameter>& params, const BenchConfig& cfg)
+{
+    string s;
+    for (const auto& p : params) {
+        if (p.applies(cfg)) {
+            s += tools::ToString(s.empty() ? "" : " ", p.name, "=", p.get(cfg));
+        }
+    }
+    return s;
+}
+
+void Log(const string& what, const vector<Parameter>& params, const Trial& t)
+{
+    cerr << what << ": " << Settings(params, t.cfg)
+         << " mb_per_s=" << t.result.MBPerSecond()
+         << " msgs_per_s=" << t.result.MessagesPerSecond()
+         << " lat_p50_us=" << t.result.latency.Percentile(50.) / 1e3
+         << " lat_p99_us=" << t.result.latency.Percentile(99.) / 1e3
+         << (t.feasible ? "" : " (infeasible)")
+         << (t.result.error.empty() ? "" : " error=" + t.result.error) << endl;
+}
+
+void Measurement(ostream& out, const BenchResult& r)
+{
+    out << "{\"mb_per_s\": " << r.MBPerSecond()
+        << ", \"msgs_per_s\": " << r.MessagesPerSecond()
+        << ", \"lat_p50_us\": " << r.latency.Percentile(50.) / 1e3
+        << ", \"lat_p99_us\": " << r.latency.Percentile(99.) / 1e3
+        << ", \"lat_p999_us\": " << r.latency.Percentile(99.9) / 1e3
+        << ", \"cpu_us_per_msg\": " << (r.received > 0 ? r.cpuSeconds * 1e6 / r.received : 0) << "}";
+}
+
+void Report(ostream& out, const string& objective, const Trial& baseline, const Trial& best, size_t numTrials)
+{
+    const BenchConfig& cfg = best.cfg;
+    const bool shmem = cfg.transport != "zeromq";
+    string options(tools::ToString("--transport ", cfg.transport == "region" ? "shmem" : cfg.transport, " --io-threads ", cfg.ioThreads));
+    if (shmem) {
+        options += tools::ToString(" --shm-segment-size ", cfg.segmentSize, " --shm-allocation ", cfg.allocation);
+    }
+    string channel(tools::ToString("sndBufSize=", cfg.sndBufSize, ",rcvBufSize=", cfg.rcvBufSize));
+    if (cfg.sndKernelSize != 0) {
+        channel += tools::ToString(",sndKernelSize=", cfg.sndKernelSize, ",rcvKernelSize=", cfg.rcvKernelSize);
+    }
+
+    out << "{\n";
+    out << "  \"objective\": \"" << objective << "\",\n";
+    out << "  \"trials\": " << numTrials << ",\n";
+    out << "  \"recommended\": {\n";
+    out << "    \"device-options\": \"" << options << "\",\n";
+    out << "    \"channel-config\": \"" << channel << "\"";
+    if (cfg.transport == "region") {
+        out << ",\n    \"region-ack-bunch-size\": " << cfg.ackBunchSize;
+    }
+    out << "\n  },\n";
+    out << "  \"measured\": ";
+    Measurement(out, best.result);
+    out << ",\n  \"baseline\": ";
+    Measurement(out, baseline.result);
+    out << "\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        BenchConfig workload;
+        string objective;
+        double duration = 1;
+        int rounds = 2;
+        double minGain = 0.03;
+        string output;
+        string severity;
+
+        bpo::options_description desc("Searches transport settings for a workload, one setting at a time (lists are space separated)");
+        desc.add_options()
+            ("transport", bpo::value<string>(&workload.transport)->default_value("shmem"), "Transport: zeromq, shmem, region (shmem with unmanaged region messages)")
+            ("msg-size", bpo::value<vector<size_t>>(&workload.msgSizes)->multitoken()->default_value({1000000}, "1000000"), "Message (part) sizes in bytes, sent in turn, repeat a size to weight it (e.g. 1000 1000 1000 1000000)")
+            ("num-parts", bpo::value<size_t>(&workload.numParts)->default_value(1), "Parts per message")
+            ("rate", bpo::value<float>(&workload.rate)->default_value(0), "Message rate per producer in messages per second (0 - unlimited)")
+            ("fan-in", bpo::value<int>(&workload.producers)->default_value(1), "Number of producers, each connected to every consumer")
+            ("fan-out", bpo::value<int>(&workload.consumers)->default_value(1), "Number of consumers")
+            ("objective", bpo::value<string>(&objective)->default_value("auto"), "throughput (MB/s), latency (p99 at the requested rate) or auto (latency with a --rate, throughput otherwise)")
+            ("io-threads", bpo::value<vector<string>>()->multitoken()->default_value({"1", "2", "4"}, "1 2 4"), "Candidate numbers of io threads")
+            ("buf-size", bpo::value<vector<string>>()->multitoken()->default_value({"1000", "100", "10000", "100000"}, "1000 100 10000 100000"), "Candidate queue sizes in messages (sndBufSize/rcvBufSize)")
+            ("kernel-size", bpo::value<vector<string>>()->multitoken()->default_value({"0", "1048576", "8388608"}, "0 1048576 8388608"), "Candidate kernel buffer sizes in bytes (sndKernelSize/rcvKernelSize, 0 - kernel default)")
+            ("segment-size", bpo::value<vector<string>>()->multitoken()->default_value({"2000000000", "268435456", "8000000000"}, "2000000000 268435456 8000000000"), "Candidate shared memory segment sizes in bytes (shmem, region)")
+            ("allocation", bpo::value<vector<string>>()->multitoken()->default_value({"rbtree_best_fit", "simple_seq_fit", "slab_fit"}, "rbtree_best_fit simple_seq_fit slab_fit"), "Candidate shared memory allocation algorithms (shmem, region)")
+            ("ack-bunch-size", bpo::value<vector<string>>()->multitoken()->default_value({"256", "16", "64", "1024"}, "256 16 64 1024"), "Candidate region ack batch sizes (region)")
+            ("duration", bpo::value<double>(&duration)->default_value(1), "Sending time per trial in seconds")
+            ("rounds", bpo::value<int>(&rounds)->default_value(2), "Passes over the settings, a pass without improvement ends the search")
+            ("min-gain", bpo::value<double>(&minGain)->default_value(0.03), "Relative improvement needed to change a setting (above the measurement noise)")
+            ("output", bpo::value<string>(&output)->default_value(""), "Report file (default: standard output)")
+            ("severity", bpo::value<string>(&severity)->default_value("warn"), "Log severity")
+            ("help", "Print help");
+
+        bpo::variables_map vm;
+        bpo::store(bpo::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help")) {
+            cout << "FairMQ transport tuning" << endl << desc << endl
+                 << "The first candidate of every setting is the starting point, the settings are searched one at a time." << endl;
+            return 0;
+        }
+
+        bpo::notify(vm);
+
+        if (workload.transport != "zeromq" && workload.transport != "shmem" && workload.transport != "region") {
+            throw runtime_error(tools::ToString("Invalid transport '", workload.transport, "', valid are 'zeromq', 'shmem' and 'region'"));
+        }
+        if (objective == "auto") {
+            objective = workload.rate > 0 ? "latency" : "throughput";
+        }
+        if (objective != "throughput" && objective != "latency") {
+            throw runtime_error(tools::ToString("Invalid objective '", objective, "', valid are 'throughput', 'latency' and 'auto'"));
+        }
+        if (objective == "latency" && workload.rate <= 0) {
+            throw runtime_error("The latency objective needs a --rate");
+        }
+        workload.numParts = max<size_t>(workload.numParts, 1);
+        workload.producers = max(workload.producers, 1);
+        workload.consumers = max(workload.consumers, 1);
+        fair::Logger::SetConsoleSeverity(severity);
+
+        vector<Parameter> params = Parameters(vm);
+        for (auto& p : params) {
+            if (p.candidates.empty()) {
+                throw runtime_error(tools::ToString("No candidates for --", p.name));
+            }
+            p.set(workload, p.candidates.front());
+        }
+        const Objective score(objective == "latency", workload.rate * workload.producers, minGain);
+        size_t numTrials = 0;
+        auto run = [&](const BenchConfig& cfg) {
+            Trial t;
+            t.cfg = cfg;
+            t.result = tools::RunBench(cfg, chrono::duration<double>(duration));
+            t.feasible = score.Feasible(t.result);
+            ++numTrials;
+            return t;
+        };
+
+        // coordinate descent: try the candidates of one setting with the best values of the others
+        const Trial baseline = run(workload);
+        Log("baseline", params, baseline);
+        Trial best = baseline;
+        for (int round = 0; round < rounds; ++round) {
+            bool improved = false;
+            for (const auto& p : params) {
+                if (!p.applies(best.cfg)) {
+                    continue;
+                }
+                const string current = p.get(best.cfg);
+                for (const auto& candidate : p.candidates) {
+                    if (candidate == current) {
+                        continue;
+                    }
+                    BenchConfig cfg = best.cfg;
+                    p.set(cfg, candidate);
+                    Trial t = run(cfg);
+                    Log("trial", params, t);
+                    if (score.Better(t, best)) {
+                        best = move(t);
+                        improved = true;
+                    }
+                }
+            }
+            if (!improved) {
+                break;
+            }
+        }
+        Log("best", params, best);
+        if (!best.feasible) {
+            cerr << "no setting reached the requested rate, reporting the best effort" << endl;
+        }
+
+        if (output.empty()) {
+            Report(cout, objective, baseline, best, numTrials);
+        } else {
+            ofstream file(output);
+            if (!file) {
+                throw runtime_error(tools::ToString("Could not open '", output, "'"));
+            }
+            Report(file, objective, baseline, best, numTrials);
+        }
+
+        return 0;
+    } catch (exception& e) {
+        cerr << "Unhandled Exception reached the top of main: " << e.what() << ", application will now exit" << endl;
+        return 2;
+    }
+}
@@ -0,0 +1,266 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_URING_COMMON_H
+#define FAIR_MQ_URING_COMMON_H
+
+#include <fairmq/stream/Common.h>
+#include <fairmq/tools/Strings.h>
+
+#include <fairlogger/Logger.h>
+
+#include <linux/io_uring.h>
+#include <netdb.h> // getaddrinfo
+#include <sys/mman.h> // mmap
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h> // iovec
+#include <unistd.h>
+
+#include <algorithm> // max
+#include <cerrno>
+#include <cstdint>
+#include <cstring> // strerror, memset
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fair::mq::uring
+{
+
+struct UringError : std::runtime_error { using std::runtime_error::runtime_error; };
+
+using stream::kPollIn;
+using stream::kPollOut;
+
+// precedes every message part on the wire
+struct FrameHeader
+{
+    static constexpr uint32_t kMagic = 0x464d5155; // "FMQU"
+    static constexpr uint32_t kMore = 1; // more parts of the same multipart message follow
+
+    uint64_t fSize;
+    uint32_t fFlags;
+    uint32_t fMagic;
+};
+
+/// Minimal io_uring instance (without liburing), used by a single thread at a time.
+/// Submissions are queued with GetSqe() and handed to the kernel with Submit()/Wait().
+class Ring
+{
+  public:
+    explicit Ring(unsigned entries)
+    {
+        io_uring_params params{};
+        fFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fFd < 0) {
+            throw UringError(tools::ToString("io_uring_setup failed: ", strerror(errno)));
+        }
+
+        fSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        fCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            fSqRingSize = fCqRingSize = std::max(fSqRingSize, fCqRingSize);
+        }
+
+        fSqRing = Map(fSqRingSize, IORING_OFF_SQ_RING);
+        fCqRing = singleMmap ? fSqRing : Map(fCqRingSize, IORING_OFF_CQ_RING);
+        fSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        fSqes = static_cast<io_uring_sqe*>(Map(fSqesSize, IORING_OFF_SQES));
+
+        char* sq = static_cast<char*>(fSqRing);
+        fSqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        fSqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        fSqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        fSqEntries = params.sq_entries;
+        fSqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(fCqRing);
+        fCqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        fCqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        fCqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        fCqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        fLocalTail = *fSqTail;
+
+        fZeroCopy = ProbeOp(IORING_OP_SEND_ZC);
+    }
+
+    Ring(const Ring&) = delete;
+    Ring(Ring&&) = delete;
+    Ring& operator=(const Ring&) = delete;
+    Ring& operator=(Ring&&) = delete;
+
+    /// @return a zeroed submission queue entry, submits queued entries first if the queue is full
+    io_uring_sqe* GetSqe()
+    {
+        if (fLocalTail - __atomic_load_n(fSqHead, __ATOMIC_ACQUIRE) >= fSqEntries) {
+            Submit();
+        }
+        unsigned index = fLocalTail & fSqMask;
+        io_uring_sqe* sqe = &fSqes[index];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        fSqArray[index] = index;
+        ++fLocalTail;
+        return sqe;
+    }
+
+    /// hand queued entries to the kernel and wait until at least waitNr completions are available
+    void Submit(unsigned waitNr = 0)
+    {
+        __atomic_store_n(fSqTail, fLocalTail, __ATOMIC_RELEASE);
+        unsigned toSubmit = fLocalTail - __atomic_load_n(fSqHead, __ATOMIC_ACQUIRE);
+        while (true) {
+            long ret = syscall(__NR_io_uring_enter, fFd, toSubmit, waitNr, waitNr > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (ret >= 0) {
+                return;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EBUSY) {
+                // completion queue is full, the caller has to reap completions
+                return;
+            }
+            throw UringError(tools::ToString("io_uring_enter failed: ", strerror(errno)));
+        }
+    }
+
+    /// @return true if a completion was available and copied into cqe
+    bool Peek(io_uring_cqe& cqe)
+    {
+        unsigned head = *fCqHead;
+        if (head == __atomic_load_n(fCqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        cqe = fCqes[head & fCqMask];
+        __atomic_store_n(fCqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /// submit queued entries and block until a completion is available
+    void Wait(io_uring_cqe& cqe)
+    {
+        while (!Peek(cqe)) {
+            Submit(1);
+        }
+    }
+
+    /// reserve an (empty) table of registered buffers
+    bool RegisterBuffers(unsigned num)
+    {
+        io_uring_rsrc_register reg{};
+        reg.nr = num;
+        reg.flags = IORING_RSRC_REGISTER_SPARSE;
+        return syscall(__NR_io_uring_register, fFd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0;
+    }
+
+    /// register (or for iov_base == nullptr unregister) the buffer at index of the registered buffer table
+    bool UpdateBuffer(unsigned index, iovec iov)
+    {
+        io_uring_rsrc_update2 update{};
+        update.offset = index;
+        update.data = reinterpret_cast<uint64_t>(&iov);
+        update.nr = 1;
+        return syscall(__NR_io_uring_register, fFd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) == 1;
+    }
+
+    /// the kernel supports zero-copy send (IORING_OP_SEND_ZC)
+    bool ZeroCopy() const { return fZeroCopy; }
+    /// size of the submission queue
+    unsigned Entries() const { return fSqEntries; }
+
+    ~Ring()
+    {
+        munmap(fSqes, fSqesSize);
+        if (fCqRing != fSqRing) {
+            munmap(fCqRing, fCqRingSize);
+        }
+        munmap(fSqRing, fSqRingSize);
+        close(fFd);
+    }
+
+  private:
+    void* Map(size_t size, off_t offset)
+    {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fFd, offset);
+        if (ptr == MAP_FAILED) {
+            int err = errno;
+            close(fFd);
+            throw UringError(tools::ToString("mapping io_uring queues failed: ", strerror(err)));
+        }
+        return ptr;
+    }
+
+    bool ProbeOp(unsigned op)
+    {
+        constexpr unsigned numOps = 256;
+        std::vector<char> buf(sizeof(io_uring_probe) + numOps * sizeof(io_uring_probe_op), 0);
+        auto probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (syscall(__NR_io_uring_register, fFd, IORING_REGISTER_PROBE, probe, numOps) < 0) {
+            return false;
+        }
+        return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    int fFd;
+    size_t fSqRingSize;
+    size_t fCqRingSize;
+    size_t fSqesSize;
+    void* fSqRing;
+    void* fCqRing;
+    io_uring_sqe* fSqes;
+    unsigned* fSqHead;
+    unsigned* fSqTail;
+    unsigned fSqMask;
+    unsigned fSqEntries;
+    unsigned* fSqArray;
+    unsigned* fCqHead;
+    unsigned* fCqTail;
+    unsigned fCqMask;
+    io_uring_cqe* fCqes;
+    unsigned fLocalTail;
+    bool fZeroCopy;
+};
+
+/// Resolve a "tcp://<host>:<port>" address, host "*" binds to all interfaces.
+/// Like the zeromq transport (without ZMQ_IPV6), host names resolve to IPv4, IPv6 needs a literal "[addr]".
+/// @return false if the address is not a valid tcp address
+inline bool ResolveTcpAddress(const std::string& address, sockaddr_storage& addr, socklen_t& addrLen, bool passive)
+{
+    const std::string prefix("tcp://");
+    if (address.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    std::string endpoint(address.substr(prefix.size()));
+    size_t pos = endpoint.rfind(':');
+    if (pos == std::string::npos || pos == 0 || pos == endpoint.size() - 1) {
+        return false;
+    }
+    std::string host(endpoint.substr(0, pos));
+    std::string port(endpoint.substr(pos + 1));
+    bool ipv6 = false;
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+        ipv6 = true;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = ipv6 ? AF_INET6 : AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+        return false;
+    }
+    std::memcpy(&addr, result->ai_addr, result->ai_addrlen);
+    addrLen = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+} // namespace fair::mq::uring
+
+#endif /* FAIR_MQ_URING_COMMON_H */
@@ -0,0 +1,25 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_URING_MESSAGE_H
+#define FAIR_MQ_URING_MESSAGE_H
+
+#include <fairmq/stream/Message.h>
+#include <fairmq/Transports.h>
+#include <fairmq/uring/UnmanagedRegion.h>
+
+namespace fair::mq::uring
+{
+
+class Socket;
+
+using Message = stream::Message<Socket, UnmanagedRegion, Transport::URING>;
+
+} // namespace fair::mq::uring
+
+#endif /* FAIR_MQ_URING_MESSAGE_H */
@@ -0,0 +1,957 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_URING_SOCKET_H
+#define FAIR_MQ_URING_SOCKET_H
+
+#include <fairmq/Message.h>
+#include <fairmq/Socket.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/uring/Common.h>
+#include <fairmq/uring/Context.h>
+#include <fairmq/uring/Message.h>
+#include <fairmq/uring/UnmanagedRegion.h>
+
+#include <fairlogger/Logger.h>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm> // min, find_if
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits> // IOV_MAX
+#include <cstring> // strerror
+#include <memory> // unique_ptr, make_unique, shared_ptr
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fair::mq::uring
+{
+
+/// PUSH/PULL and PAIR socket over TCP connections, data is moved with io_uring.
+/// Every message part is preceded by a FrameHeader on the wire. Parts above the zero-copy threshold
+/// are sent with IORING_OP_SEND_ZC (using a registered buffer if the part lives in an unmanaged region),
+/// smaller parts and the headers are gathered into a single IORING_OP_SENDMSG.
+class Socket final : public fair::mq::Socket
+{
+    friend class stream::Poller<Socket>;
+
+    static constexpr unsigned kMaxRegisteredBuffers = 64;
+    static constexpr size_t kMaxChunk = 1 << 30; // largest single io_uring send (results are 32 bit)
+    static constexpr int kReconnectInterval = 100; // ms
+
+  public:
+    Socket(Context& ctx, const std::string& type, const std::string& name, const std::string& id, fair::mq::TransportFactory* factory = nullptr)
+        : fair::mq::Socket(factory)
+        , fCtx(ctx)
+        , fId(id + "." + name + "." + type)
+        , fType(type)
+        , fBytesTx(0)
+        , fBytesRx(0)
+        , fMessagesTx(0)
+        , fMessagesRx(0)
+        , fTimeout(100)
+        , fLinger(1000)
+        , fSndHwm(1000)
+        , fRcvHwm(1000)
+        , fSndKernelSize(0)
+        , fRcvKernelSize(0)
+        , fNextPeer(0)
+        , fMoreFd(-1)
+        , fNumRegisteredBuffers(0)
+        , fZeroCopyThreshold(0)
+        , fNextUserData(1)
+    {
+        if (type != "push" && type != "pull" && type != "pair") {
+            LOG(error) << "Failed creating socket " << fId << ", reason: socket type '" << type << "' is not supported by the uring transport (push, pull, pair)";
+            throw SocketError(tools::ToString("Unavailable socket type for the uring transport requested: ", type));
+        }
+
+        try {
+            fRing = std::make_unique<Ring>(fCtx.GetQueueDepth());
+        } catch (const UringError& e) {
+            LOG(error) << "Failed creating socket " << fId << ", reason: " << e.what();
+            throw SocketError(tools::ToString("Failed creating socket ", fId, ", reason: ", e.what()));
+        }
+
+        if (fRing->ZeroCopy()) {
+            fZeroCopyThreshold = fCtx.GetZeroCopyThreshold();
+        } else {
+            LOG(debug) << "Kernel does not support IORING_OP_SEND_ZC, socket " << fId << " will copy all data";
+        }
+        if (fRing->RegisterBuffers(kMaxRegisteredBuffers)) {
+            fNumRegisteredBuffers = kMaxRegisteredBuffers;
+        }
+
+        LOG(debug) << "Created socket " << GetId();
+    }
+
+    Socket(const Socket&) = delete;
+    Socket(Socket&&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket& operator=(Socket&&) = delete;
+
+    std::string GetId() const override { return fId; }
+
+    bool Bind(const std::string& address) override
+    {
+        sockaddr_storage addr{};
+        socklen_t addrLen = 0;
+        if (!ResolveTcpAddress(address, addr, addrLen, true)) {
+            LOG(error) << "Failed binding socket " << fId << ", address: " << address << ", reason: the uring transport supports only tcp://<host>:<port> addresses";
+            return false;
+        }
+
+        int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            LOG(error) << "Failed binding socket " << fId << ", address: " << address << ", reason: " << strerror(errno);
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), addrLen) != 0 || listen(fd, SOMAXCONN) != 0) {
+            int err = errno;
+            close(fd);
+            // as in the zeromq transport, a busy port is handled upstream (by trying other ports from a range)
+            if (err != EADDRINUSE && err != EACCES) {
+                LOG(error) << "Failed binding socket " << fId << ", address: " << address << ", reason: " << strerror(err);
+            } else {
+                LOG(debug) << "Failed binding socket " << fId << ", address: " << address << ", reason: " << strerror(err);
+            }
+            return false;
+        }
+
+        fListenFds.push_back(fd);
+        return true;
+    }
+
+    bool Connect(const std::string& address) override
+    {
+        Endpoint endpoint;
+        if (!ResolveTcpAddress(address, endpoint.fAddr, endpoint.fAddrLen, false)) {
+            LOG(error) << "Failed connecting socket " << fId << ", address: " << address << ", reason: the uring transport supports only tcp://<host>:<port> addresses";
+            return false;
+        }
+        endpoint.fAddress = address;
+        // like zeromq, the connection is established (and re-established) in the background of send/receive/poll calls
+        fEndpoints.push_back(endpoint);
+        UpdatePeers();
+        return true;
+    }
+
+    int64_t Send(MessagePtr& msg, int timeout = -1) override { return SendParts(&msg, 1, timeout); }
+
+    int64_t Send(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
+    {
+        if (msgVec.empty()) {
+            LOG(warn) << "Will not send empty vector";
+            return static_cast<int>(TransferCode::error);
+        }
+        return SendParts(msgVec.data(), msgVec.size(), timeout);
+    }
+
+    int64_t Receive(MessagePtr& msg, int timeout = -1) override
+    {
+        if (fType == "push") {
+            LOG(error) << "Cannot receive on push socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+
+        while (true) {
+            int fd = fMoreFd;
+            if (fd < 0) {
+                int peer = WaitForPeer(POLLIN, timeout);
+                if (peer < 0) {
+                    return peer;
+                }
+                fd = fPeers[peer].fFd;
+            }
+
+            FrameHeader header{};
+            int64_t result = ReceivePart(fd, *static_cast<Message*>(msg.get()), header);
+            if (result < 0) {
+                continue; // peer is gone, wait for the next one
+            }
+            // remaining parts of a multipart message are returned by the next calls
+            fMoreFd = (header.fFlags & FrameHeader::kMore) ? fd : -1;
+            fBytesRx += result;
+            ++fMessagesRx;
+            return result;
+        }
+    }
+
+    int64_t Receive(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
+    {
+        if (fType == "push") {
+            LOG(error) << "Cannot receive on push socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+
+        while (true) {
+            int fd = fMoreFd;
+            if (fd < 0) {
+                int peer = WaitForPeer(POLLIN, timeout);
+                if (peer < 0) {
+                    return peer;
+                }
+                fd = fPeers[peer].fFd;
+            }
+
+            size_t initialSize = msgVec.size();
+            int64_t totalSize = 0;
+            FrameHeader header{};
+            do {
+                fair::mq::MessagePtr part = std::make_unique<Message>(GetTransport());
+                int64_t result = ReceivePart(fd, *static_cast<Message*>(part.get()), header);
+                if (result < 0) {
+                    totalSize = -1;
+                    break;
+                }
+                msgVec.push_back(move(part));
+                totalSize += result;
+            } while (header.fFlags & FrameHeader::kMore);
+
+            fMoreFd = -1;
+            if (totalSize < 0) {
+                // connection was lost within the message, drop the incomplete parts
+                msgVec.resize(initialSize);
+                continue;
+            }
+
+            // store statistics on how many messages have been received (handle all parts as a single message)
+            ++fMessagesRx;
+            fBytesRx += totalSize;
+            return totalSize;
+        }
+    }
+
+    void Close() override
+    {
+        // LOG(debug) << "Closing socket " << fId;
+
+        // wait (up to linger) until the kernel has released the buffers of zero-copy sends
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(fLinger);
+        while (fRing && !fInFlight.empty()) {
+            fRing->Submit();
+            ReapCompletions();
+            if (fInFlight.empty()) {
+                break;
+            }
+            if (fLinger >= 0 && std::chrono::steady_clock::now() > deadline) {
+                LOG(warn) << "Closing socket " << fId << " with " << fInFlight.size() << " zero-copy send(s) still in flight";
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        fInFlight.clear();
+        fEarlyNotifications.clear();
+
+        for (const Peer& peer : fPeers) {
+            close(peer.fFd);
+        }
+        fPeers.clear();
+        for (Endpoint& endpoint : fEndpoints) {
+            if (endpoint.fFd >= 0 && !endpoint.fConnected) {
+                close(endpoint.fFd);
+            }
+        }
+        fEndpoints.clear();
+        for (int fd : fListenFds) {
+            close(fd);
+        }
+        fListenFds.clear();
+        fMoreFd = -1;
+
+        fRegisteredRegions.clear();
+        fRing.reset();
+    }
+
+    void SetOption(const std::string& option, const void* value, size_t /* valueSize */) override
+    {
+        int intValue = *static_cast<const int*>(value);
+        if (option == "linger") {
+            SetLinger(intValue);
+        } else if (option == "snd-hwm") {
+            SetSndBufSize(intValue);
+        } else if (option == "rcv-hwm") {
+            SetRcvBufSize(intValue);
+        } else if (option == "snd-size") {
+            SetSndKernelSize(intValue);
+        } else if (option == "rcv-size") {
+            SetRcvKernelSize(intValue);
+        } else {
+            LOG(error) << "Failed setting socket option, reason: option '" << option << "' is not supported by the uring transport";
+        }
+    }
+
+    void GetOption(const std::string& option, void* value, size_t* valueSize) override
+    {
+        int intValue = 0;
+        if (option == "linger") {
+            intValue = GetLinger();
+        } else if (option == "snd-hwm") {
+            intValue = GetSndBufSize();
+        } else if (option == "rcv-hwm") {
+            intValue = GetRcvBufSize();
+        } else if (option == "snd-size") {
+            intValue = GetSndKernelSize();
+        } else if (option == "rcv-size") {
+            intValue = GetRcvKernelSize();
+        } else if (option == "rcv-more") {
+            intValue = fMoreFd >= 0 ? 1 : 0;
+        } else {
+            LOG(error) << "Failed getting socket option, reason: option '" << option << "' is not supported by the uring transport";
+            return;
+        }
+        *static_cast<int*>(value) = intValue;
+        *valueSize = sizeof(intValue);
+    }
+
+    int Events(uint32_t* events) override
+    {
+        UpdatePeers();
+        std::vector<pollfd> fds;
+        AddPollFds(fds);
+        if (!fds.empty() && poll(fds.data(), fds.size(), 0) < 0 && errno != EINTR) {
+            LOG(error) << "Failed getting events of socket " << fId << ", reason: " << strerror(errno);
+            return -1;
+        }
+        *events = PollResult(fds.data());
+        return 0;
+    }
+
+    void SetLinger(int value) override { fLinger = value; }
+    int GetLinger() const override { return fLinger; }
+    // high-water marks are accepted for compatibility, the amount of queued data is bounded by the kernel socket buffers
+    void SetSndBufSize(int value) override { fSndHwm = value; }
+    int GetSndBufSize() const override { return fSndHwm; }
+    void SetRcvBufSize(int value) override { fRcvHwm = value; }
+    int GetRcvBufSize() const override { return fRcvHwm; }
+
+    void SetSndKernelSize(int value) override
+    {
+        fSndKernelSize = value;
+        for (const Peer& peer : fPeers) {
+            ConfigureFd(peer.fFd);
+        }
+    }
+
+    int GetSndKernelSize() const override { return fSndKernelSize; }
+
+    void SetRcvKernelSize(int value) override
+    {
+        fRcvKernelSize = value;
+        for (const Peer& peer : fPeers) {
+            ConfigureFd(peer.fFd);
+        }
+    }
+
+    int GetRcvKernelSize() const override { return fRcvKernelSize; }
+
+    unsigned long GetNumberOfConnectedPeers() const override
+    {
+        UpdatePeers();
+        return fPeers.size();
+    }
+
+    unsigned long GetBytesTx() const override { return fBytesTx; }
+    unsigned long GetBytesRx() const override { return fBytesRx; }
+    unsigned long GetMessagesTx() const override { return fMessagesTx; }
+    unsigned long GetMessagesRx() const override { return fMessagesRx; }
+
+    /// @return number of zero-copy sends whose buffers the kernel still references, after reaping the notifications
+    /// that arrived so far
+    size_t GetNumZeroCopyInFlight()
+    {
+        if (fRing) {
+            ReapCompletions();
+        }
+        return fInFlight.size();
+    }
+
+    ~Socket() override { Close(); }
+
+  private:
+    struct Peer
+    {
+        int fFd;
+        int fEndpoint; // index into fEndpoints for connected peers, -1 for accepted peers
+    };
+
+    struct Endpoint
+    {
+        std::string fAddress;
+        sockaddr_storage fAddr{};
+        socklen_t fAddrLen = 0;
+        int fFd = -1; // connection in progress or established
+        bool fConnected = false;
+        std::chrono::steady_clock::time_point fNextAttempt;
+    };
+
+    struct SendOp
+    {
+        size_t fIov; // first iovec of a sendmsg
+        size_t fNumIov; // 0 for a send of fData
+        const char* fData;
+        size_t fSize;
+        bool fZeroCopy;
+        int fBufIndex; // registered buffer, -1 if none
+        size_t fPart; // message part of fData
+    };
+
+    int64_t SendParts(MessagePtr* msgs, size_t numParts, int timeout)
+    {
+        if (fType == "pull") {
+            LOG(error) << "Cannot send on pull socket " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+
+        if (!fInFlight.empty()) {
+            ReapCompletions();
+        }
+
+        while (true) {
+            int peer = WaitForPeer(POLLOUT, timeout);
+            if (peer < 0) {
+                return peer;
+            }
+
+            int64_t result = Transmit(fPeers[peer].fFd, msgs, numParts);
+            if (result < 0) {
+                LOG(debug) << "Lost peer of socket " << fId << " while sending, reason: " << strerror(static_cast<int>(-result));
+                ClosePeer(peer);
+                continue;
+            }
+
+            for (size_t i = 0; i < numParts; ++i) {
+                msgs[i]->Rebuild();
+            }
+
+            // store statistics on how many messages have been sent (handle all parts as a single message)
+            ++fMessagesTx;
+            fBytesTx += result;
+            return result;
+        }
+    }
+
+    /// write all parts (with their headers) to fd
+    /// @return number of payload bytes or -errno
+    int64_t Transmit(int fd, MessagePtr* msgs, size_t numParts)
+    {
+        fHeaders.resize(numParts);
+        fIovs.clear();
+        fIovs.reserve(2 * numParts);
+        fOps.clear();
+
+        int64_t totalSize = 0;
+        size_t firstIov = 0;
+        size_t pendingBytes = 0;
+        auto flush = [&]() {
+            if (fIovs.size() > firstIov) {
+                fOps.push_back({firstIov, fIovs.size() - firstIov, nullptr, pendingBytes, false, -1, 0});
+                firstIov = fIovs.size();
+                pendingBytes = 0;
+            }
+        };
+        auto gather = [&](void* data, size_t size) {
+            if (fIovs.size() - firstIov == IOV_MAX || pendingBytes + size > kMaxChunk) {
+                flush();
+            }
+            fIovs.push_back({data, size});
+            pendingBytes += size;
+        };
+
+        for (size_t i = 0; i < numParts; ++i) {
+            Message& msg = *static_cast<Message*>(msgs[i].get());
+            size_t size = msg.GetSize();
+            totalSize += size;
+            fHeaders[i] = {size, i + 1 < numParts ? FrameHeader::kMore : 0, FrameHeader::kMagic};
+            gather(&fHeaders[i], sizeof(FrameHeader));
+
+            bool zeroCopy = fZeroCopyThreshold > 0 && size >= fZeroCopyThreshold;
+            if (size == 0) {
+                continue;
+            } else if (zeroCopy || size > kMaxChunk) {
+                flush();
+                int bufIndex = zeroCopy && msg.fRegion ? RegisteredBuffer(msg.fRegion) : -1;
+                for (size_t offset = 0; offset < size; offset += kMaxChunk) {
+                    fOps.push_back({0, 0, msg.fData + offset, std::min(kMaxChunk, size - offset), zeroCopy, bufIndex, i});
+                }
+            } else {
+                gather(msg.fData, size);
+            }
+        }
+        flush();
+
+        fMsgHdrs.assign(fOps.size(), msghdr{});
+        for (size_t j = 0; j < fOps.size(); ++j) {
+            if (fOps[j].fNumIov > 0) {
+                fMsgHdrs[j].msg_iov = &fIovs[fOps[j].fIov];
+                fMsgHdrs[j].msg_iovlen = fOps[j].fNumIov;
+            }
+        }
+
+        // ops are linked, so that they are executed in order. Keep a chain within one submission.
+        const size_t batchSize = fRing->Entries();
+        for (size_t begin = 0; begin < fOps.size(); begin += batchSize) {
+            const size_t end = std::min(fOps.size(), begin + batchSize);
+            const uint64_t base = fNextUserData;
+            fNextUserData += end - begin;
+
+            for (size_t j = begin; j < end; ++j) {
+                io_uring_sqe* sqe = fRing->GetSqe();
+                PrepareSend(sqe, fd, j);
+                sqe->user_data = base + (j - begin);
+                if (j + 1 < end) {
+                    sqe->flags |= IOSQE_IO_LINK;
+                }
+            }
+            fRing->Submit();
+            Collect(base, end - begin);
+
+            for (size_t j = begin; j < end; ++j) {
+                const SendOp& op = fOps[j];
+                int res = fResults[j - begin];
+                if (fNotify[j - begin] && fEarlyNotifications.erase(base + (j - begin)) == 0) {
+                    // the kernel still references the buffer until the notification arrives
+                    fInFlight.emplace(base + (j - begin), static_cast<Message*>(msgs[op.fPart].get())->fBuffer);
+                }
+                if (res < 0 && res != -ECANCELED) {
+                    return res;
+                }
+                size_t done = res > 0 ? res : 0;
+                if (done < op.fSize) {
+                    // short or cancelled (after a short send in the chain) send, finish it in order
+                    int rc = SendRemainder(fd, op, done);
+                    if (rc < 0) {
+                        return rc;
+                    }
+                }
+            }
+        }
+
+        return totalSize;
+    }
+
+    void PrepareSend(io_uring_sqe* sqe, int fd, size_t op)
+    {
+        sqe->fd = fd;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        if (fOps[op].fNumIov > 0) {
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = reinterpret_cast<uint64_t>(&fMsgHdrs[op]);
+            sqe->len = 1;
+        } else {
+            sqe->opcode = fOps[op].fZeroCopy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+            sqe->addr = reinterpret_cast<uint64_t>(fOps[op].fData);
+            sqe->len = fOps[op].fSize;
+            if (fOps[op].fBufIndex >= 0) {
+                sqe->ioprio |= IORING_RECVSEND_FIXED_BUF;
+                sqe->buf_index = fOps[op].fBufIndex;
+            }
+        }
+    }
+
+    /// send the rest of the op (from byte done on) with plain sends, one at a time
+    int SendRemainder(int fd, const SendOp& op, size_t done)
+    {
+        auto send = [&](const char* data, size_t size) {
+            while (size > 0) {
+                io_uring_sqe* sqe = fRing->GetSqe();
+                sqe->opcode = IORING_OP_SEND;
+                sqe->fd = fd;
+                sqe->addr = reinterpret_cast<uint64_t>(data);
+                sqe->len = size;
+                sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+                int res = Execute(sqe);
+                if (res == -EINTR || res == -EAGAIN) {
+                    continue;
+                } else if (res <= 0) {
+                    return res < 0 ? res : -EPIPE;
+                }
+                data += res;
+                size -= res;
+            }
+            return 0;
+        };
+
+        if (op.fNumIov == 0) {
+            return send(op.fData + done, op.fSize - done);
+        }
+        for (size_t k = op.fIov; k < op.fIov + op.fNumIov; ++k) {
+            size_t len = fIovs[k].iov_len;
+            if (done >= len) {
+                done -= len;
+                continue;
+            }
+            int rc = send(static_cast<const char*>(fIovs[k].iov_base) + done, len - done);
+            if (rc < 0) {
+                return rc;
+            }
+            done = 0;
+        }
+        return 0;
+    }
+
+    /// receive one part (header and data) from fd into msg
+    /// @return size of the part or -1 if the peer is gone
+    int64_t ReceivePart(int fd, Message& msg, FrameHeader& header)
+    {
+        int64_t res = ReceiveAll(fd, reinterpret_cast<char*>(&header), sizeof(header));
+        if (res > 0 && header.fMagic != FrameHeader::kMagic) {
+            LOG(error) << "Received invalid frame on socket " << fId << ", closing the connection";
+            res = -EPROTO;
+        }
+        if (res > 0 && header.fSize > 0) {
+            res = ReceiveAll(fd, msg.Reset(header.fSize), header.fSize);
+        } else if (res > 0) {
+            msg.Reset(0);
+        }
+
+        if (res <= 0) {
+            if (res < 0) {
+                LOG(debug) << "Lost peer of socket " << fId << " while receiving, reason: " << strerror(static_cast<int>(-res));
+            }
+            auto it = std::find_if(fPeers.begin(), fPeers.end(), [fd](const Peer& p) { return p.fFd == fd; });
+            if (it != fPeers.end()) {
+                ClosePeer(it - fPeers.begin());
+            }
+            if (fMoreFd == fd) {
+                fMoreFd = -1;
+            }
+            return -1;
+        }
+        return header.fSize;
+    }
+
+    /// @return size, 0 if the peer closed the connection or -errno
+    int64_t ReceiveAll(int fd, char* data, size_t size)
+    {
+        size_t received = 0;
+        while (received < size) {
+            io_uring_sqe* sqe = fRing->GetSqe();
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<uint64_t>(data + received);
+            sqe->len = std::min(kMaxChunk, size - received);
+            sqe->msg_flags = MSG_WAITALL;
+            int res = Execute(sqe);
+            if (res == -EINTR || res == -EAGAIN) {
+                continue;
+            } else if (res <= 0) {
+                return res;
+            }
+            received += res;
+        }
+        return received;
+    }
+
+    /// submit a single prepared entry and wait for its result
+    int Execute(io_uring_sqe* sqe)
+    {
+        const uint64_t userData = fNextUserData++;
+        sqe->user_data = userData;
+        fRing->Submit();
+        Collect(userData, 1);
+        if (fNotify[0]) {
+            LOG(error) << "unexpected zero-copy notification for a copying operation";
+        }
+        return fResults[0];
+    }
+
+    /// wait for the results of count operations with consecutive user data starting at base
+    void Collect(uint64_t base, size_t count)
+    {
+        fResults.assign(count, 0);
+        fNotify.assign(count, false);
+        size_t remaining = count;
+        io_uring_cqe cqe{};
+        while (remaining > 0) {
+            fRing->Wait(cqe);
+            if (cqe.flags & IORING_CQE_F_NOTIF) {
+                ReleaseZeroCopy(cqe.user_data);
+            } else if (cqe.user_data >= base && cqe.user_data < base + count) {
+                fResults[cqe.user_data - base] = cqe.res;
+                fNotify[cqe.user_data - base] = cqe.flags & IORING_CQE_F_MORE;
+                --remaining;
+            }
+        }
+    }
+
+    /// release buffers of completed zero-copy sends
+    void ReapCompletions()
+    {
+        io_uring_cqe cqe{};
+        while (fRing->Peek(cqe)) {
+            if (cqe.flags & IORING_CQE_F_NOTIF) {
+                ReleaseZeroCopy(cqe.user_data);
+            }
+        }
+    }
+
+    /// release the buffer of a zero-copy send whose notification arrived. A fast send is notified within the same
+    /// Collect() as its result, before Transmit() took the buffer into fInFlight: remember it, so it is not taken
+    void ReleaseZeroCopy(uint64_t userData)
+    {
+        if (fInFlight.erase(userData) == 0) {
+            fEarlyNotifications.insert(userData);
+        }
+    }
+
+    /// @return index of the registered buffer covering the region, -1 if it cannot be registered
+    int RegisteredBuffer(const std::shared_ptr<RegionState>& region)
+    {
+        auto it = fRegisteredIndex.find(region.get());
+        if (it != fRegisteredIndex.end()) {
+            return it->second;
+        }
+        int index = -1;
+        if (fRegisteredRegions.size() < fNumRegisteredBuffers && region->fSize <= kMaxChunk) {
+            unsigned slot = fRegisteredRegions.size();
+            if (fRing->UpdateBuffer(slot, {region->fBuffer, region->fSize})) {
+                // the socket keeps the region memory alive while it is registered
+                fRegisteredRegions.push_back(region);
+                index = slot;
+            } else {
+                LOG(debug) << "Could not register region " << region->fId << " with socket " << fId << ", reason: " << strerror(errno);
+            }
+        }
+        fRegisteredIndex.emplace(region.get(), index);
+        return index;
+    }
+
+    /// wait until a peer is ready for the given events
+    /// @return peer index or a (negative) TransferCode
+    int WaitForPeer(short events, int timeout)
+    {
+        int elapsed = 0;
+        while (true) {
+            UpdatePeers();
+            fPollFds.clear();
+            AddPollFds(fPollFds, events);
+            int wait = timeout < 0 ? fTimeout : std::min(fTimeout, timeout - elapsed);
+            if (poll(fPollFds.data(), fPollFds.size(), wait) < 0 && errno != EINTR) {
+                LOG(error) << "Failed polling socket " << fId << ", reason: " << strerror(errno);
+                return static_cast<int>(TransferCode::error);
+            }
+
+            int peer = ReadyPeer(fPollFds.data(), events);
+            if (peer >= 0) {
+                return peer;
+            } else if (fCtx.Interrupted()) {
+                return static_cast<int>(TransferCode::interrupted);
+            } else if (timeout >= 0) {
+                elapsed += wait;
+                if (elapsed >= timeout) {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            }
+        }
+    }
+
+    /// pick the next ready peer (round-robin), close dead ones
+    int ReadyPeer(const pollfd* fds, short events)
+    {
+        const size_t numPeers = fPeers.size();
+        for (size_t k = 0; k < numPeers; ++k) {
+            size_t i = (fNextPeer + k) % numPeers;
+            if (fds[i].revents & events) {
+                fNextPeer = i + 1;
+                return i;
+            }
+        }
+        for (size_t i = numPeers; i-- > 0;) {
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                ClosePeer(i);
+            }
+        }
+        return -1;
+    }
+
+    /// descriptors to poll: the peers (first, in order), listening sockets and connections in progress
+    void AddPollFds(std::vector<pollfd>& fds, short events = 0) const
+    {
+        if (events == 0) {
+            events = fType == "push" ? POLLOUT : (fType == "pull" ? POLLIN : POLLIN | POLLOUT);
+        }
+        for (const Peer& peer : fPeers) {
+            fds.push_back({peer.fFd, events, 0});
+        }
+        for (int fd : fListenFds) {
+            fds.push_back({fd, POLLIN, 0});
+        }
+        for (const Endpoint& endpoint : fEndpoints) {
+            if (endpoint.fFd >= 0 && !endpoint.fConnected) {
+                fds.push_back({endpoint.fFd, POLLOUT, 0});
+            }
+        }
+    }
+
+    /// kPollIn/kPollOut from the polled descriptors of AddPollFds()
+    uint32_t PollResult(const pollfd* fds) const
+    {
+        uint32_t result = fMoreFd >= 0 ? kPollIn : 0;
+        for (size_t i = 0; i < fPeers.size(); ++i) {
+            if (fds[i].revents & POLLIN) {
+                result |= kPollIn;
+            }
+            if (fds[i].revents & POLLOUT) {
+                result |= kPollOut;
+            }
+        }
+        return result;
+    }
+
+    /// accept incoming connections and progress outgoing ones
+    void UpdatePeers() const
+    {
+        for (int listenFd : fListenFds) {
+            while (true) {
+                int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd < 0) {
+                    break;
+                }
+                if (fType == "pair" && !fPeers.empty()) {
+                    LOG(warn) << "Rejecting additional connection to pair socket " << fId;
+                    close(fd);
+                    continue;
+                }
+                ConfigureFd(fd);
+                fPeers.push_back({fd, -1});
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < fEndpoints.size(); ++i) {
+            Endpoint& endpoint = fEndpoints[i];
+            if (endpoint.fConnected) {
+                continue;
+            }
+            if (endpoint.fFd < 0) {
+                if (now < endpoint.fNextAttempt) {
+                    continue;
+                }
+                endpoint.fFd = socket(endpoint.fAddr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (endpoint.fFd < 0) {
+                    LOG(error) << "Failed connecting socket " << fId << ", address: " << endpoint.fAddress << ", reason: " << strerror(errno);
+                    endpoint.fNextAttempt = now + std::chrono::milliseconds(kReconnectInterval);
+                    continue;
+                }
+                if (connect(endpoint.fFd, reinterpret_cast<const sockaddr*>(&endpoint.fAddr), endpoint.fAddrLen) != 0 && errno != EINPROGRESS) {
+                    close(endpoint.fFd);
+                    endpoint.fFd = -1;
+                    endpoint.fNextAttempt = now + std::chrono::milliseconds(kReconnectInterval);
+                    continue;
+                }
+            }
+
+            pollfd pfd{endpoint.fFd, POLLOUT, 0};
+            if (poll(&pfd, 1, 0) <= 0) {
+                continue; // still in progress
+            }
+            int err = 0;
+            socklen_t errLen = sizeof(err);
+            if (getsockopt(endpoint.fFd, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0 || err != 0) {
+                close(endpoint.fFd);
+                endpoint.fFd = -1;
+                endpoint.fNextAttempt = now + std::chrono::milliseconds(kReconnectInterval);
+                continue;
+            }
+            if (fType == "pair" && !fPeers.empty()) {
+                close(endpoint.fFd);
+                endpoint.fFd = -1;
+                endpoint.fNextAttempt = now + std::chrono::milliseconds(kReconnectInterval);
+                continue;
+            }
+            // the data transfer itself goes through io_uring, which does not need non-blocking descriptors
+            fcntl(endpoint.fFd, F_SETFL, fcntl(endpoint.fFd, F_GETFL) & ~O_NONBLOCK);
+            ConfigureFd(endpoint.fFd);
+            endpoint.fConnected = true;
+            fPeers.push_back({endpoint.fFd, static_cast<int>(i)});
+        }
+    }
+
+    void ClosePeer(size_t index) const
+    {
+        const Peer peer = fPeers.at(index);
+        close(peer.fFd);
+        if (peer.fEndpoint >= 0) {
+            Endpoint& endpoint = fEndpoints.at(peer.fEndpoint);
+            endpoint.fFd = -1;
+            endpoint.fConnected = false;
+            endpoint.fNextAttempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(kReconnectInterval);
+        }
+        fPeers.erase(fPeers.begin() + index);
+    }
+
+    void ConfigureFd(int fd) const
+    {
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (fSndKernelSize > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &fSndKernelSize, sizeof(fSndKernelSize)) != 0) {
+            LOG(error) << "Failed setting SO_SNDBUF on socket " << fId << ", reason: " << strerror(errno);
+        }
+        if (fRcvKernelSize > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &fRcvKernelSize, sizeof(fRcvKernelSize)) != 0) {
+            LOG(error) << "Failed setting SO_RCVBUF on socket " << fId << ", reason: " << strerror(errno);
+        }
+    }
+
+    Context& fCtx;
+    std::string fId;
+    std::string fType;
+    std::unique_ptr<Ring> fRing;
+    TransferCounter fBytesTx;
+    TransferCounter fBytesRx;
+    TransferCounter fMessagesTx;
+    TransferCounter fMessagesRx;
+
+    int fTimeout;
+    int fLinger;
+    int fSndHwm;
+    int fRcvHwm;
+    int fSndKernelSize;
+    int fRcvKernelSize;
+
+    // connections are updated lazily, also from const getters
+    std::vector<int> fListenFds;
+    mutable std::vector<Endpoint> fEndpoints;
+    mutable std::vector<Peer> fPeers;
+    size_t fNextPeer;
+    int fMoreFd; // peer with the remaining parts of a partially received multipart message
+    std::vector<pollfd> fPollFds;
+
+    unsigned fNumRegisteredBuffers;
+    std::vector<std::shared_ptr<RegionState>> fRegisteredRegions; // index in the registered buffer table
+    std::unordered_map<const RegionState*, int> fRegisteredIndex;
+    size_t fZeroCopyThreshold; // 0: zero-copy send disabled
+    uint64_t fNextUserData;
+    std::unordered_map<uint64_t, std::shared_ptr<char>> fInFlight; // buffers referenced by zero-copy sends
+    std::unordered_set<uint64_t> fEarlyNotifications; // of zero-copy sends not yet in fInFlight
+
+    // reused per send
+    std::vector<FrameHeader> fHeaders;
+    std::vector<iovec> fIovs;
+    std::vector<SendOp> fOps;
+    std::vector<msghdr> fMsgHdrs;
+    std::vector<int> fResults;
+    std::vector<bool> fNotify;
+};
+
+} // namespace fair::mq::uring
+
+#endif /* FAIR_MQ_URING_SOCKET_H */
@@ -10,9 +10,28 @@
 
 #include <fairlogger/Logger.h>
 #include <fairmq/Error.h>
+#include <fairmq/tools/Log.h>
 #include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Threads.h>
+#include <netinet/in.h> // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_INFO
+#include <sched.h> // SCHED_OTHER, SCHED_FIFO, SCHED_RR
+#include <sys/ioctl.h> // ioctl
+#ifdef __linux__
+#include <linux/sockios.h> // SIOCINQ, SIOCOUTQ
+#endif
+#include <sys/socket.h> // getsockopt, setsockopt
+#include <algorithm> // min, max, remove
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <map>
+#include <sstream>
 #include <stdexcept>
+#include <string>
 #include <string_view>
+#include <vector>
 #include <zmq.h>
 
 namespace fair::mq::zmq
@@ -20,6 +39,138 @@ namespace fair::mq::zmq
 
 struct Error : std::runtime_error { using std::runtime_error::runtime_error; };
 
+/// I/O threads of a zeromq context. Channels select a context with their contextGroup property,
+/// groups are configured with --zmq-context-group name=<name>,io-threads=<n>,cpus=<list>,sched=<policy>,priority=<p>
+struct ContextGroup
+{
+    std::string name;
+    int ioThreads = 1;
+    std::vector<int> cpus;  /// CPUs the I/O threads are pinned to (empty: no pinning)
+    int schedPolicy = -1;   /// scheduling policy of the I/O threads (-1: default)
+    int priority = -1;      /// scheduling priority of the I/O threads (-1: default)
+};
+
+/// parse a list of CPUs, e.g. "2:4-7" (':' separated CPUs or ranges)
+inline std::vector<int> ParseCpuList(const std::string& list)
+{
+    try {
+        return tools::ParseCpuList(list);
+    } catch (const tools::ThreadSettingsError& e) {
+        throw Error(e.what());
+    }
+}
+
+/// parse the values of --zmq-context-group into groups by name
+inline std::map<std::string, ContextGroup> ParseContextGroups(const std::vector<std::string>& specs, int defaultIoThreads)
+{
+    std::map<std::string, ContextGroup> groups;
+    for (const auto& spec : specs) {
+        ContextGroup group;
+        group.ioThreads = defaultIoThreads;
+        std::istringstream ss(spec);
+        std::string token;
+        while (std::getline(ss, token, ',')) {
+            size_t pos = token.find('=');
+            if (pos == std::string::npos) {
+                throw Error(tools::ToString("invalid context group option '", token, "' in '", spec, "', expected key=value"));
+            }
+            std::string key(token.substr(0, pos));
+            std::string value(token.substr(pos + 1));
+            try {
+                if (key == "name") {
+                    group.name = value;
+                } else if (key == "io-threads") {
+                    group.ioThreads = std::stoi(value);
+                } else if (key == "cpus") {
+                    group.cpus = ParseCpuList(value);
+                } else if (key == "sched") {
+                    if (value == "other") {
+                        group.schedPolicy = SCHED_OTHER;
+                    } else if (value == "fifo") {
+                        group.schedPolicy = SCHED_FIFO;
+                    } else if (value == "rr") {
+                        group.schedPolicy = SCHED_RR;
+                    } else {
+                        throw Error(tools::ToString("invalid scheduling policy '", value, "', valid are 'other', 'fifo' and 'rr'"));
+                    }
+                } else if (key == "priority") {
+                    group.priority = std::stoi(value);
+                } else {
+                    throw Error(tools::ToString("unknown context group option '", key, "', valid are 'name', 'io-threads', 'cpus', 'sched' and 'priority'"));
+                }
+            } catch (const std::logic_error&) {
+                throw Error(tools::ToString("invalid value for context group option '", key, "': '", value, "'"));
+            }
+        }
+        if (group.name.empty()) {
+            throw Error(tools::ToString("context group '", spec, "' has no name"));
+        }
+        if (group.ioThreads < 0) {
+            throw Error(tools::ToString("context group '", group.name, "': number of I/O threads cannot be negative"));
+        }
+        groups[group.name] = group;
+    }
+    return groups;
+}
+
+/// the context groups of --zmq-context-group, the default context gets the settings of the transport threads
+/// (--io-cpu-affinity, --sched-policy, --sched-priority) unless it is configured explicitly with the name 'default'
+inline std::map<std::string, ContextGroup> ContextGroups(const std::vector<std::string>& specs, int defaultIoThreads, const tools::ThreadSettings& io)
+{
+    std::map<std::string, ContextGroup> groups = ParseContextGroups(specs, defaultIoThreads);
+    if (!io.Empty() && groups.count("default") == 0) {
+        ContextGroup group;
+        group.name = "default";
+        group.ioThreads = defaultIoThreads;
+        group.cpus = io.cpus;
+        group.schedPolicy = io.schedPolicy;
+        // zeromq keeps the priority of the thread (0) if none is given, which is invalid for fifo/rr
+        group.priority = (io.priority < 0 && io.schedPolicy >= 0) ? sched_get_priority_min(io.schedPolicy) : io.priority;
+        groups.emplace(group.name, group);
+    }
+    return groups;
+}
+
+/// apply the thread settings of a group to a zeromq context (before its first socket is created)
+inline void ConfigureContext(void* ctx, const ContextGroup& group)
+{
+    if (zmq_ctx_set(ctx, ZMQ_IO_THREADS, group.ioThreads) != 0) {
+        LOG(error) << "failed configuring I/O threads of context group '" << group.name << "', reason: " << zmq_strerror(errno);
+        throw Error(tools::ToString("failed configuring I/O threads of context group '", group.name, "', reason: ", zmq_strerror(errno)));
+    }
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+    for (int cpu : group.cpus) {
+        if (zmq_ctx_set(ctx, ZMQ_THREAD_AFFINITY_CPU_ADD, cpu) != 0) {
+            LOG(error) << "failed pinning I/O threads of context group '" << group.name << "' to CPU " << cpu << ", reason: " << zmq_strerror(errno);
+            throw Error(tools::ToString("failed pinning I/O threads of context group '", group.name, "' to CPU ", cpu, ", reason: ", zmq_strerror(errno)));
+        }
+    }
+#else
+    if (!group.cpus.empty()) {
+        LOG(warn) << "context group '" << group.name << "': CPU affinity of I/O threads is not supported by this ZeroMQ version";
+    }
+#endif
+    if (group.schedPolicy >= 0 && zmq_ctx_set(ctx, ZMQ_THREAD_SCHED_POLICY, group.schedPolicy) != 0) {
+        LOG(error) << "failed setting scheduling policy of context group '" << group.name << "', reason: " << zmq_strerror(errno);
+        throw Error(tools::ToString("failed setting scheduling policy of context group '", group.name, "', reason: ", zmq_strerror(errno)));
+    }
+    if (group.priority >= 0 && zmq_ctx_set(ctx, ZMQ_THREAD_PRIORITY, group.priority) != 0) {
+        LOG(error) << "failed setting scheduling priority of context group '" << group.name << "', reason: " << zmq_strerror(errno);
+        throw Error(tools::ToString("failed setting scheduling priority of context group '", group.name, "', reason: ", zmq_strerror(errno)));
+    }
+}
+
+// endpoint the socket was last bound to (ZMQ_LAST_ENDPOINT), with the actual port for wildcard (tcp://<host>:*) binds
+inline std::string GetLastEndpoint(void* socket)
+{
+    std::array<char, 256> endpoint{};
+    size_t size = endpoint.size();
+    if (zmq_getsockopt(socket, ZMQ_LAST_ENDPOINT, endpoint.data(), &size) != 0) {
+        return "";
+    }
+    return endpoint.data();
+}
+
 inline bool Bind(void* socket, const std::string& address, const std::string& id)
 {
     // LOG(debug) << "Binding socket " << id << " on " << address;
@@ -61,20 +212,55 @@ inline bool Connect(void* socket, const std::string& address, const std::string&
     return true;
 }
 
-inline bool ShouldRetry(int flags, int socketTimeout, int userTimeout, int& elapsed)
+/// Flags of the transfer calls for a user timeout (in ms): with a timeout the calls do not block and TransferWait
+/// waits for the socket, without one (-1) they block in zeromq for the socket timeout (SNDTIMEO/RCVTIMEO, checking
+/// for interruption in between).
+inline int TransferFlags(int timeout) { return timeout < 0 ? 0 : ZMQ_DONTWAIT; }
+
+/// Waits of a transfer for its socket after a transfer call failed with EAGAIN, until the deadline of the user timeout.
+/// A positive timeout is kept to the millisecond: the socket is polled for the remaining time (in slices of at most
+/// the socket timeout, so that the caller notices interruptions).
+class TransferWait
 {
-    if ((flags & ZMQ_DONTWAIT) == 0) {
-        if (userTimeout > 0) {
-            elapsed += socketTimeout;
-            if (elapsed >= userTimeout) {
-                return false;
-            }
+  public:
+    /// @param events ZMQ_POLLIN or ZMQ_POLLOUT
+    TransferWait(void* socket, short events, int socketTimeout, int timeout)
+        : fSocket(socket)
+        , fEvents(events)
+        , fSocketTimeout(socketTimeout)
+        , fTimeout(timeout)
+        , fDeadline(timeout > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout) : std::chrono::steady_clock::time_point())
+    {}
+
+    /// @return false if the transfer timed out, true if it is to be retried
+    bool Retry() const
+    {
+        if (fTimeout < 0) {
+            return true; // the blocking call waited for the socket timeout
+        } else if (fTimeout == 0) {
+            return false;
         }
+        auto remaining = fDeadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return false;
+        }
+        // rounded up, a poll returning early is followed by another one
+        long wait = std::chrono::duration_cast<std::chrono::milliseconds>(remaining + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+        if (fSocketTimeout > 0) {
+            wait = std::min(wait, static_cast<long>(fSocketTimeout));
+        }
+        zmq_pollitem_t item{fSocket, 0, fEvents, 0};
+        zmq_poll(&item, 1, wait);
         return true;
-    } else {
-        return false;
     }
-}
+
+  private:
+    void* fSocket;
+    short fEvents;
+    int fSocketTimeout;
+    int fTimeout;
+    std::chrono::steady_clock::time_point fDeadline;
+};
 
 inline int HandleErrors(const std::string& id)
 {
@@ -82,11 +268,65 @@ inline int HandleErrors(const std::string& id)
         LOG(debug) << "Terminating socket " << id;
         return static_cast<int>(TransferCode::error);
     } else {
-        LOG(error) << "Failed transfer on socket " << id << ", errno: " << errno << ", reason: " << zmq_strerror(errno);
+        FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "Failed transfer on socket " << id << ", errno: " << errno << ", reason: " << zmq_strerror(errno);
         return static_cast<int>(TransferCode::error);
     }
 }
 
+/// Move the next (multipart) message from socket in to socket out frame by frame, without decoding it (as zmq_proxy does).
+/// The receive follows the timeout semantics of Socket::Receive(), a received message is sent with retries
+/// until it is queued, or dropped if the transfer is interrupted meanwhile.
+/// @param frameSize returns the size to be accounted for a frame (data, size)
+/// @param interrupted returns true if the transfer has been interrupted (e.g. by a state change)
+/// @return accounted size of the frames or a (negative) TransferCode
+template<typename FrameSize, typename Interrupted>
+inline int64_t ForwardFrames(void* in, void* out, int socketTimeout, int timeout, const std::string& id, FrameSize frameSize, Interrupted interrupted)
+{
+    int flags = TransferFlags(timeout);
+    const TransferWait wait(in, ZMQ_POLLIN, socketTimeout, timeout);
+    int64_t totalSize = 0;
+    bool first = true;
+
+    zmq_msg_t frame;
+    zmq_msg_init(&frame);
+    while (true) {
+        // the remaining frames of a multipart message are available together with the first one
+        if (zmq_msg_recv(&frame, in, first ? flags : 0) < 0) {
+            int64_t result = 0;
+            if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (interrupted()) {
+                    result = static_cast<int>(TransferCode::interrupted);
+                } else if (!first || wait.Retry()) {
+                    continue;
+                } else {
+                    result = static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                result = HandleErrors(id);
+            }
+            zmq_msg_close(&frame);
+            return result;
+        }
+        first = false;
+        totalSize += frameSize(zmq_msg_data(&frame), zmq_msg_size(&frame));
+        bool more = zmq_msg_more(&frame);
+
+        while (zmq_msg_send(&frame, out, more ? ZMQ_SNDMORE : 0) < 0) {
+            if ((zmq_errno() == EAGAIN || zmq_errno() == EINTR) && !interrupted()) {
+                continue;
+            }
+            int64_t result = interrupted() ? static_cast<int>(TransferCode::interrupted) : HandleErrors(id);
+            zmq_msg_close(&frame);
+            return result;
+        }
+
+        if (!more) {
+            zmq_msg_close(&frame);
+            return totalSize;
+        }
+    }
+}
+
 /// Lookup table for various zmq constants
 inline auto getConstant(std::string_view constant) -> int
 {
@@ -111,6 +351,15 @@ inline auto getConstant(std::string_view constant) -> int
     if (constant == "rcv-more") { return ZMQ_RCVMORE; }
 
     if (constant == "linger") { return ZMQ_LINGER; }
+    if (constant == "rate") { return ZMQ_RATE; }
+    if (constant == "recovery-ivl") { return ZMQ_RECOVERY_IVL; }
+    if (constant == "multicast-hops") { return ZMQ_MULTICAST_HOPS; }
+    if (constant == "immediate") { return ZMQ_IMMEDIATE; }
+#ifdef ZMQ_HEARTBEAT_IVL // ZeroMQ >= 4.2
+    if (constant == "heartbeat-ivl") { return ZMQ_HEARTBEAT_IVL; }
+    if (constant == "heartbeat-timeout") { return ZMQ_HEARTBEAT_TIMEOUT; }
+    if (constant == "heartbeat-ttl") { return ZMQ_HEARTBEAT_TTL; }
+#endif
     if (constant == "no-block") { return ZMQ_DONTWAIT; }
     if (constant == "snd-more no-block") { return ZMQ_DONTWAIT|ZMQ_SNDMORE; }
 
@@ -171,8 +420,9 @@ inline auto makeMonitorSocket(void* zmqCtx, void* socketToMonitor, std::string_v
 }
 
 /// Read pending zmq monitor event in a non-blocking fashion.
+/// @param value if given, receives the event value (the file descriptor for the connection events)
 /// @return event id or -1 for no event pending
-inline auto getMonitorEvent(void* monitorSocket) -> int
+inline auto getMonitorEvent(void* monitorSocket, int* value = nullptr) -> int
 {
     assertm(monitorSocket, "zmq monitor socket exists");   // NOLINT
 
@@ -190,7 +440,12 @@ inline auto getMonitorEvent(void* monitorSocket) -> int
     // Unpack event id
     auto const event = *static_cast<uint16_t*>(zmq_msg_data(&msg));
 
-    // No unpacking of the event value needed for now
+    // Unpack event value
+    if (value) {
+        uint32_t eventValue = 0;
+        std::memcpy(&eventValue, static_cast<char*>(zmq_msg_data(&msg)) + sizeof(uint16_t), sizeof(eventValue));
+        *value = static_cast<int>(eventValue);
+    }
 
     // Second frame in message contains event address
     assertm(zmq_msg_more(&msg), "A second frame is pending");   // NOLINT
@@ -209,19 +464,24 @@ inline auto getMonitorEvent(void* monitorSocket) -> int
 }
 
 /// Compute updated connected peers count by consuming pending events from a zmq monitor socket
+/// @param fds if given, file descriptors of the connections, updated with the events
 /// @return updated connected peers count
-inline auto updateNumberOfConnectedPeers(unsigned long count, void* monitorSocket) -> unsigned long
+inline auto updateNumberOfConnectedPeers(unsigned long count, void* monitorSocket, std::vector<int>* fds = nullptr) -> unsigned long
 {
     if (monitorSocket == nullptr) {
         return count;
     }
 
-    int event = getMonitorEvent(monitorSocket);
+    int fd = -1;
+    int event = getMonitorEvent(monitorSocket, &fd);
     while (event >= 0) {
         switch (event) {
             case ZMQ_EVENT_CONNECTED:
             case ZMQ_EVENT_ACCEPTED:
                 ++count;
+                if (fds) {
+                    fds->push_back(fd);
+                }
                 break;
             case ZMQ_EVENT_DISCONNECTED:
                 if (count > 0) {
@@ -229,15 +489,65 @@ inline auto updateNumberOfConnectedPeers(unsigned long count, void* monitorSocke
                 } else {
                     LOG(warn) << "Computing connected peers would result in negative count! Some event was missed!";
                 }
+                if (fds) {
+                    fds->erase(std::remove(fds->begin(), fds->end(), fd), fds->end());
+                }
                 break;
             default:
                 break;
         }
-        event = getMonitorEvent(monitorSocket);
+        event = getMonitorEvent(monitorSocket, &fd);
     }
     return count;
 }
 
+/// @return largest smoothed round-trip time (in us) of the tcp connections, -1 if there is none (or not on Linux)
+inline int connectionRttUs(const std::vector<int>& fds)
+{
+    int rtt = -1;
+#ifdef __linux__
+    for (int fd : fds) {
+        tcp_info info{};
+        socklen_t size = sizeof(info);
+        // fails for ipc connections (and descriptors closed in the meantime)
+        if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &size) == 0) {
+            rtt = std::max(rtt, static_cast<int>(info.tcpi_rtt));
+        }
+    }
+#else
+    (void)fds;
+#endif
+    return rtt;
+}
+
+/// Bytes in the kernel send and receive queues of the connections (tcp and ipc), i.e. not yet taken by the peer or by
+/// the zmq I/O thread. The pipes of zmq between the I/O thread and the application are not visible.
+inline uint64_t connectionQueuedBytes(const std::vector<int>& fds)
+{
+    uint64_t bytes = 0;
+#ifdef __linux__
+    for (int fd : fds) {
+        int outq = 0;
+        int inq = 0;
+        // fails for descriptors closed in the meantime
+        if (ioctl(fd, SIOCOUTQ, &outq) == 0 && ioctl(fd, SIOCINQ, &inq) == 0) {
+            bytes += static_cast<uint64_t>(std::max(outq, 0)) + static_cast<uint64_t>(std::max(inq, 0));
+        }
+    }
+#else
+    (void)fds;
+#endif
+    return bytes;
+}
+
+/// Set the kernel buffer size (SO_SNDBUF/SO_RCVBUF) of the established connections, ZMQ_SNDBUF/ZMQ_RCVBUF only apply to new ones
+inline void setConnectionKernelSize(const std::vector<int>& fds, int option, int value)
+{
+    for (int fd : fds) {
+        setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value));
+    }
+}
+
 } // namespace fair::mq::zmq
 
 #endif /* FAIR_MQ_ZMQ_COMMON_H */
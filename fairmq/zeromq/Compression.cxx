@@ -0,0 +1,355 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/zeromq/Compression.h>
+
+#include <fairmq/Socket.h> // SocketError
+#include <fairmq/tools/Strings.h>
+
+#ifdef FAIRMQ_WITH_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef FAIRMQ_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <chrono>
+#include <cstring> // memcpy, memmove
+#include <memory>
+
+using namespace std;
+
+namespace fair::mq::zmq
+{
+
+namespace
+{
+
+#ifdef FAIRMQ_WITH_ZSTD
+// zstd contexts are reused per thread, creating one costs more than compressing a small block
+struct ZstdContexts
+{
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    ~ZstdContexts()
+    {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+};
+
+ZstdContexts& ThreadZstdContexts()
+{
+    thread_local ZstdContexts contexts;
+    return contexts;
+}
+#endif
+
+uint64_t NsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+Compressor::Codec Compressor::ParseCodec(const string& name)
+{
+    if (name == "none") {
+        return Codec::none;
+    } else if (name == "lz4") {
+        return Codec::lz4;
+    } else if (name == "zstd") {
+        return Codec::zstd;
+    }
+    throw SocketError(tools::ToString("unknown compression codec '", name, "', valid are 'none', 'lz4' and 'zstd'"));
+}
+
+const char* Compressor::CodecName(Codec codec)
+{
+    switch (codec) {
+        case Codec::lz4: return "lz4";
+        case Codec::zstd: return "zstd";
+        default: return "none";
+    }
+}
+
+bool Compressor::Available(Codec codec)
+{
+    switch (codec) {
+#ifdef FAIRMQ_WITH_LZ4
+        case Codec::lz4: return true;
+#endif
+#ifdef FAIRMQ_WITH_ZSTD
+        case Codec::zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+Compressor::Compressor(Codec codec, int level, int threads, size_t minSize)
+    : fCodec(codec)
+    , fLevel(level)
+    , fMinSize(minSize)
+    , fBatch(nullptr)
+    , fGeneration(0)
+    , fStop(false)
+    , fRawTx(0)
+    , fWireTx(0)
+    , fRawRx(0)
+    , fWireRx(0)
+    , fCompressNs(0)
+    , fDecompressNs(0)
+{
+    if (!Available(codec)) {
+        throw SocketError(tools::ToString("compression codec '", CodecName(codec), "' is not available, build FairMQ with -DBUILD_COMPRESSION=ON and ", CodecName(codec)));
+    }
+    for (int i = 1; i < threads; ++i) {
+        fThreads.emplace_back(&Compressor::Worker, this);
+    }
+}
+
+Compressor::~Compressor()
+{
+    {
+        lock_guard<mutex> lock(fMtx);
+        fStop = true;
+    }
+    fCV.notify_all();
+    for (auto& thread : fThreads) {
+        thread.join();
+    }
+}
+
+size_t Compressor::BlockBound(size_t size) const
+{
+    switch (fCodec) {
+#ifdef FAIRMQ_WITH_LZ4
+        case Codec::lz4: return LZ4_compressBound(static_cast<int>(size));
+#endif
+#ifdef FAIRMQ_WITH_ZSTD
+        case Codec::zstd: return ZSTD_compressBound(size);
+#endif
+        default: return size;
+    }
+}
+
+size_t Compressor::FrameBound(size_t size) const
+{
+    const size_t numBlocks = NumBlocks(size);
+    if (numBlocks == 0) {
+        return HeaderSize(0);
+    }
+    return HeaderSize(numBlocks) + (numBlocks - 1) * BlockBound(kBlockSize) + BlockBound(size - (numBlocks - 1) * kBlockSize);
+}
+
+size_t Compressor::CompressBlock(const char* src, size_t size, char* dst, size_t capacity) const
+{
+    switch (fCodec) {
+#ifdef FAIRMQ_WITH_LZ4
+        case Codec::lz4: {
+            int result = fLevel > 0 ? LZ4_compress_HC(src, dst, static_cast<int>(size), static_cast<int>(capacity), fLevel)
+                                    : LZ4_compress_default(src, dst, static_cast<int>(size), static_cast<int>(capacity));
+            return result > 0 ? result : 0;
+        }
+#endif
+#ifdef FAIRMQ_WITH_ZSTD
+        case Codec::zstd: {
+            size_t result = ZSTD_compressCCtx(ThreadZstdContexts().cctx, dst, capacity, src, size, fLevel != 0 ? fLevel : ZSTD_CLEVEL_DEFAULT);
+            return ZSTD_isError(result) ? 0 : result;
+        }
+#endif
+        default:
+            (void)src; (void)size; (void)dst; (void)capacity;
+            return 0;
+    }
+}
+
+bool Compressor::DecompressBlock(Codec codec, const char* src, size_t size, char* dst, size_t rawSize)
+{
+    switch (codec) {
+#ifdef FAIRMQ_WITH_LZ4
+        case Codec::lz4:
+            return LZ4_decompress_safe(src, dst, static_cast<int>(size), static_cast<int>(rawSize)) == static_cast<int>(rawSize);
+#endif
+#ifdef FAIRMQ_WITH_ZSTD
+        case Codec::zstd:
+            return ZSTD_decompressDCtx(ThreadZstdContexts().dctx, dst, rawSize, src, size) == rawSize;
+#endif
+        default:
+            (void)src; (void)size; (void)dst; (void)rawSize;
+            return false;
+    }
+}
+
+void Compressor::Compress(vector<CompressJob>& jobs)
+{
+    // every block is compressed into its own slot of the frame, the blocks are moved together afterwards
+    struct Block
+    {
+        size_t fJob;
+        size_t fIndex;
+        size_t fSlot;
+        size_t fCompressed;
+    };
+    vector<Block> blocks;
+    const size_t slotSize = BlockBound(kBlockSize);
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const size_t numBlocks = NumBlocks(jobs[j].fSize);
+        for (size_t b = 0; b < numBlocks; ++b) {
+            blocks.push_back(Block{j, b, HeaderSize(numBlocks) + b * slotSize, 0});
+        }
+    }
+
+    Run(blocks.size(), [&](size_t i) {
+        Block& block = blocks[i];
+        const CompressJob& job = jobs[block.fJob];
+        const size_t offset = block.fIndex * kBlockSize;
+        const size_t size = min(kBlockSize, job.fSize - offset);
+        auto start = chrono::steady_clock::now();
+        block.fCompressed = CompressBlock(static_cast<const char*>(job.fSrc) + offset, size, job.fDst + block.fSlot, BlockBound(size));
+        fCompressNs.fetch_add(NsSince(start), memory_order_relaxed);
+    });
+
+    size_t b = 0;
+    for (auto& job : jobs) {
+        const size_t numBlocks = NumBlocks(job.fSize);
+        const uint32_t count = numBlocks;
+        memcpy(job.fDst, &count, sizeof(count));
+        size_t frameSize = HeaderSize(numBlocks);
+        bool failed = false;
+        for (size_t n = 0; n < numBlocks; ++n, ++b) {
+            const uint32_t compressed = blocks[b].fCompressed;
+            failed = failed || compressed == 0;
+            memcpy(job.fDst + sizeof(uint32_t) * (1 + n), &compressed, sizeof(compressed));
+            if (!failed && blocks[b].fSlot != frameSize) {
+                memmove(job.fDst + frameSize, job.fDst + blocks[b].fSlot, compressed);
+            }
+            frameSize += compressed;
+        }
+        // incompressible payloads are sent as they are
+        job.fResult = (failed || frameSize >= job.fSize) ? 0 : frameSize;
+        Add(fRawTx, job.fSize);
+        Add(fWireTx, job.fResult > 0 ? job.fResult : job.fSize);
+    }
+}
+
+bool Compressor::Decompress(vector<DecompressJob>& jobs)
+{
+    struct Block
+    {
+        size_t fJob;
+        size_t fIndex;
+        size_t fOffset; // in the frame
+        size_t fSize;
+    };
+    vector<Block> blocks;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const DecompressJob& job = jobs[j];
+        const size_t numBlocks = NumBlocks(job.fRawSize);
+        uint32_t count = 0;
+        if (job.fSize < HeaderSize(numBlocks) || (memcpy(&count, job.fSrc, sizeof(count)), count != numBlocks)) {
+            return false;
+        }
+        size_t offset = HeaderSize(numBlocks);
+        for (size_t b = 0; b < numBlocks; ++b) {
+            uint32_t size = 0;
+            memcpy(&size, job.fSrc + sizeof(uint32_t) * (1 + b), sizeof(size));
+            blocks.push_back(Block{j, b, offset, size});
+            offset += size;
+        }
+        if (offset != job.fSize) {
+            return false;
+        }
+    }
+
+    atomic<bool> ok(true);
+    Run(blocks.size(), [&](size_t i) {
+        const Block& block = blocks[i];
+        const DecompressJob& job = jobs[block.fJob];
+        const size_t offset = block.fIndex * kBlockSize;
+        auto start = chrono::steady_clock::now();
+        if (!DecompressBlock(job.fCodec, job.fSrc + block.fOffset, block.fSize, static_cast<char*>(job.fDst) + offset, min(kBlockSize, job.fRawSize - offset))) {
+            ok.store(false, memory_order_relaxed);
+        }
+        fDecompressNs.fetch_add(NsSince(start), memory_order_relaxed);
+    });
+
+    for (const auto& job : jobs) {
+        Add(fRawRx, job.fRawSize);
+        Add(fWireRx, job.fSize);
+    }
+    return ok.load(memory_order_relaxed);
+}
+
+void Compressor::GetMetrics(ChannelMetrics& metrics) const
+{
+    metrics.compressed = true;
+    metrics.rawBytesTx = fRawTx.load(memory_order_relaxed);
+    metrics.wireBytesTx = fWireTx.load(memory_order_relaxed);
+    metrics.rawBytesRx = fRawRx.load(memory_order_relaxed);
+    metrics.wireBytesRx = fWireRx.load(memory_order_relaxed);
+    metrics.compressNs = fCompressNs.load(memory_order_relaxed);
+    metrics.decompressNs = fDecompressNs.load(memory_order_relaxed);
+}
+
+void Compressor::Run(size_t numTasks, const function<void(size_t)>& task)
+{
+    if (fThreads.empty() || numTasks < 2) {
+        for (size_t i = 0; i < numTasks; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.fTask = &task;
+    batch.fNumTasks = numTasks;
+    unique_lock<mutex> lock(fMtx);
+    fBatch = &batch;
+    ++fGeneration;
+    lock.unlock();
+    fCV.notify_all();
+
+    Claim(batch);
+
+    // all tasks are claimed, wait for the codec threads to finish theirs
+    lock.lock();
+    fBatch = nullptr;
+    fDoneCV.wait(lock, [&] { return batch.fActive == 0; });
+}
+
+void Compressor::Claim(Batch& batch)
+{
+    for (size_t i = batch.fNext.fetch_add(1, memory_order_relaxed); i < batch.fNumTasks; i = batch.fNext.fetch_add(1, memory_order_relaxed)) {
+        (*batch.fTask)(i);
+    }
+}
+
+void Compressor::Worker()
+{
+    uint64_t seen = 0;
+    unique_lock<mutex> lock(fMtx);
+    while (true) {
+        fCV.wait(lock, [&] { return fStop || (fBatch && fGeneration != seen); });
+        if (fStop) {
+            return;
+        }
+        seen = fGeneration;
+        Batch& batch = *fBatch;
+        ++batch.fActive;
+        lock.unlock();
+        Claim(batch);
+        lock.lock();
+        if (--batch.fActive == 0) {
+            fDoneCV.notify_all();
+        }
+    }
+}
+
+} // namespace fair::mq::zmq
@@ -0,0 +1,140 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_ZMQ_COMPRESSION_H
+#define FAIR_MQ_ZMQ_COMPRESSION_H
+
+#include <fairmq/ChannelMetrics.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fair::mq::zmq
+{
+
+/// Payload compression of the zeromq sockets (channel property compression), built with -DBUILD_COMPRESSION=ON.
+///
+/// A payload is split into blocks of kBlockSize bytes that are compressed independently, so that the blocks of large
+/// payloads and the parts of a multipart message are (de)compressed in parallel by the codec threads, the calling
+/// thread included. Compressed frame: uint32 number of blocks, uint32 compressed size of every block, the blocks.
+class Compressor
+{
+  public:
+    enum class Codec : uint8_t
+    {
+        none = 0,
+        lz4 = 1,
+        zstd = 2
+    };
+
+    static constexpr size_t kBlockSize = 1 << 20;
+
+    /// @throw SocketError for an unknown codec
+    static Codec ParseCodec(const std::string& name);
+    static const char* CodecName(Codec codec);
+    /// @return true if the library was built with the codec
+    static bool Available(Codec codec);
+
+    /// @param threads number of threads compressing a message, including the calling thread
+    /// @throw SocketError if the codec is not available
+    Compressor(Codec codec, int level, int threads, size_t minSize);
+    Compressor(const Compressor&) = delete;
+    Compressor(Compressor&&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+    Compressor& operator=(Compressor&&) = delete;
+    ~Compressor();
+
+    Codec GetCodec() const { return fCodec; }
+
+    /// @return true if a payload of the given size is compressed
+    bool Compresses(size_t size) const { return size >= fMinSize && size > 0; }
+    /// @return maximum size of the compressed frame of a payload
+    size_t FrameBound(size_t size) const;
+
+    struct CompressJob
+    {
+        const void* fSrc;
+        size_t fSize;
+        char* fDst;        ///< frame buffer of at least FrameBound(fSize) bytes
+        size_t fResult;    ///< compressed frame size, 0 if the payload did not get smaller (to be sent as it is)
+    };
+
+    struct DecompressJob
+    {
+        const char* fSrc;  ///< compressed frame
+        size_t fSize;
+        Codec fCodec;      ///< codec of the sender
+        void* fDst;        ///< payload buffer of fRawSize bytes
+        size_t fRawSize;
+    };
+
+    /// Compress the payloads in parallel
+    void Compress(std::vector<CompressJob>& jobs);
+    /// Decompress the frames in parallel
+    /// @return false if a frame is corrupt
+    bool Decompress(std::vector<DecompressJob>& jobs);
+
+    /// Count payloads that are transferred uncompressed (below the minimum size)
+    void CountTx(size_t size) { Add(fRawTx, size); Add(fWireTx, size); }
+    void CountRx(size_t size) { Add(fRawRx, size); Add(fWireRx, size); }
+
+    void GetMetrics(ChannelMetrics& metrics) const;
+
+  private:
+    // tasks of one Compress/Decompress call, claimed by the codec threads and the calling thread
+    struct Batch
+    {
+        const std::function<void(size_t)>* fTask;
+        size_t fNumTasks;
+        std::atomic<size_t> fNext{0};
+        size_t fActive = 0; // codec threads working on the batch
+    };
+
+    static size_t NumBlocks(size_t size) { return (size + kBlockSize - 1) / kBlockSize; }
+    static size_t HeaderSize(size_t numBlocks) { return sizeof(uint32_t) * (1 + numBlocks); }
+    size_t BlockBound(size_t size) const;
+    /// @return compressed size, 0 on failure
+    size_t CompressBlock(const char* src, size_t size, char* dst, size_t capacity) const;
+    static bool DecompressBlock(Codec codec, const char* src, size_t size, char* dst, size_t rawSize);
+
+    void Run(size_t numTasks, const std::function<void(size_t)>& task);
+    void Claim(Batch& batch);
+    void Worker();
+    // the counters are only written by the thread using the socket, but read by any thread
+    static void Add(std::atomic<uint64_t>& counter, uint64_t n) { counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+    Codec fCodec;
+    int fLevel;
+    size_t fMinSize;
+
+    std::mutex fMtx;
+    std::condition_variable fCV;     // new batch or stop, for the codec threads
+    std::condition_variable fDoneCV; // codec threads left a batch
+    Batch* fBatch;
+    uint64_t fGeneration;
+    bool fStop;
+    std::vector<std::thread> fThreads;
+
+    std::atomic<uint64_t> fRawTx;
+    std::atomic<uint64_t> fWireTx;
+    std::atomic<uint64_t> fRawRx;
+    std::atomic<uint64_t> fWireRx;
+    std::atomic<uint64_t> fCompressNs;
+    std::atomic<uint64_t> fDecompressNs;
+};
+
+} // namespace fair::mq::zmq
+
+#endif /* FAIR_MQ_ZMQ_COMPRESSION_H */
@@ -10,6 +10,7 @@
 #define FAIR_MQ_ZMQ_CONTEXT_H_
 
 #include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Threads.h>
 #include <fairmq/UnmanagedRegion.h>
 
 #include <fairlogger/Logger.h>
@@ -17,6 +18,7 @@
 #include <zmq.h>
 
 #include <atomic>
+#include <cstring> // strerror
 #include <condition_variable>
 #include <functional>
 #include <mutex>
@@ -95,6 +97,7 @@ class Context
 
     void RegionEventsSubscription()
     {
+        ApplyThreadSettings("region events thread");
         std::unique_lock<std::mutex> lock(fMtx);
         while (fRegionEventsSubscriptionActive) {
             while (!fRegionEvents.empty()) {
@@ -154,6 +157,17 @@ class Context
 
     void* GetZmqCtx() { return fZmqCtx; }
 
+    /// CPU affinity and scheduling of the threads of the transport (other than the zeromq I/O threads),
+    /// to be set before they are started
+    void SetThreadSettings(tools::ThreadSettings settings) { fThreadSettings = std::move(settings); }
+    /// apply the thread settings to the calling transport thread
+    void ApplyThreadSettings(const char* thread) const
+    {
+        if (!fThreadSettings.Empty() && !tools::ApplyThreadSettings(fThreadSettings)) {
+            LOG(warn) << "Could not apply the CPU affinity/scheduling settings to the zeromq " << thread << ": " << strerror(errno);
+        }
+    }
+
     ~Context()
     {
         UnsubscribeFromRegionEvents();
@@ -187,6 +201,7 @@ class Context
     std::thread fRegionEventThread;
     std::function<void(RegionInfo)> fRegionEventCallback;
     bool fRegionEventsSubscriptionActive;
+    tools::ThreadSettings fThreadSettings;
 };
 
 } // namespace fair::mq::zmq
@@ -0,0 +1,203 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_ZMQ_EPOLLSET_H
+#define FAIR_MQ_ZMQ_EPOLLSET_H
+
+#include <fairlogger/Logger.h>
+#include <fairmq/Poller.h>
+#include <fairmq/tools/Strings.h>
+
+#include <sys/epoll.h>
+#include <unistd.h> // close
+
+#include <zmq.h>
+
+#include <algorithm> // sort, unique
+#include <cerrno>
+#include <chrono>
+#include <cstring> // strerror
+#include <string>
+#include <vector>
+
+namespace fair::mq::zmq
+{
+
+/// @param backend value of --zmq-poller: "zmq_poll" or "epoll"
+/// @return true if the pollers use an EpollSet
+inline bool ParsePollerBackend(const std::string& backend)
+{
+    if (backend != "zmq_poll" && backend != "epoll") {
+        LOG(error) << "Invalid poller backend '" << backend << "', valid are 'zmq_poll' and 'epoll'";
+        throw fair::mq::PollerError(fair::mq::tools::ToString("Invalid poller backend '", backend, "', valid are 'zmq_poll' and 'epoll'"));
+    }
+    return backend == "epoll";
+}
+
+/// Polls zeromq sockets via their ZMQ_FD with epoll and keeps the list of ready poll items,
+/// so that a wakeup costs O(ready items) instead of O(all items) as with zmq_poll.
+///
+/// ZMQ_FD only signals that the socket state may have changed (edge-like), the actual state is read with ZMQ_EVENTS.
+/// Items that were ready after the previous poll are therefore checked again (they may have more messages queued),
+/// as are items polled for output, whose state changes with the own sends without a signal on ZMQ_FD.
+class EpollSet
+{
+  public:
+    EpollSet() = default;
+    EpollSet(const EpollSet&) = delete;
+    EpollSet(EpollSet&&) = delete;
+    EpollSet& operator=(const EpollSet&) = delete;
+    EpollSet& operator=(EpollSet&&) = delete;
+
+    void Init(zmq_pollitem_t* items, int numItems)
+    {
+        fEpollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (fEpollFd < 0) {
+            LOG(error) << "failed creating epoll instance, reason: " << strerror(errno);
+            throw fair::mq::PollerError(fair::mq::tools::ToString("Failed creating epoll instance, reason: ", strerror(errno)));
+        }
+        for (int i = 0; i < numItems; ++i) {
+            int fd = -1;
+            size_t size = sizeof(fd);
+            if (zmq_getsockopt(items[i].socket, ZMQ_FD, &fd, &size) != 0) {
+                LOG(error) << "failed getting ZMQ_FD of poll item " << i << ", reason: " << zmq_strerror(errno);
+                throw fair::mq::PollerError(fair::mq::tools::ToString("Failed getting ZMQ_FD of poll item ", i, ", reason: ", zmq_strerror(errno)));
+            }
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u32 = i;
+            if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                LOG(error) << "failed adding poll item " << i << " to epoll, reason: " << strerror(errno);
+                throw fair::mq::PollerError(fair::mq::tools::ToString("Failed adding poll item ", i, " to epoll, reason: ", strerror(errno)));
+            }
+            if (items[i].events & ZMQ_POLLOUT) {
+                fAlwaysCheck.push_back(i);
+            }
+            items[i].revents = 0;
+        }
+        fEvents.resize(numItems + 1);
+    }
+
+    /// Poll() returns while fd is readable (level-triggered), see Poller::AddWakeup()
+    void AddWakeup(int fd)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u32 = kWakeupItem;
+        if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            LOG(error) << "failed adding wakeup fd to epoll, reason: " << strerror(errno);
+            throw fair::mq::PollerError(fair::mq::tools::ToString("Failed adding wakeup fd to epoll, reason: ", strerror(errno)));
+        }
+    }
+
+    /// Wait until at least one item is ready or the timeout (in milliseconds, -1: infinite) expires.
+    /// Sets the revents of the ready items (and resets those of previously ready ones).
+    void Poll(zmq_pollitem_t* items, int timeout)
+    {
+        // items that remain ready are found via fCandidates
+        fCandidates.assign(fAlwaysCheck.begin(), fAlwaysCheck.end());
+        for (int i : fReady) {
+            items[i].revents = 0;
+            fCandidates.push_back(i);
+        }
+        fReady.clear();
+
+        auto start = std::chrono::steady_clock::now();
+        int wait = 0; // first collect pending signals without blocking
+        bool woken = false;
+        while (true) {
+            int numEvents = epoll_wait(fEpollFd, fEvents.data(), fEvents.size(), wait);
+            if (numEvents < 0) {
+                if (errno != EINTR) {
+                    LOG(error) << "polling failed, reason: " << strerror(errno);
+                    throw fair::mq::PollerError(fair::mq::tools::ToString("Polling failed, reason: ", strerror(errno)));
+                }
+                LOG(debug) << "polling interrupted by system call";
+                numEvents = 0;
+            }
+            for (int e = 0; e < numEvents; ++e) {
+                if (fEvents[e].data.u32 == kWakeupItem) {
+                    woken = true;
+                } else {
+                    fCandidates.push_back(fEvents[e].data.u32);
+                }
+            }
+            if (!Check(items)) {
+                return; // context terminated
+            }
+            if (!fReady.empty() || timeout == 0 || woken) {
+                return;
+            }
+            if (timeout > 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                if (elapsed >= timeout) {
+                    return;
+                }
+                wait = timeout - static_cast<int>(elapsed);
+            } else {
+                wait = -1;
+            }
+            fCandidates.assign(fAlwaysCheck.begin(), fAlwaysCheck.end());
+        }
+    }
+
+    /// Fill indices with the items that have input after the last Poll(), in ascending order
+    void ReadyInputs(const zmq_pollitem_t* items, std::vector<int>& indices) const
+    {
+        indices.clear();
+        for (int i : fReady) {
+            if (items[i].revents & ZMQ_POLLIN) {
+                indices.push_back(i);
+            }
+        }
+    }
+
+    ~EpollSet()
+    {
+        if (fEpollFd >= 0) {
+            close(fEpollFd);
+        }
+    }
+
+  private:
+    // read ZMQ_EVENTS of the candidates, @return false if the context has been terminated
+    bool Check(zmq_pollitem_t* items)
+    {
+        std::sort(fCandidates.begin(), fCandidates.end());
+        fCandidates.erase(std::unique(fCandidates.begin(), fCandidates.end()), fCandidates.end());
+        for (int i : fCandidates) {
+            int events = 0;
+            size_t size = sizeof(events);
+            if (zmq_getsockopt(items[i].socket, ZMQ_EVENTS, &events, &size) != 0) {
+                if (errno == ETERM) {
+                    LOG(debug) << "polling exited, reason: " << zmq_strerror(errno);
+                    return false;
+                }
+                LOG(error) << "polling failed, reason: " << zmq_strerror(errno);
+                throw fair::mq::PollerError(fair::mq::tools::ToString("Polling failed, reason: ", zmq_strerror(errno)));
+            }
+            items[i].revents = static_cast<short>(events & items[i].events);
+            if (items[i].revents != 0) {
+                fReady.push_back(i);
+            }
+        }
+        return true;
+    }
+
+    static constexpr uint32_t kWakeupItem = 0xffffffff;
+
+    int fEpollFd = -1;
+    std::vector<epoll_event> fEvents;
+    std::vector<int> fAlwaysCheck; // items polled for output
+    std::vector<int> fCandidates;
+    std::vector<int> fReady; // items with revents != 0, ascending
+};
+
+} // namespace fair::mq::zmq
+
+#endif /* FAIR_MQ_ZMQ_EPOLLSET_H */
@@ -9,20 +9,24 @@
 #ifndef FAIR_MQ_ZMQ_MESSAGE_H
 #define FAIR_MQ_ZMQ_MESSAGE_H
 
+#include <fairmq/zeromq/MessagePool.h>
 #include <fairmq/zeromq/UnmanagedRegion.h>
 #include <fairmq/Message.h>
 #include <fairmq/UnmanagedRegion.h>
+#include <fairmq/tools/Copy.h>
 
 #include <fairlogger/Logger.h>
 
 #include <zmq.h>
 
+#include <algorithm> // min
 #include <cstddef>
 #include <cstdlib> // malloc
 #include <cstring>
-#include <memory> // make_unique
+#include <memory> // make_unique, shared_ptr
 #include <new> // bad_alloc
 #include <string>
+#include <utility> // swap
 
 namespace fair::mq::zmq
 {
@@ -39,31 +43,46 @@ class Message final : public fair::mq::Message
     Message& operator=(const Message&) = delete;
     Message& operator=(Message&&) = delete;
 
-    Message(fair::mq::TransportFactory* factory = nullptr)
+    Message(fair::mq::TransportFactory* factory = nullptr, MessagePool* pool = nullptr)
         : fair::mq::Message(factory)
         , fMsg(std::make_unique<zmq_msg_t>())
+        , fPool(pool)
     {
         if (zmq_msg_init(fMsg.get()) != 0) {
             LOG(error) << "failed initializing message, reason: " << zmq_strerror(errno);
         }
     }
 
-    Message(Alignment alignment, fair::mq::TransportFactory* factory = nullptr)
+    Message(Alignment alignment, fair::mq::TransportFactory* factory = nullptr, MessagePool* pool = nullptr)
         : fair::mq::Message(factory)
         , fAlignment(alignment.alignment)
         , fMsg(std::make_unique<zmq_msg_t>())
+        , fPool(pool)
     {
         if (zmq_msg_init(fMsg.get()) != 0) {
             LOG(error) << "failed initializing message, reason: " << zmq_strerror(errno);
         }
     }
 
-    Message(const size_t size, fair::mq::TransportFactory* factory = nullptr)
+    Message(const size_t size, fair::mq::TransportFactory* factory = nullptr, MessagePool* pool = nullptr)
         : fair::mq::Message(factory)
         , fMsg(std::make_unique<zmq_msg_t>())
+        , fPool(pool)
     {
-        if (zmq_msg_init_size(fMsg.get(), size) != 0) {
-            LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
+        InitSize(size);
+    }
+
+    // the buffer is allocated with the headroom in front, fMsg is a view of it that starts after the headroom
+    Message(const size_t size, Headroom headroom, fair::mq::TransportFactory* factory = nullptr, MessagePool* pool = nullptr)
+        : fair::mq::Message(factory)
+        , fMsg(std::make_unique<zmq_msg_t>())
+        , fPool(pool)
+    {
+        InitSize(headroom.headroom + size);
+        if (headroom.headroom > 0 && zmq_msg_size(fMsg.get()) == headroom.headroom + size) {
+            if (View(headroom.headroom, size)) {
+                fHeadroom = headroom.headroom;
+            }
         }
     }
 
@@ -81,16 +100,14 @@ class Message final : public fair::mq::Message
         return {static_cast<void*>(fullBufferPtr), static_cast<void*>(alignedPartPtr)};
     }
 
-    Message(const size_t size, Alignment alignment, fair::mq::TransportFactory* factory = nullptr)
+    Message(const size_t size, Alignment alignment, fair::mq::TransportFactory* factory = nullptr, MessagePool* pool = nullptr)
         : fair::mq::Message(factory)
         , fAlignment(alignment.alignment)
         , fMsg(std::make_unique<zmq_msg_t>())
+        , fPool(pool)
     {
         if (fAlignment != 0) {
-            auto ptrs = AllocateAligned(size, fAlignment);
-            if (zmq_msg_init_data(fMsg.get(), ptrs.second, size, [](void* /* data */, void* hint) { free(hint); }, ptrs.first) != 0) {
-                LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
-            }
+            InitAligned(size);
         } else {
             if (zmq_msg_init_size(fMsg.get(), size) != 0) {
                 LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
@@ -116,27 +133,20 @@ class Message final : public fair::mq::Message
             throw TransportError(tools::ToString("region type (", region->GetType(), ") does not match message type (", GetType(), ")"));
         }
 
-        // FIXME: make this zero-copy:
-        // simply taking over the provided buffer can casue premature delete, since region could be
-        // destroyed before the message is sent out. Needs lifetime extension for the ZMQ region.
-        if (zmq_msg_init_size(fMsg.get(), size) != 0) {
-            LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
-        }
-
-        std::memcpy(zmq_msg_data(fMsg.get()), data, size);
-        // call region callback
-        auto ptr = static_cast<UnmanagedRegion*>(region.get());
-        if (ptr->fBulkCallback) {
-            ptr->fBulkCallback({{data, size, hint}});
-        } else if (ptr->fCallback) {
-            ptr->fCallback(data, size, hint);
+        // zero-copy: zeromq refers to the region buffer until the message is sent (or closed),
+        // the shared region state keeps the memory valid even if the region object is destroyed earlier.
+        // The block is acknowledged to the region owner by the region ack thread, in bulk with other released blocks.
+        auto release = new RegionRelease{static_cast<UnmanagedRegion*>(region.get())->fState, {data, size, hint}};
+        release->fState->Acquire();
+        if (zmq_msg_init_data(fMsg.get(), data, size, [](void* /* data */, void* obj) {
+                auto r = static_cast<RegionRelease*>(obj);
+                r->fState->Release(r->fBlock);
+                delete r;
+            }, release) != 0) {
+            LOG(error) << "failed initializing message with data, reason: " << zmq_strerror(errno);
+            release->fState->Release(release->fBlock);
+            delete release;
         }
-
-        // if (zmq_msg_init_data(fMsg.get(), data, size, [](void*, void*){}, nullptr) != 0)
-        // {
-        //     LOG(error) << "failed initializing message with data, reason: " <<
-        //     zmq_strerror(errno);
-        // }
     }
 
     void Rebuild() override
@@ -162,9 +172,7 @@ class Message final : public fair::mq::Message
     {
         CloseMessage();
         fMsg = std::make_unique<zmq_msg_t>();
-        if (zmq_msg_init_size(fMsg.get(), size) != 0) {
-            LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
-        }
+        InitSize(size);
     }
 
     void Rebuild(size_t size, Alignment alignment) override
@@ -174,14 +182,9 @@ class Message final : public fair::mq::Message
         fMsg = std::make_unique<zmq_msg_t>();
 
         if (fAlignment != 0) {
-            auto ptrs = AllocateAligned(size, fAlignment);
-            if (zmq_msg_init_data(fMsg.get(), ptrs.second, size, [](void* /* data */, void* hint) { free(hint); }, ptrs.first) != 0) {
-                LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
-            }
+            InitAligned(size);
         } else {
-            if (zmq_msg_init_size(fMsg.get(), size) != 0) {
-                LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
-            }
+            InitSize(size);
         }
     }
 
@@ -219,19 +222,44 @@ class Message final : public fair::mq::Message
             LOG(error) << "cannot set used size higher than original.";
             return false;
         } else {
-            auto newMsg = std::make_unique<zmq_msg_t>();
-            void* data = GetData();
-            if (zmq_msg_init_data(newMsg.get(), data, size, [](void* /* data */, void* obj) {
-                    zmq_msg_close(static_cast<zmq_msg_t*>(obj));
-                    delete static_cast<zmq_msg_t*>(obj);
-                }, fMsg.get()) != 0) {
-                LOG(error) << "failed initializing message with data, reason: " << zmq_strerror(errno);
-                return false;
-            }
-            fMsg.release();
-            fMsg.swap(newMsg);
+            return View(0, size);
+        }
+    }
+
+    // the view is re-created in front of the current one, the headroom in front of the data is part of the same buffer
+    bool Prepend(size_t n) override
+    {
+        if (n > fHeadroom) {
+            return false;
+        } else if (n == 0) {
             return true;
         }
+        if (!View(-static_cast<ptrdiff_t>(n), GetSize() + n)) {
+            return false;
+        }
+        fHeadroom -= n;
+        return true;
+    }
+
+    size_t GetHeadroom() const override { return fHeadroom; }
+
+    // zeromq buffers cannot be expanded, the content is copied into a new buffer (from the payload pool, if enabled)
+    bool Grow(size_t newSize) override
+    {
+        if (newSize <= GetSize()) {
+            return true;
+        }
+        return Reallocate(newSize);
+    }
+
+    // copies share the buffer with a reference count (ZMQ_SHARED), views (slices, shrunk messages) may share it with
+    // the messages they were created from
+    bool MakeWritable() override
+    {
+        if (GetSize() == 0 || (!fSharedBuffer && !zmq_msg_get(fMsg.get(), ZMQ_SHARED))) {
+            return true;
+        }
+        return Reallocate(GetSize());
     }
 
     void Realign()
@@ -241,12 +269,17 @@ class Message final : public fair::mq::Message
             void* data = GetData();
             size_t size = GetSize();
             // if buffer is valid && not already aligned with the given alignment
-            if (data != nullptr && reinterpret_cast<uintptr_t>(GetData()) % fAlignment) {
-                // create new aligned buffer
-                auto ptrs = AllocateAligned(size, fAlignment);
-                std::memcpy(ptrs.second, zmq_msg_data(fMsg.get()), size);
-                // rebuild the message with the new buffer
-                Rebuild(ptrs.second, size, [](void* /* buf */, void* hint) { free(hint); }, ptrs.first);
+            if (data != nullptr && reinterpret_cast<uintptr_t>(data) % fAlignment) {
+                // zeromq allocates received payloads itself (without an allocator hook),
+                // so a misaligned payload is copied once into an aligned buffer.
+                // With the payload pool the aligned buffers are recycled instead of allocated per message.
+                auto received = std::make_unique<zmq_msg_t>();
+                std::swap(fMsg, received);
+                InitAligned(size);
+                tools::CopyPayload(zmq_msg_data(fMsg.get()), data, size);
+                if (zmq_msg_close(received.get()) != 0) {
+                    LOG(error) << "failed closing message, reason: " << zmq_strerror(errno);
+                }
             }
         }
     }
@@ -263,13 +296,141 @@ class Message final : public fair::mq::Message
         }
     }
 
+    // Like the view message of SetUsedSize: the slice points into a copy of fMsg (zmq_msg_copy shares the buffer),
+    // which is closed when the slice is released.
+    fair::mq::MessagePtr Slice(size_t offset, size_t size) override
+    {
+        if (offset + size > GetSize() || offset + size < offset) {
+            throw MessageError(tools::ToString("slice [", offset, ", ", offset + size, ") is out of the range of the message (size ", GetSize(), ")"));
+        }
+        auto slice = std::make_unique<Message>(GetTransport(), fPool);
+        if (size == 0) {
+            return slice;
+        }
+        auto shared = std::make_unique<zmq_msg_t>();
+        zmq_msg_init(shared.get());
+        if (zmq_msg_copy(shared.get(), fMsg.get()) != 0) {
+            LOG(error) << "failed copying message, reason: " << zmq_strerror(errno);
+            return nullptr;
+        }
+        char* data = static_cast<char*>(zmq_msg_data(shared.get())) + offset;
+        slice->Rebuild(data, size, &CloseViewed, shared.release());
+        slice->fSharedBuffer = true;
+        return slice;
+    }
+
     ~Message() override { CloseMessage(); }
 
   private:
+    // region block referred to by a zeromq message, released by the zeromq free function
+    struct RegionRelease
+    {
+        std::shared_ptr<RegionState> fState;
+        RegionBlock fBlock;
+    };
+
     size_t fAlignment = 0;
+    size_t fHeadroom = 0; // bytes in front of the data of fMsg that belong to its buffer (see Prepend)
+    bool fSharedBuffer = false; // fMsg is a view of a buffer that may be shared with other messages (see MakeWritable)
     std::unique_ptr<zmq_msg_t> fMsg;
+    MessagePool* fPool = nullptr; // payload pool of the transport factory, if enabled
 
     zmq_msg_t* GetMessage() const { return fMsg.get(); }
+    // the sockets move buffers in and out of fMsg, a received buffer has no headroom
+    zmq_msg_t* GetMessage()
+    {
+        fHeadroom = 0;
+        return fMsg.get();
+    }
+
+    // free function of views, releases the viewed message
+    static void CloseViewed(void* /* data */, void* obj)
+    {
+        zmq_msg_close(static_cast<zmq_msg_t*>(obj));
+        delete static_cast<zmq_msg_t*>(obj);
+    }
+
+    // copy the content into a new buffer of newSize bytes (from the payload pool, if enabled)
+    bool Reallocate(size_t newSize)
+    {
+        size_t size = std::min(GetSize(), newSize);
+        auto old = std::move(fMsg);
+        fMsg = std::make_unique<zmq_msg_t>();
+        zmq_msg_init(fMsg.get());
+        if (fAlignment != 0) {
+            InitAligned(newSize);
+        } else {
+            InitSize(newSize);
+        }
+        if (zmq_msg_size(fMsg.get()) != newSize) {
+            zmq_msg_close(fMsg.get());
+            fMsg = std::move(old);
+            return false;
+        }
+        if (size > 0) {
+            tools::CopyPayload(zmq_msg_data(fMsg.get()), zmq_msg_data(old.get()), size);
+        }
+        if (zmq_msg_close(old.get()) != 0) {
+            LOG(error) << "failed closing message, reason: " << zmq_strerror(errno);
+        }
+        fHeadroom = 0;
+        fSharedBuffer = false;
+        return true;
+    }
+
+    // replace fMsg with a view of size bytes at offset from its data, which keeps the original alive
+    bool View(ptrdiff_t offset, size_t size)
+    {
+        auto view = std::make_unique<zmq_msg_t>();
+        char* data = static_cast<char*>(zmq_msg_data(fMsg.get())) + offset;
+        if (zmq_msg_init_data(view.get(), data, size, &CloseViewed, fMsg.get()) != 0) {
+            LOG(error) << "failed initializing message with data, reason: " << zmq_strerror(errno);
+            return false;
+        }
+        fSharedBuffer = fSharedBuffer || zmq_msg_get(fMsg.get(), ZMQ_SHARED);
+        fMsg.release();
+        fMsg.swap(view);
+        return true;
+    }
+
+    // aligned payloads come from the payload pool (if enabled and the size is pooled) or are allocated with malloc
+    void InitAligned(size_t size)
+    {
+        if (fPool && MessagePool::Pooled(size, fAlignment)) {
+            void* hint = nullptr;
+            void* data = fPool->Allocate(size, hint, fAlignment);
+            if (data) {
+                if (zmq_msg_init_data(fMsg.get(), data, size, &MessagePool::Free, hint) != 0) {
+                    LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
+                    MessagePool::Free(data, hint);
+                }
+                return;
+            }
+        }
+        auto ptrs = AllocateAligned(size, fAlignment);
+        if (zmq_msg_init_data(fMsg.get(), ptrs.second, size, [](void* /* data */, void* hint) { free(hint); }, ptrs.first) != 0) {
+            LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
+        }
+    }
+
+    // payloads of pooled sizes come from the payload pool (if enabled), others are allocated by zeromq
+    void InitSize(size_t size)
+    {
+        if (fPool && MessagePool::Pooled(size)) {
+            void* hint = nullptr;
+            void* data = fPool->Allocate(size, hint);
+            if (data) {
+                if (zmq_msg_init_data(fMsg.get(), data, size, &MessagePool::Free, hint) != 0) {
+                    LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
+                    MessagePool::Free(data, hint);
+                }
+                return;
+            }
+        }
+        if (zmq_msg_init_size(fMsg.get(), size) != 0) {
+            LOG(error) << "failed initializing message with size, reason: " << zmq_strerror(errno);
+        }
+    }
 
     void CloseMessage()
     {
@@ -279,6 +440,8 @@ class Message final : public fair::mq::Message
         // reset the message object to allow reuse in Rebuild
         fMsg.reset(nullptr);
         fAlignment = 0;
+        fHeadroom = 0;
+        fSharedBuffer = false;
     }
 };
 
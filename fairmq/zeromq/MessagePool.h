@@ -0,0 +1,195 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#ifndef FAIR_MQ_ZMQ_MESSAGEPOOL_H
+#define FAIR_MQ_ZMQ_MESSAGEPOOL_H
+
+#include <array>
+#include <atomic>
+#include <cstddef> // size_t, max_align_t
+#include <cstdint>
+#include <cstdlib> // malloc, free
+#include <mutex>
+#include <vector>
+
+namespace fair::mq::zmq
+{
+
+struct MessagePoolStats
+{
+    uint64_t hits = 0;   /// payloads served from the pool
+    uint64_t misses = 0; /// payloads that had to be allocated
+    uint64_t cachedBytes = 0; /// bytes currently held in the pool
+
+    double HitRate() const { return (hits + misses) > 0 ? static_cast<double>(hits) / (hits + misses) : 0.; }
+};
+
+/// Recycles the payload buffers of zeromq messages created with a size, grouped by power of two size classes.
+/// Buffers are handed to zeromq with zmq_msg_init_data and returned to the pool by the free function,
+/// which zeromq calls from its I/O thread (sent messages) or from the thread that closes the message.
+/// The pool is reference counted by its owner and all outstanding buffers, it is deleted with the last reference.
+class MessagePool
+{
+  public:
+    static constexpr size_t kMinSizeClassShift = 6;  // 64 bytes
+    static constexpr size_t kMaxSizeClassShift = 20; // 1 MiB
+    static constexpr size_t kNumSizeClasses = kMaxSizeClassShift - kMinSizeClassShift + 1;
+    // smaller payloads are stored inside the zmq_msg_t by zeromq itself and never allocated
+    static constexpr size_t kMinPooledSize = 33;
+
+    /// @param depth maximum number of buffers kept per size class
+    static MessagePool* Create(size_t depth) { return new MessagePool(depth); }
+
+    MessagePool(const MessagePool&) = delete;
+    MessagePool(MessagePool&&) = delete;
+    MessagePool& operator=(const MessagePool&) = delete;
+    MessagePool& operator=(MessagePool&&) = delete;
+
+    /// drop the reference of the owner, the pool is deleted after the last outstanding buffer is returned
+    void Close()
+    {
+        for (size_t c = 0; c < kNumSizeClasses; ++c) {
+            std::lock_guard<std::mutex> lock(fClasses.at(c).fMtx);
+            fClasses.at(c).fClosed = true;
+            Drain(c);
+        }
+        Unref();
+    }
+
+    /// @return false if the size (with the given alignment) is not served by the pool
+    static bool Pooled(size_t size, size_t alignment = 0) { return size >= kMinPooledSize && FullSize(size, alignment) <= SizeClassSize(kNumSizeClasses - 1); }
+
+    /// @param alignment alignment of the returned payload, 0 for the default alignment (max_align_t)
+    /// @return payload buffer of at least the given size (nullptr on allocation failure), to be released with Free(data, hint)
+    void* Allocate(size_t size, void*& hint, size_t alignment = 0)
+    {
+        size_t fullSize = FullSize(size, alignment);
+        size_t sizeClass = 0;
+        while (SizeClassSize(sizeClass) < fullSize) {
+            ++sizeClass;
+        }
+
+        Buffer* buffer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(fClasses.at(sizeClass).fMtx);
+            auto& freeList = fClasses.at(sizeClass).fFreeList;
+            if (!freeList.empty()) {
+                buffer = freeList.back();
+                freeList.pop_back();
+            }
+        }
+        if (buffer) {
+            fHits.fetch_add(1, std::memory_order_relaxed);
+            fCachedBytes.fetch_sub(SizeClassSize(sizeClass), std::memory_order_relaxed);
+        } else {
+            fMisses.fetch_add(1, std::memory_order_relaxed);
+            buffer = static_cast<Buffer*>(malloc(sizeof(Buffer) + SizeClassSize(sizeClass)));
+            if (!buffer) {
+                return nullptr;
+            }
+            buffer->fPool = this;
+            buffer->fSizeClass = sizeClass;
+        }
+        fRefs.fetch_add(1, std::memory_order_relaxed);
+        hint = buffer;
+        char* data = reinterpret_cast<char*>(buffer + 1);
+        if (alignment > alignof(Buffer)) {
+            data += (alignment - reinterpret_cast<uintptr_t>(data) % alignment) % alignment;
+        }
+        return data;
+    }
+
+    /// zeromq free function for buffers from Allocate()
+    static void Free(void* /* data */, void* hint)
+    {
+        Buffer* buffer = static_cast<Buffer*>(hint);
+        buffer->fPool->Return(buffer);
+    }
+
+    MessagePoolStats GetStats() const
+    {
+        MessagePoolStats stats;
+        stats.hits = fHits.load(std::memory_order_relaxed);
+        stats.misses = fMisses.load(std::memory_order_relaxed);
+        stats.cachedBytes = fCachedBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+  private:
+    // precedes the payload, the payload stays aligned to max_align_t
+    struct alignas(std::max_align_t) Buffer
+    {
+        MessagePool* fPool;
+        size_t fSizeClass;
+    };
+
+    struct SizeClass
+    {
+        std::mutex fMtx;
+        std::vector<Buffer*> fFreeList;
+        bool fClosed = false;
+    };
+
+    explicit MessagePool(size_t depth)
+        : fDepth(depth)
+        , fRefs(1)
+        , fHits(0)
+        , fMisses(0)
+        , fCachedBytes(0)
+    {}
+
+    ~MessagePool() = default;
+
+    static size_t SizeClassSize(size_t sizeClass) { return size_t(1) << (sizeClass + kMinSizeClassShift); }
+    // payload size including the padding for alignments larger than the default one
+    static size_t FullSize(size_t size, size_t alignment) { return alignment > alignof(Buffer) ? size + alignment - alignof(Buffer) : size; }
+
+    void Return(Buffer* buffer)
+    {
+        {
+            SizeClass& sizeClass = fClasses.at(buffer->fSizeClass);
+            std::lock_guard<std::mutex> lock(sizeClass.fMtx);
+            if (!sizeClass.fClosed && sizeClass.fFreeList.size() < fDepth) {
+                sizeClass.fFreeList.push_back(buffer);
+                fCachedBytes.fetch_add(SizeClassSize(buffer->fSizeClass), std::memory_order_relaxed);
+                buffer = nullptr;
+            }
+        }
+        free(buffer);
+        Unref();
+    }
+
+    // expects the lock of the size class to be held
+    void Drain(size_t sizeClass)
+    {
+        auto& freeList = fClasses.at(sizeClass).fFreeList;
+        fCachedBytes.fetch_sub(freeList.size() * SizeClassSize(sizeClass), std::memory_order_relaxed);
+        for (Buffer* buffer : freeList) {
+            free(buffer);
+        }
+        freeList.clear();
+    }
+
+    void Unref()
+    {
+        if (fRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    const size_t fDepth;
+    std::atomic<size_t> fRefs; // owner + outstanding buffers
+    std::atomic<uint64_t> fHits;
+    std::atomic<uint64_t> fMisses;
+    std::atomic<uint64_t> fCachedBytes;
+    std::array<SizeClass, kNumSizeClasses> fClasses;
+};
+
+} // namespace fair::mq::zmq
+
+#endif /* FAIR_MQ_ZMQ_MESSAGEPOOL_H */
@@ -13,7 +13,10 @@
 #include <fairmq/Channel.h>
 #include <fairmq/Poller.h>
 #include <fairmq/tools/Strings.h>
+#include <fairmq/zeromq/EpollSet.h>
 #include <fairmq/zeromq/Socket.h>
+#include <algorithm> // copy
+#include <memory> // unique_ptr
 #include <unordered_map>
 #include <vector>
 #include <zmq.h>
@@ -30,7 +33,7 @@ class Poller final : public fair::mq::Poller
     Poller& operator=(const Poller&) = delete;
     Poller& operator=(Poller&&) = delete;
 
-    Poller(const std::vector<Channel>& channels)
+    Poller(const std::vector<Channel>& channels, bool epoll = false)
         : fItems()
         , fNumItems(0)
     {
@@ -48,9 +51,11 @@ class Poller final : public fair::mq::Poller
 
             SetItemEvents(fItems[i], type);
         }
+
+        InitEpoll(epoll);
     }
 
-    Poller(const std::vector<Channel*>& channels)
+    Poller(const std::vector<Channel*>& channels, bool epoll = false)
         : fItems()
         , fNumItems(0)
     {
@@ -68,9 +73,11 @@ class Poller final : public fair::mq::Poller
 
             SetItemEvents(fItems[i], type);
         }
+
+        InitEpoll(epoll);
     }
 
-    Poller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList)
+    Poller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList, bool epoll = false)
         : fItems()
         , fNumItems(0)
     {
@@ -101,6 +108,8 @@ class Poller final : public fair::mq::Poller
                     SetItemEvents(fItems[index], type);
                 }
             }
+
+            InitEpoll(epoll);
         } catch (const std::out_of_range& oor) {
             LOG(error) << "at least one of the provided channel keys for poller initialization is invalid";
             LOG(error) << "out of range error: " << oor.what();
@@ -124,8 +133,13 @@ class Poller final : public fair::mq::Poller
 
     void Poll(int timeout) override
     {
+        if (fEpoll) {
+            fEpoll->Poll(fItems, timeout);
+            return;
+        }
+
         while (true) {
-            if (zmq_poll(fItems, fNumItems, timeout) < 0) {
+            if (zmq_poll(fItems, fNumItems + (fWakeup ? 1 : 0), timeout) < 0) {
                 if (errno == ETERM) {
                     LOG(debug) << "polling exited, reason: " << zmq_strerror(errno);
                     return;
@@ -189,13 +203,53 @@ class Poller final : public fair::mq::Poller
         }
     }
 
+    bool ReadyInputs(std::vector<int>& indices) override
+    {
+        if (!fEpoll) {
+            return false;
+        }
+        fEpoll->ReadyInputs(fItems, indices);
+        return true;
+    }
+
+    bool AddWakeup(int fd) override
+    {
+        if (fWakeup) {
+            return false; // one wakeup fd per poller
+        }
+        // the wakeup item follows the channel items, it is polled but never reported as ready input
+        auto items = new zmq_pollitem_t[fNumItems + 1];
+        std::copy(fItems, fItems + fNumItems, items);
+        items[fNumItems].socket = nullptr;
+        items[fNumItems].fd = fd;
+        items[fNumItems].events = ZMQ_POLLIN;
+        items[fNumItems].revents = 0;
+        delete[] fItems;
+        fItems = items;
+        fWakeup = true;
+        if (fEpoll) {
+            fEpoll->AddWakeup(fd);
+        }
+        return true;
+    }
+
     ~Poller() override { delete[] fItems; }
 
   private:
+    void InitEpoll(bool epoll)
+    {
+        if (epoll) {
+            fEpoll = std::make_unique<EpollSet>();
+            fEpoll->Init(fItems, fNumItems);
+        }
+    }
+
     zmq_pollitem_t* fItems;
     int fNumItems;
 
     std::unordered_map<std::string, int> fOffsetMap;
+    std::unique_ptr<EpollSet> fEpoll; // set if polling with epoll
+    bool fWakeup = false; // fItems[fNumItems] is the wakeup item
 };
 
 } // namespace fair::mq::zmq
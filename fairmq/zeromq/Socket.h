@@ -11,19 +11,30 @@
 
 #include <fairmq/Message.h>
 #include <fairmq/Socket.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Log.h>
 #include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
 #include <fairmq/zeromq/Common.h>
+#include <fairmq/zeromq/Compression.h>
 #include <fairmq/zeromq/Context.h>
 #include <fairmq/zeromq/Message.h>
+#include <fairmq/zeromq/MessagePool.h>
 
 #include <fairlogger/Logger.h>
 
 #include <zmq.h>
 
+#include <algorithm> // min
 #include <atomic>
+#include <cstdint>
+#include <cstring> // memcpy
 #include <functional>
 #include <memory> // unique_ptr, make_unique
+#include <mutex>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace fair::mq::zmq
 {
@@ -42,6 +53,12 @@ class Socket final : public fair::mq::Socket
         , fMessagesTx(0)
         , fMessagesRx(0)
         , fTimeout(100)
+        , fPackParts(0)
+        , fTrace(false)
+        , fChunkSize(0)
+        , fChunkSender(tools::UuidHash())
+        , fChunkSequence(0)
+        , fChunkTarget(nullptr)
         , fConnectedPeersCount(0)
     {
         if (fSocket == nullptr) {
@@ -89,6 +106,8 @@ class Socket final : public fair::mq::Socket
         return zmq::Bind(fSocket, address, fId);
     }
 
+    std::string GetBoundAddress() const override { return zmq::GetLastEndpoint(fSocket); }
+
     bool Connect(const std::string& address) override
     {
         return zmq::Connect(fSocket, address, fId);
@@ -96,11 +115,23 @@ class Socket final : public fair::mq::Socket
 
     int64_t Send(MessagePtr& msg, int timeout = -1) override
     {
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+
+        if (fChunkSize > 0) {
+            return SendChunked(&msg, 1, flags, timeout);
+        }
+
+        if (fTrace) {
+            int64_t rc = SendTraceFrame(msg->GetTraceContext(), flags, timeout);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+
+        if (fCompressor) {
+            return SendCompressed(&msg, 1, flags, timeout);
         }
-        int elapsed = 0;
 
         int64_t actualBytes = zmq_msg_size(static_cast<Message*>(msg.get())->GetMessage());
 
@@ -113,7 +144,7 @@ class Socket final : public fair::mq::Socket
             } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                 if (fCtx.Interrupted()) {
                     return static_cast<int>(TransferCode::interrupted);
-                } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                } else if (wait.Retry()) {
                     continue;
                 } else {
                     return static_cast<int>(TransferCode::timeout);
@@ -126,11 +157,45 @@ class Socket final : public fair::mq::Socket
 
     int64_t Receive(MessagePtr& msg, int timeout = -1) override
     {
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
+        int flags = zmq::TransferFlags(timeout);
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
+
+        if (fChunkSize > 0) {
+            std::vector<fair::mq::MessagePtr> parts;
+            int64_t rc = ReceiveChunked(parts, flags, timeout);
+            if (rc >= 0 && parts.size() != 1) {
+                FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received a multipart message with a single part receive on " << fId;
+                return static_cast<int>(TransferCode::error);
+            }
+            if (rc >= 0) {
+                // the part may have been assembled in a message of the chunk target transport
+                msg = std::move(parts.front());
+            }
+            return rc;
+        }
+
+        if (fTrace) {
+            TraceContext context;
+            int64_t rc = ReceiveTraceFrame(context, flags, timeout);
+            if (rc < 0) {
+                return rc;
+            }
+            msg->SetTraceContext(context);
+        }
+
+        if (fCompressor) {
+            std::vector<fair::mq::MessagePtr> parts;
+            int64_t rc = ReceiveCompressed(parts, flags, timeout);
+            if (rc >= 0 && parts.size() != 1) {
+                FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received a multipart message with a single part receive on " << fId;
+                return static_cast<int>(TransferCode::error);
+            }
+            if (rc >= 0) {
+                zmq_msg_move(static_cast<Message*>(msg.get())->GetMessage(), static_cast<Message*>(parts.front().get())->GetMessage());
+                static_cast<Message*>(msg.get())->Realign();
+            }
+            return rc;
         }
-        int elapsed = 0;
 
         while (true) {
             int nbytes = zmq_msg_recv(static_cast<Message*>(msg.get())->GetMessage(), fSocket, flags);
@@ -143,7 +208,7 @@ class Socket final : public fair::mq::Socket
             } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                 if (fCtx.Interrupted()) {
                     return static_cast<int>(TransferCode::interrupted);
-                } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                } else if (wait.Retry()) {
                     continue;
                 } else {
                     return static_cast<int>(TransferCode::timeout);
@@ -156,16 +221,33 @@ class Socket final : public fair::mq::Socket
 
     int64_t Send(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
     {
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
-        }
+        int flags = zmq::TransferFlags(timeout);
 
         const unsigned int vecSize = msgVec.size();
 
+        if (fChunkSize > 0 && vecSize > 0) {
+            return SendChunked(msgVec.data(), vecSize, flags, timeout);
+        }
+
+        // (a single part is sent as a regular message, which sends the trace frame itself)
+        if (fTrace && vecSize > 1) {
+            int64_t rc = SendTraceFrame(msgVec.front()->GetTraceContext(), flags, timeout);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+
+        if (fCompressor && vecSize > 1) {
+            return SendCompressed(msgVec.data(), vecSize, flags, timeout);
+        }
+
+        if (fPackParts > 0 && vecSize > 1) {
+            return SendPacked(msgVec, flags, timeout);
+        }
+
         // Sending vector typicaly handles more then one part
         if (vecSize > 1) {
-            int elapsed = 0;
+            const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
 
             while (true) {
                 int64_t totalSize = 0;
@@ -178,7 +260,7 @@ class Socket final : public fair::mq::Socket
                     } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                         if (fCtx.Interrupted()) {
                             return static_cast<int>(TransferCode::interrupted);
-                        } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                        } else if (wait.Retry()) {
                             repeat = true;
                             break;
                         } else {
@@ -201,18 +283,139 @@ class Socket final : public fair::mq::Socket
         } else if (vecSize == 1) { // If there's only one part, send it as a regular message
             return Send(msgVec.back(), timeout);
         } else { // if the vector is empty, something might be wrong
-            LOG(warn) << "Will not send empty vector";
+            FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << "Will not send empty vector";
             return static_cast<int>(TransferCode::error);
         }
     }
 
+    /// Queues zmq_msg_copy references of the messages, the payload is shared and not copied
+    bool SendCopy(const MessagePtr* msgs, size_t numMsgs, int timeout, int64_t& result) override
+    {
+        int flags = zmq::TransferFlags(timeout);
+
+        if (fCompressor || fChunkSize > 0) {
+            // the compressed frames are new messages anyway, chunks are sent as views of the parts by Send()
+            return false;
+        }
+
+        if (numMsgs == 0) {
+            FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << "Will not send empty vector";
+            result = static_cast<int>(TransferCode::error);
+            return true;
+        }
+
+        if (fTrace) {
+            result = SendTraceFrame(msgs[0]->GetTraceContext(), flags, timeout);
+            if (result < 0) {
+                return true;
+            }
+        }
+
+        if (fPackParts > 0 && numMsgs > 1) {
+            // the packed frame is assembled from the parts, only their message objects are created
+            std::vector<MessagePtr> copies;
+            copies.reserve(numMsgs);
+            for (size_t i = 0; i < numMsgs; ++i) {
+                copies.push_back(std::make_unique<Message>(GetTransport()));
+                copies.back()->Copy(*msgs[i]);
+            }
+            result = SendPacked(copies, flags, timeout);
+            return true;
+        }
+
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+        int64_t totalSize = 0;
+        size_t i = 0;
+        while (i < numMsgs) {
+            zmq_msg_t copy;
+            zmq_msg_init(&copy);
+            if (zmq_msg_copy(&copy, static_cast<const Message*>(msgs[i].get())->GetMessage()) != 0) {
+                FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "failed copying message, reason: " << zmq_strerror(errno);
+                zmq_msg_close(&copy);
+                result = static_cast<int>(TransferCode::error);
+                return true;
+            }
+            int nbytes = zmq_msg_send(&copy, fSocket, (i < numMsgs - 1) ? ZMQ_SNDMORE | flags : flags);
+            if (nbytes >= 0) {
+                totalSize += nbytes;
+                ++i;
+                continue;
+            }
+            zmq_msg_close(&copy);
+            if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fCtx.Interrupted()) {
+                    result = static_cast<int>(TransferCode::interrupted);
+                } else if (i > 0 || wait.Retry()) {
+                    // once the first part is queued, the remaining ones are queued too
+                    continue;
+                } else {
+                    result = static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                result = zmq::HandleErrors(fId);
+            }
+            return true;
+        }
+
+        // store statistics on how many messages have been sent (handle all parts as a single message)
+        ++fMessagesTx;
+        fBytesTx += totalSize;
+        result = totalSize;
+        return true;
+    }
+
+    bool Forward(fair::mq::Socket& out, int timeout, int64_t& result) override
+    {
+        auto& zOut = static_cast<Socket&>(out);
+        // packed, compressed and trace frames are forwarded as they are, only when both sides use the same packing,
+        // compression and tracing (the compressed frames are decompressed by the codec given in the descriptor frame)
+        // chunks are transfers of their own, chunked messages are assembled and chunked again
+        if (zOut.fPackParts != fPackParts || zOut.fTrace != fTrace || (zOut.fCompressor == nullptr) != (fCompressor == nullptr)
+         || fChunkSize > 0 || zOut.fChunkSize > 0) {
+            return false;
+        }
+        result = zmq::ForwardFrames(fSocket, zOut.fSocket, fTimeout, timeout, fId,
+                                    [](const void* /* data */, size_t size) { return size; },
+                                    [this]() { return fCtx.Interrupted(); });
+        if (result >= 0) {
+            ++fMessagesRx;
+            fBytesRx += result;
+            ++zOut.fMessagesTx;
+            zOut.fBytesTx += result;
+        }
+        return true;
+    }
+
     int64_t Receive(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int timeout = -1) override
     {
-        int flags = 0;
-        if (timeout == 0) {
-            flags = ZMQ_DONTWAIT;
+        int flags = zmq::TransferFlags(timeout);
+
+        if (fChunkSize > 0) {
+            return ReceiveChunked(msgVec, flags, timeout);
+        }
+
+        const size_t first = msgVec.size();
+        TraceContext context;
+        if (fTrace) {
+            int64_t rc = ReceiveTraceFrame(context, flags, timeout);
+            if (rc < 0) {
+                return rc;
+            }
         }
-        int elapsed = 0;
+
+        if (fCompressor) {
+            int64_t rc = ReceiveCompressed(msgVec, flags, timeout);
+            SetTraceContext(msgVec, first, context);
+            return rc;
+        }
+
+        if (fPackParts > 0) {
+            int64_t rc = ReceivePacked(msgVec, flags, timeout);
+            SetTraceContext(msgVec, first, context);
+            return rc;
+        }
+
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
 
         while (true) {
             int64_t totalSize = 0;
@@ -230,7 +433,7 @@ class Socket final : public fair::mq::Socket
                 } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
                     if (fCtx.Interrupted()) {
                         return static_cast<int>(TransferCode::interrupted);
-                    } else if (zmq::ShouldRetry(flags, fTimeout, timeout, elapsed)) {
+                    } else if (wait.Retry()) {
                         repeat = true;
                         break;
                     } else {
@@ -251,10 +454,32 @@ class Socket final : public fair::mq::Socket
             // store statistics on how many messages have been received (handle all parts as a single message)
             ++fMessagesRx;
             fBytesRx += totalSize;
+            SetTraceContext(msgVec, first, context);
             return totalSize;
         }
     }
 
+    void SetPackParts(int maxPartSize) override { fPackParts = maxPartSize; }
+    void SetTrace(bool enable) override { fTrace = enable; }
+    void SetChunkSize(int chunkSize) override { fChunkSize = chunkSize; }
+    void SetChunkTarget(fair::mq::TransportFactory* target) override { fChunkTarget = target; }
+    void SetChunkCallback(ChunkCallback callback) override { fChunkCallback = std::move(callback); }
+
+    void SetCompression(const std::string& codec, int level, int threads, int minSize) override
+    {
+        fCompressor = nullptr;
+        if (Compressor::ParseCodec(codec) != Compressor::Codec::none) {
+            fCompressor = std::make_unique<Compressor>(Compressor::ParseCodec(codec), level, threads, minSize);
+        }
+    }
+
+    void GetCompressionMetrics(ChannelMetrics& metrics) const override
+    {
+        if (fCompressor) {
+            fCompressor->GetMetrics(metrics);
+        }
+    }
+
     void* GetSocket() const { return fSocket; }
 
     void Close() override
@@ -350,6 +575,10 @@ class Socket final : public fair::mq::Socket
         if (zmq_setsockopt(fSocket, ZMQ_SNDBUF, &value, sizeof(value)) < 0) {
             throw SocketError(tools::ToString("failed getting ZMQ_SNDBUF, reason: ", zmq_strerror(errno)));
         }
+        // applies to new connections only, the established ones are resized directly
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+        setConnectionKernelSize(fConnectionFds, SO_SNDBUF, value);
     }
 
     int GetSndKernelSize() const override
@@ -367,6 +596,10 @@ class Socket final : public fair::mq::Socket
         if (zmq_setsockopt(fSocket, ZMQ_RCVBUF, &value, sizeof(value)) < 0) {
             throw SocketError(tools::ToString("failed getting ZMQ_RCVBUF, reason: ", zmq_strerror(errno)));
         }
+        // applies to new connections only, the established ones are resized directly
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+        setConnectionKernelSize(fConnectionFds, SO_RCVBUF, value);
     }
 
     int GetRcvKernelSize() const override
@@ -381,10 +614,36 @@ class Socket final : public fair::mq::Socket
 
     unsigned long GetNumberOfConnectedPeers() const override
     {
-        fConnectedPeersCount = updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket);
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
         return fConnectedPeersCount;
     }
 
+    int GetRttUs() const override
+    {
+        std::lock_guard<std::mutex> lock(fMonitorMtx);
+        fConnectedPeersCount = updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+        return connectionRttUs(fConnectionFds);
+    }
+
+    // estimated from the kernel queues of the connections and the average size of the transferred messages
+    int64_t GetQueueDepth(bool& exact) const override
+    {
+        exact = false;
+        uint64_t bytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(fMonitorMtx);
+            fConnectedPeersCount = updateNumberOfConnectedPeers(fConnectedPeersCount, fMonitorSocket, &fConnectionFds);
+            bytes = connectionQueuedBytes(fConnectionFds);
+        }
+        const uint64_t messages = GetMessagesTx() + GetMessagesRx();
+        if (messages == 0) {
+            return bytes > 0 ? 1 : 0;
+        }
+        const uint64_t averageSize = std::max<uint64_t>((GetBytesTx() + GetBytesRx()) / messages, 1);
+        return static_cast<int64_t>((bytes + averageSize - 1) / averageSize);
+    }
+
     unsigned long GetBytesTx() const override { return fBytesTx; }
     unsigned long GetBytesRx() const override { return fBytesRx; }
     unsigned long GetMessagesTx() const override { return fMessagesTx; }
@@ -396,17 +655,774 @@ class Socket final : public fair::mq::Socket
     ~Socket() override { Close(); }
 
   private:
+    // Packed multipart messages: the first frame starts with a PackHeader, followed by the size of every part
+    // (kPackSeparate set for parts that follow as their own frames, in order) and the packed parts,
+    // each starting at a multiple of kPackAlignment.
+    struct PackHeader
+    {
+        uint64_t fMagic;
+        uint32_t fNumParts;
+        uint32_t fReserved;
+    };
+    static constexpr uint64_t kPackMagic = 0x314b434150514d46; // "FMQPACK1"
+    static constexpr uint64_t kPackSeparate = uint64_t(1) << 63;
+    static constexpr size_t kPackAlignment = 8;
+
+    // received packed frame, shared by the parts that point into it
+    struct PackedFrame
+    {
+        fair::mq::MessagePtr fFrame;
+        std::atomic<size_t> fRefs;
+    };
+
+    static size_t PackAlign(size_t offset) { return (offset + kPackAlignment - 1) / kPackAlignment * kPackAlignment; }
+
+    static void ReleasePackedFrame(void* /* data */, void* hint)
+    {
+        auto frame = static_cast<PackedFrame*>(hint);
+        if (frame->fRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete frame;
+        }
+    }
+
+    // With tracing, every (multipart) message is preceded by a frame with the trace context of its first part.
+    // Once this frame is queued, the frames of the message are queued too (zeromq multipart messages are atomic).
+    int64_t SendTraceFrame(const TraceContext& context, int flags, int timeout)
+    {
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+        while (true) {
+            if (zmq_send(fSocket, &context, sizeof(context), ZMQ_SNDMORE | flags) >= 0) {
+                return 0;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fCtx.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+    }
+
+    int64_t ReceiveTraceFrame(TraceContext& context, int flags, int timeout)
+    {
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
+        while (true) {
+            int nbytes = zmq_recv(fSocket, &context, sizeof(context), flags);
+            if (nbytes >= 0) {
+                int more = 0;
+                size_t moreSize = sizeof(more);
+                zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+                if (nbytes != sizeof(context) || !more) {
+                    FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received a message without trace frame on " << fId << ", the peer has to enable tracing (channel property trace) too";
+                    // drop the rest of the message
+                    for (zmq_msg_t frame; more;) {
+                        zmq_msg_init(&frame);
+                        zmq_msg_recv(&frame, fSocket, 0);
+                        zmq_msg_close(&frame);
+                        zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+                    }
+                    return static_cast<int>(TransferCode::error);
+                }
+                return 0;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fCtx.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+    }
+
+    static void SetTraceContext(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, size_t first, const TraceContext& context)
+    {
+        for (size_t i = first; i < msgVec.size(); ++i) {
+            msgVec[i]->SetTraceContext(context);
+        }
+    }
+
+    // With compression, every (multipart) message is preceded by a descriptor frame with one uint64 per part:
+    // 0 for a part sent as it is, otherwise the codec (top byte) and the size of the compressed part.
+    static constexpr int kCodecShift = 56;
+
+    // payload buffers from the pool of the transport
+    fair::mq::MessagePtr NewMessage(size_t size)
+    {
+        return GetTransport() ? GetTransport()->CreateMessage(size) : std::make_unique<Message>(size);
+    }
+
+    int64_t SendCompressed(fair::mq::MessagePtr* msgs, size_t numMsgs, int flags, int timeout)
+    {
+        std::vector<uint64_t> descriptor(numMsgs, 0);
+        std::vector<fair::mq::MessagePtr> frames(numMsgs);
+        std::vector<Compressor::CompressJob> jobs;
+        std::vector<size_t> jobParts;
+        int64_t totalSize = 0;
+        for (size_t i = 0; i < numMsgs; ++i) {
+            const size_t size = msgs[i]->GetSize();
+            totalSize += size;
+            if (fCompressor->Compresses(size)) {
+                frames[i] = NewMessage(fCompressor->FrameBound(size));
+                jobs.push_back({msgs[i]->GetData(), size, static_cast<char*>(frames[i]->GetData()), 0});
+                jobParts.push_back(i);
+            } else {
+                fCompressor->CountTx(size);
+            }
+        }
+        fCompressor->Compress(jobs);
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            const size_t i = jobParts[j];
+            if (jobs[j].fResult == 0) {
+                frames[i] = nullptr;
+                continue;
+            }
+            frames[i]->SetUsedSize(jobs[j].fResult);
+            descriptor[i] = (static_cast<uint64_t>(fCompressor->GetCodec()) << kCodecShift) | jobs[j].fSize;
+        }
+
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+        while (true) {
+            if (zmq_send(fSocket, descriptor.data(), descriptor.size() * sizeof(uint64_t), ZMQ_SNDMORE | flags) >= 0) {
+                break;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fCtx.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+
+        // once the descriptor frame is queued, the frames of the message are queued too
+        for (size_t i = 0; i < numMsgs; ++i) {
+            zmq_msg_t* msg = static_cast<Message*>((frames[i] ? frames[i] : msgs[i]).get())->GetMessage();
+            while (zmq_msg_send(msg, fSocket, (i < numMsgs - 1) ? ZMQ_SNDMORE | flags : flags) < 0) {
+                if (zmq_errno() != EAGAIN && zmq_errno() != EINTR) {
+                    return zmq::HandleErrors(fId);
+                } else if (fCtx.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                }
+            }
+            if (frames[i]) {
+                // the compressed original is released like zeromq does with sent messages
+                zmq_msg_t* original = static_cast<Message*>(msgs[i].get())->GetMessage();
+                zmq_msg_close(original);
+                zmq_msg_init(original);
+            }
+        }
+
+        ++fMessagesTx;
+        fBytesTx += totalSize;
+        return totalSize;
+    }
+
+    int64_t ReceiveCompressed(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int flags, int timeout)
+    {
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
+        zmq_msg_t descriptorFrame;
+        zmq_msg_init(&descriptorFrame);
+        while (zmq_msg_recv(&descriptorFrame, fSocket, flags) < 0) {
+            if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fCtx.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+        const size_t descriptorSize = zmq_msg_size(&descriptorFrame);
+        std::vector<uint64_t> descriptor(descriptorSize / sizeof(uint64_t));
+        std::memcpy(descriptor.data(), zmq_msg_data(&descriptorFrame), descriptor.size() * sizeof(uint64_t));
+        zmq_msg_close(&descriptorFrame);
+
+        int more = 0;
+        size_t moreSize = sizeof(more);
+        zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+        bool valid = more && descriptorSize > 0 && descriptorSize % sizeof(uint64_t) == 0;
+
+        // the remaining frames of a multipart message are available once the first one has been received
+        const size_t first = msgVec.size();
+        std::vector<Compressor::DecompressJob> jobs;
+        std::vector<fair::mq::MessagePtr> frames;
+        for (size_t i = 0; more; ++i) {
+            fair::mq::MessagePtr frame = std::make_unique<Message>(GetTransport());
+            if (zmq_msg_recv(static_cast<Message*>(frame.get())->GetMessage(), fSocket, 0) < 0) {
+                return zmq::HandleErrors(fId);
+            }
+            zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+            if (!valid || i >= descriptor.size()) {
+                valid = false;
+                continue;
+            }
+            const auto codec = static_cast<Compressor::Codec>(descriptor[i] >> kCodecShift);
+            if (codec == Compressor::Codec::none) {
+                static_cast<Message*>(frame.get())->Realign();
+                fCompressor->CountRx(frame->GetSize());
+                msgVec.push_back(std::move(frame));
+                continue;
+            }
+            const size_t rawSize = descriptor[i] & ((uint64_t(1) << kCodecShift) - 1);
+            msgVec.push_back(NewMessage(rawSize));
+            jobs.push_back({static_cast<const char*>(frame->GetData()), frame->GetSize(), codec, msgVec.back()->GetData(), rawSize});
+            frames.push_back(std::move(frame));
+        }
+        if (!valid || msgVec.size() - first != descriptor.size()) {
+            FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received a message without valid compression descriptor on " << fId << ", the peer has to enable compression (channel property compression) too";
+            msgVec.resize(first);
+            return static_cast<int>(TransferCode::error);
+        }
+        if (!fCompressor->Decompress(jobs)) {
+            FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received a corrupt compressed frame on " << fId;
+            msgVec.resize(first);
+            return static_cast<int>(TransferCode::error);
+        }
+
+        int64_t totalSize = 0;
+        for (size_t i = first; i < msgVec.size(); ++i) {
+            totalSize += msgVec[i]->GetSize();
+        }
+        ++fMessagesRx;
+        fBytesRx += totalSize;
+        return totalSize;
+    }
+
+    int64_t SendPacked(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int flags, int timeout)
+    {
+        const size_t numParts = msgVec.size();
+        const size_t headerSize = sizeof(PackHeader) + numParts * sizeof(uint64_t);
+        size_t frameSize = headerSize;
+        int64_t totalSize = 0;
+        std::vector<zmq_msg_t*> separate;
+        for (auto& part : msgVec) {
+            zmq_msg_t* msg = static_cast<Message*>(part.get())->GetMessage();
+            size_t size = zmq_msg_size(msg);
+            totalSize += size;
+            if (size <= static_cast<size_t>(fPackParts)) {
+                frameSize = PackAlign(frameSize) + size;
+            } else {
+                separate.push_back(msg);
+            }
+        }
+
+        zmq_msg_t frame;
+        if (zmq_msg_init_size(&frame, frameSize) != 0) {
+            FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "failed initializing packed frame of " << frameSize << " bytes on " << fId << ", reason: " << zmq_strerror(errno);
+            return static_cast<int>(TransferCode::error);
+        }
+        char* data = static_cast<char*>(zmq_msg_data(&frame));
+        PackHeader header{kPackMagic, static_cast<uint32_t>(numParts), 0};
+        std::memcpy(data, &header, sizeof(header));
+        size_t offset = headerSize;
+        for (size_t i = 0; i < numParts; ++i) {
+            zmq_msg_t* msg = static_cast<Message*>(msgVec[i].get())->GetMessage();
+            uint64_t size = zmq_msg_size(msg);
+            if (size <= static_cast<size_t>(fPackParts)) {
+                offset = PackAlign(offset);
+                std::memcpy(data + offset, zmq_msg_data(msg), size);
+                offset += size;
+            } else {
+                size |= kPackSeparate;
+            }
+            std::memcpy(data + sizeof(PackHeader) + i * sizeof(uint64_t), &size, sizeof(size));
+        }
+
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+        size_t sent = 0; // frames sent, the first one is the packed frame
+        while (sent <= separate.size()) {
+            zmq_msg_t* msg = sent == 0 ? &frame : separate[sent - 1];
+            int nbytes = zmq_msg_send(msg, fSocket, (sent < separate.size()) ? ZMQ_SNDMORE | flags : flags);
+            if (nbytes >= 0) {
+                ++sent;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                int64_t result = 0;
+                if (fCtx.Interrupted()) {
+                    result = static_cast<int>(TransferCode::interrupted);
+                } else if (sent > 0 || wait.Retry()) {
+                    // once the first frame is queued, the remaining ones are queued too
+                    continue;
+                } else {
+                    result = static_cast<int>(TransferCode::timeout);
+                }
+                zmq_msg_close(&frame);
+                return result;
+            } else {
+                zmq_msg_close(&frame);
+                return zmq::HandleErrors(fId);
+            }
+        }
+
+        zmq_msg_close(&frame);
+
+        // the packed parts have been copied, release them like zeromq does with sent messages
+        for (auto& part : msgVec) {
+            zmq_msg_t* msg = static_cast<Message*>(part.get())->GetMessage();
+            if (zmq_msg_size(msg) <= static_cast<size_t>(fPackParts)) {
+                zmq_msg_close(msg);
+                zmq_msg_init(msg);
+            }
+        }
+
+        ++fMessagesTx;
+        fBytesTx += totalSize;
+        return totalSize;
+    }
+
+    /// Split a received packed frame into parts, parts following as separate frames get empty placeholders
+    /// @return false if the frame is not a (valid) packed frame
+    bool Unpack(fair::mq::MessagePtr& frame, bool more, std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, std::vector<size_t>& separate)
+    {
+        const size_t frameSize = frame->GetSize();
+        const char* data = static_cast<const char*>(frame->GetData());
+        PackHeader header;
+        if (frameSize < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (header.fMagic != kPackMagic || header.fNumParts == 0 || header.fNumParts > (frameSize - sizeof(header)) / sizeof(uint64_t)) {
+            return false;
+        }
+        std::vector<uint64_t> sizes(header.fNumParts);
+        std::memcpy(sizes.data(), data + sizeof(header), sizes.size() * sizeof(uint64_t));
+        size_t offset = sizeof(header) + sizes.size() * sizeof(uint64_t);
+        size_t numSeparate = 0;
+        size_t numSlices = 0;
+        for (uint64_t size : sizes) {
+            if (size & kPackSeparate) {
+                ++numSeparate;
+                continue;
+            }
+            offset = PackAlign(offset);
+            if (size > frameSize - std::min(offset, frameSize)) {
+                return false;
+            }
+            offset += size;
+            if (size >= MessagePool::kMinPooledSize) {
+                ++numSlices;
+            }
+        }
+        if (offset != frameSize || (numSeparate > 0) != more) {
+            return false;
+        }
+
+        PackedFrame* packed = numSlices > 0 ? new PackedFrame{std::move(frame), numSlices} : nullptr;
+        offset = sizeof(header) + sizes.size() * sizeof(uint64_t);
+        for (uint64_t size : sizes) {
+            if (size & kPackSeparate) {
+                separate.push_back(msgVec.size());
+                msgVec.push_back(std::make_unique<Message>(GetTransport()));
+                continue;
+            }
+            offset = PackAlign(offset);
+            void* partData = const_cast<char*>(data) + offset;
+            if (size < MessagePool::kMinPooledSize) {
+                // small enough to be stored inside the zmq_msg_t, copying is cheaper than sharing
+                msgVec.push_back(std::make_unique<Message>(size, GetTransport()));
+                std::memcpy(msgVec.back()->GetData(), partData, size);
+            } else {
+                msgVec.push_back(std::make_unique<Message>(partData, size, &ReleasePackedFrame, packed, GetTransport()));
+            }
+            offset += size;
+        }
+        return true;
+    }
+
+    int64_t ReceivePacked(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int flags, int timeout)
+    {
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
+        fair::mq::MessagePtr frame = std::make_unique<Message>(GetTransport());
+
+        while (true) {
+            int nbytes = zmq_msg_recv(static_cast<Message*>(frame.get())->GetMessage(), fSocket, flags);
+            if (nbytes >= 0) {
+                break;
+            } else if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fCtx.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+
+        int more = 0;
+        size_t moreSize = sizeof(more);
+        zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+
+        const size_t first = msgVec.size();
+        std::vector<size_t> separate;
+        const bool packed = Unpack(frame, more, msgVec, separate);
+        if (!packed) {
+            // not packed (peer without packing), receive it as a regular multipart message
+            msgVec.push_back(std::move(frame));
+        }
+
+        // the remaining frames of a multipart message are available once the first one has been received
+        size_t received = 0;
+        for (; more; ++received) {
+            if (received == separate.size()) {
+                if (packed) {
+                    FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received more frames than announced by the packed frame on " << fId;
+                    return static_cast<int>(TransferCode::error);
+                }
+                separate.push_back(msgVec.size());
+                msgVec.push_back(std::make_unique<Message>(GetTransport()));
+            }
+            if (zmq_msg_recv(static_cast<Message*>(msgVec[separate[received]].get())->GetMessage(), fSocket, 0) < 0) {
+                return zmq::HandleErrors(fId);
+            }
+            zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+        }
+        if (received != separate.size()) {
+            FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received fewer frames than announced by the packed frame on " << fId;
+            return static_cast<int>(TransferCode::error);
+        }
+
+        int64_t totalSize = 0;
+        for (size_t i = first; i < msgVec.size(); ++i) {
+            totalSize += msgVec[i]->GetSize();
+        }
+        ++fMessagesRx;
+        fBytesRx += totalSize;
+        return totalSize;
+    }
+
+    // Chunked transfers: every (multipart) message starts with a frame holding a ChunkDescriptor and the size of every part.
+    // If no part is larger than fChunkSize (kChunkInline), the parts follow as frames of the same message. Otherwise the
+    // parts follow in chunks of up to fChunkSize bytes, each one a message of two frames: a ChunkHeader and the chunk.
+    // Chunks of different senders may interleave on the receiving socket, the assemblies are kept by sender.
+    struct ChunkDescriptor
+    {
+        uint64_t fMagic;
+        uint64_t fSender;
+        uint64_t fSequence;
+        TraceContext fTrace;
+        uint32_t fNumParts;
+        uint32_t fFlags;
+    };
+    struct ChunkHeader
+    {
+        uint64_t fMagic;
+        uint64_t fSender;
+        uint64_t fSequence;
+        uint64_t fPart;
+        uint64_t fOffset;
+    };
+    static constexpr uint64_t kChunkDescriptorMagic = 0x444b4e4843514d46; // "FMQCHNKD"
+    static constexpr uint64_t kChunkMagic = 0x434b4e4843514d46; // "FMQCHNKC"
+    static constexpr uint32_t kChunkInline = 1;
+
+    struct ChunkAssembly
+    {
+        uint64_t fSequence = 0;
+        std::vector<fair::mq::MessagePtr> fParts;
+        uint64_t fRemaining = 0; // bytes
+        uint64_t fTotal = 0; // bytes
+        TraceContext fTrace;
+    };
+
+    // Queues a frame of a message whose first frame is queued already. Blocks (in steps of the socket timeout) while the
+    // queue is at the high-water mark, this paces the sender of a chunked transfer to the receiver.
+    int64_t SendFollowing(zmq_msg_t* msg, int flags)
+    {
+        while (zmq_msg_send(msg, fSocket, flags) < 0) {
+            if (zmq_errno() != EAGAIN && zmq_errno() != EINTR) {
+                return zmq::HandleErrors(fId);
+            } else if (fCtx.Interrupted()) {
+                return static_cast<int>(TransferCode::interrupted);
+            }
+        }
+        return 0;
+    }
+
+    int64_t SendChunked(fair::mq::MessagePtr* msgs, size_t numMsgs, int flags, int timeout)
+    {
+        const size_t chunkSize = fChunkSize;
+        ChunkDescriptor descriptor{kChunkDescriptorMagic, fChunkSender, ++fChunkSequence, msgs[0]->GetTraceContext(),
+                                   static_cast<uint32_t>(numMsgs), kChunkInline};
+        std::vector<char> frame(sizeof(descriptor) + numMsgs * sizeof(uint64_t));
+        int64_t totalSize = 0;
+        for (size_t i = 0; i < numMsgs; ++i) {
+            const uint64_t size = msgs[i]->GetSize();
+            totalSize += size;
+            if (size > chunkSize) {
+                descriptor.fFlags = 0;
+            }
+            std::memcpy(frame.data() + sizeof(descriptor) + i * sizeof(uint64_t), &size, sizeof(size));
+        }
+        std::memcpy(frame.data(), &descriptor, sizeof(descriptor));
+        const bool inlined = descriptor.fFlags & kChunkInline;
+
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLOUT, fTimeout, timeout);
+        while (zmq_send(fSocket, frame.data(), frame.size(), (inlined ? ZMQ_SNDMORE : 0) | flags) < 0) {
+            if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                if (fCtx.Interrupted()) {
+                    return static_cast<int>(TransferCode::interrupted);
+                } else if (wait.Retry()) {
+                    continue;
+                } else {
+                    return static_cast<int>(TransferCode::timeout);
+                }
+            } else {
+                return zmq::HandleErrors(fId);
+            }
+        }
+
+        // once the descriptor is queued, the parts are queued too
+        for (size_t i = 0; i < numMsgs; ++i) {
+            if (inlined) {
+                int64_t rc = SendFollowing(static_cast<Message*>(msgs[i].get())->GetMessage(), i < numMsgs - 1 ? ZMQ_SNDMORE : 0);
+                if (rc < 0) {
+                    return rc;
+                }
+                continue;
+            }
+            const size_t size = msgs[i]->GetSize();
+            for (size_t offset = 0; offset < size; offset += chunkSize) {
+                ChunkHeader header{kChunkMagic, fChunkSender, fChunkSequence, i, offset};
+                zmq_msg_t headerFrame;
+                zmq_msg_init_size(&headerFrame, sizeof(header));
+                std::memcpy(zmq_msg_data(&headerFrame), &header, sizeof(header));
+                int64_t rc = SendFollowing(&headerFrame, ZMQ_SNDMORE);
+                zmq_msg_close(&headerFrame);
+                if (rc < 0) {
+                    return rc;
+                }
+                // a view of the part, sharing its buffer
+                fair::mq::MessagePtr chunk = msgs[i]->Slice(offset, std::min(chunkSize, size - offset));
+                if (!chunk) {
+                    return static_cast<int>(TransferCode::error);
+                }
+                rc = SendFollowing(static_cast<Message*>(chunk.get())->GetMessage(), 0);
+                if (rc < 0) {
+                    return rc;
+                }
+            }
+            // the chunks keep the buffer alive, release the part like zeromq does with sent messages
+            zmq_msg_t* original = static_cast<Message*>(msgs[i].get())->GetMessage();
+            zmq_msg_close(original);
+            zmq_msg_init(original);
+        }
+
+        ++fMessagesTx;
+        fBytesTx += totalSize;
+        return totalSize;
+    }
+
+    // receives a frame of the message that is being received
+    bool ReceiveFollowing(zmq_msg_t* msg, int& more)
+    {
+        if (zmq_msg_recv(msg, fSocket, 0) < 0) {
+            zmq::HandleErrors(fId);
+            return false;
+        }
+        size_t moreSize = sizeof(more);
+        zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+        return true;
+    }
+
+    void DropFollowing(int more)
+    {
+        for (zmq_msg_t frame; more;) {
+            zmq_msg_init(&frame);
+            bool received = ReceiveFollowing(&frame, more);
+            zmq_msg_close(&frame);
+            if (!received) {
+                return;
+            }
+        }
+    }
+
+    int64_t CompleteChunked(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, ChunkAssembly& assembly)
+    {
+        for (auto& part : assembly.fParts) {
+            part->SetTraceContext(assembly.fTrace);
+            msgVec.push_back(std::move(part));
+        }
+        const int64_t totalSize = assembly.fTotal;
+        assembly = ChunkAssembly();
+        ++fMessagesRx;
+        fBytesRx += totalSize;
+        return totalSize;
+    }
+
+    // Chunked messages are assembled over as many calls as it takes, a timed out receive keeps the received chunks.
+    int64_t ReceiveChunked(std::vector<std::unique_ptr<fair::mq::Message>>& msgVec, int flags, int timeout)
+    {
+        const zmq::TransferWait wait(fSocket, ZMQ_POLLIN, fTimeout, timeout);
+        while (true) {
+            zmq_msg_t frame;
+            zmq_msg_init(&frame);
+            while (zmq_msg_recv(&frame, fSocket, flags) < 0) {
+                if (zmq_errno() == EAGAIN || zmq_errno() == EINTR) {
+                    if (fCtx.Interrupted()) {
+                        return static_cast<int>(TransferCode::interrupted);
+                    } else if (wait.Retry()) {
+                        continue;
+                    } else {
+                        return static_cast<int>(TransferCode::timeout);
+                    }
+                } else {
+                    return zmq::HandleErrors(fId);
+                }
+            }
+            int more = 0;
+            size_t moreSize = sizeof(more);
+            zmq_getsockopt(fSocket, ZMQ_RCVMORE, &more, &moreSize);
+
+            const size_t frameSize = zmq_msg_size(&frame);
+            uint64_t magic = 0;
+            if (frameSize >= sizeof(magic)) {
+                std::memcpy(&magic, zmq_msg_data(&frame), sizeof(magic));
+            }
+
+            if (magic == kChunkMagic && frameSize == sizeof(ChunkHeader) && more) {
+                ChunkHeader header;
+                std::memcpy(&header, zmq_msg_data(&frame), sizeof(header));
+                zmq_msg_close(&frame);
+                zmq_msg_t chunk;
+                zmq_msg_init(&chunk);
+                if (!ReceiveFollowing(&chunk, more)) {
+                    zmq_msg_close(&chunk);
+                    return static_cast<int>(TransferCode::error);
+                }
+                DropFollowing(more);
+                const size_t size = zmq_msg_size(&chunk);
+                auto it = fAssemblies.find(header.fSender);
+                if (it == fAssemblies.end() || it->second.fSequence != header.fSequence || header.fPart >= it->second.fParts.size()
+                 || header.fOffset > it->second.fParts[header.fPart]->GetSize() || size > it->second.fParts[header.fPart]->GetSize() - header.fOffset) {
+                    // e.g. the rest of a message whose beginning was sent before this socket connected
+                    FAIRMQ_LOG_RATE_LIMITED(warn, 1000) << "dropping a chunk of an unknown message on " << fId;
+                    zmq_msg_close(&chunk);
+                    continue;
+                }
+                ChunkAssembly& assembly = it->second;
+                const fair::mq::Message& part = *assembly.fParts[header.fPart];
+                tools::CopyPayload(static_cast<char*>(part.GetData()) + header.fOffset, zmq_msg_data(&chunk), size);
+                zmq_msg_close(&chunk);
+                assembly.fRemaining -= std::min<uint64_t>(size, assembly.fRemaining);
+                if (fChunkCallback) {
+                    fChunkCallback(part, header.fPart, header.fOffset, size);
+                }
+                if (assembly.fRemaining == 0) {
+                    int64_t totalSize = CompleteChunked(msgVec, assembly);
+                    fAssemblies.erase(it);
+                    return totalSize;
+                }
+                continue;
+            }
+
+            ChunkDescriptor descriptor;
+            std::vector<uint64_t> sizes;
+            if (magic == kChunkDescriptorMagic && frameSize >= sizeof(descriptor)) {
+                std::memcpy(&descriptor, zmq_msg_data(&frame), sizeof(descriptor));
+                if (frameSize == sizeof(descriptor) + descriptor.fNumParts * sizeof(uint64_t)) {
+                    sizes.resize(descriptor.fNumParts);
+                    std::memcpy(sizes.data(), static_cast<char*>(zmq_msg_data(&frame)) + sizeof(descriptor), sizes.size() * sizeof(uint64_t));
+                } else {
+                    magic = 0;
+                }
+            }
+            zmq_msg_close(&frame);
+            if (magic != kChunkDescriptorMagic || sizes.empty() || (descriptor.fFlags & kChunkInline) != (more != 0)) {
+                FAIRMQ_LOG_RATE_LIMITED(error, 1000) << "received a message without valid chunk descriptor on " << fId << ", the peer has to enable chunked transfers (channel property chunkSize) too";
+                DropFollowing(more);
+                return static_cast<int>(TransferCode::error);
+            }
+
+            if (descriptor.fFlags & kChunkInline) {
+                // the remaining frames of a multipart message are available once the first one has been received
+                const size_t first = msgVec.size();
+                int64_t totalSize = 0;
+                while (more) {
+                    fair::mq::MessagePtr part = std::make_unique<Message>(GetTransport());
+                    if (!ReceiveFollowing(static_cast<Message*>(part.get())->GetMessage(), more)) {
+                        msgVec.resize(first);
+                        return static_cast<int>(TransferCode::error);
+                    }
+                    static_cast<Message*>(part.get())->Realign();
+                    part->SetTraceContext(descriptor.fTrace);
+                    totalSize += part->GetSize();
+                    msgVec.push_back(std::move(part));
+                }
+                if (msgVec.size() - first != sizes.size()) {
+                    LOG(error) << "received " << msgVec.size() - first << " parts instead of the " << sizes.size() << " announced by the chunk descriptor on " << fId;
+                    msgVec.resize(first);
+                    return static_cast<int>(TransferCode::error);
+                }
+                ++fMessagesRx;
+                fBytesRx += totalSize;
+                return totalSize;
+            }
+
+            // a streamed message, allocate the buffers its chunks are assembled in
+            ChunkAssembly& assembly = fAssemblies[descriptor.fSender];
+            if (!assembly.fParts.empty()) {
+                LOG(warn) << "discarding an incomplete chunked message on " << fId << ", the sender started the next one";
+            }
+            assembly = ChunkAssembly();
+            assembly.fSequence = descriptor.fSequence;
+            assembly.fTrace = descriptor.fTrace;
+            try {
+                for (uint64_t size : sizes) {
+                    assembly.fParts.push_back(fChunkTarget ? fChunkTarget->CreateMessage(size) : NewMessage(size));
+                    assembly.fTotal += size;
+                }
+            } catch (const std::exception& e) {
+                LOG(error) << "cannot allocate " << assembly.fTotal << "+ bytes for a chunked message on " << fId << ": " << e.what();
+                fAssemblies.erase(descriptor.fSender);
+                return static_cast<int>(TransferCode::error);
+            }
+            assembly.fRemaining = assembly.fTotal;
+            if (assembly.fRemaining == 0) {
+                int64_t totalSize = CompleteChunked(msgVec, assembly);
+                fAssemblies.erase(descriptor.fSender);
+                return totalSize;
+            }
+        }
+    }
+
     Context& fCtx;
     std::string fId;
     void* fSocket;
     void* fMonitorSocket;
-    std::atomic<unsigned long> fBytesTx;
-    std::atomic<unsigned long> fBytesRx;
-    std::atomic<unsigned long> fMessagesTx;
-    std::atomic<unsigned long> fMessagesRx;
+    TransferCounter fBytesTx;
+    TransferCounter fBytesRx;
+    TransferCounter fMessagesTx;
+    TransferCounter fMessagesRx;
 
     int fTimeout;
+    int fPackParts;
+    bool fTrace;
+    std::unique_ptr<Compressor> fCompressor;
+    int fChunkSize;
+    const uint64_t fChunkSender;
+    uint64_t fChunkSequence;
+    fair::mq::TransportFactory* fChunkTarget;
+    ChunkCallback fChunkCallback;
+    std::unordered_map<uint64_t, ChunkAssembly> fAssemblies; // of the chunked messages in progress, by sender
     mutable unsigned long fConnectedPeersCount;
+    mutable std::vector<int> fConnectionFds; // of the established connections, from the monitor events
+    mutable std::mutex fMonitorMtx; // the peers and RTTs are queried by other threads than the one using the socket
 };
 
 } // namespace fair::mq::zmq
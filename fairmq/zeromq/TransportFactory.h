@@ -11,12 +11,16 @@
 
 #include <fairmq/zeromq/Context.h>
 #include <fairmq/zeromq/Message.h>
+#include <fairmq/zeromq/MessagePool.h>
 #include <fairmq/zeromq/Socket.h>
+#include <fairmq/zeromq/Common.h>
+#include <fairmq/zeromq/EpollSet.h>
 #include <fairmq/zeromq/Poller.h>
 #include <fairmq/zeromq/UnmanagedRegion.h>
 #include <fairmq/TransportFactory.h>
 #include <fairmq/ProgOptions.h>
 
+#include <map>
 #include <memory> // unique_ptr, make_unique
 #include <string>
 #include <vector>
@@ -30,13 +34,36 @@ class TransportFactory final : public fair::mq::TransportFactory
     TransportFactory(const std::string& id = "", const ProgOptions* config = nullptr)
         : fair::mq::TransportFactory(id)
         , fCtx(nullptr)
+        , fPool(nullptr)
+        , fEpollPoller(false)
     {
         int major = 0, minor = 0, patch = 0;
         zmq_version(&major, &minor, &patch);
         LOG(debug) << "Transport: Using ZeroMQ library, version: " << major << "." << minor << "." << patch;
 
         if (config) {
-            fCtx = std::make_unique<Context>(config->GetProperty<int>("io-threads", 1));
+            int numIoThreads = config->GetProperty<int>("io-threads", 1);
+            fCtx = std::make_unique<Context>(numIoThreads);
+            tools::ThreadSettings ioThreads = tools::ParseThreadSettings(config->GetProperty<std::string>("io-cpu-affinity", ""),
+                                                                         config->GetProperty<std::string>("sched-policy", ""),
+                                                                         config->GetProperty<int>("sched-priority", -1));
+            for (const auto& [name, group] : ContextGroups(config->GetProperty<std::vector<std::string>>("zmq-context-group", {}), numIoThreads, ioThreads)) {
+                if (name == "default") {
+                    ConfigureContext(fCtx->GetZmqCtx(), group);
+                } else {
+                    auto ctx = std::make_unique<Context>(group.ioThreads);
+                    ConfigureContext(ctx->GetZmqCtx(), group);
+                    fGroupCtxs.emplace(name, std::move(ctx));
+                }
+                LOG(debug) << "Context group '" << name << "': " << group.ioThreads << " I/O threads, " << group.cpus.size() << " CPUs";
+            }
+            fCtx->SetThreadSettings(std::move(ioThreads));
+            fEpollPoller = ParsePollerBackend(config->GetProperty<std::string>("zmq-poller", "zmq_poll"));
+            if (config->GetProperty<bool>("zmq-msg-pool", false)) {
+                size_t depth = config->GetProperty<size_t>("zmq-msg-pool-depth", 256);
+                fPool = MessagePool::Create(depth);
+                LOG(debug) << "Message payload pool enabled with depth of " << depth << " buffers per size class.";
+            }
         } else {
             LOG(debug) << "fair::mq::ProgOptions not available! Using defaults.";
             fCtx = std::make_unique<Context>(1);
@@ -50,22 +77,27 @@ class TransportFactory final : public fair::mq::TransportFactory
 
     MessagePtr CreateMessage() override
     {
-        return std::make_unique<Message>(this);
+        return std::make_unique<Message>(this, fPool);
     }
 
     MessagePtr CreateMessage(Alignment alignment) override
     {
-        return std::make_unique<Message>(alignment, this);
+        return std::make_unique<Message>(alignment, this, fPool);
     }
 
     MessagePtr CreateMessage(size_t size) override
     {
-        return std::make_unique<Message>(size, this);
+        return std::make_unique<Message>(size, this, fPool);
     }
 
     MessagePtr CreateMessage(size_t size, Alignment alignment) override
     {
-        return std::make_unique<Message>(size, alignment, this);
+        return std::make_unique<Message>(size, alignment, this, fPool);
+    }
+
+    MessagePtr CreateMessage(size_t size, Headroom headroom) override
+    {
+        return std::make_unique<Message>(size, headroom, this, fPool);
     }
 
     MessagePtr CreateMessage(void* data, size_t size, fair::mq::FreeFn* ffn, void* hint = nullptr) override
@@ -83,19 +115,32 @@ class TransportFactory final : public fair::mq::TransportFactory
         return std::make_unique<Socket>(*fCtx, type, name, GetId(), this);
     }
 
+    SocketPtr CreateSocket(const std::string& type, const std::string& name, const std::string& contextGroup) override
+    {
+        if (contextGroup.empty() || contextGroup == "default") {
+            return CreateSocket(type, name);
+        }
+        auto it = fGroupCtxs.find(contextGroup);
+        if (it == fGroupCtxs.end()) {
+            LOG(error) << "Unknown context group '" << contextGroup << "' for socket " << name << ", configure it with --zmq-context-group";
+            throw TransportFactoryError(tools::ToString("Unknown context group '", contextGroup, "' for socket ", name));
+        }
+        return std::make_unique<Socket>(*(it->second), type, name, GetId(), this);
+    }
+
     PollerPtr CreatePoller(const std::vector<Channel>& channels) const override
     {
-        return std::make_unique<Poller>(channels);
+        return std::make_unique<Poller>(channels, fEpollPoller);
     }
 
     PollerPtr CreatePoller(const std::vector<Channel*>& channels) const override
     {
-        return std::make_unique<Poller>(channels);
+        return std::make_unique<Poller>(channels, fEpollPoller);
     }
 
     PollerPtr CreatePoller(const std::unordered_map<std::string, std::vector<Channel>>& channelsMap, const std::vector<std::string>& channelList) const override
     {
-        return std::make_unique<Poller>(channelsMap, channelList);
+        return std::make_unique<Poller>(channelsMap, channelList, fEpollPoller);
     }
 
     UnmanagedRegionPtr CreateUnmanagedRegion(size_t size, RegionCallback callback, const std::string& path = "", int flags = 0, fair::mq::RegionConfig cfg = fair::mq::RegionConfig()) override
@@ -142,14 +187,46 @@ class TransportFactory final : public fair::mq::TransportFactory
 
     Transport GetType() const override { return Transport::ZMQ; }
 
-    void Interrupt() override { fCtx->Interrupt(); }
-    void Resume() override { fCtx->Resume(); }
-    void Reset() override { fCtx->Reset(); }
+    void Interrupt() override
+    {
+        fCtx->Interrupt();
+        for (auto& [name, ctx] : fGroupCtxs) {
+            ctx->Interrupt();
+        }
+    }
+    void Resume() override
+    {
+        fCtx->Resume();
+        for (auto& [name, ctx] : fGroupCtxs) {
+            ctx->Resume();
+        }
+    }
+    void Reset() override
+    {
+        fCtx->Reset();
+        for (auto& [name, ctx] : fGroupCtxs) {
+            ctx->Reset();
+        }
+    }
+
+    /// hit rate of the message payload pool (enabled with --zmq-msg-pool)
+    MessagePoolStats GetMessagePoolStats() const { return fPool ? fPool->GetStats() : MessagePoolStats(); }
 
-    ~TransportFactory() override { LOG(debug) << "Destroying ZeroMQ transport..."; }
+    ~TransportFactory() override
+    {
+        LOG(debug) << "Destroying ZeroMQ transport...";
+        if (fPool) {
+            MessagePoolStats stats = fPool->GetStats();
+            LOG(debug) << "Message payload pool: " << stats.hits << " hits, " << stats.misses << " misses (hit rate " << stats.HitRate() * 100. << "%)";
+            fPool->Close();
+        }
+    }
 
   private:
     std::unique_ptr<Context> fCtx;
+    std::map<std::string, std::unique_ptr<Context>> fGroupCtxs; // additional contexts of the configured context groups
+    MessagePool* fPool; // owned reference, released with Close()
+    bool fEpollPoller;
 };
 
 } // namespace fair::mq::zmq
@@ -9,20 +9,171 @@
 #ifndef FAIR_MQ_ZMQ_UNMANAGEDREGION_H
 #define FAIR_MQ_ZMQ_UNMANAGEDREGION_H
 
+#include <fairmq/tools/Gpu.h>
 #include <fairmq/zeromq/Context.h>
 #include <fairmq/UnmanagedRegion.h>
 
 #include <fairlogger/Logger.h>
 
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef> // size_t
+#include <cstring> // strerror
+#include <fstream>
+#include <limits>
+#include <memory> // shared_ptr
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility> // move
+#include <vector>
 
-#include <sys/mman.h> // mlock
+#include <sys/mman.h> // mlock, mmap
 
 namespace fair::mq::zmq
 {
 
+// memory and pending acknowledgements of a region, shared with the messages of the region,
+// so that the memory stays valid until zeromq releases the last message that refers to it
+struct RegionState
+{
+    RegionState(uint16_t id, size_t size, bool hugepages, int fd = -1, uint64_t fdOffset = 0)
+        : fId(id)
+        , fBuffer(nullptr)
+        , fSize(size)
+        , fMappedSize(0)
+        , fGpuRegistered(false)
+        , fOutstanding(0)
+        , fActive(true)
+    {
+        if (fd >= 0) {
+            // external memory (RegionConfig::fd), the descriptor stays with the caller
+            fMappedSize = fSize;
+            fBuffer = mmap(nullptr, fMappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(fdOffset));
+            if (fBuffer == MAP_FAILED) {
+                int err = errno;
+                fBuffer = nullptr;
+                LOG(error) << "Could not map descriptor " << fd << " (offset " << fdOffset << ") of region " << fId << ". Code: " << err << ", reason: " << strerror(err);
+                throw TransportError(tools::ToString("Could not map descriptor ", fd, " (offset ", fdOffset, ") of region ", fId, ": ", strerror(err)));
+            }
+        } else if (hugepages) {
+            // anonymous huge page mappings must be sized in multiples of the (default) huge page size
+            size_t hugePageSize = DefaultHugePageSize();
+            fMappedSize = ((fSize + hugePageSize - 1) / hugePageSize) * hugePageSize;
+            fBuffer = mmap(nullptr, fMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (fBuffer == MAP_FAILED) {
+                int err = errno;
+                fBuffer = nullptr;
+                LOG(error) << "Could not allocate huge page backed region " << fId << " of " << fMappedSize << " bytes. Code: " << err << ", reason: " << strerror(err)
+                           << ". Are enough huge pages reserved? (see /proc/sys/vm/nr_hugepages)";
+                throw TransportError(tools::ToString("Could not allocate huge page backed region ", fId, ": ", strerror(err),
+                                                     ". Are enough huge pages reserved? (see /proc/sys/vm/nr_hugepages)"));
+            }
+            LOG(debug) << "Region " << fId << " uses huge pages of " << hugePageSize << " bytes, mapped " << fMappedSize << " bytes";
+        } else {
+            fBuffer = malloc(size);
+        }
+    }
+
+    RegionState(const RegionState&) = delete;
+    RegionState(RegionState&&) = delete;
+    RegionState& operator=(const RegionState&) = delete;
+    RegionState& operator=(RegionState&&) = delete;
+
+    // a message refers to a block of the region
+    void Acquire()
+    {
+        std::lock_guard<std::mutex> lock(fMtx);
+        ++fOutstanding;
+    }
+
+    // zeromq no longer needs the block (called from the zeromq I/O thread or the thread closing the message),
+    // the acknowledgement is only queued here and delivered by the ack thread of the region
+    void Release(const RegionBlock& block)
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMtx);
+            --fOutstanding;
+            if (!fActive) {
+                return;
+            }
+            fPending.push_back(block);
+        }
+        fCV.notify_all(); // ack thread and a Deactivate() waiting for the outstanding blocks
+    }
+
+    // wait for the pending acknowledgements, all blocks queued since the last call are returned together
+    /// @return false if the region is deactivated and no acknowledgements are left
+    bool WaitForAcks(std::vector<RegionBlock>& blocks)
+    {
+        std::unique_lock<std::mutex> lock(fMtx);
+        fCV.wait(lock, [&]() { return !fPending.empty() || !fActive; });
+        blocks.clear();
+        blocks.swap(fPending);
+        return !blocks.empty() || fActive;
+    }
+
+    // wait up to linger ms for the outstanding blocks to be released, then stop queueing acknowledgements
+    void Deactivate(uint32_t linger)
+    {
+        std::unique_lock<std::mutex> lock(fMtx);
+        if (fOutstanding > 0) {
+            LOG(debug) << "Region " << fId << ": waiting up to " << linger << " ms for " << fOutstanding << " outstanding blocks";
+            if (!fCV.wait_for(lock, std::chrono::milliseconds(linger), [&]() { return fOutstanding == 0; })) {
+                LOG(debug) << "Region " << fId << ": " << fOutstanding << " blocks still outstanding, their callbacks will not be called";
+            }
+        }
+        fActive = false;
+        lock.unlock();
+        fCV.notify_all();
+    }
+
+    ~RegionState()
+    {
+        if (fGpuRegistered) {
+            try {
+                tools::GpuHostUnregister(fBuffer);
+            } catch (tools::GpuError& e) {
+                LOG(warn) << "Could not unregister region " << fId << " from the GPU runtime: " << e.what();
+            }
+        }
+        if (fMappedSize > 0) {
+            munmap(fBuffer, fMappedSize);
+        } else {
+            free(fBuffer);
+        }
+    }
+
+    const uint16_t fId;
+    void* fBuffer;
+    const size_t fSize;
+    size_t fMappedSize; // non-zero if the buffer is a mapping (huge pages or RegionConfig::fd)
+    bool fGpuRegistered; // RegionConfig::gpuRegister, unregistered with the buffer
+
+  private:
+    static size_t DefaultHugePageSize()
+    {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        while (meminfo >> key) {
+            if (key == "Hugepagesize:") {
+                size_t kb = 0;
+                meminfo >> kb;
+                return kb * 1024;
+            }
+            meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        return 2 * 1024 * 1024;
+    }
+
+    std::mutex fMtx;
+    std::condition_variable fCV;
+    size_t fOutstanding;
+    bool fActive;
+    std::vector<RegionBlock> fPending;
+};
+
 class UnmanagedRegion final : public fair::mq::UnmanagedRegion
 {
     friend class Socket;
@@ -38,25 +189,41 @@ class UnmanagedRegion final : public fair::mq::UnmanagedRegion
                     fair::mq::RegionConfig cfg)
         : fair::mq::UnmanagedRegion(factory)
         , fCtx(ctx)
-        , fId(fCtx.RegionCount())
-        , fBuffer(malloc(size))
-        , fSize(size)
+        , fState(std::make_shared<RegionState>(fCtx.RegionCount(), size, cfg.hugepages, cfg.fd, cfg.fdOffset))
         , fUserFlags(userFlags)
+        , fLinger(cfg.linger)
         , fCallback(std::move(callback))
         , fBulkCallback(std::move(bulkCallback))
     {
+        if (cfg.gpuDevice >= 0) {
+            // zeromq copies the payload of region messages through host memory
+            LOG(error) << "GPU device memory regions are only supported by the shmem transport (region " << GetId() << ")";
+            throw TransportError(tools::ToString("GPU device memory regions are only supported by the shmem transport (region ", GetId(), ")"));
+        }
         if (cfg.lock) {
-            LOG(debug) << "Locking region " << fId << "...";
-            if (mlock(fBuffer, fSize) == -1) {
-                LOG(error) << "Could not lock region " << fId << ". Code: " << errno << ", reason: " << strerror(errno);
+            LOG(debug) << "Locking region " << GetId() << "...";
+            if (mlock(fState->fBuffer, fState->fSize) == -1) {
+                LOG(error) << "Could not lock region " << GetId() << ". Code: " << errno << ", reason: " << strerror(errno);
             }
-            LOG(debug) << "Successfully locked region " << fId << ".";
+            LOG(debug) << "Successfully locked region " << GetId() << ".";
         }
         if (cfg.zero) {
-            LOG(debug) << "Zeroing free memory of region " << fId << "...";
-            memset(fBuffer, 0x00, fSize);
-            LOG(debug) << "Successfully zeroed free memory of region " << fId << ".";
+            LOG(debug) << "Zeroing free memory of region " << GetId() << "...";
+            memset(fState->fBuffer, 0x00, fState->fSize);
+            LOG(debug) << "Successfully zeroed free memory of region " << GetId() << ".";
         }
+        if (cfg.gpuRegister) {
+            try {
+                tools::GpuHostRegister(fState->fBuffer, fState->fSize);
+            } catch (tools::GpuError& e) {
+                LOG(error) << "Could not register region " << GetId() << " with the GPU runtime: " << e.what();
+                throw TransportError(tools::ToString("Could not register region ", GetId(), " with the GPU runtime: ", e.what()));
+            }
+            fState->fGpuRegistered = true;
+            LOG(debug) << "Registered region " << GetId() << " with the GPU runtime (" << tools::GpuRuntime() << ").";
+        }
+
+        fAckThread = std::thread(&UnmanagedRegion::Acks, this);
     }
 
     UnmanagedRegion(const UnmanagedRegion&) = delete;
@@ -64,30 +231,50 @@ class UnmanagedRegion final : public fair::mq::UnmanagedRegion
     UnmanagedRegion& operator=(const UnmanagedRegion&) = delete;
     UnmanagedRegion& operator=(UnmanagedRegion&&) = delete;
 
-    void* GetData() const override { return fBuffer; }
-    size_t GetSize() const override { return fSize; }
-    uint16_t GetId() const override { return fId; }
+    void* GetData() const override { return fState->fBuffer; }
+    size_t GetSize() const override { return fState->fSize; }
+    uint16_t GetId() const override { return fState->fId; }
     int64_t GetUserFlags() const { return fUserFlags; }
-    void SetLinger(uint32_t /* linger */) override { LOG(debug) << "ZeroMQ UnmanagedRegion linger option not implemented. Acknowledgements are local."; }
-    uint32_t GetLinger() const override { LOG(debug) << "ZeroMQ UnmanagedRegion linger option not implemented. Acknowledgements are local."; return 0; }
+    void SetLinger(uint32_t linger) override { fLinger = linger; }
+    uint32_t GetLinger() const override { return fLinger; }
 
     Transport GetType() const override { return Transport::ZMQ; }
 
     ~UnmanagedRegion() override
     {
-        LOG(debug) << "destroying region " << fId;
-        fCtx.RemoveRegion(fId);
-        free(fBuffer);
+        LOG(debug) << "destroying region " << GetId();
+        fState->Deactivate(fLinger);
+        fAckThread.join();
+        fCtx.RemoveRegion(GetId());
     }
 
   private:
+    // delivers the acknowledgements of the released blocks, everything released since the previous
+    // delivery is passed to a single bulk callback (or to the per-block callback, one call per block)
+    void Acks()
+    {
+        fCtx.ApplyThreadSettings("region ack thread");
+        std::vector<RegionBlock> blocks;
+        while (fState->WaitForAcks(blocks)) {
+            if (fBulkCallback) {
+                if (!blocks.empty()) {
+                    fBulkCallback(blocks);
+                }
+            } else if (fCallback) {
+                for (const auto& b : blocks) {
+                    fCallback(b.ptr, b.size, b.hint);
+                }
+            }
+        }
+    }
+
     Context& fCtx;
-    uint16_t fId;
-    void* fBuffer;
-    size_t fSize;
+    std::shared_ptr<RegionState> fState;
     int64_t fUserFlags;
+    uint32_t fLinger;
     RegionCallback fCallback;
     RegionBulkCallback fBulkCallback;
+    std::thread fAckThread;
 };
 
 } // namespace fair::mq::zmq
@@ -7,13 +7,20 @@
  ********************************************************************************/
 
 #include <chrono>
+#include <cstring>
+#include <fairmq/BatchController.h>
 #include <fairmq/Channel.h>
+#include <fairmq/HashRing.h>
+#include <fairmq/HybridSocket.h>
 #include <fairmq/ProgOptions.h>
 #include <fairmq/Tools.h>
 #include <fairmq/TransportFactory.h>
+#include <fairmq/TypedChannel.h>
+#include <fairmq/zeromq/Compression.h>
 #include <gtest/gtest.h>
 #include <string>
 #include <thread>
+#include <unistd.h> // access, getpid
 
 namespace
 {
@@ -77,6 +84,41 @@ TEST(Channel, Validation)
     channel.UpdateRcvKernelSize(1000);
     ASSERT_NO_THROW(channel.Validate());
 
+    channel.UpdateRcvMode("poll");
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+    channel.UpdateRcvMode("hybrid");
+    ASSERT_NO_THROW(channel.Validate());
+
+    channel.UpdateRcvSpinUs(-1);
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+    channel.UpdateRcvSpinUs(50);
+    ASSERT_NO_THROW(channel.Validate());
+
+    channel.UpdateSndBatch(0);
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+    channel.UpdateSndBatch(16);
+    ASSERT_NO_THROW(channel.Validate());
+
+    channel.UpdateSndBatchTimeoutUs(0);
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+    channel.UpdateSndBatchTimeoutUs(100);
+    ASSERT_NO_THROW(channel.Validate());
+
+    channel.UpdateBatchLatencyTargetUs(-1);
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+    channel.UpdateBatchLatencyTargetUs(200);
+    ASSERT_NO_THROW(channel.Validate());
+
+    channel.UpdateMetaFormat("varint");
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+    channel.UpdateMetaFormat("compact");
+    ASSERT_NO_THROW(channel.Validate());
+
+    channel.UpdatePackParts(-1);
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+    channel.UpdatePackParts(256);
+    ASSERT_NO_THROW(channel.Validate());
+
     channel.UpdateRateLogging(-1);
     ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
     channel.UpdateRateLogging(1);
@@ -94,6 +136,190 @@ TEST(Channel, Validation)
     channel2.Invalidate();
     ASSERT_EQ(channel2.IsValid(), false);
     ASSERT_EQ(channel2.Validate(), true);
+
+    Channel channel3("req", "connect", "ipc://abc");
+    channel3.UpdatePriorityLane(true);
+    ASSERT_THROW(channel3.Validate(), Channel::ChannelConfigurationError);
+
+    Channel channel4("push", "connect", "ipc://abc");
+    channel4.UpdateCompression("gzip");
+    ASSERT_THROW(channel4.Validate(), Channel::ChannelConfigurationError);
+    channel4.UpdateCompression("lz4");
+    channel4.UpdatePackParts(64);
+    ASSERT_THROW(channel4.Validate(), Channel::ChannelConfigurationError);
+    channel4.UpdatePackParts(0);
+    ASSERT_EQ(channel4.Validate(), true);
+
+    Channel channel5("sub", "connect", "epgm://eth0;239.192.1.1:5555");
+    ASSERT_EQ(channel5.Validate(), true);
+    channel5.UpdateMulticastRate(-1);
+    ASSERT_THROW(channel5.Validate(), Channel::ChannelConfigurationError);
+    channel5.UpdateMulticastRate(1000000);
+    channel5.UpdatePriorityLane(true);
+    ASSERT_THROW(channel5.Validate(), Channel::ChannelConfigurationError);
+    channel5.UpdatePriorityLane(false);
+    channel5.UpdateType("pull");
+    ASSERT_THROW(channel5.Validate(), Channel::ChannelConfigurationError);
+    channel5.UpdateType("pub");
+    channel5.UpdateAddress("epgm://eth0");
+    ASSERT_EQ(channel5.Validate(), false);
+    channel5.UpdateAddress("norm://239.192.1.1:5555");
+    ASSERT_EQ(channel5.Validate(), true);
+
+    Channel channel6("push", "connect", "ipc://abc");
+    channel6.UpdateOverflow("drop");
+    ASSERT_THROW(channel6.Validate(), Channel::ChannelConfigurationError);
+    channel6.UpdateOverflow("drop-old");
+    channel6.UpdateDeadline(-1);
+    ASSERT_THROW(channel6.Validate(), Channel::ChannelConfigurationError);
+    channel6.UpdateDeadline(100);
+    ASSERT_EQ(channel6.Validate(), true);
+    channel6.UpdateMux(true);
+    ASSERT_EQ(channel6.Validate(), true);
+    channel6.UpdatePriorityLane(true);
+    ASSERT_THROW(channel6.Validate(), Channel::ChannelConfigurationError);
+    channel6.UpdatePriorityLane(false);
+    channel6.UpdateType("router");
+    ASSERT_THROW(channel6.Validate(), Channel::ChannelConfigurationError);
+    channel6.UpdateType("push");
+    channel6.UpdateMux(false);
+    channel6.UpdatePeerTimeout(-1);
+    ASSERT_THROW(channel6.Validate(), Channel::ChannelConfigurationError);
+    channel6.UpdatePeerTimeout(3000);
+    ASSERT_EQ(channel6.Validate(), true);
+
+    Channel channel7("push", "connect", "ipc://abc");
+    channel7.UpdateOverflow("spill");
+    ASSERT_THROW(channel7.Validate(), Channel::ChannelConfigurationError);
+    channel7.UpdateSpillDir("/tmp");
+    ASSERT_EQ(channel7.Validate(), true);
+
+    Channel channel8("push", "connect", "ipc://abc");
+    for (auto const& invalid : {"1/0", "1/x", "1/2.5", "2/3", "rate:0", "rate:", "bytes:-1", "bytes:10k", "some"}) {
+        channel8.UpdateSample(invalid);
+        ASSERT_THROW(channel8.Validate(), Channel::ChannelConfigurationError) << invalid;
+    }
+    for (auto const& valid : {"all", "1/1", "1/100", "rate:0.5", "rate:100", "bytes:1000000"}) {
+        channel8.UpdateSample(valid);
+        ASSERT_EQ(channel8.Validate(), true) << valid;
+    }
+
+    Channel channel9("push", "connect", "ipc://abc");
+    channel9.UpdateMaxBandwidth(-1);
+    ASSERT_THROW(channel9.Validate(), Channel::ChannelConfigurationError);
+    channel9.UpdateMaxBandwidth(100);
+    channel9.UpdateBurst(-1);
+    ASSERT_THROW(channel9.Validate(), Channel::ChannelConfigurationError);
+    channel9.UpdateBurst(10);
+    ASSERT_EQ(channel9.Validate(), true);
+}
+
+TEST(Channel, HashRing)
+{
+    const vector<string> nodes{"tcp://10.0.0.1:5555", "tcp://10.0.0.2:5555", "tcp://10.0.0.3:5555", "tcp://10.0.0.4:5555"};
+    HashRing ring(nodes);
+    ASSERT_EQ(ring.GetNumNodes(), 4U);
+    EXPECT_EQ(HashRing().Lookup(42), -1);
+
+    constexpr int numKeys = 10000;
+    vector<int> counts(nodes.size(), 0);
+    vector<int> owner(numKeys);
+    for (int key = 0; key < numKeys; ++key) {
+        owner[key] = ring.Lookup(key);
+        ASSERT_EQ(owner[key], ring.Lookup(key));
+        ++counts.at(owner[key]);
+    }
+    for (int count : counts) {
+        EXPECT_GT(count, numKeys / 8);
+        EXPECT_LT(count, numKeys / 2);
+    }
+
+    // removing a node moves only its keys
+    HashRing reduced(vector<string>{nodes[0], nodes[1], nodes[3]});
+    const vector<int> reducedIndex{0, 1, -1, 2};
+    for (int key = 0; key < numKeys; ++key) {
+        if (owner[key] != 2) {
+            EXPECT_EQ(reduced.Lookup(key), reducedIndex[owner[key]]);
+        }
+    }
+
+    // an added node only takes keys
+    vector<string> extended(nodes);
+    extended.push_back("tcp://10.0.0.5:5555");
+    HashRing grown(extended);
+    int moved = 0;
+    for (int key = 0; key < numKeys; ++key) {
+        int index = grown.Lookup(key);
+        if (index != owner[key]) {
+            EXPECT_EQ(index, 4);
+            ++moved;
+        }
+    }
+    EXPECT_GT(moved, 0);
+    EXPECT_LT(moved, numKeys / 3);
+}
+
+TEST(Channel, Tuner)
+{
+    ChannelTuner tuner(ChannelSizes{1000, 1000, 0, 0}, 100000, 64 << 20);
+
+    // idle: the configured sizes are kept
+    ASSERT_FALSE(tuner.Sample(0, 0, 0, 0, 1., -1));
+    ASSERT_FALSE(tuner.Pending());
+
+    // 1M msg/s with 1 ms rtt: 12000 messages in two round trips plus 10 ms
+    ASSERT_TRUE(tuner.Sample(0, 0, 1000000, 0, 1., 1000));
+    ASSERT_TRUE(tuner.Pending());
+    ChannelSizes sizes(tuner.Take());
+    ASSERT_FALSE(tuner.Pending());
+    EXPECT_EQ(sizes.sndBufSize, 16384);
+    EXPECT_EQ(sizes.rcvBufSize, 1000);
+    // 2 * 1 MB/s * 1 ms is left to the kernel
+    EXPECT_EQ(sizes.sndKernelSize, 0);
+
+    // 1 GB/s with 10 ms rtt: twice the bandwidth-delay product
+    ASSERT_TRUE(tuner.Sample(1000000000, 0, 1000000, 0, 1., 10000));
+    EXPECT_EQ(tuner.GetSizes().sndKernelSize, 32 << 20);
+    EXPECT_EQ(tuner.GetSizes().sndBufSize, 32768);
+    EXPECT_EQ(tuner.GetSizes().rcvKernelSize, 0);
+
+    // shrinks only when the need falls below a quarter
+    ASSERT_FALSE(tuner.Sample(1000000000, 0, 500000, 0, 1., 10000));
+    ASSERT_TRUE(tuner.Sample(1000000000, 0, 100000, 0, 1., 10000));
+    EXPECT_EQ(tuner.GetSizes().sndBufSize, 4096);
+
+    // bounded by the maxima
+    ASSERT_TRUE(tuner.Sample(100000000000, 0, 100000000, 0, 1., 100000));
+    EXPECT_EQ(tuner.GetSizes().sndBufSize, 100000);
+    EXPECT_EQ(tuner.GetSizes().sndKernelSize, 64 << 20);
+
+    Channel channel("push", "connect", "ipc://abc");
+    channel.UpdateAutoTune(true);
+    channel.UpdateAutoTuneMaxBufSize(0);
+    ASSERT_THROW(channel.Validate(), Channel::ChannelConfigurationError);
+}
+
+auto testRtt(std::string const& transport)
+{
+    using namespace std::chrono_literals;
+
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel ch1("ch1", "pair", factory);
+    ASSERT_EQ(ch1.GetSocket().GetRttUs(), -1);
+    string endpoint("tcp://127.0.0.1:22999"); // a random port of the auto-bind range if taken
+    ASSERT_TRUE(ch1.BindEndpoint(endpoint));
+    Channel ch2("ch2", "pair", factory);
+    ASSERT_TRUE(ch2.Connect(endpoint));
+    std::this_thread::sleep_for(100ms);
+
+#ifdef __linux__
+    EXPECT_GE(ch1.GetSocket().GetRttUs(), 0);
+    EXPECT_GE(ch2.GetSocket().GetRttUs(), 0);
+#endif
 }
 
 auto testConnectedPeers(std::string const& transport)
@@ -125,6 +351,1028 @@ auto testConnectedPeers(std::string const& transport)
     ASSERT_EQ(ch1.GetNumberOfConnectedPeers(), zero);
 }
 
+// exact: counted by the transport (inproc, shmem meta rings), the depth of zeromq pipes is not visible
+auto testQueueDepth(std::string const& transport, bool metaRing, bool exact)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<bool>("shm-meta-ring", metaRing);
+    string const address(tools::ToString(transport == "inproc" ? "inproc://" : "ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+
+    for (int i = 0; i < 5; ++i) {
+        MessagePtr msg(push.NewMessage(10));
+        ASSERT_EQ(push.Send(msg), 10);
+    }
+    Parts parts(push.NewMessage(10), push.NewMessage(10));
+    ASSERT_EQ(push.Send(parts), 20);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bool counted = !exact;
+    int64_t const depth = pull.GetQueueDepth(&counted);
+    ASSERT_EQ(counted, exact);
+    if (exact) {
+        EXPECT_EQ(depth, 6); // the multipart message counts once
+        EXPECT_EQ(push.GetQueueDepth(), 6);
+    } else {
+        EXPECT_GE(depth, 0);
+    }
+
+    MessagePtr msg(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(msg), 10);
+    ASSERT_EQ(pull.Receive(msg), 10);
+    ChannelMetrics const metrics = pull.GetMetrics();
+    EXPECT_EQ(metrics.queueDepthExact, exact);
+    if (exact) {
+        EXPECT_EQ(metrics.queueDepth, 4);
+    } else {
+        EXPECT_GE(metrics.queueDepth, 0);
+    }
+}
+
+auto testReceiveBatch(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    pull.Bind(address);
+    push.Connect(address);
+
+    for (int i = 0; i < 5; ++i) {
+        MessagePtr msg(push.NewMessage(10));
+        ASSERT_EQ(push.Send(msg), 10);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    vector<MessagePtr> msgs;
+    ASSERT_EQ(pull.ReceiveBatch(msgs, 3, 1000), 30);
+    ASSERT_EQ(msgs.size(), 3U);
+    ASSERT_EQ(pull.ReceiveBatch(msgs, 3, 1000), 20);
+    ASSERT_EQ(msgs.size(), 5U);
+    ASSERT_EQ(pull.ReceiveBatch(msgs, 3, 0), static_cast<int>(TransferCode::timeout));
+}
+
+auto testMetrics(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    pull.Bind(address);
+    push.Connect(address);
+
+    ASSERT_FALSE(push.MetricsEnabled());
+    push.EnableMetrics(true);
+    pull.EnableMetrics(true);
+    ASSERT_TRUE(pull.MetricsEnabled());
+
+    for (int i = 0; i < 4; ++i) {
+        MessagePtr msg(push.NewMessage(10));
+        ASSERT_EQ(push.Send(msg), 10);
+    }
+    for (int i = 0; i < 4; ++i) {
+        MessagePtr msg(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msg, 1000), 10);
+    }
+    MessagePtr msg(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(msg, 0), static_cast<int>(TransferCode::timeout));
+
+    ChannelMetrics sent = push.GetMetrics();
+    EXPECT_EQ(sent.name, "push");
+    EXPECT_EQ(sent.transport, transport);
+    EXPECT_EQ(sent.bytesTx, 40U);
+    EXPECT_EQ(sent.messagesTx, 4U);
+    EXPECT_EQ(sent.sendCalls, 4U);
+    EXPECT_EQ(sent.sendFailed, 0U);
+    EXPECT_EQ(sent.receiveCalls, 0U);
+    EXPECT_GT(ChannelMetrics::Percentile(sent.sendLatency, 50), 0U);
+
+    ChannelMetrics received = pull.GetMetrics();
+    EXPECT_EQ(received.bytesRx, 40U);
+    EXPECT_EQ(received.messagesRx, 4U);
+    EXPECT_EQ(received.receiveCalls, 5U);
+    EXPECT_EQ(received.receiveFailed, 1U);
+    EXPECT_GT(received.receiveNs, 0U);
+    EXPECT_EQ(ChannelMetrics::Percentile(received.sendLatency, 50), 0U);
+
+    push.EnableMetrics(false);
+    EXPECT_EQ(push.GetMetrics().sendCalls, 0U);
+}
+
+auto testPriorityLane(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    pull.UpdatePriorityLane(true);
+    push.UpdatePriorityLane(true);
+    pull.Init();
+    push.Init();
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+
+    for (int i = 0; i < 3; ++i) {
+        MessagePtr msg(push.NewMessage(10));
+        ASSERT_EQ(push.Send(msg), 10);
+    }
+    MessagePtr control(push.NewMessage(1));
+    ASSERT_EQ(push.Send(control, Channel::Lane::priority), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // the control message overtakes the data queued before it
+    MessagePtr msg(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(msg, 1000), 1);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(pull.Receive(msg, 1000), 10);
+    }
+    ASSERT_EQ(pull.Receive(msg, 0), static_cast<int>(TransferCode::timeout));
+    EXPECT_EQ(push.GetMessagesTx(), 4U);
+    EXPECT_EQ(pull.GetMessagesRx(), 4U);
+
+    // a lane waits for its message like the channel socket
+    thread sender([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        MessagePtr late(push.NewMessage(2));
+        push.Send(late, Channel::Lane::priority);
+    });
+    EXPECT_EQ(pull.Receive(msg, 2000), 2);
+    sender.join();
+}
+
+TEST(Channel, PriorityLane_zeromq)
+{
+    testPriorityLane("zeromq");
+}
+
+TEST(Channel, PriorityLane_shmem)
+{
+    testPriorityLane("shmem");
+}
+
+auto testMux(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("in[0]", "pull", factory);
+    Channel push("data[3]", "push", factory);
+    pull.UpdateMux(true);
+    push.UpdateMux(true);
+    pull.Init();
+    push.Init();
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+
+    // the routing id frame is not counted and not delivered
+    MessagePtr msg(push.NewMessage(10));
+    ASSERT_EQ(push.Send(msg), 10);
+    Parts parts(push.NewMessage(1), push.NewMessage(2));
+    ASSERT_EQ(push.Send(parts), 3);
+    MessagePtr received(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(received, 1000), 10);
+    EXPECT_EQ(pull.GetReceivedRoute(), 3U);
+    Parts receivedParts;
+    ASSERT_EQ(pull.Receive(receivedParts, 1000), 3);
+    ASSERT_EQ(receivedParts.Size(), 2);
+    EXPECT_EQ(receivedParts.At(1)->GetSize(), 2);
+}
+
+TEST(Channel, Mux_zeromq)
+{
+    testMux("zeromq");
+}
+
+TEST(Channel, Mux_shmem)
+{
+    testMux("shmem");
+}
+
+auto testSharedSend(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    push.UpdateSharedSend(true);
+    push.UpdateSndBufSize(16);
+    pull.Init();
+    push.Init();
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+
+    // the messages of each producer thread arrive in the order they were sent
+    constexpr int numThreads = 4;
+    constexpr int numMsgs = 200;
+    vector<thread> producers;
+    for (int t = 0; t < numThreads; ++t) {
+        producers.emplace_back([&push, t]() {
+            for (int i = 0; i < numMsgs; ++i) {
+                MessagePtr msg(push.NewSimpleMessage(t * numMsgs + i));
+                ASSERT_EQ(push.Send(msg, 1000), sizeof(int));
+            }
+        });
+    }
+    vector<int> next(numThreads, 0);
+    MessagePtr received(pull.NewMessage());
+    for (int i = 0; i < numThreads * numMsgs; ++i) {
+        ASSERT_EQ(pull.Receive(received, 5000), sizeof(int));
+        int const value = *static_cast<int*>(received->GetData());
+        ASSERT_EQ(value % numMsgs, next.at(value / numMsgs)++);
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    EXPECT_EQ(pull.GetMessagesRx(), static_cast<uint64_t>(numThreads * numMsgs));
+    EXPECT_EQ(push.GetMessagesDropped(), 0U);
+
+    Channel invalid("invalid", "pull", factory);
+    invalid.UpdateMethod("bind");
+    invalid.UpdateAddress(address);
+    invalid.UpdateSharedSend(true);
+    ASSERT_THROW(invalid.Validate(), Channel::ChannelConfigurationError);
+}
+
+TEST(Channel, SharedSend_zeromq)
+{
+    testSharedSend("zeromq");
+}
+
+TEST(Channel, SharedSend_shmem)
+{
+    testSharedSend("shmem");
+}
+
+auto testOverflow(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    // without a peer every send would block
+    Channel dropNew("dropNew", "push", factory);
+    dropNew.UpdateOverflow("drop-new");
+    dropNew.Init();
+    ASSERT_TRUE(dropNew.Bind(address + "-new"));
+    for (int i = 0; i < 3; ++i) {
+        MessagePtr msg(dropNew.NewMessage(10));
+        ASSERT_EQ(dropNew.Send(msg, 1000), 0);
+    }
+    EXPECT_EQ(dropNew.GetMessagesDropped(), 3U);
+
+    // drop-old keeps the newest sndBufSize messages and sends them first
+    Channel push("push", "push", factory);
+    push.UpdateOverflow("drop-old");
+    push.UpdateSndBufSize(2);
+    push.UpdateDeadline(1000);
+    push.Init();
+    ASSERT_TRUE(push.Bind(address));
+    for (int i = 1; i <= 5; ++i) {
+        MessagePtr msg(push.NewMessage(i));
+        ASSERT_EQ(push.Send(msg), i);
+    }
+    EXPECT_EQ(push.GetMessagesDropped(), 3U);
+
+    Channel pull("pull", "pull", factory);
+    pull.UpdateDeadline(1000);
+    pull.Init();
+    ASSERT_TRUE(pull.Connect(address));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    MessagePtr last(push.NewMessage(6));
+    ASSERT_EQ(push.Send(last), 6);
+    MessagePtr msg(pull.NewMessage());
+    for (int i = 4; i <= 6; ++i) {
+        ASSERT_EQ(pull.Receive(msg, 1000), i);
+        EXPECT_GT(msg->GetDeadline(), std::chrono::system_clock::now());
+    }
+
+    // expired messages are discarded by the receiver
+    MessagePtr expired(push.NewMessage(7));
+    expired->SetDeadline(std::chrono::system_clock::now() - std::chrono::seconds(1));
+    ASSERT_EQ(push.Send(expired), 7);
+    EXPECT_EQ(pull.Receive(msg, 200), static_cast<int>(TransferCode::timeout));
+    EXPECT_EQ(pull.GetMessagesExpired(), 1U);
+    EXPECT_EQ(pull.GetMetrics().messagesExpired, 1U);
+}
+
+auto testSample(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel push("push", "push", factory);
+    push.UpdateSample("1/3");
+    push.Init();
+    ASSERT_TRUE(push.Bind(address));
+    Channel pull("pull", "pull", factory);
+    pull.Init();
+    ASSERT_TRUE(pull.Connect(address));
+
+    // every third message is sent, the others are released
+    for (int i = 1; i <= 9; ++i) {
+        MessagePtr msg(push.NewMessage(i));
+        if (i % 3 == 1) {
+            ASSERT_EQ(push.Send(msg, 1000), i);
+        } else {
+            ASSERT_EQ(push.Send(msg, 1000), 0);
+            EXPECT_EQ(msg, nullptr);
+        }
+    }
+    EXPECT_EQ(push.GetMessagesSampledOut(), 6U);
+    MessagePtr msg(pull.NewMessage());
+    for (int i = 1; i <= 9; i += 3) {
+        ASSERT_EQ(pull.Receive(msg, 1000), i);
+    }
+    EXPECT_EQ(pull.Receive(msg, 100), static_cast<int>(TransferCode::timeout));
+
+    // a byte budget of 100 B/s passes two 60 byte messages right away (the second one into debt), copies only those
+    Channel bytesPush("bytesPush", "push", factory);
+    bytesPush.UpdateSample("bytes:100");
+    bytesPush.Init();
+    ASSERT_TRUE(bytesPush.Bind(address + "-bytes"));
+    Channel bytesPull("bytesPull", "pull", factory);
+    bytesPull.Init();
+    ASSERT_TRUE(bytesPull.Connect(address + "-bytes"));
+    MessagePtr original(bytesPush.NewMessage(60));
+    ASSERT_EQ(bytesPush.SendCopy(original, 1000), 60);
+    ASSERT_EQ(bytesPush.SendCopy(original, 1000), 60);
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(bytesPush.SendCopy(original, 1000), 0);
+    }
+    EXPECT_EQ(original->GetSize(), 60U);
+    EXPECT_EQ(bytesPush.GetMessagesSampledOut(), 5U);
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(bytesPull.Receive(msg, 1000), 60);
+    }
+    EXPECT_EQ(bytesPull.Receive(msg, 100), static_cast<int>(TransferCode::timeout));
+}
+
+auto testShaping(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    // 1 MB/s with the default burst of 100 ms (100000 bytes)
+    Channel push("push", "push", factory);
+    push.UpdateMaxBandwidth(1);
+    push.Init();
+    ASSERT_TRUE(push.Bind(address));
+    Channel pull("pull", "pull", factory);
+    pull.Init();
+    ASSERT_TRUE(pull.Connect(address));
+
+    // the full bucket passes the first message right away
+    MessagePtr msg(push.NewMessage(100000));
+    ASSERT_EQ(push.Send(msg, 1000), 100000);
+    EXPECT_EQ(push.GetSendsShaped(), 0U);
+
+    // the empty bucket needs ~50 ms for the next one: deferred with timeout 0, sent after the wait otherwise
+    msg = push.NewMessage(50000);
+    ASSERT_EQ(push.Send(msg, 0), static_cast<int>(TransferCode::timeout));
+    ASSERT_NE(msg, nullptr);
+    ASSERT_EQ(push.Send(msg, 1000), 50000);
+    EXPECT_EQ(push.GetSendsShaped(), 1U);
+    EXPECT_GE(push.GetShapingWaitNs(), 40000000U);
+    EXPECT_EQ(push.GetMetrics().sendsShaped, 1U);
+
+    ASSERT_EQ(pull.Receive(msg, 1000), 100000);
+    ASSERT_EQ(pull.Receive(msg, 1000), 50000);
+}
+
+auto testSpill(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+    constexpr int kNumMsgs = 20;
+    string const spillFile(tools::ToString("/tmp/fmq_spill_", getpid(), "_spill"));
+
+    {
+        // without a peer every message is spilled
+        Channel push("spill", "push", factory);
+        push.UpdateOverflow("spill");
+        push.UpdateSpillDir("/tmp");
+        push.UpdateSpillSize(1);
+        push.UpdateSndBufSize(2);
+        push.Init();
+        ASSERT_TRUE(push.Bind(address));
+        for (int i = 1; i <= kNumMsgs; ++i) {
+            MessagePtr msg(push.NewMessage(i * 1000));
+            memset(msg->GetData(), i, msg->GetSize());
+            ASSERT_EQ(push.Send(msg, 1000), i * 1000);
+        }
+        EXPECT_EQ(push.GetNumSpilled(), static_cast<size_t>(kNumMsgs));
+        EXPECT_EQ(push.GetMessagesDropped(), 0U);
+        EXPECT_EQ(access(spillFile.c_str(), F_OK), 0);
+
+        // read back in order once the peer is there, without further sends
+        Channel pull("pull", "pull", factory);
+        pull.Init();
+        ASSERT_TRUE(pull.Connect(address));
+        MessagePtr msg(pull.NewMessage());
+        for (int i = 1; i <= kNumMsgs; ++i) {
+            auto start = chrono::steady_clock::now();
+            int64_t received = 0;
+            while ((received = pull.Receive(msg, 0)) < 0 && chrono::steady_clock::now() - start < chrono::seconds(5)) {
+                push.DispatchSends();
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+            ASSERT_EQ(received, i * 1000);
+            EXPECT_EQ(static_cast<unsigned char*>(msg->GetData())[i * 1000 - 1], i);
+        }
+        EXPECT_EQ(push.GetNumSpilled(), 0U);
+    }
+    // removed with the channel
+    EXPECT_NE(access(spillFile.c_str(), F_OK), 0);
+}
+
+auto testRequestReply(std::string const& transport, std::string const& clientType, std::string const& serverType)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel server("server", serverType, factory);
+    Channel client("client", clientType, factory);
+    ASSERT_TRUE(server.Bind(address));
+    ASSERT_TRUE(client.Connect(address));
+
+    auto text = [](Parts& parts) { return string(static_cast<char*>(parts.At(0)->GetData()), parts.At(0)->GetSize()); };
+    auto textPart = [&](string const& str) {
+        MessagePtr msg(client.NewMessage(str.size()));
+        std::memcpy(msg->GetData(), str.data(), str.size());
+        return msg;
+    };
+
+    // several outstanding requests, replied in reverse order
+    vector<string> replies(3);
+    for (int i = 0; i < 3; ++i) {
+        Parts request(textPart(tools::ToString("request ", i)));
+        ASSERT_EQ(client.Request(request, [&, i](Channel::ReplyStatus status, Parts& reply) {
+            ASSERT_EQ(status, Channel::ReplyStatus::ok);
+            replies.at(i) = text(reply);
+        }, 1000), 9);
+    }
+    EXPECT_EQ(client.GetNumPendingRequests(), 3U);
+    vector<Parts> envelopes;
+    vector<string> requests;
+    for (int i = 0; i < 3; ++i) {
+        Parts request;
+        ASSERT_GE(server.Receive(request, 1000), 0);
+        envelopes.push_back(server.TakeEnvelope(request));
+        requests.push_back(text(request));
+    }
+    for (int i = 2; i >= 0; --i) {
+        Parts reply(textPart("reply to " + requests.at(i)));
+        ASSERT_EQ(server.Reply(envelopes.at(i), reply), static_cast<int64_t>(requests.at(i).size() + 9));
+    }
+    int completed = 0;
+    while (completed < 3) {
+        int rc = client.DispatchReplies(1000);
+        ASSERT_GT(rc, 0);
+        completed += rc;
+    }
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(replies.at(i), tools::ToString("reply to request ", i));
+    }
+    EXPECT_EQ(client.GetNumPendingRequests(), 0U);
+
+    // future of the reply
+    Parts ping(textPart("ping"));
+    auto reply = client.Request(ping, 1000);
+    Parts request;
+    ASSERT_GE(server.Receive(request, 1000), 0);
+    Parts envelope(server.TakeEnvelope(request));
+    Parts pong(textPart("pong"));
+    ASSERT_GE(server.Reply(envelope, pong), 0);
+    ASSERT_EQ(client.DispatchReplies(1000), 1);
+    Parts received(reply.get());
+    EXPECT_EQ(text(received), "pong");
+
+    // timeout, the late reply is ignored
+    Parts late(textPart("late"));
+    auto timedOut = client.Request(late, 50);
+    EXPECT_EQ(client.DispatchReplies(-1), 1);
+    EXPECT_THROW(timedOut.get(), Channel::RequestError);
+    Parts lateRequest;
+    ASSERT_GE(server.Receive(lateRequest, 1000), 0);
+    envelope = server.TakeEnvelope(lateRequest);
+    ASSERT_GE(server.Reply(envelope, lateRequest), 0);
+    EXPECT_EQ(client.DispatchReplies(200), 0);
+}
+
+auto testSendAsync(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    // without a peer the messages wait in the send queue of the channel
+    Channel push("push", "push", factory);
+    push.UpdateSndBufSize(3);
+    push.Init();
+    ASSERT_TRUE(push.Bind(address));
+    vector<pair<Channel::SendStatus, int64_t>> results(5, {Channel::SendStatus::error, -1});
+    for (int i = 1; i <= 4; ++i) {
+        MessagePtr msg(push.NewMessage(i));
+        push.SendAsync(msg, [&, i](Channel::SendStatus status, int64_t bytes) { results.at(i) = {status, bytes}; }, i == 3 ? 50 : -1);
+        EXPECT_EQ(msg, nullptr);
+    }
+    EXPECT_EQ(push.GetNumQueuedSends(), 3U);
+    EXPECT_EQ(results.at(4).first, Channel::SendStatus::dropped);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(push.DispatchSends(), 1);
+    EXPECT_EQ(results.at(3).first, Channel::SendStatus::timeout);
+
+    Channel pull("pull", "pull", factory);
+    pull.Init();
+    ASSERT_TRUE(pull.Connect(address));
+    int completed = 0;
+    while (completed < 2) {
+        int rc = push.DispatchSends(1000);
+        ASSERT_GT(rc, 0);
+        completed += rc;
+    }
+    EXPECT_EQ(push.GetNumQueuedSends(), 0U);
+    MessagePtr msg(pull.NewMessage());
+    for (int i = 1; i <= 2; ++i) {
+        EXPECT_EQ(results.at(i).first, Channel::SendStatus::ok);
+        EXPECT_EQ(results.at(i).second, i);
+        ASSERT_EQ(pull.Receive(msg, 1000), i);
+    }
+
+    // an empty queue sends right away
+    Parts parts(push.NewMessage(5), push.NewMessage(6));
+    int64_t sent = -1;
+    push.SendAsync(parts, [&](Channel::SendStatus status, int64_t bytes) {
+        EXPECT_EQ(status, Channel::SendStatus::ok);
+        sent = bytes;
+    });
+    EXPECT_EQ(sent, 11);
+    Parts received;
+    ASSERT_EQ(pull.Receive(received, 1000), 11);
+    EXPECT_EQ(received.Size(), 2U);
+}
+
+TEST(Channel, SendAsync_zeromq)
+{
+    testSendAsync("zeromq");
+}
+
+TEST(Channel, SendAsync_shmem)
+{
+    testSendAsync("shmem");
+}
+
+TEST(Channel, RequestReply_zeromq)
+{
+    testRequestReply("zeromq", "dealer", "router");
+}
+
+TEST(Channel, RequestReply_shmem)
+{
+    testRequestReply("shmem", "pair", "pair");
+}
+
+TEST(Channel, Overflow_zeromq)
+{
+    testOverflow("zeromq");
+}
+
+TEST(Channel, Overflow_shmem)
+{
+    testOverflow("shmem");
+}
+
+TEST(Channel, Sample_zeromq)
+{
+    testSample("zeromq");
+}
+
+TEST(Channel, Sample_shmem)
+{
+    testSample("shmem");
+}
+
+TEST(Channel, Shaping_zeromq)
+{
+    testShaping("zeromq");
+}
+
+TEST(Channel, Shaping_shmem)
+{
+    testShaping("shmem");
+}
+
+TEST(Channel, Spill_zeromq)
+{
+    testSpill("zeromq");
+}
+
+TEST(Channel, Spill_shmem)
+{
+    testSpill("shmem");
+}
+
+auto testAutoBindEphemeral(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel invalid("invalid", "pull", factory);
+    invalid.UpdateAutoBindStrategy("first-free");
+    ASSERT_THROW(invalid.Validate(), Channel::ChannelConfigurationError);
+
+    // the configured port is taken, so the kernel picks one
+    Channel taken("taken", "pull", factory);
+    ASSERT_TRUE(taken.GetSocket().Bind("tcp://127.0.0.1:*"));
+    const string takenAddress = taken.GetSocket().GetBoundAddress();
+    const string takenPort = takenAddress.substr(takenAddress.rfind(':') + 1);
+    ASSERT_FALSE(takenPort.empty());
+
+    Channel pull("pull", "pull", factory);
+    pull.UpdateAutoBindStrategy("ephemeral");
+    pull.Init();
+    string endpoint("tcp://127.0.0.1:" + takenPort);
+    ASSERT_TRUE(pull.BindEndpoint(endpoint));
+    ASSERT_EQ(endpoint.rfind("tcp://127.0.0.1:", 0), 0);
+    EXPECT_NE(endpoint.substr(endpoint.rfind(':') + 1), takenPort);
+    EXPECT_EQ(pull.GetSocket().GetBoundAddress(), endpoint);
+
+    Channel push("push", "push", factory);
+    push.Init();
+    ASSERT_TRUE(push.Connect(endpoint));
+    MessagePtr msg(push.NewSimpleMessage(42));
+    ASSERT_EQ(push.Send(msg, 1000), static_cast<int>(sizeof(int)));
+    MessagePtr received(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(received, 1000), static_cast<int>(sizeof(int)));
+    EXPECT_EQ(*static_cast<int*>(received->GetData()), 42);
+}
+
+TEST(Channel, AutoBindEphemeral_zeromq)
+{
+    testAutoBindEphemeral("zeromq");
+}
+
+TEST(Channel, AutoBindEphemeral_shmem)
+{
+    testAutoBindEphemeral("shmem");
+}
+
+template<Transport T>
+auto testTypedChannel(std::string const& transport)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+    TypedChannel<T> typedPull(pull);
+    TypedChannel<T> typedPush(push);
+
+    MessagePtr msg(typedPush.NewMessage(sizeof(int)));
+    *static_cast<int*>(TypedChannel<T>::Data(msg)) = 42;
+    ASSERT_EQ(typedPush.Send(msg), sizeof(int));
+    MessagePtr received(typedPull.NewMessage());
+    ASSERT_EQ(typedPull.Receive(received, 1000), sizeof(int));
+    EXPECT_EQ(TypedChannel<T>::Size(received), sizeof(int));
+    EXPECT_EQ(*static_cast<int*>(TypedChannel<T>::Data(received)), 42);
+
+    // the typed and the generic path of a channel can be mixed
+    Parts parts;
+    parts.AddPart(typedPush.NewMessage(10));
+    parts.AddPart(push.NewMessage(20));
+    ASSERT_EQ(typedPush.Send(parts), 30);
+    Parts receivedParts;
+    ASSERT_EQ(pull.Receive(receivedParts, 1000), 30);
+    EXPECT_EQ(receivedParts.Size(), 2);
+    EXPECT_EQ(push.GetMessagesTx(), 2U);
+    EXPECT_EQ(typedPull.Receive(received, 0), static_cast<int>(TransferCode::timeout));
+
+    // other transports and channels that need the generic path are refused
+    constexpr Transport other = T == Transport::ZMQ ? Transport::SHM : Transport::ZMQ;
+    EXPECT_THROW(TypedChannel<other>{push}, TypedChannelError);
+    Channel checksummed("checksummed", "push", factory);
+    checksummed.UpdateChecksum("crc32c");
+    checksummed.Init();
+    EXPECT_THROW(TypedChannel<T>{checksummed}, TypedChannelError);
+}
+
+TEST(Channel, TypedChannel_zeromq)
+{
+    testTypedChannel<Transport::ZMQ>("zeromq");
+}
+
+TEST(Channel, TypedChannel_shmem)
+{
+    testTypedChannel<Transport::SHM>("shmem");
+}
+
+TEST(Channel, Hybrid)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    auto shmem(TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config));
+    auto zeromq(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", shmem);
+    pull.UpdateHybrid(true);
+    pull.UpdateRemoteTransport(zeromq);
+    pull.Init();
+    ASSERT_TRUE(pull.Bind("tcp://127.0.0.1:*"));
+    string const address(pull.GetSocket().GetBoundAddress());
+    ASSERT_FALSE(address.empty());
+    EXPECT_TRUE(HybridSocket::IsLocalAddress(address));
+    EXPECT_FALSE(HybridSocket::IsLocalAddress("tcp://198.51.100.1:5555"));
+
+    // a hybrid peer on this host connects via shmem, a zeromq peer via tcp
+    Channel local("local", "push", shmem);
+    local.UpdateHybrid(true);
+    local.UpdateRemoteTransport(zeromq);
+    local.Init();
+    ASSERT_TRUE(local.Connect(address));
+    Channel remote("remote", "push", zeromq);
+    remote.Init();
+    ASSERT_TRUE(remote.Connect(address));
+
+    MessagePtr msg(local.NewSimpleMessage(1));
+    ASSERT_EQ(local.Send(msg), sizeof(int));
+    MessagePtr received(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(received, 1000), sizeof(int));
+    EXPECT_EQ(received->GetType(), Transport::SHM);
+    EXPECT_EQ(*static_cast<int*>(received->GetData()), 1);
+
+    msg = remote.NewSimpleMessage(2);
+    ASSERT_EQ(remote.Send(msg), sizeof(int));
+    ASSERT_EQ(pull.Receive(received, 1000), sizeof(int));
+    EXPECT_EQ(received->GetType(), Transport::ZMQ);
+    EXPECT_EQ(*static_cast<int*>(received->GetData()), 2);
+
+    Parts parts;
+    parts.AddPart(local.NewSimpleMessage(3));
+    parts.AddPart(local.NewSimpleMessage(4));
+    ASSERT_EQ(local.Send(parts), 2 * sizeof(int));
+    Parts receivedParts;
+    ASSERT_EQ(pull.Receive(receivedParts, 1000), 2 * sizeof(int));
+    ASSERT_EQ(receivedParts.Size(), 2);
+    EXPECT_EQ(*static_cast<int*>(receivedParts[1].GetData()), 4);
+
+    ASSERT_EQ(pull.Receive(received, 0), static_cast<int>(TransferCode::timeout));
+    EXPECT_EQ(pull.GetMessagesRx(), 3U);
+}
+
+auto testChecksum(std::string const& transport, std::string const& checksum)
+{
+    if (!tools::ChecksumAvailable(tools::ParseChecksumType(checksum))) {
+        GTEST_SKIP() << checksum << " checksums not built";
+    }
+
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<bool>("shm-monitor", true);
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    pull.UpdateChecksum(checksum);
+    push.UpdateChecksum(checksum);
+    pull.Init();
+    push.Init();
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+
+    // single part (larger than the lanes of the accelerated crc32c) and multipart messages
+    MessagePtr msg(push.NewMessage(100000));
+    std::memset(msg->GetData(), 'a', msg->GetSize());
+    ASSERT_EQ(push.Send(msg), 100000);
+    MessagePtr received(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(received, 1000), 100000);
+    EXPECT_EQ(static_cast<char*>(received->GetData())[99999], 'a');
+
+    Parts parts;
+    parts.AddPart(push.NewSimpleMessage(42));
+    parts.AddPart(push.NewMessage(0));
+    ASSERT_EQ(push.Send(parts), sizeof(int));
+    Parts receivedParts;
+    ASSERT_EQ(pull.Receive(receivedParts, 1000), sizeof(int));
+    ASSERT_EQ(receivedParts.Size(), 2);
+    EXPECT_EQ(*static_cast<int*>(receivedParts[0].GetData()), 42);
+    EXPECT_EQ(pull.GetMessagesCorrupt(), 0U);
+
+    // a corrupted message, sent with a wrong checksum by a channel without checksums
+    Channel plain("plain", "push", factory);
+    plain.Init();
+    ASSERT_TRUE(plain.Connect(address));
+    Parts corrupt;
+    corrupt.AddPart(plain.NewSimpleMessage(42));
+    MessagePtr frame(plain.NewMessage(2 * sizeof(uint64_t)));
+    const uint64_t sums[] = { 0x464d51435300ULL | static_cast<uint64_t>(tools::ParseChecksumType(checksum)),
+                              tools::Checksum(tools::ParseChecksumType(checksum), corrupt[0].GetData(), corrupt[0].GetSize()) ^ 1 };
+    std::memcpy(frame->GetData(), sums, sizeof(sums));
+    corrupt.AddPart(std::move(frame));
+    ASSERT_GE(plain.Send(corrupt), 0);
+    EXPECT_EQ(pull.Receive(received, 1000), static_cast<int>(TransferCode::error));
+    EXPECT_EQ(pull.GetMessagesCorrupt(), 1U);
+    EXPECT_EQ(pull.GetMetrics().messagesCorrupt, 1U);
+}
+
+TEST(Channel, Checksum_crc32c_zeromq)
+{
+    testChecksum("zeromq", "crc32c");
+}
+
+TEST(Channel, Checksum_crc32c_shmem)
+{
+    testChecksum("shmem", "crc32c");
+}
+
+TEST(Channel, Checksum_xxh3_zeromq)
+{
+    testChecksum("zeromq", "xxh3");
+}
+
+auto testCompression(std::string const& codec, int threads)
+{
+    if (!zmq::Compressor::Available(zmq::Compressor::ParseCodec(codec))) {
+        GTEST_SKIP() << codec << " compression not built";
+    }
+
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    string const address(tools::ToString("ipc://", config.GetProperty<string>("session")));
+    auto factory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+
+    Channel pull("pull", "pull", factory);
+    Channel push("push", "push", factory);
+    for (auto ch : {&pull, &push}) {
+        ch->UpdateCompression(codec);
+        ch->UpdateCompressionThreads(threads);
+        ch->UpdateCompressionMinSize(100);
+        ch->Init();
+    }
+    pull.Bind(address);
+    push.Connect(address);
+
+    // a small part (sent as it is), a compressible part of several blocks and an incompressible one
+    const size_t sizes[] = { 10, 3 * zmq::Compressor::kBlockSize + 7, 5000 };
+    Parts parts;
+    for (size_t size : sizes) {
+        parts.AddPart(push.NewMessage(size));
+        auto data = static_cast<unsigned char*>(parts.fParts.back()->GetData());
+        uint32_t random = size;
+        for (size_t i = 0; i < size; ++i) {
+            random = random * 1664525 + 1013904223;
+            data[i] = size == sizes[2] ? random >> 24 : i % 7;
+        }
+    }
+    Parts copy;
+    for (auto& part : parts) {
+        copy.AddPart(push.NewMessage(part->GetSize()));
+        std::memcpy(copy.fParts.back()->GetData(), part->GetData(), part->GetSize());
+    }
+    const int64_t total = sizes[0] + sizes[1] + sizes[2];
+    ASSERT_EQ(push.Send(parts), total);
+
+    Parts received;
+    ASSERT_EQ(pull.Receive(received, 1000), total);
+    ASSERT_EQ(received.Size(), 3);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(received[i].GetSize(), sizes[i]);
+        EXPECT_EQ(std::memcmp(received[i].GetData(), copy[i].GetData(), sizes[i]), 0);
+    }
+
+    // single part
+    MessagePtr msg(push.NewMessage(copy[1].GetSize()));
+    std::memcpy(msg->GetData(), copy[1].GetData(), copy[1].GetSize());
+    ASSERT_EQ(push.Send(msg), static_cast<int64_t>(sizes[1]));
+    MessagePtr rmsg(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(rmsg, 1000), static_cast<int64_t>(sizes[1]));
+    EXPECT_EQ(std::memcmp(rmsg->GetData(), copy[1].GetData(), sizes[1]), 0);
+
+    ChannelMetrics sent = push.GetMetrics();
+    EXPECT_TRUE(sent.compressed);
+    EXPECT_EQ(sent.rawBytesTx, static_cast<uint64_t>(total) + sizes[1]);
+    EXPECT_GT(sent.CompressionRatioTx(), 10.);
+    EXPECT_GT(sent.compressNs, 0U);
+    ChannelMetrics rcvd = pull.GetMetrics();
+    EXPECT_EQ(rcvd.rawBytesRx, sent.rawBytesTx);
+    EXPECT_EQ(rcvd.wireBytesRx, sent.wireBytesTx);
+    EXPECT_GT(rcvd.decompressNs, 0U);
+}
+
+TEST(Channel, Compression_lz4)
+{
+    testCompression("lz4", 1);
+}
+
+TEST(Channel, Compression_zstd_threads)
+{
+    testCompression("zstd", 3);
+}
+
+TEST(Channel, Metrics_zeromq)
+{
+    testMetrics("zeromq");
+}
+
+TEST(Channel, Metrics_shmem)
+{
+    testMetrics("shmem");
+}
+
+TEST(Channel, HandlerMetrics)
+{
+    ChannelMetricsRecorder recorder;
+    ChannelMetrics idle;
+    recorder.Fill(idle);
+    EXPECT_EQ(idle.handlerCalls, 0U);
+    EXPECT_EQ(idle.BusyRatio(), 0.);
+
+    // busy for 10 ms of the first 40 ms
+    auto start = std::chrono::steady_clock::now() - std::chrono::milliseconds(40);
+    recorder.RecordHandler(start, start + std::chrono::milliseconds(5));
+    recorder.RecordHandler(start + std::chrono::milliseconds(20), start + std::chrono::milliseconds(25));
+
+    ChannelMetrics metrics;
+    recorder.Fill(metrics);
+    EXPECT_EQ(metrics.handlerCalls, 2U);
+    EXPECT_EQ(metrics.handlerNs, 10000000U);
+    EXPECT_GE(metrics.handlingNs, 40000000U);
+    EXPECT_GT(metrics.BusyRatio(), 0.);
+    EXPECT_LE(metrics.BusyRatio(), 0.25);
+    EXPECT_EQ(ChannelMetrics::Percentile(metrics.handlerLatency, 50), uint64_t(1) << 23);
+}
+
+TEST(Channel, ReceiveBatch_zeromq)
+{
+    testReceiveBatch("zeromq");
+}
+
+TEST(Channel, ReceiveBatch_shmem)
+{
+    testReceiveBatch("shmem");
+}
+
+TEST(Channel, Rtt_zeromq)
+{
+    testRtt("zeromq");
+}
+
+TEST(Channel, Rtt_shmem)
+{
+    testRtt("shmem");
+}
+
 TEST(Channel, GetNumberOfConnectedPeers_zeromq)
 {
     testConnectedPeers("zeromq");
@@ -135,4 +1383,64 @@ TEST(Channel, GetNumberOfConnectedPeers_shmem)
     testConnectedPeers("shmem");
 }
 
+TEST(Channel, BatchController)
+{
+    using namespace std::chrono_literals;
+    using clock = BatchController::clock;
+
+    BatchController controller(200, 64);
+    EXPECT_EQ(controller.Size(), 1U); // no rate yet
+    EXPECT_EQ(controller.TimeoutUs(), 160);
+
+    // 10 us between messages: 0.8 * 200 us fit 16 gaps
+    clock::time_point now = clock::now();
+    for (int i = 0; i < 10; ++i) {
+        controller.OnArrival(now);
+        now += 10us;
+    }
+    EXPECT_EQ(controller.Size(), 17U);
+
+    // 10 times the rate: capped by the maximum size
+    for (int i = 0; i < 100; ++i) {
+        controller.OnArrival(now);
+        now += 1us;
+    }
+    EXPECT_EQ(controller.Size(), 64U);
+
+    // batches that waited longer than the target shrink the share of the target, on time batches restore it
+    controller.OnFlush(now - 300us, now);
+    EXPECT_EQ(controller.TimeoutUs(), 128);
+    for (int i = 0; i < 20; ++i) {
+        controller.OnFlush(now - 100us, now);
+    }
+    EXPECT_EQ(controller.TimeoutUs(), 180);
+
+    // a low rate falls back to single messages
+    for (int i = 0; i < 100; ++i) {
+        controller.OnArrival(now);
+        now += 1ms;
+    }
+    EXPECT_EQ(controller.Size(), 1U);
+}
+
+TEST(Channel, QueueDepth_zeromq)
+{
+    testQueueDepth("zeromq", false, false);
+}
+
+TEST(Channel, QueueDepth_shmem)
+{
+    testQueueDepth("shmem", false, false);
+}
+
+TEST(Channel, QueueDepth_shmem_meta_ring)
+{
+    testQueueDepth("shmem", true, true);
+}
+
+TEST(Channel, QueueDepth_inproc)
+{
+    testQueueDepth("inproc", false, true);
+}
+
 } /* namespace */
@@ -0,0 +1,158 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/Channel.h>
+#include <fairmq/Coroutine.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Unique.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+using namespace fair::mq::coro;
+
+Task<int> Add(Executor& exec, int a, int b)
+{
+    co_await exec.Timer(chrono::milliseconds(1));
+    co_return a + b;
+}
+
+TEST(Coroutine, TaskAndTimer)
+{
+    Executor exec;
+    vector<int> order;
+    auto flow = [&](int id, int delayMs) -> Task<> {
+        co_await exec.Timer(chrono::milliseconds(delayMs));
+        order.push_back(id);
+        order.push_back(co_await Add(exec, id, 10));
+    };
+    auto start = chrono::steady_clock::now();
+    exec.Spawn(flow(1, 60));
+    exec.Spawn(flow(2, 20));
+    exec.Run([]() { return false; });
+    EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(60));
+    EXPECT_EQ(order, (vector<int>{2, 12, 1, 11}));
+    EXPECT_EQ(exec.GetNumTasks(), 0);
+}
+
+TEST(Coroutine, Exception)
+{
+    Executor exec;
+    auto thrower = [&]() -> Task<int> {
+        co_await exec.Yield();
+        throw runtime_error("flow failed");
+    };
+    // the lambdas have to outlive their coroutines, which access the captures through them
+    bool caught = false;
+    auto catcher = [&]() -> Task<> {
+        try {
+            co_await thrower();
+        } catch (const runtime_error&) {
+            caught = true;
+        }
+    };
+    exec.Spawn(catcher());
+    exec.Run([]() { return false; });
+    EXPECT_TRUE(caught);
+
+    auto passer = [&]() -> Task<> { co_await thrower(); };
+    exec.Spawn(passer());
+    EXPECT_THROW(exec.Run([]() { return false; }), runtime_error);
+}
+
+void PushPull(const string& transport, const string& address)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    Channel push("data", "push", factory);
+    Channel pull("data", "pull", factory);
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+
+    constexpr int numMessages = 1000;
+    Executor exec;
+    int received = 0;
+    int timeouts = 0;
+
+    auto consumer = [&]() -> Task<> {
+        // nothing is sent yet, the receive times out without blocking the producer
+        auto msg(pull.NewMessage());
+        if (co_await exec.ReceiveAsync(pull, msg, 20) == static_cast<int64_t>(TransferCode::timeout)) {
+            ++timeouts;
+        }
+        for (int i = 0; i < numMessages; ++i) {
+            if (co_await exec.ReceiveAsync(pull, msg, 5000) != sizeof(int)) {
+                co_return;
+            }
+            EXPECT_EQ(*static_cast<int*>(msg->GetData()), i);
+            ++received;
+        }
+    };
+    auto producer = [&]() -> Task<> {
+        co_await exec.Timer(chrono::milliseconds(50));
+        for (int i = 0; i < numMessages; ++i) {
+            auto msg(push.NewSimpleMessage(i));
+            EXPECT_EQ(co_await exec.SendAsync(push, msg), sizeof(int));
+        }
+    };
+    exec.Spawn(consumer());
+    exec.Spawn(producer());
+    exec.Run([]() { return false; });
+
+    EXPECT_EQ(timeouts, 1);
+    EXPECT_EQ(received, numMessages);
+}
+
+TEST(Coroutine, PushPullInproc)
+{
+    PushPull("inproc", "inproc://" + tools::Uuid());
+}
+
+TEST(Coroutine, PushPullZeroMQ)
+{
+    PushPull("zeromq", "ipc://test_coroutine_push_pull_zeromq");
+}
+
+TEST(Coroutine, PushPullShmem)
+{
+    PushPull("shmem", "ipc://test_coroutine_push_pull_shmem");
+}
+
+TEST(Coroutine, Stop)
+{
+    Executor exec;
+    bool stop = false;
+    bool destroyed = false;
+    auto flow = [&]() -> Task<> {
+        tools::CallOnDestruction cod([&]() { destroyed = true; });
+        co_await exec.Timer(chrono::milliseconds(10));
+        stop = true;
+        co_await exec.Timer(chrono::hours(1));
+    };
+    exec.Spawn(flow());
+    exec.Run([&]() { return stop; });
+    EXPECT_EQ(exec.GetNumTasks(), 1);
+    EXPECT_FALSE(destroyed);
+    exec.Clear();
+    EXPECT_TRUE(destroyed);
+}
+
+} // namespace
@@ -155,6 +155,238 @@ class Config : public ::testing::Test
     }
 };
 
+auto InitToDeviceReady(Device& device) -> void
+{
+    device.ChangeStateOrThrow(Transition::InitDevice);
+    device.WaitForState(State::InitializingDevice);
+    device.ChangeStateOrThrow(Transition::CompleteInit);
+    device.WaitForState(State::Initialized);
+    device.ChangeStateOrThrow(Transition::Bind);
+    device.WaitForState(State::Bound);
+    device.ChangeStateOrThrow(Transition::Connect);
+    device.WaitForState(State::DeviceReady);
+}
+
+auto ResetToIdle(Device& device) -> void
+{
+    device.ChangeStateOrThrow(Transition::ResetDevice);
+    device.WaitForState(State::Idle);
+}
+
+TEST_F(Config, WarmReset)
+{
+    ProgOptions config;
+    config.ParseAll(vector<string>{"dummy", "--id", "test", "--color", "false"}, true);
+    config.SetProperty("transport", string("zeromq"));
+    config.SetProperty("warm-reset", true);
+
+    Device device;
+    device.SetConfig(config);
+
+    Channel data;
+    data.UpdateType("pull");
+    data.UpdateMethod("bind");
+    data.UpdateAddress("tcp://127.0.0.1:*");
+    device.AddChannel("data", std::move(data));
+    Channel ctrl;
+    ctrl.UpdateType("push");
+    ctrl.UpdateMethod("connect");
+    ctrl.UpdateAddress("tcp://127.0.0.1:5559");
+    device.AddChannel("ctrl", std::move(ctrl));
+
+    thread t(&Device::RunStateMachine, &device);
+
+    InitToDeviceReady(device);
+    const string dataAddress = device.GetChannel("data").GetAddress();
+
+    // messages queued in a kept channel survive the reset
+    auto factory = TransportFactory::CreateTransportFactory("zeromq");
+    Channel sender{"sender", "push", factory};
+    sender.Connect(dataAddress);
+    auto send = [&](const string& text) {
+        MessagePtr msg(sender.NewSimpleMessage(text));
+        ASSERT_EQ(sender.Send(msg), static_cast<int64_t>(text.size()));
+    };
+    auto receive = [&]() {
+        MessagePtr msg(device.GetChannel("data").NewMessage());
+        if (device.GetChannel("data").Receive(msg, 1000) < 0) {
+            return string();
+        }
+        return string(static_cast<char*>(msg->GetData()), msg->GetSize());
+    };
+    send("before reset");
+    this_thread::sleep_for(chrono::milliseconds(100));
+    ResetToIdle(device);
+
+    // unchanged configuration: the channels are kept
+    InitToDeviceReady(device);
+    EXPECT_EQ(device.GetChannel("data").GetAddress(), dataAddress);
+    EXPECT_EQ(receive(), "before reset");
+    send("second run");
+    this_thread::sleep_for(chrono::milliseconds(100));
+    ResetToIdle(device);
+
+    // changed channel: only this one is recreated
+    config.SetProperty("chans.ctrl.0.address", string("tcp://127.0.0.1:5560"));
+    InitToDeviceReady(device);
+    EXPECT_EQ(device.GetChannel("ctrl").GetAddress(), "tcp://127.0.0.1:5560");
+    EXPECT_EQ(receive(), "second run");
+    ResetToIdle(device);
+
+    // changed transport configuration: everything is recreated
+    config.SetProperty("io-threads", 2);
+    InitToDeviceReady(device);
+    EXPECT_EQ(device.GetChannel("data").GetAddress(), dataAddress);
+    send("new transport");
+    EXPECT_EQ(receive(), "new transport");
+    ResetToIdle(device);
+
+    device.ChangeStateOrThrow(Transition::End);
+    if (t.joinable()) {
+        t.join();
+    }
+}
+
+TEST_F(Config, ChannelRef)
+{
+    ProgOptions config;
+    config.ParseAll(vector<string>{"dummy", "--id", "test", "--color", "false"}, true);
+    config.SetProperty("transport", string("zeromq"));
+
+    Device device;
+    device.SetConfig(config);
+
+    for (int i = 0; i < 2; ++i) {
+        Channel data;
+        data.UpdateType("pair");
+        data.UpdateMethod(i == 0 ? "bind" : "connect");
+        data.UpdateAddress("inproc://channel-ref");
+        device.AddChannel("data", std::move(data));
+    }
+
+    thread t(&Device::RunStateMachine, &device);
+
+    InitToDeviceReady(device);
+
+    ChannelRef data = device.GetChannelRef("data");
+    ASSERT_EQ(data.size(), 2);
+    EXPECT_EQ(&*data[1], &device.GetChannel("data", 1));
+    SubChannelRef sender = device.GetChannelRef("data", 1);
+    EXPECT_EQ(&*sender, &*data.at(1));
+    EXPECT_THROW(data.at(2), out_of_range);
+    EXPECT_THROW(device.GetChannelRef("nonexistent"), out_of_range);
+    EXPECT_FALSE(ChannelRef());
+
+    MessagePtr out(device.NewSimpleMessageFor(sender, string("ref")));
+    ASSERT_EQ(device.Send(out, sender, 1000), 3);
+    MessagePtr in(device.NewMessageFor(data[0]));
+    ASSERT_EQ(device.Receive(in, data[0], 1000), 3);
+    EXPECT_EQ(string(static_cast<char*>(in->GetData()), in->GetSize()), "ref");
+
+    ResetToIdle(device);
+    device.ChangeStateOrThrow(Transition::End);
+    if (t.joinable()) {
+        t.join();
+    }
+}
+
+TEST_F(Config, Mux)
+{
+    ProgOptions config;
+    config.ParseAll(vector<string>{"dummy", "--id", "test", "--color", "false"}, true);
+    config.SetProperty("transport", string("zeromq"));
+
+    Device device;
+    device.SetConfig(config);
+
+    Channel in;
+    in.UpdateType("pull");
+    in.UpdateMethod("bind");
+    in.UpdateAddress("inproc://mux");
+    in.UpdateMux(true);
+    device.AddChannel("in", std::move(in));
+    for (int i = 0; i < 3; ++i) {
+        Channel data;
+        data.UpdateType("push");
+        data.UpdateMethod("connect");
+        data.UpdateAddress("inproc://mux");
+        data.UpdateMux(true);
+        device.AddChannel("data", std::move(data));
+    }
+
+    thread t(&Device::RunStateMachine, &device);
+
+    InitToDeviceReady(device);
+
+    // the subchannels share one connection
+    EXPECT_EQ(&device.GetChannel("data", 0).GetSocket(), &device.GetChannel("data", 2).GetSocket());
+
+    for (int i : {2, 0, 1}) {
+        MessagePtr out(device.NewSimpleMessageFor("data", i, tools::ToString("route ", i)));
+        ASSERT_EQ(device.Send(out, "data", i, 1000), 7);
+    }
+    for (int i : {2, 0, 1}) {
+        MessagePtr msg(device.NewMessageFor("in", 0));
+        ASSERT_EQ(device.Receive(msg, "in", 0, 1000), 7);
+        EXPECT_EQ(device.GetChannel("in").GetReceivedRoute(), static_cast<uint32_t>(i));
+        EXPECT_EQ(string(static_cast<char*>(msg->GetData()), msg->GetSize()), tools::ToString("route ", i));
+    }
+
+    ResetToIdle(device);
+    device.ChangeStateOrThrow(Transition::End);
+    if (t.joinable()) {
+        t.join();
+    }
+}
+
+TEST_F(Config, Route)
+{
+    ProgOptions config;
+    config.ParseAll(vector<string>{"dummy", "--id", "test", "--color", "false"}, true);
+    config.SetProperty("transport", string("zeromq"));
+
+    Device device;
+    device.SetConfig(config);
+
+    for (int i = 0; i < 3; ++i) {
+        Channel in;
+        in.UpdateType("pull");
+        in.UpdateMethod("bind");
+        in.UpdateAddress(tools::ToString("inproc://route", i));
+        device.AddChannel("in", std::move(in));
+        Channel data;
+        data.UpdateType("push");
+        data.UpdateMethod("connect");
+        data.UpdateAddress(tools::ToString("inproc://route", i));
+        data.UpdateRoute("hash");
+        device.AddChannel("data", std::move(data));
+    }
+    device.SetRouteKey("data", [](const Message& header) { return static_cast<uint64_t>(static_cast<const char*>(header.GetData())[0]); });
+
+    thread t(&Device::RunStateMachine, &device);
+
+    InitToDeviceReady(device);
+
+    EXPECT_THROW(device.RouteIndex(MessagePtr(device.NewMessage()), "in"), out_of_range);
+    // messages with the same key go to the same subchannel
+    for (int n = 0; n < 2; ++n) {
+        for (char key : {'a', 'b', 'c', 'd'}) {
+            MessagePtr msg(device.NewSimpleMessageFor("data", 0, string(1, key)));
+            const int index = device.RouteIndex(msg, "data");
+            ASSERT_EQ(device.Route(msg, "data", 1000), 1);
+            MessagePtr received(device.NewMessageFor("in", index));
+            ASSERT_EQ(device.Receive(received, "in", index, 1000), 1);
+            EXPECT_EQ(static_cast<char*>(received->GetData())[0], key);
+        }
+    }
+
+    ResetToIdle(device);
+    device.ChangeStateOrThrow(Transition::End);
+    if (t.joinable()) {
+        t.join();
+    }
+}
+
 TEST_F(Config, SetConfig)
 {
     string transport = "zeromq";
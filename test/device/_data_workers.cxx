@@ -0,0 +1,161 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "../helper/ControlDevice.h"
+
+#include <fairmq/Device.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <cstring> // memcpy
+#include <map>
+#include <memory> // shared_ptr
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+constexpr int kNumSubChannels = 4;
+constexpr int kNumMessages = 100; // per subchannel
+
+// receives on two channels ("data" and "data2") with kNumSubChannels / 2 subchannels each
+class DataWorkersReceiver : public Device
+{
+  public:
+    DataWorkersReceiver(bool threadSafe)
+    {
+        for (const string name : {"data", "data2"}) {
+            OnData(name, [this, name](MessagePtr& msg, int index) { return HandleData(msg, tools::ToString(name, "[", index, "]")); });
+            SetDataThreadSafe(name, threadSafe);
+        }
+    }
+
+    bool HandleData(MessagePtr& msg, const string& subChannel)
+    {
+        int seq = 0;
+        memcpy(&seq, msg->GetData(), sizeof(seq));
+        {
+            lock_guard<mutex> lock(fMtx);
+            fThreads[subChannel].insert(this_thread::get_id());
+            fAllThreads.insert(this_thread::get_id());
+            // callbacks of a subchannel are called in order
+            if (seq != fNext[subChannel]++) {
+                fOutOfOrder = true;
+            }
+        }
+        return ++fReceived < kNumSubChannels * kNumMessages;
+    }
+
+    mutex fMtx;
+    map<string, set<thread::id>> fThreads;
+    set<thread::id> fAllThreads;
+    map<string, int> fNext;
+    bool fOutOfOrder = false;
+    atomic<int> fReceived{0};
+};
+
+/// @param transports transports of the "data" and "data2" channels
+void RunDataWorkers(const array<string, 2>& transports, int workers, bool threadSafe, size_t expectedThreads)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<string>("transport", transports.at(0));
+    config.SetProperty<int>("data-workers", workers);
+    config.SetProperty<bool>("shm-monitor", true);
+
+    DataWorkersReceiver device(threadSafe);
+    device.SetConfig(config);
+
+    vector<string> addresses;
+    for (int i = 0; i < kNumSubChannels; ++i) {
+        const string& transport = transports.at(i % 2);
+        addresses.push_back(tools::ToString("ipc://test_data_workers_", transports.at(0), "_", transports.at(1), "_", i));
+        Channel channel("pull", "bind", addresses.back());
+        channel.UpdateTransport(transport);
+        channel.UpdateRateLogging(0);
+        device.AddChannel(i % 2 == 0 ? "data" : "data2", std::move(channel));
+    }
+
+    thread sender([&]() {
+        map<string, shared_ptr<TransportFactory>> factories;
+        vector<Channel> channels;
+        channels.reserve(kNumSubChannels);
+        for (int i = 0; i < kNumSubChannels; ++i) {
+            const string& transport = transports.at(i % 2);
+            if (factories.count(transport) == 0) {
+                factories.emplace(transport, TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+            }
+            channels.emplace_back(tools::ToString("push", i), "push", factories.at(transport));
+            channels.back().Connect(addresses.at(i));
+        }
+        for (int n = 0; n < kNumMessages; ++n) {
+            for (auto& channel : channels) {
+                auto msg(channel.NewMessage(sizeof(n)));
+                memcpy(msg->GetData(), &n, sizeof(n));
+                ASSERT_EQ(channel.Send(msg), static_cast<int64_t>(sizeof(n)));
+            }
+        }
+        // keep the connections until everything is received
+        while (device.fReceived < kNumSubChannels * kNumMessages) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    });
+
+    thread control([&]() { test::Control(device); });
+    device.RunStateMachine();
+    control.join();
+    sender.join();
+
+    EXPECT_EQ(device.fReceived, kNumSubChannels * kNumMessages);
+    EXPECT_FALSE(device.fOutOfOrder);
+    ASSERT_EQ(device.fThreads.size(), static_cast<size_t>(kNumSubChannels));
+    for (const auto& t : device.fThreads) {
+        EXPECT_EQ(t.second.size(), 1U) << t.first << " handled by more than one thread";
+    }
+    EXPECT_EQ(device.fAllThreads.size(), expectedThreads);
+}
+
+TEST(DataWorkers, zeromq) // NOLINT
+{
+    RunDataWorkers({"zeromq", "zeromq"}, 2, true, 2);
+}
+
+TEST(DataWorkers, shmem) // NOLINT
+{
+    RunDataWorkers({"shmem", "shmem"}, 2, true, 2);
+}
+
+TEST(DataWorkersSerialized, zeromq) // NOLINT
+{
+    RunDataWorkers({"zeromq", "zeromq"}, 4, false, 4);
+}
+
+TEST(MultipleTransports, ThreadSafe) // NOLINT
+{
+    // one input thread per transport
+    RunDataWorkers({"zeromq", "shmem"}, 0, true, 2);
+}
+
+TEST(MultipleTransports, Serialized) // NOLINT
+{
+    RunDataWorkers({"zeromq", "shmem"}, 0, false, 2);
+}
+
+} // namespace
@@ -0,0 +1,155 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "../helper/ControlDevice.h"
+
+#include <fairmq/Channel.h>
+#include <fairmq/Device.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+constexpr int kNumMessages = 20; // per channel
+
+// records the order in which the messages of "bulk" and "urgent" are handled
+class DispatchReceiver : public Device
+{
+  public:
+    DispatchReceiver()
+    {
+        for (const string name : {"bulk", "urgent"}) {
+            OnData(name, [this, name](MessagePtr&, int) {
+                fOrder.push_back(name.front());
+                return fOrder.size() < 2 * kNumMessages;
+            });
+        }
+    }
+
+    string fOrder;
+};
+
+// handlers registered with OnData<&T::F>(), called without std::function
+class DirectReceiver : public Device
+{
+  public:
+    DirectReceiver()
+    {
+        OnData<&DirectReceiver::HandleMsg>("bulk");
+        OnData<&DirectReceiver::HandleParts>("urgent");
+    }
+
+    bool HandleMsg(MessagePtr& msg, int)
+    {
+        fOrder.push_back(msg ? 'b' : '?');
+        return fOrder.size() < 2 * kNumMessages;
+    }
+
+    bool HandleParts(Parts& parts, int)
+    {
+        fOrder.push_back(parts.Size() == 1 ? 'u' : '?');
+        return fOrder.size() < 2 * kNumMessages;
+    }
+
+    string fOrder;
+};
+
+/// queues the messages of both inputs before the device enters RUNNING
+template<typename Receiver = DispatchReceiver>
+string RunDispatch(const string& dispatch, int urgentPriority)
+{
+    const string session(tools::Uuid());
+    ProgOptions config;
+    config.SetProperty<string>("session", session);
+    config.SetProperty<string>("input-dispatch", dispatch);
+
+    Receiver device;
+    device.SetConfig(config);
+    device.SetInputPriority("urgent", urgentPriority);
+    for (const string name : {"bulk", "urgent"}) {
+        Channel channel("pull", "bind", tools::ToString("ipc://test_input_dispatch_", name, "_", session));
+        channel.UpdateRateLogging(0);
+        device.AddChannel(name, std::move(channel));
+    }
+
+    thread control([&]() {
+        device.ChangeStateOrThrow(Transition::InitDevice);
+        device.WaitForState(State::InitializingDevice);
+        device.ChangeStateOrThrow(Transition::CompleteInit);
+        device.WaitForState(State::Initialized);
+        device.ChangeStateOrThrow(Transition::Bind);
+        device.WaitForState(State::Bound);
+        device.ChangeStateOrThrow(Transition::Connect);
+        device.WaitForState(State::DeviceReady);
+        device.ChangeStateOrThrow(Transition::InitTask);
+        device.WaitForState(State::Ready);
+
+        ProgOptions senderConfig;
+        auto factory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &senderConfig));
+        vector<Channel> channels;
+        channels.reserve(2);
+        for (const string name : {"bulk", "urgent"}) {
+            channels.emplace_back(name, "push", factory);
+            EXPECT_TRUE(channels.back().Connect(tools::ToString("ipc://test_input_dispatch_", name, "_", session)));
+        }
+        for (auto& channel : channels) {
+            for (int i = 0; i < kNumMessages; ++i) {
+                auto msg(channel.NewMessage());
+                EXPECT_EQ(channel.Send(msg, 1000), 0);
+            }
+        }
+        // let the messages arrive in the queues of the device
+        this_thread::sleep_for(chrono::milliseconds(200));
+
+        device.ChangeStateOrThrow(Transition::Run);
+        test::Control(device, test::Cycle::ReadyToEnd);
+    });
+    device.RunStateMachine();
+    control.join();
+
+    return device.fOrder;
+}
+
+TEST(InputDispatch, Priority) // NOLINT
+{
+    const string order(RunDispatch("priority", 1));
+    EXPECT_EQ(order, string(kNumMessages, 'u') + string(kNumMessages, 'b'));
+}
+
+TEST(InputDispatch, Weighted) // NOLINT
+{
+    // bulk (weight 1) is polled first, then urgent gets 3 messages per round
+    const string order(RunDispatch("weighted", 3));
+    EXPECT_EQ(order.substr(0, 12), "buuubuuubuuu");
+}
+
+TEST(InputDispatch, DirectHandlers) // NOLINT
+{
+    const string order(RunDispatch<DirectReceiver>("priority", 1));
+    EXPECT_EQ(order, string(kNumMessages, 'u') + string(kNumMessages, 'b'));
+}
+
+TEST(InputDispatch, InvalidPolicy) // NOLINT
+{
+    EXPECT_THROW(ParseInputDispatch("fastest"), runtime_error);
+}
+
+} // namespace
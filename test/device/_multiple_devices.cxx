@@ -13,9 +13,13 @@
 
 #include <gtest/gtest.h>
 
+#include <fairmq/TransportRegistry.h>
+
+#include <memory>
 #include <string>
 #include <thread>
 #include <future> // std::async, std::future
+#include <vector>
 
 namespace
 {
@@ -75,4 +79,53 @@ TEST_F(MultipleDevices, TwoInSameProcess)
     ASSERT_EQ(second, true);
 }
 
+TEST(MultipleDevices, SharedTransports)
+{
+    auto transports = make_shared<TransportRegistry>();
+
+    test::Sender sender("data");
+    Channel senderChannel("push", "connect", "ipc://multiple-devices-shared-transports-test");
+    senderChannel.UpdateRateLogging(0);
+    sender.AddChannel("data", std::move(senderChannel));
+
+    test::Receiver receiver("data");
+    Channel receiverChannel("pull", "bind", "ipc://multiple-devices-shared-transports-test");
+    receiverChannel.UpdateRateLogging(0);
+    receiver.AddChannel("data", std::move(receiverChannel));
+
+    vector<Device*> devices{&sender, &receiver};
+    vector<thread> threads;
+    for (auto device : devices) {
+        device->SetTransport("shmem");
+        device->SetTransportRegistry(transports);
+        threads.emplace_back([device] { device->RunStateMachine(); });
+    }
+
+    auto step = [&](Transition transition, State state) {
+        for (auto device : devices) {
+            device->ChangeStateOrThrow(transition);
+        }
+        for (auto device : devices) {
+            device->WaitForState(state);
+        }
+    };
+
+    step(Transition::InitDevice, State::InitializingDevice);
+    step(Transition::CompleteInit, State::Initialized);
+    step(Transition::Bind, State::Bound);
+    step(Transition::Connect, State::DeviceReady);
+    EXPECT_EQ(sender.Transport(), receiver.Transport());
+    step(Transition::InitTask, State::Ready);
+    step(Transition::Run, State::Ready); // Run() of both returns after one message
+    step(Transition::ResetTask, State::DeviceReady);
+    step(Transition::ResetDevice, State::Idle);
+
+    for (auto device : devices) {
+        device->ChangeStateOrThrow(Transition::End);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
 } // namespace
@@ -0,0 +1,92 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "../helper/ControlDevice.h"
+
+#include <fairmq/Channel.h>
+#include <fairmq/Device.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+// sends one message on the subchannel added while running, then removes it again and leaves RUNNING
+class ResizeDevice : public Device
+{
+  public:
+    bool ConditionalRun() override
+    {
+        if (fPhase == 0 && GetNumSubChannels("data") == 2) {
+            auto msg(NewSimpleMessageFor("data", 1, 42));
+            fSent = Send(msg, "data", 1, 5000) >= 0;
+            ResizeChannel("data", 1);
+            fPhase = 1;
+        } else if (fPhase == 1 && GetNumSubChannels("data") == 1) {
+            return false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+        return true;
+    }
+
+    void SubChannelsChanged(const string& channelName) override { fChanged.push_back(channelName); }
+
+    int fPhase = 0;
+    bool fSent = false;
+    vector<string> fChanged;
+};
+
+TEST(Resize, OutputChannel) // NOLINT
+{
+    const string session(tools::Uuid());
+    ProgOptions config;
+    config.SetProperty<string>("session", session);
+
+    ResizeDevice device;
+    device.SetConfig(config);
+    Channel channel("push", "bind", tools::ToString("ipc://test_resize_0_", session));
+    channel.UpdateRateLogging(0);
+    device.AddChannel("data", std::move(channel));
+
+    thread control([&]() {
+        test::Control(device, test::Cycle::ToRun);
+
+        const string address(tools::ToString("ipc://test_resize_1_", session));
+        config.SetProperty<string>("chans.data.1.address", address);
+        config.SetProperty<string>("chans.data.numSockets", "2");
+
+        ProgOptions pullConfig;
+        auto factory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &pullConfig));
+        Channel pull("pull", "pull", factory);
+        EXPECT_TRUE(pull.Connect(address));
+        auto msg(pull.NewMessage());
+        EXPECT_EQ(pull.Receive(msg, 5000), static_cast<int64_t>(sizeof(int)));
+
+        test::Control(device, test::Cycle::ReadyToEnd);
+    });
+    device.RunStateMachine();
+    control.join();
+
+    EXPECT_TRUE(device.fSent);
+    EXPECT_EQ(device.fChanged, vector<string>({"data", "data"}));
+    EXPECT_EQ(config.Count("chans.data.1.type"), 0);
+}
+
+} // namespace
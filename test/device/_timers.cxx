@@ -0,0 +1,105 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include "../helper/ControlDevice.h"
+
+#include <fairmq/Device.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+constexpr int kNumTicks = 5;
+constexpr auto kInterval = chrono::milliseconds(20);
+
+// leaves RUNNING from the timer after kNumTicks ticks, without receiving any data
+class TimerDevice : public Device
+{
+  public:
+    explicit TimerDevice(bool dataCallbacks)
+    {
+        if (dataCallbacks) {
+            OnData("data", [](MessagePtr&, int) { return true; });
+            OnData("data2", [](MessagePtr&, int) { return true; });
+        }
+        OnTimer(kInterval, &TimerDevice::Tick);
+    }
+
+    bool Tick()
+    {
+        fThreads.insert(this_thread::get_id());
+        fLastTick = chrono::steady_clock::now();
+        return ++fTicks < kNumTicks;
+    }
+
+    bool ConditionalRun() override
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+        return true;
+    }
+
+    void PreRun() override { fStart = chrono::steady_clock::now(); }
+
+    int fTicks = 0;
+    set<thread::id> fThreads;
+    chrono::steady_clock::time_point fStart;
+    chrono::steady_clock::time_point fLastTick;
+};
+
+void RunTimers(bool dataCallbacks, int workers)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<int>("data-workers", workers);
+    config.SetProperty<bool>("shm-monitor", true);
+
+    TimerDevice device(dataCallbacks);
+    device.SetConfig(config);
+    for (const string name : {"data", "data2"}) {
+        Channel channel("pull", "bind", tools::ToString("ipc://test_timers_", name, "_", dataCallbacks, "_", workers));
+        channel.UpdateRateLogging(0);
+        device.AddChannel(name, std::move(channel));
+    }
+
+    thread control([&]() { test::Control(device); });
+    device.RunStateMachine();
+    control.join();
+
+    EXPECT_EQ(device.fTicks, kNumTicks);
+    EXPECT_EQ(device.fThreads.size(), 1U);
+    EXPECT_GE(device.fLastTick - device.fStart, kNumTicks * kInterval);
+}
+
+TEST(Timers, DataCallbacks) // NOLINT
+{
+    RunTimers(true, 0);
+}
+
+TEST(Timers, DataWorkers) // NOLINT
+{
+    RunTimers(true, 2);
+}
+
+TEST(Timers, ConditionalRun) // NOLINT
+{
+    RunTimers(false, 0);
+}
+
+} // namespace
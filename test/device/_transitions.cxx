@@ -7,10 +7,12 @@
  ********************************************************************************/
 
 #include <fairmq/Device.h>
+#include <fairmq/StartupProfile.h>
 #include <fairlogger/Logger.h>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <vector>
 #include <thread>
 
@@ -42,4 +44,67 @@ TEST(Transitions, InvalidChangeStateOrThrow)
     if (t.joinable()) { t.join(); }
 }
 
+TEST(Transitions, Timings)
+{
+    Device device;
+    thread t([&] { device.RunStateMachine(); });
+
+    device.ChangeStateOrThrow(Transition::InitDevice);
+    device.WaitForState(State::InitializingDevice);
+    device.ChangeStateOrThrow(Transition::CompleteInit);
+    device.WaitForState(State::Initialized);
+    device.ChangeStateOrThrow(Transition::ResetDevice);
+    device.WaitForState(State::Idle);
+    device.ChangeStateOrThrow(Transition::End);
+    if (t.joinable()) { t.join(); }
+
+    vector<TransitionTiming> timings = device.GetTransitionTimings();
+    ASSERT_EQ(timings.size(), 5);
+    EXPECT_EQ(timings.at(0).transition, Transition::InitDevice);
+    EXPECT_EQ(timings.at(0).from, State::Idle);
+    EXPECT_EQ(timings.at(0).to, State::InitializingDevice);
+    EXPECT_EQ(timings.at(2).transition, Transition::ResetDevice);
+    EXPECT_EQ(timings.at(3).transition, Transition::Auto);
+    EXPECT_EQ(timings.at(3).to, State::Idle);
+    EXPECT_EQ(timings.at(4).to, State::Exiting);
+    for (const auto& timing : timings) {
+        EXPECT_GE(timing.dispatch.count(), 0);
+        EXPECT_GE(timing.handling.count(), 0);
+    }
+}
+
+TEST(Transitions, StartupProfile)
+{
+    Device device;
+    thread t([&] { device.RunStateMachine(); });
+
+    device.ChangeStateOrThrow(Transition::InitDevice);
+    device.WaitForState(State::InitializingDevice);
+    device.ChangeStateOrThrow(Transition::CompleteInit);
+    device.WaitForState(State::Initialized);
+    device.ChangeStateOrThrow(Transition::Bind);
+    device.WaitForState(State::Bound);
+    device.ChangeStateOrThrow(Transition::Connect);
+    device.WaitForState(State::DeviceReady);
+    device.ChangeStateOrThrow(Transition::InitTask);
+    device.WaitForState(State::Ready);
+
+    // the profile is process wide, another test may have completed it already
+    EXPECT_TRUE(StartupProfile::Completed());
+    vector<StartupPhase> phases = StartupProfile::GetPhases();
+    for (const string name : { "init-device", "bind", "connect", "init-task", "total" }) {
+        EXPECT_TRUE(any_of(phases.begin(), phases.end(), [&](const StartupPhase& p) { return p.name == name; })) << name;
+    }
+    ASSERT_FALSE(phases.empty());
+    EXPECT_EQ(phases.back().name, "total");
+    EXPECT_EQ(StartupProfile::Format({ StartupPhase{ "bind", chrono::microseconds(0), chrono::microseconds(1500), 2 } }), "bind=1.5msx2");
+
+    device.ChangeStateOrThrow(Transition::ResetTask);
+    device.WaitForState(State::DeviceReady);
+    device.ChangeStateOrThrow(Transition::ResetDevice);
+    device.WaitForState(State::Idle);
+    device.ChangeStateOrThrow(Transition::End);
+    if (t.joinable()) { t.join(); }
+}
+
 } // namespace
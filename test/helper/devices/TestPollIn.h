@@ -45,7 +45,7 @@ class PollIn : public Device
 
         PollerPtr poller = nullptr;
 
-        if (fPollType == 0)
+        if (fPollType == 0 || fPollType == 2)
         {
             poller = NewPoller(chans);
         }
@@ -64,6 +64,7 @@ class PollIn : public Device
 
         MessagePtr msg1(NewMessage());
         MessagePtr msg2(NewMessage());
+        vector<int> ready;
 
         while (!bothArrived)
         {
@@ -110,6 +111,27 @@ class PollIn : public Device
                 }
             }
 
+            else if (fPollType == 2)
+            {
+                if (!poller->ReadyInputs(ready))
+                {
+                    LOG(error) << "poller does not track ready inputs";
+                    return;
+                }
+                for (int index : ready)
+                {
+                    LOG(debug) << "ReadyInputs() contains " << index;
+                    if (index == 0 && Receive(msg1, "data1", 0) >= 0)
+                    {
+                        arrived1 = true;
+                    }
+                    if (index == 1 && Receive(msg2, "data2", 0) >= 0)
+                    {
+                        arrived2 = true;
+                    }
+                }
+            }
+
             if (arrived1 && arrived2)
             {
                 bothArrived = true;
@@ -33,7 +33,7 @@ namespace bpo = boost::program_options;
 auto addCustomOptions(bpo::options_description& options) -> void
 {
     options.add_options()
-        ("poll-type", bpo::value<int>()->default_value(0), "Poll type switch(0 - vector of (sub-)channels, 1 - vector of channel names)");
+        ("poll-type", bpo::value<int>()->default_value(0), "Poll type switch(0 - vector of (sub-)channels, 1 - vector of channel names, 2 - vector of (sub-)channels with ReadyInputs())");
 }
 
 auto getDevice(fair::mq::ProgOptions& config) -> std::unique_ptr<fair::mq::Device>
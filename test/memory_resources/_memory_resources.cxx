@@ -15,7 +15,10 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <cstring>
+#include <new> // bad_alloc
+#include <thread>
 #include <vector>
 
 namespace
@@ -173,4 +176,163 @@ TEST(MemoryResources, getMessage)
     EXPECT_TRUE(messageArray[0] == 4 && messageArray[1] == 5 && messageArray[2] == 6);
 }
 
+TEST(MemoryResources, poolResource)
+{
+    size_t session{tools::UuidHash()};
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    FactoryType factorySHM = TransportFactory::CreateTransportFactory("shmem", fair::mq::tools::Uuid(), &config);
+    ChannelPoolResource pool(factorySHM.get(), 65536, 1024);
+
+    // small allocations are carved from one chunk message and recycled
+    {
+        std::vector<int, polymorphic_allocator<int>> v(polymorphic_allocator<int>{&pool});
+        for (int i = 0; i < 200; ++i) { // grows up to 1024 bytes in several steps
+            v.push_back(i);
+        }
+        EXPECT_EQ(pool.getNumberOfChunks(), 1);
+        EXPECT_EQ(pool.getNumberOfMessages(), 0);
+        EXPECT_EQ(getMessage(std::move(v))->GetSize(), 200 * sizeof(int)); // copied
+    }
+    void* first = pool.allocate(64, 8);
+    pool.deallocate(first, 64, 8);
+    EXPECT_EQ(pool.allocate(64, 8), first);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(pool.allocate(256, 64)) % 64, 0);
+    EXPECT_EQ(pool.getNumberOfChunks(), 1);
+
+    // large allocations get their own message, handed out without copy
+    std::vector<int, polymorphic_allocator<int>> v(polymorphic_allocator<int>{&pool});
+    v.resize(10000, 42);
+    void* data = v.data();
+    EXPECT_EQ(pool.getNumberOfMessages(), 1);
+    MessagePtr message = getMessage(std::move(v));
+    EXPECT_EQ(message->GetData(), data);
+    EXPECT_EQ(message->GetSize(), 10000 * sizeof(int));
+    EXPECT_EQ(static_cast<int*>(message->GetData())[9999], 42);
+}
+
+TEST(MemoryResources, messageTable)
+{
+    ProgOptions config;
+    FactoryType factoryZMQ = TransportFactory::CreateTransportFactory("zeromq", fair::mq::tools::Uuid(), &config);
+    ChannelResource resource(factoryZMQ.get());
+
+    // many outstanding allocations, handed back in another order than allocated
+    vector<void*> allocations;
+    for (int i = 0; i < 5000; ++i) {
+        allocations.push_back(resource.allocate(64 + i % 7, 8));
+    }
+    EXPECT_EQ(resource.getNumberOfMessages(), 5000);
+    for (size_t i = 0; i < allocations.size(); i += 2) {
+        MessagePtr message = resource.getMessage(allocations[i]);
+        ASSERT_NE(message, nullptr);
+        EXPECT_EQ(message->GetData(), allocations[i]);
+    }
+    EXPECT_EQ(resource.getMessage(allocations[0]), nullptr);
+    for (size_t i = 1; i < allocations.size(); i += 2) {
+        resource.deallocate(allocations[i], 64 + i % 7, 8);
+    }
+    EXPECT_EQ(resource.getNumberOfMessages(), 0);
+}
+
+TEST(MemoryResources, concurrentResource)
+{
+    size_t session{tools::UuidHash()};
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    FactoryType factorySHM = TransportFactory::CreateTransportFactory("shmem", fair::mq::tools::Uuid(), &config);
+    ConcurrentChannelResource resource(factorySHM.get(), 1000);
+    EXPECT_EQ(resource.getCapacity(), 1024);
+
+    // several producers fill containers from the same resource, the messages are handed out without copy
+    constexpr int kNumThreads = 4;
+    constexpr int kNumRounds = 200;
+    vector<thread> threads;
+    atomic<int> failures{0};
+    for (int t = 0; t < kNumThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int round = 0; round < kNumRounds; ++round) {
+                std::vector<int, polymorphic_allocator<int>> v(polymorphic_allocator<int>{&resource});
+                v.resize(100, t);
+                void* data = v.data();
+                MessagePtr message = getMessage(std::move(v));
+                if (!message || message->GetData() != data || static_cast<int*>(message->GetData())[99] != t) {
+                    ++failures;
+                }
+                // outstanding while the other threads allocate
+                void* p = resource.allocate(32, 8);
+                resource.deallocate(p, 32, 8);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(resource.getNumberOfMessages(), 0);
+
+    // a full table fails the allocation
+    ConcurrentChannelResource small(factorySHM.get(), 16);
+    vector<void*> allocations;
+    for (int i = 0; i < 16; ++i) {
+        allocations.push_back(small.allocate(8, 8));
+    }
+    EXPECT_THROW(small.allocate(8, 8), bad_alloc);
+    small.deallocate(allocations.back(), 8, 8);
+    EXPECT_NO_THROW(small.allocate(8, 8));
+}
+
+TEST(MemoryResources, adoptVector)
+{
+    size_t session{tools::UuidHash()};
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    for (const string transport : {"zeromq", "shmem"}) {
+        FactoryType factory = TransportFactory::CreateTransportFactory(transport, fair::mq::tools::Uuid(), &config);
+
+        // a received message becomes the storage of the vector, without a copy
+        MessagePtr message(factory->CreateMessage(4 * sizeof(int) + 2, Alignment{alignof(int)}));
+        void* data = message->GetData();
+        for (int i = 0; i < 4; ++i) {
+            static_cast<int*>(data)[i] = i + 1;
+        }
+        auto v = adoptVector<int>(std::move(message));
+        ASSERT_TRUE(v.isAdopted()) << transport;
+        EXPECT_EQ(v->data(), data);
+        EXPECT_EQ(*v, (std::vector<int, DefaultInitAllocator<int>>{1, 2, 3, 4}));
+
+        // modified in place and handed out again
+        (*v)[0] = 10;
+        v->pop_back();
+        MessagePtr out = getMessage(std::move(*v));
+        ASSERT_NE(out, nullptr);
+        EXPECT_EQ(out->GetData(), data);
+        EXPECT_EQ(out->GetSize(), 3 * sizeof(int));
+        EXPECT_EQ(static_cast<int*>(out->GetData())[0], 10);
+
+        // growing moves the data into a new message of the transport, the adopted one is released
+        auto grown = adoptVector<int>(std::move(out));
+        ASSERT_TRUE(grown.isAdopted());
+        for (int i = 0; i < 100; ++i) {
+            grown->push_back(i);
+        }
+        EXPECT_FALSE(grown.isAdopted());
+        EXPECT_EQ((*grown)[0], 10);
+        EXPECT_EQ((*grown)[2], 3);
+        EXPECT_EQ(grown->size(), 103);
+        MessagePtr grownOut = getMessage(std::move(*grown));
+        ASSERT_NE(grownOut, nullptr);
+        EXPECT_EQ(grownOut->GetSize(), 103 * sizeof(int));
+        EXPECT_EQ(grownOut->GetType(), factory->GetType());
+    }
+
+    EXPECT_THROW(MessageResource(nullptr), std::runtime_error);
+}
+
 }   // namespace
@@ -7,12 +7,15 @@
  ********************************************************************************/
 
 #include <fairmq/Channel.h>
+#include <fairmq/MessageArena.h>
+#include <fairmq/PartsBuilder.h>
 #include <fairmq/ProgOptions.h>
 #include <fairmq/tools/Semaphore.h>
 #include <fairmq/tools/Strings.h>
 #include <fairmq/tools/Unique.h>
 #include <fairmq/TransportFactory.h>
 #include <fairmq/shmem/Message.h>
+#include <fairmq/zeromq/TransportFactory.h>
 
 #include <fairlogger/Logger.h>
 
@@ -20,11 +23,15 @@
 
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <numeric> // accumulate
 #include <string_view>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 namespace
 {
@@ -368,6 +375,701 @@ auto ZeroCopyFromUnmanaged(string const& address) -> void
     blocker.Wait();
 }
 
+auto CreateMessages(string const& transport, string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel push{"Push", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    auto const address(tools::ToString(_address, "_", transport));
+    push.Bind(address);
+    pull.Connect(address);
+
+    size_t const numParts{64};
+    size_t const size{1000};
+    fair::mq::Alignment const alignment{64};
+    Parts outParts(push.NewMessages(numParts, size, alignment));
+    ASSERT_EQ(outParts.Size(), numParts);
+    for (size_t i = 0; i < numParts; ++i) {
+        ASSERT_EQ(outParts[i].GetSize(), size);
+        ASSERT_TRUE(CheckMsgAlignment(outParts[i], alignment));
+        memset(outParts[i].GetData(), static_cast<int>(i), size);
+    }
+
+    ASSERT_EQ(push.Send(outParts), static_cast<int64_t>(numParts * size));
+
+    Parts inParts;
+    ASSERT_EQ(pull.Receive(inParts), static_cast<int64_t>(numParts * size));
+    ASSERT_EQ(inParts.Size(), numParts);
+    for (size_t i = 0; i < numParts; ++i) {
+        ASSERT_EQ(inParts[i].GetSize(), size);
+        ASSERT_EQ(static_cast<unsigned char*>(inParts[i].GetData())[size - 1], static_cast<unsigned char>(i));
+    }
+
+    ASSERT_EQ(push.NewMessages(0, size).Size(), 0);
+    ASSERT_EQ(push.NewMessages(3, 0).Size(), 3);
+}
+
+auto PackedParts(string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    auto factory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+
+    Channel push{"Push", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    push.UpdatePackParts(256);
+    pull.UpdatePackParts(256);
+    auto const address(tools::ToString(_address, "_zeromq"));
+    push.Bind(address);
+    pull.Connect(address);
+
+    // mix of packed parts (tiny and sliced) and parts sent as separate frames
+    vector<size_t> const sizes{10, 0, 100, 1000, 256, 257, 3000, 7};
+    size_t const total = accumulate(sizes.begin(), sizes.end(), size_t(0));
+    Parts outParts;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        outParts.AddPart(push.NewMessage(sizes[i]));
+        memset(outParts[i].GetData(), static_cast<int>(i + 1), sizes[i]);
+    }
+    ASSERT_EQ(push.Send(outParts), static_cast<int64_t>(total));
+
+    Parts inParts;
+    ASSERT_EQ(pull.Receive(inParts), static_cast<int64_t>(total));
+    ASSERT_EQ(inParts.Size(), sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        ASSERT_EQ(inParts[i].GetSize(), sizes[i]);
+        if (sizes[i] > 0) {
+            ASSERT_EQ(static_cast<unsigned char*>(inParts[i].GetData())[0], static_cast<unsigned char>(i + 1));
+            ASSERT_EQ(static_cast<unsigned char*>(inParts[i].GetData())[sizes[i] - 1], static_cast<unsigned char>(i + 1));
+        }
+    }
+
+    // a receiver with packing accepts multipart messages of peers without packing
+    Channel plainPush{"PlainPush", "push", factory};
+    plainPush.Bind(tools::ToString(address, "_plain"));
+    pull.Connect(tools::ToString(address, "_plain"));
+    Parts plainParts;
+    plainParts.AddPart(plainPush.NewMessage(100));
+    plainParts.AddPart(plainPush.NewMessage(10));
+    ASSERT_EQ(plainPush.Send(plainParts), 110);
+    Parts inPlainParts;
+    ASSERT_EQ(pull.Receive(inPlainParts), 110);
+    ASSERT_EQ(inPlainParts.Size(), 2);
+}
+
+auto SendCopy(string const& transport, string const& _address, int packParts) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    constexpr int numOutputs = 3;
+    vector<Channel> pushes;
+    vector<Channel> pulls;
+    pushes.reserve(numOutputs);
+    pulls.reserve(numOutputs);
+    for (int i = 0; i < numOutputs; ++i) {
+        auto const address(tools::ToString(_address, "_", transport, "_", packParts, "_", i));
+        pushes.emplace_back(tools::ToString("Push", i), "push", factory);
+        pulls.emplace_back(tools::ToString("Pull", i), "pull", factory);
+        pushes.back().UpdatePackParts(packParts);
+        pulls.back().UpdatePackParts(packParts);
+        pushes.back().Bind(address);
+        pulls.back().Connect(address);
+    }
+
+    vector<size_t> const sizes{1000, 10, 100000};
+    size_t const total = accumulate(sizes.begin(), sizes.end(), size_t(0));
+    Parts outParts;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        outParts.AddPart(pushes.at(0).NewMessage(sizes[i]));
+        memset(outParts[i].GetData(), static_cast<int>(i + 1), sizes[i]);
+    }
+    MessagePtr outMsg(pushes.at(0).NewMessage(1000));
+    memset(outMsg->GetData(), 'm', 1000);
+
+    // copies to all outputs but the last one, the originals remain valid
+    for (int i = 0; i < numOutputs - 1; ++i) {
+        ASSERT_EQ(pushes.at(i).SendCopy(outParts), static_cast<int64_t>(total));
+        ASSERT_EQ(pushes.at(i).SendCopy(outMsg), 1000);
+        ASSERT_EQ(outParts.Size(), sizes.size());
+        ASSERT_EQ(outMsg->GetSize(), 1000);
+    }
+    ASSERT_EQ(pushes.back().Send(outParts), static_cast<int64_t>(total));
+    ASSERT_EQ(pushes.back().Send(outMsg), 1000);
+
+    for (auto& pull : pulls) {
+        Parts inParts;
+        ASSERT_EQ(pull.Receive(inParts), static_cast<int64_t>(total));
+        ASSERT_EQ(inParts.Size(), sizes.size());
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            ASSERT_EQ(inParts[i].GetSize(), sizes[i]);
+            ASSERT_EQ(static_cast<unsigned char*>(inParts[i].GetData())[sizes[i] - 1], static_cast<unsigned char>(i + 1));
+        }
+        MessagePtr inMsg(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(inMsg), 1000);
+        ASSERT_EQ(static_cast<char*>(inMsg->GetData())[999], 'm');
+    }
+}
+
+auto Forward(string const& transport, string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    // push -> pull | proxy | push -> pull
+    Channel push{"Push", "push", factory};
+    Channel proxyIn{"ProxyIn", "pull", factory};
+    Channel proxyOut{"ProxyOut", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    auto const address(tools::ToString(_address, "_", transport));
+    push.Bind(tools::ToString(address, "_in"));
+    proxyIn.Connect(tools::ToString(address, "_in"));
+    proxyOut.Bind(tools::ToString(address, "_out"));
+    pull.Connect(tools::ToString(address, "_out"));
+
+    MessagePtr msg(push.NewMessage(1000));
+    memset(msg->GetData(), 'a', 1000);
+    ASSERT_EQ(push.Send(msg), 1000);
+    Parts parts;
+    parts.AddPart(push.NewMessage(10));
+    parts.AddPart(push.NewMessage(2000));
+    memset(parts[1].GetData(), 'b', 2000);
+    ASSERT_EQ(push.Send(parts), 2010);
+
+    ASSERT_EQ(proxyIn.Forward(proxyOut), 1000);
+    ASSERT_EQ(proxyIn.Forward(proxyOut), 2010);
+    ASSERT_EQ(proxyIn.Forward(proxyOut, 100), static_cast<int>(TransferCode::timeout));
+    ASSERT_EQ(proxyIn.GetMessagesRx(), 2UL);
+    ASSERT_EQ(proxyOut.GetBytesTx(), 3010UL);
+
+    MessagePtr inMsg(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(inMsg), 1000);
+    ASSERT_EQ(static_cast<char*>(inMsg->GetData())[999], 'a');
+    Parts inParts;
+    ASSERT_EQ(pull.Receive(inParts), 2010);
+    ASSERT_EQ(inParts.Size(), 2);
+    ASSERT_EQ(static_cast<char*>(inParts[1].GetData())[1999], 'b');
+}
+
+auto Tracing(string const& transport, string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel push{"Push", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    push.UpdateTrace(true);
+    pull.UpdateTrace(true);
+    auto const address(tools::ToString(_address, "_", transport));
+    push.Bind(address);
+    pull.Connect(address);
+
+    MessagePtr msg(push.NewMessage(1000));
+    msg->SetTraceContext({42, 7});
+    ASSERT_EQ(push.Send(msg), 1000);
+    MessagePtr inMsg(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(inMsg), 1000);
+    ASSERT_EQ(inMsg->GetTraceContext(), (TraceContext{42, 7}));
+
+    // all parts carry the context of the first one
+    Parts parts;
+    parts.AddPart(push.NewMessage(10));
+    parts.AddPart(push.NewMessage(2000));
+    parts[0].SetTraceContext({43, 1});
+    ASSERT_EQ(push.Send(parts), 2010);
+    Parts inParts;
+    ASSERT_EQ(pull.Receive(inParts), 2010);
+    ASSERT_EQ(inParts.Size(), 2);
+    ASSERT_EQ(inParts[0].GetTraceContext(), (TraceContext{43, 1}));
+    ASSERT_EQ(inParts[1].GetTraceContext(), (TraceContext{43, 1}));
+
+    // messages without a context inherit the one last received by the thread, events are recorded when enabled
+    Tracer::Enable(true);
+    MessagePtr next(push.NewMessage(10));
+    ASSERT_EQ(push.Send(next), 10);
+    ASSERT_EQ(pull.Receive(inMsg), 10);
+    Tracer::Enable(false);
+    ASSERT_EQ(inMsg->GetTraceContext(), (TraceContext{43, 1}));
+
+    vector<TraceEvent> events;
+    Tracer::Drain([&](uint32_t, const TraceEvent& event) { events.push_back(event); });
+    ASSERT_EQ(events.size(), 2);
+    ASSERT_EQ(events[0].type, TraceEvent::Type::send);
+    ASSERT_EQ(Tracer::ChannelName(events[0].channel), "Push");
+    ASSERT_EQ(events[1].type, TraceEvent::Type::receive);
+    ASSERT_EQ(Tracer::ChannelName(events[1].channel), "Pull");
+    ASSERT_EQ(events[1].context, (TraceContext{43, 1}));
+    ASSERT_LE(events[0].timestamp, events[1].timestamp);
+}
+
+struct ArenaObject
+{
+    explicit ArenaObject(int v) : value(v) {}
+    static void* operator new(size_t size) { return MessageArena::AllocateSingle(size); }
+    static void* operator new(size_t size, MessageArena& arena) { return arena.Allocate(size); }
+    static void operator delete(void* ptr) noexcept { MessageArena::Release(ptr); }
+    static void operator delete(void* ptr, MessageArena&) noexcept { MessageArena::Release(ptr); }
+    int value;
+    char padding[100];
+};
+
+auto ArenaParts() -> void
+{
+    vector<unique_ptr<ArenaObject>> objects;
+    {
+        MessageArena arena(3, sizeof(ArenaObject));
+        for (int i = 0; i < 4; ++i) { // one more than the arena holds
+            objects.emplace_back(new (arena) ArenaObject(i));
+        }
+        // contiguous slots
+        ASSERT_LT(reinterpret_cast<char*>(objects[0].get()), reinterpret_cast<char*>(objects[1].get()));
+        ASSERT_LT(reinterpret_cast<char*>(objects[1].get()), reinterpret_cast<char*>(objects[2].get()));
+        objects[1].reset(); // before the arena
+    }
+    for (int i : {0, 2, 3}) {
+        ASSERT_EQ(objects[i]->value, i);
+    }
+    objects.clear();
+
+    // freed objects are reused by the next allocation of the thread
+    auto* first = new ArenaObject(1);
+    delete first;
+    unique_ptr<ArenaObject> second(new ArenaObject(2));
+    ASSERT_EQ(second.get(), first);
+
+    // shmem multipart receives allocate their message objects from an arena, the parts can be released in any order
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config));
+
+    Channel push{"Push", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    push.Bind("ipc://test_arena_parts");
+    pull.Connect("ipc://test_arena_parts");
+
+    Parts parts;
+    for (int i = 0; i < 8; ++i) {
+        parts.AddPart(push.NewSimpleMessage(to_string(i)));
+    }
+    ASSERT_EQ(push.Send(parts), 8);
+    Parts inParts;
+    ASSERT_EQ(pull.Receive(inParts), 8);
+    ASSERT_EQ(inParts.Size(), 8);
+    for (int i = 7; i >= 0; --i) {
+        ASSERT_EQ(AsStringView(inParts[i]), to_string(i));
+        inParts.At(i).reset();
+    }
+}
+
+struct ViewHeader
+{
+    uint32_t id;
+    uint32_t numValues;
+    double scale;
+};
+
+auto TypedViews(string const& transport, string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel push{"Push", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    auto const address(tools::ToString(_address, "_", transport));
+    push.Bind(address);
+    pull.Connect(address);
+
+    PartsBuilder builder(*factory);
+    builder.AddHeader<ViewHeader>(7U, 100U, 0.5);
+    auto payload = builder.AddPayload<float>(128);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<float>(i);
+    }
+    builder.ShrinkLast<float>(100);
+    ASSERT_EQ(builder.Size(), 2);
+    Parts parts = builder.Finish();
+    ASSERT_EQ(push.Send(parts), sizeof(ViewHeader) + 100 * sizeof(float));
+
+    Parts inParts;
+    ASSERT_EQ(pull.Receive(inParts), sizeof(ViewHeader) + 100 * sizeof(float));
+    auto const& header = inParts.As<ViewHeader>(0);
+    ASSERT_EQ(header.id, 7);
+    ASSERT_EQ(header.numValues, 100);
+    ASSERT_EQ(header.scale, 0.5);
+    auto values = inParts.AsSpan<float>(1);
+    ASSERT_EQ(values.size(), header.numValues);
+    ASSERT_EQ(values[99], 99.f);
+
+    // a single header constructed in the message buffer
+    MessagePtr typed(push.NewTypedMessage<ViewHeader>(8U, 1U, 2.0));
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(typed->GetData()) % alignof(ViewHeader), 0);
+    ASSERT_EQ(push.Send(typed), sizeof(ViewHeader));
+    MessagePtr inTyped(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(inTyped), sizeof(ViewHeader));
+    ASSERT_EQ(MessageAs<ViewHeader>(*inTyped).id, 8);
+    ASSERT_EQ(MessageAs<ViewHeader>(*inTyped).scale, 2.0);
+
+    // size and alignment are checked
+    using TooLarge = array<char, sizeof(ViewHeader) + 1>;
+    using ThreeBytes = array<char, 3>;
+    ASSERT_THROW(inParts.As<TooLarge>(0), MessageError);
+    ASSERT_THROW(inParts.AsSpan<ThreeBytes>(1), MessageError);
+    if (transport == "zeromq") { // shmem copies user buffers into the segment
+        MessagePtr unaligned(factory->CreateMessage(sizeof(uint64_t) + 1, Alignment{sizeof(uint64_t)}));
+        MessagePtr offset(factory->CreateMessage(static_cast<char*>(unaligned->GetData()) + 1, sizeof(uint64_t), [](void*, void*) {}, nullptr));
+        ASSERT_THROW(MessageAs<uint64_t>(*offset), MessageError);
+    }
+}
+
+auto Grow(string const& transport, string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel push{"Push", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    auto const address(tools::ToString(_address, "_", transport));
+    push.Bind(address);
+    pull.Connect(address);
+
+    MessagePtr msg(factory->CreateMessage(1000));
+    memset(msg->GetData(), 'a', 1000);
+    ASSERT_TRUE(msg->Grow(500)); // not larger, nothing to do
+    ASSERT_EQ(msg->GetSize(), 1000);
+    ASSERT_TRUE(msg->Grow(100000));
+    ASSERT_EQ(msg->GetSize(), 100000);
+    memset(static_cast<char*>(msg->GetData()) + 1000, 'b', 99000);
+
+    MessagePtr empty(factory->CreateMessage());
+    ASSERT_TRUE(empty->Grow(10));
+    ASSERT_EQ(empty->GetSize(), 10);
+
+    ASSERT_EQ(push.Send(msg), 100000);
+    MessagePtr in(factory->CreateMessage());
+    ASSERT_EQ(pull.Receive(in), 100000);
+    ASSERT_EQ(static_cast<char*>(in->GetData())[999], 'a');
+    ASSERT_EQ(static_cast<char*>(in->GetData())[1000], 'b');
+    ASSERT_EQ(static_cast<char*>(in->GetData())[99999], 'b');
+}
+
+auto PrependHeaders(string const& transport, string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    Channel push{"Push", "push", factory};
+    Channel pull{"Pull", "pull", factory};
+    auto const address(tools::ToString(_address, "_", transport));
+    push.Bind(address);
+    pull.Connect(address);
+
+    MessagePtr msg(factory->CreateMessage(1000, Headroom{64}));
+    ASSERT_EQ(msg->GetSize(), 1000);
+    ASSERT_EQ(msg->GetHeadroom(), 64);
+    memset(msg->GetData(), 'p', 1000);
+    char* data = static_cast<char*>(msg->GetData());
+    ASSERT_FALSE(msg->Prepend(65));
+    ASSERT_EQ(msg->GetData(), data);
+    ASSERT_TRUE(msg->Prepend(16));
+    ASSERT_EQ(msg->GetData(), data - 16);
+    ASSERT_EQ(msg->GetSize(), 1016);
+    ASSERT_EQ(msg->GetHeadroom(), 48);
+    memset(msg->GetData(), 'h', 16);
+
+    MessagePtr plain(factory->CreateMessage(10));
+    ASSERT_EQ(plain->GetHeadroom(), 0);
+    ASSERT_FALSE(plain->Prepend(1));
+
+    ASSERT_EQ(push.Send(msg), 1016);
+    MessagePtr in(factory->CreateMessage());
+    ASSERT_EQ(pull.Receive(in), 1016);
+    ASSERT_EQ(static_cast<char*>(in->GetData())[15], 'h');
+    ASSERT_EQ(static_cast<char*>(in->GetData())[16], 'p');
+    ASSERT_EQ(static_cast<char*>(in->GetData())[1015], 'p');
+    if (transport == "shmem") {
+        // the rest of the headroom travels with the message
+        ASSERT_EQ(in->GetHeadroom(), 48);
+        ASSERT_TRUE(in->Prepend(8));
+        ASSERT_EQ(in->GetSize(), 1024);
+        ASSERT_EQ(static_cast<char*>(in->GetData())[8 + 15], 'h');
+    } else {
+        ASSERT_EQ(in->GetHeadroom(), 0);
+    }
+}
+
+auto MakeWritable(string const& transport) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto factory(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config));
+
+    MessagePtr msg(factory->CreateMessage(1000));
+    memset(msg->GetData(), 'a', 1000);
+    void* data = msg->GetData();
+    // not shared, nothing to do
+    ASSERT_TRUE(msg->MakeWritable());
+    ASSERT_EQ(msg->GetData(), data);
+
+    MessagePtr copy(factory->CreateMessage());
+    copy->Copy(*msg);
+    ASSERT_TRUE(copy->MakeWritable());
+    ASSERT_NE(copy->GetData(), data);
+    ASSERT_EQ(copy->GetSize(), 1000);
+    static_cast<char*>(copy->GetData())[0] = 'b';
+    ASSERT_EQ(static_cast<char*>(msg->GetData())[0], 'a');
+    ASSERT_EQ(static_cast<char*>(copy->GetData())[999], 'a');
+
+    MessagePtr slice(msg->Slice(100, 10));
+    ASSERT_TRUE(slice->MakeWritable());
+    ASSERT_NE(slice->GetData(), static_cast<char*>(data) + 100);
+    ASSERT_EQ(slice->GetSize(), 10);
+    ASSERT_EQ(static_cast<char*>(slice->GetData())[9], 'a');
+
+    MessagePtr empty(factory->CreateMessage());
+    ASSERT_TRUE(empty->MakeWritable());
+}
+
+auto ShmemOverZeromq(string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto shmFactory(TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config));
+    auto zmqFactory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+
+    tools::Semaphore acked;
+    auto region = shmFactory->CreateUnmanagedRegion(1000000, [&acked](void*, size_t, void*) { acked.Signal(); });
+
+    Channel push{"Push", "push", zmqFactory};
+    Channel pull{"Pull", "pull", zmqFactory};
+    push.Bind(_address);
+    pull.Connect(_address);
+
+    // the zeromq message refers to the shmem buffer, the shmem message is released once zeromq is done with it
+    MessagePtr msg(shmFactory->CreateMessage(1000));
+    memset(msg->GetData(), 'z', 1000);
+    MessagePtr keep(shmFactory->CreateMessage());
+    keep->Copy(*msg);
+    ASSERT_EQ(static_cast<const shmem::Message&>(*keep).GetRefCount(), 2);
+    ASSERT_EQ(push.Send(msg), 1000);
+    ASSERT_EQ(msg->GetType(), Transport::ZMQ);
+    MessagePtr in(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(in), 1000);
+    ASSERT_EQ(static_cast<char*>(in->GetData())[999], 'z');
+    for (int i = 0; i < 1000 && static_cast<const shmem::Message&>(*keep).GetRefCount() != 1; ++i) {
+        this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    ASSERT_EQ(static_cast<const shmem::Message&>(*keep).GetRefCount(), 1);
+
+    // the region block is acknowledged after the transmission
+    MessagePtr regionMsg(shmFactory->CreateMessage(region, region->GetData(), 100, nullptr));
+    memset(regionMsg->GetData(), 'r', 100);
+    ASSERT_EQ(push.Send(regionMsg), 100);
+    ASSERT_EQ(pull.Receive(in), 100);
+    ASSERT_EQ(static_cast<char*>(in->GetData())[99], 'r');
+    acked.Wait();
+}
+
+auto ReceiveTarget(string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto shmFactory(TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config));
+    auto zmqFactory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+    auto pool(shmFactory->CreateRegionPool(1000, 4));
+
+    Channel push{"Push", "push", zmqFactory};
+    Channel pull{"Pull", "pull", zmqFactory};
+    push.Bind(_address);
+    pull.Connect(_address);
+    pull.SetReceiveTarget(shmFactory);
+
+    MessagePtr msg(push.NewMessage(1000));
+    memset(msg->GetData(), 's', 1000);
+    ASSERT_EQ(push.Send(msg), 1000);
+    MessagePtr in(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(in), 1000);
+    ASSERT_EQ(in->GetType(), Transport::SHM);
+    ASSERT_EQ(static_cast<char*>(in->GetData())[999], 's');
+
+    pull.SetReceiveTarget(*pool);
+    Parts parts;
+    parts.AddPart(push.NewMessage(100));
+    parts.AddPart(push.NewMessage(5000)); // larger than the slots, created in the managed segment
+    memset(parts.At(0)->GetData(), 'p', 100);
+    ASSERT_EQ(push.Send(parts), 5100);
+    Parts rcvParts;
+    ASSERT_EQ(pull.Receive(rcvParts), 5100);
+    ASSERT_EQ(rcvParts.Size(), 2);
+    char* region = static_cast<char*>(pool->GetRegion()->GetData());
+    char* data = static_cast<char*>(rcvParts.At(0)->GetData());
+    ASSERT_TRUE(data >= region && data < region + pool->GetRegion()->GetSize());
+    ASSERT_EQ(data[99], 'p');
+    ASSERT_EQ(pool->GetNumFreeSlots(), 3);
+    ASSERT_EQ(rcvParts.At(1)->GetType(), Transport::SHM);
+    ASSERT_EQ(rcvParts.At(1)->GetSize(), 5000);
+
+    pull.SetReceiveTarget(nullptr);
+    msg = push.NewMessage(10);
+    ASSERT_EQ(push.Send(msg), 10);
+    ASSERT_EQ(pull.Receive(in), 10);
+    ASSERT_EQ(in->GetType(), Transport::ZMQ);
+}
+
+auto ChunkedTransfer(string const& _address) -> void
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    auto shmFactory(TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config));
+    auto zmqFactory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+
+    Channel push{"Push", "push", zmqFactory};
+    Channel pull{"Pull", "pull", zmqFactory};
+    push.UpdateChunkSize(1000);
+    pull.UpdateChunkSize(1000);
+    vector<pair<size_t, size_t>> chunks; // part, end of the chunk
+    pull.SetChunkCallback([&](const Message& part, size_t partIndex, size_t offset, size_t size) {
+        ASSERT_EQ(static_cast<const char*>(part.GetData())[offset + size - 1], 'c');
+        chunks.emplace_back(partIndex, offset + size);
+    });
+    push.Bind(_address);
+    pull.Connect(_address);
+
+    // streamed in 11 chunks, assembled in the receive target
+    pull.SetReceiveTarget(shmFactory);
+    MessagePtr msg(push.NewMessage(10500));
+    memset(msg->GetData(), 'c', 10500);
+    ASSERT_EQ(push.Send(msg), 10500);
+    MessagePtr in(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(in), 10500);
+    ASSERT_EQ(in->GetType(), Transport::SHM);
+    ASSERT_EQ(in->GetSize(), 10500);
+    ASSERT_EQ(static_cast<char*>(in->GetData())[0], 'c');
+    ASSERT_EQ(static_cast<char*>(in->GetData())[10499], 'c');
+    ASSERT_EQ(chunks.size(), 11);
+    ASSERT_EQ(chunks.back(), make_pair(size_t(0), size_t(10500)));
+
+    // multipart with a large part: all parts are streamed, the empty one has no chunks
+    pull.SetReceiveTarget(nullptr);
+    chunks.clear();
+    vector<size_t> const sizes{10, 2500, 0};
+    Parts parts;
+    for (size_t size : sizes) {
+        parts.AddPart(push.NewMessage(size));
+        memset(parts.At(parts.Size() - 1)->GetData(), 'c', size);
+    }
+    ASSERT_EQ(push.Send(parts), 2510);
+    Parts rcvParts;
+    ASSERT_EQ(pull.Receive(rcvParts), 2510);
+    ASSERT_EQ(rcvParts.Size(), sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        ASSERT_EQ(rcvParts.At(i)->GetSize(), sizes[i]);
+    }
+    ASSERT_EQ(rcvParts.At(0)->GetType(), Transport::ZMQ);
+    ASSERT_EQ(static_cast<char*>(rcvParts.At(1)->GetData())[2499], 'c');
+    ASSERT_EQ(chunks.size(), 4);
+
+    // small parts follow the descriptor in the same message
+    chunks.clear();
+    Parts smallParts;
+    smallParts.AddPart(push.NewMessage(10));
+    smallParts.AddPart(push.NewMessage(1000));
+    ASSERT_EQ(push.Send(smallParts), 1010);
+    Parts rcvSmallParts;
+    ASSERT_EQ(pull.Receive(rcvSmallParts), 1010);
+    ASSERT_EQ(rcvSmallParts.Size(), 2);
+    ASSERT_EQ(rcvSmallParts.At(1)->GetSize(), 1000);
+    ASSERT_TRUE(chunks.empty());
+
+    ASSERT_EQ(pull.Receive(in, 0), static_cast<int64_t>(TransferCode::timeout));
+}
+
+auto ZeromqMessagePool(string const & _address) -> void
+{
+    size_t session{tools::UuidHash()};
+    std::string address(tools::ToString(_address, "_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::ToString(session));
+    config.SetProperty<bool>("zmq-msg-pool", true);
+    config.SetProperty<size_t>("zmq-msg-pool-depth", 4);
+
+    auto factory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+    auto& zFactory = static_cast<zmq::TransportFactory&>(*factory);
+
+    // buffers of closed messages are reused for messages of the same size class
+    for (int i = 0; i < 10; ++i) {
+        auto msg(factory->CreateMessage(1000));
+        ASSERT_NE(msg->GetData(), nullptr);
+        ASSERT_EQ(msg->GetSize(), 1000);
+        memset(msg->GetData(), i, msg->GetSize());
+    }
+    EXPECT_EQ(zFactory.GetMessagePoolStats().misses, 1);
+    EXPECT_EQ(zFactory.GetMessagePoolStats().hits, 9);
+
+    // small payloads are not pooled
+    auto small(factory->CreateMessage(10));
+    small->Rebuild(1000);
+    EXPECT_EQ(zFactory.GetMessagePoolStats().hits, 10);
+    small.reset();
+
+    Channel push("Push", "push", factory);
+    Channel pull("Pull", "pull", factory);
+    push.Bind(address);
+    pull.Connect(address);
+
+    auto out(push.NewMessage(1000));
+    memcpy(out->GetData(), "pool", 4);
+    ASSERT_EQ(push.Send(out), 1000);
+    auto in(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(in), 1000);
+    ASSERT_EQ(AsStringView(*in).substr(0, 4), "pool");
+    EXPECT_GT(zFactory.GetMessagePoolStats().HitRate(), 0.8);
+
+    // misaligned received payloads are moved into (pooled) aligned buffers
+    for (int i = 0; i < 10; ++i) {
+        auto alignedOut(push.NewMessage(1000));
+        memset(alignedOut->GetData(), i, alignedOut->GetSize());
+        ASSERT_EQ(push.Send(alignedOut), 1000);
+        auto alignedIn(pull.NewMessage(Alignment{64}));
+        ASSERT_EQ(pull.Receive(alignedIn), 1000);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(alignedIn->GetData()) % 64, 0);
+        ASSERT_EQ(static_cast<char*>(alignedIn->GetData())[999], static_cast<char>(i));
+    }
+}
+
 TEST(Resize, zeromq) // NOLINT
 {
     RunPushPullWithMsgResize("zeromq", "ipc://test_message_resize");
@@ -418,4 +1120,119 @@ TEST(ZeroCopyFromUnmanaged, shmem) // NOLINT
     ZeroCopyFromUnmanaged("ipc://test_zerocopy_unmanaged");
 }
 
+TEST(CreateMessages, zeromq) // NOLINT
+{
+    CreateMessages("zeromq", "ipc://test_create_messages");
+}
+
+TEST(CreateMessages, shmem) // NOLINT
+{
+    CreateMessages("shmem", "ipc://test_create_messages");
+}
+
+TEST(Pool, zeromq) // NOLINT
+{
+    ZeromqMessagePool("ipc://test_message_pool");
+}
+
+TEST(PackedParts, zeromq) // NOLINT
+{
+    PackedParts("ipc://test_packed_parts");
+}
+
+TEST(SendCopy, zeromq) // NOLINT
+{
+    SendCopy("zeromq", "ipc://test_send_copy", 0);
+}
+
+TEST(SendCopy, zeromq_packed) // NOLINT
+{
+    SendCopy("zeromq", "ipc://test_send_copy", 256);
+}
+
+TEST(SendCopy, shmem) // NOLINT
+{
+    SendCopy("shmem", "ipc://test_send_copy", 0);
+}
+
+TEST(Forward, zeromq) // NOLINT
+{
+    Forward("zeromq", "ipc://test_forward");
+}
+
+TEST(Forward, shmem) // NOLINT
+{
+    Forward("shmem", "ipc://test_forward");
+}
+
+TEST(Tracing, zeromq) // NOLINT
+{
+    Tracing("zeromq", "ipc://test_tracing");
+}
+
+TEST(Tracing, shmem) // NOLINT
+{
+    Tracing("shmem", "ipc://test_tracing");
+}
+
+TEST(ArenaParts, shmem) // NOLINT
+{
+    ArenaParts();
+}
+
+TEST(TypedViews, zeromq) // NOLINT
+{
+    TypedViews("zeromq", "ipc://test_typed_views");
+}
+
+TEST(TypedViews, shmem) // NOLINT
+{
+    TypedViews("shmem", "ipc://test_typed_views");
+}
+
+TEST(Grow, zeromq) // NOLINT
+{
+    Grow("zeromq", "ipc://test_grow");
+}
+
+TEST(Grow, shmem) // NOLINT
+{
+    Grow("shmem", "ipc://test_grow");
+}
+
+TEST(ShmemOverZeromq, zeromq) // NOLINT
+{
+    ShmemOverZeromq("ipc://test_shmem_over_zeromq");
+}
+
+TEST(ReceiveTarget, zeromq) // NOLINT
+{
+    ReceiveTarget("ipc://test_receive_target");
+}
+
+TEST(ChunkedTransfer, zeromq) // NOLINT
+{
+    ChunkedTransfer("ipc://test_chunked_transfer");
+}
+
+TEST(MakeWritable, zeromq) // NOLINT
+{
+    MakeWritable("zeromq");
+}
+
+TEST(MakeWritable, shmem) // NOLINT
+{
+    MakeWritable("shmem");
+}
+
+TEST(Headroom, zeromq) // NOLINT
+{
+    PrependHeaders("zeromq", "ipc://test_headroom");
+}
+
+TEST(Headroom, shmem) // NOLINT
+{
+    PrependHeaders("shmem", "ipc://test_headroom");
+}
+
 } // namespace
@@ -13,6 +13,7 @@
 #include <fairmq/Device.h>
 #include <fairmq/ProgOptions.h>
 #include <fairmq/Tools.h>
+#include <fairmq/plugins/metrics/Metrics.h>
 
 #include <gtest/gtest.h>
 
@@ -100,6 +101,34 @@ TEST(PluginManager, LoadPluginStatic)
     mgr.WaitForPluginsToReleaseDeviceControl();
 }
 
+TEST(PluginManager, MetricsPlugin)
+{
+    Device device;
+    PluginManager mgr;
+    device.SetTransport("zeromq");
+
+    ASSERT_NO_THROW(mgr.LoadPlugin("s:metrics"));
+
+    ProgOptions config;
+    config.SetProperty("metrics-port", 29517);
+    config.SetProperty<string>("metrics-address", "127.0.0.1");
+    mgr.EmplacePluginServices(config, device);
+
+    ASSERT_NO_THROW(mgr.InstantiatePlugins());
+
+    thread t(control, std::ref(device));
+    device.RunStateMachine();
+    if (t.joinable()) {
+        t.join();
+    }
+
+    string metrics;
+    mgr.ForEachPlugin([&](Plugin& plugin){ metrics = dynamic_cast<plugins::Metrics&>(plugin).Collect(); });
+    EXPECT_NE(metrics.find("fairmq_device_state{state=\"EXITING\"} 1"), string::npos);
+    EXPECT_NE(metrics.find("fairmq_state_entered_total{state=\"DEVICE READY\"} 1"), string::npos);
+    EXPECT_NE(metrics.find("# TYPE fairmq_state_last_duration_seconds gauge"), string::npos);
+}
+
 TEST(PluginManager, Factory)
 {
     const auto args = vector<string>{"-l", "debug", "--help", "-S", ">/lib", "</home/user/lib", "/usr/local/lib", "/usr/lib"};
@@ -23,7 +23,7 @@ using namespace std;
 using namespace fair::mq::test;
 using namespace fair::mq::tools;
 
-auto RunPoller(string transport, int pollType) -> void
+auto RunPoller(string transport, int pollType, string pollerBackend = "zmq_poll") -> void
 {
     size_t session{UuidHash()};
     string data1IpcFile("/tmp/fmq_" + to_string(session) + "_data1_" + transport);
@@ -55,6 +55,7 @@ auto RunPoller(string transport, int pollType) -> void
             << " --shm-monitor true"
             << " --session " << session
             << " --poll-type " << pollType
+            << " --zmq-poller " << pollerBackend
             << " --channel-config name=data1,type=pull,method=connect,address=" << data1Address
             << "                  name=data2,type=pull,method=connect,address=" << data2Address;
         pollin = execute(cmd.str(), "[POLLIN]");
@@ -90,4 +91,24 @@ TEST(Channel, shmem)
     EXPECT_EXIT(RunPoller("shmem", 1), ::testing::ExitedWithCode(0), "POLL test successfull");
 }
 
+TEST(Epoll, zeromq)
+{
+    EXPECT_EXIT(RunPoller("zeromq", 1, "epoll"), ::testing::ExitedWithCode(0), "POLL test successfull");
+}
+
+TEST(Epoll, shmem)
+{
+    EXPECT_EXIT(RunPoller("shmem", 1, "epoll"), ::testing::ExitedWithCode(0), "POLL test successfull");
+}
+
+TEST(ReadyInputs, zeromq)
+{
+    EXPECT_EXIT(RunPoller("zeromq", 2, "epoll"), ::testing::ExitedWithCode(0), "POLL test successfull");
+}
+
+TEST(ReadyInputs, shmem)
+{
+    EXPECT_EXIT(RunPoller("shmem", 2, "epoll"), ::testing::ExitedWithCode(0), "POLL test successfull");
+}
+
 } // namespace
@@ -0,0 +1,124 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/BinaryConfig.h>
+#include <fairmq/JSONParser.h>
+#include <fairmq/Properties.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#define BOOST_BIND_GLOBAL_PLACEHOLDERS
+#include <boost/property_tree/json_parser.hpp>
+#undef BOOST_BIND_GLOBAL_PLACEHOLDERS
+#include <boost/property_tree/ptree.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace {
+
+using namespace std;
+using namespace fair::mq;
+
+constexpr auto topology = R"({
+    "fairMQOptions": {
+        "devices": [
+            {
+                "id": "sampler",
+                "channels": [{ "name": "data", "sockets": [{ "type": "push", "method": "bind", "address": "tcp://*:5555" }] }]
+            },
+            {
+                "key": "processor",
+                "id": "ignored \"quoted\" id",
+                "channels": [
+                    { "name": "data-in", "type": "pull", "method": "connect", "numSockets": "2", "rateLogging": "0" },
+                    { "name": "data-out", "sockets": [{ "type": "push", "address": "tcp://localhost:5556", "sndBufSize": 10 },
+                                                      { "type": "push", "address": "tcp://localhost:5557", "trace": "true" }] }
+                ]
+            },
+            {
+                "id": "sink",
+                "channels": [{ "name": "data", "type": "pull", "method": "connect", "address": "tcp://localhost:5556" }]
+            }
+        ]
+    }
+})";
+
+auto asString(Properties const& properties, string const& key) -> string
+{
+    return PropertyHelper::ConvertPropertyToString(properties.at(key));
+}
+
+auto expectEqual(Properties const& a, Properties const& b) -> void
+{
+    ASSERT_EQ(a.size(), b.size());
+    for (auto const& p : a) {
+        EXPECT_EQ(asString(a, p.first), asString(b, p.first)) << p.first;
+    }
+}
+
+struct ConfigFiles : ::testing::Test
+{
+    ConfigFiles()
+        : json(tools::ToString("/tmp/fairmq_test_config_", tools::Uuid(), ".json"))
+        , binary(tools::ToString("/tmp/fairmq_test_config_", tools::Uuid(), ".bin"))
+    {
+        ofstream(json) << topology;
+    }
+
+    ~ConfigFiles() override
+    {
+        remove(json.c_str());
+        remove(binary.c_str());
+    }
+
+    auto fromTree(string const& id) const -> Properties
+    {
+        boost::property_tree::ptree pt;
+        boost::property_tree::read_json(json, pt);
+        return PtreeParser(pt, id);
+    }
+
+    string json;
+    string binary;
+};
+
+TEST_F(ConfigFiles, JSONParserSelectsDevice)
+{
+    for (string const id : {"sampler", "processor", "sink", "unknown"}) {
+        expectEqual(JSONParser(json, id), fromTree(id));
+    }
+
+    Properties processor(JSONParser(json, "processor"));
+    EXPECT_EQ(asString(processor, "chans.data-in.1.type"), "pull");
+    EXPECT_EQ(asString(processor, "chans.data-out.0.sndBufSize"), "10");
+    EXPECT_EQ(asString(processor, "chans.data-out.1.trace"), "true");
+    EXPECT_EQ(asString(processor, "chans.data-out.1.address"), "tcp://localhost:5557");
+    EXPECT_THROW(JSONParser(json, ""), ParserError);
+}
+
+TEST_F(ConfigFiles, BinaryConfig)
+{
+    CompileJSONConfig(json, binary);
+    EXPECT_TRUE(IsBinaryConfig(binary));
+    EXPECT_FALSE(IsBinaryConfig(json));
+
+    for (string const id : {"sampler", "processor", "sink"}) {
+        expectEqual(BinaryConfigParser(binary, id), fromTree(id));
+    }
+    EXPECT_TRUE(BinaryConfigParser(binary, "unknown").empty());
+
+    // truncated file
+    ofstream(binary, ios::binary | ios::trunc) << "FMQCFG01\x05";
+    EXPECT_THROW(BinaryConfigParser(binary, "sampler"), ParserError);
+}
+
+}   // namespace
@@ -191,6 +191,61 @@ TEST(ProgOptions, SubscribeAndSet)
                                         { fs::path("C:\\Windows"), fs::path("C:\\Windows\\System32") });
 }
 
+TEST(ProgOptions, PropertiesChange)
+{
+    ProgOptions o;
+    o.SetProperty<int>("_a", 1);
+    o.SetProperty<string>("_b", "one");
+
+    vector<vector<string>> batches;
+    o.SubscribeToPropertiesChange("test", [&](const vector<string>& keys) { batches.push_back(keys); });
+
+    o.SetProperties({{"_a", Property(2)}, {"_b", Property(string("two"))}, {"_c", Property(3.0)}});
+    EXPECT_TRUE(o.UpdateProperties({{"_a", Property(3)}, {"_b", Property(string("three"))}}));
+    EXPECT_FALSE(o.UpdateProperties({{"_a", Property(4)}, {"_missing", Property(4)}}));
+    o.SetProperty<int>("_a", 5);
+    o.UnsubscribeFromPropertiesChange("test");
+    o.SetProperty<int>("_a", 6);
+
+    ASSERT_EQ(batches.size(), 3);
+    EXPECT_EQ(batches.at(0), vector<string>({"_a", "_b", "_c"}));
+    EXPECT_EQ(batches.at(1), vector<string>({"_a", "_b"}));
+    EXPECT_EQ(batches.at(2), vector<string>({"_a"}));
+    EXPECT_EQ(o.GetProperty<int>("_a"), 6);
+}
+
+TEST(ProgOptions, PropertyHandle)
+{
+    ProgOptions o;
+
+    EXPECT_THROW(o.GetPropertyHandle<int>("_missing"), PropertyNotFoundError);
+
+    o.SetProperty<int>("_int", 1);
+    o.SetProperty<string>("_string", "one");
+    PropertyHandle<int> i = o.GetPropertyHandle<int>("_int");
+    PropertyHandle<string> s = o.GetPropertyHandle<string>("_string");
+    ASSERT_TRUE(i);
+    ASSERT_FALSE(PropertyHandle<int>());
+    EXPECT_EQ(i.Get(), 1);
+    EXPECT_EQ(s.Get(), "one");
+
+    o.SetProperty<int>("_int", 2);
+    o.UpdateProperty<string>("_string", "two");
+    EXPECT_EQ(i.Get(), 2);
+    EXPECT_EQ(o.GetPropertyHandle<int>("_int").Get(), 2);
+    EXPECT_EQ(s.Get(), "two");
+
+    o.SetProperties({{"_int", Property(3)}, {"_string", Property(string("three"))}});
+    EXPECT_EQ(i.Get(), 3);
+    EXPECT_EQ(s.Get(), "three");
+
+    // value of another type or deleted property: the handle keeps the last value
+    o.SetProperty<double>("_int", 4.0);
+    EXPECT_EQ(i.Get(), 3);
+    o.DeleteProperty("_string");
+    EXPECT_EQ(s.Get(), "three");
+}
+
 TEST(PropertyHelper, ConvertPropertyToString)
 {
     EXPECT_EQ(PropertyHelper::ConvertPropertyToString(Property(static_cast<char>('a'))), "a");
@@ -13,6 +13,8 @@
 
 #include <fairmq/TransportFactory.h>
 #include <fairmq/ProgOptions.h>
+#include <fairmq/RegionExtents.h>
+#include <fairmq/tools/Gpu.h>
 #include <fairmq/tools/Unique.h>
 #include <fairmq/tools/Semaphore.h>
 #include <fairmq/tools/Strings.h>
@@ -21,13 +23,23 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm> // sort
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstring> // memset
 #include <map>
 #include <memory> // make_unique
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <utility> // pair
 #include <vector> // pair
 
+#include <fcntl.h> // fcntl
+#include <unistd.h> // pread, pwrite, sysconf, close
+
 namespace
 {
 
@@ -335,6 +347,868 @@ void RegionCallbacks(const string& transport, const string& _address)
     LOG(info) << "2 done.";
 }
 
+void RegionAckLatency(bool adaptive, bool ring)
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_ack_latency_", adaptive, ring, "_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    RegionConfig invalidCfg;
+    invalidCfg.ackBunchSize = 0;
+    ASSERT_THROW(factory->CreateUnmanagedRegion(1000000, [](void*, size_t, void*) {}, invalidCfg), TransportError);
+
+    // a single ack must arrive immediately (adaptive, long before the maximum delay of 10s) or after the configured 1ms,
+    // the bound leaves room for scheduling only
+    RegionConfig cfg;
+    cfg.ackMaxDelayUs = adaptive ? 10000000 : 1000;
+    cfg.ackAdaptive = adaptive;
+    cfg.ackRing = ring;
+    tools::Semaphore blocker;
+    auto region = factory->CreateUnmanagedRegion(1000000, [&](void*, size_t, void*) { blocker.Signal(); }, cfg);
+
+    for (int i = 0; i < 3; ++i) {
+        {
+            MessagePtr msgOut(push.NewMessage(region, region->GetData(), 100, nullptr));
+            ASSERT_EQ(push.Send(msgOut), 100);
+        }
+        auto start = chrono::steady_clock::now();
+        {
+            MessagePtr msgIn(pull.NewMessage());
+            ASSERT_EQ(pull.Receive(msgIn), 100);
+        }
+        blocker.Wait();
+        ASSERT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(100));
+    }
+}
+
+void RegionAckCallbackThreads()
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_ack_callback_threads_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    constexpr size_t numMsgs = 400;
+    constexpr size_t numHints = 8;
+    constexpr size_t msgSize = 100;
+
+    // per hint: the thread that processed it
+    mutex mtx;
+    map<size_t, thread::id> seen;
+    bool sameThread = true;
+    tools::Semaphore blocker;
+
+    RegionConfig cfg;
+    cfg.ackCallbackThreads = 4;
+    cfg.ackSharding = RegionAckSharding::hint;
+    cfg.ackMaxDelayUs = 1000;
+    auto region = factory->CreateUnmanagedRegion(numMsgs * msgSize, [&](const std::vector<RegionBlock>& blocks) {
+        lock_guard<mutex> lock(mtx);
+        for (const auto& block : blocks) {
+            auto hint = reinterpret_cast<size_t>(block.hint);
+            auto it = seen.find(hint);
+            if (it == seen.end()) {
+                seen.emplace(hint, this_thread::get_id());
+            } else {
+                sameThread = sameThread && it->second == this_thread::get_id();
+            }
+            blocker.Signal();
+        }
+    }, cfg);
+
+    for (size_t i = 0; i < numMsgs; ++i) {
+        MessagePtr msgOut(push.NewMessage(region, static_cast<char*>(region->GetData()) + i * msgSize, msgSize, reinterpret_cast<void*>(1 + i % numHints)));
+        ASSERT_EQ(push.Send(msgOut), static_cast<int64_t>(msgSize));
+    }
+    for (size_t i = 0; i < numMsgs; ++i) {
+        MessagePtr msgIn(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(msgSize));
+    }
+    for (size_t i = 0; i < numMsgs; ++i) {
+        blocker.Wait();
+    }
+
+    lock_guard<mutex> lock(mtx);
+    ASSERT_EQ(seen.size(), numHints);
+    ASSERT_TRUE(sameThread);
+}
+
+void RegionAckReactor()
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_ack_reactor_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<bool>("shm-ack-reactor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    constexpr size_t numRegions = 6;
+    constexpr size_t numMsgs = 100;
+    constexpr size_t msgSize = 100;
+
+    // the callbacks of all regions run on the reactor thread
+    mutex mtx;
+    set<thread::id> threads;
+    tools::Semaphore blocker;
+
+    vector<UnmanagedRegionPtr> regions;
+    for (size_t r = 0; r < numRegions; ++r) {
+        RegionConfig cfg;
+        cfg.ackRing = r % 2 == 1;
+        cfg.ackAdaptive = r % 3 == 0;
+        cfg.ackMaxDelayUs = 1000;
+        regions.push_back(factory->CreateUnmanagedRegion(numMsgs * msgSize, [&](void*, size_t, void*) {
+            {
+                lock_guard<mutex> lock(mtx);
+                threads.insert(this_thread::get_id());
+            }
+            blocker.Signal();
+        }, cfg));
+    }
+
+    for (size_t i = 0; i < numMsgs; ++i) {
+        for (auto& region : regions) {
+            MessagePtr msgOut(push.NewMessage(region, static_cast<char*>(region->GetData()) + i * msgSize, msgSize, nullptr));
+            ASSERT_EQ(push.Send(msgOut), static_cast<int64_t>(msgSize));
+            MessagePtr msgIn(pull.NewMessage());
+            ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(msgSize));
+        }
+    }
+    for (size_t i = 0; i < numRegions * numMsgs; ++i) {
+        blocker.Wait();
+    }
+
+    {
+        lock_guard<mutex> lock(mtx);
+        ASSERT_EQ(threads.size(), 1u);
+        ASSERT_NE(*threads.begin(), this_thread::get_id());
+    }
+
+    // regions leave the reactor one by one, the remaining ones keep getting their acks
+    regions.erase(regions.begin());
+    {
+        MessagePtr msgOut(push.NewMessage(regions.back(), regions.back()->GetData(), msgSize, nullptr));
+        ASSERT_EQ(push.Send(msgOut), static_cast<int64_t>(msgSize));
+        MessagePtr msgIn(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(msgSize));
+    }
+    blocker.Wait();
+    regions.clear();
+}
+
+void RegionPoolRecycling(const string& transport)
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_pool_", transport, "_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    constexpr size_t numSlots = 10;
+    RegionConfig cfg;
+    cfg.ackMaxDelayUs = 1000;
+    auto pool = factory->CreateRegionPool({{1000, numSlots}, {100, numSlots}}, cfg);
+    ASSERT_EQ(pool->GetNumSlots(), 2 * numSlots);
+    ASSERT_EQ(pool->GetMaxMessageSize(), 1000);
+    ASSERT_THROW(pool->NewMessage(1001), RegionPoolError);
+
+    // small messages take the small slots first, then fall back to the large ones
+    vector<MessagePtr> msgs;
+    for (size_t i = 0; i < 2 * numSlots; ++i) {
+        MessagePtr msg(pool->NewMessage(100));
+        ASSERT_NE(msg, nullptr);
+        msgs.push_back(std::move(msg));
+    }
+    ASSERT_EQ(pool->GetNumFreeSlots(), 0);
+    ASSERT_EQ(pool->NewMessage(10), nullptr);
+    ASSERT_EQ(pool->NewMessage(10, 10), nullptr);
+
+    for (auto& msg : msgs) {
+        ASSERT_EQ(push.Send(msg), 100);
+        MessagePtr msgIn(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msgIn), 100);
+    }
+    msgs.clear();
+
+    // waits until a slot is returned by the transport
+    MessagePtr msg(pool->NewMessage(1000, 1000));
+    ASSERT_NE(msg, nullptr);
+    msg.reset();
+
+    for (int i = 0; i < 1000 && pool->GetNumFreeSlots() != pool->GetNumSlots(); ++i) {
+        this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    ASSERT_EQ(pool->GetNumFreeSlots(), pool->GetNumSlots());
+}
+
+void RegionRefCountSlab(uint32_t refCountSlots)
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_ref_count_slab_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    constexpr size_t numMsgs = 4;
+    constexpr size_t numCopies = 3;
+    constexpr size_t msgSize = 100;
+    tools::Semaphore blocker;
+    atomic<size_t> numAcks(0);
+
+    RegionConfig cfg;
+    cfg.ackMaxDelayUs = 1000;
+    cfg.refCountSlots = refCountSlots;
+    auto region = factory->CreateUnmanagedRegion(numMsgs * msgSize, [&](const std::vector<RegionBlock>& blocks) {
+        numAcks += blocks.size();
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            blocker.Signal();
+        }
+    }, cfg);
+
+    size_t const initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{to_string(session)}, 0);
+    {
+        vector<MessagePtr> msgs;
+        for (size_t i = 0; i < numMsgs; ++i) {
+            MessagePtr msg(push.NewMessage(region, static_cast<char*>(region->GetData()) + i * msgSize, msgSize));
+            for (size_t c = 0; c < numCopies; ++c) {
+                MessagePtr copy(push.NewMessage());
+                copy->Copy(*msg);
+                msgs.push_back(std::move(copy));
+            }
+            msgs.push_back(std::move(msg));
+        }
+        if (refCountSlots >= numMsgs) {
+            // all ref counts are in the region slab
+            ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{to_string(session)}, 0), initialFree);
+        } else {
+            ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{to_string(session)}, 0), initialFree);
+        }
+
+        // the copies are shared with the receiver
+        for (auto& msg : msgs) {
+            ASSERT_EQ(push.Send(msg), static_cast<int64_t>(msgSize));
+            MessagePtr msgIn(pull.NewMessage());
+            ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(msgSize));
+        }
+    }
+
+    // one ack per block, once the last copy is gone
+    for (size_t i = 0; i < numMsgs; ++i) {
+        blocker.Wait();
+    }
+    this_thread::sleep_for(chrono::milliseconds(50));
+    ASSERT_EQ(numAcks, numMsgs);
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{to_string(session)}, 0), initialFree);
+}
+
+void RegionRingBuffer()
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_ring_buffer_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    constexpr size_t regionSize = 4096;
+    constexpr size_t msgSize = 1000; // 1024 bytes with the block header
+    RegionConfig cfg;
+    cfg.ringBuffer = true;
+    auto region = factory->CreateUnmanagedRegion(regionSize, RegionCallback(nullptr), cfg);
+    ASSERT_EQ(region->GetFreeSpace(), regionSize);
+    ASSERT_EQ(region->GetAckedOffset(), 0u);
+    ASSERT_THROW(region->Allocate(regionSize), TransportError);
+
+    auto transfer = [&](void* ptr) {
+        MessagePtr msg(push.NewMessage(region, ptr, msgSize));
+        EXPECT_EQ(push.Send(msg), static_cast<int64_t>(msgSize));
+        MessagePtr msgIn(pull.NewMessage());
+        EXPECT_EQ(pull.Receive(msgIn), static_cast<int64_t>(msgSize));
+        return msgIn;
+    };
+
+    vector<MessagePtr> msgs;
+    for (size_t i = 0; i < 4; ++i) {
+        void* ptr = region->Allocate(msgSize);
+        ASSERT_NE(ptr, nullptr);
+        memset(ptr, static_cast<int>(i), msgSize);
+        msgs.push_back(transfer(ptr));
+        ASSERT_EQ(static_cast<char*>(msgs.back()->GetData())[0], static_cast<char>(i));
+    }
+    ASSERT_EQ(region->GetFreeSpace(), 0u);
+    ASSERT_EQ(region->Allocate(msgSize), nullptr);
+    ASSERT_EQ(region->Allocate(msgSize, 10), nullptr);
+
+    // out of order releases are only acknowledged once the oldest block is released
+    msgs[2].reset();
+    msgs[1].reset();
+    ASSERT_EQ(region->GetAckedOffset(), 0u);
+    ASSERT_EQ(region->GetFreeSpace(), 0u);
+    msgs[0].reset();
+    ASSERT_EQ(region->GetAckedOffset(), 3072u);
+    ASSERT_EQ(region->GetFreeSpace(), 3072u);
+
+    char* base = static_cast<char*>(region->GetData());
+    void* ptr = region->Allocate(2500); // 2528 bytes
+    ASSERT_EQ(ptr, base + 16);
+    msgs[0] = transfer(ptr);
+    ASSERT_EQ(region->GetFreeSpace(), 544u);
+
+    // a blocked allocation continues once the oldest block is released
+    thread releaser([&]() {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        msgs[3].reset();
+    });
+    ptr = region->Allocate(msgSize, -1);
+    releaser.join();
+    ASSERT_EQ(ptr, base + 2528 + 16);
+    ASSERT_EQ(region->GetAckedOffset(), 4096u);
+    msgs[1] = transfer(ptr);
+
+    // a block that does not fit at the end of the region starts at its beginning, the rest of the region counts as used
+    ASSERT_EQ(region->Allocate(msgSize), nullptr);
+    msgs[0].reset();
+    ASSERT_EQ(region->GetAckedOffset(), 4096u + 2528u);
+    ptr = region->Allocate(msgSize);
+    ASSERT_EQ(ptr, base + 16);
+    msgs[2] = transfer(ptr);
+    ASSERT_EQ(region->GetFreeSpace(), 1504u);
+
+    msgs.clear();
+    ASSERT_EQ(region->GetFreeSpace(), regionSize);
+    ASSERT_EQ(region->GetAckedOffset(), 9216u);
+}
+
+void RegionSlotPool()
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_slot_pool_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    // the creator of the pool and another producer of the session (a process of its own in a real setup)
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    auto factory2 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    Channel pull("Pull", "pull", factory);
+    pull.Bind(address);
+    Channel push("Push", "push", factory2);
+    push.Connect(address);
+
+    constexpr size_t slotSize = 1000; // 1024 bytes with the alignment
+    RegionConfig cfg;
+    cfg.slotSize = slotSize;
+    auto region = factory->CreateUnmanagedRegion(64 * 1024, RegionCallback(nullptr), cfg);
+    const size_t numSlots = region->GetFreeSpace() / 1024;
+    ASSERT_GT(numSlots, 0u);
+    ASSERT_THROW(region->Allocate(slotSize + 100), TransportError);
+
+    ASSERT_EQ(factory2->OpenUnmanagedRegion(region->GetId() + 1), nullptr);
+    auto opened = factory2->OpenUnmanagedRegion(region->GetId());
+    ASSERT_NE(opened, nullptr);
+    ASSERT_EQ(opened->GetFreeSpace(), numSlots * 1024);
+
+    // both allocate from the same free list, the mappings of the two may be at different addresses
+    vector<MessagePtr> msgs;
+    for (size_t i = 0; i < numSlots; ++i) {
+        auto& from = (i % 2 == 0) ? opened : region;
+        void* ptr = from->Allocate(slotSize);
+        ASSERT_NE(ptr, nullptr);
+        char* data = static_cast<char*>(opened->GetData()) + (static_cast<char*>(ptr) - static_cast<char*>(from->GetData()));
+        MessagePtr msg(push.NewMessage(opened, data, slotSize));
+        memset(msg->GetData(), static_cast<int>(i), slotSize);
+        ASSERT_EQ(push.Send(msg), static_cast<int64_t>(slotSize));
+        MessagePtr msgIn(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(slotSize));
+        ASSERT_EQ(static_cast<char*>(msgIn->GetData())[slotSize - 1], static_cast<char>(i));
+        msgs.push_back(std::move(msgIn));
+    }
+    ASSERT_EQ(region->GetFreeSpace(), 0u);
+    ASSERT_EQ(opened->Allocate(slotSize), nullptr);
+    ASSERT_EQ(region->Allocate(slotSize, 10), nullptr);
+
+    // a released slot goes back to the free list right away, waking a blocked allocation of the other producer
+    thread releaser([&]() {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        msgs[3].reset();
+    });
+    void* ptr = opened->Allocate(slotSize, -1);
+    releaser.join();
+    ASSERT_NE(ptr, nullptr);
+    ASSERT_EQ(opened->GetFreeSpace(), 0u);
+
+    msgs.clear();
+    ASSERT_EQ(region->GetFreeSpace(), (numSlots - 1) * 1024);
+    opened.reset(); // does not remove the region
+    ASSERT_NE(region->Allocate(slotSize), nullptr);
+}
+
+void RegionExternalDescriptor(const string& transport)
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_external_descriptor_", transport, "_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    // stands in for the device file of a readout card
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    int fd = shmem::CreateMemfd(tools::ToString("test_region_external_", session), 3 * pageSize, false);
+    ASSERT_NE(fd, -1);
+    const string pattern("external");
+    ASSERT_EQ(pwrite(fd, pattern.data(), pattern.size(), static_cast<off_t>(pageSize)), static_cast<ssize_t>(pattern.size()));
+
+    tools::Semaphore blocker;
+    RegionConfig cfg;
+    cfg.fd = fd;
+    cfg.fdOffset = pageSize;
+    cfg.ackMaxDelayUs = 1000;
+    {
+        auto region = factory->CreateUnmanagedRegion(pageSize, [&](void*, size_t, void*) { blocker.Signal(); }, cfg);
+        ASSERT_EQ(region->GetSize(), pageSize);
+        ASSERT_EQ(string(static_cast<char*>(region->GetData()), pattern.size()), pattern);
+
+        // written through the region, visible in the descriptor
+        memset(static_cast<char*>(region->GetData()) + 100, 'r', 10);
+        char buf[10];
+        ASSERT_EQ(pread(fd, buf, sizeof(buf), static_cast<off_t>(pageSize + 100)), static_cast<ssize_t>(sizeof(buf)));
+        ASSERT_EQ(string(buf, sizeof(buf)), string(10, 'r'));
+
+        {
+            MessagePtr msg(push.NewMessage(region, region->GetData(), pattern.size()));
+            ASSERT_EQ(push.Send(msg), static_cast<int64_t>(pattern.size()));
+            MessagePtr msgIn(pull.NewMessage());
+            ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(pattern.size()));
+            ASSERT_EQ(string(static_cast<char*>(msgIn->GetData()), msgIn->GetSize()), pattern);
+        }
+        blocker.Wait();
+    }
+
+    // the descriptor stays with the caller
+    ASSERT_NE(fcntl(fd, F_GETFD), -1);
+    close(fd);
+}
+
+void RegionResize()
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_resize_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    // views the region like another process of the session
+    auto viewerFactory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    tools::Semaphore blocker;
+    RegionConfig cfg;
+    cfg.maxSize = 64 * pageSize;
+    cfg.ackMaxDelayUs = 1000;
+    auto region = factory->CreateUnmanagedRegion(4 * pageSize, [&](void*, size_t, void*) { blocker.Signal(); }, cfg);
+    void* ptr = region->GetData();
+    ASSERT_EQ(region->GetSize(), 4 * pageSize);
+
+    tools::Semaphore resized;
+    atomic<size_t> resizedTo(0);
+    viewerFactory->SubscribeToRegionEvents([&](RegionInfo info) {
+        if (!info.managed && info.id == region->GetId() && info.event == RegionEvent::resized) {
+            EXPECT_EQ(info.ptr, ptr);
+            resizedTo = info.size;
+            resized.Signal();
+        }
+    });
+
+    ASSERT_FALSE(region->Resize(65 * pageSize));
+    ASSERT_TRUE(region->Resize(64 * pageSize));
+    ASSERT_EQ(region->GetSize(), 64 * pageSize);
+    ASSERT_EQ(region->GetData(), ptr);
+    resized.Wait();
+    ASSERT_EQ(resizedTo, 64 * pageSize);
+
+    // a message in the added part
+    const string pattern("resized");
+    char* end = static_cast<char*>(ptr) + 64 * pageSize - pageSize;
+    memcpy(end, pattern.data(), pattern.size());
+    {
+        MessagePtr msg(push.NewMessage(region, end, pattern.size()));
+        ASSERT_EQ(push.Send(msg), static_cast<int64_t>(pattern.size()));
+        MessagePtr msgIn(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(pattern.size()));
+        ASSERT_EQ(string(static_cast<char*>(msgIn->GetData()), msgIn->GetSize()), pattern);
+    }
+    blocker.Wait();
+
+    ASSERT_TRUE(region->Resize(2 * pageSize));
+    ASSERT_EQ(region->GetSize(), 2 * pageSize);
+    resized.Wait();
+    ASSERT_EQ(resizedTo, 2 * pageSize);
+    viewerFactory->UnsubscribeFromRegionEvents();
+
+    // fixed size regions are not resizable
+    auto fixed = factory->CreateUnmanagedRegion(pageSize, [](void*, size_t, void*) {});
+    ASSERT_FALSE(fixed->Resize(2 * pageSize));
+}
+
+void RegionCrossHost()
+{
+    // two sessions stand in for the two hosts, a memfd for the shared memory device
+    size_t sessionA(tools::UuidHash());
+    size_t sessionB(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_cross_host_", sessionA));
+
+    ProgOptions configA;
+    configA.SetProperty<string>("session", to_string(sessionA));
+    ProgOptions configB;
+    configB.SetProperty<string>("session", to_string(sessionB));
+
+    auto factoryA = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &configA);
+    auto factoryB = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &configB);
+
+    Channel push("Push", "push", factoryA);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factoryB);
+    pull.Connect(address);
+
+    constexpr size_t regionSize = 4096;
+    constexpr size_t msgSize = 1000; // 1024 bytes with the block header
+    // the ring state is at the next 2 MiB boundary behind the region
+    int fd = shmem::CreateMemfd(tools::ToString("test_region_cross_host_", sessionA), 4 << 20, false);
+    ASSERT_NE(fd, -1);
+
+    RegionConfig cfgA;
+    cfgA.id = 1;
+    cfgA.fd = fd;
+    cfgA.crossHost = true;
+    cfgA.ringBuffer = true;
+    RegionConfig cfgB = cfgA;
+    cfgB.ringBuffer = false;
+    auto regionA = factoryA->CreateUnmanagedRegion(regionSize, RegionCallback(nullptr), cfgA);
+    auto regionB = factoryB->CreateUnmanagedRegion(regionSize, RegionCallback(nullptr), cfgB);
+    ASSERT_EQ(regionB->GetFreeSpace(), regionSize);
+    // filled by the other host
+    ASSERT_EQ(regionB->Allocate(msgSize), nullptr);
+
+    vector<MessagePtr> msgs;
+    for (size_t i = 0; i < 4; ++i) {
+        void* ptr = regionA->Allocate(msgSize);
+        ASSERT_NE(ptr, nullptr);
+        memset(ptr, static_cast<int>(i), msgSize);
+        MessagePtr msg(push.NewMessage(regionA, ptr, msgSize));
+        ASSERT_EQ(push.Send(msg), static_cast<int64_t>(msgSize));
+        MessagePtr msgIn(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msgIn), static_cast<int64_t>(msgSize));
+        // the receiving host finds the block in its own mapping of the memory
+        ASSERT_EQ(static_cast<char*>(msgIn->GetData()) - static_cast<char*>(regionB->GetData()), static_cast<char*>(ptr) - static_cast<char*>(regionA->GetData()));
+        ASSERT_EQ(static_cast<char*>(msgIn->GetData())[0], static_cast<char>(i));
+        msgs.push_back(std::move(msgIn));
+    }
+    ASSERT_EQ(regionA->GetFreeSpace(), 0u);
+
+    // releases on the receiving host advance the acknowledgement seen by the sender
+    msgs[1].reset();
+    ASSERT_EQ(regionA->GetAckedOffset(), 0u);
+    msgs[0].reset();
+    ASSERT_EQ(regionA->GetAckedOffset(), 2048u);
+    msgs.clear();
+    ASSERT_EQ(regionA->GetAckedOffset(), regionSize);
+    ASSERT_EQ(regionA->GetFreeSpace(), regionSize);
+
+    regionB.reset();
+    regionA.reset();
+    close(fd);
+}
+
+void RegionReleaseTogether()
+{
+    size_t session(tools::UuidHash());
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    // one after another the regions would linger for 20 * 500 ms
+    const size_t numRegions = 20;
+    RegionConfig cfg;
+    cfg.linger = 500;
+    atomic<int> acks(0);
+    vector<UnmanagedRegionPtr> regions;
+    for (size_t i = 0; i < numRegions; ++i) {
+        regions.push_back(factory->CreateUnmanagedRegion(100000, [&](void*, size_t, void*) { ++acks; }, cfg));
+    }
+    {
+        // the ack of a message released right before the regions is still delivered
+        MessagePtr msg(factory->CreateMessage(regions.back(), regions.back()->GetData(), 100, nullptr));
+    }
+
+    auto start = chrono::steady_clock::now();
+    ReleaseRegions(regions);
+    auto elapsed = chrono::steady_clock::now() - start;
+    ASSERT_TRUE(regions.empty());
+    ASSERT_LT(elapsed, chrono::seconds(3));
+    ASSERT_GE(elapsed, chrono::milliseconds(400));
+    ASSERT_EQ(acks, 1);
+}
+
+void RegionGpu(const string& transport)
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_gpu_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    RegionConfig deviceCfg;
+    deviceCfg.gpuDevice = 0;
+    deviceCfg.lock = true;
+    // device memory cannot be locked
+    ASSERT_THROW(factory->CreateUnmanagedRegion(1000, [](const std::vector<RegionBlock>&) {}, deviceCfg), TransportError);
+
+    RegionConfig cfg;
+    cfg.gpuRegister = true;
+    if (string(tools::GpuRuntime()).empty()) {
+        // not built with a GPU runtime
+        ASSERT_THROW(factory->CreateUnmanagedRegion(1000, [](const std::vector<RegionBlock>&) {}, cfg), TransportError);
+        return;
+    }
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    tools::Semaphore blocker;
+    auto region = factory->CreateUnmanagedRegion(1000, [&](const std::vector<RegionBlock>& blocks) {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            blocker.Signal();
+        }
+    }, cfg);
+    memset(region->GetData(), 'a', 100);
+
+    MessagePtr msg(push.NewMessage(region, region->GetData(), 100));
+    ASSERT_EQ(push.Send(msg), 100);
+    MessagePtr msgIn(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(msgIn), 100);
+    ASSERT_EQ(static_cast<char*>(msgIn->GetData())[99], 'a');
+    msgIn.reset();
+    blocker.Wait();
+}
+
+void RegionZeroCopyBulkAcks(const string& transport)
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_bulk_acks_", transport, "_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    constexpr size_t numMsgs = 100;
+    constexpr size_t msgSize = 10000;
+    mutex mtx;
+    vector<void*> acked;
+    atomic<size_t> numCallbacks(0);
+    auto region = factory->CreateUnmanagedRegion(numMsgs * msgSize, [&](const std::vector<RegionBlock>& blocks) {
+        lock_guard<mutex> lock(mtx);
+        for (const auto& block : blocks) {
+            ASSERT_EQ(block.size, msgSize);
+            acked.push_back(block.ptr);
+        }
+        ++numCallbacks;
+    });
+    char* data = static_cast<char*>(region->GetData());
+
+    for (size_t i = 0; i < numMsgs; ++i) {
+        memset(data + i * msgSize, static_cast<int>(i), msgSize);
+        MessagePtr msg(push.NewMessage(region, data + i * msgSize, msgSize));
+        ASSERT_EQ(push.Send(msg), msgSize);
+    }
+    for (size_t i = 0; i < numMsgs; ++i) {
+        MessagePtr msg(pull.NewMessage());
+        ASSERT_EQ(pull.Receive(msg), msgSize);
+        ASSERT_EQ(static_cast<char*>(msg->GetData())[msgSize - 1], static_cast<char>(i));
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (acked.size() == numMsgs) {
+                break;
+            }
+        }
+        this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    lock_guard<mutex> lock(mtx);
+    ASSERT_EQ(acked.size(), numMsgs);
+    ASSERT_LE(numCallbacks.load(), numMsgs);
+    sort(acked.begin(), acked.end());
+    for (size_t i = 0; i < numMsgs; ++i) {
+        ASSERT_EQ(acked.at(i), data + i * msgSize);
+    }
+}
+
+void RegionExtents(const string& transport)
+{
+    size_t session(tools::UuidHash());
+    std::string address(tools::ToString("ipc://test_region_extents_", transport, "_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    Channel push("Push", "push", factory);
+    push.Bind(address);
+    Channel pull("Pull", "pull", factory);
+    pull.Connect(address);
+
+    constexpr size_t pageSize = 4096;
+    constexpr size_t numPages = 64;
+    mutex mtx;
+    vector<RegionBlock> acked;
+    auto region = factory->CreateUnmanagedRegion(2 * numPages * pageSize, [&](const std::vector<RegionBlock>& blocks) {
+        lock_guard<mutex> lock(mtx);
+        acked.insert(acked.end(), blocks.begin(), blocks.end());
+    });
+    char* data = static_cast<char*>(region->GetData());
+
+    // every other page, in reverse order
+    vector<Span<char>> pages;
+    for (size_t i = numPages; i > 0; --i) {
+        char* page = data + (2 * i - 1) * pageSize;
+        memset(page, static_cast<int>(i), pageSize);
+        pages.emplace_back(page, pageSize);
+    }
+    ASSERT_THROW(NewRegionExtents(*factory, region, {}), MessageError);
+    ASSERT_THROW(NewRegionExtents(*factory, region, {Span<char>(data + numPages * pageSize, 2 * numPages * pageSize)}), MessageError);
+
+    int frame = 42;
+    {
+        Parts out(NewRegionExtents(*factory, region, pages, &frame));
+        ASSERT_EQ(out.Size(), 2);
+        ASSERT_EQ(out[1].GetData(), data + pageSize);
+        ASSERT_EQ(out[1].GetSize(), (2 * numPages - 1) * pageSize);
+        ASSERT_GE(push.Send(out), 0);
+    }
+    {
+        Parts in;
+        ASSERT_GE(pull.Receive(in), 0);
+        ASSERT_TRUE(IsRegionExtents(in));
+        RegionExtentsView view(in);
+        ASSERT_EQ(view.Size(), numPages);
+        ASSERT_EQ(view.TotalSize(), numPages * pageSize);
+        for (size_t i = 0; i < numPages; ++i) {
+            ASSERT_EQ(view[i].size(), pageSize);
+            ASSERT_EQ(view[i][0], static_cast<char>(numPages - i));
+            ASSERT_EQ(view[i][pageSize - 1], static_cast<char>(numPages - i));
+        }
+        MessagePtr slice(view.Slice(numPages - 1));
+        ASSERT_NE(slice, nullptr);
+        ASSERT_EQ(slice->GetSize(), pageSize);
+        ASSERT_EQ(static_cast<char*>(slice->GetData())[0], 1);
+
+        Parts single;
+        single.AddPart(pull.NewMessage(10));
+        ASSERT_FALSE(IsRegionExtents(single));
+        ASSERT_THROW(RegionExtentsView{single}, MessageError);
+    }
+
+    // one ack for the whole span
+    for (int i = 0; i < 1000; ++i) {
+        {
+            lock_guard<mutex> lock(mtx);
+            if (!acked.empty()) {
+                break;
+            }
+        }
+        this_thread::sleep_for(chrono::milliseconds(5));
+    }
+    this_thread::sleep_for(chrono::milliseconds(50));
+    lock_guard<mutex> lock(mtx);
+    ASSERT_EQ(acked.size(), 1);
+    ASSERT_EQ(acked.at(0).ptr, data + pageSize);
+    ASSERT_EQ(acked.at(0).size, (2 * numPages - 1) * pageSize);
+    ASSERT_EQ(acked.at(0).hint, &frame);
+}
+
 TEST(RegionsSizeMismatch, shmem)
 {
     RegionsSizeMismatch();
@@ -375,4 +1249,119 @@ TEST(EventSubscriptionsExternalRegion, shmem)
     RegionEventSubscriptions("shmem", true);
 }
 
+TEST(AckLatency, shmem)
+{
+    RegionAckLatency(false, false);
+}
+
+TEST(AckLatencyAdaptive, shmem)
+{
+    RegionAckLatency(true, false);
+}
+
+TEST(AckRing, shmem)
+{
+    RegionAckLatency(false, true);
+}
+
+TEST(AckRingAdaptive, shmem)
+{
+    RegionAckLatency(true, true);
+}
+
+TEST(AckCallbackThreads, shmem)
+{
+    RegionAckCallbackThreads();
+}
+
+TEST(AckReactor, shmem)
+{
+    RegionAckReactor();
+}
+
+TEST(Pool, zeromq)
+{
+    RegionPoolRecycling("zeromq");
+}
+
+TEST(Pool, shmem)
+{
+    RegionPoolRecycling("shmem");
+}
+
+TEST(RefCountSlab, shmem)
+{
+    RegionRefCountSlab(1024);
+}
+
+TEST(RefCountSlabExhausted, shmem)
+{
+    RegionRefCountSlab(2);
+}
+
+TEST(Extents, zeromq)
+{
+    RegionExtents("zeromq");
+}
+
+TEST(Extents, shmem)
+{
+    RegionExtents("shmem");
+}
+
+TEST(ZeroCopyBulkAcks, zeromq)
+{
+    RegionZeroCopyBulkAcks("zeromq");
+}
+
+TEST(ZeroCopyBulkAcks, shmem)
+{
+    RegionZeroCopyBulkAcks("shmem");
+}
+
+TEST(RingBuffer, shmem)
+{
+    RegionRingBuffer();
+}
+
+TEST(SlotPool, shmem)
+{
+    RegionSlotPool();
+}
+
+TEST(ExternalDescriptor, zeromq)
+{
+    RegionExternalDescriptor("zeromq");
+}
+
+TEST(ExternalDescriptor, shmem)
+{
+    RegionExternalDescriptor("shmem");
+}
+
+TEST(Resize, shmem)
+{
+    RegionResize();
+}
+
+TEST(CrossHost, shmem)
+{
+    RegionCrossHost();
+}
+
+TEST(ReleaseTogether, shmem)
+{
+    RegionReleaseTogether();
+}
+
+TEST(GpuRegister, zeromq)
+{
+    RegionGpu("zeromq");
+}
+
+TEST(GpuRegister, shmem)
+{
+    RegionGpu("shmem");
+}
+
 } // namespace
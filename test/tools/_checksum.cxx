@@ -0,0 +1,44 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/tools/Checksum.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq::tools;
+
+TEST(Checksum, Crc32c)
+{
+    EXPECT_EQ(Crc32c("123456789", 9), 0xe3069283);
+    EXPECT_EQ(Crc32c("", 0), 0U);
+
+    // sizes around the lanes of the accelerated version, in one piece and continued
+    vector<char> data(100000);
+    uint32_t random = 1;
+    for (auto& c : data) {
+        random = random * 1664525 + 1013904223;
+        c = static_cast<char>(random >> 24);
+    }
+    for (size_t size : {7, 4096, 12288, 12295, 50000, 100000}) {
+        const size_t half = size / 2;
+        EXPECT_EQ(Crc32c(data.data(), size), Crc32c(data.data() + half, size - half, Crc32c(data.data(), half))) << size;
+    }
+
+    EXPECT_EQ(Checksum(ChecksumType::crc32c, "123456789", 9), 0xe3069283);
+    EXPECT_EQ(ParseChecksumType("crc32c"), ChecksumType::crc32c);
+    EXPECT_THROW(ParseChecksumType("md5"), ChecksumError);
+}
+
+} // namespace
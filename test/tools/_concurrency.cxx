@@ -0,0 +1,181 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <fairmq/tools/Futex.h>
+#include <fairmq/tools/PerThreadCounter.h>
+#include <fairmq/tools/Queues.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq::tools;
+
+TEST(Tools, SpscQueue)
+{
+    SpscQueue<unique_ptr<int>> queue(3);
+    EXPECT_EQ(queue.Capacity(), 4);
+    EXPECT_TRUE(queue.Empty());
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.TryPush(make_unique<int>(i)));
+    }
+    auto rejected = make_unique<int>(4);
+    EXPECT_FALSE(queue.TryPush(move(rejected)));
+    ASSERT_NE(rejected, nullptr); // not moved from when full
+    EXPECT_EQ(queue.Size(), 4);
+
+    unique_ptr<int> value;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.TryPop(value));
+        EXPECT_EQ(*value, i);
+    }
+    EXPECT_FALSE(queue.TryPop(value));
+
+    // in order across threads and wrap-arounds
+    const uint64_t n = 200000;
+    SpscQueue<uint64_t> ints(64);
+    thread producer([&]() {
+        for (uint64_t i = 0; i < n; ++i) {
+            while (!ints.TryPush(i)) {
+                this_thread::yield(); // the test machine may have a single core
+            }
+        }
+    });
+    uint64_t expected = 0;
+    uint64_t v = 0;
+    while (expected < n) {
+        if (ints.TryPop(v)) {
+            ASSERT_EQ(v, expected);
+            ++expected;
+        } else {
+            this_thread::yield();
+        }
+    }
+    producer.join();
+}
+
+TEST(Tools, MpmcQueue)
+{
+    const int numProducers = 4;
+    const int numConsumers = 4;
+    const uint64_t perProducer = 50000;
+    MpmcQueue<uint64_t> queue(128);
+    atomic<uint64_t> sum(0);
+    atomic<uint64_t> count(0);
+
+    vector<thread> threads;
+    for (int p = 0; p < numProducers; ++p) {
+        threads.emplace_back([&]() {
+            for (uint64_t i = 1; i <= perProducer; ++i) {
+                while (!queue.TryPush(i)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < numConsumers; ++c) {
+        threads.emplace_back([&]() {
+            uint64_t v = 0;
+            while (count.load() < numProducers * perProducer) {
+                if (queue.TryPop(v)) {
+                    sum += v;
+                    ++count;
+                } else {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(sum.load(), numProducers * perProducer * (perProducer + 1) / 2);
+    EXPECT_TRUE(queue.Empty());
+}
+
+TEST(Tools, FutexSemaphore)
+{
+    FutexSemaphore sem(2);
+    EXPECT_TRUE(sem.TryWait());
+    EXPECT_TRUE(sem.TryWait());
+    EXPECT_FALSE(sem.TryWait());
+
+    auto start = chrono::steady_clock::now();
+    EXPECT_FALSE(sem.WaitFor(chrono::milliseconds(20)));
+    EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(20));
+
+    thread signaler([&]() {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        sem.Signal(3);
+    });
+    sem.Wait();
+    EXPECT_TRUE(sem.WaitFor(chrono::seconds(5)));
+    signaler.join();
+    EXPECT_EQ(sem.GetCount(), 1);
+}
+
+TEST(Tools, SpinParkWaiter)
+{
+    SpinParkWaiter waiter(10);
+    atomic<bool> flag(false);
+
+    EXPECT_FALSE(waiter.Wait([&]() { return flag.load(); }, chrono::milliseconds(20)));
+
+    thread notifier([&]() {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        flag = true;
+        waiter.Notify();
+    });
+    EXPECT_TRUE(waiter.Wait([&]() { return flag.load(); }));
+    notifier.join();
+
+    // notifications are not lost when they race with the parking
+    atomic<uint64_t> produced(0);
+    const uint64_t n = 20000;
+    thread producer([&]() {
+        for (uint64_t i = 1; i <= n; ++i) {
+            produced.store(i);
+            waiter.Notify();
+        }
+    });
+    for (uint64_t i = 1; i <= n; ++i) {
+        ASSERT_TRUE(waiter.Wait([&]() { return produced.load() >= i; }, chrono::seconds(5)));
+    }
+    producer.join();
+}
+
+TEST(Tools, PerThreadCounter)
+{
+    PerThreadCounter counter;
+    vector<thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 10000; ++i) {
+                counter.Add();
+            }
+            counter.Add(5);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(counter.Get(), 8 * 10005);
+    counter.Reset();
+    EXPECT_EQ(counter.Get(), 0);
+}
+
+} // namespace
@@ -0,0 +1,47 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <fairmq/tools/Copy.h>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq::tools;
+
+TEST(Tools, CopyEngine)
+{
+    EXPECT_THROW(SetCopyEngine("dma", 1000), CopyEngineError);
+    // without a DSA work queue, dsa falls back to streaming copies
+    const string dsa = SetCopyEngine("dsa", 1000);
+    EXPECT_TRUE(dsa == "dsa" || dsa == "streaming");
+
+    for (const string& engine : vector<string>{"memcpy", "streaming", dsa}) {
+        ASSERT_EQ(SetCopyEngine(engine, 1000), engine);
+        // below and above the threshold, with unaligned heads and tails
+        for (size_t size : {0, 999, 1000, 4097, 3 << 20}) {
+            for (size_t offset : {0, 1, 63}) {
+                vector<char> src(size + 64);
+                vector<char> dst(size + 128, 0);
+                for (size_t i = 0; i < src.size(); ++i) {
+                    src[i] = static_cast<char>(i * 7 + 3);
+                }
+                CopyPayload(dst.data() + offset, src.data() + 3, size);
+                ASSERT_EQ(string(dst.data() + offset, size), string(src.data() + 3, size)) << engine << ", size " << size;
+                ASSERT_EQ(dst[offset + size], 0);
+            }
+        }
+    }
+    SetCopyEngine("memcpy", 0);
+}
+
+} // namespace
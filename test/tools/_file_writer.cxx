@@ -0,0 +1,94 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/FileWriter.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio> // remove
+#include <cstring> // memset
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+string ReadFile(const string& filename)
+{
+    ifstream file(filename, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+void WriteFiles(bool direct)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    auto factory(TransportFactory::CreateTransportFactory("zeromq", tools::Uuid(), &config));
+
+    FileWriterConfig cfg;
+    // O_DIRECT is not supported by tmpfs, which /tmp can be
+    cfg.filename = tools::ToString(direct ? "/var/tmp" : "/tmp", "/fairmq_test_file_writer_", tools::Uuid());
+    cfg.direct = direct;
+    cfg.bufferSize = 10000;
+    cfg.maxQueuedBytes = 50000;
+    cfg.rotateSize = 300000;
+
+    string expected;
+    size_t numFiles = 0;
+    {
+        FileWriter writer(cfg);
+        for (int i = 0; i < 1000; ++i) {
+            size_t size = (i * 7919) % 3000;
+            char c = static_cast<char>('a' + i % 26);
+            expected.append(size, c);
+            MessagePtr msg(factory->CreateMessage(size));
+            memset(msg->GetData(), c, size);
+            if (i % 3 == 0) {
+                Parts parts;
+                parts.AddPart(std::move(msg));
+                parts.AddPart(factory->CreateMessage());
+                writer.Write(parts);
+                EXPECT_EQ(parts.Size(), 0);
+            } else {
+                writer.Write(std::move(msg));
+            }
+        }
+        writer.Close();
+        EXPECT_EQ(writer.GetBytesWritten(), expected.size());
+        EXPECT_EQ(writer.GetBytesQueued(), 0);
+        numFiles = writer.GetNumFiles();
+        EXPECT_EQ(numFiles, expected.size() / cfg.rotateSize + 1);
+
+        string written;
+        for (size_t i = 0; i < numFiles; ++i) {
+            written += ReadFile(writer.GetFilename(i));
+            remove(writer.GetFilename(i).c_str());
+        }
+        EXPECT_TRUE(written == expected) << "wrote " << written.size() << " bytes, expected " << expected.size();
+    }
+}
+
+TEST(FileWriter, Buffered)
+{
+    WriteFiles(false);
+}
+
+TEST(FileWriter, Direct)
+{
+    WriteFiles(true);
+}
+
+} // namespace
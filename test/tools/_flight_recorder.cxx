@@ -0,0 +1,139 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/Channel.h>
+#include <fairmq/FlightRecorder.h>
+#include <fairmq/ProgOptions.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Strings.h>
+#include <fairmq/tools/Unique.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio> // remove
+#include <cstring> // memcpy
+#include <memory>
+#include <string>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+TEST(FlightRecorder, Wraparound)
+{
+    FlightRecorderConfig cfg;
+    cfg.path = tools::ToString("/tmp/fairmq_test_flight_recorder_", tools::Uuid());
+    cfg.size = 1000;
+    cfg.numEntries = 16;
+    cfg.maxMessageSize = 300;
+
+    {
+        FlightRecorder recorder(cfg);
+        const uint32_t channel = recorder.RegisterChannel("data");
+        EXPECT_EQ(recorder.RegisterChannel("data"), channel);
+        // 100 messages of 1..200 bytes, only the last ones fit into the index and data rings
+        for (int i = 0; i < 100; ++i) {
+            string data(static_cast<size_t>(1 + i * 37 % 200), static_cast<char>('a' + i % 26));
+            recorder.Record(channel, i % 2 == 0, data.data(), data.size(), 0, true);
+        }
+        string large(500, 'x');
+        recorder.Record(channel, true, large.data(), large.size(), 0, true);
+        EXPECT_FALSE(recorder.Frozen());
+        recorder.Freeze("test");
+        EXPECT_TRUE(recorder.Frozen());
+        recorder.Record(channel, true, large.data(), large.size(), 0, true); // ignored
+    }
+
+    auto records = FlightRecorder::Read(cfg.path);
+    ASSERT_FALSE(records.empty());
+    EXPECT_LE(records.size(), cfg.numEntries);
+    size_t stored = 0;
+    for (const auto& record : records) {
+        stored += record.data.size();
+    }
+    EXPECT_LE(stored, cfg.size);
+
+    // the last record is the truncated large message
+    EXPECT_EQ(records.back().size, 500u);
+    EXPECT_EQ(records.back().data, vector<char>(300, 'x'));
+    EXPECT_EQ(records.back().channel, "data");
+    // the others are the most recent ones of the loop, in order
+    for (size_t j = 0; j + 1 < records.size(); ++j) {
+        int i = 100 - static_cast<int>(records.size() - 1 - j);
+        EXPECT_EQ(records[j].size, static_cast<uint64_t>(1 + i * 37 % 200));
+        EXPECT_EQ(records[j].send, i % 2 == 0);
+        EXPECT_EQ(records[j].data, vector<char>(records[j].size, static_cast<char>('a' + i % 26)));
+    }
+    EXPECT_EQ(FlightRecorder::ReadFreezeReason(cfg.path), "test");
+    remove(cfg.path.c_str());
+}
+
+void TapChannel(const string& transport, const string& address)
+{
+    ProgOptions config;
+    config.SetProperty<string>("session", tools::Uuid());
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    FlightRecorderConfig cfg;
+    cfg.path = tools::ToString("/tmp/fairmq_test_flight_recorder_", tools::Uuid());
+    cfg.size = 1 << 20;
+    auto recorder = make_shared<FlightRecorder>(cfg);
+
+    Channel push("data-out", "push", factory);
+    Channel pull("data-in", "pull", factory);
+    push.SetFlightRecorder(recorder);
+    pull.SetFlightRecorder(recorder);
+    ASSERT_TRUE(pull.Bind(address));
+    ASSERT_TRUE(push.Connect(address));
+
+    const string payload("payload");
+    for (int i = 0; i < 10; ++i) {
+        Parts parts;
+        parts.AddPart(push.NewSimpleMessage(i));
+        parts.AddPart(push.NewStaticMessage(payload));
+        ASSERT_GE(push.Send(parts), 0);
+        Parts received;
+        ASSERT_GE(pull.Receive(received), 0);
+    }
+    recorder->Freeze("done");
+
+    auto records = FlightRecorder::Read(cfg.path);
+    ASSERT_EQ(records.size(), 40u);
+    for (size_t j = 0; j < records.size(); ++j) {
+        const auto& record = records[j];
+        int i = static_cast<int>(j / 4);
+        EXPECT_EQ(record.channel, j % 4 < 2 ? "data-out" : "data-in");
+        EXPECT_EQ(record.send, j % 4 < 2);
+        EXPECT_EQ(record.part, static_cast<uint16_t>(j % 2));
+        EXPECT_EQ(record.last, j % 2 == 1);
+        if (j % 2 == 0) {
+            int value = -1;
+            ASSERT_EQ(record.data.size(), sizeof(value));
+            memcpy(&value, record.data.data(), sizeof(value));
+            EXPECT_EQ(value, i);
+        } else {
+            EXPECT_EQ(string(record.data.begin(), record.data.end()), payload);
+        }
+    }
+    remove(cfg.path.c_str());
+}
+
+TEST(FlightRecorder, TapChannelZeroMQ)
+{
+    TapChannel("zeromq", "ipc://test_flight_recorder_zeromq");
+}
+
+TEST(FlightRecorder, TapChannelShmem)
+{
+    TapChannel("shmem", "ipc://test_flight_recorder_shmem");
+}
+
+} // namespace
@@ -0,0 +1,79 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <fairmq/tools/Latency.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq::tools;
+
+TEST(Tools, LatencyHistogram)
+{
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.Percentile(50.), 0);
+
+    for (uint64_t v = 1; v <= 100000; ++v) {
+        histogram.Record(v * 1000);
+    }
+    EXPECT_EQ(histogram.Count(), 100000);
+    EXPECT_EQ(histogram.Max(), 100000000);
+    EXPECT_EQ(histogram.Min(), 1000);
+    // within the relative precision of the buckets (2^-7)
+    EXPECT_NEAR(histogram.Percentile(50.), 50000000., 50000000. / 128);
+    EXPECT_NEAR(histogram.Percentile(99.), 99000000., 99000000. / 128);
+    EXPECT_NEAR(histogram.Percentile(99.9), 99900000., 99900000. / 128);
+    EXPECT_EQ(histogram.Percentile(100.), 100000000);
+
+    // small values are exact
+    histogram.Reset();
+    EXPECT_EQ(histogram.Count(), 0);
+    for (uint64_t v : {3, 7, 7, 200}) {
+        histogram.Record(v);
+    }
+    EXPECT_EQ(histogram.Percentile(25.), 3);
+    EXPECT_EQ(histogram.Percentile(75.), 7);
+    EXPECT_EQ(histogram.Percentile(100.), 200);
+
+    histogram.Record(UINT64_MAX);
+    EXPECT_EQ(histogram.Percentile(100.), UINT64_MAX);
+}
+
+TEST(Tools, LatencyStamp)
+{
+    vector<char> payload(100);
+    LatencyStamp::Write(payload.data(), LatencyClock::monotonic, 42, 7);
+    LatencyStamp stamp;
+    ASSERT_TRUE(LatencyStamp::Read(payload.data(), payload.size(), stamp));
+    EXPECT_EQ(stamp.fSource, 42);
+    EXPECT_EQ(stamp.fSeq, 7);
+    EXPECT_LE(stamp.fSendTime, LatencyClockNow(LatencyClock::monotonic));
+    EXPECT_FALSE(LatencyStamp::Read(payload.data(), sizeof(LatencyStamp) - 1, stamp));
+    payload.assign(payload.size(), 0);
+    EXPECT_FALSE(LatencyStamp::Read(payload.data(), payload.size(), stamp));
+}
+
+TEST(Tools, SequenceTracker)
+{
+    SequenceTracker tracker;
+    for (uint64_t seq : {0, 1, 3, 2, 4, 7}) {
+        tracker.Record(1, seq);
+    }
+    tracker.Record(2, 100); // other source
+    tracker.Record(2, 101);
+    EXPECT_EQ(tracker.Lost(), 2); // 5, 6
+    EXPECT_EQ(tracker.Reordered(), 1); // 2
+    EXPECT_EQ(tracker.NumSources(), 2);
+}
+
+} /* namespace */
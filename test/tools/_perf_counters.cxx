@@ -0,0 +1,79 @@
+/********************************************************************************
+ * Copyright (C) 2024 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <fairmq/ChannelMetrics.h>
+#include <fairmq/tools/PerfCounters.h>
+
+#include <thread>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+using namespace fair::mq::tools;
+
+// some work the counters can see
+bool Work()
+{
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 100000; ++i) {
+        sum += i;
+    }
+    return sum > 0;
+}
+
+TEST(Tools, PerfCounters)
+{
+    PerfCounters* counters = PerfCounters::ForThisThread();
+    if (!counters) {
+        GTEST_SKIP() << "perf_event not available";
+    }
+    EXPECT_EQ(PerfCounters::ForThisThread(), counters);
+
+    PerfCounts before;
+    PerfCounts after;
+    ASSERT_TRUE(counters->Read(before));
+    Work();
+    ASSERT_TRUE(counters->Read(after));
+    const PerfCounts delta = after - before;
+    EXPECT_GT(delta.cycles, 0U);
+    EXPECT_GE(delta.instructions, 100000U);
+
+    // every thread has its own counters
+    PerfCounters* other = nullptr;
+    thread([&]() { other = PerfCounters::ForThisThread(); }).join();
+    EXPECT_NE(other, counters);
+}
+
+TEST(Tools, PerfCountersOfHandlers)
+{
+    if (!PerfCounters::ForThisThread()) {
+        GTEST_SKIP() << "perf_event not available";
+    }
+    ChannelMetricsRecorder recorder(true);
+    EXPECT_TRUE(recorder.TimeHandler(Work));
+    EXPECT_TRUE(recorder.TimeHandler(Work));
+
+    ChannelMetrics metrics;
+    recorder.Fill(metrics);
+    EXPECT_TRUE(metrics.perfRecorded);
+    EXPECT_EQ(metrics.handlerCalls, 2U);
+    EXPECT_GE(metrics.PerHandlerCall(metrics.handlerInstructions), 100000.);
+    EXPECT_GT(metrics.HandlerIPC(), 0.);
+
+    ChannelMetricsRecorder timeOnly;
+    timeOnly.TimeHandler(Work);
+    ChannelMetrics timed;
+    timeOnly.Fill(timed);
+    EXPECT_FALSE(timed.perfRecorded);
+    EXPECT_EQ(timed.handlerCycles, 0U);
+}
+
+} // namespace
@@ -0,0 +1,89 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <fairmq/tools/Log.h>
+#include <fairmq/tools/RateLimit.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq::tools;
+
+double MeasureRate(RateLimiter& limiter, int iterations)
+{
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        limiter.maybe_sleep();
+    }
+    return iterations / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+TEST(Tools, RateLimiterPrecise)
+{
+    RateLimiter limiter(100000, RateLimitMode::precise);
+    // loose bounds, the test machine may be loaded
+    double rate = MeasureRate(limiter, 20000);
+    EXPECT_LT(rate, 100000 * 1.01);
+    EXPECT_GT(rate, 100000 * 0.5);
+}
+
+TEST(Tools, RateLimiterTokenBucket)
+{
+    RateLimiter limiter(100, RateLimitMode::tokenBucket, 10);
+    // the first burst (10 calls) passes without waiting
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i) {
+        limiter.maybe_sleep();
+    }
+    EXPECT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(5));
+    // then the rate applies
+    limiter.maybe_sleep();
+    EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(10));
+
+    // idle time refills the bucket (up to the burst size)
+    this_thread::sleep_for(chrono::milliseconds(200));
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i) {
+        limiter.maybe_sleep();
+    }
+    EXPECT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(5));
+    limiter.maybe_sleep();
+    EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(10));
+}
+
+TEST(Tools, ParseRateLimitMode)
+{
+    EXPECT_EQ(ParseRateLimitMode("adaptive"), RateLimitMode::adaptive);
+    EXPECT_EQ(ParseRateLimitMode("precise"), RateLimitMode::precise);
+    EXPECT_EQ(ParseRateLimitMode("token-bucket"), RateLimitMode::tokenBucket);
+    EXPECT_THROW(ParseRateLimitMode("fast"), runtime_error);
+}
+
+TEST(Tools, LogRateLimiter)
+{
+    LogRateLimiter limiter(chrono::milliseconds(50));
+    uint64_t suppressed = 99;
+    EXPECT_TRUE(limiter.Allow(suppressed));
+    EXPECT_EQ(suppressed, 0);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_FALSE(limiter.Allow(suppressed));
+    }
+    this_thread::sleep_for(chrono::milliseconds(60));
+    EXPECT_TRUE(limiter.Allow(suppressed));
+    EXPECT_EQ(suppressed, 10);
+    EXPECT_EQ(SuppressedNote(0), "");
+    EXPECT_EQ(SuppressedNote(10), "[10 similar message(s) suppressed] ");
+}
+
+} // namespace
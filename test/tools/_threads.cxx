@@ -0,0 +1,76 @@
+/********************************************************************************
+ * Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH       *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <fairmq/tools/Threads.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq::tools;
+
+TEST(Tools, ParseThreadSettings)
+{
+    EXPECT_EQ(ParseCpuList("2:4-6"), vector<int>({2, 4, 5, 6}));
+    EXPECT_TRUE(ParseCpuList("").empty());
+    EXPECT_THROW(ParseCpuList("6-4"), ThreadSettingsError);
+    EXPECT_THROW(ParseCpuList("a"), ThreadSettingsError);
+
+    EXPECT_TRUE(ParseThreadSettings("", "", -1).Empty());
+#ifdef __linux__
+    ThreadSettings settings = ParseThreadSettings("0", "fifo", 10);
+    EXPECT_FALSE(settings.Empty());
+    EXPECT_EQ(settings.schedPolicy, SCHED_FIFO);
+    EXPECT_EQ(settings.priority, 10);
+    EXPECT_THROW(ParseThreadSettings("", "fifo", 1000), ThreadSettingsError);
+#endif
+    EXPECT_THROW(ParseThreadSettings("", "idle", -1), ThreadSettingsError);
+}
+
+#ifdef __linux__
+TEST(Tools, ApplyThreadSettings)
+{
+    // pin a thread to the first CPU it may run on
+    cpu_set_t allowed;
+    ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed), 0);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) {
+        ++cpu;
+    }
+
+    thread t([&]() {
+        ThreadSettings settings;
+        settings.cpus = {cpu};
+        ASSERT_TRUE(ApplyThreadSettings(settings));
+        cpu_set_t pinned;
+        ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(pinned), &pinned), 0);
+        EXPECT_EQ(CPU_COUNT(&pinned), 1);
+        EXPECT_TRUE(CPU_ISSET(cpu, &pinned));
+    });
+    t.join();
+}
+
+TEST(Tools, NumaNodeOf)
+{
+    // every page is on some node, node 0 on machines without NUMA (-1 if the kernel has no NUMA support)
+    vector<char> memory(4096);
+    EXPECT_GE(NumaNodeOf(memory.data()), -1);
+    EXPECT_EQ(NumaNodeOf(nullptr), -1);
+}
+#endif
+
+} // namespace
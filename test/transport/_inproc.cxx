@@ -0,0 +1,244 @@
+/********************************************************************************
+ *    Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/Channel.h>
+#include <fairmq/Poller.h>
+#include <fairmq/tools/Unique.h>
+#include <fairmq/TransportFactory.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring> // memset
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+string UniqueAddress() { return "inproc://" + tools::Uuid(); }
+
+void PushPull()
+{
+    auto factory = TransportFactory::CreateTransportFactory("inproc", tools::Uuid());
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = UniqueAddress();
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+    ASSERT_EQ(pull->GetNumberOfConnectedPeers(), 1);
+
+    constexpr int numMessages = 10000;
+    thread receiver([&]() {
+        auto msg(factory->CreateMessage());
+        for (int i = 0; i < numMessages; ++i) {
+            ASSERT_EQ(pull->Receive(msg), sizeof(int));
+            ASSERT_EQ(*static_cast<int*>(msg->GetData()), i);
+        }
+    });
+
+    for (int i = 0; i < numMessages; ++i) {
+        auto msg(factory->NewSimpleMessage(i));
+        void* data = msg->GetData();
+        ASSERT_EQ(push->Send(msg), sizeof(int));
+        // the sender gets an empty message back, the buffer is passed on
+        ASSERT_NE(msg->GetData(), data);
+        ASSERT_EQ(msg->GetSize(), 0);
+    }
+    receiver.join();
+
+    ASSERT_EQ(push->GetMessagesTx(), numMessages);
+    ASSERT_EQ(pull->GetMessagesRx(), numMessages);
+    ASSERT_EQ(pull->GetBytesRx(), numMessages * sizeof(int));
+}
+
+void ZeroCopy()
+{
+    auto factory = TransportFactory::CreateTransportFactory("inproc", tools::Uuid());
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = UniqueAddress();
+    // connecting before binding is fine
+    ASSERT_TRUE(push->Connect(address));
+    ASSERT_TRUE(pull->Bind(address));
+
+    auto msg(factory->CreateMessage(1000000));
+    memset(msg->GetData(), 7, 1000000);
+    void* data = msg->GetData();
+    ASSERT_EQ(push->Send(msg), 1000000);
+
+    auto rcvMsg(factory->CreateMessage());
+    ASSERT_EQ(pull->Receive(rcvMsg), 1000000);
+    ASSERT_EQ(rcvMsg->GetData(), data);
+    ASSERT_EQ(rcvMsg->GetTransport(), factory.get());
+}
+
+void Multipart()
+{
+    auto factory = TransportFactory::CreateTransportFactory("inproc", tools::Uuid());
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = UniqueAddress();
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    Parts parts;
+    parts.AddPart(factory->NewSimpleMessage(42));
+    parts.AddPart(factory->CreateMessage());
+    parts.AddPart(factory->CreateMessage(200000));
+    memset(parts.At(2)->GetData(), 7, 200000);
+    ASSERT_EQ(push->Send(parts), 200000 + sizeof(int));
+
+    Parts rcvParts;
+    ASSERT_EQ(pull->Receive(rcvParts), 200000 + sizeof(int));
+    ASSERT_EQ(rcvParts.Size(), 3);
+    ASSERT_EQ(*static_cast<int*>(rcvParts.At(0)->GetData()), 42);
+    ASSERT_EQ(rcvParts.At(1)->GetSize(), 0);
+    ASSERT_EQ(rcvParts.At(2)->GetSize(), 200000);
+    ASSERT_EQ(static_cast<char*>(rcvParts.At(2)->GetData())[199999], 7);
+
+    // a multipart message received with single part receives, part by part
+    parts.Clear();
+    parts.AddPart(factory->NewSimpleMessage(1));
+    parts.AddPart(factory->NewSimpleMessage(2));
+    ASSERT_EQ(push->Send(parts), 2 * sizeof(int));
+    for (int i = 1; i <= 2; ++i) {
+        auto msg(factory->CreateMessage());
+        ASSERT_EQ(pull->Receive(msg), sizeof(int));
+        ASSERT_EQ(*static_cast<int*>(msg->GetData()), i);
+    }
+}
+
+void Pair()
+{
+    auto factory = TransportFactory::CreateTransportFactory("inproc", tools::Uuid());
+
+    auto a = factory->CreateSocket("pair", "data");
+    auto b = factory->CreateSocket("pair", "data");
+    string address = UniqueAddress();
+    ASSERT_TRUE(a->Bind(address));
+    ASSERT_FALSE(b->Bind(address));
+    ASSERT_FALSE(b->Connect("tcp://127.0.0.1:5555"));
+    ASSERT_TRUE(b->Connect(address));
+
+    auto msg(factory->NewSimpleMessage(1));
+    ASSERT_EQ(b->Send(msg), sizeof(int));
+    ASSERT_EQ(a->Receive(msg), sizeof(int));
+    ASSERT_EQ(*static_cast<int*>(msg->GetData()), 1);
+    ASSERT_EQ(a->Send(msg), sizeof(int));
+    ASSERT_EQ(b->Receive(msg), sizeof(int));
+    ASSERT_EQ(*static_cast<int*>(msg->GetData()), 1);
+    ASSERT_EQ(a->GetNumberOfConnectedPeers(), 1);
+    ASSERT_EQ(b->GetNumberOfConnectedPeers(), 1);
+}
+
+void TimeoutAndInterrupt()
+{
+    auto factory = TransportFactory::CreateTransportFactory("inproc", tools::Uuid());
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    int hwm = 2;
+    push->SetOption("snd-hwm", &hwm, sizeof(hwm));
+    push->SetOption("rcv-hwm", &hwm, sizeof(hwm));
+    string address = UniqueAddress();
+    ASSERT_TRUE(push->Bind(address));
+    ASSERT_TRUE(pull->Connect(address));
+
+    auto msg(factory->CreateMessage(100));
+    ASSERT_EQ(pull->Receive(msg, 100), static_cast<int>(TransferCode::timeout));
+    ASSERT_EQ(pull->Receive(msg, 0), static_cast<int>(TransferCode::timeout));
+    ASSERT_EQ(push->Send(msg, 0), 100);
+    ASSERT_EQ(push->Send(msg, 0), 0);
+    ASSERT_EQ(push->Send(msg, 100), static_cast<int>(TransferCode::timeout));
+
+    thread interrupter([&]() {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        factory->Interrupt();
+    });
+    ASSERT_EQ(push->Send(msg), static_cast<int>(TransferCode::interrupted));
+    interrupter.join();
+    factory->Resume();
+
+    ASSERT_THROW(factory->CreateSocket("pub", "data"), SocketError);
+}
+
+void Poll()
+{
+    auto factory = TransportFactory::CreateTransportFactory("inproc", tools::Uuid());
+
+    vector<Channel> channels;
+    channels.emplace_back("data1", "pull", factory);
+    channels.emplace_back("data2", "pull", factory);
+    Channel push1("data1", "push", factory);
+    Channel push2("data2", "push", factory);
+    string address1 = UniqueAddress();
+    string address2 = UniqueAddress();
+    ASSERT_TRUE(channels.at(0).Bind(address1));
+    ASSERT_TRUE(channels.at(1).Bind(address2));
+    ASSERT_TRUE(push1.Connect(address1));
+    ASSERT_TRUE(push2.Connect(address2));
+
+    auto poller = factory->CreatePoller(channels);
+    poller->Poll(50);
+    ASSERT_FALSE(poller->CheckInput(0));
+    ASSERT_FALSE(poller->CheckInput(1));
+
+    thread sender([&]() {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        auto msg(push2.NewSimpleMessage(2));
+        ASSERT_EQ(push2.Send(msg), sizeof(int));
+    });
+    poller->Poll(5000);
+    sender.join();
+    ASSERT_FALSE(poller->CheckInput(0));
+    ASSERT_TRUE(poller->CheckInput(1));
+
+    auto msg(channels.at(1).NewMessage());
+    ASSERT_EQ(channels.at(1).Receive(msg), sizeof(int));
+}
+
+TEST(PushPull, inproc)
+{
+    PushPull();
+}
+
+TEST(ZeroCopy, inproc)
+{
+    ZeroCopy();
+}
+
+TEST(Multipart, inproc)
+{
+    Multipart();
+}
+
+TEST(Pair, inproc)
+{
+    Pair();
+}
+
+TEST(TimeoutAndInterrupt, inproc)
+{
+    TimeoutAndInterrupt();
+}
+
+TEST(Poll, inproc)
+{
+    Poll();
+}
+
+} // namespace
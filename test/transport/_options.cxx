@@ -13,12 +13,14 @@
 #include <fairmq/Parts.h>
 #include <fairmq/ProgOptions.h>
 #include <fairmq/TransportFactory.h>
+#include <fairmq/tools/Strings.h>
 #include <fairmq/tools/Unique.h>
 #include <gtest/gtest.h>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace
 {
@@ -105,6 +107,42 @@ void ZeroingAndMlockOnCreation(const string& transport)
     ASSERT_EQ(memcmp(test.data(), outMsg->GetData(), outMsg->GetSize()), 0);
 }
 
+void ContextGroups(const string& transport)
+{
+    size_t session{tools::UuidHash()};
+    string address(tools::ToString("ipc://test_context_groups_", transport, "_", session));
+
+    ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<vector<string>>("zmq-context-group", {"name=data,io-threads=2,cpus=0", "name=default,io-threads=1"});
+    auto factory = TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &config);
+
+    // sockets of different context groups can talk to each other
+    Channel push("Push", "push", factory);
+    push.UpdateContextGroup("data");
+    push.Init();
+    ASSERT_TRUE(push.Bind(address));
+    Channel pull("Pull", "pull", factory);
+    pull.Init();
+    ASSERT_TRUE(pull.Connect(address));
+
+    auto outMsg(push.NewMessage(1000));
+    ASSERT_EQ(push.Send(outMsg), 1000);
+    auto inMsg(pull.NewMessage());
+    ASSERT_EQ(pull.Receive(inMsg), 1000);
+
+    Channel unknown("Unknown", "push", factory);
+    unknown.UpdateContextGroup("monitoring");
+    ASSERT_THROW(unknown.Init(), TransportFactoryError);
+
+    ProgOptions invalidConfig;
+    invalidConfig.SetProperty<string>("session", to_string(session));
+    invalidConfig.SetProperty<vector<string>>("zmq-context-group", {"io-threads=2"});
+    ASSERT_ANY_THROW(TransportFactory::CreateTransportFactory(transport, tools::Uuid(), &invalidConfig));
+}
+
 TEST(Options, zeromq) // NOLINT
 {
     RunOptionsTest("zeromq");
@@ -125,4 +163,14 @@ TEST(ZeroingAndMlockOnCreation, shmem)
     ZeroingAndMlockOnCreation("shmem");
 }
 
+TEST(ContextGroups, zeromq) // NOLINT
+{
+    ContextGroups("zeromq");
+}
+
+TEST(ContextGroups, shmem) // NOLINT
+{
+    ContextGroups("shmem");
+}
+
 } // namespace
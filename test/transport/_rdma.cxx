@@ -0,0 +1,220 @@
+/********************************************************************************
+ *    Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/ProgOptions.h>
+#include <fairmq/tools/Unique.h>
+#include <fairmq/TransportFactory.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring> // memset
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+// the tests need an RDMA device (e.g. a soft-RoCE device: rdma link add rxe0 type rxe netdev lo)
+shared_ptr<TransportFactory> CreateFactory(ProgOptions& config)
+{
+    try {
+        return TransportFactory::CreateTransportFactory("rdma", tools::Uuid(), &config);
+    } catch (const TransportError&) {
+        return nullptr;
+    }
+}
+
+// bind to a free port in [20000, 30000)
+string BindToFreePort(Socket& socket)
+{
+    for (int port = 20000 + static_cast<int>(tools::UuidHash() % 9000); port < 30000; ++port) {
+        string address("tcp://127.0.0.1:" + to_string(port));
+        if (socket.Bind(address)) {
+            return address;
+        }
+    }
+    return "";
+}
+
+TEST(PushPull, rdma)
+{
+    ProgOptions config;
+    config.SetProperty<size_t>("rdma-threshold", 65536);
+    auto factory = CreateFactory(config);
+    if (!factory) {
+        GTEST_SKIP() << "no RDMA device available";
+    }
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(push->Connect(address));
+
+    // small parts go over the TCP connection, large ones are written with RDMA (rendezvous with the receiver)
+    const vector<size_t> sizes{0, 1, 1000, 65536, 10000000};
+    thread receiver([&]() {
+        for (size_t size : sizes) {
+            auto msg(factory->CreateMessage());
+            ASSERT_EQ(pull->Receive(msg), static_cast<int64_t>(size));
+            ASSERT_EQ(msg->GetSize(), size);
+            for (size_t i = 0; i < size; ++i) {
+                ASSERT_EQ(static_cast<unsigned char*>(msg->GetData())[i], size % 256);
+            }
+        }
+    });
+
+    for (size_t size : sizes) {
+        auto msg(factory->CreateMessage(size));
+        if (size > 0) {
+            memset(msg->GetData(), size % 256, size);
+        }
+        ASSERT_EQ(push->Send(msg), static_cast<int64_t>(size));
+    }
+    receiver.join();
+}
+
+TEST(RegionBulkAck, rdma)
+{
+    ProgOptions config;
+    config.SetProperty<size_t>("rdma-threshold", 1024);
+    auto factory = CreateFactory(config);
+    if (!factory) {
+        GTEST_SKIP() << "no RDMA device available";
+    }
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(push->Connect(address));
+
+    constexpr int numMessages = 10;
+    constexpr int numParts = 4;
+    constexpr size_t partSize = 100000;
+    atomic<int> numCallbacks(0);
+    atomic<int> numBlocks(0);
+    auto region = factory->CreateUnmanagedRegion(numMessages * numParts * partSize, [&](const vector<RegionBlock>& blocks) {
+        ++numCallbacks;
+        numBlocks += blocks.size();
+    });
+
+    thread receiver([&]() {
+        for (int i = 0; i < numMessages; ++i) {
+            Parts parts;
+            ASSERT_EQ(pull->Receive(parts), numParts * partSize);
+            ASSERT_EQ(parts.Size(), numParts);
+            ASSERT_EQ(static_cast<char*>(parts.At(numParts - 1)->GetData())[partSize - 1], static_cast<char>(i));
+        }
+    });
+
+    for (int i = 0; i < numMessages; ++i) {
+        Parts parts;
+        for (int j = 0; j < numParts; ++j) {
+            char* data = static_cast<char*>(region->GetData()) + (i * numParts + j) * partSize;
+            memset(data, i, partSize);
+            parts.AddPart(factory->CreateMessage(region, data, partSize));
+        }
+        ASSERT_EQ(push->Send(parts), numParts * partSize);
+    }
+    receiver.join();
+
+    // all parts of a message are acknowledged with one callback, once written
+    ASSERT_EQ(numCallbacks, numMessages);
+    ASSERT_EQ(numBlocks, numMessages * numParts);
+}
+
+TEST(PairConcurrentLarge, rdma)
+{
+    ProgOptions config;
+    config.SetProperty<size_t>("rdma-threshold", 1024);
+    auto factory = CreateFactory(config);
+    if (!factory) {
+        GTEST_SKIP() << "no RDMA device available";
+    }
+
+    auto a = factory->CreateSocket("pair", "data");
+    auto b = factory->CreateSocket("pair", "data");
+    string address = BindToFreePort(*a);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(b->Connect(address));
+
+    // both peers send large parts at the same time, each receives those of the other
+    constexpr int numMessages = 20;
+    constexpr size_t msgSize = 1000000;
+    auto run = [&](Socket& socket, char value) {
+        thread receiver([&]() {
+            for (int i = 0; i < numMessages; ++i) {
+                auto msg(factory->CreateMessage());
+                ASSERT_EQ(socket.Receive(msg, 5000), static_cast<int64_t>(msgSize));
+                ASSERT_EQ(static_cast<char*>(msg->GetData())[msgSize - 1], static_cast<char>(value ^ 1));
+            }
+        });
+        for (int i = 0; i < numMessages; ++i) {
+            auto msg(factory->CreateMessage(msgSize));
+            memset(msg->GetData(), value, msgSize);
+            ASSERT_EQ(socket.Send(msg, 5000), static_cast<int64_t>(msgSize));
+        }
+        receiver.join();
+    };
+    thread other([&]() { run(*b, 1); });
+    run(*a, 0);
+    other.join();
+}
+
+TEST(RendezvousTimeout, rdma)
+{
+    ProgOptions config;
+    config.SetProperty<size_t>("rdma-threshold", 1024);
+    auto factory = CreateFactory(config);
+    if (!factory) {
+        GTEST_SKIP() << "no RDMA device available";
+    }
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(push->Connect(address));
+    // complete the queue pair handshake, without a receive
+    auto connected = chrono::steady_clock::now() + chrono::seconds(5);
+    while ((push->GetNumberOfConnectedPeers() == 0 || pull->GetNumberOfConnectedPeers() == 0) && chrono::steady_clock::now() < connected) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    ASSERT_EQ(push->GetNumberOfConnectedPeers(), 1);
+
+    // the receiver never provides the buffer: the send gives up after its timeout
+    auto msg(factory->CreateMessage(100000));
+    auto start = chrono::steady_clock::now();
+    ASSERT_EQ(push->Send(msg, 300), static_cast<int64_t>(TransferCode::timeout));
+    ASSERT_LT(chrono::steady_clock::now() - start, chrono::seconds(2));
+
+    // the timed out send dropped the connection, it is reestablished
+    connected = chrono::steady_clock::now() + chrono::seconds(5);
+    while ((push->GetNumberOfConnectedPeers() == 0 || pull->GetNumberOfConnectedPeers() == 0) && chrono::steady_clock::now() < connected) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    // and after an interruption
+    thread interrupter([&]() {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        factory->Interrupt();
+    });
+    ASSERT_EQ(push->Send(msg), static_cast<int64_t>(TransferCode::interrupted));
+    interrupter.join();
+    factory->Resume();
+}
+
+} // namespace
@@ -7,13 +7,35 @@
  ********************************************************************************/
 
 #include <fairmq/ProgOptions.h>
+#include <fairmq/shmem/AllocTrace.h>
+#include <fairmq/shmem/CommandBoard.h>
+#include <fairmq/shmem/Common.h>
 #include <fairmq/shmem/Monitor.h>
+#include <fairmq/shmem/RobustMutex.h>
+#include <fairmq/shmem/TransportFactory.h>
 #include <fairmq/tools/Unique.h>
 #include <fairmq/TransportFactory.h>
 
 #include <gtest/gtest.h>
 
+#include <boost/interprocess/managed_shared_memory.hpp>
+
+#include <algorithm> // count_if
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal> // raise
+#include <cstddef> // max_align_t
+#include <cstdint>
+#include <cstdio> // remove
+#include <cstring> // memset
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // fork
 
 namespace
 {
@@ -36,9 +58,1805 @@ void GetFreeMemory()
     ASSERT_THROW(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 1), shmem::Monitor::MonitorError);
 }
 
-TEST(Monitor, GetFreeMemory)
+void AllocationCache()
 {
-    GetFreeMemory();
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<bool>("shm-allocation-cache", true);
+    config.SetProperty<size_t>("shm-allocation-cache-depth", 8);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    size_t const initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+
+    {
+        vector<MessagePtr> msgs;
+        for (int i = 0; i < 20; ++i) {
+            msgs.push_back(factory->CreateMessage(1000));
+        }
+    }
+    // buffers retained by the cache remain allocated in the segment
+    ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+
+    // filling the segment forces the cache to be returned to it
+    ASSERT_NO_THROW(factory->CreateMessage(initialFree - 1000));
+}
+
+void AllocationCacheConsumer()
+{
+    string sessionId(to_string(tools::UuidHash()));
+    ProgOptions producerConfig;
+    producerConfig.SetProperty<string>("session", sessionId);
+    producerConfig.SetProperty<bool>("shm-monitor", true);
+    producerConfig.SetProperty<size_t>("shm-segment-size", 1000000);
+    producerConfig.SetProperty<bool>("shm-bad-alloc-wait", true);
+    producerConfig.SetProperty<int>("bad-alloc-max-wait", 10000);
+    ProgOptions consumerConfig;
+    consumerConfig.SetProperty<string>("session", sessionId);
+    consumerConfig.SetProperty<bool>("shm-monitor", true);
+    consumerConfig.SetProperty<bool>("shm-allocation-cache", true);
+    consumerConfig.SetProperty<size_t>("shm-allocation-cache-max-bytes", 1000000);
+
+    auto producer = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &producerConfig);
+    auto consumer = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &consumerConfig);
+    size_t const initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+    string address("ipc://test_allocation_cache_consumer_" + sessionId);
+
+    auto push = producer->CreateSocket("push", "data");
+    auto pull = consumer->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    for (int i = 0; i < 3; ++i) {
+        MessagePtr msg(producer->CreateMessage(200000));
+        ASSERT_EQ(push->Send(msg), 200000);
+        MessagePtr rcvMsg(consumer->CreateMessage());
+        ASSERT_EQ(pull->Receive(rcvMsg), 200000);
+    }
+    // the buffers of the producer, freed by the consumer, are held by the cache of the consumer
+    ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 500000);
+
+    // the producer asks the (idle) consumer to return its cache instead of failing
+    auto start = chrono::steady_clock::now();
+    ASSERT_NO_THROW(producer->CreateMessage(initialFree - 100000));
+    ASSERT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(5000));
+}
+
+void SlabFitAllocation()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+    config.SetProperty<string>("shm-allocation", "slab_fit");
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    size_t const initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+
+    {
+        vector<MessagePtr> msgs;
+        for (size_t size : { 1, 100, 8192, 100000, 1000000 }) {
+            msgs.push_back(factory->CreateMessage(size));
+            msgs.push_back(factory->CreateMessage(size, Alignment{4096}));
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(msgs.back()->GetData()) % 4096, 0);
+        }
+        ASSERT_TRUE(msgs.back()->SetUsedSize(10));
+        ASSERT_EQ(msgs.back()->GetSize(), 10);
+        ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+    }
+    // freed blocks are kept in the size class free lists and are counted as free memory
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+}
+
+void RefCountTable()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+    config.SetProperty<bool>("shm-refcount-table", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    size_t const initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+
+    {
+        MessagePtr msg(factory->CreateMessage(200));
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(msg->GetData()) % alignof(max_align_t), 0);
+        MessagePtr copy(factory->CreateMessage());
+        copy->Copy(*msg);
+        ASSERT_EQ(copy->GetData(), msg->GetData());
+        msg.reset();
+        // the data stays valid for the copy
+        memset(copy->GetData(), 1, copy->GetSize());
+
+        MessagePtr aligned(factory->CreateMessage(1000, Alignment{4096}));
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(aligned->GetData()) % 4096, 0);
+        ASSERT_TRUE(aligned->SetUsedSize(10));
+    }
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+}
+
+void BadAllocWait()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<bool>("shm-bad-alloc-wait", true);
+    config.SetProperty<int>("bad-alloc-max-wait", 10000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    MessagePtr msg(factory->CreateMessage(600000));
+    thread releaser([&msg]() {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        msg.reset();
+    });
+    // joins the releaser also when a failed assertion returns early
+    struct Joiner
+    {
+        thread& fThread;
+        ~Joiner() { fThread.join(); }
+    } joiner{releaser};
+
+    auto start = chrono::steady_clock::now();
+    // blocks until the first message is released, instead of failing or waiting for the full interval
+    ASSERT_NO_THROW(factory->CreateMessage(600000));
+    ASSERT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(5000));
+}
+
+void SpillOver()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<string>("shm-spill-over", "free-memory");
+    config.SetProperty<int>("shm-spill-over-max-segments", 1);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    {
+        MessagePtr msg1(factory->CreateMessage(600000));
+        // the own segment is full, the second message is allocated from a newly created one
+        MessagePtr msg2(factory->CreateMessage(600000));
+        memset(msg2->GetData(), 1, msg2->GetSize());
+        ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 1), 1000000 - 600000);
+        // segment limit is reached
+        ASSERT_THROW(factory->CreateMessage(600000), MessageBadAlloc);
+    }
+    ASSERT_GT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 1), 900000);
+}
+
+void AllocPolicy()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<string>("shm-alloc-policy", "slab1:<=4k,segment:<=100k,segment2");
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    const shmem::SessionId session{sessionId};
+    const size_t free0 = shmem::Monitor::GetFreeMemory(session, 0);
+    const size_t free1 = shmem::Monitor::GetFreeMemory(session, 1);
+    const size_t free2 = shmem::Monitor::GetFreeMemory(session, 2);
+
+    {
+        MessagePtr small(factory->CreateMessage(4096));
+        memset(small->GetData(), 1, small->GetSize());
+        EXPECT_LT(shmem::Monitor::GetFreeMemory(session, 1), free1);
+        EXPECT_EQ(shmem::Monitor::GetFreeMemory(session, 0), free0);
+
+        MessagePtr medium(factory->CreateMessage(50000));
+        memset(medium->GetData(), 2, medium->GetSize());
+        EXPECT_LT(shmem::Monitor::GetFreeMemory(session, 0), free0 - 50000 + 1);
+
+        MessagePtr large(factory->CreateMessage(500000));
+        memset(large->GetData(), 3, large->GetSize());
+        EXPECT_LT(shmem::Monitor::GetFreeMemory(session, 2), free2 - 500000 + 1);
+
+        // a full store falls back to the own segment
+        MessagePtr large2(factory->CreateMessage(600000));
+        EXPECT_LT(shmem::Monitor::GetFreeMemory(session, 0), free0 - 650000 + 1);
+    }
+    EXPECT_EQ(shmem::Monitor::GetFreeMemory(session, 2), free2);
+
+    // bulk allocations are routed like single ones
+    {
+        Parts smalls(factory->CreateMessages(10, 1000));
+        for (auto& part : smalls) {
+            memset(part->GetData(), 4, part->GetSize());
+        }
+        EXPECT_LT(shmem::Monitor::GetFreeMemory(session, 1), free1 - 10000 + 1);
+        EXPECT_EQ(shmem::Monitor::GetFreeMemory(session, 0), free0);
+    }
+
+    EXPECT_THROW(shmem::ParseAllocPolicy("heap:<=4k", 0), invalid_argument);
+    EXPECT_THROW(shmem::ParseAllocPolicy("slab1:<=4x", 0), invalid_argument);
+    EXPECT_THROW(shmem::ParseAllocPolicy("slab1:<=4k,segment:<=1k", 0), invalid_argument);
+    EXPECT_THROW(shmem::ParseAllocPolicy("segment1,segment", 0), invalid_argument);
+    EXPECT_THROW(shmem::ParseAllocPolicy("slab0:<=4k", 0), invalid_argument);
+    auto routes(shmem::ParseAllocPolicy("slab3:<=4k,segment:<=16M", 0));
+    ASSERT_EQ(routes.size(), 2U);
+    EXPECT_EQ(routes.at(0).fMaxSize, 4096U);
+    EXPECT_EQ(routes.at(0).fSegmentId, 3);
+    EXPECT_TRUE(routes.at(0).fSlab);
+    EXPECT_EQ(routes.at(1).fMaxSize, 16U << 20);
+    EXPECT_EQ(routes.at(1).fSegmentId, 0);
+}
+
+void SegmentInitAsync()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-prefault-segment", true);
+    config.SetProperty<bool>("shm-segment-init-async", true);
+    config.SetProperty<int>("shm-segment-init-threads", 2);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    atomic<bool> initialized(false);
+    factory->SubscribeToRegionEvents([&](RegionInfo info) {
+        if (info.event == RegionEvent::initialized) {
+            ASSERT_EQ(info.size, static_cast<size_t>(100000000));
+            initialized = true;
+        }
+    });
+
+    // the segment is usable while it is being initialized
+    MessagePtr msg(factory->CreateMessage(1000));
+    memset(msg->GetData(), 1, msg->GetSize());
+
+    for (int i = 0; i < 1000 && !initialized; ++i) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(initialized);
+    factory->UnsubscribeFromRegionEvents();
+}
+
+void MetaRing()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<bool>("shm-meta-ring", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_meta_ring_" + sessionId);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    MessagePtr msg(factory->CreateMessage(100));
+    memset(msg->GetData(), 7, msg->GetSize());
+    ASSERT_EQ(push->Send(msg), 100);
+
+    MessagePtr rcvMsg(factory->CreateMessage());
+    ASSERT_EQ(pull->Receive(rcvMsg), 100);
+    ASSERT_EQ(static_cast<char*>(rcvMsg->GetData())[99], 7);
+
+    vector<MessagePtr> parts;
+    parts.push_back(factory->CreateMessage(10));
+    parts.push_back(factory->CreateMessage(20));
+    ASSERT_EQ(push->Send(parts), 30);
+    vector<MessagePtr> rcvParts;
+    ASSERT_EQ(pull->Receive(rcvParts), 30);
+    ASSERT_EQ(rcvParts.size(), 2U);
+    ASSERT_EQ(rcvParts.at(1)->GetSize(), 20U);
+
+    ASSERT_EQ(pull->Receive(rcvMsg, 0), static_cast<int>(TransferCode::timeout));
+}
+
+void MetaRingTcp()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<bool>("shm-meta-ring", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    // a wildcard bind and a peer connecting to one of the host addresses share the ring
+    auto pull = factory->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind("tcp://*:*"));
+    string port(pull->GetBoundAddress().substr(pull->GetBoundAddress().rfind(':') + 1));
+    auto push = factory->CreateSocket("push", "data");
+    ASSERT_TRUE(push->Connect("tcp://localhost:" + port));
+
+    MessagePtr msg(factory->CreateMessage(100));
+    ASSERT_EQ(push->Send(msg), 100);
+    MessagePtr rcvMsg(factory->CreateMessage());
+    ASSERT_EQ(pull->Receive(rcvMsg, 1000), 100);
+
+    // the last socket closing destroys the ring with the messages that were not received,
+    // the next sockets on the same address start with an empty one
+    MessagePtr unreceived(factory->CreateMessage(100));
+    ASSERT_EQ(push->Send(unreceived), 100);
+    push.reset();
+    pull.reset();
+
+    auto pull2 = factory->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull2->Bind("tcp://*:" + port));
+    auto push2 = factory->CreateSocket("push", "data");
+    ASSERT_TRUE(push2->Connect("tcp://127.0.0.1:" + port));
+    ASSERT_EQ(pull2->Receive(rcvMsg, 0), static_cast<int>(TransferCode::timeout));
+    msg = factory->CreateMessage(50);
+    ASSERT_EQ(push2->Send(msg), 50);
+    ASSERT_EQ(pull2->Receive(rcvMsg, 1000), 50);
+}
+
+void SpinReceive()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_spin_receive_" + sessionId);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    // hybrid: spins for the budget, then blocks for the rest of the timeout
+    pull->SetRcvMode("hybrid", 2000);
+    MessagePtr rcvMsg(factory->CreateMessage());
+    ASSERT_EQ(pull->Receive(rcvMsg, 50), static_cast<int>(TransferCode::timeout));
+    ASSERT_GE(pull->GetRcvSpinTime(), 2000U);
+    ASSERT_LT(pull->GetRcvSpinTime(), 50000U);
+
+    pull->SetRcvMode("spin", 0);
+    MessagePtr msg(factory->CreateMessage(100));
+    ASSERT_EQ(push->Send(msg), 100);
+    ASSERT_EQ(pull->Receive(rcvMsg, 1000), 100);
+
+    ASSERT_THROW(pull->SetRcvMode("poll", 0), SocketError);
+}
+
+void SendBatching()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_send_batching_" + sessionId);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    push->SetSndBatch(4, 1000);
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    // 2 full batches + 2 messages flushed by the timeout, received in order
+    for (size_t i = 1; i <= 10; ++i) {
+        MessagePtr msg(factory->CreateMessage(i));
+        ASSERT_EQ(push->Send(msg), static_cast<int64_t>(i));
+    }
+    for (size_t i = 1; i <= 10; ++i) {
+        MessagePtr msg(factory->CreateMessage());
+        ASSERT_EQ(pull->Receive(msg, 1000), static_cast<int64_t>(i));
+    }
+
+    // a multipart message flushes the pending batch first
+    MessagePtr single(factory->CreateMessage(5));
+    ASSERT_EQ(push->Send(single), 5);
+    vector<MessagePtr> parts;
+    parts.push_back(factory->CreateMessage(10));
+    parts.push_back(factory->CreateMessage(20));
+    ASSERT_EQ(push->Send(parts), 30);
+
+    vector<MessagePtr> rcvSingle;
+    ASSERT_EQ(pull->Receive(rcvSingle, 1000), 5);
+    ASSERT_EQ(rcvSingle.size(), 1U);
+    vector<MessagePtr> rcvParts;
+    ASSERT_EQ(pull->Receive(rcvParts, 1000), 30);
+    ASSERT_EQ(rcvParts.size(), 2U);
+}
+
+void AdaptiveSendBatching()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_adaptive_send_batching_" + sessionId);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    push->SetSndBatch(64, 1000);
+    push->SetSndBatchLatencyTarget(200);
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    // a burst is batched, slow messages are sent one by one, all within the target of the flusher
+    for (size_t i = 1; i <= 100; ++i) {
+        MessagePtr msg(factory->CreateMessage(i));
+        ASSERT_EQ(push->Send(msg), static_cast<int64_t>(i));
+        if (i > 90) {
+            this_thread::sleep_for(chrono::milliseconds(2));
+        }
+    }
+    for (size_t i = 1; i <= 100; ++i) {
+        MessagePtr msg(factory->CreateMessage());
+        ASSERT_EQ(pull->Receive(msg, 1000), static_cast<int64_t>(i));
+    }
+
+    // a slow message does not wait for the fixed timeout (1 s) of the batch
+    MessagePtr msg(factory->CreateMessage(8));
+    ASSERT_EQ(push->Send(msg), 8);
+    MessagePtr rcvMsg(factory->CreateMessage());
+    ASSERT_EQ(pull->Receive(rcvMsg, 100), 8);
+}
+
+void CompactMeta()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_compact_meta_" + sessionId);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    ASSERT_THROW(push->SetMetaFormat("varint"), SocketError);
+    push->SetMetaFormat("compact");
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    MessagePtr msg(factory->CreateMessage(1000));
+    memset(msg->GetData(), 'c', msg->GetSize());
+    ASSERT_EQ(push->Send(msg), 1000);
+    MessagePtr rcvMsg(factory->CreateMessage());
+    ASSERT_EQ(pull->Receive(rcvMsg, 1000), 1000);
+    ASSERT_EQ(static_cast<char*>(rcvMsg->GetData())[999], 'c');
+
+    vector<MessagePtr> parts;
+    parts.push_back(factory->CreateMessage(10));
+    parts.push_back(factory->CreateMessage(0));
+    parts.push_back(factory->CreateMessage(1 << 20));
+    ASSERT_EQ(push->Send(parts), 10 + (1 << 20));
+    vector<MessagePtr> rcvParts;
+    ASSERT_EQ(pull->Receive(rcvParts, 1000), 10 + (1 << 20));
+    ASSERT_EQ(rcvParts.size(), 3U);
+    ASSERT_EQ(rcvParts.at(1)->GetSize(), 0U);
+    ASSERT_EQ(rcvParts.at(2)->GetSize(), static_cast<size_t>(1 << 20));
+
+    // a single part is also accepted by a multipart receive
+    MessagePtr single(factory->CreateMessage(7));
+    ASSERT_EQ(push->Send(single), 7);
+    vector<MessagePtr> rcvSingle;
+    ASSERT_EQ(pull->Receive(rcvSingle, 1000), 7);
+    ASSERT_EQ(rcvSingle.size(), 1U);
+}
+
+void BulkRelease()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    size_t const initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+
+    MessagePtr copy(factory->CreateMessage());
+    {
+        Parts parts(factory->CreateMessages(200, 1000));
+        parts.AddPart(factory->CreateMessage(0));
+        parts.AddPart(MessagePtr());
+        copy->Copy(parts[10]);
+        ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 200 * 1000);
+    }
+    // all chunks are released except the one still referenced by the copy
+    size_t const afterRelease = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+    ASSERT_LT(afterRelease, initialFree);
+    ASSERT_GT(afterRelease, initialFree - 2 * 1000);
+    ASSERT_EQ(copy->GetSize(), 1000U);
+
+    vector<MessagePtr> msgs;
+    msgs.push_back(std::move(copy));
+    ReleaseMessages(msgs);
+    ASSERT_TRUE(msgs.empty());
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+}
+
+void AllocStats()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<unsigned int>("shm-alloc-stats", 1);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    {
+        vector<MessagePtr> msgs;
+        for (int i = 0; i < 10; ++i) {
+            msgs.push_back(factory->CreateMessage(1000));
+        }
+        ASSERT_THROW(factory->CreateMessage(2000000), MessageBadAlloc);
+    }
+
+    boost::interprocess::managed_shared_memory mng(boost::interprocess::open_only, string("fmq_" + shmem::makeShmIdStr(sessionId) + "_mng").c_str());
+    auto allocStats = mng.find<shmem::Uint16SegmentAllocStatsHashMap>(boost::interprocess::unique_instance).first;
+    ASSERT_NE(allocStats, nullptr);
+    shmem::SegmentAllocStats& stats = allocStats->at(0);
+    // every allocation is sampled with a sampling interval of 1
+    ASSERT_EQ(stats.fSampledAllocs.load(), 10U);
+    ASSERT_EQ(stats.fSizeBuckets[shmem::SegmentAllocStats::Bucket(1000)].load(), 10U);
+    ASSERT_EQ(stats.fSampledDeallocs.load(), 10U);
+    ASSERT_EQ(stats.fFailures.load(), 1U);
+    ASSERT_EQ(stats.fFragmentedFailures.load(), 0U);
+    ASSERT_GE(stats.fLastFailureSize.load(), 2000000U);
+    ASSERT_GT(stats.fLastFailureLargestFreeBlock.load(), 0U);
+    ASSERT_LE(stats.fLastFailureLargestFreeBlock.load(), stats.fLastFailureFreeMemory.load());
+}
+
+void AllocTrace()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    string trace(tools::ToString("/tmp/fmq_test_alloc_trace_", sessionId));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<string>("shm-alloc-trace", trace);
+
+    {
+        auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+        vector<MessagePtr> msgs;
+        for (int i = 0; i < 5; ++i) {
+            msgs.push_back(factory->CreateMessage(1000));
+        }
+        // bulk allocations are traced like single ones
+        Parts parts(factory->CreateMessages(5, 1000));
+        for (auto& part : parts) {
+            msgs.push_back(move(part));
+        }
+        ASSERT_THROW(factory->CreateMessage(2000000), MessageBadAlloc);
+    }
+
+    string file(tools::ToString(trace, ".", getpid()));
+    vector<shmem::AllocTraceRecord> records = shmem::ReadAllocTrace(file);
+    std::remove(file.c_str());
+    ASSERT_EQ(records.size(), 21U);
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(records.at(i).fOp, shmem::AllocTraceRecord::alloc);
+        ASSERT_GE(records.at(i).fSize, 1000U);
+    }
+    ASSERT_EQ(records.at(10).fOp, shmem::AllocTraceRecord::failure);
+    ASSERT_GE(records.at(10).fSize, 2000000U);
+    // every deallocation pairs with an allocation of the process and carries its lifetime
+    for (size_t i = 11; i < records.size(); ++i) {
+        ASSERT_EQ(records.at(i).fOp, shmem::AllocTraceRecord::dealloc);
+        ASSERT_EQ(count_if(records.begin(), records.begin() + 10, [&](const auto& r) { return r.fKey == records.at(i).fKey; }), 1);
+        ASSERT_GT(records.at(i).fLifetimeNs, 0U);
+        ASSERT_GE(records.at(i).fTimeNs, records.at(i).fLifetimeNs);
+    }
+}
+
+void OwnerTags()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<string>("id", "tagger");
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<unsigned int>("shm-owner-sampling", 1);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", "tagger", &config);
+    string address("ipc://test_owner_tags_" + sessionId);
+
+    {
+        auto push = factory->CreateSocket("push", "data");
+        auto pull = factory->CreateSocket("pull", "data");
+        ASSERT_TRUE(pull->Bind(address));
+        ASSERT_TRUE(push->Connect(address));
+
+        vector<MessagePtr> held;
+        for (int i = 0; i < 4; ++i) {
+            held.push_back(factory->CreateMessage(1000));
+        }
+        // two of the messages are sent and held by the receiver
+        for (int i = 0; i < 2; ++i) {
+            ASSERT_EQ(push->Send(held.back()), 1000);
+            held.pop_back();
+            held.push_back(factory->CreateMessage());
+            ASSERT_EQ(pull->Receive(held.back(), 1000), 1000);
+        }
+
+        shmem::SessionOwnerUsage usage = shmem::Monitor::GetOwnerUsage(shmem::SessionId{sessionId});
+        ASSERT_EQ(usage.droppedTags, 0U);
+        ASSERT_EQ(usage.devices.size(), 1U);
+        ASSERT_EQ(usage.devices.at(0).name, "tagger");
+        ASSERT_EQ(usage.devices.at(0).taggedChunks, 4U);
+        ASSERT_EQ(usage.devices.at(0).estimatedBytes, 4000U);
+        ASSERT_EQ(usage.channels.size(), 2U);
+        for (const auto& channel : usage.channels) {
+            ASSERT_EQ(channel.taggedChunks, 2U);
+            ASSERT_TRUE(channel.name == "tagger.data.push" || channel.name == "unknown") << channel.name;
+        }
+    }
+
+    // untagged on deallocation
+    shmem::SessionOwnerUsage usage = shmem::Monitor::GetOwnerUsage(shmem::SessionId{sessionId});
+    ASSERT_TRUE(usage.devices.empty());
+    ASSERT_TRUE(usage.channels.empty());
+}
+
+void Quotas(bool refCountTable)
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<string>("id", "producer");
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+    config.SetProperty<bool>("shm-refcount-table", refCountTable);
+    config.SetProperty<size_t>("shm-quota-soft", 300000);
+    config.SetProperty<size_t>("shm-quota-hard", 500000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", "producer", &config);
+
+    auto quota = [&]() {
+        vector<shmem::QuotaUsage> quotas = shmem::Monitor::GetQuotas(shmem::SessionId{sessionId});
+        EXPECT_EQ(quotas.size(), 1U);
+        return quotas.at(0);
+    };
+
+    {
+        MessagePtr msg1(factory->CreateMessage(200000));
+        ASSERT_GE(quota().used, 200000U);
+        ASSERT_EQ(quota().softExceeded, 0U);
+        MessagePtr msg2(factory->CreateMessage(200000));
+        ASSERT_EQ(quota().softExceeded, 1U);
+        // the segment has room, but the hard quota does not
+        ASSERT_THROW(factory->CreateMessage(200000), MessageBadAlloc);
+        ASSERT_GE(quota().hardRejected, 1U);
+        msg1.reset();
+        MessagePtr msg3(factory->CreateMessage(200000));
+        // the usage fell below the soft quota in between, crossing it again is counted again
+        ASSERT_EQ(quota().softExceeded, 2U);
+    }
+
+    shmem::QuotaUsage q = quota();
+    ASSERT_EQ(q.name, "producer");
+    ASSERT_EQ(q.soft, 300000U);
+    ASSERT_EQ(q.hard, 500000U);
+    ASSERT_EQ(q.used, 0U);
+    ASSERT_GE(q.peak, 400000U);
+    ASSERT_LE(q.peak, 500000U);
+}
+
+void UsageStats()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+    config.SetProperty<int>("shm-stats-interval", 10);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", "stats", &config);
+
+    // the counters are published asynchronously, waits until the published ones match
+    auto waitFor = [&](auto&& predicate) {
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+        while (chrono::steady_clock::now() < deadline) {
+            vector<shmem::UsageStats> stats = shmem::Monitor::GetUsageStats(shmem::SessionId{sessionId});
+            if (predicate(stats)) {
+                return true;
+            }
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        return false;
+    };
+
+    for (int i = 0; i < 5; ++i) {
+        MessagePtr msg(factory->CreateMessage(1000));
+    }
+    ASSERT_TRUE(waitFor([](const vector<shmem::UsageStats>& stats) {
+        return stats.size() == 1 && stats.at(0).managed && stats.at(0).id == 0 && stats.at(0).size == 10000000
+            && stats.at(0).freeBytes > 0 && stats.at(0).freeBytes < 10000000
+            && stats.at(0).allocations >= 5 && stats.at(0).deallocations >= 5 && stats.at(0).ageMs < 5000;
+    }));
+
+    // chunks of bulk allocations and of arenas are counted like single ones
+    {
+        Parts parts(factory->CreateMessages(5, 1000));
+        BufferArenaPtr arena = factory->CreateBufferArena(100000);
+        for (int i = 0; i < 5; ++i) {
+            MessagePtr msg(arena->NewMessage(1000));
+        }
+    }
+    ASSERT_TRUE(waitFor([](const vector<shmem::UsageStats>& stats) {
+        return stats.size() == 1 && stats.at(0).allocations >= 16 && stats.at(0).allocations == stats.at(0).deallocations;
+    }));
+
+    mutex mtx;
+    condition_variable cv;
+    size_t numAcked = 0;
+    auto region = factory->CreateUnmanagedRegion(100000, [&](void* /* data */, size_t /* size */, void* /* hint */) {
+        lock_guard<mutex> lock(mtx);
+        ++numAcked;
+        cv.notify_one();
+    });
+    for (int i = 0; i < 10; ++i) {
+        MessagePtr msg(factory->CreateMessage(region, static_cast<char*>(region->GetData()) + i * 1000, 1000));
+    }
+    {
+        unique_lock<mutex> lock(mtx);
+        ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(5), [&] { return numAcked == 10; }));
+    }
+    const uint16_t regionId = region->GetId();
+    ASSERT_TRUE(waitFor([&](const vector<shmem::UsageStats>& stats) {
+        return stats.size() == 2 && !stats.at(1).managed && stats.at(1).id == regionId && stats.at(1).size == 100000
+            && stats.at(1).acksSent == 10 && stats.at(1).acksReceived == 10 && stats.at(1).ackBacklog == 0;
+    }));
+
+    // the entry of a destroyed region is freed by its creator
+    region.reset();
+    ASSERT_TRUE(waitFor([](const vector<shmem::UsageStats>& stats) { return stats.size() == 1 && stats.at(0).managed; }));
+}
+
+void BufferArenas(bool refCountTable)
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+    config.SetProperty<bool>("shm-refcount-table", refCountTable);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_buffer_arenas_" + sessionId);
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    const size_t initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+    MessagePtr received(factory->CreateMessage());
+    {
+        BufferArenaPtr arena = factory->CreateBufferArena(1000000);
+        ASSERT_NE(arena, nullptr);
+        ASSERT_EQ(arena->GetSize(), 1000000U);
+        ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 1000000);
+
+        vector<MessagePtr> msgs;
+        for (int i = 0; i < 100; ++i) {
+            msgs.push_back(arena->NewMessage(1000, Alignment{64}));
+            ASSERT_EQ(msgs.back()->GetSize(), 1000U);
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(msgs.back()->GetData()) % 64, 0U);
+            memset(msgs.back()->GetData(), i, 1000);
+        }
+        ASSERT_EQ(arena->GetNumFallbacks(), 0U);
+        ASSERT_GE(arena->GetUsedSize(), 100000U);
+        // the messages do not overlap
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_EQ(static_cast<char*>(msgs.at(i)->GetData())[999], static_cast<char>(i));
+        }
+
+        // too large for the rest of the arena
+        MessagePtr large(arena->NewMessage(2000000));
+        ASSERT_EQ(large->GetSize(), 2000000U);
+        ASSERT_EQ(arena->GetNumFallbacks(), 1U);
+
+        MessagePtr copy(factory->CreateMessage());
+        copy->Copy(*msgs.at(1));
+        ASSERT_TRUE(msgs.at(2)->SetUsedSize(10));
+        ASSERT_EQ(msgs.at(2)->GetSize(), 10U);
+
+        ASSERT_EQ(push->Send(msgs.at(3)), 1000);
+        ASSERT_EQ(pull->Receive(received), 1000);
+        ASSERT_EQ(static_cast<char*>(received->GetData())[0], 3);
+    }
+
+    // the received message keeps the arena chunk alive
+    ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 1000000);
+    received.reset();
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+}
+
+void Slices(const string& metaFormat)
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_slices_" + metaFormat + "_" + sessionId);
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    push->SetMetaFormat(metaFormat);
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    const size_t initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+    {
+        MessagePtr msg(factory->CreateMessage(3000));
+        for (int i = 0; i < 3; ++i) {
+            memset(static_cast<char*>(msg->GetData()) + i * 1000, 'a' + i, 1000);
+        }
+        ASSERT_THROW(msg->Slice(2500, 1000), MessageError);
+
+        vector<MessagePtr> parts;
+        for (size_t i = 0; i < 3; ++i) {
+            parts.push_back(msg->Slice(i * 1000, 1000));
+            ASSERT_EQ(parts.at(i)->GetSize(), 1000U);
+            ASSERT_EQ(parts.at(i)->GetData(), static_cast<char*>(msg->GetData()) + i * 1000);
+        }
+        // slice of a slice
+        MessagePtr nested(parts.at(1)->Slice(500, 10));
+        ASSERT_EQ(nested->GetData(), static_cast<char*>(msg->GetData()) + 1500);
+        ASSERT_FALSE(nested->Grow(20));
+        ASSERT_TRUE(nested->SetUsedSize(5));
+        ASSERT_EQ(nested->GetSize(), 5U);
+        msg.reset();
+
+        ASSERT_EQ(push->Send(parts), 3000);
+        vector<MessagePtr> received;
+        ASSERT_EQ(pull->Receive(received), 3000);
+        ASSERT_EQ(received.size(), 3U);
+        for (size_t i = 0; i < 3; ++i) {
+            ASSERT_EQ(received.at(i)->GetSize(), 1000U);
+            ASSERT_EQ(static_cast<char*>(received.at(i)->GetData())[0], static_cast<char>('a' + i));
+            ASSERT_EQ(static_cast<char*>(received.at(i)->GetData())[999], static_cast<char>('a' + i));
+        }
+        ASSERT_EQ(static_cast<char*>(nested->GetData())[0], 'b');
+    }
+    // the chunk is released with its last slice
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+
+    mutex mtx;
+    condition_variable cv;
+    size_t ackedSize = 0;
+    auto region = factory->CreateUnmanagedRegion(100000, [&](void* /* data */, size_t size, void* /* hint */) {
+        lock_guard<mutex> lock(mtx);
+        ackedSize = size;
+        cv.notify_one();
+    });
+    {
+        MessagePtr msg(factory->CreateMessage(region, static_cast<char*>(region->GetData()) + 1000, 2000));
+        memset(msg->GetData(), 'r', 2000);
+        MessagePtr slice(msg->Slice(100, 50));
+        ASSERT_EQ(slice->GetData(), static_cast<char*>(msg->GetData()) + 100);
+        msg.reset();
+        ASSERT_EQ(push->Send(slice), 50);
+        MessagePtr received(factory->CreateMessage());
+        ASSERT_EQ(pull->Receive(received), 50);
+        ASSERT_EQ(received->GetData(), static_cast<char*>(region->GetData()) + 1100);
+        ASSERT_EQ(static_cast<char*>(received->GetData())[49], 'r');
+    }
+    // the region block is acknowledged once, with its full size
+    unique_lock<mutex> lock(mtx);
+    ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(5), [&] { return ackedSize != 0; }));
+    ASSERT_EQ(ackedSize, 2000U);
+}
+
+void DeferredFree()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<bool>("shm-deferred-free", true);
+    config.SetProperty<size_t>("shm-deferred-free-max-bytes", 700000);
+    config.SetProperty<int>("shm-deferred-free-interval", 10000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    const size_t initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+
+    // queued for the deallocation thread (woken early only above half of the bound)
+    MessagePtr msg(factory->CreateMessage(300000));
+    msg.reset();
+    ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 250000);
+    // an allocation that does not fit completes the queued deallocations first
+    msg = factory->CreateMessage(800000);
+    // beyond the bound, buffers are deallocated synchronously
+    msg.reset();
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+
+    MessagePtr msg1(factory->CreateMessage(300000));
+    MessagePtr msg2(factory->CreateMessage(450000));
+    msg1.reset();
+    msg2.reset();
+    ASSERT_GT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 400000);
+    ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 250000);
+
+    // the queue is drained when the transport is destroyed
+    factory.reset();
+}
+
+void MemoryWatermarks()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+
+    ASSERT_THROW(factory->SubscribeToMemoryWatermarks({0.9, 0.5}, [](const MemoryWatermarkEvent&) {}), TransportError);
+
+    mutex mtx;
+    condition_variable cv;
+    vector<MemoryWatermarkEvent> events;
+    ASSERT_TRUE(factory->SubscribeToMemoryWatermarks({0.5, 0.9}, [&](const MemoryWatermarkEvent& e) {
+        lock_guard<mutex> lock(mtx);
+        events.push_back(e);
+        cv.notify_one();
+    }, 1));
+
+    auto waitForEvents = [&](size_t n) {
+        unique_lock<mutex> lock(mtx);
+        return cv.wait_for(lock, chrono::seconds(5), [&] { return events.size() >= n; });
+    };
+
+    {
+        MessagePtr msg(factory->CreateMessage(600000));
+        ASSERT_TRUE(waitForEvents(1));
+    }
+    ASSERT_TRUE(waitForEvents(2));
+    factory->UnsubscribeFromMemoryWatermarks();
+
+    ASSERT_EQ(events.size(), 2U);
+    ASSERT_EQ(events.at(0).level, 1U);
+    ASSERT_TRUE(events.at(0).rising);
+    ASSERT_GE(events.at(0).used, 600000U);
+    ASSERT_EQ(events.at(0).size, 1000000U);
+    ASSERT_EQ(events.at(1).level, 0U);
+    ASSERT_FALSE(events.at(1).rising);
+}
+
+void ObjectStore()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+
+    auto publisher = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    auto reader = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    const size_t freeInitially = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+
+    ASSERT_EQ(reader->GetObject("calib"), nullptr);
+    ASSERT_EQ(reader->GetObjectVersion("calib"), 0U);
+
+    uint64_t v1 = 0;
+    {
+        MessagePtr msg(publisher->CreateMessage(1000000));
+        memset(msg->GetData(), 1, msg->GetSize());
+        v1 = publisher->PublishObject("calib", *msg);
+        ASSERT_GT(v1, 0U);
+    }
+    // the object outlives the message of the publisher
+    uint64_t version = 0;
+    MessagePtr view1(reader->GetObject("calib", &version));
+    ASSERT_NE(view1, nullptr);
+    ASSERT_EQ(version, v1);
+    ASSERT_EQ(view1->GetSize(), 1000000U);
+    ASSERT_EQ(static_cast<char*>(view1->GetData())[999999], 1);
+    // both views map the same memory
+    MessagePtr view2(publisher->GetObject("calib"));
+    ASSERT_EQ(view1->GetData(), view2->GetData());
+
+    uint64_t v2 = 0;
+    {
+        MessagePtr msg(publisher->CreateMessage(1000000));
+        memset(msg->GetData(), 2, msg->GetSize());
+        v2 = publisher->PublishObject("calib", *msg);
+    }
+    ASSERT_GT(v2, v1);
+    ASSERT_EQ(reader->GetObjectVersion("calib"), v2);
+    MessagePtr view3(reader->GetObject("calib", &version));
+    ASSERT_EQ(version, v2);
+    ASSERT_EQ(static_cast<char*>(view3->GetData())[0], 2);
+    // the old version stays valid until its readers release it
+    ASSERT_EQ(static_cast<char*>(view1->GetData())[0], 1);
+    const size_t freeWithTwoVersions = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+    view1.reset();
+    view2.reset();
+    ASSERT_GE(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), freeWithTwoVersions + 1000000);
+
+    ASSERT_TRUE(publisher->RemoveObject("calib"));
+    ASSERT_FALSE(publisher->RemoveObject("calib"));
+    ASSERT_EQ(reader->GetObject("calib"), nullptr);
+    ASSERT_EQ(static_cast<char*>(view3->GetData())[0], 2);
+    view3.reset();
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), freeInitially);
+}
+
+void CleanupBatch()
+{
+    vector<shmem::ShmId> shmIds;
+    for (int i = 0; i < 3; ++i) {
+        ProgOptions config;
+        string sessionId(to_string(tools::UuidHash()));
+        config.SetProperty<string>("session", sessionId);
+        config.SetProperty<bool>("shm-monitor", false);
+        config.SetProperty<bool>("shm-no-cleanup", true);
+        config.SetProperty<size_t>("shm-segment-size", 1000000);
+        {
+            auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+        }
+        // left behind like after a crash
+        ASSERT_TRUE(shmem::Monitor::SegmentIsPresent(shmem::SessionId{sessionId}, 0));
+        shmIds.push_back(shmem::ShmId{shmem::makeShmIdStr(sessionId)});
+    }
+
+    auto result = shmem::Monitor::CleanupBatch(shmIds, "/dev/shm/", 2, false);
+    ASSERT_GE(result.size(), 2U * shmIds.size()); // at least the managed and the management segment
+    for (const auto& r : result) {
+        ASSERT_TRUE(r.second) << r.first;
+    }
+    for (const auto& shmId : shmIds) {
+        ASSERT_FALSE(shmem::Monitor::SegmentIsPresent(shmId, 0));
+    }
+}
+
+void PidLiveness()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<string>("shm-liveness", "pid");
+
+    auto countPids = [&]() {
+        boost::interprocess::managed_shared_memory mng(boost::interprocess::open_only, string("fmq_" + shmem::makeShmIdStr(sessionId) + "_mng").c_str());
+        auto table = mng.find<shmem::LivenessTable>(boost::interprocess::unique_instance).first;
+        EXPECT_NE(table, nullptr);
+        size_t count = 0;
+        for (const auto& pid : table->fPids) {
+            count += (pid.load() == getpid()) ? 1 : 0;
+        }
+        return count;
+    };
+
+    auto factory1 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    {
+        auto factory2 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+        ASSERT_EQ(countPids(), 2U);
+    }
+    ASSERT_EQ(countPids(), 1U);
+
+    config.SetProperty<string>("shm-liveness", "bogus");
+    ASSERT_THROW(TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config), TransportError);
+}
+
+void Reclaim()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<string>("shm-liveness", "pid");
+    config.SetProperty<bool>("shm-reclaim", true);
+
+    auto factory1 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    auto msg = factory1->CreateMessage(1000);
+    size_t const initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+
+    // a process dies holding messages, copies and slices of them
+    pid_t child = fork();
+    ASSERT_NE(child, -1);
+    if (child == 0) {
+        auto factory2 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+        vector<MessagePtr> msgs;
+        for (int i = 0; i < 10; ++i) {
+            msgs.push_back(factory2->CreateMessage(10000));
+        }
+        msgs.push_back(factory2->CreateMessage());
+        msgs.back()->Copy(*msgs.front());
+        msgs.push_back(msgs.front()->Slice(0, 100));
+        raise(SIGKILL);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFSIGNALED(status));
+    ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree - 100000);
+
+    // the next process starting releases them, the messages of live processes are not affected
+    {
+        auto factory3 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+        ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+    }
+    msg.reset();
+    factory1.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+void Premap()
+{
+    ProgOptions producerConfig;
+    string sessionId(to_string(tools::UuidHash()));
+    producerConfig.SetProperty<string>("session", sessionId);
+    producerConfig.SetProperty<bool>("shm-monitor", true);
+    producerConfig.SetProperty<size_t>("shm-segment-size", 1000000);
+    ProgOptions consumerConfig;
+    consumerConfig.SetProperty<string>("session", sessionId);
+    consumerConfig.SetProperty<bool>("shm-monitor", true);
+    consumerConfig.SetProperty<size_t>("shm-segment-size", 1000000);
+    consumerConfig.SetProperty<uint16_t>("shm-segment-id", 1);
+    consumerConfig.SetProperty<bool>("shm-premap", true);
+    consumerConfig.SetProperty<bool>("shm-premap-prefault", true);
+
+    auto producer = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &producerConfig);
+    auto region1 = producer->CreateUnmanagedRegion(100000, [](void*, size_t, void*) {});
+    auto consumer = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &consumerConfig);
+
+    auto premapped = [&](const string& kind) {
+        for (const auto& m : consumer->GetMetrics()) {
+            if (m.name == "shm_premapped" && m.labels.front().second == kind) {
+                return static_cast<int>(m.value);
+            }
+        }
+        return -1;
+    };
+    auto waitFor = [&](const string& kind, int expected) {
+        for (int i = 0; i < 500 && premapped(kind) != expected; ++i) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        return premapped(kind);
+    };
+
+    // nothing is mapped ahead before a socket is connected
+    ASSERT_EQ(premapped("segment"), 0);
+    ASSERT_EQ(premapped("region"), 0);
+
+    auto pull = consumer->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind("ipc://test_premap_" + sessionId));
+    // both segments and the region are mapped when Bind returns
+    ASSERT_EQ(premapped("segment"), 2);
+    ASSERT_EQ(premapped("region"), 1);
+
+    // regions created later are mapped by the background thread
+    auto region2 = producer->CreateUnmanagedRegion(100000, [](void*, size_t, void*) {});
+    ASSERT_EQ(waitFor("region", 2), 2);
+    region2.reset();
+    ASSERT_EQ(waitFor("region", 1), 1);
+
+    pull.reset();
+    region1.reset();
+    consumer.reset();
+    producer.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+void FixedAddress()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<bool>("shm-fixed-address", true);
+
+    auto factory1 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    auto region = factory1->CreateUnmanagedRegion(100000, [](void*, size_t, void*) {});
+    auto msg1 = factory1->CreateMessage(1000);
+    // the creating process maps the segment and the region at their reserved addresses
+    ASSERT_TRUE(dynamic_cast<shmem::TransportFactory&>(*factory1).FixedAddressMapping());
+    ASSERT_GE(reinterpret_cast<uintptr_t>(msg1->GetData()), 0x100000000000ULL);
+    ASSERT_GE(reinterpret_cast<uintptr_t>(region->GetData()), 0x100000000000ULL);
+
+    // a second mapping in the same process cannot get the reserved range: it falls back to any address and says so
+    auto factory2 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    auto msg2 = factory2->CreateMessage(1000);
+    ASSERT_FALSE(dynamic_cast<shmem::TransportFactory&>(*factory2).FixedAddressMapping());
+    memset(msg2->GetData(), 1, msg2->GetSize());
+
+    msg2.reset();
+    msg1.reset();
+    region.reset();
+    factory2.reset();
+    factory1.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+void InlinePayloads()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+    config.SetProperty<size_t>("shm-inline-size", 64);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_inline_payloads_" + sessionId);
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    const size_t initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+    {
+        // small messages do not touch the segment, neither on the sender nor on the receiver
+        MessagePtr msg(factory->CreateMessage(64));
+        memset(msg->GetData(), 'a', 64);
+        MessagePtr copy(factory->CreateMessage());
+        copy->Copy(*msg);
+        ASSERT_EQ(push->Send(msg), 64);
+        MessagePtr received(factory->CreateMessage());
+        ASSERT_EQ(pull->Receive(received), 64);
+        ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+        ASSERT_EQ(static_cast<char*>(received->GetData())[63], 'a');
+        ASSERT_EQ(static_cast<char*>(copy->GetData())[0], 'a');
+
+        // multipart messages mix inline parts and parts in the segment
+        vector<MessagePtr> parts;
+        parts.push_back(factory->CreateMessage(10));
+        parts.push_back(factory->CreateMessage(65));
+        parts.push_back(factory->CreateMessage(1));
+        ASSERT_LT(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            memset(parts.at(i)->GetData(), 'b' + static_cast<int>(i), parts.at(i)->GetSize());
+        }
+        ASSERT_EQ(push->Send(parts), 76);
+        vector<MessagePtr> receivedParts;
+        ASSERT_EQ(pull->Receive(receivedParts), 76);
+        ASSERT_EQ(receivedParts.size(), 3U);
+        for (size_t i = 0; i < receivedParts.size(); ++i) {
+            ASSERT_EQ(receivedParts.at(i)->GetSize(), parts.at(i)->GetSize());
+            ASSERT_EQ(static_cast<char*>(receivedParts.at(i)->GetData())[receivedParts.at(i)->GetSize() - 1], static_cast<char>('b' + i));
+        }
+
+        // an inline message that grows beyond the threshold moves to the segment, with its payload
+        MessagePtr growing(factory->CreateMessage(8));
+        memset(growing->GetData(), 'x', 8);
+        ASSERT_TRUE(growing->Grow(1000));
+        ASSERT_EQ(static_cast<char*>(growing->GetData())[7], 'x');
+        MessagePtr slice(received->Slice(60, 4));
+        ASSERT_EQ(static_cast<char*>(slice->GetData())[0], 'a');
+    }
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+
+    pull.reset();
+    push.reset();
+    factory.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+void LazyReceive(const string& metaFormat)
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 10000000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address1("ipc://test_lazy_receive_1_" + metaFormat + "_" + sessionId);
+    string address2("ipc://test_lazy_receive_2_" + metaFormat + "_" + sessionId);
+    auto push = factory->CreateSocket("push", "in");
+    auto routerIn = factory->CreateSocket("pull", "in");
+    auto routerOut = factory->CreateSocket("push", "out");
+    auto pull = factory->CreateSocket("pull", "out");
+    push->SetMetaFormat(metaFormat);
+    routerOut->SetMetaFormat(metaFormat);
+    ASSERT_TRUE(routerIn->Bind(address1));
+    ASSERT_TRUE(push->Connect(address1));
+    ASSERT_TRUE(pull->Bind(address2));
+    ASSERT_TRUE(routerOut->Connect(address2));
+    auto& in = dynamic_cast<shmem::Socket&>(*routerIn);
+    auto& out = dynamic_cast<shmem::Socket&>(*routerOut);
+
+    const size_t initialFree = shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0);
+    const size_t numParts = 1000;
+    auto send = [&]() {
+        vector<MessagePtr> parts;
+        for (size_t i = 0; i < numParts; ++i) {
+            parts.push_back(factory->CreateMessage(100));
+            memset(parts.back()->GetData(), static_cast<int>(i % 128), 100);
+        }
+        ASSERT_EQ(push->Send(parts), static_cast<int64_t>(numParts * 100));
+    };
+    {
+        shmem::LazyParts parts;
+        send();
+        ASSERT_EQ(in.ReceiveLazy(parts), static_cast<int64_t>(numParts * 100));
+        ASSERT_EQ(parts.Size(), numParts);
+        ASSERT_EQ(parts.NumMaterialized(), 0U);
+        ASSERT_EQ(parts.GetSize(999), 100U);
+
+        // only the header is looked at, the last part is kept, the rest is forwarded as received
+        ASSERT_EQ(static_cast<char*>(parts.At(0).GetData())[99], 0);
+        ASSERT_EQ(parts.NumMaterialized(), 1U);
+        MessagePtr last = parts.Take(numParts - 1);
+        ASSERT_THROW(parts.At(numParts - 1), MessageError);
+        ASSERT_EQ(out.Send(parts), static_cast<int64_t>((numParts - 1) * 100));
+        ASSERT_TRUE(parts.Empty());
+
+        vector<MessagePtr> received;
+        ASSERT_EQ(pull->Receive(received), static_cast<int64_t>((numParts - 1) * 100));
+        ASSERT_EQ(received.size(), numParts - 1);
+        for (size_t i = 0; i < received.size(); ++i) {
+            ASSERT_EQ(static_cast<char*>(received.at(i)->GetData())[50], static_cast<char>(i % 128));
+        }
+        ASSERT_EQ(static_cast<char*>(last->GetData())[0], static_cast<char>((numParts - 1) % 128));
+
+        // the parts of a view that is not sent on are released with it
+        send();
+        ASSERT_EQ(in.ReceiveLazy(parts), static_cast<int64_t>(numParts * 100));
+        parts.At(1);
+    }
+    ASSERT_EQ(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0), initialFree);
+
+    pull.reset();
+    routerOut.reset();
+    routerIn.reset();
+    push.reset();
+    factory.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+void RobustLocks()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    const string mngName("fmq_" + shmem::makeShmIdStr(sessionId) + "_mng");
+
+    // a process that dies while holding the session and the region table locks
+    pid_t dying = fork();
+    ASSERT_NE(dying, -1);
+    if (dying == 0) {
+        boost::interprocess::managed_shared_memory mng(boost::interprocess::open_only, mngName.c_str());
+        mng.find<shmem::RobustMutex>(boost::interprocess::unique_instance).first->lock();
+        mng.find<shmem::RobustMutex>(shmem::kRegionTableMtx).first->lock();
+        raise(SIGKILL);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(dying, &status, 0), dying);
+
+    // the locks are taken over instead of blocking the session
+    auto region = factory->CreateUnmanagedRegion(100000, [](void*, size_t, void*) {});
+    ASSERT_NE(region, nullptr);
+    ASSERT_NO_THROW(shmem::Monitor::GetFreeMemory(shmem::SessionId{sessionId}, 0));
+
+    boost::interprocess::managed_shared_memory mng(boost::interprocess::open_only, mngName.c_str());
+    EXPECT_EQ(mng.find<shmem::RobustMutex>(boost::interprocess::unique_instance).first->NumRecoveries(), 1U);
+    EXPECT_EQ(mng.find<shmem::RobustMutex>(shmem::kRegionTableMtx).first->NumRecoveries(), 1U);
+
+    region.reset();
+    factory.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+void CommandBoard()
+{
+    const string shmId = shmem::makeShmIdStr(tools::UuidHash());
+    shmem::CommandBoard controller(shmId);
+    ASSERT_EQ(controller.NumDevices(), 0U);
+
+    // a device process applying every command until End
+    auto runDevice = [&]() {
+        shmem::CommandBoard board(shmId);
+        State state = State::Idle;
+        if (!board.Join(getpid(), state)) {
+            _exit(1);
+        }
+        uint32_t seen = board.Command();
+        while (state != State::Exiting) {
+            uint32_t command = board.WaitForCommand(seen, 1000);
+            if (command == seen) {
+                continue;
+            }
+            seen = command;
+            auto transition = shmem::CommandBoard::GetTransition(command);
+            bool accepted = transition == Transition::Run || transition == Transition::End;
+            if (transition == Transition::Run) {
+                state = State::Running;
+            } else if (transition == Transition::End) {
+                state = State::Exiting;
+            }
+            board.Acknowledge(command, accepted, state);
+        }
+        _exit(0);
+    };
+
+    vector<pid_t> devices;
+    for (int i = 0; i < 3; ++i) {
+        pid_t child = fork();
+        ASSERT_NE(child, -1);
+        if (child == 0) {
+            runDevice();
+        }
+        devices.push_back(child);
+    }
+    // a device that dies without acknowledging does not block the controller
+    pid_t dying = fork();
+    ASSERT_NE(dying, -1);
+    if (dying == 0) {
+        shmem::CommandBoard board(shmId);
+        board.Join(getpid(), State::Idle);
+        raise(SIGKILL);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(dying, &status, 0), dying);
+    for (int i = 0; i < 500 && controller.NumDevices() < 4; ++i) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    uint32_t run = controller.Post(Transition::Run);
+    EXPECT_EQ(shmem::CommandBoard::GetTransition(run), Transition::Run);
+    ASSERT_TRUE(controller.WaitForAcks(run, chrono::milliseconds(5000)));
+    auto acks = controller.GetAcks(run);
+    ASSERT_EQ(acks.size(), 3U);
+    for (const auto& ack : acks) {
+        EXPECT_TRUE(ack.acknowledged);
+        EXPECT_TRUE(ack.accepted);
+        EXPECT_EQ(ack.state, State::Running);
+    }
+
+    uint32_t bind = controller.Post(Transition::Bind);
+    ASSERT_TRUE(controller.WaitForAcks(bind, chrono::milliseconds(5000)));
+    for (const auto& ack : controller.GetAcks(bind)) {
+        EXPECT_FALSE(ack.accepted);
+        EXPECT_EQ(ack.state, State::Running);
+    }
+
+    uint32_t end = controller.Post(Transition::End);
+    ASSERT_TRUE(controller.WaitForAcks(end, chrono::milliseconds(5000)));
+    for (pid_t device : devices) {
+        ASSERT_EQ(waitpid(device, &status, 0), device);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+    // the exited devices did not leave, their slots are released by the next wait
+    uint32_t stop = controller.Post(Transition::Stop);
+    EXPECT_TRUE(controller.WaitForAcks(stop, chrono::milliseconds(5000)));
+    EXPECT_EQ(controller.NumDevices(), 0U);
+
+    boost::interprocess::shared_memory_object::remove(string("fmq_" + shmId + "_mng").c_str());
+}
+
+void ManagementSegmentSize()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+    config.SetProperty<size_t>("shm-management-segment-size", 32000000);
+
+    auto factory = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    const string mngName("fmq_" + shmem::makeShmIdStr(sessionId) + "_mng");
+    ASSERT_EQ(boost::interprocess::managed_shared_memory(boost::interprocess::open_read_only, mngName.c_str()).get_size(), 32000000U);
+
+    // a second process of the session opens it with the size of the first
+    ProgOptions config2;
+    config2.SetProperty<string>("session", sessionId);
+    config2.SetProperty<size_t>("shm-segment-size", 1000000);
+    config2.SetProperty<uint16_t>("shm-segment-id", 1);
+    auto factory2 = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config2);
+    ASSERT_EQ(boost::interprocess::managed_shared_memory(boost::interprocess::open_read_only, mngName.c_str()).get_size(), 32000000U);
+
+    // region events are delivered from the event ring
+    mutex mtx;
+    condition_variable cv;
+    int created = 0;
+    int destroyed = 0;
+    factory2->SubscribeToRegionEvents([&](RegionInfo info) {
+        if (!info.managed) {
+            lock_guard<mutex> lock(mtx);
+            (info.event == RegionEvent::created ? created : destroyed) += 1;
+            cv.notify_one();
+        }
+    });
+    {
+        vector<UnmanagedRegionPtr> regions;
+        for (int i = 0; i < 10; ++i) {
+            regions.push_back(factory->CreateUnmanagedRegion(10000, [](void*, size_t, void*) {}));
+        }
+        unique_lock<mutex> lock(mtx);
+        ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(5), [&] { return created == 10; }));
+    }
+    {
+        unique_lock<mutex> lock(mtx);
+        ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(5), [&] { return destroyed == 10; }));
+    }
+    factory2->UnsubscribeFromRegionEvents();
+
+    factory2.reset();
+    factory.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+void MemfdRegion()
+{
+    ProgOptions config;
+    string sessionId(to_string(tools::UuidHash()));
+    config.SetProperty<string>("session", sessionId);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<size_t>("shm-segment-size", 1000000);
+
+    // the receiving factory maps the region as a viewer, through the memfd of the sending one
+    auto sender = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    auto receiver = TransportFactory::CreateTransportFactory("shmem", tools::Uuid(), &config);
+    string address("ipc://test_memfd_region_" + sessionId);
+    auto push = sender->CreateSocket("push", "data");
+    auto pull = receiver->CreateSocket("pull", "data");
+    ASSERT_TRUE(pull->Bind(address));
+    ASSERT_TRUE(push->Connect(address));
+
+    mutex mtx;
+    condition_variable cv;
+    size_t ackedSize = 0;
+    RegionConfig cfg;
+    cfg.memfd = true;
+    auto region = sender->CreateUnmanagedRegion(100000, [&](void* /* data */, size_t size, void* /* hint */) {
+        lock_guard<mutex> lock(mtx);
+        ackedSize = size;
+        cv.notify_one();
+    }, cfg);
+    // no named object is created for the region
+    const string shmId = shmem::makeShmIdStr(sessionId);
+    ASSERT_NE(access(("/dev/shm/fmq_" + shmId + "_rg_" + to_string(region->GetId())).c_str(), F_OK), 0);
+    ASSERT_TRUE(shmem::Monitor::RegionIsPresent(shmem::ShmId{shmId}, region->GetId()));
+
+    {
+        MessagePtr msg(sender->CreateMessage(region, static_cast<char*>(region->GetData()) + 1000, 2000));
+        memset(msg->GetData(), 'm', 2000);
+        ASSERT_EQ(push->Send(msg), 2000);
+        MessagePtr received(receiver->CreateMessage());
+        ASSERT_EQ(pull->Receive(received), 2000);
+        ASSERT_NE(received->GetData(), static_cast<char*>(region->GetData()) + 1000); // a separate mapping of the same memory
+        ASSERT_EQ(static_cast<char*>(received->GetData())[1999], 'm');
+        static_cast<char*>(received->GetData())[0] = 'x';
+        ASSERT_EQ(static_cast<char*>(region->GetData())[1000], 'x');
+    }
+    {
+        unique_lock<mutex> lock(mtx);
+        ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(5), [&] { return ackedSize == 2000; }));
+    }
+
+    push.reset();
+    pull.reset();
+    region.reset();
+    receiver.reset();
+    sender.reset();
+    shmem::Monitor::Cleanup(shmem::SessionId{sessionId}, false);
+}
+
+TEST(Monitor, GetFreeMemory)
+{
+    GetFreeMemory();
+}
+
+TEST(AllocationCache, shmem)
+{
+    AllocationCache();
+}
+
+TEST(AllocationCacheConsumer, shmem)
+{
+    AllocationCacheConsumer();
+}
+
+TEST(SlabFitAllocation, shmem)
+{
+    SlabFitAllocation();
+}
+
+TEST(RefCountTable, shmem)
+{
+    RefCountTable();
+}
+
+TEST(BadAllocWait, shmem)
+{
+    BadAllocWait();
+}
+
+TEST(SpillOver, shmem)
+{
+    SpillOver();
+}
+
+TEST(AllocPolicy, shmem)
+{
+    AllocPolicy();
+}
+
+TEST(SegmentInitAsync, shmem)
+{
+    SegmentInitAsync();
+}
+
+TEST(MetaRing, shmem)
+{
+    MetaRing();
+}
+
+TEST(MetaRingTcp, shmem)
+{
+    MetaRingTcp();
+}
+
+TEST(SpinReceive, shmem)
+{
+    SpinReceive();
+}
+
+TEST(SendBatching, shmem)
+{
+    SendBatching();
+}
+
+TEST(AdaptiveSendBatching, shmem)
+{
+    AdaptiveSendBatching();
+}
+
+TEST(CompactMeta, shmem)
+{
+    CompactMeta();
+}
+
+TEST(BulkRelease, shmem)
+{
+    BulkRelease();
+}
+
+TEST(AllocStats, shmem)
+{
+    AllocStats();
+}
+
+TEST(AllocTrace, shmem)
+{
+    AllocTrace();
+}
+
+TEST(OwnerTags, shmem)
+{
+    OwnerTags();
+}
+
+TEST(Quotas, shmem)
+{
+    Quotas(false);
+}
+
+TEST(QuotasRefCountTable, shmem)
+{
+    Quotas(true);
+}
+
+TEST(UsageStats, shmem)
+{
+    UsageStats();
+}
+
+TEST(BufferArenas, shmem)
+{
+    BufferArenas(false);
+}
+
+TEST(BufferArenasRefCountTable, shmem)
+{
+    BufferArenas(true);
+}
+
+TEST(Slices, shmem)
+{
+    Slices("default");
+}
+
+TEST(SlicesCompactMeta, shmem)
+{
+    Slices("compact");
+}
+
+TEST(DeferredFree, shmem)
+{
+    DeferredFree();
+}
+
+TEST(MemoryWatermarks, shmem)
+{
+    MemoryWatermarks();
+}
+
+TEST(ObjectStore, shmem)
+{
+    ObjectStore();
+}
+
+TEST(Monitor, CleanupBatch)
+{
+    CleanupBatch();
+}
+
+TEST(PidLiveness, shmem)
+{
+    PidLiveness();
+}
+
+TEST(Reclaim, shmem)
+{
+    Reclaim();
+}
+
+TEST(Premap, shmem)
+{
+    Premap();
+}
+
+TEST(MemfdRegion, shmem)
+{
+    MemfdRegion();
+}
+
+TEST(ManagementSegmentSize, shmem)
+{
+    ManagementSegmentSize();
+}
+
+TEST(FixedAddress, shmem)
+{
+    FixedAddress();
+}
+
+TEST(InlinePayloads, shmem)
+{
+    InlinePayloads();
+}
+
+TEST(LazyReceive, shmem)
+{
+    LazyReceive("default");
+}
+
+TEST(LazyReceiveCompactMeta, shmem)
+{
+    LazyReceive("compact");
+}
+
+TEST(RobustLocks, shmem)
+{
+    RobustLocks();
+}
+
+TEST(CommandBoard, shmem)
+{
+    CommandBoard();
 }
 
 } // namespace
@@ -9,11 +9,13 @@
 #include "runner.h"
 
 #include <fairmq/Channel.h>
+#include <fairmq/Poller.h>
 #include <fairmq/TransportFactory.h>
 #include <fairmq/ProgOptions.h>
 #include <fairmq/tools/Process.h>
 #include <fairmq/tools/Strings.h>
 #include <fairmq/tools/Unique.h>
+#include <fairmq/tools/Wakeup.h>
 
 #include <fairlogger/Logger.h>
 
@@ -92,6 +94,75 @@ void InterruptTransfer(const string& transport, const string& _address)
     ASSERT_EQ(result, static_cast<int>(fair::mq::TransferCode::interrupted));
 }
 
+void PreciseTimeout(const string& transport, const string& _address)
+{
+    size_t session{UuidHash()};
+    std::string address(ToString(_address, "_", transport));
+
+    fair::mq::ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+
+    auto factory = TransportFactory::CreateTransportFactory(transport, Uuid(), &config);
+
+    Channel pull{"Pull", "pull", factory};
+    pull.Bind(address);
+
+    // the timeout is kept to the millisecond, not rounded up to the socket timeout (sndTimeoutMs/rcvTimeoutMs)
+    for (int timeout : {1, 20}) {
+        MessagePtr msg(pull.NewMessage());
+        auto start = chrono::steady_clock::now();
+        auto result = pull.Receive(msg, timeout);
+        auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        ASSERT_EQ(result, static_cast<int>(fair::mq::TransferCode::timeout));
+        EXPECT_GE(elapsed, timeout);
+        EXPECT_LT(elapsed, timeout + 50);
+    }
+}
+
+void PollWakeup(const string& transport, const string& _address, const string& pollerBackend)
+{
+    size_t session{UuidHash()};
+    std::string address(ToString(_address, "_", transport, "_", pollerBackend));
+
+    fair::mq::ProgOptions config;
+    config.SetProperty<string>("session", to_string(session));
+    config.SetProperty<size_t>("shm-segment-size", 100000000);
+    config.SetProperty<bool>("shm-monitor", true);
+    config.SetProperty<string>("zmq-poller", pollerBackend);
+
+    auto factory = TransportFactory::CreateTransportFactory(transport, Uuid(), &config);
+
+    vector<Channel> channels;
+    channels.emplace_back("Pull", "pull", factory);
+    ASSERT_TRUE(channels.at(0).Bind(address));
+
+    Wakeup wakeup;
+    auto poller = factory->CreatePoller(channels);
+    ASSERT_TRUE(poller->AddWakeup(wakeup.Fd()));
+
+    // without input the poller blocks until the wakeup is signalled
+    auto start = chrono::steady_clock::now();
+    auto t = thread([&]() {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        wakeup.Signal();
+    });
+    poller->Poll(-1);
+    t.join();
+    auto elapsed = chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, chrono::milliseconds(100));
+    EXPECT_LT(elapsed, chrono::milliseconds(2000));
+    EXPECT_FALSE(poller->CheckInput(0));
+
+    // it stays signalled until cleared
+    poller->Poll(-1);
+    wakeup.Clear();
+    start = chrono::steady_clock::now();
+    poller->Poll(50);
+    EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds(50));
+}
+
 TEST(TransferTimeout, zeromq)
 {
     EXPECT_EXIT(RunTransferTimeout("zeromq"), ::testing::ExitedWithCode(0), "Transfer timeout test successfull");
@@ -112,4 +183,34 @@ TEST(InterruptTransfer, shmem)
     InterruptTransfer("shmem", "ipc://test_interrupt_transfer");
 }
 
+TEST(PreciseTimeout, zeromq)
+{
+    PreciseTimeout("zeromq", "ipc://test_precise_timeout");
+}
+
+TEST(PreciseTimeout, shmem)
+{
+    PreciseTimeout("shmem", "ipc://test_precise_timeout");
+}
+
+TEST(PollWakeup, zeromq)
+{
+    PollWakeup("zeromq", "ipc://test_poll_wakeup", "zmq_poll");
+}
+
+TEST(PollWakeup, shmem)
+{
+    PollWakeup("shmem", "ipc://test_poll_wakeup", "zmq_poll");
+}
+
+TEST(PollWakeupEpoll, zeromq)
+{
+    PollWakeup("zeromq", "ipc://test_poll_wakeup", "epoll");
+}
+
+TEST(PollWakeupEpoll, shmem)
+{
+    PollWakeup("shmem", "ipc://test_poll_wakeup", "epoll");
+}
+
 } // namespace
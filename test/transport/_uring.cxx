@@ -0,0 +1,272 @@
+/********************************************************************************
+ *    Copyright (C) 2023 GSI Helmholtzzentrum fuer Schwerionenforschung GmbH    *
+ *                                                                              *
+ *              This software is distributed under the terms of the             *
+ *              GNU Lesser General Public Licence (LGPL) version 3,             *
+ *                  copied verbatim in the file "LICENSE"                       *
+ ********************************************************************************/
+
+#include <fairmq/ProgOptions.h>
+#include <fairmq/tools/Unique.h>
+#include <fairmq/TransportFactory.h>
+#include <fairmq/uring/Socket.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring> // memset
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace std;
+using namespace fair::mq;
+
+// bind to a free port in [20000, 30000)
+string BindToFreePort(Socket& socket)
+{
+    for (int port = 20000 + static_cast<int>(tools::UuidHash() % 9000); port < 30000; ++port) {
+        string address("tcp://127.0.0.1:" + to_string(port));
+        if (socket.Bind(address)) {
+            return address;
+        }
+    }
+    return "";
+}
+
+void PushPull(size_t zeroCopyThreshold)
+{
+    ProgOptions config;
+    config.SetProperty<size_t>("uring-zc-threshold", zeroCopyThreshold);
+    auto factory = TransportFactory::CreateTransportFactory("uring", tools::Uuid(), &config);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(push->Connect(address));
+
+    const vector<size_t> sizes{0, 1, 1000, 100000, 10000000};
+    // sends complete once the data is in the kernel socket buffers, large messages need a concurrent receiver
+    thread receiver([&]() {
+        for (size_t size : sizes) {
+            auto msg(factory->CreateMessage());
+            ASSERT_EQ(pull->Receive(msg), static_cast<int64_t>(size));
+            ASSERT_EQ(msg->GetSize(), size);
+            for (size_t i = 0; i < size; ++i) {
+                ASSERT_EQ(static_cast<unsigned char*>(msg->GetData())[i], size % 256);
+            }
+        }
+    });
+
+    for (size_t size : sizes) {
+        auto msg(factory->CreateMessage(size));
+        if (size > 0) {
+            memset(msg->GetData(), size % 256, size);
+        }
+        ASSERT_EQ(push->Send(msg), static_cast<int64_t>(size));
+        ASSERT_EQ(msg->GetSize(), 0);
+    }
+    receiver.join();
+
+    ASSERT_EQ(push->GetMessagesTx(), sizes.size());
+    ASSERT_EQ(pull->GetMessagesRx(), sizes.size());
+}
+
+void Multipart()
+{
+    auto factory = TransportFactory::CreateTransportFactory("uring", tools::Uuid());
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(push->Connect(address));
+
+    Parts parts;
+    parts.AddPart(factory->NewSimpleMessage(42));
+    parts.AddPart(factory->CreateMessage());
+    parts.AddPart(factory->CreateMessage(200000));
+    memset(parts.At(2)->GetData(), 7, 200000);
+    ASSERT_EQ(push->Send(parts), 200000 + sizeof(int));
+
+    Parts rcvParts;
+    ASSERT_EQ(pull->Receive(rcvParts), 200000 + sizeof(int));
+    ASSERT_EQ(rcvParts.Size(), 3);
+    ASSERT_EQ(*static_cast<int*>(rcvParts.At(0)->GetData()), 42);
+    ASSERT_EQ(rcvParts.At(1)->GetSize(), 0);
+    ASSERT_EQ(rcvParts.At(2)->GetSize(), 200000);
+    ASSERT_EQ(static_cast<char*>(rcvParts.At(2)->GetData())[199999], 7);
+
+    // a multipart message received with single part receives, part by part
+    parts.Clear();
+    parts.AddPart(factory->NewSimpleMessage(1));
+    parts.AddPart(factory->NewSimpleMessage(2));
+    ASSERT_EQ(push->Send(parts), 2 * sizeof(int));
+    for (int i = 1; i <= 2; ++i) {
+        auto msg(factory->CreateMessage());
+        ASSERT_EQ(pull->Receive(msg), sizeof(int));
+        ASSERT_EQ(*static_cast<int*>(msg->GetData()), i);
+    }
+}
+
+void Pair()
+{
+    auto factory = TransportFactory::CreateTransportFactory("uring", tools::Uuid());
+
+    auto a = factory->CreateSocket("pair", "data");
+    auto b = factory->CreateSocket("pair", "data");
+    string address = BindToFreePort(*a);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(b->Connect(address));
+
+    auto msg(factory->NewSimpleMessage(1));
+    ASSERT_EQ(b->Send(msg), sizeof(int));
+    ASSERT_EQ(a->Receive(msg), sizeof(int));
+    ASSERT_EQ(*static_cast<int*>(msg->GetData()), 1);
+    ASSERT_EQ(a->Send(msg), sizeof(int));
+    ASSERT_EQ(b->Receive(msg), sizeof(int));
+    ASSERT_EQ(*static_cast<int*>(msg->GetData()), 1);
+    ASSERT_EQ(a->GetNumberOfConnectedPeers(), 1);
+}
+
+void Timeout()
+{
+    auto factory = TransportFactory::CreateTransportFactory("uring", tools::Uuid());
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+
+    auto msg(factory->CreateMessage(100));
+    ASSERT_EQ(push->Send(msg, 200), static_cast<int>(TransferCode::timeout));
+    ASSERT_EQ(pull->Receive(msg, 200), static_cast<int>(TransferCode::timeout));
+    ASSERT_EQ(pull->Receive(msg, 0), static_cast<int>(TransferCode::timeout));
+    ASSERT_THROW(factory->CreateSocket("pub", "data"), SocketError);
+}
+
+void RegionZeroCopy()
+{
+    ProgOptions config;
+    config.SetProperty<size_t>("uring-zc-threshold", 1024);
+    auto factory = TransportFactory::CreateTransportFactory("uring", tools::Uuid(), &config);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(push->Connect(address));
+
+    constexpr int numMessages = 100;
+    constexpr size_t msgSize = 100000;
+    atomic<int> numAcks(0);
+    auto region = factory->CreateUnmanagedRegion(numMessages * msgSize, [&](void* /* data */, size_t size, void* /* hint */) {
+        ASSERT_EQ(size, msgSize);
+        ++numAcks;
+    });
+
+    thread receiver([&]() {
+        for (int i = 0; i < numMessages; ++i) {
+            auto msg(factory->CreateMessage());
+            ASSERT_EQ(pull->Receive(msg), msgSize);
+            ASSERT_EQ(static_cast<char*>(msg->GetData())[msgSize - 1], static_cast<char>(i));
+        }
+    });
+
+    for (int i = 0; i < numMessages; ++i) {
+        char* data = static_cast<char*>(region->GetData()) + i * msgSize;
+        memset(data, i, msgSize);
+        auto msg(factory->CreateMessage(region, data, msgSize));
+        ASSERT_EQ(push->Send(msg), msgSize);
+    }
+    receiver.join();
+
+    // the region callback is called once the kernel released the buffer, the socket waits for it on destruction
+    push.reset();
+    ASSERT_EQ(numAcks, numMessages);
+}
+
+void ZeroCopyDrain()
+{
+    ProgOptions config;
+    config.SetProperty<size_t>("uring-zc-threshold", 1024);
+    auto factory = TransportFactory::CreateTransportFactory("uring", tools::Uuid(), &config);
+
+    auto push = factory->CreateSocket("push", "data");
+    auto pull = factory->CreateSocket("pull", "data");
+    string address = BindToFreePort(*pull);
+    ASSERT_FALSE(address.empty());
+    ASSERT_TRUE(push->Connect(address));
+    auto* uringPush = dynamic_cast<uring::Socket*>(push.get());
+    ASSERT_NE(uringPush, nullptr);
+
+    // many small zero-copy sends, most of them are notified within the same completion round as their result
+    constexpr int numMessages = 10000;
+    constexpr size_t msgSize = 4096;
+    atomic<int> numAcks(0);
+    auto region = factory->CreateUnmanagedRegion(numMessages * msgSize, [&](void* /* data */, size_t /* size */, void* /* hint */) {
+        ++numAcks;
+    });
+
+    thread receiver([&]() {
+        for (int i = 0; i < numMessages; ++i) {
+            auto msg(factory->CreateMessage());
+            ASSERT_EQ(pull->Receive(msg), msgSize);
+        }
+    });
+    for (int i = 0; i < numMessages; ++i) {
+        auto msg(factory->CreateMessage(region, static_cast<char*>(region->GetData()) + i * msgSize, msgSize));
+        ASSERT_EQ(push->Send(msg), msgSize);
+    }
+    receiver.join();
+
+    // with the socket still open, all buffers are released and all region acks arrive
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while ((uringPush->GetNumZeroCopyInFlight() > 0 || numAcks < numMessages) && chrono::steady_clock::now() < deadline) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    ASSERT_EQ(uringPush->GetNumZeroCopyInFlight(), 0);
+    ASSERT_EQ(numAcks, numMessages);
+}
+
+TEST(PushPull, uring)
+{
+    PushPull(16384);
+}
+
+TEST(PushPullCopy, uring)
+{
+    PushPull(0);
+}
+
+TEST(Multipart, uring)
+{
+    Multipart();
+}
+
+TEST(Pair, uring)
+{
+    Pair();
+}
+
+TEST(Timeout, uring)
+{
+    Timeout();
+}
+
+TEST(RegionZeroCopy, uring)
+{
+    RegionZeroCopy();
+}
+
+TEST(ZeroCopyDrain, uring)
+{
+    ZeroCopyDrain();
+}
+
+} // namespace